@@ -50,29 +50,97 @@ int usage(char** argv)
         << "\n    --max-level [int]                   : maximum level of detail"
         << "\n    --osg-options [OSG options string]  : options to pass to OSG readers/writers"
         << "\n    --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy"
+        << "\n    --partition [index] [count]         : process only this machine's share of the tiles"
+        << "\n    --partition-level [int]             : level at which to split tiles between partitions (default = 5)"
+        << "\n    --work-queue [folder]               : shared folder partitions use to balance their work"
+        << "\n    --run-id [id]                       : names this run in the work queue; all partitions must match"
+        << "\n    --threads [n]                       : number of threads reading and writing tiles"
+        << "\n    --skip-existing                     : don't rewrite tiles the output already has"
         << std::endl;
 
     return 0;
 }
 
 
+// Base for the handlers below. Skips tiles the output already has (if
+// asked to), serializes the stores for output drivers that can't take
+// concurrent writes, and counts the results for the final report.
+struct TileSourceWriter : public TileHandler
+{
+    TileSourceWriter(TileSource* dest)
+        : _dest(dest), _skipExisting(false), _written(0u), _existing(0u)
+    {
+        //nop
+    }
+
+    // true if the output already has this tile and we should leave it be.
+    bool exists(const TileKey& key)
+    {
+        if (_skipExisting && _dest->hasStoredTile(key))
+        {
+            Threading::ScopedMutexLock lock(_statsMutex);
+            ++_existing;
+            return true;
+        }
+        return false;
+    }
+
+    void stored()
+    {
+        Threading::ScopedMutexLock lock(_statsMutex);
+        ++_written;
+    }
+
+    // Holds the write mutex only if the output driver needs it.
+    struct WriteLock
+    {
+        WriteLock(TileSourceWriter& w)
+            : _mutex(w._dest->supportsConcurrentWrites() ? 0L : &w._writeMutex)
+        {
+            if (_mutex) _mutex->lock();
+        }
+        ~WriteLock()
+        {
+            if (_mutex) _mutex->unlock();
+        }
+        Threading::Mutex* _mutex;
+    };
+
+    TileSource*      _dest;
+    bool             _skipExisting;
+    Threading::Mutex _writeMutex;
+    Threading::Mutex _statsMutex;
+    unsigned         _written;
+    unsigned         _existing;
+};
+
+
 // TileHandler that copies images from an ImageLayer to a TileSource.
 // This will automatically handle any mosaicing and reprojection that is
 // necessary to translate from one Profile/SRS to another.
-struct ImageLayerToTileSource : public TileHandler
+struct ImageLayerToTileSource : public TileSourceWriter
 {
     ImageLayerToTileSource(ImageLayer* source, TileSource* dest)
-        : _source(source), _dest(dest)
+        : TileSourceWriter(dest), _source(source)
     {
         //nop
     }
 
     bool handleTile(const TileKey& key, const TileVisitor& tv)
     {
+        if (exists(key))
+            return true;
+
         bool ok = false;
         GeoImage image = _source->createImage(key);
         if (image.valid())
+        {
+            WriteLock lock(*this);
             ok = _dest->storeImage(key, image.getImage(), 0L);
+        }
+
+        if (ok)
+            stored();
 
         return ok;
     }
@@ -83,27 +151,36 @@ struct ImageLayerToTileSource : public TileHandler
     }
 
     osg::ref_ptr<ImageLayer> _source;
-    TileSource*              _dest;
 };
 
 
 // TileHandler that copies images from an ElevationLayer to a TileSource.
 // This will automatically handle any mosaicing and reprojection that is
 // necessary to translate from one Profile/SRS to another.
-struct ElevationLayerToTileSource : public TileHandler
+struct ElevationLayerToTileSource : public TileSourceWriter
 {
     ElevationLayerToTileSource(ElevationLayer* source, TileSource* dest)
-        : _source(source), _dest(dest)
+        : TileSourceWriter(dest), _source(source)
     {
         //nop
     }
 
     bool handleTile(const TileKey& key, const TileVisitor& tv)
     {
+        if (exists(key))
+            return true;
+
         bool ok = false;
         GeoHeightField hf = _source->createHeightField(key, 0L);
         if ( hf.valid() )
+        {
+            WriteLock lock(*this);
             ok = _dest->storeHeightField(key, hf.getHeightField(), 0L);
+        }
+
+        if (ok)
+            stored();
+
         return ok;
     }
 
@@ -113,38 +190,66 @@ struct ElevationLayerToTileSource : public TileHandler
     }
 
     osg::ref_ptr<ElevationLayer> _source;
-    TileSource*                  _dest;
 };
 
 
-// Custom progress reporter
+// Custom progress reporter. Prints the count, the rate and an ETA a few
+// times a second (not once per tile, which slows down threaded runs).
 struct ProgressReporter : public osgEarth::ProgressCallback
 {
+    ProgressReporter()
+        : _start(osg::Timer::instance()->tick()), _lastReport(0)
+    {
+        //nop
+    }
+
     bool reportProgress(double             current,
                         double             total,
                         unsigned           currentStage,
                         unsigned           totalStages,
                         const std::string& msg )
     {
-        _mutex.lock();
+        Threading::ScopedMutexLock lock(_mutex);
+
+        osg::Timer_t now = osg::Timer::instance()->tick();
+        bool done = current >= total;
+        if ( !done && _lastReport != 0 && osg::Timer::instance()->delta_s(_lastReport, now) < 0.25 )
+            return false;
+        _lastReport = now;
+
+        double elapsed = osg::Timer::instance()->delta_s(_start, now);
+        double rate = elapsed > 0.0 ? current/elapsed : 0.0;
+        float percentage = total > 0.0 ? current/total*100.0f : 0.0f;
 
-        float percentage = current/total*100.0f;
         std::cout
             << std::fixed
             << std::setprecision(1) << "\r"
             << (int)current << "/" << (int)total
-            << " (" << percentage << "%)"
+            << " (" << percentage << "%) "
+            << rate << " tiles/s";
+
+        if ( !done && rate > 0.0 )
+        {
+            unsigned eta = (unsigned)((total - current) / rate);
+            std::cout
+                << ", ETA "
+                << eta/3600 << ":"
+                << std::setfill('0') << std::setw(2) << (eta/60)%60 << ":"
+                << std::setw(2) << eta%60 << std::setfill(' ');
+        }
+
+        std::cout
             << "                        "
             << std::flush;
 
-        if ( percentage >= 100.0f )
+        if ( done )
             std::cout << std::endl;
 
-        _mutex.unlock();
-
         return false;
     }
 
+    osg::Timer_t     _start;
+    osg::Timer_t     _lastReport;
     Threading::Mutex _mutex;
 };
 
@@ -166,6 +271,8 @@ struct ProgressReporter : public osgEarth::ProgressCallback
  *
  * The "in" properties come from the GDALOptions getConfig method. The
  * "out" properties come from the MBTilesOptions getConfig method.
+ * MBTiles output is written in batched transactions; use "--out batch_size [n]"
+ * to change the number of tiles per transaction (default 1000).
  *
  * Other arguments:
  *
@@ -173,7 +280,11 @@ struct ProgressReporter : public osgEarth::ProgressCallback
  *      --profile [profile]   : reproject to the target profile, e.g. "wgs84"
  *      --min-level [int]     : min level of detail to copy
  *      --max-level [int]     : max level of detail to copy
- *      --threads [n]         : threads to use (may crash. Careful.)
+ *      --threads [n]         : threads to use for reading, reprojecting and writing
+ *                              tiles; stores are serialized unless the output
+ *                              driver supports concurrent writes (mbtiles, tms)
+ *      --skip-existing       : leave tiles the output already has alone, e.g. to
+ *                              resume an interrupted conversion
  *
  *      --extents [minLat] [minLong] [maxLat] [maxLong] : Lat/Long extends to copy (*)
  *
@@ -311,6 +422,10 @@ main(int argc, char** argv)
         visitor = new TileVisitor();
     }
 
+    bool skipExisting = args.read("--skip-existing");
+
+    osg::ref_ptr<TileSourceWriter> writer;
+
     if (heightFields)
     {
         ElevationLayer* layer = new ElevationLayer(ElevationLayerOptions(), input.get());
@@ -325,7 +440,7 @@ main(int argc, char** argv)
             OE_WARN << LC << "Input profile is not valid" << std::endl;
             return -1;
         }
-        visitor->setTileHandler( new ElevationLayerToTileSource(layer, output.get()) );
+        writer = new ElevationLayerToTileSource(layer, output.get());
     }
 
     else // image layers
@@ -342,7 +457,15 @@ main(int argc, char** argv)
             OE_WARN << LC << "Input profile is not valid" << std::endl;
             return -1;
         }
-        visitor->setTileHandler( new ImageLayerToTileSource(layer, output.get()) );
+        writer = new ImageLayerToTileSource(layer, output.get());
+    }
+
+    writer->_skipExisting = skipExisting;
+    visitor->setTileHandler( writer.get() );
+
+    if ( numThreads > 1 && !output->supportsConcurrentWrites() )
+    {
+        OE_NOTICE << LC << "Output driver does not support concurrent writes; tiles will be stored one at a time" << std::endl;
     }
 
     // Set the level limits:
@@ -386,6 +509,31 @@ main(int argc, char** argv)
         visitor->addExtent( extent );
     }
 
+    // split the job up between machines:
+    unsigned partitionIndex = 0, partitionCount = 1;
+    if ( args.read("--partition", partitionIndex, partitionCount) )
+    {
+        visitor->setPartition( partitionIndex, partitionCount );
+    }
+
+    unsigned partitionLevel;
+    if ( args.read("--partition-level", partitionLevel) )
+    {
+        visitor->setPartitionLevel( partitionLevel );
+    }
+
+    std::string workQueue;
+    if ( args.read("--work-queue", workQueue) )
+    {
+        visitor->setWorkQueuePath( workQueue );
+    }
+
+    std::string runID;
+    if ( args.read("--run-id", runID) )
+    {
+        visitor->setRunID( runID );
+    }
+
     // Ready!!!
     std::cout << "Working..." << std::endl;
 
@@ -396,13 +544,21 @@ main(int argc, char** argv)
     visitor->run( outputProfile.get() );
 
     osg::Timer_t t1 = osg::Timer::instance()->tick();
+    double seconds = osg::Timer::instance()->delta_s(t0, t1);
 
     std::cout
         << "Time = "
         << std::fixed
         << std::setprecision(1)
-        << osg::Timer::instance()->delta_s(t0, t1)
+        << seconds
         << " seconds." << std::endl;
 
+    std::cout
+        << "Tiles written = " << writer->_written
+        << " (" << (seconds > 0.0 ? writer->_written/seconds : 0.0) << "/s)";
+    if ( skipExisting )
+        std::cout << ", already present = " << writer->_existing;
+    std::cout << std::endl;
+
     return 0;
 }
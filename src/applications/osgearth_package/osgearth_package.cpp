@@ -75,6 +75,15 @@ usage( const std::string& msg = "" )
         << "            [--mt]                          ; Use multithreading to process the tiles." << std::endl
         << "            [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
         << "            [--alpha-mask]                  ; Mask out imagery that isn't in the provided extents." << std::endl
+        << "            [--compress <processor>]        ; Writes imagery as DXT-compressed DDS with mipmaps (e.g. fastdxt, nvtt)" << std::endl
+        << "            [--encode-threads <num>]        ; Threads that compress and encode tiles (default=2; 0=inline)" << std::endl
+        << "            [--write-threads <num>]         ; Threads that write tiles to disk (default=2; 0=inline)" << std::endl
+        << "            [--queue-size <num>]            ; Max tiles waiting for each of those stages (default=64)" << std::endl
+        << "            [--mbtiles]                     ; Write each layer to a single MBTiles file instead of a TMS folder" << std::endl
+        << "            [--partition <index> <count>]   ; Package only this machine's share of the tiles" << std::endl
+        << "            [--partition-level <num>]       ; Level at which to split tiles between partitions (default=5)" << std::endl
+        << "            [--work-queue <path>]           ; Shared folder partitions use to balance their work" << std::endl
+        << "            [--run-id <id>]                 ; Names this run in the work queue; all partitions must match" << std::endl
         << std::endl
         << "            [--verbose]                     ; Displays progress of the operation" << std::endl;
 
@@ -108,6 +117,27 @@ findArgumentWithExtension( osg::ArgumentParser& args, const std::string& ext )
 }
 
 
+/** Driver options for reading back the layer the packager just wrote. */
+TileSourceOptions
+getOutputDriverOptions( const TMSPackager& packager, const std::string& outEarthFile )
+{
+    if ( packager.getWriteMBTiles() )
+    {
+        Config conf;
+        conf.set( "driver", "mbtiles" );
+        conf.set( "filename", osgDB::getSimpleFileName(packager.getMBTilesFilename(packager.getLayerName())) );
+        return TileSourceOptions( conf );
+    }
+
+    // new TMS driver info:
+    std::string layerFolder = toLegalFileName( packager.getLayerName() );
+    TMSOptions tms;
+    tms.url() = URI(
+        osgDB::concatPaths( layerFolder, "tms.xml" ),
+        outEarthFile );
+    return tms;
+}
+
 /** Packages an image layer as a TMS folder. */
 int
 makeTMS( osg::ArgumentParser& args )
@@ -223,6 +253,19 @@ makeTMS( osg::ArgumentParser& args )
     // elevation pixel depth
     unsigned elevationPixelDepth = 32;
     args.read( "--elevation-pixel-depth", elevationPixelDepth );
+
+    // image processor to pre-compress imagery for the GPU
+    std::string compressor;
+    args.read( "--compress", compressor );
+
+    // pipeline stages
+    int encodeThreads = -1, writeThreads = -1, queueSize = -1;
+    args.read( "--encode-threads", encodeThreads );
+    args.read( "--write-threads", writeThreads );
+    args.read( "--queue-size", queueSize );
+
+    // single-file output
+    bool writeMBTiles = args.read( "--mbtiles" );
     
     // create a folder for the output
     osgDB::makeDirectory( rootFolder );
@@ -314,6 +357,31 @@ makeTMS( osg::ArgumentParser& args )
     visitor->setMinLevel( minLevel );
     visitor->setMaxLevel( maxLevel );        
 
+    unsigned int partitionIndex = 0, partitionCount = 1;
+    if (args.read("--partition", partitionIndex, partitionCount))
+    {
+        visitor->setPartition( partitionIndex, partitionCount );
+
+        // Only the first partition writes out the metadata.
+        if (partitionIndex > 0)
+        {
+            writeXML = false;
+            outEarth.clear();
+        }
+    }
+
+    unsigned int partitionLevel = 0;
+    if (args.read("--partition-level", partitionLevel))
+        visitor->setPartitionLevel( partitionLevel );
+
+    std::string workQueue;
+    if (args.read("--work-queue", workQueue))
+        visitor->setWorkQueuePath( workQueue );
+
+    std::string runID;
+    if (args.read("--run-id", runID))
+        visitor->setRunID( runID );
+
 
     for (unsigned int i = 0; i < bounds.size(); i++)
     {
@@ -333,6 +401,14 @@ makeTMS( osg::ArgumentParser& args )
     packager.setOverwrite(overwrite);
     packager.setKeepEmpties(keepEmpties);
     packager.setApplyAlphaMask(applyAlphaMask);
+    packager.setTextureCompression(compressor);
+    if (encodeThreads >= 0)
+        packager.setNumEncodeThreads(encodeThreads);
+    if (writeThreads >= 0)
+        packager.setNumWriteThreads(writeThreads);
+    if (queueSize > 0)
+        packager.setMaxQueuedTiles(queueSize);
+    packager.setWriteMBTiles(writeMBTiles);
 
 
     // new map for an output earth file if necessary.
@@ -408,15 +484,7 @@ makeTMS( osg::ArgumentParser& args )
             // save to the output map if requested:
             if( outMap.valid() )
             {
-                std::string layerFolder = toLegalFileName( packager.getLayerName() );
-
-                // new TMS driver info:
-                TMSOptions tms;
-                tms.url() = URI(
-                    osgDB::concatPaths( layerFolder, "tms.xml" ),
-                    outEarthFile );
-
-                ImageLayerOptions layerOptions( packager.getLayerName(), tms );
+                ImageLayerOptions layerOptions( packager.getLayerName(), getOutputDriverOptions(packager, outEarthFile) );
 
                 outMap->addLayer( new ImageLayer( layerOptions ) );
             }
@@ -445,15 +513,7 @@ makeTMS( osg::ArgumentParser& args )
             // save to the output map if requested:
             if( outMap.valid() )
             {
-                std::string layerFolder = toLegalFileName( packager.getLayerName() );
-
-                // new TMS driver info:
-                TMSOptions tms;
-                tms.url() = URI(
-                    osgDB::concatPaths( layerFolder, "tms.xml" ),
-                    outEarthFile );
-
-                ElevationLayerOptions layerOptions( packager.getLayerName(), tms );
+                ElevationLayerOptions layerOptions( packager.getLayerName(), getOutputDriverOptions(packager, outEarthFile) );
 
                 outMap->addLayer( new ElevationLayer( layerOptions ) );
             }
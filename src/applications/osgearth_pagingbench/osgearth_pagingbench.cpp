@@ -0,0 +1,351 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgViewer/Viewer>
+#include <osgGA/AnimationPathManipulator>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgDB/DatabasePager>
+#include <osg/GLExtensions>
+#include <osg/Timer>
+#include <osgEarth/Notify>
+#include <osgEarth/MapNode>
+#include <osgEarth/Registry>
+#include <osgEarth/CachePolicy>
+#include <osgEarth/Memory>
+#include <osgEarth/ThreadingUtils>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#define LC "[pagingbench] "
+
+using namespace osgEarth;
+
+// GL_NVX_gpu_memory_info
+#define GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX   0x9048
+#define GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+
+// GL_ATI_meminfo
+#define TEXTURE_FREE_MEMORY_ATI 0x87FC
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " file.earth --path file.path [options]\n"
+        << "\nReplays a recorded camera path against an earth file and reports paging performance.\n"
+        << "\nOptions:\n"
+        << "    --path <file>      animation path to replay (required)\n"
+        << "    --fps <n>          simulation rate; the path advances 1/n seconds per frame (default 60)\n"
+        << "    --size <w> <h>     size of the render surface (default 1280 720)\n"
+        << "    --window           render to a window instead of an offscreen pbuffer\n"
+        << "    --cache-only       read from the cache only, never from the network or source data\n"
+        << "    --settle <n>       frames with no pending tile requests that mark full detail (default 10)\n"
+        << "    --timeout <s>      give up waiting for full detail after this many seconds (default 120)\n"
+        << "    --out <file>       also write the results to a file\n"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    // Value at fraction p (0..1) of a list of samples; sorts the list.
+    double percentile(std::vector<double>& samples, double p)
+    {
+        if (samples.empty())
+            return 0.0;
+        std::sort(samples.begin(), samples.end());
+        unsigned i = (unsigned)(p * (double)(samples.size()-1) + 0.5);
+        return samples[std::min(i, (unsigned)samples.size()-1)];
+    }
+
+    /**
+     * Times every node read. Terrain tiles and paged feature tiles all
+     * come through readNode from the pager threads.
+     */
+    struct TimingReadFileCallback : public osgDB::Registry::ReadFileCallback
+    {
+        osgDB::ReaderWriter::ReadResult readNode(const std::string& filename, const osgDB::Options* options)
+        {
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            osgDB::ReaderWriter::ReadResult r = osgDB::Registry::ReadFileCallback::readNode(filename, options);
+            double ms = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+
+            Threading::ScopedMutexLock lock(_mutex);
+            _times.push_back(ms);
+            return r;
+        }
+
+        void getTimes(std::vector<double>& out)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            out = _times;
+        }
+
+        Threading::Mutex    _mutex;
+        std::vector<double> _times;
+    };
+
+    /**
+     * Samples the driver's video memory counters after each frame, when
+     * one of the vendor extensions is available. Runs on the draw thread.
+     */
+    struct GPUMemoryCallback : public osg::Camera::DrawCallback
+    {
+        GPUMemoryCallback() : _checked(false), _nvx(false), _ati(false), _totalKB(0), _firstFreeKB(-1), _minFreeKB(-1) { }
+
+        void operator()(osg::RenderInfo& ri) const
+        {
+            if (!_checked)
+            {
+                unsigned id = ri.getContextID();
+                _nvx = osg::isGLExtensionSupported(id, "GL_NVX_gpu_memory_info");
+                _ati = !_nvx && osg::isGLExtensionSupported(id, "GL_ATI_meminfo");
+                if (_nvx)
+                    glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &_totalKB);
+                _checked = true;
+            }
+
+            GLint freeKB[4] = { -1, -1, -1, -1 };
+            if (_nvx)
+                glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, freeKB);
+            else if (_ati)
+                glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, freeKB);
+            else
+                return;
+
+            if (_firstFreeKB < 0)
+                _firstFreeKB = freeKB[0];
+            if (_minFreeKB < 0 || freeKB[0] < _minFreeKB)
+                _minFreeKB = freeKB[0];
+        }
+
+        bool supported() const { return _nvx || _ati; }
+
+        // Peak video memory in use: the whole device for NVX, or the
+        // growth since the first frame for ATI, which has no total.
+        double peakUsedMB() const
+        {
+            if (_minFreeKB < 0)
+                return 0.0;
+            return _nvx ? (double)(_totalKB - _minFreeKB) / 1024.0 : (double)(_firstFreeKB - _minFreeKB) / 1024.0;
+        }
+
+        mutable bool  _checked, _nvx, _ati;
+        mutable GLint _totalKB, _firstFreeKB, _minFreeKB;
+    };
+
+    osg::GraphicsContext* createContext(int width, int height, bool window)
+    {
+        osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits();
+        traits->x = 0;
+        traits->y = 0;
+        traits->width = width;
+        traits->height = height;
+        traits->red = traits->green = traits->blue = traits->alpha = 8;
+        traits->depth = 24;
+        traits->windowDecoration = window;
+        traits->doubleBuffer = window;
+        traits->pbuffer = !window;
+        traits->vsync = false;
+
+        osg::GraphicsContext* gc = osg::GraphicsContext::createGraphicsContext(traits.get());
+        if (!gc && !window)
+        {
+            OE_WARN << LC << "Failed to create a pbuffer; falling back on a window" << std::endl;
+            return createContext(width, height, true);
+        }
+        return gc;
+    }
+}
+
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    if ( arguments.read("--help") )
+        return usage(argv[0]);
+
+    std::string pathFile;
+    if ( !arguments.read("--path", pathFile) )
+        return usage(argv[0]);
+
+    double fps = 60.0;
+    arguments.read("--fps", fps);
+    if ( fps <= 0.0 )
+        fps = 60.0;
+
+    int width = 1280, height = 720;
+    arguments.read("--size", width, height);
+
+    bool window = arguments.read("--window");
+
+    unsigned settleFrames = 10u;
+    arguments.read("--settle", settleFrames);
+
+    double timeout = 120.0;
+    arguments.read("--timeout", timeout);
+
+    std::string outFile;
+    arguments.read("--out", outFile);
+
+    // Pinning the cache keeps the run independent of network and source
+    // data latency, so results are comparable between builds.
+    if ( arguments.read("--cache-only") )
+    {
+        osgEarth::Registry::instance()->setOverrideCachePolicy( CachePolicy(CachePolicy::USAGE_CACHE_ONLY) );
+    }
+
+    osg::ref_ptr<TimingReadFileCallback> readTimer = new TimingReadFileCallback();
+    osgDB::Registry::instance()->setReadFileCallback( readTimer.get() );
+
+    osg::ref_ptr<osgGA::AnimationPathManipulator> manip = new osgGA::AnimationPathManipulator( pathFile );
+    if ( !manip->valid() )
+    {
+        OE_WARN << LC << "Failed to load animation path \"" << pathFile << "\"" << std::endl;
+        return -1;
+    }
+    manip->getAnimationPath()->setLoopMode( osg::AnimationPath::NO_LOOPING );
+    double pathDuration = manip->getAnimationPath()->getPeriod();
+
+    osg::ref_ptr<osg::Node> node = osgDB::readNodeFiles( arguments );
+    if ( !node.valid() || !MapNode::findMapNode(node.get()) )
+    {
+        OE_WARN << LC << "Failed to load an earth file" << std::endl;
+        return usage(argv[0]);
+    }
+
+    osgViewer::Viewer viewer(arguments);
+
+    // Frame times need to include the draw, so everything runs on one thread.
+    viewer.setThreadingModel( osgViewer::Viewer::SingleThreaded );
+    viewer.getDatabasePager()->setUnrefImageDataAfterApplyPolicy( true, false );
+    osgDB::Registry::instance()->getObjectWrapperManager()->findWrapper("osg::Image");
+
+    osg::ref_ptr<osg::GraphicsContext> gc = createContext( width, height, window );
+    if ( !gc.valid() )
+    {
+        OE_WARN << LC << "Failed to create a graphics context" << std::endl;
+        return -1;
+    }
+
+    osg::Camera* camera = viewer.getCamera();
+    camera->setGraphicsContext( gc.get() );
+    camera->setViewport( 0, 0, width, height );
+    camera->setProjectionMatrixAsPerspective( 30.0, (double)width/(double)height, 1.0, 1000.0 );
+    camera->setSmallFeatureCullingPixelSize( -1.0f );
+    camera->setNearFarRatio( 0.0001 );
+    GLenum buffer = gc->getTraits()->doubleBuffer ? GL_BACK : GL_FRONT;
+    camera->setDrawBuffer( buffer );
+    camera->setReadBuffer( buffer );
+
+    osg::ref_ptr<GPUMemoryCallback> gpuMemory = new GPUMemoryCallback();
+    camera->setFinalDrawCallback( gpuMemory.get() );
+
+    viewer.setCameraManipulator( manip.get() );
+    viewer.setSceneData( node.get() );
+    viewer.realize();
+
+    std::vector<double> frameTimes;
+    osg::Timer_t start = osg::Timer::instance()->tick();
+    double timeToFullDetail = -1.0;
+    unsigned idleFrames = 0u;
+    unsigned frame = 0u;
+
+    while ( !viewer.done() )
+    {
+        double simTime = (double)frame / fps;
+
+        osg::Timer_t t0 = osg::Timer::instance()->tick();
+        viewer.frame( simTime );
+        osg::Timer_t t1 = osg::Timer::instance()->tick();
+        frameTimes.push_back( osg::Timer::instance()->delta_m(t0, t1) );
+        ++frame;
+
+        double elapsed = osg::Timer::instance()->delta_s(start, t1);
+
+        // Once the path has ended, wait for the pager to go quiet.
+        if ( simTime >= pathDuration )
+        {
+            if ( viewer.getDatabasePager()->getRequestsInProgress() )
+            {
+                idleFrames = 0u;
+            }
+            else if ( ++idleFrames >= settleFrames )
+            {
+                timeToFullDetail = elapsed;
+                break;
+            }
+
+            if ( elapsed > pathDuration + timeout )
+            {
+                OE_WARN << LC << "Timed out waiting for full detail" << std::endl;
+                break;
+            }
+        }
+    }
+
+    std::vector<double> loadTimes;
+    readTimer->getTimes( loadTimes );
+    osgDB::Registry::instance()->setReadFileCallback( 0L );
+
+    osgDB::DatabasePager* pager = viewer.getDatabasePager();
+
+    std::stringstream buf;
+    buf << std::fixed << std::setprecision(3)
+        << "frames="                     << frameTimes.size() << "\n"
+        << "path_duration_s="            << pathDuration << "\n"
+        << "time_to_full_detail_s="      << timeToFullDetail << "\n"
+        << "frame_ms_p50="               << percentile(frameTimes, 0.50) << "\n"
+        << "frame_ms_p95="               << percentile(frameTimes, 0.95) << "\n"
+        << "frame_ms_p99="               << percentile(frameTimes, 0.99) << "\n"
+        << "frame_ms_max="               << percentile(frameTimes, 1.00) << "\n"
+        << "tile_loads="                 << loadTimes.size() << "\n"
+        << "tile_load_ms_p50="           << percentile(loadTimes, 0.50) << "\n"
+        << "tile_load_ms_p95="           << percentile(loadTimes, 0.95) << "\n"
+        << "tile_load_ms_p99="           << percentile(loadTimes, 0.99) << "\n"
+        << "tile_load_ms_max="           << percentile(loadTimes, 1.00) << "\n"
+        << "tile_merge_ms_min="          << pager->getMinimumTimeToMergeTile() * 1000.0 << "\n"
+        << "tile_merge_ms_avg="          << pager->getAverageTimeToMergeTiles() * 1000.0 << "\n"
+        << "tile_merge_ms_max="          << pager->getMaximumTimeToMergeTile() * 1000.0 << "\n"
+        << "peak_memory_mb="             << (double)Memory::getProcessPeakPhysicalUsage() / 1048576.0 << "\n";
+
+    if ( gpuMemory->supported() )
+        buf << "peak_gpu_memory_mb="     << gpuMemory->peakUsedMB() << "\n";
+
+    std::cout << buf.str();
+
+    if ( !outFile.empty() )
+    {
+        std::ofstream out( outFile.c_str() );
+        out << buf.str();
+    }
+
+    return timeToFullDetail >= 0.0 ? 0 : 1;
+}
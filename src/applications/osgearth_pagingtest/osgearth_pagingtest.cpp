@@ -114,6 +114,10 @@ public:
               FeatureList features;
               cursor->fill( features );
 
+              // The tile went out of view while we were reading; skip the build.
+              if ( progress && progress->isCanceled() )
+                  return 0;
+
               Style style = _style;
 
               // See if we have a style for a given lod, otherwise use the default style
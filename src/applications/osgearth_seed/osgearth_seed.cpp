@@ -85,6 +85,10 @@ int
         << std::endl
         << "    --seed file.earth                   ; Seeds the cache in a .earth file"  << std::endl
         << "        [--estimate]                    ; Print out an estimation of the number of tiles, disk space and time it will take to perform this seed operation" << std::endl
+        << "        [--probe]                       ; With --estimate, time a sample of tiles from each layer to base the estimate on" << std::endl
+        << "        [--plan file]                   ; With --estimate, write the tiles in seeding order to a task file for --tiles" << std::endl
+        << "        [--time-budget seconds]         ; Limit the --plan to the tiles that fit in this much estimated time" << std::endl
+        << "        [--priority-bounds xmin ymin xmax ymax]* ; Like --bounds, but planned ahead of all --bounds areas" << std::endl
         << "        [--min-level level]             ; Lowest LOD level to seed (default=0)" << std::endl
         << "        [--max-level level]             ; Highest LOD level to seed (defaut=highest available)" << std::endl
         << "        [--bounds xmin ymin xmax ymax]* ; Geospatial bounding box to seed (in map coordinates; default=entire map)" << std::endl
@@ -93,6 +97,12 @@ int
         << "        [--mt]                          ; Use multithreading to process the tiles." << std::endl
         << "        [--concurrency]                 ; The number of threads or processes to use if --mp or --mt are provided." << std::endl
         << "        [--verbose]                     ; Displays progress of the seed operation" << std::endl
+        << "        [--checkpoint folder]           ; Records progress in this folder so an interrupted seed can be resumed" << std::endl
+        << "        [--compress]                    ; Stores imagery in the cache DXT-compressed with mipmaps, ready for the GPU" << std::endl
+        << "        [--partition index count]       ; Seeds only this machine's share of the tiles" << std::endl
+        << "        [--partition-level level]       ; Level at which to split tiles between partitions (default=5)" << std::endl
+        << "        [--work-queue folder]           ; Shared folder partitions use to balance their work" << std::endl
+        << "        [--run-id id]                   ; Names this run in the work queue; all partitions must match" << std::endl
         << std::endl
         << "    --purge file.earth                  ; Purges a layer cache in a .earth file (interactive)" << std::endl
         << std::endl;
@@ -125,6 +135,14 @@ seed( osg::ArgumentParser& args )
     while (args.read("--max-level", maxLevel));
 
     bool estimate = args.read("--estimate");        
+
+    bool probe = args.read("--probe");
+
+    std::string planFile;
+    args.read("--plan", planFile);
+
+    double timeBudget = 0.0;
+    args.read("--time-budget", timeBudget);
     
 
     std::vector< Bounds > bounds;
@@ -137,11 +155,25 @@ seed( osg::ArgumentParser& args )
         bounds.push_back( b );
     }    
 
+    // priority bounds are planned first, then seeded like any other bounds.
+    std::vector< Bounds > priorityBounds;
+    while (args.read("--priority-bounds", xmin, ymin, xmax, ymax ))
+    {        
+        Bounds b;
+        b.xMin() = xmin, b.yMin() = ymin, b.xMax() = xmax, b.yMax() = ymax;
+        priorityBounds.push_back( b );
+    }    
+
     std::string tileList;
     while (args.read( "--tiles", tileList ) );
 
     bool verbose = args.read("--verbose");
 
+    std::string checkpointPath;
+    args.read("--checkpoint", checkpointPath);
+
+    bool compress = args.read("--compress");
+
     unsigned int batchSize = 0;
     args.read("--batchsize", batchSize);
 
@@ -205,6 +237,16 @@ seed( osg::ArgumentParser& args )
             est.setMaxLevel( maxLevel );
         est.setProfile( mapNode->getMap()->getProfile() );
 
+        if ( concurrency > 0 )
+            est.setNumThreads( concurrency );
+
+        for (unsigned int i = 0; i < priorityBounds.size(); i++)
+        {
+            GeoExtent extent(mapNode->getMapSRS(), priorityBounds[i]);
+            OE_DEBUG << "Adding priority extent " << extent.toString() << std::endl;
+            est.addExtent( extent, 1 );
+        } 
+
         for (unsigned int i = 0; i < bounds.size(); i++)
         {
             GeoExtent extent(mapNode->getMapSRS(), bounds[i]);
@@ -212,6 +254,35 @@ seed( osg::ArgumentParser& args )
             est.addExtent( extent );
         } 
 
+        if ( probe )
+        {
+            osgEarth::Map* map = mapNode->getMap();
+            TerrainLayerVector terrainLayers;
+            if ( imageLayerIndex >= 0 )
+                terrainLayers.push_back( map->getLayerAt<ImageLayer>( imageLayerIndex ) );
+            else if ( elevationLayerIndex >= 0 )
+                terrainLayers.push_back( map->getLayerAt<ElevationLayer>( elevationLayerIndex ) );
+            else
+                map->getLayers( terrainLayers );
+
+            for (unsigned int i = 0; i < terrainLayers.size(); ++i)
+            {
+                if ( terrainLayers[i].valid() && !est.probe( terrainLayers[i].get() ) )
+                {
+                    std::cout << "Layer " << terrainLayers[i]->getName() << " produced no tiles to probe" << std::endl;
+                }
+            }
+
+            for (unsigned int i = 0; i < est.getProbes().size(); ++i)
+            {
+                const CacheEstimator::LayerProbe& p = est.getProbes()[i];
+                std::cout << "Layer " << p._layerName << ": "
+                    << p._numValid << "/" << p._numSamples << " tiles with data, "
+                    << osgEarth::prettyPrintTime( p._secondsPerTile ) << " and "
+                    << osgEarth::prettyPrintSize( p._sizeInMBPerTile ) << " per tile" << std::endl;
+            }
+        }
+
         unsigned int numTiles = est.getNumTiles();
         double size = est.getSizeInMB();
         double time = est.getTotalTimeInSeconds();
@@ -221,6 +292,14 @@ seed( osg::ArgumentParser& args )
             << "Size on disk:          " << osgEarth::prettyPrintSize( size ) << std::endl
             << "Total time:            " << osgEarth::prettyPrintTime( time ) << std::endl;
 
+        if ( !planFile.empty() )
+        {
+            TaskList tasks( mapNode->getMap()->getProfile() );
+            est.getSeedPlan( tasks.getKeys(), timeBudget );
+            tasks.save( planFile );
+            std::cout << "Seed plan:             " << tasks.getKeys().size() << " tiles written to " << planFile << std::endl;
+        }
+
         return 0;
     }
     
@@ -299,6 +378,28 @@ seed( osg::ArgumentParser& args )
     if ( maxLevel >= 0 )
         visitor->setMaxLevel( maxLevel );        
 
+    unsigned int partitionIndex = 0, partitionCount = 1;
+    if (args.read("--partition", partitionIndex, partitionCount))
+        visitor->setPartition( partitionIndex, partitionCount );
+
+    unsigned int partitionLevel = 0;
+    if (args.read("--partition-level", partitionLevel))
+        visitor->setPartitionLevel( partitionLevel );
+
+    std::string workQueue;
+    if (args.read("--work-queue", workQueue))
+        visitor->setWorkQueuePath( workQueue );
+
+    std::string runID;
+    if (args.read("--run-id", runID))
+        visitor->setRunID( runID );
+
+
+    for (unsigned int i = 0; i < priorityBounds.size(); i++)
+    {
+        GeoExtent extent(mapNode->getMapSRS(), priorityBounds[i]);
+        visitor->addExtent( extent );
+    }    
 
     for (unsigned int i = 0; i < bounds.size(); i++)
     {
@@ -311,6 +412,8 @@ seed( osg::ArgumentParser& args )
     // Initialize the seeder
     CacheSeed seeder;
     seeder.setVisitor(visitor.get());
+    seeder.setCheckpointPath(checkpointPath);
+    seeder.setCompressImages(compress);
 
     osgEarth::Map* map = mapNode->getMap();
 
@@ -326,7 +429,7 @@ seed( osg::ArgumentParser& args )
             osg::Timer_t end = osg::Timer::instance()->tick();
             if (verbose)
             {
-                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
+                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << " (" << visitor->getThroughput() << " tiles/s, " << visitor->getNumSkipped() << " skipped)" << std::endl;
             }    
         }
         else
@@ -348,7 +451,7 @@ seed( osg::ArgumentParser& args )
             osg::Timer_t end = osg::Timer::instance()->tick();
             if (verbose)
             {
-                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
+                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << " (" << visitor->getThroughput() << " tiles/s, " << visitor->getNumSkipped() << " skipped)" << std::endl;
             }    
         }
         else
@@ -373,7 +476,7 @@ seed( osg::ArgumentParser& args )
             osg::Timer_t end = osg::Timer::instance()->tick();
             if (verbose)
             {
-                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << std::endl;
+                OE_NOTICE << "Completed seeding layer " << layer->getName() << " in " << prettyPrintTime( osg::Timer::instance()->delta_s( start, end ) ) << " (" << visitor->getThroughput() << " tiles/s, " << visitor->getNumSkipped() << " skipped)" << std::endl;
             }                
         }
 
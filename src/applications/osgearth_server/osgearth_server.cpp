@@ -25,11 +25,18 @@
 #include <osgEarth/Notify>
 #include <osgEarth/Registry>
 #include <osgEarth/TerrainEngineNode>
+#include <osgEarth/Containers>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
 #include <osgEarthUtil/ExampleResources>
+#include <osgEarthUtil/VectorTileGenerator>
+#include <osgEarthFeatures/FeatureSourceLayer>
 #include <osgDB/ReaderWriter>
 #include <osgDB/ReadFile>
 #include <osgDB/Registry>
 #include <osgDB/FileNameUtils>
+#include <OpenThreads/Condition>
+#include <osg/Timer>
 
 #include <Poco/Net/HTTPServer.h>
 #include <Poco/Net/HTTPRequestHandler.h>
@@ -49,6 +56,9 @@
 #include <Poco/Util/OptionSet.h>
 #include <Poco/Util/HelpFormatter.h>
 #include <iostream>
+#include <sstream>
+#include <float.h>
+#include <math.h>
 
 using Poco::Net::ServerSocket;
 using Poco::Net::HTTPRequestHandler;
@@ -296,6 +306,15 @@ usage(const char* name)
 {
     OE_NOTICE 
         << "\nUsage: " << name << " file.earth" << std::endl
+        << "    --port port          : port to listen on (default 8000)" << std::endl
+        << "    --workers n          : number of tile renderers, each with its own copy of the map (default 1)" << std::endl
+        << "    --threads n          : number of HTTP connection threads (default 32)" << std::endl
+        << "    --cache-tiles n      : number of encoded tiles to keep in memory (default 4096)" << std::endl
+        << "    --max-age seconds    : Cache-Control max-age for served tiles (default 3600)" << std::endl
+        << "    --features name      : serve the features of this FeatureSourceLayer as vector tiles" << std::endl
+        << "    --simplify tolerance : vector tile simplification tolerance, in 1/4096ths of a tile (default 1)" << std::endl
+        << "\nServes tiles at /z/x/y.png (or .jpg), vector tiles at /z/x/y.mvt (or .pbf, .json)" << std::endl
+        << "and request metrics at /metrics." << std::endl
         << MapNodeHelper().usage() << std::endl;
 
     return 0;
@@ -461,60 +480,352 @@ public:
 };
 
 
-static TileImageServer* _server;
+/**
+ * Pool of tile renderers. Each renderer has its own graphics context and its
+ * own copy of the map, so tiles render in parallel up to the pool size.
+ */
+class TileRendererPool
+{
+public:
+    ~TileRendererPool()
+    {
+        for (unsigned i = 0; i < _all.size(); ++i)
+            delete _all[i];
+    }
+
+    void add(TileImageServer* renderer)
+    {
+        OpenThreads::ScopedLock< OpenThreads::Mutex > lk(_mutex);
+        _all.push_back(renderer);
+        _free.push_back(renderer);
+        _available.signal();
+    }
+
+    // Blocks until a renderer is free.
+    TileImageServer* acquire()
+    {
+        OpenThreads::ScopedLock< OpenThreads::Mutex > lk(_mutex);
+        while (_free.empty())
+            _available.wait(&_mutex);
+        TileImageServer* renderer = _free.back();
+        _free.pop_back();
+        return renderer;
+    }
+
+    void release(TileImageServer* renderer)
+    {
+        OpenThreads::ScopedLock< OpenThreads::Mutex > lk(_mutex);
+        _free.push_back(renderer);
+        _available.signal();
+    }
+
+    unsigned size() const { return _all.size(); }
+
+private:
+    std::vector< TileImageServer* > _all;
+    std::vector< TileImageServer* > _free;
+    OpenThreads::Mutex              _mutex;
+    OpenThreads::Condition          _available;
+};
+
+/**
+ * A tile encoded and ready to send.
+ */
+struct EncodedTile : public osg::Referenced
+{
+    EncodedTile() : _ok(false), _failed(false) { }
+
+    std::string _data;
+    std::string _mimeType;
+    std::string _etag;
+    bool        _ok;
+    bool        _failed;  // the tile exists but could not be rendered or encoded
+};
+
+static bool isVectorFormat(const std::string& ext)
+{
+    return ext == "mvt" || ext == "pbf" || ext == "json" || ext == "geojson";
+}
+
+/**
+ * Hands out encoded tiles. Recently served tiles come from an in-memory
+ * cache; concurrent requests for a tile that is not cached share a single
+ * render instead of each rendering it.
+ */
+class TileService
+{
+public:
+    TileService(TileRendererPool* pool, const Profile* profile, unsigned cacheSize) :
+      _pool(pool),
+      _profile(profile),
+      _vectors(0L),
+      _cache(true, cacheSize)
+    {
+    }
+
+    // Serves vector tile requests (.mvt, .pbf, .json) from a feature source.
+    void setVectorTileGenerator(VectorTileGenerator* vectors)
+    {
+        _vectors = vectors;
+    }
+
+    osg::ref_ptr< EncodedTile > getTile(unsigned z, unsigned x, unsigned y, const std::string& ext, bool& cacheHit, bool& coalesced)
+    {
+        cacheHit = coalesced = false;
+
+        unsigned cols=0, rows=0;
+        _profile->getNumTiles( z, cols, rows );
+        if (x >= cols || y >= rows)
+            return new EncodedTile();
+
+        std::string key = Stringify() << z << "/" << x << "/" << y << "." << ext;
+
+        TileCache::Record record;
+        if (_cache.get(key, record))
+        {
+            cacheHit = true;
+            return record.value();
+        }
+
+        osg::ref_ptr< EncodedTile > tile;
+        TileFlights::Scope flight(_inFlight, key, tile);
+        if (!flight.isLeader())
+        {
+            coalesced = true;
+            return tile.valid() ? tile.get() : new EncodedTile();
+        }
+
+        tile = new EncodedTile();
+        if (isVectorFormat(ext))
+        {
+            compile(z, x, rows - y - 1, ext, *tile);
+        }
+        else
+        {
+            TileImageServer* renderer = _pool->acquire();
+            osg::ref_ptr< osg::Image > image = renderer->getTile(z, x, y);
+            _pool->release(renderer);
+
+            encode(image.get(), ext, *tile);
+            tile->_failed = !tile->_ok;
+        }
+
+        // cache before the flight lands, so later requests never miss both.
+        if (tile->_ok)
+            _cache.insert(key, tile);
+
+        return tile;
+    }
+
+private:
+    void compile(unsigned z, unsigned x, unsigned y, const std::string& ext, EncodedTile& tile)
+    {
+        if (!_vectors)
+            return;
+
+        if (_vectors->getTile(TileKey(z, x, y, _profile.get()), ext, tile._data))
+        {
+            tile._mimeType = (ext == "json" || ext == "geojson") ? "application/json" : "application/vnd.mapbox-vector-tile";
+            tile._etag = Stringify() << "\"" << hashToString(tile._data) << "-" << tile._data.size() << "\"";
+            tile._ok = true;
+        }
+    }
+
+    void encode(osg::Image* image, const std::string& ext, EncodedTile& tile)
+    {
+        osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(ext);
+        if (!image || !rw)
+            return;
+
+        std::stringstream buf;
+        if (!rw->writeImage(*image, buf).success())
+            return;
+
+        tile._data = buf.str();
+        tile._mimeType = (ext == "jpeg" || ext == "jpg") ? "image/jpeg" : "image/png";
+        tile._etag = Stringify() << "\"" << hashToString(tile._data) << "-" << tile._data.size() << "\"";
+        tile._ok = true;
+    }
+
+    typedef LRUCache< std::string, osg::ref_ptr< EncodedTile > > TileCache;
+    typedef Threading::SingleFlight< std::string, osg::ref_ptr< EncodedTile > > TileFlights;
+
+    TileRendererPool*             _pool;
+    osg::ref_ptr< const Profile > _profile;
+    VectorTileGenerator*          _vectors;
+    TileCache                     _cache;
+    TileFlights                   _inFlight;
+};
+
+/**
+ * Request counts and latency histograms per endpoint.
+ */
+class ServerMetrics
+{
+public:
+    enum { NUM_BUCKETS = 8 };
+
+    void record(const std::string& endpoint, double ms, bool ok, bool cacheHit, bool coalesced)
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        Endpoint& e = _endpoints[endpoint];
+        e._count++;
+        if (!ok) e._errors++;
+        if (cacheHit) e._cacheHits++;
+        if (coalesced) e._coalesced++;
+        e._totalMs += ms;
+        e._maxMs = osg::maximum(e._maxMs, ms);
+
+        unsigned b = 0;
+        while (b < NUM_BUCKETS-1 && ms > bucketLimit(b))
+            ++b;
+        e._buckets[b]++;
+    }
+
+    // Plain-text report, one line per endpoint. Percentiles are the upper
+    // bound of the histogram bucket they fall in.
+    std::string report() const
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        std::stringstream buf;
+        for (std::map< std::string, Endpoint >::const_iterator i = _endpoints.begin(); i != _endpoints.end(); ++i)
+        {
+            const Endpoint& e = i->second;
+            buf << i->first
+                << " count=" << e._count
+                << " errors=" << e._errors
+                << " cache_hits=" << e._cacheHits
+                << " coalesced=" << e._coalesced
+                << " avg_ms=" << (e._count > 0 ? e._totalMs / (double)e._count : 0.0)
+                << " p50_ms=" << percentile(e, 0.50)
+                << " p95_ms=" << percentile(e, 0.95)
+                << " p99_ms=" << percentile(e, 0.99)
+                << " max_ms=" << e._maxMs
+                << std::endl;
+        }
+        return buf.str();
+    }
+
+private:
+    struct Endpoint
+    {
+        Endpoint() : _count(0), _errors(0), _cacheHits(0), _coalesced(0), _totalMs(0.0), _maxMs(0.0)
+        {
+            for (unsigned b = 0; b < NUM_BUCKETS; ++b) _buckets[b] = 0;
+        }
+        unsigned _count, _errors, _cacheHits, _coalesced;
+        double   _totalMs, _maxMs;
+        unsigned _buckets[NUM_BUCKETS];
+    };
+
+    static double bucketLimit(unsigned b)
+    {
+        static const double limits[NUM_BUCKETS] = { 5.0, 10.0, 50.0, 100.0, 250.0, 1000.0, 5000.0, DBL_MAX };
+        return limits[b];
+    }
+
+    static double percentile(const Endpoint& e, double p)
+    {
+        unsigned target = (unsigned)ceil(p * (double)e._count);
+        unsigned total = 0;
+        for (unsigned b = 0; b < NUM_BUCKETS-1; ++b)
+        {
+            total += e._buckets[b];
+            if (total >= target)
+                return bucketLimit(b);
+        }
+        return e._maxMs;
+    }
+
+    std::map< std::string, Endpoint > _endpoints;
+    mutable Threading::Mutex          _mutex;
+};
+
+
+static TileService*   _tiles;
+static ServerMetrics* _metrics;
+static unsigned       _maxAge = 3600u;
 
 class TileRequestHandler: public HTTPRequestHandler
 {
 public:
-    TileRequestHandler()
+    TileRequestHandler(unsigned z, unsigned x, unsigned y, const std::string& ext) :
+      _z(z), _x(x), _y(y), _ext(ext)
     {
     }
 
     void handleRequest(HTTPServerRequest& request,
                        HTTPServerResponse& response)
     {
-        StringTokenizer tok("/");
-        StringVector tized;
-        tok.tokenize(request.getURI(), tized);            
-        if ( tized.size() == 4 )
-        {
-            int z = as<int>(tized[1], 0);
-            int x = as<int>(tized[2], 0);
-            unsigned int y = as<int>(osgDB::getNameLessExtension(tized[3]),0);
-            std::string ext = osgDB::getFileExtension(tized[3]);
+        osg::Timer_t start = osg::Timer::instance()->tick();
 
-            OE_DEBUG << "z=" << z << std::endl;
-            OE_DEBUG << "x=" << x << std::endl;
-            OE_DEBUG << "y=" << y << std::endl;              
-            OE_DEBUG << "ext=" << ext << std::endl;
+        OE_DEBUG << "z=" << _z << " x=" << _x << " y=" << _y << " ext=" << _ext << std::endl;
 
-            response.setChunkedTransferEncoding(true);
+        bool cacheHit = false, coalesced = false;
+        osg::ref_ptr< EncodedTile > tile = _tiles->getTile(_z, _x, _y, _ext, cacheHit, coalesced);
 
-            osg::ref_ptr< osg::Image > image = _server->getTile(z, x, y);
-            
-            if (image)
-            {
-                osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension(ext);
-                if (rw)
-                {
-                    std::string mime = "image/png";
-                    if (ext == "jpeg" || ext == "jpg")
-                    {
-                        mime = "image/jpeg";
-                    }                    
-                    response.setContentType(mime);
-                    std::ostream& ostr = response.send();                 
-                    rw->writeImage(*image.get(), ostr);                    
-                }             
+        if (!tile->_ok)
+        {
+            response.setStatus(tile->_failed ?
+                Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR :
+                Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+            response.setContentLength(0);
+            response.send();
+        }
+        else
+        {
+            response.set("ETag", tile->_etag);
+            response.set("Cache-Control", Stringify() << "public, max-age=" << _maxAge);
 
+            if (request.has("If-None-Match") && request.get("If-None-Match") == tile->_etag)
+            {
+                response.setStatus(Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED);
+                response.setContentLength(0);
+                response.send();
+            }
+            else
+            {
+                // A known length (rather than chunked encoding) lets the
+                // client reuse the connection.
+                response.setContentType(tile->_mimeType);
+                response.setContentLength(tile->_data.size());
+                response.send().write(tile->_data.data(), tile->_data.size());
             }
         }
- 
-        response.setStatus(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);                
+
+        double ms = osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick());
+        _metrics->record("tile." + _ext, ms, tile->_ok, cacheHit, coalesced);
     }
 
 private:
-    std::string _format;
+    unsigned    _z, _x, _y;
+    std::string _ext;
+};
+
+class MetricsRequestHandler: public HTTPRequestHandler
+{
+public:
+    void handleRequest(HTTPServerRequest& request,
+                       HTTPServerResponse& response)
+    {
+        std::string report = _metrics->report();
+        response.setContentType("text/plain");
+        response.setContentLength(report.size());
+        response.send() << report;
+    }
+};
+
+class NotFoundRequestHandler: public HTTPRequestHandler
+{
+public:
+    void handleRequest(HTTPServerRequest& request,
+                       HTTPServerResponse& response)
+    {
+        response.setStatus(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+        response.setContentLength(0);
+        response.send();
+        _metrics->record("other", 0.0, false, false, false);
+    }
 };
 
 class TileRequestHandlerFactory : public HTTPRequestHandlerFactory
@@ -527,33 +838,39 @@ class TileRequestHandlerFactory : public HTTPRequestHandlerFactory
     HTTPRequestHandler* createRequestHandler(
         const HTTPServerRequest& request)
     {        
+        std::string path = request.getURI();
+        std::string::size_type query = path.find('?');
+        if (query != std::string::npos)
+            path = path.substr(0, query);
+
+        if (path == "/metrics")
+        {
+            return new MetricsRequestHandler();
+        }
+
         StringTokenizer tok("/");
         StringVector tized;
-        tok.tokenize(request.getURI(), tized);            
+        tok.tokenize(path, tized);            
         if ( tized.size() == 4 )
         {
-            int z = as<int>(tized[1], 0);
-            int x = as<int>(tized[2], 0);
-            unsigned int y = as<int>(osgDB::getNameLessExtension(tized[3]),0);
+            unsigned z = as<unsigned>(tized[1], 0);
+            unsigned x = as<unsigned>(tized[2], 0);
+            unsigned y = as<unsigned>(osgDB::getNameLessExtension(tized[3]),0);
             std::string ext = osgDB::getFileExtension(tized[3]);
 
-            OE_DEBUG << "z=" << z << std::endl;
-            OE_DEBUG << "x=" << x << std::endl;
-            OE_DEBUG << "y=" << y << std::endl;              
-            OE_DEBUG << "ext=" << ext << std::endl;
-
-            return new TileRequestHandler();
+            return new TileRequestHandler(z, x, y, ext);
         }
 
-        return 0;
+        return new NotFoundRequestHandler();
     }
 };
 
 class TileHTTPServer: public Poco::Util::ServerApplication
 {
 public:
-    TileHTTPServer(int port):
-      _port(port)
+    TileHTTPServer(int port, unsigned numThreads):
+      _port(port),
+      _numThreads(numThreads)
     {
     }
 
@@ -575,8 +892,15 @@ protected:
 
     int main(const std::vector<std::string>& args)
     {
+        HTTPServerParams* params = new HTTPServerParams;
+        params->setMaxThreads(_numThreads);
+        params->setMaxQueued(_numThreads * 4);
+        params->setKeepAlive(true);
+        params->setKeepAliveTimeout(Poco::Timespan(15, 0));
+
+        ThreadPool threads(2, _numThreads);
         ServerSocket svs(_port);
-        HTTPServer srv(new TileRequestHandlerFactory(), svs, new HTTPServerParams);
+        HTTPServer srv(new TileRequestHandlerFactory(), threads, svs, params);
         srv.start();
         waitForTerminationRequest();
         srv.stop();
@@ -584,7 +908,8 @@ protected:
     }
 
 private:
-    int _port;
+    int      _port;
+    unsigned _numThreads;
 };
 
 
@@ -602,6 +927,34 @@ main(int argc, char** argv)
     arguments.read("--port", port);
     OE_NOTICE << "Listening on port " << port << std::endl;
 
+    unsigned numWorkers = 1;
+    arguments.read("--workers", numWorkers);
+
+    unsigned numThreads = 32;
+    arguments.read("--threads", numThreads);
+
+    unsigned cacheSize = 4096;
+    arguments.read("--cache-tiles", cacheSize);
+
+    arguments.read("--max-age", _maxAge);
+
+    std::string featuresName;
+    arguments.read("--features", featuresName);
+
+    double tolerance = 1.0;
+    arguments.read("--simplify", tolerance);
+
+    // Each extra renderer needs its own copy of the map, loaded from the same file.
+    std::string earthFile;
+    for(int pos=1; pos<arguments.argc(); ++pos)
+    {
+        if (!arguments.isOption(pos))
+        {
+            earthFile = arguments[pos];
+            break;
+        }
+    }
+
     // thread-safe initialization of the OSG wrapper manager. Calling this here
     // prevents the "unsupported wrapper" messages from OSG
     osgDB::Registry::instance()->getObjectWrapperManager()->findWrapper("osg::Image");
@@ -611,13 +964,57 @@ main(int argc, char** argv)
     osg::ref_ptr< osg::Node> node = osgDB::readNodeFiles( arguments );
     osg::ref_ptr< MapNode > mapNode = MapNode::findMapNode( node );
 
-    if (mapNode.valid())
+    if (!mapNode.valid())
+    {
+        return usage(argv[0]);
+    }
+
+    OE_NOTICE << "Found map node" << std::endl;
+
+    TileRendererPool renderers;
+    renderers.add( new TileImageServer( mapNode.get() ) );
+
+    for (unsigned i = 1; i < numWorkers; ++i)
     {
-        OE_NOTICE << "Found map node" << std::endl;
+        osg::ref_ptr< osg::Node > copy = earthFile.empty() ? 0L : osgDB::readNodeFile( earthFile );
+        MapNode* copyMapNode = MapNode::findMapNode( copy.get() );
+        if (!copyMapNode)
+        {
+            OE_WARN << "Failed to load another copy of the map; using " << renderers.size() << " worker(s)" << std::endl;
+            break;
+        }
+        renderers.add( new TileImageServer( copyMapNode ) );
+    }
+    OE_NOTICE << "Rendering with " << renderers.size() << " worker(s)" << std::endl;
+
+    _tiles = new TileService( &renderers, mapNode->getMap()->getProfile(), cacheSize );
+    _metrics = new ServerMetrics();
+
+    VectorTileGenerator* vectors = 0L;
+    if (!featuresName.empty())
+    {
+        FeatureSourceLayer* layer = mapNode->getMap()->getLayerByName<FeatureSourceLayer>(featuresName);
+        if (layer && layer->getFeatureSource())
+        {
+            vectors = new VectorTileGenerator( layer->getFeatureSource(), mapNode->getMap()->getProfile() );
+            vectors->setLayerName( featuresName );
+            vectors->setTolerance( tolerance );
+            // tiles are already cached by the service.
+            vectors->setCacheSize( 0 );
+            _tiles->setVectorTileGenerator( vectors );
+            OE_NOTICE << "Serving vector tiles from " << featuresName << std::endl;
+        }
+        else
+        {
+            OE_WARN << "No feature source layer named \"" << featuresName << "\"" << std::endl;
+        }
     }
 
-    _server = new TileImageServer( mapNode.get() );
+    TileHTTPServer app(port, numThreads);
+    int result = app.run(argc, argv);
 
-    TileHTTPServer app(port);
-    return app.run(argc, argv);
+    delete _tiles;
+    delete _metrics;
+    delete vectors;
+    return result;
 }
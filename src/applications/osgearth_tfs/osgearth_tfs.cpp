@@ -24,6 +24,7 @@
 #include <osgEarthDrivers/feature_ogr/OGRFeatureOptions>
 
 #include <osgEarthUtil/TFSPackager>
+#include <osgEarth/Registry>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -57,6 +58,9 @@ usage( const std::string& msg )
         << "    --crop             ; Crops features instead of doing a centroid check.  Features can be added to multiple tiles when cropping is enabled" << std::endl
         << "    --dest-srs         ; The destination SRS string in any format osgEarth can understand (wkt, proj4, epsg).  If none is specified the source data SRS will be used" << std::endl
         << "    --bounds minx miny maxx maxy ; The bounding box to use as Level 0.  Feature extent will be used by default" << std::endl
+        << "    --format           ; The output format of the tiles: json (default) or pbf (Mapbox vector tiles)" << std::endl
+        << "    --simplify         ; Simplification tolerance as a fraction of the tile width (ex. 0.0005).  Default is no simplification" << std::endl
+        << "    --threads          ; The number of threads used to write tiles (default 4)" << std::endl
         << std::endl;
 
     return -1;
@@ -111,6 +115,19 @@ int main(int argc, char** argv)
     std::string destSRS;
     while(arguments.read("--dest-srs", destSRS));
 
+    std::string format = "json";
+    while (arguments.read("--format", format));
+    if (format != "json" && format != "pbf")
+    {
+        return usage( "Format must be json or pbf" );
+    }
+
+    double simplification = 0.0;
+    while (arguments.read("--simplify", simplification));
+
+    unsigned int numThreads = 4;
+    while (arguments.read("--threads", numThreads));
+
     std::string grid;
     float gridSizeMeters = -1.0f;
     while (arguments.read("--grid", grid));
@@ -224,6 +241,9 @@ int main(int argc, char** argv)
         << "  OrderBy=" << queryOrderBy << std::endl
         << "  Method= " << method << std::endl
         << "  DestSRS= " << destSRS << std::endl
+        << "  Format= " << format << std::endl
+        << "  Simplify= " << simplification << std::endl
+        << "  Threads= " << numThreads << std::endl
         << std::endl;
 
     //buildTFS( features.get(), firstLevel, maxLevel, maxFeatures, destination, layer, description, query, cropMethod);
@@ -235,6 +255,13 @@ int main(int argc, char** argv)
     packager.setMethod( cropMethod );    
     packager.setDestSRS( destSRS );
     packager.setLod0Extent(ext);
+    packager.setFormat( format );
+    packager.setSimplification( simplification );
+    packager.setNumThreads( numThreads );
+
+    // tiles are written on the registry's shared pool; size it to match.
+    if ( numThreads > 0 )
+        Registry::instance()->getTaskServiceManager()->setNumThreads( numThreads );
 
     packager.package( features, destination, layer, description );
     osg::Timer_t endTime = osg::Timer::instance()->tick();
@@ -27,6 +27,7 @@
 
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <stdio.h>
 
 #include <osgEarth/Progress>
 #include <osgEarthUtil/TileIndexBuilder>
@@ -46,6 +47,15 @@ int main(int argc, char** argv)
 
     OE_NOTICE << "index name = " << indexFilename << std::endl;
 
+    unsigned int numThreads = 4;
+    while (arguments.read("--threads", numThreads));
+
+    // remembers file extents between runs, so a rebuild only opens new or changed files
+    std::string scanCache;
+    while (arguments.read("--scan-cache", scanCache));
+
+    bool overwrite = arguments.read("--overwrite");
+
     std::vector< std::string > filenames;
 
     //The rest of the arguments are filenames
@@ -66,14 +76,26 @@ int main(int argc, char** argv)
     // Open or create the index file
     if (osgDB::fileExists( indexFilename ) )
     {
-        OE_NOTICE << indexFilename << " exists, cannot update existing index" << std::endl;
-        return 1;
+        if (!overwrite)
+        {
+            OE_NOTICE << indexFilename << " exists, cannot update existing index (use --overwrite to rebuild it)" << std::endl;
+            return 1;
+        }
+
+        const char* parts[] = { "shp", "shx", "dbf", "prj" };
+        std::string base = osgDB::getNameLessExtension( indexFilename );
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            ::remove( (base + "." + parts[i]).c_str() );
+        }
     }
 
     osg::Timer_t start = osg::Timer::instance()->tick();
 
     TileIndexBuilder builder;
     builder.setProgressCallback( new ConsoleProgressCallback() );
+    builder.setNumThreads( numThreads );
+    builder.setScanCache( scanCache );
     for (unsigned int i = 0; i < filenames.size(); i++)
     {
         builder.getFilenames().push_back( filenames[i] );
@@ -85,6 +85,52 @@ CacheSettings::store(osgDB::Options* readOptions)
     }
 }
  
+#define METADATA_CACHESETTINGS_UDC_NAME "osgEarth.MetadataCacheSettings"
+
+void
+CacheSettings::storeForMetadata(osgDB::Options* readOptions)
+{
+    if (readOptions)
+    {
+        setName(METADATA_CACHESETTINGS_UDC_NAME);
+        osg::UserDataContainer* udc = readOptions->getOrCreateUserDataContainer();
+        unsigned index = udc->getUserObjectIndex(METADATA_CACHESETTINGS_UDC_NAME);
+        udc->removeUserObject(index);
+        udc->addUserObject(this);
+    }
+}
+
+CacheSettings*
+CacheSettings::getForMetadata(const osgDB::Options* readOptions)
+{
+    CacheSettings* obj = 0L;
+    if (readOptions)
+    {
+        const osg::UserDataContainer* udc = readOptions->getUserDataContainer();
+        if (udc) {
+            osg::Object* temp = const_cast<osg::Object*>(udc->getUserObject(METADATA_CACHESETTINGS_UDC_NAME));
+            obj = dynamic_cast<CacheSettings*>(temp);
+        }
+    }
+    return obj;
+}
+
+osgDB::Options*
+CacheSettings::createMetadataReadOptions(const osgDB::Options* readOptions)
+{
+    osgDB::Options* output = Registry::cloneOrCreateOptions(readOptions);
+
+    CacheSettings* meta = getForMetadata(readOptions);
+    if (meta && meta->isCacheEnabled())
+    {
+        CacheSettings* settings = new CacheSettings(*meta);
+        settings->setName(CACHESETTINGS_UDC_NAME);
+        settings->store(output);
+    }
+
+    return output;
+}
+
 CacheSettings*
 CacheSettings::get(const osgDB::Options* readOptions)
 {
@@ -144,10 +190,66 @@ Cache::removeBin( CacheBin* bin )
 
 //------------------------------------------------------------------------
 
+// Size-limit eviction trims the cache to this fraction of its maximum size.
+#define LOW_WATER_MARK 0.9
+
+off_t
+CacheMaintenanceThread::getEvictionTarget(off_t maxBytes)
+{
+    return (off_t)(LOW_WATER_MARK * (double)maxBytes);
+}
+
+CacheMaintenanceThread::CacheMaintenanceThread(unsigned periodSeconds) :
+_periodSeconds( osg::maximum(periodSeconds, 1u) ),
+_done         ( false ),
+_lastAccesses ( 0u )
+{
+    //nop
+}
+
+CacheMaintenanceThread::~CacheMaintenanceThread()
+{
+    stop();
+}
+
+void
+CacheMaintenanceThread::stop()
+{
+    if ( !_done )
+    {
+        _done = true;
+        _wake.set();
+        if ( isRunning() )
+            join();
+    }
+}
+
+void
+CacheMaintenanceThread::run()
+{
+    while ( !_done )
+    {
+        _wake.wait( _periodSeconds * 1000u );
+        _wake.reset();
+        if ( _done )
+            break;
+
+        unsigned accesses = getNumAccesses();
+        bool idle = (accesses - _lastAccesses) < _periodSeconds;
+        _lastAccesses = accesses;
+
+        runMaintenance( idle );
+    }
+}
+
+//------------------------------------------------------------------------
+
 #undef  LC
 #define LC "[CacheFactory] "
 #define CACHE_OPTIONS_TAG "__osgEarth::CacheOptions"
 
+//------------------------------------------------------------------------
+
 Cache*
 CacheFactory::create( const CacheOptions& options )
 {
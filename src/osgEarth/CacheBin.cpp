@@ -29,6 +29,7 @@
 #include <osg/Texture>
 #include <osg/Image>
 #include <osg/TextureBuffer>
+#include <sstream>
 
 using namespace osgEarth;
 
@@ -320,6 +321,82 @@ CacheBin::writeNode(const std::string&    key,
     return true;
 }
 
+bool
+CacheBin::writeBatch(const BatchRecords&   records,
+                     const osgDB::Options* writeOptions)
+{
+    bool allOK = true;
+    for(BatchRecords::const_iterator i = records.begin(); i != records.end(); ++i)
+    {
+        if ( !i->_object.valid() || !write(i->_key, i->_object.get(), i->_meta, writeOptions) )
+            allOK = false;
+    }
+    return allOK;
+}
+
+void
+CacheBin::readBatch(const std::vector<std::string>& keys,
+                    std::vector<ReadResult>&        results,
+                    const osgDB::Options*           readOptions)
+{
+    results.clear();
+    results.reserve( keys.size() );
+    for(std::vector<std::string>::const_iterator i = keys.begin(); i != keys.end(); ++i)
+    {
+        results.push_back( readObject(*i, readOptions) );
+    }
+}
+
+namespace
+{
+    // What an options structure holds, as far as osgDB::Options exposes it,
+    // so a derived copy can tell when its input was changed in place.
+    std::string getOptionsContentKey(const osgDB::Options* options)
+    {
+        std::stringstream buf;
+        buf << options->getOptionString() << '\n';
+        const osgDB::FilePathList& paths = options->getDatabasePathList();
+        for(osgDB::FilePathList::const_iterator i = paths.begin(); i != paths.end(); ++i)
+            buf << *i << '\n';
+        buf << (int)options->getObjectCacheHint() << ' '
+            << (int)options->getBuildKdTreesHint() << ' '
+            << (int)options->getPrecisionHint() << ' '
+            << (const void*)options->getAuthenticationMap() << ' '
+            << (const void*)options->getReadFileCallback() << ' '
+            << (const void*)options->getWriteFileCallback() << ' '
+            << (const void*)options->getFileLocationCallback() << ' '
+            << (const void*)options->getFileCache() << ' '
+            << options->getNumPluginData() << ' '
+            << options->getNumPluginStringData();
+        return buf.str();
+    }
+}
+
+osg::ref_ptr<const osgDB::Options>
+CacheBin::getOptionsWithPluginStringData(const osgDB::Options* options,
+                                         const std::string&    name,
+                                         const std::string&    value)
+{
+    std::string key = name + '\n' + value;
+    if ( options )
+        key += '\n' + getOptionsContentKey(options);
+
+    Threading::ScopedMutexLock lock(_derivedMutex);
+
+    // the observer catches an input that was freed and its address reused;
+    // the key catches one that was changed.
+    if ( _derived.valid() && _derivedSource.get() == options && _derivedKey == key )
+        return _derived;
+
+    osg::ref_ptr<osgDB::Options> derived = Registry::cloneOrCreateOptions(options);
+    derived->setPluginStringData(name, value);
+
+    _derivedSource = options;
+    _derivedKey    = key;
+    _derived       = derived.get();
+    return _derived;
+}
+
 
 #undef  LC
 #define LC "[ReadImageFromCachePseudoLoader] "
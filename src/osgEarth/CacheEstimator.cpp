@@ -19,13 +19,53 @@
 #include <osgEarth/CacheEstimator>
 #include <osgEarth/Registry>
 #include <osgEarth/TileKey>
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/Cache>
+#include <osgEarth/Random>
+#include <osg/Timer>
+#include <algorithm>
+#include <functional>
+#include <limits.h>
+#include <set>
 
 using namespace osgEarth;
 
+namespace
+{
+    // Range of tiles at a level that intersect an extent, or of all the
+    // tiles at that level if the extent is invalid.
+    bool getTileRange(const Profile* profile, const GeoExtent& extent, unsigned level,
+                      unsigned& xmin, unsigned& ymin, unsigned& xmax, unsigned& ymax)
+    {
+        if ( !extent.isValid() )
+        {
+            unsigned wide, high;
+            profile->getNumTiles( level, wide, high );
+            xmin = ymin = 0;
+            xmax = wide - 1;
+            ymax = high - 1;
+            return wide > 0 && high > 0;
+        }
+
+        TileKey ll = profile->createTileKey(extent.xMin(), extent.yMin(), level);
+        TileKey ur = profile->createTileKey(extent.xMax(), extent.yMax(), level);
+        if ( !ll.valid() || !ur.valid() )
+            return false;
+
+        xmin = ll.getTileX();
+        xmax = ur.getTileX();
+        ymin = ur.getTileY();
+        ymax = ll.getTileY();
+        return xmin <= xmax && ymin <= ymax;
+    }
+}
+
 CacheEstimator::CacheEstimator():
 _minLevel (0),
 _maxLevel (12),
-_profile( osgEarth::Registry::instance()->getGlobalGeodeticProfile() )
+_profile( osgEarth::Registry::instance()->getGlobalGeodeticProfile() ),
+_numThreads(1)
 {    
     // By default we can give them a somewhat worse case estimate since it's going to be next to impossible to know what the real size of the data is going to be due to the fact that it's 
     // dependant on the dataset itself as well as compression.  So lets just default to about 130 kb per tile to start with.
@@ -39,8 +79,15 @@ _profile( osgEarth::Registry::instance()->getGlobalGeodeticProfile() )
 
 void
 CacheEstimator::addExtent( const GeoExtent& value)
+{
+    addExtent( value, 0 );
+}
+
+void
+CacheEstimator::addExtent( const GeoExtent& value, int priority )
 {
     _extents.push_back( value );
+    _priorities.push_back( priority );
 }
 
 unsigned int
@@ -87,7 +134,171 @@ double CacheEstimator::getSizeInMB() const
 
 double CacheEstimator::getTotalTimeInSeconds() const
 {
-    return getNumTiles() * _timeInSecondsPerTile;
+    return getNumTiles() * _timeInSecondsPerTile / (double)_numThreads;
+}
+
+bool
+CacheEstimator::probe( TerrainLayer* layer, unsigned numSamples )
+{
+    ImageLayer*     imageLayer     = dynamic_cast<ImageLayer*>( layer );
+    ElevationLayer* elevationLayer = dynamic_cast<ElevationLayer*>( layer );
+    if ( (!imageLayer && !elevationLayer) || numSamples == 0 || _maxLevel < _minLevel )
+        return false;
+
+    std::vector<GeoExtent> regions( _extents );
+    if ( regions.empty() )
+        regions.push_back( GeoExtent::INVALID );
+
+    // Count the tiles on each level so the samples can be spread in
+    // proportion; the deepest levels hold most of the tiles and dominate
+    // the total.
+    std::vector<double> counts;
+    double total = 0.0;
+    for (unsigned level = _minLevel; level <= _maxLevel; ++level)
+    {
+        double count = 0.0;
+        for (unsigned r = 0; r < regions.size(); ++r)
+        {
+            unsigned x0, y0, x1, y1;
+            if ( getTileRange(_profile.get(), regions[r], level, x0, y0, x1, y1) )
+                count += (double)(x1 - x0 + 1) * (double)(y1 - y0 + 1);
+        }
+        counts.push_back( count );
+        total += count;
+    }
+    if ( total <= 0.0 )
+        return false;
+
+    // Time the source, not the cache.
+    CacheSettings* cacheSettings = layer->getCacheSettings();
+    optional<CachePolicy> oldPolicy;
+    if ( cacheSettings )
+    {
+        oldPolicy = cacheSettings->cachePolicy();
+        cacheSettings->cachePolicy() = CachePolicy::NO_CACHE;
+    }
+
+    Random prng( 0u );
+    LayerProbe result;
+    result._layerName  = layer->getName();
+    result._numSamples = 0;
+    result._numValid   = 0;
+    double seconds = 0.0, bytes = 0.0;
+
+    for (unsigned i = 0; i < numSamples; ++i)
+    {
+        // Level holding the (i+0.5)/numSamples quantile of all the tiles
+        double target = total * ((double)i + 0.5) / (double)numSamples;
+        unsigned li = 0;
+        double cumulative = counts[0];
+        while ( cumulative < target && li + 1 < counts.size() )
+            cumulative += counts[++li];
+        unsigned level = _minLevel + li;
+
+        unsigned x0, y0, x1, y1;
+        if ( !getTileRange(_profile.get(), regions[i % regions.size()], level, x0, y0, x1, y1) )
+            continue;
+
+        TileKey key( level, x0 + prng.next(x1 - x0 + 1), y0 + prng.next(y1 - y0 + 1), _profile.get() );
+
+        double tileBytes = 0.0;
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        if ( imageLayer )
+        {
+            GeoImage image = imageLayer->createImage( key );
+            if ( image.valid() )
+                tileBytes = image.getImage()->getTotalSizeInBytesIncludingMipmaps();
+        }
+        else
+        {
+            GeoHeightField hf = elevationLayer->createHeightField( key, 0L );
+            if ( hf.valid() )
+                tileBytes = (double)hf.getHeightField()->getNumRows() * (double)hf.getHeightField()->getNumColumns() * sizeof(float);
+        }
+        seconds += osg::Timer::instance()->delta_s( start, osg::Timer::instance()->tick() );
+
+        ++result._numSamples;
+        if ( tileBytes > 0.0 )
+        {
+            ++result._numValid;
+            bytes += tileBytes;
+        }
+    }
+
+    if ( cacheSettings )
+    {
+        cacheSettings->cachePolicy() = oldPolicy;
+    }
+
+    if ( result._numValid == 0 )
+        return false;
+
+    // Tiles without data cost time but no storage, so average both over
+    // every tile sampled.
+    result._secondsPerTile  = seconds / (double)result._numSamples;
+    result._sizeInMBPerTile = bytes / (double)result._numSamples / 1048576.0;
+
+    if ( _probes.empty() )
+    {
+        _timeInSecondsPerTile = 0.0;
+        _sizeInMBPerTile = 0.0;
+    }
+    _probes.push_back( result );
+    _timeInSecondsPerTile += result._secondsPerTile;
+    _sizeInMBPerTile += result._sizeInMBPerTile;
+
+    return true;
+}
+
+void
+CacheEstimator::getSeedPlan( std::vector<TileKey>& out, double maxSeconds ) const
+{
+    double secondsPerTile = _timeInSecondsPerTile / (double)_numThreads;
+    unsigned maxTiles = UINT_MAX;
+    if ( maxSeconds > 0.0 && secondsPerTile > 0.0 )
+        maxTiles = (unsigned)std::min( maxSeconds / secondsPerTile, (double)UINT_MAX );
+
+    std::vector<GeoExtent> regions( _extents );
+    std::vector<int> priorities( _priorities );
+    if ( regions.empty() )
+    {
+        regions.push_back( GeoExtent::INVALID );
+        priorities.push_back( 0 );
+    }
+
+    std::set< int, std::greater<int> > tiers( priorities.begin(), priorities.end() );
+
+    std::set<unsigned long long> planned;
+
+    for (std::set< int, std::greater<int> >::const_iterator tier = tiers.begin(); tier != tiers.end(); ++tier)
+    {
+        for (unsigned level = _minLevel; level <= _maxLevel; ++level)
+        {
+            for (unsigned r = 0; r < regions.size(); ++r)
+            {
+                if ( priorities[r] != *tier )
+                    continue;
+
+                unsigned x0, y0, x1, y1;
+                if ( !getTileRange(_profile.get(), regions[r], level, x0, y0, x1, y1) )
+                    continue;
+
+                for (unsigned y = y0; y <= y1; ++y)
+                {
+                    for (unsigned x = x0; x <= x1; ++x)
+                    {
+                        TileKey key( level, x, y, _profile.get() );
+                        if ( planned.insert(key.getPackedKey()).second )
+                        {
+                            out.push_back( key );
+                            if ( out.size() >= maxTiles )
+                                return;
+                        }
+                    }
+                }
+            }
+        }
+    }
 }
 
 
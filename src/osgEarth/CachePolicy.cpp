@@ -34,7 +34,8 @@ CachePolicy CachePolicy::CACHE_ONLY( CachePolicy::USAGE_CACHE_ONLY );
 CachePolicy::CachePolicy() :
 _usage  ( USAGE_READ_WRITE ),
 _maxAge ( INT_MAX ),
-_minTime( 0 )
+_minTime( 0 ),
+_httpExpiration( false )
 {
     //nop
 }
@@ -42,7 +43,8 @@ _minTime( 0 )
 CachePolicy::CachePolicy( const Usage& usage ) :
 _usage  ( usage ),
 _maxAge ( INT_MAX ),
-_minTime( 0 )
+_minTime( 0 ),
+_httpExpiration( false )
 {
     _usage = usage; // explicity set the optional<>
 }
@@ -50,7 +52,8 @@ _minTime( 0 )
 CachePolicy::CachePolicy( const Config& conf ) :
 _usage  ( USAGE_READ_WRITE ),
 _maxAge ( INT_MAX ),
-_minTime( 0 )
+_minTime( 0 ),
+_httpExpiration( false )
 {
     fromConfig( conf );
 }
@@ -58,7 +61,8 @@ _minTime( 0 )
 CachePolicy::CachePolicy(const CachePolicy& rhs) :
 _usage  ( rhs._usage ),
 _maxAge ( rhs._maxAge ),
-_minTime( rhs._minTime )
+_minTime( rhs._minTime ),
+_httpExpiration( rhs._httpExpiration )
 {
     //nop
 }
@@ -74,6 +78,9 @@ CachePolicy::mergeAndOverride(const CachePolicy& rhs)
 
     if ( rhs.maxAge().isSet() )
         maxAge() = rhs.maxAge().get();
+
+    if ( rhs.httpExpiration().isSet() )
+        httpExpiration() = rhs.httpExpiration().get();
 }
 
 void
@@ -106,7 +113,8 @@ CachePolicy::operator == (const CachePolicy& rhs) const
     return 
         (_usage.get() == rhs._usage.get()) &&
         (_maxAge.get() == rhs._maxAge.get()) &&
-        (_minTime.get() == rhs._minTime.get());
+        (_minTime.get() == rhs._minTime.get()) &&
+        (_httpExpiration.get() == rhs._httpExpiration.get());
 }
 
 CachePolicy&
@@ -115,6 +123,7 @@ CachePolicy::operator = ( const CachePolicy& rhs )
     _usage  = optional<Usage>(rhs._usage);
     _maxAge = optional<TimeSpan>(rhs._maxAge);
     _minTime = optional<TimeStamp>(rhs._minTime);
+    _httpExpiration = optional<bool>(rhs._httpExpiration);
 
     return *this;
 }
@@ -132,7 +141,7 @@ CachePolicy::usageString() const
 bool
 CachePolicy::empty() const
 {
-    bool isSet = _usage.isSet() || _maxAge.isSet() || _minTime.isSet();
+    bool isSet = _usage.isSet() || _maxAge.isSet() || _minTime.isSet() || _httpExpiration.isSet();
     return !isSet;
 }
 
@@ -146,6 +155,7 @@ CachePolicy::fromConfig( const Config& conf )
     conf.getIfSet( "usage", "none",         _usage, USAGE_NO_CACHE );
     conf.getIfSet( "max_age", _maxAge );
     conf.getIfSet( "min_time", _minTime );
+    conf.getIfSet( "http_expiration", _httpExpiration );
 }
 
 Config
@@ -158,5 +168,6 @@ CachePolicy::getConfig() const
     conf.addIfSet( "usage", "no_cache",     _usage, USAGE_NO_CACHE );
     conf.addIfSet( "max_age", _maxAge );
     conf.addIfSet( "min_time", _minTime );
+    conf.addIfSet( "http_expiration", _httpExpiration );
     return conf;
 }
@@ -26,6 +26,10 @@
 #include <osgEarth/Map>
 #include <osgEarth/ImageLayer>
 #include <osgEarth/ElevationLayer>
+#include <osgEarth/Cache>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/StringUtils>
+#include <osgDB/FileNameUtils>
 #include <OpenThreads/ScopedLock>
 #include <limits.h>
 
@@ -34,6 +38,162 @@
 using namespace osgEarth;
 using namespace OpenThreads;
 
+namespace
+{
+    /**
+     * CacheBin that collects writes and hands them to the wrapped bin in
+     * batches via CacheBin::writeBatch. Records waiting in the batch are
+     * still visible to reads through this bin. Each record is a private
+     * copy, since the caller is free to change or reuse its object once
+     * write() returns.
+     */
+    class BatchingCacheBin : public CacheBin
+    {
+    public:
+        BatchingCacheBin(CacheBin* bin, unsigned batchSize) :
+            CacheBin  ( bin->getID() ),
+            _bin      ( bin ),
+            _batchSize( batchSize )
+        {
+            setHashKeys( bin->getHashKeys() );
+        }
+
+        /** Commits all pending records to the wrapped bin. */
+        void flush(const osgDB::Options* dbo =0L)
+        {
+            BatchRecords records;
+            osg::ref_ptr<const osgDB::Options> lastDBO;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                takePending( records );
+                lastDBO = _dbo.get();
+            }
+            if ( !records.empty() )
+                _bin->writeBatch( records, dbo ? dbo : lastDBO.get() );
+        }
+
+    public: // CacheBin
+
+        ReadResult readObject(const std::string& key, const osgDB::Options* dbo)
+        {
+            ReadResult r;
+            return readPending(key, r) ? r : _bin->readObject(key, dbo);
+        }
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* dbo)
+        {
+            ReadResult r;
+            return readPending(key, r) ? r : _bin->readImage(key, dbo);
+        }
+
+        ReadResult readString(const std::string& key, const osgDB::Options* dbo)
+        {
+            ReadResult r;
+            return readPending(key, r) ? r : _bin->readString(key, dbo);
+        }
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo)
+        {
+            if ( !object )
+                return false;
+
+            // copy outside the lock; the write itself may happen much later.
+            osg::ref_ptr<osg::Object> copy = osg::clone( object, osg::CopyOp::DEEP_COPY_ALL );
+            if ( !copy.valid() )
+                return false;
+
+            BatchRecords records;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                _pending[key] = BatchRecord(key, copy.get(), meta);
+                _dbo = dbo;
+                if ( _pending.size() >= _batchSize )
+                    takePending( records );
+            }
+
+            return records.empty() || _bin->writeBatch( records, dbo );
+        }
+
+        RecordStatus getRecordStatus(const std::string& key)
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                if ( _pending.find(key) != _pending.end() )
+                    return STATUS_OK;
+            }
+            return _bin->getRecordStatus(key);
+        }
+
+        bool remove(const std::string& key)
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                _pending.erase(key);
+            }
+            return _bin->remove(key);
+        }
+
+        bool touch(const std::string& key)
+        {
+            flush();
+            return _bin->touch(key);
+        }
+
+        Config readMetadata() { return _bin->readMetadata(); }
+
+        bool writeMetadata(const Config& meta) { return _bin->writeMetadata(meta); }
+
+        bool clear()
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                _pending.clear();
+            }
+            return _bin->clear();
+        }
+
+        bool compact() { flush(); return _bin->compact(); }
+
+        unsigned getStorageSize() { return _bin->getStorageSize(); }
+
+        std::string getHashedKey(const std::string& key) const { return _bin->getHashedKey(key); }
+
+    protected:
+        virtual ~BatchingCacheBin()
+        {
+            flush();
+        }
+
+    private:
+        // assumes _mutex is locked
+        void takePending(BatchRecords& out)
+        {
+            out.reserve( _pending.size() );
+            for(std::map<std::string, BatchRecord>::iterator i = _pending.begin(); i != _pending.end(); ++i)
+                out.push_back( i->second );
+            _pending.clear();
+        }
+
+        bool readPending(const std::string& key, ReadResult& out)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            std::map<std::string, BatchRecord>::iterator i = _pending.find(key);
+            if ( i == _pending.end() )
+                return false;
+
+            // callers own what they read, so hand out a copy.
+            out = ReadResult( osg::clone(i->second._object.get(), osg::CopyOp::DEEP_COPY_ALL), i->second._meta );
+            return true;
+        }
+
+        osg::ref_ptr<CacheBin>             _bin;
+        unsigned                           _batchSize;
+        std::map<std::string, BatchRecord> _pending;
+        osg::ref_ptr<const osgDB::Options> _dbo;      // options of the latest write, for flushes without any
+        Threading::Mutex                   _mutex;
+    };
+}
+
 CacheTileHandler::CacheTileHandler( TerrainLayer* layer, const Map* map ):
 _layer( layer ),
 _map( map )
@@ -78,6 +238,15 @@ bool CacheTileHandler::hasData( const TileKey& key ) const
     return _layer->mayHaveData(key);
 }
 
+void CacheTileHandler::flush()
+{
+    // Commit any tiles still collected in the seeding batch.
+    CacheSettings* cacheSettings = _layer->getCacheSettings();
+    BatchingCacheBin* bin = cacheSettings ? dynamic_cast<BatchingCacheBin*>( cacheSettings->getCacheBin() ) : 0L;
+    if ( bin )
+        bin->flush();
+}
+
 std::string CacheTileHandler::getProcessString() const
 {
     std::stringstream buf;
@@ -105,7 +274,9 @@ std::string CacheTileHandler::getProcessString() const
 /***************************************************************************************/
 
 CacheSeed::CacheSeed():
-_visitor(new TileVisitor())
+_visitor(new TileVisitor()),
+_writeBatchSize(64u),
+_compressImages(false)
 {
 }
 
@@ -121,6 +292,62 @@ void CacheSeed::setVisitor(TileVisitor* visitor)
 
 void CacheSeed::run( TerrainLayer* layer, const Map* map )
 {
+    // Route the layer's cache writes through a batching bin for the duration
+    // of the seed, so database-backed caches commit many tiles per write.
+    CacheSettings* cacheSettings = layer->getCacheSettings();
+    osg::ref_ptr<CacheBin> bin = cacheSettings ? cacheSettings->getCacheBin() : 0L;
+    osg::ref_ptr<BatchingCacheBin> batchingBin;
+    if ( bin.valid() && _writeBatchSize > 1u )
+    {
+        batchingBin = new BatchingCacheBin( bin.get(), _writeBatchSize );
+        cacheSettings->setCacheBin( batchingBin.get() );
+    }
+
+    // Keep one checkpoint, and one set of work queue claims, per layer,
+    // named after its cache bin.
+    std::string name = bin.valid() ? bin->getID() : layer->getName();
+    std::string oldWorkQueueJob = _visitor->getWorkQueueJob();
+    _visitor->setWorkQueueJob( name );
+
+    osg::ref_ptr<TileCheckpoint> oldCheckpoint = _visitor->getCheckpoint();
+    if ( !_checkpointPath.empty() )
+    {
+        _visitor->setCheckpoint( new TileCheckpoint(
+            osgDB::concatPaths( _checkpointPath, toLegalFileName(name) + ".checkpoint" ) ) );
+    }
+
+    // Have the image layer compress tiles on their way into the cache.
+    ImageLayer* imageLayer = dynamic_cast<ImageLayer*>( layer );
+    bool compress = _compressImages && imageLayer && !imageLayer->isCoverage();
+    optional<bool> oldCompressInCache;
+    optional<osg::Texture::InternalFormatMode> oldTextureCompression;
+    if ( compress )
+    {
+        oldCompressInCache = imageLayer->options().compressInCache();
+        oldTextureCompression = imageLayer->options().textureCompression();
+        imageLayer->options().compressInCache() = true;
+        imageLayer->options().textureCompression() = (osg::Texture::InternalFormatMode)(~0 - 1);
+    }
+
     _visitor->setTileHandler( new CacheTileHandler( layer, map ) );
     _visitor->run( map->getProfile() );
+
+    if ( compress )
+    {
+        imageLayer->options().compressInCache() = oldCompressInCache;
+        imageLayer->options().textureCompression() = oldTextureCompression;
+    }
+
+    OE_INFO << LC << "Seeded " << (_visitor->getNumProcessed() - _visitor->getNumSkipped()) << " tiles ("
+        << _visitor->getNumSkipped() << " skipped) in " << prettyPrintTime( _visitor->getElapsedTime() )
+        << ", " << _visitor->getThroughput() << " tiles/s" << std::endl;
+
+    _visitor->setCheckpoint( oldCheckpoint.get() );
+    _visitor->setWorkQueueJob( oldWorkQueueJob );
+
+    if ( batchingBin.valid() )
+    {
+        batchingBin->flush();
+        cacheSettings->setCacheBin( bin.get() );
+    }
 }
\ No newline at end of file
@@ -24,6 +24,7 @@
 #include <osg/GLExtensions>
 #include <osg/GL2Extensions>
 #include <osg/Texture>
+#include <osg/Version>
 #include <osgViewer/Version>
 #include <OpenThreads/Thread>
 
@@ -136,6 +137,7 @@ _supportsS3TC           ( false ),
 _supportsPVRTC          ( false ),
 _supportsARBTC          ( false ),
 _supportsETC            ( false ),
+_supportsETC2           ( false ),
 _supportsRGTC           ( false ),
 _supportsTextureBuffer  ( false ),
 _maxTextureBufferSize   ( 0 )
@@ -384,6 +386,12 @@ _maxTextureBufferSize   ( 0 )
         _supportsETC = osg::isGLExtensionSupported( id, "GL_OES_compressed_ETC1_RGB8_texture" );
         if ( _supportsETC ) OE_INFO_CONTINUE << "ETC1 ";
 
+        // ETC2/EAC is core in GL 4.3 and GLES 3.0
+        _supportsETC2 =
+            osg::isGLExtensionSupported( id, "GL_ARB_ES3_compatibility" ) ||
+            osg::getGLVersionNumber() >= 4.3f;
+        if ( _supportsETC2 ) OE_INFO_CONTINUE << "ETC2 ";
+
         _supportsRGTC = osg::isGLExtensionSupported( id, "GL_EXT_texture_compression_rgtc" );
         if ( _supportsRGTC ) OE_INFO_CONTINUE << "RG";
 
@@ -417,6 +425,12 @@ Capabilities::supportsTextureCompression(const osg::Texture::InternalFormatMode&
         return _supportsETC;
         break;
 
+#if OSG_VERSION_GREATER_OR_EQUAL(3,4,0)
+    case osg::Texture::USE_ETC2_COMPRESSION:
+        return _supportsETC2;
+        break;
+#endif
+
     case osg::Texture::USE_RGTC1_COMPRESSION:
     case osg::Texture::USE_RGTC2_COMPRESSION:
         return _supportsRGTC;
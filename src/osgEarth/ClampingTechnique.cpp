@@ -28,6 +28,7 @@
 #include <osgEarth/Utils>
 #include <osgEarth/Shaders>
 #include <osgEarth/Clamping>
+#include <osgEarth/TerrainEngineNode>
 
 #include <osg/Depth>
 #include <osg/PolygonMode>
@@ -85,6 +86,8 @@ namespace
     // Additional per-view data stored by the clamping technique.
     struct LocalPerViewData : public osg::Referenced
     {
+        LocalPerViewData() : _renderLeafCount(0), _depthValid(false), _terrainDirty(false) { }
+
         osg::ref_ptr<osg::Texture2D> _rttTexture;
         osg::ref_ptr<osg::StateSet>  _groupStateSet;
         osg::ref_ptr<osg::Uniform>   _camViewToDepthClipUniform;
@@ -97,11 +100,62 @@ namespace
 
         unsigned _renderLeafCount;
 
+        // depth map cache; protected by the technique's views mutex.
+        bool         _depthValid;        // _rttTexture holds a reusable depth map
+        bool         _terrainDirty;      // a tile inside the depth map has changed
+        osg::Matrixd _depthViewMatrix;   // matrices the depth map was rendered with
+        osg::Matrixd _depthProjMatrix;
+
 #ifdef DUMP_RTT_IMAGE
         osg::ref_ptr<osg::Image> _rttDebugImage;
 #endif
     };
 
+    // Factor by which the depth map's region is grown beyond the required one,
+    // so that the map can be reused while the camera moves.
+    const double DEPTH_CACHE_MARGIN = 1.25;
+
+    // Resolution loss (as the camera zooms in) past which a cached depth map
+    // is re-rendered, relative to a fresh one.
+    const double DEPTH_CACHE_MAX_COARSENING = 1.5;
+
+    // Whether a depth map rendered with depthView/depthProj covers the region
+    // required by rttView/rttProj at an acceptable resolution. The corners of
+    // the required region are tested at the depth of the terrain surface.
+    bool depthMapCovers(const osg::Matrixd& depthView,
+                        const osg::Matrixd& depthProj,
+                        const osg::Matrixd& rttView,
+                        const osg::Matrixd& rttProj,
+                        double              surfaceDistance)
+    {
+        double l, r, b, t, n, f;
+        double dl, dr, db, dt, dn, df;
+        if ( !rttProj.getOrtho(l, r, b, t, n, f) || !depthProj.getOrtho(dl, dr, db, dt, dn, df) )
+            return false;
+
+        const double minRatio = 1.0 / (DEPTH_CACHE_MARGIN * DEPTH_CACHE_MAX_COARSENING);
+        if ( (r-l) < (dr-dl)*minRatio || (t-b) < (dt-db)*minRatio )
+            return false;
+
+        osg::Matrixd rttViewToDepthClip;
+        rttViewToDepthClip.invert( rttView );
+        rttViewToDepthClip = rttViewToDepthClip * depthView * depthProj;
+
+        const double z = -surfaceDistance;
+        const osg::Vec3d corners[4] = {
+            osg::Vec3d(l, b, z), osg::Vec3d(r, b, z),
+            osg::Vec3d(r, t, z), osg::Vec3d(l, t, z) };
+
+        for(unsigned i=0; i<4; ++i)
+        {
+            osg::Vec3d c = corners[i] * rttViewToDepthClip;
+            if ( fabs(c.x()) > 1.0 || fabs(c.y()) > 1.0 )
+                return false;
+        }
+
+        return true;
+    }
+
 #ifdef DUMP_RTT_IMAGE
     struct DumpTex : public osg::Camera::DrawCallback
     {
@@ -195,7 +249,8 @@ static osgEarthRegisterRenderBinProxy<ClampingRenderBin> s_regbin(OSGEARTH_CLAMP
 
 ClampingTechnique::ClampingTechnique() :
 _textureSize( 1024 ),
-_engine(0L)
+_engine(0L),
+_useDepthCache( true )
 {
     // disable if GLSL is not supported
     _supported = Registry::capabilities().supportsGLSL();
@@ -230,6 +285,19 @@ ClampingTechnique::setUpCamera(OverlayDecorator::TechRTTParams& params)
     LocalPerViewData* local = new LocalPerViewData();
     params._techniqueData = local;
 
+    // track it so terrain changes can invalidate its depth map.
+    {
+        Threading::ScopedMutexLock lock( _viewsMutex );
+        for(ViewList::iterator i = _views.begin(); i != _views.end(); )
+        {
+            if ( i->valid() )
+                ++i;
+            else
+                i = _views.erase( i );
+        }
+        _views.push_back( local );
+    }
+
     // create the projected texture:
     local->_rttTexture = new osg::Texture2D();
     local->_rttTexture->setTextureSize( *_textureSize, *_textureSize );
@@ -405,14 +473,71 @@ ClampingTechnique::cullOverlayGroup(OverlayDecorator::TechRTTParams& params,
 {
     if ( params._rttCamera.valid() && hasData(params) )
     {
-        // update the RTT camera.
-        params._rttCamera->setViewMatrix      ( params._rttViewMatrix );
-        params._rttCamera->setProjectionMatrix( params._rttProjMatrix );
-
         LocalPerViewData& local = *static_cast<LocalPerViewData*>(params._techniqueData.get());
 
-        // create the depth texture (render the terrain to tex)
-        params._rttCamera->accept( *cv );
+        bool renderDepth = true;
+
+        if ( _useDepthCache )
+        {
+            // distance from the RTT camera down to the terrain surface:
+            osg::Matrixd rttViewInverse;
+            rttViewInverse.invert( params._rttViewMatrix );
+            osg::Vec3d rttEye = osg::Vec3d(0,0,0) * rttViewInverse;
+
+            double surfaceDistance = rttEye.z();
+            const Map* map = _engine ? _engine->getMap() : 0L;
+            if ( map && map->isGeocentric() )
+            {
+                const osg::EllipsoidModel* em = map->getProfile()->getSRS()->getEllipsoid();
+                surfaceDistance = rttEye.length() - em->getRadiusEquator();
+            }
+
+            Threading::ScopedMutexLock lock( _viewsMutex );
+
+            if (local._depthValid && 
+                !local._terrainDirty &&
+                depthMapCovers(local._depthViewMatrix, local._depthProjMatrix, params._rttViewMatrix, params._rttProjMatrix, osg::maximum(surfaceDistance, 0.0)))
+            {
+                renderDepth = false;
+            }
+            else
+            {
+                // render a larger region than required, so the map stays
+                // usable for a while as the camera moves.
+                double l, r, b, t, n, f;
+                local._depthViewMatrix = params._rttViewMatrix;
+                if ( params._rttProjMatrix.getOrtho(l, r, b, t, n, f) )
+                {
+                    const double m = DEPTH_CACHE_MARGIN;
+                    local._depthProjMatrix.makeOrtho(l*m, r*m, b*m, t*m, n, f);
+                }
+                else
+                {
+                    local._depthProjMatrix = params._rttProjMatrix;
+                }
+                local._depthValid = true;
+                local._terrainDirty = false;
+            }
+        }
+        else
+        {
+            local._depthViewMatrix = params._rttViewMatrix;
+            local._depthProjMatrix = params._rttProjMatrix;
+            local._depthValid = false;
+        }
+
+        const osg::Matrixd& depthViewMatrix = local._depthViewMatrix;
+        const osg::Matrixd& depthProjMatrix = local._depthProjMatrix;
+
+        if ( renderDepth )
+        {
+            // update the RTT camera.
+            params._rttCamera->setViewMatrix      ( depthViewMatrix );
+            params._rttCamera->setProjectionMatrix( depthProjMatrix );
+
+            // create the depth texture (render the terrain to tex)
+            params._rttCamera->accept( *cv );
+        }
 
 
         // construct a matrix that transforms from camera view coords to depth texture
@@ -429,10 +554,10 @@ ClampingTechnique::cullOverlayGroup(OverlayDecorator::TechRTTParams& params,
         vm.invert( *cv->getModelViewMatrix() );
         osg::Matrix cameraViewToDepthView =
             vm *
-            params._rttViewMatrix;
+            depthViewMatrix;
 
         osg::Matrix depthViewToDepthClip = 
-            params._rttProjMatrix *
+            depthProjMatrix *
             s_scaleBiasMat;
 
         osg::Matrix cameraViewToDepthClip =
@@ -470,7 +595,7 @@ ClampingTechnique::cullOverlayGroup(OverlayDecorator::TechRTTParams& params,
             // cull geometry which is invisible when NOT clamped, but becomes visible after
             // GPU clamping.) We work around that by using a Proxy cull visitor that will 
             // use the RTT camera's matrixes for frustum culling (instead of the main camera's).
-            ProxyCullVisitor pcv( cv, params._rttProjMatrix, params._rttViewMatrix );
+            ProxyCullVisitor pcv( cv, depthProjMatrix, depthViewMatrix );
 
             // cull the clampable geometry.
             params._group->accept( pcv );
@@ -498,6 +623,13 @@ ClampingTechnique::onInstall( TerrainEngineNode* engine )
     // save a pointer to the terrain engine.
     _engine = engine;
 
+    // listen for new tiles, which invalidate cached depth maps.
+    if ( !_tileCallback.valid() )
+        _tileCallback = new TileCallback( this );
+
+    if ( _engine && _engine->getTerrain() )
+        _engine->getTerrain()->addTerrainCallback( _tileCallback.get() );
+
     if ( !_textureSize.isSet() )
     {
         unsigned maxSize = Registry::capabilities().getMaxFastTextureSize();
@@ -511,5 +643,50 @@ ClampingTechnique::onInstall( TerrainEngineNode* engine )
 void
 ClampingTechnique::onUninstall( TerrainEngineNode* engine )
 {
+    if ( _tileCallback.valid() && engine && engine->getTerrain() )
+        engine->getTerrain()->removeTerrainCallback( _tileCallback.get() );
+
     _engine = 0L;
 }
+
+
+void
+ClampingTechnique::onTileAdded(const TileKey&          key,
+                               osg::Node*              graph,
+                               TerrainCallbackContext& context)
+{
+    Threading::ScopedMutexLock lock( _viewsMutex );
+
+    for(ViewList::iterator i = _views.begin(); i != _views.end(); )
+    {
+        osg::ref_ptr<osg::Referenced> ref;
+        if ( !i->lock(ref) )
+        {
+            i = _views.erase( i );
+            continue;
+        }
+
+        LocalPerViewData* local = static_cast<LocalPerViewData*>(ref.get());
+        if ( local->_depthValid && !local->_terrainDirty )
+        {
+            // no graph means the terrain changed as a whole (e.g. a new elevation layer)
+            if ( !graph || !graph->getBound().valid() )
+            {
+                local->_terrainDirty = true;
+            }
+            else
+            {
+                // only invalidate if the new tile falls inside the depth map.
+                const osg::BoundingSphere& bs = graph->getBound();
+                osg::Vec3d c = osg::Vec3d(bs.center()) * local->_depthViewMatrix * local->_depthProjMatrix;
+                double rx = bs.radius() * fabs(local->_depthProjMatrix(0,0));
+                double ry = bs.radius() * fabs(local->_depthProjMatrix(1,1));
+                if ( fabs(c.x()) <= 1.0+rx && fabs(c.y()) <= 1.0+ry )
+                {
+                    local->_terrainDirty = true;
+                }
+            }
+        }
+        ++i;
+    }
+}
@@ -22,7 +22,10 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
 #include <osgEarth/HeightFieldUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <osgDB/FileNameUtils>
+#include <cstdlib>
 
 #define LC "[CompositeTileSource] "
 
@@ -130,6 +133,103 @@ namespace
 
     // some helper types.    
     typedef std::vector<ImageInfo> ImageMixVector;   
+
+    // Component fetches share the registry's thread budget under this UID.
+    TaskService* getCompositeImageService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    /**
+     * Component images for one key, fetched in parallel.
+     */
+    struct ComponentFetch : public ParallelJobs
+    {
+        TileKey                                  _key;
+        std::vector< osg::ref_ptr<ImageLayer> >  _layers;
+        std::vector< osg::ref_ptr<osg::Image> >  _results;
+        ProgressCallback*                        _progress;
+
+        ComponentFetch(const TileKey& key, const std::vector< osg::ref_ptr<ImageLayer> >& layers, ProgressCallback* progress) :
+            _key(key), _layers(layers), _results(layers.size()), _progress(progress) { }
+
+        void runJob(unsigned i)
+        {
+            // skip the remaining work once the request is abandoned
+            if (!_progress || (!_progress->isCanceled() && !_progress->needsRetry()))
+            {
+                GeoImage image = _layers[i]->createImage(_key, _progress);
+                if (image.valid())
+                    _results[i] = image.getImage();
+            }
+        }
+
+        void run(TaskService* service)
+        {
+            ParallelJobs::run(_layers.size(), service);
+        }
+    };
+
+    /**
+     * Tracks which output pixels are already hidden under fully opaque
+     * pixels of the images composited above them.
+     */
+    struct Coverage
+    {
+        int               _s, _t;
+        std::vector<bool> _covered;
+        unsigned          _numUncovered;
+
+        Coverage() : _s(0), _t(0), _numUncovered(1u) { }
+
+        void init(int s, int t)
+        {
+            _s = s, _t = t;
+            _covered.assign(s*t, false);
+            _numUncovered = s*t;
+        }
+
+        bool full() const { return _numUncovered == 0u; }
+
+        /** Adds an image to the coverage; returns true once nothing below can show. */
+        bool add(const osg::Image* image, float opacity)
+        {
+            if (full())
+                return true;
+
+            if (!image || opacity < 1.0f || image->s() != _s || image->t() != _t || image->r() != 1 ||
+                ImageUtils::isCompressed(image) || !ImageUtils::PixelReader::supports(image))
+            {
+                return false;
+            }
+
+            if (!ImageUtils::hasAlphaChannel(image))
+            {
+                _covered.assign(_s*_t, true);
+                _numUncovered = 0u;
+                return true;
+            }
+
+            bool rgba8 = image->getPixelFormat() == GL_RGBA && image->getDataType() == GL_UNSIGNED_BYTE;
+            ImageUtils::PixelReader read(image);
+
+            for (int t = 0; t < _t; ++t)
+            {
+                const unsigned char* alpha = rgba8 ? image->data(0, t) + 3 : 0L;
+                for (int s = 0; s < _s; ++s)
+                {
+                    unsigned k = t*_s + s;
+                    if (!_covered[k] && (rgba8 ? alpha[s*4] == 255u : read(s, t).a() >= 1.0f))
+                    {
+                        _covered[k] = true;
+                        --_numUncovered;
+                    }
+                }
+            }
+            return full();
+        }
+    };
 }
 
 //-----------------------------------------------------------------------
@@ -147,56 +247,89 @@ osg::Image*
 CompositeTileSource::createImage(const TileKey&    key,
                                  ProgressCallback* progress )
 {    
-    ImageMixVector images;
-    images.reserve(_imageLayers.size());
-
-    // Try to get an image from each of the layers for the given key.
-    for (ImageLayerVector::const_iterator itr = _imageLayers.begin(); itr != _imageLayers.end(); ++itr)
+    ImageMixVector images(_imageLayers.size());
+    for (unsigned i = 0; i < _imageLayers.size(); ++i)
     {
-        ImageLayer* layer = itr->get();
-        ImageInfo imageInfo;
-        imageInfo.dataInExtents = layer->mayHaveDataInExtent(key.getExtent()); //getTileSource()->hasDataInExtent( key.getExtent() );
-        imageInfo.opacity = layer->getOpacity();
+        ImageLayer* layer = _imageLayers[i].get();
+        images[i].dataInExtents = layer->mayHaveDataInExtent(key.getExtent()); //getTileSource()->hasDataInExtent( key.getExtent() );
+        images[i].opacity = layer->getOpacity();
+    }
 
-        if (imageInfo.dataInExtents)
+    // Fetch the images top-down (the last layer is on top), a few layers at a
+    // time in parallel, and stop once everything below is hidden by opaque pixels.
+    TaskService* service = getCompositeImageService();
+    unsigned batchSize = service->getNumThreads() + 1u;
+
+    Coverage coverage;
+    osg::Vec2s textureSize;
+    unsigned numValidImages = 0;
+    int bottom = 0;
+
+    int next = (int)images.size() - 1;
+    while (next >= 0 && !coverage.full())
+    {
+        std::vector<int> batch;
+        std::vector< osg::ref_ptr<ImageLayer> > layers;
+        for (; next >= 0 && batch.size() < batchSize; --next)
         {
-            GeoImage image = layer->createImage(key, progress);
-            if (image.valid())
+            if (images[next].dataInExtents)
             {
-                imageInfo.image = image.getImage();
+                batch.push_back(next);
+                layers.push_back(_imageLayers[next].get());
             }
+        }
+
+        osg::ref_ptr<ComponentFetch> fetch = new ComponentFetch(key, layers, progress);
+        fetch->run(service);
+
+        // If the progress got cancelled or it needs a retry then return NULL to prevent this tile from being built and cached with incomplete or partial data.
+        if (progress && (progress->isCanceled() || progress->needsRetry()))
+        {
+            OE_DEBUG << LC << " createImage was cancelled or needs retry for " << key.str() << std::endl;
+            return 0L;
+        }
 
-            // If the progress got cancelled or it needs a retry then return NULL to prevent this tile from being built and cached with incomplete or partial data.
-            if (progress && (progress->isCanceled() || progress->needsRetry()))
+        for (unsigned b = 0; b < batch.size(); ++b)
+        {
+            // take the results; a helper task may still hold the fetch.
+            ImageInfo& info = images[batch[b]];
+            info.image = fetch->_results[b].get();
+            fetch->_results[b] = 0L;
+            if (info.image.valid())
             {
-                OE_DEBUG << LC << " createImage was cancelled or needs retry for " << key.str() << std::endl;
-                return 0L;
+                // Determine the output texture size from the topmost image.
+                if (numValidImages == 0)
+                {
+                    textureSize.set( info.image->s(), info.image->t());
+                    coverage.init( textureSize.x(), textureSize.y() );
+                }
+                numValidImages++;
+
+                if (coverage.add(info.image.get(), info.opacity))
+                {
+                    bottom = batch[b];
+                    break;
+                }
             }
         }
-
-        images.push_back(imageInfo);
     }
 
-    // Determine the output texture size to use based on the image that were creatd.
-    unsigned numValidImages = 0;
-    osg::Vec2s textureSize;
+    // Layers under the opaque coverage can't contribute.
+    for (int i = 0; i < bottom; ++i)
+    {
+        images[i].image = 0L;
+        images[i].dataInExtents = false;
+    }
+    numValidImages = 0;
     for (unsigned int i = 0; i < images.size(); i++)
     {
-        ImageInfo& info = images[i];
-        if (info.image.valid())
-        {
-            if (numValidImages == 0)
-            {
-                textureSize.set( info.image->s(), info.image->t());
-            }
-            numValidImages++;        
-        }
-    } 
+        if (images[i].image.valid()) numValidImages++;
+    }
 
     // Create fallback images if we have some valid data but not for all the layers
-    if (numValidImages > 0 && numValidImages < images.size())
+    if (numValidImages > 0 && numValidImages < images.size() - bottom)
     {
-        for (unsigned int i = 0; i < images.size(); i++)
+        for (unsigned int i = bottom; i < images.size(); i++)
         {
             ImageInfo& info = images[i];
             ImageLayer* layer = _imageLayers[i].get();
@@ -272,7 +405,9 @@ CompositeTileSource::createImage(const TileKey&    key,
             {
                 if (imageInfo.image.valid())
                 {
-                    result = new osg::Image( *imageInfo.image.get());
+                    // Don't share the user data; the mix invalidates marks like single-color.
+                    result = new osg::Image( *imageInfo.image.get(), osg::CopyOp::DEEP_COPY_USERDATA );
+                    ImageUtils::markAsSingleColor( result, false );
                 }
             }
             else
@@ -285,9 +420,6 @@ CompositeTileSource::createImage(const TileKey&    key,
         }        
         return result;
     }
-
-
-
 }
 
 osg::HeightField* CompositeTileSource::createHeightField(
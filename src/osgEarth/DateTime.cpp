@@ -24,6 +24,7 @@
 #include <math.h>
 #include <iomanip>
 #include <stdio.h>
+#include <string.h>
 
 using namespace osgEarth;
 
@@ -99,6 +100,7 @@ _time_t(0)
 {
     bool ok = false;
     int year, month, day, hour, min, sec;
+    char monthName[4];
     
     ::memset( &_tm, 0, sizeof(tm) );
 
@@ -143,6 +145,22 @@ _time_t(0)
         ok = true;
     }
 
+    // RFC 1123, as in HTTP headers (e.g., "Sun, 06 Nov 1994 08:49:37 GMT")
+    else if (sscanf(input.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d", &day, monthName, &year, &hour, &min, &sec) == 6)
+    {
+        for (month = 0; month < 12 && ::strcmp(monthName, rfc_month[month]) != 0; ++month);
+        if (month < 12)
+        {
+            _tm.tm_year = year - 1900;
+            _tm.tm_mon  = month;
+            _tm.tm_mday = day;
+            _tm.tm_hour = hour;
+            _tm.tm_min  = min;
+            _tm.tm_sec  = sec;
+            ok = true;
+        }
+    }
+
     if ( ok )
     {
         // now go to time_t, and back to tm, to populate the rest of the fields.
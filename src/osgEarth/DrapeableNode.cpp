@@ -28,7 +28,8 @@ using namespace osgEarth;
 
 
 DrapeableNode::DrapeableNode() :
-_drapingEnabled( true )
+_drapingEnabled( true ),
+_revision      ( 0u )
 {
     // Unfortunetly, there's no way to return a correct bounding sphere for
     // the node since the draping will move it to the ground. The bounds
@@ -39,7 +40,8 @@ _drapingEnabled( true )
 }
 
 DrapeableNode::DrapeableNode(const DrapeableNode& rhs, const osg::CopyOp& copy) :
-osg::Group(rhs, copy)
+osg::Group(rhs, copy),
+_revision( 0u )
 {
     _drapingEnabled = rhs._drapingEnabled;
 }
@@ -51,6 +53,7 @@ DrapeableNode::setDrapingEnabled(bool value)
     {
         _drapingEnabled = value;
         setCullingActive( !_drapingEnabled );
+        dirty();
     }
 }
 
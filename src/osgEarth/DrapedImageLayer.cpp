@@ -0,0 +1,360 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarth/DrapedImageLayer>
+#include <osgEarth/TileRasterizer>
+#include <osgEarth/TerrainEngineNode>
+#include <osgEarth/MapNode>
+#include <osgEarth/Map>
+#include <osgEarth/NodeUtils>
+#include <osgEarth/Registry>
+#include <osg/MatrixTransform>
+#include <osg/Texture2D>
+
+using namespace osgEarth;
+
+#define LC "[DrapedImageLayer] "
+
+REGISTER_OSGEARTH_LAYER(draped_image, DrapedImageLayer);
+
+//........................................................................
+
+DrapedImageLayerOptions::DrapedImageLayerOptions() :
+ImageLayerOptions()
+{
+    fromConfig(_conf);
+}
+
+DrapedImageLayerOptions::DrapedImageLayerOptions(const ConfigOptions& options) :
+ImageLayerOptions( options )
+{
+    fromConfig( _conf );
+}
+
+Config
+DrapedImageLayerOptions::getConfig() const
+{
+    Config conf = ImageLayerOptions::getConfig();
+    conf.key() = "draped_image";
+    return conf;
+}
+
+void
+DrapedImageLayerOptions::fromConfig( const Config& conf )
+{
+    //nop
+}
+
+void
+DrapedImageLayerOptions::mergeConfig( const Config& conf )
+{
+    ImageLayerOptions::mergeConfig( conf );
+    fromConfig( conf );
+}
+
+//........................................................................
+
+namespace
+{
+    /**
+     * Scene graph node that hands the layer's dirty extents to the terrain
+     * engine during the update traversal, so tiles reload on the update
+     * thread no matter which thread dirtied them.
+     */
+    class DrapedImageLayerNode : public osg::Group
+    {
+    public:
+        DrapedImageLayerNode(DrapedImageLayer* layer) : _layer(layer)
+        {
+            ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        }
+
+        void traverse(osg::NodeVisitor& nv)
+        {
+            if (nv.getVisitorType() == nv.UPDATE_VISITOR)
+            {
+                osg::ref_ptr<DrapedImageLayer> layer;
+                if (_layer.lock(layer))
+                {
+                    MapNode* mapNode = findInNodePath<MapNode>(nv);
+                    if (mapNode && mapNode->getTerrainEngine())
+                    {
+                        layer->flushDirtyExtents(mapNode->getTerrainEngine());
+                    }
+                }
+            }
+            osg::Group::traverse(nv);
+        }
+
+    protected:
+        osg::observer_ptr<DrapedImageLayer> _layer;
+    };
+}
+
+//........................................................................
+
+DrapedImageLayer::DrapedImageLayer() :
+ImageLayer(&_optionsConcrete),
+_options(&_optionsConcrete)
+{
+    init();
+}
+
+DrapedImageLayer::DrapedImageLayer(const DrapedImageLayerOptions& options) :
+ImageLayer(&_optionsConcrete),
+_options(&_optionsConcrete),
+_optionsConcrete(options)
+{
+    init();
+}
+
+void
+DrapedImageLayer::init()
+{
+    setTileSourceExpected(false);
+
+    // Generate geodetic tiles by default; the terrain engine requests
+    // tiles by its own keys.
+    setProfile(Profile::create("global-geodetic"));
+
+    _updateNode = new DrapedImageLayerNode(this);
+
+    ImageLayer::init();
+
+    if (getName().empty())
+        setName("Draped image");
+}
+
+void
+DrapedImageLayer::addedToMap(const Map* map)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    _mapSRS = map->getSRS();
+
+    // extents depend on the map SRS; recompute them and reload.
+    for (Entries::iterator i = _entries.begin(); i != _entries.end(); ++i)
+    {
+        i->_extent = computeExtent(i->_node.get());
+        if (i->_extent.isValid())
+            _dirtyExtents.push_back(i->_extent);
+    }
+}
+
+void
+DrapedImageLayer::removedFromMap(const Map* map)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _mapSRS = 0L;
+    _dirtyExtents.clear();
+}
+
+osg::Node*
+DrapedImageLayer::getNode() const
+{
+    return _updateNode.get();
+}
+
+void
+DrapedImageLayer::addNode(osg::Node* node)
+{
+    if (!node)
+        return;
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    Entry entry;
+    entry._node = node;
+    entry._extent = computeExtent(node);
+    _entries.push_back(entry);
+
+    if (entry._extent.isValid())
+        _dirtyExtents.push_back(entry._extent);
+}
+
+void
+DrapedImageLayer::removeNode(osg::Node* node)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    for (Entries::iterator i = _entries.begin(); i != _entries.end(); ++i)
+    {
+        if (i->_node.get() == node)
+        {
+            if (i->_extent.isValid())
+                _dirtyExtents.push_back(i->_extent);
+            _entries.erase(i);
+            break;
+        }
+    }
+}
+
+unsigned
+DrapedImageLayer::getNumDrapedNodes() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _entries.size();
+}
+
+osg::Node*
+DrapedImageLayer::getDrapedNode(unsigned i) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return i < _entries.size() ? _entries[i]._node.get() : 0L;
+}
+
+void
+DrapedImageLayer::dirty(const GeoExtent& extent)
+{
+    if (!extent.isValid())
+        return;
+
+    Threading::ScopedMutexLock lock(_mutex);
+    _dirtyExtents.push_back(extent);
+}
+
+void
+DrapedImageLayer::dirty(osg::Node* node)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    for (Entries::iterator i = _entries.begin(); i != _entries.end(); ++i)
+    {
+        if (i->_node.get() == node)
+        {
+            // reload both the old and the new footprint.
+            GeoExtent newExtent = computeExtent(node);
+            if (i->_extent.isValid())
+                _dirtyExtents.push_back(i->_extent);
+            if (newExtent.isValid() && newExtent != i->_extent)
+                _dirtyExtents.push_back(newExtent);
+            i->_extent = newExtent;
+            break;
+        }
+    }
+}
+
+void
+DrapedImageLayer::flushDirtyExtents(TerrainEngineNode* engine)
+{
+    std::vector<GeoExtent> extents;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if (_dirtyExtents.empty())
+            return;
+        extents.swap(_dirtyExtents);
+    }
+
+    for (std::vector<GeoExtent>::const_iterator i = extents.begin(); i != extents.end(); ++i)
+    {
+        engine->invalidateRegion(*i);
+    }
+}
+
+GeoExtent
+DrapedImageLayer::computeExtent(osg::Node* node) const
+{
+    if (!node || !_mapSRS.valid())
+        return GeoExtent::INVALID;
+
+    const osg::BoundingSphere& bs = node->getBound();
+    if (!bs.valid())
+        return GeoExtent::INVALID;
+
+    // Convert the corners of the world-space bounding box to map coordinates.
+    osg::BoundingBox box;
+    box.expandBy(bs);
+
+    GeoExtent extent(_mapSRS.get());
+    for (unsigned c = 0; c < 8; ++c)
+    {
+        GeoPoint p;
+        if (p.fromWorld(_mapSRS.get(), box.corner(c)))
+        {
+            extent.expandToInclude(p.x(), p.y());
+        }
+    }
+    return extent;
+}
+
+osg::Texture*
+DrapedImageLayer::createTexture(const TileKey& key, ProgressCallback* progress, osg::Matrixf& textureMatrix)
+{
+    const GeoExtent& keyExtent = key.getExtent();
+
+    // Collect the draped nodes that touch this tile.
+    osg::ref_ptr<osg::Group> content = new osg::Group();
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        for (Entries::const_iterator i = _entries.begin(); i != _entries.end(); ++i)
+        {
+            if (i->_extent.isValid() && i->_extent.intersects(keyExtent))
+            {
+                content->addChild(i->_node.get());
+            }
+        }
+    }
+
+    if (content->getNumChildren() == 0)
+        return 0L;
+
+    // Transform the world-space content into the frame of the tile extent,
+    // flattening it to z=0 so it falls within the rasterizer's depth range.
+    osg::Matrixd world2local;
+    GeoExtent outputExtent;
+
+    const SpatialReference* keySRS = keyExtent.getSRS();
+    if (keySRS->isGeographic())
+    {
+        osg::Vec3d pos(keyExtent.west(), keyExtent.south(), 0.0);
+        osg::ref_ptr<const SpatialReference> srs = keySRS->createTangentPlaneSRS(pos);
+        if (!srs.valid())
+            return 0L;
+
+        outputExtent = keyExtent.transform(srs.get());
+
+        osg::Matrixd local2world;
+        GeoPoint(keySRS, pos.x(), pos.y(), 0.0, ALTMODE_ABSOLUTE).createLocalToWorld(local2world);
+        world2local.invert(local2world);
+    }
+    else
+    {
+        // projected map: world coordinates are already map coordinates.
+        outputExtent = keyExtent;
+    }
+
+    osg::MatrixTransform* xform = new osg::MatrixTransform();
+    xform->setMatrix(world2local * osg::Matrixd::scale(1.0, 1.0, 0.0));
+    xform->addChild(content.get());
+
+    osg::Texture2D* tex = new osg::Texture2D();
+    tex->setTextureSize(getTileSize(), getTileSize());
+    tex->setInternalFormat(GL_RGBA);
+    tex->setSourceFormat(GL_RGBA);
+    tex->setSourceType(GL_UNSIGNED_BYTE);
+    tex->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+    tex->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    tex->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    tex->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+    // The terrain engine renders the node into the texture with its
+    // tile rasterizer when the tile goes live.
+    tex->setUserData(new GeoNode(xform, outputExtent));
+
+    return tex;
+}
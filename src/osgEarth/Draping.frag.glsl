@@ -6,14 +6,37 @@ $GLSL_DEFAULT_PRECISION_FLOAT
 #pragma vp_order      0.6
 
 #pragma import_defines(OE_IS_PICK_CAMERA)
+#pragma import_defines(OE_DRAPING_CASCADES)
 
 uniform sampler2D oe_overlay_tex;
 in vec4 oe_overlay_texcoord;
 
+#ifdef OE_DRAPING_CASCADES
+uniform sampler2D oe_overlay_near_tex;
+in vec4 oe_overlay_near_texcoord;
+#endif
+
 void oe_overlay_fragment(inout vec4 color)
 {
     vec4 texel = textureProj(oe_overlay_tex, oe_overlay_texcoord);
 
+#ifdef OE_DRAPING_CASCADES
+    // Use the near cascade wherever it covers the fragment, fading
+    // into the far cascade near its edge to hide the seam.
+    vec2 nearUV = oe_overlay_near_texcoord.xy / oe_overlay_near_texcoord.w;
+    vec2 d = abs(nearUV - 0.5) * 2.0;
+    float edge = max(d.x, d.y);
+    if (edge < 1.0)
+    {
+        vec4 nearTexel = texture(oe_overlay_near_tex, nearUV);
+#ifdef OE_IS_PICK_CAMERA
+        texel = nearTexel; // never blend object IDs
+#else
+        texel = mix(nearTexel, texel, smoothstep(0.9, 1.0, edge));
+#endif
+    }
+#endif
+
 #ifdef OE_IS_PICK_CAMERA
     color = texel;
 #else
@@ -4,12 +4,22 @@ $GLSL_DEFAULT_PRECISION_FLOAT
 #pragma vp_entryPoint oe_overlay_vertex
 #pragma vp_location   vertex_view
 
+#pragma import_defines(OE_DRAPING_CASCADES)
+
 uniform mat4 oe_overlay_texmatrix;
 uniform float oe_overlay_rttLimitZ;
 
 out vec4 oe_overlay_texcoord;
 
+#ifdef OE_DRAPING_CASCADES
+uniform mat4 oe_overlay_near_texmatrix;
+out vec4 oe_overlay_near_texcoord;
+#endif
+
 void oe_overlay_vertex(inout vec4 vertexVIEW)
 {
     oe_overlay_texcoord = oe_overlay_texmatrix * vertexVIEW;
+#ifdef OE_DRAPING_CASCADES
+    oe_overlay_near_texcoord = oe_overlay_near_texmatrix * vertexVIEW;
+#endif
 }
\ No newline at end of file
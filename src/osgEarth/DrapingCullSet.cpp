@@ -26,7 +26,13 @@
 
 using namespace osgEarth;
 
-
+namespace
+{
+    inline void hashCombine(std::size_t& seed, std::size_t value)
+    {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+}
 
 
 DrapingCullSet&
@@ -85,11 +91,13 @@ DrapingCullSet::accept(osg::NodeVisitor& nv)
             if ( frame - entry->_frame > 1 )
                 continue;
 
-            // If there's an active (non-identity matrix), apply it
+            // If there's an active (non-identity matrix), apply it. Use a copy, since
+            // the set may be traversed more than once per frame (e.g. once per cascade).
             if ( entry->_matrix.valid() )
             {
-                entry->_matrix->postMult( *cv->getModelViewMatrix() );
-                cv->pushModelViewMatrix( entry->_matrix.get(), osg::Transform::RELATIVE_RF );
+                osg::ref_ptr<osg::RefMatrix> mvm = new osg::RefMatrix( *entry->_matrix.get() );
+                mvm->postMult( *cv->getModelViewMatrix() );
+                cv->pushModelViewMatrix( mvm.get(), osg::Transform::RELATIVE_RF );
             }
 
             // After pushing the matrix, we can perform the culling bounds test.
@@ -153,3 +161,36 @@ DrapingCullSet::accept(osg::NodeVisitor& nv)
         }
     }
 }
+
+std::size_t
+DrapingCullSet::getContentHash(const osg::FrameStamp* stamp, bool& out_dynamic) const
+{
+    out_dynamic = false;
+
+    int frame = stamp ? stamp->getFrameNumber() : 0u;
+    std::size_t hash = 0u;
+
+    for( std::vector<Entry>::const_iterator entry = _entries.begin(); entry != _entries.end(); ++entry )
+    {
+        // same rule as accept()
+        if ( frame - entry->_frame > 1 )
+            continue;
+
+        const DrapeableNode* node = static_cast<const DrapeableNode*>(entry->_node.get());
+
+        if ( node->getNumChildrenRequiringUpdateTraversal() > 0 )
+            out_dynamic = true;
+
+        hashCombine( hash, (std::size_t)node );
+        hashCombine( hash, (std::size_t)node->getRevision() );
+
+        if ( entry->_matrix.valid() )
+        {
+            const osg::Matrixd::value_type* m = entry->_matrix->ptr();
+            for(unsigned i=0; i<16; ++i)
+                hashCombine( hash, (std::size_t)(long long)(m[i]*1000.0) );
+        }
+    }
+
+    return hash;
+}
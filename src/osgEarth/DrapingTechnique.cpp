@@ -80,10 +80,23 @@ namespace
     };
 
 
+    // What a cascade's texture currently holds.
+    struct Cascade
+    {
+        Cascade() : _valid(false), _contentHash(0u) { }
+        osg::Matrixd _viewMatrix;   // RTT matrices it was rendered with
+        osg::Matrixd _projMatrix;
+        bool         _valid;
+        std::size_t  _contentHash;  // DrapingCullSet hash it was rendered with
+    };
+
     // Additional per-view data stored by the draping technique.
     struct LocalPerViewData : public osg::Referenced
     {
         osg::ref_ptr<osg::Uniform> _texGenUniform;
+        osg::ref_ptr<osg::Uniform> _nearTexGenUniform;
+        osg::ref_ptr<osg::Camera>  _nearCamera;
+        Cascade                    _far, _near;
     };
 }
 
@@ -317,6 +330,48 @@ namespace
         // apply the result to the projection matrix.
         params._rttProjMatrix.postMult( M );
     }
+
+    // The near cascade is rendered over a region this much larger than
+    // required, so it stays usable for a while as the camera moves.
+    const double NEAR_CACHE_MARGIN = 1.25;
+
+    // Resolution loss (as the camera zooms in) past which a cached near
+    // cascade is re-rendered, relative to a fresh one.
+    const double NEAR_CACHE_MAX_COARSENING = 1.5;
+
+    // Whether a near cascade rendered with cachedView/cachedProj covers the
+    // square of the given half-size around the RTT camera's nadir at an
+    // acceptable resolution. "depth" is the view-space Z of the draped content.
+    bool nearCascadeCovers(const osg::Matrixd& cachedView,
+                           const osg::Matrixd& cachedProj,
+                           const osg::Matrixd& rttView,
+                           double              halfSize,
+                           double              depth)
+    {
+        double l, r, b, t, n, f;
+        if ( !cachedProj.getOrtho(l, r, b, t, n, f) )
+            return false;
+
+        if ( halfSize < 0.5*(r-l) / (NEAR_CACHE_MARGIN * NEAR_CACHE_MAX_COARSENING) )
+            return false;
+
+        osg::Matrixd rttViewToCachedClip;
+        rttViewToCachedClip.invert( rttView );
+        rttViewToCachedClip = rttViewToCachedClip * cachedView * cachedProj;
+
+        const osg::Vec3d corners[4] = {
+            osg::Vec3d(-halfSize, -halfSize, depth), osg::Vec3d(halfSize, -halfSize, depth),
+            osg::Vec3d( halfSize,  halfSize, depth), osg::Vec3d(-halfSize, halfSize, depth) };
+
+        for(unsigned i=0; i<4; ++i)
+        {
+            osg::Vec3d c = corners[i] * rttViewToCachedClip;
+            if ( fabs(c.x()) > 1.0 || fabs(c.y()) > 1.0 )
+                return false;
+        }
+
+        return true;
+    }
 }
 
 //---------------------------------------------------------------------------
@@ -330,7 +385,10 @@ _textureSize     ( 1024 ),
 _mipmapping      ( false ),
 _rttBlending     ( true ),
 _attachStencil   ( false ),
-_maxFarNearRatio ( 5.0 )
+_maxFarNearRatio ( 5.0 ),
+_numCascades     ( 1u ),
+_cascadeSplit    ( 0.2 ),
+_useCache        ( true )
 {
     _supported = Registry::capabilities().supportsGLSL();
 
@@ -377,35 +435,20 @@ namespace
     };
 }
 
-void
-DrapingTechnique::setUpCamera(OverlayDecorator::TechRTTParams& params)
+osg::Camera*
+DrapingTechnique::createCamera(osg::Texture2D* texture, osg::StateSet* stateSet) const
 {
-    // create the projected texture:
-    osg::Texture2D* projTexture = new DrapingTexture(); 
-
-    projTexture->setTextureSize( *_textureSize, *_textureSize );
-    projTexture->setInternalFormat( GL_RGBA );
-    projTexture->setSourceFormat( GL_RGBA );
-    projTexture->setSourceType( GL_UNSIGNED_BYTE );
-    projTexture->setFilter( osg::Texture::MIN_FILTER, _mipmapping? osg::Texture::LINEAR_MIPMAP_LINEAR: osg::Texture::LINEAR );
-    projTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
-    projTexture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_BORDER );
-    projTexture->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_BORDER );
-    //projTexture->setWrap( osg::Texture::WRAP_R, osg::Texture::CLAMP_TO_EDGE );
-    projTexture->setBorderColor( osg::Vec4(0,0,0,0) );
-
-    // set up the RTT camera:
-    params._rttCamera = new DrapingCamera(); //new osg::Camera();
-    params._rttCamera->setClearColor( osg::Vec4f(0,0,0,0) );
+    osg::Camera* camera = new DrapingCamera();
+    camera->setClearColor( osg::Vec4f(0,0,0,0) );
     // this ref frame causes the RTT to inherit its viewpoint from above (in order to properly
     // process PagedLOD's etc. -- it doesn't affect the perspective of the RTT camera though)
-    params._rttCamera->setReferenceFrame( osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT );
-    params._rttCamera->setViewport( 0, 0, *_textureSize, *_textureSize );
-    params._rttCamera->setComputeNearFarMode( osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR );
-    params._rttCamera->setRenderOrder( osg::Camera::PRE_RENDER );
-    params._rttCamera->setRenderTargetImplementation( osg::Camera::FRAME_BUFFER_OBJECT );
-    params._rttCamera->setImplicitBufferAttachmentMask(0, 0);
-    params._rttCamera->attach( osg::Camera::COLOR_BUFFER0, projTexture, 0, 0, _mipmapping );
+    camera->setReferenceFrame( osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT );
+    camera->setViewport( 0, 0, *_textureSize, *_textureSize );
+    camera->setComputeNearFarMode( osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR );
+    camera->setRenderOrder( osg::Camera::PRE_RENDER );
+    camera->setRenderTargetImplementation( osg::Camera::FRAME_BUFFER_OBJECT );
+    camera->setImplicitBufferAttachmentMask(0, 0);
+    camera->attach( osg::Camera::COLOR_BUFFER0, texture, 0, 0, _mipmapping );
 
     if ( _attachStencil )
     {
@@ -417,26 +460,61 @@ DrapingTechnique::setUpCamera(OverlayDecorator::TechRTTParams& params)
         if ( Registry::capabilities().supportsDepthPackedStencilBuffer() )
         {
 #ifdef OSG_GLES2_AVAILABLE 
-            params._rttCamera->attach( osg::Camera::PACKED_DEPTH_STENCIL_BUFFER, GL_DEPTH24_STENCIL8_EXT );
+            camera->attach( osg::Camera::PACKED_DEPTH_STENCIL_BUFFER, GL_DEPTH24_STENCIL8_EXT );
 #else
-            params._rttCamera->attach( osg::Camera::PACKED_DEPTH_STENCIL_BUFFER, GL_DEPTH_STENCIL_EXT );
+            camera->attach( osg::Camera::PACKED_DEPTH_STENCIL_BUFFER, GL_DEPTH_STENCIL_EXT );
 #endif
         }
         else
         {
-            params._rttCamera->attach( osg::Camera::STENCIL_BUFFER, GL_STENCIL_INDEX );
+            camera->attach( osg::Camera::STENCIL_BUFFER, GL_STENCIL_INDEX );
         }
 
-        params._rttCamera->setClearStencil( 0 );
-        params._rttCamera->setClearMask( GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
+        camera->setClearStencil( 0 );
+        camera->setClearMask( GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT );
     }
     else
     {
-        params._rttCamera->setClearMask( GL_COLOR_BUFFER_BIT );
+        camera->setClearMask( GL_COLOR_BUFFER_BIT );
     }
 
-    // set up a StateSet for the RTT camera.
-    osg::StateSet* rttStateSet = params._rttCamera->getOrCreateStateSet();
+    // the cascades share one RTT stateset.
+    camera->setStateSet( stateSet );
+
+    return camera;
+}
+
+namespace
+{
+    osg::Texture2D* createDrapingTexture(int size, bool mipmapping)
+    {
+        osg::Texture2D* projTexture = new DrapingTexture(); 
+
+        projTexture->setTextureSize( size, size );
+        projTexture->setInternalFormat( GL_RGBA );
+        projTexture->setSourceFormat( GL_RGBA );
+        projTexture->setSourceType( GL_UNSIGNED_BYTE );
+        projTexture->setFilter( osg::Texture::MIN_FILTER, mipmapping? osg::Texture::LINEAR_MIPMAP_LINEAR: osg::Texture::LINEAR );
+        projTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+        projTexture->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_BORDER );
+        projTexture->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_BORDER );
+        //projTexture->setWrap( osg::Texture::WRAP_R, osg::Texture::CLAMP_TO_EDGE );
+        projTexture->setBorderColor( osg::Vec4(0,0,0,0) );
+        return projTexture;
+    }
+}
+
+void
+DrapingTechnique::setUpCamera(OverlayDecorator::TechRTTParams& params)
+{
+    // create the projected texture:
+    osg::Texture2D* projTexture = createDrapingTexture( *_textureSize, _mipmapping );
+
+    // set up a StateSet for the RTT camera(s).
+    osg::StateSet* rttStateSet = new osg::StateSet();
+
+    // set up the RTT camera:
+    params._rttCamera = createCamera( projTexture, rttStateSet );
 
     osg::StateAttribute::OverrideValue forceOff =
         osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED | osg::StateAttribute::OVERRIDE;
@@ -518,6 +596,25 @@ DrapingTechnique::setUpCamera(OverlayDecorator::TechRTTParams& params)
     local->_texGenUniform = params._terrainStateSet->getOrCreateUniform(
         "oe_overlay_texmatrix", osg::Uniform::FLOAT_MAT4 );
 
+    // the near cascade, if there's a unit for it:
+    if ( _numCascades > 1u && _nearTextureUnit.isSet() )
+    {
+        osg::Texture2D* nearTexture = createDrapingTexture( *_textureSize, _mipmapping );
+
+        local->_nearCamera = createCamera( nearTexture, rttStateSet );
+        local->_nearCamera->addChild( params._group );
+
+        params._terrainStateSet->setTextureAttributeAndModes( *_nearTextureUnit, nearTexture, osg::StateAttribute::ON );
+
+        params._terrainStateSet->getOrCreateUniform(
+            "oe_overlay_near_tex", osg::Uniform::SAMPLER_2D )->set( *_nearTextureUnit );
+
+        local->_nearTexGenUniform = params._terrainStateSet->getOrCreateUniform(
+            "oe_overlay_near_texmatrix", osg::Uniform::FLOAT_MAT4 );
+
+        params._terrainStateSet->setDefine( "OE_DRAPING_CASCADES" );
+    }
+
     // shaders
     Shaders pkg;
     pkg.load( terrain_vp, pkg.DrapingVertex );
@@ -563,6 +660,28 @@ DrapingTechnique::preCullTerrain(OverlayDecorator::TechRTTParams& params,
         m.unlock();
     }
 
+    // and a second one for the near cascade.
+    if ( _numCascades > 1u && !_nearTextureUnit.isSet() && _textureUnit.isSet() )
+    {
+        static Threading::Mutex m;
+        m.lock();
+        if ( !_nearTextureUnit.isSet() )
+        {
+            int texUnit;
+            if ( params._terrainResources->reserveTextureImageUnit(texUnit, "Draping near cascade") )
+            {
+                _nearTextureUnit = texUnit;
+                OE_INFO << LC << "Reserved texture image unit " << *_nearTextureUnit << " for the near cascade" << std::endl;
+            }
+            else
+            {
+                OE_WARN << LC << "No texture image unit available for the near cascade; using one cascade." << std::endl;
+                _numCascades = 1u;
+            }
+        }
+        m.unlock();
+    }
+
     if ( !params._rttCamera.valid() && _textureUnit.isSet() )
     {
         setUpCamera( params );
@@ -588,16 +707,85 @@ DrapingTechnique::cullOverlayGroup(OverlayDecorator::TechRTTParams& params,
             osg::Matrix::translate(1.0,1.0,1.0) * 
             osg::Matrix::scale(0.5,0.5,0.5);
 
+        DrapingCullSet& cullSet = DrapingCullSet::get( cv->getCurrentCamera() );
+
+        // A cascade can be reused when it was rendered with the same draped content.
+        // Content that animates can't be compared, so it's re-rendered every frame.
+        bool dynamic = false;
+        std::size_t contentHash = cullSet.getContentHash( cv->getFrameStamp(), dynamic );
+        bool useCache = _useCache && !dynamic;
+
+        // Note that we require the InverseViewMatrix, but it is OK to invert the ModelView
+        // matrix as the model matrix is identity here.
+        osg::Matrix vm;
+        vm.invert( *cv->getModelViewMatrix() );
+
+        // The near cascade is a plain ortho square around the RTT camera's nadir,
+        // so do it before the far cascade's warping alters the projection matrix.
+        double l, r, b, t, n, f;
+        if ( local._nearCamera.valid() && params._rttProjMatrix.getOrtho(l, r, b, t, n, f) )
+        {
+            double halfSize = _cascadeSplit * osg::maximum(
+                osg::maximum(fabs(l), fabs(r)),
+                osg::maximum(fabs(b), fabs(t)) );
+
+            // view-space depth of the draped content, for the coverage test:
+            double depth = (cullSet.getBound().center() * params._rttViewMatrix).z();
+
+            bool reuse =
+                useCache &&
+                local._near._valid &&
+                local._near._contentHash == contentHash &&
+                nearCascadeCovers(local._near._viewMatrix, local._near._projMatrix, params._rttViewMatrix, halfSize, depth);
+
+            if ( !reuse )
+            {
+                double m = halfSize * NEAR_CACHE_MARGIN;
+                local._near._viewMatrix = params._rttViewMatrix;
+                local._near._projMatrix.makeOrtho( -m, m, -m, m, n, f );
+                local._near._contentHash = contentHash;
+                local._near._valid = true;
+
+                local._nearCamera->setViewMatrix      ( local._near._viewMatrix );
+                local._nearCamera->setProjectionMatrix( local._near._projMatrix );
+                static_cast<DrapingCamera*>(local._nearCamera.get())->accept( *cv, cv->getCurrentCamera() );
+            }
+
+            if ( local._nearTexGenUniform.valid() )
+            {
+                local._nearTexGenUniform->set( vm * local._near._viewMatrix * local._near._projMatrix * s_scaleBiasMat );
+            }
+        }
+
         // resolution weighting based on camera distance.
         if ( _maxFarNearRatio > 1.0 )
         {
             optimizeProjectionMatrix( params, _maxFarNearRatio );
         }
 
-        params._rttCamera->setViewMatrix      ( params._rttViewMatrix );
-        params._rttCamera->setProjectionMatrix( params._rttProjMatrix );
+        // The far cascade follows the camera exactly, so reuse it only while the camera is still.
+        bool reuse =
+            useCache &&
+            local._far._valid &&
+            local._far._contentHash == contentHash &&
+            local._far._viewMatrix == params._rttViewMatrix &&
+            local._far._projMatrix == params._rttProjMatrix;
 
-        osg::Matrix VPT = params._rttViewMatrix * params._rttProjMatrix * s_scaleBiasMat;
+        if ( !reuse )
+        {
+            local._far._viewMatrix = params._rttViewMatrix;
+            local._far._projMatrix = params._rttProjMatrix;
+            local._far._contentHash = contentHash;
+            local._far._valid = true;
+
+            params._rttCamera->setViewMatrix      ( params._rttViewMatrix );
+            params._rttCamera->setProjectionMatrix( params._rttProjMatrix );
+
+            // traverse the overlay group (via the RTT camera).
+            static_cast<DrapingCamera*>(params._rttCamera.get())->accept( *cv, cv->getCurrentCamera() );
+        }
+
+        osg::Matrix VPT = local._far._viewMatrix * local._far._projMatrix * s_scaleBiasMat;
 
         if ( local._texGenUniform.valid() )
         {
@@ -611,15 +799,11 @@ DrapingTechnique::cullOverlayGroup(OverlayDecorator::TechRTTParams& params,
             // dispatched to render. So we need to come up with a way to address this.
             // In the meantime, I patched the MP engine to set a DYNAMIC data variance on
             // terrain tiles to work around the problem.
-            //
-            // Note that we require the InverseViewMatrix, but it is OK to invert the ModelView matrix as the model matrix is identity here.
-            osg::Matrix vm;
-            vm.invert( *cv->getModelViewMatrix() );
             local._texGenUniform->set( vm * VPT );
         }
 
-        // traverse the overlay group (via the RTT camera).
-        static_cast<DrapingCamera*>(params._rttCamera.get())->accept( *cv, cv->getCurrentCamera() );
+        // if neither cascade traversed the cull set, it still needs to reset next frame.
+        cullSet.skip();
     }
 }
 
@@ -691,6 +875,18 @@ DrapingTechnique::getResolutionRatio() const
     return (float)_maxFarNearRatio;
 }
 
+void
+DrapingTechnique::setNumCascades(unsigned value)
+{
+    _numCascades = osg::clampBetween(value, 1u, 2u);
+}
+
+void
+DrapingTechnique::setCascadeSplit(float value)
+{
+    _cascadeSplit = (double)osg::clampBetween(value, 0.01f, 0.99f);
+}
+
 void
 DrapingTechnique::onInstall( TerrainEngineNode* engine )
 {
@@ -710,4 +906,10 @@ DrapingTechnique::onUninstall( TerrainEngineNode* engine )
         engine->getResources()->releaseTextureImageUnit( *_textureUnit );
         _textureUnit.unset();
     }
+
+    if ( _nearTextureUnit.isSet() )
+    {
+        engine->getResources()->releaseTextureImageUnit( *_nearTextureUnit );
+        _nearTextureUnit.unset();
+    }
 }
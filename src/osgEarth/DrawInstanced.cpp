@@ -27,11 +27,14 @@
 #include <osgEarth/Utils>
 #include <osgEarth/Shaders>
 #include <osgEarth/ObjectIndex>
+#include <osgEarth/ThreadingUtils>
 
 #include <osg/ComputeBoundsVisitor>
 #include <osg/MatrixTransform>
 #include <osg/UserDataContainer>
+#include <osg/buffered_value>
 #include <osg/LOD>
+#include <osg/Polytope>
 #include <osg/TextureBuffer>
 #include <osgUtil/MeshOptimizers>
 
@@ -43,6 +46,7 @@ using namespace osgEarth::DrawInstanced;
 // Ref: http://sol.gfxile.net/instancing.html
 
 #define POSTEX_TBO_UNIT 5
+#define INDEX_TBO_UNIT  6
 #define TAG_MATRIX_VECTOR "osgEarth::DrawInstanced::MatrixRefVector"
 
 //Uncomment to experiment with instance count adjustment
@@ -119,6 +123,99 @@ namespace
     };
 #endif // USE_INSTANCE_LODS
 
+    /**
+     * Culls the instances of a drawable one at a time against the current
+     * frustum and LOD range, writes the indices of the survivors to a TBO,
+     * and draws only that many instances. The instancing shader looks up
+     * each instance's matrix through that index list.
+     */
+    struct InstanceCullCallback : public osg::Drawable::DrawCallback
+    {
+        InstanceCullCallback(InstanceBounds* bounds, float minRange, float maxRange) :
+            _bounds(bounds), _minRange(minRange), _maxRange(std::min(maxRange, bounds->_maxRange)) { }
+
+        void drawImplementation(osg::RenderInfo& ri, const osg::Drawable* drawable) const
+        {
+            const osg::Geometry* geom = drawable->asGeometry();
+            const std::vector<osg::BoundingSphere>& spheres = _bounds->_spheres;
+            if ( !geom || geom->getNumPrimitiveSets() == 0 || spheres.empty() )
+            {
+                drawable->drawImplementation(ri);
+                return;
+            }
+
+            osg::State& state = *ri.getState();
+
+            // one index list per context, since contexts may draw in parallel
+            PerContext& pc = _pcd[state.getContextID()];
+            if ( !pc._tbo.valid() )
+            {
+                pc._image = new osg::Image();
+                pc._image->setName("osgearth.drawinstanced.index");
+                pc._image->allocateImage(spheres.size(), 1, 1, GL_RED, GL_FLOAT);
+                pc._tbo = new osg::TextureBuffer();
+                pc._tbo->setImage(pc._image.get());
+                pc._tbo->setInternalFormat(GL_R32F);
+            }
+
+            // frustum and eye point in the drawable's local frame:
+            const osg::Matrix& mv = state.getModelViewMatrix();
+            osg::Polytope frustum;
+            frustum.setToUnitFrustum();
+            frustum.transformProvidingInverse(mv * state.getProjectionMatrix());
+            osg::Vec3 eye = osg::Vec3(0,0,0) * osg::Matrix::inverse(mv);
+
+            GLfloat* ptr = reinterpret_cast<GLfloat*>(pc._image->data());
+            unsigned numVisible = 0u;
+            for(unsigned i=0; i<spheres.size(); ++i)
+            {
+                const osg::BoundingSphere& bs = spheres[i];
+                float range = (bs.center() - eye).length();
+                if ( range >= _minRange && range < _maxRange && frustum.contains(bs) )
+                {
+                    ptr[numVisible++] = (GLfloat)i;
+                }
+            }
+
+            if ( numVisible == 0u )
+                return;
+
+            pc._image->dirty();
+            state.applyTextureAttribute(INDEX_TBO_UNIT, pc._tbo.get());
+
+            // the primitive sets are shared by all contexts, so only one
+            // may change their instance counts at a time.
+            Threading::ScopedMutexLock lock(_drawMutex);
+
+            std::vector<int> counts(geom->getNumPrimitiveSets());
+            for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+            {
+                osg::PrimitiveSet* ps = const_cast<osg::PrimitiveSet*>(geom->getPrimitiveSet(p));
+                counts[p] = ps->getNumInstances();
+                ps->setNumInstances(std::min((int)numVisible, counts[p]));
+            }
+
+            drawable->drawImplementation(ri);
+
+            for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+            {
+                const_cast<osg::PrimitiveSet*>(geom->getPrimitiveSet(p))->setNumInstances(counts[p]);
+            }
+        }
+
+        struct PerContext
+        {
+            osg::ref_ptr<osg::TextureBuffer> _tbo;
+            osg::ref_ptr<osg::Image>         _image;
+        };
+
+        osg::ref_ptr<InstanceBounds>         _bounds;
+        float                                _minRange;
+        float                                _maxRange;
+        mutable osg::buffered_object<PerContext> _pcd;
+        mutable Threading::Mutex             _drawMutex;
+    };
+
     struct ModelInstance
     {
         ModelInstance() : objectID( OSGEARTH_OBJECTID_EMPTY ) { }
@@ -146,10 +243,13 @@ namespace
 
 ConvertToDrawInstanced::ConvertToDrawInstanced(unsigned                numInstances,
                                                const osg::BoundingBox& bbox,
-                                               bool                    optimize ) :
+                                               bool                    optimize,
+                                               InstanceBounds*         cullBounds ) :
 _numInstances    ( numInstances ),
 _bbox(bbox),
-_optimize        ( optimize )
+_optimize        ( optimize ),
+_cullBounds      ( cullBounds ),
+_range           ( 0.0f, FLT_MAX )
 {
     setTraversalMode( TRAVERSE_ALL_CHILDREN );
     setNodeMaskOverride( ~0 );
@@ -181,8 +281,15 @@ ConvertToDrawInstanced::apply( osg::Geode& geode )
                 _primitiveSets.push_back( ps );
             }
 
+            if ( _cullBounds.valid() )
+            {
+                geom->setDrawCallback( new InstanceCullCallback(_cullBounds.get(), _range.first, _range.second) );
+            }
 #ifdef USE_INSTANCE_LODS
-            geom->setDrawCallback( new LODCallback() );
+            else
+            {
+                geom->setDrawCallback( new LODCallback() );
+            }
 #endif
         }
     }
@@ -194,6 +301,23 @@ ConvertToDrawInstanced::apply( osg::Geode& geode )
 void
 ConvertToDrawInstanced::apply(osg::LOD& lod)
 {
+    // when culling per instance, keep all the levels and let each instance
+    // pick its own level at draw time.
+    if ( _cullBounds.valid() && lod.getRangeMode() == osg::LOD::DISTANCE_FROM_EYE_POINT )
+    {
+        std::pair<float, float> parentRange = _range;
+        unsigned num = std::min(lod.getNumChildren(), lod.getNumRanges());
+        for(unsigned i=0; i<num; ++i)
+        {
+            _range.first  = std::max(parentRange.first,  lod.getMinRange(i));
+            _range.second = std::min(parentRange.second, lod.getMaxRange(i));
+            lod.setRange(i, 0.0f, FLT_MAX);
+            lod.getChild(i)->accept(*this);
+        }
+        _range = parentRange;
+        return;
+    }
+
     // find the highest LOD:
     int   minIndex = 0;
     float minRange = FLT_MAX;
@@ -232,6 +356,8 @@ DrawInstanced::install(osg::StateSet* stateset)
     pkg.load( vp, pkg.InstancingVertex );
 
     stateset->getOrCreateUniform("oe_di_postex_TBO", osg::Uniform::SAMPLER_BUFFER)->set(POSTEX_TBO_UNIT);
+    stateset->getOrCreateUniform("oe_di_index_TBO", osg::Uniform::SAMPLER_BUFFER)->set(INDEX_TBO_UNIT);
+    stateset->getOrCreateUniform("oe_di_culled", osg::Uniform::BOOL)->set(false);
 
     return true;
 }
@@ -251,11 +377,13 @@ DrawInstanced::remove(osg::StateSet* stateset)
     pkg.unload( vp, pkg.InstancingVertex );
 
     stateset->removeUniform("oe_di_postex_TBO");
+    stateset->removeUniform("oe_di_index_TBO");
+    stateset->removeUniform("oe_di_culled");
 }
 
 
 bool
-DrawInstanced::convertGraphToUseDrawInstanced( osg::Group* parent )
+DrawInstanced::convertGraphToUseDrawInstanced( osg::Group* parent, bool cullInstances, float maxRange )
 {
     if ( !Registry::capabilities().supportsDrawInstanced() )
         return false;
@@ -348,10 +476,28 @@ DrawInstanced::convertGraphToUseDrawInstanced( osg::Group* parent )
 			numInstancesToStore = maxTBOInstancesSize;
 		}
 		
+        // For per-instance culling, bound each instance with a sphere:
+        osg::ref_ptr<InstanceBounds> cullBounds;
+        if ( cullInstances )
+        {
+            cullBounds = new InstanceBounds();
+            cullBounds->_maxRange = maxRange;
+            cullBounds->_spheres.reserve(numInstancesToStore);
+
+            osg::BoundingSphere nodeSphere(nodeBox);
+            for(unsigned m=0; m<numInstancesToStore; ++m)
+            {
+                const osg::Matrix& mat = instances[m].matrix;
+                osg::Vec3d scale = mat.getScale();
+                float s = (float)std::max(scale.x(), std::max(scale.y(), scale.z()));
+                cullBounds->_spheres.push_back(osg::BoundingSphere(nodeSphere.center() * mat, nodeSphere.radius() * s));
+            }
+        }
+
         // Convert the node's primitive sets to use "draw-instanced" rendering; at the
         // same time, assign our computed bounding box as the static bounds for all
         // geometries. (As DI's they cannot report bounds naturally.)
-        ConvertToDrawInstanced cdi(numInstancesToStore, bbox, true);
+        ConvertToDrawInstanced cdi(numInstancesToStore, bbox, true, cullBounds.get());
         node->accept( cdi );
 		
         // Assign matrix vectors to the node, so the application can easily retrieve
@@ -412,6 +558,10 @@ DrawInstanced::convertGraphToUseDrawInstanced( osg::Group* parent )
         osg::StateSet* stateset = instanceGroup->getOrCreateStateSet();
         stateset->setTextureAttribute(POSTEX_TBO_UNIT, posTBO);
 
+        // tell the shader to draw through the culled index list.
+        if ( cullInstances )
+            stateset->addUniform(new osg::Uniform("oe_di_culled", true));
+
 		// add the node as a child:
         instanceGroup->addChild( node );
 
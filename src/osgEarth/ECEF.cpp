@@ -66,6 +66,79 @@ ECEF::createLocalToWorld( const osg::Vec3d& input )
     return localToWorld;
 }
 
+void
+ECEF::transformToECEF(const osg::EllipsoidModel* em,
+                      const osg::Vec3d*          input,
+                      osg::Vec3d*                output,
+                      unsigned                   count,
+                      osg::Vec3d*                output_up)
+{
+    // same math as EllipsoidModel::convertLatLongHeightToXYZ, with the
+    // ellipsoid terms hoisted out of the loop.
+    const double a   = em->getRadiusEquator();
+    const double b   = em->getRadiusPolar();
+    const double e2  = (a*a - b*b) / (a*a);
+    const double d2r = osg::PI / 180.0;
+
+    for( unsigned i=0; i<count; ++i )
+    {
+        double lat = input[i].y() * d2r, lon = input[i].x() * d2r, hae = input[i].z();
+        double sin_lat = sin(lat), cos_lat = cos(lat);
+        double sin_lon = sin(lon), cos_lon = cos(lon);
+        double N = a / sqrt(1.0 - e2*sin_lat*sin_lat);
+        double r = (N + hae) * cos_lat;
+
+        output[i].set( r * cos_lon, r * sin_lon, (N*(1.0-e2) + hae) * sin_lat );
+
+        if ( output_up )
+            output_up[i].set( cos_lat * cos_lon, cos_lat * sin_lon, sin_lat );
+    }
+}
+
+void
+ECEF::transformFromECEF(const osg::EllipsoidModel* em,
+                        const osg::Vec3d*          input,
+                        osg::Vec3d*                output,
+                        unsigned                   count)
+{
+    const double a   = em->getRadiusEquator();
+    const double b   = em->getRadiusPolar();
+    const double e2  = (a*a - b*b) / (a*a);
+    const double r2d = 180.0 / osg::PI;
+
+    // 1e-13 radians is well under a micrometer on the surface.
+    const double epsilon = 1e-13;
+    const int    maxIterations = 10;
+
+    for( unsigned i=0; i<count; ++i )
+    {
+        double x = input[i].x(), y = input[i].y(), z = input[i].z();
+        double p = sqrt(x*x + y*y);
+
+        // start from the spherical-ish estimate and iterate
+        // lat = atan2(z + e2*N*sin(lat), p); converges in a few steps.
+        double lat = atan2(z, p*(1.0 - e2));
+        for( int k=0; k<maxIterations; ++k )
+        {
+            double sin_lat = sin(lat);
+            double N = a / sqrt(1.0 - e2*sin_lat*sin_lat);
+            double next = atan2(z + e2*N*sin_lat, p);
+            bool done = fabs(next - lat) < epsilon;
+            lat = next;
+            if ( done )
+                break;
+        }
+
+        double sin_lat = sin(lat), cos_lat = cos(lat);
+
+        // well-conditioned everywhere, including at the poles:
+        double hae = p*cos_lat + z*sin_lat - a*sqrt(1.0 - e2*sin_lat*sin_lat);
+        double lon = atan2(y, x);
+
+        output[i].set( lon * r2d, lat * r2d, hae );
+    }
+}
+
 void
 ECEF::transformAndLocalize(const osg::Vec3d&       input,
                            const SpatialReference* inputSRS,
@@ -90,12 +163,13 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
     const SpatialReference* ecefSRS = outputSRS->getECEF();
     output->reserve( output->size() + input.size() );
 
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
+    // one bulk transform instead of one per point
+    std::vector<osg::Vec3d> ecef( input );
+    inputSRS->transform( ecef, ecefSRS );
+
+    for( std::vector<osg::Vec3d>::const_iterator i = ecef.begin(); i != ecef.end(); ++i )
     {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        //inputSRS->transformToECEF( *i, ecef );
-        output->push_back( ecef * world2local );
+        output->push_back( (*i) * world2local );
     }
 }
 
@@ -110,12 +184,14 @@ ECEF::transformAndLocalize(const std::vector<osg::Vec3d>& input,
 {
     const SpatialReference* ecefSRS = outputSRS->getECEF();
     out_verts->reserve( out_verts->size() + input.size() );
-    
-    for( std::vector<osg::Vec3d>::const_iterator i = input.begin(); i != input.end(); ++i )
+
+    // one bulk transform instead of one per point
+    std::vector<osg::Vec3d> ecef( input );
+    inputSRS->transform( ecef, ecefSRS );
+
+    for( std::vector<osg::Vec3d>::const_iterator i = ecef.begin(); i != ecef.end(); ++i )
     {
-        osg::Vec3d ecef;
-        inputSRS->transform( *i, ecefSRS, ecef );
-        out_verts->push_back( ecef * world2local );
+        out_verts->push_back( (*i) * world2local );
     }
 
     if ( out_normals )
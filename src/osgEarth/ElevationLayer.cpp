@@ -23,8 +23,13 @@
 #include <osgEarth/MemCache>
 #include <osgEarth/Metrics>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/Registry>
 #include <osg/Version>
 #include <iterator>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -70,6 +75,7 @@ ElevationLayerOptions::setDefaults()
 {
     _offset.init( false );
     _noDataPolicy.init( NODATA_INTERPOLATE );
+    _quantizeMemCache.init( false );
 }
 
 Config
@@ -82,6 +88,7 @@ ElevationLayerOptions::getConfig() const
     conf.set("nodata_policy", "default",     _noDataPolicy, NODATA_INTERPOLATE );
     conf.set("nodata_policy", "interpolate", _noDataPolicy, NODATA_INTERPOLATE );
     conf.set("nodata_policy", "msl",         _noDataPolicy, NODATA_MSL );
+    conf.set("quantize_mem_cache", _quantizeMemCache);
 
     //if (driver().isSet())
     //    conf.set("driver", driver()->getDriver());
@@ -96,6 +103,7 @@ ElevationLayerOptions::fromConfig( const Config& conf )
     conf.getIfSet("nodata_policy", "default",     _noDataPolicy, NODATA_INTERPOLATE );
     conf.getIfSet("nodata_policy", "interpolate", _noDataPolicy, NODATA_INTERPOLATE );
     conf.getIfSet("nodata_policy", "msl",         _noDataPolicy, NODATA_MSL );
+    conf.getIfSet("quantize_mem_cache", _quantizeMemCache);
 }
 
 void
@@ -161,6 +169,51 @@ namespace
         
         return true;
     }    
+
+    // Packs a heightfield into a 16-bit image for the memory cache; the
+    // dequantization parameters go in the record's metadata.
+    osg::Image* quantizeForMemCache(const osg::HeightField* hf, Config& meta)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(hf->getNumColumns(), hf->getNumRows(), 1, GL_LUMINANCE, GL_UNSIGNED_SHORT);
+
+        float offset, scale;
+        HeightFieldUtils::quantizeHeights(hf, reinterpret_cast<unsigned short*>(image->data()), offset, scale);
+        meta.set("q16_offset", (double)offset);
+        meta.set("q16_scale", (double)scale);
+        return image;
+    }
+
+    // Reads a memory cache record, which holds either a heightfield or
+    // a quantized image from quantizeForMemCache.
+    osg::HeightField* readMemCacheRecord(ReadResult& r, const TileKey& key)
+    {
+        osg::Image* image = r.get<osg::Image>();
+        if ( !image )
+        {
+            return r.release<osg::HeightField>();
+        }
+
+        if ( image->getDataType() != GL_UNSIGNED_SHORT || !r.metadata().hasValue("q16_scale") )
+            return 0L;
+
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(image->s(), image->t());
+        HeightFieldUtils::dequantizeHeights(
+            reinterpret_cast<const unsigned short*>(image->data()),
+            image->s()*image->t(),
+            r.metadata().value<double>("q16_offset", 0.0),
+            r.metadata().value<double>("q16_scale", 0.0),
+            &hf->getFloatArray()->front());
+
+        double minx, miny, maxx, maxy;
+        key.getExtent().getBounds(minx, miny, maxx, maxy);
+        hf->setOrigin( osg::Vec3d( minx, miny, 0.0 ) );
+        hf->setXInterval( (maxx - minx)/(double)(hf->getNumColumns()-1) );
+        hf->setYInterval( (maxy - miny)/(double)(hf->getNumRows()-1) );
+        hf->setBorderWidth( 0 );
+        return hf;
+    }
 }
 
 //------------------------------------------------------------------------
@@ -211,6 +264,8 @@ ElevationLayer::init()
     // elevation layers do not render directly; rather, a composite of elevation data
     // feeds the terrain engine to permute the mesh.
     setRenderType(RENDERTYPE_NONE);
+
+    _fallbacks.setMaxSize(48u);
 }
 
 bool
@@ -273,6 +328,15 @@ ElevationLayer::createHeightFieldFromTileSource(const TileKey&    key,
             return 0L;
         }
 
+        // Without a caller's progress callback, use our own so we can still
+        // tell a transient failure (needsRetry) from a tile that has no data.
+        osg::ref_ptr<ProgressCallback> localProgress;
+        if ( progress == 0L )
+        {
+            localProgress = new ProgressCallback();
+            progress = localProgress.get();
+        }
+
         // Make it from the source:
         result = source->createHeightField( key, getOrCreatePreCacheOp(), progress );
    
@@ -294,10 +358,9 @@ ElevationLayer::createHeightFieldFromTileSource(const TileKey&    key,
         // we can't get it and it wasn't cancelled
         if (!result.valid())
         {
-            if ( progress == 0L ||
-                 ( !progress->isCanceled() && !progress->needsRetry() ) )
+            if ( !progress->isCanceled() && !progress->needsRetry() )
             {
-                source->getBlacklist()->add( key );
+                source->blacklist( key );
             }
         }
     }
@@ -426,6 +489,60 @@ ElevationLayer::createHeightField(const TileKey&    key,
                      "key", key.str().c_str(),
                      "name", getName().c_str());
 
+    // The terrain, ElevationPool and ElevationQuery frequently want the same
+    // key at the same time; only one of them builds it and the rest share it.
+    std::string flightKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
+    for(;;)
+    {
+        GeoHeightField result;
+        Threading::SingleFlight<std::string, GeoHeightField>::Scope flight( _heightFieldsInFlight, flightKey, result );
+
+        if ( flight.isLeader() )
+        {
+            result = createHeightFieldInKeyProfile( key, progress );
+            if ( progress && progress->isCanceled() )
+                flight.abandon();
+            return result;
+        }
+
+        // callers may modify the heightfield, so each follower gets its own
+        // copy. (NormalMap can't be cloned; it's only read after creation.)
+        if ( !flight.wasAbandoned() )
+        {
+            if ( !result.valid() )
+                return result;
+            return GeoHeightField(
+                osg::clone(result.getHeightField(), osg::CopyOp::DEEP_COPY_ALL),
+                result.getNormalMap(),
+                result.getExtent() );
+        }
+
+        if ( progress && progress->isCanceled() )
+            return GeoHeightField::INVALID;
+    }
+}
+
+GeoHeightField
+ElevationLayer::getFallbackHeightField(const TileKey&    key,
+                                       ProgressCallback* progress)
+{
+    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
+
+    FallbackCache::Record rec;
+    if ( _fallbacks.get(cacheKey, rec) )
+        return rec.value();
+
+    GeoHeightField result = createHeightField( key, progress );
+    if ( result.valid() )
+        _fallbacks.insert( cacheKey, result );
+
+    return result;
+}
+
+GeoHeightField
+ElevationLayer::createHeightFieldInKeyProfile(const TileKey&    key,
+                                              ProgressCallback* progress )
+{
     if (getStatus().isError())
     {
         return GeoHeightField::INVALID;
@@ -444,6 +561,9 @@ ElevationLayer::createHeightField(const TileKey&    key,
     // Check the memory cache first
     bool fromMemCache = false;
 
+    // persistent bin the new heightfield went into, if any
+    CacheBin* writtenToBin = 0L;
+
     // cache key combines the key with the full signature (incl vdatum)
     std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
@@ -454,11 +574,12 @@ ElevationLayer::createHeightField(const TileKey&    key,
         ReadResult cacheResult = bin->readObject(cacheKey, 0L);
         if ( cacheResult.succeeded() )
         {
-            result = GeoHeightField(
-                static_cast<osg::HeightField*>(cacheResult.releaseObject()),
-                key.getExtent());
-
-            fromMemCache = true;
+            osg::ref_ptr<osg::HeightField> memHF = readMemCacheRecord(cacheResult, key);
+            if ( memHF.valid() )
+            {
+                result = GeoHeightField(memHF.get(), key.getExtent());
+                fromMemCache = true;
+            }
         }
     }
 
@@ -498,6 +619,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
         if ( cacheBin && policy.isCacheReadable() )
         {
             ReadResult r = cacheBin->readObject(cacheKey, 0L);
+            countCacheRead( r.succeeded() );
             if ( r.succeeded() )
             {            
                 bool expired = policy.isExpired(r.lastModifiedTime());
@@ -557,6 +679,7 @@ ElevationLayer::createHeightField(const TileKey&    key,
                  policy.isCacheWriteable() )
             {
                 cacheBin->write(cacheKey, hf, 0L);
+                writtenToBin = cacheBin;
             }
 
             // We have an expired heightfield from the cache and no new data from the TileSource.  So just return the cached data.
@@ -592,7 +715,16 @@ ElevationLayer::createHeightField(const TileKey&    key,
     if ( result.valid() && !fromMemCache && _memCache.valid() )
     {
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        bin->write(cacheKey, result.getHeightField(), 0L);
+        if ( options().quantizeMemCache() == true )
+        {
+            Config meta;
+            osg::ref_ptr<osg::Image> quantized = quantizeForMemCache(result.getHeightField(), meta);
+            bin->write(cacheKey, quantized.get(), meta, 0L);
+        }
+        else
+        {
+            bin->write(cacheKey, result.getHeightField(), 0L);
+        }
     }
 
     // post-processing:
@@ -620,11 +752,273 @@ ElevationLayer::createHeightField(const TileKey&    key,
                 NO_DATA_VALUE,
                 geoid );
         }
+
+        // remember the extrema so the engine can bound this tile without the data:
+        if ( !fromMemCache )
+        {
+            recordExtrema( key, result.getHeightField(), writtenToBin );
+        }
     }
 
     return result;
 }
 
+namespace
+{
+    std::string extremaCacheKey(const TileKey& key)
+    {
+        return Stringify() << "_extrema_" << key.str() << "_" << key.getProfile()->getFullSignature();
+    }
+
+    // Records kept in memory, and how many dirty records to collect
+    // before writing them back to the cache bin.
+    const unsigned MAX_EXTREMA_RECORDS = 16384u;
+    const unsigned EXTREMA_WRITE_BATCH = 64u;
+
+    // How many levels up getExtrema looks for a record.
+    const unsigned MAX_EXTREMA_FALLBACK = 2u;
+}
+
+ElevationLayer::~ElevationLayer()
+{
+    writeExtrema();
+}
+
+void
+ElevationLayer::recordExtrema(const TileKey&          key,
+                              const osg::HeightField* hf,
+                              CacheBin*               cacheBin)
+{
+    if ( !hf )
+        return;
+
+    Extrema e;
+    const osg::HeightField::HeightList& heights = hf->getHeightList();
+    for(osg::HeightField::HeightList::const_iterator h = heights.begin(); h != heights.end(); ++h)
+    {
+        if ( *h != NO_DATA_VALUE )
+        {
+            e._min = std::min(e._min, *h);
+            e._max = std::max(e._max, *h);
+        }
+    }
+
+    if ( !e.valid() )
+        return;
+
+    // Bring the stored records of the key, its ancestors and its children
+    // into memory first (reading the cache bin as needed, without the lock).
+    // Widening below then keeps what earlier runs recorded, and the engine
+    // can bound the children from memory once it creates them.
+    for(TileKey k = key; k.valid(); k = k.createParentKey())
+    {
+        Extrema stored;
+        if ( !readExtrema(k, stored, true) && k != key )
+            break;
+    }
+    for(unsigned q = 0; q < 4; ++q)
+    {
+        Extrema stored;
+        readExtrema(key.createChildKey(q), stored, true);
+    }
+
+    bool writeBack = false;
+    {
+        Threading::ScopedMutexLock lock( _extremaMutex );
+
+        // Take in the children's records, which may predate this one.
+        for(unsigned q = 0; q < 4; ++q)
+        {
+            TileKey child = key.createChildKey(q);
+            ExtremaTable::const_iterator rec = _extrema.find( ExtremaKey(child.getLOD(), extremaCacheKey(child)) );
+            if ( rec != _extrema.end() && rec->second.valid() )
+            {
+                e._min = std::min(e._min, rec->second._min);
+                e._max = std::max(e._max, rec->second._max);
+            }
+        }
+
+        // Records only ever grow, since a descendant may have widened this one.
+        // Then widen the ancestors so that each record bounds its whole subtree.
+        TileKey k = key;
+        bool changed = true;
+        while ( k.valid() && changed )
+        {
+            ExtremaKey extremaKey( k.getLOD(), extremaCacheKey(k) );
+
+            ExtremaTable::iterator rec = _extrema.find( extremaKey );
+            if ( rec != _extrema.end() && rec->second.valid() )
+            {
+                const Extrema& old = rec->second;
+                changed = e._min < old._min || e._max > old._max;
+                e._min = std::min(e._min, old._min);
+                e._max = std::max(e._max, old._max);
+            }
+            else if ( k != key )
+            {
+                // nothing to widen above here.
+                break;
+            }
+
+            if ( changed )
+            {
+                _extrema[extremaKey] = e;
+                _extremaDirty.insert( extremaKey );
+            }
+
+            k = k.createParentKey();
+        }
+
+        if ( cacheBin )
+            _extremaBin = cacheBin;
+
+        writeBack = _extremaDirty.size() >= EXTREMA_WRITE_BATCH;
+
+        trimExtrema();
+    }
+
+    if ( writeBack )
+    {
+        writeExtrema();
+    }
+}
+
+void
+ElevationLayer::writeExtrema()
+{
+    std::vector< std::pair<std::string, Extrema> > batch;
+    osg::ref_ptr<CacheBin> cacheBin;
+    {
+        Threading::ScopedMutexLock lock( _extremaMutex );
+        cacheBin = _extremaBin.get();
+        if ( cacheBin.valid() )
+        {
+            batch.reserve( _extremaDirty.size() );
+            for(std::set<ExtremaKey>::const_iterator i = _extremaDirty.begin(); i != _extremaDirty.end(); ++i)
+            {
+                ExtremaTable::const_iterator rec = _extrema.find( *i );
+                if ( rec != _extrema.end() )
+                    batch.push_back( std::make_pair(i->second, rec->second) );
+            }
+        }
+        _extremaDirty.clear();
+    }
+
+    for(unsigned i = 0; i < batch.size(); ++i)
+    {
+        const Extrema& e = batch[i].second;
+        std::string value = Stringify() << std::setprecision(9) << e._min << " " << e._max;
+        osg::ref_ptr<StringObject> obj = new StringObject(value);
+        cacheBin->write(batch[i].first, obj.get(), 0L);
+    }
+}
+
+void
+ElevationLayer::trimExtrema() const
+{
+    // ASSUME _extremaMutex is locked.
+    // Drop from the finest LOD up; dirty records stay until they're written.
+    ExtremaTable::iterator i = _extrema.end();
+    while ( _extrema.size() > MAX_EXTREMA_RECORDS && i != _extrema.begin() )
+    {
+        --i;
+        if ( _extremaDirty.find(i->first) == _extremaDirty.end() )
+            _extrema.erase( i++ );
+    }
+}
+
+bool
+ElevationLayer::readExtrema(const TileKey& key, Extrema& out, bool readCache) const
+{
+    ExtremaKey extremaKey( key.getLOD(), extremaCacheKey(key) );
+
+    {
+        Threading::ScopedMutexLock lock( _extremaMutex );
+        ExtremaTable::const_iterator rec = _extrema.find( extremaKey );
+        if ( rec != _extrema.end() )
+        {
+            out = rec->second;
+            return out.valid();
+        }
+    }
+
+    if ( !readCache )
+        return false;
+
+    Extrema e;
+
+    CacheSettings* cacheSettings = getCacheSettings();
+    if ( cacheSettings && cacheSettings->isCacheEnabled() && cacheSettings->cachePolicy()->isCacheReadable() )
+    {
+        CacheBin* cacheBin = const_cast<ElevationLayer*>(this)->getCacheBin( key.getProfile() );
+        if ( cacheBin )
+        {
+            ReadResult r = cacheBin->readString(extremaKey.second, 0L);
+            if ( r.succeeded() )
+            {
+                float min, max;
+                if ( sscanf(r.getString().c_str(), "%f %f", &min, &max) == 2 )
+                {
+                    e = Extrema(min, max);
+                }
+            }
+        }
+    }
+
+    // store misses too, so the cache bin is only consulted once per key.
+    // (A record made while we read the bin wins.)
+    Threading::ScopedMutexLock lock( _extremaMutex );
+    std::pair<ExtremaTable::iterator, bool> ins = _extrema.insert( std::make_pair(extremaKey, e) );
+    out = ins.first->second;
+    trimExtrema();
+    return out.valid();
+}
+
+bool
+ElevationLayer::findExtrema(const TileKey& key, Extrema& out, bool readCache) const
+{
+    if ( getStatus().isError() || !getEnabled() )
+        return false;
+
+    unsigned levels = 0u;
+    for(TileKey k = key; k.valid() && levels <= MAX_EXTREMA_FALLBACK; k = k.createParentKey(), ++levels)
+    {
+        if ( readExtrema(k, out, readCache) )
+            return true;
+    }
+    return false;
+}
+
+bool
+ElevationLayer::getExtrema(const TileKey& key, float& out_min, float& out_max) const
+{
+    Extrema e;
+    if ( !findExtrema(key, e, true) )
+        return false;
+
+    out_min = e._min;
+    out_max = e._max;
+    return true;
+}
+
+void
+ElevationLayer::modifyTileBoundingBox(const TileKey& key, osg::BoundingBox& box) const
+{
+    // Offsets are relative to other layers, so they say nothing about the
+    // absolute height of the tile.
+    if ( isOffset() )
+        return;
+
+    // This runs during cull and update, so only consult the records already
+    // in memory; recordExtrema brings them in on the loading thread.
+    Extrema e;
+    if ( findExtrema(key, e, false) )
+    {
+        box.zMin() = std::min(box.zMin(), e._min);
+        box.zMax() = std::max(box.zMax(), e._max);
+    }
+}
+
 
 //------------------------------------------------------------------------
 
@@ -643,6 +1037,29 @@ osg::MixinVector< osg::ref_ptr<ElevationLayer> >( rhs )
     //nop
 }
 
+bool
+ElevationLayerVector::getExtrema(const TileKey& key,
+                                 float&         out_min,
+                                 float&         out_max) const
+{
+    bool found = false;
+    for(const_iterator i = begin(); i != end(); ++i)
+    {
+        ElevationLayer* layer = i->get();
+        if ( layer && layer->getEnabled() && !layer->isOffset() )
+        {
+            float min, max;
+            if ( layer->getExtrema(key, min, max) )
+            {
+                out_min = found ? std::min(out_min, min) : min;
+                out_max = found ? std::max(out_max, max) : max;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
 
 
 namespace
@@ -652,10 +1069,72 @@ namespace
         RefElevationLayer layer;
         TileKey key;
         int index;
+        bool isFallback;
     };
     //typedef std::pair<RefElevationLayer, TileKey> LayerAndKey;
     typedef std::vector<LayerData>              LayerDataVector;
 
+    // Composite fetches share the registry's thread budget under this UID.
+    TaskService* getCompositeService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    // Whether the layer reports data covering the whole of an extent.
+    // Layers that report no data extents at all might not.
+    bool coversExtent(const ElevationLayer* layer, const GeoExtent& extent)
+    {
+        const DataExtentList& dataExtents = layer->getDataExtents();
+        for (DataExtentList::const_iterator de = dataExtents.begin(); de != dataExtents.end(); ++de)
+        {
+            if (de->contains(extent.transform(de->getSRS())))
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * A set of heightfields to fetch in parallel.
+     */
+    struct HeightFieldFetch : public ParallelJobs
+    {
+        struct Item
+        {
+            RefElevationLayer _layer;
+            TileKey           _key;
+            bool              _useAncestors; // fall back on parent keys
+            bool              _isFallback;   // the key is already an ancestor
+            unsigned          _slot;         // index in the contenders or offsets
+            GeoHeightField    _result;
+            TileKey           _actualKey;
+        };
+
+        std::vector<Item> _items;
+        ProgressCallback* _progress;
+
+        HeightFieldFetch(ProgressCallback* progress) : _progress(progress) { }
+
+        void runJob(unsigned i)
+        {
+            Item& item = _items[i];
+            for (item._actualKey = item._key; item._actualKey.valid(); item._actualKey = item._actualKey.createParentKey())
+            {
+                // ancestor data is shared by all the children that need it.
+                item._result = (item._isFallback || item._actualKey != item._key) ?
+                    item._layer->getFallbackHeightField(item._actualKey, _progress) :
+                    item._layer->createHeightField(item._actualKey, _progress);
+                if (item._result.valid() || !item._useAncestors)
+                    break;
+            }
+        }
+
+        void run()
+        {
+            ParallelJobs::run(_items.size(), _items.size() > 1u ? getCompositeService() : 0L);
+        }
+    };
+
     //! Gets the normal vector for elevation data at column s, row t.
     osg::Vec3 getNormal(const GeoExtent& extent, const osg::HeightField* hf, int s, int t)
     {
@@ -854,6 +1333,7 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                     ld.layer = layer;
                     ld.key = bestKey;
                     ld.index = i;
+                    ld.isFallback = (mappedKey != bestKey);
                 }
                 else
                 {
@@ -862,6 +1342,7 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                     ld.layer = layer;
                     ld.key = bestKey;
                     ld.index = i;
+                    ld.isFallback = (mappedKey != bestKey);
                 }
             }
         }
@@ -909,6 +1390,7 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
 #else
     GeoHeightFieldVector heightFields[9];
     GeoHeightFieldVector offsetFields[9]; //(offsets.size());
+    std::vector<TileKey> heightKeys[9];   // key each heightfield actually came from
     std::vector<bool>    heightFallback[9]; //(contenders.size(), false);
     std::vector<bool>    heightFailed[9]; //(contenders.size(), false);
     std::vector<bool>    offsetFailed[9]; //(offsets.size(), false);
@@ -917,9 +1399,10 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
     {
         heightFields[n].resize(contenders.size());
         offsetFields[n].resize(offsets.size());
-        heightFallback[n].assign(9, false);
-        heightFailed[n].assign(9, false);
-        offsetFailed[n].assign(9, false);
+        heightKeys[n].resize(contenders.size());
+        heightFallback[n].assign(contenders.size(), false);
+        heightFailed[n].assign(contenders.size(), false);
+        offsetFailed[n].assign(offsets.size(), false);
     }
 #endif
 
@@ -927,6 +1410,74 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
     unsigned int maxHeightFields = 50;
     unsigned numHeightFieldsInCache = 0;
 
+    // Fetch the center tiles we are sure to need concurrently instead of one
+    // at a time as the sampling reaches them. That's every contender down to
+    // the first one with full-resolution data covering the whole tile (any
+    // below it only fill holes), plus the offsets above that one. Anything
+    // else still loads on demand below.
+    {
+        osg::ref_ptr<HeightFieldFetch> fetch = new HeightFieldFetch(progress);
+
+        int coveringIndex = -1;
+        for (unsigned i = 0; i < contenders.size() && coveringIndex < 0; ++i)
+        {
+            fetch->_items.push_back(HeightFieldFetch::Item());
+            HeightFieldFetch::Item& item = fetch->_items.back();
+            item._layer = contenders[i].layer;
+            item._key = contenders[i].key;
+            item._useAncestors = true;
+            item._isFallback = contenders[i].isFallback;
+            item._slot = i;
+
+            if (!contenders[i].isFallback && coversExtent(contenders[i].layer.get(), contenders[i].key.getExtent()))
+                coveringIndex = contenders[i].index;
+        }
+
+        unsigned numContenderItems = fetch->_items.size();
+        for (unsigned i = 0; i < offsets.size(); ++i)
+        {
+            if (offsets[i].index >= coveringIndex)
+            {
+                fetch->_items.push_back(HeightFieldFetch::Item());
+                HeightFieldFetch::Item& item = fetch->_items.back();
+                item._layer = offsets[i].layer;
+                item._key = offsets[i].key;
+                item._useAncestors = false;
+                item._isFallback = offsets[i].isFallback;
+                item._slot = i;
+            }
+        }
+
+        fetch->run();
+
+        for (unsigned j = 0; j < fetch->_items.size(); ++j)
+        {
+            const HeightFieldFetch::Item& item = fetch->_items[j];
+            unsigned i = item._slot;
+            if (j < numContenderItems)
+            {
+                if (item._result.valid())
+                {
+                    heightFields[4][i] = item._result;
+                    heightKeys[4][i] = item._actualKey;
+                    heightFallback[4][i] = (item._actualKey != item._key);
+                    numHeightFieldsInCache++;
+                }
+                else
+                {
+                    heightFailed[4][i] = true;
+                }
+            }
+            else
+            {
+                if (item._result.valid())
+                    offsetFields[4][i] = item._result;
+                else
+                    offsetFailed[4][i] = true;
+            }
+        }
+    }
+
     const SpatialReference* keySRS = keyToUse.getProfile()->getSRS();
 
     bool realData = false;
@@ -983,7 +1534,9 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                     // We also fallback on parent layers to make sure that we have data at the location even if it's fallback.
                     while (!layerHF.valid() && actualKey.valid())
                     {
-                        layerHF = layer->createHeightField(actualKey, progress);
+                        layerHF = (contenders[i].isFallback || actualKey != contenderKey) ?
+                            layer->getFallbackHeightField(actualKey, progress) :
+                            layer->createHeightField(actualKey, progress);
                         if (!layerHF.valid())
                         {
                             actualKey = actualKey.createParentKey();
@@ -994,6 +1547,7 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                     if (layerHF.valid())
                     {
                         heightFallback[n][i] = (actualKey != contenderKey); // actualKey != contenders[i].second;
+                        heightKeys[n][i] = actualKey;
                         numHeightFieldsInCache++;
                     }
                     else
@@ -1002,6 +1556,10 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                         continue;
                     }
                 }
+                else
+                {
+                    actualKey = heightKeys[n][i];
+                }
 
                 if (layerHF.valid())
                 {
@@ -1083,7 +1641,9 @@ ElevationLayerVector::populateHeightFieldAndNormalMap(osg::HeightField*      hf,
                 {
                     ElevationLayer* offset = offsets[i].layer.get();
 
-                    layerHF = offset->createHeightField(contenderKey, progress);
+                    layerHF = offsets[i].isFallback ?
+                        offset->getFallbackHeightField(contenderKey, progress) :
+                        offset->createHeightField(contenderKey, progress);
                     if ( !layerHF.valid() )
                     {
                         offsetFailed[n][i] = true;
@@ -22,6 +22,7 @@
 #include <osgEarth/Map>
 #include <osgEarth/Metrics>
 #include <osgEarth/Registry>
+#include <osgEarth/Memory>
 #include <osg/Shape>
 
 using namespace osgEarth;
@@ -32,8 +33,7 @@ using namespace osgEarth;
 
 
 ElevationPool::ElevationPool() :
-_entries(0u),
-_maxEntries( 128u ),
+_tiles( true, 128u, 16u, Tiles::POLICY_CLOCK ),
 _tileSize( 257u )
 {
     //nop
@@ -62,32 +62,31 @@ ElevationPool::~ElevationPool()
 void
 ElevationPool::setMap(const Map* map)
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
+    Threading::ScopedMutexLock lock(_mutex);
     _map = map;
-    clearImpl();
+    _tiles.clear();
 }
 
 void
 ElevationPool::clear()
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
-    clearImpl();
+    _tiles.clear();
 }
 
 void
 ElevationPool::setElevationLayers(const ElevationLayerVector& layers)
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
+    Threading::ScopedMutexLock lock(_mutex);
     _layers = layers;
-    clearImpl();
+    _tiles.clear();
 }
 
 void
 ElevationPool::setTileSize(unsigned value)
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
+    Threading::ScopedMutexLock lock(_mutex);
     _tileSize = value;
-    clearImpl();
+    _tiles.clear();
 }
 
 Future<ElevationSample>
@@ -147,6 +146,9 @@ ElevationPool::fetchTileFromMap(const TileKey& key, MapFrame& frame, Tile* tile)
         {
             tile->_hf = GeoHeightField( hf.get(), keyToUse.getExtent() );
             tile->_bounds = keyToUse.getExtent().bounds();
+
+            // charged until the tile leaves the cache and every envelope using it
+            Memory::charge( Memory::ELEVATION_POOL, tile, Memory::estimateSize(hf.get()) );
         }
         else
         {
@@ -157,167 +159,79 @@ ElevationPool::fetchTileFromMap(const TileKey& key, MapFrame& frame, Tile* tile)
     return tile->_hf.valid();
 }
 
-void
-ElevationPool::popMRU()
-{
-    // first rememeber the key of the item we're about the pop:
-    TileKey key = _mru.back()->_key;
-
-    // establish a temporary observer on the item:
-    osg::observer_ptr<Tile> temp = _mru.back().get();
-
-    // pop the Tile from the MRU:
-    _mru.pop_back();
-
-    // if our observer went to NULL, we know there are no more pointers
-    // to that Tile in the MRU, and we can remove it from the main list:
-    if (!temp.valid())
-    {
-        _tiles.erase(key);
-    }
-}
-
 bool
-ElevationPool::tryTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<Tile>& out)
+ElevationPool::getTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<ElevationPool::Tile>& output)
 {
-    // first see whether the tile is available
-    _tilesMutex.lock();
-
-    // locate the tile in the local tile cache:
-    osg::observer_ptr<Tile>& tile_obs = _tiles[key];
-
-    osg::ref_ptr<Tile> tile;
-
-    // Get a safe pointer to it. If this is NULL, we need to create and
-    // fetch a new tile from the Map.
-    if (!tile_obs.lock(tile))
+    // Synchronize the MapFrame to its Map; if there's an update,
+    // clear out the internal cache.
+    if ( frame.needsSync() )
     {
-        // a new tile; status -> EMPTY
-        tile = new Tile();
-        tile->_key = key;
-
-        // update the LRU:
-        _mru.push_front(tile.get());
-
-        // prune the MRU if necessary:
-        if (++_entries > _maxEntries )
+        if (frame.sync())
         {
-            popMRU();
-            --_entries;
+            // Probably unnecessary because the Map itself will clear the pool.
+            clear();
         }
-
-        // add to the main cache (after putting it on the LRU).
-        tile_obs = tile;
     }
-       
-    // This means the tile object exists but has yet to be populated:
-    if ( tile->_status == STATUS_EMPTY )
-    {
-        OE_TEST << "  getTile(" << key.str() << ") -> fetch from map\n";
-        tile->_status.exchange(STATUS_IN_PROGRESS);
-        _tilesMutex.unlock();
 
-        bool ok = fetchTileFromMap(key, frame, tile.get());
-        tile->_status.exchange( ok ? STATUS_AVAILABLE : STATUS_FAIL );
-        
-        out = ok ? tile.get() : 0L;
-        return ok;
-    }
+    osg::ref_ptr<Tile> tile;
+    bool fetch = false;
 
-    // This means the tile object is populated and available for use:
-    else if ( tile->_status == STATUS_AVAILABLE )
+    // The common case is a hit, which costs one short shard lock:
+    Tiles::Record rec;
+    if (_tiles.get(key, rec))
     {
-        OE_TEST << "  getTile(" << key.str() << ") -> available\n";
-        out = tile.get();
-
-        // Mark this tile as recently used:
-        _mru.push_front(tile.get());
-
-        // prune the MRU if necessary
-        if (++_entries > _maxEntries)
-        {
-            popMRU();
-            --_entries;
-        }
-
-        _tilesMutex.unlock();
-        return true;
+        tile = rec.value();
     }
-
-    // This means the attempt to populate the tile with data failed.
-    else if ( tile->_status == STATUS_FAIL )
+    else
     {
-        OE_TEST << "  getTile(" << key.str() << ") -> fail\n";
-        _tilesMutex.unlock();
-        out = 0L;
-        return false;
+        // A miss. Race to install a placeholder; the winner fetches the tile
+        // outside the lock and everyone else waits on it.
+        osg::ref_ptr<Tile> placeholder = new Tile();
+        placeholder->_key = key;
+        placeholder->_status.exchange(STATUS_IN_PROGRESS);
+
+        fetch = _tiles.getOrInsert(key, placeholder.get(), rec);
+        tile = rec.value();
     }
 
-    // This means tile data fetch is still in progress (in another thread)
-    // and the caller should check back later.
-    else //if ( tile->_status == STATUS_IN_PROGRESS )
+    if (fetch)
     {
-        OE_DEBUG << "  getTile(" << key.str() << ") -> in progress...waiting\n";
-        _tilesMutex.unlock();
-        out = 0L;
-        return true;            // out:NULL => check back later please.
+        OE_TEST << "  getTile(" << key.str() << ") -> fetch from map\n";
+        bool ok = fetchTileFromMap(key, frame, tile.get());
+        tile->_status.exchange( ok ? STATUS_AVAILABLE : STATUS_FAIL );
+        tile->_ready.set();
     }
-}
 
-void
-ElevationPool::clearImpl()
-{
-    // assumes the tiles lock is taken.
-    _tiles.clear();
-    _mru.clear();
-    _entries = 0u;
-}
-
-bool
-ElevationPool::getTile(const TileKey& key, MapFrame& frame, osg::ref_ptr<ElevationPool::Tile>& output)
-{
-    // Synchronize the MapFrame to its Map; if there's an update,
-    // clear out the internal cache and MRU.
-    if ( frame.needsSync() )
+    else if (tile->_status == STATUS_IN_PROGRESS)
     {
-        if (frame.sync())
+        // another thread is fetching the tile from the map; wait for it.
+        OE_DEBUG << "  getTile(" << key.str() << ") -> in progress...waiting\n";
+        const unsigned timeout_ms = 30000u;
+        if (!tile->_ready.wait(timeout_ms))
         {
-            // Probably unnecessary because the Map itself will clear the pool.
-            clear();
+            // this means we timed out trying to fetch the map tile.
+            OE_TEST << LC << "Timout fetching tile " << key.str() << std::endl;
+            return false;
         }
     }
-   
-    OE_START_TIMER(get);
 
-    const double timeout = 30.0;
-    osg::ref_ptr<Tile> tile;
-    while( tryTile(key, frame, tile) && !tile.valid() && OE_GET_TIMER(get) < timeout)
+    if (tile->_status != STATUS_AVAILABLE)
     {
-        // condition: another thread is working on fetching the tile from the map,
-        // so wait and try again later. Do this until we succeed or time out.
-        OpenThreads::Thread::YieldCurrentThread();
+        OE_TEST << "  getTile(" << key.str() << ") -> fail\n";
+        return false;
     }
 
-    if ( !tile.valid() && OE_GET_TIMER(get) >= timeout )
+    if ( tile->_hf.valid() )
     {
-        // this means we timed out trying to fetch the map tile.
-        OE_TEST << LC << "Timout fetching tile " << key.str() << std::endl;
+        // got a valid tile, so push it to the query set.
+        output = tile.get();
     }
-
-    if ( tile.valid() )
+    else
     {
-        if ( tile->_hf.valid() )
-        {
-            // got a valid tile, so push it to the query set.
-            output = tile.get();
-        }
-        else
-        {
-            OE_WARN << LC << "Got a tile with an invalid HF (" << key.str() << ")\n";
-        }
+        OE_WARN << LC << "Got a tile with an invalid HF (" << key.str() << ")\n";
     }
 
-    return tile.valid();
+    return output.valid();
 }
 
 ElevationEnvelope*
@@ -424,6 +338,27 @@ ElevationEnvelope::getElevationAndResolution(double x, double y)
     return std::make_pair(elevation, resolution);
 }
 
+ElevationPool::Tile*
+ElevationEnvelope::findTile(double x, double y)
+{
+    for(ElevationPool::QuerySet::const_iterator tile_ref = _tiles.begin();
+        tile_ref != _tiles.end();
+        ++tile_ref)
+    {
+        if (tile_ref->get()->_bounds.contains(x, y))
+            return tile_ref->get();
+    }
+
+    TileKey key = _frame.getProfile()->createTileKey(x, y, _lod);
+    osg::ref_ptr<ElevationPool::Tile> tile;
+    if (_pool && _pool->getTile(key, _frame, tile))
+    {
+        _tiles.insert(tile.get());
+        return tile.get();
+    }
+    return 0L;
+}
+
 unsigned
 ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
                                  std::vector<float>& output)
@@ -432,17 +367,68 @@ ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
 
     unsigned count = 0u;
 
-    output.reserve(input.size());
-    output.clear();
+    output.assign(input.size(), NO_DATA_VALUE);
 
-    // for each input point:
-    for (std::vector<osg::Vec3d>::const_iterator v = input.begin(); v != input.end(); ++v)
+    if (input.empty())
+        return 0u;
+
+    // Transform all the points into the map SRS in one go.
+    std::vector<osg::Vec3d> points(input);
+    const SpatialReference* mapSRS = _frame.getProfile()->getSRS();
+    bool xformed = _inputSRS->isHorizEquivalentTo(mapSRS) || _inputSRS->transform(points, mapSRS);
+
+    if (xformed)
     {
-        float elevation, resolution;
-        sample(v->x(), v->y(), elevation, resolution);
-        output.push_back(elevation);
-        if (elevation != NO_DATA_VALUE)
-            ++count;
+        // Group the points by tile. Neighboring points usually share a tile,
+        // so check the last one first.
+        typedef std::map<ElevationPool::Tile*, std::vector<unsigned> > TileGroups;
+        TileGroups groups;
+        ElevationPool::Tile* last = 0L;
+
+        for (unsigned i = 0; i < points.size(); ++i)
+        {
+            const osg::Vec3d& p = points[i];
+            ElevationPool::Tile* tile =
+                last && last->_bounds.contains(p.x(), p.y()) ? last : findTile(p.x(), p.y());
+
+            if (tile)
+            {
+                groups[tile].push_back(i);
+                last = tile;
+            }
+        }
+
+        // Then sample each tile's points in a single pass.
+        std::vector<osg::Vec3d> batch;
+        std::vector<float> elevations;
+        for (TileGroups::const_iterator g = groups.begin(); g != groups.end(); ++g)
+        {
+            const std::vector<unsigned>& indices = g->second;
+            batch.resize(indices.size());
+            for (unsigned j = 0; j < indices.size(); ++j)
+                batch[j] = points[indices[j]];
+
+            g->first->_hf.getElevations(0L, batch, elevations);
+
+            for (unsigned j = 0; j < indices.size(); ++j)
+            {
+                output[indices[j]] = elevations[j];
+                if (elevations[j] != NO_DATA_VALUE)
+                    ++count;
+            }
+        }
+    }
+    else
+    {
+        // some points failed to transform, so go one by one.
+        for (unsigned i = 0; i < input.size(); ++i)
+        {
+            float elevation, resolution;
+            sample(input[i].x(), input[i].y(), elevation, resolution);
+            output[i] = elevation;
+            if (elevation != NO_DATA_VALUE)
+                ++count;
+        }
     }
 
     if (count < input.size())
@@ -20,13 +20,123 @@
 #include <osgEarth/DPLineSegmentIntersector>
 #include <osgEarth/Map>
 #include <osgEarth/ElevationPool>
+#include <osgEarth/TaskService>
+#include <osgEarth/Registry>
 #include <osgUtil/IntersectionVisitor>
 #include <osgSim/LineOfSight>
+#include <algorithm>
 
 #define LC "[ElevationQuery] "
 
 using namespace osgEarth;
 
+namespace
+{
+    // Shared by all ElevationQuery instances; each instance runs at most
+    // one batch at a time. Async queries share the registry's thread budget
+    // under this UID.
+    TaskService* getAsyncService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+}
+
+/**
+ * Pending asynchronous queries for one ElevationQuery. Requests accumulate
+ * while a batch is running; the next batch picks them all up at once, sorts
+ * them by tile and answers them with a private ElevationQuery (which is not
+ * thread-safe, so it never leaves the batch thread).
+ */
+struct ElevationQuery::AsyncQueue : public osg::Referenced
+{
+    struct Request : public osg::Referenced
+    {
+        GeoPoint                 _point;
+        double                   _resolution;
+        TileKey                  _key;
+        Promise<ElevationSample> _promise;
+    };
+    typedef std::vector< osg::ref_ptr<Request> > Requests;
+
+    struct SortByKey
+    {
+        bool operator()(const osg::ref_ptr<Request>& lhs, const osg::ref_ptr<Request>& rhs) const {
+            return lhs->_key < rhs->_key;
+        }
+    };
+
+    struct Batch : public TaskRequest
+    {
+        osg::ref_ptr<AsyncQueue> _queue;
+        void operator()(ProgressCallback*) { _queue->run(); }
+    };
+
+    AsyncQueue(const MapFrame& frame) : _worker(frame), _scheduled(false) { }
+
+    void add(Request* request)
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        _pending.push_back(request);
+        if (!_scheduled)
+        {
+            _scheduled = true;
+            Batch* batch = new Batch();
+            batch->_queue = this;
+            getAsyncService()->add(batch);
+        }
+    }
+
+    void run()
+    {
+        for (;;)
+        {
+            Requests batch;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                batch.swap(_pending);
+                if (batch.empty())
+                {
+                    _scheduled = false;
+                    return;
+                }
+            }
+
+            _worker.sync();
+
+            // Answer queries for the same tile back to back, so each tile is
+            // fetched once and stays hot in the envelope.
+            const Profile* profile = _worker._mapf.getProfile();
+            for (Requests::iterator i = batch.begin(); i != batch.end(); ++i)
+            {
+                Request* r = i->get();
+                GeoPoint mapPoint;
+                if (profile && r->_point.transform(profile->getSRS(), mapPoint))
+                    r->_key = profile->createTileKey(mapPoint.x(), mapPoint.y(), _worker.getLOD(r->_resolution));
+            }
+            std::stable_sort(batch.begin(), batch.end(), SortByKey());
+
+            for (Requests::iterator i = batch.begin(); i != batch.end(); ++i)
+            {
+                Request* r = i->get();
+
+                // nobody is waiting for this one any more.
+                if (r->_promise.isAbandoned())
+                    continue;
+
+                double resolution = 0.0;
+                float elevation = _worker.getElevation(r->_point, r->_resolution, &resolution);
+                r->_promise.resolve(new ElevationSample(elevation, (float)resolution));
+            }
+        }
+    }
+
+    ElevationQuery   _worker;
+    Threading::Mutex _mutex;
+    Requests         _pending;
+    bool             _scheduled;
+};
+
 
 ElevationQuery::ElevationQuery()
 {
@@ -43,10 +153,16 @@ ElevationQuery::ElevationQuery(const MapFrame& mapFrame)
     setMapFrame(mapFrame);
 }
 
+ElevationQuery::~ElevationQuery()
+{
+    //nop
+}
+
 void
 ElevationQuery::setMap(const Map* map)
 {
     _mapf.setMap(map);
+    _async = 0L;
     reset();
 }
 
@@ -54,6 +170,7 @@ void
 ElevationQuery::setMapFrame(const MapFrame& frame)
 {
     _mapf = frame;
+    _async = 0L;
     reset();
 }
 
@@ -118,6 +235,42 @@ ElevationQuery::getElevation(const GeoPoint& point,
     return result;
 }
 
+Future<ElevationSample>
+ElevationQuery::getElevationAsync(const GeoPoint& point,
+                                  double          desiredResolution)
+{
+    if (!_async.valid())
+        _async = new AsyncQueue(_mapf);
+
+    osg::ref_ptr<AsyncQueue::Request> request = new AsyncQueue::Request();
+    request->_point = point;
+    request->_resolution = desiredResolution;
+    Future<ElevationSample> result = request->_promise.getFuture();
+
+    _async->add(request.get());
+    return result;
+}
+
+unsigned
+ElevationQuery::getLOD(double desiredResolution) const
+{
+    // tile size (resolution of elevation tiles)
+    unsigned tileSize = 257; // yes?
+
+    // default LOD:
+    unsigned lod = 23u;
+
+    // attempt to map the requested resolution to an LOD:
+    if (desiredResolution > 0.0)
+    {
+        int level = _mapf.getProfile()->getLevelOfDetailForHorizResolution(desiredResolution, tileSize);
+        if ( level > 0 )
+            lod = level;
+    }
+
+    return lod;
+}
+
 bool
 ElevationQuery::getElevations(std::vector<osg::Vec3d>& points,
                               const SpatialReference*  pointsSRS,
@@ -251,19 +404,7 @@ ElevationQuery::getElevationImpl(const GeoPoint& point,
         return true;
     }
 
-    // tile size (resolution of elevation tiles)
-    unsigned tileSize = 257; // yes?
-
-    // default LOD:
-    unsigned lod = 23u;
-
-    // attempt to map the requested resolution to an LOD:
-    if (desiredResolution > 0.0)
-    {
-        int level = _mapf.getProfile()->getLevelOfDetailForHorizResolution(desiredResolution, tileSize);
-        if ( level > 0 )
-            lod = level;
-    }
+    unsigned lod = getLOD(desiredResolution);
 
     // do we need a new ElevationEnvelope?
     if (!_envelope.valid() ||
@@ -0,0 +1,274 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ElevationRayCaster>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/Map>
+#include <osgEarth/GeoData>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#define LC "[ElevationRayCaster] "
+
+using namespace osgEarth;
+
+ElevationRayCaster::ElevationRayCaster(const Map* map) :
+_map       ( map ),
+_lod       ( 14u ),
+_spacing   ( 0.0 ),
+_useExtrema( false ),
+_extremaMargin( 0.0 )
+{
+    //nop
+}
+
+void
+ElevationRayCaster::toMap(const SpatialReference* srs, const osg::Vec3d& world, osg::Vec3d& out) const
+{
+    GeoPoint p;
+    p.fromWorld(srs, world);
+    out = p.vec3d();
+}
+
+bool
+ElevationRayCaster::aboveExtrema(const MapFrame&   frame,
+                                 const Span&       span,
+                                 const osg::Vec3d& mid,
+                                 double            minHeight,
+                                 double            lod0Spacing) const
+{
+    const Profile* profile = frame.getProfile();
+
+    double xmin = std::min(std::min(span._p0.x(), span._p1.x()), mid.x());
+    double xmax = std::max(std::max(span._p0.x(), span._p1.x()), mid.x());
+    double ymin = std::min(std::min(span._p0.y(), span._p1.y()), mid.y());
+    double ymax = std::max(std::max(span._p0.y(), span._p1.y()), mid.y());
+
+    // start at the finest LOD whose tiles are as big as the span:
+    double w, h;
+    profile->getTileDimensions(0u, w, h);
+    double size = std::max(xmax-xmin, ymax-ymin);
+    double ratio = size > 0.0 ? std::min(w, h) / size : 0.0;
+    unsigned lod = _lod;
+    if (size > 0.0)
+        lod = ratio > 1.0 ? std::min(_lod, (unsigned)(log(ratio)/log(2.0))) : 0u;
+
+    // then walk up until a tile holds the whole span.
+    for(;;)
+    {
+        TileKey key = profile->createTileKey(mid.x(), mid.y(), lod);
+        if (key.valid() &&
+            key.getExtent().contains(xmin, ymin) &&
+            key.getExtent().contains(xmax, ymax))
+        {
+            // Every layer needs a record; one without could hold the peak.
+            double emax = -DBL_MAX;
+            const ElevationLayerVector& layers = frame.elevationLayers();
+            for (ElevationLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+            {
+                const ElevationLayer* layer = i->get();
+                if (layer->getEnabled() && !layer->isOffset())
+                {
+                    float lmin, lmax;
+                    if (!layer->getExtrema(key, lmin, lmax))
+                        return false;
+                    emax = std::max(emax, (double)lmax);
+                }
+            }
+            if (emax == -DBL_MAX)
+                return false;
+
+            // The record only saw its tile's samples; between samples the
+            // terrain can rise by about half a spacing (at 45 degrees). The
+            // record may be the grandparent's (see getExtrema), so use its spacing.
+            unsigned recordLOD = key.getLOD() >= 2u ? key.getLOD() - 2u : 0u;
+            double errorBound = 0.5 * lod0Spacing / (double)(1u << recordLOD) + _extremaMargin;
+            return minHeight > emax + errorBound;
+        }
+
+        if (lod == 0u)
+            return false;
+        --lod;
+    }
+}
+
+void
+ElevationRayCaster::collectSpans(const MapFrame&    frame,
+                                 const osg::Vec3d&  start,
+                                 const osg::Vec3d&  end,
+                                 const Span&        span,
+                                 double             spacing,
+                                 double             sagFactor,
+                                 double             lod0Spacing,
+                                 bool               useExtrema,
+                                 std::vector<Span>& out) const
+{
+    double length = (end-start).length() * (span._t1 - span._t0);
+    if (length <= spacing)
+    {
+        out.push_back(span);
+        return;
+    }
+
+    double tm = 0.5*(span._t0 + span._t1);
+    osg::Vec3d mid;
+    toMap(frame.getProfile()->getSRS(), start + (end-start)*tm, mid);
+
+    if (useExtrema)
+    {
+        // In a geocentric map the segment is a chord, and can dip below its
+        // sampled heights by about L^2/8R.
+        double minHeight =
+            std::min(std::min(span._p0.z(), span._p1.z()), mid.z()) -
+            length*length*sagFactor;
+
+        if (aboveExtrema(frame, span, mid, minHeight, lod0Spacing))
+            return;
+    }
+
+    Span first  = { span._t0, tm, span._p0, mid };
+    Span second = { tm, span._t1, mid, span._p1 };
+    collectSpans(frame, start, end, first,  spacing, sagFactor, lod0Spacing, useExtrema, out);
+    collectSpans(frame, start, end, second, spacing, sagFactor, lod0Spacing, useExtrema, out);
+}
+
+bool
+ElevationRayCaster::intersect(const osg::Vec3d& startWorld,
+                              const osg::Vec3d& endWorld,
+                              osg::Vec3d&       out_hitWorld)
+{
+    std::vector<osg::Vec3d> starts(1, startWorld), ends(1, endWorld), hits;
+    std::vector<bool> blocked;
+    if (intersect(starts, ends, hits, blocked) == 0u)
+        return false;
+
+    out_hitWorld = hits[0];
+    return true;
+}
+
+unsigned
+ElevationRayCaster::intersect(const std::vector<osg::Vec3d>& startsWorld,
+                              const std::vector<osg::Vec3d>& endsWorld,
+                              std::vector<osg::Vec3d>&       out_hitsWorld,
+                              std::vector<bool>&             out_blocked)
+{
+    unsigned num = std::min(startsWorld.size(), endsWorld.size());
+    out_hitsWorld.assign(num, osg::Vec3d());
+    out_blocked.assign(num, false);
+
+    osg::ref_ptr<const Map> map;
+    if (num == 0u || !_map.lock(map) || !map->getElevationPool())
+        return 0u;
+
+    MapFrame frame(map.get());
+    const Profile* profile = frame.getProfile();
+    const SpatialReference* srs = profile->getSRS();
+
+    double spacing = _spacing;
+    if (spacing <= 0.0)
+    {
+        double w, h;
+        profile->getTileDimensions(_lod, w, h);
+        unsigned tileSize = map->getElevationPool()->getTileSize();
+        spacing = w / (double)(tileSize > 1u ? tileSize-1u : 1u);
+        if (srs->isGeographic())
+            spacing *= srs->getEllipsoid()->getRadiusEquator() * osg::PI / 180.0;
+    }
+
+    // Sample spacing of the elevation tiles at LOD 0, for the extrema error bound:
+    double lod0Spacing;
+    {
+        double w, h;
+        profile->getTileDimensions(0u, w, h);
+        unsigned tileSize = map->getElevationPool()->getTileSize();
+        lod0Spacing = std::max(w, h) / (double)(tileSize > 1u ? tileSize-1u : 1u);
+        if (srs->isGeographic())
+            lod0Spacing *= srs->getEllipsoid()->getRadiusEquator() * osg::PI / 180.0;
+    }
+
+    double sagFactor = map->isGeocentric() ?
+        1.0 / (8.0 * srs->getEllipsoid()->getRadiusEquator()) : 0.0;
+
+    // Offset layers aren't covered by the extrema records.
+    bool useExtrema = _useExtrema;
+    const ElevationLayerVector& layers = frame.elevationLayers();
+    for (ElevationLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        if (i->get()->getEnabled() && i->get()->isOffset())
+            useExtrema = false;
+    }
+
+    std::vector< std::vector<Span> > spans(num);
+    std::vector<osg::Vec3d> points;
+    for (unsigned i = 0; i < num; ++i)
+    {
+        Span whole;
+        whole._t0 = 0.0;
+        whole._t1 = 1.0;
+        toMap(srs, startsWorld[i], whole._p0);
+        toMap(srs, endsWorld[i],   whole._p1);
+        collectSpans(frame, startsWorld[i], endsWorld[i], whole, spacing, sagFactor, lod0Spacing, useExtrema, spans[i]);
+
+        for (unsigned j = 0; j < spans[i].size(); ++j)
+        {
+            points.push_back(spans[i][j]._p0);
+            points.push_back(spans[i][j]._p1);
+        }
+    }
+
+    if (points.empty())
+        return 0u;
+
+    osg::ref_ptr<ElevationEnvelope> envelope = map->getElevationPool()->createEnvelope(srs, _lod);
+    std::vector<float> elevations;
+    envelope->getElevations(points, elevations);
+
+    unsigned count = 0u;
+    unsigned k = 0u;
+    for (unsigned i = 0; i < num; ++i)
+    {
+        const std::vector<Span>& list = spans[i];
+        unsigned j = 0;
+        for (; j < list.size(); ++j, k += 2)
+        {
+            const Span& span = list[j];
+            float e0 = elevations[k], e1 = elevations[k+1];
+            double d0 = span._p0.z() - (double)e0;
+            double d1 = span._p1.z() - (double)e1;
+
+            double t;
+            if (e0 != NO_DATA_VALUE && d0 < 0.0)
+                t = span._t0;
+            else if (e1 != NO_DATA_VALUE && d1 < 0.0)
+                t = e0 != NO_DATA_VALUE ? span._t0 + (span._t1-span._t0)*d0/(d0-d1) : span._t1;
+            else
+                continue;
+
+            out_hitsWorld[i] = startsWorld[i] + (endsWorld[i]-startsWorld[i])*t;
+            out_blocked[i] = true;
+            ++count;
+            break;
+        }
+
+        // skip the rest of this segment's samples
+        k += 2u * (list.size() - j);
+    }
+
+    return count;
+}
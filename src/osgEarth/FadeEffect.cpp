@@ -57,6 +57,7 @@ namespace
         "uniform float oe_fadeeffect_duration; \n"
         "uniform float oe_fadeeffect_startTime; \n"
         "uniform float oe_fadeeffect_maxRange; \n"
+        "uniform float oe_fadeeffect_minRange; \n"
         "uniform float oe_fadeeffect_attenDist; \n"
         "uniform float osg_FrameTime; \n"
 
@@ -66,7 +67,8 @@ namespace
         "{ \n"
         "    float t = (osg_FrameTime-oe_fadeeffect_startTime)/oe_fadeeffect_duration; \n"
         "    float r = (oe_fadeeffect_maxRange - (-VertexView.z))/oe_fadeeffect_attenDist; \n"
-        "    oe_fadeeffect_opacity = clamp(t, 0.0, 1.0) * clamp(r, 0.0, 1.0); \n"
+        "    float n = ((-VertexView.z) - oe_fadeeffect_minRange)/oe_fadeeffect_attenDist; \n"
+        "    oe_fadeeffect_opacity = clamp(t, 0.0, 1.0) * clamp(r, 0.0, 1.0) * clamp(n, 0.0, 1.0); \n"
         "} \n";
 
     const char* FadeEffectFragmentShader = 
@@ -108,6 +110,9 @@ FadeEffect::FadeEffect()
         _maxRange = ss->getOrCreateUniform( "oe_fadeeffect_maxRange", osg::Uniform::FLOAT );
         _maxRange->set( FLT_MAX );
 
+        _minRange = ss->getOrCreateUniform( "oe_fadeeffect_minRange", osg::Uniform::FLOAT );
+        _minRange->set( -FLT_MAX );
+
         _attenDist = ss->getOrCreateUniform( "oe_fadeeffect_attenDist", osg::Uniform::FLOAT );
         _attenDist->set( 0.0f );
     }
@@ -143,6 +148,20 @@ FadeEffect::getMaxRange() const
     return value;
 }
 
+void
+FadeEffect::setMinRange(float value)
+{
+    _minRange->set( value );
+}
+
+float
+FadeEffect::getMinRange() const
+{
+    float value = 0.0f;
+    _minRange->get( value );
+    return value;
+}
+
 void
 FadeEffect::setAttenuationDistance(float value)
 {
@@ -25,6 +25,7 @@
 #include <osgEarth/Cube>
 #include <osgEarth/VerticalDatum>
 #include <osgEarth/Terrain>
+#include <osgEarth/ThreadingUtils>
 
 #include <osg/Notify>
 #include <osg/Timer>
@@ -37,6 +38,9 @@
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
+#include <list>
+#include <map>
 
 #define LC "[GeoData] "
 
@@ -1487,8 +1491,7 @@ GeoImage::addTransparentBorder(bool leftBorder, bool rightBorder, bool bottomBor
     if (topBorder)    newT += buffer;
     if (bottomBorder) newT += buffer;
 
-    osg::Image* newImage = new osg::Image;
-    newImage->allocateImage(newS, newT, _image->r(), _image->getPixelFormat(), _image->getDataType(), _image->getPacking());
+    osg::Image* newImage = ImageUtils::createImage(newS, newT, _image->r(), _image->getPixelFormat(), _image->getDataType(), _image->getPacking());
     newImage->setInternalTextureFormat(_image->getInternalTextureFormat());
     memset(newImage->data(), 0, newImage->getImageSizeInBytes());
     unsigned startC = leftBorder ? buffer : 0;
@@ -1769,6 +1772,248 @@ namespace
     }    
 
 
+    // Spacing (in destination pixels) of the coarse warp grid nodes
+#define WARP_GRID_STEP 16
+
+    // Source coordinates of a grid over a destination raster. Either every
+    // pixel (_exact) or a coarse grid to be interpolated. Column-major, like
+    // SpatialReference::transformExtentPoints.
+    struct WarpGrid : public osg::Referenced
+    {
+        unsigned _numX, _numY;
+        bool _exact;
+        std::vector<double> _x, _y;
+
+        unsigned bytes() const { return (unsigned)((_x.size() + _y.size()) * sizeof(double)); }
+    };
+
+    // Keep at most this many bytes of warp grids. Coarse grids are a few KB,
+    // but an exact grid costs 16 bytes per destination pixel.
+#define WARP_GRID_CACHE_BYTES (16u * 1024u * 1024u)
+
+    /**
+     * Least-recently-used warp grids, bounded by their total size rather
+     * than their count.
+     */
+    class WarpGridCache
+    {
+    public:
+        WarpGridCache(unsigned maxBytes) : _maxBytes(maxBytes), _bytes(0u) { }
+
+        WarpGrid* get(const std::string& key)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            GridMap::iterator i = _map.find(key);
+            if (i == _map.end())
+                return 0L;
+            _lru.splice(_lru.end(), _lru, i->second.second);
+            return i->second.first.get();
+        }
+
+        void insert(const std::string& key, WarpGrid* grid)
+        {
+            unsigned size = grid->bytes();
+            if (size > _maxBytes)
+                return;
+
+            Threading::ScopedMutexLock lock(_mutex);
+            if (_map.find(key) != _map.end())
+                return;
+
+            while (!_lru.empty() && _bytes + size > _maxBytes)
+            {
+                GridMap::iterator oldest = _map.find(_lru.front());
+                _bytes -= oldest->second.first->bytes();
+                _map.erase(oldest);
+                _lru.pop_front();
+            }
+
+            _lru.push_back(key);
+            _map[key] = std::make_pair(osg::ref_ptr<WarpGrid>(grid), --_lru.end());
+            _bytes += size;
+        }
+
+    private:
+        typedef std::list<std::string> LRU;
+        typedef std::map<std::string, std::pair<osg::ref_ptr<WarpGrid>, LRU::iterator> > GridMap;
+
+        Threading::Mutex _mutex;
+        unsigned         _maxBytes;
+        unsigned         _bytes;
+        LRU              _lru;
+        GridMap          _map;
+    };
+
+    WarpGridCache s_warpGrids(WARP_GRID_CACHE_BYTES);
+
+    WarpGrid* createWarpGrid(const GeoExtent& dest_extent, const SpatialReference* srcSRS, unsigned width, unsigned height)
+    {
+        const double dx = dest_extent.width() / (double)width;
+        const double dy = dest_extent.height() / (double)height;
+        const double xmin = dest_extent.xMin() + .5 * dx, ymin = dest_extent.yMin() + .5 * dy;
+        const double xmax = dest_extent.xMax() - .5 * dx, ymax = dest_extent.yMax() - .5 * dy;
+        const SpatialReference* destSRS = dest_extent.getSRS();
+
+        osg::ref_ptr<WarpGrid> grid = new WarpGrid();
+        grid->_numX = osg::minimum(width,  (width-1)/WARP_GRID_STEP + 2u);
+        grid->_numY = osg::minimum(height, (height-1)/WARP_GRID_STEP + 2u);
+        grid->_exact = false;
+        grid->_x.resize(grid->_numX * grid->_numY);
+        grid->_y.resize(grid->_numX * grid->_numY);
+
+        bool ok =
+            grid->_numX < width && grid->_numY < height &&
+            destSRS->transformExtentPoints(srcSRS, xmin, ymin, xmax, ymax, &grid->_x[0], &grid->_y[0], grid->_numX, grid->_numY);
+
+        // Interpolating the grid must land within 1/20 of a destination
+        // pixel of the true source point; check the center of every cell,
+        // since the distortion can be confined to one corner or edge.
+        if (ok)
+        {
+            const double gdx = (xmax - xmin) / (double)(grid->_numX-1);
+            const double gdy = (ymax - ymin) / (double)(grid->_numY-1);
+            const unsigned numCellsY = grid->_numY - 1u;
+            const unsigned numChecks = (grid->_numX - 1u) * numCellsY;
+
+            std::vector<osg::Vec3d> checks;
+            checks.reserve(numChecks);
+            for (unsigned ci = 0; ci < grid->_numX - 1u; ++ci)
+                for (unsigned cj = 0; cj < numCellsY; ++cj)
+                    checks.push_back(osg::Vec3d(xmin + ((double)ci + 0.5)*gdx, ymin + ((double)cj + 0.5)*gdy, 0.0));
+
+            ok = destSRS->transform(checks, srcSRS);
+
+            for (unsigned k = 0; ok && k < numChecks; ++k)
+            {
+                unsigned ci = k / numCellsY, cj = k % numCellsY;
+                unsigned i00 = ci*grid->_numY + cj, i01 = i00 + 1, i10 = i00 + grid->_numY, i11 = i10 + 1;
+                double ix = 0.25*(grid->_x[i00] + grid->_x[i01] + grid->_x[i10] + grid->_x[i11]);
+                double iy = 0.25*(grid->_y[i00] + grid->_y[i01] + grid->_y[i10] + grid->_y[i11]);
+
+                double cellX = std::max(fabs(grid->_x[i10] - grid->_x[i00]), fabs(grid->_x[i01] - grid->_x[i00]));
+                double cellY = std::max(fabs(grid->_y[i10] - grid->_y[i00]), fabs(grid->_y[i01] - grid->_y[i00]));
+                double tolX = 0.05 * cellX / (double)WARP_GRID_STEP;
+                double tolY = 0.05 * cellY / (double)WARP_GRID_STEP;
+
+                if (fabs(ix - checks[k].x()) > tolX || fabs(iy - checks[k].y()) > tolY)
+                    ok = false;
+            }
+        }
+
+        if (!ok)
+        {
+            // too nonlinear (or too small) to interpolate; transform every pixel.
+            grid->_numX = width;
+            grid->_numY = height;
+            grid->_exact = true;
+            grid->_x.resize(width * height);
+            grid->_y.resize(width * height);
+            destSRS->transformExtentPoints(srcSRS, xmin, ymin, xmax, ymax, &grid->_x[0], &grid->_y[0], width, height);
+        }
+
+        return grid.release();
+    }
+
+    /**
+     * Computes the source coordinates of each destination pixel center. The
+     * warp grid behind them is cached, so the many tiles that share an extent
+     * (one per image layer in the same profile) transform it only once.
+     */
+    void getWarpPoints(const GeoExtent& dest_extent, const SpatialReference* srcSRS,
+                       unsigned width, unsigned height, double* srcPointsX, double* srcPointsY)
+    {
+        if (width < 2u || height < 2u)
+        {
+            const double dx = dest_extent.width() / (double)width;
+            const double dy = dest_extent.height() / (double)height;
+            dest_extent.getSRS()->transformExtentPoints(
+                srcSRS,
+                dest_extent.xMin() + .5 * dx, dest_extent.yMin() + .5 * dy,
+                dest_extent.xMax() - .5 * dx, dest_extent.yMax() - .5 * dy,
+                srcPointsX, srcPointsY, width, height);
+            return;
+        }
+
+        std::stringstream buf;
+        buf << std::setprecision(17)
+            << dest_extent.getSRS()->getHorizInitString() << ";" << srcSRS->getHorizInitString() << ";"
+            << dest_extent.xMin() << "," << dest_extent.yMin() << ","
+            << dest_extent.xMax() << "," << dest_extent.yMax() << ";"
+            << width << "x" << height;
+        std::string key = buf.str();
+
+        osg::ref_ptr<WarpGrid> grid = s_warpGrids.get(key);
+        if (!grid.valid())
+        {
+            grid = createWarpGrid(dest_extent, srcSRS, width, height);
+            s_warpGrids.insert(key, grid.get());
+        }
+
+        if (grid->_exact)
+        {
+            std::copy(grid->_x.begin(), grid->_x.end(), srcPointsX);
+            std::copy(grid->_y.begin(), grid->_y.end(), srcPointsY);
+            return;
+        }
+
+        // Interpolate the grid, one destination column at a time.
+        const double ux = (double)(grid->_numX-1) / (double)(width-1);
+        const double uy = (double)(grid->_numY-1) / (double)(height-1);
+        unsigned pixel = 0;
+        for (unsigned c = 0; c < width; ++c)
+        {
+            double u = (double)c * ux;
+            unsigned i = osg::minimum((unsigned)u, grid->_numX-2u);
+            double fu = u - (double)i;
+
+            const double* x0 = &grid->_x[i * grid->_numY];
+            const double* y0 = &grid->_y[i * grid->_numY];
+            const double* x1 = x0 + grid->_numY;
+            const double* y1 = y0 + grid->_numY;
+
+            for (unsigned r = 0; r < height; ++r, ++pixel)
+            {
+                double v = (double)r * uy;
+                unsigned j = osg::minimum((unsigned)v, grid->_numY-2u);
+                double fv = v - (double)j;
+
+                double xa = x0[j] + (x0[j+1] - x0[j]) * fv, xb = x1[j] + (x1[j+1] - x1[j]) * fv;
+                double ya = y0[j] + (y0[j+1] - y0[j]) * fv, yb = y1[j] + (y1[j+1] - y1[j]) * fv;
+                srcPointsX[pixel] = xa + (xb - xa) * fu;
+                srcPointsY[pixel] = ya + (yb - ya) * fu;
+            }
+        }
+    }
+
+    /**
+     * Bilinear sample of an 8-bit image straight from its bytes; matches the
+     * PixelReader path in manualReproject without the float conversions.
+     */
+    inline void sampleBytesBilinear(const osg::Image* image, unsigned numComponents, float px, float py, unsigned char* out)
+    {
+        int colMin = osg::maximum((int)floor(px), 0);
+        int colMax = osg::maximum(osg::minimum((int)ceil(px), (int)(image->s()-1)), 0);
+        int rowMin = osg::maximum((int)floor(py), 0);
+        int rowMax = osg::maximum(osg::minimum((int)ceil(py), (int)(image->t()-1)), 0);
+        if (colMin > colMax) colMin = colMax;
+        if (rowMin > rowMax) rowMin = rowMax;
+
+        const unsigned char* ll = image->data(colMin, rowMin);
+        const unsigned char* lr = image->data(colMax, rowMin);
+        const unsigned char* ul = image->data(colMin, rowMax);
+        const unsigned char* ur = image->data(colMax, rowMax);
+
+        float fx = colMax == colMin ? 0.0f : px - (float)colMin;
+        float fy = rowMax == rowMin ? 0.0f : py - (float)rowMin;
+
+        for (unsigned i = 0; i < numComponents; ++i)
+        {
+            float r1 = (float)ll[i] + ((float)lr[i] - (float)ll[i]) * fx;
+            float r2 = (float)ul[i] + ((float)ur[i] - (float)ul[i]) * fx;
+            out[i] = (unsigned char)osg::clampBetween(r1 + (r2 - r1) * fy + 0.5f, 0.0f, 255.0f);
+        }
+    }
+
     osg::Image* manualReproject(
         const osg::Image* image, 
         const GeoExtent&  src_extent, 
@@ -1788,9 +2033,8 @@ namespace
         // need to know this in order to choose the right interpolation algorithm
         const bool isSrcContiguous = src_extent.getSRS()->isContiguous();
 
-        osg::Image *result = new osg::Image();
         //result->allocateImage(width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE);
-        result->allocateImage(width, height, 1, image->getPixelFormat(), image->getDataType()); //GL_UNSIGNED_BYTE);
+        osg::Image *result = ImageUtils::createImage(width, height, 1, image->getPixelFormat(), image->getDataType()); //GL_UNSIGNED_BYTE);
         result->setInternalTextureFormat(image->getInternalTextureFormat());
         ImageUtils::markAsUnNormalized(result, ImageUtils::isUnNormalized(image));
 
@@ -1813,11 +2057,15 @@ namespace
         // the sample grid into the source coordinate system.
         double *srcPointsX = new double[numPixels * 2];
         double *srcPointsY = srcPointsX + numPixels;
-        dest_extent.getSRS()->transformExtentPoints(
-            src_extent.getSRS(),
-            dest_extent.xMin() + .5 * dx, dest_extent.yMin() + .5 * dy,
-            dest_extent.xMax() - .5 * dx, dest_extent.yMax() - .5 * dy,
-            srcPointsX, srcPointsY, width, height);
+        getWarpPoints(dest_extent, src_extent.getSRS(), width, height, srcPointsX, srcPointsY);
+
+        // 8-bit color images skip the generic pixel reader/writer.
+        const unsigned numComponents = osg::Image::computeNumComponents(image->getPixelFormat());
+        const bool sampleBytes =
+            image->getDataType() == GL_UNSIGNED_BYTE &&
+            (image->getPixelFormat() == GL_RGBA || image->getPixelFormat() == GL_RGB || image->getPixelFormat() == GL_LUMINANCE) &&
+            image->getPacking() == 1 && result->getPacking() == 1 &&
+            image->r() == 1;
 
         // Next, go through the source-SRS sample grid, read the color at each point from the source image,
         // and write it to the corresponding pixel in the destination image.
@@ -1846,6 +2094,16 @@ namespace
                 int px_i = osg::clampBetween( (int)osg::round(px), 0, image->s()-1 );
                 int py_i = osg::clampBetween( (int)osg::round(py), 0, image->t()-1 );
 
+                if ( sampleBytes )
+                {
+                    if ( interpolate )
+                        sampleBytesBilinear(image, numComponents, px, py, result->data(c, r));
+                    else
+                        memcpy(result->data(c, r), image->data(px_i, py_i), numComponents);
+                    pixel++;
+                    continue;
+                }
+
                 osg::Vec4 color(0,0,0,0);
 
                 // TODO: consider this again later. Causes blockiness.
@@ -2240,6 +2498,47 @@ GeoHeightField::getElevation(double x, double y) const
         INTERP_BILINEAR);
 }
 
+unsigned
+GeoHeightField::getElevations(const SpatialReference*        inputSRS,
+                              const std::vector<osg::Vec3d>& points,
+                              std::vector<float>&            out_elevations) const
+{
+    out_elevations.assign(points.size(), NO_DATA_VALUE);
+    if ( points.empty() || !valid() )
+        return 0u;
+
+    // transform all the points into our local SRS at once:
+    const std::vector<osg::Vec3d>* local = &points;
+    std::vector<osg::Vec3d> xformed;
+    if ( inputSRS && !inputSRS->isHorizEquivalentTo(_extent.getSRS()) )
+    {
+        xformed = points;
+        if ( !inputSRS->transform(xformed, _extent.getSRS()) )
+            return 0u;
+        local = &xformed;
+    }
+
+    double xInterval = _extent.width()  / (double)(_heightField->getNumColumns()-1);
+    double yInterval = _extent.height() / (double)(_heightField->getNumRows()-1);
+
+    HeightFieldUtils::getHeightsAtLocations(
+        _heightField.get(),
+        &local->front(), local->size(),
+        _extent.xMin(), _extent.yMin(),
+        xInterval, yInterval,
+        &out_elevations.front());
+
+    unsigned count = 0u;
+    for (unsigned i = 0; i < local->size(); ++i)
+    {
+        if ( !_extent.contains((*local)[i].x(), (*local)[i].y()) )
+            out_elevations[i] = NO_DATA_VALUE;
+        else if ( out_elevations[i] != NO_DATA_VALUE )
+            ++count;
+    }
+    return count;
+}
+
 osg::Vec3
 GeoHeightField::getNormal(double x, double y) const
 {
@@ -185,6 +185,58 @@ GeoMath::interpolate(double lat1Rad, double lon1Rad,
     em.convertXYZToLatLongHeight( v0.x(), v0.y(), v0.z(), out_latRad, out_lonRad, dummy );
 }
 
+void
+GeoMath::interpolate(double lat1Rad, double lon1Rad,
+                     double lat2Rad, double lon2Rad,
+                     unsigned parts,
+                     std::vector<osg::Vec2d>& out_latLonRad)
+{
+    if ( parts < 2 )
+        return;
+
+    static osg::EllipsoidModel em;
+
+    osg::Vec3d v0, v1;
+
+    em.convertLatLongHeightToXYZ(lat1Rad, lon1Rad, 0, v0.x(), v0.y(), v0.z());
+    double r0 = v0.length();
+    v0.normalize();
+    em.convertLatLongHeightToXYZ(lat2Rad, lon2Rad, 0, v1.x(), v1.y(), v1.z());
+    double r1 = v1.length();
+    v1.normalize();
+
+    double radius   = 0.5*(r0 + r1);
+    double angle    = acos( osg::clampBetween(v0 * v1, -1.0, 1.0) );
+    double sinAngle = sin( angle );
+
+    // spherical linear interpolation between the unit vectors; same result as
+    // rotating v0 about the v0^v1 axis, without building a quaternion per point.
+    out_latLonRad.reserve( out_latLonRad.size() + parts - 1 );
+    for( unsigned i=1; i<parts; ++i )
+    {
+        double t = double(i)/double(parts);
+        double w0, w1;
+        if ( sinAngle > 1e-12 )
+        {
+            w0 = sin( (1.0-t)*angle ) / sinAngle;
+            w1 = sin( t*angle ) / sinAngle;
+        }
+        else
+        {
+            w0 = 1.0-t;
+            w1 = t;
+        }
+
+        osg::Vec3d v = v0*w0 + v1*w1;
+        v.normalize();
+        v *= radius;
+
+        double lat, lon, dummy;
+        em.convertXYZToLatLongHeight( v.x(), v.y(), v.z(), lat, lon, dummy );
+        out_latLonRad.push_back( osg::Vec2d(lat, lon) );
+    }
+}
+
 double
 GeoMath::rhumbDistance(double lat1Rad, double lon1Rad,
                        double lat2Rad, double lon2Rad,
@@ -19,6 +19,8 @@
 
 #include <osgEarth/Geoid>
 #include <osgEarth/HeightFieldUtils>
+#include <vector>
+#include <algorithm>
 
 #define LC "[Geoid] "
 
@@ -91,6 +93,82 @@ Geoid::getHeight(double lat_deg, double lon_deg, const ElevationInterpolation& i
     return result;
 }
 
+namespace
+{
+    // Where one grid coordinate falls in the geoid heightfield.
+    struct Sample
+    {
+        unsigned _i0, _i1;
+        float    _w;       // weight of _i1
+        bool     _inside;
+    };
+
+    void computeSamples(double start, double step, unsigned count,
+                        double min, double max, unsigned size,
+                        std::vector<Sample>& out)
+    {
+        out.resize(count);
+        for(unsigned i=0; i<count; ++i)
+        {
+            double v = start + step*(double)i;
+            Sample& s = out[i];
+            s._inside = v >= min && v <= max;
+
+            double p = osg::clampBetween((v-min)/(max-min), 0.0, 1.0) * (double)(size-1);
+            s._i0 = (unsigned)p;
+            s._i1 = osg::minimum(s._i0+1u, size-1u);
+            s._w  = (float)(p - (double)s._i0);
+        }
+    }
+}
+
+void
+Geoid::getHeights(double   west,
+                  double   south,
+                  double   xstep,
+                  double   ystep,
+                  unsigned cols,
+                  unsigned rows,
+                  float*   out) const
+{
+    if ( !_valid )
+    {
+        std::fill(out, out + cols*rows, 0.0f);
+        return;
+    }
+
+    // the weights are separable, so work them out once per column and row.
+    std::vector<Sample> cs, rs;
+    computeSamples(west,  xstep, cols, _bounds.xMin(), _bounds.xMax(), _hf->getNumColumns(), cs);
+    computeSamples(south, ystep, rows, _bounds.yMin(), _bounds.yMax(), _hf->getNumRows(),    rs);
+
+    const osg::HeightField::HeightList& heights = _hf->getHeightList();
+    unsigned hfCols = _hf->getNumColumns();
+
+    for(unsigned r=0; r<rows; ++r)
+    {
+        const Sample& rs_r = rs[r];
+        const float* row0 = &heights[rs_r._i0 * hfCols];
+        const float* row1 = &heights[rs_r._i1 * hfCols];
+        float* o = out + r*cols;
+
+        for(unsigned c=0; c<cols; ++c)
+        {
+            const Sample& cs_c = cs[c];
+            if ( rs_r._inside && cs_c._inside )
+            {
+                float s = row0[cs_c._i0] + (row0[cs_c._i1]-row0[cs_c._i0])*cs_c._w;
+                float n = row1[cs_c._i0] + (row1[cs_c._i1]-row1[cs_c._i0])*cs_c._w;
+                o[c] = s + (n-s)*rs_r._w;
+            }
+            else
+            {
+                o[c] = 0.0f;
+            }
+        }
+    }
+}
+
 bool
 Geoid::isEquivalentTo( const Geoid& rhs ) const
 {
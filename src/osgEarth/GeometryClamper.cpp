@@ -17,6 +17,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/GeometryClamper>
+#include <osgEarth/Registry>
+#include <osgEarth/TaskService>
 
 #include <osgUtil/IntersectionVisitor>
 
@@ -30,16 +32,129 @@ using namespace osgEarth;
 
 #define ZOFFSETS_NAME "GeometryClamper::zOffsets"
 
+namespace
+{
+    // Clamping shares the registry's thread budget under this UID.
+    TaskService* getClampService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+struct GeometryClamper::ClampJobs
+{
+    const GeometryClamper* _clamper;
+    std::vector<Job>::iterator _begin, _end;
+    std::vector<char>* _dirty;
+    unsigned _offset;
+
+    void execute()
+    {
+        Sampler sampler;
+        _clamper->initSampler(sampler);
+        unsigned i = _offset;
+        for (std::vector<Job>::iterator job = _begin; job != _end; ++job, ++i)
+        {
+            (*_dirty)[i] = _clamper->clampGeometry(job->_geom.get(), job->_local2world, sampler);
+        }
+    }
+};
+
 //-----------------------------------------------------------------------
 
 GeometryClamper::GeometryClamper() :
 osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN ),
 _preserveZ      ( false ),
 _scale          ( 1.0f ),
-_offset         ( 0.0f )
+_offset         ( 0.0f ),
+_lod            ( 14u ),
+_parallel       ( true ),
+_gathering      ( false )
 {
     this->setNodeMaskOverride( ~0 );
-    _lsi = new osgEarth::DPLineSegmentIntersector(osg::Vec3d(0,0,0), osg::Vec3d(0,0,0));
+}
+
+void
+GeometryClamper::clamp(osg::Node* node)
+{
+    if ( !node || !_terrainSRS.valid() )
+        return;
+
+    _jobs.clear();
+    _jobArrays.clear();
+    _gathering = true;
+    node->accept( *this );
+    _gathering = false;
+
+    if ( _jobs.empty() )
+        return;
+
+    std::vector<char> dirty( _jobs.size(), 0 );
+
+    TaskService* service = _parallel && _jobs.size() > 1 ? getClampService() : 0L;
+
+    if ( service && service->getNumThreads() > 1 )
+    {
+        // A few ranges per thread so one dense drawable doesn't hold up the rest:
+        unsigned numTasks = osg::minimum((unsigned)_jobs.size(), 4u * (unsigned)service->getNumThreads());
+        Threading::MultiEvent semaphore(numTasks);
+
+        for (unsigned t = 0; t < numTasks; ++t)
+        {
+            unsigned begin = (t * _jobs.size()) / numTasks;
+            unsigned end = ((t + 1) * _jobs.size()) / numTasks;
+
+            ParallelTask<ClampJobs>* task = new ParallelTask<ClampJobs>(&semaphore);
+            task->_clamper = this;
+            task->_begin   = _jobs.begin() + begin;
+            task->_end     = _jobs.begin() + end;
+            task->_dirty   = &dirty;
+            task->_offset  = begin;
+            service->add(task);
+        }
+
+        semaphore.wait();
+    }
+    else
+    {
+        ClampJobs task;
+        task._clamper = this;
+        task._begin   = _jobs.begin();
+        task._end     = _jobs.end();
+        task._dirty   = &dirty;
+        task._offset  = 0u;
+        task.execute();
+    }
+
+    // Dirty the results here, on the calling thread.
+    unsigned count = 0u;
+    for (unsigned i = 0; i < _jobs.size(); ++i)
+    {
+        if ( dirty[i] )
+        {
+            osg::Geometry* geom = _jobs[i]._geom.get();
+            osg::Array* verts = geom->getVertexArray();
+            geom->dirtyBound();
+            if ( geom->getUseVertexBufferObjects() )
+            {
+                verts->getVertexBufferObject()->setUsage( GL_DYNAMIC_DRAW_ARB );
+                verts->dirty();
+            }
+            else
+            {
+                geom->dirtyDisplayList();
+            }
+            ++count;
+        }
+    }
+
+    OE_DEBUG << LC << "clamped " << count << " of " << _jobs.size() << " drawables.\n";
+
+    _jobs.clear();
+    _jobArrays.clear();
 }
 
 void
@@ -60,25 +175,71 @@ GeometryClamper::apply(osg::Drawable& drawable)
         return;
 
     osg::Geometry* geom = drawable.asGeometry();
-    if ( !geom )
+    if ( !geom || !dynamic_cast<osg::Vec3Array*>(geom->getVertexArray()) )
         return;
 
-    const osg::Matrixd& local2world = _matrixStack.back();
+    if ( _gathering )
+    {
+        // Geometries that share a vertex array would race; clamp each array once.
+        if ( !_jobArrays.insert(geom->getVertexArray()).second )
+            return;
+
+        Job job;
+        job._geom = geom;
+        job._local2world = _matrixStack.back();
+        _jobs.push_back( job );
+    }
+    else
+    {
+        Sampler sampler;
+        initSampler( sampler );
+        if ( clampGeometry(geom, _matrixStack.back(), sampler) )
+        {
+            osg::Array* verts = geom->getVertexArray();
+            geom->dirtyBound();
+            if ( geom->getUseVertexBufferObjects() )
+            {
+                verts->getVertexBufferObject()->setUsage( GL_DYNAMIC_DRAW_ARB );
+                verts->dirty();
+            }
+            else
+            {
+                geom->dirtyDisplayList();
+            }
+        }
+    }
+}
+
+void
+GeometryClamper::initSampler(Sampler& sampler) const
+{
+    if ( _pool.valid() )
+        sampler._envelope = _pool->createEnvelope( _terrainSRS.get(), _lod );
+    else
+        sampler._lsi = new osgEarth::DPLineSegmentIntersector(osg::Vec3d(0,0,0), osg::Vec3d(0,0,0));
+
+    if ( _clampExtent.isValid() )
+        sampler._extent = _clampExtent.transform( _terrainSRS.get() );
+}
+
+bool
+GeometryClamper::clampGeometry(osg::Geometry*      geom,
+                               const osg::Matrixd& local2world,
+                               Sampler&            sampler) const
+{
+    if ( !_pool.valid() && !_terrainPatch.valid() )
+        return false;
+
     osg::Matrix world2local;
     world2local.invert( local2world );
 
     const osg::EllipsoidModel* em = _terrainSRS->getEllipsoid();
-    osg::Vec3d n_vector(0,0,1), start, end, msl;
+    osg::Vec3d n_vector(0,0,1), msl;
 
     bool isGeocentric = _terrainSRS->isGeographic();
 
-    osgUtil::IntersectionVisitor iv( _lsi.get() );
-
     double r = std::min( em->getRadiusEquator(), em->getRadiusPolar() );
 
-    unsigned count = 0;
-
-    bool geomDirty = false;
     osg::Vec3Array*  verts = static_cast<osg::Vec3Array*>(geom->getVertexArray());
     osg::FloatArray* zOffsets = 0L;
 
@@ -104,31 +265,37 @@ GeometryClamper::apply(osg::Drawable& drawable)
         }
     }
 
+    bool filter = sampler._extent.isValid();
+
+    // First pass: compute the world point, up vector and terrain SRS
+    // coordinates of every vertex we intend to clamp.
+    std::vector<unsigned>   indices;
+    std::vector<osg::Vec3d> world, up, mapCoords;
+    indices.reserve( verts->size() );
+    world.reserve( verts->size() );
+    up.reserve( verts->size() );
+    mapCoords.reserve( verts->size() );
+
     for( unsigned k=0; k<verts->size(); ++k )
     {
         osg::Vec3d vw = (*verts)[k];
         vw = vw * local2world;
 
+        osg::Vec3d mc( vw.x(), vw.y(), 0.0 );
+
         if ( isGeocentric )
         {
             // normal to the ellipsoid:
             n_vector = em->computeLocalUpVector(vw.x(),vw.y(),vw.z());
 
-            // if we need to build to z-offsets array, calculate the z offset now:
-            if ( buildZOffsets || _scale != 1.0 )
+            double lat,lon,hae;
+            em->convertXYZToLatLongHeight(vw.x(), vw.y(), vw.z(), lat, lon, hae);
+            mc.set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), hae );
+
+            // if we need to build to z-offsets array, record the z offset now:
+            if ( buildZOffsets )
             {
-                double lat,lon,hae;
-                em->convertXYZToLatLongHeight(vw.x(), vw.y(), vw.z(), lat, lon, hae);
-
-                if ( buildZOffsets )
-                {
-                    zOffsets->push_back( hae ); //(*verts)[k].z() );
-                }
-
-                if ( _scale != 1.0 )
-                {
-                    msl = vw - n_vector*hae;
-                }
+                zOffsets->push_back( hae );
             }
         }
 
@@ -137,51 +304,98 @@ GeometryClamper::apply(osg::Drawable& drawable)
             zOffsets->push_back( float(vw.z()) );
         }
 
-        _lsi->reset();
-        _lsi->setStart( vw + n_vector*r*_scale );
-        _lsi->setEnd( vw - n_vector*r );
-        _lsi->setIntersectionLimit( _lsi->LIMIT_NEAREST );
+        if ( filter && !sampler._extent.contains(mc.x(), mc.y()) )
+            continue;
 
-        _terrainPatch->accept( iv );
+        indices.push_back( k );
+        world.push_back( vw );
+        up.push_back( n_vector );
+        mapCoords.push_back( mc );
+    }
 
-        if ( _lsi->containsIntersections() )
+    if ( indices.empty() )
+        return false;
+
+    // Second pass: find the terrain point under each vertex. The elevation
+    // pool samples the whole batch at once; otherwise intersect one by one.
+    std::vector<osg::Vec3d> terrain( indices.size() );
+    std::vector<bool>       hit( indices.size(), false );
+
+    if ( sampler._envelope.valid() )
+    {
+        std::vector<float> elevations;
+        sampler._envelope->getElevations( mapCoords, elevations );
+
+        for( unsigned i=0; i<indices.size(); ++i )
         {
-            osg::Vec3d fw = _lsi->getFirstIntersection().getWorldIntersectPoint();
-            if ( _scale != 1.0 )
+            if ( elevations[i] == NO_DATA_VALUE )
+                continue;
+
+            if ( isGeocentric )
             {
-                osg::Vec3d delta = fw - msl;
-                fw += delta*_scale;
+                em->convertLatLongHeightToXYZ(
+                    osg::DegreesToRadians(mapCoords[i].y()), osg::DegreesToRadians(mapCoords[i].x()), elevations[i],
+                    terrain[i].x(), terrain[i].y(), terrain[i].z() );
             }
-            if ( _offset != 0.0 )
+            else
             {
-                fw += n_vector*_offset;
+                terrain[i].set( mapCoords[i].x(), mapCoords[i].y(), elevations[i] );
             }
-            if ( _preserveZ && (zOffsets != 0L) )
+            hit[i] = true;
+        }
+    }
+    else
+    {
+        osgUtil::IntersectionVisitor iv( sampler._lsi.get() );
+
+        for( unsigned i=0; i<indices.size(); ++i )
+        {
+            sampler._lsi->reset();
+            sampler._lsi->setStart( world[i] + up[i]*r*_scale );
+            sampler._lsi->setEnd( world[i] - up[i]*r );
+            sampler._lsi->setIntersectionLimit( sampler._lsi->LIMIT_NEAREST );
+
+            _terrainPatch->accept( iv );
+
+            if ( sampler._lsi->containsIntersections() )
             {
-                fw += n_vector * (*zOffsets)[k];
+                terrain[i] = sampler._lsi->getFirstIntersection().getWorldIntersectPoint();
+                hit[i] = true;
             }
-
-            (*verts)[k] = (fw * world2local);
-            geomDirty = true;
-            ++count;
         }
     }
 
-    if ( geomDirty )
+    // Last pass: apply scale, offset and preserved Z, and write back.
+    bool geomDirty = false;
+
+    for( unsigned i=0; i<indices.size(); ++i )
     {
-        geom->dirtyBound();
-        if ( geom->getUseVertexBufferObjects() )
+        if ( !hit[i] )
+            continue;
+
+        unsigned k = indices[i];
+        osg::Vec3d fw = terrain[i];
+
+        if ( _scale != 1.0 )
         {
-            verts->getVertexBufferObject()->setUsage( GL_DYNAMIC_DRAW_ARB );
-            verts->dirty();
+            msl = isGeocentric ? world[i] - up[i]*mapCoords[i].z() : osg::Vec3d(world[i].x(), world[i].y(), 0.0);
+            osg::Vec3d delta = fw - msl;
+            fw += delta*_scale;
         }
-        else
+        if ( _offset != 0.0 )
+        {
+            fw += up[i]*_offset;
+        }
+        if ( _preserveZ && (zOffsets != 0L) )
         {
-            geom->dirtyDisplayList();
+            fw += up[i] * (*zOffsets)[k];
         }
 
-        OE_DEBUG << LC << "clamped " << count << " verts." << std::endl;
+        (*verts)[k] = (fw * world2local);
+        geomDirty = true;
     }
+
+    return geomDirty;
 }
 
 
@@ -190,5 +404,10 @@ GeometryClamperCallback::onTileAdded(const TileKey&          key,
                                      osg::Node*              tile, 
                                      TerrainCallbackContext& context)
 {
-    tile->accept( _clamper );
+    // Only vertices over the new tile can have changed:
+    _clamper.setClampExtent( key.valid() ? key.getExtent() : GeoExtent::INVALID );
+    if ( key.valid() )
+        _clamper.setElevationLOD( key.getLOD() );
+
+    _clamper.clamp( tile );
 }
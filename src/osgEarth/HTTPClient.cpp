@@ -17,22 +17,29 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/HTTPClient>
+#include <osgEarth/ImageDecoder>
 #include <osgEarth/Registry>
 #include <osgEarth/Version>
 #include <osgEarth/Progress>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Metrics>
+#include <osgEarth/StatsRegistry>
+#include <osgEarth/DateTime>
 #include <osgDB/ReadFile>
 #include <osgDB/Registry>
 #include <osgDB/FileNameUtils>
 #include <osg/Notify>
 #include <osg/Timer>
+#include <osg/Math>
 #include <string.h>
 #include <sstream>
 #include <fstream>
 #include <iterator>
 #include <iostream>
 #include <algorithm>
+#include <set>
+#include <map>
+#include <functional>
 #include <curl/curl.h>
 
 // Whether to use WinInet instead of cURL - CMAKE option
@@ -180,6 +187,16 @@ static int CurlProgressCallback(void *clientp,double dltotal,double dlnow,double
     return cancelled;
 }
 
+#if LIBCURL_VERSION_NUM >= 0x072000
+// Newer curls call this (instead of the deprecated double-based progress
+// function) and keep calling it while a transfer is stalled, so a canceled
+// request aborts without waiting for the next byte to arrive.
+static int CurlXferInfoCallback(void *clientp,curl_off_t dltotal,curl_off_t dlnow,curl_off_t ultotal,curl_off_t ulnow)
+{
+    return CurlProgressCallback(clientp, (double)dltotal, (double)dlnow, (double)ultotal, (double)ulnow);
+}
+#endif
+
 /****************************************************************************/
 
 HTTPRequest::HTTPRequest( const std::string& url )
@@ -381,6 +398,8 @@ namespace
     static osg::ref_ptr< URLRewriter > s_rewriter;
 
     static osg::ref_ptr< CurlConfigHandler > s_curlConfigHandler;
+
+    static unsigned                    s_maxRequestsInFlight = 0u;
 }
 
 HTTPClient&
@@ -451,7 +470,11 @@ HTTPClient::initializeImpl()
     curl_easy_setopt( _curl_handle, CURLOPT_HEADERFUNCTION, osgEarth::StreamObjectHeaderCallback );
     curl_easy_setopt( _curl_handle, CURLOPT_FOLLOWLOCATION, (void*)1 );
     curl_easy_setopt( _curl_handle, CURLOPT_MAXREDIRS, (void*)5 );
+#if LIBCURL_VERSION_NUM >= 0x072000
+    curl_easy_setopt( _curl_handle, CURLOPT_XFERINFOFUNCTION, &CurlXferInfoCallback);
+#else
     curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSFUNCTION, &CurlProgressCallback);
+#endif
     curl_easy_setopt( _curl_handle, CURLOPT_NOPROGRESS, (void*)0 ); //0=enable.
     curl_easy_setopt( _curl_handle, CURLOPT_FILETIME, true );
 
@@ -551,6 +574,39 @@ HTTPClient::globalInit()
     curl_global_init(CURL_GLOBAL_ALL);
 }
 
+void
+HTTPClient::setMaxRequestsInFlight( unsigned value )
+{
+    s_maxRequestsInFlight = value;
+}
+
+unsigned
+HTTPClient::getMaxRequestsInFlight()
+{
+    if ( s_maxRequestsInFlight == 0u )
+    {
+        const char* env = ::getenv("OSGEARTH_HTTP_MAX_IN_FLIGHT");
+        s_maxRequestsInFlight = env ? osg::maximum(1u, as<unsigned>(std::string(env), 32u)) : 32u;
+    }
+    return s_maxRequestsInFlight;
+}
+
+bool
+HTTPClient::isMultiplexRequested(const osgDB::Options* options)
+{
+    if ( options )
+    {
+        std::istringstream iss( options->getOptionString() );
+        std::string opt;
+        while( iss >> opt )
+        {
+            if ( opt == "OSGEARTH_HTTP_MULTIPLEX" )
+                return true;
+        }
+    }
+    return false;
+}
+
 void
 HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port) const
 {
@@ -718,6 +774,255 @@ HTTPClient::download(const std::string& uri,
     return getClient().doDownload( uri, localPath );
 }
 
+namespace
+{
+    // Feeds the stats registry with the outcome and duration of a GET.
+    void recordStats(const HTTPResponse& response)
+    {
+        static StatsRegistry::Histogram* s_duration = StatsRegistry::instance()->getHistogram(
+            "osgearth_http_request_duration_seconds", StatsRegistry::getLatencyBounds(), "", "Duration of HTTP GET requests");
+
+        static StatsRegistry::Counter* s_requests[7] = {
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"none\"", "HTTP GET requests by response class"),
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"1xx\""),
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"2xx\""),
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"3xx\""),
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"4xx\""),
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"5xx\""),
+            StatsRegistry::instance()->getCounter("osgearth_http_requests_total", "code=\"canceled\"") };
+
+        unsigned cls = response.isCancelled() ? 6u : response.getCode() / 100u;
+        s_requests[cls < 6u ? cls : 0u]->add();
+
+        if ( !response.isCancelled() )
+            s_duration->observe( response.getDuration() );
+    }
+
+    /**
+     * Per-host request budgets, shared by every thread's client and by the
+     * multiplexer. Each host has an optional cap on concurrent requests and
+     * an optional token bucket for its request rate. A request that doesn't
+     * fit waits, and waiting requests are admitted highest priority first.
+     */
+    class HostBudgets
+    {
+    public:
+        static HostBudgets& instance()
+        {
+            static HostBudgets s_instance;
+            return s_instance;
+        }
+
+        void setLimits(const std::string& host, unsigned maxConnections, double requestsPerSecond)
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            Budget& b = _hosts[host];
+            if ( b._rate != requestsPerSecond )
+                b._tokens = osg::maximum(1.0, requestsPerSecond);
+            b._maxConnections = maxConnections;
+            b._rate = requestsPerSecond;
+            _cond.broadcast();
+        }
+
+        //! Takes a slot if one is free right now; never waits.
+        bool tryAcquire(const std::string& host, float priority)
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            return take( _hosts[host], priority );
+        }
+
+        //! Waits for a slot. Returns false (holding nothing) if canceled first.
+        bool acquire(const std::string& host, float priority, ProgressCallback* progress)
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            Budget& b = _hosts[host];
+            if ( take(b, priority) )
+                return true;
+
+            std::multiset<float>::iterator waiter = b._waiting.insert( priority );
+            bool ok = false;
+            while( !(progress && progress->isCanceled()) )
+            {
+                if ( take(b, priority) )
+                {
+                    ok = true;
+                    break;
+                }
+                // short waits so token refills and cancelation are noticed
+                _cond.wait( &_mutex, 20 );
+            }
+            b._waiting.erase( waiter );
+            _cond.broadcast();
+            return ok;
+        }
+
+        void release(const std::string& host)
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            Budget& b = _hosts[host];
+            if ( b._active > 0u )
+                --b._active;
+            _cond.broadcast();
+        }
+
+        //! Holds off new requests to a host that asked us to slow down.
+        void backOff(const std::string& host, double seconds)
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            osg::Timer_t until = osg::Timer::instance()->tick() + (osg::Timer_t)(seconds / osg::Timer::instance()->getSecondsPerTick());
+            Budget& b = _hosts[host];
+            b._blockedUntil = osg::maximum( b._blockedUntil, until );
+        }
+
+    private:
+        struct Budget
+        {
+            Budget() : _maxConnections(0u), _rate(0.0), _tokens(0.0), _active(0u), _lastRefill(0), _blockedUntil(0) { }
+            unsigned             _maxConnections;
+            double               _rate;
+            double               _tokens;
+            unsigned             _active;
+            osg::Timer_t         _lastRefill;
+            osg::Timer_t         _blockedUntil;
+            std::multiset<float> _waiting;
+        };
+
+        // call with _mutex held
+        bool take(Budget& b, float priority)
+        {
+            osg::Timer_t now = osg::Timer::instance()->tick();
+
+            if ( b._rate > 0.0 )
+            {
+                if ( b._lastRefill != 0 )
+                {
+                    double dt = osg::Timer::instance()->delta_s( b._lastRefill, now );
+                    b._tokens = osg::minimum( b._tokens + dt * b._rate, osg::maximum(1.0, b._rate) );
+                }
+                b._lastRefill = now;
+            }
+
+            if ( now < b._blockedUntil )
+                return false;
+            if ( b._maxConnections > 0u && b._active >= b._maxConnections )
+                return false;
+            if ( b._rate > 0.0 && b._tokens < 1.0 )
+                return false;
+            if ( !b._waiting.empty() && *b._waiting.rbegin() > priority )
+                return false;
+
+            if ( b._rate > 0.0 )
+                b._tokens -= 1.0;
+            ++b._active;
+            return true;
+        }
+
+        Threading::Mutex                _mutex;
+        OpenThreads::Condition          _cond;
+        std::map<std::string, Budget>   _hosts;
+    };
+
+    // Holds a host budget slot for the life of a blocking request.
+    struct HostSlot
+    {
+        HostSlot(const std::string& host, ProgressCallback* progress) : _host(host)
+        {
+            _acquired = HostBudgets::instance().acquire( host, progress ? progress->getPriority() : 0.0f, progress );
+        }
+        ~HostSlot()
+        {
+            if ( _acquired )
+                HostBudgets::instance().release( _host );
+        }
+        bool acquired() const { return _acquired; }
+        std::string _host;
+        bool        _acquired;
+    };
+
+    // "host[:port]" part of a URL, which is what budgets are kept by.
+    std::string getHost(const std::string& url)
+    {
+        std::string::size_type start = url.find( "://" );
+        start = start == std::string::npos ? 0 : start + 3;
+        std::string::size_type end = url.find_first_of( "/?#", start );
+        std::string host = url.substr( start, end == std::string::npos ? std::string::npos : end - start );
+        std::string::size_type at = host.rfind( '@' );
+        return toLower( at == std::string::npos ? host : host.substr(at + 1) );
+    }
+
+    // Applies any host limits carried in the options string to "host". A layer
+    // passes the same options with every request, so each host and option
+    // string pair is only parsed and applied the first time it is seen.
+    void applyHostLimits(const std::string& host, const osgDB::Options* options)
+    {
+        if ( !options || options->getOptionString().find("OSGEARTH_HTTP_") == std::string::npos )
+            return;
+
+        static Threading::Mutex s_appliedMutex;
+        static std::set< std::pair<std::string, std::string> > s_applied;
+        {
+            Threading::ScopedMutexLock lock( s_appliedMutex );
+            if ( !s_applied.insert( std::make_pair(host, options->getOptionString()) ).second )
+                return;
+        }
+
+        optional<unsigned> maxConnections;
+        optional<double>   rate;
+        std::istringstream iss( options->getOptionString() );
+        std::string opt;
+        while( iss >> opt )
+        {
+            std::string::size_type eq = opt.find( '=' );
+            if ( eq == std::string::npos )
+                continue;
+            std::string key = opt.substr( 0, eq );
+            if ( key == "OSGEARTH_HTTP_MAX_CONNECTIONS" )
+                maxConnections = as<unsigned>( opt.substr(eq + 1), 0u );
+            else if ( key == "OSGEARTH_HTTP_RATE_LIMIT" )
+                rate = as<double>( opt.substr(eq + 1), 0.0 );
+        }
+
+        if ( maxConnections.isSet() || rate.isSet() )
+        {
+            HostBudgets::instance().setLimits( host, maxConnections.get(), rate.get() );
+        }
+    }
+
+    // Pauses a host that answered "429 Too Many Requests" or "503 Service
+    // Unavailable" for as long as its Retry-After asks (1s if it doesn't say).
+    void checkBackOff(const std::string& host, const HTTPResponse& response)
+    {
+        if ( response.getCode() != 429 && response.getCode() != 503 )
+            return;
+
+        double seconds = 1.0;
+        const ConfigSet& headers = response.getHeadersAsConfig().children();
+        for( ConfigSet::const_iterator i = headers.begin(); i != headers.end(); ++i )
+        {
+            if ( ciEquals(i->key(), "Retry-After") )
+            {
+                // either a number of seconds or an HTTP date
+                std::string value = trim( i->value() );
+                if ( !value.empty() && value.find_first_not_of("0123456789") == std::string::npos )
+                    seconds = as<double>( value, 1.0 );
+                else if ( DateTime(value).asTimeStamp() > 0 )
+                    seconds = (double)(DateTime(value).asTimeStamp() - DateTime().asTimeStamp());
+                break;
+            }
+        }
+
+        seconds = osg::clampBetween( seconds, 0.0, 60.0 );
+        OE_INFO << LC << host << " returned " << response.getCode() << "; pausing requests for " << seconds << "s" << std::endl;
+        HostBudgets::instance().backOff( host, seconds );
+    }
+}
+
+void
+HTTPClient::setHostLimits(const std::string& host, unsigned maxConnections, double requestsPerSecond)
+{
+    HostBudgets::instance().setLimits( toLower(host), maxConnections, requestsPerSecond );
+}
+
 
 #ifdef OSGEARTH_USE_WININET_FOR_HTTP
 
@@ -765,6 +1070,18 @@ HTTPClient::doGet(const HTTPRequest&    request,
         OE_DEBUG << LC << "Rewrote URL " << oldURL << " to " << url << std::endl;
     }
 
+    std::string host = getHost( request.getURL() );
+    applyHostLimits( host, options );
+
+    HostSlot slot( host, progress );
+    if ( !slot.acquired() )
+    {
+        // canceled while waiting for the host's budget
+        HTTPResponse response( 0L );
+        response._cancelled = true;
+        return response;
+    }
+
     HINTERNET hInternet = InternetOpen(
         getUserAgent().c_str(),
         //"Mozilla/5.0 (Windows NT 6.1; WOW64; Trident/7.0; AS; rv:11.0) like Gecko",
@@ -930,6 +1247,11 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
     response._mimeType = contentType;
 
+    // WinInet doesn't report the time to the first byte, so use the time
+    // until the headers arrive.
+    double latency = OE_GET_TIMER(http_get);
+    double bytes = 0.0;
+
     if ( statusCode == 200 )
     {
         osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
@@ -938,6 +1260,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
         while( InternetReadFile(hRequest, buffer, 4096, &numBytesRead) && numBytesRead )
         {
             part->_stream << std::string(buffer, numBytesRead);
+            bytes += numBytesRead;
         }
 
         response._parts.push_back( part.get() );
@@ -953,31 +1276,70 @@ HTTPClient::doGet(const HTTPRequest&    request,
     {
         progress->stats("http_get_time") += OE_GET_TIMER(http_get);
         progress->stats("http_get_count") += 1;
+        progress->stats("http_get_latency") += latency;
+        progress->stats("http_get_bytes") += bytes;
         if ( response._cancelled )
             progress->stats("http_cancel_count") += 1;
     }
 
+    checkBackOff( host, response );
+
+    recordStats( response );
+
     METRIC_END("HTTPClient::doGet", 1,
                  "response_code", toString<int>(response.getCode()).c_str());
 
     return response;
 }
 
+Threading::Future<HTTPAsyncResponse>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress,
+                     HTTPResponseCallback* callback)
+{
+    // WinInet has no multi interface; complete the request before returning.
+    Threading::Promise<HTTPAsyncResponse> promise;
+    HTTPResponse response = getClient().doGet( request, options, progress );
+    if ( callback )
+        callback->onResponse( request, response );
+    promise.resolve( new HTTPAsyncResponse(response) );
+    return promise.getFuture();
+}
+
 #else // OSGEARTH_USE_WININET_FOR_HTTP
 
-HTTPResponse
-HTTPClient::doGet(const HTTPRequest&    request,
-                  const osgDB::Options* options,
-                  ProgressCallback*     progress) const
+/**
+ * State of one GET transfer on a curl easy handle, shared between the
+ * blocking path and the multiplexer.
+ */
+struct HTTPClient::CurlGet
 {
-    METRIC_BEGIN("HTTPClient::doGet", 1,
-                   "url", request.getURL().c_str());
+    CurlGet() : _headers(0L), _sp(0L), _startTime(0), _performTime(0) { _errorBuf[0] = 0; }
+    ~CurlGet() { if (_headers) curl_slist_free_all(_headers); }
+
+    std::string                      _url;
+    std::string                      _proxyAddr;
+    struct curl_slist*               _headers;
+    osg::ref_ptr<HTTPResponse::Part> _part;
+    StreamObject                     _sp;
+    char                             _errorBuf[CURL_ERROR_SIZE];
+    osg::Timer_t                     _startTime;
+    osg::Timer_t                     _performTime;
+};
 
+bool
+HTTPClient::prepareGet(const HTTPRequest&    request,
+                       const osgDB::Options* options,
+                       ProgressCallback*     progress,
+                       CurlGet&              get) const
+{
     initialize();
 
-    OE_START_TIMER(http_get);
+    get._startTime = osg::Timer::instance()->tick();
 
-    std::string url = request.getURL();
+    get._url = request.getURL();
+    std::string& url = get._url;
 
     const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ?
             options->getAuthenticationMap() :
@@ -1039,7 +1401,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
     }
 
     // Set up proxy server:
-    std::string proxy_addr;
+    std::string& proxy_addr = get._proxyAddr;
     if ( !proxy_host.empty() )
     {
         std::stringstream buf;
@@ -1124,7 +1486,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
 
 
     // Set any headers
-    struct curl_slist *headers=NULL;
+    struct curl_slist*& headers = get._headers;
     if (!request.getHeaders().empty())
     {
         for (HTTPRequest::Parameters::const_iterator itr = request.getHeaders().begin(); itr != request.getHeaders().end(); ++itr)
@@ -1139,56 +1501,65 @@ HTTPClient::doGet(const HTTPRequest&    request,
     headers = curl_slist_append(headers, "Pragma: ");
     curl_easy_setopt(_curl_handle, CURLOPT_HTTPHEADER, headers);
 
-    osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
-    StreamObject sp( &part->_stream );
+    get._part = new HTTPResponse::Part();
+    get._sp._stream = &get._part->_stream;
 
     //Take a temporary ref to the callback (why? dangerous.)
     //osg::ref_ptr<ProgressCallback> progressCallback = callback;
     curl_easy_setopt( _curl_handle, CURLOPT_URL, url.c_str() );
-    if (progress)
+    // PROGRESSDATA is the same slot as XFERINFODATA; always set it so a
+    // handle reused from a canceled request can't see a stale callback.
+    curl_easy_setopt(_curl_handle, CURLOPT_PROGRESSDATA, (void*)progress);
+
+    get._performTime = osg::Timer::instance()->tick();
+
+    if ( _simResponseCode >= 0 )
+        return false;
+
+    curl_easy_setopt( _curl_handle, CURLOPT_ERRORBUFFER, (void*)get._errorBuf );
+    curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)&get._sp);
+    curl_easy_setopt( _curl_handle, CURLOPT_HEADERDATA, (void*)&get._sp);
+
+    //Disable peer certificate verification to allow us to access in https servers where the peer certificate cannot be verified.
+    curl_easy_setopt( _curl_handle, CURLOPT_SSL_VERIFYPEER, (void*)0 );
+
+    osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
+    if (curlConfigHandler.valid()) {
+        curlConfigHandler->onGet(_curl_handle);
+    }
+
+    return true;
+}
+
+HTTPResponse
+HTTPClient::finishGet(int               result,
+                      CurlGet&          get,
+                      ProgressCallback* progress) const
+{
+    // canceled while still queued; the handle never saw this request.
+    if ( !get._part.valid() )
     {
-        curl_easy_setopt(_curl_handle, CURLOPT_PROGRESSDATA, progress);
+        HTTPResponse response( 0L );
+        response._cancelled = true;
+        return response;
     }
 
-    CURLcode res;
+    CURLcode res = (CURLcode)result;
     long response_code = 0L;
 
-    OE_START_TIMER(get_duration);
-
     if ( _simResponseCode < 0 )
     {
-        char errorBuf[CURL_ERROR_SIZE];
-        errorBuf[0] = 0;
-        curl_easy_setopt( _curl_handle, CURLOPT_ERRORBUFFER, (void*)errorBuf );
-        curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)&sp);
-        curl_easy_setopt( _curl_handle, CURLOPT_HEADERDATA, (void*)&sp);
-
-        //Disable peer certificate verification to allow us to access in https servers where the peer certificate cannot be verified.
-        curl_easy_setopt( _curl_handle, CURLOPT_SSL_VERIFYPEER, (void*)0 );
-
-        osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
-        if (curlConfigHandler.valid()) {
-            curlConfigHandler->onGet(_curl_handle);
-        }
-
-        res = curl_easy_perform(_curl_handle);
         curl_easy_setopt( _curl_handle, CURLOPT_WRITEDATA, (void*)0 );
+        curl_easy_setopt( _curl_handle, CURLOPT_HEADERDATA, (void*)0 );
         curl_easy_setopt( _curl_handle, CURLOPT_PROGRESSDATA, (void*)0);
 
-        if (!proxy_addr.empty())
+        if (!get._proxyAddr.empty())
         {
             long connect_code = 0L;
             CURLcode r = curl_easy_getinfo(_curl_handle, CURLINFO_HTTP_CONNECTCODE, &connect_code);
             if ( r != CURLE_OK )
             {
                 OE_WARN << LC << "Proxy connect error: " << curl_easy_strerror(r) << std::endl;
-
-                // Free the headers
-                if (headers)
-                {
-                    curl_slist_free_all(headers);
-                }
-
                 return HTTPResponse(0);
             }
         }
@@ -1203,6 +1574,9 @@ HTTPClient::doGet(const HTTPRequest&    request,
     }
 
     HTTPResponse response( response_code );
+    osg::ref_ptr<HTTPResponse::Part>& part = get._part;
+    StreamObject& sp = get._sp;
+    const std::string& url = get._url;
 
     // read the response content type:
     char* content_type_cp;
@@ -1250,12 +1624,23 @@ HTTPClient::doGet(const HTTPRequest&    request,
         response._cancelled = true;
     }
 
-    response._duration_s = OE_STOP_TIMER(get_duration);
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    response._duration_s = osg::Timer::instance()->delta_s( get._performTime, now );
+
+    // time to the first byte and size of the body, for link quality estimates.
+    double latency = 0.0, bytes = 0.0;
+    if ( _simResponseCode < 0 )
+    {
+        curl_easy_getinfo( _curl_handle, CURLINFO_STARTTRANSFER_TIME, &latency );
+        curl_easy_getinfo( _curl_handle, CURLINFO_SIZE_DOWNLOAD, &bytes );
+    }
 
     if ( progress )
     {
-        progress->stats()["http_get_time"] += OE_STOP_TIMER(http_get);
+        progress->stats()["http_get_time"] += osg::Timer::instance()->delta_s( get._startTime, now );
         progress->stats()["http_get_count"] += 1;
+        progress->stats()["http_get_latency"] += latency;
+        progress->stats()["http_get_bytes"] += bytes;
         if ( response._cancelled )
             progress->stats()["http_cancel_count"] += 1;
     }
@@ -1310,11 +1695,53 @@ HTTPClient::doGet(const HTTPRequest&    request,
 #endif
     }
 
-    // Free the headers
-    if (headers)
+    return response;
+}
+
+HTTPResponse
+HTTPClient::doGet(const HTTPRequest&    request,
+                  const osgDB::Options* options,
+                  ProgressCallback*     progress) const
+{
+    METRIC_BEGIN("HTTPClient::doGet", 1,
+                   "url", request.getURL().c_str());
+
+    HTTPResponse response;
+
+    if ( isMultiplexRequested(options) )
     {
-        curl_slist_free_all(headers);
+        // Share the multiplexer's connections instead of this thread's handle.
+        Threading::Future<HTTPAsyncResponse> result = getAsync( request, options, progress );
+        osg::ref_ptr<HTTPAsyncResponse> async = result.get();
+        if ( async.valid() )
+            response = async->getResponse();
     }
+    else
+    {
+        std::string host = getHost( request.getURL() );
+        applyHostLimits( host, options );
+
+        HostSlot slot( host, progress );
+        if ( slot.acquired() )
+        {
+            CurlGet get;
+            CURLcode res = CURLE_OK;
+            if ( prepareGet(request, options, progress, get) )
+            {
+                res = curl_easy_perform(_curl_handle);
+            }
+            response = finishGet( res, get, progress );
+            checkBackOff( host, response );
+        }
+        else
+        {
+            // canceled while waiting for the host's budget
+            response = HTTPResponse( 0L );
+            response._cancelled = true;
+        }
+    }
+
+    recordStats( response );
 
     METRIC_END("HTTPClient::doGet", 2,
                "response_code", toString<int>(response.getCode()).c_str(),
@@ -1323,6 +1750,311 @@ HTTPClient::doGet(const HTTPRequest&    request,
     return response;
 }
 
+/**
+ * Drives asynchronous GETs on a single curl multi handle from one
+ * background thread. Each in-flight transfer borrows a pooled HTTPClient
+ * (and therefore its easy handle and auth state); the multi handle owns
+ * the connection cache, so connections are reused across transfers.
+ */
+class HTTPClient::Multiplexer : public OpenThreads::Thread
+{
+public:
+    static Multiplexer& instance()
+    {
+        static Multiplexer s_instance;
+        return s_instance;
+    }
+
+    Threading::Future<HTTPAsyncResponse> add(const HTTPRequest&    request,
+                                             const osgDB::Options* options,
+                                             ProgressCallback*     progress,
+                                             HTTPResponseCallback* callback)
+    {
+        Job* job = new Job( request, options, progress, callback );
+        job->_host = getHost( request.getURL() );
+        applyHostLimits( job->_host, options );
+        Threading::Future<HTTPAsyncResponse> future = job->_promise.getFuture();
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _pending.insert( PendingJobs::value_type(job->getPriority(), job) );
+            if ( !isRunning() && !_done )
+                start();
+        }
+        _wake.signal();
+        return future;
+    }
+
+    void run()
+    {
+        while( !_done )
+        {
+            {
+                Threading::ScopedMutexLock lock( _mutex );
+                while( !_done && _pending.empty() && _inFlight.empty() )
+                    _wake.wait( &_mutex );
+            }
+
+            startPending();
+
+            int running = 0;
+            curl_multi_perform( _multi, &running );
+
+            collectFinished();
+
+            abortCanceled();
+
+            if ( !_inFlight.empty() )
+            {
+#if LIBCURL_VERSION_NUM >= 0x071C00
+                int numfds = 0;
+                curl_multi_wait( _multi, 0L, 0, 10, &numfds );
+#else
+                OpenThreads::Thread::microSleep( 1000 );
+#endif
+            }
+            else
+            {
+                // anything still pending is waiting on its host's budget
+                OpenThreads::Thread::microSleep( 5000 );
+            }
+        }
+
+        // shutting down; abandon whatever is left.
+        for( InFlight::iterator i = _inFlight.begin(); i != _inFlight.end(); ++i )
+        {
+            curl_multi_remove_handle( _multi, i->first );
+            complete( i->second, CURLE_ABORTED_BY_CALLBACK );
+        }
+        _inFlight.clear();
+    }
+
+private:
+    struct Job
+    {
+        Job(const HTTPRequest& request, const osgDB::Options* options, ProgressCallback* progress, HTTPResponseCallback* callback) :
+            _request( request ), _options( options ), _progress( progress ), _callback( callback ), _client( 0L ), _hasSlot( false ) { }
+
+        float getPriority() const { return _progress.valid() ? _progress->getPriority() : 0.0f; }
+
+        HTTPRequest                            _request;
+        osg::ref_ptr<const osgDB::Options>     _options;
+        osg::ref_ptr<ProgressCallback>         _progress;
+        osg::ref_ptr<HTTPResponseCallback>     _callback;
+        Threading::Promise<HTTPAsyncResponse>  _promise;
+        HTTPClient*                            _client;
+        CurlGet                                _get;
+        std::string                            _host;
+        bool                                   _hasSlot;
+    };
+
+    // Jobs waiting to start, highest priority (as of when they were added)
+    // first and oldest first among equals.
+    typedef std::multimap<float, Job*, std::greater<float> > PendingJobs;
+
+    typedef std::map<CURL*, Job*> InFlight;
+
+    Multiplexer() : _done( false )
+    {
+        _multi = curl_multi_init();
+
+#if LIBCURL_VERSION_NUM >= 0x072B00
+        curl_multi_setopt( _multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX );
+#endif
+    }
+
+    ~Multiplexer()
+    {
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+            _done = true;
+        }
+        _wake.signal();
+        if ( isRunning() )
+            join();
+
+        for( PendingJobs::iterator i = _pending.begin(); i != _pending.end(); ++i )
+            delete i->second;
+
+        for( std::vector<HTTPClient*>::iterator i = _idle.begin(); i != _idle.end(); ++i )
+            delete *i;
+
+        curl_multi_cleanup( _multi );
+    }
+
+    HTTPClient* borrowClient()
+    {
+        if ( !_idle.empty() )
+        {
+            HTTPClient* client = _idle.back();
+            _idle.pop_back();
+            return client;
+        }
+
+        HTTPClient* client = new HTTPClient();
+        client->initialize();
+
+#if LIBCURL_VERSION_NUM >= 0x072B00
+        // wait for an existing connection to multiplex on rather than opening another
+        curl_easy_setopt( client->_curl_handle, CURLOPT_PIPEWAIT, 1L );
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072F00
+        curl_easy_setopt( client->_curl_handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS );
+#endif
+        return client;
+    }
+
+    void startPending()
+    {
+        unsigned maxInFlight = HTTPClient::getMaxRequestsInFlight();
+
+        while( _inFlight.size() < maxInFlight )
+        {
+            Job* job = 0L;
+            {
+                Threading::ScopedMutexLock lock( _mutex );
+                job = takeNext();
+                if ( !job )
+                    break;
+            }
+
+            if ( job->_progress.valid() && job->_progress->isCanceled() )
+            {
+                job->_client = borrowClient();
+                complete( job, CURLE_ABORTED_BY_CALLBACK );
+                continue;
+            }
+
+            job->_client = borrowClient();
+
+            if ( job->_client->prepareGet(job->_request, job->_options.get(), job->_progress.get(), job->_get) )
+            {
+                CURL* handle = job->_client->_curl_handle;
+                _inFlight[handle] = job;
+                curl_multi_add_handle( _multi, handle );
+            }
+            else
+            {
+                // simulated response code; nothing to transfer.
+                complete( job, CURLE_OK );
+            }
+        }
+    }
+
+    // Removes and returns the next job to start, in priority order: a
+    // canceled one (so it completes right away) or one whose host has room
+    // in its budget. Call with _mutex held.
+    Job* takeNext()
+    {
+        std::set<std::string> full;
+        for( PendingJobs::iterator i = _pending.begin(); i != _pending.end(); ++i )
+        {
+            Job* job = i->second;
+            bool take = false;
+
+            if ( job->_progress.valid() && job->_progress->isCanceled() )
+            {
+                take = true;
+            }
+            else if ( full.find(job->_host) == full.end() )
+            {
+                if ( HostBudgets::instance().tryAcquire(job->_host, job->getPriority()) )
+                {
+                    job->_hasSlot = true;
+                    take = true;
+                }
+                else
+                {
+                    full.insert( job->_host );
+                }
+            }
+
+            if ( take )
+            {
+                _pending.erase( i );
+                return job;
+            }
+        }
+        return 0L;
+    }
+
+    void collectFinished()
+    {
+        int remaining = 0;
+        CURLMsg* msg = 0L;
+        while( (msg = curl_multi_info_read(_multi, &remaining)) != 0L )
+        {
+            if ( msg->msg != CURLMSG_DONE )
+                continue;
+
+            CURL* handle = msg->easy_handle;
+            CURLcode result = msg->data.result;
+
+            InFlight::iterator i = _inFlight.find( handle );
+            curl_multi_remove_handle( _multi, handle );
+            if ( i != _inFlight.end() )
+            {
+                Job* job = i->second;
+                _inFlight.erase( i );
+                complete( job, result );
+            }
+        }
+    }
+
+    // Pulls canceled transfers out of the multi handle right away instead of
+    // waiting for curl's next progress callback, which can take up to a
+    // second on a stalled connection.
+    void abortCanceled()
+    {
+        for( InFlight::iterator i = _inFlight.begin(); i != _inFlight.end(); )
+        {
+            Job* job = i->second;
+            if ( job->_progress.valid() && job->_progress->isCanceled() )
+            {
+                curl_multi_remove_handle( _multi, i->first );
+                _inFlight.erase( i++ );
+                complete( job, CURLE_ABORTED_BY_CALLBACK );
+            }
+            else ++i;
+        }
+    }
+
+    void complete(Job* job, CURLcode result)
+    {
+        HTTPResponse response = job->_client->finishGet( result, job->_get, job->_progress.get() );
+
+        if ( job->_hasSlot )
+        {
+            HostBudgets::instance().release( job->_host );
+            checkBackOff( job->_host, response );
+        }
+
+        if ( job->_callback.valid() )
+            job->_callback->onResponse( job->_request, response );
+
+        job->_promise.resolve( new HTTPAsyncResponse(response) );
+
+        _idle.push_back( job->_client );
+        delete job;
+    }
+
+    CURLM*                   _multi;
+    PendingJobs              _pending;
+    InFlight                 _inFlight;
+    std::vector<HTTPClient*> _idle;
+    Threading::Mutex         _mutex;
+    OpenThreads::Condition   _wake;
+    volatile bool            _done;
+};
+
+Threading::Future<HTTPAsyncResponse>
+HTTPClient::getAsync(const HTTPRequest&    request,
+                     const osgDB::Options* options,
+                     ProgressCallback*     progress,
+                     HTTPResponseCallback* callback)
+{
+    return Multiplexer::instance().add( request, options, progress, callback );
+}
+
 #endif // USE_WININET
 
 bool
@@ -1413,30 +2145,24 @@ HTTPClient::doReadImage(const HTTPRequest&    request,
 
     if (response.isOK())
     {
-        osgDB::ReaderWriter* reader = getReader(request.getURL(), response);
-        if (!reader)
-        {
-            result = ReadResult(ReadResult::RESULT_NO_READER);
-        }
+        // the decoder identifies the format from the data itself, so the
+        // extension and mime type are only fallbacks here.
+        result = ImageDecoder::decode(
+            response.getPartStream(0),
+            osgDB::getFileExtension(request.getURL()),
+            response.getMimeType(),
+            options,
+            ImageDecoder::getMaxSize(options) );
 
-        else
+        if ( !result.succeeded() && s_HTTP_DEBUG )
         {
-            osgDB::ReaderWriter::ReadResult rr = reader->readImage(response.getPartStream(0), options);
-            if ( rr.validImage() )
-            {
-                result = ReadResult(rr.takeImage());
-            }
-            else
+            OE_WARN << LC << "Failed to read image from " << request.getURL()
+                << "; message = " << result.errorDetail()
+                << std::endl;
+
+            if ( endsWith(response.getMimeType(), "xml", false) )
             {
-                if ( s_HTTP_DEBUG )
-                {
-                    OE_WARN << LC << reader->className()
-                        << " failed to read image from " << request.getURL()
-                        << "; message = " << rr.message()
-                        <<  std::endl;
-                }
-                result = ReadResult(ReadResult::RESULT_READER_ERROR);
-                result.setErrorDetail( rr.message() );
+                OE_WARN << LC << "Content:\n" << response.getPartAsString(0) << "\n";
             }
         }
 
@@ -24,6 +24,9 @@
 #include <osgEarth/CullingUtils>
 #include <osgEarth/ImageUtils>
 #include <osg/Notify>
+#include <cfloat>
+#include <algorithm>
+#include <vector>
 
 using namespace osgEarth;
 
@@ -57,6 +60,85 @@ HeightFieldUtils::validateSamples(float &a, float &b, float &c, float &d)
     return true;
 }
 
+namespace
+{
+    // Catmull-Rom spline through p[1] and p[2] at parameter t in [0..1].
+    inline double catmullRom(const double* p, double t)
+    {
+        return p[1] + 0.5*t*(p[2]-p[0] + t*(2.0*p[0]-5.0*p[1]+4.0*p[2]-p[3] + t*(3.0*(p[1]-p[2])+p[3]-p[0])));
+    }
+}
+
+namespace
+{
+    // Where an output post falls between two input posts.
+    struct Tap
+    {
+        unsigned _i0, _i1;
+        float    _w;       // weight of _i1
+    };
+
+    void computeTaps(unsigned inSize, unsigned outSize, std::vector<Tap>& taps)
+    {
+        taps.resize(outSize);
+        for(unsigned i=0; i<outSize; ++i)
+        {
+            double p = outSize > 1u ? (double)i / (double)(outSize-1) * (double)(inSize-1) : 0.0;
+            Tap& tap = taps[i];
+            tap._i0 = osg::minimum((unsigned)p, inSize-1u);
+            tap._i1 = osg::minimum(tap._i0+1u, inSize-1u);
+            tap._w  = (float)(p - (double)tap._i0);
+        }
+    }
+
+    // Bilinear resampling of a whole heightfield onto another's grid. The
+    // weights are separable, so they are worked out once per column and row,
+    // leaving a straight-line inner loop. Posts next to NO_DATA_VALUE go
+    // through getHeightAtPixel, which knows how to patch the holes.
+    void resampleBilinear(const osg::HeightField* input, osg::HeightField* output)
+    {
+        unsigned inCols  = input->getNumColumns(),  inRows  = input->getNumRows();
+        unsigned outCols = output->getNumColumns(), outRows = output->getNumRows();
+
+        std::vector<Tap> cs, rs;
+        computeTaps(inCols, outCols, cs);
+        computeTaps(inRows, outRows, rs);
+
+        const float* in = &input->getFloatArray()->front();
+        float* out = &output->getFloatArray()->front();
+
+        for(unsigned r=0; r<outRows; ++r)
+        {
+            const Tap& rt = rs[r];
+            const float* row0 = in + rt._i0*inCols;
+            const float* row1 = in + rt._i1*inCols;
+            float* o = out + r*outCols;
+
+            for(unsigned c=0; c<outCols; ++c)
+            {
+                const Tap& ct = cs[c];
+                float ll = row0[ct._i0], lr = row0[ct._i1];
+                float ul = row1[ct._i0], ur = row1[ct._i1];
+
+                if ( ll == NO_DATA_VALUE || lr == NO_DATA_VALUE || ul == NO_DATA_VALUE || ur == NO_DATA_VALUE )
+                {
+                    o[c] = HeightFieldUtils::getHeightAtPixel(
+                        input,
+                        (double)ct._i0 + (double)ct._w,
+                        (double)rt._i0 + (double)rt._w,
+                        INTERP_BILINEAR );
+                }
+                else
+                {
+                    float s = ll + (lr-ll)*ct._w;
+                    float n = ul + (ur-ul)*ct._w;
+                    o[c] = s + (n-s)*rt._w;
+                }
+            }
+        }
+    }
+}
+
 float
 HeightFieldUtils::getHeightAtPixel(const osg::HeightField* hf, double c, double r, ElevationInterpolation interpolation)
 {
@@ -143,6 +225,37 @@ HeightFieldUtils::getHeightAtPixel(const osg::HeightField* hf, double c, double
 
         result = ( n.x() * ( c - v0.x() ) + n.y() * ( r - v0.y() ) ) / -n.z() + v0.z();
     }
+    else if (interpolation == INTERP_BICUBIC)
+    {
+        // Catmull-Rom over the surrounding 4x4 posts, clamped at the edges.
+        // It passes through the posts, so upsampled tiles match their source.
+        int cols = (int)hf->getNumColumns();
+        int rows = (int)hf->getNumRows();
+        int col0 = osg::clampBetween((int)floor(c), 0, cols-1);
+        int row0 = osg::clampBetween((int)floor(r), 0, rows-1);
+        double tx = osg::clampBetween(c - (double)col0, 0.0, 1.0);
+        double ty = osg::clampBetween(r - (double)row0, 0.0, 1.0);
+
+        double p[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            int row = osg::clampBetween(row0 + j - 1, 0, rows-1);
+
+            double q[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                float h = hf->getHeight(osg::clampBetween(col0 + i - 1, 0, cols-1), row);
+                if (h == NO_DATA_VALUE)
+                {
+                    // the kernel would smear the hole; settle for bilinear.
+                    return getHeightAtPixel(hf, c, r, INTERP_BILINEAR);
+                }
+                q[i] = h;
+            }
+            p[j] = catmullRom(q, tx);
+        }
+        result = (float)catmullRom(p, ty);
+    }
     else
     {
         //OE_INFO << "getHeightAtPixel: (" << c << ", " << r << ")" << std::endl;
@@ -255,6 +368,51 @@ HeightFieldUtils::getHeightAtLocation(const osg::HeightField* hf, double x, doub
     return getHeightAtPixel(hf, px, py, interpolation);
 }
 
+void
+HeightFieldUtils::getHeightsAtLocations(const osg::HeightField* hf,
+                                        const osg::Vec3d* points, unsigned numPoints,
+                                        double llx, double lly, double dx, double dy,
+                                        float* out_heights)
+{
+    const int cols = (int)hf->getNumColumns();
+    const int rows = (int)hf->getNumRows();
+    const double maxc = (double)(cols-1);
+    const double maxr = (double)(rows-1);
+    const double idx = 1.0/dx;
+    const double idy = 1.0/dy;
+    const float* heights = &hf->getFloatArray()->front();
+
+    for (unsigned i = 0; i < numPoints; ++i)
+    {
+        double c = osg::clampBetween( (points[i].x() - llx) * idx, 0.0, maxc );
+        double r = osg::clampBetween( (points[i].y() - lly) * idy, 0.0, maxr );
+
+        int c0 = (int)c;
+        int r0 = (int)r;
+        double fc = c - (double)c0;
+        double fr = r - (double)r0;
+        int c1 = fc > 0.0 ? c0+1 : c0;
+        int r1 = fr > 0.0 ? r0+1 : r0;
+
+        float ll = heights[r0*cols + c0];
+        float lr = heights[r0*cols + c1];
+        float ul = heights[r1*cols + c0];
+        float ur = heights[r1*cols + c1];
+
+        if (ll == NO_DATA_VALUE || lr == NO_DATA_VALUE || ul == NO_DATA_VALUE || ur == NO_DATA_VALUE)
+        {
+            // rare; let the general path resolve the no-data posts.
+            out_heights[i] = getHeightAtPixel(hf, c, r, INTERP_BILINEAR);
+        }
+        else
+        {
+            double bottom = (double)ll + fc*((double)lr - (double)ll);
+            double top    = (double)ul + fc*((double)ur - (double)ul);
+            out_heights[i] = (float)(bottom + fr*(top - bottom));
+        }
+    }
+}
+
 osg::Vec3
 HeightFieldUtils::getNormalAtLocation(const HeightFieldNeighborhood& hood, double x, double y, double llx, double lly, double dx, double dy, ElevationInterpolation interp)
 {
@@ -488,6 +646,12 @@ HeightFieldUtils::resampleHeightField(osg::HeightField*      input,
     output->setXInterval( stepX );
     output->setYInterval( stepY );
     output->setOrigin( origin );
+
+    if ( interp == INTERP_BILINEAR )
+    {
+        resampleBilinear( input, output );
+        return output;
+    }
     
     for( int y = 0; y < newRows; ++y )
     {
@@ -537,15 +701,17 @@ HeightFieldUtils::createReferenceHeightField(const GeoExtent& ex,
         double latStart = latMin - latInterval*(double)border;
         double lonStart = lonMin - lonInterval*(double)border;
 
-        for( unsigned r=0; r<hf->getNumRows(); ++r )
-        {            
-            double lat = latStart + latInterval*(double)r;
-            for( unsigned c=0; c<hf->getNumColumns(); ++c )
-            {
-                double lon = lonStart + lonInterval*(double)c;
-                double offset = vdatum->msl2hae(lat, lon, 0.0);
-                hf->setHeight( c, r, offset );
-            }
+        if ( vdatum->getGeoid() )
+        {
+            // the MSL=0 surface is just the geoid, so sample it in one pass.
+            vdatum->getGeoid()->getHeights(
+                lonStart, latStart, lonInterval, latInterval,
+                hf->getNumColumns(), hf->getNumRows(),
+                &hf->getFloatArray()->front() );
+        }
+        else
+        {
+            hf->getFloatArray()->assign(hf->getNumColumns()*hf->getNumRows(), 0.0f);
         }
     }
     else
@@ -575,17 +741,18 @@ HeightFieldUtils::resolveInvalidHeights(osg::HeightField* grid,
         double lonInterval = geodeticExtent.width() / (double)(numCols-1);
         double latInterval = geodeticExtent.height() / (double)(numRows-1);
 
-        for( unsigned r=0; r<numRows; ++r )
+        osg::HeightField::HeightList& heights = grid->getHeightList();
+        if ( std::find(heights.begin(), heights.end(), invalidValue) == heights.end() )
+            return;
+
+        // sample the geoid for the whole grid in one pass, then patch the holes.
+        std::vector<float> geoidHeights( numCols*numRows );
+        geoid->getHeights( lonMin, latMin, lonInterval, latInterval, numCols, numRows, &geoidHeights[0] );
+
+        for( unsigned i=0; i<heights.size(); ++i )
         {
-            double lat = latMin + latInterval*(double)r;
-            for( unsigned c=0; c<numCols; ++c )
-            {
-                double lon = lonMin + lonInterval*(double)c;
-                if ( grid->getHeight(c, r) == invalidValue )
-                {
-                    grid->setHeight( c, r, geoid->getHeight(lat, lon) );
-                }
-            }
+            if ( heights[i] == invalidValue )
+                heights[i] = geoidHeights[i];
         }
     }
     else
@@ -799,24 +966,35 @@ HeightFieldUtils::createNormalMap(const osg::Image* elevation,
     double mPerDegAtEquator = (srs->getEllipsoid()->getRadiusEquator() * 2.0 * osg::PI) / 360.0;
     double dy = srs->isGeographic() ? yInterval * mPerDegAtEquator : yInterval;
 
+    // Decode the elevations once; each post is needed by five stencils.
+    int width = (int)elevation->s();
+    std::vector<float> heights( width * (int)elevation->t() );
+    for (int t = 0; t<(int)elevation->t(); ++t)
+        for(int s=0; s<width; ++s)
+            heights[t*width + s] = readElevation(s, t).r();
+
     for (int t = 0; t<(int)elevation->t(); ++t)
     {
         double lat = extent.yMin() + yInterval*(double)t;
         double dx = srs->isGeographic() ? xInterval * mPerDegAtEquator * cos(osg::DegreesToRadians(lat)) : xInterval;
 
-        for(int s=0; s<(int)elevation->s(); ++s)
+        const float* row      = &heights[t*width];
+        const float* rowSouth = &heights[std::max(0, t - 1)*width];
+        const float* rowNorth = &heights[std::min(tMax, t + 1)*width];
+
+        for(int s=0; s<width; ++s)
         {
-            float h = readElevation(s, t).r();
+            float h = row[s];
 
             osg::Vec3f west ( s > 0 ? -dx : 0, 0, h );
             osg::Vec3f east ( s < sMax ?  dx : 0, 0, h );
             osg::Vec3f south( 0, t > 0 ? -dy : 0, h );
             osg::Vec3f north( 0, t < tMax ? dy : 0, h );
 
-            west.z() = readElevation(std::max(0, s - 1), t).r();
-            east.z() = readElevation(std::min(sMax, s + 1), t).r();
-            south.z() = readElevation(s, std::max(0, t - 1)).r();
-            north.z() = readElevation(s, std::min(tMax, t + 1)).r();
+            west.z() = row[std::max(0, s - 1)];
+            east.z() = row[std::min(sMax, s + 1)];
+            south.z() = rowSouth[s];
+            north.z() = rowNorth[s];
 
             osg::Vec3f n = (east-west) ^ (north-south);
             n.normalize();
@@ -904,3 +1082,55 @@ FillNoDataOperator::operator ()(osg::HeightField *heightField)
     }
 }
 #endif
+
+#define QUANTIZED_NO_DATA 0xFFFFu
+
+void
+HeightFieldUtils::quantizeHeights(const osg::HeightField* hf,
+                                  unsigned short*         out,
+                                  float&                  out_offset,
+                                  float&                  out_scale)
+{
+    const osg::HeightField::HeightList& heights = hf->getHeightList();
+
+    float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+    for(unsigned i=0; i<heights.size(); ++i)
+    {
+        if ( heights[i] != NO_DATA_VALUE )
+        {
+            minHeight = std::min(minHeight, heights[i]);
+            maxHeight = std::max(maxHeight, heights[i]);
+        }
+    }
+
+    if ( minHeight > maxHeight )
+    {
+        minHeight = maxHeight = 0.0f;
+    }
+
+    // the top value is reserved for NO_DATA_VALUE.
+    out_offset = minHeight;
+    out_scale  = (maxHeight - minHeight) / (float)(QUANTIZED_NO_DATA - 1u);
+    float invScale = out_scale > 0.0f ? 1.0f/out_scale : 0.0f;
+
+    for(unsigned i=0; i<heights.size(); ++i)
+    {
+        if ( heights[i] == NO_DATA_VALUE )
+            out[i] = QUANTIZED_NO_DATA;
+        else
+            out[i] = (unsigned short)std::min((heights[i]-minHeight)*invScale + 0.5f, (float)(QUANTIZED_NO_DATA - 1u));
+    }
+}
+
+void
+HeightFieldUtils::dequantizeHeights(const unsigned short* in,
+                                    unsigned              count,
+                                    float                 offset,
+                                    float                 scale,
+                                    float*                out)
+{
+    for(unsigned i=0; i<count; ++i)
+    {
+        out[i] = in[i] == QUANTIZED_NO_DATA ? NO_DATA_VALUE : offset + scale*(float)in[i];
+    }
+}
@@ -321,6 +321,100 @@ Horizon::getPlane(osg::Plane& out_plane) const
     return true;
 }
 
+bool
+Horizon::computeOcclusionPoint(const osg::EllipsoidModel& ellipsoid,
+                               const osg::Vec3d*          points,
+                               unsigned                   count,
+                               osg::Vec3d&                out_unitPoint)
+{
+    if ( points == 0L || count == 0u )
+        return false;
+
+    osg::Vec3d scale(
+        1.0 / ellipsoid.getRadiusEquator(),
+        1.0 / ellipsoid.getRadiusEquator(),
+        1.0 / ellipsoid.getRadiusPolar() );
+
+    // The occlusion point lies along the (unit space) direction to the
+    // centroid of the points.
+    osg::Vec3d dir;
+    for(unsigned i=0; i<count; ++i)
+        dir += points[i];
+    dir = osg::componentMultiply( dir, scale );
+    if ( dir.normalize() == 0.0 )
+        return false;
+
+    // For each point, find how far along "dir" we must go for the horizon
+    // to cover that point whenever it covers the occlusion point; keep the
+    // farthest.
+    double maxMag = 0.0;
+    for(unsigned i=0; i<count; ++i)
+    {
+        osg::Vec3d p = osg::componentMultiply( points[i], scale );
+        double mag2 = p.length2();
+        double mag  = sqrt(mag2);
+        if ( mag == 0.0 )
+            return false;
+
+        osg::Vec3d pDir = p / mag;
+
+        // points below the surface are treated as if on it.
+        mag2 = std::max( mag2, 1.0 );
+        mag  = std::max( mag,  1.0 );
+
+        double cosAlpha = pDir * dir;
+        double sinAlpha = (pDir ^ dir).length();
+        double cosBeta  = 1.0 / mag;
+        double sinBeta  = sqrt( mag2 - 1.0 ) * cosBeta;
+
+        double denom = cosAlpha*cosBeta - sinAlpha*sinBeta;
+        if ( denom <= 0.0 )
+        {
+            // the points spread too far around the ellipsoid for a
+            // single point to stand in for them.
+            return false;
+        }
+
+        maxMag = std::max( maxMag, 1.0/denom );
+    }
+
+    out_unitPoint = dir * maxMag;
+    return true;
+}
+
+bool
+Horizon::isOcclusionPointVisible(const osg::Vec3d& unitEye, const osg::Vec3d& unitPoint)
+{
+    // ref: https://cesiumjs.org/2013/04/25/Horizon-culling/
+    double VHmag2  = unitEye.length2() - 1.0;
+    osg::Vec3d VT  = unitPoint - unitEye;
+    double VTdotVC = -(VT * unitEye);
+
+    bool occluded = VHmag2 < 0.0 ?
+        VTdotVC > 0.0 :
+        VTdotVC > VHmag2 && (VTdotVC*VTdotVC / VT.length2()) > VHmag2;
+
+    return !occluded;
+}
+
+bool
+Horizon::isOcclusionPointVisible(const osg::Vec3d& unitPoint) const
+{
+    if ( _valid == false )
+        return true;
+
+    // _VC is the (min-HAE clamped) center relative to the eye, so the eye
+    // relative to the center is its negation.
+    osg::Vec3d unitEye = -_VC;
+    double len = _VC.length();
+    if ( len == 0.0 )
+        return true;
+    if ( len < _VCmag )
+        unitEye *= _VCmag / len;
+
+    return isOcclusionPointVisible( unitEye, unitPoint );
+}
+
 //........................................................................
 
 
@@ -367,12 +461,11 @@ HorizonCullCallback::isVisible(osg::Node* node, osg::NodeVisitor* nv)
         np.pop_back();
         local2world = osg::computeLocalToWorld(np);
 
-        osg::ref_ptr<Horizon> horizonCopy = osg::clone(_horizonProto.get(), osg::CopyOp::DEEP_COPY_ALL);
-        horizonCopy->setEye( eye );
-
+        // the eye-taking variant leaves the prototype untouched, so there's
+        // no need to clone it (and allocate) on every cull.
         const osg::BoundingSphere& bs = node->getBound();
         double radius = _centerOnly ? 0.0 : bs.radius();
-        return horizonCopy->isVisible( bs.center()*local2world, radius );
+        return _horizonProto->isVisible( eye, bs.center()*local2world, radius );
     }
 
     // If the user forgot to install a horizon at all...
@@ -0,0 +1,343 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ImageDecoder>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
+#include <osgDB/Registry>
+#include <osgDB/ReaderWriter>
+#include <cstring>
+#include <istream>
+#include <sstream>
+#include <map>
+#include <vector>
+
+#ifdef OSGEARTH_HAVE_TURBOJPEG
+#   include <turbojpeg.h>
+#endif
+
+#define LC "[ImageDecoder] "
+
+using namespace osgEarth;
+
+namespace
+{
+    // Caches osgDB reader lookups, which otherwise go through the registry
+    // (and its plugin mutex) for every image.
+    struct ReaderCache
+    {
+        typedef std::map<std::string, osg::ref_ptr<osgDB::ReaderWriter> > Readers;
+        Readers                   _readers;
+        Threading::ReadWriteMutex _mutex;
+
+        osgDB::ReaderWriter* get(const std::string& key, const std::string& value, bool mimeType)
+        {
+            if ( value.empty() )
+                return 0L;
+
+            {
+                Threading::ScopedReadLock lock(_mutex);
+                Readers::const_iterator i = _readers.find(key);
+                if ( i != _readers.end() )
+                    return i->second.get();
+            }
+
+            osgDB::ReaderWriter* rw = mimeType ?
+                osgDB::Registry::instance()->getReaderWriterForMimeType(value) :
+                osgDB::Registry::instance()->getReaderWriterForExtension(value);
+
+            // only cache hits, so a plugin that appears later is still found.
+            if ( rw )
+            {
+                Threading::ScopedWriteLock lock(_mutex);
+                _readers[key] = rw;
+            }
+            return rw;
+        }
+
+        osgDB::ReaderWriter* forExtension(const std::string& ext)
+        {
+            return get( "ext:" + ext, ext, false );
+        }
+
+        osgDB::ReaderWriter* forMimeType(const std::string& mimeType)
+        {
+            return get( "mime:" + mimeType, mimeType, true );
+        }
+    };
+
+    ReaderCache& readerCache()
+    {
+        static ReaderCache s_cache;
+        return s_cache;
+    }
+
+    const char* getExtension(ImageDecoder::Format format)
+    {
+        switch( format )
+        {
+        case ImageDecoder::FORMAT_JPEG: return "jpg";
+        case ImageDecoder::FORMAT_PNG:  return "png";
+        case ImageDecoder::FORMAT_WEBP: return "webp";
+        case ImageDecoder::FORMAT_GIF:  return "gif";
+        case ImageDecoder::FORMAT_TIFF: return "tif";
+        default:                        return "";
+        }
+    }
+
+    // Largest power-of-two reduction (up to 1/8) of s x t that keeps both
+    // dimensions at or above maxSize.
+    unsigned getReduction(unsigned s, unsigned t, unsigned maxSize)
+    {
+        unsigned div = 1u;
+        while( maxSize > 0u && div < 8u && s/(div*2u) >= maxSize && t/(div*2u) >= maxSize )
+            div *= 2u;
+        return div;
+    }
+
+#ifdef OSGEARTH_HAVE_TURBOJPEG
+
+    // A TurboJPEG decompressor plus a buffer for the encoded data, both
+    // reused from one image to the next.
+    struct JPEGContext
+    {
+        tjhandle                   _handle;
+        std::vector<unsigned char> _input;
+    };
+
+    struct JPEGContextPool
+    {
+        std::vector<JPEGContext*> _free;
+        Threading::Mutex          _mutex;
+
+        ~JPEGContextPool()
+        {
+            for(unsigned i=0; i<_free.size(); ++i)
+            {
+                tjDestroy( _free[i]->_handle );
+                delete _free[i];
+            }
+        }
+
+        JPEGContext* acquire()
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                if ( !_free.empty() )
+                {
+                    JPEGContext* cx = _free.back();
+                    _free.pop_back();
+                    return cx;
+                }
+            }
+
+            tjhandle handle = tjInitDecompress();
+            if ( !handle )
+                return 0L;
+
+            JPEGContext* cx = new JPEGContext();
+            cx->_handle = handle;
+            return cx;
+        }
+
+        void release(JPEGContext* cx)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            _free.push_back( cx );
+        }
+    };
+
+    JPEGContextPool& jpegContexts()
+    {
+        static JPEGContextPool s_pool;
+        return s_pool;
+    }
+
+    // Decodes a JPEG straight into a new image, scaling it down in the DCT
+    // if asked to. Returns NULL (leaving the stream where it was) if
+    // TurboJPEG can't handle the data, e.g. a CMYK image.
+    osg::Image* decodeJPEG(std::istream& in, unsigned maxSize)
+    {
+        std::streampos start = in.tellg();
+        in.seekg( 0, std::ios::end );
+        std::streamoff size = in.tellg() - start;
+        in.seekg( start );
+        if ( size <= 0 )
+            return 0L;
+
+        JPEGContext* cx = jpegContexts().acquire();
+        if ( !cx )
+            return 0L;
+
+        osg::ref_ptr<osg::Image> image;
+
+        cx->_input.resize( (size_t)size );
+        in.read( (char*)&cx->_input[0], size );
+
+        int width, height, subsamp, colorspace;
+        if ( in.gcount() == size &&
+             tjDecompressHeader3(cx->_handle, &cx->_input[0], (unsigned long)size, &width, &height, &subsamp, &colorspace) == 0 )
+        {
+            // pick the smallest DCT scaling that matches getReduction.
+            unsigned div = getReduction( width, height, maxSize );
+            tjscalingfactor factor = { 1, 1 };
+            if ( div > 1u )
+            {
+                int numFactors = 0;
+                tjscalingfactor* factors = tjGetScalingFactors( &numFactors );
+                for(int i=0; factors && i<numFactors; ++i)
+                {
+                    if ( factors[i].num == 1 && factors[i].denom == (int)div )
+                        factor = factors[i];
+                }
+            }
+
+            int s = TJSCALED( width, factor );
+            int t = TJSCALED( height, factor );
+
+            bool gray = (colorspace == TJCS_GRAY);
+            GLenum pixelFormat = gray ? GL_LUMINANCE : GL_RGB;
+
+            image = new osg::Image();
+            image->allocateImage( s, t, 1, pixelFormat, GL_UNSIGNED_BYTE );
+            image->setInternalTextureFormat( pixelFormat );
+
+            // OSG images start at the bottom row.
+            if ( tjDecompress2(cx->_handle, &cx->_input[0], (unsigned long)size, image->data(),
+                               s, image->getRowSizeInBytes(), t,
+                               gray ? TJPF_GRAY : TJPF_RGB, TJFLAG_BOTTOMUP) != 0 )
+            {
+                OE_DEBUG << LC << "TurboJPEG: " << tjGetErrorStr() << std::endl;
+                image = 0L;
+            }
+        }
+
+        jpegContexts().release( cx );
+
+        if ( !image.valid() )
+        {
+            in.clear();
+            in.seekg( start );
+        }
+
+        return image.release();
+    }
+
+#endif // OSGEARTH_HAVE_TURBOJPEG
+}
+
+ImageDecoder::Format
+ImageDecoder::sniff(const char* data, unsigned size)
+{
+    const unsigned char* b = (const unsigned char*)data;
+
+    if ( size >= 3 && b[0] == 0xFF && b[1] == 0xD8 && b[2] == 0xFF )
+        return FORMAT_JPEG;
+
+    if ( size >= 8 && ::memcmp(b, "\x89PNG\r\n\x1A\n", 8) == 0 )
+        return FORMAT_PNG;
+
+    if ( size >= 12 && ::memcmp(b, "RIFF", 4) == 0 && ::memcmp(b+8, "WEBP", 4) == 0 )
+        return FORMAT_WEBP;
+
+    if ( size >= 6 && (::memcmp(b, "GIF87a", 6) == 0 || ::memcmp(b, "GIF89a", 6) == 0) )
+        return FORMAT_GIF;
+
+    if ( size >= 4 && (::memcmp(b, "II*\0", 4) == 0 || ::memcmp(b, "MM\0*", 4) == 0) )
+        return FORMAT_TIFF;
+
+    return FORMAT_UNKNOWN;
+}
+
+ReadResult
+ImageDecoder::decode(std::istream&         in,
+                     const std::string&    ext,
+                     const std::string&    mimeType,
+                     const osgDB::Options* options,
+                     unsigned              maxSize)
+{
+    // identify the data from its header, then rewind.
+    std::streampos start = in.tellg();
+    char header[12];
+    in.read( header, sizeof(header) );
+    Format format = sniff( header, (unsigned)in.gcount() );
+    in.clear();
+    in.seekg( start );
+
+#ifdef OSGEARTH_HAVE_TURBOJPEG
+    if ( format == FORMAT_JPEG )
+    {
+        osg::Image* image = decodeJPEG( in, maxSize );
+        if ( image )
+            return ReadResult( image );
+    }
+#endif
+
+    ReaderCache& readers = readerCache();
+    osgDB::ReaderWriter* reader = 0L;
+    if ( format != FORMAT_UNKNOWN )
+        reader = readers.forExtension( getExtension(format) );
+    if ( !reader )
+        reader = readers.forExtension( ext );
+    if ( !reader )
+        reader = readers.forMimeType( mimeType );
+
+    if ( !reader )
+    {
+        ReadResult result( ReadResult::RESULT_NO_READER );
+        result.setErrorDetail( Stringify() << "No reader for image (ext=" << ext << "; mime-type=" << mimeType << ")" );
+        return result;
+    }
+
+    osgDB::ReaderWriter::ReadResult rr = reader->readImage( in, options );
+    if ( !rr.validImage() )
+    {
+        ReadResult result( ReadResult::RESULT_READER_ERROR );
+        result.setErrorDetail( rr.message() );
+        return result;
+    }
+
+    osg::ref_ptr<osg::Image> image = rr.takeImage();
+
+    unsigned div = getReduction( image->s(), image->t(), maxSize );
+    if ( div > 1u && image->r() == 1 )
+    {
+        osg::ref_ptr<osg::Image> reduced;
+        if ( ImageUtils::resizeImage(image.get(), image->s()/div, image->t()/div, reduced) )
+            image = reduced.get();
+    }
+
+    return ReadResult( image.release() );
+}
+
+unsigned
+ImageDecoder::getMaxSize(const osgDB::Options* options)
+{
+    if ( options )
+    {
+        std::istringstream iss( options->getOptionString() );
+        std::string opt;
+        while( iss >> opt )
+        {
+            if ( startsWith(opt, "OSGEARTH_DECODE_MAX_SIZE=") )
+                return as<unsigned>( opt.substr(25), 0u );
+        }
+    }
+    return 0u;
+}
@@ -29,10 +29,12 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Capabilities>
 #include <osgEarth/Metrics>
+#include <osgEarth/TaskService>
 #include <osg/Version>
 #include <osgDB/WriteFile>
 #include <memory.h>
 #include <limits.h>
+#include <cstdlib>
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -47,6 +49,29 @@ namespace osgEarth {
     REGISTER_OSGEARTH_LAYER(image, ImageLayer);
 }
 
+namespace
+{
+    // Runs the first "count" filters of the chain on a copy of the image, since
+    // the original may be shared with the memory cache. Returns NULL if the
+    // image's format can't be read and written.
+    osg::Image* bakeColorFilters(const osg::Image* image, const ColorFilterChain& chain, unsigned count)
+    {
+        osg::ref_ptr<osg::Image> baked;
+        if ( ImageUtils::PixelReader::supports(image) && ImageUtils::PixelWriter::supports(image) )
+            baked = ImageUtils::cloneImage( image );
+        else if ( ImageUtils::canConvert(image, GL_RGBA, GL_UNSIGNED_BYTE) )
+            baked = ImageUtils::convertToRGBA8( image );
+
+        if ( !baked.valid() )
+            return 0L;
+
+        for( unsigned i = 0; i < count; ++i )
+            chain[i]->applyToImage( baked.get() );
+
+        return baked.release();
+    }
+}
+
 //------------------------------------------------------------------------
 
 ImageLayerOptions::ImageLayerOptions() :
@@ -88,6 +113,10 @@ ImageLayerOptions::setDefaults()
     _minFilter.init( osg::Texture::LINEAR_MIPMAP_LINEAR );
     _magFilter.init( osg::Texture::LINEAR );
     _texcomp.init( osg::Texture::USE_IMAGE_DATA_FORMAT ); // none
+    _compressInCache.init( false );
+    _bakeColorFilters.init( false );
+    _adaptiveLOD.init( false );
+    _adaptiveLODTargetTime.init( 2.0 );
     _shared.init( false );
     _coverage.init( false );    
 }
@@ -136,6 +165,10 @@ ImageLayerOptions::fromConfig(const Config& conf)
     conf.getIfSet("texture_compression", "auto", _texcomp, (osg::Texture::InternalFormatMode)~0);
     conf.getIfSet("texture_compression", "fastdxt", _texcomp, (osg::Texture::InternalFormatMode)(~0 - 1));
     //TODO add all the enums
+    conf.getIfSet("compress_in_cache", _compressInCache);
+    conf.getIfSet("bake_color_filters", _bakeColorFilters);
+    conf.getIfSet("adaptive_lod", _adaptiveLOD);
+    conf.getIfSet("adaptive_lod_target_time", _adaptiveLODTargetTime);
 
     // uniform names
     conf.getIfSet("shared_sampler", _shareTexUniformName);
@@ -186,6 +219,10 @@ ImageLayerOptions::getConfig() const
     conf.set("texture_compression", "on",   _texcomp, (osg::Texture::InternalFormatMode)~0);
     conf.set("texture_compression", "fastdxt", _texcomp, (osg::Texture::InternalFormatMode)(~0 - 1));
     //TODO add all the enums
+    conf.set("compress_in_cache", _compressInCache);
+    conf.set("bake_color_filters", _bakeColorFilters);
+    conf.set("adaptive_lod", _adaptiveLOD);
+    conf.set("adaptive_lod_target_time", _adaptiveLODTargetTime);
 
     // uniform names
     conf.set("shared_sampler", _shareTexUniformName);
@@ -369,6 +406,14 @@ ImageLayer::init()
 
     // image layers render as a terrain texture.
     setRenderType(RENDERTYPE_TILE);
+
+    _adaptive._latency = 0.0;
+    _adaptive._bytes = 0.0;
+    _adaptive._throughput = 0.0;
+    _adaptive._samples = 0u;
+    _adaptive._maxLevel = UINT_MAX;
+    _adaptive._highestLevel = 0u;
+    _adaptive._lastChange = osg::Timer::instance()->tick();
 }
 
 void
@@ -457,6 +502,19 @@ ImageLayer::getColorFilters() const
     return options().colorFilters();
 }
 
+unsigned
+ImageLayer::getNumBakedColorFilters() const
+{
+    if ( options().bakeColorFilters() != true || options().compressInCache() == true || isCoverage() )
+        return 0u;
+
+    const ColorFilterChain& chain = options().colorFilters();
+    unsigned count = 0u;
+    while( count < chain.size() && chain[count]->canApplyToImage() )
+        ++count;
+    return count;
+}
+
 void
 ImageLayer::setTargetProfileHint( const Profile* profile )
 {
@@ -466,6 +524,74 @@ ImageLayer::setTargetProfileHint( const Profile* profile )
     _preCacheOp = 0L;
 }
 
+unsigned
+ImageLayer::getAdaptiveMaxLevel() const
+{
+    Threading::ScopedMutexLock lock(_adaptiveMutex);
+    return _adaptive._maxLevel;
+}
+
+void
+ImageLayer::updateAdaptiveLOD(double requests, double seconds, double latency, double bytes)
+{
+    // weight of the newest fetch in the running estimates
+    const double alpha = 0.2;
+
+    double target = options().adaptiveLODTargetTime().get();
+    unsigned minLevel = options().minLevel().getOrUse(0u);
+
+    Threading::ScopedMutexLock lock(_adaptiveMutex);
+    AdaptiveLOD& a = _adaptive;
+
+    double transfer = seconds - latency;
+    double throughput = bytes > 0.0 && transfer > 0.0 ? bytes / transfer : 0.0;
+
+    if ( a._throughput <= 0.0 )
+    {
+        a._latency = latency;
+        a._bytes = bytes;
+        a._throughput = throughput;
+    }
+    else
+    {
+        a._latency = a._latency + alpha*(latency - a._latency);
+        a._bytes = a._bytes + alpha*(bytes - a._bytes);
+        if ( throughput > 0.0 )
+            a._throughput = a._throughput + alpha*(throughput - a._throughput);
+    }
+    ++a._samples;
+
+    // Expected time to fetch one tile over the link as it is now.
+    double estimate = a._throughput > 0.0 ? a._latency + a._bytes/a._throughput : seconds;
+
+    // Give each change time to show up in the measurements before the next.
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    if ( a._samples < 4u || osg::Timer::instance()->delta_s(a._lastChange, now) < 2.0*target )
+        return;
+
+    if ( estimate > target )
+    {
+        unsigned current = a._maxLevel == UINT_MAX ? a._highestLevel : a._maxLevel;
+        if ( current > minLevel )
+        {
+            a._maxLevel = current - 1u;
+            a._samples = 0u;
+            a._lastChange = now;
+            OE_INFO << LC << "Slow link (" << estimate << "s per tile); requesting up to LOD " << a._maxLevel << std::endl;
+        }
+    }
+    else if ( estimate < 0.5*target && a._maxLevel != UINT_MAX )
+    {
+        a._maxLevel = a._maxLevel + 1u >= a._highestLevel ? UINT_MAX : a._maxLevel + 1u;
+        a._samples = 0u;
+        a._lastChange = now;
+        if ( a._maxLevel == UINT_MAX )
+            OE_INFO << LC << "Link recovered (" << estimate << "s per tile); requesting all LODs" << std::endl;
+        else
+            OE_INFO << LC << "Link improving (" << estimate << "s per tile); requesting up to LOD " << a._maxLevel << std::endl;
+    }
+}
+
 TileSource::ImageOperation*
 ImageLayer::getOrCreatePreCacheOp()
 {
@@ -501,7 +627,66 @@ ImageLayer::createImage(const TileKey&    key,
         return GeoImage::INVALID;
     }
 
-    return createImageInKeyProfile( key, progress );
+    // Several tiles often ask for the same key at once (e.g. a shared parent);
+    // let the first one create it and hand the result to the rest.
+    std::string flightKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature();
+    for(;;)
+    {
+        GeoImage result;
+        Threading::SingleFlight<std::string, GeoImage>::Scope flight( _imagesInFlight, flightKey, result );
+
+        if ( flight.isLeader() )
+        {
+            if ( options().adaptiveLOD() == true )
+            {
+                // HTTPClient adds up its timings in the progress callback;
+                // diff them around this tile to see what the network cost.
+                osg::ref_ptr<ProgressCallback> local = progress ? progress : new ProgressCallback();
+                ProgressCallback::Stats& stats = local->stats();
+                double count   = stats["http_get_count"];
+                double seconds = stats["http_get_time"];
+                double latency = stats["http_get_latency"];
+                double bytes   = stats["http_get_bytes"];
+
+                result = createImageInKeyProfile( key, local.get() );
+
+                if ( stats["http_get_count"] > count && !local->isCanceled() )
+                {
+                    updateAdaptiveLOD(
+                        stats["http_get_count"]   - count,
+                        stats["http_get_time"]    - seconds,
+                        stats["http_get_latency"] - latency,
+                        stats["http_get_bytes"]   - bytes );
+                }
+            }
+            else
+            {
+                result = createImageInKeyProfile( key, progress );
+            }
+
+            unsigned numBaked = getNumBakedColorFilters();
+            if ( result.valid() && numBaked > 0 )
+            {
+                osg::ref_ptr<osg::Image> baked = bakeColorFilters( result.getImage(), getColorFilters(), numBaked );
+                if ( baked.valid() )
+                    result = GeoImage( baked.get(), result.getExtent() );
+                else if ( _bakeWarned.exchange(1u) == 0u )
+                    OE_WARN << LC << "Cannot bake color filters into " << key.str() << "; unsupported image format"
+                        << " (further tiles will not be reported)" << std::endl;
+            }
+
+            if ( progress && progress->isCanceled() )
+                flight.abandon();
+            return result;
+        }
+
+        // callers may modify the image, so each follower gets its own copy.
+        if ( !flight.wasAbandoned() )
+            return result.valid() ? GeoImage( osg::clone(result.getImage(), osg::CopyOp::DEEP_COPY_ALL), result.getExtent() ) : result;
+
+        if ( progress && progress->isCanceled() )
+            return GeoImage::INVALID;
+    }
 }
 
 GeoImage
@@ -606,6 +791,7 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     // Check the layer L2 cache first
     if ( _memCache.valid() )
     {
+        ScopedTileStage stage("image.memcache_read", getName(), key);
         CacheBin* bin = _memCache->getOrCreateDefaultBin();
         ReadResult result = bin->readObject(cacheKey, 0L);
         if ( result.succeeded() )
@@ -645,11 +831,22 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
     // map profile, we can try this first.
     if ( cacheBin && policy.isCacheReadable() )
     {
+        ScopedTileStage stage("image.cache_read", getName(), key);
         ReadResult r = cacheBin->readImage(cacheKey, 0L);
+        countCacheRead( r.succeeded() );
         if ( r.succeeded() )
         {
             cachedImage = r.releaseImage();
             ImageUtils::fixInternalFormat( cachedImage.get() );            
+
+            // Single-color tiles are cached as one pixel; expand them back out.
+            osg::ref_ptr<osg::Image> expanded;
+            if ( cachedImage->s() == 1 && cachedImage->t() == 1 && getTileSize() > 1 &&
+                 ImageUtils::resizeImage(cachedImage.get(), getTileSize(), getTileSize(), expanded) )
+            {
+                ImageUtils::markAsSingleColor( expanded.get(), true );
+                cachedImage = expanded.get();
+            }
             bool expired = policy.isExpired(r.lastModifiedTime());
             if (!expired)
             {
@@ -676,14 +873,32 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
             return GeoImage::INVALID;
         }
     }
+
+    // On a slow link, don't queue up fine tiles the link can't deliver;
+    // the engine falls back on coarser data until the limit rises again.
+    if ( options().adaptiveLOD() == true )
+    {
+        unsigned maxLevel;
+        {
+            Threading::ScopedMutexLock lock(_adaptiveMutex);
+            _adaptive._highestLevel = osg::maximum( _adaptive._highestLevel, key.getLOD() );
+            maxLevel = _adaptive._maxLevel;
+        }
+        if ( key.getLOD() > maxLevel )
+        {
+            return cachedImage.valid() ? GeoImage( cachedImage.get(), key.getExtent() ) : GeoImage::INVALID;
+        }
+    }
     
     if (key.getProfile()->isHorizEquivalentTo(getProfile()))
     {
+        ScopedTileStage stage("image.fetch", getName(), key);
         result = createImageImplementation(key, progress);
     }
     else
     {
         // If the profiles are different, use a compositing method to assemble the tile.
+        ScopedTileStage stage("image.assemble", getName(), key);
         result = assembleImage( key, progress );
     }
 
@@ -693,6 +908,40 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         ImageUtils::fixInternalFormat( result.getImage() );
     }
 
+    ScopedTileStage cacheStage("image.cache_write", getName(), key);
+
+    // Single-color tiles (open water, nodata fill, empty overlays) go into the
+    // cache as one pixel, and are marked so the terrain engine can share one
+    // texture per color.
+    osg::ref_ptr<osg::Image> cacheImage = result.getImage();
+    if ( result.valid() )
+    {
+        bool singleColor =
+            !isCoverage() &&
+            !ImageUtils::isCompressed(result.getImage()) &&
+            result.getImage()->s() * result.getImage()->t() > 1 &&
+            ImageUtils::isSingleColorImage(result.getImage(), 0.0f);
+
+        // Set the mark either way; the image may carry a stale one from
+        // an image it was copied from.
+        ImageUtils::markAsSingleColor( result.getImage(), singleColor );
+        if ( singleColor )
+        {
+            cacheImage = ImageUtils::createOnePixelImage( ImageUtils::PixelReader(result.getImage())(0, 0) );
+        }
+    }
+
+    // Compress before caching so that cached reads skip the work entirely.
+    if ( result.valid() &&
+         !ImageUtils::isMarkedAsSingleColor(result.getImage()) &&
+         options().compressInCache() == true &&
+         options().textureCompression() == (osg::Texture::InternalFormatMode)(~0 - 1) &&
+         !isCoverage() &&
+         !ImageUtils::isCompressed(result.getImage()) )
+    {
+        ImageUtils::compressImageInPlace( result.getImage(), "fastdxt", true );
+    }
+
     // memory cache first:
     if ( result.valid() && _memCache.valid() )
     {
@@ -711,7 +960,7 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
             OE_INFO << LC << "WARNING! mismatched extents." << std::endl;
         }
 
-        cacheBin->write(cacheKey, result.getImage(), 0L);
+        cacheBin->write(cacheKey, cacheImage.get(), 0L);
     }
 
     if ( result.valid() )
@@ -770,6 +1019,15 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
     //    return GeoImage::INVALID;
     //}
 
+    // Without a caller's progress callback, use our own so we can still
+    // tell a transient failure (needsRetry) from a tile that has no data.
+    osg::ref_ptr<ProgressCallback> localProgress;
+    if ( progress == 0L )
+    {
+        localProgress = new ProgressCallback();
+        progress = localProgress.get();
+    }
+
     // create an image from the tile source.
     osg::ref_ptr<osg::Image> result = source->createImage( key, op.get(), progress );   
 
@@ -785,10 +1043,9 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
     // blacklist this tile for future requests.
     if (result == 0L)
     {
-        if ( progress == 0L ||
-             ( !progress->isCanceled() && !progress->needsRetry() ) )
+        if ( !progress->isCanceled() && !progress->needsRetry() )
         {
-            source->getBlacklist()->add( key );
+            source->blacklist( key );
         }
     }
 
@@ -796,6 +1053,65 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
 }
 
 
+namespace
+{
+    // Mosaic fetches share the registry's thread budget under this UID.
+    TaskService* getMosaicService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+}
+
+/**
+ * The native tiles under one mosaic, fetched in parallel.
+ */
+struct ImageLayer::MosaicFetch : public ParallelJobs
+{
+    ImageLayer*           _layer;
+    std::vector<TileKey>  _keys;
+    std::vector<GeoImage> _results;
+    ProgressCallback*     _progress;
+    Threading::Mutex      _mutex;
+
+    // Gives each concurrent fetch its own stats; they're added to the
+    // request's callback under the lock when the fetch is done.
+    struct FetchProgress : public ProgressCallback
+    {
+        ProgressCallback* _parent;
+        FetchProgress(ProgressCallback* parent) : _parent(parent) { }
+        bool isCanceled() { return _canceled || _parent->isCanceled(); }
+    };
+
+    MosaicFetch(ImageLayer* layer, const std::vector<TileKey>& keys, ProgressCallback* progress) :
+        _layer(layer), _keys(keys), _results(keys.size()), _progress(progress) { }
+
+    void runJob(unsigned i)
+    {
+        // skip the remaining work once the request is abandoned
+        osg::ref_ptr<FetchProgress> progress;
+        if (!_progress || (!_progress->isCanceled() && !_progress->needsRetry()))
+        {
+            progress = _progress ? new FetchProgress(_progress) : 0L;
+            _results[i] = _layer->createImageImplementation(_keys[i], progress.get());
+        }
+
+        if (progress.valid())
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            if (progress->needsRetry())
+                _progress->setNeedsRetry(true);
+            for (ProgressCallback::Stats::const_iterator s = progress->stats().begin(); s != progress->stats().end(); ++s)
+                _progress->stats()[s->first] += s->second;
+        }
+    }
+
+    void run()
+    {
+        ParallelJobs::run(_keys.size(), _keys.size() > 1u ? getMosaicService() : 0L);
+    }
+};
+
 GeoImage
 ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
 {
@@ -833,9 +1149,14 @@ ImageLayer::assembleImage(const TileKey& key, ProgressCallback* progress)
         // keep track of failed tiles.
         std::vector<TileKey> failedKeys;
 
-        for( std::vector<TileKey>::iterator k = intersectingKeys.begin(); k != intersectingKeys.end(); ++k )
+        // fetch all the native tiles at once:
+        osg::ref_ptr<MosaicFetch> fetch = new MosaicFetch( this, intersectingKeys, progress );
+        fetch->run();
+
+        for( unsigned i = 0; i < intersectingKeys.size(); ++i )
         {
-            GeoImage image = createImageImplementation( *k, progress );
+            const TileKey* k = &intersectingKeys[i];
+            GeoImage image = fetch->_results[i];
 
             if ( image.valid() )
             {
@@ -988,6 +1309,12 @@ ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
         tex->setInternalFormatMode(osg::Texture::USE_IMAGE_DATA_FORMAT);
     }
 
+    // Pre-compressed data (from a compressed cache or repo) goes to GL as-is.
+    else if ( ImageUtils::isCompressed(tex->getImage(0)) )
+    {
+        tex->setInternalFormatMode(osg::Texture::USE_IMAGE_DATA_FORMAT);
+    }
+
 
     else if ( options().textureCompression() == (osg::Texture::InternalFormatMode)~0 )
     {
@@ -1012,39 +1339,11 @@ ImageLayer::applyTextureCompressionMode(osg::Texture* tex) const
     }
     else if ( options().textureCompression() == (osg::Texture::InternalFormatMode)(~0 - 1))
     {
-        osg::Timer_t start = osg::Timer::instance()->tick();
-        osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension("fastdxt");
-        if (imageProcessor)
+        osg::Image* image = tex->getImage(0);
+        if ( ImageUtils::compressImageInPlace(image, "fastdxt") )
         {
-            osg::Texture::InternalFormatMode mode;
-            // RGB uses DXT1
-            if (tex->getImage(0)->getPixelFormat() == GL_RGB)
-            {
-                mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
-            }
-            // RGBA uses DXT5
-            else if (tex->getImage(0)->getPixelFormat() == GL_RGBA)
-            {         
-                mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
-            }
-            else
-            {
-                OE_DEBUG << "FastDXT only works on GL_RGBA or GL_RGB images" << std::endl;
-                return;
-            }
-
-            osg::Image *image = tex->getImage(0);
-            imageProcessor->compress(*image, mode, false, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
-            osg::Timer_t end = osg::Timer::instance()->tick();
-            image->dirty();
             tex->setImage(0, image);
-            OE_DEBUG << "Compress took " << osg::Timer::instance()->delta_m(start, end) << std::endl;        
         }
-        else
-        {
-            OE_WARN << "Failed to get ImageProcessor fastdxt" << std::endl;
-        }
-
     }
     else if ( options().textureCompression().isSet() )
     {
@@ -23,6 +23,7 @@
 #include <osg/Notify>
 #include <osg/Timer>
 #include <osg/io_utils>
+#include <memory.h>
 
 #define LC "[ImageMosaic] "
 
@@ -109,18 +110,28 @@ ImageMosaic::createImage()
     unsigned int pixelsWide = tilesWide * tileWidth;
     unsigned int pixelsHigh = tilesHigh * tileHeight;
 
-    osg::ref_ptr<osg::Image> image = new osg::Image;
-    image->allocateImage(pixelsWide, pixelsHigh, 1, tile->_image->getPixelFormat(), tile->_image->getDataType());
+    osg::ref_ptr<osg::Image> image = ImageUtils::createImage(pixelsWide, pixelsHigh, 1, tile->_image->getPixelFormat(), tile->_image->getDataType());
     image->setInternalTextureFormat(tile->_image->getInternalTextureFormat());
     ImageUtils::markAsNormalized(image.get(), ImageUtils::isNormalized(tile->getImage()));
 
     //Initialize the image to be completely white!
     //memset(image->data(), 0xFF, image->getImageSizeInBytes());
 
-    ImageUtils::PixelWriter write(image.get());
-    for (unsigned t = 0; t < pixelsHigh; ++t)
-        for (unsigned s = 0; s < pixelsWide; ++s)
-            write(osg::Vec4(1,1,1,0), s, t);
+    if (image->getPixelFormat() == GL_RGBA && image->getDataType() == GL_UNSIGNED_BYTE && image->getPacking() == 1)
+    {
+        // the usual case: fill the bytes directly.
+        const unsigned char clear[4] = { 255, 255, 255, 0 };
+        unsigned char* ptr = image->data();
+        for (unsigned p = 0; p < pixelsWide*pixelsHigh; ++p, ptr += 4)
+            memcpy(ptr, clear, 4);
+    }
+    else
+    {
+        ImageUtils::PixelWriter write(image.get());
+        for (unsigned t = 0; t < pixelsHigh; ++t)
+            for (unsigned s = 0; s < pixelsWide; ++s)
+                write(osg::Vec4(1,1,1,0), s, t);
+    }
 
     //Composite the incoming images into the master image
     for (TileImageList::iterator i = _images.begin(); i != _images.end(); ++i)
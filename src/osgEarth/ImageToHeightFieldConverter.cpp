@@ -22,11 +22,18 @@
 
 #include <osgEarth/ImageToHeightFieldConverter>
 #include <osgEarth/GeoCommon>
+#include <osgEarth/ImageUtils>
 #include <osg/Notify>
 #include <osg/Texture>
 #include <limits.h>
 #include <string.h>
 
+// SSE2 is part of every x86-64 target, so no runtime check is needed.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define OE_HF_USE_SSE2 1
+#  include <emmintrin.h>
+#endif
+
 using namespace osgEarth;
 
 static bool
@@ -35,10 +42,116 @@ isNoData( float f )
   return f == FLT_MAX || f == -FLT_MAX;
 }
 
+namespace
+{
+  // 16-bit signed samples, with +/-SHRT_MAX meaning "no data".
+  void decodeRow16( const short* in, float* out, unsigned count )
+  {
+    unsigned i = 0;
+#ifdef OE_HF_USE_SSE2
+    const __m128i hi = _mm_set1_epi16( SHRT_MAX );
+    const __m128i lo = _mm_set1_epi16( -SHRT_MAX );
+    const __m128  nodata = _mm_set1_ps( NO_DATA_VALUE );
+    for( ; i + 8 <= count; i += 8 )
+    {
+      __m128i v = _mm_loadu_si128( (const __m128i*)(in + i) );
+      __m128i nd = _mm_or_si128( _mm_cmpeq_epi16(v, hi), _mm_cmpeq_epi16(v, lo) );
+
+      // sign-extend to 32 bits, then convert.
+      __m128 f0 = _mm_cvtepi32_ps( _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16) );
+      __m128 f1 = _mm_cvtepi32_ps( _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16) );
+      __m128 m0 = _mm_castsi128_ps( _mm_unpacklo_epi16(nd, nd) );
+      __m128 m1 = _mm_castsi128_ps( _mm_unpackhi_epi16(nd, nd) );
+
+      _mm_storeu_ps( out + i,     _mm_or_ps(_mm_and_ps(m0, nodata), _mm_andnot_ps(m0, f0)) );
+      _mm_storeu_ps( out + i + 4, _mm_or_ps(_mm_and_ps(m1, nodata), _mm_andnot_ps(m1, f1)) );
+    }
+#endif
+    for( ; i < count; ++i )
+    {
+      short v = in[i];
+      out[i] = (v == -SHRT_MAX || v == SHRT_MAX) ? NO_DATA_VALUE : (float)v;
+    }
+  }
+
+  // 8-bit RGBA pixels packed as offset + (R*65536 + G*256 + B) * scale.
+  void decodeRowRGBA( const unsigned char* in, float* out, unsigned count, float scale, float offset )
+  {
+    unsigned i = 0;
+#ifdef OE_HF_USE_SSE2
+    const __m128i mask = _mm_set1_epi32( 0xFF );
+    const __m128i maskG = _mm_set1_epi32( 0xFF00 );
+    const __m128  s = _mm_set1_ps( scale );
+    const __m128  o = _mm_set1_ps( offset );
+    for( ; i + 4 <= count; i += 4 )
+    {
+      // each 32-bit lane holds one pixel as A<<24 | B<<16 | G<<8 | R.
+      __m128i p = _mm_loadu_si128( (const __m128i*)(in + 4*i) );
+      __m128i v = _mm_or_si128(
+        _mm_or_si128( _mm_slli_epi32(_mm_and_si128(p, mask), 16), _mm_and_si128(p, maskG) ),
+        _mm_and_si128( _mm_srli_epi32(p, 16), mask ) );
+      _mm_storeu_ps( out + i, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), s), o) );
+    }
+#endif
+    for( ; i < count; ++i )
+    {
+      const unsigned char* px = in + 4*i;
+      int v = (px[0] << 16) | (px[1] << 8) | px[2];
+      out[i] = (float)v * scale + offset;
+    }
+  }
+
+  // 8-bit RGB pixels, as above.
+  void decodeRowRGB( const unsigned char* in, float* out, unsigned count, float scale, float offset )
+  {
+    for( unsigned i = 0; i < count; ++i )
+    {
+      const unsigned char* px = in + 3*i;
+      int v = (px[0] << 16) | (px[1] << 8) | px[2];
+      out[i] = (float)v * scale + offset;
+    }
+  }
+
+  void decodeRGB( const osg::Image* image, float* out, float scale, float offset )
+  {
+    unsigned cols = image->s(), rows = image->t();
+    bool bytes = image->getDataType() == GL_UNSIGNED_BYTE;
+
+    if ( bytes && image->getPixelFormat() == GL_RGBA )
+    {
+      for( unsigned r = 0; r < rows; ++r )
+        decodeRowRGBA( image->data(0, r), out + r*cols, cols, scale, offset );
+    }
+    else if ( bytes && image->getPixelFormat() == GL_RGB )
+    {
+      for( unsigned r = 0; r < rows; ++r )
+        decodeRowRGB( image->data(0, r), out + r*cols, cols, scale, offset );
+    }
+    else
+    {
+      // other layouts (BGR, 16-bit channels, ...) go through the pixel reader.
+      ImageUtils::PixelReader reader( image );
+      for( unsigned r = 0; r < rows; ++r )
+      {
+        for( unsigned c = 0; c < cols; ++c )
+        {
+          osg::Vec4 pixel = reader( c, r );
+          int v =
+            ((int)(pixel.r()*255.0f + 0.5f) << 16) |
+            ((int)(pixel.g()*255.0f + 0.5f) << 8) |
+             (int)(pixel.b()*255.0f + 0.5f);
+          out[r*cols + c] = (float)v * scale + offset;
+        }
+      }
+    }
+  }
+}
+
 
 ImageToHeightFieldConverter::ImageToHeightFieldConverter():
 _replace_nodata( false ),
-_nodata_value( 0.0f )
+_nodata_value( 0.0f ),
+_encoding( ENCODING_RAW )
 {
   //NOP
 }
@@ -55,11 +168,43 @@ osg::HeightField* ImageToHeightFieldConverter::convert(const osg::Image* image )
     return NULL;
   }
 
-  osg::HeightField* hf;
-  if ( image->getPixelSizeInBits() == 32 ) {
-    hf = convert32( image );
-  } else {
-    hf = convert16( image );
+  osg::HeightField* hf = new osg::HeightField();
+  convertInto( image, hf );
+  return hf;
+}
+
+bool
+ImageToHeightFieldConverter::convertInto(const osg::Image* image, osg::HeightField* hf)
+{
+  if ( !image || !hf ) {
+    return false;
+  }
+
+  unsigned cols = image->s(), rows = image->t();
+  if ( hf->getNumColumns() != cols || hf->getNumRows() != rows ) {
+    hf->allocate( cols, rows );
+  }
+
+  if ( cols == 0 || rows == 0 ) {
+    return true;
+  }
+
+  // decode straight into the heightfield, one image row at a time (rows may be padded).
+  float* out = &hf->getFloatArray()->front();
+
+  if ( _encoding == ENCODING_MAPBOX ) {
+    decodeRGB( image, out, 0.1f, -10000.0f );
+  }
+  else if ( _encoding == ENCODING_TERRARIUM ) {
+    decodeRGB( image, out, 1.0f/256.0f, -32768.0f );
+  }
+  else if ( image->getPixelSizeInBits() == 32 ) {
+    for( unsigned r = 0; r < rows; ++r )
+      memcpy( out + r*cols, image->data(0, r), sizeof(float) * cols );
+  }
+  else {
+    for( unsigned r = 0; r < rows; ++r )
+      decodeRow16( (const short*)image->data(0, r), out + r*cols, cols );
   }
 
   // scan for and replace NODATA values. This algorithm is terrible but good enough for now
@@ -96,44 +241,7 @@ osg::HeightField* ImageToHeightFieldConverter::convert(const osg::Image* image )
     }
   }
 
-  return hf;
-}
-
-osg::HeightField* ImageToHeightFieldConverter::convert16(const osg::Image* image ) const {
-  if ( !image ) {
-    return NULL;
-  }
-
-  osg::HeightField *hf = new osg::HeightField();
-  hf->allocate( image->s(), image->t() );
-
-  osg::FloatArray* floats = hf->getFloatArray();
-
-  for( unsigned int i = 0; i < floats->size(); ++i ) {
-      short v = *(short*)image->data(i);
-      float h = (float)v;
-      // Replace short nodata values with our float marker.
-      if (v == -SHRT_MAX || v == SHRT_MAX)
-      {
-          h = NO_DATA_VALUE;
-      }
-      floats->at( i ) = h;
-  }
-
-  return hf;
-}
-
-osg::HeightField* ImageToHeightFieldConverter::convert32(const osg::Image* image ) const {
-  if ( !image ) {
-    return NULL;
-  }
-
-  osg::HeightField *hf = new osg::HeightField();
-  hf->allocate( image->s(), image->t() );
-
-  memcpy( &hf->getFloatArray()->front(), image->data(), sizeof(float) * hf->getFloatArray()->size() );
-
-  return hf;
+  return true;
 }
 
 
@@ -147,9 +255,11 @@ ImageToHeightFieldConverter::convert(const osg::Image* image, float scaleFactor)
   osg::HeightField* hf = convert( image );
 
   // finally, apply the scale factor.
-  for( osg::FloatArray::iterator i = hf->getFloatArray()->begin(); i != hf->getFloatArray()->end(); ++i )
+  osg::FloatArray* floats = hf->getFloatArray();
+  float* f = floats->empty() ? 0L : &floats->front();
+  for( unsigned i = 0; i < floats->size(); ++i )
   {
-    (*i) *= scaleFactor;
+    f[i] *= scaleFactor;
   }
 
   return hf;
@@ -28,9 +28,11 @@
 #include <osg/ImageSequence>
 #include <osg/Timer>
 #include <osg/ValueObject>
+#include <osg/Version>
 #include <osgDB/Registry>
 #include <string.h>
 #include <memory.h>
+#include <cstdlib>
 
 #define LC "[ImageUtils] "
 
@@ -46,6 +48,352 @@
 
 using namespace osgEarth;
 
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Format-specialized kernels for the common layouts (RGBA8, RGB8,
+    // LUMINANCE8, R32F). They work a whole row at a time on the raw data,
+    // in place of the per-pixel PixelReader/PixelWriter dispatch, with inner
+    // loops simple enough for the compiler to vectorize. Anything else takes
+    // the general path.
+
+    /** Channel count (1, 3 or 4) if the image has a fast layout of the given type, else 0. */
+    unsigned getFastChannels(const osg::Image* image, GLenum dataType)
+    {
+        if ( !image || !image->data() || image->getDataType() != dataType )
+            return 0u;
+
+        switch( image->getPixelFormat() )
+        {
+        case GL_RGBA:      return 4u;
+        case GL_RGB:       return 3u;
+        case GL_LUMINANCE: return 1u;
+        case GL_RED:       return 1u;
+        default:           return 0u;
+        }
+    }
+
+    inline void storeSample(float v, GLubyte& out) { out = (GLubyte)(v + 0.5f); }
+    inline void storeSample(float v, GLfloat& out) { out = v; }
+
+    /**
+     * Sample positions along one axis of a resize, matching the general path:
+     * each output sample reads sample i0 with weight w0 and i1 with weight w1.
+     */
+    struct ResizeAxis
+    {
+        std::vector<int>   _i0, _i1;
+        std::vector<float> _w0, _w1;
+
+        ResizeAxis(unsigned in, unsigned out, bool bilinear) :
+            _i0(out), _i1(out), _w0(out), _w1(out)
+        {
+            for(unsigned i = 0; i < out; ++i)
+            {
+                float x = (float)i/(float)out * (float)in;
+                if ( x >= (float)in ) x = (float)(in-1);
+                else if ( x < 0.0f ) x = 0.0f;
+
+                int i0, i1;
+                if ( bilinear )
+                {
+                    i0 = osg::maximum((int)floor(x), 0);
+                    i1 = osg::maximum(osg::minimum((int)ceil(x), (int)in-1), 0);
+                    if ( i0 > i1 ) i0 = i1;
+                }
+                else
+                {
+                    // nearest neighbor:
+                    i0 = i1 = (x-(int)x) <= (ceil(x)-x) ? (int)x : std::min(1+(int)x, (int)in-1);
+                }
+
+                _i0[i] = i0, _i1[i] = i1;
+                _w0[i] = i0 == i1 ? 1.0f : (float)i1 - x;
+                _w1[i] = i0 == i1 ? 0.0f : x - (float)i0;
+            }
+        }
+    };
+
+    /** Resizes mip level 0 of an image into another of the same layout. */
+    template<typename T, unsigned N>
+    void resizeRows(const osg::Image* input, osg::Image* output, int out_s, int out_t, bool bilinear)
+    {
+        ResizeAxis cols( input->s(), out_s, bilinear );
+        ResizeAxis rows( input->t(), out_t, bilinear );
+
+        for(int layer = 0; layer < input->r(); ++layer)
+        {
+            for(int t = 0; t < out_t; ++t)
+            {
+                const T* row0 = (const T*)input->data(0, rows._i0[t], layer);
+                const T* row1 = (const T*)input->data(0, rows._i1[t], layer);
+                const float wr0 = rows._w0[t], wr1 = rows._w1[t];
+                T* out = (T*)output->data(0, t, layer);
+
+                if ( !bilinear )
+                {
+                    for(int s = 0; s < out_s; ++s)
+                    {
+                        const T* in = row0 + cols._i0[s]*N;
+                        for(unsigned k = 0; k < N; ++k)
+                            out[s*N+k] = in[k];
+                    }
+                }
+                else
+                {
+                    for(int s = 0; s < out_s; ++s)
+                    {
+                        const unsigned c0 = cols._i0[s]*N, c1 = cols._i1[s]*N;
+                        const float wc0 = cols._w0[s], wc1 = cols._w1[s];
+                        for(unsigned k = 0; k < N; ++k)
+                        {
+                            float v =
+                                ((float)row0[c0+k]*wc0 + (float)row0[c1+k]*wc1) * wr0 +
+                                ((float)row1[c0+k]*wc0 + (float)row1[c1+k]*wc1) * wr1;
+                            storeSample( v, out[s*N+k] );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /** Runs resizeRows if both images share one of the fast layouts. */
+    bool resizeFast(const osg::Image* input, osg::Image* output, int out_s, int out_t, bool bilinear)
+    {
+        if ( input->getPixelFormat() != output->getPixelFormat() ||
+             input->getDataType()    != output->getDataType()    ||
+             input->r()              != output->r()              ||
+             out_s > output->s() || out_t > output->t()          ||
+             ImageUtils::isNormalized(input) != ImageUtils::isNormalized(output) )
+        {
+            return false;
+        }
+
+        switch( getFastChannels(input, GL_UNSIGNED_BYTE) )
+        {
+        case 4u: resizeRows<GLubyte, 4u>( input, output, out_s, out_t, bilinear ); return true;
+        case 3u: resizeRows<GLubyte, 3u>( input, output, out_s, out_t, bilinear ); return true;
+        case 1u: resizeRows<GLubyte, 1u>( input, output, out_s, out_t, bilinear ); return true;
+        default: break;
+        }
+
+        if ( getFastChannels(input, GL_FLOAT) == 1u )
+        {
+            resizeRows<GLfloat, 1u>( input, output, out_s, out_t, bilinear );
+            return true;
+        }
+
+        return false;
+    }
+
+    /** Copies 8-bit pixels between LUMINANCE, RGB and RGBA layouts, as CopyImage would. */
+    template<unsigned SrcN, unsigned DstN>
+    void convertRows8(const osg::Image* src, osg::Image* dst)
+    {
+        for(int r = 0; r < src->r(); ++r)
+        {
+            for(int t = 0; t < src->t(); ++t)
+            {
+                const GLubyte* sp = src->data(0, t, r);
+                GLubyte*       dp = dst->data(0, t, r);
+                for(int s = 0; s < src->s(); ++s, sp += SrcN, dp += DstN)
+                {
+                    dp[0] = sp[0];
+                    dp[1] = sp[SrcN > 1u ? 1 : 0];
+                    dp[2] = sp[SrcN > 1u ? 2 : 0];
+                    if ( DstN == 4u )
+                        dp[3] = SrcN == 4u ? sp[3] : 255u;
+                }
+            }
+        }
+    }
+
+    /** Runs convertRows8 if the source is an 8-bit layout and the target RGB8 or RGBA8. */
+    bool convertFast(const osg::Image* src, osg::Image* dst)
+    {
+        // an unnormalized source gets a raw alpha of 1, not 255.
+        unsigned srcN = ImageUtils::isNormalized(src) ? getFastChannels(src, GL_UNSIGNED_BYTE) : 0u;
+        if ( srcN == 1u && src->getPixelFormat() != GL_LUMINANCE )
+            return false;
+
+        unsigned dstN = getFastChannels(dst, GL_UNSIGNED_BYTE);
+
+        if      ( srcN == 4u && dstN == 4u ) convertRows8<4u, 4u>( src, dst );
+        else if ( srcN == 4u && dstN == 3u ) convertRows8<4u, 3u>( src, dst );
+        else if ( srcN == 3u && dstN == 4u ) convertRows8<3u, 4u>( src, dst );
+        else if ( srcN == 3u && dstN == 3u ) convertRows8<3u, 3u>( src, dst );
+        else if ( srcN == 1u && dstN == 4u ) convertRows8<1u, 4u>( src, dst );
+        else if ( srcN == 1u && dstN == 3u ) convertRows8<1u, 3u>( src, dst );
+        else return false;
+
+        return true;
+    }
+
+    /**
+     * Lookup of which 8-bit alpha values pass a threshold, evaluated exactly as
+     * a PixelReader would see them (normalized).
+     */
+    struct AlphaTable
+    {
+        bool _above[256];
+
+        AlphaTable(float threshold)
+        {
+            for(unsigned b = 0; b < 256u; ++b)
+            {
+                float a = float(b) * (1.0/255.0);
+                _above[b] = a > threshold;
+            }
+        }
+
+        bool operator()(GLubyte b) const { return _above[b]; }
+    };
+
+    /** Whether the image is a normalized RGBA8 image, the layout the alpha kernels handle. */
+    bool isNormalizedRGBA8(const osg::Image* image)
+    {
+        return getFastChannels(image, GL_UNSIGNED_BYTE) == 4u && ImageUtils::isNormalized(image);
+    }
+}
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    /**
+     * Recycles the pixel buffers of tile-sized images, pooled by size in
+     * bytes. Each pooled image holds a reference to the pool, so the pool
+     * outlives every buffer it hands out.
+     */
+    class ImageBufferPool : public osg::Referenced
+    {
+    public:
+        static ImageBufferPool* instance()
+        {
+            static Threading::Mutex s_mutex;
+            static osg::ref_ptr<ImageBufferPool> s_pool;
+
+            Threading::ScopedMutexLock lock(s_mutex);
+            if ( !s_pool.valid() )
+            {
+                unsigned long long maxMB = 64u;
+                const char* poolEnv = ::getenv("OSGEARTH_IMAGE_POOL_MB");
+                if ( poolEnv )
+                    maxMB = as<unsigned long long>(std::string(poolEnv), maxMB);
+
+                // clamp so the byte count fits in a size_t.
+                const unsigned long long limitMB = (unsigned long long)(~(size_t)0) >> 20;
+                if ( maxMB > limitMB )
+                    maxMB = limitMB;
+
+                s_pool = new ImageBufferPool( (size_t)maxMB << 20 );
+            }
+            return s_pool.get();
+        }
+
+        /** Whether buffers of this size are worth pooling. */
+        bool accepts(unsigned size) const
+        {
+            return _maxBytes > 0u && size >= 4096u && size <= 4u*1024u*1024u && size <= _maxBytes;
+        }
+
+        unsigned char* acquire(unsigned size)
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                std::map<unsigned, std::vector<unsigned char*> >::iterator i = _free.find(size);
+                if ( i != _free.end() && !i->second.empty() )
+                {
+                    unsigned char* buffer = i->second.back();
+                    i->second.pop_back();
+                    _pooledBytes -= size;
+                    return buffer;
+                }
+            }
+            return new unsigned char[size];
+        }
+
+        void release(unsigned char* buffer, unsigned size)
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                if ( size <= _maxBytes - _pooledBytes )
+                {
+                    _free[size].push_back( buffer );
+                    _pooledBytes += size;
+                    return;
+                }
+            }
+            delete [] buffer;
+        }
+
+    protected:
+        ImageBufferPool(size_t maxBytes) : _maxBytes(maxBytes), _pooledBytes(0u) { }
+
+        virtual ~ImageBufferPool()
+        {
+            for(std::map<unsigned, std::vector<unsigned char*> >::iterator i = _free.begin(); i != _free.end(); ++i)
+                for(unsigned k = 0; k < i->second.size(); ++k)
+                    delete [] i->second[k];
+        }
+
+    private:
+        Threading::Mutex                                  _mutex;
+        std::map<unsigned, std::vector<unsigned char*> >  _free;
+        size_t                                            _maxBytes;
+        size_t                                            _pooledBytes;
+    };
+
+    /**
+     * Image whose pixel buffer belongs to the ImageBufferPool. The image never
+     * frees the buffer itself (NO_DELETE); it goes back to the pool when the
+     * image is destroyed, even if the image was reallocated in the meantime.
+     */
+    class PooledImage : public osg::Image
+    {
+    public:
+        PooledImage(ImageBufferPool* pool, unsigned size) :
+            _pool  ( pool ),
+            _buffer( pool->acquire(size) ),
+            _size  ( size ) { }
+
+        unsigned char* buffer() const { return _buffer; }
+
+    protected:
+        virtual ~PooledImage()
+        {
+            if ( data() == _buffer )
+                setData( 0L, osg::Image::NO_DELETE );
+            _pool->release( _buffer, _size );
+        }
+
+    private:
+        osg::ref_ptr<ImageBufferPool> _pool;
+        unsigned char*                _buffer;
+        unsigned                      _size;
+    };
+}
+
+osg::Image*
+ImageUtils::createImage(int s, int t, int r, GLenum pixelFormat, GLenum dataType, int packing)
+{
+    unsigned size = osg::Image::computeRowWidthInBytes(s, pixelFormat, dataType, packing) * t * r;
+
+    ImageBufferPool* pool = ImageBufferPool::instance();
+    if ( !pool->accepts(size) )
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage( s, t, r, pixelFormat, dataType, packing );
+        return image;
+    }
+
+    PooledImage* image = new PooledImage( pool, size );
+    image->setImage( s, t, r, pixelFormat, pixelFormat, dataType, image->buffer(), osg::Image::NO_DELETE, packing );
+    return image;
+}
+
 
 osg::Image*
 ImageUtils::cloneImage( const osg::Image* input )
@@ -97,6 +445,23 @@ ImageUtils::isUnNormalized(const osg::Image* image)
     return image->getUserValue("osgEarth.unnormalized", result) && (result == true);
 }
 
+void
+ImageUtils::markAsSingleColor(osg::Image* image, bool value)
+{
+    if ( image )
+    {
+        image->setUserValue("osgEarth.singlecolor", value);
+    }
+}
+
+bool
+ImageUtils::isMarkedAsSingleColor(const osg::Image* image)
+{
+    if ( !image ) return false;
+    bool result;
+    return image->getUserValue("osgEarth.singlecolor", result) && (result == true);
+}
+
 bool
 ImageUtils::copyAsSubImage(const osg::Image* src, osg::Image* dst, int dst_start_col, int dst_start_row)
 {
@@ -228,18 +593,16 @@ ImageUtils::resizeImage(const osg::Image* input,
 
     if ( !output.valid() )
     {
-        output = new osg::Image();
-
         if ( PixelWriter::supports(input) )
         {
-            output->allocateImage( out_s, out_t, input->r(), input->getPixelFormat(), input->getDataType(), input->getPacking() );
+            output = createImage( out_s, out_t, input->r(), input->getPixelFormat(), input->getDataType(), input->getPacking() );
             output->setInternalTextureFormat( input->getInternalTextureFormat() );
             markAsNormalized(output, isNormalized(input));
         }
         else
         {
             // for unsupported write formats, convert to normalized RGBA8 automatically.
-            output->allocateImage( out_s, out_t, input->r(), GL_RGBA, GL_UNSIGNED_BYTE );
+            output = createImage( out_s, out_t, input->r(), GL_RGBA, GL_UNSIGNED_BYTE );
             output->setInternalTextureFormat( GL_RGB8A_INTERNAL );
         }
     }
@@ -253,6 +616,10 @@ ImageUtils::resizeImage(const osg::Image* input,
     {
         memcpy( output->data(), input->data(), input->getTotalSizeInBytes() );
     }
+    else if ( mipmapLevel == 0 && resizeFast(input, output.get(), out_s, out_t, bilinear) )
+    {
+        // done.
+    }
     else
     {
         PixelReader read( input );
@@ -713,6 +1080,35 @@ namespace
             return true;
         }
     };
+
+    // MixImage for 8-bit RGB(A) sources onto an 8-bit RGBA image, in integer
+    // math over whole rows so the compiler can vectorize it.
+    void mixRGBA8(osg::Image* dest, const osg::Image* src, float a)
+    {
+        const unsigned a8 = (unsigned)(osg::clampBetween(a, 0.0f, 1.0f) * 255.0f + 0.5f);
+        const bool srcHasAlpha = src->getPixelFormat() == GL_RGBA;
+        const unsigned srcStep = srcHasAlpha ? 4u : 3u;
+        const int s = dest->s();
+
+        for (int r = 0; r < dest->r(); ++r)
+        {
+            for (int t = 0; t < dest->t(); ++t)
+            {
+                const unsigned char* sp = src->data(0, t, r);
+                unsigned char*       dp = dest->data(0, t, r);
+
+                for (int i = 0; i < s; ++i, sp += srcStep, dp += 4)
+                {
+                    unsigned sa = srcHasAlpha ? (a8 * sp[3] + 127u) / 255u : a8;
+                    unsigned da = 255u - sa;
+                    dp[0] = (unsigned char)((dp[0]*da + sp[0]*sa + 127u) / 255u);
+                    dp[1] = (unsigned char)((dp[1]*da + sp[1]*sa + 127u) / 255u);
+                    dp[2] = (unsigned char)((dp[2]*da + sp[2]*sa + 127u) / 255u);
+                    dp[3] = (unsigned char)osg::maximum(sa, (unsigned)dp[3]);
+                }
+            }
+        }
+    }
 }
 
 bool
@@ -724,6 +1120,13 @@ ImageUtils::mix(osg::Image* dest, const osg::Image* src, float a)
     {
         return false;
     }
+
+    if (isNormalizedRGBA8(dest) && isNormalized(src) &&
+        getFastChannels(src, GL_UNSIGNED_BYTE) >= 3u)
+    {
+        mixRGBA8( dest, src, a );
+        return true;
+    }
     
     PixelVisitor<MixImage> mixer;
     mixer._a = osg::clampBetween( a, 0.0f, 1.0f );
@@ -776,8 +1179,7 @@ ImageUtils::cropImage(const osg::Image* image,
     //OE_NOTICE << "Copying from " << windowX << ", " << windowY << ", " << windowWidth << ", " << windowHeight << std::endl;
 
     //Allocate the croppped image
-    osg::Image* cropped = new osg::Image;
-    cropped->allocateImage(windowWidth, windowHeight, image->r(), image->getPixelFormat(), image->getDataType());
+    osg::Image* cropped = createImage(windowWidth, windowHeight, image->r(), image->getPixelFormat(), image->getDataType());
     cropped->setInternalTextureFormat( image->getInternalTextureFormat() );
     ImageUtils::markAsNormalized( cropped, ImageUtils::isNormalized(image) );    
     
@@ -860,8 +1262,7 @@ ImageUtils::createEmptyImage()
 osg::Image*
 ImageUtils::createEmptyImage(unsigned int s, unsigned int t)
 {
-    osg::Image* empty = new osg::Image;
-    empty->allocateImage(s,t,1, GL_RGBA, GL_UNSIGNED_BYTE);
+    osg::Image* empty = createImage(s,t,1, GL_RGBA, GL_UNSIGNED_BYTE);
     empty->setInternalTextureFormat( GL_RGB8A_INTERNAL );
     unsigned char *data = empty->data(0,0);
     memset(data, 0, 4 * s * t);
@@ -874,6 +1275,24 @@ ImageUtils::isEmptyImage(const osg::Image* image, float alphaThreshold)
     if ( !hasAlphaChannel(image) || !PixelReader::supports(image) )
         return false;
 
+    if ( isNormalizedRGBA8(image) )
+    {
+        AlphaTable visible( alphaThreshold );
+        for(int r=0; r<image->r(); ++r)
+        {
+            for(int t=0; t<image->t(); ++t)
+            {
+                const GLubyte* p = image->data(0, t, r) + 3;
+                for(int s=0; s<image->s(); ++s)
+                {
+                    if ( visible(p[s*4]) )
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
     PixelReader read(image);
     for(unsigned r=0; r<(unsigned)image->r(); ++r)
     {
@@ -1021,6 +1440,41 @@ ImageUtils::isSingleColorImage(const osg::Image* image, float threshold)
     if ( !PixelReader::supports(image) )
         return false;
 
+    unsigned n = isNormalized(image) ? getFastChannels(image, GL_UNSIGNED_BYTE) : 0u;
+    if ( n > 0u )
+    {
+        // compare whole rows of bytes to the first pixel.
+        const int tolerance = (int)floor(threshold * 255.0f + 0.0001f);
+        const int rowLength = image->s() * n;
+
+        // a row filled with the first pixel
+        std::vector<GLubyte> ref( rowLength );
+        for(int i=0; i<rowLength; ++i)
+            ref[i] = image->data(0, 0, 0)[i % n];
+
+        for(int r=0; r<image->r(); ++r)
+        {
+            for(int t=0; t<image->t(); ++t)
+            {
+                const GLubyte* p = image->data(0, t, r);
+                if ( tolerance == 0 )
+                {
+                    if ( memcmp(p, &ref[0], rowLength) != 0 )
+                        return false;
+                }
+                else
+                {
+                    for(int i=0; i<rowLength; ++i)
+                    {
+                        if ( std::abs((int)p[i] - (int)ref[i]) > tolerance )
+                            return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
     PixelReader read(image);
 
     osg::Vec4 referenceColor = read(0, 0, 0);
@@ -1049,6 +1503,51 @@ ImageUtils::isSingleColorImage(const osg::Image* image, float threshold)
     return true;
 }
 
+bool
+ImageUtils::compressImageInPlace(osg::Image*        image,
+                                 const std::string& processor,
+                                 bool               generateMipmaps)
+{
+    if ( !image || !image->data() || isCompressed(image) )
+        return false;
+
+    osg::Texture::InternalFormatMode mode;
+    // RGB uses DXT1
+    if ( image->getPixelFormat() == GL_RGB && image->getDataType() == GL_UNSIGNED_BYTE )
+    {
+        mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
+    }
+    // RGBA uses DXT5
+    else if ( image->getPixelFormat() == GL_RGBA && image->getDataType() == GL_UNSIGNED_BYTE )
+    {
+        mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
+    }
+    else
+    {
+        OE_DEBUG << LC << "Compression only works on GL_RGBA or GL_RGB images" << std::endl;
+        return false;
+    }
+
+    osgDB::ImageProcessor* imageProcessor = osgDB::Registry::instance()->getImageProcessorForExtension(processor);
+    if ( !imageProcessor )
+    {
+        OE_WARN << LC << "Failed to get ImageProcessor " << processor << std::endl;
+        return false;
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    // mipmaps need a power-of-two image.
+    bool mipmaps = generateMipmaps && isPowerOfTwo(image);
+    imageProcessor->compress(*image, mode, mipmaps, true, osgDB::ImageProcessor::USE_CPU, osgDB::ImageProcessor::FASTEST);
+    image->dirty();
+
+    osg::Timer_t end = osg::Timer::instance()->tick();
+    OE_DEBUG << LC << "Compress took " << osg::Timer::instance()->delta_m(start, end) << std::endl;
+
+    return isCompressed(image);
+}
+
 bool
 ImageUtils::computeTextureCompressionMode(const osg::Image*                 image,
                                           osg::Texture::InternalFormatMode& out_mode)
@@ -1067,7 +1566,13 @@ ImageUtils::computeTextureCompressionMode(const osg::Image*                 imag
             out_mode = osg::Texture::USE_S3TC_DXT5_COMPRESSION;
             return true;
         }
-        //todo: add ETC2
+#if OSG_VERSION_GREATER_OR_EQUAL(3,4,0)
+        else if (caps.supportsTextureCompression(osg::Texture::USE_ETC2_COMPRESSION))
+        {
+            out_mode = osg::Texture::USE_ETC2_COMPRESSION;
+            return true;
+        }
+#endif
         else if (caps.supportsTextureCompression(osg::Texture::USE_ARB_COMPRESSION))
         {
             out_mode = osg::Texture::USE_ARB_COMPRESSION;
@@ -1081,6 +1586,13 @@ ImageUtils::computeTextureCompressionMode(const osg::Image*                 imag
             out_mode = osg::Texture::USE_S3TC_DXT1_COMPRESSION;
             return true;
         }
+#if OSG_VERSION_GREATER_OR_EQUAL(3,4,0)
+        else if (caps.supportsTextureCompression(osg::Texture::USE_ETC2_COMPRESSION))
+        {
+            out_mode = osg::Texture::USE_ETC2_COMPRESSION;
+            return true;
+        }
+#endif
         else if (caps.supportsTextureCompression(osg::Texture::USE_ETC_COMPRESSION))
         {
             // ETC1 is RGB only
@@ -1187,8 +1699,7 @@ ImageUtils::convert(const osg::Image* image, GLenum pixelFormat, GLenum dataType
     if ( dataType == GL_UNSIGNED_BYTE && pixelFormat == GL_RGBA && image->getDataType() == GL_UNSIGNED_BYTE && image->getPixelFormat() == GL_RGB)
     {
         // Do fast conversion
-        osg::Image* result = new osg::Image();
-        result->allocateImage(image->s(), image->t(), image->r(), GL_RGBA, GL_UNSIGNED_BYTE);
+        osg::Image* result = createImage(image->s(), image->t(), image->r(), GL_RGBA, GL_UNSIGNED_BYTE);
         result->setInternalTextureFormat(GL_RGBA8);
 
         const unsigned char* pSrcData = image->data();
@@ -1220,8 +1731,7 @@ ImageUtils::convert(const osg::Image* image, GLenum pixelFormat, GLenum dataType
         return 0L;
 
     // Generic conversion : use PixelVisitor
-    osg::Image* result = new osg::Image();
-    result->allocateImage(image->s(), image->t(), image->r(), pixelFormat, dataType);
+    osg::Image* result = createImage(image->s(), image->t(), image->r(), pixelFormat, dataType);
     memset(result->data(), 0, result->getTotalSizeInBytes());
     markAsNormalized(result, isNormalized(image));
 
@@ -1232,7 +1742,10 @@ ImageUtils::convert(const osg::Image* image, GLenum pixelFormat, GLenum dataType
     else
         result->setInternalTextureFormat( pixelFormat );
 
-    PixelVisitor<CopyImage>().accept( image, result );
+    if ( !convertFast(image, result) )
+    {
+        PixelVisitor<CopyImage>().accept( image, result );
+    }
 
     return result;
 }
@@ -1316,13 +1829,73 @@ ImageUtils::featherAlphaRegions(osg::Image* image, float maxAlpha)
     if ( !PixelReader::supports(image) || !PixelWriter::supports(image) )
         return false;
 
-    PixelReader read (image);
-    PixelWriter write(image);
-
     int ns = image->s();
     int nt = image->t();
     int nr = image->r();
 
+    if ( isNormalizedRGBA8(image) )
+    {
+        // same passes as below, moving whole 4-byte pixels.
+        AlphaTable visible( maxAlpha );
+
+        for( int r=0; r<nr; ++r )
+        {
+            for( int t=0; t<nt; ++t )
+            {
+                GLubyte* row = image->data(0, t, r);
+                bool rowdone = false;
+                for( int s=0; s<ns && !rowdone; ++s )
+                {
+                    GLubyte* pixel = row + s*4;
+                    if ( !visible(pixel[3]) )
+                    {
+                        bool wrote = false;
+                        if ( s < ns-1 && visible(pixel[7]) ) {
+                            memcpy( pixel, pixel+4, 4 );
+                            wrote = true;
+                        }
+                        if ( !wrote && s > 0 && visible(pixel[-1]) ) {
+                            memcpy( pixel, pixel-4, 4 );
+                            rowdone = true;
+                        }
+                    }
+                }
+            }
+
+            for( int s=0; s<ns; ++s )
+            {
+                bool coldone = false;
+                for( int t=0; t<nt && !coldone; ++t )
+                {
+                    GLubyte* pixel = image->data(s, t, r);
+                    if ( !visible(pixel[3]) )
+                    {
+                        bool wrote = false;
+                        if ( t < nt-1 ) {
+                            GLubyte* n = image->data(s, t+1, r);
+                            if ( visible(n[3]) ) {
+                                memcpy( pixel, n, 4 );
+                                wrote = true;
+                            }
+                        }
+                        if ( !wrote && t > 0 ) {
+                            GLubyte* n = image->data(s, t-1, r);
+                            if ( visible(n[3]) ) {
+                                memcpy( pixel, n, 4 );
+                                coldone = true;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    PixelReader read (image);
+    PixelWriter write(image);
+
     osg::Vec4 n;
 
     for( int r=0; r<nr; ++r )
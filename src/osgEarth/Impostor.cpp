@@ -0,0 +1,250 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/Impostor>
+#include <osgEarth/VirtualProgram>
+#include <osgEarth/ShaderGenerator>
+#include <osgEarth/Registry>
+#include <osgEarth/Capabilities>
+#include <osgEarth/CullingUtils>
+#include <osg/Camera>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/ComputeBoundsVisitor>
+
+using namespace osgEarth;
+
+#define LC "[Impostor] "
+
+namespace
+{
+    const char* ImpostorVertexShader =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+
+        "out vec2 oe_impostor_uv; \n"
+
+        "void oe_impostor_vertex(inout vec4 VertexMODEL) \n"
+        "{ \n"
+        "    oe_impostor_uv = gl_MultiTexCoord0.st; \n"
+        "} \n";
+
+    const char* ImpostorFragmentShader =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+
+        "uniform sampler2D oe_impostor_tex; \n"
+        "in vec2 oe_impostor_uv; \n"
+
+        "void oe_impostor_fragment(inout vec4 color) \n"
+        "{ \n"
+        "    vec4 texel = texture(oe_impostor_tex, oe_impostor_uv); \n"
+        "    if ( texel.a < 0.5 ) discard; \n"
+        "    color = vec4(color.rgb * texel.rgb, color.a); \n"
+        "} \n";
+
+    /**
+     * Group that traverses its children during the cull traversal only if
+     * its impostor hasn't rendered yet in the current graphics context.
+     */
+    class RenderOnceGroup : public osg::Group
+    {
+    public:
+        RenderOnceGroup(Impostor* impostor) : _impostor(impostor)
+        {
+            setCullingActive(false);
+        }
+
+        void traverse(osg::NodeVisitor& nv)
+        {
+            if (nv.getVisitorType() == nv.CULL_VISITOR)
+            {
+                osgUtil::CullVisitor* cv = Culling::asCullVisitor(nv);
+                unsigned id = cv && cv->getState() ? cv->getState()->getContextID() : 0u;
+                if (!_impostor->claimRender(id))
+                    return;
+            }
+            osg::Group::traverse(nv);
+        }
+
+    private:
+        osg::ref_ptr<Impostor> _impostor;
+    };
+
+    // Orthographic camera that renders the model into one half of the atlas.
+    osg::Camera* createViewCamera(osg::Node* model, osg::Texture2D* texture, unsigned size, unsigned half,
+                                  const osg::Vec3d& eye, const osg::Vec3d& center,
+                                  double left, double right, double bottom, double top, double radius)
+    {
+        osg::Camera* camera = new osg::Camera();
+        camera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+        camera->setRenderOrder(osg::Camera::PRE_RENDER);
+        camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+        camera->setCullingActive(false);
+        camera->setClearColor(osg::Vec4(0,0,0,0));
+        camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+        camera->setSmallFeatureCullingPixelSize(0.0f);
+        camera->setViewport(half*size, 0, size, size);
+        camera->setViewMatrixAsLookAt(eye, center, osg::Vec3d(0,0,1));
+        camera->setProjectionMatrixAsOrtho(left, right, bottom, top, radius, 3.0*radius);
+        camera->attach(osg::Camera::COLOR_BUFFER, texture, 0u, 0u, /*mipmap=*/true);
+        camera->addChild(model);
+        return camera;
+    }
+}
+
+Impostor::Impostor(osg::Node* model, unsigned size) :
+_size(size)
+{
+    osg::ComputeBoundsVisitor cbv;
+    model->accept(cbv);
+    _box = cbv.getBoundingBox();
+    if (!_box.valid())
+    {
+        OE_WARN << LC << "Model has no bounds; cannot create an impostor\n";
+        return;
+    }
+
+    _texture = new osg::Texture2D();
+    _texture->setTextureSize(2*size, size);
+    _texture->setInternalFormat(GL_RGBA);
+    _texture->setSourceFormat(GL_RGBA);
+    _texture->setSourceType(GL_UNSIGNED_BYTE);
+    _texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
+    _texture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+    _texture->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+    _texture->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+}
+
+bool
+Impostor::claimRender(unsigned contextID)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    if (contextID >= _rendered.size())
+        _rendered.resize(contextID+1, false);
+    if (_rendered[contextID])
+        return false;
+    _rendered[contextID] = true;
+    return true;
+}
+
+osg::Node*
+Impostor::createRenderNode(osg::Node* model)
+{
+    if (!valid() || !model)
+        return 0L;
+
+    const osg::BoundingBox& box = _box;
+    const osg::Vec3d center = box.center();
+    const double radius = osg::maximum((double)box.radius(), 1e-3);
+
+    // Front view looks down +Y (screen right is +X); side view looks
+    // down -X (screen right is +Y). Both are orthographic and fit the box.
+    osg::Group* render = new RenderOnceGroup(this);
+
+    render->addChild(createViewCamera(
+        model, _texture.get(), _size, 0u,
+        center - osg::Vec3d(0, 2.0*radius, 0), center,
+        box.xMin()-center.x(), box.xMax()-center.x(), box.zMin()-center.z(), box.zMax()-center.z(),
+        radius));
+
+    render->addChild(createViewCamera(
+        model, _texture.get(), _size, 1u,
+        center + osg::Vec3d(2.0*radius, 0, 0), center,
+        box.yMin()-center.y(), box.yMax()-center.y(), box.zMin()-center.z(), box.zMax()-center.z(),
+        radius));
+
+    return render;
+}
+
+osg::Node*
+Impostor::createImpostorNode() const
+{
+    if (!valid())
+        return 0L;
+
+    const osg::BoundingBox& box = _box;
+    const osg::Vec3 center = box.center();
+
+    // Two crossed quads through the center of the box, each mapped to
+    // its half of the atlas.
+    osg::Geometry* geom = new osg::Geometry();
+    geom->setUseVertexBufferObjects(true);
+    geom->setUseDisplayList(false);
+
+    osg::Vec3Array* verts = new osg::Vec3Array();
+    verts->push_back(osg::Vec3(box.xMin(), center.y(), box.zMin()));
+    verts->push_back(osg::Vec3(box.xMax(), center.y(), box.zMin()));
+    verts->push_back(osg::Vec3(box.xMax(), center.y(), box.zMax()));
+    verts->push_back(osg::Vec3(box.xMin(), center.y(), box.zMax()));
+    verts->push_back(osg::Vec3(center.x(), box.yMin(), box.zMin()));
+    verts->push_back(osg::Vec3(center.x(), box.yMax(), box.zMin()));
+    verts->push_back(osg::Vec3(center.x(), box.yMax(), box.zMax()));
+    verts->push_back(osg::Vec3(center.x(), box.yMin(), box.zMax()));
+    geom->setVertexArray(verts);
+
+    osg::Vec2Array* uvs = new osg::Vec2Array();
+    uvs->push_back(osg::Vec2(0.0f, 0.0f));
+    uvs->push_back(osg::Vec2(0.5f, 0.0f));
+    uvs->push_back(osg::Vec2(0.5f, 1.0f));
+    uvs->push_back(osg::Vec2(0.0f, 1.0f));
+    uvs->push_back(osg::Vec2(0.5f, 0.0f));
+    uvs->push_back(osg::Vec2(1.0f, 0.0f));
+    uvs->push_back(osg::Vec2(1.0f, 1.0f));
+    uvs->push_back(osg::Vec2(0.5f, 1.0f));
+    geom->setTexCoordArray(0, uvs);
+
+    // Light the quads as if they faced up, so they don't darken as the
+    // camera moves around them.
+    osg::Vec3Array* normals = new osg::Vec3Array();
+    normals->push_back(osg::Vec3(0,0,1));
+    geom->setNormalArray(normals, osg::Array::BIND_OVERALL);
+
+    osg::Vec4Array* colors = new osg::Vec4Array();
+    colors->push_back(osg::Vec4(1,1,1,1));
+    geom->setColorArray(colors, osg::Array::BIND_OVERALL);
+
+    osg::DrawElementsUByte* quads = new osg::DrawElementsUByte(GL_TRIANGLES);
+    const GLubyte indices[] = { 0,1,2, 0,2,3, 4,5,6, 4,6,7 };
+    for (unsigned i = 0; i < 12; ++i)
+        quads->push_back(indices[i]);
+    geom->addPrimitiveSet(quads);
+
+    osg::Geode* geode = new osg::Geode();
+    geode->addDrawable(geom);
+
+    osg::StateSet* ss = geode->getOrCreateStateSet();
+    ss->setMode(GL_CULL_FACE, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+
+    if (Registry::capabilities().supportsGLSL())
+    {
+        ss->setTextureAttribute(0, _texture.get());
+        ss->addUniform(new osg::Uniform("oe_impostor_tex", 0));
+
+        VirtualProgram* vp = VirtualProgram::getOrCreate(ss);
+        vp->setName("Impostor");
+        vp->setFunction("oe_impostor_vertex",   ImpostorVertexShader,   ShaderComp::LOCATION_VERTEX_MODEL);
+        vp->setFunction("oe_impostor_fragment", ImpostorFragmentShader, ShaderComp::LOCATION_FRAGMENT_COLORING, 0.4f);
+    }
+
+    // Shaders are already in place; keep the generator away from the quads.
+    ShaderGenerator::setIgnoreHint(geode, true);
+
+    return geode;
+}
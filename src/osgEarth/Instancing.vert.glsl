@@ -7,6 +7,8 @@
 #pragma vp_order      0.0
 
 uniform samplerBuffer oe_di_postex_TBO;
+uniform samplerBuffer oe_di_index_TBO;
+uniform bool oe_di_culled;
 
 // Stage-global containing object ID
 uint oe_index_objectid;
@@ -14,7 +16,9 @@ vec3 vp_Normal;
 
 void oe_di_setInstancePosition(inout vec4 VertexMODEL)
 { 
-    int index = 4 * gl_InstanceID;
+    // when instances are culled, the instance ID indexes the list of visible instances
+    int instance = oe_di_culled ? int(texelFetch(oe_di_index_TBO, gl_InstanceID).r) : gl_InstanceID;
+    int index = 4 * instance;
 
     vec4 m0 = texelFetch(oe_di_postex_TBO, index);
     vec4 m1 = texelFetch(oe_di_postex_TBO, index+1); 
@@ -25,12 +25,52 @@
 #include <osgEarth/URI>
 #include <osgEarth/ElevationPool>
 #include <osgEarth/Utils>
+#include <osgEarth/StatsRegistry>
+#include <osgEarth/TaskService>
 #include <iterator>
+#include <set>
 
 using namespace osgEarth;
 
 #define LC "[Map] "
 
+namespace
+{
+    // Opens a layer and records how long it took, for startup profiling.
+    void openLayer(Layer* layer)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
+
+        layer->open();
+
+        double seconds = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+
+        StatsRegistry::instance()->getGauge(
+            "osgearth_layer_open_seconds",
+            Stringify() << "layer=" << StatsRegistry::labelValue(layer->getName()),
+            "Time spent opening each map layer")->set(seconds);
+
+        OE_INFO << LC << "Opened \"" << layer->getName() << "\" in " << seconds << "s\n";
+    }
+
+    // Layer opens share the registry's thread budget under this UID.
+    TaskService* getLayerOpenService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    struct OpenLayers : public ParallelJobs
+    {
+        std::vector<Layer*> _layers;
+
+        void runJob(unsigned i)
+        {
+            openLayer(_layers[i]);
+        }
+    };
+}
+
 //------------------------------------------------------------------------
 
 Map::ElevationLayerCB::ElevationLayerCB(Map* map) :
@@ -267,53 +307,119 @@ Map::addLayer(Layer* layer)
     {
         if (layer->getEnabled())
         {
-            // Pass along the Read Options (including the cache settings, etc.) to the layer:
-            layer->setReadOptions(_readOptions.get());
-            
-            // If this is a terrain layer, tell it about the Map profile.
-            TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer);
-            if (terrainLayer && _profile.valid())
-            {
-                terrainLayer->setTargetProfileHint( _profile.get() );
-            }            
+            prepareLayer(layer);
 
             // Attempt to open the layer. Don't check the status here.
-            layer->open();
+            openLayer(layer);
+        }
 
-            // If this is an elevation layer, install a callback so we know when
-            // it's visibility changes:
-            ElevationLayer* elevationLayer = dynamic_cast<ElevationLayer*>(layer);
-            if (elevationLayer)
-            {
-                elevationLayer->addCallback(_elevationLayerCB.get());
+        installLayer(layer);
+    }
+}
 
-                // invalidate the elevation pool
-                getElevationPool()->clear();
-            }
+void
+Map::addLayers(const LayerVector& layers)
+{
+    osgEarth::Registry::instance()->clearBlacklist();
+
+    // Terrain layers are independent of one another until they join the map,
+    // and their open() is dominated by I/O, so open those concurrently.
+    std::vector<Layer*> concurrent;
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        Layer* layer = i->get();
+        if (layer && layer->getEnabled())
+        {
+            prepareLayer(layer);
+            if (dynamic_cast<TerrainLayer*>(layer))
+                concurrent.push_back(layer);
         }
+    }
 
-        int newRevision;
-        unsigned index = -1;
+    std::set<Layer*> opened;
+    if (concurrent.size() > 1u)
+    {
+        osg::Timer_t start = osg::Timer::instance()->tick();
 
-        // Add the layer to our stack.
+        osg::ref_ptr<OpenLayers> jobs = new OpenLayers();
+        jobs->_layers = concurrent;
+        jobs->run(concurrent.size(), getLayerOpenService());
+
+        opened.insert(concurrent.begin(), concurrent.end());
+
+        OE_INFO << LC << "Opened " << concurrent.size() << " terrain layers in "
+            << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << "s\n";
+    }
+
+    // Everything joins the map in the original order; anything not already
+    // opened above opens here, serially.
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        Layer* layer = i->get();
+        if (layer)
         {
-            Threading::ScopedWriteLock lock( _mapDataMutex );
+            if (layer->getEnabled() && opened.find(layer) == opened.end())
+            {
+                openLayer(layer);
+            }
 
-            _layers.push_back( layer );
-            index = _layers.size() - 1;
-            newRevision = ++_dataModelRevision;
+            installLayer(layer);
         }
+    }
+}
 
-        // tell the layer it was just added.
-        layer->addedToMap(this);
+void
+Map::prepareLayer(Layer* layer)
+{
+    // Pass along the Read Options (including the cache settings, etc.) to the layer:
+    layer->setReadOptions(_readOptions.get());
 
-        // a separate block b/c we don't need the mutex
-        for( MapCallbackList::iterator i = _mapCallbacks.begin(); i != _mapCallbacks.end(); i++ )
+    // If this is a terrain layer, tell it about the Map profile.
+    TerrainLayer* terrainLayer = dynamic_cast<TerrainLayer*>(layer);
+    if (terrainLayer && _profile.valid())
+    {
+        terrainLayer->setTargetProfileHint( _profile.get() );
+    }
+}
+
+void
+Map::installLayer(Layer* layer)
+{
+    if (layer->getEnabled())
+    {
+        // If this is an elevation layer, install a callback so we know when
+        // it's visibility changes:
+        ElevationLayer* elevationLayer = dynamic_cast<ElevationLayer*>(layer);
+        if (elevationLayer)
         {
-            i->get()->onMapModelChanged(MapModelChange(
-                MapModelChange::ADD_LAYER, newRevision, layer, index));
+            elevationLayer->addCallback(_elevationLayerCB.get());
+
+            // invalidate the elevation pool
+            getElevationPool()->clear();
         }
     }
+
+    int newRevision;
+    unsigned index = -1;
+
+    // Add the layer to our stack.
+    {
+        Threading::ScopedWriteLock lock( _mapDataMutex );
+
+        _layers.push_back( layer );
+        index = _layers.size() - 1;
+        newRevision = ++_dataModelRevision;
+    }
+
+    // tell the layer it was just added.
+    layer->addedToMap(this);
+
+    // a separate block b/c we don't need the mutex
+    for( MapCallbackList::iterator i = _mapCallbacks.begin(); i != _mapCallbacks.end(); i++ )
+    {
+        i->get()->onMapModelChanged(MapModelChange(
+            MapModelChange::ADD_LAYER, newRevision, layer, index));
+    }
 }
 
 void
@@ -335,7 +441,7 @@ Map::insertLayer(Layer* layer, unsigned index)
             }            
 
             // Attempt to open the layer. Don't check the status here.
-            layer->open();
+            openLayer(layer);
 
             // If this is an elevation layer, install a callback so we know when
             // it's visibility changes:
@@ -37,6 +37,7 @@
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/TextureCompositor>
 #include <osgEarth/ShaderGenerator>
+#include <osgEarth/ShaderWarmUp>
 #include <osgEarth/SpatialReference>
 #include <osgEarth/MapModelChange>
 #include <osgEarth/Lighting>
@@ -45,6 +46,7 @@
 #include <osg/ArgumentParser>
 #include <osg/PagedLOD>
 #include <osgUtil/Optimizer>
+#include <osgUtil/CullVisitor>
 #include <typeinfo>
 
 using namespace osgEarth;
@@ -342,6 +344,8 @@ MapNode::init()
             draping->setAttachStencil( *_mapNodeOptions.overlayAttachStencil() );
         if ( _mapNodeOptions.overlayResolutionRatio().isSet() )
             draping->setResolutionRatio( *_mapNodeOptions.overlayResolutionRatio() );
+        if ( _mapNodeOptions.overlayCascades().isSet() )
+            draping->setNumCascades( *_mapNodeOptions.overlayCascades() );
 
         draping->reestablish( getTerrainEngine() );
         _overlayDecorator->addTechnique( draping );
@@ -757,7 +761,54 @@ MapNode::traverse( osg::NodeVisitor& nv )
 
     else
     {
+        if ( nv.getVisitorType() == nv.CULL_VISITOR && _mapNodeOptions.warmUpShaders() == true )
+        {
+            cullShaderWarmUp( nv );
+        }
+
         if (dynamic_cast<osgUtil::BaseOptimizerVisitor*>(&nv) == 0L)
             osg::Group::traverse( nv );
     }
 }
+
+void
+MapNode::cullShaderWarmUp(osg::NodeVisitor& nv)
+{
+    osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(&nv);
+    if ( !cv )
+        return;
+
+    if ( !_shaderWarmUpNode.valid() )
+    {
+        Threading::ScopedMutexLock lock( _shaderWarmUpMutex );
+        if ( !_shaderWarmUpNode.valid() )
+        {
+            // the state above and including this node, outermost first:
+            ShaderWarmUp::StatePath prefix;
+            for(osgUtil::StateGraph* sg = cv->getCurrentStateGraph(); sg; sg = sg->_parent)
+            {
+                if ( sg->getStateSet() )
+                    prefix.insert( prefix.begin(), const_cast<osg::StateSet*>(sg->getStateSet()) );
+            }
+
+            osg::ref_ptr<ShaderWarmUp> warmUp = new ShaderWarmUp();
+
+            if ( _terrainEngine )
+            {
+                ShaderWarmUp::StatePath terrainPrefix = prefix;
+                if ( _terrainEngineContainer && _terrainEngineContainer->getStateSet() )
+                    terrainPrefix.push_back( _terrainEngineContainer->getStateSet() );
+                _terrainEngine->addShaderWarmUpStates( terrainPrefix, *warmUp.get() );
+            }
+
+            // model layers that have already loaded
+            warmUp->addScene( _layerNodes, prefix );
+
+            OE_INFO << LC << "Shader warm-up will build " << warmUp->size() << " state combinations" << std::endl;
+
+            _shaderWarmUpNode = warmUp->createNode();
+        }
+    }
+
+    _shaderWarmUpNode->accept( nv );
+}
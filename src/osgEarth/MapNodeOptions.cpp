@@ -40,7 +40,9 @@ _overlayMipMapping     ( false ),
 _overlayTextureSize    ( 4096 ),
 _terrainOptions        ( 0L ),
 _overlayAttachStencil  ( false ),
-_overlayResolutionRatio( 3.0f )
+_overlayResolutionRatio( 3.0f ),
+_overlayCascades       ( 1u ),
+_warmUpShaders         ( false )
 {
     mergeConfig( conf );
 }
@@ -54,6 +56,8 @@ _overlayTextureSize    ( 4096 ),
 _overlayMipMapping     ( false ),
 _overlayAttachStencil  ( false ),
 _overlayResolutionRatio( 3.0f ),
+_overlayCascades       ( 1u ),
+_warmUpShaders         ( false ),
 _terrainOptions        ( 0L )
 {
     setTerrainOptions( to );
@@ -68,6 +72,8 @@ _overlayTextureSize    ( 4096 ),
 _overlayMipMapping     ( false ),
 _overlayAttachStencil  ( false ),
 _overlayResolutionRatio( 3.0f ),
+_overlayCascades       ( 1u ),
+_warmUpShaders         ( false ),
 _terrainOptions        ( 0L )
 {
     mergeConfig( rhs.getConfig() );
@@ -99,6 +105,8 @@ MapNodeOptions::getConfig() const
     conf.updateIfSet   ( "overlay_mipmapping",       _overlayMipMapping );
     conf.updateIfSet   ( "overlay_attach_stencil",   _overlayAttachStencil );
     conf.updateIfSet   ( "overlay_resolution_ratio", _overlayResolutionRatio );
+    conf.updateIfSet   ( "overlay_cascades",         _overlayCascades );
+    conf.updateIfSet   ( "warm_up_shaders",          _warmUpShaders );
 
     return conf;
 }
@@ -117,6 +125,8 @@ MapNodeOptions::mergeConfig( const Config& conf )
     conf.getIfSet   ( "overlay_mipmapping",       _overlayMipMapping );
     conf.getIfSet   ( "overlay_attach_stencil",   _overlayAttachStencil );
     conf.getIfSet   ( "overlay_resolution_ratio", _overlayResolutionRatio );
+    conf.getIfSet   ( "overlay_cascades",         _overlayCascades );
+    conf.getIfSet   ( "warm_up_shaders",          _warmUpShaders );
 
     if ( conf.hasChild( "terrain" ) )
     {
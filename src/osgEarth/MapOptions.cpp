@@ -45,6 +45,7 @@ MapOptions::fromConfig( const Config& conf )
     conf.getIfSet( "elevation_interpolation", "average",     _elevationInterpolation, INTERP_AVERAGE);
     conf.getIfSet( "elevation_interpolation", "bilinear",    _elevationInterpolation, INTERP_BILINEAR);
     conf.getIfSet( "elevation_interpolation", "triangulate", _elevationInterpolation, INTERP_TRIANGULATE);
+    conf.getIfSet( "elevation_interpolation", "bicubic",     _elevationInterpolation, INTERP_BICUBIC);
 }
 
 Config
@@ -65,6 +66,7 @@ MapOptions::getConfig() const
     conf.set( "elevation_interpolation", "average",     _elevationInterpolation, INTERP_AVERAGE);
     conf.set( "elevation_interpolation", "bilinear",    _elevationInterpolation, INTERP_BILINEAR);
     conf.set( "elevation_interpolation", "triangulate", _elevationInterpolation, INTERP_TRIANGULATE);
+    conf.set( "elevation_interpolation", "bicubic",     _elevationInterpolation, INTERP_BICUBIC);
 
     return conf;
 }
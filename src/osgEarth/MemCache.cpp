@@ -20,6 +20,9 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Containers>
+#include <osgEarth/StatsRegistry>
+#include <osgEarth/Memory>
+#include <list>
 
 using namespace osgEarth;
 
@@ -29,38 +32,65 @@ using namespace osgEarth;
 
 namespace
 {
-    typedef std::pair<osg::ref_ptr<const osg::Object>, Config> MemCacheEntry;
-    typedef LRUCache<std::string, MemCacheEntry> MemCacheLRU;
-
     struct MemCacheBin : public CacheBin
     {
-        MemCacheBin( const std::string& id, unsigned maxSize )
-            : CacheBin( id ),
-              _lru    ( true /* MT-safe */, maxSize )
+        struct Entry
         {
-            //nop
-        }
+            osg::ref_ptr<const osg::Object>  _object;
+            Config                           _meta;
+            unsigned                         _bytes;
+            std::list<std::string>::iterator _lru;
+        };
+        typedef std::map<std::string, Entry> EntryMap;
 
-        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        MemCacheBin( const std::string& id, unsigned maxSize, unsigned maxBytes )
+            : CacheBin   ( id ),
+              _maxSize   ( maxSize ),
+              _maxBytes  ( maxBytes ),
+              _bytes     ( 0u ),
+              _reported  ( 0u ),
+              _queries   ( 0u ),
+              _hits      ( 0u ),
+              _evictions ( 0u )
         {
-            MemCacheLRU::Record rec;
-            _lru.get(key, rec);
+            std::string labels = "bin=" + StatsRegistry::labelValue(id);
+            StatsRegistry* stats = StatsRegistry::instance();
+            _hitCounter   = stats->getCounter("osgearth_memcache_reads_total", labels + ",result=\"hit\"", "Reads from memory cache bins");
+            _missCounter  = stats->getCounter("osgearth_memcache_reads_total", labels + ",result=\"miss\"");
+            _evictCounter = stats->getCounter("osgearth_memcache_evictions_total", labels, "Entries evicted from memory cache bins");
+            _bytesGauge   = stats->getGauge("osgearth_memcache_bytes", labels, "Estimated memory held by memory cache bins");
+        }
 
-            // clone required since the cache is in memory
+        ~MemCacheBin()
+        {
+            Memory::adjustUsage( Memory::MEMCACHE, -(long long)_reported );
+        }
 
-            if ( rec.valid() )
+        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        {
+            osg::ref_ptr<const osg::Object> object;
+            Config meta;
             {
-                //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
+                Threading::ScopedMutexLock lock(_mutex);
+                ++_queries;
+                EntryMap::iterator i = _entries.find(key);
+                if ( i == _entries.end() )
+                {
+                    _missCounter->add();
+                    return ReadResult();
+                }
 
-                return ReadResult( 
-                   osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL),
-                   rec.value().second );
-            }
-            else
-            {
-                //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
-                return ReadResult();
+                ++_hits;
+                _hitCounter->add();
+                _lru.splice( _lru.end(), _lru, i->second._lru );
+                object = i->second._object.get();
+                meta   = i->second._meta;
             }
+
+            // clone required since the cache is in memory
+            return ReadResult( 
+                osg::clone(object.get(), osg::CopyOp::DEEP_COPY_ALL),
+                meta );
         }
 
         ReadResult readImage(const std::string& key, const osgDB::Options* readOptions)
@@ -75,38 +105,79 @@ namespace
 
         bool write( const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
         {
-            if ( object ) 
+            if ( !object )
+                return false;
+
+            osg::ref_ptr<const osg::Object> cloned = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
+            unsigned bytes = Memory::estimateSize(cloned.get()) + key.size() + sizeof(Entry);
+
+            // an object that blows the whole budget would only flush everything else.
+            if ( _maxBytes > 0u && bytes > _maxBytes )
+                return false;
+
+            Threading::ScopedMutexLock lock(_mutex);
+
+            EntryMap::iterator i = _entries.find(key);
+            if ( i != _entries.end() )
             {
-                osg::ref_ptr<const osg::Object> cloned = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
-                _lru.insert( key, std::make_pair(cloned.get(), meta) );
-                return true;
+                _bytes -= i->second._bytes;
+                _lru.splice( _lru.end(), _lru, i->second._lru );
             }
             else
-                return false;
+            {
+                _lru.push_back( key );
+                i = _entries.insert( std::make_pair(key, Entry()) ).first;
+                i->second._lru = --_lru.end();
+            }
+
+            i->second._object = cloned.get();
+            i->second._meta   = meta;
+            i->second._bytes  = bytes;
+            _bytes += bytes;
+
+            evict();
+            report();
+            return true;
         }
 
         bool remove(const std::string& key)
         {
-            _lru.erase(key);
+            Threading::ScopedMutexLock lock(_mutex);
+            EntryMap::iterator i = _entries.find(key);
+            if ( i != _entries.end() )
+            {
+                _bytes -= i->second._bytes;
+                _lru.erase( i->second._lru );
+                _entries.erase( i );
+                report();
+            }
             return true;
         }
 
         bool touch(const std::string& key)
         {
-            // just doing a get will put it at the front of the LRU list
-            MemCacheLRU::Record dummy;
-            return _lru.get(key, dummy);
+            Threading::ScopedMutexLock lock(_mutex);
+            EntryMap::iterator i = _entries.find(key);
+            if ( i == _entries.end() )
+                return false;
+            _lru.splice( _lru.end(), _lru, i->second._lru );
+            return true;
         }
 
         RecordStatus getRecordStatus( const std::string& key )
         {
             // ignore minTime; MemCache does not support expiration
-            return _lru.has(key) ? STATUS_OK : STATUS_NOT_FOUND;
+            Threading::ScopedMutexLock lock(_mutex);
+            return _entries.find(key) != _entries.end() ? STATUS_OK : STATUS_NOT_FOUND;
         }
 
         bool purge()
         {
+            Threading::ScopedMutexLock lock(_mutex);
+            _entries.clear();
             _lru.clear();
+            _bytes = 0u;
+            report();
             return true;
         }
 
@@ -115,7 +186,56 @@ namespace
             return key;
         }
 
-        MemCacheLRU _lru;
+        void dumpStats()
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            OE_INFO << LC << "Bin \"" << getID() << "\": "
+                << "entries = " << _entries.size() << "/" << _maxSize
+                << ", bytes = " << _bytes << "/"
+                << (_maxBytes > 0u ? std::string(Stringify() << _maxBytes) : std::string("unlimited"))
+                << ", hit ratio = " << (_queries > 0u ? (float)_hits/(float)_queries : 0.0f)
+                << ", evictions = " << _evictions
+                << std::endl;
+        }
+
+    private:
+        // publishes the byte total; assumes _mutex is locked
+        void report()
+        {
+            _bytesGauge->set( _bytes );
+            Memory::adjustUsage( Memory::MEMCACHE, (long long)_bytes - (long long)_reported );
+            _reported = _bytes;
+        }
+
+        // assumes _mutex is locked
+        void evict()
+        {
+            // Always keep the most recent entry; the write path already rejected
+            // anything larger than the whole budget.
+            while (_entries.size() > 1u &&
+                   (_entries.size() > _maxSize || (_maxBytes > 0u && _bytes > _maxBytes)))
+            {
+                EntryMap::iterator victim = _entries.find( _lru.front() );
+                _bytes -= victim->second._bytes;
+                _entries.erase( victim );
+                _lru.pop_front();
+                ++_evictions;
+                _evictCounter->add();
+            }
+        }
+
+        EntryMap               _entries;
+        std::list<std::string> _lru;
+        unsigned               _maxSize;
+        unsigned               _maxBytes;
+        unsigned               _bytes;
+        unsigned               _reported;
+        unsigned               _queries;
+        unsigned               _hits;
+        unsigned               _evictions;
+        osg::ref_ptr<StatsRegistry::Counter> _hitCounter, _missCounter, _evictCounter;
+        osg::ref_ptr<StatsRegistry::Gauge>   _bytesGauge;
+        Threading::Mutex       _mutex;
     };
     
 
@@ -124,8 +244,9 @@ namespace
 
 //------------------------------------------------------------------------
 
-MemCache::MemCache( unsigned maxBinSize ) :
+MemCache::MemCache( unsigned maxBinSize, unsigned maxBinBytes ) :
 _maxBinSize( std::max(maxBinSize, 1u) ),
+_maxBinBytes( maxBinBytes ),
 _reads(0),
 _writes(0),
 _hits(0)
@@ -136,7 +257,7 @@ _hits(0)
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize, _maxBinBytes) );
 }
 
 CacheBin*
@@ -157,7 +278,7 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            _defaultBin = new MemCacheBin("__default", _maxBinSize, _maxBinBytes);
         }
     }
 
@@ -169,6 +290,6 @@ void
 MemCache::dumpStats(const std::string& binID)
 {
     MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
-    CacheStats stats = bin->_lru.getStats();
-    OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
+    if ( bin )
+        bin->dumpStats();
 }
@@ -20,6 +20,16 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include <osgEarth/Memory>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/StatsRegistry>
+#include <osg/Observer>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Texture>
+#include <osg/NodeVisitor>
+#include <set>
 
 using namespace osgEarth;
 
@@ -173,3 +183,288 @@ Memory::getProcessPeakPrivateUsage()
     return (size_t)0L;
 #endif
 }
+
+//------------------------------------------------------------------------
+
+const char* Memory::TERRAIN_TILES_CPU = "terrain_tiles_cpu";
+const char* Memory::TERRAIN_TILES_GPU = "terrain_tiles_gpu";
+const char* Memory::MEMCACHE          = "memcache";
+const char* Memory::ELEVATION_POOL    = "elevation_pool";
+const char* Memory::FEATURE_TILES     = "feature_tiles";
+const char* Memory::RESOURCE_CACHE    = "resource_cache";
+const char* Memory::SHADER_PROGRAMS   = "shader_programs";
+
+namespace
+{
+    struct Subsystem
+    {
+        Memory::Usage                        _usage;
+        osg::ref_ptr<StatsRegistry::Gauge>   _bytesGauge;
+        osg::ref_ptr<StatsRegistry::Gauge>   _peakGauge;
+    };
+
+    typedef std::map<std::string, Subsystem> Subsystems;
+
+    // Function-local statics so that objects destroyed during static
+    // destruction can still report safely. Intentionally never deleted.
+    Threading::Mutex& subsystemsMutex()
+    {
+        static Threading::Mutex* s_mutex = new Threading::Mutex();
+        return *s_mutex;
+    }
+
+    Subsystems& subsystems()
+    {
+        static Subsystems* s_subsystems = new Subsystems();
+        return *s_subsystems;
+    }
+
+    // assumes subsystemsMutex() is locked
+    Subsystem& getSubsystem(const std::string& name)
+    {
+        Subsystems::iterator i = subsystems().find(name);
+        if (i == subsystems().end())
+        {
+            i = subsystems().insert(std::make_pair(name, Subsystem())).first;
+            std::string labels = "subsystem=" + StatsRegistry::labelValue(name);
+            StatsRegistry* stats = StatsRegistry::instance();
+            i->second._bytesGauge = stats->getGauge("osgearth_memory_bytes", labels, "Estimated memory held by each osgEarth subsystem");
+            i->second._peakGauge  = stats->getGauge("osgearth_memory_peak_bytes", labels, "High-water mark of osgearth_memory_bytes");
+        }
+        return i->second;
+    }
+
+    // assumes subsystemsMutex() is locked
+    void update(Subsystem& s, long long bytes)
+    {
+        s._usage._bytes = bytes > 0 ? bytes : 0;
+        if (s._usage._bytes > s._usage._peakBytes)
+        {
+            s._usage._peakBytes = s._usage._bytes;
+            s._peakGauge->set( (double)s._usage._peakBytes );
+        }
+        s._bytesGauge->set( (double)s._usage._bytes );
+    }
+
+    // Removes an object's charge when the object is deleted.
+    class ChargeObserver : public osg::Observer
+    {
+    public:
+        void charge(const std::string& subsystem, const osg::Referenced* object, unsigned bytes)
+        {
+            bool observe = false;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                Charges::iterator i = _charges.find(object);
+                if (i == _charges.end())
+                {
+                    Charge& c = _charges[object];
+                    c._subsystem = subsystem;
+                    c._bytes = bytes;
+                    observe = true;
+                }
+                else if (i->second._subsystem == subsystem)
+                {
+                    i->second._bytes += bytes;
+                }
+                else return; // already charged to another subsystem
+            }
+
+            if (observe)
+                object->addObserver(this);
+
+            Memory::adjustUsage(subsystem, bytes);
+        }
+
+        void objectDeleted(void* ptr)
+        {
+            Charge c;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                Charges::iterator i = _charges.find(static_cast<const osg::Referenced*>(ptr));
+                if (i == _charges.end())
+                    return;
+                c = i->second;
+                _charges.erase(i);
+            }
+            Memory::adjustUsage(c._subsystem, -(long long)c._bytes);
+        }
+
+    private:
+        struct Charge
+        {
+            std::string _subsystem;
+            unsigned    _bytes;
+        };
+        typedef std::map<const osg::Referenced*, Charge> Charges;
+        Charges          _charges;
+        Threading::Mutex _mutex;
+    };
+
+    ChargeObserver& chargeObserver()
+    {
+        // never deleted, since it must outlive every object it observes
+        static ChargeObserver* s_observer = new ChargeObserver();
+        return *s_observer;
+    }
+
+    /**
+     * Rough estimate of the memory held by a scene graph: vertex and
+     * primitive data plus texture images, each counted once.
+     */
+    struct EstimateMemoryVisitor : public osg::NodeVisitor
+    {
+        EstimateMemoryVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN), _bytes(0u) { }
+
+        void apply(osg::Node& node)
+        {
+            applyStateSet( node.getStateSet() );
+            _bytes += sizeof(osg::Node);
+            traverse(node);
+        }
+
+        void apply(osg::Geode& geode)
+        {
+            applyStateSet( geode.getStateSet() );
+            for(unsigned i=0; i<geode.getNumDrawables(); ++i)
+            {
+                osg::Drawable* d = geode.getDrawable(i);
+                applyStateSet( d->getStateSet() );
+                osg::Geometry* geom = d->asGeometry();
+                if ( geom )
+                {
+                    osg::Geometry::ArrayList arrays;
+                    geom->getArrayList( arrays );
+                    for(unsigned a=0; a<arrays.size(); ++a)
+                        if ( arrays[a].valid() )
+                            _bytes += arrays[a]->getTotalDataSize();
+
+                    for(unsigned p=0; p<geom->getNumPrimitiveSets(); ++p)
+                        _bytes += geom->getPrimitiveSet(p)->getTotalDataSize();
+                }
+            }
+            traverse(geode);
+        }
+
+        void applyStateSet(const osg::StateSet* ss)
+        {
+            if ( !ss )
+                return;
+
+            const osg::StateSet::TextureAttributeList& tal = ss->getTextureAttributeList();
+            for(unsigned u=0; u<tal.size(); ++u)
+            {
+                for(osg::StateSet::AttributeList::const_iterator i = tal[u].begin(); i != tal[u].end(); ++i)
+                {
+                    applyTexture( dynamic_cast<const osg::Texture*>( i->second.first.get() ) );
+                }
+            }
+        }
+
+        void applyTexture(const osg::Texture* tex)
+        {
+            if ( !tex )
+                return;
+
+            for(unsigned j=0; j<tex->getNumImages(); ++j)
+            {
+                const osg::Image* image = tex->getImage(j);
+                if ( image && _images.insert(image).second )
+                    _bytes += image->getTotalSizeInBytesIncludingMipmaps();
+            }
+        }
+
+        unsigned _bytes;
+        std::set<const osg::Image*> _images;
+    };
+}
+
+void
+Memory::adjustUsage(const std::string& subsystem, long long bytes)
+{
+    Threading::ScopedMutexLock lock(subsystemsMutex());
+    Subsystem& s = getSubsystem(subsystem);
+    update(s, s._usage._bytes + bytes);
+}
+
+void
+Memory::setUsage(const std::string& subsystem, long long bytes)
+{
+    Threading::ScopedMutexLock lock(subsystemsMutex());
+    update(getSubsystem(subsystem), bytes);
+}
+
+void
+Memory::charge(const std::string& subsystem, const osg::Referenced* object, unsigned bytes)
+{
+    if (object && bytes > 0u)
+    {
+        chargeObserver().charge(subsystem, object, bytes);
+    }
+}
+
+Memory::Usage
+Memory::getUsage(const std::string& subsystem)
+{
+    Threading::ScopedMutexLock lock(subsystemsMutex());
+    Subsystems::const_iterator i = subsystems().find(subsystem);
+    return i != subsystems().end() ? i->second._usage : Usage();
+}
+
+void
+Memory::getUsage(UsageTable& out)
+{
+    Threading::ScopedMutexLock lock(subsystemsMutex());
+    out.clear();
+    for (Subsystems::const_iterator i = subsystems().begin(); i != subsystems().end(); ++i)
+        out[i->first] = i->second._usage;
+}
+
+void
+Memory::resetPeakUsage()
+{
+    Threading::ScopedMutexLock lock(subsystemsMutex());
+    for (Subsystems::iterator i = subsystems().begin(); i != subsystems().end(); ++i)
+    {
+        i->second._usage._peakBytes = i->second._usage._bytes;
+        i->second._peakGauge->set( (double)i->second._usage._peakBytes );
+    }
+}
+
+unsigned
+Memory::estimateSize(const osg::Object* object)
+{
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if ( image )
+        return sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+
+    const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+    if ( hf )
+        return sizeof(osg::HeightField) + hf->getNumColumns()*hf->getNumRows()*sizeof(float);
+
+    const osg::Node* node = dynamic_cast<const osg::Node*>(object);
+    if ( node )
+    {
+        EstimateMemoryVisitor v;
+        const_cast<osg::Node*>(node)->accept( v );
+        return v._bytes;
+    }
+
+    const osg::StateSet* stateSet = dynamic_cast<const osg::StateSet*>(object);
+    if ( stateSet )
+    {
+        EstimateMemoryVisitor v;
+        v.applyStateSet( stateSet );
+        return sizeof(osg::StateSet) + v._bytes;
+    }
+
+    const osg::Texture* texture = dynamic_cast<const osg::Texture*>(object);
+    if ( texture )
+    {
+        EstimateMemoryVisitor v;
+        v.applyTexture( texture );
+        return sizeof(osg::Texture) + v._bytes;
+    }
+
+    return sizeof(osg::Object);
+}
@@ -19,8 +19,14 @@
 #include <osgEarth/Metrics>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Memory>
+#include <osgEarth/TileKey>
 #include <osgViewer/Viewer>
+#include <OpenThreads/Atomic>
 #include <cstdarg>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
 
 using namespace osgEarth;
 
@@ -29,6 +35,32 @@ namespace
 {
     static osg::ref_ptr< MetricsBackend > s_metrics_backend;
 
+    // Interned event names; ID 0 is the empty string.
+    struct NameTable
+    {
+        NameTable() { _names.push_back(std::string()); _ids[std::string()] = 0u; }
+        std::vector<std::string>        _names;
+        std::map<std::string, unsigned> _ids;
+        Threading::Mutex                _mutex;
+    };
+    static NameTable s_nameTable;
+
+    // Per-layer tile stage histograms (see TileStageStats).
+    struct StageTable
+    {
+        StageTable() : _enabled(false) { }
+        bool                   _enabled;
+        TileStageStats::Table  _table;
+        Threading::Mutex       _mutex;
+        std::string            _outputFile;
+    };
+    static StageTable s_stageTable;
+
+    bool endsWith(const std::string& s, const std::string& suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size()-suffix.size(), suffix.size(), suffix) == 0;
+    }
+
     class MetricsStartup
     {
     public:
@@ -37,19 +69,103 @@ namespace
             const char* metricsFile = ::getenv("OSGEARTH_METRICS_FILE");
             if (metricsFile)
             {
-                Metrics::setMetricsBackend(new ChromeMetricsBackend(std::string(metricsFile)));
+                // A ".bin" file or OSGEARTH_METRICS_BUFFERED selects the low-overhead backend.
+                std::string filename(metricsFile);
+                bool binary = endsWith(filename, ".bin");
+                if (binary || ::getenv("OSGEARTH_METRICS_BUFFERED"))
+                {
+                    BufferedMetricsBackend* backend = new BufferedMetricsBackend(
+                        filename,
+                        binary ? BufferedMetricsBackend::FORMAT_BINARY : BufferedMetricsBackend::FORMAT_CHROME);
+
+                    const char* sample = ::getenv("OSGEARTH_METRICS_SAMPLE");
+                    if (sample)
+                        backend->setSampleInterval(as<unsigned>(sample, 1u));
+
+                    Metrics::setMetricsBackend(backend);
+                }
+                else
+                {
+                    Metrics::setMetricsBackend(new ChromeMetricsBackend(filename));
+                }
+            }
+
+            const char* stageStats = ::getenv("OSGEARTH_TILE_STAGE_STATS");
+            if (stageStats)
+            {
+                TileStageStats::setEnabled(true);
+                if (std::string(stageStats) != "1")
+                    s_stageTable._outputFile = stageStats;
             }
         }
 
         ~MetricsStartup()
         {
             Metrics::setMetricsBackend(0);
+
+            if (TileStageStats::enabled() && !s_stageTable._table.empty())
+            {
+                if (s_stageTable._outputFile.empty())
+                {
+                    TileStageStats::write(std::cout);
+                }
+                else
+                {
+                    std::ofstream out(s_stageTable._outputFile.c_str());
+                    TileStageStats::write(out);
+                }
+            }
         }
     };
 
     static MetricsStartup s_metricsStartup;
 }
 
+void MetricsBackend::begin(unsigned id)
+{
+    begin(Metrics::getName(id));
+}
+
+void MetricsBackend::end(unsigned id)
+{
+    end(Metrics::getName(id));
+}
+
+unsigned Metrics::intern(const std::string& name)
+{
+    Threading::ScopedMutexLock lock(s_nameTable._mutex);
+    std::map<std::string, unsigned>::const_iterator i = s_nameTable._ids.find(name);
+    if (i != s_nameTable._ids.end())
+        return i->second;
+
+    unsigned id = s_nameTable._names.size();
+    s_nameTable._names.push_back(name);
+    s_nameTable._ids[name] = id;
+    return id;
+}
+
+std::string Metrics::getName(unsigned id)
+{
+    Threading::ScopedMutexLock lock(s_nameTable._mutex);
+    return id < s_nameTable._names.size() ? s_nameTable._names[id] : std::string();
+}
+
+void Metrics::begin(unsigned id)
+{
+    if (s_metrics_backend.valid())
+    {
+        s_metrics_backend->begin(id);
+    }
+}
+
+void Metrics::end(unsigned id)
+{
+    if (s_metrics_backend.valid())
+    {
+        s_metrics_backend->end(id);
+    }
+}
+
 void Metrics::begin(const std::string& name, const Config& args)
 {
     if (s_metrics_backend.valid())
@@ -245,6 +361,16 @@ int Metrics::run(osgViewer::Viewer& viewer)
                     Metrics::counter("Memory::WorkingSet", "WorkingSet", Memory::getProcessPhysicalUsage() / 1048576);
                     Metrics::counter("Memory::PrivateBytes", "PrivateBytes", Memory::getProcessPrivateUsage() / 1048576);
                     Metrics::counter("Memory::PeakPrivateBytes", "PeakPrivateBytes", Memory::getProcessPeakPrivateUsage() / 1048576);
+
+                    // per-subsystem accounting, current and high-water mark, in MB
+                    Memory::UsageTable usage;
+                    Memory::getUsage(usage);
+                    for (Memory::UsageTable::const_iterator u = usage.begin(); u != usage.end(); ++u)
+                    {
+                        Metrics::counter("Memory::" + u->first,
+                            u->first, (double)u->second._bytes / 1048576.0,
+                            u->first + "_peak", (double)u->second._peakBytes / 1048576.0);
+                    }
                 }
             }
 
@@ -441,6 +567,369 @@ void ChromeMetricsBackend::counter(const std::string& graph,
 }
 
 
+//...................................................................
+
+namespace
+{
+    const unsigned BINARY_VERSION = 1u;
+
+    // C++03 has no thread_local; the compiler extensions only hold PODs,
+    // which is all we need to find the calling thread's buffer.
+#if defined(_MSC_VER)
+#  define OE_METRICS_TLS __declspec(thread)
+#else
+#  define OE_METRICS_TLS __thread
+#endif
+
+    // The calling thread's buffer, and the serial number of the backend that owns
+    // it (backends can be replaced, so a cached pointer is only good for its owner).
+    OE_METRICS_TLS void*    t_metricsBuffer = 0L;
+    OE_METRICS_TLS unsigned t_metricsSerial = 0u;
+
+    OpenThreads::Atomic s_metricsSerial;
+}
+
+struct BufferedMetricsBackend::Impl
+{
+    struct Record
+    {
+        double   _time;
+        double   _values[3];
+        unsigned _id;
+        unsigned _names[3];
+        char     _phase;
+    };
+
+    // Single-producer, single-consumer ring: only the owning thread advances
+    // _head and only the writer advances _tail.
+    struct ThreadBuffer
+    {
+        ThreadBuffer(unsigned thread, unsigned capacity) :
+            _thread(thread), _records(capacity), _mask(capacity-1u),
+            _depth(0u), _count(0u), _skipping(false) { }
+
+        // Interns a name through this thread's own cache, so only the first
+        // use of a name on each thread touches the global name table.
+        unsigned intern(const std::string& name)
+        {
+            std::map<std::string, unsigned>::const_iterator i = _ids.find(name);
+            if (i != _ids.end())
+                return i->second;
+            unsigned id = Metrics::intern(name);
+            _ids[name] = id;
+            return id;
+        }
+
+        unsigned            _thread;
+        std::vector<Record> _records;
+        unsigned            _mask;
+        OpenThreads::Atomic _head;
+        OpenThreads::Atomic _tail;
+
+        // owning thread only
+        unsigned _depth;
+        unsigned _count;
+        bool     _skipping;
+        std::map<std::string, unsigned> _ids;
+    };
+
+    struct Writer : public OpenThreads::Thread
+    {
+        Writer(Impl* impl) : _impl(impl) { }
+        void run()
+        {
+            while (!_impl->_done)
+            {
+                _impl->_wake.wait(100);
+                _impl->_wake.reset();
+                _impl->drain();
+            }
+        }
+        Impl* _impl;
+    };
+
+    Impl(const std::string& filename, Format format, unsigned capacity) :
+        _format(format), _capacity(1u), _firstEvent(true), _namesWritten(1u), _done(false)
+    {
+        _serial = ++s_metricsSerial;
+
+        while (_capacity < capacity)
+            _capacity <<= 1;
+
+        _startTime = osg::Timer::instance()->tick();
+
+        if (_format == FORMAT_BINARY)
+        {
+            _file.open(filename.c_str(), std::ios::out | std::ios::binary);
+            _file.write("OEMB", 4);
+            writeRaw(BINARY_VERSION);
+        }
+        else
+        {
+            _file.open(filename.c_str(), std::ios::out);
+            _file << "[";
+        }
+
+        _writer = new Writer(this);
+        _writer->start();
+    }
+
+    ~Impl()
+    {
+        _done = true;
+        _wake.set();
+        _writer->join();
+        delete _writer;
+
+        drain();
+        if (_format == FORMAT_CHROME)
+            _file << "]";
+        _file.close();
+
+        for (unsigned i = 0; i < _buffers.size(); ++i)
+            delete _buffers[i];
+    }
+
+    // The calling thread's buffer, from thread-local storage. A thread's first
+    // event creates its buffer and registers it with the writer; that is the
+    // only time this locks.
+    ThreadBuffer* getThreadBuffer()
+    {
+        if (t_metricsSerial == _serial)
+            return static_cast<ThreadBuffer*>(t_metricsBuffer);
+
+        ThreadBuffer* buffer = new ThreadBuffer(Threading::getCurrentThreadId(), _capacity);
+        {
+            Threading::ScopedMutexLock lock(_buffersMutex);
+            _buffers.push_back(buffer);
+        }
+        t_metricsBuffer = buffer;
+        t_metricsSerial = _serial;
+        return buffer;
+    }
+
+    void push(ThreadBuffer* buffer, Record& record)
+    {
+        unsigned head = buffer->_head;
+        if (head - (unsigned)buffer->_tail > buffer->_mask)
+        {
+            ++_dropped;
+            return;
+        }
+        record._time = osg::Timer::instance()->delta_u(_startTime, osg::Timer::instance()->tick());
+        buffer->_records[head & buffer->_mask] = record;
+        ++buffer->_head;
+    }
+
+    template<typename T> void writeRaw(const T& value)
+    {
+        _file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    const std::string& getName(unsigned id)
+    {
+        while (_names.size() <= id)
+            _names.push_back(Metrics::getName(_names.size()));
+        return _names[id];
+    }
+
+    // Binary files define each name before the first record that uses it.
+    void defineNames(unsigned id)
+    {
+        for (; _namesWritten <= id; ++_namesWritten)
+        {
+            const std::string& name = getName(_namesWritten);
+            _file.put('S');
+            writeRaw(_namesWritten);
+            writeRaw((unsigned)name.size());
+            _file.write(name.c_str(), name.size());
+        }
+    }
+
+    void write(const Record& r, unsigned thread)
+    {
+        if (_format == FORMAT_BINARY)
+        {
+            defineNames(r._id);
+            _file.put(r._phase);
+            writeRaw(r._id);
+            if (r._phase == 'C')
+            {
+                for (unsigned i = 0; i < 3; ++i) defineNames(r._names[i]);
+                for (unsigned i = 0; i < 3; ++i) writeRaw(r._names[i]);
+                for (unsigned i = 0; i < 3; ++i) writeRaw(r._values[i]);
+            }
+            writeRaw(thread);
+            writeRaw(r._time);
+            return;
+        }
+
+        if (_firstEvent)
+            _firstEvent = false;
+        else
+            _file << "," << std::endl;
+
+        _file << "{"
+            << "\"cat\": \"" << "" << "\","
+            << "\"pid\": \"" << 0 << "\","
+            << "\"tid\": \"" << thread << "\","
+            << "\"ts\": \""  << std::setprecision(9) << r._time << "\","
+            << "\"ph\": \"" << r._phase << "\","
+            << "\"name\": \""  << getName(r._id) << "\"";
+
+        if (r._phase == 'C')
+        {
+            _file << ",\"args\" : {";
+            bool first = true;
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                if (r._names[i] == 0u)
+                    continue;
+                if (!first)
+                    _file << ",";
+                first = false;
+                _file << "    \"" << getName(r._names[i]) << "\": " << std::setprecision(9) << r._values[i];
+            }
+            _file << "}";
+        }
+
+        _file << "}";
+    }
+
+    void drain()
+    {
+        Threading::ScopedMutexLock lock(_fileMutex);
+
+        std::vector<ThreadBuffer*> buffers;
+        {
+            Threading::ScopedMutexLock buffersLock(_buffersMutex);
+            buffers = _buffers;
+        }
+
+        for (unsigned i = 0; i < buffers.size(); ++i)
+        {
+            ThreadBuffer* buffer = buffers[i];
+
+            unsigned tail = buffer->_tail;
+            unsigned head = buffer->_head;
+            for (; tail != head; ++tail)
+            {
+                write(buffer->_records[tail & buffer->_mask], buffer->_thread);
+            }
+            buffer->_tail.exchange(tail);
+        }
+        _file.flush();
+    }
+
+    Format                     _format;
+    unsigned                   _capacity;
+    unsigned                   _serial;
+    std::vector<ThreadBuffer*> _buffers;      // every thread's buffer, in order of creation
+    Threading::Mutex           _buffersMutex;
+    OpenThreads::Atomic        _dropped;
+    osg::Timer_t             _startTime;
+
+    // writer state
+    Threading::Mutex         _fileMutex;
+    std::ofstream            _file;
+    bool                     _firstEvent;
+    std::vector<std::string> _names;
+    unsigned                 _namesWritten;
+    Writer*                  _writer;
+    Threading::Event         _wake;
+    volatile bool            _done;
+};
+
+BufferedMetricsBackend::BufferedMetricsBackend(const std::string& filename, Format format, unsigned eventsPerThread) :
+_sampleInterval(1u)
+{
+    _impl = new Impl(filename, format, osg::maximum(eventsPerThread, 2u));
+}
+
+BufferedMetricsBackend::~BufferedMetricsBackend()
+{
+    delete _impl;
+}
+
+void BufferedMetricsBackend::setSampleInterval(unsigned n)
+{
+    _sampleInterval = osg::maximum(n, 1u);
+}
+
+unsigned BufferedMetricsBackend::getNumDropped() const
+{
+    return _impl->_dropped;
+}
+
+void BufferedMetricsBackend::flush()
+{
+    _impl->drain();
+}
+
+void BufferedMetricsBackend::begin(const std::string& name, const Config& args)
+{
+    begin(_impl->getThreadBuffer()->intern(name));
+}
+
+void BufferedMetricsBackend::end(const std::string& name, const Config& args)
+{
+    end(_impl->getThreadBuffer()->intern(name));
+}
+
+void BufferedMetricsBackend::begin(unsigned id)
+{
+    Impl::ThreadBuffer* buffer = _impl->getThreadBuffer();
+
+    // sampling decisions are made at the outermost event on each thread,
+    // so begin/end pairs always stay matched.
+    if (buffer->_depth++ == 0u)
+        buffer->_skipping = _sampleInterval > 1u && (buffer->_count++ % _sampleInterval) != 0u;
+
+    if (!buffer->_skipping)
+    {
+        Impl::Record record;
+        record._id = id;
+        record._phase = 'B';
+        _impl->push(buffer, record);
+    }
+}
+
+void BufferedMetricsBackend::end(unsigned id)
+{
+    Impl::ThreadBuffer* buffer = _impl->getThreadBuffer();
+    if (buffer->_depth == 0u)
+        return;
+
+    --buffer->_depth;
+
+    if (!buffer->_skipping)
+    {
+        Impl::Record record;
+        record._id = id;
+        record._phase = 'E';
+        _impl->push(buffer, record);
+    }
+}
+
+void BufferedMetricsBackend::counter(const std::string& graph,
+                                     const std::string& name0, double value0,
+                                     const std::string& name1, double value1,
+                                     const std::string& name2, double value2)
+{
+    Impl::ThreadBuffer* buffer = _impl->getThreadBuffer();
+
+    Impl::Record record;
+    record._id = buffer->intern(graph);
+    record._phase = 'C';
+    record._names[0] = name0.empty() ? 0u : buffer->intern(name0);
+    record._names[1] = name1.empty() ? 0u : buffer->intern(name1);
+    record._names[2] = name2.empty() ? 0u : buffer->intern(name2);
+    record._values[0] = value0;
+    record._values[1] = value1;
+    record._values[2] = value2;
+    _impl->push(buffer, record);
+}
+
 
 ScopedMetric::ScopedMetric(const std::string& name) :
 _name(name)
@@ -482,3 +971,127 @@ ScopedMetric::~ScopedMetric()
     Metrics::end(_name);
 }
 
+
+//.........................................................................
+
+double
+TileStageStats::Histogram::percentileMS(double p) const
+{
+    if (_count == 0u)
+        return 0.0;
+
+    unsigned target = (unsigned)ceil(p * (double)_count);
+    unsigned sum = 0u;
+    for (unsigned i = 0; i < NUM_BUCKETS-1; ++i)
+    {
+        sum += _buckets[i];
+        if (sum >= target)
+            return std::min(ldexp(1.0, (int)i-3), _maxMS);
+    }
+    return _maxMS;
+}
+
+void
+TileStageStats::setEnabled(bool value)
+{
+    s_stageTable._enabled = value;
+}
+
+bool
+TileStageStats::enabled()
+{
+    return s_stageTable._enabled;
+}
+
+void
+TileStageStats::record(const std::string& layer, const std::string& stage, double ms)
+{
+    // bucket i holds durations under 2^(i-3) ms.
+    unsigned bucket = 0u;
+    while (bucket < NUM_BUCKETS-1 && ms >= ldexp(1.0, (int)bucket-3))
+        ++bucket;
+
+    Threading::ScopedMutexLock lock(s_stageTable._mutex);
+    Histogram& h = s_stageTable._table[std::make_pair(layer, stage)];
+    h._count++;
+    h._totalMS += ms;
+    h._maxMS = std::max(h._maxMS, ms);
+    h._buckets[bucket]++;
+}
+
+void
+TileStageStats::getTable(Table& out)
+{
+    Threading::ScopedMutexLock lock(s_stageTable._mutex);
+    out = s_stageTable._table;
+}
+
+void
+TileStageStats::reset()
+{
+    Threading::ScopedMutexLock lock(s_stageTable._mutex);
+    s_stageTable._table.clear();
+}
+
+void
+TileStageStats::write(std::ostream& out)
+{
+    Table table;
+    getTable(table);
+
+    out << "layer,stage,count,total_ms,mean_ms,max_ms,p50_ms,p95_ms";
+    for (unsigned i = 0; i < NUM_BUCKETS; ++i)
+        out << ",lt_" << ldexp(1.0, (int)i-3) << "ms";
+    out << std::endl;
+
+    for (Table::const_iterator i = table.begin(); i != table.end(); ++i)
+    {
+        const Histogram& h = i->second;
+        out << i->first.first << "," << i->first.second << ","
+            << h._count << ","
+            << h._totalMS << ","
+            << (h._count > 0u ? h._totalMS / (double)h._count : 0.0) << ","
+            << h._maxMS << ","
+            << h.percentileMS(0.50) << ","
+            << h.percentileMS(0.95);
+        for (unsigned b = 0; b < NUM_BUCKETS; ++b)
+            out << "," << h._buckets[b];
+        out << std::endl;
+    }
+}
+
+//.........................................................................
+
+ScopedTileStage::ScopedTileStage(const char* stage, const std::string& layer, const TileKey& key) :
+_stage  ( stage ),
+_start  ( 0 ),
+_metrics( Metrics::enabled() ),
+_stats  ( TileStageStats::enabled() )
+{
+    if (_metrics || _stats)
+    {
+        _layer = layer;
+        _start = osg::Timer::instance()->tick();
+    }
+
+    if (_metrics)
+    {
+        Config args;
+        args.add("layer", layer);
+        args.add("key", key.str());
+        Metrics::begin(_stage, args);
+    }
+}
+
+ScopedTileStage::~ScopedTileStage()
+{
+    if (_metrics)
+    {
+        Metrics::end(_stage);
+    }
+
+    if (_stats)
+    {
+        TileStageStats::record(_layer, _stage, osg::Timer::instance()->delta_m(_start, osg::Timer::instance()->tick()));
+    }
+}
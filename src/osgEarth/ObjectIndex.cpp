@@ -37,6 +37,21 @@ using namespace osgEarth;
 // Object IDs under this reserved
 #define STARTING_OBJECT_ID 10
 
+// An ObjectID packs a slot index (low bits) and that slot's generation
+// count (high bits). IDs must survive the trip through an RGBA8 pick
+// buffer, so the whole thing fits in 32 bits.
+#define SLOT_BITS       24
+#define SLOT_MASK       ((1u << SLOT_BITS) - 1u)
+#define GENERATION_MASK 0xffu
+
+namespace
+{
+    inline ObjectID makeObjectID(unsigned slot, unsigned generation)
+    {
+        return (ObjectID)((generation << SLOT_BITS) | slot);
+    }
+}
+
 namespace
 {
     const char* indexVertexInit =
@@ -62,8 +77,11 @@ namespace
 }
 
 ObjectIndex::ObjectIndex() :
-_idGen( STARTING_OBJECT_ID )
+_size( 0u )
 {
+    // reserved IDs never map to a slot.
+    _slots.resize( STARTING_OBJECT_ID );
+
     _attribName     = "oe_index_objectid_attr";
     _attribLocation = osg::Drawable::SECONDARY_COLORS;
     _oidUniformName = "oe_index_objectid_uniform";
@@ -86,7 +104,7 @@ ObjectIndex::loadShaders(VirtualProgram* vp) const
 void
 ObjectIndex::setObjectIDAtrribLocation(int value)
 {
-    if ( _index.size() == 0 )
+    if ( size() == 0 )
     {
         _attribLocation = value;
     } 
@@ -96,10 +114,17 @@ ObjectIndex::setObjectIDAtrribLocation(int value)
     }
 }
 
+unsigned
+ObjectIndex::size() const
+{
+    Threading::ScopedReadLock shared( _mutex );
+    return _size;
+}
+
 ObjectID
 ObjectIndex::insert(osg::Referenced* object)
 {
-    Threading::ScopedMutexLock excl( _mutex );
+    Threading::ScopedWriteLock excl( _mutex );
     return insertImpl( object );
 }
 
@@ -107,9 +132,31 @@ ObjectID
 ObjectIndex::insertImpl(osg::Referenced* object)
 {
     // internal: assume mutex is locked
-    ObjectID id = ++_idGen;
-    _index[id] = object;
-    OE_DEBUG << LC << "Insert " << id << "; size = " << _index.size() << "\n";
+    unsigned slot;
+
+    // recycle the least recently freed slot, so a stale ID takes as long
+    // as possible to come back around to the same generation.
+    if ( !_freeSlots.empty() )
+    {
+        slot = _freeSlots.front();
+        _freeSlots.pop_front();
+    }
+    else if ( _slots.size() <= SLOT_MASK )
+    {
+        slot = _slots.size();
+        _slots.push_back( Slot() );
+    }
+    else
+    {
+        OE_WARN << LC << "Index is full; object will not be indexed\n";
+        return OSGEARTH_OBJECTID_EMPTY;
+    }
+
+    _slots[slot]._object = object;
+    ++_size;
+
+    ObjectID id = makeObjectID( slot, _slots[slot]._generation );
+    OE_DEBUG << LC << "Insert " << id << "; size = " << _size << "\n";
     return id;
 }
 
@@ -117,14 +164,18 @@ osg::Referenced*
 ObjectIndex::getImpl(ObjectID id) const
 {
     // assume the mutex is locked
-    IndexMap::const_iterator i = _index.find(id);
-    return i != _index.end() ? i->second.get() : 0L;
+    unsigned slot = id & SLOT_MASK;
+    if ( slot < STARTING_OBJECT_ID || slot >= _slots.size() )
+        return 0L;
+
+    const Slot& s = _slots[slot];
+    return makeObjectID(slot, s._generation) == id ? s._object.get() : 0L;
 }
 
 void
 ObjectIndex::remove(ObjectID id)
 {
-    Threading::ScopedMutexLock excl(_mutex);
+    Threading::ScopedWriteLock excl(_mutex);
     removeImpl(id);
 }
 
@@ -132,20 +183,48 @@ void
 ObjectIndex::removeImpl(ObjectID id)
 {
     // internal - assume mutex is locked
-    _index.erase( id );
-    OE_DEBUG << "Remove " << id << "; size = " << _index.size() << "\n";
+    unsigned slot = id & SLOT_MASK;
+    if ( slot < STARTING_OBJECT_ID || slot >= _slots.size() )
+        return;
+
+    Slot& s = _slots[slot];
+    if ( !s._object.valid() || makeObjectID(slot, s._generation) != id )
+        return;
+
+    s._object = 0L;
+    s._generation = (s._generation + 1u) & GENERATION_MASK;
+    _freeSlots.push_back( slot );
+    --_size;
 
+    OE_DEBUG << "Remove " << id << "; size = " << _size << "\n";
 }
 
 ObjectID
 ObjectIndex::tagDrawable(osg::Drawable* drawable, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
-    ObjectID oid = insertImpl(object);
+    ObjectID oid = insert(object);
     tagDrawable(drawable, oid);
     return oid;
 }
 
+void
+ObjectIndex::tagDrawables(const std::vector<osg::Drawable*>&   drawables,
+                          const std::vector<osg::Referenced*>& objects,
+                          std::vector<ObjectID>&               output)
+{
+    unsigned count = std::min(drawables.size(), objects.size());
+    unsigned first = output.size();
+    output.resize(first + count);
+
+    // insert everything under one lock, then tag outside of it.
+    insert(objects.begin(), objects.begin() + count, output.begin() + first);
+
+    for(unsigned i=0; i<count; ++i)
+    {
+        tagDrawable(drawables[i], output[first+i]);
+    }
+}
+
 void
 ObjectIndex::tagDrawable(osg::Drawable* drawable, ObjectID id) const
 {
@@ -198,8 +277,7 @@ namespace
 ObjectID
 ObjectIndex::tagAllDrawables(osg::Node* node, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
-    ObjectID oid = insertImpl(object);
+    ObjectID oid = insert(object);
     tagAllDrawables(node, oid);
     return oid;
 }
@@ -217,8 +295,7 @@ ObjectIndex::tagAllDrawables(osg::Node* node, ObjectID id) const
 ObjectID
 ObjectIndex::tagNode(osg::Node* node, osg::Referenced* object)
 {
-    Threading::ScopedMutexLock lock(_mutex);
-    ObjectID oid = insertImpl(object);
+    ObjectID oid = insert(object);
     tagNode(node, oid);
     return oid;
 }
@@ -17,11 +17,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarth/PatchLayer>
+#include <cfloat>
 
 using namespace osgEarth;
 
 PatchLayer::PatchLayer() :
-VisibleLayer()
+VisibleLayer(),
+_maxRange(FLT_MAX)
 {
     setRenderType(RENDERTYPE_PATCH);
 }
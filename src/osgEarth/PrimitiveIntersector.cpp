@@ -308,6 +308,26 @@ struct PrimitiveIntersectorFunctor
 
 };
 
+// True if every primitive set in the drawable is made of triangles; a KdTree
+// only indexes triangles, so anything else has to take the thick-ray path.
+bool hasOnlyTriangles(osg::Drawable* drawable)
+{
+    osg::Geometry* geometry = drawable->asGeometry();
+    if (!geometry || geometry->getNumPrimitiveSets() == 0)
+        return false;
+
+    for(unsigned i=0; i<geometry->getNumPrimitiveSets(); ++i)
+    {
+        GLenum mode = geometry->getPrimitiveSet(i)->getMode();
+        if (mode != GL_TRIANGLES && mode != GL_TRIANGLE_STRIP && mode != GL_TRIANGLE_FAN &&
+            mode != GL_QUADS && mode != GL_QUAD_STRIP && mode != GL_POLYGON)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 } //namespace
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -457,6 +477,15 @@ void PrimitiveIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Draw
 
     if (iv.getDoDummyTraversal()) return;
 
+    // Triangle meshes that carry a KdTree (built by the database pager when a
+    // feature layer sets "pick_index") are tested along the center of the
+    // pick ray through the tree instead of triangle by triangle.
+    osg::KdTree* kdTree = iv.getUseKdTreeWhenAvailable() ? dynamic_cast<osg::KdTree*>(drawable->getShape()) : 0L;
+    if (kdTree && hasOnlyTriangles(drawable))
+    {
+        intersectWithKdTree(iv, drawable, s, e, kdTree);
+        return;
+    }
 
     osg::TemplatePrimitiveFunctor<PrimitiveIntersectorFunctor> ti;
 
@@ -527,6 +556,57 @@ void PrimitiveIntersector::intersect(osgUtil::IntersectionVisitor& iv, osg::Draw
     }
 }
 
+void PrimitiveIntersector::intersectWithKdTree(osgUtil::IntersectionVisitor& iv, osg::Drawable* drawable, const osg::Vec3d& s, const osg::Vec3d& e, osg::KdTree* kdTree)
+{
+    osg::KdTree::LineSegmentIntersections intersections;
+    intersections.reserve(4);
+    if (!kdTree->intersect(s, e, intersections))
+        return;
+
+    for(osg::KdTree::LineSegmentIntersections::iterator itr = intersections.begin(); itr != intersections.end(); ++itr)
+    {
+        osg::KdTree::LineSegmentIntersection& lsi = *itr;
+
+        // remap ratio into _start, _end range
+        double remap_ratio = ((s-_start).length() + lsi.ratio * (e-s).length() )/(_end-_start).length();
+
+        // the tree doesn't return hits in order, so keep looking for a nearer one
+        if ( _intersectionLimit == LIMIT_NEAREST && !getIntersections().empty() )
+        {
+            if (remap_ratio >= getIntersections().begin()->ratio )
+                continue;
+            else
+                getIntersections().clear();
+        }
+
+        Intersection hit;
+        hit.ratio = remap_ratio;
+        hit.matrix = iv.getModelMatrix();
+        hit.nodePath = iv.getNodePath();
+        hit.drawable = drawable;
+        hit.primitiveIndex = findPrimitiveIndex(drawable, lsi.primitiveIndex);
+
+        hit.localIntersectionPoint = _start*(1.0-remap_ratio) + _end*remap_ratio;
+
+        hit.localIntersectionNormal = lsi.intersectionNormal;
+
+        // vertex indices let IntersectionPicker look up the ObjectIDs
+        hit.indexList.reserve(3);
+        hit.ratioList.reserve(3);
+        hit.indexList.push_back(lsi.p0);
+        hit.ratioList.push_back(lsi.r0);
+        hit.indexList.push_back(lsi.p1);
+        hit.ratioList.push_back(lsi.r1);
+        hit.indexList.push_back(lsi.p2);
+        hit.ratioList.push_back(lsi.r2);
+
+        insertIntersection(hit);
+
+        if (_intersectionLimit == LIMIT_ONE_PER_DRAWABLE || _intersectionLimit == LIMIT_ONE)
+            break;
+    }
+}
+
 void PrimitiveIntersector::reset()
 {
     Intersector::reset();
@@ -707,6 +707,9 @@ Profile::addIntersectingTiles(const GeoExtent& key_ext, unsigned localLOD, std::
 
     OE_DEBUG << std::fixed << "  Dest Tiles: " << tileMinX << "," << tileMinY << " => " << tileMaxX << "," << tileMaxY << std::endl;
 
+    out_intersectingKeys.reserve(
+        out_intersectingKeys.size() + (tileMaxX-tileMinX+1)*(tileMaxY-tileMinY+1) );
+
     for (int i = tileMinX; i <= tileMaxX; ++i)
     {
         for (int j = tileMinY; j <= tileMaxY; ++j)
@@ -803,14 +806,14 @@ Profile::getEquivalentLOD( const Profile* rhsProfile, unsigned rhsLOD ) const
 
     double delta = DBL_MAX;
 
+    // tile height at currLOD, halved as we go rather than recomputed from LOD 0
+    double h = (_extent.yMax() - _extent.yMin()) / (double)_numTilesHighAtLod0;
+
     // Find the LOD that most closely matches the resolution of the incoming key.
     // We use the closest (under or over) so that you can match back and forth between profiles and be sure to get the same results each time.
     while( true )
     {
         double prevDelta = delta;
-        
-        double w, h;
-        getTileDimensions(currLOD, w, h);
 
         delta = osg::absolute( h - rhsTargetHeight );
         if (delta < prevDelta)
@@ -824,6 +827,7 @@ Profile::getEquivalentLOD( const Profile* rhsProfile, unsigned rhsLOD ) const
             break;
         }        
         currLOD++;
+        h *= 0.5;
     }
     return destLOD;
 }
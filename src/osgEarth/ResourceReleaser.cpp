@@ -25,7 +25,10 @@ using namespace osgEarth;
 #define LC "[ResourceReleaser] "
 
 
-ResourceReleaser::ResourceReleaser()
+ResourceReleaser::ResourceReleaser() :
+_next       ( 0u ),
+_budget     ( 0.0 ),
+_maxPerFrame( 0u )
 {
     // ensure this node always gets traversed:
     this->setCullingActive(false);
@@ -56,19 +59,42 @@ ResourceReleaser::push(const ObjectList& nodes)
 void
 ResourceReleaser::drawImplementation(osg::RenderInfo& ri) const
 {
-    if (!_toRelease.empty())
+    // Start on the next batch once the current one is done.
+    if (_next >= _releasing.size() && !_toRelease.empty())
     {
         Threading::ScopedMutexLock lock(_mutex);
-        if (!_toRelease.empty())
+        _releasing.clear();
+        _releasing.swap(_toRelease);
+        _next = 0u;
+    }
+
+    if (_next < _releasing.size())
+    {
+        METRIC_SCOPED("ResourceReleaser");
+
+        const osg::Timer* timer = osg::Timer::instance();
+        osg::Timer_t start = timer->tick();
+        unsigned count = 0u;
+
+        // Always release at least one object so the queue keeps moving.
+        while (_next < _releasing.size() &&
+               (count == 0u ||
+                ((_maxPerFrame == 0u || count < _maxPerFrame) &&
+                 (_budget <= 0.0 || timer->delta_m(start, timer->tick()) < _budget))))
+        {
+            osg::Object* object = _releasing[_next].get();
+            object->releaseGLObjects(ri.getState());
+            _releasing[_next] = 0L;
+            ++_next;
+            ++count;
+        }
+
+        OE_DEBUG << LC << "Released " << count << " objects, " << (_releasing.size()-_next) << " left in batch\n";
+
+        if (_next >= _releasing.size())
         {
-            METRIC_SCOPED("ResourceReleaser");
-            for (ObjectList::const_iterator i = _toRelease.begin(); i != _toRelease.end(); ++i)
-            {
-                osg::Object* object = i->get();
-                object->releaseGLObjects(ri.getState());
-            }
-            OE_DEBUG << LC << "Released " << _toRelease.size() << " objects\n";
-            _toRelease.clear();
+            _releasing.clear();
+            _next = 0u;
         }
     }
 }
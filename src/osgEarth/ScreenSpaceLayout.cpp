@@ -38,6 +38,9 @@
 
 #define FADE_UNIFORM_NAME "oe_declutter_fade"
 
+// Size (in pixels) of a cell in the declutter occupancy grid
+#define OCCUPANCY_CELL_SIZE 64.0f
+
 using namespace osgEarth;
 
 //----------------------------------------------------------------------------
@@ -130,6 +133,111 @@ namespace
     
     typedef std::pair<const osg::Node*, osg::BoundingBox> RenderLeafBox;
 
+    // Screen-space occupancy grid for the declutter test. Each placed box is
+    // bucketed into the fixed-size cells it touches, so a candidate only has
+    // to test against the boxes in its own cells instead of every box placed
+    // so far. Boxes hanging off the viewport clamp to the border cells.
+    struct OccupancyGrid
+    {
+        OccupancyGrid() : _cols(0), _rows(0), _stamp(0u) { }
+
+        void reset(float width, float height)
+        {
+            unsigned cols = std::max(1, (int)ceil(width / OCCUPANCY_CELL_SIZE));
+            unsigned rows = std::max(1, (int)ceil(height / OCCUPANCY_CELL_SIZE));
+            if ( cols != _cols || rows != _rows )
+            {
+                _cols = cols;
+                _rows = rows;
+                _cells.assign( _cols*_rows, std::vector<unsigned>() );
+            }
+            else
+            {
+                // keep the cells' capacity from frame to frame.
+                for(unsigned i = 0; i < _cells.size(); ++i)
+                    _cells[i].clear();
+            }
+            _boxes.clear();
+            _tested.clear();
+        }
+
+        void getCellRange(const osg::BoundingBox& box, int& c0, int& r0, int& c1, int& r1) const
+        {
+            c0 = osg::clampBetween( (int)floor(box.xMin() / OCCUPANCY_CELL_SIZE), 0, (int)_cols-1 );
+            c1 = osg::clampBetween( (int)floor(box.xMax() / OCCUPANCY_CELL_SIZE), 0, (int)_cols-1 );
+            r0 = osg::clampBetween( (int)floor(box.yMin() / OCCUPANCY_CELL_SIZE), 0, (int)_rows-1 );
+            r1 = osg::clampBetween( (int)floor(box.yMax() / OCCUPANCY_CELL_SIZE), 0, (int)_rows-1 );
+        }
+
+        // true if the box doesn't overlap any placed box (other than one
+        // from the same drawable parent, which is acceptable).
+        bool isClear(const osg::BoundingBox& box, const osg::Node* parent)
+        {
+            // a box spanning several cells is only tested once per query.
+            if ( ++_stamp == 0u )
+            {
+                std::fill( _tested.begin(), _tested.end(), 0u );
+                _stamp = 1u;
+            }
+
+            int c0, r0, c1, r1;
+            getCellRange( box, c0, r0, c1, r1 );
+            for(int r = r0; r <= r1; ++r)
+            {
+                for(int c = c0; c <= c1; ++c)
+                {
+                    const std::vector<unsigned>& cell = _cells[r*_cols + c];
+                    for(std::vector<unsigned>::const_iterator i = cell.begin(); i != cell.end(); ++i)
+                    {
+                        if ( _tested[*i] == _stamp )
+                            continue;
+                        _tested[*i] = _stamp;
+
+                        // only need a 2D test since we're in clip space
+                        const RenderLeafBox& used = _boxes[*i];
+                        bool isClear =
+                            box.xMin() > used.second.xMax() ||
+                            box.xMax() < used.second.xMin() ||
+                            box.yMin() > used.second.yMax() ||
+                            box.yMax() < used.second.yMin();
+
+                        if ( !isClear && parent != used.first )
+                            return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        void insert(const osg::BoundingBox& box, const osg::Node* parent)
+        {
+            unsigned index = _boxes.size();
+            _boxes.push_back( std::make_pair(parent, box) );
+            _tested.push_back( 0u );
+
+            int c0, r0, c1, r1;
+            getCellRange( box, c0, r0, c1, r1 );
+            for(int r = r0; r <= r1; ++r)
+                for(int c = c0; c <= c1; ++c)
+                    _cells[r*_cols + c].push_back( index );
+        }
+
+        unsigned                             _cols, _rows;
+        std::vector< std::vector<unsigned> > _cells;
+        std::vector<RenderLeafBox>           _boxes;
+        std::vector<unsigned>                _tested;  // per-box query stamp
+        unsigned                             _stamp;
+    };
+
+    // The declutter decision for one leaf, remembered for the next frame.
+    struct PlacementRecord
+    {
+        const osg::Drawable* _drawable;
+        osg::BoundingBox     _box;
+        float                _priority;
+        bool                 _visible;
+    };
+
     // Data structure stored one-per-View.
     struct PerCamInfo
     {
@@ -141,7 +249,11 @@ namespace
         // re-usable structures (to avoid unnecessary re-allocation)
         osgUtil::RenderBin::RenderLeafList _passed;
         osgUtil::RenderBin::RenderLeafList _failed;
-        std::vector<RenderLeafBox>         _used;
+        OccupancyGrid                      _used;
+
+        // declutter decisions from this pass and the previous one
+        std::vector<PlacementRecord>       _placements;
+        std::vector<PlacementRecord>       _lastPlacements;
 
         // time stamp of the previous pass, for calculating animation speed
         osg::Timer_t _lastTimeStamp;
@@ -270,7 +382,7 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         // Reset the local re-usable containers
         local._passed.clear();          // drawables that pass occlusion test
         local._failed.clear();          // drawables that fail occlusion test
-        local._used.clear();            // list of occupied bounding boxes in screen space
+        local._placements.clear();
 
         // compute a window matrix so we can do window-space culling. If this is an RTT camera
         // with a reference camera attachment, we actually want to declutter in the window-space
@@ -282,6 +394,8 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
         osg::Vec3f  refCamScale(1.0f, 1.0f, 1.0f);
         osg::Matrix refCamScaleMat;
         osg::Matrix refWindowMatrix = windowMatrix;
+        float       gridWidth  = vp->width();
+        float       gridHeight = vp->height();
 
         if ( cam->isRenderToTextureCamera() )
         {
@@ -292,9 +406,20 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                 refCamScale.set( vp->width() / refVP->width(), vp->height() / refVP->height(), 1.0 );
                 refCamScaleMat.makeScale( refCamScale );
                 refWindowMatrix = refVP->computeWindowMatrix();
+                gridWidth  = refVP->width();
+                gridHeight = refVP->height();
             }
         }
 
+        // occupied bounding boxes in screen space
+        local._used.reset( gridWidth, gridHeight );
+
+        // Frame-to-frame coherence: a leaf's decision depends only on the leaves
+        // sorted ahead of it. So as long as this pass repeats the previous one
+        // leaf-for-leaf (same drawable, same declutter box, same priority), the
+        // previous decisions still hold and the occupancy tests can be skipped.
+        bool coherent = s_declutteringEnabledGlobally;
+
         // Track the parent nodes of drawables that are obscured (and culled). Drawables
         // with the same parent node (typically a Geode) are considered to be grouped and
         // will be culled as a group.
@@ -422,6 +547,16 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                 // A max priority => never occlude.
                 float priority = layoutData ? layoutData->_priority : 0.0f;
 
+                // still repeating the previous pass?
+                unsigned n = local._placements.size();
+                coherent =
+                    coherent &&
+                    n < local._lastPlacements.size() &&
+                    local._lastPlacements[n]._drawable == drawable &&
+                    local._lastPlacements[n]._priority == priority &&
+                    local._lastPlacements[n]._box._min == box._min &&
+                    local._lastPlacements[n]._box._max == box._max;
+
                 if ( priority == FLT_MAX )
                 {
                     visible = true;
@@ -433,36 +568,31 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
                     visible = false;
                 }
 
+                // same as last time; keep the placement.
+                else if ( coherent )
+                {
+                    visible = local._lastPlacements[n]._visible;
+                }
+
                 else
                 {
                     // weed out any drawables that are obscured by closer drawables.
-                    // TODO: think about a more efficient algorithm - right now we are just using
-                    // brute force to compare all bbox's
-                    for( std::vector<RenderLeafBox>::const_iterator j = local._used.begin(); j != local._used.end(); ++j )
-                    {
-                        // only need a 2D test since we're in clip space
-                        bool isClear =
-                            box.xMin() > j->second.xMax() ||
-                            box.xMax() < j->second.xMin() ||
-                            box.yMin() > j->second.yMax() ||
-                            box.yMax() < j->second.yMin();
-
-                        // if there's an overlap (and the conflict isn't from the same drawable
-                        // parent, which is acceptable), then the leaf is culled.
-                        if ( !isClear && drawableParent != j->first )
-                        {
-                            visible = false;
-                            break;
-                        }
-                    }
+                    visible = local._used.isClear( box, drawableParent );
                 }
+
+                PlacementRecord record;
+                record._drawable = drawable;
+                record._box      = box;
+                record._priority = priority;
+                record._visible  = visible;
+                local._placements.push_back( record );
             }
 
             if ( visible )
             {
-                // passed the test, so add the leaf's bbox to the "used" list, and add the leaf
+                // passed the test, so add the leaf's bbox to the "used" grid, and add the leaf
                 // to the final draw list.
-                local._used.push_back( std::make_pair(drawableParent, box) );
+                local._used.insert( box, drawableParent );
                 local._passed.push_back( leaf );
             }
 
@@ -496,6 +626,8 @@ struct /*internal*/ DeclutterSort : public osgUtil::RenderBin::SortCallback
             leaf->_modelview = new osg::RefMatrix( newModelView );
         }
 
+        local._lastPlacements.swap( local._placements );
+
         // copy the final draw list back into the bin, rejecting any leaves whose parents
         // are in the cull list.
 
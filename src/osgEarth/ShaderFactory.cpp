@@ -1018,24 +1018,14 @@ ShaderFactory::createColorFilterChainFragmentShader(const std::string&      func
         "#version " GLSL_VERSION_STR "\n"
         GLSL_DEFAULT_PRECISION_FLOAT "\n";
 
-    // write out the shader function prototypes:
-    for( ColorFilterChain::const_iterator i = chain.begin(); i != chain.end(); ++i )
-    {
-        ColorFilter* filter = i->get();
-        buf << "void " << filter->getEntryPointFunctionName() << "(inout vec4 color);\n";
-    }
+    std::stringstream body;
+    writeColorFilterChain( chain, 0u, buf, body, INDENT );
 
-    // write out the main function:
+    // write out the main function. if the chain is empty, it's a NOP.
     buf << "void " << function << "(inout vec4 color) \n"
-        << "{ \n";
+        << "{ \n"
+        << body.str();
 
-    // write out the function calls. if there are none, it's a NOP.
-    for( ColorFilterChain::const_iterator i = chain.begin(); i != chain.end(); ++i )
-    {
-        ColorFilter* filter = i->get();
-        buf << INDENT << filter->getEntryPointFunctionName() << "(color);\n";
-    }
-        
     buf << "} \n";
 
     std::string bufstr;
@@ -1043,6 +1033,31 @@ ShaderFactory::createColorFilterChainFragmentShader(const std::string&      func
     return new osg::Shader(osg::Shader::FRAGMENT, bufstr);
 }
 
+void
+ShaderFactory::writeColorFilterChain(const ColorFilterChain& chain,
+                                     unsigned                first,
+                                     std::ostream&           declarations,
+                                     std::ostream&           body,
+                                     const std::string&      indent) const
+{
+    for( unsigned i = first; i < chain.size(); ++i )
+    {
+        const ColorFilter* filter = chain[i].get();
+
+        std::string decl, statements;
+        if ( filter->getInlineCode(decl, statements) )
+        {
+            // scope each body so locals from different filters don't collide.
+            declarations << decl;
+            body << indent << "{\n" << statements << indent << "}\n";
+        }
+        else
+        {
+            declarations << "void " << filter->getEntryPointFunctionName() << "(inout vec4 color);\n";
+            body << indent << filter->getEntryPointFunctionName() << "(color);\n";
+        }
+    }
+}
 
 //osg::Uniform*
 //ShaderFactory::createUniformForGLMode(osg::StateAttribute::GLMode      mode,
@@ -61,6 +61,9 @@
 // profile, and if so, promote that VP to the Geode's state set.
 #define PROMOTE_EQUIVALENT_DRAWABLE_VP_TO_GEODE 1
 
+// Number of VP templates at which the generator starts over.
+#define MAX_VP_TEMPLATES 1024
+
 using namespace osgEarth;
 
 //------------------------------------------------------------------------
@@ -305,6 +308,57 @@ namespace
         }
     };
 
+    /**
+     * Process-wide cache of generated VirtualPrograms, keyed by the code they
+     * contain. Statesets with the same texture/mode signature generate the
+     * same code; each gets a copy of the cached VP, so they share shader
+     * objects (and therefore compiled programs, through the Registry's
+     * program repo) while callers can still modify their own VP. Thread-safe.
+     */
+    class VirtualProgramTemplateCache
+    {
+    public:
+        VirtualProgram* create(const std::string&           name,
+                               const std::string&           vertSource,
+                               ShaderComp::FunctionLocation vertLocation,
+                               const std::string&           fragSource,
+                               ShaderComp::FunctionLocation fragLocation)
+        {
+            std::string key = Stringify()
+                << name << '\n' << vertLocation << '\n' << vertSource << '\n' << fragLocation << '\n' << fragSource;
+
+            Threading::ScopedMutexLock lock(_mutex);
+
+            VPMap::iterator i = _vps.find(key);
+            if ( i != _vps.end() )
+                return new VirtualProgram( *i->second.get() );
+
+            // templates are cheap to rebuild, so just start over when full.
+            if ( _vps.size() >= MAX_VP_TEMPLATES )
+                _vps.clear();
+
+            VirtualProgram* vp = new VirtualProgram();
+            vp->setName( name );
+            vp->setInheritShaders( true );
+
+            if ( !vertSource.empty() )
+                vp->setFunction(VERTEX_FUNCTION, vertSource, vertLocation, 0.5f);
+
+            if ( !fragSource.empty() )
+                vp->setFunction(FRAGMENT_FUNCTION, fragSource, fragLocation, 0.5f);
+
+            _vps[key] = vp;
+            return new VirtualProgram( *vp );
+        }
+
+    private:
+        typedef std::map<std::string, osg::ref_ptr<VirtualProgram> > VPMap;
+        VPMap            _vps;
+        Threading::Mutex _mutex;
+    };
+
+    VirtualProgramTemplateCache s_vpTemplates;
+
     // if the node has a stateset, clone it and replace it with the clone.
     // otherwise, just create a new stateset on the node.
     osg::StateSet* cloneOrCreateStateSet(osg::Node* node)
@@ -362,7 +416,9 @@ ShaderGenerator::ShaderGenerator()
 ShaderGenerator::ShaderGenerator(const ShaderGenerator& rhs, const osg::CopyOp& copy) :
 osg::NodeVisitor         (),
 _active                  (rhs._active),
-_duplicateSharedSubgraphs(rhs._duplicateSharedSubgraphs)
+_name                    (rhs._name),
+_duplicateSharedSubgraphs(rhs._duplicateSharedSubgraphs),
+_acceptCallbacks         (rhs._acceptCallbacks)
 {
     _visitorType              = rhs._visitorType;
     _traversalMode            = rhs._traversalMode;
@@ -374,7 +430,9 @@ _duplicateSharedSubgraphs(rhs._duplicateSharedSubgraphs)
 ShaderGenerator::ShaderGenerator(const ShaderGenerator& rhs, const osg::CopyOp& copy) :
 osg::NodeVisitor         (rhs, copy),
 _active                  (rhs._active),
-_duplicateSharedSubgraphs(rhs._duplicateSharedSubgraphs)
+_name                    (rhs._name),
+_duplicateSharedSubgraphs(rhs._duplicateSharedSubgraphs),
+_acceptCallbacks         (rhs._acceptCallbacks)
 {
     _state = new StateEx();
 }
@@ -794,15 +852,6 @@ ShaderGenerator::processText(const osg::StateSet* ss, osg::ref_ptr<osg::StateSet
     // New state set. We never modify existing statesets.
     replacement = ss ? osg::clone(ss, osg::CopyOp::SHALLOW_COPY) : new osg::StateSet();
 
-    // new VP:
-    osg::ref_ptr<VirtualProgram> vp = VirtualProgram::cloneOrCreate(replacement.get());
-    
-    // give the VP a name if it needs one.
-    if ( vp->getName().empty() )
-    {
-        vp->setName( _name );
-    }
-
     std::string vertSrc =
         "#version " GLSL_VERSION_STR "\n" GLSL_PRECISION "\n"
         "out " MEDIUMP "vec4 " TEX_COORD_TEXT ";\n"
@@ -821,8 +870,28 @@ ShaderGenerator::processText(const osg::StateSet* ss, osg::ref_ptr<osg::StateSet
         INDENT "color.a *= texel.a; \n"
         "}\n";
 
-    vp->setFunction( VERTEX_FUNCTION,   vertSrc, ShaderComp::LOCATION_VERTEX_MODEL, 0.5f );
-    vp->setFunction( FRAGMENT_FUNCTION, fragSrc, ShaderComp::LOCATION_FRAGMENT_COLORING, 0.5f );
+    if ( VirtualProgram::get(replacement.get()) )
+    {
+        // add to a clone of the existing VP:
+        osg::ref_ptr<VirtualProgram> vp = VirtualProgram::cloneOrCreate(replacement.get());
+
+        // give the VP a name if it needs one.
+        if ( vp->getName().empty() )
+        {
+            vp->setName( _name );
+        }
+
+        vp->setFunction( VERTEX_FUNCTION,   vertSrc, ShaderComp::LOCATION_VERTEX_MODEL, 0.5f );
+        vp->setFunction( FRAGMENT_FUNCTION, fragSrc, ShaderComp::LOCATION_FRAGMENT_COLORING, 0.5f );
+    }
+    else
+    {
+        // all text shares the same shaders:
+        replacement->setAttributeAndModes(
+            s_vpTemplates.create(_name, vertSrc, ShaderComp::LOCATION_VERTEX_MODEL, fragSrc, ShaderComp::LOCATION_FRAGMENT_COLORING),
+            osg::StateAttribute::ON );
+    }
+
     replacement->getOrCreateUniform( SAMPLER_TEXT, osg::Uniform::SAMPLER_2D )->set( 0 );
 
     return replacement.valid();
@@ -853,20 +922,23 @@ ShaderGenerator::processGeometry(const osg::StateSet*         original,
         original ? osg::clone(original, osg::CopyOp::SHALLOW_COPY) :
         new osg::StateSet();
 
-    // likewise, create a VP that we might populate.
-    osg::ref_ptr<VirtualProgram> vp = VirtualProgram::cloneOrCreate(original, newStateSet);
+    // If the original has a VP, clone it so we can add to it. Otherwise we
+    // will copy the template VP for the generated code once we know what it is.
+    osg::ref_ptr<VirtualProgram> vp;
+    if ( VirtualProgram::get(original) )
+    {
+        vp = VirtualProgram::cloneOrCreate(original, newStateSet);
+
+        // give the VP a name if it needs one.
+        if ( vp->getName().empty() )
+        {
+            vp->setName( _name );
+        }
+    }
 
     // we'll set this to true if the new stateset goes into effect and
     // needs to be returned.
     bool needNewStateSet = false;
-    bool needVertexFunction = false;
-    bool needFragmentFunction = false;
-    
-    // give the VP a name if it needs one.
-    if ( vp->getName().empty() )
-    {
-        vp->setName( _name );
-    }
 
     // Check whether the lighting state has changed and install a mode uniform.
     // TODO: fix this
@@ -934,16 +1006,15 @@ ShaderGenerator::processGeometry(const osg::StateSet*         original,
         vertBodySource = buf._vertBody.str();
 
 
+        std::string vertSource;
         if ( !vertHeadSource.empty() || !vertBodySource.empty() )
         {
-            std::string vertSource = Stringify()
+            vertSource = Stringify()
                 << "#version " << version << "\n" GLSL_PRECISION "\n"
                 << vertHeadSource
                 << "void " VERTEX_FUNCTION "(inout vec4 vertex_view)\n{\n"
                 << vertBodySource
                 << "}\n";
-
-            vp->setFunction(VERTEX_FUNCTION, vertSource, ShaderComp::LOCATION_VERTEX_VIEW, 0.5f);
         }
 
 
@@ -953,16 +1024,30 @@ ShaderGenerator::processGeometry(const osg::StateSet*         original,
         std::string fragBodySource;
         fragBodySource = buf._fragBody.str();
 
+        std::string fragSource;
         if ( !fragHeadSource.empty() || !fragBodySource.empty() )
         {
-            std::string fragSource = Stringify()
+            fragSource = Stringify()
                 << "#version " << version << "\n" GLSL_PRECISION "\n"
                 << fragHeadSource
                 << "void " FRAGMENT_FUNCTION "(inout vec4 color)\n{\n"
                 << fragBodySource
                 << "}\n";
+        }
+
+        if ( vp.valid() )
+        {
+            if ( !vertSource.empty() )
+                vp->setFunction(VERTEX_FUNCTION, vertSource, ShaderComp::LOCATION_VERTEX_VIEW, 0.5f);
 
-            vp->setFunction(FRAGMENT_FUNCTION, fragSource, ShaderComp::LOCATION_FRAGMENT_COLORING, 0.5f);
+            if ( !fragSource.empty() )
+                vp->setFunction(FRAGMENT_FUNCTION, fragSource, ShaderComp::LOCATION_FRAGMENT_COLORING, 0.5f);
+        }
+        else
+        {
+            newStateSet->setAttributeAndModes(
+                s_vpTemplates.create(_name, vertSource, ShaderComp::LOCATION_VERTEX_VIEW, fragSource, ShaderComp::LOCATION_FRAGMENT_COLORING),
+                osg::StateAttribute::ON );
         }
     }
 
@@ -0,0 +1,234 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/ShaderWarmUp>
+#include <osgEarth/VirtualProgram>
+#include <osgEarth/StringUtils>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/State>
+#include <osg/Timer>
+#include <osg/Version>
+
+#define LC "[ShaderWarmUp] "
+
+using namespace osgEarth;
+
+namespace
+{
+    // Copies the parts of a state set that go into building a program:
+    // its VirtualProgram and its shader defines. Appends a description of
+    // them to "key". Returns NULL if there are none.
+    osg::StateSet* trim(const osg::StateSet* in, std::string& key)
+    {
+        if ( !in )
+            return 0L;
+
+        osg::ref_ptr<osg::StateSet> out;
+
+        const osg::StateSet::RefAttributePair* vp = in->getAttributePair(VirtualProgram::SA_TYPE);
+        if ( vp && vp->first.valid() )
+        {
+            out = new osg::StateSet();
+            out->setAttribute( vp->first.get(), vp->second );
+            key += Stringify() << "vp" << vp->first.get() << ":" << vp->second << ";";
+        }
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3,5,6)
+        const osg::StateSet::DefineList& defines = in->getDefineList();
+        for(osg::StateSet::DefineList::const_iterator i = defines.begin(); i != defines.end(); ++i)
+        {
+            if ( !out.valid() )
+                out = new osg::StateSet();
+            out->setDefine( i->first, i->second.first, i->second.second );
+            key += Stringify() << i->first << "=" << i->second.first << ":" << i->second.second << ";";
+        }
+#endif
+
+        return out.release();
+    }
+
+    // Collects the state along the path to each drawable.
+    struct CollectStatePaths : public osg::NodeVisitor
+    {
+        ShaderWarmUp*            _warmUp;
+        ShaderWarmUp::StatePath  _path;
+
+        CollectStatePaths(ShaderWarmUp* warmUp, const ShaderWarmUp::StatePath& prefix) :
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            _warmUp(warmUp),
+            _path(prefix)
+        {
+            setNodeMaskOverride(~0);
+        }
+
+        void apply(osg::Node& node)
+        {
+            if ( node.getStateSet() )
+                _path.push_back( node.getStateSet() );
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3,3,2)
+            if ( node.asDrawable() )
+                _warmUp->add( _path );
+            else
+#endif
+                traverse(node);
+
+            if ( node.getStateSet() )
+                _path.pop_back();
+        }
+
+        void apply(osg::Geode& geode)
+        {
+            if ( geode.getStateSet() )
+                _path.push_back( geode.getStateSet() );
+
+            for(unsigned i=0; i<geode.getNumDrawables(); ++i)
+            {
+                osg::Drawable* d = geode.getDrawable(i);
+                if ( d->getStateSet() )
+                    _path.push_back( d->getStateSet() );
+
+                _warmUp->add( _path );
+
+                if ( d->getStateSet() )
+                    _path.pop_back();
+            }
+
+            if ( geode.getStateSet() )
+                _path.pop_back();
+        }
+    };
+
+    // Draws nothing; runs the warm-up in the draw thread instead.
+    struct WarmUpDrawCallback : public osg::Drawable::DrawCallback
+    {
+        osg::ref_ptr<ShaderWarmUp> _warmUp;
+
+        WarmUpDrawCallback(ShaderWarmUp* warmUp) : _warmUp(warmUp) { }
+
+        void drawImplementation(osg::RenderInfo& renderInfo, const osg::Drawable*) const
+        {
+            _warmUp->compile( renderInfo );
+        }
+    };
+}
+
+ShaderWarmUp::ShaderWarmUp()
+{
+    //nop
+}
+
+void
+ShaderWarmUp::add(const StatePath& path)
+{
+    std::string key;
+    StatePath trimmed;
+    for(StatePath::const_iterator i = path.begin(); i != path.end(); ++i)
+    {
+        osg::StateSet* ss = trim( i->get(), key );
+        if ( ss )
+            trimmed.push_back( ss );
+    }
+
+    if ( trimmed.empty() )
+        return;
+
+    Threading::ScopedMutexLock lock(_mutex);
+    if ( _keys.insert(key).second )
+        _paths.push_back( trimmed );
+}
+
+void
+ShaderWarmUp::addScene(osg::Node* node, const StatePath& prefix)
+{
+    if ( node )
+    {
+        CollectStatePaths collector(this, prefix);
+        node->accept( collector );
+    }
+}
+
+unsigned
+ShaderWarmUp::size() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _paths.size();
+}
+
+void
+ShaderWarmUp::compile(osg::RenderInfo& renderInfo)
+{
+    osg::State* state = renderInfo.getState();
+    if ( !state )
+        return;
+
+    std::vector<StatePath> paths;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if ( !_compiledContexts.insert(state->getContextID()).second )
+            return;
+        paths = _paths;
+    }
+
+    osg::Timer_t start = osg::Timer::instance()->tick();
+
+    // the whole point is to link everything now, so lift any per-frame limit.
+    unsigned maxLinks = VirtualProgram::getMaxProgramLinksPerFrame();
+    VirtualProgram::setMaxProgramLinksPerFrame( 0u );
+
+    for(std::vector<StatePath>::const_iterator path = paths.begin(); path != paths.end(); ++path)
+    {
+        for(StatePath::const_iterator ss = path->begin(); ss != path->end(); ++ss)
+            state->pushStateSet( ss->get() );
+
+        state->apply();
+
+        for(unsigned i=0; i<path->size(); ++i)
+            state->popStateSet();
+    }
+
+    // put back whatever the render stage had applied
+    state->apply();
+
+    VirtualProgram::setMaxProgramLinksPerFrame( maxLinks );
+
+    OE_INFO << LC << "Built programs for " << paths.size() << " state combinations in "
+        << osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) << "s "
+        << "(context " << state->getContextID() << ")" << std::endl;
+}
+
+osg::Node*
+ShaderWarmUp::createNode()
+{
+    osg::Geometry* geom = new osg::Geometry();
+    geom->setUseDisplayList( false );
+#if OSG_VERSION_GREATER_OR_EQUAL(3,3,2)
+    geom->setCullingActive( false );
+#endif
+    geom->setDrawCallback( new WarmUpDrawCallback(this) );
+
+    osg::Geode* geode = new osg::Geode();
+    geode->addDrawable( geom );
+    geode->setCullingActive( false );
+
+    // draw ahead of everything else in the render stage
+    geode->getOrCreateStateSet()->setRenderBinDetails( -1000000, "RenderBin" );
+
+    return geode;
+}
@@ -91,26 +91,132 @@ namespace
 
     void geodeticToECEF(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
+        if ( !points.empty() )
+            ECEF::transformToECEF( em, &points[0], &points[0], points.size() );
+    }
+
+    void ECEFtoGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
+    {
+        if ( !points.empty() )
+            ECEF::transformFromECEF( em, &points[0], &points[0], points.size() );
+    }
+
+    // Transverse Mercator (Krueger series to third order in n) for UTM, the
+    // same formulation PROJ uses for "utm". Accurate to about a millimeter
+    // within the distances checked below, so points far outside the zone
+    // are left for OGR instead.
+    // https://en.wikipedia.org/wiki/Universal_Transverse_Mercator_coordinate_system
+    inline double artanh(double x) { return 0.5 * log((1.0 + x) / (1.0 - x)); }
+
+    struct UTMParams
+    {
+        double e, k0A, lon0, N0;
+        double alpha[3], beta[3], delta[3];
+
+        UTMParams(const osg::EllipsoidModel* em, int zone, bool north)
+        {
+            double a = em->getRadiusEquator();
+            double b = em->getRadiusPolar();
+            double f = (a - b) / a;
+            double n = f / (2.0 - f), n2 = n*n, n3 = n2*n;
+
+            e    = sqrt(f * (2.0 - f));
+            k0A  = 0.9996 * a / (1.0 + n) * (1.0 + n2/4.0 + n2*n2/64.0);
+            lon0 = osg::DegreesToRadians(zone*6.0 - 183.0);
+            N0   = north ? 0.0 : 10000000.0;
+
+            alpha[0] = n/2.0 - 2.0*n2/3.0 + 5.0*n3/16.0;
+            alpha[1] = 13.0*n2/48.0 - 3.0*n3/5.0;
+            alpha[2] = 61.0*n3/240.0;
+            beta[0]  = n/2.0 - 2.0*n2/3.0 + 37.0*n3/96.0;
+            beta[1]  = n2/48.0 + n3/15.0;
+            beta[2]  = 17.0*n3/480.0;
+            delta[0] = 2.0*n - 2.0*n2/3.0 - 2.0*n3;
+            delta[1] = 7.0*n2/3.0 - 8.0*n3/5.0;
+            delta[2] = 56.0*n3/15.0;
+        }
+    };
+
+    const double UTM_E0        = 500000.0;
+    const double UTM_MAX_DLON  = 20.0;       // degrees from the central meridian
+    const double UTM_MAX_DE    = 2000000.0;  // meters from the false easting
+
+    bool geographicToUTM(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em, int zone, bool north)
+    {
+        UTMParams p(em, zone, north);
+        const double lon0 = zone*6.0 - 183.0;
+
+        // reject the whole batch before touching it if any point is out of range
+        for( unsigned i=0; i<points.size(); ++i )
+        {
+            double dlon = fmod(points[i].x() - lon0 + 540.0, 360.0) - 180.0;
+            if ( fabs(dlon) > UTM_MAX_DLON || fabs(points[i].y()) > 89.0 )
+                return false;
+        }
+
         for( unsigned i=0; i<points.size(); ++i )
         {
-            double x, y, z;
-            em->convertLatLongHeightToXYZ(
-                osg::DegreesToRadians( points[i].y() ), osg::DegreesToRadians( points[i].x() ), points[i].z(),
-                x, y, z );
-            points[i].set( x, y, z );
+            double lat = osg::DegreesToRadians(points[i].y());
+            double dlon = osg::DegreesToRadians(points[i].x()) - p.lon0;
+            if ( dlon >  osg::PI ) dlon -= 2.0*osg::PI;
+            if ( dlon < -osg::PI ) dlon += 2.0*osg::PI;
+
+            double sinLat = sin(lat);
+            double t = sinh(artanh(sinLat) - p.e*artanh(p.e*sinLat));
+            double xi  = atan2(t, cos(dlon));
+            double eta = artanh(sin(dlon) / sqrt(1.0 + t*t));
+
+            double E = eta, N = xi;
+            for( int j=0; j<3; ++j )
+            {
+                double k = 2.0*(j+1);
+                E += p.alpha[j] * cos(k*xi) * sinh(k*eta);
+                N += p.alpha[j] * sin(k*xi) * cosh(k*eta);
+            }
+
+            points[i].x() = UTM_E0 + p.k0A * E;
+            points[i].y() = p.N0 + p.k0A * N;
+            // z doesn't change here.
         }
+        return true;
     }
 
-    void ECEFtoGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
+    bool UTMToGeographic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em, int zone, bool north)
     {
+        UTMParams p(em, zone, north);
+
+        for( unsigned i=0; i<points.size(); ++i )
+        {
+            if ( fabs(points[i].x() - UTM_E0) > UTM_MAX_DE )
+                return false;
+        }
+
         for( unsigned i=0; i<points.size(); ++i )
         {
-            double lat, lon, alt;
-            em->convertXYZToLatLongHeight(
-                points[i].x(), points[i].y(), points[i].z(),
-                lat, lon, alt );
-            points[i].set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt );
+            double xi  = (points[i].y() - p.N0) / p.k0A;
+            double eta = (points[i].x() - UTM_E0) / p.k0A;
+
+            double xip = xi, etap = eta;
+            for( int j=0; j<3; ++j )
+            {
+                double k = 2.0*(j+1);
+                xip  -= p.beta[j] * sin(k*xi) * cosh(k*eta);
+                etap -= p.beta[j] * cos(k*xi) * sinh(k*eta);
+            }
+
+            double chi = asin(sin(xip) / cosh(etap));
+            double lat = chi;
+            for( int j=0; j<3; ++j )
+            {
+                lat += p.delta[j] * sin(2.0*(j+1)*chi);
+            }
+            double lon = p.lon0 + atan2(sinh(etap), cos(xip));
+
+            points[i].x() = osg::RadiansToDegrees(lon);
+            points[i].y() = osg::RadiansToDegrees(lat);
+            // z doesn't change here.
         }
+        return true;
     }
 }
 
@@ -432,7 +538,10 @@ _is_user_defined( false ),
 _is_ltp         ( false ),
 _is_plate_carre ( false ),
 _is_spherical_mercator( false ),
-_ellipsoidId(0u)
+_utm_zone       ( 0 ),
+_is_utm_north   ( false ),
+_ellipsoidId(0u),
+_lastTransformHandle( 0L )
 {
     // nop
 }
@@ -444,7 +553,10 @@ _handle        ( handle ),
 _owns_handle   ( ownsHandle ),
 _is_ltp        ( false ),
 _is_plate_carre( false ),
-_is_ecef       ( false )
+_is_ecef       ( false ),
+_utm_zone      ( 0 ),
+_is_utm_north  ( false ),
+_lastTransformHandle( 0L )
 {
     //nop
 }
@@ -840,6 +952,19 @@ SpatialReference::isSphericalMercator() const
     return _is_spherical_mercator;
 }
 
+bool
+SpatialReference::isUTMOnDatumOf(const SpatialReference* geo) const
+{
+    if ( !_initialized )
+        const_cast<SpatialReference*>(this)->init();
+
+    return
+        _utm_zone > 0 &&
+        _ellipsoidId == geo->_ellipsoidId &&
+        _datum == geo->_datum &&
+        !_datum.empty();
+}
+
 bool 
 SpatialReference::isNorthPolar() const
 {
@@ -1074,6 +1199,31 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
         return success;
     }
 
+    // UTM on the same datum: closed-form, no need to go through OGR.
+    else if ( inputSRS->isGeographic() && outputSRS->isUTMOnDatumOf(inputSRS) )
+    {
+        std::vector<osg::Vec3d> temp(points);
+        if ( geographicToUTM(temp, outputSRS->getEllipsoid(), outputSRS->_utm_zone, outputSRS->_is_utm_north) )
+        {
+            // Z's first, while the points are still geographic
+            inputSRS->transformZ( points, outputSRS, true );
+            for( unsigned i=0; i<points.size(); ++i )
+                points[i].set( temp[i].x(), temp[i].y(), points[i].z() );
+            outputSRS->postTransform( points );
+            return true;
+        }
+    }
+
+    else if ( outputSRS->isGeographic() && inputSRS->isUTMOnDatumOf(outputSRS) )
+    {
+        if ( UTMToGeographic(points, inputSRS->getEllipsoid(), inputSRS->_utm_zone, inputSRS->_is_utm_north) )
+        {
+            inputSRS->transformZ( points, outputSRS, true );
+            outputSRS->postTransform( points );
+            return true;
+        }
+    }
+
     // if the points are starting as geographic, do the Z's first to avoid an unneccesary
     // transformation in the case of differing vdatums.
     bool z_done = false;
@@ -1159,18 +1309,30 @@ SpatialReference::transformXYPointArrays(double*  x,
     // Transform the X and Y values inside an exclusive GDAL/OGR lock
     GDAL_SCOPED_LOCK;
 
-    void* xform_handle = NULL;
-    TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_srs->getWKT());
-    if (itr != _transformHandleCache.end())
+    // Same output SRS as last time? Then skip the WKT lookup. The observer
+    // goes null when that SRS dies, so a reused address never matches.
+    SpatialReference* self = const_cast<SpatialReference*>(this);
+    void* xform_handle = 0L;
+    if (_lastTransformHandle && _lastTransformSRS.get() == out_srs)
     {
-        //OE_DEBUG << LC << "using cached transform handle" << std::endl;
-        xform_handle = itr->second;
+        xform_handle = _lastTransformHandle;
     }
     else
     {
-        OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
-        xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
-        const_cast<SpatialReference*>(this)->_transformHandleCache[out_srs->getWKT()] = xform_handle;
+        const std::string& out_wkt = out_srs->getWKT();
+        TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_wkt);
+        if (itr != _transformHandleCache.end())
+        {
+            xform_handle = itr->second;
+        }
+        else
+        {
+            OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
+            xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
+            self->_transformHandleCache[out_wkt] = xform_handle;
+        }
+        self->_lastTransformSRS = out_srs;
+        self->_lastTransformHandle = xform_handle;
     }
 
     if ( !xform_handle )
@@ -1399,49 +1561,57 @@ SpatialReference::transformExtentToMBR(const SpatialReference* to_srs,
     // Transform all points and take the maximum bounding rectangle the resulting points
     std::vector<osg::Vec3d> v;
 
-    double height = in_out_ymax - in_out_ymin;
-    double width = in_out_xmax - in_out_xmin;
-    v.push_back( osg::Vec3d(in_out_xmin, in_out_ymin, 0) ); // ll    
-    v.push_back( osg::Vec3d(in_out_xmin, in_out_ymax, 0) ); // ul
-    v.push_back( osg::Vec3d(in_out_xmax, in_out_ymax, 0) ); // ur
-    v.push_back( osg::Vec3d(in_out_xmax, in_out_ymin, 0) ); // lr
-
-    //We also sample along the edges of the bounding box and include them in the 
-    //MBR computation in case you are dealing with a projection that will cause the edges
-    //of the bounding box to be expanded.  This was first noticed when dealing with converting
-    //Hotline Oblique Mercator to WGS84
-   
-    //Sample the edges
-    unsigned int numSamples = 5;    
-    double dWidth  = width / (numSamples - 1 );
-    double dHeight = height / (numSamples - 1 );
-    
-    //Left edge
-    for (unsigned int i = 0; i < numSamples; i++)
+    // Geographic <-> spherical mercator maps each axis independently and
+    // monotonically, so the two opposite corners are enough.
+    if ((isGeographic() && to_srs->isSphericalMercator()) ||
+        (isSphericalMercator() && to_srs->isGeographic()))
     {
-        v.push_back( osg::Vec3d(in_out_xmin, in_out_ymin + dHeight * (double)i, 0) );
+        v.reserve( 2 );
+        v.push_back( osg::Vec3d(in_out_xmin, in_out_ymin, 0) ); // ll
+        v.push_back( osg::Vec3d(in_out_xmax, in_out_ymax, 0) ); // ur
     }
-
-    //Right edge
-    for (unsigned int i = 0; i < numSamples; i++)
+    else
     {
-        v.push_back( osg::Vec3d(in_out_xmax, in_out_ymin + dHeight * (double)i, 0) );
-    }
+        double height = in_out_ymax - in_out_ymin;
+        double width = in_out_xmax - in_out_xmin;
 
-    //Top edge
-    for (unsigned int i = 0; i < numSamples; i++)
-    {
-        v.push_back( osg::Vec3d(in_out_xmin + dWidth * (double)i, in_out_ymax, 0) );
-    }
+        //We sample along the edges of the bounding box (corners included) and use them
+        //all in the MBR computation in case you are dealing with a projection that will
+        //cause the edges of the bounding box to be expanded.  This was first noticed when
+        //dealing with converting Hotline Oblique Mercator to WGS84
 
-    //Bottom edge
-    for (unsigned int i = 0; i < numSamples; i++)
-    {
-        v.push_back( osg::Vec3d(in_out_xmin + dWidth * (double)i, in_out_ymin, 0) );
+        //Sample the edges
+        unsigned int numSamples = 5;
+        double dWidth  = width / (numSamples - 1 );
+        double dHeight = height / (numSamples - 1 );
+
+        v.reserve( 4 * numSamples );
+
+        //Left edge
+        for (unsigned int i = 0; i < numSamples; i++)
+        {
+            v.push_back( osg::Vec3d(in_out_xmin, in_out_ymin + dHeight * (double)i, 0) );
+        }
+
+        //Right edge
+        for (unsigned int i = 0; i < numSamples; i++)
+        {
+            v.push_back( osg::Vec3d(in_out_xmax, in_out_ymin + dHeight * (double)i, 0) );
+        }
+
+        //Top edge
+        for (unsigned int i = 0; i < numSamples; i++)
+        {
+            v.push_back( osg::Vec3d(in_out_xmin + dWidth * (double)i, in_out_ymax, 0) );
+        }
+
+        //Bottom edge
+        for (unsigned int i = 0; i < numSamples; i++)
+        {
+            v.push_back( osg::Vec3d(in_out_xmin + dWidth * (double)i, in_out_ymin, 0) );
+        }
     }
-    
-    
-    
+
     if ( transform(v, to_srs) )
     {
         in_out_xmin = DBL_MAX;
@@ -1574,6 +1744,11 @@ SpatialReference::_init()
       _is_south_polar = false;
     }
 
+    // check for UTM in meters (eligible for the native transform):
+    int isNorth = 0;
+    _utm_zone = _is_geographic ? 0 : OSRGetUTMZone( _handle, &isNorth );
+    _is_utm_north = isNorth != 0;
+
     // Try to extract the horizontal datum
     _datum = getOGRAttrValue( _handle, "DATUM", 0, true );
 
@@ -1585,6 +1760,9 @@ SpatialReference::_init()
     else
         _units = Units(units, units, Units::TYPE_LINEAR, unitMultiplier);
 
+    if ( unitMultiplier != 1.0 )
+        _utm_zone = 0;
+
     // Give the SRS a name if it doesn't have one:
     if ( _name == "unnamed" || _name.empty() )
     {
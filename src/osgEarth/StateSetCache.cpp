@@ -91,6 +91,57 @@ namespace
 #endif
     }
 
+    inline void hashCombine(std::size_t& h, std::size_t value)
+    {
+        h ^= value + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+
+    // Hash that agrees with StateAttribute::compare: equivalent attributes
+    // always have the same type and member.
+    std::size_t hashStateAttribute(const osg::StateAttribute* attr)
+    {
+        std::size_t h = attr->getType();
+        hashCombine(h, attr->getMember());
+        return h;
+    }
+
+    // Hash that agrees with StateSet::compare: it only looks at which
+    // attributes, modes and uniforms are present, which equivalent
+    // statesets always share.
+    std::size_t hashStateSet(const osg::StateSet* stateSet)
+    {
+        std::size_t h = stateSet->getRenderingHint();
+        hashCombine(h, stateSet->getBinNumber());
+
+        const osg::StateSet::AttributeList& attrs = stateSet->getAttributeList();
+        for( osg::StateSet::AttributeList::const_iterator i = attrs.begin(); i != attrs.end(); ++i )
+        {
+            hashCombine(h, i->first.first);
+            hashCombine(h, i->first.second);
+        }
+
+        const osg::StateSet::ModeList& modes = stateSet->getModeList();
+        for( osg::StateSet::ModeList::const_iterator i = modes.begin(); i != modes.end(); ++i )
+        {
+            hashCombine(h, i->first);
+            hashCombine(h, i->second);
+        }
+
+        const osg::StateSet::TextureAttributeList& texattrs = stateSet->getTextureAttributeList();
+        for( unsigned unit = 0; unit < texattrs.size(); ++unit )
+        {
+            const osg::StateSet::AttributeList& texattrlist = texattrs[unit];
+            for( osg::StateSet::AttributeList::const_iterator i = texattrlist.begin(); i != texattrlist.end(); ++i )
+            {
+                hashCombine(h, unit);
+                hashCombine(h, i->first.first);
+            }
+        }
+
+        hashCombine(h, stateSet->getUniformList().size());
+        return h;
+    }
+
     /**
      * Visitor that calls StateSetCache::share on all attributes found
      * in a scene graph.
@@ -246,9 +297,8 @@ namespace
 
 //------------------------------------------------------------------------
 
-StateSetCache::StateSetCache() :
+StateSetCache::Shard::Shard() :
 _pruneCount       ( 0 ),
-_maxSize          ( DEFAULT_PRUNE_ACCESS_COUNT ),
 _attrShareAttempts( 0 ),
 _attrsIneligible  ( 0 ),
 _attrShareHits    ( 0 ),
@@ -257,9 +307,14 @@ _attrShareMisses  ( 0 )
     //nop
 }
 
+StateSetCache::StateSetCache() :
+_maxSize( DEFAULT_PRUNE_ACCESS_COUNT )
+{
+    //nop
+}
+
 StateSetCache::~StateSetCache()
 {
-    Threading::ScopedMutexLock lock( _mutex );
     prune();
 }
 
@@ -267,9 +322,10 @@ void
 StateSetCache::setMaxSize(unsigned value)
 {
     _maxSize = value;
+    for(unsigned i=0; i<NUM_SHARDS; ++i)
     {
-        Threading::ScopedMutexLock lock( _mutex );
-        pruneIfNecessary();
+        Threading::ScopedMutexLock lock( _shards[i]._mutex );
+        pruneIfNecessary( _shards[i] );
     }
 }
 
@@ -325,46 +381,32 @@ StateSetCache::share(osg::ref_ptr<osg::StateSet>& input,
                      osg::ref_ptr<osg::StateSet>& output,
                      bool                         checkEligible)
 {
-    bool shared     = false;
-    //bool shareattrs = true;
-
-    if ( !checkEligible || eligible(input.get()) )
+    if ( input.valid() && (!checkEligible || eligible(input.get())) )
     {
-        Threading::ScopedMutexLock lock( _mutex );
+        Shard& shard = _shards[ hashStateSet(input.get()) % NUM_SHARDS ];
+        Threading::ScopedMutexLock lock( shard._mutex );
 
-        pruneIfNecessary();
+        pruneIfNecessary( shard );
 
-        //shareattrs = false;
-
-        std::pair<StateSetSet::iterator,bool> result = _stateSetCache.insert( input );
+        std::pair<StateSetSet::iterator,bool> result = shard._stateSetCache.insert( input );
         if ( result.second )
         {
             // first use
             output = input.get();
-            //shareattrs = true;
-            shared = false;
+            return false;
         }
         else
         {
             // found a share!
             output = result.first->get();
-            shared = true;
+            return true;
         }
     }
     else
     {
         output = input.get();
-        shared = false;
+        return false;
     }
-
-    // OBE.
-    //if ( shareattrs )
-    //{
-    //    ShareStateAttributes sa(this);
-    //    sa.applyStateSet( input.get() );
-    //}
-
-    return shared;
 }
 
 
@@ -374,63 +416,92 @@ StateSetCache::share(osg::ref_ptr<osg::StateAttribute>& input,
                      osg::ref_ptr<osg::StateAttribute>& output,
                      bool                               checkEligible)
 {
-    _attrShareAttempts++;
+    if ( !input.valid() )
+    {
+        output = 0L;
+        return false;
+    }
+
+    Shard& shard = _shards[ hashStateAttribute(input.get()) % NUM_SHARDS ];
+    Threading::ScopedMutexLock lock( shard._mutex );
+
+    shard._attrShareAttempts++;
 
     if ( !checkEligible || eligible(input.get()) )
     {
-        Threading::ScopedMutexLock lock( _mutex );
-
-        pruneIfNecessary();
+        pruneIfNecessary( shard );
 
-        std::pair<StateAttributeSet::iterator,bool> result = _stateAttributeCache.insert( input );
+        std::pair<StateAttributeSet::iterator,bool> result = shard._stateAttributeCache.insert( input );
         if ( result.second )
         {
             // first use
             output = input.get();
-            _attrShareMisses++;
+            shard._attrShareMisses++;
             return false;
         }
         else
         {
             // found a share!
             output = result.first->get();
-            _attrShareHits++;
+            shard._attrShareHits++;
             return true;
         }
     }
     else
     {
-        _attrsIneligible++;
+        shard._attrsIneligible++;
         output = input.get();
         return false;
     }
 }
 
+unsigned
+StateSetCache::size() const
+{
+    unsigned total = 0u;
+    for(unsigned i=0; i<NUM_SHARDS; ++i)
+    {
+        Threading::ScopedMutexLock lock( _shards[i]._mutex );
+        total += _shards[i]._stateSetCache.size();
+    }
+    return total;
+}
+
 void
-StateSetCache::pruneIfNecessary()
+StateSetCache::pruneIfNecessary(Shard& shard)
 {
-    // assume an exclusve mutex is taken
-    if ( _pruneCount++ >= _maxSize )
+    // assume the shard's mutex is taken
+    if ( shard._pruneCount++ >= _maxSize )
     {
-        prune();
-        _pruneCount = 0;
+        prune( shard );
+        shard._pruneCount = 0;
     }
 }
 
 void
 StateSetCache::prune()
 {
-    // assume an exclusive mutex is taken.
+    for(unsigned i=0; i<NUM_SHARDS; ++i)
+    {
+        Threading::ScopedMutexLock lock( _shards[i]._mutex );
+        prune( _shards[i] );
+    }
+}
+
+void
+StateSetCache::prune(Shard& shard)
+{
+    // assume the shard's mutex is taken.
 
     unsigned ss_count = 0, sa_count = 0;
 
-    for( StateSetSet::iterator i = _stateSetCache.begin(); i != _stateSetCache.end(); )
+    for( StateSetSet::iterator i = shard._stateSetCache.begin(); i != shard._stateSetCache.end(); )
     {
         if ( i->get()->referenceCount() <= 1 )
         {
             // do not call releaseGLObjects since the attrs themselves might still be shared
             // TODO: review this.
-            _stateSetCache.erase( i++ );
+            shard._stateSetCache.erase( i++ );
             ss_count++;
         }
         else
@@ -439,12 +510,12 @@ StateSetCache::prune()
         }
     }
 
-    for( StateAttributeSet::iterator i = _stateAttributeCache.begin(); i != _stateAttributeCache.end(); )
+    for( StateAttributeSet::iterator i = shard._stateAttributeCache.begin(); i != shard._stateAttributeCache.end(); )
     {
         if ( i->get()->referenceCount() <= 1 )
         {
             i->get()->releaseGLObjects( 0L );
-            _stateAttributeCache.erase( i++ );
+            shard._stateAttributeCache.erase( i++ );
             sa_count++;
         }
         else
@@ -459,21 +530,31 @@ StateSetCache::prune()
 void
 StateSetCache::clear()
 {
-    Threading::ScopedMutexLock lock( _mutex );
-
-    _stateAttributeCache.clear();
-    _stateSetCache.clear();
+    for(unsigned i=0; i<NUM_SHARDS; ++i)
+    {
+        Threading::ScopedMutexLock lock( _shards[i]._mutex );
+        _shards[i]._stateAttributeCache.clear();
+        _shards[i]._stateSetCache.clear();
+    }
 }
 
 
 void
 StateSetCache::dumpStats()
 {
-    Threading::ScopedMutexLock lock( _mutex );
+    unsigned attempts = 0, ineligible = 0, hits = 0, misses = 0;
+    for(unsigned i=0; i<NUM_SHARDS; ++i)
+    {
+        Threading::ScopedMutexLock lock( _shards[i]._mutex );
+        attempts   += _shards[i]._attrShareAttempts;
+        ineligible += _shards[i]._attrsIneligible;
+        hits       += _shards[i]._attrShareHits;
+        misses     += _shards[i]._attrShareMisses;
+    }
 
     OE_NOTICE << LC << "StateSetCache Dump:" << std::endl
-        << "    attr attempts     = " << _attrShareAttempts << std::endl
-        << "    ineligibles attrs = " << _attrsIneligible << std::endl
-        << "    attr share hits   = " << _attrShareHits << std::endl
-        << "    attr share misses = " << _attrShareMisses << std::endl;
+        << "    attr attempts     = " << attempts << std::endl
+        << "    ineligibles attrs = " << ineligible << std::endl
+        << "    attr share hits   = " << hits << std::endl
+        << "    attr share misses = " << misses << std::endl;
 }
@@ -0,0 +1,260 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/StatsRegistry>
+#include <osgEarth/Notify>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+using namespace osgEarth;
+
+#define LC "[StatsRegistry] "
+
+//...................................................................
+
+void
+StatsRegistry::Counter::add(double amount)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _value += amount;
+}
+
+double
+StatsRegistry::Counter::get() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _value;
+}
+
+void
+StatsRegistry::Gauge::set(double value)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _value = value;
+}
+
+void
+StatsRegistry::Gauge::add(double amount)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _value += amount;
+}
+
+double
+StatsRegistry::Gauge::get() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _value;
+}
+
+StatsRegistry::Histogram::Histogram(const std::vector<double>& bounds) :
+_bounds( bounds ),
+_sum   ( 0.0 ),
+_count ( 0u )
+{
+    std::sort( _bounds.begin(), _bounds.end() );
+    _counts.resize( _bounds.size() + 1u, 0u );
+}
+
+void
+StatsRegistry::Histogram::observe(double value)
+{
+    unsigned bucket = std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin();
+
+    Threading::ScopedMutexLock lock(_mutex);
+    ++_counts[bucket];
+    _sum += value;
+    ++_count;
+}
+
+void
+StatsRegistry::Histogram::get(std::vector<double>& cumulative, double& sum, double& count) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    cumulative.resize( _counts.size() );
+    double total = 0.0;
+    for (unsigned i = 0; i < _counts.size(); ++i)
+    {
+        total += (double)_counts[i];
+        cumulative[i] = total;
+    }
+    sum = _sum;
+    count = (double)_count;
+}
+
+//...................................................................
+
+StatsRegistry*
+StatsRegistry::instance()
+{
+    static StatsRegistry s_instance;
+    return &s_instance;
+}
+
+StatsRegistry::Family&
+StatsRegistry::getFamily(const std::string& name, Type type, const std::string& help)
+{
+    Families::iterator i = _families.find( name );
+    if ( i == _families.end() )
+    {
+        Family& family = _families[name];
+        family._type = type;
+        family._help = help;
+        return family;
+    }
+
+    if ( i->second._type != type )
+    {
+        OE_WARN << LC << "Statistic \"" << name << "\" is already registered with a different type\n";
+    }
+    if ( i->second._help.empty() )
+    {
+        i->second._help = help;
+    }
+    return i->second;
+}
+
+StatsRegistry::Counter*
+StatsRegistry::getCounter(const std::string& name, const std::string& labels, const std::string& help)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    Family& family = getFamily(name, COUNTER, help);
+    osg::ref_ptr<osg::Referenced>& series = family._series[labels];
+    if ( !series.valid() )
+        series = new Counter();
+    return dynamic_cast<Counter*>(series.get());
+}
+
+StatsRegistry::Gauge*
+StatsRegistry::getGauge(const std::string& name, const std::string& labels, const std::string& help)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    Family& family = getFamily(name, GAUGE, help);
+    osg::ref_ptr<osg::Referenced>& series = family._series[labels];
+    if ( !series.valid() )
+        series = new Gauge();
+    return dynamic_cast<Gauge*>(series.get());
+}
+
+StatsRegistry::Histogram*
+StatsRegistry::getHistogram(const std::string& name, const std::vector<double>& bounds, const std::string& labels, const std::string& help)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    Family& family = getFamily(name, HISTOGRAM, help);
+    osg::ref_ptr<osg::Referenced>& series = family._series[labels];
+    if ( !series.valid() )
+        series = new Histogram(bounds);
+    return dynamic_cast<Histogram*>(series.get());
+}
+
+const std::vector<double>&
+StatsRegistry::getLatencyBounds()
+{
+    static const double s_bounds[] = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0 };
+    static const std::vector<double> s_vector(s_bounds, s_bounds + sizeof(s_bounds)/sizeof(s_bounds[0]));
+    return s_vector;
+}
+
+std::string
+StatsRegistry::labelValue(const std::string& value)
+{
+    std::string out = "\"";
+    for (std::string::const_iterator c = value.begin(); c != value.end(); ++c)
+    {
+        if      ( *c == '\\' ) out += "\\\\";
+        else if ( *c == '"' )  out += "\\\"";
+        else if ( *c == '\n' ) out += "\\n";
+        else                   out += *c;
+    }
+    out += "\"";
+    return out;
+}
+
+namespace
+{
+    // name{labels} or name{labels,extra}
+    std::string seriesName(const std::string& name, const std::string& labels, const std::string& extra =std::string())
+    {
+        if ( labels.empty() && extra.empty() )
+            return name;
+        if ( labels.empty() )
+            return name + "{" + extra + "}";
+        if ( extra.empty() )
+            return name + "{" + labels + "}";
+        return name + "{" + labels + "," + extra + "}";
+    }
+
+    std::string bound(double value)
+    {
+        std::ostringstream buf;
+        buf << value;
+        return buf.str();
+    }
+}
+
+void
+StatsRegistry::writePrometheus(std::ostream& out) const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    out << std::setprecision(12);
+
+    for (Families::const_iterator f = _families.begin(); f != _families.end(); ++f)
+    {
+        const std::string& name = f->first;
+        const Family& family = f->second;
+
+        if ( !family._help.empty() )
+            out << "# HELP " << name << " " << family._help << "\n";
+
+        out << "# TYPE " << name << " "
+            << (family._type == COUNTER ? "counter" : family._type == GAUGE ? "gauge" : "histogram")
+            << "\n";
+
+        for (std::map<std::string, osg::ref_ptr<osg::Referenced> >::const_iterator s = family._series.begin(); s != family._series.end(); ++s)
+        {
+            const std::string& labels = s->first;
+
+            if ( family._type == COUNTER )
+            {
+                out << seriesName(name, labels) << " " << static_cast<const Counter*>(s->second.get())->get() << "\n";
+            }
+            else if ( family._type == GAUGE )
+            {
+                out << seriesName(name, labels) << " " << static_cast<const Gauge*>(s->second.get())->get() << "\n";
+            }
+            else
+            {
+                const Histogram* h = static_cast<const Histogram*>(s->second.get());
+                std::vector<double> cumulative;
+                double sum, count;
+                h->get(cumulative, sum, count);
+
+                for (unsigned i = 0; i < h->getBounds().size(); ++i)
+                {
+                    out << seriesName(name + "_bucket", labels, "le=\"" + bound(h->getBounds()[i]) + "\"") << " " << cumulative[i] << "\n";
+                }
+                out << seriesName(name + "_bucket", labels, "le=\"+Inf\"") << " " << cumulative.back() << "\n";
+                out << seriesName(name + "_sum", labels) << " " << sum << "\n";
+                out << seriesName(name + "_count", labels) << " " << count << "\n";
+            }
+        }
+    }
+}
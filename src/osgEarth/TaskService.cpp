@@ -19,6 +19,11 @@
 #include <osgEarth/TaskService>
 #include <osg/Notify>
 #include <osg/Math>
+#include <algorithm>
+
+#ifdef _WIN32
+#   include <windows.h>
+#endif
 
 using namespace osgEarth;
 using namespace OpenThreads;
@@ -95,6 +100,19 @@ TaskRequestQueue::cancel()
     _requests.clear();
 }
 
+void
+TaskRequestQueue::drain( TaskRequestList& out )
+{
+    {
+        ScopedLock<Mutex> lock(_mutex);
+        for (TaskRequestPriorityMap::iterator it = _requests.begin(); it != _requests.end(); ++it)
+            out.push_back( it->second.get() );
+
+        _requests.clear();
+    }
+    _notFull.signal();
+}
+
 bool
 TaskRequestQueue::isFull() const
 {
@@ -198,8 +216,284 @@ TaskRequestQueue::setDone()
 
 //------------------------------------------------------------------------
 
-TaskThread::TaskThread( TaskRequestQueue* queue ) :
+namespace
+{
+#ifdef _WIN32
+    inline bool compareAndSwap(volatile long* p, long expected, long value) {
+        return ::InterlockedCompareExchange(p, value, expected) == expected;
+    }
+    inline void atomicAdd(volatile long* p, long delta) {
+        ::InterlockedExchangeAdd(p, delta);
+    }
+#else
+    inline bool compareAndSwap(volatile long* p, long expected, long value) {
+        return __sync_bool_compare_and_swap(p, expected, value);
+    }
+    inline void atomicAdd(volatile long* p, long delta) {
+        __sync_fetch_and_add(p, delta);
+    }
+#endif
+
+    // Strict-weak ordering that matches the shared priority map, so that
+    // each deque drains in the same order the single queue would.
+    struct RunsBefore
+    {
+        bool operator()(float priority, const osg::ref_ptr<TaskRequest>& r) const {
+            return priority < r->getPriority();
+        }
+    };
+}
+
+WorkStealingTaskRequestQueue::WorkStealingTaskRequestQueue(unsigned numSlots, unsigned int maxSize) :
+TaskRequestQueue( maxSize ),
+_numPending( 0 ),
+_numSleepers( 0 ),
+_numBlockedAdders( 0 ),
+_nextSlot( 0 ),
+_done( false )
+{
+    numSlots = osg::maximum(1u, numSlots);
+    _slots.reserve( numSlots );
+    for(unsigned i=0; i<numSlots; ++i)
+        _slots.push_back( new Slot() );
+}
+
+WorkStealingTaskRequestQueue::~WorkStealingTaskRequestQueue()
+{
+    for(unsigned i=0; i<_slots.size(); ++i)
+        delete _slots[i];
+}
+
+unsigned
+WorkStealingTaskRequestQueue::pickSlot() const
+{
+    // A worker thread queuing follow-up work keeps it local; everyone
+    // else spreads their requests round-robin across the slots.
+    TaskThread* worker = dynamic_cast<TaskThread*>(OpenThreads::Thread::CurrentThread());
+    if ( worker && worker->getQueue() == this )
+        return worker->getSlot() % _slots.size();
+
+    // Advance with a compare-and-swap so the counter wraps at the slot
+    // count instead of running off the end of its type.
+    WorkStealingTaskRequestQueue* self = const_cast<WorkStealingTaskRequestQueue*>(this);
+    const long numSlots = (long)_slots.size();
+    for(;;)
+    {
+        long slot = self->_nextSlot;
+        long next = (slot + 1) % numSlots;
+        if ( compareAndSwap(&self->_nextSlot, slot, next) )
+            return (unsigned)next;
+    }
+}
+
+bool
+WorkStealingTaskRequestQueue::reserve()
+{
+    // Check the bound and count the request in one compare-and-swap, so
+    // concurrent adders cannot all pass the check and overshoot it.
+    const long maxSize = (long)getMaxSize();
+    for(;;)
+    {
+        long pending = _numPending;
+        if ( maxSize > 0 && pending >= maxSize )
+            return false;
+        if ( compareAndSwap(&_numPending, pending, pending + 1) )
+            return true;
+    }
+}
+
+void
+WorkStealingTaskRequestQueue::add( TaskRequest* request )
+{
+    // The poison pill means "no more work": hold it aside and hand it out only
+    // once every deque has drained, so it cannot overtake queued requests.
+    if ( dynamic_cast<PoisonPill*>(request) )
+    {
+        {
+            ScopedLock<Mutex> lock( _sleepMutex );
+            _poison = request;
+        }
+        _notEmpty.broadcast();
+        return;
+    }
+
+    request->setState( TaskRequest::STATE_PENDING );
+
+    if ( !request->getProgressCallback() )
+        request->setProgressCallback( new ProgressCallback() );
+
+    // bounded queue: block until there's room. The request is counted
+    // before it becomes visible so a thief can never drive the count negative.
+    bool reserved = reserve();
+    if ( !reserved )
+    {
+        ScopedLock<Mutex> lock( _sleepMutex );
+        ++_numBlockedAdders;
+        while( !(reserved = reserve()) && !_done )
+            _notFull.wait( &_sleepMutex );
+        --_numBlockedAdders;
+    }
+
+    // shutting down; don't block, just count it.
+    if ( !reserved )
+        atomicAdd( &_numPending, 1 );
+
+    Slot* slot = _slots[pickSlot()];
+    {
+        ScopedLock<Mutex> lock( slot->_mutex );
+        Deque& q = slot->_requests;
+        if ( q.empty() || !(request->getPriority() < q.back()->getPriority()) )
+            q.push_back( request );
+        else
+            q.insert( std::upper_bound(q.begin(), q.end(), request->getPriority(), RunsBefore()), request );
+    }
+
+    // Only touch the shared lock if someone is actually asleep.
+    if ( _numSleepers > 0 )
+    {
+        ScopedLock<Mutex> lock( _sleepMutex );
+        _notEmpty.signal();
+    }
+}
+
+TaskRequest*
+WorkStealingTaskRequestQueue::pop( unsigned slot )
+{
+    Slot* s = _slots[slot];
+    ScopedLock<Mutex> lock( s->_mutex );
+    if ( s->_requests.empty() )
+        return 0L;
+    osg::ref_ptr<TaskRequest> next = s->_requests.front();
+    s->_requests.pop_front();
+    return next.release();
+}
+
+TaskRequest*
+WorkStealingTaskRequestQueue::steal( unsigned thief )
+{
+    // Take from the tail of a peer, i.e. the work its owner would get to last.
+    for(unsigned i=1; i<_slots.size(); ++i)
+    {
+        Slot* s = _slots[(thief + i) % _slots.size()];
+        ScopedLock<Mutex> lock( s->_mutex );
+        if ( !s->_requests.empty() )
+        {
+            osg::ref_ptr<TaskRequest> next = s->_requests.back();
+            s->_requests.pop_back();
+            return next.release();
+        }
+    }
+    return 0L;
+}
+
+TaskRequest*
+WorkStealingTaskRequestQueue::get( unsigned slot )
+{
+    slot = slot % _slots.size();
+
+    while( !_done )
+    {
+        osg::ref_ptr<TaskRequest> next = pop( slot );
+        if ( !next.valid() )
+            next = steal( slot );
+
+        if ( next.valid() )
+        {
+            atomicAdd( &_numPending, -1 );
+            if ( _numBlockedAdders > 0 )
+            {
+                ScopedLock<Mutex> lock( _sleepMutex );
+                _notFull.signal();
+            }
+            return next.release();
+        }
+
+        // Nothing to run anywhere; sleep until an add() or shutdown.
+        ScopedLock<Mutex> lock( _sleepMutex );
+        ++_numSleepers;
+        while( _numPending == 0 && !_done && !_poison.valid() )
+            _notEmpty.wait( &_sleepMutex );
+        --_numSleepers;
+
+        if ( _numPending == 0 && _poison.valid() )
+            return osg::ref_ptr<TaskRequest>(_poison.get()).release();
+    }
+
+    return 0L;
+}
+
+void
+WorkStealingTaskRequestQueue::clearSlots( TaskRequestList* out, bool cancel )
+{
+    for(unsigned i=0; i<_slots.size(); ++i)
+    {
+        Slot* s = _slots[i];
+        ScopedLock<Mutex> lock( s->_mutex );
+        for(Deque::iterator r = s->_requests.begin(); r != s->_requests.end(); ++r)
+        {
+            if ( cancel )
+                (*r)->cancel();
+            if ( out )
+                out->push_back( r->get() );
+            atomicAdd( &_numPending, -1 );
+        }
+        s->_requests.clear();
+    }
+
+    ScopedLock<Mutex> lock( _sleepMutex );
+    _notFull.broadcast();
+}
+
+void
+WorkStealingTaskRequestQueue::clear()
+{
+    clearSlots( 0L, false );
+}
+
+void
+WorkStealingTaskRequestQueue::cancel()
+{
+    clearSlots( 0L, true );
+}
+
+void
+WorkStealingTaskRequestQueue::drain( TaskRequestList& out )
+{
+    clearSlots( &out, false );
+}
+
+void
+WorkStealingTaskRequestQueue::setDone()
+{
+    ScopedLock<Mutex> lock( _sleepMutex );
+    _done = true;
+    _notEmpty.broadcast();
+    _notFull.broadcast();
+}
+
+bool
+WorkStealingTaskRequestQueue::isFull() const
+{
+    return getMaxSize() > 0 && (unsigned)_numPending >= getMaxSize();
+}
+
+bool
+WorkStealingTaskRequestQueue::isEmpty() const
+{
+    return !_done && _numPending == 0;
+}
+
+unsigned int
+WorkStealingTaskRequestQueue::getNumRequests() const
+{
+    return (unsigned)_numPending;
+}
+
+//------------------------------------------------------------------------
+
+TaskThread::TaskThread( TaskRequestQueue* queue, unsigned slot ) :
 _queue( queue ),
+_slot( slot ),
 _done( false )
 {
     //nop
@@ -210,7 +504,7 @@ TaskThread::run()
 {
     while( !_done )
     {
-        _request = _queue->get();
+        _request = _queue->get( _slot );
 
         if ( _done )
             break;
@@ -283,14 +577,64 @@ TaskThread::cancel()
 
 //------------------------------------------------------------------------
 
-TaskService::TaskService( const std::string& name, int numThreads, unsigned int maxSize ):
+TaskService::TaskService( const std::string& name, int numThreads, unsigned int maxSize, Scheduler scheduler ):
 osg::Referenced( true ),
 _lastRemoveFinishedThreadsStamp(0),
 _name(name),
-_numThreads( 0 )
+_numThreads( 0 ),
+_maxSize( maxSize ),
+_scheduler( scheduler ),
+_nextSlot( 0u )
+{
+    _numThreads = osg::maximum(1, numThreads);
+    _queue = createQueue();
+    adjustThreadCount();
+}
+
+TaskRequestQueue*
+TaskService::createQueue() const
+{
+    if ( _scheduler == SCHEDULER_WORK_STEALING )
+    {
+        // Leave room for the pool to grow without sharing deques.
+        unsigned numSlots = osg::maximum( (unsigned)_numThreads, (unsigned)OpenThreads::GetNumberOfProcessors() );
+        return new WorkStealingTaskRequestQueue( numSlots, _maxSize );
+    }
+    else
+    {
+        return new TaskRequestQueue( _maxSize );
+    }
+}
+
+void
+TaskService::setScheduler( Scheduler scheduler )
 {
-    _queue = new TaskRequestQueue( maxSize );
-    setNumThreads( numThreads );
+    OpenThreads::ScopedLock<OpenThreads::ReentrantMutex> lock(_threadMutex);
+
+    if ( scheduler == _scheduler )
+        return;
+
+    _scheduler = scheduler;
+
+    osg::ref_ptr<TaskRequestQueue> oldQueue = _queue.get();
+    _queue = createQueue();
+
+    // move pending work over to the new queue:
+    TaskRequestList pending;
+    oldQueue->drain( pending );
+    for( TaskRequestList::iterator i = pending.begin(); i != pending.end(); ++i )
+        _queue->add( i->get() );
+
+    // retire the old threads; they exit once their current task is done.
+    for( TaskThreads::iterator i = _threads.begin(); i != _threads.end(); ++i )
+        (*i)->setDone( true );
+    oldQueue->setDone();
+
+    adjustThreadCount();
+
+    OE_INFO << LC << "TaskService [" << _name << "] switched to "
+        << (_scheduler == SCHEDULER_WORK_STEALING ? "work-stealing" : "priority queue")
+        << " scheduler" << std::endl;
 }
 
 unsigned int
@@ -395,7 +739,7 @@ TaskService::adjustThreadCount()
         //We need to add some threads
         for (int i = 0; i < diff; ++i)
         {
-            TaskThread* thread = new TaskThread( _queue.get() );
+            TaskThread* thread = new TaskThread( _queue.get(), _nextSlot++ );
             _threads.push_back( thread );
             thread->start();
         }       
@@ -458,9 +802,65 @@ TaskService::cancelAll()
 
 //------------------------------------------------------------------------
 
+struct ParallelJobs::Helper : public TaskRequest
+{
+    osg::ref_ptr<ParallelJobs> _jobs;
+    Helper(ParallelJobs* jobs) : _jobs(jobs) { }
+    void operator()(ProgressCallback*) { while (_jobs->runOne()); }
+};
+
+void
+ParallelJobs::run(unsigned count, TaskService* service)
+{
+    if (count == 0u)
+        return;
+
+    {
+        Threading::ScopedMutexLock lock(_jobsMutex);
+        _count = count;
+        _next = 0u;
+        _remaining = count;
+    }
+    _done.reset();
+
+    if (service && count > 1u)
+    {
+        unsigned numHelpers = osg::minimum(count-1u, (unsigned)osg::maximum(service->getNumThreads(), 1));
+        for (unsigned i = 0; i < numHelpers; ++i)
+        {
+            service->add(new Helper(this));
+        }
+    }
+
+    while (runOne());
+    _done.wait();
+}
+
+bool
+ParallelJobs::runOne()
+{
+    unsigned i;
+    {
+        Threading::ScopedMutexLock lock(_jobsMutex);
+        if (_next >= _count)
+            return false;
+        i = _next++;
+    }
+
+    runJob(i);
+
+    Threading::ScopedMutexLock lock(_jobsMutex);
+    if (--_remaining == 0u)
+        _done.set();
+    return true;
+}
+
+//------------------------------------------------------------------------
+
 TaskServiceManager::TaskServiceManager( int numThreads ) :
 _numThreads( 0 ),
-_targetNumThreads( numThreads )
+_targetNumThreads( numThreads ),
+_scheduler( TaskService::SCHEDULER_PRIORITY_QUEUE )
 {
     //nop
 }
@@ -488,7 +888,7 @@ TaskServiceManager::add( UID uid, float weight )
     }
     else
     {
-        TaskService* newService = new TaskService( "", 1 );
+        TaskService* newService = new TaskService( "", 1, 0, _scheduler );
         _services[uid] = WeightedTaskService( newService, weight );
         reallocate( _targetNumThreads );
         return newService;
@@ -555,6 +955,17 @@ TaskServiceManager::setWeight( TaskService* service, float weight )
     }    
 }
 
+void
+TaskServiceManager::setScheduler( TaskService::Scheduler scheduler )
+{
+    ScopedLock<Mutex> lock( _taskServiceMgrMutex );
+    if ( _scheduler != scheduler )
+    {
+        _scheduler = scheduler;
+        reallocate( _targetNumThreads );
+    }
+}
+
 void
 TaskServiceManager::reallocate( int numThreads )
 {
@@ -568,6 +979,7 @@ TaskServiceManager::reallocate( int numThreads )
     for( TaskServiceMap::const_iterator i = _services.begin(); i != _services.end(); ++i )
     {
         int threads = osg::maximum( 1, (int)( (float)_targetNumThreads * (i->second.second / totalWeight) ) );
+        i->second.first->setScheduler( _scheduler );
         i->second.first->setNumThreads( threads );
         _numThreads += threads;
     }
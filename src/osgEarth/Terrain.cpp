@@ -42,21 +42,12 @@ void Terrain::OnTileAddedOperation::operator()(osg::Object*)
         return;
 
     ++_count;
-    osg::ref_ptr<Terrain>   terrain;
-    osg::ref_ptr<osg::Node> node;
-    
-    if ( _terrain.lock(terrain) && (!_key.valid() || _node.lock(node)) )
+    osg::ref_ptr<Terrain> terrain;
+    if ( _terrain.lock(terrain) )
     {
-        if (_key.valid())
-            terrain->fireTileAdded( _key, node.get() );
-        else
-            terrain->fireTileAdded( _key, 0L );
-
-    }
-    else
-    {
-        // nop; tile expired; let it go.
-        OE_DEBUG << "Tile expired before notification: " << _key.str() << std::endl;
+        terrain->dispatchTilesAdded(
+            std::vector<TileKey>(1, _key),
+            TileList(1, _node) );
     }
 
     this->setKeep( false );
@@ -64,15 +55,52 @@ void Terrain::OnTileAddedOperation::operator()(osg::Object*)
 
 //---------------------------------------------------------------------------
 
+Terrain::OnTilesAddedOperation::OnTilesAddedOperation(Terrain* terrain)
+    : osg::Operation("OnTilesAdded", false),
+        _terrain(terrain) { }
+
+void Terrain::OnTilesAddedOperation::operator()(osg::Object*)
+{
+    osg::ref_ptr<Terrain> terrain;
+    if ( _terrain.lock(terrain) )
+        terrain->dispatchPendingTiles();
+}
+
+//---------------------------------------------------------------------------
+
+Terrain::AsyncTilesAddedOperation::AsyncTilesAddedOperation(Terrain* terrain,
+                                                            const std::vector<TileKey>& keys,
+                                                            const TileList& tiles)
+    : osg::Operation("AsyncTilesAdded", false),
+        _terrain(terrain), _keys(keys), _tiles(tiles) { }
+
+void Terrain::AsyncTilesAddedOperation::operator()(osg::Object*)
+{
+    _terrain->fireTilesAdded( _keys, _tiles, true );
+}
+
+//---------------------------------------------------------------------------
+
 Terrain::Terrain(osg::Node* graph, const Profile* mapProfile, bool geocentric, const TerrainOptions& terrainOptions ) :
 _graph         ( graph ),
 _profile       ( mapProfile ),
 _geocentric    ( geocentric ),
-_terrainOptions( terrainOptions )
+_terrainOptions( terrainOptions ),
+_dispatchQueued( false )
 {
     _updateQueue = new osg::OperationQueue();
 }
 
+Terrain::~Terrain()
+{
+    // Async operations refer to this object, so wait for the current one to finish.
+    if ( _asyncThread.valid() )
+    {
+        _asyncThread->cancel();
+        _asyncThread = 0L;
+    }
+}
+
 void
 Terrain::update()
 {
@@ -317,25 +345,112 @@ Terrain::notifyTileAdded( const TileKey& key, osg::Node* node )
         if (!key.valid())
             OE_WARN << LC << "notifyTileAdded with key = NULL\n";
 
-        _updateQueue->add(new OnTileAddedOperation(key, node, this));
+        // Collect the tile; all the tiles merged before the next update
+        // go out in one batch.
+        Threading::ScopedMutexLock lock( _pendingMutex );
+        _pendingKeys.push_back( key );
+        _pendingTiles.push_back( node );
+        if ( !_dispatchQueued )
+        {
+            _dispatchQueued = true;
+            _updateQueue->add(new OnTilesAddedOperation(this));
+        }
     }
 }
 
 void
-Terrain::fireTileAdded( const TileKey& key, osg::Node* node )
+Terrain::dispatchPendingTiles()
 {
-    Threading::ScopedReadLock sharedLock( _callbacksMutex );
+    std::vector<TileKey> keys;
+    TileList             tiles;
+    {
+        Threading::ScopedMutexLock lock( _pendingMutex );
+        keys.swap( _pendingKeys );
+        tiles.swap( _pendingTiles );
+        _dispatchQueued = false;
+    }
 
-    for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end(); )
-    {       
-        TerrainCallbackContext context( this );
-        i->get()->onTileAdded( key, node, context );
+    if ( !keys.empty() )
+        dispatchTilesAdded( keys, tiles );
+}
 
-        // if the callback set the "remove" flag, discard the callback.
-        if ( context.markedForRemoval() )
-            i = _callbacks.erase( i );
+void
+Terrain::dispatchTilesAdded( const std::vector<TileKey>& keys, const TileList& tiles )
+{
+    bool hasAsync = false;
+    {
+        Threading::ScopedReadLock sharedLock( _callbacksMutex );
+        for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end() && !hasAsync; ++i )
+            hasAsync = i->get()->getDispatchAsync();
+    }
+
+    if ( hasAsync )
+    {
+        Threading::ScopedMutexLock lock( _asyncThreadMutex );
+        if ( !_asyncThread.valid() )
+        {
+            _asyncThread = new osg::OperationThread();
+            _asyncThread->startThread();
+        }
+        _asyncThread->add( new AsyncTilesAddedOperation(this, keys, tiles) );
+    }
+
+    fireTilesAdded( keys, tiles, false );
+}
+
+void
+Terrain::fireTilesAdded( const std::vector<TileKey>& keys, const TileList& tiles, bool async )
+{
+    // Hold the tiles that still exist for the duration of the callbacks.
+    std::vector<TileKey>                  liveKeys;
+    std::vector<osg::Node*>               liveTiles;
+    std::vector< osg::ref_ptr<osg::Node> > refs;
+
+    for( unsigned i = 0; i < keys.size(); ++i )
+    {
+        osg::ref_ptr<osg::Node> node;
+        if ( !keys[i].valid() )
+        {
+            liveKeys.push_back( keys[i] );
+            liveTiles.push_back( 0L );
+        }
+        else if ( tiles[i].lock(node) )
+        {
+            liveKeys.push_back( keys[i] );
+            liveTiles.push_back( node.get() );
+            refs.push_back( node.get() );
+        }
         else
-            ++i;
+        {
+            // nop; tile expired; let it go.
+            OE_DEBUG << "Tile expired before notification: " << keys[i].str() << std::endl;
+        }
+    }
+
+    if ( liveKeys.empty() )
+        return;
+
+    CallbackList toRemove;
+    {
+        Threading::ScopedReadLock sharedLock( _callbacksMutex );
+
+        for( CallbackList::iterator i = _callbacks.begin(); i != _callbacks.end(); ++i )
+        {
+            if ( i->get()->getDispatchAsync() != async )
+                continue;
+
+            TerrainCallbackContext context( this );
+            i->get()->onTilesAdded( liveKeys, liveTiles, context );
+
+            // if the callback set the "remove" flag, discard the callback.
+            if ( context.markedForRemoval() )
+                toRemove.push_back( *i );
+        }
+    }
+
+    for( CallbackList::iterator i = toRemove.begin(); i != toRemove.end(); ++i )
+    {
+        removeTerrainCallback( i->get() );
     }
 }
 
@@ -122,6 +122,7 @@ _dirtyCount              ( 0 ),
 _requireElevationTextures( false ),
 _requireNormalTextures   ( false ),
 _requireParentTextures   ( false ),
+_parentTexturesLifetime  ( -1.0f ),
 _requireElevationBorder  ( false ),
 _requireFullDataAtFirstLOD( false ),
 _redrawRequired          ( true )
@@ -173,6 +174,16 @@ TerrainEngineNode::requireParentTextures()
     dirtyTerrain();
 }
 
+void
+TerrainEngineNode::setParentTexturesLifetime(float seconds)
+{
+    if (_parentTexturesLifetime != seconds)
+    {
+        _parentTexturesLifetime = seconds;
+        dirtyTerrain();
+    }
+}
+
 
 void
 TerrainEngineNode::requestRedraw()
@@ -191,6 +202,39 @@ TerrainEngineNode::dirtyTerrain()
     requestRedraw();
 }
 
+void
+TerrainEngineNode::addShaderWarmUpStates(const ShaderWarmUp::StatePath& prefix, ShaderWarmUp& warmUp)
+{
+    ShaderWarmUp::StatePath path = prefix;
+    if (getStateSet())
+        path.push_back(getStateSet());
+
+    osg::StateSet* surface = getSurfaceStateSet();
+    if (surface && surface != getStateSet())
+        path.push_back(surface);
+
+    warmUp.add(path);
+
+    if (!_map.valid())
+        return;
+
+    LayerVector layers;
+    _map->getLayers(layers);
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        const Layer* layer = i->get();
+        const VisibleLayer* visLayer = dynamic_cast<const VisibleLayer*>(layer);
+        if (layer->getEnabled() && (!visLayer || visLayer->getVisible()) &&
+            layer->getRenderType() != Layer::RENDERTYPE_NONE &&
+            layer->getStateSet())
+        {
+            path.push_back(layer->getStateSet());
+            warmUp.add(path);
+            path.pop_back();
+        }
+    }
+}
+
 void
 TerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
 {
@@ -24,6 +24,7 @@
 #include <osgEarth/URI>
 #include <osgEarth/MemCache>
 #include <osgEarth/CacheBin>
+#include <osgEarth/StatsRegistry>
 #include <osgDB/WriteFile>
 #include <osg/Version>
 #include <OpenThreads/ScopedLock>
@@ -262,7 +263,7 @@ _tileSourceExpected(true)
 
 TerrainLayer::~TerrainLayer()
 {
-    //nop
+    saveBlacklist();
 }
 
 void
@@ -296,6 +297,14 @@ TerrainLayer::open()
             OE_INFO << LC << "L2 cache size set from environment = " << l2CacheSize << "\n";
         }
 
+        unsigned l2CacheMaxBytes = options().driver()->L2CacheMaxBytes().get();
+        char const* l2bytesEnv = ::getenv( "OSGEARTH_L2_CACHE_MAX_BYTES" );
+        if ( l2bytesEnv )
+        {
+            l2CacheMaxBytes = as<unsigned>( std::string(l2bytesEnv), 0u );
+            OE_INFO << LC << "L2 cache budget set from environment = " << l2CacheMaxBytes << " bytes\n";
+        }
+
         // Env cache-only mode also disables the L2 cache.
         char const* noCacheEnv = ::getenv( "OSGEARTH_MEMORY_PROFILE" );
         if ( noCacheEnv )
@@ -306,7 +315,7 @@ TerrainLayer::open()
         // Initialize the l2 cache if it's size is > 0
         if ( l2CacheSize > 0 )
         {
-            _memCache = new MemCache( l2CacheSize );
+            _memCache = new MemCache( l2CacheSize, l2CacheMaxBytes );
         }
 
         // create the unique cache ID for the cache bin.
@@ -360,6 +369,25 @@ TerrainLayer::open()
             }
             else if (isTileSourceExpected())
             {
+                // Let the driver cache any service metadata it fetches while opening
+                // (capabilities documents and the like) in this layer's bin, so that
+                // a warm start can skip the network. Unless the layer sets a max age,
+                // that metadata goes stale after a day and is then revalidated.
+                if (_cacheSettings->isCacheEnabled())
+                {
+                    osg::ref_ptr<CacheSettings> metadataSettings = new CacheSettings(*_cacheSettings);
+                    metadataSettings->setCacheBin(_cacheSettings->getCache()->addBin(_runtimeCacheId));
+                    if (!metadataSettings->cachePolicy()->maxAge().isSet())
+                    {
+                        TimeSpan maxAge = 86400;
+                        const char* maxAgeEnv = ::getenv("OSGEARTH_METADATA_CACHE_MAX_AGE");
+                        if (maxAgeEnv)
+                            maxAge = as<long>(std::string(maxAgeEnv), maxAge);
+                        metadataSettings->cachePolicy()->maxAge() = maxAge;
+                    }
+                    metadataSettings->storeForMetadata(_readOptions.get());
+                }
+
                 // Initialize the tile source once and only once.
                 ts = createAndOpenTileSource();
             }
@@ -433,6 +461,7 @@ TerrainLayer::open()
 void
 TerrainLayer::close()
 {
+    saveBlacklist();
     setProfile(0L);
     _tileSource = 0L;
     _openCalled = false;
@@ -512,6 +541,58 @@ TerrainLayer::getMetadataKey(const Profile* profile) const
         return "_metadata";
 }
 
+std::string
+TerrainLayer::getBlacklistKey() const
+{
+    // the blacklist holds keys in the tile source's profile, not the cache's
+    const Profile* profile = _profileOriginal.valid() ? _profileOriginal.get() : _profile.get();
+    if (profile)
+        return Stringify() << profile->getHorizSignature() << "_blacklist";
+    else
+        return "_blacklist";
+}
+
+void
+TerrainLayer::saveBlacklist()
+{
+    TileSource* ts = getTileSource();
+    if (!ts || !ts->getBlacklist() || !ts->getBlacklist()->isDirty() || !_openCalled)
+        return;
+
+    CacheSettings* cacheSettings = getCacheSettings();
+    if (!cacheSettings || !cacheSettings->cachePolicy()->isCacheWriteable())
+        return;
+
+    CacheBin* bin = cacheSettings->getCacheBin();
+    if (bin)
+    {
+        std::stringstream buf;
+        ts->getBlacklist()->write(buf);
+        bin->write(getBlacklistKey(), new StringObject(buf.str()), _readOptions.get());
+        OE_DEBUG << LC << "Saved tile blacklist to cache bin [" << _runtimeCacheId << "]" << std::endl;
+    }
+}
+
+void
+TerrainLayer::countCacheRead(bool hit) const
+{
+    // The registry keeps its counters forever, so a plain pointer is safe to hold;
+    // a race on first use just looks the same counter up twice.
+    OpenThreads::AtomicPtr& slot = hit ? _cacheHitCounter : _cacheMissCounter;
+    StatsRegistry::Counter* counter = static_cast<StatsRegistry::Counter*>(slot.get());
+    if ( !counter )
+    {
+        std::string labels = Stringify()
+            << "layer=" << StatsRegistry::labelValue(getName())
+            << ",result=" << (hit ? "\"hit\"" : "\"miss\"");
+
+        counter = StatsRegistry::instance()->getCounter(
+            "osgearth_cache_reads_total", labels, "Tile reads from layer caches");
+        slot.assign( counter, 0L );
+    }
+    counter->add();
+}
+
 CacheBin*
 TerrainLayer::getCacheBin(const Profile* profile)
 {
@@ -650,6 +731,18 @@ TerrainLayer::getCacheBin(const Profile* profile)
         {
             _cacheBinMetadata[metaKey] = meta.get();
             OE_DEBUG << LC << "Established metadata for cache bin [" << _runtimeCacheId << "]" << std::endl;
+
+            // pick up the tiles previous runs found to be empty, so we don't ask
+            // the source for them again until their entries expire.
+            if (getTileSource() && getTileSource()->getBlacklist())
+            {
+                ReadResult blr = bin->readString(getBlacklistKey(), _readOptions.get());
+                if (blr.succeeded())
+                {
+                    std::istringstream in(blr.getString());
+                    getTileSource()->getBlacklist()->append(in);
+                }
+            }
         }
     }
 
@@ -728,6 +821,32 @@ TerrainLayer::createAndOpenTileSource()
             _readOptions->setOptionString( s );
         }
 
+        // route HTTP reads through the shared multiplexer if requested.
+        if ( ts->getOptions().httpMultiplex() == true )
+        {
+            std::string s = _readOptions->getOptionString();
+            _readOptions->setOptionString( s.empty() ? "OSGEARTH_HTTP_MULTIPLEX" : s + " OSGEARTH_HTTP_MULTIPLEX" );
+        }
+
+        // per-host request budget; HTTPClient applies it to each host this layer reads from.
+        if ( ts->getOptions().httpMaxConnections().isSet() || ts->getOptions().httpRateLimit().isSet() )
+        {
+            std::string s = Stringify()
+                << _readOptions->getOptionString()
+                << " OSGEARTH_HTTP_MAX_CONNECTIONS=" << ts->getOptions().httpMaxConnections().get()
+                << " OSGEARTH_HTTP_RATE_LIMIT=" << ts->getOptions().httpRateLimit().get();
+            _readOptions->setOptionString( trim(s) );
+        }
+
+        // ask the image decoder to reduce oversized images while decoding them.
+        if ( ts->getOptions().decodeMaxSize().isSet() && ts->getOptions().decodeMaxSize().get() > 0u )
+        {
+            std::string s = Stringify()
+                << _readOptions->getOptionString()
+                << " OSGEARTH_DECODE_MAX_SIZE=" << ts->getOptions().decodeMaxSize().get();
+            _readOptions->setOptionString( trim(s) );
+        }
+
         // report on a manual override profile:
         if ( ts->getProfile() )
         {
@@ -23,8 +23,11 @@
 #include <osgEarth/PatchLayer>
 #include <osgEarth/MapOptions>
 #include <osgEarth/MapFrame>
+#include <osgEarth/Metrics>
 
 #include <osg/Texture2D>
+#include <algorithm>
+#include <climits>
 
 #define LC "[TerrainTileModelFactory] "
 
@@ -32,6 +35,40 @@ using namespace osgEarth;
 
 //.........................................................................
 
+namespace
+{
+    // Whether a key is past the highest level at which a layer has real data,
+    // i.e. whether the layer could only return an upsampled copy of a parent tile.
+    bool isPastMaxDataLevel(const TerrainLayer* layer, const TileKey& key)
+    {
+        const Profile* profile = layer->getProfile();
+        if ( !profile )
+            return false;
+
+        unsigned maxLevel = layer->options().maxDataLevel().get();
+
+        const DataExtentList& dataExtents = layer->getDataExtents();
+        if ( !dataExtents.empty() )
+        {
+            unsigned extentsMax = 0u;
+            for (DataExtentList::const_iterator i = dataExtents.begin(); i != dataExtents.end(); ++i)
+            {
+                if ( !i->maxLevel().isSet() )
+                {
+                    extentsMax = UINT_MAX;
+                    break;
+                }
+                extentsMax = std::max(extentsMax, i->maxLevel().get());
+            }
+            maxLevel = std::min(maxLevel, extentsMax);
+        }
+
+        return profile->getEquivalentLOD(key.getProfile(), key.getLOD()) > maxLevel;
+    }
+}
+
+//.........................................................................
+
 TerrainTileModelFactory::TerrainTileModelFactory(const TerrainOptions& options) :
 _options         ( options ),
 _heightFieldCache( true, 128 )
@@ -49,6 +86,8 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
                                          const TerrainEngineRequirements* requirements,
                                          ProgressCallback*                progress)
 {
+    ScopedTileStage stage("tile.model", "terrain", key);
+
     // Make a new model:
     osg::ref_ptr<TerrainTileModel> model = new TerrainTileModel(
         key,
@@ -63,7 +102,7 @@ TerrainTileModelFactory::createTileModel(const MapFrame&                  frame,
     {
         unsigned border = requirements->elevationBorderRequired() ? 1u : 0u;
 
-        addElevation( model.get(), frame, key, filter, border, progress );
+        addElevation( model.get(), frame, requirements, key, filter, border, progress );
     }
 
 #if 0
@@ -104,6 +143,17 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
         if (!layer->getEnabled())
             continue;
 
+        // Coverage data past its last level would only be an upsampled copy of
+        // the parent tile's. The engine inherits a shared layer's parent texture
+        // (with a scale/bias matrix) when a tile has none, so don't make one.
+        if (layer->isCoverage() &&
+            layer->isShared() &&
+            key.getLOD() > _options.firstLOD().get() &&
+            isPastMaxDataLevel(layer, key))
+        {
+            continue;
+        }
+
         osg::Texture* tex = 0L;
         osg::Matrixf textureMatrix;
 
@@ -111,6 +161,7 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
         {
             if (layer->createTextureSupported())
             {
+                ScopedTileStage stage("tile.create_texture", layer->getName(), key);
                 tex = layer->createTexture( key, progress, textureMatrix );
             }
 
@@ -120,6 +171,7 @@ TerrainTileModelFactory::addImageLayers(TerrainTileModel* model,
            
                 if ( geoImage.valid() )
                 {
+                    ScopedTileStage stage("tile.texture", layer->getName(), key);
                     if ( layer->isCoverage() )
                         tex = createCoverageTexture(geoImage.getImage(), layer);
                     else
@@ -187,6 +239,7 @@ TerrainTileModelFactory::addPatchLayers(TerrainTileModel* model,
 
         if (layer->getAcceptCallback() == 0L || layer->getAcceptCallback()->acceptKey(key))
         {
+            ScopedTileStage stage("tile.patch", layer->getName(), key);
             PatchLayer::TileData* tileData = layer->createTileData(key);
             if (tileData)
             {
@@ -205,12 +258,13 @@ TerrainTileModelFactory::addPatchLayers(TerrainTileModel* model,
 
 
 void
-TerrainTileModelFactory::addElevation(TerrainTileModel*            model,
-                                      const MapFrame&              frame,
-                                      const TileKey&               key,
-                                      const CreateTileModelFilter& filter,
-                                      unsigned                     border,
-                                      ProgressCallback*            progress)
+TerrainTileModelFactory::addElevation(TerrainTileModel*                model,
+                                      const MapFrame&                  frame,
+                                      const TerrainEngineRequirements* reqs,
+                                      const TileKey&                   key,
+                                      const CreateTileModelFilter&     filter,
+                                      unsigned                         border,
+                                      ProgressCallback*                progress)
 {    
     // make an elevation layer.
     OE_START_TIMER(fetch_elevation);
@@ -227,8 +281,19 @@ TerrainTileModelFactory::addElevation(TerrainTileModel*            model,
     osg::ref_ptr<osg::HeightField> mainHF;
     osg::ref_ptr<NormalMap> normalMap;
 
-    if (getOrCreateHeightField(frame, key, SAMPLE_FIRST_VALID, interp, border, mainHF, normalMap, progress) && mainHF.valid())
+    // Only build a normal map if the engine will use it.
+    bool createNormalMap = reqs == 0L || reqs->normalTexturesRequired();
+
+    bool haveHF;
     {
+        ScopedTileStage stage("tile.elevation", "elevation", key);
+        haveHF = getOrCreateHeightField(frame, key, SAMPLE_FIRST_VALID, interp, border, createNormalMap, mainHF, normalMap, progress);
+    }
+
+    if (haveHF && mainHF.valid())
+    {
+        ScopedTileStage stage("tile.elevation_texture", "elevation", key);
+
         osg::ref_ptr<TerrainTileElevationModel> layerModel = new TerrainTileElevationModel();
         layerModel->setHeightField( mainHF.get() );
 
@@ -317,6 +382,7 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
                                                 ElevationSamplePolicy           samplePolicy,
                                                 ElevationInterpolation          interpolation,
                                                 unsigned                        border,
+                                                bool                            createNormalMap,
                                                 osg::ref_ptr<osg::HeightField>& out_hf,
                                                 osg::ref_ptr<NormalMap>&        out_normalMap,
                                                 ProgressCallback*               progress)
@@ -332,7 +398,8 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
 
     bool hit = false;
     HFCache::Record rec;
-    if ( _heightFieldCacheEnabled && _heightFieldCache.get(cachekey, rec) )
+    if ( _heightFieldCacheEnabled && _heightFieldCache.get(cachekey, rec) &&
+         (!createNormalMap || rec.value()._normalMap.valid()) )
     {
         out_hf = rec.value()._hf.get();
         out_normalMap = rec.value()._normalMap.get();
@@ -355,7 +422,7 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
             true);              // initialize to HAE (0.0) heights
     }
 
-    if (!out_normalMap.valid())
+    if (createNormalMap && !out_normalMap.valid())
     {
         //OE_INFO << "TODO: check terrain reqs\n";
         out_normalMap = new NormalMap(257, 257); // ImageUtils::createEmptyImage(257, 257);        
@@ -412,10 +479,50 @@ TerrainTileModelFactory::getOrCreateHeightField(const MapFrame&
     return populated;
 }
 
+osg::Texture*
+TerrainTileModelFactory::getSingleColorTexture(const osg::Image* image,
+                                               const ImageLayer* layer) const
+{
+    osg::Vec4 color = ImageUtils::PixelReader(image)(0, 0);
+    unsigned rgba =
+        ((unsigned)(osg::clampBetween(color.r(), 0.0f, 1.0f) * 255.0f + 0.5f) << 24) |
+        ((unsigned)(osg::clampBetween(color.g(), 0.0f, 1.0f) * 255.0f + 0.5f) << 16) |
+        ((unsigned)(osg::clampBetween(color.b(), 0.0f, 1.0f) * 255.0f + 0.5f) << 8)  |
+        ((unsigned)(osg::clampBetween(color.a(), 0.0f, 1.0f) * 255.0f + 0.5f));
+
+    Threading::ScopedMutexLock lock( _singleColorTexturesMutex );
+
+    std::pair<UID, unsigned> key( layer->getUID(), rgba );
+    SingleColorTextures::const_iterator i = _singleColorTextures.find( key );
+    if ( i != _singleColorTextures.end() )
+        return i->second.get();
+
+    // don't let a layer full of near-solid gradients grow this without bound
+    if ( _singleColorTextures.size() >= 1024u )
+        return 0L;
+
+    osg::Texture2D* tex = new osg::Texture2D( ImageUtils::createOnePixelImage(color) );
+    tex->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+    tex->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+    tex->setResizeNonPowerOfTwoHint(false);
+    tex->setFilter( osg::Texture::MAG_FILTER, osg::Texture::NEAREST );
+    tex->setFilter( osg::Texture::MIN_FILTER, osg::Texture::NEAREST );
+    _singleColorTextures[key] = tex;
+    return tex;
+}
+
 osg::Texture*
 TerrainTileModelFactory::createImageTexture(osg::Image*       image,
                                             const ImageLayer* layer) const
 {
+    // Tiles of a single color all share one tiny texture.
+    if ( layer && ImageUtils::isMarkedAsSingleColor(image) )
+    {
+        osg::Texture* shared = getSingleColorTexture( image, layer );
+        if ( shared )
+            return shared;
+    }
+
     osg::Texture2D* tex = new osg::Texture2D( image );
 
     tex->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
@@ -20,8 +20,11 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include <limits.h>
+#include <float.h>
 
 #include <osgEarth/Tessellator>
+#include <algorithm>
+#include <deque>
 
 using namespace osgEarth;
 
@@ -131,6 +134,9 @@ Tessellator::tessellateGeometry(osg::Geometry &geom)
 
     if (!vertices || vertices->empty() || geom.getPrimitiveSetList().empty()) return false;
 
+    if (_method == METHOD_FAST)
+        return tessellateFast(geom);
+
     // copy the original primitive set list
     osg::Geometry::PrimitiveSetList originalPrimitives = geom.getPrimitiveSetList();
 
@@ -401,4 +407,855 @@ Tessellator::isEar(const osg::Vec3Array &vertices, const std::vector<unsigned in
     tradEar = true;
 
 		return circEar;
-}
\ No newline at end of file
+}
+
+
+/***************************************************/
+
+// METHOD_FAST: ear clipping on a linked list of vertices, with z-order
+// hashing of the vertices for the point-in-ear tests and bridging of holes
+// into the outer loop. Coordinates use only x and y. Adapted from the
+// "earcut" algorithm by Mapbox (https://github.com/mapbox/earcut), which
+// carries the following notice:
+//
+// ISC License
+//
+// Copyright (c) 2016, Mapbox
+//
+// Permission to use, copy, modify, and/or distribute this software for any purpose
+// with or without fee is hereby granted, provided that the above copyright notice
+// and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH REGARD TO
+// THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS.
+// IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA
+// OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+// ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+namespace
+{
+    struct Node
+    {
+        unsigned i;          // index into the vertex array
+        double   x, y;
+        Node*    prev;
+        Node*    next;
+        unsigned z;          // z-order curve value
+        Node*    prevZ;
+        Node*    nextZ;
+        bool     steiner;
+
+        Node(unsigned i_, double x_, double y_) :
+            i(i_), x(x_), y(y_), prev(0L), next(0L), z(0u), prevZ(0L), nextZ(0L), steiner(false) { }
+    };
+
+    class FastTessellator
+    {
+    public:
+        FastTessellator(const osg::Vec3Array& verts, std::vector<unsigned>& tris) :
+            _verts(verts), _tris(tris), _hashed(false), _minX(0.0), _minY(0.0), _invSize(0.0) { }
+
+        /** Tessellates one loop [first, last) with holes. Returns false on failure. */
+        bool run(unsigned first, unsigned last, const std::vector< std::pair<unsigned,unsigned> >& holes)
+        {
+            _nodes.clear();
+            unsigned startSize = _tris.size();
+
+            Node* outer = linkedList(first, last, true);
+            if (!outer || outer->next == outer->prev)
+                return false;
+
+            unsigned numPoints = last - first;
+            if (!holes.empty())
+            {
+                outer = eliminateHoles(holes, outer);
+                for (unsigned h = 0; h < holes.size(); ++h)
+                    numPoints += holes[h].second - holes[h].first;
+            }
+
+            // hash the vertices when the polygon is big enough to pay for it.
+            _hashed = false;
+            if (numPoints > 80u)
+            {
+                double maxX, maxY;
+                _minX = maxX = _verts[first].x();
+                _minY = maxY = _verts[first].y();
+                for (unsigned v = first+1; v < last; ++v)
+                {
+                    const osg::Vec3& p = _verts[v];
+                    if (p.x() < _minX) _minX = p.x();
+                    if (p.y() < _minY) _minY = p.y();
+                    if (p.x() > maxX) maxX = p.x();
+                    if (p.y() > maxY) maxY = p.y();
+                }
+                double size = osg::maximum(maxX - _minX, maxY - _minY);
+                _invSize = size != 0.0 ? 32767.0 / size : 0.0;
+                _hashed = _invSize != 0.0;
+            }
+
+            earcutLinked(outer, 0);
+
+            return _tris.size() > startSize;
+        }
+
+    private:
+        const osg::Vec3Array&  _verts;
+        std::vector<unsigned>& _tris;
+        std::deque<Node>       _nodes;    // deque: nodes stay put as it grows
+        bool                   _hashed;
+        double                 _minX, _minY, _invSize;
+
+        static double area(const Node* p, const Node* q, const Node* r)
+        {
+            return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+        }
+
+        static bool equals(const Node* a, const Node* b)
+        {
+            return a->x == b->x && a->y == b->y;
+        }
+
+        static int sign(double v)
+        {
+            return v > 0.0 ? 1 : v < 0.0 ? -1 : 0;
+        }
+
+        static bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+        {
+            return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+                   (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+                   (bx - px) * (cy - py) >= (cx - px) * (by - py);
+        }
+
+        Node* insertNode(unsigned i, Node* last)
+        {
+            const osg::Vec3& v = _verts[i];
+            _nodes.push_back(Node(i, v.x(), v.y()));
+            Node* p = &_nodes.back();
+            if (!last)
+            {
+                p->prev = p;
+                p->next = p;
+            }
+            else
+            {
+                p->next = last->next;
+                p->prev = last;
+                last->next->prev = p;
+                last->next = p;
+            }
+            return p;
+        }
+
+        static void removeNode(Node* p)
+        {
+            p->next->prev = p->prev;
+            p->prev->next = p->next;
+            if (p->prevZ) p->prevZ->nextZ = p->nextZ;
+            if (p->nextZ) p->nextZ->prevZ = p->prevZ;
+        }
+
+        // builds a circular list from a loop, in CCW (outer) or CW (hole) order.
+        Node* linkedList(unsigned first, unsigned last, bool ccw)
+        {
+            if (last - first < 3)
+                return 0L;
+
+            double sum = 0.0;
+            for (unsigned i = first, j = last-1; i < last; j = i++)
+                sum += (_verts[j].x() - _verts[i].x()) * (_verts[i].y() + _verts[j].y());
+
+            Node* tail = 0L;
+            if (ccw == (sum > 0.0))
+            {
+                for (unsigned i = first; i < last; ++i)
+                    tail = insertNode(i, tail);
+            }
+            else
+            {
+                for (unsigned i = last; i-- > first; )
+                    tail = insertNode(i, tail);
+            }
+
+            if (tail && equals(tail, tail->next))
+            {
+                removeNode(tail);
+                tail = tail->next;
+            }
+            return tail;
+        }
+
+        // removes duplicate and collinear points
+        static Node* filterPoints(Node* start, Node* end =0L)
+        {
+            if (!start) return start;
+            if (!end) end = start;
+
+            Node* p = start;
+            bool again;
+            do
+            {
+                again = false;
+                if (!p->steiner && (equals(p, p->next) || area(p->prev, p, p->next) == 0.0))
+                {
+                    removeNode(p);
+                    p = end = p->prev;
+                    if (p == p->next) break;
+                    again = true;
+                }
+                else
+                {
+                    p = p->next;
+                }
+            }
+            while (again || p != end);
+
+            return end;
+        }
+
+        void emit(const Node* a, const Node* b, const Node* c)
+        {
+            _tris.push_back(a->i);
+            _tris.push_back(b->i);
+            _tris.push_back(c->i);
+        }
+
+        void earcutLinked(Node* ear, int pass)
+        {
+            if (!ear) return;
+
+            if (pass == 0 && _hashed)
+                indexCurve(ear);
+
+            Node* stop = ear;
+
+            while (ear->prev != ear->next)
+            {
+                Node* prev = ear->prev;
+                Node* next = ear->next;
+
+                if (_hashed ? isEarHashed(ear) : isEar(ear))
+                {
+                    emit(prev, ear, next);
+                    removeNode(ear);
+
+                    // skipping the next vertex leads to fewer sliver triangles
+                    ear = next->next;
+                    stop = next->next;
+                    continue;
+                }
+
+                ear = next;
+
+                // no more ears: try to recover, in increasingly drastic ways.
+                if (ear == stop)
+                {
+                    if (pass == 0)
+                    {
+                        earcutLinked(filterPoints(ear), 1);
+                    }
+                    else if (pass == 1)
+                    {
+                        ear = cureLocalIntersections(filterPoints(ear));
+                        earcutLinked(ear, 2);
+                    }
+                    else if (pass == 2)
+                    {
+                        splitEarcut(ear);
+                    }
+                    break;
+                }
+            }
+        }
+
+        static bool isEar(const Node* ear)
+        {
+            const Node* a = ear->prev;
+            const Node* b = ear;
+            const Node* c = ear->next;
+
+            if (area(a, b, c) >= 0.0) return false; // reflex
+
+            double x0 = osg::minimum(a->x, osg::minimum(b->x, c->x)), y0 = osg::minimum(a->y, osg::minimum(b->y, c->y));
+            double x1 = osg::maximum(a->x, osg::maximum(b->x, c->x)), y1 = osg::maximum(a->y, osg::maximum(b->y, c->y));
+
+            for (const Node* p = c->next; p != a; p = p->next)
+            {
+                if (p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 &&
+                    !equals(p, a) &&
+                    pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                    area(p->prev, p, p->next) >= 0.0)
+                    return false;
+            }
+            return true;
+        }
+
+        bool isEarHashed(const Node* ear) const
+        {
+            const Node* a = ear->prev;
+            const Node* b = ear;
+            const Node* c = ear->next;
+
+            if (area(a, b, c) >= 0.0) return false; // reflex
+
+            double x0 = osg::minimum(a->x, osg::minimum(b->x, c->x)), y0 = osg::minimum(a->y, osg::minimum(b->y, c->y));
+            double x1 = osg::maximum(a->x, osg::maximum(b->x, c->x)), y1 = osg::maximum(a->y, osg::maximum(b->y, c->y));
+
+            // z-order range of the triangle's bounding box
+            unsigned minZ = zOrder(x0, y0);
+            unsigned maxZ = zOrder(x1, y1);
+
+            const Node* p = ear->prevZ;
+            const Node* n = ear->nextZ;
+
+            // look for points inside the triangle in both directions
+            while (p && p->z >= minZ && n && n->z <= maxZ)
+            {
+                if (inEar(p, a, b, c, x0, y0, x1, y1)) return false;
+                p = p->prevZ;
+                if (inEar(n, a, b, c, x0, y0, x1, y1)) return false;
+                n = n->nextZ;
+            }
+
+            while (p && p->z >= minZ)
+            {
+                if (inEar(p, a, b, c, x0, y0, x1, y1)) return false;
+                p = p->prevZ;
+            }
+
+            while (n && n->z <= maxZ)
+            {
+                if (inEar(n, a, b, c, x0, y0, x1, y1)) return false;
+                n = n->nextZ;
+            }
+
+            return true;
+        }
+
+        static bool inEar(const Node* p, const Node* a, const Node* b, const Node* c, double x0, double y0, double x1, double y1)
+        {
+            return
+                p != a && p != c &&
+                p->x >= x0 && p->x <= x1 && p->y >= y0 && p->y <= y1 &&
+                pointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+                area(p->prev, p, p->next) >= 0.0;
+        }
+
+        // clips away small self-intersections (p->prev, p, p->next, p->next->next crossing)
+        Node* cureLocalIntersections(Node* start)
+        {
+            Node* p = start;
+            do
+            {
+                Node* a = p->prev;
+                Node* b = p->next->next;
+
+                if (!equals(a, b) && intersects(a, p, p->next, b) && locallyInside(a, b) && locallyInside(b, a))
+                {
+                    emit(a, p, b);
+                    removeNode(p);
+                    removeNode(p->next);
+                    p = start = b;
+                }
+                p = p->next;
+            }
+            while (p != start);
+
+            return filterPoints(p);
+        }
+
+        // splits the polygon along a valid diagonal and tessellates the halves
+        void splitEarcut(Node* start)
+        {
+            Node* a = start;
+            do
+            {
+                Node* b = a->next->next;
+                while (b != a->prev)
+                {
+                    if (a->i != b->i && isValidDiagonal(a, b))
+                    {
+                        Node* c = splitPolygon(a, b);
+                        a = filterPoints(a, a->next);
+                        c = filterPoints(c, c->next);
+                        earcutLinked(a, 0);
+                        earcutLinked(c, 0);
+                        return;
+                    }
+                    b = b->next;
+                }
+                a = a->next;
+            }
+            while (a != start);
+        }
+
+        struct LessX
+        {
+            bool operator()(const Node* a, const Node* b) const { return a->x < b->x; }
+        };
+
+        // links every hole into the outer loop, left to right
+        Node* eliminateHoles(const std::vector< std::pair<unsigned,unsigned> >& holes, Node* outer)
+        {
+            std::vector<Node*> queue;
+            queue.reserve(holes.size());
+            for (unsigned h = 0; h < holes.size(); ++h)
+            {
+                Node* list = linkedList(holes[h].first, holes[h].second, false);
+                if (list)
+                {
+                    if (list == list->next) list->steiner = true;
+                    queue.push_back(getLeftmost(list));
+                }
+            }
+
+            std::sort(queue.begin(), queue.end(), LessX());
+
+            for (unsigned h = 0; h < queue.size(); ++h)
+                outer = eliminateHole(queue[h], outer);
+
+            return outer;
+        }
+
+        Node* eliminateHole(Node* hole, Node* outer)
+        {
+            Node* bridge = findHoleBridge(hole, outer);
+            if (!bridge)
+                return outer;
+
+            Node* bridgeReverse = splitPolygon(bridge, hole);
+            filterPoints(bridgeReverse, bridgeReverse->next);
+            return filterPoints(bridge, bridge->next);
+        }
+
+        // finds a vertex of the outer loop that can see the hole's leftmost point
+        static Node* findHoleBridge(Node* hole, Node* outer)
+        {
+            Node* p = outer;
+            double hx = hole->x, hy = hole->y;
+            double qx = -DBL_MAX;
+            Node* m = 0L;
+
+            // cast a ray from the hole point to the left; the endpoint with the
+            // lesser x of the nearest segment it hits is a candidate.
+            do
+            {
+                if (hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+                {
+                    double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+                    if (x <= hx && x > qx)
+                    {
+                        qx = x;
+                        m = p->x < p->next->x ? p : p->next;
+                        if (x == hx) return m; // hole touches the outer segment
+                    }
+                }
+                p = p->next;
+            }
+            while (p != outer);
+
+            if (!m) return 0L;
+
+            // if other vertices fall inside the triangle (hole point, ray hit,
+            // candidate), use the one with the smallest angle to the ray.
+            Node* stop = m;
+            double mx = m->x, my = m->y;
+            double tanMin = DBL_MAX;
+            p = m;
+            do
+            {
+                if (hx >= p->x && p->x >= mx && hx != p->x &&
+                    pointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+                {
+                    double tan = fabs(hy - p->y) / (hx - p->x);
+                    if (locallyInside(p, hole) &&
+                        (tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && sectorContainsSector(m, p))))))
+                    {
+                        m = p;
+                        tanMin = tan;
+                    }
+                }
+                p = p->next;
+            }
+            while (p != stop);
+
+            return m;
+        }
+
+        static bool sectorContainsSector(const Node* m, const Node* p)
+        {
+            return area(m->prev, m, p->prev) < 0.0 && area(p->next, m, m->next) < 0.0;
+        }
+
+        unsigned zOrder(double px, double py) const
+        {
+            unsigned x = (unsigned)((px - _minX) * _invSize);
+            unsigned y = (unsigned)((py - _minY) * _invSize);
+
+            x = (x | (x << 8)) & 0x00FF00FF;
+            x = (x | (x << 4)) & 0x0F0F0F0F;
+            x = (x | (x << 2)) & 0x33333333;
+            x = (x | (x << 1)) & 0x55555555;
+
+            y = (y | (y << 8)) & 0x00FF00FF;
+            y = (y | (y << 4)) & 0x0F0F0F0F;
+            y = (y | (y << 2)) & 0x33333333;
+            y = (y | (y << 1)) & 0x55555555;
+
+            return x | (y << 1);
+        }
+
+        // links the nodes in z-order
+        void indexCurve(Node* start)
+        {
+            Node* p = start;
+            do
+            {
+                if (p->z == 0u) p->z = zOrder(p->x, p->y);
+                p->prevZ = p->prev;
+                p->nextZ = p->next;
+                p = p->next;
+            }
+            while (p != start);
+
+            p->prevZ->nextZ = 0L;
+            p->prevZ = 0L;
+
+            sortLinked(p);
+        }
+
+        // linked list merge sort on z (Simon Tatham)
+        static Node* sortLinked(Node* list)
+        {
+            unsigned inSize = 1;
+            unsigned numMerges;
+            do
+            {
+                Node* p = list;
+                Node* tail = 0L;
+                list = 0L;
+                numMerges = 0;
+
+                while (p)
+                {
+                    ++numMerges;
+                    Node* q = p;
+                    unsigned pSize = 0;
+                    for (unsigned i = 0; i < inSize; ++i)
+                    {
+                        ++pSize;
+                        q = q->nextZ;
+                        if (!q) break;
+                    }
+                    unsigned qSize = inSize;
+
+                    while (pSize > 0 || (qSize > 0 && q))
+                    {
+                        Node* e;
+                        if (pSize != 0 && (qSize == 0 || !q || p->z <= q->z))
+                        {
+                            e = p;
+                            p = p->nextZ;
+                            --pSize;
+                        }
+                        else
+                        {
+                            e = q;
+                            q = q->nextZ;
+                            --qSize;
+                        }
+
+                        if (tail) tail->nextZ = e;
+                        else list = e;
+
+                        e->prevZ = tail;
+                        tail = e;
+                    }
+                    p = q;
+                }
+
+                tail->nextZ = 0L;
+                inSize *= 2;
+            }
+            while (numMerges > 1);
+
+            return list;
+        }
+
+        static Node* getLeftmost(Node* start)
+        {
+            Node* p = start;
+            Node* leftmost = start;
+            do
+            {
+                if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+                    leftmost = p;
+                p = p->next;
+            }
+            while (p != start);
+            return leftmost;
+        }
+
+        // whether a diagonal lies in the polygon interior
+        static bool isValidDiagonal(const Node* a, const Node* b)
+        {
+            return
+                a->next->i != b->i && a->prev->i != b->i && !intersectsPolygon(a, b) &&
+                ((locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b) &&
+                  (area(a->prev, a, b->prev) != 0.0 || area(a, b->prev, b) != 0.0)) ||
+                 (equals(a, b) && area(a->prev, a, a->next) > 0.0 && area(b->prev, b, b->next) > 0.0));
+        }
+
+        static bool onSegment(const Node* p, const Node* q, const Node* r)
+        {
+            return
+                q->x <= osg::maximum(p->x, r->x) && q->x >= osg::minimum(p->x, r->x) &&
+                q->y <= osg::maximum(p->y, r->y) && q->y >= osg::minimum(p->y, r->y);
+        }
+
+        static bool intersects(const Node* p1, const Node* q1, const Node* p2, const Node* q2)
+        {
+            int o1 = sign(area(p1, q1, p2));
+            int o2 = sign(area(p1, q1, q2));
+            int o3 = sign(area(p2, q2, p1));
+            int o4 = sign(area(p2, q2, q1));
+
+            if (o1 != o2 && o3 != o4) return true;
+
+            if (o1 == 0 && onSegment(p1, p2, q1)) return true;
+            if (o2 == 0 && onSegment(p1, q2, q1)) return true;
+            if (o3 == 0 && onSegment(p2, p1, q2)) return true;
+            if (o4 == 0 && onSegment(p2, q1, q2)) return true;
+
+            return false;
+        }
+
+        static bool intersectsPolygon(const Node* a, const Node* b)
+        {
+            const Node* p = a;
+            do
+            {
+                if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
+                    intersects(p, p->next, a, b))
+                    return true;
+                p = p->next;
+            }
+            while (p != a);
+            return false;
+        }
+
+        static bool locallyInside(const Node* a, const Node* b)
+        {
+            return area(a->prev, a, a->next) < 0.0 ?
+                area(a, b, a->next) >= 0.0 && area(a, a->prev, b) >= 0.0 :
+                area(a, b, a->prev) < 0.0 || area(a, a->next, b) < 0.0;
+        }
+
+        static bool middleInside(const Node* a, const Node* b)
+        {
+            const Node* p = a;
+            bool inside = false;
+            double px = (a->x + b->x) / 2.0, py = (a->y + b->y) / 2.0;
+            do
+            {
+                if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+                    (px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+                    inside = !inside;
+                p = p->next;
+            }
+            while (p != a);
+            return inside;
+        }
+
+        // links two vertices with a bridge: splits a loop in two, or merges a hole into the outer loop.
+        Node* splitPolygon(Node* a, Node* b)
+        {
+            _nodes.push_back(Node(a->i, a->x, a->y));
+            Node* a2 = &_nodes.back();
+            _nodes.push_back(Node(b->i, b->x, b->y));
+            Node* b2 = &_nodes.back();
+
+            Node* an = a->next;
+            Node* bp = b->prev;
+
+            a->next = b;
+            b->prev = a;
+
+            a2->next = an;
+            an->prev = a2;
+
+            b2->next = a2;
+            a2->prev = b2;
+
+            bp->next = b2;
+            b2->prev = bp;
+
+            return b2;
+        }
+    };
+
+    struct Loop
+    {
+        unsigned first, last;
+        double   area;
+        double   xmin, ymin, xmax, ymax;
+        int      parent;
+        int      depth;
+    };
+
+    struct GreaterArea
+    {
+        bool operator()(const Loop& a, const Loop& b) const { return a.area > b.area; }
+    };
+
+    bool pointInLoop(const osg::Vec3Array& verts, const Loop& loop, double x, double y)
+    {
+        bool inside = false;
+        for (unsigned i = loop.first, j = loop.last-1; i < loop.last; j = i++)
+        {
+            const osg::Vec3& a = verts[i];
+            const osg::Vec3& b = verts[j];
+            if (((a.y() > y) != (b.y() > y)) &&
+                (x < (b.x() - a.x()) * (y - a.y()) / (b.y() - a.y()) + a.x()))
+                inside = !inside;
+        }
+        return inside;
+    }
+}
+
+bool
+Tessellator::tessellateFast(osg::Geometry &geom)
+{
+    osg::Vec3Array* vertices = dynamic_cast<osg::Vec3Array*>(geom.getVertexArray());
+
+    if (!vertices || vertices->empty() || geom.getPrimitiveSetList().empty()) return false;
+
+    // gather the loops; keep any other primitive sets as they are.
+    std::vector<Loop> loops;
+    osg::Geometry::PrimitiveSetList others;
+
+    const osg::Geometry::PrimitiveSetList& primSets = geom.getPrimitiveSetList();
+    for (unsigned p = 0; p < primSets.size(); ++p)
+    {
+        osg::PrimitiveSet* primitive = primSets[p].get();
+        if (primitive->getMode() != osg::PrimitiveSet::POLYGON && primitive->getMode() != osg::PrimitiveSet::LINE_LOOP)
+        {
+            others.push_back(primitive);
+            continue;
+        }
+
+        std::vector< std::pair<unsigned,unsigned> > ranges;
+        if (primitive->getType() == osg::PrimitiveSet::DrawArraysPrimitiveType)
+        {
+            osg::DrawArrays* da = static_cast<osg::DrawArrays*>(primitive);
+            ranges.push_back(std::make_pair((unsigned)da->getFirst(), (unsigned)(da->getFirst() + da->getCount())));
+        }
+        else if (primitive->getType() == osg::PrimitiveSet::DrawArrayLengthsPrimitiveType)
+        {
+            osg::DrawArrayLengths* dal = static_cast<osg::DrawArrayLengths*>(primitive);
+            unsigned first = dal->getFirst();
+            for (osg::DrawArrayLengths::const_iterator i = dal->begin(); i != dal->end(); ++i)
+            {
+                ranges.push_back(std::make_pair(first, first + *i));
+                first += *i;
+            }
+        }
+        else
+        {
+            OE_DEBUG << LC << "Primitive type " << primitive->getType() << " not handled" << std::endl;
+            return false;
+        }
+
+        for (unsigned r = 0; r < ranges.size(); ++r)
+        {
+            if (ranges[r].second > vertices->size())
+                return false;
+
+            if (ranges[r].second - ranges[r].first < 3)
+                continue;
+
+            Loop loop;
+            loop.first = ranges[r].first;
+            loop.last  = ranges[r].second;
+            loop.parent = -1;
+            loop.depth  = 0;
+
+            const osg::Vec3& v0 = (*vertices)[loop.first];
+            loop.xmin = loop.xmax = v0.x();
+            loop.ymin = loop.ymax = v0.y();
+
+            double sum = 0.0;
+            for (unsigned i = loop.first, j = loop.last-1; i < loop.last; j = i++)
+            {
+                const osg::Vec3& a = (*vertices)[i];
+                const osg::Vec3& b = (*vertices)[j];
+                sum += ((double)b.x() - a.x()) * ((double)a.y() + b.y());
+                loop.xmin = osg::minimum(loop.xmin, (double)a.x());
+                loop.ymin = osg::minimum(loop.ymin, (double)a.y());
+                loop.xmax = osg::maximum(loop.xmax, (double)a.x());
+                loop.ymax = osg::maximum(loop.ymax, (double)a.y());
+            }
+            loop.area = fabs(sum);
+            loops.push_back(loop);
+        }
+    }
+
+    if (loops.empty())
+        return false;
+
+    // nest the loops (largest first): a loop inside an outer loop is its hole,
+    // and a loop inside a hole starts a new outer loop.
+    std::sort(loops.begin(), loops.end(), GreaterArea());
+
+    for (unsigned k = 1; k < loops.size(); ++k)
+    {
+        Loop& loop = loops[k];
+        const osg::Vec3& v = (*vertices)[loop.first];
+        for (int j = (int)k-1; j >= 0; --j)
+        {
+            const Loop& other = loops[j];
+            if (loop.xmin >= other.xmin && loop.xmax <= other.xmax && loop.ymin >= other.ymin && loop.ymax <= other.ymax &&
+                pointInLoop(*vertices, other, v.x(), v.y()))
+            {
+                loop.parent = j;
+                loop.depth  = other.depth + 1;
+                break;
+            }
+        }
+    }
+
+    std::vector<unsigned> tris;
+    tris.reserve(3 * vertices->size());
+    FastTessellator tess(*vertices, tris);
+
+    std::vector< std::pair<unsigned,unsigned> > holes;
+    for (unsigned k = 0; k < loops.size(); ++k)
+    {
+        if (loops[k].depth % 2 != 0)
+            continue;
+
+        holes.clear();
+        for (unsigned h = k+1; h < loops.size(); ++h)
+        {
+            if (loops[h].parent == (int)k)
+                holes.push_back(std::make_pair(loops[h].first, loops[h].last));
+        }
+
+        if (!tess.run(loops[k].first, loops[k].last, holes))
+        {
+            OE_DEBUG << LC << "Fast tessellation failed!" << std::endl;
+            return false;
+        }
+    }
+
+    osg::DrawElementsUInt* triElements = new osg::DrawElementsUInt(osg::PrimitiveSet::TRIANGLES, tris.begin(), tris.end());
+
+    // keep the user data the polygon carried (e.g. feature index tags).
+    triElements->setUserData(primSets[0]->getUserData());
+
+    others.push_back(triElements);
+    geom.setPrimitiveSetList(others);
+
+    return true;
+}
@@ -0,0 +1,211 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/TileCheckpoint>
+#include <osgEarth/TileHandler>
+#include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+#include <osgDB/FileUtils>
+#include <fstream>
+#include <cstdio>
+
+#define LC "[TileCheckpoint] "
+
+using namespace osgEarth;
+
+namespace
+{
+    const char* HEADER = "osgearth_tile_checkpoint";
+    const int   VERSION = 1;
+
+    // Tiles are grouped into 8x8 blocks per LOD, one bit per tile.
+    inline unsigned blockBit(unsigned x, unsigned y)
+    {
+        return ((y & 7u) << 3) | (x & 7u);
+    }
+}
+
+TileCheckpoint::TileCheckpoint(const std::string& filename) :
+_filename    ( filename ),
+_saveInterval( 30.0 ),
+_lastSave    ( osg::Timer::instance()->tick() ),
+_numComplete ( 0u )
+{
+}
+
+unsigned
+TileCheckpoint::countBits(unsigned long long bits)
+{
+    unsigned count = 0u;
+    for( ; bits; ++count )
+        bits &= bits - 1ull;
+    return count;
+}
+
+bool
+TileCheckpoint::open(const Profile* profile)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    _blocks.clear();
+    _numComplete = 0u;
+    _signature = profile ? profile->getHorizSignature() : "none";
+    _lastSave = osg::Timer::instance()->tick();
+
+    // Fall back on the temporary file if we were interrupted in the middle
+    // of replacing the checkpoint.
+    std::string filename = _filename;
+    if ( !osgDB::fileExists(filename) )
+    {
+        filename = _filename + ".tmp";
+        if ( !osgDB::fileExists(filename) )
+            return false;
+    }
+
+    std::ifstream in( filename.c_str() );
+    std::string header, signature;
+    int version = 0;
+    in >> header >> version >> signature;
+    if ( !in || header != HEADER || version != VERSION )
+    {
+        OE_WARN << LC << "Ignoring unrecognized checkpoint file \"" << filename << "\"" << std::endl;
+        return false;
+    }
+
+    if ( signature != _signature )
+    {
+        OE_WARN << LC << "Checkpoint \"" << filename << "\" was written for a different profile; starting over" << std::endl;
+        return false;
+    }
+
+    unsigned lod, bx, by;
+    unsigned long long bits;
+    while( in >> lod >> bx >> by >> std::hex >> bits >> std::dec )
+    {
+        unsigned long long& block = _blocks[BlockKey(lod, bx, by)];
+        _numComplete += countBits( bits & ~block );
+        block |= bits;
+    }
+
+    OE_INFO << LC << "Resuming from \"" << filename << "\" with " << _numComplete << " completed tiles" << std::endl;
+    return true;
+}
+
+bool
+TileCheckpoint::isComplete(const TileKey& key) const
+{
+    unsigned x, y;
+    key.getTileXY(x, y);
+
+    Threading::ScopedMutexLock lock(_mutex);
+    Blocks::const_iterator i = _blocks.find( BlockKey(key.getLevelOfDetail(), x >> 3, y >> 3) );
+    return i != _blocks.end() && (i->second & (1ull << blockBit(x, y))) != 0ull;
+}
+
+void
+TileCheckpoint::markComplete(const TileKey& key)
+{
+    unsigned x, y;
+    key.getTileXY(x, y);
+    unsigned long long bit = 1ull << blockBit(x, y);
+
+    Threading::ScopedMutexLock lock(_mutex);
+    unsigned long long& block = _blocks[BlockKey(key.getLevelOfDetail(), x >> 3, y >> 3)];
+    if ( (block & bit) == 0ull )
+    {
+        block |= bit;
+        ++_numComplete;
+    }
+}
+
+unsigned
+TileCheckpoint::getNumComplete() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _numComplete;
+}
+
+bool
+TileCheckpoint::isSaveDue()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    if ( osg::Timer::instance()->delta_s(_lastSave, now) < _saveInterval )
+        return false;
+    _lastSave = now;
+    return true;
+}
+
+bool
+TileCheckpoint::save(TileHandler* handler)
+{
+    // One writer at a time; the completed set keeps growing while we write.
+    Threading::ScopedMutexLock saveLock(_saveMutex);
+
+    Blocks blocks;
+    std::string signature;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        blocks = _blocks;
+        signature = _signature;
+        _lastSave = osg::Timer::instance()->tick();
+    }
+
+    // Make sure everything recorded in the snapshot has actually been stored.
+    if ( handler )
+        handler->flush();
+
+    osgEarth::makeDirectoryForFile( _filename );
+
+    // Write to a temporary file and swap it in, so a crash mid-write never
+    // leaves us without a usable checkpoint.
+    std::string tmp = _filename + ".tmp";
+    {
+        std::ofstream out( tmp.c_str(), std::ios::out | std::ios::trunc );
+        if ( !out.is_open() )
+        {
+            OE_WARN << LC << "Failed to write checkpoint \"" << tmp << "\"" << std::endl;
+            return false;
+        }
+
+        out << HEADER << " " << VERSION << " " << signature << "\n";
+        for(Blocks::const_iterator i = blocks.begin(); i != blocks.end(); ++i)
+        {
+            out << i->first._lod << " " << i->first._bx << " " << i->first._by << " "
+                << std::hex << i->second << std::dec << "\n";
+        }
+
+        out.flush();
+        if ( !out )
+        {
+            OE_WARN << LC << "Failed to write checkpoint \"" << tmp << "\"" << std::endl;
+            return false;
+        }
+    }
+
+    ::remove( _filename.c_str() );
+    if ( ::rename( tmp.c_str(), _filename.c_str() ) != 0 )
+    {
+        OE_WARN << LC << "Failed to replace checkpoint \"" << _filename << "\"" << std::endl;
+        return false;
+    }
+
+    OE_DEBUG << LC << "Saved " << blocks.size() << " blocks to \"" << _filename << "\"" << std::endl;
+    return true;
+}
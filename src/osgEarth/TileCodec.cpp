@@ -0,0 +1,389 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/TileCodec>
+#include <osgEarth/Notify>
+#include <osgEarth/HeightFieldUtils>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osgDB/Registry>
+#include <osgDB/ObjectWrapper>
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+using namespace osgEarth;
+
+#define LC "[TileCodec] "
+
+namespace
+{
+    const char     MAGIC[4] = { 'O', 'E', 'T', 'C' };
+    const unsigned VERSION  = 1u;
+
+    enum TileType
+    {
+        TYPE_IMAGE       = 1,
+        TYPE_HEIGHTFIELD = 2,
+        TYPE_QUANTIZED_HEIGHTFIELD = 3
+    };
+
+    struct Header
+    {
+        char     _magic[4];
+        unsigned _version;
+        unsigned _type;
+        unsigned _compressorLength;
+    };
+
+    struct ImageHeader
+    {
+        int      _s, _t, _r;
+        int      _internalFormat;
+        unsigned _pixelFormat;
+        unsigned _dataType;
+        unsigned _packing;
+        unsigned _reserved;
+    };
+
+    struct HeightFieldHeader
+    {
+        unsigned _numColumns;
+        unsigned _numRows;
+        double   _origin[3];
+        double   _rotation[4];
+        float    _xInterval;
+        float    _yInterval;
+        float    _skirtHeight;
+        unsigned _borderWidth;
+    };
+
+    struct QuantizationHeader
+    {
+        float _offset;
+        float _scale;
+    };
+
+    template<typename T>
+    inline void writeBinary(std::ostream& out, const T& value)
+    {
+        out.write( (const char*)&value, sizeof(T) );
+    }
+
+    template<typename T>
+    inline bool readBinary(std::istream& in, T& value)
+    {
+        in.read( (char*)&value, sizeof(T) );
+        return in.good();
+    }
+
+    bool writeBuffer(std::ostream& out, const char* data, unsigned length, osgDB::BaseCompressor* compressor)
+    {
+        if ( compressor )
+        {
+            return compressor->compress( out, std::string(data, length) );
+        }
+        else
+        {
+            writeBinary( out, length );
+            out.write( data, length );
+            return out.good();
+        }
+    }
+
+    bool readBuffer(std::istream& in, std::string& buf, osgDB::BaseCompressor* compressor)
+    {
+        if ( compressor )
+        {
+            return compressor->decompress( in, buf );
+        }
+        else
+        {
+            unsigned length = 0u;
+            if ( !readBinary(in, length) )
+                return false;
+            buf.resize( length );
+            if ( length > 0u )
+                in.read( &buf[0], length );
+            return !in.fail();
+        }
+    }
+
+    osgDB::BaseCompressor* findCompressor(const std::string& name)
+    {
+        if ( name.empty() )
+            return 0L;
+        return osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor( name );
+    }
+}
+
+bool
+TileCodec::canEncode(const osg::Object* object)
+{
+    if ( !object )
+        return false;
+
+    // only the base classes; subclasses may carry state we would lose.
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if ( image )
+    {
+        return
+            std::string(image->libraryName()) == "osg" &&
+            std::string(image->className()) == "Image" &&
+            image->data() != 0L &&
+            !image->isMipmap() &&
+            image->isDataContiguous();
+    }
+
+    const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+    if ( hf )
+    {
+        return
+            std::string(hf->libraryName()) == "osg" &&
+            std::string(hf->className()) == "HeightField" &&
+            hf->getFloatArray() != 0L;
+    }
+
+    return false;
+}
+
+bool
+TileCodec::encode(const osg::Object* object, std::ostream& out, const std::string& compressorName, bool quantizeHeights)
+{
+    if ( !canEncode(object) )
+        return false;
+
+    osgDB::BaseCompressor* compressor = findCompressor(compressorName);
+    if ( !compressorName.empty() && !compressor )
+    {
+        OE_WARN << LC << "Compressor \"" << compressorName << "\" is not available" << std::endl;
+        return false;
+    }
+
+    Header header;
+    ::memcpy( header._magic, MAGIC, 4 );
+    header._version = VERSION;
+    header._compressorLength = compressor ? compressorName.size() : 0u;
+
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if ( image )
+    {
+        header._type = TYPE_IMAGE;
+        writeBinary( out, header );
+        if ( compressor )
+            out.write( compressorName.data(), compressorName.size() );
+
+        ImageHeader ih;
+        ::memset( &ih, 0, sizeof(ImageHeader) );
+        ih._s              = image->s();
+        ih._t              = image->t();
+        ih._r              = image->r();
+        ih._internalFormat = image->getInternalTextureFormat();
+        ih._pixelFormat    = image->getPixelFormat();
+        ih._dataType       = image->getDataType();
+        ih._packing        = image->getPacking();
+        writeBinary( out, ih );
+
+        return writeBuffer( out, (const char*)image->data(), image->getTotalSizeInBytes(), compressor );
+    }
+
+    const osg::HeightField* hf = static_cast<const osg::HeightField*>(object);
+    header._type = quantizeHeights ? TYPE_QUANTIZED_HEIGHTFIELD : TYPE_HEIGHTFIELD;
+    writeBinary( out, header );
+    if ( compressor )
+        out.write( compressorName.data(), compressorName.size() );
+
+    HeightFieldHeader hh;
+    ::memset( &hh, 0, sizeof(HeightFieldHeader) );
+    hh._numColumns  = hf->getNumColumns();
+    hh._numRows     = hf->getNumRows();
+    hh._origin[0]   = hf->getOrigin().x();
+    hh._origin[1]   = hf->getOrigin().y();
+    hh._origin[2]   = hf->getOrigin().z();
+    hh._rotation[0] = hf->getRotation().x();
+    hh._rotation[1] = hf->getRotation().y();
+    hh._rotation[2] = hf->getRotation().z();
+    hh._rotation[3] = hf->getRotation().w();
+    hh._xInterval   = hf->getXInterval();
+    hh._yInterval   = hf->getYInterval();
+    hh._skirtHeight = hf->getSkirtHeight();
+    hh._borderWidth = hf->getBorderWidth();
+    writeBinary( out, hh );
+
+    if ( quantizeHeights )
+    {
+        std::vector<unsigned short> quantized( hf->getNumColumns()*hf->getNumRows() );
+        QuantizationHeader qh;
+        if ( !quantized.empty() )
+            HeightFieldUtils::quantizeHeights( hf, &quantized[0], qh._offset, qh._scale );
+        else
+            qh._offset = qh._scale = 0.0f;
+        writeBinary( out, qh );
+
+        const char* data = quantized.empty() ? "" : (const char*)&quantized[0];
+        return writeBuffer( out, data, quantized.size()*sizeof(unsigned short), compressor );
+    }
+
+    const osg::FloatArray* heights = hf->getFloatArray();
+    return writeBuffer( out, (const char*)heights->getDataPointer(), heights->getTotalDataSize(), compressor );
+}
+
+bool
+TileCodec::isEncoded(std::istream& in)
+{
+    std::streampos pos = in.tellg();
+    char magic[4];
+    in.read( magic, 4 );
+    bool encoded = in.good() && ::memcmp(magic, MAGIC, 4) == 0;
+    in.clear();
+    in.seekg( pos );
+    return encoded;
+}
+
+osg::Object*
+TileCodec::decode(std::istream& in)
+{
+    Header header;
+    if ( !readBinary(in, header) || ::memcmp(header._magic, MAGIC, 4) != 0 )
+        return 0L;
+
+    if ( header._version != VERSION )
+    {
+        OE_WARN << LC << "Unsupported encoding version " << header._version << std::endl;
+        return 0L;
+    }
+
+    osgDB::BaseCompressor* compressor = 0L;
+    if ( header._compressorLength > 0u )
+    {
+        if ( header._compressorLength > 64u )
+            return 0L;
+        std::string name( header._compressorLength, '\0' );
+        in.read( &name[0], header._compressorLength );
+        compressor = findCompressor( name );
+        if ( !compressor )
+        {
+            OE_WARN << LC << "Compressor \"" << name << "\" is not available" << std::endl;
+            return 0L;
+        }
+    }
+
+    std::string buf;
+
+    if ( header._type == TYPE_IMAGE )
+    {
+        ImageHeader ih;
+        if ( !readBinary(in, ih) || !readBuffer(in, buf, compressor) )
+            return 0L;
+
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage( ih._s, ih._t, ih._r, ih._pixelFormat, ih._dataType, ih._packing );
+        image->setInternalTextureFormat( ih._internalFormat );
+        if ( image->getTotalSizeInBytes() != buf.size() )
+        {
+            OE_WARN << LC << "Image buffer size mismatch" << std::endl;
+            return 0L;
+        }
+        ::memcpy( image->data(), buf.data(), buf.size() );
+        return image.release();
+    }
+
+    else if ( header._type == TYPE_HEIGHTFIELD || header._type == TYPE_QUANTIZED_HEIGHTFIELD )
+    {
+        bool quantized = header._type == TYPE_QUANTIZED_HEIGHTFIELD;
+
+        HeightFieldHeader hh;
+        QuantizationHeader qh;
+        if ( !readBinary(in, hh) || (quantized && !readBinary(in, qh)) || !readBuffer(in, buf, compressor) )
+            return 0L;
+
+        unsigned sampleSize = quantized ? sizeof(unsigned short) : sizeof(float);
+        if ( buf.size() != hh._numColumns*hh._numRows*sampleSize )
+        {
+            OE_WARN << LC << "Heightfield buffer size mismatch" << std::endl;
+            return 0L;
+        }
+
+        osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+        hf->allocate( hh._numColumns, hh._numRows );
+        hf->setOrigin( osg::Vec3(hh._origin[0], hh._origin[1], hh._origin[2]) );
+        hf->setRotation( osg::Quat(hh._rotation[0], hh._rotation[1], hh._rotation[2], hh._rotation[3]) );
+        hf->setXInterval( hh._xInterval );
+        hf->setYInterval( hh._yInterval );
+        hf->setSkirtHeight( hh._skirtHeight );
+        hf->setBorderWidth( hh._borderWidth );
+        if ( buf.empty() )
+            return hf.release();
+
+        if ( quantized )
+        {
+            // copy out first, since the string data need not be aligned for shorts.
+            std::vector<unsigned short> samples( hh._numColumns*hh._numRows );
+            ::memcpy( &samples[0], buf.data(), buf.size() );
+            HeightFieldUtils::dequantizeHeights( &samples[0], samples.size(), qh._offset, qh._scale, &hf->getFloatArray()->front() );
+        }
+        else
+        {
+            ::memcpy( &hf->getFloatArray()->front(), buf.data(), buf.size() );
+        }
+        return hf.release();
+    }
+
+    return 0L;
+}
+
+bool
+TileCodec::parseEncoding(const std::string& encoding, std::string& out_compressor)
+{
+    if ( encoding == "raw" )
+    {
+        out_compressor.clear();
+        return true;
+    }
+    else if ( encoding.empty() || encoding == "osgb" )
+    {
+        return false;
+    }
+    else
+    {
+        // any other value names an osgDB compressor, e.g. "zlib"
+        out_compressor = encoding;
+        return true;
+    }
+}
+
+bool
+TileCodec::parseEncoding(const std::string& encoding, std::string& out_compressor, bool& out_quantizeHeights)
+{
+    out_quantizeHeights = false;
+
+    if ( encoding == "q16" )
+    {
+        out_quantizeHeights = true;
+        out_compressor.clear();
+        return true;
+    }
+    else if ( encoding.size() > 4 && encoding.compare(0, 4, "q16+") == 0 )
+    {
+        out_quantizeHeights = true;
+        out_compressor = encoding.substr(4);
+        return true;
+    }
+
+    return parseEncoding( encoding, out_compressor );
+}
@@ -39,3 +39,7 @@ std::string TileHandler::getProcessString() const
 {
     return "";
 }
+
+void TileHandler::flush()
+{
+}
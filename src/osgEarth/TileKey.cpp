@@ -19,6 +19,7 @@
 
 #include <osgEarth/TileKey>
 #include <osgEarth/StringUtils>
+#include <cstdio>
 
 using namespace osgEarth;
 
@@ -28,11 +29,23 @@ TileKey TileKey::INVALID( 0, 0, 0, 0L );
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    inline unsigned long long pack(unsigned lod, unsigned x, unsigned y)
+    {
+        return
+            ((unsigned long long)(lod & 0x3Fu) << 58) |
+            ((unsigned long long)(x & 0x1FFFFFFFu) << 29) |
+            ((unsigned long long)(y & 0x1FFFFFFFu));
+    }
+}
+
 TileKey::TileKey(unsigned int lod, unsigned int tile_x, unsigned int tile_y, const Profile* profile)
 {
     _x = tile_x;
     _y = tile_y;
     _lod = lod;
+    _packed = pack(lod, tile_x, tile_y);
     _profile = profile;
 
     double width, height;
@@ -46,27 +59,36 @@ TileKey::TileKey(unsigned int lod, unsigned int tile_x, unsigned int tile_y, con
         double ymin = ymax - height;
 
         _extent = GeoExtent( _profile->getSRS(), xmin, ymin, xmax, ymax );
-
-        _key = Stringify() << _lod << "/" << _x << "/" << _y;
     }
     else
     {
         _extent = GeoExtent::INVALID;
-        _key = "invalid";
     }
 }
 
 TileKey::TileKey( const TileKey& rhs ) :
-_key( rhs._key ),
 _lod(rhs._lod),
 _x(rhs._x),
 _y(rhs._y),
+_packed(rhs._packed),
 _profile( rhs._profile.get() ),
 _extent( rhs._extent )
 {
     //NOP
 }
 
+std::string
+TileKey::str() const
+{
+    if ( !_profile.valid() )
+        return "invalid";
+
+    // Cheaper than a stringstream, since this ends up in every cache key.
+    char buf[36];
+    sprintf( buf, "%u/%u/%u", _lod, _x, _y );
+    return buf;
+}
+
 const Profile*
 TileKey::getProfile() const
 {
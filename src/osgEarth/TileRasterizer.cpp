@@ -23,6 +23,7 @@
 #include <osg/MatrixTransform>
 #include <osg/FrameBufferObject>
 #include <osgDB/ReadFile>
+#include <cstdlib>
 
 #define LC "[TileRasterizer] "
 
@@ -64,21 +65,21 @@ namespace
 }
 
 TileRasterizer::TileRasterizer() :
-osg::Camera()
+osg::Camera(),
+_maxJobsPerFrame( 8u )
 {
+    const char* jobs = ::getenv("OSGEARTH_TILE_RASTERIZER_JOBS");
+    if ( jobs )
+        _maxJobsPerFrame = osg::maximum( 1, atoi(jobs) );
+
     // active an update traversal.
     setNumChildrenRequiringUpdateTraversal(1);
     setCullingActive(false);
 
-    // set up the RTT camera.
-    setClearColor(osg::Vec4(0,0,0,0));
-    setClearMask(GL_COLOR_BUFFER_BIT);
+    // This camera only holds the shared state; each job renders through a
+    // pre-render RTT child camera of its own (see createJobCamera).
     setReferenceFrame(ABSOLUTE_RF);
-    //setComputeNearFarMode( osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR );
-    setRenderOrder(PRE_RENDER);
-    setRenderTargetImplementation(FRAME_BUFFER_OBJECT);
-    setImplicitBufferAttachmentMask(0, 0);
-    setSmallFeatureCullingPixelSize(0.0f);
+    setRenderOrder(NESTED_RENDER);
     setViewMatrix(osg::Matrix::identity());
 
     osg::StateSet* ss = getOrCreateStateSet();
@@ -87,9 +88,6 @@ osg::Camera()
     ss->setMode(GL_BLEND, 0);
     ss->setMode(GL_LIGHTING, 0);
     ss->setMode(GL_CULL_FACE, 0);
-    
-    this->setPreDrawCallback(new PreDrawRouter<TileRasterizer>(this));
-    this->setPostDrawCallback(new PostDrawRouter<TileRasterizer>(this));
 
 #if 0 // works in OE, not in VRV :(
     osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits();
@@ -124,6 +122,27 @@ TileRasterizer::~TileRasterizer()
     OE_DEBUG << LC << "~TileRasterizer\n";
 }
 
+osg::Camera*
+TileRasterizer::createJobCamera()
+{
+    osg::Camera* camera = new osg::Camera();
+    camera->setCullingActive(false);
+    camera->setClearColor(osg::Vec4(0,0,0,0));
+    camera->setClearMask(GL_COLOR_BUFFER_BIT);
+    camera->setReferenceFrame(ABSOLUTE_RF);
+    //camera->setComputeNearFarMode( osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR );
+    camera->setRenderOrder(PRE_RENDER);
+    camera->setRenderTargetImplementation(FRAME_BUFFER_OBJECT);
+    camera->setImplicitBufferAttachmentMask(0, 0);
+    camera->setSmallFeatureCullingPixelSize(0.0f);
+    camera->setViewMatrix(osg::Matrix::identity());
+
+    camera->setPreDrawCallback(new PreDrawRouter<TileRasterizer>(this));
+    camera->setPostDrawCallback(new PostDrawRouter<TileRasterizer>(this));
+
+    return camera;
+}
+
 void
 TileRasterizer::push(osg::Node* node, osg::Texture* texture, const GeoExtent& extent)
 {
@@ -186,22 +205,52 @@ TileRasterizer::traverse(osg::NodeVisitor& nv)
     {
         Threading::ScopedMutexLock lock(_mutex);
 
-        if (!_finishedJobs.empty())
+        // Retire the jobs that rendered (and read back) in a previous frame:
+        while (!_finishedJobs.empty())
         {
             Job& job = _finishedJobs.front();
-            removeChild(job._node.get());
-            job._imagePromise.resolve(job._image.get());
+
+            osg::Camera* camera = job._camera.get();
+            removeChild(camera);
+            camera->removeChildren(0, camera->getNumChildren());
+            camera->detach(osg::Camera::COLOR_BUFFER);
+            camera->dirtyAttachmentMap();
+            _idleCameras.push_back(camera);
+
+            if (job._image.valid())
+                job._imagePromise.resolve(job._image.get());
+
             _finishedJobs.pop(); 
-            detach(osg::Camera::COLOR_BUFFER);
-            dirtyAttachmentMap();
         }
 
-        if (!_pendingJobs.empty() && _readbackJobs.empty() && _finishedJobs.empty())
+        // Start as many pending jobs as the budget allows; each one gets its own
+        // RTT camera so they all render in the same frame.
+        unsigned started = 0u;
+        while (!_pendingJobs.empty() && started < _maxJobsPerFrame)
         {
             Job& job = _pendingJobs.front();
 
+            // Nobody is waiting for this image any more; skip it.
+            if (job._image.valid() && job._imagePromise.isAbandoned())
+            {
+                _pendingJobs.pop();
+                continue;
+            }
+
+            if (!_idleCameras.empty())
+            {
+                job._camera = _idleCameras.back();
+                _idleCameras.pop_back();
+            }
+            else
+            {
+                job._camera = createJobCamera();
+            }
+
+            osg::Camera* camera = job._camera.get();
+
             // Configure a top-down orothographic camera:
-            setProjectionMatrixAsOrtho2D(
+            camera->setProjectionMatrixAsOrtho2D(
                 job._extent.xMin(), job._extent.xMax(),
                 job._extent.yMin(), job._extent.yMax());
 
@@ -209,34 +258,32 @@ TileRasterizer::traverse(osg::NodeVisitor& nv)
             if (job._texture.valid())
             {
                 // Setup the viewport and attach to the new texture
-                setViewport(0, 0, job._texture->getTextureWidth(), job._texture->getTextureHeight());
-                attach(COLOR_BUFFER, job._texture.get(), 0u, 0u, /*mipmap=*/false);
-                dirtyAttachmentMap();
+                camera->setViewport(0, 0, job._texture->getTextureWidth(), job._texture->getTextureHeight());
+                camera->attach(COLOR_BUFFER, job._texture.get(), 0u, 0u, /*mipmap=*/false);
+                camera->dirtyAttachmentMap();
             }
 
             // Job includes an image to populate, so use the built-in FBO target texture:
             else if (job._image.valid())
             {
-                setViewport(0, 0, job._image->s(), job._image->t());
-                attach(COLOR_BUFFER, job._image.get(), 0u, 0u);
-                dirtyAttachmentMap();
+                camera->setViewport(0, 0, job._image->s(), job._image->t());
+                camera->attach(COLOR_BUFFER, job._image.get(), 0u, 0u);
+                camera->dirtyAttachmentMap();
             }
 
             // Add the node to the scene graph so it'll get rendered.
-            addChild(job._node.get());
+            camera->addChild(job._node.get());
+            addChild(camera);
 
-            // If this job has a readback image, push the job to the next queue
-            // where it will be picked up for readback.
-            if (job._image.valid())
-            {
-                _readbackJobs.push(job);
-            }
+            // The job waits here until its camera has drawn (postDraw).
+            _activeJobs.push_back(job);
 
-            // Remove the texture from the queue.
+            // Remove the job from the queue.
             _pendingJobs.pop();
+            ++started;
             //OE_INFO << LC
             //    << "P=" << _pendingJobs.size()
-            //    << ", R=" << _readbackJobs.size()
+            //    << ", A=" << _activeJobs.size()
             //    << ", F=" << _finishedJobs.size()
             //    << std::endl;
         }
@@ -252,17 +299,18 @@ TileRasterizer::traverse(osg::NodeVisitor& nv)
 void
 TileRasterizer::preDraw(osg::RenderInfo& ri) const
 {
-    if (!_readbackJobs.empty())
-    {
-        Threading::ScopedMutexLock lock(_mutex);
+    Threading::ScopedMutexLock lock(_mutex);
 
-        if (!_readbackJobs.empty()) // double check!
+    const osg::Camera* camera = ri.getCurrentCamera();
+    for (JobList::iterator i = _activeJobs.begin(); i != _activeJobs.end(); ++i)
+    {
+        if (i->_camera.get() == camera)
         {
-            Job& job = _readbackJobs.front();
-            if (job._image.valid())
+            if (i->_image.valid())
             {
-                job._image.get()->_ri = &ri;
+                i->_image.get()->_ri = &ri;
             }
+            break;
         }
     }
 }
@@ -270,15 +318,18 @@ TileRasterizer::preDraw(osg::RenderInfo& ri) const
 void
 TileRasterizer::postDraw(osg::RenderInfo& ri) const
 {
-    if (!_readbackJobs.empty())
-    {
-        Threading::ScopedMutexLock lock(_mutex);
+    Threading::ScopedMutexLock lock(_mutex);
 
-        if (!_readbackJobs.empty()) // double check!
+    // The camera has rendered (and read back its image, if any), so the job is
+    // done; the update traversal will retire it.
+    const osg::Camera* camera = ri.getCurrentCamera();
+    for (JobList::iterator i = _activeJobs.begin(); i != _activeJobs.end(); ++i)
+    {
+        if (i->_camera.get() == camera)
         {
-            Job& job = _readbackJobs.front();
-            _finishedJobs.push(job);
-            _readbackJobs.pop();
+            _finishedJobs.push(*i);
+            _activeJobs.erase(i);
+            break;
         }
     }
 }
@@ -41,22 +41,48 @@ using namespace osgEarth;
 //------------------------------------------------------------------------
 
 TileBlacklist::TileBlacklist() :
-_tiles(true, 1024)
+_tiles(true, 1024),
+_ttl  (0),
+_dirty(0)
 {
     //NOP
 }
 
+TimeStamp
+TileBlacklist::expiry() const
+{
+    return _ttl > 0 ? DateTime().asTimeStamp() + _ttl : 0;
+}
+
 void
 TileBlacklist::add(const TileKey& key)
 {
-    _tiles.insert(key, true);
+    _tiles.insert(key, expiry());
+    _dirty.exchange(1);
     OE_DEBUG << "Added " << key.str() << " to blacklist" << std::endl;
 }
 
+void
+TileBlacklist::addSubtree(const TileKey& key)
+{
+    if (contains(key))
+        return;
+
+    Threading::ScopedMutexLock lock(_subtreesMutex);
+    _subtrees[key] = expiry();
+    _dirty.exchange(1);
+    OE_DEBUG << "Added subtree " << key.str() << " to blacklist" << std::endl;
+}
+
 void
 TileBlacklist::remove(const TileKey& key)
 {
     _tiles.erase(key);
+    {
+        Threading::ScopedMutexLock lock(_subtreesMutex);
+        _subtrees.erase(key);
+    }
+    _dirty.exchange(1);
     OE_DEBUG << "Removed " << key.str() << " from blacklist" << std::endl;
 }
 
@@ -64,19 +90,61 @@ void
 TileBlacklist::clear()
 {
     _tiles.clear();
+    {
+        Threading::ScopedMutexLock lock(_subtreesMutex);
+        _subtrees.clear();
+    }
+    _dirty.exchange(1);
     OE_DEBUG << "Cleared blacklist" << std::endl;
 }
 
 bool
 TileBlacklist::contains(const TileKey& key) const
 {
-    return _tiles.has(key);
+    TimeStamp now = DateTime().asTimeStamp();
+
+    LRUCache<TileKey, TimeStamp>::Record rec;
+    if (_tiles.get(key, rec))
+    {
+        if (rec.value() == 0 || rec.value() > now)
+            return true;
+        _tiles.erase(key);
+    }
+
+    Threading::ScopedMutexLock lock(_subtreesMutex);
+    if (_subtrees.empty())
+        return false;
+
+    // look for a blacklisted subtree rooted at this tile or at any ancestor:
+    for (TileKey k = key; k.valid(); k = k.createParentKey())
+    {
+        Subtrees::iterator i = _subtrees.find(k);
+        if (i != _subtrees.end())
+        {
+            if (i->second == 0 || i->second > now)
+                return true;
+            _subtrees.erase(i);
+        }
+        if (k.getLOD() == 0)
+            break;
+    }
+    return false;
 }
 
 TileBlacklist*
 TileBlacklist::read(std::istream &in)
 {
     osg::ref_ptr< TileBlacklist > result = new TileBlacklist();
+    result->append(in);
+    return result.release();
+}
+
+void
+TileBlacklist::append(std::istream &in)
+{
+    // Each line is "z x y", optionally followed by the expiry time and
+    // an asterisk marking a subtree.
+    TimeStamp now = DateTime().asTimeStamp();
 
     while (!in.eof())
     {
@@ -85,15 +153,24 @@ TileBlacklist::read(std::istream &in)
         if (!line.empty())
         {
             int z, x, y;
-            if (sscanf(line.c_str(), "%d %d %d", &z, &x, &y) == 3)
+            long expires = 0;
+            char subtree = 0;
+            int n = sscanf(line.c_str(), "%d %d %d %ld %c", &z, &x, &y, &expires, &subtree);
+            if (n >= 3 && (n < 4 || expires == 0 || expires > now))
             {
-                result->add(TileKey(z, x, y, 0L));
+                TileKey key(z, x, y, 0L);
+                if (subtree == '*')
+                {
+                    Threading::ScopedMutexLock lock(_subtreesMutex);
+                    _subtrees[key] = (TimeStamp)expires;
+                }
+                else
+                {
+                    _tiles.insert(key, (TimeStamp)expires);
+                }
             }
-
         }
     }
-
-    return result.release();
 }
 
 TileBlacklist*
@@ -121,11 +198,13 @@ TileBlacklist::write(const std::string &filename) const
 }
 
 namespace {
-    struct WriteFunctor : public LRUCache<TileKey,bool>::Functor {
+    struct WriteFunctor : public LRUCache<TileKey,TimeStamp>::Functor {
         std::ostream& _out;
-        WriteFunctor(std::ostream& out) : _out(out) { }
-        void operator()(const TileKey& key, const bool& value) {
-            _out << key.getLOD() << ' ' << key.getTileX() << ' ' << key.getTileY() << std::endl;
+        TimeStamp _now;
+        WriteFunctor(std::ostream& out, TimeStamp now) : _out(out), _now(now) { }
+        void operator()(const TileKey& key, const TimeStamp& expires) {
+            if (expires == 0 || expires > _now)
+                _out << key.getLOD() << ' ' << key.getTileX() << ' ' << key.getTileY() << ' ' << (long)expires << std::endl;
         }
     };
 }
@@ -133,8 +212,20 @@ namespace {
 void
 TileBlacklist::write(std::ostream &output) const
 {
-    WriteFunctor writer(output);
+    // Reset first, so an entry added while we write marks it dirty again.
+    _dirty.exchange(0);
+
+    TimeStamp now = DateTime().asTimeStamp();
+
+    WriteFunctor writer(output, now);
     _tiles.iterate(writer);
+
+    Threading::ScopedMutexLock lock(_subtreesMutex);
+    for (Subtrees::const_iterator i = _subtrees.begin(); i != _subtrees.end(); ++i)
+    {
+        if (i->second == 0 || i->second > now)
+            output << i->first.getLOD() << ' ' << i->first.getTileX() << ' ' << i->first.getTileY() << ' ' << (long)i->second << " *" << std::endl;
+    }
 }
 
 
@@ -143,9 +234,16 @@ TileBlacklist::write(std::ostream &output) const
 
 TileSourceOptions::TileSourceOptions( const ConfigOptions& options ) :
 DriverConfigOptions   ( options ),
+_blacklistSubtrees    ( false ),
+_blacklistTTL         ( 604800 ),
 _L2CacheSize          ( 16 ),
+_L2CacheMaxBytes      ( 0u ),
 _bilinearReprojection ( true ),
-_coverage             ( false )
+_coverage             ( false ),
+_httpMultiplex        ( false ),
+_httpMaxConnections   ( 0u ),
+_httpRateLimit        ( 0.0 ),
+_decodeMaxSize        ( 0u )
 { 
     fromConfig( _conf );
 }
@@ -156,10 +254,17 @@ TileSourceOptions::getConfig() const
 {
     Config conf = DriverConfigOptions::getConfig();
     conf.set( "blacklist_filename", _blacklistFilename);
+    conf.set( "blacklist_subtrees", _blacklistSubtrees );
+    conf.set( "blacklist_ttl", _blacklistTTL );
     conf.set( "l2_cache_size", _L2CacheSize );
+    conf.set( "l2_cache_max_bytes", _L2CacheMaxBytes );
     conf.set( "bilinear_reprojection", _bilinearReprojection );
     conf.set( "coverage", _coverage );
     conf.set( "osg_option_string", _osgOptionString );
+    conf.set( "http_multiplex", _httpMultiplex );
+    conf.set( "http_max_connections", _httpMaxConnections );
+    conf.set( "http_rate_limit", _httpRateLimit );
+    conf.set( "decode_max_size", _decodeMaxSize );
     conf.setObj( "profile", _profileOptions );
     return conf;
 }
@@ -177,10 +282,17 @@ void
 TileSourceOptions::fromConfig( const Config& conf )
 {
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
+    conf.getIfSet( "blacklist_subtrees", _blacklistSubtrees );
+    conf.getIfSet( "blacklist_ttl", _blacklistTTL );
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "l2_cache_max_bytes", _L2CacheMaxBytes );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "coverage", _coverage );
     conf.getIfSet( "osg_option_string", _osgOptionString );
+    conf.getIfSet( "http_multiplex", _httpMultiplex );
+    conf.getIfSet( "http_max_connections", _httpMaxConnections );
+    conf.getIfSet( "http_rate_limit", _httpRateLimit );
+    conf.getIfSet( "decode_max_size", _decodeMaxSize );
     conf.getObjIfSet( "profile", _profileOptions );
 }
 
@@ -216,6 +328,13 @@ _maxValidValue(  32000.0f )
         l2CacheSize = as<int>( std::string(l2env), 0 );
     }
 
+    unsigned l2CacheMaxBytes = *options.L2CacheMaxBytes();
+    char const* l2bytesEnv = ::getenv( "OSGEARTH_L2_CACHE_MAX_BYTES" );
+    if ( l2bytesEnv )
+    {
+        l2CacheMaxBytes = as<unsigned>( std::string(l2bytesEnv), 0u );
+    }
+
     // Env cache-only mode also disables the L2 cache.
     char const* noCacheEnv = ::getenv( "OSGEARTH_MEMORY_PROFILE" );
     if ( noCacheEnv )
@@ -226,7 +345,7 @@ _maxValidValue(  32000.0f )
     // Initialize the l2 cache if it's size is > 0
     if ( l2CacheSize > 0 )
     {
-        _memCache = new MemCache( l2CacheSize );
+        _memCache = new MemCache( l2CacheSize, l2CacheMaxBytes );
     }
 
     if (_options.blacklistFilename().isSet())
@@ -249,6 +368,8 @@ _maxValidValue(  32000.0f )
         //Initialize the blacklist if we couldn't read it.
         _blacklist = new TileBlacklist();
     }
+
+    _blacklist->setTTL( _options.blacklistTTL().get() );
 }
 
 TileSource::~TileSource()
@@ -437,6 +558,33 @@ TileSource::getBlacklist() const
     return _blacklist.get();
 }
 
+void
+TileSource::blacklist(const TileKey& key)
+{
+    // A tile without data only speaks for its subtree if every data extent
+    // under it says where its data starts, and none starts at a finer LOD
+    // (like a high-resolution inset would). An extent without a min level
+    // could hold data at any LOD, so then just list the tile.
+    bool subtree =
+        _options.blacklistSubtrees() == true &&
+        !_dataExtents.empty() &&
+        !isDynamic();
+
+    for (DataExtentList::const_iterator de = _dataExtents.begin(); subtree && de != _dataExtents.end(); ++de)
+    {
+        if (key.getExtent().intersects(*de) &&
+            (!de->minLevel().isSet() || de->minLevel().get() > key.getLOD()))
+        {
+            subtree = false;
+        }
+    }
+
+    if (subtree)
+        _blacklist->addSubtree(key);
+    else
+        _blacklist->add(key);
+}
+
 //------------------------------------------------------------------------
 
 #undef  LC
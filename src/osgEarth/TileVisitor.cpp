@@ -19,14 +19,84 @@
 #include <osgEarth/TileVisitor>
 #include <osgEarth/CacheEstimator>
 #include <osgEarth/FileUtils>
+#include <osgEarth/StringUtils>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <fstream>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
 
 using namespace osgEarth;
 
+namespace
+{
+    // Deterministic (platform-independent) hash used to assign subtrees to partitions.
+    unsigned partitionHash(const TileKey& key)
+    {
+        unsigned x, y;
+        key.getTileXY(x, y);
+        unsigned h = 2166136261u;
+        h = (h ^ key.getLevelOfDetail()) * 16777619u;
+        h = (h ^ x) * 16777619u;
+        h = (h ^ y) * 16777619u;
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        return h;
+    }
+
+    // Atomically creates a file, failing if it already exists.
+    bool createExclusive(const std::string& path, const std::string& contents)
+    {
+#ifdef _WIN32
+        int fd = ::_open( path.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY, _S_IREAD | _S_IWRITE );
+        if ( fd < 0 ) return false;
+        ::_write( fd, contents.c_str(), (unsigned)contents.size() );
+        ::_close( fd );
+#else
+        int fd = ::open( path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644 );
+        if ( fd < 0 ) return false;
+        ssize_t n = ::write( fd, contents.c_str(), contents.size() );
+        (void)n;
+        ::close( fd );
+#endif
+        return true;
+    }
+
+    // Folder holding the claims of one run of one job.
+    std::string claimFolder(const std::string& queue, const std::string& job, const std::string& run)
+    {
+        std::string folder = queue;
+        if ( !job.empty() )
+            folder = osgDB::concatPaths( folder, toLegalFileName(job) );
+        return osgDB::concatPaths( folder, toLegalFileName(run) );
+    }
+
+    // How often (s) a partition refreshes the timestamps of its claims.
+    const double CLAIM_REFRESH_INTERVAL = 60.0;
+}
+
 TileVisitor::TileVisitor():
 _total(0),
 _processed(0),
+_skipped(0),
+_startTime(osg::Timer::instance()->tick()),
 _minLevel(0),
-_maxLevel(5)
+_maxLevel(5),
+_partitionIndex(0),
+_partitionCount(1),
+_partitionLevel(5),
+_runID("default"),
+_claimTimeout(1800.0),
+_stealing(false),
+_claimsRefreshed(0)
 {
 }
 
@@ -35,8 +105,17 @@ TileVisitor::TileVisitor(TileHandler* handler):
 _tileHandler( handler ),
 _total(0),
 _processed(0),
+_skipped(0),
+_startTime(osg::Timer::instance()->tick()),
 _minLevel(0),
-_maxLevel(5)
+_maxLevel(5),
+_partitionIndex(0),
+_partitionCount(1),
+_partitionLevel(5),
+_runID("default"),
+_claimTimeout(1800.0),
+_stealing(false),
+_claimsRefreshed(0)
 {
 }
 
@@ -44,6 +123,165 @@ void TileVisitor::resetProgress()
 {
     _total = 0;
     _processed = 0;
+    _skipped = 0;
+    _startTime = osg::Timer::instance()->tick();
+}
+
+double TileVisitor::getElapsedTime() const
+{
+    return osg::Timer::instance()->delta_s( _startTime, osg::Timer::instance()->tick() );
+}
+
+double TileVisitor::getThroughput() const
+{
+    double elapsed = getElapsedTime();
+    return elapsed > 0.0 ? (double)(_processed - _skipped) / elapsed : 0.0;
+}
+
+bool TileVisitor::skip( const TileKey& key )
+{
+    if (!_checkpoint.valid() || !_checkpoint->isComplete( key ))
+    {
+        return false;
+    }
+
+    {
+        OpenThreads::ScopedLock< OpenThreads::Mutex > lk(_progressMutex );
+        _skipped++;
+    }
+    incrementProgress(1);
+    return true;
+}
+
+void TileVisitor::markComplete( const TileKey& key )
+{
+    if (_checkpoint.valid())
+    {
+        _checkpoint->markComplete( key );
+        if (_checkpoint->isSaveDue())
+        {
+            _checkpoint->save( _tileHandler.get() );
+        }
+    }
+}
+
+void TileVisitor::setPartition( unsigned int index, unsigned int count )
+{
+    _partitionCount = osg::maximum( count, 1u );
+    _partitionIndex = osg::minimum( index, _partitionCount-1 );
+}
+
+bool TileVisitor::isPartitioned() const
+{
+    return _partitionCount > 1 || !_workQueuePath.empty();
+}
+
+bool TileVisitor::isInPartition( const TileKey& key ) const
+{
+    return _partitionCount <= 1 || (partitionHash( key ) % _partitionCount) == _partitionIndex;
+}
+
+bool TileVisitor::claim( const TileKey& key )
+{
+    unsigned x, y;
+    key.getTileXY(x, y);
+    std::string filename = osgDB::concatPaths(
+        claimFolder( _workQueuePath, _workQueueJob, _runID ),
+        Stringify() << key.getLevelOfDetail() << "_" << x << "_" << y );
+    std::string owner = Stringify() << _partitionIndex;
+
+    // Another partition of this run already finished it.
+    if (osgDB::fileExists( filename + ".done" ))
+    {
+        return false;
+    }
+
+    bool claimed = createExclusive( filename, owner );
+    if (!claimed)
+    {
+        std::string claimedBy;
+        {
+            std::ifstream in( filename.c_str() );
+            in >> claimedBy;
+        }
+
+        // A claim we made in an earlier attempt at this run is still ours;
+        // that lets a restarted partition finish the subtrees it had started.
+        if (claimedBy == owner)
+        {
+            claimed = true;
+        }
+
+        // A claim that hasn't been refreshed in a while was left behind by a
+        // partition that died. Move it aside first, so that only one of the
+        // partitions that notice can take it over.
+        else if (!claimedBy.empty() && ::difftime( ::time(0L), osgEarth::getLastModifiedTime(filename) ) > _claimTimeout)
+        {
+            std::string stale = filename + ".stale" + owner;
+            if (::rename( filename.c_str(), stale.c_str() ) == 0)
+            {
+                ::remove( stale.c_str() );
+                claimed = createExclusive( filename, owner );
+                if (claimed)
+                {
+                    OE_INFO << "Partition " << _partitionIndex << " took over a stale claim from partition " << claimedBy << ": " << filename << std::endl;
+                }
+            }
+        }
+    }
+
+    if (claimed)
+    {
+        OpenThreads::ScopedLock< OpenThreads::Mutex > lk( _claimsMutex );
+        _claims.push_back( filename );
+    }
+    return claimed;
+}
+
+void TileVisitor::refreshClaims()
+{
+    OpenThreads::ScopedLock< OpenThreads::Mutex > lk( _claimsMutex );
+    if (_claims.empty())
+    {
+        return;
+    }
+
+    osg::Timer_t now = osg::Timer::instance()->tick();
+    if (osg::Timer::instance()->delta_s( _claimsRefreshed, now ) < CLAIM_REFRESH_INTERVAL)
+    {
+        return;
+    }
+    _claimsRefreshed = now;
+
+    for (std::vector< std::string >::const_iterator i = _claims.begin(); i != _claims.end(); ++i)
+    {
+        osgEarth::touchFile( *i );
+    }
+}
+
+void TileVisitor::releaseClaims()
+{
+    bool canceled = _progress.valid() && _progress->isCanceled();
+    std::string owner = Stringify() << _partitionIndex;
+
+    OpenThreads::ScopedLock< OpenThreads::Mutex > lk( _claimsMutex );
+    for (std::vector< std::string >::const_iterator i = _claims.begin(); i != _claims.end(); ++i)
+    {
+        if (!canceled)
+        {
+            createExclusive( *i + ".done", owner );
+        }
+        ::remove( i->c_str() );
+    }
+    _claims.clear();
+}
+
+void TileVisitor::saveCheckpoint()
+{
+    if (_checkpoint.valid())
+    {
+        _checkpoint->save( _tileHandler.get() );
+    }
 }
 
 void TileVisitor::addExtent( const GeoExtent& extent )
@@ -79,6 +317,13 @@ void TileVisitor::setProgressCallback( ProgressCallback* progress )
 }
 
 void TileVisitor::run( const Profile* mapProfile )
+{
+    produceKeys( mapProfile );
+    releaseClaims();
+    saveCheckpoint();
+}
+
+void TileVisitor::produceKeys( const Profile* mapProfile )
 {
     _profile = mapProfile;
     
@@ -87,14 +332,53 @@ void TileVisitor::run( const Profile* mapProfile )
     
     estimate();
 
+    // Pick up where a previous run left off.
+    if (_checkpoint.valid())
+    {
+        _checkpoint->open( mapProfile );
+    }
+
+    if (!_workQueuePath.empty())
+    {
+        osgEarth::makeDirectory( claimFolder(_workQueuePath, _workQueueJob, _runID) );
+    }
+
+    {
+        OpenThreads::ScopedLock< OpenThreads::Mutex > lk( _claimsMutex );
+        _claims.clear();
+        _claimsRefreshed = osg::Timer::instance()->tick();
+    }
+
     // Get all the root keys and process them.
     std::vector<TileKey> keys;
     mapProfile->getRootKeys(keys);
 
+    _unclaimed.clear();
     for (unsigned int i = 0; i < keys.size(); ++i)
     {
         processKey( keys[i] );
     }
+
+    // Once our own share is done, help with whatever the other partitions
+    // haven't started yet.
+    if (!_unclaimed.empty())
+    {
+        OE_INFO << "Partition " << _partitionIndex << " checking " << _unclaimed.size() << " subtrees from other partitions" << std::endl;
+        TileKeyList unclaimed;
+        unclaimed.swap( _unclaimed );
+
+        _stealing = true;
+        for (unsigned int i = 0; i < unclaimed.size(); ++i)
+        {
+            if (_progress && _progress->isCanceled())
+            {
+                break;
+            }
+            waitForCapacity();
+            processKey( unclaimed[i] );
+        }
+        _stealing = false;
+    }
 }
 
 void TileVisitor::estimate()
@@ -109,6 +393,12 @@ void TileVisitor::estimate()
         est.addExtent( _extents[ i ] );
     } 
     _total = est.getNumTiles();
+
+    // Without a work queue each partition does roughly its share.
+    if (_partitionCount > 1 && _workQueuePath.empty())
+    {
+        _total /= _partitionCount;
+    }
 }
 
 void TileVisitor::processKey( const TileKey& key )
@@ -134,9 +424,44 @@ void TileVisitor::processKey( const TileKey& key )
     // If the key intersects the extent attempt to traverse
     if (intersects( key.getExtent() ))
     {
+        // When partitioned, only partition 0 handles the keys above the
+        // partition level; the others just pass through them.
+        bool handle = true;
+
+        if (isPartitioned())
+        {
+            unsigned int partitionLevel = osg::minimum( _partitionLevel, _maxLevel );
+            if (lod < partitionLevel)
+            {
+                handle = (_partitionIndex == 0);
+            }
+            else if (lod == partitionLevel)
+            {
+                if (!_stealing && !isInPartition( key ))
+                {
+                    // Someone else's; remember it in case we have time to help later.
+                    if (!_workQueuePath.empty())
+                    {
+                        _unclaimed.push_back( key );
+                    }
+                    return;
+                }
+
+                if (!_workQueuePath.empty() && !claim( key ))
+                {
+                    return;
+                }
+            }
+        }
+
         // If the lod is less than the min level don't do anything but do traverse the children.
-        if (lod < _minLevel)
+        if (lod < _minLevel || !handle)
+        {
+            traverseChildren = true;
+        }
+        else if (skip( key ))
         {
+            // Already handled by a previous run.
             traverseChildren = true;
         }
         else
@@ -163,6 +488,7 @@ void TileVisitor::incrementProgress(unsigned int amount)
         OpenThreads::ScopedLock< OpenThreads::Mutex > lk(_progressMutex );
         _processed += amount;
     }
+    refreshClaims();
     if (_progress.valid())
     {
         // If report progress returns true then mark the task as being cancelled.
@@ -181,6 +507,11 @@ bool TileVisitor::handleTile( const TileKey& key )
         result = _tileHandler->handleTile( key, *this );
     }
 
+    if (result)
+    {
+        markComplete( key );
+    }
+
     incrementProgress(1);    
     
     return result;
@@ -207,7 +538,10 @@ public:
       {         
           if (_handler.valid())
           {                           
-              _handler->handleTile( _key, *_visitor.get() );
+              if (_handler->handleTile( _key, *_visitor.get() ))
+              {
+                  _visitor->markComplete( _key );
+              }
               _visitor->incrementProgress(1);
           }
       }
@@ -245,10 +579,10 @@ void MultithreadedTileVisitor::run(const Profile* mapProfile)
 {                   
     // Start up the task service
     OE_INFO << "Starting " << _numThreads << std::endl;
-    _taskService = new TaskService( "MTTileHandler", _numThreads, 1000 );
+    _taskService = new TaskService( "MTTileHandler", _numThreads, 1000, TaskService::SCHEDULER_WORK_STEALING );
 
     // Produce the tiles
-    TileVisitor::run( mapProfile );
+    produceKeys( mapProfile );
 
     // Send a poison pill to kill all the threads
     _taskService->add( new PoisonPill() );
@@ -265,6 +599,9 @@ void MultithreadedTileVisitor::run(const Profile* mapProfile)
         }
     }
     OE_INFO << "All threads have completed" << std::endl;
+
+    releaseClaims();
+    saveCheckpoint();
 }
 
 bool MultithreadedTileVisitor::handleTile( const TileKey& key )        
@@ -274,6 +611,20 @@ bool MultithreadedTileVisitor::handleTile( const TileKey& key )
     return true;
 }
 
+void MultithreadedTileVisitor::waitForCapacity()
+{
+    // Don't claim more work until the queue is nearly drained, so the
+    // subtrees we can't get to stay available to other partitions.
+    while (_taskService->getNumRequests() > _numThreads)
+    {
+        if (_progress && _progress->isCanceled())
+        {
+            break;
+        }
+        OpenThreads::Thread::microSleep(10000);
+    }
+}
+
 /*****************************************************************************************/
 
 TaskList::TaskList(const Profile* profile):
@@ -366,7 +717,7 @@ void MultiprocessTileVisitor::run(const Profile* mapProfile)
     _taskService = new TaskService( "MPTileHandler", _numProcesses, 1000 );
     
     // Produce the tiles
-    TileVisitor::run( mapProfile );
+    produceKeys( mapProfile );
 
     // Process any remaining tasks in the final batch
     processBatch();
@@ -386,6 +737,9 @@ void MultiprocessTileVisitor::run(const Profile* mapProfile)
         }
     }
     OE_INFO << "All threads have completed" << std::endl;
+
+    releaseClaims();
+    saveCheckpoint();
 }
 
 bool MultiprocessTileVisitor::handleTile( const TileKey& key )        
@@ -399,6 +753,23 @@ bool MultiprocessTileVisitor::handleTile( const TileKey& key )
     return true;
 }
 
+void MultiprocessTileVisitor::waitForCapacity()
+{
+    // Ship what we have and wait for the batches to drain before claiming more work.
+    if (!_batch.empty())
+    {
+        processBatch();
+    }
+    while (_taskService->getNumRequests() > _numProcesses)
+    {
+        if (_progress && _progress->isCanceled())
+        {
+            break;
+        }
+        OpenThreads::Thread::microSleep(10000);
+    }
+}
+
 const std::string& MultiprocessTileVisitor::getEarthFile() const
 {
     return _earthFile;
@@ -415,20 +786,30 @@ void MultiprocessTileVisitor::setEarthFile( const std::string& earthFile )
 class ExecuteTask : public TaskRequest
 {
 public:
-    ExecuteTask(const std::string& command, TileVisitor* visitor, unsigned int count):            
+    ExecuteTask(const std::string& command, TileVisitor* visitor, const TileKeyList& keys):            
       _command( command ),
       _visitor( visitor ),
-      _count( count )
+      _keys( keys )
       {
       }
 
       virtual void operator()(ProgressCallback* progress )
       {         
-          system(_command.c_str());     
+          int result = system(_command.c_str());     
+
+          // The external process doesn't report on individual tiles, so the
+          // whole batch is complete only if it finished cleanly.
+          if (result == 0)
+          {
+              for (unsigned int i = 0; i < _keys.size(); i++)
+              {
+                  _visitor->markComplete( _keys[i] );
+              }
+          }
 
           // Cleanup the temp files and increment the progress on the visitor.
           cleanupTempFiles();
-          _visitor->incrementProgress( _count );
+          _visitor->incrementProgress( _keys.size() );
       }
 
       void addTempFile( const std::string& filename )
@@ -448,7 +829,7 @@ public:
       std::vector< std::string > _tempFiles;
       std::string _command;
       TileVisitor* _visitor;
-      unsigned int _count;
+      TileKeyList _keys;
 };
 
 void MultiprocessTileVisitor::processBatch()
@@ -466,7 +847,7 @@ void MultiprocessTileVisitor::processBatch()
     std::stringstream command;        
     command << _tileHandler->getProcessString() << " --tiles " << filename << " " << _earthFile;
     OE_INFO << "Running command " << command.str() << std::endl;
-    osg::ref_ptr< ExecuteTask > task = new ExecuteTask( command.str(), this, tasks.getKeys().size() );
+    osg::ref_ptr< ExecuteTask > task = new ExecuteTask( command.str(), this, tasks.getKeys() );
     // Add the task file as a temp file to the task to make sure it gets deleted
     task->addTempFile( filename );
 
@@ -489,12 +870,22 @@ void TileKeyListVisitor::run(const Profile* mapProfile)
 {
     resetProgress();        
 
+    if (_checkpoint.valid())
+    {
+        _checkpoint->open( mapProfile );
+    }
+
     for (TileKeyList::iterator itr = _keys.begin(); itr != _keys.end(); ++itr)
     {
-        if (_tileHandler)
+        if (_tileHandler && !skip( *itr ))
         {
-            _tileHandler->handleTile( *itr, *this );
+            if (_tileHandler->handleTile( *itr, *this ))
+            {
+                markComplete( *itr );
+            }
             incrementProgress(1);
         }
     }
+
+    saveCheckpoint();
 }
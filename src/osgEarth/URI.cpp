@@ -23,6 +23,8 @@
 #include <osgEarth/Registry>
 #include <osgEarth/Progress>
 #include <osgEarth/FileUtils>
+#include <osgEarth/DateTime>
+#include <osgEarth/StringUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
@@ -283,6 +285,86 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------
+    // HTTP response headers stored with cached records.
+
+    std::string getHeader(const Config& meta, const std::string& name)
+    {
+        const ConfigSet& headers = meta.children();
+        for (ConfigSet::const_iterator i = headers.begin(); i != headers.end(); ++i)
+        {
+            if (ciEquals(i->key(), name))
+                return i->value();
+        }
+        return std::string();
+    }
+
+    // Whether the server asked that the response not be stored.
+    bool isNoStore(const Config& meta)
+    {
+        return toLower(getHeader(meta, "Cache-Control")).find("no-store") != std::string::npos;
+    }
+
+    // Whether a cached response has outlived the freshness lifetime its
+    // Cache-Control or Expires header gave it. "received" is when the record
+    // was written or last revalidated. Without either header, it never goes
+    // stale here and only the CachePolicy age limits apply.
+    bool isStale(const Config& meta, TimeStamp received)
+    {
+        TimeStamp now = DateTime().asTimeStamp();
+
+        std::string cacheControl = toLower(getHeader(meta, "Cache-Control"));
+        if (cacheControl.find("no-cache") != std::string::npos)
+            return true;
+
+        std::string::size_type maxAge = cacheControl.find("max-age=");
+        if (maxAge != std::string::npos)
+            return now >= received + as<long>(cacheControl.substr(maxAge + 8), 0L);
+
+        std::string expires = getHeader(meta, "Expires");
+        if (!expires.empty())
+        {
+            // An unparseable Expires (like "0") means already expired. Measure
+            // the lifetime against the server's Date when there is one, so
+            // that clock skew doesn't matter.
+            TimeStamp expiresTime = DateTime(expires).asTimeStamp();
+            if (expiresTime == 0)
+                return true;
+
+            TimeStamp dateTime = DateTime(getHeader(meta, "Date")).asTimeStamp();
+            TimeSpan lifetime = (TimeSpan)(expiresTime - (dateTime > 0 ? dateTime : received));
+            return now >= received + lifetime;
+        }
+
+        return false;
+    }
+
+    //--------------------------------------------------------------------
+    // Adds the conditional request headers that let a server answer
+    // "304 Not Modified" when a cached copy is still current.
+
+    void addValidators(HTTPRequest& req, const ReadResult& cached)
+    {
+        // Prefer the server's own Last-Modified; the record's time is only
+        // when we stored it.
+        std::string lastModified = getHeader(cached.metadata(), "Last-Modified");
+        if (!lastModified.empty())
+        {
+            req.addHeader("If-Modified-Since", lastModified);
+        }
+        else if (cached.lastModifiedTime() > 0)
+        {
+            req.setLastModified(cached.lastModifiedTime());
+        }
+
+        std::string etag = getHeader(cached.metadata(), "ETag");
+        if (!etag.empty())
+        {
+            req.addHeader("If-None-Match", etag);
+        }
+    }
+
+
     //--------------------------------------------------------------------
     // Read functors (used by the doRead method)
 
@@ -291,13 +373,10 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_OBJECTS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readObject(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readObject(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached )
         {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+            HTTPRequest req(uri);
+            addValidators(req, cached);
             return HTTPClient::readObject(req, opt, p);
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return ReadResult(osgDB::readObjectFile(uri, opt)); }
@@ -308,13 +387,10 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_NODES) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readNode(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key ) { return bin->readObject(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached )
         {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+            HTTPRequest req(uri);
+            addValidators(req, cached);
             return HTTPClient::readNode(req, opt, p);
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return ReadResult(osgDB::readNodeFile(uri, opt)); }
@@ -335,12 +411,9 @@ namespace
             if ( r.getImage() ) r.getImage()->setFileName( key );
             return r;
         }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified ) { 
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached ) { 
+            HTTPRequest req(uri);
+            addValidators(req, cached);
             ReadResult r = HTTPClient::readImage(req, opt, p);
             if ( r.getImage() ) r.getImage()->setFileName( uri );
             return r;
@@ -357,18 +430,202 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_STRINGS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readString(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readString(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
+        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, const ReadResult& cached )
         {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+            HTTPRequest req(uri);
+            addValidators(req, cached);
             return HTTPClient::readString(req, opt, p);
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return readStringFile(uri, opt); }
     };
 
+    //--------------------------------------------------------------------
+    // Network fetches currently in progress, one table per functor type, so
+    // that concurrent fetches of the same resource share a single request.
+
+    template<typename READ_FUNCTOR>
+    struct FetchesInFlight
+    {
+        static Threading::SingleFlight<std::string, ReadResult> s_table;
+    };
+
+    template<typename READ_FUNCTOR>
+    Threading::SingleFlight<std::string, ReadResult> FetchesInFlight<READ_FUNCTOR>::s_table;
+
+    // Two fetches can only share a request if everything that goes into the
+    // request (option string, proxy, credentials) is the same.
+    std::string getFetchKey(const URI& uri, const osgDB::Options* options)
+    {
+        std::stringstream buf;
+        buf << uri.full();
+        if ( options )
+        {
+            buf << '\n' << options->getOptionString()
+                << '\n' << options->getPluginStringData("osgEarth::ProxySettings")
+                << '\n' << (const void*)options->getAuthenticationMap();
+        }
+        return buf.str();
+    }
+
+    // Each caller gets its own copy of a shared result, since callers
+    // are free to modify what they read.
+    ReadResult copyResult(const ReadResult& r)
+    {
+        if ( !r.getObject() )
+            return r;
+
+        ReadResult copy( r.code(), osg::clone(r.getObject(), osg::CopyOp::DEEP_COPY_ALL), r.metadata() );
+        copy.setLastModifiedTime( r.lastModifiedTime() );
+        copy.setDuration( r.duration() );
+        copy.setErrorDetail( r.errorDetail() );
+        return copy;
+    }
+
+    // Fetches a URI from the network. If another thread is already making
+    // the same request, waits for it and takes a copy of its result. If that
+    // thread's request is canceled, this one makes its own request instead.
+    template<typename READ_FUNCTOR>
+    ReadResult fetch(
+        READ_FUNCTOR&         reader,
+        const URI&            uri,
+        const osgDB::Options* options,
+        ProgressCallback*     progress)
+    {
+        std::string key = getFetchKey(uri, options);
+        for(;;)
+        {
+            ReadResult shared;
+            Threading::SingleFlight<std::string, ReadResult>::Scope flight(
+                FetchesInFlight<READ_FUNCTOR>::s_table, key, shared );
+
+            if ( flight.isLeader() )
+            {
+                shared = reader.fromHTTP( uri.full(), options, progress, ReadResult() );
+
+                // a canceled read is no use to anyone else
+                if ( shared.code() == ReadResult::RESULT_CANCELED )
+                    flight.abandon();
+                return shared;
+            }
+            else if ( !flight.wasAbandoned() )
+            {
+                return copyResult( shared );
+            }
+            else if ( progress && progress->isCanceled() )
+            {
+                return ReadResult( ReadResult::RESULT_CANCELED );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------
+    // Reads a remote URI, going through the cache bin (if any) first.
+
+    template<typename READ_FUNCTOR>
+    ReadResult doReadRemote(
+        READ_FUNCTOR&         reader,
+        URIReadCallback*      cb,
+        const URI&            uri,
+        const osgDB::Options* localOptions,
+        ProgressCallback*     progress,
+        bool&                 gotResultFromCallback)
+    {
+        ReadResult result;
+
+        bool callbackCachingOK = !cb || reader.callbackRequestsCaching(cb);
+
+        optional<CachePolicy> cp;
+        osg::ref_ptr<CacheBin> bin;
+
+        CacheSettings* cacheSettings = CacheSettings::get(localOptions);
+        if (cacheSettings)
+        {
+            cp = cacheSettings->cachePolicy();
+            if (cp->isCacheEnabled() && callbackCachingOK)
+            {
+                bin = cacheSettings->getCacheBin(); 
+            }
+        }
+
+        bool expired = false;
+        // first try to go to the cache if there is one:
+        if ( bin && cp->isCacheReadable() )
+        {                                                
+            result = reader.fromCache( bin, uri.cacheKey() );                        
+            if ( result.succeeded() )
+            {                                        
+                expired =
+                    cp->isExpired(result.lastModifiedTime()) ||
+                    (cp->httpExpiration() == true && isStale(result.metadata(), result.lastModifiedTime()));
+                result.setIsFromCache(true);
+            }
+        }
+
+        // If it's not cached, or it is cached but is expired then try to hit the server.                    
+        if ( result.empty() || expired )
+        {                        
+            // Need to do this to support nested PLODs and Proxynodes.
+            osg::ref_ptr<osgDB::Options> remoteOptions =
+                Registry::instance()->cloneOrCreateOptions( localOptions );
+            remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
+
+            // Store the existing object from the cache if there is one.
+            osg::ref_ptr< osg::Object > object = result.getObject();
+
+            // try to use the callback if it's set. Callback ignores the caching policy.
+            if ( cb )
+            {                
+                result = reader.fromCallback( cb, uri.full(), remoteOptions.get() );
+
+                if ( result.code() != ReadResult::RESULT_NOT_IMPLEMENTED )
+                {
+                    // "not implemented" is the only excuse for falling back
+                    gotResultFromCallback = true;
+                }
+            }
+
+            if ( !gotResultFromCallback )
+            {                            
+                // still no data, go to the source:
+                if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
+                {                                
+                    // a conditional request depends on what this caller has
+                    // cached, so only unconditional ones are shared.
+                    ReadResult remoteResult = result.empty() ?
+                        fetch( reader, uri, remoteOptions.get(), progress ) :
+                        reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result );
+                    if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
+                    {                                    
+                        OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
+                        // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
+                        if (bin)
+                            bin->touch( uri.cacheKey() );
+                    }
+                    else if ( remoteResult.succeeded() || result.empty() || remoteResult.code() == ReadResult::RESULT_NOT_FOUND )
+                    {
+                        OE_DEBUG << LC << "Got remote result for " << uri.full() << std::endl;
+                        result = remoteResult;                                    
+                    }
+                    else
+                    {
+                        // the server can't be reached (or is failing); an expired copy beats nothing.
+                        OE_DEBUG << LC << uri.full() << " unavailable, using expired cached result" << std::endl;
+                    }
+                }
+
+                // write the result to the cache if possible:
+                if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() &&
+                     !(cp->httpExpiration() == true && isNoStore(result.metadata())) )
+                {
+                    OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
+                    bin->write( uri.cacheKey(), result.getObject(), result.metadata(), remoteOptions );
+                }
+            }
+        }
+
+        return result;
+    }
+
     //--------------------------------------------------------------------
     // MASTER read template function. I templatized this so we wouldn't
     // have 4 95%-identical code paths to maintain...
@@ -452,84 +709,7 @@ namespace
                 // remote URI, consider caching:
                 else
                 {
-                    bool callbackCachingOK = !cb || reader.callbackRequestsCaching(cb);
-
-                    optional<CachePolicy> cp;
-                    osg::ref_ptr<CacheBin> bin;
-
-                    CacheSettings* cacheSettings = CacheSettings::get(localOptions.get());
-                    if (cacheSettings)
-                    {
-                        cp = cacheSettings->cachePolicy();
-                        if (cp->isCacheEnabled() && callbackCachingOK)
-                        {
-                            bin = cacheSettings->getCacheBin(); 
-                        }
-                    }
-
-                    bool expired = false;
-                    // first try to go to the cache if there is one:
-                    if ( bin && cp->isCacheReadable() )
-                    {                                                
-                        result = reader.fromCache( bin, uri.cacheKey() );                        
-                        if ( result.succeeded() )
-                        {                                        
-                            expired = cp->isExpired(result.lastModifiedTime());
-                            result.setIsFromCache(true);
-                        }
-                    }
-
-                    // If it's not cached, or it is cached but is expired then try to hit the server.                    
-                    if ( result.empty() || expired )
-                    {                        
-                        // Need to do this to support nested PLODs and Proxynodes.
-                        osg::ref_ptr<osgDB::Options> remoteOptions =
-                            Registry::instance()->cloneOrCreateOptions( localOptions );
-                        remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
-
-                        // Store the existing object from the cache if there is one.
-                        osg::ref_ptr< osg::Object > object = result.getObject();
-
-                        // try to use the callback if it's set. Callback ignores the caching policy.
-                        if ( cb )
-                        {                
-                            result = reader.fromCallback( cb, uri.full(), remoteOptions.get() );
-
-                            if ( result.code() != ReadResult::RESULT_NOT_IMPLEMENTED )
-                            {
-                                // "not implemented" is the only excuse for falling back
-                                gotResultFromCallback = true;
-                            }
-                        }
-
-                        if ( !gotResultFromCallback )
-                        {                            
-                            // still no data, go to the source:
-                            if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
-                            {                                
-                                ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
-                                if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
-                                {                                    
-                                    OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
-                                    // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
-                                    if (bin)
-                                        bin->touch( uri.cacheKey() );
-                                }
-                                else
-                                {
-                                    OE_DEBUG << LC << "Got remote result for " << uri.full() << std::endl;
-                                    result = remoteResult;                                    
-                                }
-                            }
-
-                            // write the result to the cache if possible:
-                            if ( result.succeeded() && !result.isFromCache() && bin && cp->isCacheWriteable() && bin )
-                            {
-                                OE_DEBUG << LC << "Writing " << uri.cacheKey() << " to cache" << std::endl;
-                                bin->write( uri.cacheKey(), result.getObject(), result.metadata(), remoteOptions );
-                            }
-                        }
-                    }
+                    result = doReadRemote( reader, cb, uri, localOptions.get(), progress, gotResultFromCallback );
                 }
 
 
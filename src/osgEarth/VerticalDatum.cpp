@@ -21,6 +21,7 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/GeoData>
+#include <osgEarth/Containers>
 
 #include <osgDB/ReadFile>
 #include <osgDB/ReaderWriter>
@@ -37,6 +38,32 @@ namespace
     typedef std::map<std::string, osg::ref_ptr<VerticalDatum> > VDatumCache;
     VDatumCache      _vdatumCache;
     Threading::Mutex _vdataCacheMutex;
+
+    // Geoid heights sampled over a heightfield's grid. Every heightfield on the
+    // same grid (the same tile in other layers, or the same tile built again)
+    // reuses them.
+    typedef LRUCache<std::string, osg::ref_ptr<osg::FloatArray> > GeoidGridCache;
+    GeoidGridCache _geoidGridCache(true, 32u);
+
+    osg::ref_ptr<osg::FloatArray> getGeoidGrid(const Geoid* geoid,
+                                               double west, double south,
+                                               double xstep, double ystep,
+                                               unsigned cols, unsigned rows)
+    {
+        std::string key = Stringify() << std::setprecision(17)
+            << geoid->getName() << "_" << (const void*)geoid << "_"
+            << west << "_" << south << "_" << xstep << "_" << ystep << "_"
+            << cols << "_" << rows;
+
+        GeoidGridCache::Record rec;
+        if ( _geoidGridCache.get(key, rec) )
+            return rec.value();
+
+        osg::ref_ptr<osg::FloatArray> grid = new osg::FloatArray(cols*rows);
+        geoid->getHeights(west, south, xstep, ystep, cols, rows, &grid->front());
+        _geoidGridCache.insert(key, grid);
+        return grid;
+    }
 } 
 
 VerticalDatum*
@@ -154,17 +181,32 @@ VerticalDatum::transform(const VerticalDatum* from,
         ystep = (ne.y()-sw.y()) / double(rows-1);
     }
 
-    for( unsigned c=0; c<cols; ++c)
+    // Same math as the per-point transform, but with the geoid offsets for
+    // the whole grid looked up at once.
+    osg::ref_ptr<osg::FloatArray> fromOffsets, toOffsets;
+    if ( from && from->getGeoid() )
+        fromOffsets = getGeoidGrid(from->getGeoid(), sw.x(), sw.y(), xstep, ystep, cols, rows);
+    if ( to && to->getGeoid() )
+        toOffsets = getGeoidGrid(to->getGeoid(), sw.x(), sw.y(), xstep, ystep, cols, rows);
+
+    Units fromUnits = from ? from->getUnits() : Units::METERS;
+    Units toUnits = to ? to->getUnits() : Units::METERS;
+    bool convertUnits = fromUnits != toUnits;
+
+    osg::HeightField::HeightList& heights = hf->getHeightList();
+    for( unsigned i=0; i<cols*rows; ++i )
     {
-        double lon = sw.x() + xstep*double(c);
-        for( unsigned r=0; r<rows; ++r)
+        float& h = heights[i];
+        if (h != NO_DATA_VALUE)
         {
-            double lat = sw.y() + ystep*double(r);
-            float& h = hf->getHeight(c, r);
-            if (h != NO_DATA_VALUE)
-            {
-                VerticalDatum::transform( from, to, lat, lon, h );
-            }
+            double z = h;
+            if ( fromOffsets.valid() )
+                z += (*fromOffsets)[i];
+            if ( convertUnits )
+                z = fromUnits.convertTo(toUnits, z);
+            if ( toOffsets.valid() )
+                z -= (*toOffsets)[i];
+            h = float(z);
         }
     }
 
@@ -18,6 +18,7 @@
 */
 #include <osgEarth/VideoLayer>
 #include <osg/ImageStream>
+#include <osg/BufferObject>
 #include <osgEarth/Registry>
 
 using namespace osgEarth;
@@ -48,6 +49,7 @@ ImageLayerOptions( name )
 void
 VideoLayerOptions::setDefaults()
 {
+    _pixelBufferObject.init( false );
 }
 
 Config
@@ -57,6 +59,7 @@ VideoLayerOptions::getConfig() const
     conf.key() = "video";
 
     conf.set("url", _url);
+    conf.set("pixel_buffer_object", _pixelBufferObject);
 
     return conf;
 }
@@ -65,6 +68,7 @@ void
 VideoLayerOptions::fromConfig( const Config& conf )
 {
     conf.getIfSet("url", _url );
+    conf.getIfSet("pixel_buffer_object", _pixelBufferObject );
 }
 
 void
@@ -109,6 +113,14 @@ VideoLayer::open()
                 is->play();                 
             }
 
+            // Each new frame goes through the PBO; the texture subloads from it
+            // without waiting for the copy to finish. All tiles share the one
+            // texture, so a frame is uploaded once no matter how many tiles show it.
+            if (options().pixelBufferObject() == true)
+            {
+                image->setPixelBufferObject(new osg::PixelBufferObject(image.get()));
+            }
+
             _texture = new osg::Texture2D( image );
             _texture->setResizeNonPowerOfTwoHint( false );
             _texture->setFilter(osg::Texture::MIN_FILTER, osg::Texture2D::LINEAR);
@@ -116,6 +128,7 @@ VideoLayer::open()
             _texture->setWrap( osg::Texture::WRAP_S, osg::Texture::REPEAT );
             _texture->setWrap( osg::Texture::WRAP_T, osg::Texture::REPEAT );
             _texture->setUnRefImageDataAfterApply(false);
+            _texture->setDataVariance(osg::Object::DYNAMIC);
         }
         else
         {
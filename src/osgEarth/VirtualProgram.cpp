@@ -24,6 +24,7 @@
 #include <osgEarth/ShaderUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Containers>
+#include <osgEarth/Memory>
 #include <osg/Shader>
 #include <osg/Program>
 #include <osg/State>
@@ -31,6 +32,7 @@
 #include <osg/Version>
 #include <osg/GL2Extensions>
 #include <osg/GLExtensions>
+#include <osgDB/FileUtils>
 #include <fstream>
 #include <sstream>
 #include <OpenThreads/Thread>
@@ -115,6 +117,30 @@ namespace
 
     typedef std::map<std::string, std::string> HeaderMap;
 
+    /** Hashes a program key (its shader pointers) for probing the program cache. */
+    inline std::size_t hashProgramKey(const ProgramKey& key)
+    {
+        std::size_t h = key.size();
+        for(ProgramKey::const_iterator i = key.begin(); i != key.end(); ++i)
+        {
+            h ^= reinterpret_cast<std::size_t>(i->get()) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        }
+        return h;
+    }
+
+    /** Finds the entry for a program key among the entries sharing its hash. */
+    template<typename MAP>
+    inline typename MAP::iterator findProgramEntry(MAP& map, const ProgramKey& key, std::size_t hash)
+    {
+        std::pair<typename MAP::iterator, typename MAP::iterator> range = map.equal_range(hash);
+        for(typename MAP::iterator i = range.first; i != range.second; ++i)
+        {
+            if ( i->second._key == key )
+                return i;
+        }
+        return map.end();
+    }
+
     // removes leading and trailing whitespace, and replaces all other
     // whitespace with single spaces
     std::string trimAndCompress(const std::string& in)
@@ -503,12 +529,239 @@ namespace
         addShadersToProgram( buildVector, accumAttribBindings, accumAttribAliases, program, stages );
         addTemplateDataToProgram( templateProgram, program );
 
+        // account for the source text; the driver's copy of the linked
+        // program is out of sight.
+        unsigned bytes = sizeof(osg::Program);
+        for(unsigned i=0; i<program->getNumShaders(); ++i)
+            bytes += program->getShader(i)->getShaderSource().size();
+        Memory::charge( Memory::SHADER_PROGRAMS, program, bytes );
+
         return program;
     }
 }
 
 //------------------------------------------------------------------------
 
+// environment variable control for program linking
+#define OSGEARTH_PROGRAM_BINARY_CACHE         "OSGEARTH_PROGRAM_BINARY_CACHE"
+#define OSGEARTH_MAX_PROGRAM_LINKS_PER_FRAME  "OSGEARTH_MAX_PROGRAM_LINKS_PER_FRAME"
+
+// identifies a program binary file written by VirtualProgram
+#define PROGRAM_BINARY_MAGIC 0x4250454fu // "OEPB"
+
+namespace
+{
+    struct ProgramLinkSettings
+    {
+        ProgramLinkSettings() : _maxLinksPerFrame(0u)
+        {
+            const char* path = ::getenv(OSGEARTH_PROGRAM_BINARY_CACHE);
+            if ( path )
+                _binaryCachePath = path;
+
+            const char* maxLinks = ::getenv(OSGEARTH_MAX_PROGRAM_LINKS_PER_FRAME);
+            if ( maxLinks )
+                _maxLinksPerFrame = as<unsigned>(maxLinks, 0u);
+        }
+
+        std::string      _binaryCachePath;
+        unsigned         _maxLinksPerFrame;
+
+        // serializes use of osg::Program::setProgramBinary, which is not per-context
+        Threading::Mutex _binaryMutex;
+    };
+    ProgramLinkSettings s_linkSettings;
+
+    // number of programs linked in the current frame, per context. Each slot
+    // is only touched by its own context's draw thread.
+    struct LinkBudget
+    {
+        LinkBudget() : _frameNumber(~0u), _count(0u) { }
+        unsigned _frameNumber;
+        unsigned _count;
+    };
+    LinkBudget s_linkBudget[MAX_CONTEXTS];
+
+    inline osg::Program::PerContextProgram* getPCP(osg::Program* program, osg::State& state)
+    {
+#if OSG_VERSION_GREATER_OR_EQUAL(3,3,4)
+        return program->getPCP( state );
+#else
+        return program->getPCP( state.getContextID() );
+#endif
+    }
+
+    /** Counts a program link against the per-frame budget. Returns false if over budget. */
+    bool reserveProgramLink(const osg::State& state)
+    {
+        unsigned maxLinks = s_linkSettings._maxLinksPerFrame;
+        unsigned contextID = state.getContextID();
+        if ( maxLinks == 0u || contextID >= MAX_CONTEXTS || !state.getFrameStamp() )
+            return true;
+
+        LinkBudget& budget = s_linkBudget[contextID];
+        unsigned frameNumber = state.getFrameStamp()->getFrameNumber();
+        if ( budget._frameNumber != frameNumber )
+        {
+            budget._frameNumber = frameNumber;
+            budget._count = 0u;
+        }
+
+        if ( budget._count >= maxLinks )
+            return false;
+
+        ++budget._count;
+        return true;
+    }
+
+    /**
+     * Generates the binary cache filename for a program. The key covers the
+     * shader source, the active defines, the attribute bindings, and the GL
+     * driver, since a binary is only valid for the driver that produced it.
+     */
+    std::string getProgramBinaryFilename(osg::State& state, osg::Program* program)
+    {
+        std::stringstream buf;
+
+        const char* vendor   = (const char*)glGetString(GL_VENDOR);
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        const char* version  = (const char*)glGetString(GL_VERSION);
+        buf << (vendor? vendor : "") << '\n' << (renderer? renderer : "") << '\n' << (version? version : "") << '\n';
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3,5,6)
+        buf << state.getDefineString(program->getShaderDefines()) << '\n';
+#endif
+
+        const osg::Program::AttribBindingList& abl = program->getAttribBindingList();
+        for(osg::Program::AttribBindingList::const_iterator i = abl.begin(); i != abl.end(); ++i)
+        {
+            buf << i->first << '=' << i->second << '\n';
+        }
+
+        for(unsigned i=0; i<program->getNumShaders(); ++i)
+        {
+            const osg::Shader* shader = program->getShader(i);
+            buf << shader->getType() << '\n' << shader->getShaderSource() << '\n';
+        }
+
+        std::string key = buf.str();
+        return Stringify()
+            << s_linkSettings._binaryCachePath << "/"
+            << hashToString(key) << "-" << std::hex << key.length() << ".bin";
+    }
+
+    osg::ProgramBinary* readProgramBinary(const std::string& filename)
+    {
+        std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+        if ( !in.is_open() )
+            return 0L;
+
+        unsigned header[3];
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        if ( in.fail() || header[0] != PROGRAM_BINARY_MAGIC || header[2] == 0u )
+            return 0L;
+
+        osg::ref_ptr<osg::ProgramBinary> binary = new osg::ProgramBinary();
+        binary->setFormat( header[1] );
+        binary->allocate( header[2] );
+        in.read(reinterpret_cast<char*>(binary->getData()), header[2]);
+        if ( in.fail() )
+            return 0L;
+
+        return binary.release();
+    }
+
+    void writeProgramBinary(const std::string& filename, const osg::ProgramBinary* binary)
+    {
+        if ( !osgDB::makeDirectoryForFile(filename) )
+            return;
+
+        std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if ( !out.is_open() )
+        {
+            OE_WARN << LC << "Unable to write program binary to " << filename << std::endl;
+            return;
+        }
+
+        unsigned header[3] = { PROGRAM_BINARY_MAGIC, binary->getFormat(), binary->getSize() };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(binary->getData()), binary->getSize());
+    }
+
+    /**
+     * Links a program for the current context. When the binary cache is
+     * enabled, loads a previously saved binary instead of compiling from
+     * source, and saves the binary of anything it does compile.
+     */
+    void linkProgram(osg::State& state, osg::Program* program)
+    {
+        if ( s_linkSettings._binaryCachePath.empty() )
+        {
+            program->compileGLObjects( state );
+            return;
+        }
+
+        osg::Program::PerContextProgram* pcp = getPCP(program, state);
+        std::string filename = getProgramBinaryFilename(state, program);
+
+        osg::ref_ptr<osg::ProgramBinary> binary = readProgramBinary(filename);
+        if ( binary.valid() )
+        {
+            Threading::ScopedMutexLock lock(s_linkSettings._binaryMutex);
+            program->setProgramBinary( binary.get() );
+            pcp->linkProgram( state );
+            program->setProgramBinary( 0L );
+
+            if ( pcp->isLinked() )
+                return;
+
+            // The driver rejected the binary (probably a driver update);
+            // fall back on the source and replace the stale file.
+            OE_DEBUG << LC << "Discarding stale program binary " << filename << std::endl;
+            pcp->requestLink();
+        }
+
+        program->compileGLObjects( state );
+
+        if ( pcp->isLinked() )
+        {
+            osg::ref_ptr<osg::ProgramBinary> compiled = pcp->compileProgramBinary( state );
+            if ( compiled.valid() && compiled->getSize() > 0u )
+            {
+                writeProgramBinary( filename, compiled.get() );
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+void
+VirtualProgram::setProgramBinaryCachePath(const std::string& path)
+{
+    s_linkSettings._binaryCachePath = path;
+}
+
+const std::string&
+VirtualProgram::getProgramBinaryCachePath()
+{
+    return s_linkSettings._binaryCachePath;
+}
+
+void
+VirtualProgram::setMaxProgramLinksPerFrame(unsigned value)
+{
+    s_linkSettings._maxLinksPerFrame = value;
+}
+
+unsigned
+VirtualProgram::getMaxProgramLinksPerFrame()
+{
+    return s_linkSettings._maxLinksPerFrame;
+}
+
+//------------------------------------------------------------------------
+
 void
 VirtualProgram::AttrStackMemory::remember(const osg::State&                 state,
                                           const VirtualProgram::AttrStack&  rhs,
@@ -676,7 +929,8 @@ _inheritSet        ( false ),
 _logShaders        ( false ),
 _logPath           ( "" ),
 _acceptCallbacksVaryPerFrame( false ),
-_isAbstract        ( false )
+_isAbstract        ( false ),
+_programCacheRevision( 0u )
 {
     // Note: we cannot set _active here. Wait until apply().
     // It will cause a conflict in the Registry.
@@ -704,6 +958,8 @@ _isAbstract        ( false )
 #ifdef USE_STACK_MEMORY
     _vpStackMemory._item.resize(MAX_CONTEXTS);
 #endif
+
+    _fallbackProgram.resize(MAX_CONTEXTS);
 }
 
 
@@ -718,7 +974,8 @@ _logShaders        ( rhs._logShaders ),
 _logPath           ( rhs._logPath ),
 _template          ( osg::clone(rhs._template.get()) ),
 _acceptCallbacksVaryPerFrame( rhs._acceptCallbacksVaryPerFrame ),
-_isAbstract        ( rhs._isAbstract )
+_isAbstract        ( rhs._isAbstract ),
+_programCacheRevision( 0u )
 {    
     // Attribute bindings.
     const osg::Program::AttribBindingList &abl = rhs.getAttribBindingList();
@@ -734,6 +991,8 @@ _isAbstract        ( rhs._isAbstract )
 #ifdef USE_STACK_MEMORY
     _vpStackMemory._item.resize(MAX_CONTEXTS);
 #endif
+
+    _fallbackProgram.resize(MAX_CONTEXTS);
 }
 
 VirtualProgram::~VirtualProgram()
@@ -872,6 +1131,18 @@ VirtualProgram::releaseGLObjects(osg::State* state) const
     }
 
     _programCache.clear();
+    ++_programCacheRevision;
+
+    if ( state )
+    {
+        if ( state->getContextID() < _fallbackProgram.size() )
+            _fallbackProgram[state->getContextID()] = 0L;
+    }
+    else
+    {
+        for(unsigned i=0; i<_fallbackProgram.size(); ++i)
+            _fallbackProgram[i] = 0L;
+    }
 
     _programCacheMutex.unlock();
 }
@@ -1112,6 +1383,7 @@ VirtualProgram::setInheritShaders( bool value )
         {
             _programCacheMutex.lock();
             _programCache.clear();
+            ++_programCacheRevision;
             _programCacheMutex.unlock();
         }
 
@@ -1248,14 +1520,43 @@ VirtualProgram::apply( osg::State& state ) const
         {
             local.programKey.push_back( i->data()._shader.get() );
         }
+        std::size_t programKeyHash = hashProgramKey( local.programKey );
 
         // current frame number, for shader program expiry.
         unsigned frameNumber = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0;
 
+#ifdef PREALLOCATE_APPLY_VARS
+        // check this context's memo first; only this context's draw thread
+        // touches it, so it needs no lock.
+        unsigned revision = _programCacheRevision;
+        if ( local.programMemoRevision != revision )
+        {
+            local.programMemo.clear();
+            local.programMemoRevision = revision;
+        }
+
+        ProgramMap::iterator memo = findProgramEntry( local.programMemo, local.programKey, programKeyHash );
+        if ( memo != local.programMemo.end() )
+        {
+            program = memo->second._program.get();
+
+            // keep the shared entry from expiring; touching it once a frame is enough.
+            if ( memo->second._frameLastUsed != frameNumber )
+            {
+                osg::ref_ptr<osg::Program> shared;
+                _programCacheMutex.lock();
+                const_cast<VirtualProgram*>(this)->readProgramCache(local.programKey, programKeyHash, frameNumber, shared);
+                _programCacheMutex.unlock();
+                memo->second._frameLastUsed = frameNumber;
+            }
+        }
+#endif
+
         // look up the program:
+        if ( !program.valid() )
         {
             _programCacheMutex.lock();
-            const_cast<VirtualProgram*>(this)->readProgramCache(local.programKey, frameNumber, program);
+            const_cast<VirtualProgram*>(this)->readProgramCache(local.programKey, programKeyHash, frameNumber, program);
             _programCacheMutex.unlock();
         }
 
@@ -1272,7 +1573,7 @@ VirtualProgram::apply( osg::State& state ) const
                 Threading::ScopedMutexLock lock(_programCacheMutex);
 
                 // double-check: look again to negate race conditions
-                const_cast<VirtualProgram*>(this)->readProgramCache(local.programKey, frameNumber, program);
+                const_cast<VirtualProgram*>(this)->readProgramCache(local.programKey, programKeyHash, frameNumber, program);
                 if ( !program.valid() )
                 {
                     local.programKey.clear();
@@ -1321,15 +1622,32 @@ VirtualProgram::apply( osg::State& state ) const
                     Registry::programSharedRepo()->share( program );
 
                     // finally, put own new program in the cache.
-                    ProgramEntry& pe = _programCache[local.programKey];
+                    ProgramEntry pe;
+                    pe._key = local.programKey;
                     pe._program = program.get();
                     pe._frameLastUsed = frameNumber;
+                    _programCache.insert( std::make_pair(hashProgramKey(local.programKey), pe) );
 
                     // purge expired programs.
                     const_cast<VirtualProgram*>(this)->removeExpiredProgramsFromCache(state, frameNumber);
                 }
             }
         }
+
+#ifdef PREALLOCATE_APPLY_VARS
+        // remember the program for the next lookup in this context.
+        if ( program.valid() && memo == local.programMemo.end() )
+        {
+            if ( local.programMemo.size() >= MAX_PROGRAM_CACHE_SIZE )
+                local.programMemo.clear();
+
+            ProgramEntry pe;
+            pe._key = local.programKey;
+            pe._program = program.get();
+            pe._frameLastUsed = frameNumber;
+            local.programMemo.insert( std::make_pair(hashProgramKey(local.programKey), pe) );
+        }
+#endif
     }
 
     // finally, apply the program attribute.
@@ -1347,13 +1665,25 @@ VirtualProgram::apply( osg::State& state ) const
         }
 #endif // USE_STACK_MEMORY
 
-        osg::Program::PerContextProgram* pcp;
+        osg::Program::PerContextProgram* pcp = getPCP( program.get(), state );
+
+        // If this context is over its link budget for the frame, render with
+        // the last program this VP used here and link the new one later.
+        bool usingFallback = false;
+        if ( pcp->needsLink() && !reserveProgramLink(state) )
+        {
+            osg::Program* fallback = _fallbackProgram[contextID].get();
+            if ( fallback && fallback != program.get() )
+            {
+                osg::Program::PerContextProgram* fallbackPCP = getPCP( fallback, state );
+                if ( !fallbackPCP->needsLink() && fallbackPCP->isLinked() )
+                {
+                    pcp = fallbackPCP;
+                    usingFallback = true;
+                }
+            }
+        }
 
-#if OSG_VERSION_GREATER_OR_EQUAL(3,3,4)
-        pcp = program->getPCP( state );
-#else
-        pcp = program->getPCP( contextID );
-#endif
         bool useProgram = state.getLastAppliedProgramObject() != pcp;
 
 #ifdef DEBUG_APPLY_COUNTS
@@ -1388,7 +1718,7 @@ VirtualProgram::apply( osg::State& state ) const
         if ( useProgram )
         {
             if( pcp->needsLink() )
-                program->compileGLObjects( state );
+                linkProgram( state, program.get() );
 
             if( pcp->isLinked() )
             {
@@ -1397,6 +1727,9 @@ VirtualProgram::apply( osg::State& state ) const
 
                 pcp->useProgram();
                 state.setLastAppliedProgramObject( pcp );
+
+                if ( !usingFallback && _fallbackProgram[contextID] != program )
+                    _fallbackProgram[contextID] = program.get();
             }
             else
             {
@@ -1433,7 +1766,8 @@ VirtualProgram::removeExpiredProgramsFromCache(osg::State& state, unsigned frame
                 {
                     k->second._program->releaseGLObjects(&state);
                 }
-                k = _programCache.erase(k);
+                _programCache.erase(k++);
+                ++_programCacheRevision;
             }
             else
             {
@@ -1444,10 +1778,10 @@ VirtualProgram::removeExpiredProgramsFromCache(osg::State& state, unsigned frame
 }
 
 bool
-VirtualProgram::readProgramCache(const ProgramKey& vec, unsigned frameNumber, osg::ref_ptr<osg::Program>& program)
-//VirtualProgram::readProgramCache(const ShaderVector& vec, unsigned frameNumber, osg::ref_ptr<osg::Program>& program)
+VirtualProgram::readProgramCache(const ProgramKey& vec, std::size_t hash, unsigned frameNumber, osg::ref_ptr<osg::Program>& program)
 {
-    ProgramMap::iterator p = _programCache.find( vec );
+    // probe by hash, then compare the keys that share it.
+    ProgramMap::iterator p = findProgramEntry( _programCache, vec, hash );
     if ( p != _programCache.end() )
     {
         // update as current..
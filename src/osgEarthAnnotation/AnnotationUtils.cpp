@@ -23,7 +23,10 @@
 #include <osgEarthAnnotation/AnnotationUtils>
 #include <osgEarthSymbology/Color>
 #include <osgEarthSymbology/MeshSubdivider>
+#include <osgEarthFeatures/GeometryCompiler>
+#include <osgEarth/MapNode>
 #include <osgEarth/ThreadingUtils>
+#include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
 #include <osgEarth/VirtualProgram>
 #include <osgEarth/Capabilities>
@@ -38,6 +41,8 @@
 #include <osg/MatrixTransform>
 #include <osg/LightModel>
 #include <osg/Projection>
+#include <osg/observer_ptr>
+#include <map>
 
 using namespace osgEarth;
 using namespace osgEarth::Annotation;
@@ -99,6 +104,138 @@ namespace
         x |= x >> 16;
         return x+1;
     }
+
+    // Labels and icons are created by the thousands, so the state they draw
+    // with is shared: one Font (and therefore one glyph texture atlas) per
+    // font name, and one texture/stateset per icon image. That lets the
+    // render bin draw runs of labels without any state changes in between,
+    // and lets StateSetCache merge the statesets the shader generator makes.
+    struct SharedLabelState
+    {
+        typedef std::map<std::string, osg::ref_ptr<osgText::Font> >       FontMap;
+        typedef std::map<std::string, osg::observer_ptr<osg::StateSet> > IconStateMap;
+
+        Threading::Mutex                    _mutex;
+        FontMap                             _fonts;
+        IconStateMap                        _iconStateSets;
+        osg::ref_ptr<osg::Vec2Array>        _quadTexCoords;
+        osg::ref_ptr<osg::Vec4Array>        _quadColors;
+        osg::ref_ptr<osg::DrawElementsUShort> _quadIndices;
+    };
+
+    SharedLabelState& sharedLabelState()
+    {
+        static SharedLabelState s_state;
+        return s_state;
+    }
+
+    osgText::Font* getSharedFont(const std::string& name)
+    {
+        SharedLabelState& shared = sharedLabelState();
+        Threading::ScopedMutexLock lock( shared._mutex );
+
+        osg::ref_ptr<osgText::Font> font;
+
+        // the default font can change, so it isn't cached here.
+        if ( !name.empty() )
+        {
+            // a font that fails to load is remembered too, so it isn't searched for again.
+            SharedLabelState::FontMap::iterator i = shared._fonts.find(name);
+            if ( i != shared._fonts.end() )
+            {
+                font = i->second.get();
+            }
+            else
+            {
+                font = osgText::readFontFile( name );
+                shared._fonts[name] = font.get();
+            }
+        }
+
+        if ( !font.valid() )
+            font = Registry::instance()->getDefaultFont();
+
+        // mitigates mipmapping issues that cause rendering artifacts for some fonts/placement
+        if ( font.valid() )
+            font->setGlyphImageMargin( 2 );
+
+        return font.get();
+    }
+
+    // Icons loaded from the same file share a texture even when each
+    // node read its own copy of the image.
+    std::string iconKey(const osg::Image* image)
+    {
+        if ( !image->getFileName().empty() )
+            return image->getFileName();
+        return Stringify() << "image:" << (const void*)image;
+    }
+
+    osg::StateSet* getSharedIconStateSet(osg::Image* image)
+    {
+        SharedLabelState& shared = sharedLabelState();
+        Threading::ScopedMutexLock lock( shared._mutex );
+
+        std::string key = iconKey(image);
+
+        // a live stateset keeps its texture and image (and so its key) alive.
+        osg::ref_ptr<osg::StateSet> dstate;
+        SharedLabelState::IconStateMap::iterator i = shared._iconStateSets.find(key);
+        if ( i != shared._iconStateSets.end() && i->second.lock(dstate) )
+            return dstate.release();
+
+        // prune the records whose statesets have gone away.
+        for(SharedLabelState::IconStateMap::iterator j = shared._iconStateSets.begin(); j != shared._iconStateSets.end(); )
+        {
+            if ( !j->second.valid() )
+                shared._iconStateSets.erase( j++ );
+            else
+                ++j;
+        }
+
+        osg::Texture2D* texture = new osg::Texture2D();
+        texture->setFilter(osg::Texture::MIN_FILTER,osg::Texture::LINEAR_MIPMAP_LINEAR);
+        texture->setFilter(osg::Texture::MAG_FILTER,osg::Texture::LINEAR);
+        texture->setResizeNonPowerOfTwoHint(false);
+        texture->setImage( image );
+
+        // set up the decoration.
+        dstate = new osg::StateSet;
+        dstate->setMode(GL_CULL_FACE,osg::StateAttribute::OFF);
+        dstate->setMode(GL_LIGHTING,osg::StateAttribute::OFF);
+        dstate->setTextureAttributeAndModes(0, texture,osg::StateAttribute::ON);
+
+        shared._iconStateSets[key] = dstate.get();
+        return dstate.release();
+    }
+
+    // The parts of an icon quad that are the same for every icon.
+    void getSharedQuadArrays(osg::ref_ptr<osg::Vec2Array>&          tcoords,
+                             osg::ref_ptr<osg::Vec4Array>&          colors,
+                             osg::ref_ptr<osg::DrawElementsUShort>& indices)
+    {
+        SharedLabelState& shared = sharedLabelState();
+        Threading::ScopedMutexLock lock( shared._mutex );
+
+        if ( !shared._quadTexCoords.valid() )
+        {
+            shared._quadTexCoords = new osg::Vec2Array(4);
+            (*shared._quadTexCoords)[0].set(0, 0);
+            (*shared._quadTexCoords)[1].set(1, 0);
+            (*shared._quadTexCoords)[2].set(1, 1);
+            (*shared._quadTexCoords)[3].set(0, 1);
+
+            shared._quadColors = new osg::Vec4Array(1);
+            (*shared._quadColors)[0].set(1.0f,1.0f,1.0,1.0f);
+
+            GLushort quad[] = {0,1,2,0,2,3};
+            shared._quadIndices = new osg::DrawElementsUShort( GL_TRIANGLES, 6, quad );
+        }
+
+        tcoords = shared._quadTexCoords.get();
+        colors  = shared._quadColors.get();
+        indices = shared._quadIndices.get();
+    }
 }
 
 osg::Drawable*
@@ -207,20 +344,10 @@ AnnotationUtils::createTextDrawable(const std::string& text,
     t->setCharacterSize( size );
     t->setColor( symbol && symbol->fill().isSet() ? symbol->fill()->color() : Color::White );
 
-    osgText::Font* font = 0L;
-    if ( symbol && symbol->font().isSet() )
-    {
-        font = osgText::readFontFile( *symbol->font() );
-    }
-    if ( !font )
-        font = Registry::instance()->getDefaultFont();
-
+    osgText::Font* font = getSharedFont( symbol && symbol->font().isSet() ? *symbol->font() : std::string() );
     if ( font )
     {
         t->setFont( font );
-
-        // mitigates mipmapping issues that cause rendering artifacts for some fonts/placement
-        font->setGlyphImageMargin( 2 );
     }
 
     float resFactor = 2.0f;
@@ -278,22 +405,10 @@ AnnotationUtils::createImageGeometry(osg::Image*       image,
     if ( !image )
         return 0L;
 
-    osg::Texture2D* texture = new osg::Texture2D();
-    texture->setFilter(osg::Texture::MIN_FILTER,osg::Texture::LINEAR_MIPMAP_LINEAR);
-    texture->setFilter(osg::Texture::MAG_FILTER,osg::Texture::LINEAR);
-    texture->setResizeNonPowerOfTwoHint(false);
-    texture->setImage( image );
-
-    // set up the decoration.
-    osg::StateSet* dstate = new osg::StateSet;
-    dstate->setMode(GL_CULL_FACE,osg::StateAttribute::OFF);
-    dstate->setMode(GL_LIGHTING,osg::StateAttribute::OFF);
-    dstate->setTextureAttributeAndModes(0, texture,osg::StateAttribute::ON);
-
     // set up the geoset.
     osg::Geometry* geom = new osg::Geometry();
     geom->setUseVertexBufferObjects(true);
-    geom->setStateSet(dstate);
+    geom->setStateSet( getSharedIconStateSet(image) );
 
     float s = scale * image->s();
     float t = scale * image->t();
@@ -318,20 +433,15 @@ AnnotationUtils::createImageGeometry(osg::Image*       image,
     }
     geom->setVertexArray(verts);
 
-    osg::Vec2Array* tcoords = new osg::Vec2Array(4);
-    (*tcoords)[0].set(0, 0);
-    (*tcoords)[1].set(1, 0);
-    (*tcoords)[2].set(1, 1);
-    (*tcoords)[3].set(0, 1);
-    geom->setTexCoordArray(textureUnit,tcoords);
+    osg::ref_ptr<osg::Vec2Array>          tcoords;
+    osg::ref_ptr<osg::Vec4Array>          colors;
+    osg::ref_ptr<osg::DrawElementsUShort> indices;
+    getSharedQuadArrays( tcoords, colors, indices );
 
-    osg::Vec4Array* colors = new osg::Vec4Array(1);
-    (*colors)[0].set(1.0f,1.0f,1.0,1.0f);
-    geom->setColorArray(colors);
+    geom->setTexCoordArray(textureUnit,tcoords.get());
+    geom->setColorArray(colors.get());
     geom->setColorBinding(osg::Geometry::BIND_OVERALL);
-
-    GLushort indices[] = {0,1,2,0,2,3};
-    geom->addPrimitiveSet( new osg::DrawElementsUShort( GL_TRIANGLES, 6, indices ) );
+    geom->addPrimitiveSet( indices.get() );
 
     return geom;
 }
@@ -865,3 +975,98 @@ AnnotationUtils::installOverlayParent(osg::Node* node, const Style& style)
     return node;
 }
 
+
+namespace
+{
+    // Compiled unit shapes, shared by every annotation that draws the
+    // same shape in the same style (see getSharedShapeMesh).
+    struct SharedShapeMeshes
+    {
+        typedef std::map<std::string, osg::observer_ptr<osg::Node> > MeshMap;
+
+        Threading::Mutex _mutex;
+        MeshMap          _meshes;
+    };
+
+    SharedShapeMeshes& sharedShapeMeshes()
+    {
+        static SharedShapeMeshes s_meshes;
+        return s_meshes;
+    }
+}
+
+bool
+AnnotationUtils::styleSupportsShapeTransform(const Style& style)
+{
+    const AltitudeSymbol* alt = style.get<AltitudeSymbol>();
+    if (alt &&
+        alt->technique() == alt->TECHNIQUE_SCENE &&
+        alt->binding() == alt->BINDING_VERTEX)
+    {
+        return false;
+    }
+
+    if (style.has<ExtrusionSymbol>() || style.has<SkinSymbol>())
+        return false;
+
+    const LineSymbol* line = style.get<LineSymbol>();
+    if (line)
+    {
+        if (line->tessellation().isSet() || line->tessellationSize().isSet())
+            return false;
+
+        if (line->stroke().isSet() && line->stroke()->widthUnits() != Units::PIXELS)
+            return false;
+    }
+
+    return true;
+}
+
+osg::ref_ptr<osg::Node>
+AnnotationUtils::getSharedShapeMesh(const std::string& shapeKey,
+                                    Geometry*          unitShape,
+                                    const Style&       style,
+                                    MapNode*           mapNode)
+{
+    std::string key = Stringify()
+        << shapeKey << ";" << (const void*)mapNode << ";" << style.getConfig().toJSON();
+
+    SharedShapeMeshes& shared = sharedShapeMeshes();
+    osg::ref_ptr<osg::Node> mesh;
+    {
+        Threading::ScopedMutexLock lock( shared._mutex );
+        SharedShapeMeshes::MeshMap::iterator i = shared._meshes.find(key);
+        if ( i != shared._meshes.end() && i->second.lock(mesh) )
+            return mesh;
+    }
+
+    // compile outside the lock; it's the expensive part.
+    osg::ref_ptr<Features::Session> session;
+    if ( mapNode )
+        session = new Features::Session( mapNode->getMap() );
+
+    Features::GeometryCompiler compiler;
+    mesh = compiler.compile( unitShape, style, Features::FilterContext(session.get()) );
+    if ( !mesh.valid() )
+        return 0L;
+
+    Threading::ScopedMutexLock lock( shared._mutex );
+
+    // another thread may have compiled the same mesh in the meantime.
+    osg::ref_ptr<osg::Node> existing;
+    SharedShapeMeshes::MeshMap::iterator i = shared._meshes.find(key);
+    if ( i != shared._meshes.end() && i->second.lock(existing) )
+        return existing;
+
+    // prune the records whose meshes have gone away.
+    for(SharedShapeMeshes::MeshMap::iterator j = shared._meshes.begin(); j != shared._meshes.end(); )
+    {
+        if ( !j->second.valid() )
+            shared._meshes.erase( j++ );
+        else
+            ++j;
+    }
+
+    shared._meshes[key] = mesh.get();
+    return mesh;
+}
@@ -28,8 +28,10 @@
 #include <osgEarthSymbology/ExtrusionSymbol>
 #include <osgEarth/MapNode>
 #include <osgEarth/DrapeableNode>
+#include <osgEarth/StringUtils>
 #include <osg/MatrixTransform>
 #include <cmath>
+#include <iomanip>
 
 using namespace osgEarth;
 using namespace osgEarth::Annotation;
@@ -139,21 +141,29 @@ CircleNode::setPie(const bool& pie)
 void
 CircleNode::rebuildGeometry()
 {
-    // construct a local-origin circle.
+    // construct a local-origin unit circle and scale it to the radius, so
+    // circles with the same shape share one mesh and a new radius doesn't
+    // need a recompile.
     GeometryFactory factory;
     Geometry* geom = NULL;
+    std::string key;
+    Distance unit(1.0, Units::METERS);
     if (std::abs(_arcEnd.as(Units::DEGREES) - _arcStart.as(Units::DEGREES)) >= 360.0)
     {
-        geom = factory.createCircle(osg::Vec3d(0,0,0), _radius, _numSegments);
+        geom = factory.createCircle(osg::Vec3d(0,0,0), unit, _numSegments);
+        key = Stringify() << "circle;" << _numSegments;
     }
     else
     {
-        geom = factory.createArc(osg::Vec3d(0,0,0), _radius, _arcStart, _arcEnd, _numSegments, 0L, _pie);
+        geom = factory.createArc(osg::Vec3d(0,0,0), unit, _arcStart, _arcEnd, _numSegments, 0L, _pie);
+        key = Stringify() << std::setprecision(12) << "arc;" << _numSegments
+            << ";" << _arcStart.as(Units::RADIANS) << ";" << _arcEnd.as(Units::RADIANS) << ";" << _pie;
     }
 
     if ( geom )
     {
-        setGeometry( geom );        
+        double r = _radius.as(Units::METERS);
+        setUnitShape( key, geom, osg::Matrixd::scale(r, r, 1.0) );
     }
 }
 
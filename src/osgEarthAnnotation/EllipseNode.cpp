@@ -26,7 +26,9 @@
 #include <osgEarthSymbology/GeometryFactory>
 #include <osgEarth/DrapeableNode>
 #include <osgEarth/MapNode>
+#include <osgEarth/StringUtils>
 #include <cmath>
+#include <iomanip>
 
 using namespace osgEarth;
 using namespace osgEarth::Annotation;
@@ -173,22 +175,37 @@ EllipseNode::setPie(const bool& pie)
 void
 EllipseNode::rebuildGeometry()
 {
-    // construct a local-origin ellipse.
+    // construct a local-origin unit ellipse (a circle) and scale/rotate it
+    // into place, so ellipses with the same shape share one mesh and new
+    // radii or rotation don't need a recompile.
     GeometryFactory factory;
 
     osg::ref_ptr<Geometry> geom;
+    std::string key;
+    Distance unit(1.0, Units::METERS);
+    double a = _radiusMajor.as(Units::METERS);
+    double b = _radiusMinor.as(Units::METERS);
+    double g = _rotationAngle.as(Units::RADIANS);
+    osg::Matrixd transform;
 
     if (std::abs(_arcEnd.as(Units::DEGREES) - _arcStart.as(Units::DEGREES)) >= 360.0)
     {
-        geom = factory.createEllipse(osg::Vec3d(0,0,0), _radiusMajor, _radiusMinor, _rotationAngle, _numSegments);
+        // createEllipse measures the rotation from the Y axis.
+        geom = factory.createEllipse(osg::Vec3d(0,0,0), unit, unit, Angle(90.0, Units::DEGREES), _numSegments);
+        key = Stringify() << "ellipse;" << _numSegments;
+        transform = osg::Matrixd::scale(a, b, 1.0) * osg::Matrixd::rotate(g - osg::PI_2, osg::Z_AXIS);
     }
     else
     {
-        geom = factory.createEllipticalArc(osg::Vec3d(0,0,0), _radiusMajor, _radiusMinor, _rotationAngle, _arcStart, _arcEnd, _numSegments, 0L, _pie);
+        // createEllipticalArc rotates clockwise.
+        geom = factory.createEllipticalArc(osg::Vec3d(0,0,0), unit, unit, Angle(0.0, Units::DEGREES), _arcStart, _arcEnd, _numSegments, 0L, _pie);
+        key = Stringify() << std::setprecision(12) << "ellipticalarc;" << _numSegments
+            << ";" << _arcStart.as(Units::RADIANS) << ";" << _arcEnd.as(Units::RADIANS) << ";" << _pie;
+        transform = osg::Matrixd::scale(a, b, 1.0) * osg::Matrixd::rotate(-g, osg::Z_AXIS);
     }
     if ( geom.valid() )
     {
-        setGeometry( geom.get() );
+        setUnitShape( key, geom.get(), transform );
     }
 }
 
@@ -70,7 +70,7 @@ AddPointHandler::addPoint( float x, float y, osgViewer::View* view )
             GeoPoint featurePoint = mapPoint.transform( feature->getSRS() );
 
             feature->getGeometry()->push_back( featurePoint.vec3d() );            
-            _featureNode->init();            
+            _featureNode->dirtyFeature( feature );            
             return true;
         }        
     }
@@ -127,7 +127,7 @@ public:
       {
           Feature* feature = _featureNode->getFeatures().front();
           (*feature->getGeometry())[_point] =  osg::Vec3d(position.x(), position.y(), 0);
-          _featureNode->init();
+          _featureNode->dirtyFeature( feature );
       }
 
       osg::ref_ptr< FeatureNode > _featureNode;
@@ -41,6 +41,9 @@
 #include <osg/BoundingSphere>
 #include <osg/Polytope>
 #include <osg/Transform>
+#include <osg/MatrixTransform>
+#include <osg/Geometry>
+#include <cstring>
 
 #define LC "[FeatureNode] "
 
@@ -49,6 +52,203 @@ using namespace osgEarth::Annotation;
 using namespace osgEarth::Features;
 using namespace osgEarth::Symbology;
 
+namespace
+{
+    // Flattens a subgraph into pre-order lists of its nodes and drawables.
+    struct CollectNodes : public osg::NodeVisitor
+    {
+        CollectNodes() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN)
+        {
+            setNodeMaskOverride( ~0 );
+        }
+
+        void apply(osg::Node& node)
+        {
+            _nodes.push_back( &node );
+            traverse( node );
+        }
+
+        void apply(osg::Drawable& drawable)
+        {
+            _drawables.push_back( &drawable );
+        }
+
+        std::vector<osg::Node*>     _nodes;
+        std::vector<osg::Drawable*> _drawables;
+    };
+
+    bool sameLayout(const osg::Array* a, const osg::Array* b)
+    {
+        if ( !a || !b )
+            return a == b;
+
+        return
+            a->getType()        == b->getType() &&
+            a->getNumElements() == b->getNumElements() &&
+            a->getBinding()     == b->getBinding();
+    }
+
+    bool sameLayout(const osg::PrimitiveSet* a, const osg::PrimitiveSet* b)
+    {
+        return
+            a->getType()       == b->getType() &&
+            a->getMode()       == b->getMode() &&
+            a->getNumIndices() == b->getNumIndices();
+    }
+
+    bool sameLayout(const osg::Geometry* a, const osg::Geometry* b)
+    {
+        if (!sameLayout(a->getVertexArray(), b->getVertexArray()) ||
+            !sameLayout(a->getNormalArray(), b->getNormalArray()) ||
+            !sameLayout(a->getColorArray(),  b->getColorArray()))
+            return false;
+
+        if (a->getNumTexCoordArrays() != b->getNumTexCoordArrays())
+            return false;
+        for(unsigned i=0; i<a->getNumTexCoordArrays(); ++i)
+            if (!sameLayout(a->getTexCoordArray(i), b->getTexCoordArray(i)))
+                return false;
+
+        if (a->getNumVertexAttribArrays() != b->getNumVertexAttribArrays())
+            return false;
+        for(unsigned i=0; i<a->getNumVertexAttribArrays(); ++i)
+            if (!sameLayout(a->getVertexAttribArray(i), b->getVertexAttribArray(i)))
+                return false;
+
+        if (a->getNumPrimitiveSets() != b->getNumPrimitiveSets())
+            return false;
+        for(unsigned i=0; i<a->getNumPrimitiveSets(); ++i)
+            if (!sameLayout(a->getPrimitiveSet(i), b->getPrimitiveSet(i)))
+                return false;
+
+        return true;
+    }
+
+    void copyArray(osg::Array* dst, const osg::Array* src)
+    {
+        if ( dst && src )
+        {
+            ::memcpy( const_cast<GLvoid*>(dst->getDataPointer()), src->getDataPointer(), src->getTotalDataSize() );
+            dst->dirty();
+        }
+    }
+
+    void copyGeometry(osg::Geometry* dst, const osg::Geometry* src)
+    {
+        copyArray( dst->getVertexArray(), src->getVertexArray() );
+        copyArray( dst->getNormalArray(), src->getNormalArray() );
+        copyArray( dst->getColorArray(),  src->getColorArray() );
+
+        for(unsigned i=0; i<dst->getNumTexCoordArrays(); ++i)
+            copyArray( dst->getTexCoordArray(i), src->getTexCoordArray(i) );
+
+        for(unsigned i=0; i<dst->getNumVertexAttribArrays(); ++i)
+            copyArray( dst->getVertexAttribArray(i), src->getVertexAttribArray(i) );
+
+        for(unsigned i=0; i<dst->getNumPrimitiveSets(); ++i)
+        {
+            osg::PrimitiveSet* dp = dst->getPrimitiveSet(i);
+            const osg::PrimitiveSet* sp = src->getPrimitiveSet(i);
+
+            if ( dp->getType() == osg::PrimitiveSet::DrawArraysPrimitiveType )
+            {
+                osg::DrawArrays* da = static_cast<osg::DrawArrays*>(dp);
+                const osg::DrawArrays* sa = static_cast<const osg::DrawArrays*>(sp);
+                da->setFirst( sa->getFirst() );
+                da->setCount( sa->getCount() );
+                da->dirty();
+            }
+            else if ( dp->getDrawElements() && sp->getDrawElements() )
+            {
+                // re-tessellation can reorder the indices, so copy them too
+                ::memcpy( const_cast<GLvoid*>(dp->getDataPointer()), sp->getDataPointer(), sp->getTotalDataSize() );
+                dp->dirty();
+            }
+            else
+            {
+                dst->setPrimitiveSet( i, const_cast<osg::PrimitiveSet*>(sp) );
+            }
+        }
+
+        // the clamper keeps per-vertex data in the user data container, and
+        // it belongs to the old vertices.
+        dst->setUserDataContainer( const_cast<osg::UserDataContainer*>(src->getUserDataContainer()) );
+
+        dst->dirtyBound();
+        dst->dirtyDisplayList();
+    }
+
+    /**
+     * Copies the vertex data and transforms of a freshly compiled subgraph
+     * into an existing one with the same layout, so the existing GL objects
+     * and compiled state are reused. Returns false (and changes nothing) if
+     * the layouts differ.
+     */
+    bool patchInPlace(osg::Node* target, osg::Node* source)
+    {
+        CollectNodes dst, src;
+        target->accept( dst );
+        source->accept( src );
+
+        if ( dst._nodes.size()     != src._nodes.size() ||
+             dst._drawables.size() != src._drawables.size() )
+            return false;
+
+        for(unsigned i=0; i<dst._nodes.size(); ++i)
+        {
+            osg::Node* d = dst._nodes[i];
+            osg::Node* s = src._nodes[i];
+
+            if ( ::strcmp(d->className(), s->className()) != 0 )
+                return false;
+
+            if ( d->asGroup() && d->asGroup()->getNumChildren() != s->asGroup()->getNumChildren() )
+                return false;
+
+            if ( d->asTransform() && !d->asTransform()->asMatrixTransform() )
+                return false;
+        }
+
+        for(unsigned i=0; i<dst._drawables.size(); ++i)
+        {
+            osg::Geometry* dg = dst._drawables[i]->asGeometry();
+            osg::Geometry* sg = src._drawables[i]->asGeometry();
+            if ( !dg || !sg || !sameLayout(dg, sg) )
+                return false;
+        }
+
+        for(unsigned i=0; i<dst._nodes.size(); ++i)
+        {
+            osg::Node* d = dst._nodes[i];
+            osg::Node* s = src._nodes[i];
+
+            // style expressions can depend on the attributes
+            if ( d->getStateSet() != s->getStateSet() )
+                d->setStateSet( s->getStateSet() );
+
+            if ( d->asTransform() )
+            {
+                d->asTransform()->asMatrixTransform()->setMatrix(
+                    s->asTransform()->asMatrixTransform()->getMatrix() );
+            }
+        }
+
+        for(unsigned i=0; i<dst._drawables.size(); ++i)
+        {
+            osg::Drawable* d = dst._drawables[i];
+            osg::Drawable* s = src._drawables[i];
+
+            if ( d->getStateSet() != s->getStateSet() )
+                d->setStateSet( s->getStateSet() );
+
+            copyGeometry( d->asGeometry(), s->asGeometry() );
+        }
+
+        target->dirtyBound();
+        return true;
+    }
+}
+
 FeatureNode::FeatureNode(MapNode* mapNode,
                          Feature* feature,
                          const Style& in_style,
@@ -58,7 +258,8 @@ AnnotationNode(),
 _options           ( options ),
 _needsRebuild      ( true ),
 _styleSheet        ( styleSheet ),
-_clampDirty        (false)
+_clampDirty        (false),
+_clampDirtyLOD     (0u)
 {
     _features.push_back( feature );
 
@@ -82,7 +283,8 @@ AnnotationNode(),
 _options        ( options ),
 _needsRebuild   ( true ),
 _styleSheet     ( styleSheet ),
-_clampDirty     ( false )
+_clampDirty     ( false ),
+_clampDirtyLOD  ( 0u )
 {
     _features.insert( _features.end(), features.begin(), features.end() );
     FeatureNode::setMapNode( mapNode );
@@ -108,66 +310,26 @@ FeatureNode::build()
 
     const Style &style = getStyle();
 
-    // compilation options.
-    GeometryCompilerOptions options = _options;
-
     // figure out what kind of altitude manipulation we need to perform.
     AnnotationUtils::AltitudePolicy ap;
     AnnotationUtils::getAltitudePolicy( style, ap );
 
-    // If we're doing auto-clamping on the CPU, shut off compiler map clamping
-    // clamping since it would be redundant.
-    if ( ap.sceneClamping )
-    {
-        options.ignoreAltitudeSymbol() = true;
-    }
-
-
     osg::Node* node = _compiled.get();
     if (_needsRebuild || !_compiled.valid() )
     {
-        // Clone the Features before rendering as the GeometryCompiler and it's filters can change the coordinates
-        // of the geometry when performing localization or converting to geocentric.
-        _extent = GeoExtent::INVALID;
+        computeBounds();
 
-        FeatureList clone;
-        for(FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
-        {
-            Feature* feature = new Feature( *itr->get(), osg::CopyOp::DEEP_COPY_ALL);
-            GeoExtent featureExtent(feature->getSRS(), feature->getGeometry()->getBounds());
+        // everything goes back into one batch; features being edited will
+        // be split out again by dirtyFeature().
+        _editGroups.clear();
+        _compiled = new osg::Group();
 
-            if (_extent.isInvalid())
-            {
-                _extent = featureExtent;
-            }
-            else
-            {
-                _extent.expandToInclude( featureExtent );
-            }
-            clone.push_back( feature );
-        }
-
-        // prep the compiler:
-        GeometryCompiler compiler( options );
-        Session* session = new Session( getMapNode()->getMap(), _styleSheet.get() );
+        osg::Node* batch = compile( _features );
+        if ( batch )
+            _compiled->addChild( batch );
 
-        FilterContext context( session, new FeatureProfile( _extent ), _extent );
-
-        _compiled = compiler.compile( clone, style, context );
         node = _compiled.get();
         _needsRebuild = false;
-
-        // Compute the world bounds
-        osg::BoundingSphered bounds;
-        for( FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
-        {
-            osg::BoundingSphered bs;
-            itr->get()->getWorldBound(getMapNode()->getMapSRS(), bs);
-            bounds.expandBy(bs);
-        }
-
-        // The polytope will ensure we only clamp to intersecting tiles:
-        Feature::getWorldBoundingPolytope(bounds, getMapNode()->getMapSRS(), _featurePolytope);
     }
 
     if ( node )
@@ -295,40 +457,230 @@ void FeatureNode::init()
     build();
 }
 
-// This will be called by AnnotationNode when a new terrain tile comes in.
 void
-FeatureNode::onTileAdded(const TileKey&          key,
-                         osg::Node*              graph,
-                         TerrainCallbackContext& context)
+FeatureNode::computeBounds()
 {
-    if (!_clampDirty)
+    _extent = GeoExtent::INVALID;
+
+    osg::BoundingSphered bounds;
+    for(FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
     {
-        bool needsClamp;
+        Feature* feature = itr->get();
+        if ( !feature->getGeometry() )
+            continue;
 
-        if (key.valid())
+        GeoExtent featureExtent(feature->getSRS(), feature->getGeometry()->getBounds());
+        if (_extent.isInvalid())
         {
-            osg::Polytope tope;
-            key.getExtent().createPolytope(tope);
-            needsClamp = tope.contains(this->getBound());
+            _extent = featureExtent;
         }
         else
         {
-            // without a valid tilekey we don't know the extent of the change,
-            // so clamping is required.
-            needsClamp = true;
+            _extent.expandToInclude( featureExtent );
         }
 
-        if (needsClamp)
+        // Compute the world bounds
+        osg::BoundingSphered bs;
+        feature->getWorldBound(getMapNode()->getMapSRS(), bs);
+        bounds.expandBy(bs);
+    }
+
+    // The polytope will ensure we only clamp to intersecting tiles:
+    Feature::getWorldBoundingPolytope(bounds, getMapNode()->getMapSRS(), _featurePolytope);
+}
+
+osg::Node*
+FeatureNode::compile(const FeatureList& features)
+{
+    const Style &style = getStyle();
+
+    // compilation options.
+    GeometryCompilerOptions options = _options;
+
+    // If we're doing auto-clamping on the CPU, shut off compiler map clamping
+    // clamping since it would be redundant.
+    AnnotationUtils::AltitudePolicy ap;
+    AnnotationUtils::getAltitudePolicy( style, ap );
+    if ( ap.sceneClamping )
+    {
+        options.ignoreAltitudeSymbol() = true;
+    }
+
+    // Clone the Features before rendering as the GeometryCompiler and it's filters can change the coordinates
+    // of the geometry when performing localization or converting to geocentric.
+    GeoExtent extent = GeoExtent::INVALID;
+
+    FeatureList clone;
+    for(FeatureList::const_iterator itr = features.begin(); itr != features.end(); ++itr)
+    {
+        Feature* feature = new Feature( *itr->get(), osg::CopyOp::DEEP_COPY_ALL);
+        if ( feature->getGeometry() )
+        {
+            GeoExtent featureExtent(feature->getSRS(), feature->getGeometry()->getBounds());
+            if (extent.isInvalid())
+                extent = featureExtent;
+            else
+                extent.expandToInclude( featureExtent );
+        }
+        clone.push_back( feature );
+    }
+
+    if ( clone.empty() || extent.isInvalid() )
+        return 0L;
+
+    // prep the compiler:
+    GeometryCompiler compiler( options );
+    Session* session = new Session( getMapNode()->getMap(), _styleSheet.get() );
+
+    FilterContext context( session, new FeatureProfile( extent ), extent );
+
+    return compiler.compile( clone, style, context );
+}
+
+void
+FeatureNode::dirtyFeature(Feature* feature)
+{
+    if ( !feature || !getMapNode() || !_compiled.valid() || !_attachPoint || _needsRebuild )
+    {
+        init();
+        return;
+    }
+
+    bool found = false;
+    for(FeatureList::const_iterator itr = _features.begin(); itr != _features.end() && !found; ++itr)
+        found = (itr->get() == feature);
+
+    if ( !found )
+    {
+        init();
+        return;
+    }
+
+    // the (unclamped) extent and polytope follow the edit
+    computeBounds();
+
+    FeatureList single;
+    single.push_back( feature );
+    osg::ref_ptr<osg::Node> node = compile( single );
+
+    // nodes whose vertices must be re-clamped
+    std::vector<osg::Node*> changed;
+
+    EditGroups::iterator e = _editGroups.find( feature );
+    if ( e == _editGroups.end() )
+    {
+        // First edit of this feature: take it out of the batch once, so that
+        // subsequent edits only touch its own geometry.
+        osg::Group* group = new osg::Group();
+        _editGroups[feature] = group;
+
+        FeatureList others;
+        for(FeatureList::const_iterator itr = _features.begin(); itr != _features.end(); ++itr)
+        {
+            if ( itr->get() != feature && _editGroups.find(itr->get()) == _editGroups.end() )
+                others.push_back( itr->get() );
+        }
+
+        osg::Node* batch = compile( others );
+
+        _compiled->removeChildren( 0, _compiled->getNumChildren() );
+        if ( batch )
+        {
+            _compiled->addChild( batch );
+            changed.push_back( batch );
+        }
+
+        for(EditGroups::iterator i = _editGroups.begin(); i != _editGroups.end(); ++i)
+            _compiled->addChild( i->second.get() );
+
+        if ( node.valid() )
+        {
+            group->addChild( node.get() );
+            changed.push_back( node.get() );
+        }
+    }
+    else
+    {
+        osg::Group* group = e->second.get();
+        osg::Node*  old   = group->getNumChildren() > 0 ? group->getChild(0) : 0L;
+
+        if ( old && node.valid() && patchInPlace(old, node.get()) )
+        {
+            changed.push_back( old );
+        }
+        else
+        {
+            group->removeChildren( 0, group->getNumChildren() );
+            if ( node.valid() )
+            {
+                group->addChild( node.get() );
+                changed.push_back( node.get() );
+            }
+        }
+    }
+
+    AnnotationUtils::AltitudePolicy ap;
+    AnnotationUtils::getAltitudePolicy( getStyle(), ap );
+
+    if ( ap.sceneClamping && getMapNode()->getTerrain() )
+    {
+        osg::ref_ptr<Terrain> terrain = getMapNode()->getTerrain();
+        for(unsigned i=0; i<changed.size(); ++i)
+        {
+            clamp( terrain->getGraph(), terrain.get(), changed[i] );
+        }
+    }
+
+    dirtyBound();
+}
+
+// This will be called by AnnotationNode when a new terrain tile comes in.
+void
+FeatureNode::onTileAdded(const TileKey&          key,
+                         osg::Node*              graph,
+                         TerrainCallbackContext& context)
+{
+    // Already set to clamp everything?
+    if (_clampDirty && !_clampDirtyExtent.isValid())
+        return;
+
+    if (key.valid())
+    {
+        osg::Polytope tope;
+        key.getExtent().createPolytope(tope);
+        if (tope.contains(this->getBound()))
+        {
+            // Accumulate the new tiles so the clamp can skip everything else.
+            if (!_clampDirty)
+            {
+                _clampDirtyExtent = key.getExtent();
+                _clampDirtyLOD = key.getLOD();
+                _clampDirty = true;
+                ADJUST_UPDATE_TRAV_COUNT(this, +1);
+            }
+            else
+            {
+                _clampDirtyExtent.expandToInclude(key.getExtent());
+                _clampDirtyLOD = osg::maximum(_clampDirtyLOD, key.getLOD());
+            }
+        }
+    }
+    else
+    {
+        // without a valid tilekey we don't know the extent of the change,
+        // so clamping everything is required.
+        _clampDirtyExtent = GeoExtent::INVALID;
+        if (!_clampDirty)
         {
             _clampDirty = true;
             ADJUST_UPDATE_TRAV_COUNT(this, +1);
-            //clamp(graph, context.getTerrain());
         }
     }
 }
 
 void
-FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
+FeatureNode::clamp(osg::Node* graph, const Terrain* terrain, osg::Node* target,
+                   const GeoExtent& extent, unsigned lod)
 {
     if ( terrain && graph )
     {
@@ -344,8 +696,15 @@ FeatureNode::clamp(osg::Node* graph, const Terrain* terrain)
         clamper.setTerrainSRS( terrain->getSRS() );
         clamper.setPreserveZ( relative );
         clamper.setOffset( offset );
+        clamper.setClampExtent( extent );
+
+        // Batch-sample the map's elevation pool rather than intersecting the scene graph.
+        if ( alt && alt->useElevationData() == true && getMapNode() && getMapNode()->getMap() )
+            clamper.setElevationPool( getMapNode()->getMap()->getElevationPool() );
+        if ( lod > 0u )
+            clamper.setElevationLOD( lod );
 
-        this->accept( clamper );
+        clamper.clamp( target ? target : this );
     }
 }
 
@@ -358,10 +717,12 @@ FeatureNode::traverse(osg::NodeVisitor& nv)
         {
             osg::ref_ptr<Terrain> terrain = getMapNode()->getTerrain();
             if (terrain.valid())
-                clamp(terrain->getGraph(), terrain.get());
+                clamp(terrain->getGraph(), terrain.get(), 0L, _clampDirtyExtent, _clampDirtyLOD);
 
             ADJUST_UPDATE_TRAV_COUNT(this, -1);
             _clampDirty = false;
+            _clampDirtyExtent = GeoExtent::INVALID;
+            _clampDirtyLOD = 0u;
         }
     }
     AnnotationNode::traverse(nv);
@@ -377,7 +738,9 @@ FeatureNode::FeatureNode(MapNode*              mapNode,
                          const Config&         conf,
                          const osgDB::Options* dbOptions ) :
 AnnotationNode(conf),
-_clampDirty(false)
+_needsRebuild(true),
+_clampDirty(false),
+_clampDirtyLOD(0u)
 {
     osg::ref_ptr<Geometry> geom;
     if ( conf.hasChild("geometry") )
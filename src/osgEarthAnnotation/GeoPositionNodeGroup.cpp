@@ -0,0 +1,377 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarthAnnotation/GeoPositionNodeGroup>
+#include <osgEarthAnnotation/GeoPositionNode>
+#include <osgEarthAnnotation/GeoPositionNodeAutoScaler>
+#include <osgEarth/CullingUtils>
+#include <osgEarth/MapNode>
+#include <osgEarth/NodeUtils>
+#include <osgUtil/CullVisitor>
+#include <algorithm>
+
+#define LC "[GeoPositionNodeGroup] "
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+
+
+GeoPositionNodeGroup::GeoPositionNodeGroup() :
+osg::Group      (),
+_mapNodeRequired( true ),
+_clusterPixels  ( 0.0f ),
+_clusterRange   ( 0.0 )
+{
+    // find the map's horizon model on the first update traversal.
+    ADJUST_UPDATE_TRAV_COUNT(this, +1);
+}
+
+GeoPositionNodeGroup::GeoPositionNodeGroup(const GeoPositionNodeGroup& rhs, const osg::CopyOp& op) :
+osg::Group      (),
+_mapNodeRequired( false ),
+_clusterPixels  ( 0.0f ),
+_clusterRange   ( 0.0 )
+{
+    //nop - UNUSED
+}
+
+GeoPositionNodeGroup::~GeoPositionNodeGroup()
+{
+    // give the children back their own callbacks in case they live on
+    // somewhere else.
+    for(unsigned i=0; i<_entries.size(); ++i)
+        release( _entries[i] );
+}
+
+void
+GeoPositionNodeGroup::adopt(Entry& entry, osg::Node* child)
+{
+    entry = Entry();
+
+    GeoPositionNode* geo = dynamic_cast<GeoPositionNode*>(child);
+    if ( !geo )
+        return;
+
+    entry._node = geo;
+
+    // the group does the horizon test for the node.
+    entry._horizon = geo->getHorizonCulling();
+    geo->setHorizonCulling( false );
+
+    // and the auto-scaling, if the node has a scaler.
+    for(osg::Callback* cb = geo->getCullCallback(); cb; cb = cb->getNestedCallback())
+    {
+        GeoPositionNodeAutoScaler* scaler = dynamic_cast<GeoPositionNodeAutoScaler*>(cb);
+        if ( scaler )
+        {
+            entry._scaler    = scaler;
+            entry._autoScale = true;
+            entry._baseScale = scaler->getBaseScale();
+            entry._minScale  = scaler->getMinScale();
+            entry._maxScale  = scaler->getMaxScale();
+            break;
+        }
+    }
+
+    if ( entry._scaler.valid() )
+    {
+        geo->removeCullCallback( entry._scaler.get() );
+    }
+}
+
+void
+GeoPositionNodeGroup::release(Entry& entry)
+{
+    if ( entry._node )
+    {
+        entry._node->setHorizonCulling( entry._horizon );
+
+        if ( entry._scaler.valid() )
+            entry._node->addCullCallback( entry._scaler.get() );
+    }
+
+    entry = Entry();
+}
+
+bool
+GeoPositionNodeGroup::addChild(osg::Node* child)
+{
+    return insertChild( getNumChildren(), child );
+}
+
+bool
+GeoPositionNodeGroup::insertChild(unsigned int index, osg::Node* child)
+{
+    if ( !osg::Group::insertChild(index, child) )
+        return false;
+
+    unsigned pos = std::min( index, (unsigned)_entries.size() );
+    _entries.insert( _entries.begin() + pos, Entry() );
+    adopt( _entries[pos], child );
+    return true;
+}
+
+bool
+GeoPositionNodeGroup::removeChildren(unsigned int pos, unsigned int numChildrenToRemove)
+{
+    if ( pos >= _entries.size() || numChildrenToRemove == 0 )
+        return osg::Group::removeChildren(pos, numChildrenToRemove);
+
+    unsigned end = std::min( pos + numChildrenToRemove, (unsigned)_entries.size() );
+
+    // release before removing, since removal may delete the child.
+    for(unsigned i=pos; i<end; ++i)
+        release( _entries[i] );
+
+    osg::Group::removeChildren( pos, numChildrenToRemove );
+    _entries.erase( _entries.begin() + pos, _entries.begin() + end );
+    return true;
+}
+
+bool
+GeoPositionNodeGroup::setChild(unsigned int i, osg::Node* node)
+{
+    if ( i >= _entries.size() || !node )
+        return osg::Group::setChild(i, node);
+
+    release( _entries[i] );
+    osg::Group::setChild( i, node );
+    adopt( _entries[i], node );
+    return true;
+}
+
+void
+GeoPositionNodeGroup::traverse(osg::NodeVisitor& nv)
+{
+    if ( nv.getVisitorType() == nv.UPDATE_VISITOR && _mapNodeRequired )
+    {
+        MapNode* mapNode = osgEarth::findInNodePath<MapNode>(nv);
+        if ( mapNode )
+        {
+            if ( mapNode->isGeocentric() )
+                _horizonProto = new Horizon( mapNode->getMapSRS() );
+
+            _mapNodeRequired = false;
+            ADJUST_UPDATE_TRAV_COUNT(this, -1);
+        }
+    }
+
+    if ( nv.getVisitorType() == nv.CULL_VISITOR && _entries.size() == _children.size() )
+    {
+        cull( nv );
+    }
+    else
+    {
+        osg::Group::traverse( nv );
+    }
+}
+
+void
+GeoPositionNodeGroup::cull(osg::NodeVisitor& nv)
+{
+    osgUtil::CullVisitor* cv = Culling::asCullVisitor(nv);
+    if ( !cv || !cv->getModelViewMatrix() || !cv->getMVPW() || _entries.empty() )
+    {
+        osg::Group::traverse( nv );
+        return;
+    }
+
+    const unsigned n = _entries.size();
+
+    Scratch& s = _scratch.get( cv->getCurrentCamera() );
+    s._dx.resize( n );
+    s._dy.resize( n );
+    s._dz.resize( n );
+    s._sx.resize( n );
+    s._sy.resize( n );
+    s._size.resize( n );
+    s._draw.assign( n, 1 );
+
+    // Eyepoint in the group's reference frame. Positions are taken relative
+    // to it so the batched math below can run in single precision.
+    osg::Matrixd viewToLocal;
+    viewToLocal.invert( *cv->getModelViewMatrix() );
+    osg::Vec3d eye = osg::Vec3d(0,0,0) * viewToLocal;
+
+    // 1/pixelSize(center, 0.5) is linear in the center point:
+    // 2*(center*psv), split into a constant term and an eye-relative term.
+    const osg::Vec4& psv = cv->getCurrentCullingSet().getPixelSizeVector();
+    const float sizeBase = (float)(2.0*(eye.x()*psv.x() + eye.y()*psv.y() + eye.z()*psv.z() + psv.w()));
+    const float psx = 2.0f*psv.x(), psy = 2.0f*psv.y(), psz = 2.0f*psv.z();
+
+    // If this is an RTT camera see if we have a reference camera so we can
+    // scale the viewport (same as GeoPositionNodeAutoScaler).
+    double viewportScale = 1.0;
+    osg::Camera* cam = cv->getCurrentCamera();
+    if ( cam && cam->isRenderToTextureCamera() && cam->getViewport() )
+    {
+        osg::Camera* refCam = dynamic_cast<osg::Camera*>(cam->getUserData());
+        if ( refCam && refCam->getViewport() )
+            viewportScale = cam->getViewport()->width() / refCam->getViewport()->width();
+    }
+
+    // Eye-relative window matrix, for clustering.
+    osg::Matrixd window = osg::Matrixd::translate(eye) * (*cv->getMVPW());
+    const float m00 = window(0,0), m10 = window(1,0), m20 = window(2,0), m30 = window(3,0);
+    const float m01 = window(0,1), m11 = window(1,1), m21 = window(2,1), m31 = window(3,1);
+    const float m03 = window(0,3), m13 = window(1,3), m23 = window(2,3), m33 = window(3,3);
+
+    // Gather the anchor points.
+    for(unsigned i=0; i<n; ++i)
+    {
+        const Entry& e = _entries[i];
+        if ( e._node )
+        {
+            const osg::Vec3d& anchor = e._node->getGeoTransform()->getMatrix().getTrans();
+            s._dx[i] = (float)(anchor.x() - eye.x());
+            s._dy[i] = (float)(anchor.y() - eye.y());
+            s._dz[i] = (float)(anchor.z() - eye.z());
+        }
+        else
+        {
+            s._dx[i] = s._dy[i] = s._dz[i] = 0.0f;
+        }
+    }
+
+    // Scale factors and window positions for all nodes in one branch-free
+    // loop over flat arrays, which the compiler can vectorize.
+    {
+        const float* dx = &s._dx[0];
+        const float* dy = &s._dy[0];
+        const float* dz = &s._dz[0];
+        float* size = &s._size[0];
+        float* sx = &s._sx[0];
+        float* sy = &s._sy[0];
+
+        for(unsigned i=0; i<n; ++i)
+        {
+            const float x = dx[i], y = dy[i], z = dz[i];
+            size[i] = sizeBase + psx*x + psy*y + psz*z;
+
+            const float w = m03*x + m13*y + m23*z + m33;
+            const float invW = w > 0.0f ? 1.0f/w : 0.0f;
+            sx[i] = (m00*x + m10*y + m20*z + m30) * invW;
+            sy[i] = (m01*x + m11*y + m21*z + m31) * invW;
+        }
+    }
+
+    // Horizon: prefer the one the terrain installed on the visitor, since
+    // its eyepoint is already set.
+    Horizon* horizon = Horizon::get(nv);
+    osg::Matrixd local2world;
+    osg::Vec3d eyeWorld;
+    if ( horizon || _horizonProto.valid() )
+    {
+        local2world = osg::computeLocalToWorld( nv.getNodePath() );
+        eyeWorld = eye * local2world;
+    }
+
+    // Apply the scales and run the horizon test.
+    for(unsigned i=0; i<n; ++i)
+    {
+        Entry& e = _entries[i];
+        if ( !e._node )
+            continue;
+
+        if ( e._autoScale )
+        {
+            double size = osg::clampBetween( (double)s._size[i] * viewportScale, e._minScale, e._maxScale );
+            e._node->getPositionAttitudeTransform()->setScale( osg::componentMultiply(e._baseScale, osg::Vec3d(size,size,size)) );
+            if ( e._node->getCullingActive() == false )
+                e._node->setCullingActive( true );
+        }
+
+        if ( _horizonCulling.getOrUse(e._horizon) && (horizon || _horizonProto.valid()) )
+        {
+            const osg::BoundingSphere& bs = e._node->getBound();
+            osg::Vec3d center = bs.center() * local2world;
+            bool visible = horizon ?
+                horizon->isVisible( center, bs.radius() ) :
+                _horizonProto->isVisible( eyeWorld, center, bs.radius() );
+            if ( !visible )
+                s._draw[i] = 0;
+        }
+    }
+
+    // Screen-space clustering: bin the far nodes into cells and keep only
+    // the highest priority node in each cell.
+    if ( _clusterPixels > 0.0f )
+    {
+        const float range2 = (float)(_clusterRange*_clusterRange);
+        const float cellInv = 1.0f/_clusterPixels;
+
+        s._cells.clear();
+        for(unsigned i=0; i<n; ++i)
+        {
+            if ( !_entries[i]._node || !s._draw[i] )
+                continue;
+
+            const float x = s._dx[i], y = s._dy[i], z = s._dz[i];
+            if ( x*x + y*y + z*z < range2 )
+                continue;
+
+            const float w = m03*x + m13*y + m23*z + m33;
+            if ( w <= 0.0f )
+                continue;
+
+            int cx = (int)floorf( s._sx[i]*cellInv );
+            int cy = (int)floorf( s._sy[i]*cellInv );
+            long long key = (long long)(((unsigned long long)(unsigned)cx << 32) | (unsigned long long)(unsigned)cy);
+            s._cells.push_back( std::make_pair(key, i) );
+        }
+
+        std::sort( s._cells.begin(), s._cells.end() );
+
+        for(unsigned first=0; first<s._cells.size(); )
+        {
+            unsigned last = first+1;
+            while( last < s._cells.size() && s._cells[last].first == s._cells[first].first )
+                ++last;
+
+            if ( last - first > 1 )
+            {
+                // ties go to the node added first.
+                unsigned best = s._cells[first].second;
+                for(unsigned c=first+1; c<last; ++c)
+                {
+                    unsigned i = s._cells[c].second;
+                    if ( _entries[i]._node->getPriority() > _entries[best]._node->getPriority() )
+                        best = i;
+                }
+
+                for(unsigned c=first; c<last; ++c)
+                {
+                    if ( s._cells[c].second != best )
+                        s._draw[ s._cells[c].second ] = 0;
+                }
+            }
+
+            first = last;
+        }
+    }
+
+    for(unsigned i=0; i<n; ++i)
+    {
+        if ( s._draw[i] )
+            _children[i]->accept( nv );
+    }
+}
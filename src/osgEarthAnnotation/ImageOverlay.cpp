@@ -748,7 +748,7 @@ ImageOverlay::clamp(osg::Node* graph, const Terrain* terrain)
         clamper.setTerrainPatch( graph );
         clamper.setTerrainSRS( terrain->getSRS() );
 
-        this->accept( clamper );
+        clamper.clamp( this );
         this->dirtyBound();
     }
 }
@@ -39,7 +39,9 @@ using namespace osgEarth::Features;
 LocalGeometryNode::LocalGeometryNode() :
 GeoPositionNode(),
 _clampRelative(false),
-_clampDirty(false)
+_clampToElevationData(false),
+_clampDirty(false),
+_clampDirtyLOD(0u)
 {
     //nop - unused
 }
@@ -47,7 +49,9 @@ _clampDirty(false)
 LocalGeometryNode::LocalGeometryNode(MapNode* mapNode) :
 GeoPositionNode(),
 _clampRelative(false),
-_clampDirty(false)
+_clampToElevationData(false),
+_clampDirty(false),
+_clampDirtyLOD(0u)
 {
     LocalGeometryNode::setMapNode( mapNode );
     init( 0L );
@@ -60,7 +64,9 @@ GeoPositionNode(),
 _geom    ( geom ),
 _style   ( style ),
 _clampRelative(false),
-_clampDirty(false)
+_clampToElevationData(false),
+_clampDirty(false),
+_clampDirtyLOD(0u)
 {
     LocalGeometryNode::setMapNode( mapNode );
     init( 0L );
@@ -74,7 +80,9 @@ GeoPositionNode(),
 _node    ( node ),
 _style   ( style ),
 _clampRelative(false),
-_clampDirty(false)
+_clampToElevationData(false),
+_clampDirty(false),
+_clampDirtyLOD(0u)
 {
     LocalGeometryNode::setMapNode( mapNode );
     init( 0L );
@@ -112,15 +120,34 @@ void
 LocalGeometryNode::initGeometry(const osgDB::Options* dbOptions)
 {
     osgEarth::clearChildren( getPositionAttitudeTransform() );
+    _unitShapeXform = 0L;
 
     if ( _geom.valid() )
     {
-        osg::ref_ptr<Session> session;
-        if ( getMapNode() )
-            session = new Session(getMapNode()->getMap(), 0L, 0L, dbOptions);
-        
-        GeometryCompiler gc;
-        osg::ref_ptr<osg::Node> node = gc.compile( _geom.get(), getStyle(), FilterContext(session) );
+        osg::ref_ptr<osg::Node> node;
+
+        if ( _unitShape.valid() && AnnotationUtils::styleSupportsShapeTransform(getStyle()) )
+        {
+            osg::ref_ptr<osg::Node> mesh = AnnotationUtils::getSharedShapeMesh(
+                _unitShapeKey, _unitShape.get(), getStyle(), getMapNode() );
+
+            if ( mesh.valid() )
+            {
+                _unitShapeXform = new osg::MatrixTransform( _unitShapeMatrix );
+                _unitShapeXform->addChild( mesh.get() );
+                node = _unitShapeXform.get();
+            }
+        }
+        else
+        {
+            osg::ref_ptr<Session> session;
+            if ( getMapNode() )
+                session = new Session(getMapNode()->getMap(), 0L, 0L, dbOptions);
+
+            GeometryCompiler gc;
+            node = gc.compile( _geom.get(), getStyle(), FilterContext(session) );
+        }
+
         if ( node.valid() )
         {
             node = AnnotationUtils::installOverlayParent( node.get(), getStyle() );
@@ -162,6 +189,8 @@ LocalGeometryNode::setNode( osg::Node* node )
 {
     _node = node;
     _geom = 0L;
+    _unitShape = 0L;
+    _unitShapeKey.clear();
     initNode();
 }
 
@@ -171,9 +200,47 @@ LocalGeometryNode::setGeometry( Geometry* geom )
 {
     _geom = geom;
     _node = 0L;
+    _unitShape = 0L;
+    _unitShapeKey.clear();
     initGeometry(0L);
 }
 
+
+void
+LocalGeometryNode::setUnitShape(const std::string& key, Geometry* unitShape, const osg::Matrixd& transform)
+{
+    // keep the full-size shape for getGeometry() and for styles that can't
+    // use the shared mesh.
+    osg::ref_ptr<Geometry> geom = unitShape->clone();
+    GeometryIterator parts( geom.get(), true );
+    while( parts.hasMore() )
+    {
+        Geometry* part = parts.next();
+        for( Geometry::iterator i = part->begin(); i != part->end(); ++i )
+            *i = (*i) * transform;
+    }
+
+    bool sameMesh =
+        _unitShapeXform.valid() &&
+        _unitShape.valid() &&
+        key == _unitShapeKey;
+
+    _geom            = geom.get();
+    _node            = 0L;
+    _unitShape       = unitShape;
+    _unitShapeKey    = key;
+    _unitShapeMatrix = transform;
+
+    if ( sameMesh )
+    {
+        _unitShapeXform->setMatrix( transform );
+    }
+    else
+    {
+        initGeometry( 0L );
+    }
+}
+
 void
 LocalGeometryNode::applyAltitudeSymbology(const Style& style)
 {
@@ -189,6 +256,8 @@ LocalGeometryNode::applyAltitudeSymbology(const Style& style)
         const AltitudeSymbol* alt = style.get<AltitudeSymbol>();
         if ( alt && alt->technique() == alt->TECHNIQUE_SCENE )
         {
+            _clampToElevationData = alt->useElevationData() == true;
+
             if ( alt->binding() == alt->BINDING_CENTROID )
             {
                 // centroid scene clamping? let GeoTransform do its thing.
@@ -226,8 +295,8 @@ LocalGeometryNode::onTileAdded(const TileKey&          key,
                                osg::Node*              graph, 
                                TerrainCallbackContext& context)
 {
-    // If we are already set to clamp, ignore this
-    if (_clampDirty)
+    // If we are already set to clamp everything, ignore this
+    if (_clampDirty && !_clampDirtyExtent.isValid())
         return;
 
     bool needsClamp;
@@ -251,15 +320,28 @@ LocalGeometryNode::onTileAdded(const TileKey&          key,
 
     if (needsClamp)
     {   
-        //clamp(graph, context.getTerrain());
-        _clampDirty = true;
-        ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        // Accumulate the new tiles so the clamp can skip everything else.
+        if (!key.valid())
+            _clampDirtyExtent = GeoExtent::INVALID;
+        else if (!_clampDirty)
+            _clampDirtyExtent = key.getExtent();
+        else
+            _clampDirtyExtent.expandToInclude(key.getExtent());
+
+        if (key.valid())
+            _clampDirtyLOD = osg::maximum(_clampDirtyLOD, key.getLOD());
+
+        if (!_clampDirty)
+        {
+            _clampDirty = true;
+            ADJUST_UPDATE_TRAV_COUNT(this, +1);
+        }
         OE_DEBUG << LC << "LGN: clamp requested b/c of key " << key.str() << std::endl;
     }
 }
 
 void
-LocalGeometryNode::clamp(osg::Node* graph, const Terrain* terrain)
+LocalGeometryNode::clamp(osg::Node* graph, const Terrain* terrain, const GeoExtent& extent, unsigned lod)
 {
     if (terrain && graph)
     {
@@ -268,9 +350,16 @@ LocalGeometryNode::clamp(osg::Node* graph, const Terrain* terrain)
         clamper.setTerrainPatch( graph );
         clamper.setTerrainSRS( terrain ? terrain->getSRS() : 0L );
         clamper.setPreserveZ( _clampRelative );
+        clamper.setClampExtent( extent );
         //clamper.setOffset( getPosition().alt() );
 
-        this->accept( clamper );
+        // Batch-sample the map's elevation pool rather than intersecting the scene graph.
+        if ( _clampToElevationData && getMapNode() && getMapNode()->getMap() )
+            clamper.setElevationPool( getMapNode()->getMap()->getElevationPool() );
+        if ( lod > 0u )
+            clamper.setElevationLOD( lod );
+
+        clamper.clamp( this );
 
         OE_DEBUG << LC << "LGN: clamped.\n";
     }
@@ -283,10 +372,12 @@ LocalGeometryNode::traverse(osg::NodeVisitor& nv)
     {
         osg::ref_ptr<Terrain> terrain = getGeoTransform()->getTerrain();
         if (terrain.valid())
-            clamp(terrain->getGraph(), terrain.get());
+            clamp(terrain->getGraph(), terrain.get(), _clampDirtyExtent, _clampDirtyLOD);
 
         ADJUST_UPDATE_TRAV_COUNT(this, -1);
         _clampDirty = false;
+        _clampDirtyExtent = GeoExtent::INVALID;
+        _clampDirtyLOD = 0u;
     }
     GeoPositionNode::traverse(nv);
 }
@@ -362,7 +453,9 @@ LocalGeometryNode::LocalGeometryNode(MapNode*              mapNode,
                                      const osgDB::Options* dbOptions) :
 GeoPositionNode( mapNode, conf ),
 _clampRelative(false),
-_clampDirty(false)
+_clampToElevationData(false),
+_clampDirty(false),
+_clampDirtyLOD(0u)
 {
     if ( conf.hasChild("geometry") )
     {
@@ -81,7 +81,12 @@ RectangleNode::setSize( const Linear& width, const Linear& height)
     {
         _width = width;
         _height = height;
-        rebuild();
+
+        // a shared unit square only needs a new scale.
+        if ( _shapeXform.valid() )
+            _shapeXform->setMatrix( getShapeMatrix() );
+        else
+            rebuild();
     }
 }
 
@@ -332,18 +337,47 @@ RectangleNode::setCorner( Corner corner, const GeoPoint& location)
 }
 
 
+osg::Matrixd
+RectangleNode::getShapeMatrix() const
+{
+    return osg::Matrixd::scale( _width.as(Units::METERS), _height.as(Units::METERS), 1.0 );
+}
+
 void
 RectangleNode::rebuild()
 {    
     osgEarth::clearChildren( getPositionAttitudeTransform() );
+    _shapeXform = 0L;
 
-    // construct a local-origin circle.
+    // construct a local-origin rectangle. When the style allows, all
+    // rectangles share one compiled unit square scaled to size.
     GeometryFactory factory;    
-    Geometry* geom = factory.createRectangle(osg::Vec3d(0,0,0), _width, _height);
-    if ( geom )
+    osg::ref_ptr<Geometry> geom;
+    osg::ref_ptr<osg::Node> node;
+    if ( AnnotationUtils::styleSupportsShapeTransform(_style) )
+    {
+        Distance unit(1.0, Units::METERS);
+        geom = factory.createRectangle(osg::Vec3d(0,0,0), unit, unit);
+        osg::ref_ptr<osg::Node> mesh = AnnotationUtils::getSharedShapeMesh("rectangle", geom.get(), _style, getMapNode());
+        if ( mesh.valid() )
+        {
+            _shapeXform = new osg::MatrixTransform( getShapeMatrix() );
+            _shapeXform->addChild( mesh.get() );
+            node = _shapeXform.get();
+        }
+    }
+    else
+    {
+        geom = factory.createRectangle(osg::Vec3d(0,0,0), _width, _height);
+        if ( geom.valid() )
+        {
+            GeometryCompiler compiler;
+            node = compiler.compile( geom.get(), _style, FilterContext(0L) );
+        }
+    }
+
+    if ( geom.valid() )
     {
-        GeometryCompiler compiler;
-        osg::ref_ptr<osg::Node> node = compiler.compile( geom, _style, FilterContext(0L) );
         if ( node )
         {
             node = AnnotationUtils::installOverlayParent( node.get(), _style );
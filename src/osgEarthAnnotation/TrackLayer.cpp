@@ -0,0 +1,439 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarthAnnotation/TrackLayer>
+#include <osgEarth/Registry>
+#include <osgEarth/Capabilities>
+#include <osgEarth/VirtualProgram>
+#include <osgEarth/ShaderGenerator>
+#include <osgEarth/CullingUtils>
+#include <osgEarth/Containers>
+#include <osg/TextureBuffer>
+#include <osg/BlendFunc>
+#include <osg/Geode>
+#include <osg/observer_ptr>
+#include <osgUtil/CullVisitor>
+#include <cstring>
+#include <cmath>
+
+#define LC "[TrackLayer] "
+
+// texture image unit of the track data buffer
+#define TRACK_DATA_TBO_UNIT 5
+
+// set in TrackLayer::_middle when the snapshot there hasn't been picked up yet
+#define SNAPSHOT_DIRTY 4u
+
+using namespace osgEarth;
+using namespace osgEarth::Annotation;
+
+//------------------------------------------------------------------------
+
+/** Register this layer so it can be used in an earth file */
+REGISTER_OSGEARTH_LAYER(tracks, TrackLayer);
+
+namespace
+{
+    const char* trackVertexModel =
+        "#version " GLSL_VERSION_STR "\n"
+        "#extension GL_EXT_gpu_shader4 : enable\n"
+        "#extension GL_ARB_draw_instanced : enable\n"
+        "uniform samplerBuffer oe_tracks_data;\n"
+        "out vec2 oe_tracks_texcoord;\n"
+        "vec2 oe_tracks_corner;\n"
+        "vec4 oe_tracks_aheadPoint;\n"
+        "float oe_tracks_active;\n"
+        "void oe_tracks_vertex_model(inout vec4 vertex)\n"
+        "{\n"
+        "    vec4 pos = texelFetch(oe_tracks_data, 2*gl_InstanceID);\n"
+        "    vec4 dir = texelFetch(oe_tracks_data, 2*gl_InstanceID+1);\n"
+        "    oe_tracks_corner = vertex.xy;\n"
+        "    oe_tracks_texcoord = vertex.xy + vec2(0.5);\n"
+        "    oe_tracks_active = pos.w;\n"
+        "    oe_tracks_aheadPoint = vec4(pos.xyz + dir.xyz, 1.0);\n"
+        "    vertex = vec4(pos.xyz, 1.0);\n"
+        "}\n";
+
+    // expands each instance into a screen-aligned quad, turned so that
+    // "up" on the icon points along the track's heading on screen.
+    const char* trackVertexClip =
+        "#version " GLSL_VERSION_STR "\n"
+        "uniform vec2 oe_tracks_viewport;\n"
+        "uniform vec2 oe_tracks_iconSize;\n"
+        "vec2 oe_tracks_corner;\n"
+        "vec4 oe_tracks_aheadPoint;\n"
+        "float oe_tracks_active;\n"
+        "void oe_tracks_vertex_clip(inout vec4 clip)\n"
+        "{\n"
+        "    if ( oe_tracks_active < 0.5 || clip.w <= 0.0 ) {\n"
+        "        clip = vec4(0.0, 0.0, 2.0, 1.0);\n"
+        "        return;\n"
+        "    }\n"
+        "    vec4 ahead = gl_ModelViewProjectionMatrix * oe_tracks_aheadPoint;\n"
+        "    vec2 fwd = vec2(0.0, 1.0);\n"
+        "    if ( ahead.w > 0.0 ) {\n"
+        "        vec2 screenDir = (ahead.xy/ahead.w - clip.xy/clip.w) * oe_tracks_viewport;\n"
+        "        float len = length(screenDir);\n"
+        "        if ( len > 0.0 ) fwd = screenDir/len;\n"
+        "    }\n"
+        "    vec2 right = vec2(fwd.y, -fwd.x);\n"
+        "    vec2 offset = (oe_tracks_corner.x*right + oe_tracks_corner.y*fwd) * oe_tracks_iconSize;\n"
+        "    clip.xy += (2.0 * offset / oe_tracks_viewport) * clip.w;\n"
+        "}\n";
+
+    const char* trackFragment =
+        "#version " GLSL_VERSION_STR "\n"
+        GLSL_DEFAULT_PRECISION_FLOAT "\n"
+        "uniform sampler2D oe_tracks_icon;\n"
+        "in vec2 oe_tracks_texcoord;\n"
+        "void oe_tracks_fragment(inout vec4 color)\n"
+        "{\n"
+        "    color = texture2D(oe_tracks_icon, oe_tracks_texcoord);\n"
+        "    if ( color.a < 0.05 ) discard;\n"
+        "}\n";
+
+    // Pushes the viewport size of the current camera, which the clip-stage
+    // shader needs to size the icons in pixels.
+    struct ViewportCallback : public osg::NodeCallback
+    {
+        PerObjectFastMap<const osg::Camera*, osg::ref_ptr<osg::StateSet> > _perCam;
+
+        void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            osgUtil::CullVisitor* cv = Culling::asCullVisitor(nv);
+            const osg::Camera* cam = cv ? cv->getCurrentCamera() : 0L;
+            const osg::Viewport* vp = cam ? cam->getViewport() : 0L;
+            if ( !vp )
+            {
+                traverse(node, nv);
+                return;
+            }
+
+            osg::ref_ptr<osg::StateSet>& ss = _perCam.get(cam);
+            if ( !ss.valid() )
+            {
+                ss = new osg::StateSet();
+                ss->addUniform( new osg::Uniform("oe_tracks_viewport", osg::Vec2f(vp->width(), vp->height())) );
+            }
+            else
+            {
+                ss->getUniform("oe_tracks_viewport")->set( osg::Vec2f(vp->width(), vp->height()) );
+            }
+
+            cv->pushStateSet( ss.get() );
+            traverse(node, nv);
+            cv->popStateSet();
+        }
+    };
+
+    // Bounds the instanced geometry by the published track positions.
+    struct TrackBoundCallback : public osg::Drawable::ComputeBoundingBoxCallback
+    {
+        osg::BoundingBox _box;
+
+        osg::BoundingBox computeBound(const osg::Drawable&) const
+        {
+            return _box;
+        }
+    };
+}
+
+namespace osgEarth { namespace Annotation
+{
+    // Picks up newly published track data during the update traversal.
+    struct TrackLayerUpdateCallback : public osg::NodeCallback
+    {
+        osg::observer_ptr<TrackLayer> _layer;
+
+        TrackLayerUpdateCallback(TrackLayer* layer) : _layer(layer) { }
+
+        void operator()(osg::Node* node, osg::NodeVisitor* nv)
+        {
+            osg::ref_ptr<TrackLayer> layer;
+            if ( _layer.lock(layer) )
+                layer->sync();
+            traverse(node, nv);
+        }
+    };
+} }
+
+//------------------------------------------------------------------------
+
+TrackLayer::TrackLayer() :
+VisibleLayer(&_optionsConcrete),
+_options(&_optionsConcrete)
+{
+    init();
+}
+
+TrackLayer::TrackLayer(const TrackLayerOptions& options) :
+VisibleLayer(&_optionsConcrete),
+_options(&_optionsConcrete),
+_optionsConcrete(options)
+{
+    init();
+}
+
+void
+TrackLayer::init()
+{
+    VisibleLayer::init();
+
+    _maxTracks = std::max(1u, options().maxTracks().get());
+
+    // two texels per track have to fit in the texture buffer.
+    unsigned maxTBO = (unsigned)Registry::capabilities().getMaxTextureBufferSize();
+    if ( maxTBO > 0u && 2u*_maxTracks > maxTBO )
+    {
+        OE_WARN << LC << "max_tracks reduced to " << maxTBO/2u << " to fit the texture buffer\n";
+        _maxTracks = maxTBO/2u;
+    }
+
+    // triple buffer: the producer owns _back, the update traversal owns
+    // _front, and the one in the middle changes hands atomically.
+    _staged._texels.assign( 2*_maxTracks, osg::Vec4f(0,0,0,0) );
+    for(unsigned i = 0; i < 3; ++i)
+        _snapshots[i]._texels.assign( 2*_maxTracks, osg::Vec4f(0,0,0,0) );
+    _back   = 0u;
+    _middle.exchange( 1u );
+    _front  = 2u;
+    _anchored = false;
+
+    _root = new osg::MatrixTransform();
+    _root->addUpdateCallback( new TrackLayerUpdateCallback(this) );
+    _root->addCullCallback( new ViewportCallback() );
+
+    // one quad, instanced once per track slot in use.
+    _geom = new osg::Geometry();
+    _geom->setName( "TrackLayer" );
+    _geom->setUseVertexBufferObjects( true );
+    _geom->setUseDisplayList( false );
+    _geom->setDataVariance( osg::Object::DYNAMIC );
+    _geom->setComputeBoundingBoxCallback( new TrackBoundCallback() );
+
+    osg::Vec3Array* verts = new osg::Vec3Array(4);
+    (*verts)[0].set( -0.5f, -0.5f, 0.0f );
+    (*verts)[1].set(  0.5f, -0.5f, 0.0f );
+    (*verts)[2].set(  0.5f,  0.5f, 0.0f );
+    (*verts)[3].set( -0.5f,  0.5f, 0.0f );
+    _geom->setVertexArray( verts );
+
+    GLushort indices[] = {0,1,2,0,2,3};
+    osg::DrawElementsUShort* quad = new osg::DrawElementsUShort( GL_TRIANGLES, 6, indices );
+    quad->setNumInstances( 0 );
+    _geom->addPrimitiveSet( quad );
+
+    osg::Geode* geode = new osg::Geode();
+    geode->addDrawable( _geom.get() );
+    _root->addChild( geode );
+
+    // track data, uploaded whole whenever a new snapshot arrives.
+    _data = new osg::Image();
+    _data->setName( "osgearth.tracklayer.data" );
+    _data->allocateImage( 2*_maxTracks, 1, 1, GL_RGBA, GL_FLOAT );
+    ::memset( _data->data(), 0, _data->getTotalSizeInBytes() );
+    _data->setDataVariance( osg::Object::DYNAMIC );
+
+    osg::TextureBuffer* tbo = new osg::TextureBuffer();
+    tbo->setImage( _data.get() );
+    tbo->setInternalFormat( GL_RGBA32F_ARB );
+    ShaderGenerator::setIgnoreHint( tbo, true );
+
+    _iconTexture = new osg::Texture2D();
+    _iconTexture->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR );
+    _iconTexture->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+    _iconTexture->setResizeNonPowerOfTwoHint( false );
+
+    osg::StateSet* ss = _root->getOrCreateStateSet();
+    ss->setTextureAttribute( TRACK_DATA_TBO_UNIT, tbo );
+    ss->addUniform( new osg::Uniform("oe_tracks_data", TRACK_DATA_TBO_UNIT) );
+    ss->setTextureAttribute( 0, _iconTexture.get() );
+    ss->addUniform( new osg::Uniform("oe_tracks_icon", 0) );
+    _iconSize = new osg::Uniform("oe_tracks_iconSize", osg::Vec2f(0,0));
+    ss->addUniform( _iconSize.get() );
+    ss->setMode( GL_LIGHTING, osg::StateAttribute::OFF );
+    ss->setMode( GL_CULL_FACE, osg::StateAttribute::OFF );
+    ss->setMode( GL_BLEND, osg::StateAttribute::ON );
+    ss->setAttributeAndModes( new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) );
+    ss->setRenderingHint( osg::StateSet::TRANSPARENT_BIN );
+
+    VirtualProgram* vp = VirtualProgram::getOrCreate( ss );
+    vp->setName( "TrackLayer" );
+    vp->setFunction( "oe_tracks_vertex_model", trackVertexModel, ShaderComp::LOCATION_VERTEX_MODEL );
+    vp->setFunction( "oe_tracks_vertex_clip",  trackVertexClip,  ShaderComp::LOCATION_VERTEX_CLIP );
+    vp->setFunction( "oe_tracks_fragment",     trackFragment,    ShaderComp::LOCATION_FRAGMENT_COLORING );
+
+    if ( !Registry::capabilities().supportsDrawInstanced() )
+    {
+        OE_WARN << LC << "Instanced drawing is not available; tracks will not render\n";
+        _root->setNodeMask( 0 );
+    }
+    else if ( options().icon().isSet() )
+    {
+        osg::ref_ptr<osg::Image> icon = options().icon()->getImage( getReadOptions() );
+        if ( icon.valid() )
+            setIcon( icon.get() );
+        else
+            OE_WARN << LC << "Failed to load icon \"" << options().icon()->full() << "\"\n";
+    }
+}
+
+void
+TrackLayer::setIcon(osg::Image* image)
+{
+    _iconTexture->setImage( image );
+    updateIconSize();
+}
+
+osg::Image*
+TrackLayer::getIcon() const
+{
+    return const_cast<osg::Image*>(_iconTexture->getImage());
+}
+
+void
+TrackLayer::updateIconSize()
+{
+    const osg::Image* image = _iconTexture->getImage();
+    float scale = options().iconScale().get();
+    _iconSize->set( image ?
+        osg::Vec2f(scale*(float)image->s(), scale*(float)image->t()) :
+        osg::Vec2f(0,0) );
+}
+
+bool
+TrackLayer::setTrack(unsigned id, const GeoPoint& position, double heading_deg)
+{
+    if ( id >= _maxTracks || !position.isValid() )
+        return false;
+
+    // the local frame gives us both the world position and the
+    // directions of north and east at the track.
+    osg::Matrixd local2world;
+    if ( !position.createLocalToWorld(local2world) )
+        return false;
+
+    osg::Vec3d world = local2world.getTrans();
+
+    // positions are stored relative to an anchor so they fit in floats.
+    if ( !_staged._hasAnchor )
+    {
+        _staged._anchor = world;
+        _staged._hasAnchor = true;
+    }
+
+    double heading = osg::DegreesToRadians(heading_deg);
+    osg::Vec3d dir = osg::Matrixd::transform3x3( osg::Vec3d(sin(heading), cos(heading), 0.0), local2world );
+    dir.normalize();
+
+    osg::Vec3f rel = world - _staged._anchor;
+    _staged._texels[2*id  ].set( rel.x(), rel.y(), rel.z(), 1.0f );
+    _staged._texels[2*id+1].set( dir.x(), dir.y(), dir.z(), 0.0f );
+
+    if ( id >= _staged._count )
+        _staged._count = id+1;
+
+    return true;
+}
+
+void
+TrackLayer::removeTrack(unsigned id)
+{
+    if ( id >= _maxTracks )
+        return;
+
+    _staged._texels[2*id].w() = 0.0f;
+
+    // shrink the instance count past any trailing removed slots.
+    while( _staged._count > 0 && _staged._texels[2*(_staged._count-1)].w() == 0.0f )
+        --_staged._count;
+}
+
+void
+TrackLayer::publish()
+{
+    Snapshot& back = _snapshots[_back];
+
+    // only the slots in use need copying.
+    unsigned numTexels = 2*std::max(_staged._count, back._count);
+    if ( numTexels > 0 )
+        ::memcpy( &back._texels[0], &_staged._texels[0], numTexels*sizeof(osg::Vec4f) );
+
+    back._count     = _staged._count;
+    back._anchor    = _staged._anchor;
+    back._hasAnchor = _staged._hasAnchor;
+
+    back._bound.init();
+    for(unsigned i = 0; i < back._count; ++i)
+    {
+        const osg::Vec4f& t = back._texels[2*i];
+        if ( t.w() != 0.0f )
+            back._bound.expandBy( t.x(), t.y(), t.z() );
+    }
+
+    // hand the snapshot over; whatever was in the middle becomes the new back buffer.
+    _back = _middle.exchange( _back | SNAPSHOT_DIRTY ) & ~SNAPSHOT_DIRTY;
+}
+
+void
+TrackLayer::sync()
+{
+    // nothing new?
+    if ( ((unsigned)_middle & SNAPSHOT_DIRTY) == 0u )
+        return;
+
+    _front = _middle.exchange( _front ) & ~SNAPSHOT_DIRTY;
+    const Snapshot& front = _snapshots[_front];
+
+    if ( front._hasAnchor && !_anchored )
+    {
+        _root->setMatrix( osg::Matrixd::translate(front._anchor) );
+        _anchored = true;
+    }
+
+    // upload all the slots at once.
+    unsigned numTexels = 2*front._count;
+    if ( numTexels > 0 )
+        ::memcpy( _data->data(), &front._texels[0], numTexels*sizeof(osg::Vec4f) );
+    _data->dirty();
+
+    osg::DrawElementsUShort* quad = static_cast<osg::DrawElementsUShort*>(_geom->getPrimitiveSet(0));
+    quad->setNumInstances( front._count );
+    quad->dirty();
+
+    static_cast<TrackBoundCallback*>(_geom->getComputeBoundingBoxCallback())->_box = front._bound;
+    _geom->dirtyBound();
+}
+
+osg::Node*
+TrackLayer::getNode() const
+{
+    return _root.get();
+}
+
+Config
+TrackLayer::getConfig() const
+{
+    Config conf = options().getConfig();
+    conf.key() = "tracks";
+    return conf;
+}
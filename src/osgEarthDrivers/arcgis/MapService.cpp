@@ -1,6 +1,7 @@
 #include "MapService.h"
 #include <osgEarth/JsonUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/Cache>
 #include <osg/Notify>
 #include <sstream>
 #include <limits.h>
@@ -138,7 +139,8 @@ MapService::init( const URI& _uri, const osgDB::ReaderWriter::Options* options )
     std::string sep = uri.full().find( "?" ) == std::string::npos ? "?" : "&";
     std::string json_url = uri.full() + sep + std::string("f=pjson");  // request the data in JSON format
 
-    ReadResult r = URI(json_url).readString( options );
+    osg::ref_ptr<osgDB::Options> readOptions = CacheSettings::createMetadataReadOptions( options );
+    ReadResult r = URI(json_url).readString( readOptions.get() );
     if ( r.failed() )
         return setError( "Unable to read metadata from ArcGIS service" );
 
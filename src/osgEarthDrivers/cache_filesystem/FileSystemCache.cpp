@@ -25,11 +25,20 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/TileCodec>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <algorithm>
 #include <fstream>
+#include <vector>
 #include <sys/stat.h>
 
+#ifdef WIN32
+#  include <sys/utime.h>
+#else
+#  include <utime.h>
+#endif
+
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
 using namespace osgEarth::Threading;
@@ -50,8 +59,8 @@ namespace
     class FileSystemCache : public Cache
     {
     public:
-        FileSystemCache() { } // unused
-        FileSystemCache( const FileSystemCache& rhs, const osg::CopyOp& op ) { } // unused
+        FileSystemCache() : _maintenance(0L) { } // unused
+        FileSystemCache( const FileSystemCache& rhs, const osg::CopyOp& op ) : _maintenance(0L) { } // unused
         META_Object( osgEarth, FileSystemCache );
 
         /**
@@ -61,17 +70,45 @@ namespace
          */
         FileSystemCache( const CacheOptions& options );
 
+        virtual ~FileSystemCache();
+
     public: // Cache interface
 
         CacheBin* addBin( const std::string& binID );
 
         CacheBin* getOrCreateDefaultBin();
 
+    public: // internal
+
+        // Deletes expired records and evicts the least recently accessed
+        // records until the cache fits under its size limit.
+        void runMaintenance();
+
     protected:
 
         void init();
 
         std::string _rootPath;
+        bool        _rawTiles;
+        std::string _rawCompressor;
+        bool        _quantizeHeights;
+
+        FileSystemCacheOptions _fsOptions;
+        CacheMaintenanceThread* _maintenance;
+    };
+
+    /**
+     * Background thread that periodically runs cache maintenance.
+     */
+    class FileSystemCacheMaintenance : public CacheMaintenanceThread
+    {
+    public:
+        FileSystemCacheMaintenance(FileSystemCache* cache, unsigned period) :
+            CacheMaintenanceThread(period), _cache(cache) { }
+    protected:
+        void runMaintenance(bool idle) { _cache->runMaintenance(); }
+    private:
+        FileSystemCache* _cache;
     };
 
     /** 
@@ -81,7 +118,7 @@ namespace
     class FileSystemCacheBin : public CacheBin
     {
     public:
-        FileSystemCacheBin( const std::string& name, const std::string& rootPath );
+        FileSystemCacheBin( const std::string& name, const std::string& rootPath, bool rawTiles, const std::string& rawCompressor, bool quantizeHeights, bool trackAccess );
 
     public: // CacheBin interface
 
@@ -116,9 +153,15 @@ namespace
 
         bool binValidForWriting(bool silent =false);
 
-        const osgDB::Options* mergeOptions(const osgDB::Options* in);
+        osg::ref_ptr<const osgDB::Options> mergeOptions(const osgDB::Options* in);
+
+        osg::Object* readEncoded(const std::string& path);
 
         bool                              _ok;
+        bool                              _rawTiles;       // write images/heightfields with TileCodec
+        std::string                       _rawCompressor;
+        bool                              _quantizeHeights; // write heightfields as 16-bit samples
+        bool                              _trackAccess;    // record read times for LRU eviction
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
         std::string                       _binPath;        // full path to the bin's root folder
@@ -151,6 +194,81 @@ namespace
             meta.fromJSON( bufStr );
         }
     }
+
+    // Marks a file as read just now without changing its modification time,
+    // which is what the cache reports as the age of the record.
+    void touchAccessTime( const std::string& path )
+    {
+        struct stat s;
+        if ( ::stat(path.c_str(), &s) == 0 )
+        {
+            struct ::utimbuf ut;
+            ut.actime = DateTime().asTimeStamp();
+            ut.modtime = s.st_mtime;
+            ::utime( path.c_str(), &ut );
+        }
+    }
+
+    // One cached record (data file plus optional metadata file) as seen by
+    // the maintenance pass.
+    struct CacheRecord
+    {
+        std::string _path;     // full path to the data file
+        off_t       _size;     // bytes used by the data and metadata files
+        TimeStamp   _modified; // when the record was written
+        TimeStamp   _accessed; // when the record was last read or written
+
+        bool operator < (const CacheRecord& rhs) const { return _accessed < rhs._accessed; }
+    };
+    typedef std::vector<CacheRecord> CacheRecords;
+
+    std::string metaPathFor( const std::string& dataPath )
+    {
+        return dataPath.substr(0, dataPath.length() - std::string(OSG_EXT).length()) + ".meta";
+    }
+
+    void collectRecords( const std::string& dir, CacheRecords& records, off_t& total )
+    {
+        osgDB::DirectoryContents dc = osgDB::getDirectoryContents( dir );
+        for( osgDB::DirectoryContents::iterator i = dc.begin(); i != dc.end(); ++i )
+        {
+            if ( i->compare(".") == 0 || i->compare("..") == 0 )
+                continue;
+
+            std::string full = osgDB::concatPaths(dir, *i);
+            osgDB::FileType type = osgDB::fileType( full );
+
+            if ( type == osgDB::DIRECTORY )
+            {
+                collectRecords( full, records, total );
+            }
+            else if ( type == osgDB::REGULAR_FILE && osgDB::getFileExtensionIncludingDot(full) == OSG_EXT )
+            {
+                struct stat s;
+                if ( ::stat(full.c_str(), &s) != 0 )
+                    continue;
+
+                CacheRecord r;
+                r._path     = full;
+                r._size     = s.st_size;
+                r._modified = s.st_mtime;
+                r._accessed = std::max(s.st_atime, s.st_mtime);
+
+                struct stat ms;
+                if ( ::stat(metaPathFor(full).c_str(), &ms) == 0 )
+                    r._size += ms.st_size;
+
+                total += r._size;
+                records.push_back( r );
+            }
+        }
+    }
+
+    bool removeRecord( const CacheRecord& r )
+    {
+        ::unlink( metaPathFor(r._path).c_str() );
+        return ::unlink( r._path.c_str() ) == 0;
+    }
 }
 
 
@@ -165,32 +283,106 @@ namespace
 namespace
 {
     FileSystemCache::FileSystemCache( const CacheOptions& options ) :
-    Cache( options )
+    Cache       ( options ),
+    _fsOptions  ( options ),
+    _maintenance( 0L )
     {
-        FileSystemCacheOptions fsco( options );
-
         // read the root path from ENV is necessary:
-        if ( !fsco.rootPath().isSet())
+        if ( !_fsOptions.rootPath().isSet())
         {           
             const char* cachePath = ::getenv(OSGEARTH_ENV_CACHE_PATH);
             if ( cachePath )
-                fsco.rootPath() = cachePath;
+                _fsOptions.rootPath() = cachePath;
         }
 
-        _rootPath = URI( *fsco.rootPath(), options.referrer() ).full();
+        _rootPath = URI( *_fsOptions.rootPath(), options.referrer() ).full();
+        _rawTiles = TileCodec::parseEncoding( _fsOptions.tileEncoding().get(), _rawCompressor, _quantizeHeights );
         init();
     }
 
+    FileSystemCache::~FileSystemCache()
+    {
+        if ( _maintenance )
+        {
+            _maintenance->stop();
+            delete _maintenance;
+            _maintenance = 0L;
+        }
+    }
+
     void
     FileSystemCache::init()
     {
         OE_INFO << LC << "Opened a filesystem cache at \"" << _rootPath << "\"\n";
+
+        if ( !_rootPath.empty() && (_fsOptions.maxSizeMB().isSet() || _fsOptions.maxAge().isSet()) )
+        {
+            _maintenance = new FileSystemCacheMaintenance( this, _fsOptions.maintenancePeriod().get() );
+            _maintenance->start();
+        }
+    }
+
+    void
+    FileSystemCache::runMaintenance()
+    {
+        CacheRecords records;
+        off_t total = 0;
+        collectRecords( _rootPath, records, total );
+
+        unsigned expired = 0, evicted = 0;
+
+        if ( _fsOptions.maxAge().isSet() )
+        {
+            TimeStamp cutoff = DateTime().asTimeStamp() - _fsOptions.maxAge().get();
+
+            CacheRecords live;
+            live.reserve( records.size() );
+            for( CacheRecords::const_iterator r = records.begin(); r != records.end(); ++r )
+            {
+                if ( r->_modified < cutoff )
+                {
+                    if ( removeRecord(*r) )
+                        ++expired;
+                    total -= r->_size;
+                }
+                else
+                {
+                    live.push_back( *r );
+                }
+            }
+            records.swap( live );
+        }
+
+        if ( _fsOptions.maxSizeMB().isSet() )
+        {
+            off_t maxBytes = (off_t)_fsOptions.maxSizeMB().get() * 1048576;
+            if ( total > maxBytes )
+            {
+                off_t target = CacheMaintenanceThread::getEvictionTarget( maxBytes );
+
+                // least recently accessed first:
+                std::sort( records.begin(), records.end() );
+
+                for( CacheRecords::const_iterator r = records.begin(); r != records.end() && total > target; ++r )
+                {
+                    if ( removeRecord(*r) )
+                        ++evicted;
+                    total -= r->_size;
+                }
+            }
+        }
+
+        if ( expired > 0 || evicted > 0 )
+        {
+            OE_INFO << LC << "Maintenance expired " << expired << " and evicted " << evicted
+                << " record(s); cache size = " << (total/1048576) << " MB" << std::endl;
+        }
     }
 
     CacheBin*
     FileSystemCache::addBin( const std::string& name )
     {
-        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath ) );
+        return _bins.getOrCreate( name, new FileSystemCacheBin( name, _rootPath, _rawTiles, _rawCompressor, _quantizeHeights, _fsOptions.maxSizeMB().isSet() ) );
     }
 
     CacheBin*
@@ -202,7 +394,7 @@ namespace
             Threading::ScopedMutexLock lock( s_defaultBinMutex );
             if ( !_defaultBin.valid() ) // double-check
             {
-                _defaultBin = new FileSystemCacheBin( "__default", _rootPath );
+                _defaultBin = new FileSystemCacheBin( "__default", _rootPath, _rawTiles, _rawCompressor, _quantizeHeights, _fsOptions.maxSizeMB().isSet() );
             }
         }
         return _defaultBin.get();
@@ -288,10 +480,18 @@ namespace
     }
 
     FileSystemCacheBin::FileSystemCacheBin(const std::string&   binID,
-                                           const std::string&   rootPath) :
+                                           const std::string&   rootPath,
+                                           bool                 rawTiles,
+                                           const std::string&   rawCompressor,
+                                           bool                 quantizeHeights,
+                                           bool                 trackAccess) :
     CacheBin            ( binID ),
     _binPathExists      ( false ),
-    _ok( true )
+    _ok( true ),
+    _rawTiles           ( rawTiles ),
+    _rawCompressor      ( rawCompressor ),
+    _quantizeHeights    ( quantizeHeights ),
+    _trackAccess        ( trackAccess )
     {
         _binPath = osgDB::concatPaths( rootPath, binID );
         _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
@@ -306,7 +506,7 @@ namespace
 #endif
     }
 
-    const osgDB::Options*
+    osg::ref_ptr<const osgDB::Options>
     FileSystemCacheBin::mergeOptions(const osgDB::Options* dbo)
     {
         if (!dbo)
@@ -319,12 +519,20 @@ namespace
         }
         else
         {
-            osgDB::Options* merged = Registry::cloneOrCreateOptions(dbo);
-            merged->setPluginStringData("Compressor", "zlib");
-            return merged;
+            // reused while dbo is unchanged, so this doesn't clone on every read and write
+            return getOptionsWithPluginStringData(dbo, "Compressor", "zlib");
         }
     }
 
+    osg::Object*
+    FileSystemCacheBin::readEncoded(const std::string& path)
+    {
+        std::ifstream in( path.c_str(), std::ios_base::in | std::ios_base::binary );
+        if ( in.is_open() && TileCodec::isEncoded(in) )
+            return TileCodec::decode(in);
+        return 0L;
+    }
+
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
@@ -346,17 +554,30 @@ namespace
         {
             ScopedReadLock lock(_mutex);
 
-            r = _rw->readImage( path, dbo.get() );
-            if ( !r.success() )
+            // Records may be in either encoding; try the one we write first.
+            osg::ref_ptr<osg::Object> decoded = _rawTiles ? readEncoded(path) : 0L;
+            if ( !decoded.valid() )
+            {
+                r = _rw->readImage( path, dbo.get() );
+                if ( r.success() )
+                    decoded = r.getImage();
+                else if ( !_rawTiles )
+                    decoded = readEncoded(path);
+            }
+
+            if ( !dynamic_cast<osg::Image*>(decoded.get()) )
                 return ReadResult();
 
+            if ( _trackAccess )
+                touchAccessTime( path );
+
             // read metadata
             Config meta;
             std::string metafile = fileURI.full() + ".meta";
             if ( osgDB::fileExists(metafile) )
                 readMeta( metafile, meta );
 
-            ReadResult rr( r.getImage(), meta );
+            ReadResult rr( decoded.get(), meta );
             rr.setLastModifiedTime(timeStamp);
             return rr;            
         }
@@ -383,17 +604,29 @@ namespace
         {
             ScopedReadLock lock(_mutex);
 
-            r = _rw->readObject( path, dbo.get() );
-            if ( !r.success() )
+            osg::ref_ptr<osg::Object> decoded = _rawTiles ? readEncoded(path) : 0L;
+            if ( !decoded.valid() )
+            {
+                r = _rw->readObject( path, dbo.get() );
+                if ( r.success() )
+                    decoded = r.getObject();
+                else if ( !_rawTiles )
+                    decoded = readEncoded(path);
+            }
+
+            if ( !decoded.valid() )
                 return ReadResult();
 
+            if ( _trackAccess )
+                touchAccessTime( path );
+
             // read metadata
             Config meta;
             std::string metafile = fileURI.full() + ".meta";
             if ( osgDB::fileExists(metafile) )
                 readMeta( metafile, meta );
 
-            ReadResult rr( r.getObject(), meta );
+            ReadResult rr( decoded.get(), meta );
             rr.setLastModifiedTime(timeStamp);
             return rr;            
         }
@@ -438,7 +671,13 @@ namespace
 
             osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
 
-            if ( dynamic_cast<const osg::Image*>(object) )
+            if ( _rawTiles && TileCodec::canEncode(object) )
+            {
+                std::string filename = fileURI.full() + OSG_EXT;
+                std::ofstream out( filename.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+                objWriteOK = out.is_open() && TileCodec::encode( object, out, _rawCompressor, _quantizeHeights );
+            }
+            else if ( dynamic_cast<const osg::Image*>(object) )
             {
                 std::string filename = fileURI.full() + OSG_EXT;
                 r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
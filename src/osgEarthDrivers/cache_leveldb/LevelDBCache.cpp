@@ -26,6 +26,7 @@
 #include <osgDB/FileNameUtils>
 #include <osgDB/ObjectWrapper>
 
+#include <algorithm>
 #include <sys/stat.h>
 #ifndef _WIN32
 #   include <unistd.h>
@@ -40,11 +41,32 @@
 using namespace osgEarth;
 using namespace osgEarth::Drivers::LevelDBCache;
 
+namespace
+{
+    /**
+     * Background thread that periodically runs cache maintenance.
+     */
+    class MaintenanceThread : public CacheMaintenanceThread
+    {
+    public:
+        MaintenanceThread(LevelDBCacheImpl* cache, unsigned period) :
+            CacheMaintenanceThread(period), _cache(cache) { }
+    protected:
+        unsigned getNumAccesses() const { return _cache->getNumAccesses(); }
+        void runMaintenance(bool idle) { _cache->runMaintenance(idle); }
+    private:
+        LevelDBCacheImpl* _cache;
+    };
+}
+
 
 LevelDBCacheImpl::LevelDBCacheImpl( const CacheOptions& options ) :
 osgEarth::Cache( options ),
 _options       ( options ),
-_active        ( true )
+_active        ( true ),
+_db            ( 0L ),
+_maintenance   ( 0L ),
+_needsCompaction( false )
 {
     // Force OSG to initialize the image wrapper. Failure to do this can result
     // in a race condition within OSG when the cache is accessed from multiple threads.
@@ -103,6 +125,13 @@ _active        ( true )
 
 LevelDBCacheImpl::~LevelDBCacheImpl()
 {
+    if ( _maintenance )
+    {
+        _maintenance->stop();
+        delete _maintenance;
+        _maintenance = 0L;
+    }
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -138,6 +167,65 @@ LevelDBCacheImpl::init()
     if ( _active )
     {
         OE_INFO << LC << "Opened a cache at \"" << _rootPath << "\"" << std::endl;
+
+        if ( _db && (_options.maxSizeMB().isSet() || _options.maxAge().isSet()) )
+        {
+            _maintenance = new MaintenanceThread(this, _options.maintenancePeriod().get());
+            _maintenance->start();
+        }
+    }
+}
+
+unsigned
+LevelDBCacheImpl::getNumAccesses() const
+{
+    return (unsigned)_tracker->reads + (unsigned)_tracker->writes;
+}
+
+void
+LevelDBCacheImpl::runMaintenance(bool idle)
+{
+    LevelDBCacheBin* bin = static_cast<LevelDBCacheBin*>( getOrCreateDefaultBin() );
+    if ( !bin )
+        return;
+
+    unsigned expired = 0;
+    if ( _options.maxAge().isSet() )
+    {
+        DateTime cutoff( DateTime().asTimeStamp() - _options.maxAge().get() );
+        expired = bin->purgeOlderThan( cutoff );
+    }
+
+    ::off_t evicted = 0;
+    if ( _tracker->hasSizeLimit() )
+    {
+        ::off_t size     = _tracker->calcSize();
+        ::off_t maxBytes = (::off_t)_options.maxSizeMB().get() * 1048576;
+        if ( size > maxBytes )
+        {
+            evicted = bin->purgeBytes( size - CacheMaintenanceThread::getEvictionTarget(maxBytes) );
+        }
+    }
+
+    if ( expired > 0 || evicted > 0 )
+    {
+        _needsCompaction = true;
+    }
+
+    // Deleting only writes tombstones; compaction reclaims the space. Do it
+    // right away when over the size limit (or the next pass would see the
+    // same size and evict again), otherwise wait for a quiet period.
+    if ( evicted > 0 || (idle && _needsCompaction) )
+    {
+        compact();
+        _needsCompaction = false;
+        _tracker->calcSize();
+    }
+
+    if ( expired > 0 || evicted > 0 )
+    {
+        OE_INFO << LC << "Maintenance expired " << expired << " record(s) and evicted "
+            << (evicted/1048576) << " MB" << std::endl;
     }
 }
 
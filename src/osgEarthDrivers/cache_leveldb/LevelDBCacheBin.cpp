@@ -19,6 +19,8 @@
 #include "LevelDBCacheBin"
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
+#include <osgEarth/TileCodec>
+#include <osgEarth/TileKey>
 #include <osgEarth/Random>
 #include <osgDB/Registry>
 #include <leveldb/write_batch.h>
@@ -66,6 +68,25 @@ namespace
     {
         blend(data, seed);
     }
+
+    // Quadtree prefix of a tile: its root tile, then one digit (0-3) per
+    // LOD. A tile's descendants all share its prefix, and since "!" sorts
+    // before the digits, a tile's own records come just before theirs.
+    bool quadkeyPrefix(unsigned lod, unsigned x, unsigned y, std::string& out)
+    {
+        if ( lod >= 32 )
+            return false;
+
+        std::string digits(lod, '0');
+        for(unsigned i=0; i<lod; ++i)
+        {
+            unsigned bit = lod-1-i;
+            digits[i] = (char)('0' + ((x>>bit)&1) + 2*((y>>bit)&1));
+        }
+
+        out = Stringify() << "qk!" << (x>>lod) << "-" << (y>>lod) << "!" << digits;
+        return true;
+    }
 }
 
 //------------------------------------------------------------------------
@@ -85,7 +106,8 @@ LevelDBCacheBin::LevelDBCacheBin(const std::string& binID,
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
-_debug            ( false )
+_debug            ( false ),
+_quadkeyOrder     ( tracker->options().quadkeyOrder().get() )
 {
     // reader to parse data:
     _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
@@ -93,6 +115,8 @@ _debug            ( false )
     
     if ( ::getenv("OSGEARTH_CACHE_DEBUG") )
         _debug = true;
+
+    _rawTiles = TileCodec::parseEncoding( tracker->options().tileEncoding().get(), _rawCompressor, _quantizeHeights );
 }
 
 LevelDBCacheBin::~LevelDBCacheBin()
@@ -148,10 +172,30 @@ LevelDBCacheBin::dataKey(const std::string& key) const
     return "d" + SEP + binDataKeyTuple(key);
 }
 
+std::string
+LevelDBCacheBin::sortKey(const std::string& key) const
+{
+    if ( !_quadkeyOrder )
+        return key;
+
+    // Tile records are keyed "lod/x/y<suffix>"; re-key those by quadtree
+    // prefix and leave any other key as-is.
+    unsigned lod, x, y;
+    int len = 0;
+    if ( sscanf(key.c_str(), "%u/%u/%u%n", &lod, &x, &y, &len) != 3 )
+        return key;
+
+    std::string prefix;
+    if ( !quadkeyPrefix(lod, x, y, prefix) )
+        return key;
+
+    return prefix + SEP + key.substr(len);
+}
+
 std::string
 LevelDBCacheBin::binDataKeyTuple(const std::string& key) const
 {
-    return getID() + SEP + key;
+    return getID() + SEP + sortKey(key);
 }
 
 std::string
@@ -253,47 +297,65 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
 
     ++_tracker->reads;
 
-    Config metadata;
-    leveldb::Status status;
     leveldb::ReadOptions ro;
 
     // first read the metadata record.
     std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
+    bool hasMeta = _db->Get( ro, metaKey(key), &metavalue ).ok();
         
     // next read the data record.
-    std::string datakey = dataKey(key);
     std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
-    if ( !status.ok() )
+    if ( !_db->Get( ro, dataKey(key), &datavalue ).ok() )
     {
         // main record not found for some reason.
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
     }
 
+    return decode(key, hasMeta ? &metavalue : 0L, datavalue, reader);
+}
+
+ReadResult
+LevelDBCacheBin::decode(const std::string& key, const std::string* metavalue, std::string& datavalue, const Reader& reader)
+{
+    Config metadata;
+    TimeStamp lastModified = (TimeStamp)0;
+    if ( metavalue )
+    {        
+        decodeMeta(*metavalue, metadata);
+        DateTime t( metadata.value(TIME_FIELD));
+        lastModified = t.asTimeStamp();
+    }
+
     // blend the data string
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
 
-    // finally, decode the OSGB stream into an object.
+    // finally, decode the stream into an object (TileCodec or OSGB).
     std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+    osg::ref_ptr<osg::Object> object;
+    if ( TileCodec::isEncoded(datastream) )
     {
-        OE_WARN << LC << "Cache read failure!"
-            << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
-            << "\n";
+        object = TileCodec::decode(datastream);
+        if ( !object.valid() )
+        {
+            OE_WARN << LC << "Cache read failure! TileCodec could not decode (" << key << ")\n";
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+    }
+    else
+    {
+        osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+        if ( !r.success() )
+        {
+            OE_WARN << LC << "Cache read failure!"
+                << "\n reader = " << reader.name()
+                << "\n error detail = " << r.message()
+                << "\n data value = " << datavalue
+                << "\n";
 
-        return ReadResult(ReadResult::RESULT_READER_ERROR);
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+        object = r.getObject();
     }
         
     if ( _debug )
@@ -310,11 +372,39 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
+    ReadResult rr(object.get(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
 }
 
+void
+LevelDBCacheBin::readBatch(const std::vector<std::string>& keys, std::vector<ReadResult>& results, const osgDB::Options* readOptions)
+{
+    results.assign( keys.size(), ReadResult(ReadResult::RESULT_NOT_FOUND) );
+
+    if ( !binValidForReading() || keys.empty() )
+        return;
+
+    // LevelDB has no multi-get; read them all from one snapshot instead so
+    // the batch sees a consistent view of the database.
+    leveldb::ReadOptions ro;
+    ro.snapshot = _db->GetSnapshot();
+
+    ObjectReader reader(_rw.get(), readOptions);
+    for(unsigned i=0; i<keys.size(); ++i)
+    {
+        ++_tracker->reads;
+        std::string metavalue, datavalue;
+        bool hasMeta = _db->Get( ro, metaKey(keys[i]), &metavalue ).ok();
+        if ( _db->Get( ro, dataKey(keys[i]), &datavalue ).ok() )
+        {
+            results[i] = decode(keys[i], hasMeta ? &metavalue : 0L, datavalue, reader);
+        }
+    }
+
+    _db->ReleaseSnapshot( ro.snapshot );
+}
+
 ReadResult
 LevelDBCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
 {
@@ -333,18 +423,18 @@ LevelDBCacheBin::readString(const std::string& key, const osgDB::Options* readOp
 }
 
 bool
-LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+LevelDBCacheBin::serialize(const osg::Object* object, const osgDB::Options* writeOptions, std::string& data, std::string& message)
 {
-    if ( !binValidForWriting() || !object ) 
-        return false;
-        
     osgDB::ReaderWriter::WriteResult r;
     bool objWriteOK = false;
 
-    std::string       data;
     std::stringstream datastream;
 
-    if ( dynamic_cast<const osg::Image*>(object) )
+    if ( _rawTiles && TileCodec::canEncode(object) )
+    {
+        objWriteOK = TileCodec::encode( object, datastream, _rawCompressor, _quantizeHeights );
+    }
+    else if ( dynamic_cast<const osg::Image*>(object) )
     {
         if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
         {
@@ -375,25 +465,50 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
         objWriteOK = r.success();
     }
 
-    if (objWriteOK)
+    if ( !objWriteOK )
     {
-        DateTime now;
-        leveldb::WriteBatch batch;
+        message = r.message();
+        return false;
+    }
+
+    data = datastream.str();
+    if ( _tracker->seed().isSet() )
+        blend(data, _tracker->seed().value());
+
+    return true;
+}
+
+void
+LevelDBCacheBin::addToBatch(leveldb::WriteBatch& batch, const std::string& key, const std::string& data, const Config& meta, const DateTime& now)
+{
+    // write the data:
+    batch.Put( dataKey(key), data );
+
+    // write the timestamp index:
+    batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+
+    // write the metadata:
+    Config metadata(meta);
+    metadata.set( TIME_FIELD, now.asCompactISO8601() );
+    std::string metavalue;
+    encodeMeta( metadata, metavalue );
+    batch.Put( metaKey(key), metavalue );
+}
 
-        // write the data:
-        data = datastream.str();
-        if ( _tracker->seed().isSet() )
-            blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
+bool
+LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+{
+    if ( !binValidForWriting() || !object ) 
+        return false;
 
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+    std::string data, message;
+    bool objWriteOK = serialize(object, writeOptions, data, message);
 
-        // write the metadata:
-        Config metadata(meta);
-        metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+    if (objWriteOK)
+    {
+        DateTime now;
+        leveldb::WriteBatch batch;
+        addToBatch( batch, key, data, meta, now );
 
         objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
 
@@ -413,12 +528,63 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     if ( !objWriteOK )
     {
         OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << key << "); msg = \"" 
-            << r.message() << "\"\n";
+            << message << "\"\n";
     }
 
     return objWriteOK;
 }
 
+bool
+LevelDBCacheBin::writeBatch(const BatchRecords& records, const osgDB::Options* writeOptions)
+{
+    if ( !binValidForWriting() ) 
+        return false;
+
+    // serialize everything into one native batch so it commits in a single write.
+    DateTime now;
+    leveldb::WriteBatch batch;
+    unsigned count = 0u;
+    bool allOK = true;
+
+    for(BatchRecords::const_iterator i = records.begin(); i != records.end(); ++i)
+    {
+        std::string data, message;
+        if ( i->_object.valid() && serialize(i->_object.get(), writeOptions, data, message) )
+        {
+            addToBatch( batch, i->_key, data, i->_meta, now );
+            ++count;
+        }
+        else
+        {
+            OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << i->_key << "); msg = \"" 
+                << message << "\"\n";
+            allOK = false;
+        }
+    }
+
+    if ( count == 0u )
+        return allOK;
+
+    if ( !_db->Write( leveldb::WriteOptions(), &batch ).ok() )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to write batch of " << count << " records\n";
+        return false;
+    }
+
+    for(unsigned i=0; i<count; ++i)
+    {
+        ++_tracker->writes;
+        postWrite();
+    }
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": wrote batch of " << count << " records\n";
+    }
+
+    return allOK;
+}
+
 void
 LevelDBCacheBin::postWrite()
 {
@@ -692,3 +858,131 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
 
     return true;
 }
+
+unsigned
+LevelDBCacheBin::purgeOlderThan(const DateTime& cutoff)
+{
+    if ( !binValidForWriting() )
+        return 0u;
+
+    // the time index sorts by time, so the expired records come first.
+    std::string limit = "t" + SEP + cutoff.asCompactISO8601();
+
+    leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
+
+    unsigned count = 0;
+    for(it->Seek(timeBeginGlobal());
+        it->Valid() && it->key().ToString() < limit;
+        it->Next())
+    {
+        if ( !it->status().ok() )
+            break;
+
+        std::string tuple = it->value().ToString();
+
+        leveldb::WriteOptions wo;
+        _db->Delete( wo, dataKeyFromTuple(tuple) );
+        _db->Delete( wo, metaKeyFromTuple(tuple) );
+        _db->Delete( wo, it->key() );
+        ++count;
+    }
+
+    delete it;
+
+    if ( _debug && count > 0 )
+    {
+        OE_NOTICE << LC << "Expired " << count << " record(s) older than " << cutoff.asISO8601() << std::endl;
+    }
+
+    return count;
+}
+
+::off_t
+LevelDBCacheBin::purgeBytes(::off_t bytes)
+{
+    if ( !binValidForWriting() )
+        return 0;
+
+    leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
+
+    ::off_t  freed = 0;
+    unsigned count = 0;
+    std::string limit = timeEndGlobal();
+
+    for(it->Seek(timeBeginGlobal());
+        freed < bytes && it->Valid() && it->key().ToString() < limit;
+        it->Next())
+    {
+        if ( !it->status().ok() )
+            break;
+
+        std::string tuple = it->value().ToString();
+        std::string dkey = dataKeyFromTuple(tuple);
+        std::string mkey = metaKeyFromTuple(tuple);
+
+        std::string value;
+        if ( _db->Get(leveldb::ReadOptions(), dkey, &value).ok() )
+            freed += value.size();
+        if ( _db->Get(leveldb::ReadOptions(), mkey, &value).ok() )
+            freed += value.size();
+
+        leveldb::WriteOptions wo;
+        _db->Delete( wo, dkey );
+        _db->Delete( wo, mkey );
+        _db->Delete( wo, it->key() );
+        ++count;
+    }
+
+    delete it;
+
+    if ( _debug && count > 0 )
+    {
+        OE_NOTICE << LC << "Evicted " << count << " record(s) (" << (freed/1048576) << " MB)" << std::endl;
+    }
+
+    return freed;
+}
+
+unsigned
+LevelDBCacheBin::prefetch(const TileKey& key)
+{
+    if ( !_quadkeyOrder || !key.valid() || !binValidForReading() )
+        return 0u;
+
+    std::string prefix;
+    if ( !quadkeyPrefix(key.getLOD(), key.getTileX(), key.getTileY(), prefix) )
+        return 0u;
+
+    // The whole subtree is one contiguous key range, so a single iterator
+    // pulls every block in it into the block cache (and the OS file cache).
+    leveldb::ReadOptions ro;
+    ro.fill_cache = true;
+    leveldb::Iterator* it = _db->NewIterator(ro);
+
+    unsigned count = 0;
+    size_t   bytes = 0;
+
+    const std::string ranges[2] = { dataBegin() + prefix, metaBegin() + prefix };
+    for(unsigned r=0; r<2; ++r)
+    {
+        const std::string& begin = ranges[r];
+        for(it->Seek(begin);
+            it->Valid() && it->key().starts_with(begin);
+            it->Next())
+        {
+            bytes += it->value().size();
+            if ( r == 0 )
+                ++count;
+        }
+    }
+
+    delete it;
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Prefetched " << count << " record(s) (" << bytes
+            << " bytes) under " << key.str() << " in bin " << getID() << std::endl;
+    }
+
+    return count;
+}
@@ -0,0 +1,1083 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "MMapCache"
+#include <osgEarth/Cache>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/URI>
+#include <osgEarth/FileUtils>
+#include <osgEarth/DateTime>
+#include <osgEarth/Registry>
+#include <osgEarth/TileCodec>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <osg/Image>
+#include <osg/Node>
+#include <osg/Math>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <cstring>
+#include <cstddef>
+#include <iomanip>
+#include <cstdio>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace osgEarth::Threading;
+
+#define OSG_FORMAT "osgb"
+
+#undef  LC
+#define LC "[MMapCache] "
+
+namespace
+{
+    // On-disk layout of a segment file is a sequence of records:
+    //
+    //   RecordHeader | key | metadata (JSON) | pad | payload | pad
+    //
+    // Each record starts on a RECORD_ALIGN boundary, and so does its payload.
+    // The unused tail of a segment is zero-filled, so scanning stops at the
+    // first header without the magic number.
+
+    const unsigned RECORD_MAGIC = 0x434d454fu; // "OEMC"
+    const unsigned RECORD_ALIGN = 16u;
+    const unsigned INDEX_MAGIC  = 0x584d454fu; // "OEMX"
+    const unsigned INDEX_VERSION = 1u;
+
+    enum RecordType
+    {
+        RECORD_OBJECT    = 1,
+        RECORD_IMAGE     = 2,
+        RECORD_NODE      = 3,
+        RECORD_RAW_IMAGE = 4,   // no longer written
+        RECORD_REMOVED   = 5,
+        RECORD_TILE      = 6    // TileCodec encoding
+    };
+
+    struct RecordHeader
+    {
+        unsigned _magic;
+        unsigned _type;
+        unsigned _keyLength;
+        unsigned _metaLength;
+        unsigned _dataLength;
+        unsigned _reserved;
+        double   _timestamp;
+    };
+
+    inline unsigned align(unsigned n)
+    {
+        return (n + RECORD_ALIGN - 1u) & ~(RECORD_ALIGN - 1u);
+    }
+
+    inline unsigned payloadOffset(const RecordHeader& h)
+    {
+        return align(sizeof(RecordHeader) + h._keyLength + h._metaLength);
+    }
+
+    inline unsigned recordLength(const RecordHeader& h)
+    {
+        return payloadOffset(h) + align(h._dataLength);
+    }
+
+    /**
+     * Reads the record header at an offset in a segment's data, and checks
+     * that it's intact and that the whole record lies before "limit".
+     */
+    inline bool readRecordHeader(const char* data, unsigned offset, unsigned limit, RecordHeader& h)
+    {
+        if ( (unsigned long long)offset + sizeof(RecordHeader) > limit )
+            return false;
+
+        ::memcpy( &h, data+offset, sizeof(RecordHeader) );
+
+        // check the lengths one by one first so recordLength() can't overflow.
+        return
+            h._magic == RECORD_MAGIC &&
+            h._keyLength > 0u && h._keyLength <= 0xffffu &&
+            h._metaLength < limit &&
+            h._dataLength < limit &&
+            (unsigned long long)offset + sizeof(RecordHeader) + h._keyLength + h._metaLength + h._dataLength + 2u*RECORD_ALIGN <= 0xffffffffULL &&
+            recordLength(h) <= limit - offset;
+    }
+
+    /** Read-only stream buffer over a block of mapped memory (no copy). */
+    struct MemoryStreamBuf : public std::streambuf
+    {
+        MemoryStreamBuf(char* data, unsigned length) { setg(data, data, data+length); }
+    };
+
+    /**
+     * One append-only segment file. Writes go through the file descriptor;
+     * reads come from a shared, read-only mapping of the whole segment, so
+     * they see what was written. Nothing read from the mapping is handed out
+     * without copying it first.
+     */
+    class Segment : public osg::Referenced
+    {
+    public:
+        Segment(const std::string& path, unsigned capacity) :
+            _path    ( path ),
+            _capacity( capacity ),
+            _used    ( 0u ),
+            _data    ( 0L )
+#ifdef _WIN32
+            , _file  ( INVALID_HANDLE_VALUE ),
+            _mapping ( 0L )
+#else
+            , _fd    ( -1 )
+#endif
+        {
+            open();
+        }
+
+        bool valid() const { return _data != 0L; }
+
+        const std::string& getPath() const { return _path; }
+
+        unsigned getCapacity() const { return _capacity; }
+
+        char* data() const { return _data; }
+
+        unsigned getUsed() const { return _used; }
+        void setUsed(unsigned used) { _used = used; }
+
+        unsigned getFree() const { return _capacity - _used; }
+
+        /** Writes bytes at an offset in the file. */
+        bool writeAt(unsigned offset, const void* buf, unsigned length)
+        {
+#ifdef _WIN32
+            OVERLAPPED ov;
+            ::memset(&ov, 0, sizeof(ov));
+            ov.Offset = offset;
+            DWORD written = 0;
+            return
+                ::WriteFile(_file, buf, length, &written, &ov) != 0 &&
+                written == length;
+#else
+            const char* ptr = (const char*)buf;
+            while( length > 0u )
+            {
+                ssize_t n = ::pwrite(_fd, ptr, length, (off_t)offset);
+                if ( n <= 0 )
+                    return false;
+                ptr    += n;
+                offset += n;
+                length -= n;
+            }
+            return true;
+#endif
+        }
+
+    protected:
+        virtual ~Segment()
+        {
+            close();
+        }
+
+        void open()
+        {
+#ifdef _WIN32
+            _file = ::CreateFileA(
+                _path.c_str(), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE,
+                0L, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0L );
+            if ( _file == INVALID_HANDLE_VALUE )
+                return;
+
+            LARGE_INTEGER size;
+            if ( !::GetFileSizeEx(_file, &size) || size.QuadPart < (LONGLONG)_capacity )
+            {
+                size.QuadPart = _capacity;
+                ::SetFilePointerEx(_file, size, 0L, FILE_BEGIN);
+                ::SetEndOfFile(_file);
+            }
+
+            _mapping = ::CreateFileMappingA(_file, 0L, PAGE_READONLY, 0, _capacity, 0L);
+            if ( _mapping )
+                _data = (char*)::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, _capacity);
+#else
+            _fd = ::open(_path.c_str(), O_RDWR|O_CREAT, 0666);
+            if ( _fd < 0 )
+                return;
+
+            struct stat s;
+            if ( ::fstat(_fd, &s) != 0 || s.st_size < (off_t)_capacity )
+            {
+                // sparse; disk space is only consumed as records are appended.
+                if ( ::ftruncate(_fd, (off_t)_capacity) != 0 )
+                    return;
+            }
+
+            void* ptr = ::mmap(0L, _capacity, PROT_READ, MAP_SHARED, _fd, 0);
+            if ( ptr != MAP_FAILED )
+                _data = (char*)ptr;
+#endif
+            if ( !_data )
+            {
+                OE_WARN << LC << "Failed to map segment \"" << _path << "\"" << std::endl;
+            }
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if ( _data )
+                ::UnmapViewOfFile(_data);
+            if ( _mapping )
+                ::CloseHandle(_mapping);
+            if ( _file != INVALID_HANDLE_VALUE )
+                ::CloseHandle(_file);
+#else
+            if ( _data )
+                ::munmap(_data, _capacity);
+            if ( _fd >= 0 )
+                ::close(_fd);
+#endif
+            _data = 0L;
+        }
+
+    private:
+        std::string _path;
+        unsigned    _capacity;
+        unsigned    _used;
+        char*       _data;
+#ifdef _WIN32
+        HANDLE      _file;
+        HANDLE      _mapping;
+#else
+        int         _fd;
+#endif
+    };
+
+    /** Index entry locating the latest version of a record. */
+    struct Location
+    {
+        unsigned  _segment;
+        unsigned  _offset;
+        TimeStamp _timestamp;
+    };
+
+    /**
+     * Cache that stores data in memory-mapped segment files.
+     */
+    class MMapCache : public Cache
+    {
+    public:
+        MMapCache() { } // unused
+        MMapCache( const MMapCache& rhs, const osg::CopyOp& op ) { } // unused
+        META_Object( osgEarth, MMapCache );
+
+        /**
+         * Constructs a new memory-mapped cache.
+         * @param options Options structure that comes from a serialized description of
+         *        the object.
+         */
+        MMapCache( const CacheOptions& options );
+
+    public: // Cache interface
+
+        CacheBin* addBin( const std::string& binID );
+
+        CacheBin* getOrCreateDefaultBin();
+
+    protected:
+        std::string _rootPath;
+        unsigned    _segmentSize;
+    };
+
+    /**
+     * Cache bin implementation for a MMapCache.
+     * You don't need to create this object directly; use MMapCache::addBin instead.
+     */
+    class MMapCacheBin : public CacheBin
+    {
+    public:
+        MMapCacheBin( const std::string& name, const std::string& rootPath, unsigned segmentSize );
+
+    public: // CacheBin interface
+
+        ReadResult readObject(const std::string& key, const osgDB::Options* dbo);
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* dbo);
+
+        ReadResult readString(const std::string& key, const osgDB::Options* dbo);
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo);
+
+        bool remove(const std::string& key);
+
+        bool touch(const std::string& key);
+
+        RecordStatus getRecordStatus(const std::string& key);
+
+        bool clear();
+
+        Config readMetadata();
+
+        bool writeMetadata( const Config& meta );
+
+        unsigned getStorageSize();
+
+        std::string getHashedKey(const std::string&) const;
+
+    protected:
+        virtual ~MMapCacheBin();
+
+        ReadResult read(const std::string& key, const osgDB::Options* dbo);
+
+        bool binValidForWriting();
+
+        osg::ref_ptr<const osgDB::Options> mergeOptions(const osgDB::Options* in);
+
+        std::string segmentPath(unsigned i) const;
+
+        bool openSegments();
+
+        void scan(unsigned segment, unsigned from);
+
+        bool append(const std::string& key, unsigned type, const std::string& meta, const char* data, unsigned dataLength, const char* data2, unsigned data2Length);
+
+        bool loadIndex();
+
+        void saveIndex();
+
+        typedef std::map<std::string, Location> Index;
+        typedef std::vector< osg::ref_ptr<Segment> > Segments;
+
+        bool                              _ok;
+        bool                              _opened;
+        unsigned                          _segmentSize;
+        std::string                       _binPath;        // full path to the bin's root folder
+        std::string                       _metaPath;       // full path to the bin's metadata file
+        std::string                       _indexPath;      // full path to the persisted index
+        Index                             _index;
+        Segments                          _segments;
+        osg::ref_ptr<osgDB::ReaderWriter> _rw;
+        osg::ref_ptr<osgDB::Options>      _zlibOptions;
+        mutable Threading::ReadWriteMutex _mutex;
+    };
+}
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    MMapCache::MMapCache( const CacheOptions& options ) :
+    Cache( options )
+    {
+        MMapCacheOptions mco( options );
+
+        // read the root path from ENV is necessary:
+        if ( !mco.rootPath().isSet())
+        {
+            const char* cachePath = ::getenv(OSGEARTH_ENV_CACHE_PATH);
+            if ( cachePath )
+                mco.rootPath() = cachePath;
+        }
+
+        _rootPath = URI( *mco.rootPath(), options.referrer() ).full();
+
+        // keep offsets within 32 bits.
+        _segmentSize = osg::clampBetween(mco.segmentSize().get(), 1u, 2047u) * 1024u * 1024u;
+
+        OE_INFO << LC << "Opened a memory-mapped cache at \"" << _rootPath << "\"\n";
+    }
+
+    CacheBin*
+    MMapCache::addBin( const std::string& name )
+    {
+        return _bins.getOrCreate( name, new MMapCacheBin( name, _rootPath, _segmentSize ) );
+    }
+
+    CacheBin*
+    MMapCache::getOrCreateDefaultBin()
+    {
+        static Threading::Mutex s_defaultBinMutex;
+        if ( !_defaultBin.valid() )
+        {
+            Threading::ScopedMutexLock lock( s_defaultBinMutex );
+            if ( !_defaultBin.valid() ) // double-check
+            {
+                _defaultBin = new MMapCacheBin( "__default", _rootPath, _segmentSize );
+            }
+        }
+        return _defaultBin.get();
+    }
+
+    //------------------------------------------------------------------------
+
+    MMapCacheBin::MMapCacheBin(const std::string& binID,
+                               const std::string& rootPath,
+                               unsigned           segmentSize) :
+    CacheBin    ( binID ),
+    _ok         ( true ),
+    _opened     ( false ),
+    _segmentSize( segmentSize )
+    {
+        _binPath   = osgDB::concatPaths( rootPath, binID );
+        _metaPath  = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
+        _indexPath = osgDB::concatPaths( _binPath, "index.oemx" );
+
+        _rw = osgDB::Registry::instance()->getReaderWriterForExtension(OSG_FORMAT);
+
+#ifdef OSGEARTH_HAVE_ZLIB
+        _zlibOptions = Registry::instance()->cloneOrCreateOptions();
+        _zlibOptions->setPluginStringData("Compressor", "zlib");
+#endif
+
+        // an existing bin is opened right away so reads can be served;
+        // otherwise the folder is created on the first write.
+        if ( osgDB::fileExists(_binPath) )
+        {
+            openSegments();
+        }
+    }
+
+    MMapCacheBin::~MMapCacheBin()
+    {
+        if ( _opened )
+        {
+            saveIndex();
+        }
+    }
+
+    std::string
+    MMapCacheBin::getHashedKey(const std::string& key) const
+    {
+        // keys are stored verbatim in the records; no need to mangle them.
+        return key;
+    }
+
+    std::string
+    MMapCacheBin::segmentPath(unsigned i) const
+    {
+        return osgDB::concatPaths( _binPath, Stringify() << "segment_" << std::setfill('0') << std::setw(5) << i << ".oemc" );
+    }
+
+    bool
+    MMapCacheBin::openSegments()
+    {
+        // assumes exclusive access.
+        if ( _opened )
+            return _ok;
+
+        _opened = true;
+
+        if ( !_rw.valid() )
+        {
+            _ok = false;
+            return false;
+        }
+
+        for(unsigned i=0; osgDB::fileExists(segmentPath(i)); ++i)
+        {
+            osg::ref_ptr<Segment> seg = new Segment(segmentPath(i), _segmentSize);
+            if ( !seg->valid() )
+            {
+                _ok = false;
+                return false;
+            }
+            _segments.push_back( seg.get() );
+        }
+
+        // The persisted index records how far each segment had been indexed;
+        // anything appended after that (e.g. before a crash) is recovered by
+        // scanning. Without an index, scan everything.
+        std::vector<unsigned> indexed( _segments.size(), 0u );
+        if ( loadIndex() )
+        {
+            for(unsigned i=0; i<_segments.size(); ++i)
+                indexed[i] = _segments[i]->getUsed();
+        }
+        else
+        {
+            _index.clear();
+        }
+
+        for(unsigned i=0; i<_segments.size(); ++i)
+        {
+            scan( i, indexed[i] );
+        }
+
+        OE_DEBUG << LC << "Bin [" << getID() << "] opened with " << _index.size() << " records in "
+            << _segments.size() << " segments" << std::endl;
+
+        return true;
+    }
+
+    void
+    MMapCacheBin::scan(unsigned segment, unsigned offset)
+    {
+        Segment* seg = _segments[segment].get();
+        const char* data = seg->data();
+
+        RecordHeader h;
+        while( readRecordHeader(data, offset, seg->getCapacity(), h) )
+        {
+
+            std::string key( data + offset + sizeof(RecordHeader), h._keyLength );
+            if ( h._type == RECORD_REMOVED )
+            {
+                _index.erase( key );
+            }
+            else
+            {
+                Location& loc = _index[key];
+                loc._segment   = segment;
+                loc._offset    = offset;
+                loc._timestamp = (TimeStamp)h._timestamp;
+            }
+
+            offset += recordLength(h);
+        }
+
+        seg->setUsed( offset );
+    }
+
+    bool
+    MMapCacheBin::loadIndex()
+    {
+        std::ifstream in( _indexPath.c_str(), std::ios_base::in | std::ios_base::binary );
+        if ( !in.is_open() )
+            return false;
+
+        unsigned magic = 0u, version = 0u, numSegments = 0u, numRecords = 0u;
+        in.read( (char*)&magic, sizeof(unsigned) );
+        in.read( (char*)&version, sizeof(unsigned) );
+        in.read( (char*)&numSegments, sizeof(unsigned) );
+        if ( !in.good() || magic != INDEX_MAGIC || version != INDEX_VERSION || numSegments > _segments.size() )
+            return false;
+
+        for(unsigned i=0; i<numSegments; ++i)
+        {
+            unsigned used = 0u;
+            in.read( (char*)&used, sizeof(unsigned) );
+            _segments[i]->setUsed( std::min(used, _segments[i]->getCapacity()) );
+        }
+
+        in.read( (char*)&numRecords, sizeof(unsigned) );
+        for(unsigned r=0; r<numRecords && in.good(); ++r)
+        {
+            unsigned keyLength = 0u;
+            double timestamp = 0.0;
+            Location loc;
+            in.read( (char*)&keyLength, sizeof(unsigned) );
+            if ( keyLength > 0xffffu )
+                in.setstate( std::ios_base::failbit );
+            if ( !in.good() )
+                break;
+            std::string key( keyLength, '\0' );
+            if ( keyLength > 0u )
+                in.read( &key[0], keyLength );
+            in.read( (char*)&loc._segment, sizeof(unsigned) );
+            in.read( (char*)&loc._offset, sizeof(unsigned) );
+            in.read( (char*)&timestamp, sizeof(double) );
+            loc._timestamp = (TimeStamp)timestamp;
+
+            // only trust an entry that points at an intact record for the same key.
+            RecordHeader h;
+            if (in.good() &&
+                loc._segment < numSegments &&
+                readRecordHeader(_segments[loc._segment]->data(), loc._offset, _segments[loc._segment]->getUsed(), h) &&
+                h._type != RECORD_REMOVED &&
+                h._keyLength == keyLength &&
+                key.compare(0, std::string::npos, _segments[loc._segment]->data() + loc._offset + sizeof(RecordHeader), keyLength) == 0)
+            {
+                _index[key] = loc;
+            }
+        }
+
+        if ( !in.good() )
+        {
+            for(unsigned i=0; i<_segments.size(); ++i)
+                _segments[i]->setUsed( 0u );
+            return false;
+        }
+
+        return true;
+    }
+
+    void
+    MMapCacheBin::saveIndex()
+    {
+        if ( _segments.empty() )
+            return;
+
+        std::string tempPath = _indexPath + ".tmp";
+        {
+            std::ofstream out( tempPath.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+            if ( !out.is_open() )
+                return;
+
+            unsigned numSegments = _segments.size();
+            unsigned numRecords  = _index.size();
+            out.write( (const char*)&INDEX_MAGIC, sizeof(unsigned) );
+            out.write( (const char*)&INDEX_VERSION, sizeof(unsigned) );
+            out.write( (const char*)&numSegments, sizeof(unsigned) );
+            for(unsigned i=0; i<numSegments; ++i)
+            {
+                unsigned used = _segments[i]->getUsed();
+                out.write( (const char*)&used, sizeof(unsigned) );
+            }
+
+            out.write( (const char*)&numRecords, sizeof(unsigned) );
+            for(Index::const_iterator i = _index.begin(); i != _index.end(); ++i)
+            {
+                unsigned keyLength = i->first.size();
+                double   timestamp = (double)i->second._timestamp;
+                out.write( (const char*)&keyLength, sizeof(unsigned) );
+                out.write( i->first.data(), keyLength );
+                out.write( (const char*)&i->second._segment, sizeof(unsigned) );
+                out.write( (const char*)&i->second._offset, sizeof(unsigned) );
+                out.write( (const char*)&timestamp, sizeof(double) );
+            }
+
+            if ( !out.good() )
+                return;
+        }
+
+        ::remove( _indexPath.c_str() );
+        ::rename( tempPath.c_str(), _indexPath.c_str() );
+    }
+
+    bool
+    MMapCacheBin::binValidForWriting()
+    {
+        // assumes exclusive access.
+        if ( !_opened )
+        {
+            osgEarth::makeDirectoryForFile( _metaPath );
+            if ( !osgDB::fileExists(_binPath) )
+            {
+                OE_WARN << LC << "FAILED to find or create cache bin at [" << _binPath << "]" << std::endl;
+                _opened = true;
+                _ok = false;
+            }
+            else
+            {
+                openSegments();
+            }
+        }
+        return _ok;
+    }
+
+    osg::ref_ptr<const osgDB::Options>
+    MMapCacheBin::mergeOptions(const osgDB::Options* dbo)
+    {
+        if (!dbo)
+        {
+            return _zlibOptions.get();
+        }
+        else if (!_zlibOptions.valid())
+        {
+            return dbo;
+        }
+        else
+        {
+            // reused while dbo is unchanged, so this doesn't clone on every read and write
+            return getOptionsWithPluginStringData(dbo, "Compressor", "zlib");
+        }
+    }
+
+    ReadResult
+    MMapCacheBin::read(const std::string& key, const osgDB::Options* readOptions)
+    {
+        ScopedReadLock lock(_mutex);
+
+        if ( !_opened || !_ok )
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        Index::const_iterator i = _index.find(key);
+        if ( i == _index.end() )
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        Segment* seg = _segments[i->second._segment].get();
+        char* record = seg->data() + i->second._offset;
+
+        RecordHeader h;
+        if ( !readRecordHeader(seg->data(), i->second._offset, seg->getUsed(), h) )
+        {
+            OE_WARN << LC << "Damaged record for \"" << key << "\" in bin [" << getID() << "]" << std::endl;
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        }
+
+        Config meta;
+        if ( h._metaLength > 0u )
+        {
+            meta.fromJSON( std::string(record + sizeof(RecordHeader) + h._keyLength, h._metaLength) );
+        }
+
+        char* payload = record + payloadOffset(h);
+        osg::ref_ptr<osg::Object> object;
+
+        if ( h._type == RECORD_RAW_IMAGE )
+        {
+            // written by an older version; treat it as a miss so it's replaced.
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        }
+        else if ( h._type == RECORD_TILE )
+        {
+            // the decoder copies the data out of the mapping.
+            MemoryStreamBuf buf( payload, h._dataLength );
+            std::istream in( &buf );
+            object = TileCodec::decode( in );
+            if ( !object.valid() )
+            {
+                OE_WARN << LC << "Cache read failure for \"" << key << "\" in bin [" << getID() << "]: TileCodec could not decode" << std::endl;
+                return ReadResult(ReadResult::RESULT_READER_ERROR);
+            }
+        }
+        else
+        {
+            MemoryStreamBuf buf( payload, h._dataLength );
+            std::istream in( &buf );
+
+            osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+
+            osgDB::ReaderWriter::ReadResult r =
+                h._type == RECORD_IMAGE ? _rw->readImage( in, dbo.get() ) :
+                h._type == RECORD_NODE  ? _rw->readNode( in, dbo.get() ) :
+                _rw->readObject( in, dbo.get() );
+
+            if ( !r.success() )
+            {
+                OE_WARN << LC << "Cache read failure for \"" << key << "\" in bin [" << getID() << "]: " << r.message() << std::endl;
+                return ReadResult(ReadResult::RESULT_READER_ERROR);
+            }
+            object = r.getObject();
+        }
+
+        ReadResult rr( object.get(), meta );
+        rr.setLastModifiedTime( i->second._timestamp );
+        return rr;
+    }
+
+    ReadResult
+    MMapCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
+    {
+        ReadResult r = read(key, readOptions);
+        if ( r.succeeded() && !r.getImage() )
+            return ReadResult();
+        return r;
+    }
+
+    ReadResult
+    MMapCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+    {
+        return read(key, readOptions);
+    }
+
+    ReadResult
+    MMapCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
+    {
+        ReadResult r = readObject(key, readOptions);
+        if ( r.succeeded() )
+        {
+            if ( r.get<StringObject>() )
+                return r;
+            else
+                return ReadResult();
+        }
+        else
+        {
+            return r;
+        }
+    }
+
+    bool
+    MMapCacheBin::append(const std::string& key,
+                         unsigned           type,
+                         const std::string& meta,
+                         const char*        data,
+                         unsigned           dataLength,
+                         const char*        data2,
+                         unsigned           data2Length)
+    {
+        // assumes exclusive access.
+        RecordHeader h;
+        ::memset( &h, 0, sizeof(RecordHeader) );
+        h._magic      = RECORD_MAGIC;
+        h._type       = type;
+        h._keyLength  = key.size();
+        h._metaLength = meta.size();
+        h._dataLength = dataLength + data2Length;
+        h._timestamp  = (double)DateTime().asTimeStamp();
+
+        unsigned length = recordLength(h);
+        if ( length > _segmentSize )
+        {
+            OE_WARN << LC << "Record \"" << key << "\" (" << length << " bytes) is larger than a segment; not cached" << std::endl;
+            return false;
+        }
+
+        if ( _segments.empty() || _segments.back()->getFree() < length )
+        {
+            osg::ref_ptr<Segment> seg = new Segment( segmentPath(_segments.size()), _segmentSize );
+            if ( !seg->valid() )
+                return false;
+            _segments.push_back( seg.get() );
+        }
+
+        Segment* seg = _segments.back().get();
+        unsigned offset = seg->getUsed();
+
+        // Write everything but the header first, so a partially written record
+        // is never mistaken for a valid one by the recovery scan.
+        std::string body( payloadOffset(h) - sizeof(RecordHeader), '\0' );
+        ::memcpy( &body[0], key.data(), key.size() );
+        if ( !meta.empty() )
+            ::memcpy( &body[key.size()], meta.data(), meta.size() );
+
+        bool ok =
+            seg->writeAt( offset + sizeof(RecordHeader), body.data(), body.size() ) &&
+            (dataLength  == 0u || seg->writeAt( offset + payloadOffset(h), data, dataLength )) &&
+            (data2Length == 0u || seg->writeAt( offset + payloadOffset(h) + dataLength, data2, data2Length )) &&
+            seg->writeAt( offset, &h, sizeof(RecordHeader) );
+
+        if ( !ok )
+        {
+            OE_WARN << LC << "FAILED to write \"" << key << "\" to " << seg->getPath() << std::endl;
+            return false;
+        }
+
+        seg->setUsed( offset + length );
+
+        if ( type == RECORD_REMOVED )
+        {
+            _index.erase( key );
+        }
+        else
+        {
+            Location& loc = _index[key];
+            loc._segment   = _segments.size()-1;
+            loc._offset    = offset;
+            loc._timestamp = (TimeStamp)h._timestamp;
+        }
+
+        return true;
+    }
+
+    bool
+    MMapCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+    {
+        if ( !object || key.empty() )
+            return false;
+
+        std::string metaJSON = meta.empty() ? std::string() : meta.toJSON();
+
+        // Plain images and heightfields are stored raw (TileCodec) so they
+        // can be read back with a copy instead of the OSGB reader.
+        if ( TileCodec::canEncode(object) )
+        {
+            std::stringstream buf;
+            if ( !TileCodec::encode(object, buf) )
+                return false;
+
+            std::string data = buf.str();
+
+            ScopedWriteLock lock(_mutex);
+            if ( !binValidForWriting() )
+                return false;
+
+            return append( key, RECORD_TILE, metaJSON, data.data(), data.size(), 0L, 0u );
+        }
+
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+
+        // Everything else is serialized to OSGB before taking the lock.
+        std::stringstream buf;
+        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
+        osgDB::ReaderWriter::WriteResult r;
+        unsigned type;
+
+        if ( !_rw.valid() )
+            return false;
+
+        if ( image )
+        {
+            r = _rw->writeImage( *image, buf, dbo.get() );
+            type = RECORD_IMAGE;
+        }
+        else if ( dynamic_cast<const osg::Node*>(object) )
+        {
+            r = _rw->writeNode( *static_cast<const osg::Node*>(object), buf, dbo.get() );
+            type = RECORD_NODE;
+        }
+        else
+        {
+            r = _rw->writeObject( *object, buf, dbo.get() );
+            type = RECORD_OBJECT;
+        }
+
+        if ( !r.success() )
+        {
+            OE_WARN << LC << "FAILED to write \"" << key << "\" to cache bin " << getID()
+                << "; msg = \"" << r.message() << "\"" << std::endl;
+            return false;
+        }
+
+        std::string data = buf.str();
+
+        ScopedWriteLock lock(_mutex);
+        if ( !binValidForWriting() )
+            return false;
+
+        return append( key, type, metaJSON, data.data(), data.size(), 0L, 0u );
+    }
+
+    CacheBin::RecordStatus
+    MMapCacheBin::getRecordStatus(const std::string& key)
+    {
+        ScopedReadLock lock(_mutex);
+        return _index.find(key) != _index.end() ? STATUS_OK : STATUS_NOT_FOUND;
+    }
+
+    bool
+    MMapCacheBin::remove(const std::string& key)
+    {
+        ScopedWriteLock lock(_mutex);
+        if ( _index.find(key) == _index.end() )
+            return false;
+
+        // tombstone, so the removal survives a rescan.
+        return append( key, RECORD_REMOVED, std::string(), 0L, 0u, 0L, 0u );
+    }
+
+    bool
+    MMapCacheBin::touch(const std::string& key)
+    {
+        ScopedWriteLock lock(_mutex);
+        Index::iterator i = _index.find(key);
+        if ( i == _index.end() )
+            return false;
+
+        double now = (double)DateTime().asTimeStamp();
+        Segment* seg = _segments[i->second._segment].get();
+        if ( !seg->writeAt(i->second._offset + offsetof(RecordHeader, _timestamp), &now, sizeof(double)) )
+            return false;
+
+        i->second._timestamp = (TimeStamp)now;
+        return true;
+    }
+
+    bool
+    MMapCacheBin::clear()
+    {
+        ScopedWriteLock lock(_mutex);
+
+        // Nothing outside the bin references a segment, so dropping it here
+        // unmaps and closes the file before it's deleted (which Windows
+        // requires).
+        bool ok = true;
+        for(unsigned i=0; i<_segments.size(); ++i)
+        {
+            std::string path = _segments[i]->getPath();
+            _segments[i] = 0L;
+            if ( ::remove(path.c_str()) != 0 )
+                ok = false;
+        }
+        _segments.clear();
+        _index.clear();
+        ::remove( _indexPath.c_str() );
+        return ok;
+    }
+
+    unsigned
+    MMapCacheBin::getStorageSize()
+    {
+        ScopedReadLock lock(_mutex);
+        unsigned size = 0u;
+        for(unsigned i=0; i<_segments.size(); ++i)
+            size += _segments[i]->getUsed();
+        return size;
+    }
+
+    Config
+    MMapCacheBin::readMetadata()
+    {
+        ScopedReadLock lock(_mutex);
+        if ( !osgDB::fileExists(_metaPath) )
+            return Config();
+
+        Config conf;
+        conf.fromJSON( URI(_metaPath).getString() );
+        return conf;
+    }
+
+    bool
+    MMapCacheBin::writeMetadata( const Config& conf )
+    {
+        ScopedWriteLock lock(_mutex);
+        if ( !binValidForWriting() )
+            return false;
+
+        std::fstream output( _metaPath.c_str(), std::ios_base::out );
+        if ( output.is_open() )
+        {
+            output << conf.toJSON(true);
+            output.flush();
+            output.close();
+            return true;
+        }
+        return false;
+    }
+}
+
+//------------------------------------------------------------------------
+
+/**
+ * Cache driver that stores records in large memory-mapped segment files.
+ */
+class MMapCacheDriver : public CacheDriver
+{
+public:
+    MMapCacheDriver()
+    {
+        supportsExtension( "osgearth_cache_mmap", "Memory-mapped file cache for osgEarth" );
+    }
+
+    virtual const char* className() const
+    {
+        return "Memory-mapped file cache for osgEarth";
+    }
+
+    virtual ReadResult readObject(const std::string& file_name, const Options* options) const
+    {
+        if ( !acceptsExtension(osgDB::getLowerCaseFileExtension( file_name )))
+            return ReadResult::FILE_NOT_HANDLED;
+
+        return ReadResult( new MMapCache( getCacheOptions(options) ) );
+    }
+};
+
+REGISTER_OSGPLUGIN(osgearth_cache_mmap, MMapCacheDriver)
@@ -28,6 +28,7 @@
 #include <rocksdb/cache.h>
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/table.h>
+#include <algorithm>
 #include <sys/stat.h>
 #ifndef _WIN32
 #   include <unistd.h>
@@ -42,11 +43,32 @@
 using namespace osgEarth;
 using namespace osgEarth::Drivers::RocksDBCache;
 
+namespace
+{
+    /**
+     * Background thread that periodically runs cache maintenance.
+     */
+    class MaintenanceThread : public CacheMaintenanceThread
+    {
+    public:
+        MaintenanceThread(RocksDBCacheImpl* cache, unsigned period) :
+            CacheMaintenanceThread(period), _cache(cache) { }
+    protected:
+        unsigned getNumAccesses() const { return _cache->getNumAccesses(); }
+        void runMaintenance(bool idle) { _cache->runMaintenance(idle); }
+    private:
+        RocksDBCacheImpl* _cache;
+    };
+}
+
 
 RocksDBCacheImpl::RocksDBCacheImpl( const CacheOptions& options ) :
 osgEarth::Cache( options ),
 _options       ( options ),
-_active        ( true )
+_active        ( true ),
+_db            ( 0L ),
+_maintenance   ( 0L ),
+_needsCompaction( false )
 {
     // Force OSG to initialize the image wrapper. Failure to do this can result
     // in a race condition within OSG when the cache is accessed from multiple threads.
@@ -105,6 +127,13 @@ _active        ( true )
 
 RocksDBCacheImpl::~RocksDBCacheImpl()
 {
+    if ( _maintenance )
+    {
+        _maintenance->stop();
+        delete _maintenance;
+        _maintenance = 0L;
+    }
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -140,6 +169,65 @@ RocksDBCacheImpl::init()
     if ( _active )
     {
         OE_INFO << LC << "Opened a cache at \"" << _rootPath << "\"" << std::endl;
+
+        if ( _db && (_options.maxSizeMB().isSet() || _options.maxAge().isSet()) )
+        {
+            _maintenance = new MaintenanceThread(this, _options.maintenancePeriod().get());
+            _maintenance->start();
+        }
+    }
+}
+
+unsigned
+RocksDBCacheImpl::getNumAccesses() const
+{
+    return (unsigned)_tracker->reads + (unsigned)_tracker->writes;
+}
+
+void
+RocksDBCacheImpl::runMaintenance(bool idle)
+{
+    RocksDBCacheBin* bin = static_cast<RocksDBCacheBin*>( getOrCreateDefaultBin() );
+    if ( !bin )
+        return;
+
+    unsigned expired = 0;
+    if ( _options.maxAge().isSet() )
+    {
+        DateTime cutoff( DateTime().asTimeStamp() - _options.maxAge().get() );
+        expired = bin->purgeOlderThan( cutoff );
+    }
+
+    ::off_t evicted = 0;
+    if ( _tracker->hasSizeLimit() )
+    {
+        ::off_t size     = _tracker->calcSize();
+        ::off_t maxBytes = (::off_t)_options.maxSizeMB().get() * 1048576;
+        if ( size > maxBytes )
+        {
+            evicted = bin->purgeBytes( size - CacheMaintenanceThread::getEvictionTarget(maxBytes) );
+        }
+    }
+
+    if ( expired > 0 || evicted > 0 )
+    {
+        _needsCompaction = true;
+    }
+
+    // Deleting only writes tombstones; compaction reclaims the space. Do it
+    // right away when over the size limit (or the next pass would see the
+    // same size and evict again), otherwise wait for a quiet period.
+    if ( evicted > 0 || (idle && _needsCompaction) )
+    {
+        compact();
+        _needsCompaction = false;
+        _tracker->calcSize();
+    }
+
+    if ( expired > 0 || evicted > 0 )
+    {
+        OE_INFO << LC << "Maintenance expired " << expired << " record(s) and evicted "
+            << (evicted/1048576) << " MB" << std::endl;
     }
 }
 
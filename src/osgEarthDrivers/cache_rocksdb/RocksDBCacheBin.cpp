@@ -19,6 +19,8 @@
 #include "RocksDBCacheBin"
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
+#include <osgEarth/TileCodec>
+#include <osgEarth/TileKey>
 #include <osgEarth/Random>
 #include <osgDB/Registry>
 #include <rocksdb/write_batch.h>
@@ -66,6 +68,25 @@ namespace
     {
         blend(data, seed);
     }
+
+    // Quadtree prefix of a tile: its root tile, then one digit (0-3) per
+    // LOD. A tile's descendants all share its prefix, and since "!" sorts
+    // before the digits, a tile's own records come just before theirs.
+    bool quadkeyPrefix(unsigned lod, unsigned x, unsigned y, std::string& out)
+    {
+        if ( lod >= 32 )
+            return false;
+
+        std::string digits(lod, '0');
+        for(unsigned i=0; i<lod; ++i)
+        {
+            unsigned bit = lod-1-i;
+            digits[i] = (char)('0' + ((x>>bit)&1) + 2*((y>>bit)&1));
+        }
+
+        out = Stringify() << "qk!" << (x>>lod) << "-" << (y>>lod) << "!" << digits;
+        return true;
+    }
 }
 
 //------------------------------------------------------------------------
@@ -85,7 +106,8 @@ RocksDBCacheBin::RocksDBCacheBin(const std::string& binID,
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
-_debug            ( false )
+_debug            ( false ),
+_quadkeyOrder     ( tracker->options().quadkeyOrder().get() )
 {
     // reader to parse data:
     _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
@@ -93,6 +115,8 @@ _debug            ( false )
     
     if ( ::getenv("OSGEARTH_CACHE_DEBUG") )
         _debug = true;
+
+    _rawTiles = TileCodec::parseEncoding( tracker->options().tileEncoding().get(), _rawCompressor, _quantizeHeights );
 }
 
 RocksDBCacheBin::~RocksDBCacheBin()
@@ -148,10 +172,30 @@ RocksDBCacheBin::dataKey(const std::string& key) const
     return "d" + SEP + binDataKeyTuple(key);
 }
 
+std::string
+RocksDBCacheBin::sortKey(const std::string& key) const
+{
+    if ( !_quadkeyOrder )
+        return key;
+
+    // Tile records are keyed "lod/x/y<suffix>"; re-key those by quadtree
+    // prefix and leave any other key as-is.
+    unsigned lod, x, y;
+    int len = 0;
+    if ( sscanf(key.c_str(), "%u/%u/%u%n", &lod, &x, &y, &len) != 3 )
+        return key;
+
+    std::string prefix;
+    if ( !quadkeyPrefix(lod, x, y, prefix) )
+        return key;
+
+    return prefix + SEP + key.substr(len);
+}
+
 std::string
 RocksDBCacheBin::binDataKeyTuple(const std::string& key) const
 {
-    return getID() + SEP + key;
+    return getID() + SEP + sortKey(key);
 }
 
 std::string
@@ -247,47 +291,65 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
 
     ++_tracker->reads;
 
-    Config metadata;
-    rocksdb::Status status;
     rocksdb::ReadOptions ro;
 
     // first read the metadata record.
     std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
+    bool hasMeta = _db->Get( ro, metaKey(key), &metavalue ).ok();
         
     // next read the data record.
-    std::string datakey = dataKey(key);
     std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
-    if ( !status.ok() )
+    if ( !_db->Get( ro, dataKey(key), &datavalue ).ok() )
     {
         // main record not found for some reason.
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
     }
 
+    return decode(key, hasMeta ? &metavalue : 0L, datavalue, reader);
+}
+
+ReadResult
+RocksDBCacheBin::decode(const std::string& key, const std::string* metavalue, std::string& datavalue, const Reader& reader)
+{
+    Config metadata;
+    TimeStamp lastModified = (TimeStamp)0;
+    if ( metavalue )
+    {        
+        decodeMeta(*metavalue, metadata);
+        DateTime t( metadata.value(TIME_FIELD));
+        lastModified = t.asTimeStamp();
+    }
+
     // blend the data string
     if ( _tracker->seed().isSet() )
         unblend(datavalue, _tracker->seed().value());
 
-    // finally, decode the OSGB stream into an object.
+    // finally, decode the stream into an object (TileCodec or OSGB).
     std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+    osg::ref_ptr<osg::Object> object;
+    if ( TileCodec::isEncoded(datastream) )
     {
-        OE_WARN << LC << "Cache read failure!"
-            << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
-            << "\n";
+        object = TileCodec::decode(datastream);
+        if ( !object.valid() )
+        {
+            OE_WARN << LC << "Cache read failure! TileCodec could not decode (" << key << ")\n";
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+    }
+    else
+    {
+        osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+        if ( !r.success() )
+        {
+            OE_WARN << LC << "Cache read failure!"
+                << "\n reader = " << reader.name()
+                << "\n error detail = " << r.message()
+                << "\n data value = " << datavalue
+                << "\n";
 
-        return ReadResult(ReadResult::RESULT_READER_ERROR);
+            return ReadResult(ReadResult::RESULT_READER_ERROR);
+        }
+        object = r.getObject();
     }
         
     if ( _debug )
@@ -304,11 +366,43 @@ RocksDBCacheBin::read(const std::string& key, const Reader& reader)
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
+    ReadResult rr(object.get(), metadata);
     rr.setLastModifiedTime(lastModified);    
     return rr;
 }
 
+void
+RocksDBCacheBin::readBatch(const std::vector<std::string>& keys, std::vector<ReadResult>& results, const osgDB::Options* readOptions)
+{
+    results.assign( keys.size(), ReadResult(ReadResult::RESULT_NOT_FOUND) );
+
+    if ( !binValidForReading() || keys.empty() )
+        return;
+
+    // fetch the meta and data records for all keys in one MultiGet.
+    std::vector<std::string> dbkeys;
+    dbkeys.reserve( keys.size()*2 );
+    for(unsigned i=0; i<keys.size(); ++i)
+    {
+        dbkeys.push_back( metaKey(keys[i]) );
+        dbkeys.push_back( dataKey(keys[i]) );
+    }
+
+    std::vector<rocksdb::Slice> slices( dbkeys.begin(), dbkeys.end() );
+    std::vector<std::string> values;
+    std::vector<rocksdb::Status> status = _db->MultiGet( rocksdb::ReadOptions(), slices, &values );
+
+    ObjectReader reader(_rw.get(), readOptions);
+    for(unsigned i=0; i<keys.size(); ++i)
+    {
+        ++_tracker->reads;
+        if ( status[2*i+1].ok() )
+        {
+            results[i] = decode(keys[i], status[2*i].ok() ? &values[2*i] : 0L, values[2*i+1], reader);
+        }
+    }
+}
+
 ReadResult
 RocksDBCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
 {
@@ -327,18 +421,18 @@ RocksDBCacheBin::readString(const std::string& key, const osgDB::Options* readOp
 }
 
 bool
-RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+RocksDBCacheBin::serialize(const osg::Object* object, const osgDB::Options* writeOptions, std::string& data, std::string& message)
 {
-    if ( !binValidForWriting() || !object ) 
-        return false;
-        
     osgDB::ReaderWriter::WriteResult r;
     bool objWriteOK = false;
 
-    std::string       data;
     std::stringstream datastream;
 
-    if ( dynamic_cast<const osg::Image*>(object) )
+    if ( _rawTiles && TileCodec::canEncode(object) )
+    {
+        objWriteOK = TileCodec::encode( object, datastream, _rawCompressor, _quantizeHeights );
+    }
+    else if ( dynamic_cast<const osg::Image*>(object) )
     {
         if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
         {
@@ -369,25 +463,50 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
         objWriteOK = r.success();
     }
 
-    if (objWriteOK)
+    if ( !objWriteOK )
     {
-        DateTime now;
-        rocksdb::WriteBatch batch;
+        message = r.message();
+        return false;
+    }
 
-        // write the data:
-        data = datastream.str();
-        if ( _tracker->seed().isSet() )
-            blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
+    data = datastream.str();
+    if ( _tracker->seed().isSet() )
+        blend(data, _tracker->seed().value());
 
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+    return true;
+}
 
-        // write the metadata:
-        Config metadata(meta);
-        metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
+void
+RocksDBCacheBin::addToBatch(rocksdb::WriteBatch& batch, const std::string& key, const std::string& data, const Config& meta, const DateTime& now)
+{
+    // write the data:
+    batch.Put( dataKey(key), data );
+
+    // write the timestamp index:
+    batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+
+    // write the metadata:
+    Config metadata(meta);
+    metadata.set( TIME_FIELD, now.asCompactISO8601() );
+    std::string metavalue;
+    encodeMeta( metadata, metavalue );
+    batch.Put( metaKey(key), metavalue );
+}
+
+bool
+RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+{
+    if ( !binValidForWriting() || !object ) 
+        return false;
+
+    std::string data, message;
+    bool objWriteOK = serialize(object, writeOptions, data, message);
+
+    if (objWriteOK)
+    {
+        DateTime now;
+        rocksdb::WriteBatch batch;
+        addToBatch( batch, key, data, meta, now );
 
         objWriteOK = _db->Write( rocksdb::WriteOptions(), &batch ).ok();
 
@@ -407,12 +526,63 @@ RocksDBCacheBin::write(const std::string& key, const osg::Object* object, const
     if ( !objWriteOK )
     {
         OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << key << "); msg = \"" 
-            << r.message() << "\"\n";
+            << message << "\"\n";
     }
 
     return objWriteOK;
 }
 
+bool
+RocksDBCacheBin::writeBatch(const BatchRecords& records, const osgDB::Options* writeOptions)
+{
+    if ( !binValidForWriting() ) 
+        return false;
+
+    // serialize everything into one native batch so it commits in a single write.
+    DateTime now;
+    rocksdb::WriteBatch batch;
+    unsigned count = 0u;
+    bool allOK = true;
+
+    for(BatchRecords::const_iterator i = records.begin(); i != records.end(); ++i)
+    {
+        std::string data, message;
+        if ( i->_object.valid() && serialize(i->_object.get(), writeOptions, data, message) )
+        {
+            addToBatch( batch, i->_key, data, i->_meta, now );
+            ++count;
+        }
+        else
+        {
+            OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << i->_key << "); msg = \"" 
+                << message << "\"\n";
+            allOK = false;
+        }
+    }
+
+    if ( count == 0u )
+        return allOK;
+
+    if ( !_db->Write( rocksdb::WriteOptions(), &batch ).ok() )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to write batch of " << count << " records\n";
+        return false;
+    }
+
+    for(unsigned i=0; i<count; ++i)
+    {
+        ++_tracker->writes;
+        postWrite();
+    }
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": wrote batch of " << count << " records\n";
+    }
+
+    return allOK;
+}
+
 void
 RocksDBCacheBin::postWrite()
 {
@@ -686,3 +856,131 @@ RocksDBCacheBin::purgeOldest(unsigned maxnum)
 
     return true;
 }
+
+unsigned
+RocksDBCacheBin::purgeOlderThan(const DateTime& cutoff)
+{
+    if ( !binValidForWriting() )
+        return 0u;
+
+    // the time index sorts by time, so the expired records come first.
+    std::string limit = "t" + SEP + cutoff.asCompactISO8601();
+
+    rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
+
+    unsigned count = 0;
+    for(it->Seek(timeBeginGlobal());
+        it->Valid() && it->key().ToString() < limit;
+        it->Next())
+    {
+        if ( !it->status().ok() )
+            break;
+
+        std::string tuple = it->value().ToString();
+
+        rocksdb::WriteOptions wo;
+        _db->Delete( wo, dataKeyFromTuple(tuple) );
+        _db->Delete( wo, metaKeyFromTuple(tuple) );
+        _db->Delete( wo, it->key() );
+        ++count;
+    }
+
+    delete it;
+
+    if ( _debug && count > 0 )
+    {
+        OE_NOTICE << LC << "Expired " << count << " record(s) older than " << cutoff.asISO8601() << std::endl;
+    }
+
+    return count;
+}
+
+::off_t
+RocksDBCacheBin::purgeBytes(::off_t bytes)
+{
+    if ( !binValidForWriting() )
+        return 0;
+
+    rocksdb::Iterator* it = _db->NewIterator(rocksdb::ReadOptions());
+
+    ::off_t  freed = 0;
+    unsigned count = 0;
+    std::string limit = timeEndGlobal();
+
+    for(it->Seek(timeBeginGlobal());
+        freed < bytes && it->Valid() && it->key().ToString() < limit;
+        it->Next())
+    {
+        if ( !it->status().ok() )
+            break;
+
+        std::string tuple = it->value().ToString();
+        std::string dkey = dataKeyFromTuple(tuple);
+        std::string mkey = metaKeyFromTuple(tuple);
+
+        std::string value;
+        if ( _db->Get(rocksdb::ReadOptions(), dkey, &value).ok() )
+            freed += value.size();
+        if ( _db->Get(rocksdb::ReadOptions(), mkey, &value).ok() )
+            freed += value.size();
+
+        rocksdb::WriteOptions wo;
+        _db->Delete( wo, dkey );
+        _db->Delete( wo, mkey );
+        _db->Delete( wo, it->key() );
+        ++count;
+    }
+
+    delete it;
+
+    if ( _debug && count > 0 )
+    {
+        OE_NOTICE << LC << "Evicted " << count << " record(s) (" << (freed/1048576) << " MB)" << std::endl;
+    }
+
+    return freed;
+}
+
+unsigned
+RocksDBCacheBin::prefetch(const TileKey& key)
+{
+    if ( !_quadkeyOrder || !key.valid() || !binValidForReading() )
+        return 0u;
+
+    std::string prefix;
+    if ( !quadkeyPrefix(key.getLOD(), key.getTileX(), key.getTileY(), prefix) )
+        return 0u;
+
+    // The whole subtree is one contiguous key range, so a single iterator
+    // pulls every block in it into the block cache (and the OS file cache).
+    rocksdb::ReadOptions ro;
+    ro.fill_cache = true;
+    rocksdb::Iterator* it = _db->NewIterator(ro);
+
+    unsigned count = 0;
+    size_t   bytes = 0;
+
+    const std::string ranges[2] = { dataBegin() + prefix, metaBegin() + prefix };
+    for(unsigned r=0; r<2; ++r)
+    {
+        const std::string& begin = ranges[r];
+        for(it->Seek(begin);
+            it->Valid() && it->key().starts_with(begin);
+            it->Next())
+        {
+            bytes += it->value().size();
+            if ( r == 0 )
+                ++count;
+        }
+    }
+
+    delete it;
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Prefetched " << count << " record(s) (" << bytes
+            << " bytes) under " << key.str() << " in bin " << getID() << std::endl;
+    }
+
+    return count;
+}
@@ -0,0 +1,1444 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "SharedMemoryCache"
+#include <osgEarth/Cache>
+#include <osgEarth/StringUtils>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/DateTime>
+#include <osgEarth/Registry>
+#include <osgEarth/TileCodec>
+#include <osgDB/FileNameUtils>
+#include <osg/Image>
+#include <osg/Node>
+#include <osg/Math>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <sstream>
+#include <streambuf>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <errno.h>
+#   include <pthread.h>
+#endif
+
+// How the segment lock survives a process that dies holding it:
+// - Windows: a named mutex, which the system marks abandoned.
+// - POSIX: a robust process-shared mutex, which the kernel marks
+//   owner-dead (works across PID namespaces and with reused PIDs).
+// - macOS has no robust mutexes, so there the lock is a lease: a holder
+//   that keeps it far longer than any cache operation takes is presumed dead.
+#if defined(_WIN32)
+#   define SHM_LOCK_NAMED_MUTEX
+#elif defined(__APPLE__)
+#   define SHM_LOCK_LEASE
+#else
+#   define SHM_LOCK_ROBUST_MUTEX
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace osgEarth::Threading;
+
+#define OSG_FORMAT "osgb"
+
+#undef  LC
+#define LC "[SharedMemoryCache] "
+
+namespace
+{
+    // Layout of the shared segment:
+    //
+    //   SharedHeader | Bucket[numBuckets] | Entry[numBlocks] | unsigned next[numBlocks] | blocks
+    //
+    // Buckets are an open-addressed hash table (linear probing) from a 64-bit
+    // hash of bin ID + key to an Entry. Each Entry is one record; its data
+    // lives in a chain of fixed-size blocks linked through next[]. Published
+    // entries are kept in an LRU list, and the least recently used ones are
+    // evicted when a write needs blocks.
+    //
+    // Index and allocator changes happen under a lock in the header that
+    // works across processes; data is never copied while holding it. A
+    // write reserves an entry and its blocks under the lock, copies its
+    // data in without the lock, and then publishes the entry under the lock.
+    // A read finds the entry under the lock, copies the data out without it,
+    // and then checks that the entry's generation didn't change in the
+    // meantime (it changes whenever the entry is evicted, removed or
+    // reused), treating the read as a miss if it did.
+
+    const unsigned SEGMENT_MAGIC   = 0x4d48454fu; // "OEHM"
+    const unsigned SEGMENT_VERSION = 2u;
+    const unsigned NONE            = 0xffffffffu;
+    const unsigned TOMBSTONE       = 0xfffffffeu;
+    const unsigned HEADER_ALIGN    = 64u;
+
+    // seconds to wait for the lock before treating an operation as a miss.
+    const int      LOCK_TIMEOUT    = 2;
+
+    // seconds after which a reservation that was never published (the
+    // writer died while copying) is reclaimed.
+    const double   RESERVATION_TTL = 60.0;
+
+#ifdef SHM_LOCK_LEASE
+    // seconds after which a lock holder is presumed dead.
+    const double   LOCK_LEASE      = 10.0;
+#endif
+
+    enum RecordType
+    {
+        RECORD_OBJECT    = 1,
+        RECORD_IMAGE     = 2,
+        RECORD_NODE      = 3,
+        RECORD_TILE      = 4    // TileCodec encoding
+    };
+
+    enum EntryState
+    {
+        ENTRY_FREE      = 0,
+        ENTRY_RESERVED  = 1,    // blocks allocated, data being copied in
+        ENTRY_PUBLISHED = 2     // in the hash table and the LRU list
+    };
+
+#ifdef _WIN32
+    typedef LONG AtomicInt;
+    inline bool compareAndSwap(volatile AtomicInt* p, AtomicInt expected, AtomicInt value) {
+        return ::InterlockedCompareExchange(p, value, expected) == expected;
+    }
+    inline void memoryBarrier() { ::MemoryBarrier(); }
+#else
+    typedef int AtomicInt;
+    inline bool compareAndSwap(volatile AtomicInt* p, AtomicInt expected, AtomicInt value) {
+        return __sync_bool_compare_and_swap(p, expected, value);
+    }
+    inline void memoryBarrier() { __sync_synchronize(); }
+#endif
+
+    // wall-clock seconds, comparable between processes.
+    inline double now()
+    {
+        return (double)::time(0L);
+    }
+
+    struct SharedHeader
+    {
+        unsigned           _magic;
+        unsigned           _version;
+        unsigned           _layout;        // sizes of the shared structs, to catch mismatched builds
+        volatile AtomicInt _ready;
+#if defined(SHM_LOCK_ROBUST_MUTEX)
+        pthread_mutex_t    _mutex;
+#elif defined(SHM_LOCK_LEASE)
+        volatile AtomicInt _lock;          // lock ticket; even = free, odd = held
+        volatile double    _lockTime;      // when the current holder took the lock
+#endif
+        unsigned           _blockSize;
+        unsigned           _numBlocks;
+        unsigned           _numBuckets;
+        unsigned           _freeEntry;
+        unsigned           _freeBlock;
+        unsigned           _numFreeBlocks;
+        unsigned           _lruHead;       // most recently used
+        unsigned           _lruTail;       // least recently used
+        unsigned           _reserved;      // list of reserved entries
+        unsigned           _numRecords;
+        unsigned           _tombstones;
+        unsigned long long _totalSize;
+    };
+
+    struct Bucket
+    {
+        unsigned long long _hash;
+        unsigned           _entry;         // NONE, TOMBSTONE, or an entry index
+        unsigned           _pad;
+    };
+
+    struct Entry
+    {
+        unsigned long long _hash;
+        volatile unsigned  _generation;
+        unsigned           _state;
+        unsigned           _bin;           // hash of the bin ID, for clearing a bin
+        unsigned           _bucket;
+        unsigned           _prev, _next;   // links in the LRU, reserved or free list
+        unsigned           _firstBlock;
+        unsigned           _numBlocks;
+        unsigned           _length;
+        unsigned           _pad;
+        double             _timestamp;     // record time; reservation time while reserved
+    };
+
+    // Start of each record's data.
+    struct RecordHeader
+    {
+        unsigned _type;
+        unsigned _keyLength;
+        unsigned _metaLength;
+        unsigned _dataLength;
+    };
+
+    inline size_t alignUp(size_t n)
+    {
+        return (n + HEADER_ALIGN - 1u) & ~(size_t)(HEADER_ALIGN - 1u);
+    }
+
+    inline unsigned layoutCode()
+    {
+        return (unsigned)(sizeof(SharedHeader) | (sizeof(Bucket) << 8) | (sizeof(Entry) << 16));
+    }
+
+    // 64-bit FNV-1a
+    inline unsigned long long hashBytes(const char* data, size_t length, unsigned long long h =14695981039346656037ULL)
+    {
+        for(size_t i=0; i<length; ++i)
+        {
+            h ^= (unsigned char)data[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    /** Read-only stream buffer over a block of memory (no copy). */
+    struct MemoryStreamBuf : public std::streambuf
+    {
+        MemoryStreamBuf(char* data, unsigned length) { setg(data, data, data+length); }
+    };
+
+    /**
+     * The shared-memory segment and the operations on its index. One per
+     * cache; all bins share it.
+     */
+    class SharedSegment : public osg::Referenced
+    {
+    public:
+        SharedSegment(const std::string& name, unsigned long long dataSize, unsigned blockSize, int mode) :
+            _name   ( name ),
+            _base   ( 0L ),
+            _size   ( 0u ),
+            _header ( 0L )
+#ifdef _WIN32
+            , _mapping( 0L ),
+            _mutex    ( 0L )
+#else
+            , _fd     ( -1 )
+#endif
+        {
+            open( dataSize, blockSize, mode );
+        }
+
+        bool valid() const { return _base != 0L; }
+
+        unsigned long long getUsedBytes() const
+        {
+            return valid() ? (unsigned long long)(_header->_numBlocks - _header->_numFreeBlocks) * _header->_blockSize : 0ULL;
+        }
+
+        unsigned getNumRecords() const
+        {
+            return valid() ? _header->_numRecords : 0u;
+        }
+
+        /**
+         * Stores a record made of up to three pieces of data, replacing any
+         * record with the same hash. Evicts least recently used records as
+         * needed to make room.
+         */
+        bool put(unsigned long long hash, unsigned bin, double timestamp,
+                 const char* d0, unsigned n0, const char* d1, unsigned n1, const char* d2, unsigned n2)
+        {
+            unsigned length = n0 + n1 + n2;
+            unsigned blockSize = _header->_blockSize;
+            unsigned numBlocks = (length + blockSize - 1u) / blockSize;
+            if ( numBlocks == 0u || numBlocks > _header->_numBlocks )
+                return false;
+
+            // reserve an entry and its blocks.
+            if ( !lock() )
+                return false;
+
+            reclaimReservations();
+
+            while( _header->_numFreeBlocks < numBlocks && _header->_lruTail != NONE )
+                release( _header->_lruTail );
+
+            if ( _header->_numFreeBlocks < numBlocks || _header->_freeEntry == NONE )
+            {
+                unlock();
+                return false;
+            }
+
+            unsigned e = _header->_freeEntry;
+            Entry& entry = _entries[e];
+            _header->_freeEntry = entry._next;
+
+            entry._firstBlock = _header->_freeBlock;
+            unsigned last = entry._firstBlock;
+            for(unsigned i=1; i<numBlocks; ++i)
+                last = _next[last];
+            _header->_freeBlock = _next[last];
+            _next[last] = NONE;
+            _header->_numFreeBlocks -= numBlocks;
+
+            // readers that still hold a stale copy of this entry must fail.
+            entry._generation++;
+            entry._state     = ENTRY_RESERVED;
+            entry._numBlocks = numBlocks;
+            entry._length    = length;
+            entry._timestamp = now();
+            pushFront( e, _header->_reserved, 0L );
+
+            unsigned generation = entry._generation;
+            unlock();
+
+            // copy the data in without the lock; the blocks belong to this
+            // writer until it publishes them (or the reservation expires).
+            unsigned block = entry._firstBlock, pos = 0u;
+            copyIn( block, pos, d0, n0 );
+            copyIn( block, pos, d1, n1 );
+            copyIn( block, pos, d2, n2 );
+
+            // publish.
+            if ( !lock() )
+                return false; // the reservation expires eventually
+
+            if ( entry._state != ENTRY_RESERVED || entry._generation != generation )
+            {
+                // reclaimed or reset while copying.
+                unlock();
+                return false;
+            }
+
+            unlink( e, _header->_reserved, 0L );
+
+            unsigned b = find(hash);
+            if ( b != NONE )
+                release( _buckets[b]._entry );
+
+            if ( _header->_tombstones > _header->_numBuckets/4u )
+                rebuildBuckets();
+
+            entry._hash      = hash;
+            entry._bin       = bin;
+            entry._timestamp = timestamp;
+            entry._state     = ENTRY_PUBLISHED;
+            entry._bucket    = insertBucket( hash, e );
+            pushFront( e, _header->_lruHead, &_header->_lruTail );
+            _header->_numRecords++;
+
+            unlock();
+            return true;
+        }
+
+        /**
+         * Copies a record out. Returns false if there's no such record or it
+         * changed while being copied.
+         */
+        bool get(unsigned long long hash, std::vector<char>& out, double& out_timestamp)
+        {
+            if ( !lock() )
+                return false;
+
+            unsigned b = find(hash);
+            if ( b == NONE )
+            {
+                unlock();
+                return false;
+            }
+
+            unsigned e = _buckets[b]._entry;
+            Entry& entry = _entries[e];
+            unlink( e, _header->_lruHead, &_header->_lruTail );
+            pushFront( e, _header->_lruHead, &_header->_lruTail );
+
+            unsigned generation = entry._generation;
+            unsigned block      = entry._firstBlock;
+            unsigned length     = entry._length;
+            out_timestamp       = entry._timestamp;
+            unlock();
+
+            // copy without the lock; a concurrent writer may reuse these
+            // blocks, which the generation check below catches.
+            out.resize( length );
+            unsigned blockSize = _header->_blockSize;
+            for(unsigned pos=0u; pos<length; pos += blockSize)
+            {
+                if ( block >= _header->_numBlocks )
+                    return false;
+                ::memcpy( &out[pos], _data + (size_t)block * blockSize, std::min(blockSize, length-pos) );
+                block = _next[block];
+            }
+
+            memoryBarrier();
+            return entry._generation == generation;
+        }
+
+        bool contains(unsigned long long hash, double& out_timestamp)
+        {
+            if ( !lock() )
+                return false;
+            unsigned b = find(hash);
+            if ( b != NONE )
+                out_timestamp = _entries[_buckets[b]._entry]._timestamp;
+            unlock();
+            return b != NONE;
+        }
+
+        bool remove(unsigned long long hash)
+        {
+            if ( !lock() )
+                return false;
+            unsigned b = find(hash);
+            if ( b != NONE )
+                release( _buckets[b]._entry );
+            unlock();
+            return b != NONE;
+        }
+
+        bool touch(unsigned long long hash)
+        {
+            if ( !lock() )
+                return false;
+            unsigned b = find(hash);
+            if ( b != NONE )
+            {
+                unsigned e = _buckets[b]._entry;
+                _entries[e]._timestamp = (double)DateTime().asTimeStamp();
+                unlink( e, _header->_lruHead, &_header->_lruTail );
+                pushFront( e, _header->_lruHead, &_header->_lruTail );
+            }
+            unlock();
+            return b != NONE;
+        }
+
+        /** Removes every record in a bin, or all records if bin is NONE. */
+        void clear(unsigned bin)
+        {
+            if ( !lock() )
+                return;
+
+            unsigned e = _header->_lruHead;
+            while( e != NONE )
+            {
+                unsigned next = _entries[e]._next;
+                if ( bin == NONE || _entries[e]._bin == bin )
+                    release( e );
+                e = next;
+            }
+
+            unlock();
+        }
+
+    protected:
+        virtual ~SharedSegment()
+        {
+            close();
+        }
+
+        void open(unsigned long long dataSize, unsigned blockSize, int mode)
+        {
+            unsigned numBlocks = (unsigned)osg::clampBetween(dataSize / blockSize, 1ULL, 0x7fffffffULL);
+            unsigned numBuckets = 1u;
+            while( numBuckets < 2u*numBlocks )
+                numBuckets <<= 1;
+
+            size_t totalSize =
+                alignUp(sizeof(SharedHeader)) +
+                alignUp(sizeof(Bucket) * (size_t)numBuckets) +
+                alignUp(sizeof(Entry) * (size_t)numBlocks) +
+                alignUp(sizeof(unsigned) * (size_t)numBlocks) +
+                (size_t)numBlocks * blockSize;
+
+#ifdef _WIN32
+            std::string mappingName = "Local\\" + _name;
+            _mapping = ::CreateFileMappingA(
+                INVALID_HANDLE_VALUE, 0L, PAGE_READWRITE,
+                (DWORD)((unsigned long long)totalSize >> 32), (DWORD)(totalSize & 0xffffffffu),
+                mappingName.c_str() );
+            if ( !_mapping )
+            {
+                OE_WARN << LC << "Failed to create shared memory \"" << _name << "\"" << std::endl;
+                return;
+            }
+            bool creator = (::GetLastError() != ERROR_ALREADY_EXISTS);
+
+            std::string mutexName = "Local\\" + _name + ".lock";
+            _mutex = ::CreateMutexA( 0L, FALSE, mutexName.c_str() );
+            if ( !_mutex )
+            {
+                OE_WARN << LC << "Failed to create the lock for \"" << _name << "\"" << std::endl;
+                close();
+                return;
+            }
+
+            // an existing mapping keeps the size its creator gave it.
+            _base = (char*)::MapViewOfFile( _mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+            if ( _base )
+            {
+                MEMORY_BASIC_INFORMATION info;
+                _size = ::VirtualQuery(_base, &info, sizeof(info)) ? info.RegionSize : totalSize;
+            }
+
+            if ( !_base )
+            {
+                OE_WARN << LC << "Failed to map shared memory \"" << _name << "\"" << std::endl;
+                close();
+                return;
+            }
+
+            _header = (SharedHeader*)_base;
+
+            if ( creator )
+            {
+                create( totalSize, blockSize, numBlocks, numBuckets );
+            }
+            else if ( !attach(numBlocks, blockSize) )
+            {
+                // the name can't be taken over while other processes use it.
+                OE_WARN << LC << "Shared memory \"" << _name << "\" is in use by an incompatible "
+                    "or failed process; use a different name" << std::endl;
+                close();
+            }
+#else
+            std::string shmName = "/" + _name;
+
+            // Two tries: if the segment is stale (its creator died before
+            // initializing it) or was made by an incompatible build, remove
+            // it and start over.
+            for(int attempt = 0; attempt < 2 && !_base; ++attempt)
+            {
+                _fd = ::shm_open( shmName.c_str(), O_RDWR|O_CREAT|O_EXCL, (mode_t)mode );
+                if ( _fd >= 0 )
+                {
+                    if ( ::ftruncate(_fd, (off_t)totalSize) != 0 || !map(totalSize) )
+                    {
+                        OE_WARN << LC << "Failed to create shared memory \"" << _name << "\"" << std::endl;
+                        ::shm_unlink( shmName.c_str() );
+                        close();
+                        return;
+                    }
+                    create( totalSize, blockSize, numBlocks, numBuckets );
+                    return;
+                }
+
+                if ( errno != EEXIST )
+                    break;
+
+                _fd = ::shm_open( shmName.c_str(), O_RDWR, 0 );
+                if ( _fd < 0 )
+                    continue; // removed in the meantime
+
+                // wait for the creator to size it.
+                struct stat s;
+                size_t size = 0u;
+                for(int i=0; i<500; ++i)
+                {
+                    if ( ::fstat(_fd, &s) == 0 && s.st_size >= (off_t)sizeof(SharedHeader) )
+                    {
+                        size = (size_t)s.st_size;
+                        break;
+                    }
+                    OpenThreads::Thread::microSleep( 10000 );
+                }
+
+                if ( size > 0u && map(size) )
+                {
+                    _header = (SharedHeader*)_base;
+                    if ( attach(numBlocks, blockSize) )
+                        return;
+                }
+
+                OE_WARN << LC << "Replacing unusable shared memory \"" << _name << "\"" << std::endl;
+                if ( isCurrent(shmName) )
+                    ::shm_unlink( shmName.c_str() );
+                close();
+            }
+
+            OE_WARN << LC << "Failed to open shared memory \"" << _name << "\"" << std::endl;
+#endif
+        }
+
+#ifndef _WIN32
+        bool map(size_t size)
+        {
+            void* ptr = ::mmap( 0L, size, PROT_READ|PROT_WRITE, MAP_SHARED, _fd, 0 );
+            if ( ptr == MAP_FAILED )
+                return false;
+            _base = (char*)ptr;
+            _size = size;
+            _header = (SharedHeader*)_base;
+            return true;
+        }
+
+        // whether the name still refers to the segment we opened (and not
+        // one another process made after removing ours).
+        bool isCurrent(const std::string& shmName) const
+        {
+            int fd = ::shm_open( shmName.c_str(), O_RDONLY, 0 );
+            if ( fd < 0 )
+                return false;
+            struct stat a, b;
+            bool same =
+                ::fstat(_fd, &a) == 0 && ::fstat(fd, &b) == 0 &&
+                a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+            ::close( fd );
+            return same;
+        }
+#endif
+
+        // initializes a segment this process created.
+        void create(size_t totalSize, unsigned blockSize, unsigned numBlocks, unsigned numBuckets)
+        {
+            _header->_magic      = SEGMENT_MAGIC;
+            _header->_version    = SEGMENT_VERSION;
+            _header->_layout     = layoutCode();
+            _header->_blockSize  = blockSize;
+            _header->_numBlocks  = numBlocks;
+            _header->_numBuckets = numBuckets;
+            _header->_totalSize  = totalSize;
+
+#if defined(SHM_LOCK_ROBUST_MUTEX)
+            pthread_mutexattr_t attr;
+            ::pthread_mutexattr_init( &attr );
+            ::pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+            ::pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST );
+            ::pthread_mutex_init( &_header->_mutex, &attr );
+            ::pthread_mutexattr_destroy( &attr );
+#elif defined(SHM_LOCK_LEASE)
+            _header->_lock     = 0;
+            _header->_lockTime = 0.0;
+#endif
+
+            locate();
+            initialize();
+            memoryBarrier();
+            _header->_ready = 1;
+
+            OE_INFO << LC << "Created shared memory \"" << _name << "\" with "
+                << numBlocks << " blocks of " << blockSize/1024u << " KB" << std::endl;
+        }
+
+        // validates a segment another process created.
+        bool attach(unsigned numBlocks, unsigned blockSize)
+        {
+            // wait for the creator to initialize it.
+            for(int i=0; _header->_ready == 0 && i<500; ++i)
+                OpenThreads::Thread::microSleep( 10000 );
+            memoryBarrier();
+
+            if (_header->_ready == 0 ||
+                _header->_magic != SEGMENT_MAGIC ||
+                _header->_version != SEGMENT_VERSION ||
+                _header->_layout != layoutCode() ||
+                _header->_totalSize > (unsigned long long)_size)
+            {
+                return false;
+            }
+
+            if ( _header->_numBlocks != numBlocks || _header->_blockSize != blockSize )
+            {
+                OE_INFO << LC << "Attached to shared memory \"" << _name << "\" using its existing size ("
+                    << _header->_numBlocks << " blocks of " << _header->_blockSize/1024u << " KB)" << std::endl;
+            }
+
+            locate();
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if ( _base )
+                ::UnmapViewOfFile( _base );
+            if ( _mapping )
+                ::CloseHandle( _mapping );
+            if ( _mutex )
+                ::CloseHandle( _mutex );
+            _mapping = 0L;
+            _mutex = 0L;
+#else
+            // the segment itself stays until the system restarts (or someone
+            // removes it), so the next process starts with a warm cache.
+            if ( _base )
+                ::munmap( _base, _size );
+            if ( _fd >= 0 )
+                ::close( _fd );
+            _fd = -1;
+#endif
+            _base = 0L;
+            _header = 0L;
+        }
+
+        // sets the table pointers from the header.
+        void locate()
+        {
+            char* p = _base + alignUp(sizeof(SharedHeader));
+            _buckets = (Bucket*)p;
+            p += alignUp(sizeof(Bucket) * (size_t)_header->_numBuckets);
+            _entries = (Entry*)p;
+            p += alignUp(sizeof(Entry) * (size_t)_header->_numBlocks);
+            _next = (unsigned*)p;
+            p += alignUp(sizeof(unsigned) * (size_t)_header->_numBlocks);
+            _data = p;
+        }
+
+        // empties the index and puts every entry and block on the free lists.
+        void initialize()
+        {
+            unsigned n = _header->_numBlocks;
+            for(unsigned i=0; i<_header->_numBuckets; ++i)
+                _buckets[i]._entry = NONE;
+            for(unsigned i=0; i<n; ++i)
+            {
+                _entries[i]._generation++;
+                _entries[i]._state = ENTRY_FREE;
+                _entries[i]._next = i+1 < n ? i+1 : NONE;
+                _next[i] = i+1 < n ? i+1 : NONE;
+            }
+            _header->_freeEntry     = 0u;
+            _header->_freeBlock     = 0u;
+            _header->_numFreeBlocks = n;
+            _header->_lruHead       = NONE;
+            _header->_lruTail       = NONE;
+            _header->_reserved      = NONE;
+            _header->_numRecords    = 0u;
+            _header->_tombstones    = 0u;
+        }
+
+        /**
+         * Takes the cross-process lock. Gives up after a couple of seconds
+         * rather than stall the caller. If the holder died, takes the lock
+         * over and resets the cache, since the holder may have left the
+         * index half-updated.
+         */
+        bool lock()
+        {
+#if defined(SHM_LOCK_NAMED_MUTEX)
+            DWORD r = ::WaitForSingleObject( _mutex, LOCK_TIMEOUT*1000 );
+            if ( r == WAIT_ABANDONED )
+            {
+                recover();
+                return true;
+            }
+            return r == WAIT_OBJECT_0;
+
+#elif defined(SHM_LOCK_ROBUST_MUTEX)
+            struct timespec deadline;
+            ::clock_gettime( CLOCK_REALTIME, &deadline );
+            deadline.tv_sec += LOCK_TIMEOUT;
+
+            int r = ::pthread_mutex_timedlock( &_header->_mutex, &deadline );
+            if ( r == EOWNERDEAD )
+            {
+                recover();
+                ::pthread_mutex_consistent( &_header->_mutex );
+                return true;
+            }
+            if ( r == ETIMEDOUT )
+            {
+                OE_DEBUG << LC << "Timed out waiting for the lock on \"" << _name << "\"" << std::endl;
+            }
+            return r == 0;
+
+#elif defined(SHM_LOCK_LEASE)
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            for(unsigned spins=0; ; ++spins)
+            {
+                AtomicInt ticket = _header->_lock;
+                if ( (ticket & 1) == 0 )
+                {
+                    if ( compareAndSwap(&_header->_lock, ticket, ticket+1) )
+                    {
+                        _ticket = ticket+1;
+                        _header->_lockTime = now();
+                        return true;
+                    }
+                    continue;
+                }
+
+                // held for far longer than any operation takes: the holder died.
+                if ( now() - _header->_lockTime > LOCK_LEASE && compareAndSwap(&_header->_lock, ticket, ticket+2) )
+                {
+                    _ticket = ticket+2;
+                    _header->_lockTime = now();
+                    recover();
+                    return true;
+                }
+
+                if ( spins >= 64u )
+                    OpenThreads::Thread::YieldCurrentThread();
+
+                if ( (spins & 255u) == 0u && osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) > (double)LOCK_TIMEOUT )
+                {
+                    OE_DEBUG << LC << "Timed out waiting for the lock on \"" << _name << "\"" << std::endl;
+                    return false;
+                }
+            }
+#endif
+        }
+
+        void unlock()
+        {
+#if defined(SHM_LOCK_NAMED_MUTEX)
+            ::ReleaseMutex( _mutex );
+#elif defined(SHM_LOCK_ROBUST_MUTEX)
+            ::pthread_mutex_unlock( &_header->_mutex );
+#elif defined(SHM_LOCK_LEASE)
+            // fails harmlessly if the lease was taken over.
+            memoryBarrier();
+            compareAndSwap( &_header->_lock, _ticket, _ticket+1 );
+#endif
+        }
+
+        void recover()
+        {
+            OE_WARN << LC << "A process died holding the lock on \"" << _name << "\"; resetting" << std::endl;
+            initialize();
+        }
+
+        // releases reservations whose writers appear to have died.
+        void reclaimReservations()
+        {
+            double t = now();
+            unsigned e = _header->_reserved;
+            while( e != NONE )
+            {
+                unsigned next = _entries[e]._next;
+                if ( t - _entries[e]._timestamp > RESERVATION_TTL )
+                    release( e );
+                e = next;
+            }
+        }
+
+        // bucket holding a hash, or NONE.
+        unsigned find(unsigned long long hash) const
+        {
+            unsigned mask = _header->_numBuckets - 1u;
+            for(unsigned i = (unsigned)hash & mask, probes = 0u; probes < _header->_numBuckets; i = (i+1u) & mask, ++probes)
+            {
+                const Bucket& b = _buckets[i];
+                if ( b._entry == NONE )
+                    return NONE;
+                if ( b._entry != TOMBSTONE && b._hash == hash )
+                    return i;
+            }
+            return NONE;
+        }
+
+        unsigned insertBucket(unsigned long long hash, unsigned entry)
+        {
+            unsigned mask = _header->_numBuckets - 1u;
+            unsigned i = (unsigned)hash & mask;
+            while( _buckets[i]._entry != NONE && _buckets[i]._entry != TOMBSTONE )
+                i = (i+1u) & mask;
+            if ( _buckets[i]._entry == TOMBSTONE )
+                _header->_tombstones--;
+            _buckets[i]._hash  = hash;
+            _buckets[i]._entry = entry;
+            return i;
+        }
+
+        void rebuildBuckets()
+        {
+            for(unsigned i=0; i<_header->_numBuckets; ++i)
+                _buckets[i]._entry = NONE;
+            _header->_tombstones = 0u;
+            for(unsigned e = _header->_lruHead; e != NONE; e = _entries[e]._next)
+                _entries[e]._bucket = insertBucket( _entries[e]._hash, e );
+        }
+
+        // removes an entry from a doubly-linked list ("tail" is NULL for
+        // lists that don't track their tail).
+        void unlink(unsigned e, unsigned& head, unsigned* tail)
+        {
+            Entry& entry = _entries[e];
+            if ( entry._prev != NONE ) _entries[entry._prev]._next = entry._next; else head = entry._next;
+            if ( entry._next != NONE ) _entries[entry._next]._prev = entry._prev; else if ( tail ) *tail = entry._prev;
+        }
+
+        void pushFront(unsigned e, unsigned& head, unsigned* tail)
+        {
+            Entry& entry = _entries[e];
+            entry._prev = NONE;
+            entry._next = head;
+            if ( head != NONE )
+                _entries[head]._prev = e;
+            head = e;
+            if ( tail && *tail == NONE )
+                *tail = e;
+        }
+
+        // removes an entry and returns its blocks and itself to the free lists.
+        void release(unsigned e)
+        {
+            Entry& entry = _entries[e];
+            entry._generation++;
+            memoryBarrier();
+
+            if ( entry._state == ENTRY_PUBLISHED )
+            {
+                unlink( e, _header->_lruHead, &_header->_lruTail );
+                _buckets[entry._bucket]._entry = TOMBSTONE;
+                _header->_tombstones++;
+                _header->_numRecords--;
+            }
+            else
+            {
+                unlink( e, _header->_reserved, 0L );
+            }
+
+            unsigned last = entry._firstBlock;
+            for(unsigned i=1; i<entry._numBlocks; ++i)
+                last = _next[last];
+            _next[last] = _header->_freeBlock;
+            _header->_freeBlock = entry._firstBlock;
+            _header->_numFreeBlocks += entry._numBlocks;
+
+            entry._state = ENTRY_FREE;
+            entry._next = _header->_freeEntry;
+            _header->_freeEntry = e;
+        }
+
+        void copyIn(unsigned& block, unsigned& pos, const char* data, unsigned length)
+        {
+            unsigned blockSize = _header->_blockSize;
+            while( length > 0u )
+            {
+                unsigned n = std::min( length, blockSize - pos );
+                ::memcpy( _data + (size_t)block * blockSize + pos, data, n );
+                data   += n;
+                length -= n;
+                pos    += n;
+                if ( pos == blockSize )
+                {
+                    block = _next[block];
+                    pos = 0u;
+                }
+            }
+        }
+
+    private:
+        std::string   _name;
+        char*         _base;
+        size_t        _size;
+        SharedHeader* _header;
+        Bucket*       _buckets;
+        Entry*        _entries;
+        unsigned*     _next;
+        char*         _data;
+#ifdef _WIN32
+        HANDLE        _mapping;
+        HANDLE        _mutex;
+#else
+        int           _fd;
+#endif
+#ifdef SHM_LOCK_LEASE
+        AtomicInt     _ticket;        // this process's ticket while it holds the lock
+#endif
+    };
+
+    /**
+     * Cache that stores data in shared memory.
+     */
+    class SharedMemoryCache : public Cache
+    {
+    public:
+        SharedMemoryCache() { } // unused
+        SharedMemoryCache( const SharedMemoryCache& rhs, const osg::CopyOp& op ) { } // unused
+        META_Object( osgEarth, SharedMemoryCache );
+
+        /**
+         * Constructs a new shared memory cache.
+         * @param options Options structure that comes from a serialized description of
+         *        the object.
+         */
+        SharedMemoryCache( const CacheOptions& options );
+
+    public: // Cache interface
+
+        CacheBin* addBin( const std::string& binID );
+
+        CacheBin* getOrCreateDefaultBin();
+
+        off_t getApproximateSize() const;
+
+        bool clear();
+
+    protected:
+        osg::ref_ptr<SharedSegment> _segment;
+        osg::ref_ptr<Cache>         _backing;
+    };
+
+    /**
+     * Cache bin implementation for a SharedMemoryCache.
+     * You don't need to create this object directly; use SharedMemoryCache::addBin instead.
+     */
+    class SharedMemoryCacheBin : public CacheBin
+    {
+    public:
+        SharedMemoryCacheBin( const std::string& name, SharedSegment* segment, CacheBin* backing );
+
+    public: // CacheBin interface
+
+        ReadResult readObject(const std::string& key, const osgDB::Options* dbo);
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* dbo);
+
+        ReadResult readString(const std::string& key, const osgDB::Options* dbo);
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo);
+
+        bool remove(const std::string& key);
+
+        bool touch(const std::string& key);
+
+        RecordStatus getRecordStatus(const std::string& key);
+
+        bool clear();
+
+        Config readMetadata();
+
+        bool writeMetadata( const Config& meta );
+
+        unsigned getStorageSize();
+
+        std::string getHashedKey(const std::string& key) const;
+
+    protected:
+        ReadResult read(const std::string& key, const osgDB::Options* dbo);
+
+        bool store(const std::string& key, const osg::Object* object, const Config& meta, double timestamp, const osgDB::Options* dbo);
+
+        unsigned long long hashKey(const std::string& key) const;
+
+        osg::ref_ptr<SharedSegment>       _segment;
+        osg::ref_ptr<CacheBin>            _backing;
+        unsigned long long                _binHash;
+        osg::ref_ptr<osgDB::ReaderWriter> _rw;
+    };
+}
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    SharedMemoryCache::SharedMemoryCache( const CacheOptions& options ) :
+    Cache( options )
+    {
+        SharedMemoryCacheOptions sco( options );
+
+        // shared memory names can't contain path separators.
+        std::string name = sco.name().get();
+        for(unsigned i=0; i<name.size(); ++i)
+            if ( name[i] == '/' || name[i] == '\\' )
+                name[i] = '_';
+
+        unsigned long long size = (unsigned long long)std::max(sco.size().get(), 1u) * 1024ULL * 1024ULL;
+        unsigned blockSize = osg::clampBetween(sco.blockSize().get(), 4u, 16384u) * 1024u;
+
+        int mode = (int)::strtol( sco.permissions()->c_str(), 0L, 8 );
+        if ( mode <= 0 || mode > 0777 )
+        {
+            OE_WARN << LC << "Invalid permissions \"" << sco.permissions().get() << "\"; using 0600" << std::endl;
+            mode = 0600;
+        }
+
+        _segment = new SharedSegment( name, size, blockSize, mode );
+        if ( !_segment->valid() )
+        {
+            _ok = false;
+            return;
+        }
+
+        if ( sco.backing().isSet() )
+        {
+            _backing = CacheFactory::create( sco.backing().get() );
+            if ( !_backing.valid() || !_backing->isOK() )
+            {
+                OE_WARN << LC << "Failed to open the backing cache; continuing without it" << std::endl;
+                _backing = 0L;
+            }
+        }
+
+        OE_INFO << LC << "Opened a shared memory cache \"" << name << "\"" << (_backing.valid() ? " with a backing cache" : "") << std::endl;
+    }
+
+    CacheBin*
+    SharedMemoryCache::addBin( const std::string& name )
+    {
+        CacheBin* backing = _backing.valid() ? _backing->addBin( name ) : 0L;
+        return _bins.getOrCreate( name, new SharedMemoryCacheBin( name, _segment.get(), backing ) );
+    }
+
+    CacheBin*
+    SharedMemoryCache::getOrCreateDefaultBin()
+    {
+        static Threading::Mutex s_defaultBinMutex;
+        if ( !_defaultBin.valid() )
+        {
+            Threading::ScopedMutexLock lock( s_defaultBinMutex );
+            if ( !_defaultBin.valid() ) // double-check
+            {
+                CacheBin* backing = _backing.valid() ? _backing->getOrCreateDefaultBin() : 0L;
+                _defaultBin = new SharedMemoryCacheBin( "__default", _segment.get(), backing );
+            }
+        }
+        return _defaultBin.get();
+    }
+
+    off_t
+    SharedMemoryCache::getApproximateSize() const
+    {
+        return (off_t)_segment->getUsedBytes();
+    }
+
+    bool
+    SharedMemoryCache::clear()
+    {
+        _segment->clear( NONE );
+        return _backing.valid() ? _backing->clear() : true;
+    }
+
+    //------------------------------------------------------------------------
+
+    SharedMemoryCacheBin::SharedMemoryCacheBin(const std::string& binID,
+                                               SharedSegment*     segment,
+                                               CacheBin*          backing) :
+    CacheBin ( binID ),
+    _segment ( segment ),
+    _backing ( backing )
+    {
+        _binHash = hashBytes( binID.data(), binID.size() );
+        _rw = osgDB::Registry::instance()->getReaderWriterForExtension(OSG_FORMAT);
+    }
+
+    std::string
+    SharedMemoryCacheBin::getHashedKey(const std::string& key) const
+    {
+        // keys are stored verbatim in the records; no need to mangle them.
+        return key;
+    }
+
+    unsigned long long
+    SharedMemoryCacheBin::hashKey(const std::string& key) const
+    {
+        // separate bins with a character keys can't start with.
+        char sep = '\0';
+        return hashBytes( key.data(), key.size(), hashBytes(&sep, 1u, _binHash) );
+    }
+
+    ReadResult
+    SharedMemoryCacheBin::read(const std::string& key, const osgDB::Options* readOptions)
+    {
+        std::vector<char> buf;
+        double timestamp = 0.0;
+        if ( !_segment->get(hashKey(key), buf, timestamp) || buf.size() < sizeof(RecordHeader) )
+        {
+            // fall back on the backing cache, and keep what it has for the
+            // other processes.
+            if ( _backing.valid() )
+            {
+                ReadResult r = _backing->readObject( key, readOptions );
+                if ( r.succeeded() )
+                {
+                    // keep the backing record's time, so expiration still works.
+                    double t = r.lastModifiedTime() > 0 ? (double)r.lastModifiedTime() : (double)DateTime().asTimeStamp();
+                    store( key, r.getObject(), r.metadata(), t, readOptions );
+                }
+                return r;
+            }
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        }
+
+        RecordHeader h;
+        ::memcpy( &h, &buf[0], sizeof(RecordHeader) );
+
+        // guard against a damaged record or a hash collision.
+        if ((unsigned long long)sizeof(RecordHeader) + h._keyLength + h._metaLength + h._dataLength != buf.size() ||
+            key.compare(0, std::string::npos, &buf[sizeof(RecordHeader)], h._keyLength) != 0)
+        {
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        }
+
+        Config meta;
+        if ( h._metaLength > 0u )
+        {
+            meta.fromJSON( std::string(&buf[sizeof(RecordHeader) + h._keyLength], h._metaLength) );
+        }
+
+        char* payload = &buf[sizeof(RecordHeader) + h._keyLength + h._metaLength];
+        osg::ref_ptr<osg::Object> object;
+
+        if ( h._type == RECORD_TILE )
+        {
+            // the decoder checks the buffer size against the dimensions.
+            MemoryStreamBuf sbuf( payload, h._dataLength );
+            std::istream in( &sbuf );
+            object = TileCodec::decode( in );
+            if ( !object.valid() )
+            {
+                OE_WARN << LC << "Cache read failure for \"" << key << "\" in bin [" << getID() << "]: TileCodec could not decode" << std::endl;
+                return ReadResult(ReadResult::RESULT_READER_ERROR);
+            }
+        }
+        else
+        {
+            if ( !_rw.valid() )
+                return ReadResult(ReadResult::RESULT_READER_ERROR);
+
+            MemoryStreamBuf sbuf( payload, h._dataLength );
+            std::istream in( &sbuf );
+
+            osgDB::ReaderWriter::ReadResult r =
+                h._type == RECORD_IMAGE ? _rw->readImage( in, readOptions ) :
+                h._type == RECORD_NODE  ? _rw->readNode( in, readOptions ) :
+                _rw->readObject( in, readOptions );
+
+            if ( !r.success() )
+            {
+                OE_WARN << LC << "Cache read failure for \"" << key << "\" in bin [" << getID() << "]: " << r.message() << std::endl;
+                return ReadResult(ReadResult::RESULT_READER_ERROR);
+            }
+            object = r.getObject();
+        }
+
+        ReadResult rr( object.get(), meta );
+        rr.setLastModifiedTime( (TimeStamp)timestamp );
+        return rr;
+    }
+
+    ReadResult
+    SharedMemoryCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
+    {
+        ReadResult r = read(key, readOptions);
+        if ( r.succeeded() && !r.getImage() )
+            return ReadResult();
+        return r;
+    }
+
+    ReadResult
+    SharedMemoryCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+    {
+        return read(key, readOptions);
+    }
+
+    ReadResult
+    SharedMemoryCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
+    {
+        ReadResult r = readObject(key, readOptions);
+        if ( r.succeeded() )
+        {
+            if ( r.get<StringObject>() )
+                return r;
+            else
+                return ReadResult();
+        }
+        else
+        {
+            return r;
+        }
+    }
+
+    bool
+    SharedMemoryCacheBin::store(const std::string& key, const osg::Object* object, const Config& meta, double timestamp, const osgDB::Options* writeOptions)
+    {
+        if ( !object || key.empty() )
+            return false;
+
+        std::string metaJSON = meta.empty() ? std::string() : meta.toJSON();
+
+        RecordHeader h;
+        ::memset( &h, 0, sizeof(RecordHeader) );
+        h._keyLength  = key.size();
+        h._metaLength = metaJSON.size();
+
+        // the first piece of the record: header, key and metadata.
+        std::string prefix;
+
+        std::stringstream buf;
+
+        // Plain images and heightfields are stored raw (TileCodec) so they
+        // can be read back without the OSGB reader.
+        if ( TileCodec::canEncode(object) )
+        {
+            if ( !TileCodec::encode(object, buf) )
+                return false;
+            h._type = RECORD_TILE;
+        }
+        else
+        {
+            // Everything else is serialized to OSGB.
+            if ( !_rw.valid() )
+                return false;
+
+            osgDB::ReaderWriter::WriteResult r;
+            const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+
+            if ( image )
+            {
+                r = _rw->writeImage( *image, buf, writeOptions );
+                h._type = RECORD_IMAGE;
+            }
+            else if ( dynamic_cast<const osg::Node*>(object) )
+            {
+                r = _rw->writeNode( *static_cast<const osg::Node*>(object), buf, writeOptions );
+                h._type = RECORD_NODE;
+            }
+            else
+            {
+                r = _rw->writeObject( *object, buf, writeOptions );
+                h._type = RECORD_OBJECT;
+            }
+
+            if ( !r.success() )
+            {
+                OE_WARN << LC << "FAILED to write \"" << key << "\" to cache bin " << getID()
+                    << "; msg = \"" << r.message() << "\"" << std::endl;
+                return false;
+            }
+        }
+
+        std::string data = buf.str();
+        h._dataLength = data.size();
+
+        prefix.append( (const char*)&h, sizeof(RecordHeader) );
+        prefix.append( key );
+        prefix.append( metaJSON );
+
+        return _segment->put(
+            hashKey(key), (unsigned)_binHash, timestamp,
+            prefix.data(), prefix.size(),
+            data.data(), data.size(),
+            0L, 0u );
+    }
+
+    bool
+    SharedMemoryCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+    {
+        // write through, so the record outlives the shared memory.
+        bool ok = true;
+        if ( _backing.valid() )
+            ok = _backing->write( key, object, meta, writeOptions );
+
+        return store( key, object, meta, (double)DateTime().asTimeStamp(), writeOptions ) && ok;
+    }
+
+    CacheBin::RecordStatus
+    SharedMemoryCacheBin::getRecordStatus(const std::string& key)
+    {
+        double timestamp;
+        if ( _segment->contains(hashKey(key), timestamp) )
+            return STATUS_OK;
+
+        return _backing.valid() ? _backing->getRecordStatus(key) : STATUS_NOT_FOUND;
+    }
+
+    bool
+    SharedMemoryCacheBin::remove(const std::string& key)
+    {
+        bool removed = _segment->remove( hashKey(key) );
+        if ( _backing.valid() )
+            removed = _backing->remove( key ) || removed;
+        return removed;
+    }
+
+    bool
+    SharedMemoryCacheBin::touch(const std::string& key)
+    {
+        bool touched = _segment->touch( hashKey(key) );
+        if ( _backing.valid() )
+            touched = _backing->touch( key ) || touched;
+        return touched;
+    }
+
+    bool
+    SharedMemoryCacheBin::clear()
+    {
+        _segment->clear( (unsigned)_binHash );
+        return _backing.valid() ? _backing->clear() : true;
+    }
+
+    unsigned
+    SharedMemoryCacheBin::getStorageSize()
+    {
+        // records from all bins share the segment.
+        return _backing.valid() ? _backing->getStorageSize() : (unsigned)std::min(_segment->getUsedBytes(), 0xffffffffULL);
+    }
+
+    Config
+    SharedMemoryCacheBin::readMetadata()
+    {
+        if ( _backing.valid() )
+            return _backing->readMetadata();
+
+        ReadResult r = readString( "__metadata", 0L );
+        Config conf;
+        if ( r.succeeded() )
+            conf.fromJSON( r.getString() );
+        return conf;
+    }
+
+    bool
+    SharedMemoryCacheBin::writeMetadata( const Config& conf )
+    {
+        if ( _backing.valid() )
+            return _backing->writeMetadata( conf );
+
+        osg::ref_ptr<StringObject> s = new StringObject( conf.toJSON() );
+        return store( "__metadata", s.get(), Config(), (double)DateTime().asTimeStamp(), 0L );
+    }
+}
+
+//------------------------------------------------------------------------
+
+/**
+ * Cache driver that stores records in shared memory.
+ */
+class SharedMemoryCacheDriver : public CacheDriver
+{
+public:
+    SharedMemoryCacheDriver()
+    {
+        supportsExtension( "osgearth_cache_shm", "Shared memory cache for osgEarth" );
+    }
+
+    virtual const char* className() const
+    {
+        return "Shared memory cache for osgEarth";
+    }
+
+    virtual ReadResult readObject(const std::string& file_name, const Options* options) const
+    {
+        if ( !acceptsExtension(osgDB::getLowerCaseFileExtension( file_name )))
+            return ReadResult::FILE_NOT_HANDLED;
+
+        return ReadResult( new SharedMemoryCache( getCacheOptions(options) ) );
+    }
+};
+
@@ -331,13 +331,13 @@ namespace
         return 0L;
     }
 
-    bool addLayer(const Config& conf, Map* map)
+    bool addLayer(const Config& conf, LayerVector& layers)
     {
         std::string name = conf.key();
         Layer* layer = Layer::create(name, conf);
         if (layer)
         {
-            map->addLayer(layer);
+            layers.push_back(layer);
         }
         return layer != 0L;
     }
@@ -408,6 +408,9 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
     // Start a batch update of the map:
     map->beginUpdate();
 
+    // Collect the layers and add them all at once, so the map can open them in parallel.
+    LayerVector layers;
+
     // Read all the elevation layers in FIRST so other layers can access them for things like clamping.
     // TODO: revisit this since we should really be listening for elevation data changes and
     // re-clamping based on that..
@@ -418,12 +421,12 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
         {
             Config temp = *i;
             temp.key() = "elevation";
-            addLayer(temp, map);
+            addLayer(temp, layers);
         }
 
         else if ( i->key() == "elevation" ) // || i->key() == "heightfield" )
         {
-            addLayer(*i, map);
+            addLayer(*i, layers);
         }
     }
 
@@ -471,7 +474,7 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
         else if ( !isReservedWord(i->key()) ) // plugins/extensions.
         {
             // try to add as a plugin Layer first:
-            bool addedLayer = addLayer(*i, map); 
+            bool addedLayer = addLayer(*i, layers);
 
             // failing that, try to load as an extension:
             if ( !addedLayer )
@@ -483,6 +486,8 @@ EarthFileSerializer2::deserialize( const Config& conf, const std::string& referr
         }
     }
 
+    map->addLayers(layers);
+
     // Complete the batch update of the map
     map->endUpdate();
 
@@ -28,14 +28,95 @@ using namespace osgEarth;
 #define LC "[MP.HeightFieldCache] "
 
 
+//------------------------------------------------------------------------
+
+bool
+HFCacheShard::get(const HFKey& key, HFValue& out) const
+{
+    Threading::ScopedReadLock shared( _mutex );
+
+    std::map<HFKey, unsigned>::const_iterator i = _index.find( key );
+    if ( i == _index.end() )
+        return false;
+
+    Slot& slot = _slots[i->second];
+    slot._used = true;
+    out = slot._value;
+    return true;
+}
+
+void
+HFCacheShard::insert(const HFKey& key, const HFValue& value)
+{
+    Threading::ScopedWriteLock exclusive( _mutex );
+
+    std::map<HFKey, unsigned>::iterator i = _index.find( key );
+    if ( i != _index.end() )
+    {
+        _slots[i->second]._value = value;
+        _slots[i->second]._used  = true;
+        return;
+    }
+
+    unsigned s;
+    if ( _slots.size() < _capacity )
+    {
+        s = _slots.size();
+        _slots.push_back( Slot() );
+    }
+    else
+    {
+        // clock sweep: skip (and clear) recently used slots until we find one
+        // that hasn't been touched since the hand last passed it.
+        while( _slots[_hand]._used )
+        {
+            _slots[_hand]._used = false;
+            _hand = (_hand + 1) % _slots.size();
+        }
+        s = _hand;
+        _hand = (_hand + 1) % _slots.size();
+        _index.erase( _slots[s]._key );
+    }
+
+    _slots[s]._key   = key;
+    _slots[s]._value = value;
+    _slots[s]._used  = false;
+    _index[key] = s;
+}
+
+void
+HFCacheShard::clear()
+{
+    Threading::ScopedWriteLock exclusive( _mutex );
+    _index.clear();
+    _slots.clear();
+    _hand = 0u;
+}
+
+//------------------------------------------------------------------------
+
 HeightFieldCache::HeightFieldCache(const MPTerrainEngineOptions& options) :
-_cache   ( true, 128 ),
 _tileSize( options.tileSize().get() )
 {
     _useParentAsReferenceHF = (options.elevationSmoothing() == true);
     _enabled = (::getenv("OSGEARTH_MEMORY_PROFILE") == 0L);
+
+    // same total capacity as the old single LRU cache
+    for(unsigned i=0; i<NUM_SHARDS; ++i)
+        _shards[i].setCapacity( 128u / NUM_SHARDS );
 }
 
+HFCacheShard&
+HeightFieldCache::shard(const TileKey& key) const
+{
+    // spread adjacent tiles across shards so a neighborhood lookup
+    // doesn't pile onto one lock.
+    unsigned h = 
+        (key.getTileX() * 73856093u) ^
+        (key.getTileY() * 19349663u) ^
+        (key.getLOD()   * 83492791u);
+    return _shards[h % NUM_SHARDS];
+}
 
 bool
 HeightFieldCache::getOrCreateHeightField(const MapFrame&                 frame,
@@ -59,89 +140,185 @@ HeightFieldCache::getOrCreateHeightField(const MapFrame&                 frame,
     if (progress)
         progress->stats()["hfcache_try_count"] += 1;
 
-    LRUCache<HFKey,HFValue>::Record rec;
-    if ( _enabled && _cache.get(cachekey, rec) )
+    HFValue cacheval;
+    if ( _enabled && shard(key).get(cachekey, cacheval) )
     {
         // Found it in the cache.
-        out_hf         = rec.value()._hf.get();
-        out_isFallback = rec.value()._isFallback;
+        out_hf         = cacheval._hf.get();
+        out_isFallback = cacheval._isFallback;
 
         if (progress)
         {
             progress->stats()["hfcache_hit_count"] += 1;
             progress->stats()["hfcache_hit_rate"] = progress->stats()["hfcache_hit_count"]/progress->stats()["hfcache_try_count"];
         }
+        return true;
     }
 
-    else
+    // ONLY cache the new heightfield if a parent HF existed. Otherwise the new HF
+    // may contain invalid data. This can happen if this task runs to completion
+    // while the tile's parent expires from the scene graph. In that case the result
+    // of this task will be discarded. Therefore we should not cache the result here.
+    // This was causing intermittent rare "flat tiles" to appear in the terrain.
+    if ( !_enabled || !parent_hf )
     {
-        // Not in the cache, so we need to create a HF.
-        TileKey parentKey = key.createParentKey();
-
-        // Elevation "smoothing" uses the parent HF as the starting point for building
-        // a new tile. This will cause lower-resolution data to propagate down the tree
-        // and fill in any gaps in higher-resolution data. The result will be an elevation
-        // grid that is "smoother" but not neccessarily as accurate.
-        if ( _useParentAsReferenceHF && parent_hf && parentKey.valid() )
-        {
-            out_hf = HeightFieldUtils::createSubSample(
-                parent_hf,
-                parentKey.getExtent(),
-                key.getExtent(),
-                interp );
-        }
+        return createHeightField(frame, key, parent_hf, out_hf, out_isFallback, interp, progress);
+    }
 
-        // If we are not smoothing, or we have no parent data, start with a basic
-        // MSL=0 reference heightfield instead.
-        if ( !out_hf.valid() )
+    // Neighboring tiles all ask for each other's heightfields, so several loader
+    // threads often miss on the same key at once. Build it once and share it.
+    Threading::SingleFlight<HFKey,HFValue>::Scope flight( _inFlight, cachekey, cacheval );
+
+    if ( flight.isLeader() )
+    {
+        if ( !createHeightField(frame, key, parent_hf, cacheval._hf, cacheval._isFallback, interp, progress) ||
+             (progress && progress->isCanceled()) )
         {
-            out_hf = HeightFieldUtils::createReferenceHeightField( key.getExtent(), _tileSize, _tileSize, 0u );
+            flight.abandon();
+            out_hf = cacheval._hf.get();
+            out_isFallback = cacheval._isFallback;
+            return out_hf.valid();
         }
 
-        // Next, populate it with data from the Map. The map will overwrite our starting
-        // data with real data from the elevation stack.
-        bool populated = frame.populateHeightField(
-            out_hf,
-            key,
-            true, // convertToHAE
-            progress );
-
-        // If the map failed to provide any suitable data sources at all, replace the
-        // heightfield with data from its parent (if available). 
-        if ( !populated )
+        // cache it.
+        shard(key).insert( cachekey, cacheval );
+    }
+    else if ( flight.wasAbandoned() )
+    {
+        return createHeightField(frame, key, parent_hf, out_hf, out_isFallback, interp, progress);
+    }
+
+    out_hf         = cacheval._hf.get();
+    out_isFallback = cacheval._isFallback;
+    return true;
+}
+
+unsigned
+HeightFieldCache::getOrCreateNeighbors(const MapFrame&                frame,
+                                       const TileKey&                 key,
+                                       const HeightFieldNeighborhood& parents,
+                                       HeightFieldNeighborhood&       out_neighbors,
+                                       ElevationSamplePolicy          samplePolicy,
+                                       ElevationInterpolation         interp,
+                                       ProgressCallback*              progress)
+{
+    unsigned count = 0u;
+
+    HFKey cachekey;
+    cachekey._revision     = frame.getRevision();
+    cachekey._samplePolicy = samplePolicy;
+
+    // first pass: take everything the cache already has.
+    std::vector< std::pair<int,int> > misses;
+    for( int x=-1; x<=1; x++ )
+    {
+        for( int y=-1; y<=1; y++ )
         {
-            if ( parentKey.valid() && parent_hf )
-            {        
-                out_hf = HeightFieldUtils::createSubSample(
-                    parent_hf,
-                    parentKey.getExtent(),
-                    key.getExtent(),
-                    interp );
-            }
+            if ( x == 0 && y == 0 )
+                continue;
+
+            if ( !parents.getNeighbor(x, y) )
+                continue;
+
+            cachekey._key = key.createNeighborKey(x, y);
+            if ( !cachekey._key.valid() )
+                continue;
 
-            if ( !out_hf.valid() )
+            HFValue cacheval;
+            if ( _enabled && shard(cachekey._key).get(cachekey, cacheval) )
+            {
+                out_neighbors.setNeighbor( x, y, cacheval._hf.get() );
+                ++count;
+            }
+            else
             {
-                // NOTE: This is probably no longer be possible, but check anyway for completeness.
-                return false;
+                misses.push_back( std::make_pair(x, y) );
             }
         }
+    }
+
+    if (progress)
+    {
+        progress->stats()["hfcache_neighbor_try_count"] += 8;
+        progress->stats()["hfcache_neighbor_miss_count"] += misses.size();
+    }
+
+    // second pass: build the rest.
+    for( unsigned i=0; i<misses.size(); ++i )
+    {
+        int x = misses[i].first, y = misses[i].second;
 
-        // ONLY cache the new heightfield if a parent HF existed. Otherwise the new HF
-        // may contain invalid data. This can happen if this task runs to completion
-        // while the tile's parent expires from the scene graph. In that case the result
-        // of this task will be discarded. Therefore we should not cache the result here.
-        // This was causing intermittent rare "flat tiles" to appear in the terrain.
-        if ( _enabled && parent_hf )
+        osg::ref_ptr<osg::HeightField> hf;
+        bool isFallback;
+        if ( getOrCreateHeightField(frame, key.createNeighborKey(x, y), parents.getNeighbor(x, y), hf, isFallback, samplePolicy, interp, progress) )
         {
-            // cache it.
-            HFValue cacheval;
-            cacheval._hf = out_hf.get();
-            cacheval._isFallback = !populated;
-            _cache.insert( cachekey, cacheval );
+            out_neighbors.setNeighbor( x, y, hf.get() );
+            ++count;
         }
+    }
 
-        out_isFallback = !populated;
+    return count;
+}
+
+bool
+HeightFieldCache::createHeightField(const MapFrame&                 frame,
+                                    const TileKey&                  key,
+                                    const osg::HeightField*         parent_hf,
+                                    osg::ref_ptr<osg::HeightField>& out_hf,
+                                    bool&                           out_isFallback,
+                                    ElevationInterpolation          interp,
+                                    ProgressCallback*               progress )
+{
+    TileKey parentKey = key.createParentKey();
+
+    // Elevation "smoothing" uses the parent HF as the starting point for building
+    // a new tile. This will cause lower-resolution data to propagate down the tree
+    // and fill in any gaps in higher-resolution data. The result will be an elevation
+    // grid that is "smoother" but not neccessarily as accurate.
+    if ( _useParentAsReferenceHF && parent_hf && parentKey.valid() )
+    {
+        out_hf = HeightFieldUtils::createSubSample(
+            parent_hf,
+            parentKey.getExtent(),
+            key.getExtent(),
+            interp );
+    }
+
+    // If we are not smoothing, or we have no parent data, start with a basic
+    // MSL=0 reference heightfield instead.
+    if ( !out_hf.valid() )
+    {
+        out_hf = HeightFieldUtils::createReferenceHeightField( key.getExtent(), _tileSize, _tileSize, 0u );
+    }
+
+    // Next, populate it with data from the Map. The map will overwrite our starting
+    // data with real data from the elevation stack.
+    bool populated = frame.populateHeightField(
+        out_hf,
+        key,
+        true, // convertToHAE
+        progress );
+
+    // If the map failed to provide any suitable data sources at all, replace the
+    // heightfield with data from its parent (if available). 
+    if ( !populated )
+    {
+        if ( parentKey.valid() && parent_hf )
+        {        
+            out_hf = HeightFieldUtils::createSubSample(
+                parent_hf,
+                parentKey.getExtent(),
+                key.getExtent(),
+                interp );
+        }
+
+        if ( !out_hf.valid() )
+        {
+            // NOTE: This is probably no longer be possible, but check anyway for completeness.
+            return false;
+        }
     }
 
+    out_isFallback = !populated;
     return true;
 }
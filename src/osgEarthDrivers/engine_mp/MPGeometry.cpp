@@ -36,6 +36,16 @@ using namespace osgEarth;
 
 #define LC "[MPGeometry] "
 
+namespace
+{
+    // Parent texture matrix that tells the shaders there is no parent texture
+    const osg::Matrixf s_noParentTexMat(
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 0.0f);
+}
+
 
 MPGeometry::MPGeometry() :
 osg::Geometry(),
@@ -48,6 +58,7 @@ _texMatParentUniformNameID(0u),
 _tileKeyUniformNameID(0u),
 _minRangeUniformNameID(0u),
 _maxRangeUniformNameID(0u),
+_parentTexLifetime(-1.0f),
 _imageUnit(0),
 _imageUnitParent(0),
 _elevUnit(0),
@@ -66,6 +77,7 @@ _texMatParentUniformNameID(rhs._texMatParentUniformNameID),
 _tileKeyUniformNameID(rhs._tileKeyUniformNameID),
 _minRangeUniformNameID(rhs._minRangeUniformNameID),
 _maxRangeUniformNameID(rhs._maxRangeUniformNameID),
+_parentTexLifetime(rhs._parentTexLifetime),
 _imageUnit(rhs._imageUnit),
 _imageUnitParent(rhs._imageUnitParent),
 _elevUnit(rhs._elevUnit),
@@ -86,6 +98,7 @@ _texMatParentUniformNameID(0u),
 _tileKeyUniformNameID(0u),
 _minRangeUniformNameID(0u),
 _maxRangeUniformNameID(0u),
+_parentTexLifetime(-1.0f),
 _imageUnitParent(0),
 _elevUnit(0),
 _supportsGLSL(false)
@@ -233,6 +246,18 @@ MPGeometry::renderPrimitiveSets(osg::State& state,
         ext->glUniform1f( birthTimeLocation, pcd.birthTime );
     }
 
+    // bind parent textures only within their lifetime after the tile's birth.
+    bool bindTexParent = texMatParentLocation >= 0;
+    if ( bindTexParent && _parentTexLifetime >= 0.0f )
+    {
+        const PerContextData& pcd = _pcd[state.getContextID()];
+        const osg::FrameStamp* stamp = state.getFrameStamp();
+        if ( stamp && pcd.birthTime >= 0.0f )
+        {
+            bindTexParent = (float)stamp->getReferenceTime() - pcd.birthTime <= _parentTexLifetime;
+        }
+    }
+
     // activate the tile coordinate set - same for all layers
     if ( renderColor )
     {
@@ -343,7 +368,7 @@ MPGeometry::renderPrimitiveSets(osg::State& state,
                     }
 
                     // if we're using a parent texture for blending, activate that now
-                    if ( texMatParentLocation >= 0 && layer._texParent.valid() )
+                    if ( bindTexParent && layer._texParent.valid() )
                     {
                         state.setActiveTextureUnit( _imageUnitParent );
                         activeImageUnit = _imageUnitParent;
@@ -383,10 +408,15 @@ MPGeometry::renderPrimitiveSets(osg::State& state,
                         }
 
                         // assign the parent texture matrix
-                        if ( texMatParentLocation >= 0 && layer._texParent.valid() )
+                        if ( bindTexParent && layer._texParent.valid() )
                         {
                             ext->glUniformMatrix4fv( texMatParentLocation, 1, GL_FALSE, layer._texMatParent.ptr() );
                         }
+                        else if ( texMatParentLocation >= 0 && !bindTexParent )
+                        {
+                            // past the lifetime; a zero matrix turns parent sampling off
+                            ext->glUniformMatrix4fv( texMatParentLocation, 1, GL_FALSE, s_noParentTexMat.ptr() );
+                        }
 
                         // assign the min range
                         if ( minRangeLocation >= 0 )
@@ -364,6 +364,18 @@ MPTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     // initialize the model factory:
     _tileModelFactory = new TileModelFactory(_liveTiles.get(), _terrainOptions, this);
 
+    // compiled geometry shared by all the tile compilers
+    if ( _terrainOptions.geometryCacheSize() > 0u )
+    {
+        _surfaceCache = new CompiledSurfaceCache( _terrainOptions.geometryCacheSize().get() );
+    }
+
+    // helpers for compiling large tiles
+    if ( _terrainOptions.compileThreads() > 0u )
+    {
+        _compileService = new TaskService( "MP Compile", _terrainOptions.compileThreads().get() );
+    }
+
     // Normal map texture unit
     if ( _terrainOptions.normalMaps() == true )
     {
@@ -650,7 +662,9 @@ MPTerrainEngineNode::getKeyNodeFactory()
             modelLayers,
             _primaryUnit,
             optimizeTriangleOrientation,
-            _terrainOptions );
+            _terrainOptions,
+            _surfaceCache.get(),
+            _compileService.get() );
 
         // initialize a key node factory.
         knf = new SingleKeyNodeFactory(
@@ -763,7 +777,9 @@ MPTerrainEngineNode::createTile( const TileKey& key )
         modelLayers,
         _primaryUnit,
         optimizeTriangleOrientation,
-        _terrainOptions );
+        _terrainOptions,
+        _surfaceCache.get(),
+        _compileService.get() );
 
     return compiler->compile(model.get(), *_update_mapf, 0L);
 }
@@ -1038,21 +1054,27 @@ MPTerrainEngineNode::updateState()
                         ImageLayer* layer = imageLayers[i].get();
                         if ( layer->getEnabled() )
                         {
-                            // install Color Filter function calls:
+                            // install Color Filter function calls. Filters the layer bakes into
+                            // its tiles are skipped, and the rest are fused into one block.
                             const ColorFilterChain& chain = layer->getColorFilters();
-                            if ( chain.size() > 0 )
+                            unsigned first = layer->getNumBakedColorFilters();
+                            if ( chain.size() > first )
                             {
                                 haveColorFilters = true;
                                 if ( ifStarted ) cf_body << I << "else if ";
                                 else             cf_body << I << "if ";
                                 cf_body << "(oe_layer_uid == " << layer->getUID() << ") {\n";
-                                for( ColorFilterChain::const_iterator j = chain.begin(); j != chain.end(); ++j )
+                                for( unsigned j = first; j < chain.size(); ++j )
                                 {
-                                    const ColorFilter* filter = j->get();
-                                    cf_head << "void " << filter->getEntryPointFunctionName() << "(inout vec4 color);\n";
-                                    cf_body << I << I << filter->getEntryPointFunctionName() << "(color);\n";
+                                    const ColorFilter* filter = chain[j].get();
                                     filter->install( terrainStateSet );
+
+                                    // inlined filters don't need their entry point shader.
+                                    std::string decl, statements;
+                                    if ( filter->getInlineCode(decl, statements) )
+                                        vp->removeShader( filter->getEntryPointFunctionName() );
                                 }
+                                Registry::shaderFactory()->writeColorFilterChain( chain, first, cf_head, cf_body, std::string(I) + I );
                                 cf_body << I << "}\n";
                                 ifStarted = true;
                             }
@@ -266,7 +266,8 @@ _tileLocator     ( rhs._tileLocator.get() ),
 _colorData       ( rhs._colorData ),
 _elevationData   ( rhs._elevationData ),
 _parentStateSet  ( rhs._parentStateSet ),
-_useParentData   ( rhs._useParentData )
+_useParentData   ( rhs._useParentData ),
+_parentTextureLifetime( rhs._parentTextureLifetime )
 {
     //nop
 }
@@ -31,6 +31,8 @@
 #include <osgEarth/Utils>
 #include <osgEarth/ECEF>
 #include <osgEarth/ObjectIndex>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
 #include <osgEarthSymbology/Geometry>
 #include <osgEarthSymbology/MeshConsolidator>
 
@@ -79,6 +81,20 @@ CompilerCache::TexCoordArrayCache::get(const osg::Vec4d& mat,
 
 //------------------------------------------------------------------------
 
+bool
+CompiledSurfaceCache::Key::operator < (const CompiledSurfaceCache::Key& rhs) const
+{
+    if ( _elevationHash < rhs._elevationHash ) return true;
+    if ( _elevationHash > rhs._elevationHash ) return false;
+    if ( _cols < rhs._cols ) return true;
+    if ( _cols > rhs._cols ) return false;
+    if ( _rows < rhs._rows ) return true;
+    if ( _rows > rhs._rows ) return false;
+    return _tileKey < rhs._tileKey;
+}
+
+//------------------------------------------------------------------------
+
 
 #define MATCH_TOLERANCE 0.000001
 
@@ -202,6 +218,7 @@ namespace
         
         // for masking/stitching:
         MaskRecordVector         maskRecords;
+        osg::Vec2d               maskNdcMin, maskNdcMax;        // union of the mask record extents
         //MPGeometry*              stitchGeom;
 
         bool                     usePatches;
@@ -259,6 +276,7 @@ namespace
             if (x_match && y_match)
             {
                 osg::ref_ptr<MPGeometry> stitchGeom = new MPGeometry( d.model->_tileKey, d.frame, d.textureImageUnit );
+                stitchGeom->_parentTexLifetime = d.model->parentTextureLifetime();
                 stitchGeom->setName("stitchGeom");
                 d.maskRecords.push_back( MaskRecord(boundary, min_ndc, max_ndc, stitchGeom) );
             }
@@ -536,45 +554,36 @@ namespace
 
 
     /**
-     * Iterate over the sampling grid and calculate the vertex positions and normals
-     * for each sampling point.
+     * Output of sampling a band of rows [firstRow, lastRow) of the surface grid.
+     * The arrays either point straight at the tile's arrays (single band) or
+     * are private to the band and get appended to the tile's arrays afterwards.
+     * Either way the band writes vertex numbers into Data::indices relative
+     * to the start of its own arrays.
      */
-    void createSurfaceGeometry( Data& d, bool debug )
+    struct SurfaceRows
     {
-        d.surfaceBound.init();
-
-        //osgTerrain::HeightFieldLayer* elevationLayer = d.model->_elevationData.getHFLayer();
-
-        osg::HeightField* hf            = d.model->_elevationData.getHeightField();
-        GeoLocator*       hfLocator     = d.model->_elevationData.getLocator();
-
-        if ( debug )
-        {
-            // Debugging code to help identify all zero heightfields.
-            bool allZero = true;
-            // Check for an all 0 heightfield
-            for (unsigned int c = 0; c < hf->getNumColumns(); ++c)
-            {
-                for (unsigned int r = 0; r < hf->getNumRows(); ++r)
-                {
-                    float h = hf->getHeight(c, r);
-                    if (h != 0)
-                    {
-                        allZero = false;
-                        break;
-                    }
-                }
-            }
+        unsigned                                    firstRow, lastRow;
+        osg::ref_ptr<osg::Vec3Array>                verts;
+        osg::ref_ptr<osg::Vec3Array>                normals;
+        osg::ref_ptr<osg::Vec4Array>                attribs;
+        osg::ref_ptr<osg::Vec4Array>                attribs2;
+        osg::ref_ptr<osg::FloatArray>               elevations;
+        osg::ref_ptr<osg::Vec2Array>                tileCoords;
+        std::vector< osg::ref_ptr<osg::Vec2Array> > texCoords; // one per render layer; NULL if not owned
+        osg::BoundingSphere                         bound;
+    };
 
-            if (allZero)
-            {
-                OE_DEBUG << "ALL ZERO HEIGHTFIELD " << d.model->_tileKey.str() << std::endl;
-            }
-        }
 
+    /**
+     * Calculates the vertex positions, normals, and attributes for a band of
+     * rows of the sampling grid. Only reads the shared Data (other than its
+     * own slots in the index table), so bands can run concurrently.
+     */
+    void sampleSurfaceRows( Data& d, SurfaceRows& out )
+    {
+        const osg::HeightField* hf = d.model->_elevationData.getHeightField();
 
-        // populate vertex and tex coord arrays    
-        for(unsigned j=0; j < d.numRows; ++j)
+        for(unsigned j=out.firstRow; j < out.lastRow; ++j)
         {
             for(unsigned i=0; i < d.numCols; ++i)
             {
@@ -601,77 +610,52 @@ namespace
                 // If so, skip the sampling and mark it as a mask location
                 if ( validValue && d.maskRecords.size() > 0 )
                 {
-					double minndcx = d.maskRecords[0]._ndcMin.x();
-					double minndcy = d.maskRecords[0]._ndcMin.y();
-					double maxndcx = d.maskRecords[0]._ndcMax.x();
-					double maxndcy = d.maskRecords[0]._ndcMax.y();
-					for (int mrs = 1; mrs < d.maskRecords.size(); ++mrs)
-					{
-						if ( d.maskRecords[mrs]._ndcMin.x()< minndcx)
-						{
-							minndcx = d.maskRecords[mrs]._ndcMin.x();
-						}
-						if ( d.maskRecords[mrs]._ndcMin.y()< minndcy)
-						{
-							minndcy = d.maskRecords[mrs]._ndcMin.y();
-						}
-						if ( d.maskRecords[mrs]._ndcMax.x()> maxndcx)
-						{
-							maxndcx = d.maskRecords[mrs]._ndcMax.x();
-						}
-						if ( d.maskRecords[mrs]._ndcMax.y()> maxndcy)
-						{
-							maxndcy = d.maskRecords[mrs]._ndcMax.y();
-						}
-
-
-					}
-					if(ndc.x() >= (minndcx) && ndc.x() <= (maxndcx) &&
-						        ndc.y() >= (minndcy) && ndc.y() <= (maxndcy))
-				    {
-				        validValue = false;
-				        d.indices[iv] = -2;
-				    
-				    }
+                    if(ndc.x() >= d.maskNdcMin.x() && ndc.x() <= d.maskNdcMax.x() &&
+                       ndc.y() >= d.maskNdcMin.y() && ndc.y() <= d.maskNdcMax.y())
+                    {
+                        validValue = false;
+                        d.indices[iv] = -2;
+                    }
                 }
                 
                 if ( validValue )
                 {
-                    d.indices[iv] = d.surfaceVerts->size();
+                    d.indices[iv] = out.verts->size();
 
                     osg::Vec3d model;
                     d.model->_tileLocator->unitToModel( ndc, model );
                     osg::Vec3d modelLTP = model * d.world2local;
-                    (*d.surfaceVerts).push_back(modelLTP);
+                    out.verts->push_back(modelLTP);
 
                     // grow the bounding sphere:
-                    d.surfaceBound.expandBy( (*d.surfaceVerts).back() );
+                    out.bound.expandBy( out.verts->back() );
 
                     // the separate texture space requires separate transformed texcoords for each layer.
-                    for( RenderLayerVector::const_iterator r = d.renderLayers.begin(); r != d.renderLayers.end(); ++r )
+                    for( unsigned r = 0; r < d.renderLayers.size(); ++r )
                     {
-                        if ( r->_ownsTexCoords )
+                        const RenderLayer& layer = d.renderLayers[r];
+                        if ( layer._ownsTexCoords )
                         {
-                            if ( !r->_locator->isEquivalentTo( *d.geoLocator.get() ) )
+                            if ( !layer._locator->isEquivalentTo( *d.geoLocator.get() ) )
                             {
                                 osg::Vec3d color_ndc;
-                                osgTerrain::Locator::convertLocalCoordBetween( *d.geoLocator.get(), ndc, *r->_locator.get(), color_ndc );
-                                r->_texCoords->push_back( osg::Vec2( color_ndc.x(), color_ndc.y() ) );
+                                osgTerrain::Locator::convertLocalCoordBetween( *d.geoLocator.get(), ndc, *layer._locator.get(), color_ndc );
+                                out.texCoords[r]->push_back( osg::Vec2( color_ndc.x(), color_ndc.y() ) );
                             }
                             else
                             {
-                                r->_texCoords->push_back( osg::Vec2( ndc.x(), ndc.y() ) );
+                                out.texCoords[r]->push_back( osg::Vec2( ndc.x(), ndc.y() ) );
                             }
                         }
                     }
 
                     if ( d.ownsTileCoords )
                     {
-                        d.renderTileCoords->push_back( osg::Vec2(ndc.x(), ndc.y()) );
+                        out.tileCoords->push_back( osg::Vec2(ndc.x(), ndc.y()) );
                     }
 
                     // record the raw elevation value in our float array for later
-                    (*d.elevations).push_back(ndc.z());
+                    out.elevations->push_back(ndc.z());
 
                     // compute the local normal (up vector)
                     osg::Vec3d ndc_plus_one(ndc.x(), ndc.y(), ndc.z() + 1.0);
@@ -679,7 +663,7 @@ namespace
                     d.model->_tileLocator->unitToModel(ndc_plus_one, model_up);
                     model_up = (model_up*d.world2local) - modelLTP;
                     model_up.normalize();
-                    (*d.normals).push_back(model_up);
+                    out.normals->push_back(model_up);
 
                     // Calculate and store the "old height", i.e the height value from
                     // the parent LOD.
@@ -699,14 +683,14 @@ namespace
 
                     // first attribute set has the unit extrusion vector and the
                     // raw height value.
-                    (*d.surfaceAttribs).push_back( osg::Vec4f(
+                    out.attribs->push_back( osg::Vec4f(
                         model_up.x(),
                         model_up.y(),
                         model_up.z(),
                         heightValue) );
 
                     // second attribute set has the old height value in "w"
-                    (*d.surfaceAttribs2).push_back( osg::Vec4f(
+                    out.attribs2->push_back( osg::Vec4f(
                         oldNormal.x(),
                         oldNormal.y(),
                         oldNormal.z(),
@@ -714,11 +698,199 @@ namespace
                 }
             }
         }
+    }
+
+
+    /**
+     * Bands of rows to sample in parallel. Worker tasks and the compiling
+     * thread pull bands from the same list, so the compile still finishes
+     * if the workers are busy with other tiles.
+     */
+    struct SurfaceBands : public osg::Referenced
+    {
+        Data*                    _data;
+        std::vector<SurfaceRows> _bands;
+        Threading::Mutex         _mutex;
+        unsigned                 _next;
+        unsigned                 _remaining;
+        Threading::Event         _done;
+
+        SurfaceBands(Data* data) : _data(data), _next(0u), _remaining(0u) { }
+
+        bool runOne()
+        {
+            unsigned i;
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                if (_next >= _bands.size())
+                    return false;
+                i = _next++;
+            }
+
+            sampleSurfaceRows(*_data, _bands[i]);
+
+            Threading::ScopedMutexLock lock(_mutex);
+            if (--_remaining == 0u)
+                _done.set();
+            return true;
+        }
+
+        struct Task : public TaskRequest
+        {
+            osg::ref_ptr<SurfaceBands> _bands;
+            Task(SurfaceBands* bands) : _bands(bands) { }
+            void operator()(ProgressCallback*) { while (_bands->runOne()); }
+        };
+
+        void run(TaskService* service)
+        {
+            _remaining = _bands.size();
+
+            unsigned numHelpers = osg::minimum((unsigned)_bands.size()-1u, (unsigned)service->getNumThreads());
+            for (unsigned i = 0; i < numHelpers; ++i)
+            {
+                service->add(new Task(this));
+            }
+
+            while (runOne());
+            if (!_bands.empty())
+                _done.wait();
+        }
+    };
+
+
+    /**
+     * Iterate over the sampling grid and calculate the vertex positions and normals
+     * for each sampling point. When a compile service is available and the tile
+     * is large enough, the rows are split into bands and sampled in parallel.
+     */
+    void createSurfaceGeometry( Data& d, bool debug, TaskService* service, unsigned minParallelTileSize )
+    {
+        d.surfaceBound.init();
+
+        //osgTerrain::HeightFieldLayer* elevationLayer = d.model->_elevationData.getHFLayer();
+
+        osg::HeightField* hf            = d.model->_elevationData.getHeightField();
+        GeoLocator*       hfLocator     = d.model->_elevationData.getLocator();
+
+        if ( debug )
+        {
+            // Debugging code to help identify all zero heightfields.
+            bool allZero = true;
+            // Check for an all 0 heightfield
+            for (unsigned int c = 0; c < hf->getNumColumns(); ++c)
+            {
+                for (unsigned int r = 0; r < hf->getNumRows(); ++r)
+                {
+                    float h = hf->getHeight(c, r);
+                    if (h != 0)
+                    {
+                        allZero = false;
+                        break;
+                    }
+                }
+            }
+
+            if (allZero)
+            {
+                OE_DEBUG << "ALL ZERO HEIGHTFIELD " << d.model->_tileKey.str() << std::endl;
+            }
+        }
 
-        //if ( d.renderLayers[0]._texCoords->size() < d.surfaceVerts->size() )
-        //{
-        //    OE_WARN << LC << "not good. mask error." << std::endl;
-        //}
+        // union of the mask bounding boxes; sampling points inside it get skipped.
+        if ( d.maskRecords.size() > 0 )
+        {
+            d.maskNdcMin.set( d.maskRecords[0]._ndcMin.x(), d.maskRecords[0]._ndcMin.y() );
+            d.maskNdcMax.set( d.maskRecords[0]._ndcMax.x(), d.maskRecords[0]._ndcMax.y() );
+            for (unsigned mrs = 1; mrs < d.maskRecords.size(); ++mrs)
+            {
+                d.maskNdcMin.x() = osg::minimum( d.maskNdcMin.x(), d.maskRecords[mrs]._ndcMin.x() );
+                d.maskNdcMin.y() = osg::minimum( d.maskNdcMin.y(), d.maskRecords[mrs]._ndcMin.y() );
+                d.maskNdcMax.x() = osg::maximum( d.maskNdcMax.x(), d.maskRecords[mrs]._ndcMax.x() );
+                d.maskNdcMax.y() = osg::maximum( d.maskNdcMax.y(), d.maskRecords[mrs]._ndcMax.y() );
+            }
+        }
+
+        unsigned numBands = 1u;
+        if ( service && minParallelTileSize > 0u && d.numRows >= minParallelTileSize )
+        {
+            // at least a few rows per band, or the merge isn't worth it
+            numBands = osg::minimum( (unsigned)service->getNumThreads() + 1u, d.numRows / 4u );
+            numBands = osg::maximum( numBands, 1u );
+        }
+
+        if ( numBands == 1u )
+        {
+            // sample straight into the tile's arrays.
+            SurfaceRows rows;
+            rows.firstRow   = 0u;
+            rows.lastRow    = d.numRows;
+            rows.verts      = d.surfaceVerts;
+            rows.normals    = d.normals;
+            rows.attribs    = d.surfaceAttribs;
+            rows.attribs2   = d.surfaceAttribs2;
+            rows.elevations = d.elevations;
+            rows.tileCoords = d.renderTileCoords;
+            for( RenderLayerVector::const_iterator r = d.renderLayers.begin(); r != d.renderLayers.end(); ++r )
+                rows.texCoords.push_back( r->_texCoords.get() );
+
+            sampleSurfaceRows( d, rows );
+            d.surfaceBound.expandBy( rows.bound );
+            return;
+        }
+
+        osg::ref_ptr<SurfaceBands> bands = new SurfaceBands( &d );
+        bands->_bands.resize( numBands );
+        for( unsigned b = 0; b < numBands; ++b )
+        {
+            SurfaceRows& rows = bands->_bands[b];
+            rows.firstRow   = (b * d.numRows) / numBands;
+            rows.lastRow    = ((b+1) * d.numRows) / numBands;
+            rows.verts      = new osg::Vec3Array();
+            rows.normals    = new osg::Vec3Array();
+            rows.attribs    = new osg::Vec4Array();
+            rows.attribs2   = new osg::Vec4Array();
+            rows.elevations = new osg::FloatArray();
+            rows.tileCoords = new osg::Vec2Array();
+            for( RenderLayerVector::const_iterator r = d.renderLayers.begin(); r != d.renderLayers.end(); ++r )
+                rows.texCoords.push_back( r->_ownsTexCoords ? new osg::Vec2Array() : 0L );
+        }
+
+        bands->run( service );
+
+        // stitch the bands together in row order, rebasing the vertex numbers
+        // each band recorded in the index table.
+        for( unsigned b = 0; b < numBands; ++b )
+        {
+            const SurfaceRows& rows = bands->_bands[b];
+            int base = d.surfaceVerts->size();
+
+            for( unsigned iv = rows.firstRow*d.numCols; iv < rows.lastRow*d.numCols; ++iv )
+            {
+                if ( d.indices[iv] >= 0 )
+                    d.indices[iv] += base;
+            }
+
+            d.surfaceVerts->insert( d.surfaceVerts->end(), rows.verts->begin(), rows.verts->end() );
+            d.normals->insert( d.normals->end(), rows.normals->begin(), rows.normals->end() );
+            d.surfaceAttribs->insert( d.surfaceAttribs->end(), rows.attribs->begin(), rows.attribs->end() );
+            d.surfaceAttribs2->insert( d.surfaceAttribs2->end(), rows.attribs2->begin(), rows.attribs2->end() );
+            d.elevations->insert( d.elevations->end(), rows.elevations->begin(), rows.elevations->end() );
+
+            if ( d.ownsTileCoords )
+                d.renderTileCoords->insert( d.renderTileCoords->end(), rows.tileCoords->begin(), rows.tileCoords->end() );
+
+            for( unsigned r = 0; r < d.renderLayers.size(); ++r )
+            {
+                if ( d.renderLayers[r]._ownsTexCoords )
+                {
+                    osg::Vec2Array* tc = d.renderLayers[r]._texCoords.get();
+                    tc->insert( tc->end(), rows.texCoords[r]->begin(), rows.texCoords[r]->end() );
+                }
+            }
+
+            d.surfaceBound.expandBy( rows.bound );
+        }
     }
 
 
@@ -2076,6 +2248,148 @@ namespace
         d.surface->_elevTex = d.model->_elevationTexture.get();
     }
 
+    // FNV-1a over a block of memory, continuing from "hash".
+    void hashBytes( const void* data, unsigned size, unsigned long long& hash )
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for( unsigned i = 0; i < size; ++i )
+        {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    void hashHeightField( const osg::HeightField* hf, unsigned long long& hash )
+    {
+        unsigned dims[2] = { 0u, 0u };
+        if ( hf )
+        {
+            dims[0] = hf->getNumColumns();
+            dims[1] = hf->getNumRows();
+        }
+        hashBytes( dims, sizeof(dims), hash );
+
+        const osg::FloatArray* heights = hf ? hf->getFloatArray() : 0L;
+        if ( heights && heights->size() > 0 )
+        {
+            hashBytes( &heights->front(), heights->size() * sizeof(float), hash );
+        }
+    }
+
+    // The heights, the neighbors (they feed the normals), and the extent
+    // the heights cover (a fallback tile covers more than the tile key).
+    void hashElevationData( const TileModel::ElevationData& data, unsigned long long& hash )
+    {
+        hashHeightField( data.getHeightField(), hash );
+
+        for( int y = -1; y <= 1; ++y )
+            for( int x = -1; x <= 1; ++x )
+                if ( x != 0 || y != 0 )
+                    hashHeightField( data.getNeighbor(x, y), hash );
+
+        if ( data.getLocator() )
+        {
+            const GeoExtent& ex = data.getLocator()->getDataExtent();
+            double bounds[4] = { ex.xMin(), ex.yMin(), ex.xMax(), ex.yMax() };
+            hashBytes( bounds, sizeof(bounds), hash );
+        }
+    }
+
+    /**
+     * Builds the surface cache key for a tile: its key, grid size, and a hash of
+     * every piece of elevation data that createSurfaceGeometry, the tessellator,
+     * and the skirt builder read. Engine-wide options (vertical scale, skirt
+     * ratio, etc.) are fixed for the life of the cache so they stay out of it.
+     */
+    CompiledSurfaceCache::Key makeSurfaceCacheKey( const Data& d )
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+
+        bool flags[2] = { d.model->hasNormalMap(), d.parentModel.valid() };
+        hashBytes( flags, sizeof(flags), hash );
+
+        hashElevationData( d.model->_elevationData, hash );
+
+        if ( d.parentModel.valid() )
+            hashElevationData( d.parentModel->_elevationData, hash );
+
+        CompiledSurfaceCache::Key key;
+        key._tileKey       = d.model->_tileKey;
+        key._cols          = d.numCols;
+        key._rows          = d.numRows;
+        key._elevationHash = hash;
+        return key;
+    }
+
+    /**
+     * Saves private copies of the finished surface (skirts included) in the cache.
+     */
+    void storeCachedSurface( const Data& d, const CompiledSurfaceCache::Key& key, CompiledSurfaceCache& cache )
+    {
+        osg::DrawElements* elements = d.surface->getNumPrimitiveSets() > 0 ?
+            dynamic_cast<osg::DrawElements*>( d.surface->getPrimitiveSet(0) ) : 0L;
+
+        if ( !elements || !d.renderTileCoords.valid() )
+            return;
+
+        CompiledSurfaceCache::Entry entry;
+        entry._verts      = new osg::Vec3Array( *d.surfaceVerts.get() );
+        entry._normals    = new osg::Vec3Array( *d.normals.get() );
+        entry._attribs    = new osg::Vec4Array( *d.surfaceAttribs.get() );
+        entry._attribs2   = new osg::Vec4Array( *d.surfaceAttribs2.get() );
+        entry._tileCoords = new osg::Vec2Array( *d.renderTileCoords.get() );
+        entry._elements   = static_cast<osg::DrawElements*>( elements->clone(osg::CopyOp::SHALLOW_COPY) );
+
+        cache.insert( key, entry );
+    }
+
+    /**
+     * Fills the tile's arrays from a cache entry in place of sampling,
+     * tessellating, and building skirts.
+     */
+    void installCachedSurface( Data& d, const CompiledSurfaceCache::Entry& entry )
+    {
+        d.surfaceVerts->assign( entry._verts->begin(), entry._verts->end() );
+        d.normals->assign( entry._normals->begin(), entry._normals->end() );
+        d.surfaceAttribs->assign( entry._attribs->begin(), entry._attribs->end() );
+        d.surfaceAttribs2->assign( entry._attribs2->begin(), entry._attribs2->end() );
+
+        d.surface->addPrimitiveSet( static_cast<osg::DrawElements*>( entry._elements->clone(osg::CopyOp::SHALLOW_COPY) ) );
+
+        const osg::Vec2Array& tileCoords = *entry._tileCoords.get();
+
+        if ( d.ownsTileCoords )
+        {
+            d.renderTileCoords->assign( tileCoords.begin(), tileCoords.end() );
+        }
+
+        // Layer texture coordinates depend on the layer's locator, so they aren't
+        // cached. Derive them from the tile coordinates instead; that covers the
+        // skirts too, since a skirt vertex copies the coordinates of its surface vertex.
+        for( RenderLayerVector::const_iterator r = d.renderLayers.begin(); r != d.renderLayers.end(); ++r )
+        {
+            if ( !r->_ownsTexCoords )
+                continue;
+
+            osg::Vec2Array* texCoords = r->_texCoords.get();
+
+            if ( r->_locator->isEquivalentTo( *d.geoLocator.get() ) )
+            {
+                texCoords->assign( tileCoords.begin(), tileCoords.end() );
+            }
+            else
+            {
+                texCoords->reserve( tileCoords.size() );
+                for( osg::Vec2Array::const_iterator tc = tileCoords.begin(); tc != tileCoords.end(); ++tc )
+                {
+                    osg::Vec3d color_ndc;
+                    osgTerrain::Locator::convertLocalCoordBetween( *d.geoLocator.get(), osg::Vec3d(tc->x(), tc->y(), 0.0), *r->_locator.get(), color_ndc );
+                    texCoords->push_back( osg::Vec2( color_ndc.x(), color_ndc.y() ) );
+                }
+            }
+        }
+    }
+
     osg::Geode* makeBBox(const Data& d)
     {        
         osg::Geode* geode = new osg::Geode();
@@ -2147,12 +2461,16 @@ TileModelCompiler::TileModelCompiler(const MaskLayerVector&              maskLay
                                      const ModelLayerVector&             modelLayers,
                                      int                                 texImageUnit,
                                      bool                                optimizeTriOrientation,
-                                     const MPTerrainEngineOptions& options) :
+                                     const MPTerrainEngineOptions& options,
+                                     CompiledSurfaceCache*         surfaceCache,
+                                     TaskService*                  compileService) :
 _maskLayers            ( maskLayers ),
 _modelLayers           ( modelLayers ),
 _optimizeTriOrientation( optimizeTriOrientation ),
 _options               ( options ),
-_textureImageUnit      ( texImageUnit )
+_textureImageUnit      ( texImageUnit ),
+_surfaceCache          ( surfaceCache ),
+_compileService        ( compileService )
 {
     _debug =
         _options.debug() == true || 
@@ -2186,6 +2504,7 @@ TileModelCompiler::compile(TileModel*        model,
 
     // A Geode/Geometry for the surface:
     d.surface = new MPGeometry( d.model->_tileKey, d.frame, _textureImageUnit );
+    d.surface->_parentTexLifetime = d.model->parentTextureLifetime();
     d.surface->setName( "surface" );
     d.surfaceGeode = new osg::Geode();
    
@@ -2209,28 +2528,48 @@ TileModelCompiler::compile(TileModel*        model,
     // set up the list of layers to render and their shared arrays.
     setupTextureAttributes( d, _cache );
 
-    // calculate the vertex and normals for the surface geometry.
-    createSurfaceGeometry( d, _debug );
+    // Masked tiles are never cached; the stitching geometry depends on the mask
+    // boundaries as well as the elevation data.
+    bool useSurfaceCache = _surfaceCache.valid() && d.maskRecords.size() == 0;
 
-    // build geometry for the masked areas, if applicable
-    if ( d.maskRecords.size() > 0 )
-        createMaskGeometry( d );
+    CompiledSurfaceCache::Key surfaceKey;
+    CompiledSurfaceCache::Entry cachedSurface;
 
-    
+    if ( useSurfaceCache )
+    {
+        surfaceKey = makeSurfaceCacheKey( d );
+    }
 
-    // at this point, make sure we actually built any surface geometry.
-    if (d.surface->getVertexArray() &&
-        d.surface->getVertexArray()->getNumElements() > 0 )
+    if ( useSurfaceCache && _surfaceCache->get(surfaceKey, cachedSurface) )
     {
+        installCachedSurface( d, cachedSurface );
         d.surfaceGeode->addDrawable( d.surface );
+    }
+    else
+    {
+        // calculate the vertex and normals for the surface geometry.
+        createSurfaceGeometry( d, _debug, _compileService.get(), _options.compileThreadsMinTileSize().get() );
+
+        // build geometry for the masked areas, if applicable
+        if ( d.maskRecords.size() > 0 )
+            createMaskGeometry( d );
 
-        // tesselate the surface verts into triangles.
-        tessellateSurfaceGeometry( d, _optimizeTriOrientation, *_options.normalizeEdges() );
+        // at this point, make sure we actually built any surface geometry.
+        if (d.surface->getVertexArray() &&
+            d.surface->getVertexArray()->getNumElements() > 0 )
+        {
+            d.surfaceGeode->addDrawable( d.surface );
+
+            // tesselate the surface verts into triangles.
+            tessellateSurfaceGeometry( d, _optimizeTriOrientation, *_options.normalizeEdges() );
 
-        // build the skirts.
-        if ( d.createSkirt )
-            createSkirtGeometry( d, *_options.heightFieldSkirtRatio() );
+            // build the skirts.
+            if ( d.createSkirt )
+                createSkirtGeometry( d, *_options.heightFieldSkirtRatio() );
 
+            if ( useSurfaceCache )
+                storeCachedSurface( d, surfaceKey, *_surfaceCache.get() );
+        }
     }
 
     // installs the per-layer rendering data into the Geometry objects.
@@ -26,6 +26,7 @@
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Progress>
 #include <osgEarth/TerrainEngineNode>
+#include <map>
 
 using namespace osgEarth::Drivers::MPTerrainEngine;
 using namespace osgEarth;
@@ -283,44 +284,57 @@ TileModelFactory::buildElevation(const TileKey&    key,
         // Edge normalization: requires adjacency information
         if ( _terrainOptions.normalizeEdges() == true )
         {
-            for( int x=-1; x<=1; x++ )
+            // collect each neighbor's parent HF (at most four distinct tiles), since
+            // we only pull a neighbor if we have a valid parent HF for it -- otherwise
+            // you might get a flat tile when upsampling data.
+            HeightFieldNeighborhood neighborParents;
+            if ( accumulate )
             {
-                for( int y=-1; y<=1; y++ )
+                std::map< TileKey, osg::ref_ptr<osg::HeightField> > parentHFs;
+                parentHFs[parentKey] = parentHF.get();
+
+                for( int x=-1; x<=1; x++ )
                 {
-                    if ( x != 0 || y != 0 )
+                    for( int y=-1; y<=1; y++ )
                     {
+                        if ( x == 0 && y == 0 )
+                            continue;
+
                         TileKey neighborKey = key.createNeighborKey(x, y);
-                        if ( neighborKey.valid() )
+                        if ( !neighborKey.valid() )
+                            continue;
+
+                        TileKey neighborParentKey = neighborKey.createParentKey();
+                        std::map< TileKey, osg::ref_ptr<osg::HeightField> >::iterator i = parentHFs.find(neighborParentKey);
+                        if ( i == parentHFs.end() )
                         {
-                            osg::ref_ptr<osg::HeightField> neighborParentHF;
-                            if ( accumulate )
+                            osg::ref_ptr<TileNode> neighborParentNode;
+                            if (_liveTiles->get(neighborParentKey, neighborParentNode))
                             {
-                                TileKey neighborParentKey = neighborKey.createParentKey();
-                                if (neighborParentKey == parentKey)
-                                {
-                                    neighborParentHF = parentHF;
-                                }
-                                else
-                                {
-                                    osg::ref_ptr<TileNode> neighborParentNode;
-                                    if (_liveTiles->get(neighborParentKey, neighborParentNode))
-                                    {
-                                        neighborParentHF = neighborParentNode->getTileModel()->_elevationData.getHeightField();
-                                    }
-                                }
+                                i = parentHFs.insert( std::make_pair(neighborParentKey, neighborParentNode->getTileModel()->_elevationData.getHeightField()) ).first;
                             }
-
-                            // only pull the tile if we have a valid parent HF for it -- otherwise
-                            // you might get a flat tile when upsampling data.
-                            if ( neighborParentHF.valid() )
+                            else
                             {
-                                osg::ref_ptr<osg::HeightField> hf;
-                                if (_meshHFCache->getOrCreateHeightField(frame, neighborKey, neighborParentHF.get(), hf, isFallback, SAMPLE_FIRST_VALID, interp, progress) )
-                                {
-                                    model->_elevationData.setNeighbor( x, y, hf.get() );
-                                }
+                                i = parentHFs.insert( std::make_pair(neighborParentKey, (osg::HeightField*)0L) ).first;
                             }
                         }
+
+                        neighborParents.setNeighbor( x, y, i->second.get() );
+                    }
+                }
+            }
+
+            HeightFieldNeighborhood neighbors;
+            if (_meshHFCache->getOrCreateNeighbors(frame, key, neighborParents, neighbors, SAMPLE_FIRST_VALID, interp, progress) > 0u)
+            {
+                for( int x=-1; x<=1; x++ )
+                {
+                    for( int y=-1; y<=1; y++ )
+                    {
+                        if ( (x != 0 || y != 0) && neighbors.getNeighbor(x, y) )
+                        {
+                            model->_elevationData.setNeighbor( x, y, neighbors.getNeighbor(x, y) );
+                        }
                     }
                 }
             }
@@ -438,6 +452,7 @@ TileModelFactory::createTileModel(const TileKey&           key,
     osg::ref_ptr<TileModel> model = new TileModel( frame.getRevision(), frame.getMapInfo() );
 
     model->_useParentData = _terrainReqs->parentTexturesRequired();
+    model->_parentTextureLifetime = _terrainReqs->parentTexturesLifetime();
 
     model->_tileKey = key;
     model->_tileLocator = GeoLocator::createForKey(key, frame.getMapInfo());
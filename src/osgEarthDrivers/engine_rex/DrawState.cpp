@@ -46,6 +46,8 @@ PerContextDrawState::refresh(osg::RenderInfo& ri, const RenderBindings* bindings
         _elevTexelCoeff.clear();
         _morphConstants.clear();
         _parentTextureExists.clear();
+        _layerTexIndex.clear();
+        _layerTexParentIndex.clear();
         _samplerState.clear();
 
         // for each sampler binding, initialize its state tracking structure 
@@ -66,6 +68,8 @@ PerContextDrawState::refresh(osg::RenderInfo& ri, const RenderBindings* bindings
         _layerMinRangeUL = pcp->getUniformLocation(osg::Uniform::getNameID("oe_layer_minRange"));
         _layerMaxRangeUL = pcp->getUniformLocation(osg::Uniform::getNameID("oe_layer_maxRange"));
         _morphConstantsUL = pcp->getUniformLocation(osg::Uniform::getNameID("oe_tile_morph"));
+        _layerTexIndexUL = pcp->getUniformLocation(osg::Uniform::getNameID("oe_layer_texIndex"));
+        _layerTexParentIndexUL = pcp->getUniformLocation(osg::Uniform::getNameID("oe_layer_texParentIndex"));
     }
 
     _pcp = pcp;
@@ -75,5 +79,7 @@ void
 PerContextDrawState::clear()
 {
     _samplerState.clear();
+    _textureArray = 0L;
+    _boundGeometry = 0L;
     _pcp = 0L;
 }
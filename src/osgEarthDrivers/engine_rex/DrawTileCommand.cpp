@@ -71,7 +71,23 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
             const Sampler& sampler = (*_colorSamplers)[s];
             SamplerState& samplerState = ds._samplerState._samplers[s];
 
-            if (sampler._texture.valid() && !samplerState._texture.isSetTo(sampler._texture))
+            // Slice of the layer's texture array holding this texture; -1 = bind it directly
+            GLint sliceUL = s == SamplerBinding::COLOR ? ds._layerTexIndexUL : ds._layerTexParentIndexUL;
+            optional<int>& sliceValue = s == SamplerBinding::COLOR ? ds._layerTexIndex : ds._layerTexParentIndex;
+            int slice = -1;
+
+            if (ds._textureArray && sliceUL >= 0 && sampler._texture.valid())
+            {
+                slice = ds._textureArray->getSlice(sampler._texture.get(), state);
+            }
+
+            if (sliceUL >= 0 && !sliceValue.isSetTo(slice))
+            {
+                ds._ext->glUniform1i(sliceUL, slice);
+                sliceValue = slice;
+            }
+
+            if (slice < 0 && sampler._texture.valid() && !samplerState._texture.isSetTo(sampler._texture))
             {
                 state.setActiveTextureUnit((*dsMaster._bindings)[s].unit());
                 sampler._texture->apply(state);
@@ -120,18 +136,15 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
 
     if (_drawCallback)
     {
-        PatchLayer::DrawContext dc;
-
-        //TODO: might not need any of this. review. -gw
-        dc.colorTexture = _colorSamplers? (*_colorSamplers)[SamplerBinding::COLOR]._texture.get() : 0L;
-        if (_sharedSamplers)
+        // the callback does its own thing with the vertex arrays.
+        if (ds._boundGeometry)
         {
-            dc.elevationTexture = (*_sharedSamplers)[SamplerBinding::ELEVATION]._texture.get();
-            dc.normalTexture    = (*_sharedSamplers)[SamplerBinding::NORMAL]._texture.get();
-            dc.coverageTexture  = (*_sharedSamplers)[SamplerBinding::COVERAGE]._texture.get();
+            ds._boundGeometry->unbind(state);
+            ds._boundGeometry = 0L;
         }
-        dc.key = &_key;
-        dc.range = _range;
+
+        PatchLayer::DrawContext dc;
+        getDrawContext(dc);
         _drawCallback->draw(ri, dc, layerData);
 
         // evaluate this.
@@ -144,7 +157,17 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
     {
         GLenum ptype = _drawPatch ? GL_PATCHES : GL_TRIANGLES;
 
-        _geom->render(ptype, ri);
+        // Commands are sorted so that tiles sharing a pooled geometry are adjacent;
+        // bind its arrays once for the whole run and just issue the draws. No need
+        // to unbind the previous geometry first: bind() respecifies every array, and
+        // prebuilt geometries share buffers, so the buffer binds themselves are redundant.
+        if (ds._boundGeometry != _geom.get())
+        {
+            _geom->bind(state);
+            ds._boundGeometry = _geom.get();
+        }
+
+        _geom->drawPrimitives(ptype, state);
 #if 0
         // Set up the vertex arrays:
         _geom->drawVertexArraysImplementation(ri);
@@ -181,3 +204,33 @@ DrawTileCommand::draw(osg::RenderInfo& ri, DrawState& dsMaster, osg::Referenced*
 #endif
     }    
 }
+
+void
+DrawTileCommand::getDrawContext(PatchLayer::DrawContext& dc) const
+{
+    if (_colorSamplers)
+    {
+        const Sampler& color = (*_colorSamplers)[SamplerBinding::COLOR];
+        dc.colorTexture = color._texture.get();
+        dc.colorTextureMatrix = color._matrix;
+    }
+
+    if (_sharedSamplers)
+    {
+        const Sampler& elevation = (*_sharedSamplers)[SamplerBinding::ELEVATION];
+        dc.elevationTexture = elevation._texture.get();
+        dc.elevationTextureMatrix = elevation._matrix;
+
+        const Sampler& normal = (*_sharedSamplers)[SamplerBinding::NORMAL];
+        dc.normalTexture = normal._texture.get();
+        dc.normalTextureMatrix = normal._matrix;
+
+        const Sampler& coverage = (*_sharedSamplers)[SamplerBinding::COVERAGE];
+        dc.coverageTexture = coverage._texture.get();
+        dc.coverageTextureMatrix = coverage._matrix;
+    }
+
+    dc.key = &_key;
+    dc.range = _range;
+    dc.modelViewMatrix = _modelViewMatrix;
+}
@@ -21,6 +21,7 @@
 #include <osgEarth/TraversalData>
 #include <osgEarth/CullingUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/StatsRegistry>
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
 using namespace osgEarth;
@@ -55,7 +56,8 @@ _options       ( options ),
 _selectionInfo ( selectionInfo ),
 _bboxCB        ( bboxCB ),
 _tick(0),
-_tilesLastCull(0)
+_tilesLastCull(0),
+_coarseFirst(false)
 {
     _expirationRange2 = _options.expirationRange().get() * _options.expirationRange().get();
     _mainThreadId = Threading::getCurrentThreadId();
@@ -189,6 +191,10 @@ EngineContext::endCull(osgUtil::CullVisitor* cv)
     }
 
     //Registry::instance()->startActivity("REX live tiles", Stringify()<<_liveTiles->size());
+
+    static StatsRegistry::Gauge* s_liveTiles = StatsRegistry::instance()->getGauge(
+        "osgearth_rex_live_tiles", "", "Tiles in the REX terrain scene graph");
+    s_liveTiles->set( _liveTiles->size() );
 }
 
 bool
@@ -0,0 +1,218 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2014 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "GPUTimers"
+#include <osgEarth/Metrics>
+#include <osgEarth/StringUtils>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace osgEarth;
+
+#define LC "[GPUTimers] "
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+namespace
+{
+    // number of frames over which to average before publishing
+    const unsigned REPORT_INTERVAL = 30u;
+
+    // give up timing rather than pile up queries the GPU isn't answering
+    const unsigned MAX_PENDING = 1024u;
+
+    std::string getLayerName(const MapFrame& frame, UID uid)
+    {
+        for (LayerVector::const_iterator i = frame.layers().begin(); i != frame.layers().end(); ++i)
+        {
+            if ( i->get()->getUID() == uid )
+                return i->get()->getName();
+        }
+        return Stringify() << "layer " << uid;
+    }
+}
+
+GPUTimers::GPUTimers() :
+_frames( 0u )
+{
+    _pcs.resize(64);
+}
+
+void
+GPUTimers::begin(UID layer, Category category, osg::State& state)
+{
+    PerContext& pc = _pcs[state.getContextID()];
+    if ( pc._running )
+        return;
+
+    if ( !pc._ext.valid() )
+        pc._ext = osg::GLExtensions::Get(state.getContextID(), true);
+
+    if ( !pc._ext.valid() || !pc._ext->isTimerQuerySupported )
+        return;
+
+    // read back whatever finished since the last frame:
+    unsigned frame = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0u;
+    if ( frame != pc._lastCollectFrame )
+    {
+        collect( pc );
+        pc._lastCollectFrame = frame;
+    }
+
+    if ( pc._pending.size() >= MAX_PENDING )
+        return;
+
+    Query query;
+    if ( pc._free.empty() )
+    {
+        pc._ext->glGenQueries(1, &query._id);
+    }
+    else
+    {
+        query._id = pc._free.back();
+        pc._free.pop_back();
+    }
+    query._layer = layer;
+    query._category = category;
+
+    pc._ext->glBeginQuery(GL_TIME_ELAPSED, query._id);
+    pc._pending.push_back( query );
+    pc._running = true;
+}
+
+void
+GPUTimers::end(osg::State& state)
+{
+    PerContext& pc = _pcs[state.getContextID()];
+    if ( pc._running )
+    {
+        pc._ext->glEndQuery(GL_TIME_ELAPSED);
+        pc._running = false;
+    }
+}
+
+void
+GPUTimers::collect(PerContext& pc)
+{
+    // Queries finish in the order they were issued, so stop at the first
+    // one that isn't ready yet.
+    unsigned done = 0u;
+    std::vector<std::pair<Query, double> > results;
+
+    for (; done < pc._pending.size(); ++done)
+    {
+        const Query& query = pc._pending[done];
+
+        GLint available = 0;
+        pc._ext->glGetQueryObjectiv(query._id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if ( !available )
+            break;
+
+        GLuint64 ns = 0;
+        pc._ext->glGetQueryObjectui64v(query._id, GL_QUERY_RESULT, &ns);
+        results.push_back( std::make_pair(query, (double)ns * 1.0e-6) );
+        pc._free.push_back( query._id );
+    }
+
+    if ( done == 0u )
+        return;
+
+    pc._pending.erase( pc._pending.begin(), pc._pending.begin() + done );
+
+    Threading::ScopedMutexLock lock( _mutex );
+    for (unsigned i = 0; i < results.size(); ++i)
+    {
+        TerrainEngineNode::LayerGPUTime& t = _totals[results[i].first._layer];
+        if ( results[i].first._category == DRAW )
+            t._drawMs += results[i].second;
+        else
+            t._uploadMs += results[i].second;
+    }
+}
+
+void
+GPUTimers::report(const osg::FrameStamp* stamp, const MapFrame& frame)
+{
+    TerrainEngineNode::LayerGPUTimes times;
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        if ( ++_frames < REPORT_INTERVAL )
+            return;
+
+        for (TerrainEngineNode::LayerGPUTimes::iterator i = _totals.begin(); i != _totals.end(); ++i)
+        {
+            i->second._drawMs   /= (double)_frames;
+            i->second._uploadMs /= (double)_frames;
+        }
+        _times.swap( _totals );
+        _totals.clear();
+        _frames = 0u;
+        times = _times;
+    }
+
+    if ( Metrics::enabled() )
+    {
+        for (TerrainEngineNode::LayerGPUTimes::const_iterator i = times.begin(); i != times.end(); ++i)
+        {
+            std::string name = i->first >= 0 ? getLayerName(frame, i->first) : "terrain";
+
+            Metrics::counter("Terrain GPU time (ms)",
+                name + " draw",   i->second._drawMs,
+                name + " upload", i->second._uploadMs);
+        }
+    }
+}
+
+void
+GPUTimers::getTimes(TerrainEngineNode::LayerGPUTimes& out) const
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    out = _times;
+}
+
+void
+GPUTimers::releaseGLObjects(osg::State* state) const
+{
+    // without a state we can't delete, so just forget the queries.
+    for (unsigned i = 0; i < _pcs.size(); ++i)
+    {
+        if ( state && state->getContextID() != i )
+            continue;
+
+        PerContext& pc = _pcs[i];
+        if ( state && pc._ext.valid() )
+        {
+            for (unsigned q = 0; q < pc._free.size(); ++q)
+                pc._ext->glDeleteQueries(1, &pc._free[q]);
+            for (unsigned q = 0; q < pc._pending.size(); ++q)
+                pc._ext->glDeleteQueries(1, &pc._pending[q]._id);
+        }
+        pc._free.clear();
+        pc._pending.clear();
+        pc._running = false;
+    }
+}
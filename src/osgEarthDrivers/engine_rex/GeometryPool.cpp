@@ -18,6 +18,7 @@
 */
 #include "GeometryPool"
 #include <osgEarth/Locators>
+#include <osgEarth/ECEF>
 #include <osgEarth/NodeUtils>
 #include <osg/Point>
 #include <cstdlib> // for getenv
@@ -90,8 +91,14 @@ GeometryPool::getPooledGeometry(const TileKey&               tileKey,
 
         bool masking = maskSet && maskSet->hasMasks();
 
+        GeometryMap::iterator p = masking ? _prebuiltMap.end() : _prebuiltMap.find( geomKey );
         GeometryMap::iterator i = _geometryMap.find( geomKey );
-        if ( !masking && i != _geometryMap.end() )
+        if ( p != _prebuiltMap.end() )
+        {
+            // Built at startup. return it.
+            out = p->second.get();
+        }
+        else if ( !masking && i != _geometryMap.end() )
         {
             // Found. return it.
             out = i->second.get();
@@ -128,6 +135,65 @@ GeometryPool::createKeyForTileKey(const TileKey&             tileKey,
     out.size = size;
 }
 
+void
+GeometryPool::prebuild(const MapInfo& mapInfo, unsigned maxLOD)
+{
+    if ( !_enabled )
+        return;
+
+    Threading::ScopedMutexLock exclusive( _geometryMapMutex );
+
+    // Start a new pair of buffers after this many bytes, so no single
+    // buffer gets too big for the driver to place comfortably.
+    const unsigned maxBufferSize = 32u * 1024u * 1024u;
+
+    osg::ref_ptr<osg::VertexBufferObject>  vbo;
+    osg::ref_ptr<osg::ElementBufferObject> ebo;
+    unsigned bufferSize = 0u;
+    unsigned numBuffers = 0u;
+
+    for (unsigned lod = _options.firstLOD().get(); lod <= maxLOD; ++lod)
+    {
+        unsigned tilesX, tilesY;
+        mapInfo.getProfile()->getNumTiles( lod, tilesX, tilesY );
+
+        // geocentric geometry varies by row; projected geometry only by LOD.
+        unsigned rows = mapInfo.isGeocentric() ? tilesY : 1u;
+
+        for (unsigned row = 0; row < rows; ++row)
+        {
+            TileKey tileKey( lod, 0, row, mapInfo.getProfile() );
+
+            GeometryKey geomKey;
+            createKeyForTileKey( tileKey, _tileSize, mapInfo, geomKey );
+            if ( _prebuiltMap.find(geomKey) != _prebuiltMap.end() )
+                continue;
+
+            if ( !vbo.valid() || bufferSize >= maxBufferSize )
+            {
+                vbo = new osg::VertexBufferObject();
+                ebo = new osg::ElementBufferObject();
+                bufferSize = 0u;
+                ++numBuffers;
+            }
+
+            SharedGeometry* geom = createGeometry( tileKey, mapInfo, 0L, vbo.get(), ebo.get() );
+
+            bufferSize += geom->getVertexArray()->getTotalDataSize();
+            bufferSize += geom->getNormalArray()->getTotalDataSize();
+            bufferSize += geom->getTexCoordArray()->getTotalDataSize();
+            if ( geom->getNeighborArray() )
+                bufferSize += geom->getNeighborArray()->getTotalDataSize();
+            bufferSize += geom->getDrawElements()->getTotalDataSize();
+
+            _prebuiltMap[geomKey] = geom;
+        }
+    }
+
+    OE_INFO << LC << "Prebuilt " << _prebuiltMap.size() << " geometries through LOD " << maxLOD
+        << " in " << numBuffers << " shared buffer(s)\n";
+}
+
 int
 GeometryPool::getNumSkirtElements() const
 {
@@ -171,9 +237,11 @@ namespace
 }
 
 SharedGeometry*
-GeometryPool::createGeometry(const TileKey& tileKey,
-                             const MapInfo& mapInfo,
-                             MaskGenerator* maskSet) const
+GeometryPool::createGeometry(const TileKey&            tileKey,
+                             const MapInfo&            mapInfo,
+                             MaskGenerator*            maskSet,
+                             osg::VertexBufferObject*  sharedVBO,
+                             osg::ElementBufferObject* sharedEBO) const
 {    
     // Establish a local reference frame for the tile:
     osg::Vec3d centerWorld;
@@ -199,7 +267,7 @@ GeometryPool::createGeometry(const TileKey& tileKey,
 
     // Pre-allocate enough space for all triangles.
     osg::DrawElements* primSet = new osg::DrawElementsUShort(mode);
-    primSet->setElementBufferObject(new osg::ElementBufferObject());
+    primSet->setElementBufferObject(sharedEBO ? sharedEBO : new osg::ElementBufferObject());
 
     primSet->reserveElements(numIndiciesInSurface + numIncidesInSkirt);
 
@@ -210,7 +278,7 @@ GeometryPool::createGeometry(const TileKey& tileKey,
     geom->setUseVertexBufferObjects(true);
     //geom->setUseDisplayList(false);
 
-    osg::ref_ptr<osg::VertexBufferObject> vbo = new osg::VertexBufferObject();
+    osg::ref_ptr<osg::VertexBufferObject> vbo = sharedVBO ? sharedVBO : new osg::VertexBufferObject();
 
     geom->setDrawElements(primSet);
 
@@ -268,6 +336,33 @@ GeometryPool::createGeometry(const TileKey& tileKey,
 
     osg::ref_ptr<GeoLocator> locator = GeoLocator::createForKey( tileKey, mapInfo );
 
+    // For a geographic tile on a geocentric map, convert the whole grid to
+    // ECEF (and "up" vectors) in one pass instead of going through the
+    // locator twice per vertex.
+    const GeoExtent& keyExtent = tileKey.getExtent();
+    const bool batchECEF = mapInfo.isGeocentric() && keyExtent.getSRS()->isGeographic();
+    std::vector<osg::Vec3d> ecef, up;
+    if ( batchECEF )
+    {
+        ecef.resize( numVertsInSurface );
+        up.resize( numVertsInSurface );
+
+        for(unsigned row=0; row<_tileSize; ++row)
+        {
+            float ny = (float)row/(float)(_tileSize-1);
+            for(unsigned col=0; col<_tileSize; ++col)
+            {
+                float nx = (float)col/(float)(_tileSize-1);
+                ecef[row*_tileSize + col].set(
+                    keyExtent.xMin() + nx*keyExtent.width(),
+                    keyExtent.yMin() + ny*keyExtent.height(),
+                    0.0 );
+            }
+        }
+
+        ECEF::transformToECEF( keyExtent.getSRS()->getEllipsoid(), &ecef[0], &ecef[0], numVertsInSurface, &up[0] );
+    }
+
     for(unsigned row=0; row<_tileSize; ++row)
     {
         float ny = (float)row/(float)(_tileSize-1);
@@ -276,7 +371,10 @@ GeometryPool::createGeometry(const TileKey& tileKey,
             float nx = (float)col/(float)(_tileSize-1);
 
             osg::Vec3d model;
-            locator->unitToModel(osg::Vec3d(nx, ny, 0.0f), model);
+            if ( batchECEF )
+                model = ecef[row*_tileSize + col];
+            else
+                locator->unitToModel(osg::Vec3d(nx, ny, 0.0f), model);
             osg::Vec3d modelLTP = model*world2local;
             verts->push_back( modelLTP );
             tileBound.expandBy( verts->back() );
@@ -288,9 +386,17 @@ GeometryPool::createGeometry(const TileKey& tileKey,
                 texCoords->push_back( osg::Vec3f(nx, ny, marker) );
             }
 
-            osg::Vec3d modelPlusOne;
-            locator->unitToModel(osg::Vec3d(nx, ny, 1.0f), modelPlusOne);
-            osg::Vec3d normal = (modelPlusOne*world2local)-modelLTP;                
+            osg::Vec3d normal;
+            if ( batchECEF )
+            {
+                normal = osg::Matrix::transform3x3( up[row*_tileSize + col], world2local );
+            }
+            else
+            {
+                osg::Vec3d modelPlusOne;
+                locator->unitToModel(osg::Vec3d(nx, ny, 1.0f), modelPlusOne);
+                normal = (modelPlusOne*world2local)-modelLTP;
+            }
             normal.normalize();
             normals->push_back( normal );
 
@@ -568,7 +674,7 @@ void SharedGeometry::compileGLObjects(osg::RenderInfo& renderInfo) const
 
         osg::BufferObject* ebo = _drawElements->getElementBufferObject();
         osg::GLBufferObject* ebo_glBufferObject = ebo->getOrCreateGLBufferObject(contextID);
-        if (ebo_glBufferObject && vbo_glBufferObject->isDirty())
+        if (ebo_glBufferObject && ebo_glBufferObject->isDirty())
         {
             // OSG_NOTICE<<"Compile buffer "<<glBufferObject<<std::endl;
             ebo_glBufferObject->compileBuffer();
@@ -623,7 +729,13 @@ void SharedGeometry::releaseGLObjects(osg::State* state) const
 void SharedGeometry::render(GLenum primitiveType, osg::RenderInfo& renderInfo) const
 {
     osg::State& state = *renderInfo.getState();
-    
+    bind(state);
+    drawPrimitives(primitiveType, state);
+    unbind(state);
+}
+
+void SharedGeometry::bind(osg::State& state) const
+{
 #if OSG_VERSION_LESS_THAN(3,5,6)
     osg::ArrayDispatchers& dispatchers = state.getArrayDispatchers();
 #else
@@ -681,27 +793,25 @@ void SharedGeometry::render(GLenum primitiveType, osg::RenderInfo& renderInfo) c
         state.applyDisablingOfVertexAttributes();
     }
 
+    osg::GLBufferObject* ebo = _drawElements->getOrCreateGLBufferObject(state.getContextID());
+    if (ebo)
+    {
+        state.bindElementBufferObject(ebo);
+    }
+}
 
-#ifdef SUPPORTS_VAO
-    bool request_bind_unbind = !state.useVertexArrayObject(_useVertexArrayObject) || state.getCurrentVertexArrayState()->getRequiresSetArrays();
-#else
-    bool request_bind_unbind = true;
-#endif
-
+void SharedGeometry::drawPrimitives(GLenum primitiveType, osg::State& state) const
+{
     osg::GLBufferObject* ebo = _drawElements->getOrCreateGLBufferObject(state.getContextID());
 
     if (ebo)
     {
-        /*if (request_bind_unbind)*/ state.bindElementBufferObject(ebo);
-
         glDrawElements(primitiveType, _drawElements->getNumIndices(), _drawElements->getDataType(), (const GLvoid *)(ebo->getOffset(_drawElements->getBufferIndex())));
 
         if (_maskElements.valid())
         {
             glDrawElements(primitiveType, _maskElements->getNumIndices(), _maskElements->getDataType(), (const GLvoid *)(ebo->getOffset(_maskElements->getBufferIndex())));
         }
-
-        /*if (request_bind_unbind)*/ state.unbindElementBufferObject();
     }
     else
     {
@@ -712,6 +822,20 @@ void SharedGeometry::render(GLenum primitiveType, osg::RenderInfo& renderInfo) c
             glDrawElements(primitiveType, _maskElements->getNumIndices(), _maskElements->getDataType(), _maskElements->getDataPointer());
         }
     }
+}
+
+void SharedGeometry::unbind(osg::State& state) const
+{
+#ifdef SUPPORTS_VAO
+    bool request_bind_unbind = !state.useVertexArrayObject(_useVertexArrayObject) || state.getCurrentVertexArrayState()->getRequiresSetArrays();
+#else
+    bool request_bind_unbind = true;
+#endif
+
+    if (_drawElements->getOrCreateGLBufferObject(state.getContextID()))
+    {
+        state.unbindElementBufferObject();
+    }
 
     // unbind the VBO's if any are used.
     if (request_bind_unbind)
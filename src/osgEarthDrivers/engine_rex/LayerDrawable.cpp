@@ -43,6 +43,11 @@ LayerDrawable::drawImplementation(osg::RenderInfo& ri) const
 
     ds.refresh(ri, _drawState->_bindings);
 
+    if (_drawState->_timers)
+    {
+        _drawState->_timers->begin(_layer ? _layer->getUID() : -1, GPUTimers::DRAW, *ri.getState());
+    }
+
     if (ds._layerOrderUL >= 0)
     {
         ds._ext->glUniform1i(ds._layerOrderUL, (GLint)_order);
@@ -71,9 +76,61 @@ LayerDrawable::drawImplementation(osg::RenderInfo& ri) const
             ds._ext->glUniform1f(ds._layerMaxRangeUL, (GLfloat)FLT_MAX);
     }
 
-    for (DrawTileCommands::const_iterator tile = _tiles.begin(); tile != _tiles.end(); ++tile)
+    // Image layers draw their tile textures out of a texture array, if enabled
+    ds._textureArray = 0L;
+    if (_drawState->_textureArrays && _imageLayer)
+    {
+        ds._textureArray = _drawState->_textureArrays->get(_imageLayer->getUID(), ri.getContextID());
+        ds._textureArray->bind(*ri.getState());
+    }
+
+    // A batched patch layer draws all of its tiles in one call.
+    PatchLayer::DrawCallback* batchCallback = 0L;
+    if (_renderType == Layer::RENDERTYPE_PATCH && !_tiles.empty())
+    {
+        PatchLayer::DrawCallback* cb = _tiles.front()._drawCallback;
+        if (cb && cb->batched())
+            batchCallback = cb;
+    }
+
+    if (batchCallback)
+    {
+        // the callback does its own thing with the vertex arrays.
+        if (ds._boundGeometry)
+        {
+            ds._boundGeometry->unbind(*ri.getState());
+            ds._boundGeometry = 0L;
+        }
+
+        PatchLayer::DrawContextVector contexts(_tiles.size());
+        unsigned t = 0;
+        for (DrawTileCommands::const_iterator tile = _tiles.begin(); tile != _tiles.end(); ++tile, ++t)
+        {
+            tile->getDrawContext(contexts[t]);
+        }
+
+        batchCallback->drawTiles(ri, contexts, 0L);
+
+        ds._samplerState.clear();
+    }
+    else
+    {
+        for (DrawTileCommands::const_iterator tile = _tiles.begin(); tile != _tiles.end(); ++tile)
+        {
+            tile->draw(ri, *_drawState, 0L);
+        }
+    }
+
+    if (_drawState->_timers)
+    {
+        _drawState->_timers->end(*ri.getState());
+    }
+
+    // Release the arrays of the last geometry run.
+    if (ds._boundGeometry)
     {
-        tile->draw(ri, *_drawState, 0L);
+        ds._boundGeometry->unbind(*ri.getState());
+        ds._boundGeometry = 0L;
     }
 
     // If set, dirty all OSG state to prevent any leakage - this is sometimes
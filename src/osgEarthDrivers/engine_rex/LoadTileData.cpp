@@ -18,9 +18,15 @@
 */
 #include "LoadTileData"
 #include "SurfaceNode"
+#include "MaskGenerator"
+#include "GPUTimers"
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/Terrain>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/MaskLayer>
+#include <osgEarth/Metrics>
 #include <osg/NodeVisitor>
+#include <osg/Texture>
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
 using namespace osgEarth;
@@ -31,11 +37,13 @@ using namespace osgEarth;
 LoadTileData::LoadTileData(TileNode* tilenode, EngineContext* context) :
 _tilenode(tilenode),
 _context(context),
-_enableCancel(true)
+_enableCancel(true),
+_elevationInherited(false)
 {
     this->setTileKey(tilenode->getKey());
     _mapFrame.setMap(context->getMap());
     _engine = context->getEngine();
+    _tileSize = context->getOptions().tileSize().get();
 }
 
 namespace
@@ -44,7 +52,27 @@ namespace
         LoadTileData* _req;
         MyProgress(LoadTileData* req) : _req(req) {}
         bool isCanceled() { return _req->isIdle(); }
+        float getPriority() const { return _req->_priority; }
     };
+
+    // Whether any elevation layer has data at the key's own LOD, rather than
+    // only coarser data that would be resampled to fit it.
+    bool hasElevationAt(const MapFrame& frame, const TileKey& key)
+    {
+        ElevationLayerVector layers;
+        frame.getLayers(layers);
+        for (ElevationLayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+        {
+            const ElevationLayer* layer = i->get();
+            if (layer->getEnabled())
+            {
+                TileKey best = layer->getBestAvailableTileKey(key);
+                if (best.valid() && best.getLOD() >= key.getLOD())
+                    return true;
+            }
+        }
+        return false;
+    }
 }
 
 
@@ -73,14 +101,123 @@ LoadTileData::invoke()
     // Only use a progress callback is cancelation is enabled.    
     osg::ref_ptr<ProgressCallback> progress = _enableCancel ? new MyProgress(this) : 0L;
 
+    // If the tile is sampling its parent's elevation texture and there's nothing
+    // finer here, keep sharing that texture instead of building a resampled copy.
+    CreateTileModelFilter filter = _filter;
+    if (_elevationInherited &&
+        (filter.empty() || filter.elevation().isSetTo(true)) &&
+        !hasElevationAt(_mapFrame, tilenode->getKey()))
+    {
+        if (filter.empty())
+        {
+            for (LayerVector::const_iterator i = _mapFrame.layers().begin(); i != _mapFrame.layers().end(); ++i)
+                filter.layers().insert(i->get()->getUID());
+        }
+        filter.elevation() = false;
+    }
+
     // Assemble all the components necessary to display this tile
     _dataModel = engine->createTileModel(
         _mapFrame,
         tilenode->getKey(),           
-        _filter,
+        filter,
         progress.get() );
+
+    // Note the layers that held back data for this tile because of a slow
+    // link, so the tile can ask again once the link recovers.
+    _heldBackLayers.clear();
+    ImageLayerVector imageLayers;
+    _mapFrame.getLayers(imageLayers);
+    for (ImageLayerVector::const_iterator i = imageLayers.begin(); i != imageLayers.end(); ++i)
+    {
+        ImageLayer* layer = i->get();
+        if (layer->getEnabled() &&
+            layer->options().adaptiveLOD() == true &&
+            filter.accept(layer) &&
+            tilenode->getKey().getLOD() > layer->getAdaptiveMaxLevel())
+        {
+            _heldBackLayers.push_back(layer);
+        }
+    }
+
+    // Masked tiles need an expensive tessellation; build the subtiles' ahead of
+    // time here so the cull traversal that creates them only has to look it up.
+    MaskLayerVector maskLayers;
+    if (_mapFrame.getLayers(maskLayers) > 0)
+    {
+        const TileKey& key = tilenode->getKey();
+        for (unsigned q = 0; q < 4; ++q)
+        {
+            if (progress.valid() && progress->isCanceled())
+                break;
+
+            osg::ref_ptr<MaskGenerator> masks = new MaskGenerator(key.createChildKey(q), _tileSize, _mapFrame);
+            masks->prepare(_mapFrame.getMapInfo());
+        }
+    }
+}
+
+
+namespace
+{
+    void compileTexture(osg::Texture* tex, osg::State& state, PixelBufferRing* uploads, GPUTimers* timers, UID layer,
+                        const std::string& layerName, const TileKey& key)
+    {
+        if ( !tex )
+            return;
+
+        ScopedTileStage stage("tile.upload", layerName, key);
+
+        if ( timers )
+            timers->begin( layer, GPUTimers::UPLOAD, state );
+
+        if ( uploads )
+            uploads->compile( tex, state );
+        else
+            tex->compileGLObjects( state );
+
+        if ( timers )
+            timers->end( state );
+    }
+
+    UID getLayerUID(const TerrainTileImageLayerModel* model)
+    {
+        return model->getImageLayer() ? model->getImageLayer()->getUID() : -1;
+    }
+
+    std::string getLayerName(const TerrainTileImageLayerModel* model)
+    {
+        return model->getImageLayer() ? model->getImageLayer()->getName() : model->getName();
+    }
 }
 
+// compileGLObjects runs in the draw thread, between invoke and apply.
+void
+LoadTileData::compileGLObjects(osg::State& state, PixelBufferRing* uploads, GPUTimers* timers) const
+{
+    if (!_dataModel.valid())
+        return;
+
+    const TileKey& key = _dataModel->getKey();
+
+    for (TerrainTileImageLayerModelVector::const_iterator i = _dataModel->colorLayers().begin(); i != _dataModel->colorLayers().end(); ++i)
+    {
+        if (i->valid())
+            compileTexture((*i)->getTexture(), state, uploads, timers, getLayerUID(i->get()), getLayerName(i->get()), key);
+    }
+
+    for (TerrainTileImageLayerModelVector::const_iterator i = _dataModel->sharedLayers().begin(); i != _dataModel->sharedLayers().end(); ++i)
+    {
+        if (i->valid())
+            compileTexture((*i)->getTexture(), state, uploads, timers, getLayerUID(i->get()), getLayerName(i->get()), key);
+    }
+
+    if (_dataModel->elevationModel().valid())
+        compileTexture(_dataModel->elevationModel()->getTexture(), state, uploads, timers, -1, "elevation", key);
+
+    if (_dataModel->normalModel().valid())
+        compileTexture(_dataModel->normalModel()->getTexture(), state, uploads, timers, -1, "normalmap", key);
+}
 
 bool
 LoadTileData::isCanceled()
@@ -106,8 +243,15 @@ LoadTileData::apply(const osg::FrameStamp* stamp)
                 const RenderBindings& bindings = _context->getRenderBindings();
 
                 // Merge the new data into the tile.
+                ScopedTileStage stage("tile.merge", "terrain", _dataModel->getKey());
+                double bytesBefore = (double)tilenode->getMemoryUsage();
                 tilenode->merge(_dataModel.get(), bindings);
 
+                // keep the unloader's memory estimate current between its recounts.
+                _context->getUnloader()->adjustMemoryUsage( (double)tilenode->getMemoryUsage() - bytesBefore );
+
+                tilenode->setHeldBackLayers(_heldBackLayers, _filter);
+
                 // Mark as complete. TODO: per-data requests will do something different.
                 tilenode->setDirty( false );
 
@@ -21,12 +21,16 @@
 
 #include <osgEarth/Registry>
 #include <osgEarth/Utils>
+#include <osgEarth/StatsRegistry>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/Registry>
 #include <osgDB/ReaderWriter>
 
+#include <osg/State>
+#include <osg/RenderInfo>
+
 #include <string>
 
 #define REPORT_ACTIVITY true
@@ -66,6 +70,149 @@ Loader::Request::addToChangeSet(osg::Node* node)
 
 //...............................................
 
+#undef  LC
+#define LC "[GLCompileQueue] "
+
+GLCompileQueue::GLCompileQueue()
+{
+    // ensure this node always gets traversed:
+    this->setCullingActive(false);
+
+    // ensure the draw runs synchronously:
+    this->setDataVariance(DYNAMIC);
+
+    // force the draw to run every frame:
+    this->setUseDisplayList(false);
+}
+
+void
+GLCompileQueue::push(Loader::Request* req)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _toCompile.push_back(req);
+}
+
+void
+GLCompileQueue::takeCompiled(std::vector<osg::ref_ptr<Loader::Request> >& out)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    out.insert(out.end(), _compiled.begin(), _compiled.end());
+    _compiled.clear();
+}
+
+void
+GLCompileQueue::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _toCompile.clear();
+    _compiled.clear();
+}
+
+void
+GLCompileQueue::drawImplementation(osg::RenderInfo& ri) const
+{
+    if ( _toCompile.empty() )
+        return;
+
+    Threading::ScopedMutexLock lock(_mutex);
+    osg::State& state = *ri.getState();
+
+    // always make some progress, even if one compile blows the budget.
+    unsigned count = 0;
+    _budget.startFrame();
+    while ( !_toCompile.empty() && (count == 0 || _budget.hasTimeLeft()) )
+    {
+        osg::ref_ptr<Loader::Request> req = _toCompile.front();
+        _toCompile.erase( _toCompile.begin() );
+
+        // anything canceled while waiting just drops out.
+        if ( req->isMerging() )
+        {
+            _budget.startJob();
+            state.setActiveTextureUnit(0);
+            req->compileGLObjects( state, _uploads.get(), _timers.get() );
+            _budget.endJob();
+            _compiled.push_back( req.get() );
+        }
+        ++count;
+    }
+
+    // we bound textures behind the state's back.
+    state.dirtyAllAttributes();
+
+    OE_DEBUG << LC << "Compiled " << count << " requests (" << _budget.getAverage() << " ms avg)\n";
+}
+
+void
+GLCompileQueue::releaseGLObjects(osg::State* state) const
+{
+    osg::Drawable::releaseGLObjects( state );
+    if ( _uploads.valid() )
+        _uploads->releaseGLObjects( state );
+}
+
+//...............................................
+
+LoaderGroup::LoaderGroup() :
+_numLODs( 20u )
+{
+    // initialize the LOD priority scales and offsets
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        _priorityScales[i] = 1.0f;
+        _priorityOffsets[i] = 0.0f;
+    }
+}
+
+void
+LoaderGroup::setNumLODs(unsigned lods)
+{
+    _numLODs = std::max(lods, 1u);
+}
+
+void
+LoaderGroup::setLODPriorityScale(unsigned lod, float priorityScale)
+{
+    if (lod < 64)
+        _priorityScales[lod] = priorityScale;
+}
+
+void
+LoaderGroup::setLODPriorityOffset(unsigned lod, float offset)
+{
+    if (lod < 64)
+        _priorityOffsets[lod] = offset;
+}
+
+void
+LoaderGroup::setCompileQueue(GLCompileQueue* queue)
+{
+    _compileQueue = queue;
+}
+
+bool
+LoaderGroup::compile(Loader::Request* req)
+{
+    if ( !_compileQueue.valid() )
+        return false;
+
+    req->setState( Request::MERGING );
+    _compileQueue->push( req );
+    return true;
+}
+
+float
+LoaderGroup::normalizePriority(unsigned lod, float priority) const
+{
+    if (lod >= 64)
+        return priority / (float)(_numLODs+1);
+
+    float p = priority * _priorityScales[lod] + _priorityOffsets[lod];
+    return p / (float)(_numLODs+1);
+}
+
+//...............................................
+
 #undef  LC
 #define LC "[SimpleLoader] "
 
@@ -181,8 +328,7 @@ namespace
 PagerLoader::PagerLoader(TerrainEngineNode* engine) :
 _checkpoint    ( (osg::Timer_t)0 ),
 _mergesPerFrame( 0 ),
-_frameNumber   ( 0 ),
-_numLODs       ( 20u )
+_frameNumber   ( 0 )
 {
     _myNodePath.push_back( this );
 
@@ -190,19 +336,6 @@ _numLODs       ( 20u )
     _dboptions->setFileLocationCallback( new FileLocationCallback() );
 
     OptionsData<PagerLoader>::set(_dboptions.get(), "osgEarth.PagerLoader", this);
-
-    // initialize the LOD priority scales and offsets
-    for (unsigned i = 0; i < 64; ++i)
-    {
-        _priorityScales[i] = 1.0f;
-        _priorityOffsets[i] = 0.0f;
-    }
-}
-
-void
-PagerLoader::setNumLODs(unsigned lods)
-{
-    _numLODs = std::max(lods, 1u);
 }
 
 void
@@ -213,17 +346,17 @@ PagerLoader::setMergesPerFrame(int value)
 }
 
 void
-PagerLoader::setLODPriorityScale(unsigned lod, float priorityScale)
+PagerLoader::setMergeBudget(float ms)
 {
-    if (lod < 64)
-        _priorityScales[lod] = priorityScale;
+    _mergeBudget.setBudget( ms );
+    this->setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
 void
-PagerLoader::setLODPriorityOffset(unsigned lod, float offset)
+PagerLoader::setCompileQueue(GLCompileQueue* queue)
 {
-    if (lod < 64)
-        _priorityOffsets[lod] = offset;
+    LoaderGroup::setCompileQueue( queue );
+    this->setNumChildrenRequiringUpdateTraversal( 1 );
 }
 
 bool
@@ -239,7 +372,6 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
         if ( nv.getFrameStamp() )
         {
             fn = nv.getFrameStamp()->getFrameNumber();
-            request->setFrameNumber( fn );
         }
 
         bool addToRequestSet = false;
@@ -252,16 +384,9 @@ PagerLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv
             // remember the last tick at which this request was submitted
             request->_lastTick = osg::Timer::instance()->tick();
 
-            // update the priority, scale and bias it, and then normalize it to [0..1] range.
-            unsigned lod = request->getTileKey().getLOD();
-            float p = priority * _priorityScales[lod] + _priorityOffsets[lod];            
-            request->_priority = p / (float)(_numLODs+1);
-
-            // timestamp it
-            request->setFrameNumber( fn );
-
-            // incremenet the load count.
-            request->_loadCount++;
+            // update the priority (scaled, biased and normalized to [0..1]),
+            // timestamp it, and increment the load count.
+            request->submit( fn, normalizePriority(request->getTileKey().getLOD(), priority) );
 
             // if this is the first load request since idle, we need to remember this request.
             addToRequestSet = (request->_loadCount == 1);
@@ -302,7 +427,7 @@ PagerLoader::clear()
 void
 PagerLoader::traverse(osg::NodeVisitor& nv)
 {
-    // only called when _mergesPerFrame > 0
+    // only called when merges are limited or GL compilation is on
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
     {
         if ( nv.getFrameStamp() )
@@ -310,15 +435,27 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             setFrameStamp(nv.getFrameStamp());
         }
 
+        // pick up requests that are done compiling:
+        if ( _compileQueue.valid() )
+        {
+            std::vector<RefRequest> compiled;
+            _compileQueue->takeCompiled( compiled );
+            _mergeQueue.insert( compiled.begin(), compiled.end() );
+        }
+
+        // merge in priority order until we run out of count or time.
+        _mergeBudget.startFrame();
         int count;
-        for(count=0; count < _mergesPerFrame && !_mergeQueue.empty(); ++count)
+        for(count=0;
+            (_mergesPerFrame == 0 || count < _mergesPerFrame) && !_mergeQueue.empty() && (count == 0 || _mergeBudget.hasTimeLeft());
+            ++count)
         {
             Request* req = _mergeQueue.begin()->get();
-            if ( req && req->_lastTick >= _checkpoint )
+            if ( req && req->isMerging() && req->_lastTick >= _checkpoint )
             {
-                OE_START_TIMER(req_apply);
+                _mergeBudget.startJob();
                 req->apply( getFrameStamp() );
-                double s = OE_STOP_TIMER(req_apply);
+                _mergeBudget.endJob();
 
                 req->setState(Request::FINISHED);
             }
@@ -377,6 +514,13 @@ PagerLoader::traverse(osg::NodeVisitor& nv)
             }
 
             //OE_NOTICE << LC << "PagerLoader: requests=" << _requests.size() << "; mergeQueue=" << _mergeQueue.size() << std::endl;
+
+            static StatsRegistry::Gauge* s_requests = StatsRegistry::instance()->getGauge(
+                "osgearth_rex_loader_requests", "loader=\"pager\"", "Tile load requests in progress");
+            static StatsRegistry::Gauge* s_merges = StatsRegistry::instance()->getGauge(
+                "osgearth_rex_loader_merge_queue", "loader=\"pager\"", "Loaded tiles waiting to merge");
+            s_requests->set( _requests.size() );
+            s_merges->set( _mergeQueue.size() );
         }
     }
 
@@ -395,7 +539,11 @@ PagerLoader::addChild(osg::Node* node)
         {
             if ( req->_lastTick >= _checkpoint )
             {
-                if ( _mergesPerFrame > 0 )
+                if ( compile(req) )
+                {
+                    // merges once it's compiled.
+                }
+                else if ( _mergesPerFrame > 0 || _mergeBudget.getBudget() > 0.0 )
                 {
                     _mergeQueue.insert( req );
                     req->setState( Request::MERGING );
@@ -471,6 +619,303 @@ PagerLoader::invokeAndRelease(UID requestUID)
 
 
 
+//...............................................
+
+#undef  LC
+#define LC "[ThreadedLoader] "
+
+class ThreadedLoader::Worker : public OpenThreads::Thread
+{
+public:
+    Worker(ThreadedLoader* loader) : _loader(loader) { }
+
+    void run()
+    {
+        ThreadedLoader::RefRequest req;
+        while ( _loader->takeNext(req) )
+        {
+            if ( REPORT_ACTIVITY )
+                Registry::instance()->startActivity( req->getName() );
+
+            req->invoke();
+            _loader->invoked( req.get() );
+            req = 0L;
+        }
+    }
+
+    ThreadedLoader* _loader;
+};
+
+
+ThreadedLoader::ThreadedLoader(unsigned numThreads) :
+_checkpoint    ( (osg::Timer_t)0 ),
+_mergesPerFrame( 0 ),
+_done          ( false )
+{
+    // merging happens in the update traversal.
+    this->setNumChildrenRequiringUpdateTraversal( 1 );
+
+    numThreads = std::max(numThreads, 1u);
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        Worker* worker = new Worker(this);
+        worker->start();
+        _workers.push_back( worker );
+    }
+
+    OE_INFO << LC << "Started " << numThreads << " loader threads" << std::endl;
+}
+
+ThreadedLoader::~ThreadedLoader()
+{
+    {
+        Threading::ScopedMutexLock lock( _mutex );
+        _done = true;
+
+        // tell anything still running to cancel:
+        for (Requests::iterator i = _requests.begin(); i != _requests.end(); ++i)
+            i->second->setState( Request::IDLE );
+
+        _pending.clear();
+        _wake.broadcast();
+    }
+
+    for (unsigned i = 0; i < _workers.size(); ++i)
+    {
+        _workers[i]->join();
+        delete _workers[i];
+    }
+    _workers.clear();
+}
+
+void
+ThreadedLoader::setMergesPerFrame(int value)
+{
+    _mergesPerFrame = std::max(value, 0);
+}
+
+void
+ThreadedLoader::setMergeBudget(float ms)
+{
+    _mergeBudget.setBudget( ms );
+}
+
+bool
+ThreadedLoader::load(Loader::Request* request, float priority, osg::NodeVisitor& nv)
+{
+    if ( !request || request->isMerging() || request->isFinished() )
+        return false;
+
+    unsigned fn = nv.getFrameStamp() ? nv.getFrameStamp()->getFrameNumber() : 0u;
+
+    // lock the request since multiple cull traversals might hit this function.
+    request->lock();
+    {
+        request->setState( Request::RUNNING );
+        request->_lastTick = osg::Timer::instance()->tick();
+        request->submit( fn, normalizePriority(request->getTileKey().getLOD(), priority) );
+    }
+    request->unlock();
+
+    Threading::ScopedMutexLock lock( _mutex );
+
+    if ( _requests.find(request->getUID()) == _requests.end() )
+    {
+        _requests[request->getUID()] = request;
+
+        // A worker may still be winding down a canceled run of this same request;
+        // it will re-queue it when it's done.
+        if ( _inFlight.find(request->getUID()) == _inFlight.end() )
+        {
+            _pending[request->getUID()] = request;
+            _wake.signal();
+        }
+    }
+
+    return true;
+}
+
+bool
+ThreadedLoader::takeNext(RefRequest& out)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    while ( !_done && _pending.empty() )
+        _wake.wait( &_mutex );
+
+    if ( _done )
+        return false;
+
+    // priorities change from frame to frame, so just find the best one now.
+    Requests::iterator best = _pending.begin();
+    for (Requests::iterator i = _pending.begin(); i != _pending.end(); ++i)
+    {
+        if ( i->second->_priority > best->second->_priority )
+            best = i;
+    }
+
+    out = best->second.get();
+    _pending.erase( best );
+    _inFlight[out->getUID()] = false;
+    return true;
+}
+
+void
+ThreadedLoader::invoked(Loader::Request* req)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    InFlight::iterator f = _inFlight.find( req->getUID() );
+    bool canceled = f != _inFlight.end() && f->second;
+    if ( f != _inFlight.end() )
+        _inFlight.erase( f );
+
+    if ( canceled || !req->isRunning() || req->_lastTick < _checkpoint )
+    {
+        if ( REPORT_ACTIVITY )
+            Registry::instance()->endActivity( req->getName() );
+
+        // if the request came back while we were running the canceled one,
+        // run it again from scratch.
+        if ( req->isRunning() && _requests.find(req->getUID()) != _requests.end() )
+        {
+            _pending[req->getUID()] = req;
+            _wake.signal();
+        }
+        return;
+    }
+
+    if ( !compile(req) )
+    {
+        req->setState( Request::MERGING );
+        _mergeQueue.insert( req );
+    }
+}
+
+void
+ThreadedLoader::expire(Loader::Request* req)
+{
+    req->setState( Request::IDLE );
+
+    _pending.erase( req->getUID() );
+
+    InFlight::iterator f = _inFlight.find( req->getUID() );
+    if ( f != _inFlight.end() )
+        f->second = true;
+    else if ( REPORT_ACTIVITY )
+        Registry::instance()->endActivity( req->getName() );
+}
+
+void
+ThreadedLoader::clear()
+{
+    // Set a time checkpoint for invalidating old requests.
+    _checkpoint = osg::Timer::instance()->tick();
+}
+
+void
+ThreadedLoader::traverse(osg::NodeVisitor& nv)
+{
+    if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
+    {
+        if ( nv.getFrameStamp() )
+        {
+            setFrameStamp(nv.getFrameStamp());
+        }
+
+        // pick up requests that are done compiling:
+        if ( _compileQueue.valid() )
+        {
+            std::vector<RefRequest> compiled;
+            _compileQueue->takeCompiled( compiled );
+            Threading::ScopedMutexLock lock( _mutex );
+            _mergeQueue.insert( compiled.begin(), compiled.end() );
+        }
+
+        // Merge results in priority order until we run out of count or time.
+        _mergeBudget.startFrame();
+        int count = 0;
+        while ( (_mergesPerFrame == 0 || count < _mergesPerFrame) && (count == 0 || _mergeBudget.hasTimeLeft()) )
+        {
+            RefRequest req;
+            {
+                Threading::ScopedMutexLock lock( _mutex );
+                if ( _mergeQueue.empty() )
+                    break;
+                req = *_mergeQueue.begin();
+                _mergeQueue.erase( _mergeQueue.begin() );
+            }
+
+            // skip anything that gave up waiting in the queue.
+            if ( !req->isMerging() )
+                continue;
+
+            if ( req->_lastTick >= _checkpoint )
+            {
+                _mergeBudget.startJob();
+                req->apply( getFrameStamp() );
+                _mergeBudget.endJob();
+                ++count;
+            }
+            req->setState( Request::FINISHED );
+        }
+
+        // cull finished and expired requests.
+        {
+            Threading::ScopedMutexLock lock( _mutex );
+
+            unsigned fn = 0;
+            if ( nv.getFrameStamp() )
+                fn = nv.getFrameStamp()->getFrameNumber();
+
+            for(Requests::iterator i = _requests.begin(); i != _requests.end(); )
+            {
+                Request* req = i->second.get();
+                const unsigned frameDiff = fn - req->getLastFrameSubmitted();
+
+                if ( req->isFinished() )
+                {
+                    req->setState( Request::IDLE );
+                    if ( REPORT_ACTIVITY )
+                        Registry::instance()->endActivity( req->getName() );
+                    _requests.erase( i++ );
+                }
+
+                // Cancel requests that are no longer wanted:
+                else if ( !req->isMerging() && frameDiff > 2 )
+                {
+                    expire( req );
+                    _requests.erase( i++ );
+                }
+
+                // Prevent a request from getting stuck in the merge queue:
+                else if ( req->isMerging() && frameDiff > 1800 )
+                {
+                    req->setState( Request::IDLE );
+                    if ( REPORT_ACTIVITY )
+                        Registry::instance()->endActivity( req->getName() );
+                    _requests.erase( i++ );
+                }
+
+                else
+                {
+                    ++i;
+                }
+            }
+
+            static StatsRegistry::Gauge* s_requests = StatsRegistry::instance()->getGauge(
+                "osgearth_rex_loader_requests", "loader=\"threaded\"", "Tile load requests in progress");
+            static StatsRegistry::Gauge* s_merges = StatsRegistry::instance()->getGauge(
+                "osgearth_rex_loader_merge_queue", "loader=\"threaded\"", "Loaded tiles waiting to merge");
+            s_requests->set( _requests.size() );
+            s_merges->set( _mergeQueue.size() );
+        }
+    }
+
+    LoaderGroup::traverse( nv );
+}
+
+
 namespace osgEarth { namespace Drivers { namespace RexTerrainEngine
 {
     using namespace osgEarth;
@@ -21,6 +21,7 @@
 #include <osgEarth/MaskLayer>
 #include <osgEarth/Locators>
 #include <osgEarthSymbology/Geometry>
+#include <osgEarth/Containers>
 
 #include <osgUtil/DelaunayTriangulator>
 
@@ -33,11 +34,62 @@ using namespace osgEarth::Symbology;
 
 #define MATCH_TOLERANCE 0.000001
 
+namespace
+{
+    // Tessellations are cached per tile key, since tiles of the same key are
+    // rebuilt as they page in and out.
+    struct TessellationKey
+    {
+        TileKey  _key;
+        unsigned _tileSize;
+
+        bool operator < (const TessellationKey& rhs) const
+        {
+            if (_key < rhs._key) return true;
+            if (rhs._key < _key) return false;
+            return _tileSize < rhs._tileSize;
+        }
+    };
+
+    typedef LRUCache<TessellationKey, osg::ref_ptr<MaskTessellation> > TessellationCache;
+
+    TessellationCache s_tessellationCache(true, 256);
+}
+
+bool
+MaskTessellation::matches(const MaskRecordVector& records) const
+{
+    if (records.size() != _sources.size())
+        return false;
+
+    for (unsigned i = 0; i < records.size(); ++i)
+    {
+        if (records[i]._boundary.get() != _sources[i].get() ||
+            records[i]._boundary->getModifiedCount() != _sourceRevisions[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 
 MaskGenerator::MaskGenerator(const TileKey& key, unsigned tileSize, const Map* map) :
 _key( key ), _tileSize(tileSize)
 {
     MapFrame frame(map);
+    init(frame);
+}
+
+MaskGenerator::MaskGenerator(const TileKey& key, unsigned tileSize, const MapFrame& frame) :
+_key( key ), _tileSize(tileSize)
+{
+    init(frame);
+}
+
+void
+MaskGenerator::init(const MapFrame& frame)
+{
     MaskLayerVector maskLayers;
     frame.getLayers(maskLayers);
     for(MaskLayerVector::const_iterator it = maskLayers.begin();
@@ -45,9 +97,9 @@ _key( key ), _tileSize(tileSize)
         ++it)
     {
         MaskLayer* layer = it->get();
-        if ( layer->getMinLevel() <= key.getLevelOfDetail() )
+        if ( layer->getMinLevel() <= _key.getLevelOfDetail() )
         {
-            setupMaskRecord(frame.getMapInfo(), layer->getOrCreateMaskBoundary( 1.0, key.getExtent().getSRS(), (ProgressCallback*)0L ) );
+            setupMaskRecord(frame.getMapInfo(), layer->getOrCreateMaskBoundary( 1.0, _key.getExtent().getSRS(), (ProgressCallback*)0L ) );
         }
     }
 }
@@ -111,23 +163,13 @@ MaskGenerator::setupMaskRecord(const MapInfo& mapInfo, osg::Vec3dArray* boundary
     }
 }
 
-osg::DrawElementsUInt*
-MaskGenerator::createMaskPrimitives(const MapInfo& mapInfo, osg::Vec3Array* verts, osg::Vec3Array* texCoords, osg::Vec3Array* normals, osg::Vec3Array* neighbors)
+void
+MaskGenerator::tessellate(const MapInfo& mapInfo, osg::ref_ptr<MaskTessellation>& out)
 {
-    if (_maskRecords.size() <= 0)
-      return 0L;
-
     osg::ref_ptr<osgEarth::GeoLocator> geoLocator = GeoLocator::createForKey(_key, mapInfo);
     if (geoLocator->getCoordinateSystemType() == GeoLocator::GEOCENTRIC)
         geoLocator = geoLocator->getGeographicFromGeocentric();
 
-    GeoPoint centroid;
-    _key.getExtent().getCentroid( centroid );
-
-    osg::Matrix world2local, local2world;
-    centroid.createWorldToLocal( world2local );
-    local2world.invert( world2local );
-
     osg::ref_ptr<osgUtil::DelaunayTriangulator> trig=new osgUtil::DelaunayTriangulator();
 
     std::vector<osg::ref_ptr<osgUtil::DelaunayConstraint> > alldcs;
@@ -406,75 +448,140 @@ MaskGenerator::createMaskPrimitives(const MapInfo& mapInfo, osg::Vec3Array* vert
             trig->removeInternalTriangles(alldcs[dcnum].get());
         }
 
-        verts->reserve(verts->size() + trig->getInputPointArray()->size());
-        texCoords->reserve(texCoords->size() + trig->getInputPointArray()->size());
-        normals->reserve(normals->size() + trig->getInputPointArray()->size());
-        if ( neighbors )
-            neighbors->reserve(neighbors->size() + trig->getInputPointArray()->size()); 
-
-        // Iterate through point to convert to model coords, calculate normals, and set up tex coords
-        osg::ref_ptr<GeoLocator> locator = GeoLocator::createForKey( _key, mapInfo );
-
-        //int norm_i = -1;
-        unsigned vertsOffset = verts->size();
-
-        for (osg::Vec3Array::iterator it = trig->getInputPointArray()->begin(); it != trig->getInputPointArray()->end(); ++it)
+        osg::DrawElementsUInt* tris = trig->getTriangles();
+        if ( tris && tris->getNumIndices() >= 3 )
         {
-            // check to see if point is a part of the original mask boundary
-            bool isBoundary = false;
-            for (osg::Vec3dArray::iterator bit = boundaryVerts->begin(); bit != boundaryVerts->end(); ++bit)
+            out = new MaskTessellation();
+            out->_points = trig->getInputPointArray();
+            out->_triangles = tris;
+
+            // flag the points that are part of the original mask boundary
+            out->_boundary.reserve(out->_points->size());
+            for (osg::Vec3Array::const_iterator it = out->_points->begin(); it != out->_points->end(); ++it)
             {
-                if (osg::absolute((*bit).x() - (*it).x()) < MATCH_TOLERANCE && osg::absolute((*bit).y() - (*it).y()) < MATCH_TOLERANCE)
+                bool isBoundary = false;
+                for (osg::Vec3dArray::iterator bit = boundaryVerts->begin(); bit != boundaryVerts->end(); ++bit)
                 {
-                    isBoundary = true;
-                    break;
+                    if (osg::absolute((*bit).x() - (*it).x()) < MATCH_TOLERANCE && osg::absolute((*bit).y() - (*it).y()) < MATCH_TOLERANCE)
+                    {
+                        isBoundary = true;
+                        break;
+                    }
                 }
+                out->_boundary.push_back(isBoundary);
             }
 
-            // get model coords
-            osg::Vec3d model;
-            locator->unitToModel(osg::Vec3d(it->x(), it->y(), 0.0f), model);
-            model = model * world2local;
+            for (MaskRecordVector::const_iterator mr = _maskRecords.begin(); mr != _maskRecords.end(); ++mr)
+            {
+                out->_sources.push_back(mr->_boundary.get());
+                out->_sourceRevisions.push_back(mr->_boundary->getModifiedCount());
+            }
+        }
+    }
+}
 
-            // calc normals
-            osg::Vec3d modelPlusOne;
-            locator->unitToModel(osg::Vec3d(it->x(), it->y(), 1.0f), modelPlusOne);
-            osg::Vec3d normal = (modelPlusOne*world2local)-model;                
-            normal.normalize();
-            normals->push_back( normal );
+void
+MaskGenerator::getOrCreateTessellation(const MapInfo& mapInfo, osg::ref_ptr<MaskTessellation>& out)
+{
+    TessellationKey cacheKey;
+    cacheKey._key = _key;
+    cacheKey._tileSize = _tileSize;
 
-            // set elevation if this is a point along the mask boundary
-            if (isBoundary)
-                model += normal*it->z();
+    TessellationCache::Record rec;
+    if (s_tessellationCache.get(cacheKey, rec) && rec.value()->matches(_maskRecords))
+    {
+        out = rec.value().get();
+        return;
+    }
 
-            verts->push_back(model);
+    tessellate(mapInfo, out);
+    if (out.valid())
+    {
+        s_tessellationCache.insert(cacheKey, out.get());
+    }
+}
 
-            // use same vert for neighbor to prevent morphing
-            if ( neighbors )
-                neighbors->push_back( model );  
+void
+MaskGenerator::prepare(const MapInfo& mapInfo)
+{
+    if (_maskRecords.size() > 0)
+    {
+        osg::ref_ptr<MaskTessellation> tess;
+        getOrCreateTessellation(mapInfo, tess);
+    }
+}
 
-            // set up text coords
-            texCoords->push_back( osg::Vec3f(it->x(), it->y(), isBoundary ? MASK_MARKER_BOUNDARY : MASK_MARKER_SKIRT) );
-        }
+osg::DrawElementsUInt*
+MaskGenerator::createMaskPrimitives(const MapInfo& mapInfo, osg::Vec3Array* verts, osg::Vec3Array* texCoords, osg::Vec3Array* normals, osg::Vec3Array* neighbors)
+{
+    if (_maskRecords.size() <= 0)
+      return 0L;
 
-        // Get triangles from triangulator and add as primative set to the geometry
-        osg::DrawElementsUInt* tris = trig->getTriangles();
-        if ( tris && tris->getNumIndices() >= 3 )
-        {
-            osg::ref_ptr<osg::DrawElementsUInt> elems = new osg::DrawElementsUInt(tris->getMode());
-            elems->reserve(tris->size());
+    osg::ref_ptr<MaskTessellation> tess;
+    getOrCreateTessellation(mapInfo, tess);
+    if (!tess.valid())
+        return 0L;
 
-            const osg::MixinVector<GLuint> ins = tris->asVector();
-            for (osg::MixinVector<GLuint>::const_iterator it = ins.begin(); it != ins.end(); ++it)
-            {
-                elems->push_back((*it) + vertsOffset);
-            }
+    GeoPoint centroid;
+    _key.getExtent().getCentroid( centroid );
 
-            return elems.release();
-        }
+    osg::Matrix world2local, local2world;
+    centroid.createWorldToLocal( world2local );
+    local2world.invert( world2local );
+
+    verts->reserve(verts->size() + tess->_points->size());
+    texCoords->reserve(texCoords->size() + tess->_points->size());
+    normals->reserve(normals->size() + tess->_points->size());
+    if ( neighbors )
+        neighbors->reserve(neighbors->size() + tess->_points->size()); 
+
+    // Iterate through point to convert to model coords, calculate normals, and set up tex coords
+    osg::ref_ptr<GeoLocator> locator = GeoLocator::createForKey( _key, mapInfo );
+
+    unsigned vertsOffset = verts->size();
+
+    for (unsigned p = 0; p < tess->_points->size(); ++p)
+    {
+        const osg::Vec3& point = (*tess->_points)[p];
+        bool isBoundary = tess->_boundary[p];
+
+        // get model coords
+        osg::Vec3d model;
+        locator->unitToModel(osg::Vec3d(point.x(), point.y(), 0.0f), model);
+        model = model * world2local;
+
+        // calc normals
+        osg::Vec3d modelPlusOne;
+        locator->unitToModel(osg::Vec3d(point.x(), point.y(), 1.0f), modelPlusOne);
+        osg::Vec3d normal = (modelPlusOne*world2local)-model;                
+        normal.normalize();
+        normals->push_back( normal );
+
+        // set elevation if this is a point along the mask boundary
+        if (isBoundary)
+            model += normal*point.z();
+
+        verts->push_back(model);
+
+        // use same vert for neighbor to prevent morphing
+        if ( neighbors )
+            neighbors->push_back( model );  
+
+        // set up text coords
+        texCoords->push_back( osg::Vec3f(point.x(), point.y(), isBoundary ? MASK_MARKER_BOUNDARY : MASK_MARKER_SKIRT) );
+    }
+
+    // Add the cached triangles, offset to the new vertices
+    osg::ref_ptr<osg::DrawElementsUInt> elems = new osg::DrawElementsUInt(tess->_triangles->getMode());
+    elems->reserve(tess->_triangles->size());
+
+    const osg::MixinVector<GLuint>& ins = tess->_triangles->asVector();
+    for (osg::MixinVector<GLuint>::const_iterator it = ins.begin(); it != ins.end(); ++it)
+    {
+        elems->push_back((*it) + vertsOffset);
     }
 
-    return 0L;
+    return elems.release();
 }
 
 void
@@ -0,0 +1,87 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2014 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PixelBufferRing"
+
+#include <osg/Image>
+#include <osg/GLExtensions>
+#include <algorithm>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace osgEarth;
+
+PixelBufferRing::PixelBufferRing(unsigned size) :
+_next( 0u )
+{
+    _pbos.resize( std::max(size, 1u) );
+    for (unsigned i = 0; i < _pbos.size(); ++i)
+    {
+        _pbos[i] = new osg::PixelBufferObject();
+        _pbos[i]->setUsage( GL_STREAM_DRAW_ARB );
+    }
+}
+
+void
+PixelBufferRing::compile(osg::Texture* texture, osg::State& state)
+{
+    if ( !texture )
+        return;
+
+    // already compiled (shared or placeholder textures) - nothing to upload.
+    if ( texture->getTextureObject(state.getContextID()) )
+        return;
+
+    const osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+    if ( !ext || !ext->isPBOSupported )
+    {
+        texture->compileGLObjects( state );
+        return;
+    }
+
+    // stage each image through the next buffer in the ring:
+    std::vector<osg::Image*> staged;
+    for (unsigned i = 0; i < texture->getNumImages(); ++i)
+    {
+        osg::Image* image = texture->getImage(i);
+        if ( image && image->data() && image->getPixelBufferObject() == 0L )
+        {
+            image->setPixelBufferObject( _pbos[_next].get() );
+            _next = (_next + 1) % _pbos.size();
+            staged.push_back( image );
+        }
+    }
+
+    texture->compileGLObjects( state );
+    state.unbindPixelBufferObject();
+
+    // detach again so the buffers don't grow to hold every image we've ever seen;
+    // the texture is already specified and won't re-upload unless the image changes.
+    for (std::vector<osg::Image*>::iterator i = staged.begin(); i != staged.end(); ++i)
+    {
+        (*i)->setPixelBufferObject( 0L );
+    }
+}
+
+void
+PixelBufferRing::releaseGLObjects(osg::State* state) const
+{
+    for (unsigned i = 0; i < _pbos.size(); ++i)
+    {
+        _pbos[i]->releaseGLObjects( state );
+    }
+}
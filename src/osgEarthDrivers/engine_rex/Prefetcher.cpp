@@ -0,0 +1,201 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2014 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "Prefetcher"
+
+#include <osgEarth/ImageLayer>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/GeoData>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace osgEarth;
+
+#define LC "[Prefetcher] "
+
+namespace
+{
+    // Maximum number of queued prefetch requests; beyond this we drop
+    // new requests rather than fall further behind the camera.
+    const unsigned MAX_PENDING = 64u;
+
+    // Forget the request history past this many keys.
+    const unsigned MAX_REQUESTED = 4096u;
+
+    // Fetches one tile from each layer, which populates the layer caches.
+    struct PrefetchTile : public TaskRequest
+    {
+        TileKey              _key;
+        ImageLayerVector     _imageLayers;
+        ElevationLayerVector _elevationLayers;
+        OpenThreads::Atomic* _pending;
+
+        void operator()(ProgressCallback* progress)
+        {
+            for (ImageLayerVector::const_iterator i = _imageLayers.begin(); i != _imageLayers.end(); ++i)
+            {
+                if (progress && progress->isCanceled())
+                    break;
+
+                ImageLayer* layer = i->get();
+                if (layer->getEnabled() && layer->isKeyInLegalRange(_key))
+                    layer->createImage(_key, progress);
+            }
+
+            for (ElevationLayerVector::const_iterator i = _elevationLayers.begin(); i != _elevationLayers.end(); ++i)
+            {
+                if (progress && progress->isCanceled())
+                    break;
+
+                ElevationLayer* layer = i->get();
+                if (layer->getEnabled() && layer->isKeyInLegalRange(_key))
+                    layer->createHeightField(_key, progress);
+            }
+
+            --(*_pending);
+        }
+    };
+}
+
+Prefetcher::Prefetcher(const MapFrame& frame, const SelectionInfo& selectionInfo, double lookahead, unsigned numThreads) :
+_frame(frame),
+_selectionInfo(selectionInfo),
+_lookahead(lookahead),
+_pending(0u)
+{
+    _service = new TaskService("REX Prefetch", osg::maximum(numThreads, 1u));
+}
+
+Prefetcher::~Prefetcher()
+{
+    // Drop the queued requests and join the threads before the members
+    // the running requests refer to are destroyed.
+    _service->cancelAll();
+    _service = 0L;
+}
+
+void
+Prefetcher::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _requested.clear();
+}
+
+void
+Prefetcher::cull(osgUtil::CullVisitor* cv)
+{
+    const osg::Camera* camera = cv->getCurrentCamera();
+    if (!camera || camera->getReferenceFrame() == osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT)
+        return;
+
+    if (!cv->getFrameStamp() || !_frame.getProfile() || _selectionInfo.numLods() == 0)
+        return;
+
+    osg::Matrixd mvInverse;
+    mvInverse.invert(*cv->getModelViewMatrix());
+    osg::Vec3d eye = mvInverse.getTrans();
+    double time = cv->getFrameStamp()->getReferenceTime();
+
+    osg::Vec3d predicted;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        // Forget cameras that have been deleted, so the map doesn't grow
+        // and a new camera at a recycled address starts a fresh track.
+        for (std::map<const osg::Camera*, Track>::iterator i = _tracks.begin(); i != _tracks.end(); )
+        {
+            if (!i->second._camera.valid())
+                _tracks.erase(i++);
+            else
+                ++i;
+        }
+
+        // Smooth the velocity over a few frames so one jittery frame
+        // doesn't throw the prediction across the map.
+        Track& track = _tracks[camera];
+        if (!track._camera.valid())
+            track._camera = camera;
+
+        double dt = time - track._time;
+        if (track._time >= 0.0 && dt > 0.0 && dt < 1.0)
+            track._velocity = track._velocity*0.7 + ((eye - track._eye)/dt)*0.3;
+        else
+            track._velocity.set(0.0, 0.0, 0.0);
+
+        track._eye = eye;
+        track._time = time;
+
+        // Not going anywhere; the culler is already loading what's in view.
+        if (track._velocity.length() < 1.0)
+            return;
+
+        predicted = eye + track._velocity*_lookahead;
+    }
+
+    // Find the finest LOD the terrain will draw under the predicted eye:
+    GeoPoint point;
+    const Profile* profile = _frame.getProfile();
+    if (!point.fromWorld(profile->getSRS(), predicted))
+        return;
+
+    double range = osg::maximum(point.z(), 1.0);
+    unsigned lod = 0u;
+    while (lod+1u < _selectionInfo.numLods() && _selectionInfo.visParameters(lod+1u)._visibilityRange > range)
+        ++lod;
+
+    TileKey key = profile->createTileKey(point.x(), point.y(), lod);
+    if (!key.valid())
+        return;
+
+    // The tile under the eye, then its neighbors:
+    prefetch(key);
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            if (x != 0 || y != 0)
+                prefetch(key.createNeighborKey(x, y));
+        }
+    }
+}
+
+void
+Prefetcher::prefetch(const TileKey& key)
+{
+    if (!key.valid() || _pending >= MAX_PENDING)
+        return;
+
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if (_requested.size() >= MAX_REQUESTED)
+            _requested.clear();
+        if (!_requested.insert(key).second)
+            return;
+    }
+
+    PrefetchTile* task = new PrefetchTile();
+    task->_key = key;
+    task->_pending = &_pending;
+    _frame.getLayers(task->_imageLayers);
+    _frame.getLayers(task->_elevationLayers);
+
+    // Finer tiles are more likely to pop, so fetch them first.
+    task->setPriority((float)key.getLOD());
+
+    ++_pending;
+    _service->add(task);
+}
@@ -1,6 +1,8 @@
 #version 330
 #pragma vp_name Rex Terrain SDK
 
+#pragma import_defines(OE_TERRAIN_GPU_NORMALS)
+
 /**
  * SDK functions for the Rex engine.
  * Declare and call these from any shader that runs on the terrain.
@@ -62,7 +64,23 @@ float oe_terrain_getElevation()
  */
 vec4 oe_terrain_getNormalAndCurvature(in vec2 uv_scaledBiased)
 {
+#ifdef OE_TERRAIN_GPU_NORMALS
+    // The normal sampler holds the elevation texture; take central differences
+    // one texel apart. Curvature is not available and reads as flat (0.5).
+    vec2 texel = 1.0/vec2(textureSize(oe_tile_normalTex, 0));
+    float hW = texture(oe_tile_normalTex, uv_scaledBiased - vec2(texel.x, 0.0)).r;
+    float hE = texture(oe_tile_normalTex, uv_scaledBiased + vec2(texel.x, 0.0)).r;
+    float hS = texture(oe_tile_normalTex, uv_scaledBiased - vec2(0.0, texel.y)).r;
+    float hN = texture(oe_tile_normalTex, uv_scaledBiased + vec2(0.0, texel.y)).r;
+
+    // Ground distance spanned by one texel (oe_tile_key.w is the tile width):
+    float texelSize = texel.x * oe_tile_key.w / (oe_tile_elevTexelCoeff.x * oe_tile_normalTexMatrix[0][0]);
+
+    vec3 normal = normalize(vec3(hW-hE, hS-hN, 2.0*texelSize));
+    return vec4(normal*0.5+0.5, 0.5);
+#else
     return texture(oe_tile_normalTex, uv_scaledBiased);
+#endif
 }
 
 vec4 oe_terrain_getNormalAndCurvature()
@@ -72,7 +90,7 @@ vec4 oe_terrain_getNormalAndCurvature()
         + oe_tile_elevTexelCoeff.x * oe_tile_normalTexMatrix[3].st
         + oe_tile_elevTexelCoeff.y;
 
-    return texture(oe_tile_normalTex, uv_scaledBiased);
+    return oe_terrain_getNormalAndCurvature(uv_scaledBiased);
 }
 
 /**
@@ -5,7 +5,7 @@
 #pragma vp_location   fragment_coloring
 #pragma vp_order      0.5
 
-#pragma import_defines(OE_TERRAIN_RENDER_IMAGERY, OE_TERRAIN_MORPH_IMAGERY, OE_TERRAIN_BLEND_IMAGERY, OE_IS_PICK_CAMERA)
+#pragma import_defines(OE_TERRAIN_RENDER_IMAGERY, OE_TERRAIN_MORPH_IMAGERY, OE_TERRAIN_BLEND_IMAGERY, OE_IS_PICK_CAMERA, OE_TERRAIN_TEXTURE_ARRAYS)
 
 uniform sampler2D oe_layer_tex;
 uniform int       oe_layer_uid;
@@ -19,6 +19,13 @@ in vec4 oe_layer_texcParent;
 in float oe_rex_morphFactor;
 #endif
 
+#ifdef OE_TERRAIN_TEXTURE_ARRAYS
+// tile textures kept in a per-layer array; index < 0 means use the plain sampler
+uniform sampler2DArray oe_layer_texArray;
+uniform int oe_layer_texIndex;
+uniform int oe_layer_texParentIndex;
+#endif
+
 in vec4 oe_layer_texc;
 in vec4 oe_layer_tilec;
 
@@ -35,12 +42,24 @@ void oe_rexEngine_frag(inout vec4 color)
 #endif
 
     float applyImagery = oe_layer_uid >= 0 ? 1.0 : 0.0;
+#ifdef OE_TERRAIN_TEXTURE_ARRAYS
+	vec4 texelSelf = oe_layer_texIndex >= 0 ?
+        texture(oe_layer_texArray, vec3(oe_layer_texc.st, float(oe_layer_texIndex))) :
+        texture(oe_layer_tex, oe_layer_texc.st);
+#else
 	vec4 texelSelf = texture(oe_layer_tex, oe_layer_texc.st);
+#endif
 
 #ifdef OE_TERRAIN_MORPH_IMAGERY
 
     // sample the parent texture:
+#ifdef OE_TERRAIN_TEXTURE_ARRAYS
+	vec4 texelParent = oe_layer_texParentIndex >= 0 ?
+        texture(oe_layer_texArray, vec3(oe_layer_texcParent.st, float(oe_layer_texParentIndex))) :
+        texture(oe_layer_texParent, oe_layer_texcParent.st);
+#else
 	vec4 texelParent = texture(oe_layer_texParent, oe_layer_texcParent.st);
+#endif
 
     // if the parent texture does not exist, use the current texture with alpha=0 as the parent
     // so we can "fade in" an image layer that starts at LOD > 0:
@@ -23,6 +23,7 @@
 
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/ShaderFactory>
 #include <osgEarth/Capabilities>
 #include <osgEarth/VirtualProgram>
 #include <osgEarth/MapModelChange>
@@ -30,6 +31,7 @@
 #include <osgEarth/ShaderLoader>
 #include <osgEarth/Utils>
 #include <osgEarth/ObjectIndex>
+#include <osgEarth/TraversalData>
 
 #include <osg/Version>
 #include <osg/BlendFunc>
@@ -37,6 +39,7 @@
 #include <osg/CullFace>
 
 #include <cstdlib> // for getenv
+#include <climits>
 
 #define LC "[RexTerrainEngineNode] "
 
@@ -124,10 +127,9 @@ namespace
                 tileNode.setDirty(true);
             }
 
-            if (!_layersToLoad.empty())
+            else if (!_layersToLoad.empty())
             {
-                tileNode.newLayers().insert(_layersToLoad.begin(), _layersToLoad.end());
-                tileNode.setDirty(true);
+                tileNode.loadLayers(_layersToLoad);
             }
         }
     };
@@ -143,7 +145,8 @@ _tileCount            ( 0 ),
 _tileCreationTime     ( 0.0 ),
 _batchUpdateInProgress( false ),
 _refreshRequired      ( false ),
-_stateUpdateRequired  ( false )
+_stateUpdateRequired  ( false ),
+_cullSplitLOD         ( -1 )
 {
     // Necessary for pager object data
     this->setName("osgEarth.RexTerrainEngineNode");
@@ -253,6 +256,8 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
 
     // A resource releaser that will call releaseGLObjects() on expired objects.
     _releaser = new ResourceReleaser();
+    _releaser->setTimeBudget( _terrainOptions.releaseBudget().get() );
+    _releaser->setMaxObjectsPerFrame( _terrainOptions.releasesPerFrame().get() );
     this->addChild(_releaser.get());
 
     // A shared geometry pool.
@@ -261,9 +266,44 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     this->addChild( _geometryPool.get() );
 
     // Make a tile loader
-    PagerLoader* loader = new PagerLoader( this );
+    LoaderGroup* loader;
+    if ( _terrainOptions.loaderThreads().get() > 0u )
+    {
+        ThreadedLoader* threaded = new ThreadedLoader( _terrainOptions.loaderThreads().get() );
+        threaded->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+        threaded->setMergeBudget( _terrainOptions.mergeBudget().get() );
+        loader = threaded;
+    }
+    else
+    {
+        PagerLoader* pager = new PagerLoader( this );
+        pager->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
+        pager->setMergeBudget( _terrainOptions.mergeBudget().get() );
+        loader = pager;
+    }
+
+    // Optionally measure the GPU time of each layer
+    if ( _terrainOptions.gpuTimers() == true )
+    {
+        _gpuTimers = new GPUTimers();
+    }
+
+    // Optionally compile tile textures ahead of merging, on a time budget
+    // and/or through a ring of PBOs
+    if ( _terrainOptions.compileBudget().get() > 0.0f || _terrainOptions.uploadBuffers().get() > 0u )
+    {
+        _compileQueue = new GLCompileQueue();
+        _compileQueue->setBudget( _terrainOptions.compileBudget().get() );
+        if ( _terrainOptions.uploadBuffers().get() > 0u )
+        {
+            _compileQueue->setUploadRing( new PixelBufferRing(_terrainOptions.uploadBuffers().get()) );
+        }
+        _compileQueue->setTimers( _gpuTimers.get() );
+        loader->setCompileQueue( _compileQueue.get() );
+        this->addChild( _compileQueue.get() );
+    }
+
     loader->setNumLODs(_terrainOptions.maxLOD().getOrUse(DEFAULT_MAX_LOD));
-    loader->setMergesPerFrame( _terrainOptions.mergesPerFrame().get() );
     for (std::vector<RexTerrainEngineOptions::LODOptions>::const_iterator i = _terrainOptions.lods().begin(); i != _terrainOptions.lods().end(); ++i) {
         if (i->_lod.isSet()) {
             loader->setLODPriorityScale(i->_lod.get(), i->_priorityScale.getOrUse(1.0f));
@@ -277,6 +317,7 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
     // Make a tile unloader
     _unloader = new UnloaderGroup( _liveTiles.get() );
     _unloader->setThreshold( _terrainOptions.expirationThreshold().get() );
+    _unloader->setMemoryBudget( _terrainOptions.memoryBudget().get() );
     _unloader->setReleaser(_releaser.get());
     this->addChild( _unloader.get() );
 
@@ -329,6 +370,40 @@ RexTerrainEngineNode::setMap(const Map* map, const TerrainOptions& options)
         _mapFrame.getMapInfo().getProfile(),        
         _terrainOptions.minTileRangeFactor().get() );
 
+    // Optionally build the pooled tile geometry up front:
+    if ( _terrainOptions.poolPrebuildLOD().isSet() )
+    {
+        _geometryPool->prebuild(
+            _mapFrame.getMapInfo(),
+            std::min(_terrainOptions.poolPrebuildLOD().get(), maxLOD) );
+    }
+
+    // Optionally cull the terrain with a pool of worker threads. Split the quadtree
+    // at the first LOD with enough tiles to keep all the threads busy.
+    if ( _terrainOptions.cullThreads().isSet() && _terrainOptions.cullThreads().get() > 0u )
+    {
+        unsigned numThreads = _terrainOptions.cullThreads().get();
+        _cullService = new TaskService("REX Cull", numThreads);
+
+        const Profile* profile = _mapFrame.getMapInfo().getProfile();
+        unsigned lod = _terrainOptions.firstLOD().get();
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        while ( tx*ty < 4u*numThreads && lod < maxLOD )
+        {
+            profile->getNumTiles(++lod, tx, ty);
+        }
+        _cullSplitLOD = (int)lod;
+
+        OE_INFO << LC << "Culling with " << numThreads << " threads from LOD " << lod << "\n";
+    }
+
+    // Optionally warm the layer caches ahead of moving cameras:
+    if ( _terrainOptions.prefetchTime().get() > 0.0f )
+    {
+        _prefetcher = new Prefetcher(_mapFrame, _selectionInfo, _terrainOptions.prefetchTime().get(), 2u);
+    }
+
     // set up the initial graph
     refresh();
 
@@ -382,6 +457,54 @@ RexTerrainEngineNode::getSurfaceStateSet()
     return _imageLayerStateSet.get();
 }
 
+void
+RexTerrainEngineNode::addShaderWarmUpStates(const ShaderWarmUp::StatePath& prefix, ShaderWarmUp& warmUp)
+{
+    // Same state stack as cull_traverse() builds for each layer drawable.
+    ShaderWarmUp::StatePath path = prefix;
+    if (getStateSet())
+        path.push_back(getStateSet());
+    if (_terrain)
+        path.push_back(_terrain->getOrCreateStateSet());
+
+    ShaderWarmUp::StatePath surfacePath = path;
+    surfacePath.push_back(getSurfaceStateSet());
+
+    // the "blank" layer drawn where there's no imagery
+    osg::ref_ptr<osg::StateSet> blank = new osg::StateSet();
+    blank->setDefine("OE_TERRAIN_RENDER_IMAGERY", osg::StateAttribute::OFF);
+    surfacePath.push_back(blank.get());
+    warmUp.add(surfacePath);
+    surfacePath.pop_back();
+
+    LayerVector layers;
+    getMap()->getLayers(layers);
+    for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
+    {
+        Layer* layer = i->get();
+        const VisibleLayer* visLayer = dynamic_cast<const VisibleLayer*>(layer);
+        if (!layer->getEnabled() || (visLayer && !visLayer->getVisible()) ||
+            layer->getRenderType() == Layer::RENDERTYPE_NONE || !layer->getStateSet())
+            continue;
+
+        // only tile layers draw with the surface state set
+        ShaderWarmUp::StatePath& base =
+            layer->getRenderType() == Layer::RENDERTYPE_TILE ? surfacePath : path;
+
+        base.push_back(layer->getStateSet());
+        warmUp.add(base);
+        base.pop_back();
+    }
+}
+
+bool
+RexTerrainEngineNode::normalTexturesRequired() const
+{
+    return
+        TerrainEngineNode::normalTexturesRequired() &&
+        _terrainOptions.gpuNormalMaps() == false;
+}
+
 void
 RexTerrainEngineNode::setupRenderBindings()
 {
@@ -396,6 +519,12 @@ RexTerrainEngineNode::setupRenderBindings()
     }
     _renderBindings.clear();
 
+    if (_textureArrays.valid())
+    {
+        getResources()->releaseTextureImageUnit(_textureArrays->getUnit());
+        _textureArrays = 0L;
+    }
+
     // "SHARED" is the start of shared layers, so we always want the bindings
     // vector to be at least that size.
     _renderBindings.resize(SamplerBinding::SHARED);
@@ -417,7 +546,7 @@ RexTerrainEngineNode::setupRenderBindings()
     normal.usage()       = SamplerBinding::NORMAL;
     normal.samplerName() = "oe_tile_normalTex";
     normal.matrixName()  = "oe_tile_normalTexMatrix";
-    if (this->normalTexturesRequired())
+    if (TerrainEngineNode::normalTexturesRequired())
         getResources()->reserveTextureImageUnit( normal.unit(), "Terrain Normals" );
     
     SamplerBinding& colorParent = _renderBindings[SamplerBinding::COLOR_PARENT];
@@ -426,6 +555,20 @@ RexTerrainEngineNode::setupRenderBindings()
     colorParent.matrixName()  = "oe_layer_texParentMatrix";
     if (this->parentTexturesRequired())
         getResources()->reserveTextureImageUnit( colorParent.unit(), "Terrain Color (Parent)" );
+
+    // Optional per-layer texture arrays for tile color textures:
+    if (_terrainOptions.textureArraySize().get() > 0u)
+    {
+        int unit;
+        if (!Registry::capabilities().supportsTextureArrays())
+        {
+            OE_WARN << LC << "Texture arrays are not supported; tile textures will bind individually\n";
+        }
+        else if (getResources()->reserveTextureImageUnit(unit, "Terrain Color (Array)"))
+        {
+            _textureArrays = new TileTextureArrays(_terrainOptions.textureArraySize().get(), unit);
+        }
+    }
 }
 
 void
@@ -438,6 +581,10 @@ RexTerrainEngineNode::dirtyTerrain()
 
     // clear the loader:
     _loader->clear();
+    if ( _compileQueue.valid() )
+        _compileQueue->clear();
+    if ( _prefetcher.valid() )
+        _prefetcher->clear();
 
     // clear out the tile registry:
     if ( _liveTiles.valid() )
@@ -515,6 +662,16 @@ namespace
 }
 
 
+bool
+RexTerrainEngineNode::getLayerGPUTimes(LayerGPUTimes& out) const
+{
+    if (!_gpuTimers.valid())
+        return false;
+
+    _gpuTimers->getTimes(out);
+    return true;
+}
+
 void
 RexTerrainEngineNode::dirtyState()
 {
@@ -535,6 +692,24 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
             _terrain->accept(visitor);
             _renderModelUpdateRequired = false;
         }
+
+        if (_gpuTimers.valid())
+        {
+            _gpuTimers->report(nv.getFrameStamp(), _mapFrame);
+        }
+
+        // While a layer holds back fine LODs on a slow link, fill in the
+        // view with coarse tiles before spending the link on detail.
+        bool coarseFirst = false;
+        ImageLayerVector imageLayers;
+        _mapFrame.getLayers(imageLayers);
+        for (ImageLayerVector::const_iterator i = imageLayers.begin(); i != imageLayers.end() && !coarseFirst; ++i)
+        {
+            coarseFirst = i->get()->getEnabled() && i->get()->getAdaptiveMaxLevel() != UINT_MAX;
+        }
+        if (getEngineContext())
+            getEngineContext()->setCoarseFirst(coarseFirst);
+
         TerrainEngineNode::traverse( nv );
     }
     
@@ -555,10 +730,27 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
 
         // Prepare the culler with the set of renderable layers:
         culler.setup(_mapFrame, this->getEngineContext()->getRenderBindings());
+        culler._terrain._drawState->_textureArrays = _textureArrays.get();
+        culler._terrain._drawState->_timers = _gpuTimers.get();
+
+        // Assemble the terrain drawable, culling deeper subtrees in parallel if enabled.
+        // A ComputeRangeCallback gets the one CullVisitor, which is not safe to share
+        // across threads, so its presence keeps the cull serial.
+        bool cullInParallel =
+            _cullService.valid() &&
+            getComputeRangeCallback() == 0L &&
+            !VisitorData::isSet(nv, "osgEarth.Stealth");
+        if (cullInParallel)
+            culler.setDeferLOD(_cullSplitLOD);
 
-        // Assemble the terrain drawable:
         _terrain->accept(culler);
 
+        if (cullInParallel)
+            culler.cullDeferred(_cullService.get());
+
+        if (_prefetcher.valid() && !VisitorData::isSet(nv, "osgEarth.Stealth"))
+            _prefetcher->cull(cv);
+
         // If we're using geometry pooling, optimize the drawable for shared state:
         if (getEngineContext()->getGeometryPool()->isEnabled())
         {
@@ -646,6 +838,8 @@ RexTerrainEngineNode::traverse(osg::NodeVisitor& nv)
         _loader->accept(nv);
         _unloader->accept(nv);
         _releaser->accept(nv);
+        if ( _compileQueue.valid() )
+            _compileQueue->accept(nv);
         _rasterizer->accept(nv);
     }
 
@@ -912,16 +1106,12 @@ RexTerrainEngineNode::addTileLayer(Layer* tileLayer)
 
         if (_terrain)
         {
-            // Update the existing render models, and trigger a data reload.
-            // Later we can limit the reload to an update of only the new data.
+            // Update the existing render models, and load the new layer's data
+            // into each tile in the background. Other layers' textures, and the
+            // tile geometry, stay as they are. (Tiles that don't load the layer
+            // at their own LOD inherit it when their ancestors merge it.)
             UpdateRenderModels updateModels(_mapFrame);
 
-#if 0
-            // This uses the loaddata filter approach which will only request
-            // data for one layer. It mostly works but not 100%; see hires-insets
-            // as an example. Removing the world layer and re-adding it while
-            // zoomed in doesn't result in all tiles reloading. Possibly a
-            // synchronization issue.
             ImageLayerVector imageLayers;
             _mapFrame.getLayers(imageLayers);
 
@@ -929,9 +1119,6 @@ RexTerrainEngineNode::addTileLayer(Layer* tileLayer)
                 updateModels.setReloadData(true);
             else
                 updateModels.layersToLoad().insert(tileLayer->getUID());
-#else
-            updateModels.setReloadData(true);
-#endif
 
             _terrain->accept(updateModels);
         }
@@ -1096,13 +1283,20 @@ RexTerrainEngineNode::updateState()
             }
 
             // Normal mapping shaders:
-            if ( this->normalTexturesRequired() )
+            if ( TerrainEngineNode::normalTexturesRequired() )
             {
                 package.load(surfaceVP, package.NORMAL_MAP_VERT);
                 package.load(surfaceVP, package.NORMAL_MAP_FRAG);
                 surfaceStateSet->setDefine("OE_TERRAIN_RENDER_NORMAL_MAP");
             }
 
+            // The normal sampler holds the elevation texture and the SDK
+            // derives normals from it:
+            if ( _terrainOptions.gpuNormalMaps() == true )
+                terrainStateSet->setDefine("OE_TERRAIN_GPU_NORMALS");
+            else
+                terrainStateSet->removeDefine("OE_TERRAIN_GPU_NORMALS");
+
             // Morphing?
             if (_terrainOptions.morphTerrain() == true ||
                 _terrainOptions.morphImagery() == true)
@@ -1147,21 +1341,27 @@ RexTerrainEngineNode::updateState()
                     ImageLayer* layer = imageLayers.at(i);
                     if ( layer->getEnabled() )
                     {
-                        // install Color Filter function calls:
+                        // install Color Filter function calls. Filters the layer bakes into
+                        // its tiles are skipped, and the rest are fused into one block.
                         const ColorFilterChain& chain = layer->getColorFilters();
-                        if ( chain.size() > 0 )
+                        unsigned first = layer->getNumBakedColorFilters();
+                        if ( chain.size() > first )
                         {
                             haveColorFilters = true;
                             if ( ifStarted ) cf_body << I << "else if ";
                             else             cf_body << I << "if ";
                             cf_body << "(oe_layer_uid == " << layer->getUID() << ") {\n";
-                            for( ColorFilterChain::const_iterator j = chain.begin(); j != chain.end(); ++j )
+                            for( unsigned j = first; j < chain.size(); ++j )
                             {
-                                const ColorFilter* filter = j->get();
-                                cf_head << "void " << filter->getEntryPointFunctionName() << "(inout vec4 color);\n";
-                                cf_body << I << I << filter->getEntryPointFunctionName() << "(color);\n";
+                                const ColorFilter* filter = chain[j].get();
                                 filter->install( surfaceStateSet );
+
+                                // inlined filters don't need their entry point shader.
+                                std::string decl, statements;
+                                if ( filter->getInlineCode(decl, statements) )
+                                    surfaceVP->removeShader( filter->getEntryPointFunctionName() );
                             }
+                            Registry::shaderFactory()->writeColorFilterChain( chain, first, cf_head, cf_body, std::string(I) + I );
                             cf_body << I << "}\n";
                             ifStarted = true;
                         }
@@ -1200,6 +1400,16 @@ RexTerrainEngineNode::updateState()
                 }
             }
 
+            // Sampler and default slice indices for the tile texture arrays:
+            if (_textureArrays.valid())
+            {
+                terrainStateSet->setDefine("OE_TERRAIN_TEXTURE_ARRAYS");
+                terrainStateSet->addUniform( new osg::Uniform("oe_layer_texArray", _textureArrays->getUnit()) );
+                terrainStateSet->addUniform( new osg::Uniform("oe_layer_texIndex", (int)-1) );
+                terrainStateSet->addUniform( new osg::Uniform("oe_layer_texParentIndex", (int)-1) );
+                OE_DEBUG << LC << " > Bound \"oe_layer_texArray\" to unit " << _textureArrays->getUnit() << "\n";
+            }
+
             // uniform that controls per-layer opacity
             terrainStateSet->addUniform( new osg::Uniform("oe_layer_opacity", 1.0f) );
 
@@ -177,48 +177,51 @@ HorizonTileCuller::set(const SpatialReference* srs,
                        const osg::Matrix&      local2world,
                        const osg::BoundingBox& bbox)
 {
-    if (!_horizon.valid() && srs->isGeographic())
-    {
-        _horizon = new Horizon();
-    }
+    _valid = false;
 
-    if (_horizon.valid())
+    if (srs->isGeographic())
     {
-        _horizon->setEllipsoid(*srs->getEllipsoid());
-
         // Adjust the horizon ellipsoid based on the minimum Z value of the tile;
         // necessary because a tile that's below the ellipsoid (ocean floor, e.g.)
         // may be visible even if it doesn't pass the horizon-cone test. In such
         // cases we need a more conservative ellipsoid.
         double zMin = (double)std::min( bbox.corner(0).z(), 0.0f );
         zMin = std::max(zMin, -25000.0); // approx the lowest point on earth * 2
-        _horizon->setEllipsoid( osg::EllipsoidModel(
+        osg::EllipsoidModel em(
             srs->getEllipsoid()->getRadiusEquator() + zMin, 
-            srs->getEllipsoid()->getRadiusPolar() + zMin) );
+            srs->getEllipsoid()->getRadiusPolar() + zMin);
+
+        _scale.set(
+            1.0 / em.getRadiusEquator(),
+            1.0 / em.getRadiusEquator(),
+            1.0 / em.getRadiusPolar() );
 
-        // consider the uppermost 4 points of the tile-aligned bounding box.
-        // (the last four corners of the bbox are the "zmax" corners.)
-        for(unsigned i=0; i<4; ++i)
+        // one point stands in for all the corners of the tile-aligned box.
+        osg::Vec3d points[8];
+        for(unsigned i=0; i<8; ++i)
         {
-            _points[i] = bbox.corner(4+i) * local2world;
+            points[i] = bbox.corner(i) * local2world;
         }
+
+        _valid = Horizon::computeOcclusionPoint(em, points, 8, _occluder);
     }
 }
 
 bool
 HorizonTileCuller::isVisible(const osg::Vec3d& from) const
 {
-    if (!_horizon.valid())
+    if (!_valid)
         return true;
 
-    // alternate method (slower)
-    //return _horizon->isVisible(from, _bs.center(), _bs.radius());
-
-    for (unsigned i = 0; i < 4; ++i)
-        if (_horizon->isVisible(from, _points[i], 0.0))
-            return true;
+    // Like Horizon, treat an eyepoint below the minimum HAE (500m) as if it
+    // were at that height, so there's always a horizon to test against.
+    osg::Vec3d eye = osg::componentMultiply(from, _scale);
+    double minMag = 1.0 + 500.0*_scale.z();
+    double mag = eye.length();
+    if (mag < minMag && mag > 0.0)
+        eye *= minMag/mag;
 
-    return false;
+    return Horizon::isOcclusionPointVisible(eye, _occluder);
 }
 
 //..............................................................
@@ -247,6 +250,7 @@ SurfaceNode::SurfaceNode(const TileKey&        tilekey,
     setMatrix( local2world );
     
     // Initialize the cached bounding box.
+    _childBoxRevision = 0;
     setElevationRaster( 0L, osg::Matrixf::identity() );
 }
 
@@ -342,6 +346,8 @@ SurfaceNode::setElevationRaster(const osg::Image*   raster,
     _childrenCorners[3][6] =  maxZMedians[2];
     _childrenCorners[3][7] =  box.corner(7);
 
+    ++_childBoxRevision;
+
     // Transform the child corners to world space
     
     const osg::Matrix& local2world = getMatrix();
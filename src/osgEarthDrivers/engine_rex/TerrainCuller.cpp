@@ -24,6 +24,24 @@
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
+namespace
+{
+    // Culls a contiguous range of deferred subtrees with a private culler.
+    struct CullSubtrees
+    {
+        TerrainCuller* _culler;
+        std::vector<TileNode*>::const_iterator _begin, _end;
+
+        void execute()
+        {
+            for (std::vector<TileNode*>::const_iterator i = _begin; i != _end; ++i)
+            {
+                (*i)->accept(*_culler);
+            }
+        }
+    };
+}
+
 
 TerrainCuller::TerrainCuller(osgUtil::CullVisitor* cullVisitor, EngineContext* context) :
 _frame(0L),
@@ -31,7 +49,8 @@ _camera(0L),
 _currentTileNode(0L),
 _orphanedPassesDetected(0u),
 _cv(cullVisitor),
-_context(context)
+_context(context),
+_deferLOD(-1)
 {
     setVisitorType(CULL_VISITOR);
     setTraversalMode(TRAVERSE_ALL_CHILDREN);
@@ -48,10 +67,52 @@ _context(context)
 void
 TerrainCuller::setup(const MapFrame& frame, const RenderBindings& bindings)
 {
+    _frame = &frame;
     unsigned frameNum = getFrameStamp() ? getFrameStamp()->getFrameNumber() : 0u;
     _terrain.setup(frame, bindings, frameNum, *this, _camera);
 }
 
+void
+TerrainCuller::cullDeferred(TaskService* service)
+{
+    if (_deferred.empty() || !_frame)
+        return;
+
+    // A few ranges per thread, so one busy subtree near the eye does not
+    // hold up the others:
+    unsigned numTasks = osg::minimum((unsigned)_deferred.size(), 4u * (unsigned)service->getNumThreads());
+
+    // Set up the workers here; setup() is not safe to run concurrently.
+    std::vector< osg::ref_ptr<TerrainCuller> > workers(numTasks);
+    Threading::MultiEvent semaphore(numTasks);
+
+    for (unsigned t = 0; t < numTasks; ++t)
+    {
+        TerrainCuller* worker = new TerrainCuller(_cv, _context);
+        worker->setup(*_frame, _context->getRenderBindings());
+        worker->_terrain._drawState->_textureArrays = _terrain._drawState->_textureArrays;
+        worker->_terrain._drawState->_timers = _terrain._drawState->_timers;
+        workers[t] = worker;
+
+        ParallelTask<CullSubtrees>* task = new ParallelTask<CullSubtrees>(&semaphore);
+        task->_culler = worker;
+        task->_begin  = _deferred.begin() + (t * _deferred.size()) / numTasks;
+        task->_end    = _deferred.begin() + ((t + 1) * _deferred.size()) / numTasks;
+        service->add(task);
+    }
+
+    semaphore.wait();
+
+    // Merge in task order, which preserves the serial traversal order.
+    for (unsigned t = 0; t < numTasks; ++t)
+    {
+        _terrain.merge(workers[t]->_terrain);
+        _orphanedPassesDetected += workers[t]->_orphanedPassesDetected;
+    }
+
+    _deferred.clear();
+}
+
 float
 TerrainCuller::getDistanceToViewPoint(const osg::Vec3& pos, bool withLODScale) const
 {
@@ -134,6 +195,12 @@ TerrainCuller::apply(osg::Node& node)
     TileNode* tileNode = dynamic_cast<TileNode*>(&node);
     if (tileNode)
     {
+        if (_deferLOD >= 0 && (int)tileNode->getKey().getLOD() == _deferLOD)
+        {
+            _deferred.push_back(tileNode);
+            return;
+        }
+
         _currentTileNode = tileNode;
         _currentTileDrawCommands = 0u;
         
@@ -144,6 +211,11 @@ TerrainCuller::apply(osg::Node& node)
             TileRenderModel& renderModel = _currentTileNode->renderModel();
 
             bool pushedMatrix = false;
+
+            // Closest possible range to any point in the tile, for range culling.
+            // (Compute it before pushing the surface matrix, in world space.)
+            const osg::BoundingSphere& tileBound = tileNode->getSurfaceNode()->getBound();
+            float minTileRange = osg::maximum(getDistanceToViewPoint(tileBound.center(), false) - tileBound.radius(), 0.0f);
             
             for (PatchLayerVector::const_iterator i = _terrain.patchLayers().begin(); i != _terrain.patchLayers().end(); ++i)
             {
@@ -151,6 +223,10 @@ TerrainCuller::apply(osg::Node& node)
                 if (layer->getAcceptCallback() == 0L ||
                     layer->getAcceptCallback()->acceptKey(_currentTileNode->getKey()))
                 {
+                    // Skip the tile if it's entirely beyond the layer's range.
+                    if (minTileRange > layer->getMaxRange())
+                        continue;
+
                     // Push this tile's matrix if we haven't already done so:
                     if (!pushedMatrix)
                     {
@@ -35,6 +35,30 @@ TerrainRenderData::sortDrawCommands()
     }
 }
 
+void
+TerrainRenderData::merge(TerrainRenderData& rhs)
+{
+    for (LayerDrawableList::iterator i = rhs._layerList.begin(); i != rhs._layerList.end(); ++i)
+    {
+        LayerDrawable* source = i->get();
+        if (source->_tiles.empty())
+            continue;
+
+        UID uid = source->_layer ? source->_layer->getUID() : -1;
+        LayerDrawableMap::iterator target = _layerMap.find(uid);
+        if (target != _layerMap.end() && target->second.valid())
+        {
+            target->second->_tiles.splice(target->second->_tiles.end(), source->_tiles);
+        }
+    }
+
+    if (rhs._drawState.valid() && rhs._drawState->_bs.valid())
+    {
+        _drawState->_bs.expandBy(rhs._drawState->_bs);
+        _drawState->_box.expandBy(_drawState->_bs);
+    }
+}
+
 void
 TerrainRenderData::setup(const MapFrame& frame, const RenderBindings& bindings,
                          unsigned frameNum, osg::NodeVisitor& nv, const osg::Camera* camera)
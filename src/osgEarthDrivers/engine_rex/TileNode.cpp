@@ -66,6 +66,8 @@ namespace
 
 TileNode::TileNode() : 
 _dirty        ( false ),
+_reloadPending( false ),
+_loadIssued   ( false ),
 _childrenReady( false ),
 _minExpiryTime( 0.0 ),
 _minExpiryFrames( 0 ),
@@ -93,7 +95,9 @@ TileNode::create(const TileKey& key, TileNode* parent, EngineContext* context)
     _loadRequest->setTileKey( _key );
 
     // whether the stitch together normal maps for adjacent tiles.
-    _stitchNormalMap = context->_options.normalizeEdges() == true;
+    _stitchNormalMap =
+        context->_options.normalizeEdges() == true &&
+        context->_options.gpuNormalMaps() == false;
 
     // Encode the tile key in a uniform. Note! The X and Y components are presented
     // modulo 2^16 form so they don't overrun single-precision space.
@@ -200,6 +204,9 @@ TileNode::create(const TileKey& key, TileNode* parent, EngineContext* context)
                 setElevation = true;
             }
         }
+
+        // Until finer elevation data exists, keep sampling the parent's texture.
+        _loadRequest->setElevationInherited(setElevation);
     }
 
     // need to recompute the bounds after adding payload:
@@ -274,15 +281,34 @@ TileNode::getElevationMatrix() const
 void
 TileNode::setDirty(bool value)
 {
-    _dirty = value;
-    
-    if (_dirty == false && !_newLayers.empty())
+    if (value)
     {
-        _loadRequest->filter().clear();
-        _loadRequest->filter().layers() = _newLayers;
-        _newLayers.clear();
+        // A full reload covers any layers still waiting to load. It only
+        // becomes the request's filter when the load is issued (see load()),
+        // so a load already in flight keeps the filter it started with.
+        _reloadPending = true;
+        _pendingLayers.clear();
         _dirty = true;
     }
+    else
+    {
+        // A load was merged. Stay dirty if more was asked for while it ran.
+        _loadIssued = false;
+        _dirty = _reloadPending || !_pendingLayers.empty();
+    }
+}
+
+void
+TileNode::loadLayers(const std::set<UID>& layers)
+{
+    if (layers.empty())
+        return;
+
+    // a pending full reload will include the new layers.
+    if (!_reloadPending)
+        _pendingLayers.insert(layers.begin(), layers.end());
+
+    _dirty = true;
 }
 
 void
@@ -326,6 +352,11 @@ TileNode::shouldSubDivide(TerrainCuller* culler, const SelectionInfo& selectionI
         float range = (float)selectionInfo.visParameters(currLOD+1)._visibilityRange2;
         if (currLOD < selectionInfo.numLods() && currLOD != selectionInfo.numLods()-1)
         {
+            if (context->getOptions().frameCoherentLOD() == true)
+            {
+                return shouldSubDivideCoherent(culler, range);
+            }
+
             return _surface->anyChildBoxIntersectsSphere(
                 culler->getViewPointLocal(), 
                 range,
@@ -335,6 +366,60 @@ TileNode::shouldSubDivide(TerrainCuller* culler, const SelectionInfo& selectionI
     return false;
 }
 
+bool
+TileNode::shouldSubDivideCoherent(TerrainCuller* culler, float range2)
+{
+    const osg::Vec3& eye = culler->getViewPointLocal();
+    float lodScale = culler->getLODScale();
+
+    // Only the owning camera may touch the cache; an inherit-viewpoint camera
+    // never claims it since it doesn't drive subdivision.
+    osg::Camera* camera = culler->getCamera();
+    bool owner =
+        camera != 0L &&
+        (_subdivision._owner.get() == camera ||
+         (camera->getReferenceFrame() != osg::Camera::ABSOLUTE_RF_INHERIT_VIEWPOINT &&
+          _subdivision._owner.assign(camera, 0L)));
+
+    if (!owner)
+    {
+        return _surface->anyChildBoxIntersectsSphere(eye, range2, lodScale);
+    }
+
+    unsigned revision = _surface->getChildBoxRevision();
+
+    bool sameView =
+        _subdivision._lodScale == lodScale &&
+        _subdivision._revision == revision;
+
+    // The nearest-corner distance can change no faster than the eye moves,
+    // so the last decision holds while the eye stays within the slack.
+    if (sameView && (eye - _subdivision._eye).length2() < _subdivision._slack2)
+    {
+        return _subdivision._result;
+    }
+
+    float distance = sqrtf(_surface->getChildBoxDistance2(eye)) * lodScale;
+    float range = sqrtf(range2);
+
+    // Once subdivided, stay that way until the camera backs away past the
+    // hysteresis band, so tiles near the threshold don't flip every frame.
+    float hysteresis = osg::maximum(culler->getEngineContext()->getOptions().lodHysteresis().get(), 0.0f);
+    float threshold = sameView && _subdivision._result ? range*(1.0f+hysteresis) : range;
+    bool result = distance < threshold;
+
+    float nextThreshold = result ? range*(1.0f+hysteresis) : range;
+    float slack = lodScale > 0.0f ? fabs(distance - nextThreshold) / lodScale : 0.0f;
+
+    _subdivision._eye = eye;
+    _subdivision._lodScale = lodScale;
+    _subdivision._revision = revision;
+    _subdivision._slack2 = slack*slack;
+    _subdivision._result = result;
+
+    return result;
+}
+
 bool
 TileNode::cull_stealth(TerrainCuller* culler)
 {
@@ -455,6 +540,12 @@ TileNode::cull(TerrainCuller* culler)
     // Run any patch callbacks.
     //context->invokeTilePatchCallbacks(cv, getTileKey(), _payloadStateSet.get(), _patch.get() );
 
+    // Ask again for layers that held back data on a slow link.
+    if ( !_dirty && canLoadData && !_heldBackLayers.empty() )
+    {
+        reloadHeldBackLayers();
+    }
+
     // If this tile is marked dirty, try loading data.
     if ( _dirty && canLoadData )
     {
@@ -631,6 +722,12 @@ TileNode::merge(const TerrainTileModel* model, const RenderBindings& bindings)
 
         setElevationRaster(tex->getImage(0), osg::Matrixf::identity());
 
+        // Normals derived on the GPU sample the elevation texture through the normal binding.
+        if (_context->getOptions().gpuNormalMaps() == true && bindings[SamplerBinding::NORMAL].isActive())
+        {
+            _renderModel._sharedSamplers[SamplerBinding::NORMAL] = _renderModel._sharedSamplers[SamplerBinding::ELEVATION];
+        }
+
         newElevationData = true;
     } 
 
@@ -848,6 +945,45 @@ TileNode::refreshInheritedData(TileNode* parent, const RenderBindings& bindings)
     }
 }
 
+void
+TileNode::setHeldBackLayers(const ImageLayerVector& layers, const CreateTileModelFilter& loaded)
+{
+    for (unsigned i = 0; i < _heldBackLayers.size(); )
+    {
+        osg::ref_ptr<ImageLayer> layer;
+        if (!_heldBackLayers[i].lock(layer) || loaded.accept(layer.get()))
+        {
+            _heldBackLayers[i] = _heldBackLayers.back();
+            _heldBackLayers.pop_back();
+        }
+        else ++i;
+    }
+
+    _heldBackLayers.insert(_heldBackLayers.end(), layers.begin(), layers.end());
+}
+
+void
+TileNode::reloadHeldBackLayers()
+{
+    std::set<UID> ready;
+
+    for (unsigned i = 0; i < _heldBackLayers.size(); )
+    {
+        osg::ref_ptr<ImageLayer> layer;
+        bool gone = !_heldBackLayers[i].lock(layer);
+        if (gone || layer->getAdaptiveMaxLevel() >= _key.getLOD())
+        {
+            if (!gone)
+                ready.insert(layer->getUID());
+            _heldBackLayers[i] = _heldBackLayers.back();
+            _heldBackLayers.pop_back();
+        }
+        else ++i;
+    }
+
+    loadLayers(ready);
+}
+
 void
 TileNode::load(TerrainCuller* culler)
 {    
@@ -857,7 +993,7 @@ TileNode::load(TerrainCuller* culler)
     
     // LOD priority is in the range [0..numLods]
     float lodPriority = (float)lod;
-    if ( _context->getOptions().highResolutionFirst() == false )
+    if ( _context->getOptions().highResolutionFirst() == false || _context->getCoarseFirst() )
         lodPriority = (float)(numLods - lod);
 
     float distance = culler->getDistanceToViewPoint(getBound().center(), true);
@@ -872,6 +1008,29 @@ TileNode::load(TerrainCuller* culler)
     // normalize the composite priority to [0..1].
     //priority /= (float)(numLods+1); // GW: moved this to the PagerLoader.
 
+    // Snapshot what was asked for into the request as it's issued. Nothing
+    // touches the filter while the request is in flight. A request that went
+    // idle without being merged never ran, so widen its filter instead of
+    // replacing it.
+    if ( _loadRequest->isIdle() && (_reloadPending || !_pendingLayers.empty()) )
+    {
+        CreateTileModelFilter& filter = _loadRequest->filter();
+        if ( _reloadPending || (_loadIssued && filter.empty()) )
+        {
+            filter.clear();
+        }
+        else
+        {
+            if ( !_loadIssued )
+                filter.clear();
+            filter.layers().insert( _pendingLayers.begin(), _pendingLayers.end() );
+        }
+
+        _reloadPending = false;
+        _pendingLayers.clear();
+        _loadIssued = true;
+    }
+
     // Submit to the loader.
     _context->getLoader()->load( _loadRequest.get(), priority, *culler );
 }
@@ -879,6 +1038,10 @@ TileNode::load(TerrainCuller* culler)
 void
 TileNode::loadSync()
 {
+    // a full load, so it covers whatever was waiting.
+    _reloadPending = false;
+    _pendingLayers.clear();
+
     osg::ref_ptr<LoadTileData> loadTileData = new LoadTileData(this, _context.get());
     loadTileData->setEnableCancelation(false);
     loadTileData->invoke();
@@ -896,6 +1059,15 @@ TileNode::areSubTilesDormant(const osg::FrameStamp* fs) const
         getSubTile(3)->isDormant( fs );
 }
 
+unsigned
+TileNode::getLastSubTileTraversalFrame() const
+{
+    unsigned frame = 0u;
+    for (unsigned i = 0; i < getNumChildren() && i < 4u; ++i)
+        frame = osg::maximum(frame, (unsigned)getSubTile(i)->_lastTraversalFrame);
+    return frame;
+}
+
 void
 TileNode::removeSubTiles()
 {
@@ -0,0 +1,318 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2008-2014 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "TileTextureArray"
+
+#include <osg/Image>
+#include <osg/GLExtensions>
+#include <algorithm>
+
+using namespace osgEarth::Drivers::RexTerrainEngine;
+using namespace osgEarth;
+
+#define LC "[TileTextureArray] "
+
+
+namespace
+{
+    // Box-filters an 8-bit image down one mipmap level into a tightly packed buffer.
+    void downsample(const unsigned char* src, unsigned w, unsigned h, unsigned srcStride,
+                    unsigned comps, unsigned char* dst, unsigned dw, unsigned dh)
+    {
+        for (unsigned y = 0; y < dh; ++y)
+        {
+            const unsigned char* row0 = src + std::min(2*y,   h-1)*srcStride;
+            const unsigned char* row1 = src + std::min(2*y+1, h-1)*srcStride;
+
+            for (unsigned x = 0; x < dw; ++x)
+            {
+                unsigned x0 = std::min(2*x,   w-1)*comps;
+                unsigned x1 = std::min(2*x+1, w-1)*comps;
+
+                for (unsigned c = 0; c < comps; ++c)
+                {
+                    unsigned sum = row0[x0+c] + row0[x1+c] + row1[x0+c] + row1[x1+c];
+                    *dst++ = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    bool isMipmapFilter(osg::Texture::FilterMode mode)
+    {
+        return
+            mode == osg::Texture::LINEAR_MIPMAP_LINEAR ||
+            mode == osg::Texture::LINEAR_MIPMAP_NEAREST ||
+            mode == osg::Texture::NEAREST_MIPMAP_LINEAR ||
+            mode == osg::Texture::NEAREST_MIPMAP_NEAREST;
+    }
+}
+
+//........................................................................
+
+TileTextureArray::TileTextureArray(unsigned slices, int unit) :
+_unit       ( unit ),
+_levels     ( 1u ),
+_allocatedID( 0u )
+{
+    _slots.resize( std::max(slices, 1u) );
+}
+
+bool
+TileTextureArray::accepts(const osg::Texture* texture) const
+{
+    if ( texture->getTextureTarget() != GL_TEXTURE_2D || texture->getNumImages() != 1 )
+        return false;
+
+    const osg::Image* image = texture->getImage(0);
+    if ( !image || !image->data() || image->isCompressed() || image->r() != 1 )
+        return false;
+
+    if ( image->getDataType() != GL_UNSIGNED_BYTE )
+        return false;
+
+    if ( image->getPixelFormat() != GL_RGBA && image->getPixelFormat() != GL_RGB )
+        return false;
+
+    // once the array exists, every slice must match it:
+    if ( _array.valid() )
+    {
+        return
+            image->s() == _array->getTextureWidth() &&
+            image->t() == _array->getTextureHeight() &&
+            image->getPixelFormat() == _array->getSourceFormat();
+    }
+
+    return true;
+}
+
+void
+TileTextureArray::create(const osg::Texture* texture)
+{
+    const osg::Image* image = texture->getImage(0);
+
+    _array = new osg::Texture2DArray();
+    _array->setTextureSize( image->s(), image->t(), _slots.size() );
+    _array->setSourceFormat( image->getPixelFormat() );
+    _array->setSourceType( GL_UNSIGNED_BYTE );
+    _array->setInternalFormat( image->getPixelFormat() == GL_RGBA ? GL_RGBA8 : GL_RGB8 );
+    _array->setFilter( osg::Texture::MIN_FILTER, texture->getFilter(osg::Texture::MIN_FILTER) );
+    _array->setFilter( osg::Texture::MAG_FILTER, texture->getFilter(osg::Texture::MAG_FILTER) );
+    _array->setWrap( osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE );
+    _array->setWrap( osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE );
+    _array->setResizeNonPowerOfTwoHint( false );
+
+    _levels = 1u;
+    if ( isMipmapFilter(texture->getFilter(osg::Texture::MIN_FILTER)) )
+    {
+        for (int size = std::max(image->s(), image->t()); size > 1; size >>= 1)
+            ++_levels;
+    }
+    _array->setNumMipmapLevels( _levels );
+
+    OE_DEBUG << LC << "Created " << image->s() << "x" << image->t() << "x" << _slots.size()
+        << " array with " << _levels << " levels\n";
+}
+
+void
+TileTextureArray::allocate(osg::State& state)
+{
+    // OSG only allocates level 0 of an image-less array; allocate the rest.
+    osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    int w = _array->getTextureWidth(), h = _array->getTextureHeight();
+    for (unsigned level = 1; level < _levels; ++level)
+    {
+        w = std::max(w >> 1, 1);
+        h = std::max(h >> 1, 1);
+        ext->glTexImage3D(
+            GL_TEXTURE_2D_ARRAY_EXT, level, _array->getInternalFormat(),
+            w, h, _slots.size(), 0,
+            _array->getSourceFormat(), GL_UNSIGNED_BYTE, 0L);
+    }
+    glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAX_LEVEL, _levels-1 );
+
+    _allocatedID = _array->getTextureObject(state.getContextID())->id();
+
+    // new storage, so nothing we think is resident actually is.
+    _lookup.clear();
+    for (unsigned i = 0; i < _slots.size(); ++i)
+        _slots[i] = Slot();
+}
+
+void
+TileTextureArray::bind(osg::State& state)
+{
+    if ( !_array.valid() )
+        return;
+
+    state.setActiveTextureUnit( _unit );
+    _array->apply( state );
+
+    osg::Texture::TextureObject* to = _array->getTextureObject(state.getContextID());
+    if ( to && to->id() != _allocatedID )
+    {
+        allocate( state );
+    }
+}
+
+void
+TileTextureArray::upload(const osg::Image* image, int slice, osg::State& state)
+{
+    osg::GLExtensions* ext = state.get<osg::GLExtensions>();
+
+    unsigned comps = image->getPixelFormat() == GL_RGBA ? 4u : 3u;
+    GLenum   format = image->getPixelFormat();
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, image->getPacking() );
+    ext->glTexSubImage3D(
+        GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, slice,
+        image->s(), image->t(), 1,
+        format, GL_UNSIGNED_BYTE, image->data());
+
+    if ( _levels > 1u )
+    {
+        // build the mipmaps for this slice only; glGenerateMipmap would redo the whole array.
+        unsigned w = image->s(), h = image->t();
+        std::vector<unsigned char> src( image->data(), image->data() + image->getRowSizeInBytes()*h );
+        unsigned srcStride = image->getRowSizeInBytes();
+        std::vector<unsigned char> dst;
+
+        glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+        for (unsigned level = 1; level < _levels; ++level)
+        {
+            unsigned dw = std::max(w >> 1, 1u), dh = std::max(h >> 1, 1u);
+            dst.resize( dw*dh*comps );
+            downsample( &src[0], w, h, srcStride, comps, &dst[0], dw, dh );
+
+            ext->glTexSubImage3D(
+                GL_TEXTURE_2D_ARRAY_EXT, level, 0, 0, slice,
+                dw, dh, 1,
+                format, GL_UNSIGNED_BYTE, &dst[0]);
+
+            src.swap( dst );
+            w = dw, h = dh, srcStride = dw*comps;
+        }
+    }
+
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+}
+
+int
+TileTextureArray::getSlice(const osg::Texture* texture, osg::State& state)
+{
+    unsigned frame = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0u;
+
+    SlotMap::iterator i = _lookup.find(texture);
+    if ( i != _lookup.end() )
+    {
+        Slot& slot = _slots[i->second];
+
+        // same live texture with unchanged data: reuse the slice.
+        if ( slot._texture.get() == texture && slot._modifiedCount == texture->getImage(0)->getModifiedCount() )
+        {
+            slot._lastFrame = frame;
+            return i->second;
+        }
+
+        // stale (the texture went away and its address was reused, or its image changed)
+        _lookup.erase( i );
+        slot._texture = 0L;
+        slot._key = 0L;
+    }
+
+    if ( !accepts(texture) )
+        return -1;
+
+    if ( !_array.valid() )
+    {
+        create( texture );
+    }
+
+    bind( state );
+
+    // pick a free slice, or else the one drawn longest ago:
+    int best = -1;
+    for (unsigned s = 0; s < _slots.size(); ++s)
+    {
+        if ( !_slots[s]._texture.valid() )
+        {
+            best = s;
+            break;
+        }
+        if ( best < 0 || _slots[s]._lastFrame < _slots[best]._lastFrame )
+        {
+            best = s;
+        }
+    }
+
+    // every slice is in use this frame; the caller will bind the texture instead.
+    if ( best < 0 || (_slots[best]._texture.valid() && _slots[best]._lastFrame == frame) )
+        return -1;
+
+    Slot& slot = _slots[best];
+    if ( slot._key )
+        _lookup.erase( slot._key );
+
+    upload( texture->getImage(0), best, state );
+
+    slot._texture       = const_cast<osg::Texture*>(texture);
+    slot._key           = texture;
+    slot._modifiedCount = texture->getImage(0)->getModifiedCount();
+    slot._lastFrame     = frame;
+    _lookup[texture]    = best;
+
+    return best;
+}
+
+void
+TileTextureArray::releaseGLObjects(osg::State* state) const
+{
+    if ( _array.valid() )
+        _array->releaseGLObjects( state );
+}
+
+//........................................................................
+
+TileTextureArrays::TileTextureArrays(unsigned slices, int unit) :
+_slices( slices ),
+_unit  ( unit )
+{
+    //nop
+}
+
+TileTextureArray*
+TileTextureArrays::get(UID layerUID, unsigned contextID)
+{
+    osg::ref_ptr<TileTextureArray>& array = _arrays[contextID][layerUID];
+    if ( !array.valid() )
+        array = new TileTextureArray( _slices, _unit );
+    return array.get();
+}
+
+void
+TileTextureArrays::releaseGLObjects(osg::State* state) const
+{
+    for (unsigned c = 0; c < _arrays.size(); ++c)
+    {
+        for (ArrayMap::const_iterator i = _arrays[c].begin(); i != _arrays[c].end(); ++i)
+        {
+            i->second->releaseGLObjects( state );
+        }
+    }
+}
@@ -21,6 +21,9 @@
 #include "TileNodeRegistry"
 
 #include <osgEarth/Metrics>
+#include <osgEarth/Memory>
+
+#include <algorithm>
 
 using namespace osgEarth::Drivers::RexTerrainEngine;
 
@@ -35,11 +38,12 @@ namespace
     {
         TileNodeRegistry*      _tiles;
         unsigned               _count;
+        double                 _bytes;
 
         ResourceReleaser::ObjectList _nodes;
 
         ExpirationCollector(TileNodeRegistry* tiles)
-            : _tiles(tiles), _count(0)
+            : _tiles(tiles), _count(0), _bytes(0.0)
         {
             // set up to traverse the entire subgraph, ignoring node masks.
             setTraversalMode( TRAVERSE_ALL_CHILDREN );
@@ -55,10 +59,49 @@ namespace
                 _nodes.push_back(tn);
                 _tiles->remove( tn );
                 _count++;
+                _bytes += tn->getMemoryUsage();
             }
             traverse(node);
         }
     };
+
+    // totals the estimated memory held by all live tiles, split into
+    // resident client copies and GPU copies.
+    struct SplitMemoryTally : public TileNodeRegistry::ConstOperation
+    {
+        long long& _cpu;
+        long long& _gpu;
+
+        SplitMemoryTally(long long& cpu, long long& gpu) : _cpu(cpu), _gpu(gpu) { }
+
+        void operator()(const TileNodeRegistry::TileNodeMap& tiles) const
+        {
+            for (TileNodeRegistry::TileNodeMap::const_iterator i = tiles.begin(); i != tiles.end(); ++i)
+            {
+                unsigned cpu = 0u, gpu = 0u;
+                i->second.tile->getMemoryUsage(cpu, gpu);
+                _cpu += cpu;
+                _gpu += gpu;
+            }
+        }
+    };
+
+    // frames between reports of the tiles' memory use
+    const unsigned MEMORY_REPORT_INTERVAL = 60u;
+
+    // a parent whose subtiles can be unloaded, ordered least recently visible first
+    // and then deepest first.
+    struct Candidate
+    {
+        TileKey  _key;
+        unsigned _lastFrame;
+
+        bool operator < (const Candidate& rhs) const
+        {
+            if (_lastFrame != rhs._lastFrame) return _lastFrame < rhs._lastFrame;
+            return _key.getLOD() > rhs._key.getLOD();
+        }
+    };
 }
 
 //........................................................................
@@ -69,11 +112,46 @@ namespace
 
 UnloaderGroup::UnloaderGroup(TileNodeRegistry* tiles) :
 _tiles(tiles),
-_threshold( INT_MAX )
+_threshold( INT_MAX ),
+_memoryBudget( 0u ),
+_estimatedBytes( 0.0 ),
+_reportedCPU( 0 ),
+_reportedGPU( 0 )
 {
     this->setNumChildrenRequiringUpdateTraversal( 1u );
 }
 
+UnloaderGroup::~UnloaderGroup()
+{
+    Memory::adjustUsage( Memory::TERRAIN_TILES_CPU, -_reportedCPU );
+    Memory::adjustUsage( Memory::TERRAIN_TILES_GPU, -_reportedGPU );
+}
+
+void
+UnloaderGroup::reportMemoryUsage()
+{
+    long long cpu = 0, gpu = 0;
+    _tiles->run( SplitMemoryTally(cpu, gpu) );
+
+    // adjust rather than set, so that several terrain engines add up
+    Memory::adjustUsage( Memory::TERRAIN_TILES_CPU, cpu - _reportedCPU );
+    Memory::adjustUsage( Memory::TERRAIN_TILES_GPU, gpu - _reportedGPU );
+    _reportedCPU = cpu;
+    _reportedGPU = gpu;
+
+    // resync the running total that expireToBudget() works from, to correct
+    // any drift in the per-merge adjustments.
+    Threading::ScopedMutexLock lock( _mutex );
+    _estimatedBytes = (double)(cpu + gpu);
+}
+
+void
+UnloaderGroup::adjustMemoryUsage(double bytes)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    _estimatedBytes += bytes;
+}
+
 void
 UnloaderGroup::unloadChildren(const std::vector<TileKey>& keys)
 {
@@ -88,7 +166,16 @@ UnloaderGroup::traverse(osg::NodeVisitor& nv)
 {
     if ( nv.getVisitorType() == nv.UPDATE_VISITOR )
     {        
-        if ( _parentKeys.size() > _threshold )
+        if ( nv.getFrameStamp() && nv.getFrameStamp()->getFrameNumber() % MEMORY_REPORT_INTERVAL == 0u )
+        {
+            reportMemoryUsage();
+        }
+
+        if ( _memoryBudget > 0u )
+        {
+            expireToBudget( nv.getFrameStamp() );
+        }
+        else if ( _parentKeys.size() > _threshold )
         {
             ScopedMetric m("Unloader expire");
 
@@ -107,6 +194,7 @@ UnloaderGroup::traverse(osg::NodeVisitor& nv)
                         for(unsigned i=0; i<parentNode->getNumChildren(); ++i)
                             parentNode->getSubTile(i)->accept( collector );
                         unloaded += collector._count;
+                        _estimatedBytes -= collector._bytes;
 
                         // submit all collected nodes for GL resource release:
                         if (!collector._nodes.empty() && _releaser.valid())
@@ -126,3 +214,59 @@ UnloaderGroup::traverse(osg::NodeVisitor& nv)
     osg::Group::traverse( nv );
 }
 
+void
+UnloaderGroup::expireToBudget(const osg::FrameStamp* stamp)
+{
+    Threading::ScopedMutexLock lock( _mutex );
+
+    if ( _parentKeys.empty() )
+        return;
+
+    double& bytes = _estimatedBytes;
+
+    const double budget = (double)_memoryBudget * 1048576.0;
+    if ( bytes > budget )
+    {
+        ScopedMetric m("Unloader expire");
+
+        std::vector<Candidate> candidates;
+        candidates.reserve( _parentKeys.size() );
+        for(std::set<TileKey>::const_iterator parentKey = _parentKeys.begin(); parentKey != _parentKeys.end(); ++parentKey)
+        {
+            osg::ref_ptr<TileNode> parentNode;
+            if ( _tiles->get(*parentKey, parentNode) && parentNode->areSubTilesDormant(stamp) )
+            {
+                Candidate c;
+                c._key = *parentKey;
+                c._lastFrame = parentNode->getLastSubTileTraversalFrame();
+                candidates.push_back( c );
+            }
+        }
+
+        std::sort( candidates.begin(), candidates.end() );
+
+        unsigned unloaded = 0;
+        for(std::vector<Candidate>::const_iterator c = candidates.begin(); c != candidates.end() && bytes > budget; ++c)
+        {
+            // skip parents that went away with an earlier candidate's subtree
+            osg::ref_ptr<TileNode> parentNode;
+            if ( !_tiles->get(c->_key, parentNode) )
+                continue;
+
+            ExpirationCollector collector( _tiles );
+            for(unsigned i=0; i<parentNode->getNumChildren(); ++i)
+                parentNode->getSubTile(i)->accept( collector );
+            unloaded += collector._count;
+            bytes -= collector._bytes;
+
+            if (!collector._nodes.empty() && _releaser.valid())
+                _releaser->push(collector._nodes);
+
+            parentNode->removeSubTiles();
+        }
+
+        OE_DEBUG << LC << "Budget=" << _memoryBudget << "MB; estimated=" << (bytes/1048576.0) << "MB; candidates=" << candidates.size() << "; unloaded=" << unloaded << "\n";
+    }
+
+    _parentKeys.clear();
+}
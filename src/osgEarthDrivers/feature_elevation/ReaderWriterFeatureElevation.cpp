@@ -26,6 +26,7 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarth/URI>
 #include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Containers>
 
 #include <osgEarthFeatures/TransformFilter>
 
@@ -163,89 +164,116 @@ public:
             // We now have a feature list in feature SRS.
 
             bool transformRequired = !keySRS->isHorizEquivalentTo(featureSRS);
-		    
-			if (!featureList.empty())
-			{
+
+            // Only polygons carry an elevation; keep them in query order, since the
+            // first one containing a sample wins.
+            std::vector<Feature*> features;
+            std::vector<const osgEarth::Symbology::Polygon*> boundaries;
+            for (FeatureList::iterator f = featureList.begin(); f != featureList.end(); ++f)
+            {
+                const osgEarth::Symbology::Polygon* boundary = dynamic_cast<const osgEarth::Symbology::Polygon*>((*f)->getGeometry());
+                if (boundary)
+                {
+                    features.push_back(f->get());
+                    boundaries.push_back(boundary);
+                }
+                else
+                {
+                    OE_WARN << LC << "NOT A POLYGON" << std::endl;
+                }
+            }
+
+            if (!featureList.empty())
+            {
                 //Only allocate the heightfield if we actually intersect any features.
                 osg::ref_ptr<osg::HeightField> hf = new osg::HeightField;
                 hf->allocate(tileSize, tileSize);
                 for (unsigned int i = 0; i < hf->getHeightList().size(); ++i) hf->getHeightList()[i] = NO_DATA_VALUE;
 
-				// Iterate over the output heightfield and sample the data that was read into it.
-				double dx = (xmax - xmin) / (tileSize-1);
-				double dy = (ymax - ymin) / (tileSize-1);
-
-				for (int c = 0; c < tileSize; ++c)
-				{
-					double geoX = xmin + (dx * (double)c);
-					for (int r = 0; r < tileSize; ++r)
-					{
-						double geoY = ymin + (dy * (double)r);
-
-						float h = NO_DATA_VALUE;
-
-						for (FeatureList::iterator f = featureList.begin(); f != featureList.end(); ++f)
-						{
-							osgEarth::Symbology::Polygon* boundary = dynamic_cast<osgEarth::Symbology::Polygon*>((*f)->getGeometry());
-
-							if (!boundary)
-							{
-								OE_WARN << LC << "NOT A POLYGON" << std::endl;
-							}
-							else
-							{
-								GeoPoint geo(keySRS, geoX, geoY, 0.0, ALTMODE_ABSOLUTE);
-
-                                if ( transformRequired )
-                                    geo = geo.transform(featureSRS);
-
-								if ( boundary->contains2D(geo.x(), geo.y()) )
-								{
-                                    h = (*f)->getDouble(_options.attr().value());
-
-                                    if ( keySRS->isGeographic() )
-                                    {                              
-                                        // for a round earth, must adjust the final elevation accounting for the
-                                        // curvature of the earth; so we have to adjust it in the feature boundary's
-                                        // local tangent plane.
-                                        Bounds bounds = boundary->getBounds();
-                                        GeoPoint anchor( featureSRS, bounds.center().x(), bounds.center().y(), h, ALTMODE_ABSOLUTE );
-                                        if ( transformRequired )
-                                            anchor = anchor.transform(keySRS);
-
-                                        // For transforming between ECEF and local tangent plane:
-                                        osg::Matrix localToWorld, worldToLocal;
-                                        anchor.createLocalToWorld(localToWorld);
-                                        worldToLocal.invert( localToWorld );
-
-                                        // Get the ECEF location of the anchor point:
-                                        osg::Vec3d ecef;
-                                        geo.toWorld( ecef );
-
-                                        // Move it into Local Tangent Plane coordinates:
-                                        osg::Vec3d local = ecef * worldToLocal;
-
-                                        // Reset the Z to zero, since the LTP is centered on the "h" elevation:
-                                        local.z() = 0.0;
-
-                                        // Back into ECEF:
-                                        ecef = local * localToWorld;
-
-                                        // And back into lat/long/alt:
-                                        geo.fromWorld( geo.getSRS(), ecef);
-
-                                        h = geo.z();
-                                    }
-									break;
-								}
-							}
-						}
-
-						hf->setHeight(c, r, h + _offset);
-					}
-				}
+                // Bucket the polygons by bounds so each sample only tests the
+                // polygons that might contain it, instead of the whole list.
+                // Indices go in ascending order to preserve the first-match rule.
+                GridIndex index(
+                    extentInFeatureSRS.xMin(), extentInFeatureSRS.yMin(),
+                    extentInFeatureSRS.xMax(), extentInFeatureSRS.yMax(),
+                    std::min(tileSize, 64), std::min(tileSize, 64));
+
+                for (unsigned i = 0; i < boundaries.size(); ++i)
+                {
+                    const Bounds& b = boundaries[i]->getBounds();
+                    index.insert(i, b.xMin(), b.yMin(), b.xMax(), b.yMax());
+                }
+
+                // Per-polygon elevation and local tangent plane, set up the first
+                // time a sample lands in the polygon.
+                std::vector<PolygonElevation> elevations(boundaries.size());
+
+                // Iterate over the output heightfield and sample the data that was read into it.
+                double dx = (xmax - xmin) / (tileSize-1);
+                double dy = (ymax - ymin) / (tileSize-1);
+
+                for (int c = 0; c < tileSize; ++c)
+                {
+                    double geoX = xmin + (dx * (double)c);
+                    for (int r = 0; r < tileSize; ++r)
+                    {
+                        double geoY = ymin + (dy * (double)r);
+
+                        float h = NO_DATA_VALUE;
+
+                        GeoPoint geo(keySRS, geoX, geoY, 0.0, ALTMODE_ABSOLUTE);
+
+                        if ( transformRequired )
+                            geo = geo.transform(featureSRS);
+
+                        const std::vector<unsigned>& candidates = index.query(geo.x(), geo.y());
+                        for (unsigned i = 0; i < candidates.size(); ++i)
+                        {
+                            const osgEarth::Symbology::Polygon* boundary = boundaries[candidates[i]];
+
+                            if ( boundary->contains2D(geo.x(), geo.y()) )
+                            {
+                                PolygonElevation& pe = elevations[candidates[i]];
+                                if ( !pe._valid )
+                                {
+                                    initPolygonElevation(pe, features[candidates[i]], boundary, featureSRS, keySRS, transformRequired);
+                                }
+
+                                h = pe._h;
+
+                                if ( keySRS->isGeographic() )
+                                {
+                                    // for a round earth, must adjust the final elevation accounting for the
+                                    // curvature of the earth; so we have to adjust it in the feature boundary's
+                                    // local tangent plane.
+
+                                    // Get the ECEF location of the sample point:
+                                    osg::Vec3d ecef;
+                                    geo.toWorld( ecef );
+
+                                    // Move it into Local Tangent Plane coordinates:
+                                    osg::Vec3d local = ecef * pe._worldToLocal;
+
+                                    // Reset the Z to zero, since the LTP is centered on the "h" elevation:
+                                    local.z() = 0.0;
+
+                                    // Back into ECEF:
+                                    ecef = local * pe._localToWorld;
+
+                                    // And back into lat/long/alt:
+                                    geo.fromWorld( geo.getSRS(), ecef);
+
+                                    h = geo.z();
+                                }
+                                break;
+                            }
+                        }
+
+                        hf->setHeight(c, r, h + _offset);
+                    }
+                }
                 return hf.release();
-			}	
+            }
         }
         return 0;        
     }
@@ -257,6 +285,37 @@ public:
     }
 
 
+    // Elevation of one boundary polygon, and the local tangent plane at its
+    // center used to follow the earth's curvature in a geographic tile.
+    struct PolygonElevation
+    {
+        PolygonElevation() : _valid(false), _h(NO_DATA_VALUE) { }
+        bool        _valid;
+        float       _h;
+        osg::Matrix _localToWorld, _worldToLocal;
+    };
+
+    void initPolygonElevation(PolygonElevation& pe, const Feature* feature, const osgEarth::Symbology::Polygon* boundary,
+                              const SpatialReference* featureSRS, const SpatialReference* keySRS, bool transformRequired)
+    {
+        pe._h = feature->getDouble(_options.attr().value());
+
+        if ( keySRS->isGeographic() )
+        {
+            Bounds bounds = boundary->getBounds();
+            GeoPoint anchor( featureSRS, bounds.center().x(), bounds.center().y(), pe._h, ALTMODE_ABSOLUTE );
+            if ( transformRequired )
+                anchor = anchor.transform(keySRS);
+
+            // For transforming between ECEF and local tangent plane:
+            anchor.createLocalToWorld(pe._localToWorld);
+            pe._worldToLocal.invert( pe._localToWorld );
+        }
+
+        pe._valid = true;
+    }
+
+
 private:
 
     GeoExtent _extents;
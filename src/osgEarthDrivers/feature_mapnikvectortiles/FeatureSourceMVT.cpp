@@ -106,9 +106,7 @@ public:
             // the pointer returned from _blob gets freed internally by sqlite, supposedly
             const char* data = (const char*)sqlite3_column_blob( select, 0 );
             int dataLen = sqlite3_column_bytes( select, 0 );
-            std::string dataBuffer( data, dataLen );
-            std::stringstream in(dataBuffer);
-            MVT::read(in, key, features);
+            MVT::read(data, dataLen, key, features, _attributes.empty() ? 0L : &_attributes);
         }
         else
         {
@@ -247,6 +245,17 @@ protected:
 
         setFeatureProfile(createFeatureProfile());
 
+        if (_options.attributes().isSet())
+        {
+            StringVector names;
+            StringTokenizer(_options.attributes().get(), names, " ,", "", false, true);
+            _attributes.insert(names.begin(), names.end());
+
+            // the FID attribute always needs decoding.
+            if (!_attributes.empty() && _options.fidAttribute().isSet())
+                _attributes.insert(_options.fidAttribute().get());
+        }
+
         return Status::OK();
     }
 
@@ -281,6 +290,7 @@ private:
 private:
     const MVTFeatureOptions         _options;    
     FeatureSchema                   _schema;
+    std::set<std::string>           _attributes;
     osg::ref_ptr<osgDB::Options>    _dbOptions;    
     osg::ref_ptr<osgDB::BaseCompressor> _compressor;
     sqlite3* _database;
@@ -20,6 +20,7 @@
 #include <osgEarthFeatures/OgrUtils>
 #include <osgEarthFeatures/Feature>
 #include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
 #include <osg/Math>
 #include <algorithm>
 
@@ -33,6 +34,25 @@ using namespace osgEarth::Symbology;
 
 namespace
 {
+    // Holds the global GDAL lock only when the cursor's handles are shared.
+    struct OptionalOGRLock
+    {
+        bool _locked;
+        OptionalOGRLock(bool lock) : _locked(lock) { if (_locked) osgEarth::getGDALMutex().lock(); }
+        ~OptionalOGRLock() { if (_locked) osgEarth::getGDALMutex().unlock(); }
+    };
+
+    OGRLayerH openLayer(OGRDataSourceH ds, const std::string& layer)
+    {
+        OGRLayerH h = OGR_DS_GetLayerByName(ds, layer.c_str());
+        if ( !h )
+        {
+            unsigned index = osgEarth::as<unsigned>(layer, 0);
+            h = OGR_DS_GetLayer(ds, index);
+        }
+        return h;
+    }
+
     /**
      * Determine whether a point is valid or not.  Some shapefiles can have points that are ridiculously big, which are really invalid data
      * but shapefiles have no way of marking the data as invalid.  So instead we check for really large values that are indiciative of something being wrong.
@@ -69,12 +89,84 @@ namespace
 }
 
 
+//........................................................................
+
+OGRDataSourcePool::OGRDataSourcePool(const std::string& source, const std::string& layer, unsigned maxIdle) :
+_source ( source ),
+_layer  ( layer ),
+_maxIdle( maxIdle )
+{
+    //nop
+}
+
+OGRDataSourcePool::~OGRDataSourcePool()
+{
+    OGR_SCOPED_LOCK;
+    for(unsigned i = 0; i < _idle.size(); ++i)
+        OGRReleaseDataSource( _idle[i].first );
+    _idle.clear();
+}
+
+bool
+OGRDataSourcePool::acquire(OGRDataSourceH& out_dsHandle, OGRLayerH& out_layerHandle)
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if ( !_idle.empty() )
+        {
+            out_dsHandle    = _idle.back().first;
+            out_layerHandle = _idle.back().second;
+            _idle.pop_back();
+            return true;
+        }
+    }
+
+    // opening touches the driver registry, so do it under the global lock.
+    OGR_SCOPED_LOCK;
+    OGRSFDriverH driver = 0L;
+    out_dsHandle = OGROpen( _source.c_str(), 0, &driver );
+    if ( !out_dsHandle )
+        return false;
+
+    out_layerHandle = openLayer( out_dsHandle, _layer );
+    if ( !out_layerHandle )
+    {
+        OGRReleaseDataSource( out_dsHandle );
+        out_dsHandle = 0L;
+        return false;
+    }
+    return true;
+}
+
+void
+OGRDataSourcePool::release(OGRDataSourceH dsHandle, OGRLayerH layerHandle)
+{
+    // leave the layer ready for the next cursor.
+    OGR_L_SetSpatialFilter( layerHandle, 0L );
+    OGR_L_ResetReading( layerHandle );
+
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        if ( _idle.size() < _maxIdle )
+        {
+            _idle.push_back( std::make_pair(dsHandle, layerHandle) );
+            return;
+        }
+    }
+
+    OGR_SCOPED_LOCK;
+    OGRReleaseDataSource( dsHandle );
+}
+
+//........................................................................
+
 FeatureCursorOGR::FeatureCursorOGR(OGRDataSourceH              dsHandle,
                                    OGRLayerH                   layerHandle,
                                    const FeatureSource*        source,
                                    const FeatureProfile*       profile,
                                    const Symbology::Query&     query,
-                                   const FeatureFilterList&    filters) :
+                                   const FeatureFilterList&    filters,
+                                   OGRDataSourcePool*          pool) :
 _source           ( source ),
 _dsHandle         ( dsHandle ),
 _layerHandle      ( layerHandle ),
@@ -85,10 +177,11 @@ _chunkSize        ( 500 ),
 _nextHandleToQueue( 0L ),
 _resultSetEndReached(false),
 _profile          ( profile ),
-_filters          ( filters )
+_filters          ( filters ),
+_pool             ( pool )
 {
     {
-        OGR_SCOPED_LOCK;
+        OptionalOGRLock lock( !_pool.valid() );
 
         std::string expr;
         std::string from = OGR_FD_GetName( OGR_L_GetLayerDefn( _layerHandle ));        
@@ -170,8 +263,18 @@ _filters          ( filters )
         }
 
 
-        OE_DEBUG << LC << "SQL: " << expr << std::endl;
-        _resultSetHandle = OGR_DS_ExecuteSQL( _dsHandle, expr.c_str(), _spatialFilter, 0L );
+        if ( _pool.valid() && !_query.expression().isSet() && !_query.orderby().isSet() )
+        {
+            // A private handle can read the layer directly, letting the driver
+            // apply the spatial filter (and its spatial index) without the SQL engine.
+            OGR_L_SetSpatialFilter( _layerHandle, _spatialFilter );
+            _resultSetHandle = _layerHandle;
+        }
+        else
+        {
+            OE_DEBUG << LC << "SQL: " << expr << std::endl;
+            _resultSetHandle = OGR_DS_ExecuteSQL( _dsHandle, expr.c_str(), _spatialFilter, 0L );
+        }
 
         if ( _resultSetHandle )
         {
@@ -184,18 +287,21 @@ _filters          ( filters )
 
 FeatureCursorOGR::~FeatureCursorOGR()
 {
-    OGR_SCOPED_LOCK;
+    OptionalOGRLock lock( !_pool.valid() );
 
     if ( _nextHandleToQueue )
         OGR_F_Destroy( _nextHandleToQueue );
 
-    if ( _resultSetHandle != _layerHandle )
+    if ( _resultSetHandle && _resultSetHandle != _layerHandle )
         OGR_DS_ReleaseResultSet( _dsHandle, _resultSetHandle );
 
+    if ( _pool.valid() && _dsHandle )
+        _pool->release( _dsHandle, _layerHandle );
+
     if ( _spatialFilter )
         OGR_G_DestroyGeometry( _spatialFilter );
 
-    if ( _dsHandle )
+    if ( _dsHandle && !_pool.valid() )
         OGRReleaseDataSource( _dsHandle );
 }
 
@@ -231,7 +337,7 @@ FeatureCursorOGR::readChunk()
     if ( !_resultSetHandle )
         return;
     
-    OGR_SCOPED_LOCK;
+    OptionalOGRLock lock( !_pool.valid() );
 
     while( _queue.size() < _chunkSize && !_resultSetEndReached )
     {
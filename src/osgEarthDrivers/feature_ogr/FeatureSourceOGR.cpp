@@ -192,6 +192,11 @@ public:
 
             if (openMode == 1)
                 _writable = true;
+
+            // Read-only sources give each cursor a private handle from a pool, so
+            // queries on different threads don't serialize on the global GDAL lock.
+            if ( !_writable && _options.concurrentReads() == true )
+                _pool = new OGRDataSourcePool( _source, _options.layer().get() );
                 
             // Open a specific layer within the data source, if applicable:
             _layerHandle = openLayer(_dsHandle, _options.layer().value());
@@ -330,6 +335,24 @@ public:
             OGRDataSourceH dsHandle = 0L;
             OGRLayerH layerHandle = 0L;
 
+            if ( _pool.valid() )
+            {
+                // private handles: the cursor reads without the global lock
+                // and hands them back to the pool when it's done.
+                if ( _pool->acquire(dsHandle, layerHandle) )
+                {
+                    return new FeatureCursorOGR(
+                        dsHandle,
+                        layerHandle,
+                        this,
+                        getFeatureProfile(),
+                        query,
+                        getFilters(),
+                        _pool.get() );
+                }
+                return 0L;
+            }
+
             // open the handles safely:
             {
                 OGR_SCOPED_LOCK;
@@ -534,6 +557,7 @@ private:
     OGRDataSourceH _dsHandle;
     OGRLayerH _layerHandle;
     OGRSFDriverH _ogrDriverHandle;
+    osg::ref_ptr<OGRDataSourcePool> _pool;
     osg::ref_ptr<Symbology::Geometry> _geometry; // explicit geometry.
     const OGRFeatureOptions _options;
     int _featureCount;
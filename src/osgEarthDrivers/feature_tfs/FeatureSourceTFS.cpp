@@ -27,6 +27,7 @@
 #include <osgEarthFeatures/ScaleFilter>
 #include <osgEarthFeatures/MVT>
 #include <osgEarthFeatures/OgrUtils>
+#include <osgEarthFeatures/GeoJSONReader>
 #include <osgEarthUtil/TFS>
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
@@ -127,11 +128,26 @@ public:
     {            
         if (mimeType == "application/x-protobuf" || mimeType == "binary/octet-stream")
         {
-            std::stringstream in(buffer);
-            return MVT::read(in, key, features);
+            return MVT::read(buffer.data(), buffer.size(), key, features);
         }
         else
         {            
+            // Read GeoJSON natively, without a document tree and outside the
+            // GDAL lock. OGR remains the fallback for anything it rejects.
+            if ( isJSON(mimeType) )
+            {
+                FeatureList parsed;
+                if ( GeoJSONReader::read(buffer.data(), buffer.size(), getFeatureProfile(), parsed) )
+                {
+                    for( FeatureList::iterator i = parsed.begin(); i != parsed.end(); ++i )
+                    {
+                        if ( !isBlacklisted(i->get()->getFID()) )
+                            features.push_back( i->get() );
+                    }
+                    return true;
+                }
+            }
+
             // find the right driver for the given mime type
             OGR_SCOPED_LOCK;
 
@@ -272,34 +288,40 @@ public:
             return 0L;
 
         OE_DEBUG << LC << url << std::endl;
-        URI uri(url);
 
-        // read the data:
-        ReadResult r = uri.readString( _readOptions.get() );
+        // look for features already parsed from this tile before going
+        // to the raw response.
+        FeatureList features;
+        bool dataOK = readFeaturesFromCache( url, _readOptions.get(), features );
+
+        if ( !dataOK )
+        {
+            URI uri(url);
 
-        const std::string& buffer = r.getString();
-        const Config&      meta   = r.metadata();
+            // read the data:
+            ReadResult r = uri.readString( _readOptions.get() );
 
-        bool dataOK = false;
+            const std::string& buffer = r.getString();
 
-        FeatureList features;
-        if ( !buffer.empty() )
-        {
-            // Get the mime-type from the metadata record if possible
-            std::string mimeType = r.metadata().value( IOMetadata::CONTENT_TYPE );
-            //If the mimetype is empty then try to set it from the format specification
-            if (mimeType.empty())
+            if ( !buffer.empty() )
             {
-                if (_options.format().value() == "json") mimeType = "json";
-                else if (_options.format().value().compare("gml") == 0) mimeType = "text/xml";
-                else if (_options.format().value().compare("pbf") == 0) mimeType = "application/x-protobuf";
+                // Get the mime-type from the metadata record if possible
+                std::string mimeType = r.metadata().value( IOMetadata::CONTENT_TYPE );
+                //If the mimetype is empty then try to set it from the format specification
+                if (mimeType.empty())
+                {
+                    if (_options.format().value() == "json") mimeType = "json";
+                    else if (_options.format().value().compare("gml") == 0) mimeType = "text/xml";
+                    else if (_options.format().value().compare("pbf") == 0) mimeType = "application/x-protobuf";
+                }
+                dataOK = getFeatures( buffer, *query.tileKey(), mimeType, features );
             }
-            dataOK = getFeatures( buffer, *query.tileKey(), mimeType, features );
-        }
 
-        if ( dataOK )
-        {
-            OE_DEBUG << LC << "Read " << features.size() << " features" << std::endl;
+            if ( dataOK )
+            {
+                OE_DEBUG << LC << "Read " << features.size() << " features" << std::endl;
+                writeFeaturesToCache( url, features, _readOptions.get() );
+            }
         }
 
         //If we have any filters, process them here before the cursor is created
@@ -26,6 +26,7 @@
 #include <osgEarthFeatures/ScaleFilter>
 #include <osgEarthUtil/WFS>
 #include <osgEarthFeatures/OgrUtils>
+#include <osgEarthFeatures/GeoJSONReader>
 #include <osg/Notify>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -155,6 +156,22 @@ public:
 
     bool getFeatures( const std::string& buffer, const std::string& mimeType, FeatureList& features )
     {
+        // Read GeoJSON natively, without a document tree and outside the
+        // GDAL lock. OGR remains the fallback for anything it rejects.
+        if ( isJSON(mimeType) )
+        {
+            FeatureList parsed;
+            if ( GeoJSONReader::read(buffer.data(), buffer.size(), getFeatureProfile(), parsed) )
+            {
+                for( FeatureList::iterator i = parsed.begin(); i != parsed.end(); ++i )
+                {
+                    if ( !isBlacklisted(i->get()->getFID()) )
+                        features.push_back( i->get() );
+                }
+                return true;
+            }
+        }
+
         OGR_SCOPED_LOCK;        
 
         bool json = isJSON( mimeType );
@@ -330,27 +347,33 @@ public:
             return 0L;
 
         OE_DEBUG << LC << url << std::endl;
-        URI uri(url);
 
-        // read the data:
-        ReadResult r = uri.readString( _readOptions.get() );
+        // parsing GML/GeoJSON is the expensive part, so look for features
+        // already parsed from this request before going to the raw response.
+        FeatureList features;
+        bool dataOK = readFeaturesFromCache( url, _readOptions.get(), features );
+
+        if ( !dataOK )
+        {
+            URI uri(url);
 
-        const std::string& buffer = r.getString();
-        const Config&      meta   = r.metadata();
+            // read the data:
+            ReadResult r = uri.readString( _readOptions.get() );
 
-        bool dataOK = false;
+            const std::string& buffer = r.getString();
 
-        FeatureList features;
-        if ( !buffer.empty() )
-        {
-            // Get the mime-type from the metadata record if possible
-            const std::string& mimeType = r.metadata().value( IOMetadata::CONTENT_TYPE );
-            dataOK = getFeatures( buffer, mimeType, features );
-        }
+            if ( !buffer.empty() )
+            {
+                // Get the mime-type from the metadata record if possible
+                const std::string& mimeType = r.metadata().value( IOMetadata::CONTENT_TYPE );
+                dataOK = getFeatures( buffer, mimeType, features );
+            }
 
-        if ( dataOK )
-        {
-            OE_DEBUG << LC << "Read " << features.size() << " features" << std::endl;
+            if ( dataOK )
+            {
+                OE_DEBUG << LC << "Read " << features.size() << " features" << std::endl;
+                writeFeaturesToCache( url, features, _readOptions.get() );
+            }
         }
 
         //If we have any filters, process them here before the cursor is created
@@ -91,10 +91,14 @@ public: // FeatureFilter
 
             if (!boundaries.empty())
             {
-                // Transform the boundaries into the coordinate system of the features
+                // Transform the boundaries into the coordinate system of the features,
+                // and prepare each one once for testing against all the features
+                std::vector< osg::ref_ptr<PreparedGeometry> > prepared;
+                prepared.reserve( boundaries.size() );
                 for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
                 {
                     itr->get()->transform( context.profile()->getSRS() );
+                    prepared.push_back( new PreparedGeometry(itr->get()->getGeometry()) );
                 }
 
                 for(FeatureList::const_iterator f = input.begin(); f != input.end(); ++f)
@@ -106,10 +110,13 @@ public: // FeatureFilter
                        
                         if (_featureSource->getFeatureProfile()->getExtent().contains(GeoPoint(feature->getSRS(), c.x(), c.y())))
                         {
-                            for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
+                            osg::ref_ptr<PreparedGeometry> featureGeom = new PreparedGeometry( feature->getGeometry() );
+
+                            unsigned b = 0;
+                            for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr, ++b)
                             {
                                 //if (ring && ring->contains2D(c.x(), c.y()))
-                                if (itr->get()->getGeometry()->intersects( feature->getGeometry() ) )
+                                if (prepared[b]->intersects( featureGeom.get() ) )
                                 {
                                     // Copy the attributes in the boundary to the feature
                                     for (AttributeTable::const_iterator attrItr = itr->get()->getAttrs().begin();
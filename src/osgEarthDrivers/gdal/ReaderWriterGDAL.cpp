@@ -26,6 +26,7 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarth/URI>
 #include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Containers>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -35,6 +36,7 @@
 #include <osgDB/ImageOptions>
 
 #include <sstream>
+#include <algorithm>
 #include <stdlib.h>
 #include <memory.h>
 
@@ -76,6 +78,11 @@ float Hue_2_RGB( float v1, float v2, float vH )
 #  include <gdal_proxy.h>
 #endif
 
+//RasterIO only takes a progress function (via GDALRasterIOExtraArg) since GDAL 2.0
+#if GDAL_VERSION_MAJOR >= 2
+#  define GDAL_RASTERIO_HAS_PROGRESS 1
+#endif
+
 #include <cpl_string.h>
 
 //GDAL VRT api is only available after 1.5.0
@@ -85,6 +92,37 @@ using namespace std;
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
 
+namespace
+{
+    // GDAL progress function that aborts a read once the osgEarth request
+    // that started it is canceled.
+    int CPL_STDCALL cancelProgress(double, const char*, void* data)
+    {
+        ProgressCallback* progress = static_cast<ProgressCallback*>(data);
+        return (progress && progress->isCanceled()) ? FALSE : TRUE;
+    }
+
+    // Reads a window of a band like RasterIO(GF_Read, ...), but stops early
+    // (returning CE_Failure) if "progress" is canceled partway through.
+    CPLErr readRaster(GDALRasterBand* band, int x, int y, int width, int height,
+                      void* buffer, int bufWidth, int bufHeight, GDALDataType type,
+                      int lineSpace, ProgressCallback* progress)
+    {
+        if (progress && progress->isCanceled())
+            return CE_Failure;
+
+#ifdef GDAL_RASTERIO_HAS_PROGRESS
+        GDALRasterIOExtraArg extra;
+        INIT_RASTERIO_EXTRA_ARG(extra);
+        extra.pfnProgress = cancelProgress;
+        extra.pProgressData = progress;
+        return band->RasterIO(GF_Read, x, y, width, height, buffer, bufWidth, bufHeight, type, 0, lineSpace, &extra);
+#else
+        return band->RasterIO(GF_Read, x, y, width, height, buffer, bufWidth, bufHeight, type, 0, lineSpace);
+#endif
+    }
+}
+
 #define GEOTRSFRM_TOPLEFT_X            0
 #define GEOTRSFRM_WE_RES               1
 #define GEOTRSFRM_ROTATION_PARAM1      2
@@ -669,7 +707,11 @@ public:
       _srcDS(NULL),
       _warpedDS(NULL),
       _options(options),
-      _maxDataLevel(30)
+      _maxDataLevel(30),
+      _warpPolar(false),
+      _numHandles(0u),
+      _poolFailed(false),
+      _blocks(true, 64u)
     {
     }
 
@@ -677,6 +719,13 @@ public:
     {
         GDAL_SCOPED_LOCK;
 
+        // Close the pooled handles; all leases are gone by now.
+        for (unsigned i = 0; i < _freeHandles.size(); ++i)
+        {
+            closeHandle( _freeHandles[i] );
+        }
+        _freeHandles.clear();
+
         // Close the _warpedDS dataset if :
         // - it exists
         // - and is different from _srcDS
@@ -814,6 +863,7 @@ public:
                         _srcDS = (GDALDataset*)GDALOpen(result.getString().c_str(), GA_ReadOnly );
                         if (_srcDS)
                         {
+                            _srcPath = result.getString();
                             OE_INFO << LC << INDENT << "Read VRT from cache!" << std::endl;
                         }
                     }
@@ -875,6 +925,7 @@ public:
 
                 if (_srcDS)
                 {
+                    _srcPath = files[0];
 
                     char **subDatasets = _srcDS->GetMetadata( "SUBDATASETS");
                     int numSubDatasets = CSLCount( subDatasets );
@@ -889,6 +940,7 @@ public:
                         char *pszSubdatasetName = CPLStrdup( CSLFetchNameValue( subDatasets, buf.str().c_str() ) );
                         GDALClose( _srcDS );
                         _srcDS = (GDALDataset*)GDALOpen( pszSubdatasetName, GA_ReadOnly ) ;
+                        _srcPath = pszSubdatasetName;
                         CPLFree( pszSubdatasetName );
                     }
                 }
@@ -1021,26 +1073,18 @@ public:
         {
             if ( profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
             {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
+                _warpSrcWKT = src_srs->getWKT();
+                _warpDestWKT = profile->getSRS()->getWKT();
+                _warpPolar = true;
             }
             else
             {
-                std::string destWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    destWKT.c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    0);
+                _warpSrcWKT = src_srs->getWKT();
+                _warpDestWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
             }
 
+            _warpedDS = createWarpedDataset( _srcDS );
+
             if ( _warpedDS )
             {
                 warpedSRSWKT = _warpedDS->GetProjectionRef();
@@ -1218,12 +1262,189 @@ public:
 
 
     /**
-    * Finds a raster band based on color interpretation
+    * Creates the warping VRT (if any) that presents a source dataset in the
+    * output profile.
     */
-    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    GDALDataset* createWarpedDataset(GDALDataset* srcDS) const
+    {
+        if (_warpDestWKT.empty())
+            return srcDS;
+
+        if (_warpPolar)
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+
+        return (GDALDataset*)GDALAutoCreateWarpedVRT(
+            srcDS,
+            _warpSrcWKT.c_str(),
+            _warpDestWKT.c_str(),
+            GRA_NearestNeighbour,
+            5.0,
+            0);
+    }
+
+    /**
+    * Decoded pixels of one chunk of the elevation band (or one of its
+    * overviews), shared between adjacent tiles.
+    */
+    struct RasterBlock : public osg::Referenced
+    {
+        int _x, _y, _width, _height;
+        std::vector<float> _data;
+    };
+
+    struct RasterBlockKey
+    {
+        int _overview; // -1 = full resolution
+        int _col, _row;
+        bool operator < (const RasterBlockKey& rhs) const
+        {
+            if (_overview != rhs._overview) return _overview < rhs._overview;
+            if (_row != rhs._row) return _row < rhs._row;
+            return _col < rhs._col;
+        }
+    };
+
+    typedef LRUCache< RasterBlockKey, osg::ref_ptr<RasterBlock> > RasterBlockCache;
+
+    /**
+    * Pixels under one tile, in the pixel space of the overview they came from.
+    */
+    struct RasterWindow
+    {
+        int _x, _y, _width, _height;
+        int _rasterWidth, _rasterHeight; // size of the overview
+        double _scaleX, _scaleY;         // full resolution pixels per overview pixel
+        std::vector<float> _data;
+
+        bool contains(int c, int r) const { return c >= _x && r >= _y && c < _x+_width && r < _y+_height; }
+        float get(int c, int r) const { return _data[(r-_y)*_width + (c-_x)]; }
+    };
+
+    /**
+    * A separately opened copy of the source dataset. GDAL datasets are not
+    * thread-safe, but distinct handles to the same file can be read at once.
+    */
+    struct DatasetHandle
+    {
+        GDALDataset* _srcDS;
+        GDALDataset* _warpedDS;
+    };
+
+    bool openHandle(DatasetHandle& out) const
     {
         GDAL_SCOPED_LOCK;
 
+        out._srcDS = (GDALDataset*)GDALOpen( _srcPath.c_str(), GA_ReadOnly );
+        if (!out._srcDS)
+            return false;
+
+        out._warpedDS = createWarpedDataset( out._srcDS );
+        if (!out._warpedDS)
+        {
+            GDALClose( out._srcDS );
+            return false;
+        }
+        return true;
+    }
+
+    void closeHandle(DatasetHandle& handle) const
+    {
+        GDAL_SCOPED_LOCK;
+
+        if (handle._warpedDS != handle._srcDS)
+            GDALClose( handle._warpedDS );
+        GDALClose( handle._srcDS );
+    }
+
+    /**
+    * Takes a handle from the pool, opening one if the pool isn't full yet.
+    * Returns false if the source can't be reopened (external or in-memory
+    * datasets) or every handle is in use.
+    */
+    bool acquireHandle(DatasetHandle& out)
+    {
+        if (_srcPath.empty())
+            return false;
+
+        {
+            Threading::ScopedMutexLock lock( _poolMutex );
+            if (!_freeHandles.empty())
+            {
+                out = _freeHandles.back();
+                _freeHandles.pop_back();
+                return true;
+            }
+
+            if (_poolFailed || _numHandles >= _options.datasetPoolSize().get())
+                return false;
+
+            ++_numHandles;
+        }
+
+        if (openHandle( out ))
+            return true;
+
+        OE_WARN << LC << "Failed to open an extra handle on " << _srcPath << "; reads will share one" << std::endl;
+        Threading::ScopedMutexLock lock( _poolMutex );
+        _poolFailed = true;
+        --_numHandles;
+        return false;
+    }
+
+    void releaseHandle(const DatasetHandle& handle)
+    {
+        Threading::ScopedMutexLock lock( _poolMutex );
+        _freeHandles.push_back( handle );
+    }
+
+    /**
+    * Access to a dataset for the duration of one read: a pooled handle owned
+    * by the caller, or failing that the main dataset under the global GDAL
+    * lock.
+    */
+    class DatasetLease
+    {
+    public:
+        DatasetLease(GDALTileSource* source) : _source(source)
+        {
+            _pooled = source->acquireHandle( _handle );
+            if (!_pooled)
+            {
+                getGDALMutex().lock();
+                _handle._srcDS = source->_srcDS;
+                _handle._warpedDS = source->_warpedDS;
+            }
+        }
+
+        ~DatasetLease()
+        {
+            if (_pooled)
+                _source->releaseHandle( _handle );
+            else
+                getGDALMutex().unlock();
+        }
+
+        GDALDataset* dataset() const { return _handle._warpedDS; }
+
+    private:
+        GDALTileSource* _source;
+        DatasetHandle   _handle;
+        bool            _pooled;
+    };
+
+    /**
+    * Finds a raster band based on color interpretation
+    */
+    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    {
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetColorInterpretation() == colorInterp) return ds->GetRasterBand(i);
@@ -1233,8 +1454,6 @@ public:
 
     static GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetRasterDataType() == dataType) return ds->GetRasterBand(i);
@@ -1350,7 +1569,8 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        DatasetLease lease( this );
+        GDALDataset* warpedDS = lease.dataset();
 
         int tileSize = getPixelsPerTile(); //_options.tileSize().value();
 
@@ -1415,8 +1635,8 @@ public:
         int height = (int)(src_max_y - src_min_y);
 
 
-        int rasterWidth = _warpedDS->GetRasterXSize();
-        int rasterHeight = _warpedDS->GetRasterYSize();
+        int rasterWidth = warpedDS->GetRasterXSize();
+        int rasterHeight = warpedDS->GetRasterYSize();
         if (off_x + width > rasterWidth || off_y + height > rasterHeight)
         {
             OE_WARN << LC << "Read window outside of bounds of dataset.  Source Dimensions=" << rasterWidth << "x" << rasterHeight << " Read Window=" << off_x << ", " << off_y << " " << width << "x" << height << std::endl;
@@ -1450,44 +1670,44 @@ public:
 
 
 
-        GDALRasterBand* bandRed = findBandByColorInterp(_warpedDS, GCI_RedBand);
-        GDALRasterBand* bandGreen = findBandByColorInterp(_warpedDS, GCI_GreenBand);
-        GDALRasterBand* bandBlue = findBandByColorInterp(_warpedDS, GCI_BlueBand);
-        GDALRasterBand* bandAlpha = findBandByColorInterp(_warpedDS, GCI_AlphaBand);
+        GDALRasterBand* bandRed = findBandByColorInterp(warpedDS, GCI_RedBand);
+        GDALRasterBand* bandGreen = findBandByColorInterp(warpedDS, GCI_GreenBand);
+        GDALRasterBand* bandBlue = findBandByColorInterp(warpedDS, GCI_BlueBand);
+        GDALRasterBand* bandAlpha = findBandByColorInterp(warpedDS, GCI_AlphaBand);
 
-        GDALRasterBand* bandGray = findBandByColorInterp(_warpedDS, GCI_GrayIndex);
+        GDALRasterBand* bandGray = findBandByColorInterp(warpedDS, GCI_GrayIndex);
 
-        GDALRasterBand* bandPalette = findBandByColorInterp(_warpedDS, GCI_PaletteIndex);
+        GDALRasterBand* bandPalette = findBandByColorInterp(warpedDS, GCI_PaletteIndex);
 
         if (!bandRed && !bandGreen && !bandBlue && !bandAlpha && !bandGray && !bandPalette)
         {
             OE_DEBUG << LC << "Could not determine bands based on color interpretation, using band count" << std::endl;
             //We couldn't find any valid bands based on the color interp, so just make an educated guess based on the number of bands in the file
             //RGB = 3 bands
-            if (_warpedDS->GetRasterCount() == 3)
+            if (warpedDS->GetRasterCount() == 3)
             {
-                bandRed   = _warpedDS->GetRasterBand( 1 );
-                bandGreen = _warpedDS->GetRasterBand( 2 );
-                bandBlue  = _warpedDS->GetRasterBand( 3 );
+                bandRed   = warpedDS->GetRasterBand( 1 );
+                bandGreen = warpedDS->GetRasterBand( 2 );
+                bandBlue  = warpedDS->GetRasterBand( 3 );
             }
             //RGBA = 4 bands
-            else if (_warpedDS->GetRasterCount() == 4)
+            else if (warpedDS->GetRasterCount() == 4)
             {
-                bandRed   = _warpedDS->GetRasterBand( 1 );
-                bandGreen = _warpedDS->GetRasterBand( 2 );
-                bandBlue  = _warpedDS->GetRasterBand( 3 );
-                bandAlpha = _warpedDS->GetRasterBand( 4 );
+                bandRed   = warpedDS->GetRasterBand( 1 );
+                bandGreen = warpedDS->GetRasterBand( 2 );
+                bandBlue  = warpedDS->GetRasterBand( 3 );
+                bandAlpha = warpedDS->GetRasterBand( 4 );
             }
             //Gray = 1 band
-            else if (_warpedDS->GetRasterCount() == 1)
+            else if (warpedDS->GetRasterCount() == 1)
             {
-                bandGray = _warpedDS->GetRasterBand( 1 );
+                bandGray = warpedDS->GetRasterBand( 1 );
             }
             //Gray + alpha = 2 bands
-            else if (_warpedDS->GetRasterCount() == 2)
+            else if (warpedDS->GetRasterCount() == 2)
             {
-                bandGray  = _warpedDS->GetRasterBand( 1 );
-                bandAlpha = _warpedDS->GetRasterBand( 2 );
+                bandGray  = warpedDS->GetRasterBand( 1 );
+                bandAlpha = warpedDS->GetRasterBand( 2 );
             }
         }
 
@@ -1507,20 +1727,19 @@ public:
             //Initialize the alpha values to 255.
             memset(alpha, 255, target_width * target_height);
 
-            image = new osg::Image;
-            image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
+            image = ImageUtils::createImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
             memset(image->data(), 0, image->getImageSizeInBytes());
 
             //Nearest interpolation just uses RasterIO to sample the imagery and should be very fast.
             if (!*_options.interpolateImagery() || _options.interpolation() == INTERP_NEAREST)
             {
-                bandRed->RasterIO(GF_Read, off_x, off_y, width, height, red, target_width, target_height, GDT_Byte, 0, 0);
-                bandGreen->RasterIO(GF_Read, off_x, off_y, width, height, green, target_width, target_height, GDT_Byte, 0, 0);
-                bandBlue->RasterIO(GF_Read, off_x, off_y, width, height, blue, target_width, target_height, GDT_Byte, 0, 0);
+                readRaster(bandRed, off_x, off_y, width, height, red, target_width, target_height, GDT_Byte, 0, progress);
+                readRaster(bandGreen, off_x, off_y, width, height, green, target_width, target_height, GDT_Byte, 0, progress);
+                readRaster(bandBlue, off_x, off_y, width, height, blue, target_width, target_height, GDT_Byte, 0, progress);
 
                 if (bandAlpha)
                 {
-                    bandAlpha->RasterIO(GF_Read, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, 0);
+                    readRaster(bandAlpha, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, progress);
                 }
 
                 for (int src_row = 0, dst_row = tile_offset_top;
@@ -1607,8 +1826,7 @@ public:
                 }
 
                 // Create an un-normalized luminance image to hold coverage values.
-                image = new osg::Image();
-                image->allocateImage( tileSize, tileSize, 1, GL_LUMINANCE, glDataType );
+                image = ImageUtils::createImage( tileSize, tileSize, 1, GL_LUMINANCE, glDataType );
                 image->setInternalTextureFormat( internalFormat );
                 ImageUtils::markAsUnNormalized( image, true );
                 memset(image->data(), 0, image->getImageSizeInBytes());
@@ -1635,7 +1853,7 @@ public:
                 if ( !success )
                     nodata = NO_DATA_VALUE; //getNoDataValue(); //getOptions().noDataValue().get();
 
-                CPLErr err = bandGray->RasterIO(GF_Read, off_x, off_y, width, height, data, target_width, target_height, gdalDataType, 0, 0);
+                CPLErr err = readRaster(bandGray, off_x, off_y, width, height, data, target_width, target_height, gdalDataType, 0, progress);
                 if ( err == CE_None )
                 {
                     // copy from data to image.
@@ -1662,7 +1880,7 @@ public:
                     // TODO: can we replace this by writing rows in reverse order? -gw
                     image->flipVertical();
                 }
-                else // err != CE_None
+                else if (!progress || !progress->isCanceled()) // err != CE_None
                 {
                     OE_WARN << LC << "RasterIO failed.\n";
                     // TODO - handle error condition
@@ -1679,18 +1897,17 @@ public:
                 //Initialize the alpha values to 255.
                 memset(alpha, 255, target_width * target_height);
 
-                image = new osg::Image;
-                image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
+                image = ImageUtils::createImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
                 memset(image->data(), 0, image->getImageSizeInBytes());
 
 
                 if (!*_options.interpolateImagery() || _options.interpolation() == INTERP_NEAREST)
                 {
-                    bandGray->RasterIO(GF_Read, off_x, off_y, width, height, gray, target_width, target_height, GDT_Byte, 0, 0);
+                    readRaster(bandGray, off_x, off_y, width, height, gray, target_width, target_height, GDT_Byte, 0, progress);
 
                     if (bandAlpha)
                     {
-                        bandAlpha->RasterIO(GF_Read, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, 0);
+                        readRaster(bandAlpha, off_x, off_y, width, height, alpha, target_width, target_height, GDT_Byte, 0, progress);
                     }
 
                     for (int src_row = 0, dst_row = tile_offset_top;
@@ -1749,11 +1966,9 @@ public:
             //b/c interpolating pallete indexes doesn't make sense.
             unsigned char *palette = new unsigned char[target_width * target_height];
 
-            image = new osg::Image;
-
             if ( _options.coverage() == true )
             {
-                image->allocateImage(tileSize, tileSize, 1, GL_LUMINANCE, GL_FLOAT);
+                image = ImageUtils::createImage(tileSize, tileSize, 1, GL_LUMINANCE, GL_FLOAT);
                 image->setInternalTextureFormat(GL_LUMINANCE32F_ARB);
                 ImageUtils::markAsUnNormalized(image, true);
 
@@ -1769,11 +1984,11 @@ public:
             }
             else
             {
-                image->allocateImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
+                image = ImageUtils::createImage(tileSize, tileSize, 1, pixelFormat, GL_UNSIGNED_BYTE);
                 memset(image->data(), 0, image->getImageSizeInBytes());
             }
 
-            bandPalette->RasterIO(GF_Read, off_x, off_y, width, height, palette, target_width, target_height, GDT_Byte, 0, 0);
+            readRaster(bandPalette, off_x, off_y, width, height, palette, target_width, target_height, GDT_Byte, 0, progress);
 
             ImageUtils::PixelWriter write(image);
 
@@ -1829,6 +2044,13 @@ public:
             return NULL;
         }
 
+        // a canceled read leaves the image partially filled; don't let it
+        // get cached or displayed.
+        if (progress && progress->isCanceled())
+        {
+            return NULL;
+        }
+
         return image.release();
     }
 
@@ -1854,13 +2076,242 @@ public:
         return true;
     }
 
+    // Callers hold a DatasetLease on the band's dataset.
     bool isValidValue(float v, GDALRasterBand* band)
     {
-        GDAL_SCOPED_LOCK;
         return isValidValue_noLock( v, band );
     }
 
 
+    /**
+    * Combines the four pixels around a sample point using the configured
+    * interpolation method.
+    */
+    float blend(double c, double r, int colMin, int colMax, int rowMin, int rowMax,
+                float llHeight, float ulHeight, float lrHeight, float urHeight) const
+    {
+        float result = 0.0f;
+
+        if ( _options.interpolation() == INTERP_AVERAGE )
+        {
+            double x_rem = c - (int)c;
+            double y_rem = r - (int)r;
+
+            double w00 = (1.0 - y_rem) * (1.0 - x_rem) * (double)llHeight;
+            double w01 = (1.0 - y_rem) * x_rem * (double)lrHeight;
+            double w10 = y_rem * (1.0 - x_rem) * (double)ulHeight;
+            double w11 = y_rem * x_rem * (double)urHeight;
+
+            result = (float)(w00 + w01 + w10 + w11);
+        }
+        else if ( _options.interpolation() == INTERP_BILINEAR )
+        {
+            //Check for exact value
+            if ((colMax == colMin) && (rowMax == rowMin))
+            {
+                //OE_NOTICE << "Exact value" << std::endl;
+                result = llHeight;
+            }
+            else if (colMax == colMin)
+            {
+                //OE_NOTICE << "Vertically" << std::endl;
+                //Linear interpolate vertically
+                result = ((float)rowMax - r) * llHeight + (r - (float)rowMin) * ulHeight;
+            }
+            else if (rowMax == rowMin)
+            {
+                //OE_NOTICE << "Horizontally" << std::endl;
+                //Linear interpolate horizontally
+                result = ((float)colMax - c) * llHeight + (c - (float)colMin) * lrHeight;
+            }
+            else
+            {
+                //OE_NOTICE << "Bilinear" << std::endl;
+                //Bilinear interpolate
+                float r1 = ((float)colMax - c) * llHeight + (c - (float)colMin) * lrHeight;
+                float r2 = ((float)colMax - c) * ulHeight + (c - (float)colMin) * urHeight;
+
+                //OE_INFO << "r1, r2 = " << r1 << " , " << r2 << std::endl;
+                result = ((float)rowMax - r) * r1 + (r - (float)rowMin) * r2;
+            }
+        }
+        return result;
+    }
+
+    /**
+    * Same as getInterpolatedValue, but reads the pixels from a window that
+    * was decoded in advance instead of doing a RasterIO per pixel.
+    */
+    float getInterpolatedValue(const RasterWindow& window, GDALRasterBand* band, double x, double y)
+    {
+        double r, c;
+        geoToPixel( x, y, c, r );
+
+        // into the window's overview, then the half pixel offset:
+        c = c / window._scaleX - 0.5;
+        r = r / window._scaleY - 0.5;
+
+        int rasterWidth  = window._rasterWidth;
+        int rasterHeight = window._rasterHeight;
+
+        if (c < 0 && c >= -0.5)
+            c = 0;
+        else if (c > rasterWidth-1 && c <= rasterWidth-0.5)
+            c = rasterWidth-1;
+
+        if (r < 0 && r >= -0.5)
+            r = 0;
+        else if (r > rasterHeight-1 && r <= rasterHeight-0.5)
+            r = rasterHeight-1;
+
+        if (c < 0 || r < 0 || c > rasterWidth-1 || r > rasterHeight-1)
+            return NO_DATA_VALUE;
+
+        int rowMin = osg::maximum((int)floor(r), 0);
+        int rowMax = osg::maximum(osg::minimum((int)ceil(r), rasterHeight-1), 0);
+        int colMin = osg::maximum((int)floor(c), 0);
+        int colMax = osg::maximum(osg::minimum((int)ceil(c), rasterWidth-1), 0);
+
+        if (rowMin > rowMax) rowMin = rowMax;
+        if (colMin > colMax) colMin = colMax;
+
+        if (!window.contains(colMin, rowMin) || !window.contains(colMax, rowMax))
+            return getInterpolatedValue( band, x, y );
+
+        float llHeight = window.get(colMin, rowMin);
+        float ulHeight = window.get(colMin, rowMax);
+        float lrHeight = window.get(colMax, rowMin);
+        float urHeight = window.get(colMax, rowMax);
+
+        if ((!isValidValue(urHeight, band)) || (!isValidValue(llHeight, band)) ||(!isValidValue(ulHeight, band)) || (!isValidValue(lrHeight, band)))
+        {
+            return NO_DATA_VALUE;
+        }
+
+        return blend( c, r, colMin, colMax, rowMin, rowMax, llHeight, ulHeight, lrHeight, urHeight );
+    }
+
+    /**
+    * Gets a decoded chunk of an elevation band from the block cache, reading
+    * it if necessary. Chunks are aligned to the band's natural blocks so each
+    * block is decoded once no matter how many tiles touch it.
+    */
+    bool getBlock(GDALRasterBand* source, int overview, int col, int row,
+                  int chunkWidth, int chunkHeight, osg::ref_ptr<RasterBlock>& out,
+                  ProgressCallback* progress)
+    {
+        RasterBlockKey key;
+        key._overview = overview;
+        key._col = col;
+        key._row = row;
+
+        RasterBlockCache::Record rec;
+        if (_blocks.get(key, rec))
+        {
+            out = rec.value();
+            return true;
+        }
+
+        osg::ref_ptr<RasterBlock> block = new RasterBlock();
+        block->_x = col * chunkWidth;
+        block->_y = row * chunkHeight;
+        block->_width  = osg::minimum(chunkWidth,  source->GetXSize() - block->_x);
+        block->_height = osg::minimum(chunkHeight, source->GetYSize() - block->_y);
+        if (block->_width <= 0 || block->_height <= 0)
+            return false;
+
+        block->_data.resize(block->_width * block->_height);
+        CPLErr err = readRaster(source, block->_x, block->_y, block->_width, block->_height,
+            &block->_data[0], block->_width, block->_height, GDT_Float32, 0, progress);
+        if (err != CE_None)
+            return false;
+
+        _blocks.insert(key, block.get());
+        out = block.get();
+        return true;
+    }
+
+    /**
+    * Decodes the pixels under a tile into a window, from the coarsest
+    * overview that still has a pixel for every sample.
+    */
+    bool readWindow(GDALRasterBand* band, double xmin, double ymin, double xmax, double ymax,
+                    int tileSize, RasterWindow& out, ProgressCallback* progress)
+    {
+        double colMin, colMax, rowMin, rowMax;
+        geoToPixel( xmin, ymin, colMin, rowMax );
+        geoToPixel( xmax, ymax, colMax, rowMin );
+
+        int rasterWidth  = band->GetXSize();
+        int rasterHeight = band->GetYSize();
+        double pixelsPerSample = (colMax - colMin) / (double)(tileSize-1);
+
+        GDALRasterBand* source = band;
+        int overview = -1;
+        for (int i = 0; i < band->GetOverviewCount(); ++i)
+        {
+            GDALRasterBand* ov = band->GetOverview(i);
+            if (ov && ov->GetXSize() > 0 && ov->GetYSize() > 0 &&
+                (double)rasterWidth / (double)ov->GetXSize() <= pixelsPerSample &&
+                ov->GetXSize() < source->GetXSize())
+            {
+                source = ov;
+                overview = i;
+            }
+        }
+
+        out._rasterWidth  = source->GetXSize();
+        out._rasterHeight = source->GetYSize();
+        out._scaleX = (double)rasterWidth  / (double)out._rasterWidth;
+        out._scaleY = (double)rasterHeight / (double)out._rasterHeight;
+
+        // one pixel of margin for the interpolation
+        int x0 = osg::maximum((int)floor(colMin / out._scaleX) - 1, 0);
+        int y0 = osg::maximum((int)floor(rowMin / out._scaleY) - 1, 0);
+        int x1 = osg::minimum((int)ceil(colMax / out._scaleX) + 1, out._rasterWidth-1);
+        int y1 = osg::minimum((int)ceil(rowMax / out._scaleY) + 1, out._rasterHeight-1);
+        if (x0 > x1 || y0 > y1)
+            return false;
+
+        out._x = x0;
+        out._y = y0;
+        out._width  = x1 - x0 + 1;
+        out._height = y1 - y0 + 1;
+        out._data.assign(out._width * out._height, NO_DATA_VALUE);
+
+        int blockWidth, blockHeight;
+        source->GetBlockSize(&blockWidth, &blockHeight);
+        if (blockWidth  <= 0) blockWidth  = 256;
+        if (blockHeight <= 0) blockHeight = 256;
+
+        // group small blocks (e.g., scanline strips) into chunks of at least 256 pixels
+        int chunkWidth  = blockWidth  * osg::maximum(1, 256/blockWidth);
+        int chunkHeight = blockHeight * osg::maximum(1, 256/blockHeight);
+
+        for (int row = y0/chunkHeight; row <= y1/chunkHeight; ++row)
+        {
+            for (int col = x0/chunkWidth; col <= x1/chunkWidth; ++col)
+            {
+                osg::ref_ptr<RasterBlock> block;
+                if (!getBlock(source, overview, col, row, chunkWidth, chunkHeight, block, progress))
+                    return false;
+
+                int bx0 = osg::maximum(x0, block->_x);
+                int bx1 = osg::minimum(x1, block->_x + block->_width - 1);
+                int by0 = osg::maximum(y0, block->_y);
+                int by1 = osg::minimum(y1, block->_y + block->_height - 1);
+
+                for (int y = by0; y <= by1; ++y)
+                {
+                    const float* src = &block->_data[(y - block->_y) * block->_width + (bx0 - block->_x)];
+                    std::copy(src, src + (bx1 - bx0 + 1), &out._data[(y - y0) * out._width + (bx0 - x0)]);
+                }
+            }
+        }
+
+        return true;
+    }
+
     float getInterpolatedValue(GDALRasterBand *band, double x, double y, bool applyOffset=true)
     {
         double r, c;
@@ -1937,49 +2388,7 @@ public:
                 return NO_DATA_VALUE;
             }
 
-            if ( _options.interpolation() == INTERP_AVERAGE )
-            {
-                double x_rem = c - (int)c;
-                double y_rem = r - (int)r;
-
-                double w00 = (1.0 - y_rem) * (1.0 - x_rem) * (double)llHeight;
-                double w01 = (1.0 - y_rem) * x_rem * (double)lrHeight;
-                double w10 = y_rem * (1.0 - x_rem) * (double)ulHeight;
-                double w11 = y_rem * x_rem * (double)urHeight;
-
-                result = (float)(w00 + w01 + w10 + w11);
-            }
-            else if ( _options.interpolation() == INTERP_BILINEAR )
-            {
-                //Check for exact value
-                if ((colMax == colMin) && (rowMax == rowMin))
-                {
-                    //OE_NOTICE << "Exact value" << std::endl;
-                    result = llHeight;
-                }
-                else if (colMax == colMin)
-                {
-                    //OE_NOTICE << "Vertically" << std::endl;
-                    //Linear interpolate vertically
-                    result = ((float)rowMax - r) * llHeight + (r - (float)rowMin) * ulHeight;
-                }
-                else if (rowMax == rowMin)
-                {
-                    //OE_NOTICE << "Horizontally" << std::endl;
-                    //Linear interpolate horizontally
-                    result = ((float)colMax - c) * llHeight + (c - (float)colMin) * lrHeight;
-                }
-                else
-                {
-                    //OE_NOTICE << "Bilinear" << std::endl;
-                    //Bilinear interpolate
-                    float r1 = ((float)colMax - c) * llHeight + (c - (float)colMin) * lrHeight;
-                    float r2 = ((float)colMax - c) * ulHeight + (c - (float)colMin) * urHeight;
-
-                    //OE_INFO << "r1, r2 = " << r1 << " , " << r2 << std::endl;
-                    result = ((float)rowMax - r) * r1 + (r - (float)rowMin) * r2;
-                }
-            }
+            result = blend( c, r, colMin, colMax, rowMin, rowMax, llHeight, ulHeight, lrHeight, urHeight );
         }
 
         return result;
@@ -1996,7 +2405,8 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        DatasetLease lease( this );
+        GDALDataset* warpedDS = lease.dataset();
 
         int tileSize = getPixelsPerTile();
 
@@ -2011,11 +2421,11 @@ public:
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             if (_options.interpolation() == INTERP_NEAREST)
@@ -2034,9 +2444,9 @@ public:
                 int iNumRows = iRowMax - iRowMin + 1;
 
                 int iWinColMin = max(0, iColMin);
-                int iWinColMax = min(_warpedDS->GetRasterXSize()-1, iColMax);
+                int iWinColMax = min(warpedDS->GetRasterXSize()-1, iColMax);
                 int iWinRowMin = max(0, iRowMin);
-                int iWinRowMax = min(_warpedDS->GetRasterYSize()-1, iRowMax);
+                int iWinRowMax = min(warpedDS->GetRasterYSize()-1, iRowMax);
                 int iNumWinCols = iWinColMax - iWinColMin + 1;
                 int iNumWinRows = iWinRowMax - iWinRowMin + 1;
 
@@ -2050,7 +2460,7 @@ public:
                 int startOffset = iBufRowMin * tileSize + iBufColMin;
                 int lineSpace = tileSize * sizeof(float);
 
-                band->RasterIO(GF_Read, iWinColMin, iWinRowMin, iNumWinCols, iNumWinRows, &buffer[startOffset], iNumBufCols, iNumBufRows, GDT_Float32, 0, lineSpace);
+                readRaster(band, iWinColMin, iWinRowMin, iNumWinCols, iNumWinRows, &buffer[startOffset], iNumBufCols, iNumBufRows, GDT_Float32, lineSpace, progress);
 
                 for (int r = 0, ir = tileSize - 1; r < tileSize; ++r, --ir)
                 {
@@ -2062,6 +2472,9 @@ public:
             }
             else
             {
+                RasterWindow window;
+                bool windowed = readWindow(band, xmin, ymin, xmax, ymax, tileSize, window, progress);
+
                 double dx = (xmax - xmin) / (tileSize-1);
                 double dy = (ymax - ymin) / (tileSize-1);
                 for (int r = 0; r < tileSize; ++r)
@@ -2070,7 +2483,9 @@ public:
                     for (int c = 0; c < tileSize; ++c)
                     {
                         double geoX = xmin + (dx * (double)c);
-                        float h = getInterpolatedValue(band, geoX, geoY);
+                        float h = windowed ?
+                            getInterpolatedValue(window, band, geoX, geoY) :
+                            getInterpolatedValue(band, geoX, geoY);
                         hf->setHeight(c, r, h);
                     }
                 }
@@ -2081,6 +2496,12 @@ public:
             std::vector<float>& heightList = hf->getHeightList();
             std::fill(heightList.begin(), heightList.end(), NO_DATA_VALUE);
         }
+
+        if (progress && progress->isCanceled())
+        {
+            return NULL;
+        }
+
         return hf.release();
     }
 
@@ -2322,7 +2743,7 @@ public:
             {
                 heights[i] = NO_DATA_VALUE;
             }
-            band->RasterIO(GF_Read, src_min_x, src_min_y, width, height, heights, target_width, target_height, GDT_Float32, 0, 0);
+            readRaster(band, src_min_x, src_min_y, width, height, heights, target_width, target_height, GDT_Float32, 0, progress);
 
             // Now create a GeoHeightField that we can sample from.  This heightfield only contains the portion that was actually read from the dataset
             osg::ref_ptr< osg::HeightField > readHF = new osg::HeightField();
@@ -2371,6 +2792,12 @@ public:
                 }
             }
         }
+
+        if (progress && progress->isCanceled())
+        {
+            return NULL;
+        }
+
         return hf.release();
     }
 
@@ -2400,6 +2827,19 @@ private:
     osg::ref_ptr< osgDB::Options > _dbOptions;
 
     unsigned int _maxDataLevel;
+
+    // how to reopen the source for the handle pool (empty if it can't be)
+    std::string _srcPath;
+    std::string _warpSrcWKT;
+    std::string _warpDestWKT;
+    bool        _warpPolar;
+
+    Threading::Mutex           _poolMutex;
+    std::vector<DatasetHandle> _freeHandles;
+    unsigned                   _numHandles;
+    bool                       _poolFailed;
+
+    RasterBlockCache _blocks;
 };
 
 
@@ -0,0 +1,89 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "KMLPager"
+#include "KML_Placemark"
+
+using namespace osgEarth_kml;
+
+KMLPager::KMLPager(const KMLContext& cx, unsigned level, KMLSource* source) :
+SimplePager( Profile::create("global-geodetic") ),
+_source    ( source ),
+_options   ( *cx._options )
+{
+    setMinLevel( level );
+    setMaxLevel( level );
+
+    // tiles build with a copy of the reader's context. The copy holds its own
+    // options, since the reader's go away when loading finishes, and it shares
+    // the style sheet, which inline styles still add to, under a lock.
+    _cx._mapNode    = cx._mapNode;
+    _cx._options    = &_options;
+    _cx._sheet      = cx._sheet.get();
+    _cx._srs        = cx._srs.get();
+    _cx._dbOptions  = cx._dbOptions.get();
+    _cx._referrer   = cx._referrer;
+    _cx._sheetMutex = &_sheetMutex;
+}
+
+void
+KMLPager::add(xml_node<>* placemark, const GeoPoint& position)
+{
+    GeoPoint p = position.transform( getProfile()->getSRS() );
+    if ( p.isValid() )
+    {
+        TileKey key = getProfile()->createTileKey( p.x(), p.y(), getMaxLevel() );
+        if ( key.valid() )
+        {
+            _bins[key].push_back( placemark );
+        }
+    }
+}
+
+osg::Node*
+KMLPager::createNode(const TileKey& key, ProgressCallback* progress)
+{
+    Bins::const_iterator bin = _bins.find( key );
+    if ( bin == _bins.end() )
+        return 0L;
+
+    osg::Group* group = new osg::Group();
+
+    KMLContext cx = _cx;
+    cx._groupStack.push( group );
+
+    for (std::vector<xml_node<>*>::const_iterator i = bin->second.begin(); i != bin->second.end(); ++i)
+    {
+        if ( progress && progress->isCanceled() )
+        {
+            osg::ref_ptr<osg::Group> discard = group;
+            return 0L;
+        }
+
+        KML_Placemark placemark;
+        placemark.build( *i, cx );
+    }
+
+    if ( group->getNumChildren() == 0 )
+    {
+        osg::ref_ptr<osg::Group> discard = group;
+        return 0L;
+    }
+
+    return group;
+}
@@ -19,6 +19,7 @@
 #include "KMLReader"
 #include "KML_Root"
 #include "KML_Geometry"
+#include "KMLPager"
 #include <osgEarth/Registry>
 #include <osgEarth/Capabilities>
 #include <osgEarth/XmlUtils>
@@ -48,15 +49,15 @@ KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
     osg::Timer_t start = osg::Timer::instance()->tick();
 	std::stringstream buffer;
     buffer << in.rdbuf();
-    std::string xmlStr;
-    xmlStr = buffer.str();
-	xml_document<> doc;
-	doc.parse<0>(&xmlStr[0]);
+    // held by reference so a pager can keep the document after we return:
+    osg::ref_ptr<KMLSource> source = new KMLSource();
+    source->_text = buffer.str();
+	source->_doc.parse<0>(&source->_text[0]);
     osg::Timer_t end = osg::Timer::instance()->tick();
 	OE_INFO << "Loaded KML in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
 
     start = osg::Timer::instance()->tick();
-	osg::Node* node = read(doc, dbOptions);
+	osg::Node* node = read(source.get(), dbOptions);
     end = osg::Timer::instance()->tick();
 	OE_INFO << "Parsed KML in " << osg::Timer::instance()->delta_s(start, end) << std::endl;
 	node->setName( context.referrer() );
@@ -66,6 +67,18 @@ KMLReader::read( std::istream& in, const osgDB::Options* dbOptions )
 
 osg::Node*
 KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
+{
+    return read( doc, 0L, dbOptions );
+}
+
+osg::Node*
+KMLReader::read( KMLSource* source, const osgDB::Options* dbOptions )
+{
+    return read( source->_doc, source, dbOptions );
+}
+
+osg::Node*
+KMLReader::read( xml_document<>& doc, KMLSource* source, const osgDB::Options* dbOptions )
 {
     osg::Group* root = new osg::Group();
     root->ref();
@@ -103,6 +116,22 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
     if ( cx._options == 0L )
         cx._options = &blankOptions;
 
+    // page placemarks in by region if requested. The pager needs the document
+    // to outlive this call, which it can only ensure for a document we parsed.
+    osg::ref_ptr<KMLPager> pager;
+    if ( cx._options->pagingLevel().isSet() )
+    {
+        if ( source )
+        {
+            pager = new KMLPager( cx, cx._options->pagingLevel().get(), source );
+            cx._pager = pager.get();
+        }
+        else
+        {
+            OE_WARN << LC << "Paging requires the reader to parse the KML itself; building all placemarks now" << std::endl;
+        }
+    }
+
     //if ( cx._options->iconAndLabelGroup().valid() && cx._options->declutter() == true )
     //{
     //    Decluttering::setEnabled( cx._options->iconAndLabelGroup()->getOrCreateStateSet(), true );
@@ -131,6 +160,12 @@ KMLReader::read( xml_document<>& doc, const osgDB::Options* dbOptions )
         OE_INFO << "build took " << osg::Timer::instance()->delta_s(start, end) << std::endl;
     }
 
+    if ( pager.valid() && !pager->empty() )
+    {
+        pager->build();
+        root->addChild( pager.get() );
+    }
+
     URIResultCache* cacheUsed = URIResultCache::from(cx._dbOptions.get());
     CacheStats stats = cacheUsed->getStats();
     OE_INFO << LC << "URI Cache: " << stats._queries << " reads, " << (stats._hitRatio*100.0) << "% hits" << std::endl;
@@ -19,6 +19,7 @@
 #include "KML_Placemark"
 #include "KML_Geometry"
 #include "KML_Style"
+#include "KMLPager"
 
 #include <osgEarthAnnotation/FeatureNode>
 #include <osgEarthAnnotation/PlaceNode>
@@ -37,6 +38,25 @@ using namespace osgEarth::Annotation;
 void 
 KML_Placemark::build( xml_node<>* node, KMLContext& cx )
 {
+    // when paging, only note where the placemark is; the pager builds it
+    // later, once the tile containing it comes into range.
+    if ( cx._pager )
+    {
+        Style unused;
+        KML_Geometry geometry;
+        geometry.build(node, cx, unused);
+        if ( geometry._geom.valid() && geometry._geom->getTotalPointCount() > 0 )
+        {
+            GeoPoint position(cx._srs.get(), geometry._geom->getBounds().center(), ALTMODE_ABSOLUTE);
+            cx._pager->add( node, position );
+        }
+        return;
+    }
+
+    // paged tiles build concurrently, and inline styles add to the shared sheet.
+    if ( cx._sheetMutex )
+        cx._sheetMutex->lock();
+
 	Style masterStyle;
 
 	std::string styleUrl = getValue(node, "styleurl");
@@ -58,6 +78,9 @@ KML_Placemark::build( xml_node<>* node, KMLContext& cx )
 		masterStyle = masterStyle.combineWith(cx._activeStyle);
 	}
 
+    if ( cx._sheetMutex )
+        cx._sheetMutex->unlock();
+
     // parse the geometry. the placemark must have geometry to be valid. The 
     // geometry parse may optionally specify an altitude mode as well.
     KML_Geometry geometry;
@@ -221,7 +244,7 @@ KML_Placemark::build( xml_node<>* node, KMLContext& cx )
                 {
                     if ( iconNode )
                     {
-                        if ( cx._options->iconAndLabelGroup().valid() )
+                        if ( cx._options->iconAndLabelGroup().valid() && !cx._options->pagingLevel().isSet() )
                         {
                             cx._options->iconAndLabelGroup()->addChild( iconNode );
                         }
@@ -63,11 +63,68 @@ _options  ( options ),
 _database ( NULL ),
 _minLevel ( 0 ),
 _maxLevel ( 20 ),
-_forceRGB ( false )
+_forceRGB ( false ),
+_insert   ( NULL ),
+_select   ( NULL ),
+_exists   ( NULL ),
+_batchCount( 0u ),
+_wal      ( false )
 {
     //nop
 }
 
+MBTilesTileSource::~MBTilesTileSource()
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    if ( _database )
+    {
+        commitBatch();
+
+        if ( _insert )
+            sqlite3_finalize( _insert );
+
+        if ( _select )
+            sqlite3_finalize( _select );
+
+        if ( _exists )
+            sqlite3_finalize( _exists );
+
+        // leave the file in rollback-journal mode so it can be opened
+        // read-only (WAL requires a writable -shm file).
+        if ( _wal )
+            sqlite3_exec( _database, "PRAGMA journal_mode=DELETE", 0L, 0L, 0L );
+
+        sqlite3_close( _database );
+        _database = NULL;
+    }
+
+    Threading::ScopedMutexLock poolLock(_poolMutex);
+    for(std::vector<Connection>::iterator c = _readPool.begin(); c != _readPool.end(); ++c)
+    {
+        if ( c->_select )
+            sqlite3_finalize( c->_select );
+        sqlite3_close( c->_database );
+    }
+    _readPool.clear();
+}
+
+void
+MBTilesTileSource::commitBatch()
+{
+    // assume the mutex is locked
+    if ( _batchCount > 0 )
+    {
+        char* errorMsg = 0L;
+        if ( SQLITE_OK != sqlite3_exec(_database, "COMMIT", 0L, 0L, &errorMsg) )
+        {
+            OE_WARN << LC << "Failed to commit tiles: " << errorMsg << std::endl;
+            sqlite3_free( errorMsg );
+        }
+        _batchCount = 0;
+    }
+}
+
 Status
 MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 {
@@ -114,12 +171,21 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
         : (SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX);
 
     int rc = sqlite3_open_v2( fullFilename.c_str(), &_database, flags, 0L );
+    _fullFilename = fullFilename;
     if ( rc != 0 )
     {
         return Status::Error( Status::ResourceUnavailable, Stringify()
             << "Database \"" << fullFilename << "\": " << sqlite3_errmsg(_database) );
     }
 
+    // Write-ahead logging makes batched writes cheaper; readers are unaffected
+    // while writing, and the destructor switches the file back.
+    if ( readWrite && _options.batchSize().get() > 1u )
+    {
+        _wal = SQLITE_OK == sqlite3_exec( _database, "PRAGMA journal_mode=WAL", 0L, 0L, 0L );
+        sqlite3_exec( _database, "PRAGMA synchronous=NORMAL", 0L, 0L, 0L );
+    }
+
     // New database setup:
     if ( isNewDatabase )
     {
@@ -304,8 +370,6 @@ osg::Image*
 MBTilesTileSource::createImage(const TileKey&    key,
                                ProgressCallback* progress)
 {
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     int z = key.getLevelOfDetail();
     int x = key.getTileX();
     int y = key.getTileY();
@@ -326,66 +390,167 @@ MBTilesTileSource::createImage(const TileKey&    key,
     y  = numRows - y - 1;
 
     //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &select, 0L );
-    if ( rc != SQLITE_OK )
+    std::string dataBuffer;
+    bool valid;
+
+    if ( (getMode() & MODE_WRITE) != 0 )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+        // A writable database has a single connection.
+        Threading::ScopedMutexLock exclusiveLock(_mutex);
+        valid = readTile( _database, _select, z, x, y, dataBuffer );
+    }
+    else
+    {
+        // Read-only: each reader thread borrows its own connection.
+        Connection c;
+        if ( !acquireReadConnection(c) )
+            return NULL;
+        valid = readTile( c._database, c._select, z, x, y, dataBuffer );
+        releaseReadConnection(c);
+    }
+
+    if ( !valid )
         return NULL;
+
+    osg::Image* result = NULL;
+
+    // decompress if necessary:
+    if ( _compressor.valid() )
+    {
+        std::istringstream inputStream(dataBuffer);
+        std::string value;
+        if ( !_compressor->decompress(inputStream, value) )
+        {
+            OE_WARN << LC << "Decompression failed" << std::endl;
+            valid = false;
+        }
+        else
+        {
+            dataBuffer = value;
+        }
     }
 
-    bool valid = true;
+    // decode the raw image data:
+    if ( valid )
+    {
+        std::istringstream inputStream(dataBuffer);
+        osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
+        if (rr.validImage())
+        {
+            result = rr.takeImage();
+        }
+    }
+
+    return result;
+}
+
+bool
+MBTilesTileSource::readTile(sqlite3* database, sqlite3_stmt*& select, int z, int x, int y, std::string& output) const
+{
+    // assume the caller has exclusive use of the connection.
+    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+    if ( !select )
+    {
+        int rc = sqlite3_prepare_v2( database, query.c_str(), -1, &select, 0L );
+        if ( rc != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(database) << std::endl;
+            select = NULL;
+            return false;
+        }
+    }
 
     sqlite3_bind_int( select, 1, z );
     sqlite3_bind_int( select, 2, x );
     sqlite3_bind_int( select, 3, y );
 
-    osg::Image* result = NULL;
-    rc = sqlite3_step( select );
+    bool valid = true;
+    int rc = sqlite3_step( select );
     if ( rc == SQLITE_ROW)
     {
         // the pointer returned from _blob gets freed internally by sqlite, supposedly
         const char* data = (const char*)sqlite3_column_blob( select, 0 );
         int dataLen = sqlite3_column_bytes( select, 0 );
+        output.assign( data, dataLen );
+    }
+    else
+    {
+        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
+        valid = false;
+    }
 
-        std::string dataBuffer( data, dataLen );
+    sqlite3_reset( select );
+    return valid;
+}
 
-        // decompress if necessary:
-        if ( _compressor.valid() )
+bool
+MBTilesTileSource::acquireReadConnection(Connection& c) const
+{
+    {
+        Threading::ScopedMutexLock lock(_poolMutex);
+        if ( !_readPool.empty() )
         {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
-            {
-                OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
-            }
-            else
-            {
-                dataBuffer = value;
-            }
+            c = _readPool.back();
+            _readPool.pop_back();
+            return true;
         }
+    }
 
-        // decode the raw image data:
-        if ( valid )
-        {
-            std::istringstream inputStream(dataBuffer);
-            osgDB::ReaderWriter::ReadResult rr = _rw->readImage( inputStream, _dbOptions.get() );
-            if (rr.validImage())
-            {
-                result = rr.takeImage();
-            }
-        }
+    // Open another read-only connection. Each connection is only ever used by
+    // one thread at a time, so it doesn't need SQLite's own mutexing, and a
+    // private page cache lets the connections read in parallel.
+    c._database = NULL;
+    c._select = NULL;
+    int rc = sqlite3_open_v2( _fullFilename.c_str(), &c._database, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_PRIVATECACHE, 0L );
+    if ( rc != SQLITE_OK )
+    {
+        OE_WARN << LC << "Failed to open a read connection to \"" << _fullFilename << "\": " << sqlite3_errmsg(c._database) << std::endl;
+        sqlite3_close( c._database );
+        return false;
     }
-    else
+    return true;
+}
+
+void
+MBTilesTileSource::releaseReadConnection(const Connection& c) const
+{
+    Threading::ScopedMutexLock lock(_poolMutex);
+    _readPool.push_back( c );
+}
+
+bool
+MBTilesTileSource::hasStoredTile(const TileKey& key)
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    if ( !_database )
+        return false;
+
+    // tile_index makes this a single index probe.
+    std::string query = "SELECT 1 FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?";
+    if ( !_exists )
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        if ( sqlite3_prepare_v2( _database, query.c_str(), -1, &_exists, 0L ) != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+            _exists = NULL;
+            return false;
+        }
     }
 
-    sqlite3_finalize( select );
-    return result;
+    // flip Y axis
+    unsigned int numRows, numCols;
+    key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
+
+    sqlite3_bind_int( _exists, 1, key.getLOD() );
+    sqlite3_bind_int( _exists, 2, key.getTileX() );
+    sqlite3_bind_int( _exists, 3, numRows - key.getTileY() - 1 );
+
+    bool found = sqlite3_step( _exists ) == SQLITE_ROW;
+
+    sqlite3_reset( _exists );
+    sqlite3_clear_bindings( _exists );
+    return found;
 }
 
 bool
@@ -396,9 +561,8 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     if ( (getMode() & MODE_WRITE) == 0 )
         return false;
 
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
-    // encode the data stream:
+    // encode the data stream (outside the lock, so writer threads can
+    // encode in parallel):
     std::stringstream buf;
     osgDB::ReaderWriter::WriteResult wr;
     if ( _forceRGB && ImageUtils::hasAlphaChannel(image) )
@@ -431,6 +595,8 @@ MBTilesTileSource::storeImage(const TileKey&    key,
         value = output.str();
     }
 
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
     int z = key.getLOD();
     int x = key.getTileX();
     int y = key.getTileY();
@@ -440,14 +606,26 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
-    // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
+    // Prep the insert statement once and reuse it:
     std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L );
-    if ( rc != SQLITE_OK )
+    int rc;
+    if ( !_insert )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return false;
+        rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &_insert, 0L );
+        if ( rc != SQLITE_OK )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+            _insert = NULL;
+            return false;
+        }
+    }
+    sqlite3_stmt* insert = _insert;
+
+    // Start a new batch:
+    unsigned batchSize = osg::maximum( _options.batchSize().get(), 1u );
+    if ( batchSize > 1u && _batchCount == 0u )
+    {
+        sqlite3_exec( _database, "BEGIN", 0L, 0L, 0L );
     }
 
     // bind parameters:
@@ -476,7 +654,14 @@ MBTilesTileSource::storeImage(const TileKey&    key,
         ok = false;
     }
 
-    sqlite3_finalize( insert );
+    sqlite3_reset( insert );
+    sqlite3_clear_bindings( insert );
+
+    // Commit when the batch is full:
+    if ( batchSize > 1u && ++_batchCount >= batchSize )
+    {
+        commitBatch();
+    }
 
     return ok;
 }
@@ -52,26 +52,49 @@ namespace
     };
 }
 
-MonitorExtension::MonitorExtension()
+MonitorExtension::MonitorExtension() :
+_server( 0L )
 {
-    ctor();
+    ctor( ConfigOptions() );
 }
 
-MonitorExtension::MonitorExtension(const ConfigOptions& options)
+MonitorExtension::MonitorExtension(const ConfigOptions& options) :
+_server( 0L )
 {
-    ctor();
+    ctor( options );
 }
 
 MonitorExtension::~MonitorExtension()
 {
-    // nop
+    if ( _server )
+    {
+        _server->stopServing();
+        delete _server;
+        _server = 0L;
+    }
 }
 
 void
-MonitorExtension::ctor()
+MonitorExtension::ctor(const ConfigOptions& options)
 {
     OE_INFO << LC << "loaded\n";
     _ui = new MonitorUI();
+
+    // Optionally expose the stats registry to a Prometheus scraper. Only local
+    // clients can reach it unless stats_address names another interface.
+    optional<unsigned> port;
+    optional<std::string> address( "127.0.0.1" );
+    options.getConfig().getIfSet( "stats_port", port );
+    options.getConfig().getIfSet( "stats_address", address );
+    if ( port.isSet() && port.get() > 0u && port.get() < 65536u )
+    {
+        _server = new StatsServer( (unsigned short)port.get(), address.get() );
+        if ( !_server->startServing() )
+        {
+            delete _server;
+            _server = 0L;
+        }
+    }
 }
 
 
@@ -123,5 +146,9 @@ void
 MonitorExtension::frame(const osg::FrameStamp* fs)
 {
     if (_ui.valid())
-        _ui->update(fs);
+    {
+        osg::ref_ptr<MapNode> mapNode;
+        _mapNode.lock(mapNode);
+        _ui->update(fs, mapNode.get());
+    }
 }
\ No newline at end of file
@@ -19,6 +19,8 @@
 #include "MonitorUI"
 #include <osgEarth/Memory>
 #include <osgEarth/Registry>
+#include <osgEarth/TerrainEngineNode>
+#include <iomanip>
 
 using namespace osgEarth::Monitor;
 using namespace osgEarth;
@@ -52,10 +54,12 @@ MonitorUI::MonitorUI()
     _ppb->setHorizAlign(ALIGN_RIGHT);
     this->setControl(1, r, _ppb.get());
     ++r;
+
+    _firstLayerRow = r;
 }
 
 void
-MonitorUI::update(const osg::FrameStamp* fs)
+MonitorUI::update(const osg::FrameStamp* fs, MapNode* mapNode)
 {
     if (fs && fs->getFrameNumber() % 15 == 0)
     {
@@ -63,7 +67,43 @@ MonitorUI::update(const osg::FrameStamp* fs)
         _pb->setText(Stringify() << (Memory::getProcessPrivateUsage() / 1048576) << " M");
         _ppb->setText(Stringify() << (Memory::getProcessPeakPrivateUsage() / 1048576) << " M");
 
+        updateGPUTimes(mapNode);
+
         //Registry::instance()->startActivity("Current Mem", Stringify() <<  (bytes / 1048576) << " M");
         //Registry::instance()->startActivity("Peak Mem", Stringify() << (Memory::getProcessPeakUsage() / 1048576) << " M");
     }
 }
+
+void
+MonitorUI::updateGPUTimes(MapNode* mapNode)
+{
+    TerrainEngineNode::LayerGPUTimes times;
+    if (!mapNode || !mapNode->getTerrainEngine() || !mapNode->getTerrainEngine()->getLayerGPUTimes(times))
+        return;
+
+    unsigned k = 0;
+    for (TerrainEngineNode::LayerGPUTimes::const_iterator i = times.begin(); i != times.end(); ++i, ++k)
+    {
+        if (k == _layerNames.size())
+        {
+            _layerNames.push_back(new ui::LabelControl());
+            this->setControl(0, _firstLayerRow + k, _layerNames.back().get());
+
+            _layerTimes.push_back(new ui::LabelControl());
+            _layerTimes.back()->setHorizAlign(ALIGN_RIGHT);
+            this->setControl(1, _firstLayerRow + k, _layerTimes.back().get());
+        }
+
+        const Layer* layer = i->first >= 0 ? mapNode->getMap()->getLayerByUID(i->first) : 0L;
+        _layerNames[k]->setText(layer ? layer->getName() + ":" : std::string("Terrain:"));
+        _layerTimes[k]->setText(Stringify() << std::fixed << std::setprecision(2)
+            << i->second._drawMs << " + " << i->second._uploadMs << " ms");
+    }
+
+    // blank out rows for layers that have gone away
+    for (; k < _layerNames.size(); ++k)
+    {
+        _layerNames[k]->setText("");
+        _layerTimes[k]->setText("");
+    }
+}
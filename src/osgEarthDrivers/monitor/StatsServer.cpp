@@ -0,0 +1,214 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "StatsServer"
+#include <osgEarth/StatsRegistry>
+#include <osgEarth/Notify>
+#include <sstream>
+#include <cstring>
+
+#ifdef _WIN32
+#   include <winsock2.h>
+    typedef int socklen_t;
+#   define CLOSE_SOCKET ::closesocket
+#   define SHUT_RDWR    SD_BOTH
+#else
+#   include <sys/types.h>
+#   include <sys/socket.h>
+#   include <sys/select.h>
+#   include <netinet/in.h>
+#   include <arpa/inet.h>
+#   include <unistd.h>
+#   define CLOSE_SOCKET ::close
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Monitor;
+
+#define LC "[StatsServer] "
+
+namespace
+{
+    // How long a client may stall a read or write before we drop it.
+    const int CLIENT_TIMEOUT_MS = 2000;
+}
+
+StatsServer::StatsServer(unsigned short port, const std::string& address) :
+_port   ( port ),
+_address( address ),
+_socket ( -1 ),
+_client ( -1 ),
+_done   ( false )
+{
+#ifdef _WIN32
+    WSADATA data;
+    ::WSAStartup(MAKEWORD(2,2), &data);
+#endif
+}
+
+StatsServer::~StatsServer()
+{
+    stopServing();
+#ifdef _WIN32
+    ::WSACleanup();
+#endif
+}
+
+bool
+StatsServer::startServing()
+{
+    unsigned long ip = ::inet_addr(_address.c_str());
+    if ( ip == INADDR_NONE && _address != "255.255.255.255" )
+    {
+        OE_WARN << LC << "Invalid listen address \"" << _address << "\"\n";
+        return false;
+    }
+
+    _socket = (int)::socket(AF_INET, SOCK_STREAM, 0);
+    if ( _socket < 0 )
+    {
+        OE_WARN << LC << "Failed to create a socket\n";
+        return false;
+    }
+
+    int reuse = 1;
+    ::setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = (unsigned)ip;
+    addr.sin_port        = htons(_port);
+
+    if ( ::bind(_socket, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(_socket, 8) != 0 )
+    {
+        OE_WARN << LC << "Failed to listen on " << _address << ":" << _port << "\n";
+        CLOSE_SOCKET(_socket);
+        _socket = -1;
+        return false;
+    }
+
+    _done = false;
+    start();
+    OE_INFO << LC << "Serving stats on " << _address << ":" << _port << "\n";
+    return true;
+}
+
+void
+StatsServer::stopServing()
+{
+    if ( _socket < 0 )
+        return;
+
+    // Shut the sockets down to wake the thread from select, recv or send.
+    _done = true;
+    ::shutdown(_socket, SHUT_RDWR);
+    {
+        Threading::ScopedMutexLock lock(_clientMutex);
+        if ( _client >= 0 )
+            ::shutdown(_client, SHUT_RDWR);
+    }
+    join();
+
+    CLOSE_SOCKET(_socket);
+    _socket = -1;
+}
+
+void
+StatsServer::run()
+{
+    while ( !_done )
+    {
+        // wake up periodically to check for shutdown.
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(_socket, &readable);
+        timeval timeout;
+        timeout.tv_sec  = 0;
+        timeout.tv_usec = 250000;
+
+        if ( ::select(_socket+1, &readable, 0L, 0L, &timeout) <= 0 )
+            continue;
+
+        sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        int client = (int)::accept(_socket, (sockaddr*)&addr, &len);
+        if ( client >= 0 )
+        {
+            // Don't let a client that connects and goes quiet hang the server.
+#ifdef _WIN32
+            DWORD clientTimeout = CLIENT_TIMEOUT_MS;
+#else
+            timeval clientTimeout;
+            clientTimeout.tv_sec  = CLIENT_TIMEOUT_MS / 1000;
+            clientTimeout.tv_usec = (CLIENT_TIMEOUT_MS % 1000) * 1000;
+#endif
+            ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&clientTimeout, sizeof(clientTimeout));
+            ::setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&clientTimeout, sizeof(clientTimeout));
+
+            {
+                Threading::ScopedMutexLock lock(_clientMutex);
+                _client = client;
+            }
+
+            if ( !_done )
+                handle( client );
+
+            {
+                Threading::ScopedMutexLock lock(_clientMutex);
+                _client = -1;
+            }
+            CLOSE_SOCKET( client );
+        }
+    }
+}
+
+void
+StatsServer::handle(int client)
+{
+    // Read (and ignore) the request; every path gets the stats.
+    char request[4096];
+    int received = ::recv(client, request, sizeof(request), 0);
+    if ( received <= 0 )
+        return;
+
+    std::ostringstream body;
+    StatsRegistry::instance()->writePrometheus( body );
+    std::string content = body.str();
+
+    std::ostringstream response;
+    response
+        << "HTTP/1.0 200 OK\r\n"
+        << "Content-Type: text/plain; version=0.0.4\r\n"
+        << "Content-Length: " << content.size() << "\r\n"
+        << "Connection: close\r\n"
+        << "\r\n"
+        << content;
+
+    std::string data = response.str();
+    const char* ptr = data.c_str();
+    int remaining = (int)data.size();
+    while ( remaining > 0 )
+    {
+        int sent = ::send(client, ptr, remaining, 0);
+        if ( sent <= 0 )
+            break;
+        ptr += sent;
+        remaining -= sent;
+    }
+}
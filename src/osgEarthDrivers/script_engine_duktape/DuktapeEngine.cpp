@@ -193,7 +193,36 @@ namespace
 
         duk_pop(ctx); 
     }
-    
+
+    // Evaluates a code snippet (as eval code, like duk_peval_string) leaving the
+    // result, or the error on failure, on top of the stack. Each snippet is
+    // compiled once per context and the function is cached in the heap stash,
+    // so repeated calls skip parsing and compiling.
+    bool evalCached(duk_context* ctx, const std::string& code)
+    {
+        duk_push_heap_stash(ctx);                                 // [stash]
+        duk_push_lstring(ctx, code.data(), code.size());          // [stash, code]
+        if ( duk_get_prop(ctx, -2) && duk_is_function(ctx, -1) )  // [stash, fn]
+        {
+            duk_remove(ctx, -2);                                  // [fn]
+        }
+        else
+        {
+            duk_pop(ctx);                                         // [stash]
+            if ( duk_pcompile_lstring(ctx, DUK_COMPILE_EVAL, code.data(), code.size()) != 0 )
+            {
+                duk_remove(ctx, -2);                              // [error]
+                return false;
+            }
+            // [stash, fn]
+            duk_push_lstring(ctx, code.data(), code.size());      // [stash, fn, code]
+            duk_dup(ctx, -2);                                     // [stash, fn, code, fn]
+            duk_put_prop(ctx, -4);                                // [stash, fn]
+            duk_remove(ctx, -2);                                  // [fn]
+        }
+
+        return duk_pcall(ctx, 0) == 0;                            // [result]
+    }
 }
 
 //............................................................................
@@ -266,6 +295,15 @@ DuktapeEngine::~DuktapeEngine()
     //nop
 }
 
+DuktapeEngine::Context&
+DuktapeEngine::getContext(bool complete)
+{
+    // cache the Context on a per-thread basis
+    Context& c = _contexts.get();
+    c.initialize( _options, complete );
+    return c;
+}
+
 ScriptResult
 DuktapeEngine::run(const std::string&   code,
                    Feature const*       feature,
@@ -280,13 +318,43 @@ DuktapeEngine::run(const std::string&   code,
     // brand new context every time
     Context c;
     c.initialize( _options, complete );
-    duk_context* ctx = c._ctx;
+    return run( c, code, feature, complete );
 #else
-    // cache the Context on a per-thread basis
-    Context& c = _contexts.get();
-    c.initialize( _options, complete );
-    duk_context* ctx = c._ctx;
+    return run( getContext(complete), code, feature, complete );
 #endif
+}
+
+void
+DuktapeEngine::runBatch(const std::string&   code,
+                        const FeatureList&   features,
+                        std::vector<ScriptResult>& results,
+                        FilterContext const* context)
+{
+    if (code.empty())
+    {
+        results.resize( results.size() + features.size(), ScriptResult(EMPTY_STRING, false, "Script is empty.") );
+        return;
+    }
+
+    bool complete = (getProfile() == "full");
+
+    // one context lookup and one compile for the whole batch.
+    Context& c = getContext(complete);
+
+    results.reserve( results.size() + features.size() );
+    for( FeatureList::const_iterator i = features.begin(); i != features.end(); ++i )
+    {
+        results.push_back( run(c, code, i->get(), complete) );
+    }
+}
+
+ScriptResult
+DuktapeEngine::run(Context&           c,
+                   const std::string& code,
+                   Feature const*     feature,
+                   bool               complete)
+{
+    duk_context* ctx = c._ctx;
 
 	if ( feature && feature != c._feature.get() )
     {
@@ -301,7 +369,7 @@ DuktapeEngine::run(const std::string&   code,
     // message instead of the return value.
     std::string resultString;
 
-    bool ok = (duk_peval_string(ctx, code.c_str()) == 0); // [ "result" ]
+    bool ok = evalCached(ctx, code); // [ "result" ]
     const char* resultVal = duk_to_string(ctx, -1);
     if ( resultVal )
         resultString = resultVal;
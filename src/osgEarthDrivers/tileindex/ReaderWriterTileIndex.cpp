@@ -24,6 +24,7 @@
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/URI>
+#include <osgEarth/ThreadingUtils>
 
 #include <osgEarthUtil/TileIndex>
 
@@ -35,6 +36,8 @@
 #include <osgDB/ImageOptions>
 
 #include <sstream>
+#include <map>
+#include <set>
 #include <stdlib.h>
 #include <memory.h>
 
@@ -44,6 +47,9 @@
 
 #define LC "[TileIndex driver] "
 
+// How long to wait before trying again to open a file that failed.
+#define FAILED_OPEN_RETRY_SECONDS 60.0
+
 using namespace std;
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
@@ -62,6 +68,7 @@ public:
     Status initialize( const osgDB::Options* dbOptions )
     {
         _dbOptions = Registry::instance()->cloneOrCreateOptions(dbOptions);
+        _tileSourceCache.setMaxSize( _options.maxOpenFiles().get() );
         if ( _options.url().isSet() )
         {
             _index = TileIndex::load( _options.url()->full() );        
@@ -89,41 +96,9 @@ public:
         for (unsigned int i = 0; i < files.size(); i++)
         {            
             osg::ref_ptr< TileSource> source;
-            {
-                //Try to get the TileSource from the cache
-                TileSourceCache::Record record;
-                if (_tileSourceCache.get( files[i], record ))
-                {
-                    source = record.value().get();                    
-                }
-                else
-                {
-                    // Couldn't get it from the cache so open it.                    
-                    GDALOptions opt;
-                    opt.url() = files[i];
-                    //Just force it to render so we don't have to worry about falling back
-                    opt.maxDataLevelOverride() = 23;           
-                    //Disable the l2 cache so that we don't run out of RAM so easily.
-                    opt.L2CacheSize() = 0;
-
-                    start = osg::Timer::instance()->tick();
-                    source = osgEarth::TileSourceFactory::create( opt );                               
-                    Status compStatus = source->open();
-                    if (compStatus.isOK())
-                    {
-                        _tileSourceCache.insert( files[i], source.get() );                                                
-                    }
-                    else
-                    {
-                        OE_WARN << "Failed to open " << files[i] << std::endl;
-                    }
-                    end = osg::Timer::instance()->tick();
-                    //OE_NOTICE << "init took " << osg::Timer::instance()->delta_m( start, end) << "ms" << std::endl;
-                }               
-            }
+            if (!getSource( files[i], source ))
+                continue;
 
-            
-            
             start = osg::Timer::instance()->tick();
             osg::ref_ptr< osg::Image > image = source->createImage( key);
             end = osg::Timer::instance()->tick();
@@ -150,10 +125,95 @@ public:
         return result;
     }
 
-    //std::map< std::string, osg::ref_ptr< TileSource> > _tileSourceCache;
+    /**
+     * Gets an opened source for a file from the shared pool, opening it if
+     * necessary. Concurrent requests for the same file wait for one open
+     * instead of each opening the dataset, and files that fail to open are
+     * not retried until FAILED_OPEN_RETRY_SECONDS have passed.
+     */
+    bool getSource(const std::string& file, osg::ref_ptr< TileSource >& output)
+    {
+        TileSourceCache::Record record;
+        if (_tileSourceCache.get( file, record ))
+        {
+            output = record.value().get();
+            return true;
+        }
+
+        const double now = osg::Timer::instance()->time_s();
+        {
+            Threading::ScopedMutexLock lock( _failedMutex );
+            FailedOpens::iterator f = _failed.find( file );
+            if (f != _failed.end())
+            {
+                if (now - f->second < FAILED_OPEN_RETRY_SECONDS)
+                    return false;
+                _failed.erase( f );
+            }
+        }
+
+        osg::ref_ptr< TileSource > source;
+        Threading::SingleFlight< std::string, osg::ref_ptr<TileSource> >::Scope flight( _opensInFlight, file, source );
+        if (flight.isLeader())
+        {
+            // it may have been opened and pooled while we were joining the flight.
+            if (_tileSourceCache.get( file, record ))
+            {
+                source = record.value().get();
+            }
+            else
+            {
+                source = openFile( file );
+                if (source.valid())
+                {
+                    _tileSourceCache.insert( file, source.get() );
+                }
+                else
+                {
+                    Threading::ScopedMutexLock lock( _failedMutex );
+                    _failed[file] = now;
+                }
+            }
+        }
+
+        output = source.get();
+        return output.valid();
+    }
+
+    // Opens a GDAL source for one file in the index, or returns NULL.
+    TileSource* openFile(const std::string& file)
+    {
+        GDALOptions opt;
+        opt.url() = file;
+        //Just force it to render so we don't have to worry about falling back
+        opt.maxDataLevelOverride() = 23;           
+        //Disable the l2 cache so that we don't run out of RAM so easily.
+        opt.L2CacheSize() = 0;
+
+        osg::Timer_t start = osg::Timer::instance()->tick();
+        osg::ref_ptr< TileSource > source = osgEarth::TileSourceFactory::create( opt );
+        Status compStatus = source.valid() ? source->open() : Status::Error("No GDAL driver");
+        osg::Timer_t end = osg::Timer::instance()->tick();
+        OE_DEBUG << LC << "open took " << osg::Timer::instance()->delta_m( start, end) << "ms" << std::endl;
+
+        if (!compStatus.isOK())
+        {
+            OE_WARN << LC << "Failed to open " << file << std::endl;
+            return 0L;
+        }
+        return source.release();
+    }
+
     typedef LRUCache< std::string, osg::ref_ptr< TileSource> > TileSourceCache;
     TileSourceCache _tileSourceCache;
 
+    Threading::SingleFlight< std::string, osg::ref_ptr<TileSource> > _opensInFlight;
+
+    // files that failed to open, and when.
+    typedef std::map< std::string, double > FailedOpens;
+    FailedOpens      _failed;
+    Threading::Mutex _failedMutex;
+
     osg::ref_ptr< TileIndex > _index;
     TileIndexOptions _options;
     osg::ref_ptr<osgDB::Options> _dbOptions;
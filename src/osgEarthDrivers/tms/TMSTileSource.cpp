@@ -22,6 +22,7 @@
 #include "TMSTileSource"
 #include <osgEarth/ImageUtils>
 #include <osgEarth/FileUtils>
+#include <osgEarth/Cache>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 
@@ -113,7 +114,8 @@ TMSTileSource::initialize(const osgDB::Options* dbOptions)
     else
     {
         // Attempt to read the tile map parameters from a TMS TileMap XML tile on the server:
-        _tileMap = TMS::TileMapReaderWriter::read( tmsURI.full(), _dbOptions.get() );
+        osg::ref_ptr<osgDB::Options> metadataOptions = CacheSettings::createMetadataReadOptions( _dbOptions.get() );
+        _tileMap = TMS::TileMapReaderWriter::read( tmsURI.full(), metadataOptions.get() );
 
         if (!_tileMap.valid())
         {
@@ -245,6 +247,12 @@ TMSTileSource::createImage(const TileKey&    key,
     return 0;
 }
 
+bool
+TMSTileSource::hasStoredTile(const TileKey& key)
+{
+    return _tileMap.valid() && osgDB::fileExists( _tileMap->getURL(key, _invertY) );
+}
+
 bool
 TMSTileSource::storeImage(const TileKey& key,
                           osg::Image*    image,
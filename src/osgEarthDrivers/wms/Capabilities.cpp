@@ -21,9 +21,12 @@
 
 #include <osgEarth/XmlUtils>
 #include <osgEarth/HTTPClient>
+#include <osgEarth/Cache>
+#include <osgEarth/URI>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
+#include <sstream>
 
 using namespace osgEarth;
 using namespace std;
@@ -138,10 +141,12 @@ WMSCapabilitiesReader::read( const std::string &location, const osgDB::ReaderWri
     WMSCapabilities *caps = NULL;
     if ( osgDB::containsServerAddress( location ) )
     {
-        HTTPResponse response = HTTPClient::get( location, options );
-        if ( response.isOK() && response.getNumParts() > 0 )
+        osg::ref_ptr<osgDB::Options> readOptions = CacheSettings::createMetadataReadOptions( options );
+        ReadResult r = URI( location ).readString( readOptions.get() );
+        if ( r.succeeded() )
         {
-            caps = read( response.getPartStream( 0 ) );
+            std::istringstream buf( r.getString() );
+            caps = read( buf );
         }
     }
     else
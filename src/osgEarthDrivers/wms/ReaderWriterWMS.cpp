@@ -24,6 +24,7 @@
 #include <osgEarth/XmlUtils>
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Containers>
+#include <osgEarth/TaskService>
 #include <osgEarthUtil/WMS>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -50,17 +51,30 @@ using namespace osgEarth::Drivers;
 
 namespace
 {
+    // Latest simulation time seen by any of a source's sequences, so the
+    // frame prefetcher knows which frames are about to play.
+    struct Playhead : public osg::Referenced
+    {
+        Playhead() : _simTime(0.0) { }
+        volatile double _simTime;
+    };
+
     // All looping ImageSequences deriving from this class will be in sync due to
     // a shared reference time.
     struct SyncImageSequence : public osg::ImageSequence
     {
-        SyncImageSequence() : osg::ImageSequence() { }
+        SyncImageSequence(Playhead* playhead) : osg::ImageSequence(), _playhead(playhead) { }
 
         virtual void update(osg::NodeVisitor* nv)
         {
+            if ( _playhead.valid() && nv && nv->getFrameStamp() )
+                _playhead->_simTime = nv->getFrameStamp()->getSimulationTime();
+
             setReferenceTime( 0.0 );
             osg::ImageSequence::update( nv );
         }
+
+        osg::ref_ptr<Playhead> _playhead;
     };
 }
 
@@ -83,6 +97,11 @@ public:
                 _seqFrameInfoVec.push_back(SequenceFrameInfo());
                 _seqFrameInfoVec.back().timeIdentifier = _timesVec[i];
             }
+
+            if ( _timesVec.size() > 1 && _options.prefetchThreads() > 0u )
+            {
+                _prefetchService = new TaskService( "WMS-T prefetch", _options.prefetchThreads().get() );
+            }
         }
 
         // localize it since we might override them:
@@ -414,25 +433,103 @@ public:
         return image.release();
     }
 
+    /**
+     * Loads one frame of a tile's sequence in the background and swaps it
+     * into its slot. Does nothing if the tile was paged out in the meantime.
+     */
+    struct FetchFrame : public TaskRequest
+    {
+        FetchFrame(WMSSource* source, osg::ImageSequence* seq, const TileKey& key, unsigned frame, const std::string& time, float priority)
+            : TaskRequest(priority), _source(source), _seq(seq), _key(key), _frame(frame), _time(time) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            osg::ref_ptr<osg::ImageSequence> seq;
+            if ( !_seq.lock(seq) )
+                return;
+
+            ReadResult response;
+            osg::ref_ptr<osg::Image> image = _source->fetchTileImage(
+                _key, std::string("TIME=") + _time, progress, response );
+
+            // the placeholder in the slot decides the texture's layout; a frame
+            // that doesn't match it keeps the placeholder.
+            osg::Image* placeholder = seq->getImage(_frame);
+            if ( image.valid() && placeholder &&
+                 image->s() == placeholder->s() &&
+                 image->t() == placeholder->t() &&
+                 image->getPixelFormat() == placeholder->getPixelFormat() &&
+                 image->getDataType() == placeholder->getDataType() )
+            {
+                seq->setImage( _frame, image.get() );
+            }
+        }
+
+        WMSSource*                            _source;
+        osg::observer_ptr<osg::ImageSequence> _seq;
+        TileKey                               _key;
+        unsigned                              _frame;
+        std::string                           _time;
+    };
+
     /** creates a 3D image from timestamped data. */
     osg::Image* createImageSequence( const TileKey& key, ProgressCallback* progress )
     {
-        osg::ref_ptr< osg::ImageSequence > seq = new SyncImageSequence();
+        osg::ref_ptr< osg::ImageSequence > seq = new SyncImageSequence( _playhead.get() );
         
         seq->setLoopingMode( osg::ImageStream::LOOPING );
         seq->setLength( _options.secondsPerFrame().value() * (double)_timesVec.size() );
         if ( this->isSequencePlaying() )
             seq->play();
 
-        for( unsigned int r=0; r<_timesVec.size(); ++r )
+        if ( _prefetchService.valid() )
         {
-            std::string extraAttrs = std::string("TIME=") + _timesVec[r];
+            // Time-aware prefetch: load the frame that's playing right now so the
+            // tile has something to show, and put it in every slot. The other
+            // frames load in the background, soonest-to-play first, and replace
+            // their slots as they arrive.
+            unsigned numFrames = _timesVec.size();
+            unsigned current   = getFrameIndex( _playhead->_simTime );
+
+            osg::ref_ptr<osg::Image> image;
+            unsigned first = current;
+            for( unsigned i=0; i<numFrames && !image.valid(); ++i )
+            {
+                if ( progress && progress->isCanceled() )
+                    return 0L;
 
-            ReadResult response;
-            osg::ref_ptr<osg::Image> image = fetchTileImage( key, extraAttrs, progress, response );
-            if ( image.get() )
+                first = (current + i) % numFrames;
+                ReadResult response;
+                image = fetchTileImage( key, std::string("TIME=") + _timesVec[first], progress, response );
+            }
+
+            if ( image.valid() )
+            {
+                for( unsigned r=0; r<numFrames; ++r )
+                {
+                    seq->addImage( image.get() );
+                }
+
+                for( unsigned i=1; i<numFrames; ++i )
+                {
+                    unsigned frame = (first + i) % numFrames;
+                    _prefetchService->add( new FetchFrame(this, seq.get(), key, frame, _timesVec[frame], (float)i) );
+                }
+            }
+        }
+
+        else
+        {
+            for( unsigned int r=0; r<_timesVec.size(); ++r )
             {
-                seq->addImage( image );
+                std::string extraAttrs = std::string("TIME=") + _timesVec[r];
+
+                ReadResult response;
+                osg::ref_ptr<osg::Image> image = fetchTileImage( key, extraAttrs, progress, response );
+                if ( image.get() )
+                {
+                    seq->addImage( image );
+                }
             }
         }
 
@@ -540,20 +637,27 @@ public: // SequenceControl
 
     /** Index of current frame */
     int getCurrentSequenceFrameIndex( const osg::FrameStamp* fs ) const
+    {
+        return getFrameIndex( fs->getSimulationTime() );
+    }
+
+
+private:
+
+    /** Index of the frame playing at a simulation time */
+    int getFrameIndex( double simTime ) const
     {
         if ( _seqFrameInfoVec.size() == 0 )
             return 0;
 
         double len = _options.secondsPerFrame().value() * (double)_timesVec.size();
-        double t   = fmod( fs->getSimulationTime(), len ) / len;
+        double t   = fmod( simTime, len ) / len;
         return osg::clampBetween(
             (int)(t * (double)_seqFrameInfoVec.size()), 
             (int)0, 
             (int)_seqFrameInfoVec.size()-1);
     }
 
-
-private:
     const WMSOptions                 _options;
     std::string                      _formatToUse;
     std::string                      _srsToUse;
@@ -566,6 +670,10 @@ private:
     std::vector<SequenceFrameInfo>   _seqFrameInfoVec;
 
     mutable ThreadSafeObserverSet<osg::ImageSequence> _sequenceCache;
+    osg::ref_ptr<Playhead>           _playhead;
+
+    // declared last so its threads stop before anything they use goes away
+    osg::ref_ptr<TaskService>        _prefetchService;
 };
 
 
@@ -20,6 +20,7 @@
 #include "TileService"
 
 #include <osgEarth/XmlUtils>
+#include <osgEarth/Cache>
 
 #include <osg/io_utils>
 #include <osgDB/FileNameUtils>
@@ -212,7 +213,8 @@ TileServiceReader::read( const std::string &location, const osgDB::ReaderWriter:
 {
     TileService *tileService = NULL;
 
-    ReadResult r = URI(location).readString( options );
+    osg::ref_ptr<osgDB::Options> readOptions = CacheSettings::createMetadataReadOptions( options );
+    ReadResult r = URI(location).readString( readOptions.get() );
     if ( r.succeeded() )
     {
         std::istringstream buf( r.getString() );
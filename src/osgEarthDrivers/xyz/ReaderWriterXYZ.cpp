@@ -23,6 +23,7 @@
 #include <osgEarth/TileSource>
 #include <osgEarth/FileUtils>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/ImageToHeightFieldConverter>
 #include <osgEarth/Registry>
 
 #include <osg/Notify>
@@ -142,9 +143,11 @@ public:
       osg::HeightField* createHeightField( const TileKey&        key,
           ProgressCallback*     progress)
       {
-          // MapBox encoded elevation PNG.
-          // https://www.mapbox.com/blog/terrain-rgb/
-          if (_options.elevationEncoding().value() == "mapbox")
+          // RGB-encoded elevation PNGs:
+          // MapBox: https://www.mapbox.com/blog/terrain-rgb/
+          // Terrarium: https://github.com/tilezen/joerd/blob/master/docs/formats.md
+          const std::string& encoding = _options.elevationEncoding().value();
+          if (encoding == "mapbox" || encoding == "terrarium")
           {
               if (getStatus().isError())
                   return 0L;
@@ -153,23 +156,11 @@ public:
               osg::ref_ptr<osg::Image> image = createImage(key, progress);
               if (image.valid())
               {
-                  // Allocate the heightfield.
-                  hf = new osg::HeightField();
-                  hf->allocate( image->s(), image->t() );
-
-                  ImageUtils::PixelReader reader(image.get());
-                  for (unsigned int c = 0; c < image->s(); c++)
-                  {
-                      for (unsigned int r = 0; r < image->t(); r++)
-                      {
-                          osg::Vec4 pixel = reader(c, r);
-                          pixel.r() *= 255.0;
-                          pixel.g() *= 255.0;
-                          pixel.b() *= 255.0;
-                          float h = -10000.0f + ((pixel.r() * 256.0f * 256.0f + pixel.g() * 256.0f + pixel.b()) * 0.1f);
-                          hf->setHeight(c, r, h);
-                      }
-                  }
+                  ImageToHeightFieldConverter conv;
+                  conv.setEncoding( encoding == "mapbox" ?
+                      ImageToHeightFieldConverter::ENCODING_MAPBOX :
+                      ImageToHeightFieldConverter::ENCODING_TERRARIUM );
+                  hf = conv.convert( image.get() );
               }
               return hf;        
           }
@@ -180,6 +180,14 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
     bool vertEquiv =
         featureSRS->isVertEquivalentTo( mapSRS );
 
+    // the feature SRS with the map's vertical datum, for converting resolved Z's back.
+    osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
+        SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
+
+    // scratch buffer for converting Z values a whole part at a time.
+    std::vector<osg::Vec3d> zpoints;
+    std::vector<unsigned>   zindices;
+
     for( FeatureList::iterator i = features.begin(); i != features.end(); ++i )
     {
         Feature* feature = i->get();
@@ -307,9 +315,6 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
             // and record HATs along the way.
             else if ( _altitude->clamping() == AltitudeSymbol::CLAMP_RELATIVE_TO_TERRAIN )
             {
-                osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum = !vertEquiv ?
-                    SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString()) : 0L;
-
                 if ( perVertex )
                 {
                     std::vector<float> elevations;
@@ -317,6 +322,9 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
                     
                     if ( eq.getElevations( geom->asVector(), featureSRS, elevations, _maxRes ) )
                     {
+                        zpoints.clear();
+                        zindices.clear();
+
                         for( unsigned i=0; i<geom->size(); ++i )
                         {
                             osg::Vec3d& p = (*geom)[i];
@@ -329,11 +337,12 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
                                 double hat = p.z();
                                 p.z() = elevations[i] + p.z();
 
-                                // if necessary, convert the Z value (which is now in the map's SRS) back to
-                                // the feature's SRS.
+                                // if necessary, queue the Z value (which is now in the map's SRS) for
+                                // conversion back to the feature's SRS.
                                 if ( !vertEquiv )
                                 {
-                                    featureSRSwithMapVertDatum->transform(p, featureSRS, p);
+                                    zpoints.push_back( p );
+                                    zindices.push_back( i );
                                 }
 
                                 if ( hat > maxHAT )
@@ -347,6 +356,14 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
                                     minTerrainZ = elevations[i];
                             }
                         }
+
+                        // convert the queued Z values in one batch.
+                        if ( !zpoints.empty() )
+                        {
+                            featureSRSwithMapVertDatum->transform( zpoints, featureSRS );
+                            for( unsigned k=0; k<zpoints.size(); ++k )
+                                (*geom)[zindices[k]] = zpoints[k];
+                        }
                     }
                 }
                 else // per-centroid
@@ -360,19 +377,19 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
                         double hat = p.z();
                         p.z() = centroidElevation + p.z();
 
-                        // if necessary, convert the Z value (which is now in the map's SRS) back to
-                        // the feature's SRS.
-                        if ( !vertEquiv )
-                        {
-                            featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                        }
-
                         if ( hat > maxHAT )
                             maxHAT = hat;
                         if ( hat < minHAT )
                             minHAT = hat;
                     }
 
+                    // if necessary, convert the Z values (which are now in the map's SRS) back to
+                    // the feature's SRS.
+                    if ( !vertEquiv )
+                    {
+                        featureSRSwithMapVertDatum->transform( geom->asVector(), featureSRS );
+                    }
+
                     if ( centroidElevation > maxTerrainZ )
                         maxTerrainZ = centroidElevation;
                     if ( centroidElevation < minTerrainZ )
@@ -391,31 +408,19 @@ AltitudeFilter::pushAndClamp( FeatureList& features, FilterContext& cx )
                     // into the feature's SRS.
                     if ( !vertEquiv )
                     {
-                        osg::ref_ptr<const SpatialReference> featureSRSwithMapVertDatum =
-                            SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString());
-
-                        osg::Vec3d tempgeo;
-                        for( unsigned i=0; i<geom->size(); ++i )
-                        {
-                            osg::Vec3d& p = (*geom)[i];
-                            featureSRSwithMapVertDatum->transform(p, featureSRS, p);
-                        }
+                        featureSRSwithMapVertDatum->transform( geom->asVector(), featureSRS );
                     }
                 }
                 else // per-centroid
                 {
-                    osg::ref_ptr<const SpatialReference> featureSRSWithMapVertDatum;
-                    if ( !vertEquiv )
-                        featureSRSWithMapVertDatum = SpatialReference::create(featureSRS->getHorizInitString(), mapSRS->getVertInitString());
-
                     for( unsigned i=0; i<geom->size(); ++i )
                     {
-                        osg::Vec3d& p = (*geom)[i];
-                        p.z() = centroidElevation;
-                        if ( !vertEquiv )
-                        {
-                            featureSRSWithMapVertDatum->transform(p, featureSRS, p);
-                        }
+                        (*geom)[i].z() = centroidElevation;
+                    }
+
+                    if ( !vertEquiv )
+                    {
+                        featureSRSwithMapVertDatum->transform( geom->asVector(), featureSRS );
                     }
                 }
             }
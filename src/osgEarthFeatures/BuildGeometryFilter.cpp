@@ -89,13 +89,22 @@ namespace
 
         return false;
     }
+
+    // A built polygon part waiting for subdivision (see processPolygons)
+    struct BuiltPart
+    {
+        osg::ref_ptr<osg::Geometry> _geom;
+        Feature*                    _feature;
+        osg::Vec4f                  _color;
+    };
 }
 
 BuildGeometryFilter::BuildGeometryFilter( const Style& style ) :
 _style        ( style ),
 _maxAngle_deg ( 180.0 ),
 _geoInterp    ( GEOINTERP_RHUMB_LINE ),
-_maxPolyTilingAngle_deg( 45.0f )
+_maxPolyTilingAngle_deg( 45.0f ),
+_tessellator  ( Tessellator::METHOD_FAST )
 {
     //nop
 }
@@ -119,6 +128,10 @@ BuildGeometryFilter::processPolygons(FeatureList& features, FilterContext& conte
         makeECEF   = context.getOutputSRS()->isGeographic();
     }
 
+    // parts with geometry, finished once they're all subdivided.
+    std::vector<BuiltPart>      builtParts;
+    std::vector<osg::Geometry*> greatCircleParts, rhumbLineParts;
+
     for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
     {
         Feature* input = f->get();
@@ -211,36 +224,16 @@ BuildGeometryFilter::processPolygons(FeatureList& features, FilterContext& conte
                         (*i)._v[2] = v[2];
                     }
 
-                    double threshold = osg::DegreesToRadians( *_maxAngle_deg );
-                    OE_TEST << "Running mesh subdivider with threshold " << *_maxAngle_deg << std::endl;
-
-                    MeshSubdivider ms( _world2local, _local2world );
-                    if ( input->geoInterp().isSet() )
-                        ms.run( *osgGeom, threshold, *input->geoInterp() );
+                    // subdivided below, together with the other parts.
+                    GeoInterpolation interp = input->geoInterp().isSet() ? *input->geoInterp() : *_geoInterp;
+                    if ( interp == GEOINTERP_GREAT_CIRCLE )
+                        greatCircleParts.push_back( osgGeom.get() );
                     else
-                        ms.run( *osgGeom, threshold, *_geoInterp );
+                        rhumbLineParts.push_back( osgGeom.get() );
                 }
 
-                // assign the primary color array. PER_VERTEX required in order to support
-                // vertex optimization later
-                unsigned count = osgGeom->getVertexArray()->getNumElements();
-                osg::Vec4Array* colors = new osg::Vec4Array;
-                colors->assign( count, primaryColor );
-                osgGeom->setColorArray( colors );
-                osgGeom->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
-
-                geode->addDrawable( osgGeom );
-
-                // record the geometry's primitive set(s) in the index:
-                if ( context.featureIndex() )
-                    context.featureIndex()->tagDrawable( osgGeom, input );
-
-                // install clamping attributes if necessary
-                if (_style.has<AltitudeSymbol>() &&
-                    _style.get<AltitudeSymbol>()->technique() == AltitudeSymbol::TECHNIQUE_GPU)
-                {
-                    Clamping::applyDefaultClampingAttrs( osgGeom, input->getDouble("__oe_verticalOffset", 0.0) );
-                }
+                BuiltPart built = { osgGeom, input, primaryColor };
+                builtParts.push_back( built );
             }
             else
             {
@@ -249,6 +242,45 @@ BuildGeometryFilter::processPolygons(FeatureList& features, FilterContext& conte
         }
     }
 
+    // Subdivide all the parts in one go so the subdivider can work on
+    // several of them at once.
+    if ( makeECEF )
+    {
+        double threshold = osg::DegreesToRadians( *_maxAngle_deg );
+        OE_TEST << "Running mesh subdivider with threshold " << *_maxAngle_deg << std::endl;
+
+        MeshSubdivider ms( _world2local, _local2world );
+        ms.run( greatCircleParts, threshold, GEOINTERP_GREAT_CIRCLE );
+        ms.run( rhumbLineParts,   threshold, GEOINTERP_RHUMB_LINE );
+    }
+
+    for( std::vector<BuiltPart>::iterator i = builtParts.begin(); i != builtParts.end(); ++i )
+    {
+        osg::Geometry* osgGeom = i->_geom.get();
+        Feature*       input   = i->_feature;
+
+        // assign the primary color array. PER_VERTEX required in order to support
+        // vertex optimization later
+        unsigned count = osgGeom->getVertexArray()->getNumElements();
+        osg::Vec4Array* colors = new osg::Vec4Array;
+        colors->assign( count, i->_color );
+        osgGeom->setColorArray( colors );
+        osgGeom->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
+
+        geode->addDrawable( osgGeom );
+
+        // record the geometry's primitive set(s) in the index:
+        if ( context.featureIndex() )
+            context.featureIndex()->tagDrawable( osgGeom, input );
+
+        // install clamping attributes if necessary
+        if (_style.has<AltitudeSymbol>() &&
+            _style.get<AltitudeSymbol>()->technique() == AltitudeSymbol::TECHNIQUE_GPU)
+        {
+            Clamping::applyDefaultClampingAttrs( osgGeom, input->getDouble("__oe_verticalOffset", 0.0) );
+        }
+    }
+
     OE_TEST << LC << "Num drawables = " << geode->getNumDrawables() << "\n";
     return geode;
 }
@@ -352,11 +384,56 @@ BuildGeometryFilter::processPolygonizedLines(FeatureList&   features,
 }
 
 
+#define MAX_LINE_BATCH_VERTS 65536u
+
+void
+BuildGeometryFilter::finishLineBatch(osg::Geometry*    batch,
+                                     const LineSymbol* line,
+                                     bool              makeECEF,
+                                     osg::Geode*       geode)
+{
+    if ( !batch || batch->getNumPrimitiveSets() == 0 )
+        return;
+
+    // same subdivision rule as for individual parts (see processLines).
+    if ( makeECEF && line && !line->tessellation().isSetTo(0) && !line->tessellationSize().isSet() )
+    {
+        double threshold = osg::DegreesToRadians( *_maxAngle_deg );
+        MeshSubdivider ms( _world2local, _local2world );
+        ms.run( *batch, threshold, *_geoInterp );
+    }
+
+    geode->addDrawable( batch );
+}
+
 osg::Geode*
 BuildGeometryFilter::processLines(FeatureList& features, FilterContext& context)
 {
     osg::Geode* geode = new osg::Geode();
 
+    // Parts that need no drawable of their own (no name, no index tag, no per-feature
+    // style or interpolation, no clamping attributes) are appended straight into
+    // shared vertex/color arrays, one drawable per MAX_LINE_BATCH_VERTS, instead of
+    // each creating a Geometry that the merge step then has to copy again.
+    bool gpuClamping =
+        _style.has<AltitudeSymbol>() &&
+        _style.get<AltitudeSymbol>()->technique() == AltitudeSymbol::TECHNIQUE_GPU;
+
+    bool canBatch = !_featureNameExpr.isSet() && !context.featureIndex() && !gpuClamping;
+
+    const LineSymbol* batchLine = _style.get<LineSymbol>();
+    osg::ref_ptr<osg::Geometry> batch;
+    osg::Vec3Array* batchVerts  = 0L;
+    osg::Vec4Array* batchColors = 0L;
+    unsigned        remainingPoints = 0;
+
+    if ( canBatch )
+    {
+        for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f )
+            if ( f->get()->getGeometry() )
+                remainingPoints += f->get()->getGeometry()->getTotalPointCount();
+    }
+
     bool makeECEF = false;
     const SpatialReference* featureSRS = 0L;
     const SpatialReference* outputSRS = 0L;
@@ -389,6 +466,12 @@ BuildGeometryFilter::processLines(FeatureList& features, FilterContext& context)
             input->eval( temp, &context );
         }
 
+        bool batched =
+            canBatch &&
+            line == batchLine &&
+            !input->style().isSet() &&
+            !input->geoInterp().isSet();
+
         GeometryIterator parts( input->getGeometry(), true );
         while( parts.hasMore() )
         {
@@ -398,6 +481,39 @@ BuildGeometryFilter::processLines(FeatureList& features, FilterContext& context)
             if ( part->size() < 2 )
                 continue;
 
+            if ( batched )
+            {
+                if ( !batch.valid() || batchVerts->size() + part->size() > MAX_LINE_BATCH_VERTS )
+                {
+                    finishLineBatch( batch.get(), batchLine, makeECEF, geode );
+
+                    batch = new osg::Geometry();
+                    batch->setUseVertexBufferObjects( true );
+                    batch->setUseDisplayList( false );
+
+                    // reserve up front; appending a part only reserves exactly what it needs.
+                    batchVerts = new osg::Vec3Array();
+                    batchVerts->reserve( osg::maximum( osg::minimum(remainingPoints, MAX_LINE_BATCH_VERTS), (unsigned)part->size() ) );
+                    batch->setVertexArray( batchVerts );
+
+                    batchColors = new osg::Vec4Array();
+                    batchColors->reserve( batchVerts->capacity() );
+                    batch->setColorArray( batchColors );
+                    batch->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
+                }
+
+                GLenum primMode = dynamic_cast<Ring*>(part) ? GL_LINE_LOOP : GL_LINE_STRIP;
+                unsigned first = batchVerts->size();
+
+                transformAndLocalize( part->asVector(), featureSRS, batchVerts, outputSRS, _world2local, makeECEF );
+
+                batch->addPrimitiveSet( new osg::DrawArrays(primMode, first, batchVerts->size() - first) );
+                batchColors->resize( batchVerts->size(), line->stroke()->color() );
+
+                remainingPoints = remainingPoints > part->size() ? remainingPoints - part->size() : 0u;
+                continue;
+            }
+
             // collect all the pre-transformation HAT (Z) values.
             osg::ref_ptr<osg::FloatArray> hats = new osg::FloatArray();
             hats->reserve( part->size() );
@@ -474,6 +590,8 @@ BuildGeometryFilter::processLines(FeatureList& features, FilterContext& context)
         }
     }
 
+    finishLineBatch( batch.get(), batchLine, makeECEF, geode );
+
     return geode;
 }
 
@@ -623,9 +741,9 @@ void convertToDrawElementsUInt(osg::Geometry* geometry)
  * Tesselates an osg::Geometry using the osgEarth tesselator.
  * If it fails, fall back to the osgUtil tesselator.
  */
-bool tesselateGeometry(osg::Geometry* geometry)
+bool tesselateGeometry(osg::Geometry* geometry, Tessellator::Method method)
 {
-    osgEarth::Tessellator oeTess;
+    osgEarth::Tessellator oeTess( method );
     if ( !oeTess.tessellateGeometry(*geometry) )
     {
         osgUtil::Tessellator tess;
@@ -847,7 +965,7 @@ BuildGeometryFilter::tileAndBuildPolygon(Geometry*               ring,
             if ( temp->getNumPrimitiveSets() > 0 )
             {
                 // Tesselate the polygon while the coordinates are still in the LTP
-                if (tesselateGeometry( temp.get() ))
+                if (tesselateGeometry( temp.get(), *_tessellator ))
                 {
                     osg::Vec3Array* verts = static_cast<osg::Vec3Array*>(temp->getVertexArray());
                     if ( verts->getNumElements() > 0 )
@@ -931,6 +1049,11 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
     osg::ref_ptr<osg::Vec3Array> allPoints = new osg::Vec3Array();
     transformAndLocalize( ring->asVector(), featureSRS, allPoints.get(), outputSRS, world2local, makeECEF );
 
+    // the fast tessellator bridges holes itself, so they are passed along as
+    // separate loops; otherwise splice each one into the outer loop here.
+    bool bridgeHoles = *_tessellator != Tessellator::METHOD_FAST;
+    std::vector< osg::ref_ptr<osg::Vec3Array> > holeLoops;
+
     Polygon* poly = dynamic_cast<Polygon*>(ring);
     if ( poly )
     {
@@ -947,6 +1070,12 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
                 osg::ref_ptr<osg::Vec3Array> holePoints = new osg::Vec3Array();
                 transformAndLocalize( hole->asVector(), featureSRS, holePoints.get(), outputSRS, world2local, makeECEF );
 
+                if ( !bridgeHoles )
+                {
+                    holeLoops.push_back( holePoints.get() );
+                    continue;
+                }
+
                 // find the point with the highest x value
                 unsigned int hCursor = 0;
                 for (unsigned int i=1; i < holePoints->size(); i++)
@@ -1082,6 +1211,13 @@ BuildGeometryFilter::buildPolygon(Geometry*               ring,
         std::copy(allPoints->begin(), allPoints->end(), std::back_inserter(*v));
     }
 
+    for( unsigned h = 0; h < holeLoops.size(); ++h )
+    {
+        osg::Vec3Array* v = static_cast<osg::Vec3Array*>(osgGeom->getVertexArray());
+        osgGeom->addPrimitiveSet( new osg::DrawArrays( mode, v->size(), holeLoops[h]->size() ) );
+        v->insert( v->end(), holeLoops[h]->begin(), holeLoops[h]->end() );
+    }
+
     //// Normal computation.
     //// Not completely correct, but better than no normals at all. TODO: update this
     //// to generate a proper normal vector in ECEF mode.
@@ -74,13 +74,8 @@ CropFilter::push( FeatureList& input, FilterContext& context )
         }
     }
 
-    else // METHOD_CROPPING (requires GEOS)
+    else // METHOD_CROPPING
     {
-#ifdef OSGEARTH_HAVE_GEOS
-
-        // create the intersection polygon:
-        osg::ref_ptr<Symbology::Polygon> poly;
-        
         for( FeatureList::iterator i = input.begin(); i != input.end();  )
         {
             bool keepFeature = false;
@@ -103,20 +98,12 @@ CropFilter::push( FeatureList& input, FilterContext& context )
                     newExtent.expandToInclude( bounds );
                 }
 
-                // then move on to the cropping operation:
+                // then move on to the cropping operation. The extent is a rectangle, so
+                // most features are cropped directly without going through GEOS:
                 else
                 {
-                    if ( !poly.valid() )
-                    {
-                        poly = new Symbology::Polygon();
-                        poly->push_back( osg::Vec3d( extent.xMin(), extent.yMin(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMax(), extent.yMin(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMax(), extent.yMax(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMin(), extent.yMax(), 0 ));
-                    }
-
                     osg::ref_ptr<Geometry> croppedGeometry;
-                    if ( featureGeom->crop( poly.get(), croppedGeometry ) )
+                    if ( featureGeom->crop( extent.bounds(), croppedGeometry ) )
                     {
                         if ( croppedGeometry->isValid() )
                         {
@@ -133,13 +120,6 @@ CropFilter::push( FeatureList& input, FilterContext& context )
             else
                 i = input.erase( i );
         }  
-
-#else // OSGEARTH_HAVE_GEOS
-
-        OE_WARN << "CropFilter - METHOD_CROPPING not available - please compile osgEarth with GEOS" << std::endl;
-        return context;
-
-#endif
     }
 
     FilterContext newContext = context;
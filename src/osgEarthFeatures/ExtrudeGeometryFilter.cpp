@@ -76,6 +76,8 @@ namespace
 
 ExtrudeGeometryFilter::ExtrudeGeometryFilter() :
 _mergeGeometry         ( true ),
+_tessellator           ( Tessellator::METHOD_FAST ),
+_useTextureArrays      ( false ),
 _wallAngleThresh_deg   ( 60.0 ),
 _styleDirty            ( true ),
 _makeStencilVolume     ( false ),
@@ -96,6 +98,8 @@ ExtrudeGeometryFilter::reset( const FilterContext& context )
 {
     _cosWallAngleThresh = cos( _wallAngleThresh_deg );
     _geodes.clear();
+    _drawablesToTag.clear();
+    _featuresToTag.clear();
     
     if ( _styleDirty )
     {
@@ -510,12 +514,19 @@ ExtrudeGeometryFilter::buildWallGeometry(const Structure&     structure,
                                          osg::Geometry*       walls,
                                          const osg::Vec4&     wallColor,
                                          const osg::Vec4&     wallBaseColor,
-                                         const SkinResource*  wallSkin)
+                                         const SkinResource*  wallSkin,
+                                         int                  wallSkinLayer)
 {
     bool madeGeom = true;
 
-    // 6 verts per face total (3 triangles)
-    unsigned numWallVerts = 6 * structure.getNumPoints();
+    // 4 verts per face (one quad, drawn as 2 indexed triangles). The two
+    // triangles share the roof-left and base-right corners, which carry
+    // identical attributes, so nothing is lost over 6 separate verts.
+    unsigned numFaces = 0;
+    for(Elevations::const_iterator e = structure.elevations.begin(); e != structure.elevations.end(); ++e)
+        numFaces += e->faces.size();
+
+    unsigned numWallVerts = 4 * numFaces;
 
     double texWidthM   = wallSkin ? *wallSkin->imageWidth()  : 1.0;
     double texHeightM  = wallSkin ? *wallSkin->imageHeight() : 1.0;
@@ -529,6 +540,14 @@ ExtrudeGeometryFilter::buildWallGeometry(const Structure&     structure,
         bias.set (wallSkin->imageBiasS().get(),  wallSkin->imageBiasT().get());
         scale.set(wallSkin->imageScaleS().get(), wallSkin->imageScaleT().get());
         layer = (float)wallSkin->imageLayer().get();
+
+        // the skin has a texture array layer all to itself.
+        if ( wallSkinLayer >= 0 )
+        {
+            bias.set(0.0f, 0.0f);
+            scale.set(1.0f, 1.0f);
+            layer = (float)wallSkinLayer;
+        }
     }
 
     // create all the OSG geometry components
@@ -576,19 +595,17 @@ ExtrudeGeometryFilter::buildWallGeometry(const Structure&     structure,
                                     (osg::DrawElements*) new osg::DrawElementsUByte ( GL_TRIANGLES );
 
         // pre-allocate for speed
-        de->reserveElements( numWallVerts );
+        de->reserveElements( 6 * elev->faces.size() );
 
         walls->addPrimitiveSet( de );
 
-        for(Faces::const_iterator f = elev->faces.begin(); f != elev->faces.end(); ++f, vertptr+=6)
+        for(Faces::const_iterator f = elev->faces.begin(); f != elev->faces.end(); ++f, vertptr+=4)
         {
-            // set the 6 wall verts.
+            // set the 4 wall verts: roof-left, base-left, base-right, roof-right.
             (*verts)[vertptr+0] = f->left.roof;
             (*verts)[vertptr+1] = f->left.base;
             (*verts)[vertptr+2] = f->right.base;
-            (*verts)[vertptr+3] = f->right.base;
-            (*verts)[vertptr+4] = f->right.roof;
-            (*verts)[vertptr+5] = f->left.roof;
+            (*verts)[vertptr+3] = f->right.roof;
             
             if ( anchors )
             {
@@ -596,19 +613,16 @@ ExtrudeGeometryFilter::buildWallGeometry(const Structure&     structure,
 
                 (*anchors)[vertptr+1].set( x, y, vo, Clamping::ClampToGround );
                 (*anchors)[vertptr+2].set( x, y, vo, Clamping::ClampToGround );
-                (*anchors)[vertptr+3].set( x, y, vo, Clamping::ClampToGround );
 
                 if ( flatten )
                 {
                     (*anchors)[vertptr+0].set( x, y, vo, Clamping::ClampToAnchor );
-                    (*anchors)[vertptr+4].set( x, y, vo, Clamping::ClampToAnchor );
-                    (*anchors)[vertptr+5].set( x, y, vo, Clamping::ClampToAnchor );
+                    (*anchors)[vertptr+3].set( x, y, vo, Clamping::ClampToAnchor );
                 }
                 else
                 {                    
                     (*anchors)[vertptr+0].set( x, y, vo + f->left.height,  Clamping::ClampToGround );
-                    (*anchors)[vertptr+4].set( x, y, vo + f->right.height, Clamping::ClampToGround );
-                    (*anchors)[vertptr+5].set( x, y, vo + f->left.height,  Clamping::ClampToGround );
+                    (*anchors)[vertptr+3].set( x, y, vo + f->right.height, Clamping::ClampToGround );
                 }
             }
 
@@ -618,9 +632,7 @@ ExtrudeGeometryFilter::buildWallGeometry(const Structure&     structure,
                 (*colors)[vertptr+0] = wallColor;
                 (*colors)[vertptr+1] = wallBaseColor;
                 (*colors)[vertptr+2] = wallBaseColor;
-                (*colors)[vertptr+3] = wallBaseColor;
-                (*colors)[vertptr+4] = wallColor;
-                (*colors)[vertptr+5] = wallColor;
+                (*colors)[vertptr+3] = wallColor;
             }
 
             // Calculate texture coordinates:
@@ -653,15 +665,16 @@ ExtrudeGeometryFilter::buildWallGeometry(const Structure&     structure,
                 (*tex)[vertptr+0].set( texRoofL.x(), texRoofL.y(), layer );
                 (*tex)[vertptr+1].set( texBaseL.x(), texBaseL.y(), layer );
                 (*tex)[vertptr+2].set( texBaseR.x(), texBaseR.y(), layer );
-                (*tex)[vertptr+3].set( texBaseR.x(), texBaseR.y(), layer );
-                (*tex)[vertptr+4].set( texRoofR.x(), texRoofR.y(), layer );
-                (*tex)[vertptr+5].set( texRoofL.x(), texRoofL.y(), layer );
+                (*tex)[vertptr+3].set( texRoofR.x(), texRoofR.y(), layer );
             }
 
-            for(int i=0; i<6; ++i)
-            {
-                de->addElement( vertptr+i );
-            }
+            // same two triangles (and winding) as before: RL-BL-BR, BR-RR-RL.
+            de->addElement( vertptr+0 );
+            de->addElement( vertptr+1 );
+            de->addElement( vertptr+2 );
+            de->addElement( vertptr+2 );
+            de->addElement( vertptr+3 );
+            de->addElement( vertptr+0 );
         }
     }
     
@@ -682,8 +695,11 @@ bool
 ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
                                          osg::Geometry*       roof,
                                          const osg::Vec4&     roofColor,
-                                         const SkinResource*  roofSkin)
+                                         const SkinResource*  roofSkin,
+                                         int                  roofSkinLayer)
 {    
+    float layer = roofSkinLayer >= 0 ? (float)roofSkinLayer : 0.0f;
+
     osg::Vec3Array* verts = new osg::Vec3Array();
     roof->setVertexArray( verts );
 
@@ -730,7 +746,7 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
 
                 if ( tex )
                 {
-                    tex->push_back( osg::Vec3f(f->left.roofTexU, f->left.roofTexV, (float)0.0f) );
+                    tex->push_back( osg::Vec3f(f->left.roofTexU, f->left.roofTexV, layer) );
                 }
 
                 if ( anchors )
@@ -763,7 +779,7 @@ ExtrudeGeometryFilter::buildRoofGeometry(const Structure&     structure,
     int v = verts->size();
 
     // Tessellate the roof lines into polygons.
-    osgEarth::Tessellator oeTess;
+    osgEarth::Tessellator oeTess( _tessellator );
     if (!oeTess.tessellateGeometry(*roof))
     {
         //fallback to osg tessellator
@@ -921,7 +937,9 @@ ExtrudeGeometryFilter::addDrawable(osg::Drawable*       drawable,
 
     if ( index )
     {
-        index->tagDrawable( drawable, feature );
+        // tagged all at once after processing.
+        _drawablesToTag.push_back( drawable );
+        _featuresToTag.push_back( feature );
     }
 }
 
@@ -1061,13 +1079,24 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                     wallBaseColor = wallColor;
                 }
 
-                buildWallGeometry(structure, walls.get(), wallColor, wallBaseColor, wallSkin);
-
+                // Use the library's shared texture array if we can; failing that,
+                // get a stateset for the individual wall skin
+                int wallSkinLayer = -1;
                 if ( wallSkin )
                 {
-                    // Get a stateset for the individual wall stateset
-                    context.resourceCache()->getOrCreateStateSet(wallSkin, wallStateSet, context.getDBOptions());
+                    unsigned layer;
+                    if ( _useTextureArrays &&
+                         context.resourceCache()->getOrCreateStateSet(_wallResLib.get(), wallSkin, wallStateSet, layer, context.getDBOptions()) )
+                    {
+                        wallSkinLayer = (int)layer;
+                    }
+                    else
+                    {
+                        context.resourceCache()->getOrCreateStateSet(wallSkin, wallStateSet, context.getDBOptions());
+                    }
                 }
+
+                buildWallGeometry(structure, walls.get(), wallColor, wallBaseColor, wallSkin, wallSkinLayer);
             }
 
             // tessellate and add the roofs if necessary:
@@ -1079,13 +1108,23 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
                     roofColor = _roofPolygonSymbol->fill()->color();
                 }
 
-                buildRoofGeometry(structure, rooflines.get(), roofColor, roofSkin);
-
+                int roofSkinLayer = -1;
                 if ( roofSkin )
                 {
-                    // Get a stateset for the individual roof skin
-                    context.resourceCache()->getOrCreateStateSet(roofSkin, roofStateSet, context.getDBOptions());
+                    unsigned layer;
+                    if ( _useTextureArrays &&
+                         context.resourceCache()->getOrCreateStateSet(_roofResLib.get(), roofSkin, roofStateSet, layer, context.getDBOptions()) )
+                    {
+                        roofSkinLayer = (int)layer;
+                    }
+                    else
+                    {
+                        // Get a stateset for the individual roof skin
+                        context.resourceCache()->getOrCreateStateSet(roofSkin, roofStateSet, context.getDBOptions());
+                    }
                 }
+
+                buildRoofGeometry(structure, rooflines.get(), roofColor, roofSkin, roofSkinLayer);
             }
 
             if ( outlines.valid() )
@@ -1191,6 +1230,15 @@ ExtrudeGeometryFilter::push( FeatureList& input, FilterContext& context )
     // push all the features through the extruder.
     bool ok = process( input, context );
 
+    // tag the new drawables in the feature index.
+    if ( context.featureIndex() && !_drawablesToTag.empty() )
+    {
+        std::vector<ObjectID> oids;
+        context.featureIndex()->tagDrawables( _drawablesToTag, _featuresToTag, oids );
+    }
+    _drawablesToTag.clear();
+    _featuresToTag.clear();
+
     // parent geometry with a delocalizer (if necessary)
     osg::Group* group = createDelocalizeGroup();
     
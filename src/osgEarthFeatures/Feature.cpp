@@ -144,6 +144,91 @@ AttributeValue::getBool( bool defaultValue ) const
 
 //----------------------------------------------------------------------------
 
+// Past this many extensions, a layout forgets the ones no feature uses anymore.
+#define MAX_EXTENSIONS 256
+
+AttributeLayout::AttributeLayout(const AttributeLayout* parent, const std::string& name) :
+_parent( parent ),
+_names ( parent->_names ),
+_slots ( parent->_slots )
+{
+    _slots[name] = _names.size();
+    _names.push_back( name );
+}
+
+const AttributeLayout*
+AttributeLayout::empty()
+{
+    static osg::ref_ptr<AttributeLayout> s_empty = new AttributeLayout();
+    return s_empty.get();
+}
+
+osg::ref_ptr<const AttributeLayout>
+AttributeLayout::get(const FeatureSchema& schema)
+{
+    osg::ref_ptr<const AttributeLayout> layout = empty();
+    for(FeatureSchema::const_iterator i = schema.begin(); i != schema.end(); ++i)
+    {
+        if ( layout->find(i->first) < 0 )
+            layout = layout->extend(i->first);
+    }
+    return layout;
+}
+
+int
+AttributeLayout::find(const std::string& name) const
+{
+    Slots::const_iterator i = _slots.find(name);
+    return i != _slots.end() ? (int)i->second : -1;
+}
+
+osg::ref_ptr<const AttributeLayout>
+AttributeLayout::extend(const std::string& name) const
+{
+    Threading::ScopedMutexLock lock(_extensionsMutex);
+
+    osg::ref_ptr<AttributeLayout> layout;
+
+    Extensions::iterator i = _extensions.find(name);
+    if ( i != _extensions.end() && i->second.lock(layout) )
+        return layout.get();
+
+    if ( _extensions.size() >= MAX_EXTENSIONS )
+    {
+        for(Extensions::iterator e = _extensions.begin(); e != _extensions.end(); )
+        {
+            osg::ref_ptr<AttributeLayout> temp;
+            if ( e->second.lock(temp) )
+                ++e;
+            else
+                _extensions.erase(e++);
+        }
+    }
+
+    // The new layout keeps this one alive, so features that add the same
+    // names in the same order keep finding the same layouts.
+    layout = new AttributeLayout(this, name);
+    _extensions[name] = layout.get();
+    return layout.get();
+}
+
+//----------------------------------------------------------------------------
+
+AttributeValue&
+AttributeTable::operator[](const std::string& name)
+{
+    int slot = _layout->find(name);
+    if ( slot < 0 )
+    {
+        _layout = _layout->extend(name);
+        _values.push_back( AttributeValue() );
+        slot = _values.size()-1;
+    }
+    return _values[slot];
+}
+
+//----------------------------------------------------------------------------
+
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
 _srs( 0L )
@@ -273,41 +358,41 @@ Feature::setNull( const std::string& name, AttributeType type)
 bool
 Feature::hasAttr( const std::string& name ) const
 {
-    return _attrs.find(toLower(name)) != _attrs.end();
+    return _attrs.find(name) != _attrs.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
 }
 
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
 }
 
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
 }
 
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
 }
 
 bool
 Feature::isSet( const std::string& name) const
 {
-    AttributeTable::const_iterator i = _attrs.find(toLower(name));
+    AttributeTable::const_iterator i = _attrs.find(name);
     return i != _attrs.end()? i->second.second.set : false;
 }
 
@@ -318,7 +403,7 @@ Feature::eval( NumericExpression& expr, FilterContext const* context ) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
       double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
+      AttributeTable::const_iterator ai = _attrs.find(i->first);
       if (ai != _attrs.end())
       {
         val = ai->second.getDouble(0.0);
@@ -351,7 +436,7 @@ Feature::eval(NumericExpression& expr, Session* session) const
     for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
+        AttributeTable::const_iterator ai = _attrs.find(i->first);
         if (ai != _attrs.end())
         {
             val = ai->second.getDouble(0.0);
@@ -386,10 +471,16 @@ Feature::eval( StringExpression& expr, FilterContext const* context ) const
     const StringExpression::Variables& vars = expr.variables();
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
-      std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
+      std::string val;
+      AttributeTable::const_iterator ai = _attrs.find(i->first);
       if (ai != _attrs.end())
       {
+        if (ai->second.first == ATTRTYPE_STRING)
+        {
+          // common case: set straight from the attribute, no intermediate copy.
+          expr.set( *i, ai->second.second.stringValue );
+          continue;
+        }
         val = ai->second.getString();
       }
       else if (context && context->getSession())
@@ -418,10 +509,16 @@ Feature::eval(StringExpression& expr, Session* session) const
     const StringExpression::Variables& vars = expr.variables();
     for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
     {
-        std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
+        std::string val;
+        AttributeTable::const_iterator ai = _attrs.find(i->first);
         if (ai != _attrs.end())
         {
+            if (ai->second.first == ATTRTYPE_STRING)
+            {
+                // common case: set straight from the attribute, no intermediate copy.
+                expr.set( *i, ai->second.second.stringValue );
+                continue;
+            }
             val = ai->second.getString();
         }
         else if (session)
@@ -33,6 +33,22 @@ FeatureCursor::fill( FeatureList& list )
     }
 }
 
+unsigned
+FeatureCursor::fill( FeatureList& list, unsigned maxFeatures )
+{
+    unsigned count = 0;
+    while( count < maxFeatures && hasMore() )
+    {
+        Feature* feature = nextFeature();
+        if ( feature )
+        {
+            list.push_back( feature );
+            ++count;
+        }
+    }
+    return count;
+}
+
 //---------------------------------------------------------------------------
 
 FeatureListCursor::FeatureListCursor(const FeatureList& features) :
@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/FeatureListSource>
+#include <algorithm>
 
 using namespace osgEarth::Features;
 
@@ -39,14 +40,46 @@ FeatureListSource::createFeatureCursor( const Symbology::Query& query )
     if (getFeatureProfile() == 0L)
         setFeatureProfile(createFeatureProfile());
 
+    // A table creates fresh features for each cursor, so no copy is needed.
+    if (_table.valid() && _features.empty())
+        return _table->createFeatureCursor(query);
+
     //Create a copy of all of the features before returning the cursor.
     //The processing filters in osgEarth can modify the features as they are operating and we don't want our original data destroyed.
     FeatureList cursorFeatures;
-    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+    if ( query.bounds().isSet() )
+    {
+        // only copy the features that the spatial index says overlap the query.
+        std::vector<unsigned> slots;
+        {
+            Threading::ScopedMutexLock lock(_indexMutex);
+            syncIndex();
+            _index.query( query.bounds().get(), slots );
+            if ( !_unbounded.empty() )
+            {
+                slots.insert( slots.end(), _unbounded.begin(), _unbounded.end() );
+                std::sort( slots.begin(), slots.end() );
+            }
+            for (std::vector<unsigned>::const_iterator s = slots.begin(); s != slots.end(); ++s)
+            {
+                Feature* feature = _slots[*s].get();
+                if ( feature )
+                    cursorFeatures.push_back( new osgEarth::Features::Feature(*feature, osg::CopyOp::DEEP_COPY_ALL) );
+            }
+        }
+    }
+    else
     {
-        Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
-        cursorFeatures.push_back( feature );
-    }    
+        for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+        {
+            Feature* feature = new osgEarth::Features::Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
+            cursorFeatures.push_back( feature );
+        }    
+    }
+
+    if (_table.valid())
+        _table->toFeatureList(query, cursorFeatures);
+
     return new FeatureListCursor( cursorFeatures );
 }
 
@@ -72,6 +105,13 @@ FeatureListSource::createFeatureProfile()
         }
     }
 
+    if ( _table.valid() && _table->getBounds().isValid() )
+    {
+        if ( !srs )
+            srs = _table->getSRS();
+        bounds.expandBy( _table->getBounds() );
+    }
+
     // return the new profile, or a default extent if the profile could not be computed.
     if ( srs && bounds.isValid() )
         return new FeatureProfile( GeoExtent(srs, bounds) );
@@ -87,8 +127,42 @@ FeatureListSource::deleteFeature(FeatureID fid)
     {
         if (itr->get()->getFID() == fid)
         {
+            Threading::ScopedMutexLock lock(_indexMutex);
+            bool indexed = inSyncWith(_indexRevision);
+
+            // keep the index current rather than rebuilding it.
+            if ( indexed )
+            {
+                for(unsigned s = 0; s < _slots.size(); ++s)
+                {
+                    if ( _slots[s] == itr->get() )
+                    {
+                        _index.remove( s );
+                        _slots[s] = 0L;
+                        _unbounded.erase( std::remove(_unbounded.begin(), _unbounded.end(), s), _unbounded.end() );
+                        break;
+                    }
+                }
+                _fidSlots.erase( fid );
+            }
+
             _features.erase( itr );
             dirty();
+
+            if ( indexed )
+                sync( _indexRevision );
+
+            return true;
+        }
+    }
+
+    if ( _table.valid() )
+    {
+        int row = _table->findRow(fid);
+        if ( row >= 0 )
+        {
+            _table->remove( (unsigned)row );
+            dirty();
             return true;
         }
     }
@@ -98,6 +172,14 @@ FeatureListSource::deleteFeature(FeatureID fid)
 Feature*
 FeatureListSource::getFeature( FeatureID fid )
 {
+    {
+        Threading::ScopedMutexLock lock(_indexMutex);
+        syncIndex();
+        std::map<FeatureID, unsigned>::const_iterator i = _fidSlots.find(fid);
+        if ( i != _fidSlots.end() && _slots[i->second].valid() )
+            return _slots[i->second].get();
+    }
+
     for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr) 
     {
         if (itr->get()->getFID() == fid)
@@ -105,13 +187,87 @@ FeatureListSource::getFeature( FeatureID fid )
             return itr->get();
         }
     }
+
+    // table rows have no Feature object; hand back a fresh copy.
+    if ( _table.valid() )
+    {
+        int row = _table->findRow(fid);
+        if ( row >= 0 )
+            return _table->createFeature( (unsigned)row );
+    }
     return NULL;
 }
 
 bool FeatureListSource::insertFeature(Feature* feature)
 {
     dirtyFeatureProfile();
-    _features.push_back( feature );
-    dirty();
+    if ( _table.valid() )
+    {
+        _table->append( feature );
+        dirty();
+    }
+    else
+    {
+        Threading::ScopedMutexLock lock(_indexMutex);
+        bool indexed = inSyncWith(_indexRevision);
+        _features.push_back( feature );
+        if ( indexed )
+            addToIndex( feature );
+        dirty();
+        if ( indexed )
+            sync( _indexRevision );
+    }
     return true;
 }
+
+int
+FeatureListSource::getFeatureCount() const
+{
+    return _features.size() + (_table.valid() ? _table->size() : 0);
+}
+
+void
+FeatureListSource::setFeatureTable(FeatureTable* table)
+{
+    dirtyFeatureProfile();
+    _table = table;
+    dirty();
+}
+
+void
+FeatureListSource::addToIndex(Feature* feature)
+{
+    unsigned slot = _slots.size();
+    _slots.push_back( feature );
+
+    if ( _fidSlots.find(feature->getFID()) == _fidSlots.end() )
+        _fidSlots[feature->getFID()] = slot;
+
+    const Geometry* geom = static_cast<const Feature*>(feature)->getGeometry();
+    Bounds bounds;
+    if ( geom )
+        bounds = geom->getBounds();
+
+    if ( bounds.isValid() )
+        _index.insert( slot, bounds );
+    else
+        _unbounded.push_back( slot );
+}
+
+void
+FeatureListSource::syncIndex()
+{
+    if ( inSyncWith(_indexRevision) )
+        return;
+
+    _index.clear();
+    _slots.clear();
+    _unbounded.clear();
+    _fidSlots.clear();
+    _slots.reserve( _features.size() );
+
+    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+        addToIndex( itr->get() );
+
+    sync( _indexRevision );
+}
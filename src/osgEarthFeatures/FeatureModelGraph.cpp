@@ -21,6 +21,7 @@
 #include <osgEarthFeatures/CropFilter>
 #include <osgEarthFeatures/FeatureSourceIndexNode>
 #include <osgEarthFeatures/Session>
+#include <osgEarthFeatures/SimplifyFilter>
 
 #include <osgEarth/Map>
 #include <osgEarth/Capabilities>
@@ -30,11 +31,15 @@
 #include <osgEarth/ElevationLOD>
 #include <osgEarth/ElevationQuery>
 #include <osgEarth/FadeEffect>
+#include <osgEarth/Memory>
 #include <osgEarth/NodeUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
 #include <osgEarth/ThreadingUtils>
 
 #include <osg/CullFace>
+#include <osg/OcclusionQueryNode>
 #include <osg/PagedLOD>
 #include <osg/ProxyNode>
 #include <osg/PolygonOffset>
@@ -71,6 +76,53 @@ namespace
 
         bool useFileCache() const { return false; }
     };
+
+    // Dense tile compiles share the registry's thread budget under this UID.
+    TaskService* getFeatureCompileService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    /**
+     * One style group's features split into chunks and compiled in
+     * parallel, each chunk with its own copy of the filter context.
+     */
+    struct ChunkCompile : public ParallelJobs
+    {
+        osg::ref_ptr<FeatureNodeFactory>        _factory;
+        Style                                   _style;
+        std::vector<FeatureList>                _chunks;
+        std::vector<FilterContext>              _contexts;
+        std::vector< osg::ref_ptr<osg::Node> >  _results;
+        std::vector<char>                       _ok;
+
+        ChunkCompile(FeatureNodeFactory* factory, const Style& style, FeatureList& workingSet, const FilterContext& context, unsigned numChunks) :
+            _factory(factory), _style(style), _chunks(numChunks), _contexts(numChunks, context),
+            _results(numChunks), _ok(numChunks, 0)
+        {
+            // contiguous runs keep features that were close in the source together.
+            unsigned perChunk = (workingSet.size() + numChunks - 1) / numChunks;
+            unsigned c = 0u;
+            for (FeatureList::iterator i = workingSet.begin(); i != workingSet.end(); ++i)
+            {
+                if (_chunks[c].size() >= perChunk && c+1 < numChunks)
+                    ++c;
+                _chunks[c].push_back(i->get());
+            }
+        }
+
+        void runJob(unsigned i)
+        {
+            osg::ref_ptr<FeatureCursor> cursor = new FeatureListCursor(_chunks[i]);
+            _ok[i] = _factory->createOrUpdateNode(cursor.get(), _style, _contexts[i], _results[i]) ? 1 : 0;
+        }
+
+        void run(TaskService* service)
+        {
+            ParallelJobs::run(_chunks.size(), service);
+        }
+    };
 }
 
 //---------------------------------------------------------------------------
@@ -140,6 +192,10 @@ namespace
         options->setFileLocationCallback( flc );
         p->setDatabaseOptions( options );
 
+        // have the pager build KdTrees for the tile on its own thread, for picking.
+        if ( layout.pickIndex() == true )
+            options->setBuildKdTreesHint( osgDB::Options::BUILD_KDTREES );
+
         // so we can find the FMG instance in the pseudoloader.
         //TODO: fix
         options->getOrCreateUserDataContainer()->addUserObject(fmg);
@@ -292,6 +348,8 @@ FeatureModelGraph::ctor()
     // So we can pass it to the pseudoloader
     setName(USER_OBJECT_NAME);
 
+    _cacheKeyHash.exchange(0u);
+
     // an FLC that queues feature data on the high-latency thread.
     _defaultFileLocationCallback = new HighLatencyFileLocationCallback();
 
@@ -796,6 +854,10 @@ FeatureModelGraph::load(unsigned lod, unsigned tileX, unsigned tileY,
     // Done - run the pre-merge operations.
     runPreMergeOperations(result);
 
+    // account for the tile until the pager expires it. Subtiles aren't loaded
+    // yet, so each tile only counts its own data.
+    Memory::charge( Memory::FEATURE_TILES, result, Memory::estimateSize(result) );
+
     return result;
 }
 
@@ -893,18 +955,23 @@ FeatureModelGraph::buildSubTilePagedLODs(unsigned        parentLOD,
 
 namespace
 {
+    // Compiled tiles depend on the tile, the level's style, the whole stylesheet
+    // and the state of the feature source, so all of them go into the key.
     std::string makeCacheKey(const FeatureLevel& level,
                              const GeoExtent& extent,
-                             const TileKey* key)
+                             const TileKey* key,
+                             unsigned salt)
     {
         if (key)
         {
-            return key->str();
+            return Stringify()
+                << key->str() << "_"
+                << std::hex << osgEarth::hashString(Stringify() << level.styleName().get() << salt);
         }
         else
         {
             return Stringify() << osgEarth::hashString(
-                Stringify() << extent.toString() << level.styleName().get());
+                Stringify() << extent.toString() << level.styleName().get() << salt);
         }
     }
 }
@@ -1004,8 +1071,12 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
     osg::ref_ptr<osg::Group> group;
 
     // Try to read it from a cache:
-    std::string cacheKey = makeCacheKey(level, extent, key);
-    group = readTileFromCache(cacheKey, readOptions);
+    std::string cacheKey;
+    if (_options.nodeCaching() == true)
+    {
+        cacheKey = makeCacheKey(level, extent, key, (unsigned)_cacheKeyHash);
+        group = readTileFromCache(cacheKey, readOptions);
+    }
     
     // Not there? Build it
     if (!group.valid())
@@ -1042,40 +1113,35 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
 
         query.setMap(_session->createMapFrame());// _session->getMap() );
 
+        osg::ref_ptr<StylePlan> plan = getStylePlan();
+
         // does the level have a style name set?
         if ( level.styleName().isSet() )
         {
+            StylePlan::Level resolved;
+            std::map<std::string, StylePlan::Level>::const_iterator i = plan->_levels.find( *level.styleName() );
+            if ( i != plan->_levels.end() )
+                resolved = i->second;
+            else
+                plan->resolveLevel( *level.styleName(), resolved );
+
             osg::Node* node = 0L;
-            const Style* style = _session->styles()->getStyle( *level.styleName(), false );
-            if ( style )
+            if ( resolved._style.isSet() )
             {
                 // found a specific style to use.
-                node = createStyleGroup( *style, query, index, readOptions );
+                node = createStyleGroup( *resolved._style, query, index, readOptions );
                 if ( node )
                     group->addChild( node );
             }
-            else
+            else if ( resolved._selector )
             {
-                const StyleSelector* selector = _session->styles()->getSelector( *level.styleName() );
-                if ( selector )
-                {
-                    buildStyleGroups( selector, query, index, group.get(), readOptions );
-                }
+                buildStyleGroups( resolved._selector, resolved._selectorStyle, plan.get(), query, index, group.get(), readOptions );
             }
         }
 
         else
         {
-            Style defaultStyle;
-
-            if ( _session->styles()->selectors().size() == 0 )
-            {
-                // attempt to glean the style from the feature source name:
-                defaultStyle = *_session->styles()->getStyle( 
-                    *_session->getFeatureSource()->getFeatureSourceOptions().name() );
-            }
-
-            osg::Node* node = build(defaultStyle, query, extent, index, readOptions);
+            osg::Node* node = build(plan.get(), query, extent, index, readOptions);
             if ( node )
                 group->addChild( node );
         }
@@ -1089,6 +1155,18 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
 
     if ( group->getNumChildren() > 0 )
     {
+        // Draw the tile only if its bounds passed an occlusion query recently.
+        // Query results lag by a frame or more, so a tile coming out from behind
+        // a ridge can take a frame to appear.
+        if ( _options.occlusionCulling() == true && Registry::capabilities().supportsOcclusionQuery() )
+        {
+            osg::OcclusionQueryNode* oqn = new osg::OcclusionQueryNode();
+            oqn->setQueriesEnabled( true );
+            oqn->setVisibilityThreshold( 1u );
+            oqn->addChild( group.get() );
+            group = oqn;
+        }
+
         // account for a min-range here. Do not address the max-range here; that happens
         // above when generating paged LOD nodes, etc.
         float minRange = level.minRange().get();
@@ -1136,7 +1214,7 @@ FeatureModelGraph::buildTile(const FeatureLevel& level,
 
 
 osg::Group*
-FeatureModelGraph::build(const Style&          defaultStyle, 
+FeatureModelGraph::build(StylePlan*            plan, 
                          const Query&          baseQuery, 
                          const GeoExtent&      workingExtent,
                          FeatureIndexBuilder*  index,
@@ -1196,13 +1274,14 @@ FeatureModelGraph::build(const Style&          defaultStyle,
     // case: features are externally styled.
     else
     {
-        const StyleSheet* styles = _session->styles();
+        const StyleSheet* styles = plan->_styles.get();
 
         // if the stylesheet has selectors, use them to sort the features into style groups. Then create
         // a create a node for each style group.
         if ( styles->selectors().size() > 0 )
         {
-            for( StyleSelectorList::const_iterator i = styles->selectors().begin(); i != styles->selectors().end(); ++i )
+            unsigned s = 0;
+            for( StyleSelectorList::const_iterator i = styles->selectors().begin(); i != styles->selectors().end(); ++i, ++s )
             {
                 // pull the selected style...
                 const StyleSelector& sel = *i;
@@ -1216,15 +1295,14 @@ FeatureModelGraph::build(const Style&          defaultStyle,
                     combinedQuery.setMap(_session->createMapFrame());// _session->getMap() );
 
                     // query, sort, and add each style group to th parent:
-                    queryAndSortIntoStyleGroups( combinedQuery, *sel.styleExpression(), index, group, readOptions );
+                    queryAndSortIntoStyleGroups( combinedQuery, *sel.styleExpression(), plan, index, group, readOptions );
                 }
 
                 // otherwise, all feature returned by this query will have the same style:
                 else if ( !_useTiledSource )
                 {
-                    // combine the selection style with the incoming base style:
-                    Style selectedStyle = *styles->getStyle( sel.getSelectedStyleName() );
-                    Style combinedStyle = defaultStyle.combineWith( selectedStyle );
+                    // the selection style, already combined with the base style:
+                    const Style& combinedStyle = s < plan->_selectorStyles.size() ? plan->_selectorStyles[s] : plan->_defaultStyle;
 
                     // .. and merge it's query into the existing query
                     Query combinedQuery = baseQuery.combineWith( *sel.query() );
@@ -1252,13 +1330,8 @@ FeatureModelGraph::build(const Style&          defaultStyle,
         // if no selectors are present, render all the features with a single style.
         else
         {
-            Style combinedStyle = defaultStyle;
-
-            // if there's no base style defined, choose a "default" style from the stylesheet.
-            if ( defaultStyle.empty() )
-                combinedStyle = *styles->getDefaultStyle();
-
-            osg::Group* styleGroup = createStyleGroup( combinedStyle, baseQuery, index, readOptions );
+            // the base style, or the stylesheet's "default" style if there's no base style.
+            osg::Group* styleGroup = createStyleGroup( plan->_fallbackStyle, baseQuery, index, readOptions );
 
             if ( styleGroup && !group->containsNode(styleGroup) )
                 group->addChild( styleGroup );
@@ -1284,6 +1357,8 @@ FeatureModelGraph::createOrUpdateNode(FeatureCursor*           cursor,
  */
 void
 FeatureModelGraph::buildStyleGroups(const StyleSelector*  selector,
+                                    const Style&          selectedStyle,
+                                    StylePlan*            plan,
                                     const Query&          baseQuery,
                                     FeatureIndexBuilder*  index,
                                     osg::Group*           parent,
@@ -1300,24 +1375,18 @@ FeatureModelGraph::buildStyleGroups(const StyleSelector*  selector,
         combinedQuery.setMap(_session->createMapFrame());// _session->getMap() );
 
         // query, sort, and add each style group to the parent:
-        queryAndSortIntoStyleGroups( combinedQuery, *selector->styleExpression(), index, parent, readOptions );
+        queryAndSortIntoStyleGroups( combinedQuery, *selector->styleExpression(), plan, index, parent, readOptions );
     }
 
     // otherwise, all feature returned by this query will have the same style:
     else
     {
-        // combine the selection style with the incoming base style:
-        const Style* selectedStyle = _session->styles()->getStyle(selector->getSelectedStyleName());
-        Style style;
-        if ( selectedStyle )
-            style = *selectedStyle;
-
         // .. and merge it's query into the existing query
         Query combinedQuery = baseQuery.combineWith( *selector->query() );
         combinedQuery.setMap(_session->createMapFrame());// _session->getMap() );
 
         // then create the node.
-        osg::Node* node = createStyleGroup(style, combinedQuery, index, readOptions);
+        osg::Node* node = createStyleGroup(selectedStyle, combinedQuery, index, readOptions);
         if ( node && !parent->containsNode(node) )
             parent->addChild( node );
     }
@@ -1334,6 +1403,7 @@ FeatureModelGraph::buildStyleGroups(const StyleSelector*  selector,
 void
 FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
                                                const StringExpression& styleExpr,
+                                               StylePlan*              plan,
                                                FeatureIndexBuilder*    index,
                                                osg::Group*             parent,
                                                const osgDB::Options*   readOptions)
@@ -1377,26 +1447,7 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
 
         // resolve the style:
         Style combinedStyle;
-
-        // if the style string begins with an open bracket, it's an inline style definition.
-        if ( styleString.length() > 0 && styleString.at(0) == '{' )
-        {
-            Config conf( "style", styleString );
-            conf.setReferrer( styleExpr.uriContext().referrer() );
-            conf.set( "type", "text/css" );
-            combinedStyle = Style(conf);
-        }
-
-        // otherwise, look up the style in the stylesheet. Do NOT fall back on a default
-        // style in this case: for style expressions, the user must be explicity about 
-        // default styling; this is because there is no other way to exclude unwanted
-        // features.
-        else
-        {
-            const Style* selectedStyle = _session->styles()->getStyle(styleString, false);
-            if ( selectedStyle )
-                combinedStyle = *selectedStyle;
-        }
+        plan->resolveExpression( styleString, styleExpr.uriContext(), combinedStyle );
 
         // if there is a valid style, create the node and add it. (Otherwise we will skip
         // the feature.)
@@ -1410,6 +1461,66 @@ FeatureModelGraph::queryAndSortIntoStyleGroups(const Query&            query,
 }
 
 
+// Past this many entries the simplified geometry cache starts over.
+#define MAX_SIMPLIFIED_GEOMETRIES 8192
+
+void
+FeatureModelGraph::simplify(FeatureList&     workingSet,
+                            const GeoExtent& tileExtent)
+{
+    // tolerance in pixels -> tolerance in the units of the tile extent,
+    // taking the tile to be 512 pixels across.
+    double tolerance = _options.layout()->simplify().get() * tileExtent.width() / 512.0;
+    if ( tolerance <= 0.0 )
+        return;
+
+    for( FeatureList::iterator i = workingSet.begin(); i != workingSet.end(); ++i )
+    {
+        Feature* feature = i->get();
+        const Geometry* geom = feature ? feature->getGeometry() : 0L;
+        if ( !geom || geom->getType() == Geometry::TYPE_POINTSET )
+            continue;
+
+        // features without an ID can't be told apart, so don't cache them.
+        FeatureID fid = feature->getFID();
+        std::pair<FeatureID,double> key( fid, tolerance );
+        int numPoints = geom->getTotalPointCount();
+        Bounds bounds = geom->getBounds();
+
+        if ( fid != 0 )
+        {
+            Threading::ScopedMutexLock lock( _simplifiedMutex );
+            SimplifiedGeometryCache::const_iterator c = _simplified.find( key );
+            if ( c != _simplified.end() && c->second._inputPoints == numPoints && c->second._inputBounds == bounds )
+            {
+                // the rest of the filter chain edits geometry in place.
+                feature->setGeometry( c->second._geom->clone() );
+                continue;
+            }
+        }
+
+        osg::ref_ptr<Geometry> simplified = SimplifyFilter::simplify( geom, tolerance );
+
+        if ( fid == 0 )
+        {
+            feature->setGeometry( simplified.get() );
+        }
+        else
+        {
+            feature->setGeometry( simplified->clone() );
+
+            Threading::ScopedMutexLock lock( _simplifiedMutex );
+            if ( _simplified.size() >= MAX_SIMPLIFIED_GEOMETRIES )
+                _simplified.clear();
+
+            SimplifiedGeometry& entry = _simplified[key];
+            entry._geom = simplified.get();
+            entry._inputPoints = numPoints;
+            entry._inputBounds = bounds;
+        }
+    }
+}
+
 osg::Group*
 FeatureModelGraph::createStyleGroup(const Style&          style, 
                                     FeatureList&          workingSet, 
@@ -1422,6 +1533,13 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
 
     FilterContext context(contextPrototype);
 
+    // Simplify to the level's resolution before cropping, so every tile a
+    // feature touches sees the same shape and the tile edges line up.
+    if ( _options.layout().isSet() && _options.layout()->simplify().isSet() && context.extent().isSet() )
+    {
+        simplify( workingSet, *context.extent() );
+    }
+
     // First Crop the feature set to the working extent.
     // Note: There is an obscure edge case that can happen is a feature's centroid
     // falls exactly on the crop extent boundary. In that case the feature can
@@ -1450,8 +1568,36 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
         context = crop2.push( workingSet, context );
     }
 
+    // dense tiles: compile chunks of the working set in parallel. Not when
+    // indexing features though; the index builder isn't thread-safe.
+    unsigned threshold = _options.parallelCompileThreshold().get();
+    if ( threshold > 0u && workingSet.size() >= 2u*threshold && context.featureIndex() == 0L )
+    {
+        TaskService* service = getFeatureCompileService();
+        unsigned numChunks = osg::minimum( (unsigned)workingSet.size()/threshold, (unsigned)service->getNumThreads()+1u );
+
+        osg::ref_ptr<ChunkCompile> compile = new ChunkCompile( _factory.get(), style, workingSet, context, numChunks );
+        compile->run( service );
+
+        for(unsigned i = 0; i < numChunks; ++i)
+        {
+            if ( compile->_ok[i] != 0 )
+            {
+                if ( !styleGroup )
+                    styleGroup = getOrCreateStyleGroupFromFactory( style );
+
+                if ( compile->_results[i].valid() )
+                    styleGroup->addChild( compile->_results[i].get() );
+            }
+        }
+
+        // a helper task may still hold the compile; don't leave our nodes in it.
+        compile->_results.clear();
+        compile->_chunks.clear();
+    }
+
     // finally, compile the features into a node.
-    if ( workingSet.size() > 0 )
+    else if ( workingSet.size() > 0 )
     {
         osg::ref_ptr<osg::Node> node;
         osg::ref_ptr<FeatureCursor> newCursor = new FeatureListCursor(workingSet);
@@ -1495,13 +1641,43 @@ FeatureModelGraph::createStyleGroup(const Style&          style,
 
         FilterContext context( _session.get(), featureProfile, GeoExtent(featureProfile->getSRS(), cellBounds), index );
 
-        // start by culling our feature list to the working extent. By default, this is done by
-        // checking feature centroids. But the user can override this to crop feature geometry to
-        // the cell boundaries.
-        FeatureList workingSet;
-        cursor->fill( workingSet );
+        unsigned batchSize = _options.featureBatchSize().get();
+        if ( batchSize > 0u )
+        {
+            // stream the query result through the filters and compiler in bounded
+            // batches, so only one batch of raw features is in memory at a time.
+            FeatureList batch;
+            osg::ref_ptr<osg::Group> merged;
+            while( cursor->fill(batch, batchSize) > 0u )
+            {
+                osg::ref_ptr<osg::Group> batchGroup = createStyleGroup(style, batch, context, readOptions);
+                batch.clear();
+
+                if ( !batchGroup.valid() )
+                    continue;
+
+                if ( !merged.valid() )
+                {
+                    merged = batchGroup.get();
+                }
+                else if ( batchGroup.get() != merged.get() )
+                {
+                    for(unsigned i = 0; i < batchGroup->getNumChildren(); ++i)
+                        merged->addChild( batchGroup->getChild(i) );
+                }
+            }
+            styleGroup = merged.release();
+        }
+        else
+        {
+            // start by culling our feature list to the working extent. By default, this is done by
+            // checking feature centroids. But the user can override this to crop feature geometry to
+            // the cell boundaries.
+            FeatureList workingSet;
+            cursor->fill( workingSet );
 
-        styleGroup = createStyleGroup(style, workingSet, context, readOptions);
+            styleGroup = createStyleGroup(style, workingSet, context, readOptions);
+        }
     }
 
 
@@ -1747,6 +1923,28 @@ FeatureModelGraph::redraw()
     // clear it out
     removeChildren( 0, getNumChildren() );
 
+    // re-resolve styles in case the stylesheet was edited in place.
+    {
+        Threading::ScopedMutexLock lock( _stylePlanMutex );
+        _stylePlan = 0L;
+    }
+
+    // the features may have changed.
+    {
+        Threading::ScopedMutexLock lock( _simplifiedMutex );
+        _simplified.clear();
+    }
+
+    // cached tiles built from an older stylesheet or source revision no longer apply.
+    if ( _options.nodeCaching() == true && _session->getFeatureSource() )
+    {
+        Revision sourceRev;
+        _session->getFeatureSource()->sync( sourceRev );
+        _cacheKeyHash.exchange( hashString( Stringify()
+            << (_session->styles() ? _session->styles()->getConfig().toJSON() : std::string())
+            << "_" << (int)sourceRev ) );
+    }
+
     // initialize the index if necessary.
     if ( _options.featureIndexing()->enabled() == true )
     {
@@ -1832,3 +2030,118 @@ FeatureModelGraph::setStyles( StyleSheet* styles )
     _session->setStyles( styles );
     dirty();
 }
+
+osg::ref_ptr<FeatureModelGraph::StylePlan>
+FeatureModelGraph::getStylePlan()
+{
+    const StyleSheet* styles = _session->styles();
+
+    Threading::ScopedMutexLock lock( _stylePlanMutex );
+
+    if ( _stylePlan.valid() && _stylePlan->_styles.get() == styles && styles->inSyncWith(_stylePlan->_revision) )
+        return _stylePlan;
+
+    osg::ref_ptr<StylePlan> plan = new StylePlan();
+    plan->_styles = styles;
+    styles->sync( plan->_revision );
+
+    if ( styles->selectors().size() == 0 )
+    {
+        // attempt to glean the style from the feature source name:
+        const Style* style = styles->getStyle( *_session->getFeatureSource()->getFeatureSourceOptions().name() );
+        if ( style )
+            plan->_defaultStyle = *style;
+    }
+
+    // if there's no base style defined, choose a "default" style from the stylesheet.
+    plan->_fallbackStyle = plan->_defaultStyle;
+    if ( plan->_defaultStyle.empty() && styles->getDefaultStyle() )
+        plan->_fallbackStyle = *styles->getDefaultStyle();
+
+    for( StyleSelectorList::const_iterator i = styles->selectors().begin(); i != styles->selectors().end(); ++i )
+    {
+        const Style* selectedStyle = styles->getStyle( i->getSelectedStyleName() );
+        plan->_selectorStyles.push_back( plan->_defaultStyle.combineWith( selectedStyle ? *selectedStyle : Style() ) );
+    }
+
+    for( unsigned lod = 0; lod < _lodmap.size(); ++lod )
+    {
+        const FeatureLevel* level = _lodmap[lod];
+        if ( level && level->styleName().isSet() && plan->_levels.find(*level->styleName()) == plan->_levels.end() )
+        {
+            plan->resolveLevel( *level->styleName(), plan->_levels[*level->styleName()] );
+        }
+    }
+
+    OE_DEBUG << LC << "Resolved styles for " << plan->_levels.size() << " level(s) and "
+        << plan->_selectorStyles.size() << " selector(s)\n";
+
+    _stylePlan = plan.get();
+    return _stylePlan;
+}
+
+void
+FeatureModelGraph::StylePlan::resolveLevel(const std::string& styleName, Level& out) const
+{
+    const Style* style = _styles->getStyle( styleName, false );
+    if ( style )
+    {
+        out._style = *style;
+    }
+    else
+    {
+        out._selector = _styles->getSelector( styleName );
+        if ( out._selector )
+        {
+            const Style* selectedStyle = _styles->getStyle( out._selector->getSelectedStyleName() );
+            if ( selectedStyle )
+                out._selectorStyle = *selectedStyle;
+        }
+    }
+}
+
+// Expressions can produce any number of distinct strings (inline styles
+// built from attribute values, say), so the resolved results are capped.
+#define MAX_EXPRESSION_STYLES 4096
+
+void
+FeatureModelGraph::StylePlan::resolveExpression(const std::string& styleString,
+                                                const URIContext&  uriContext,
+                                                Style&             out)
+{
+    std::string key = uriContext.referrer() + '\n' + styleString;
+    {
+        Threading::ScopedMutexLock lock( _expressionStylesMutex );
+        std::map<std::string, Style>::const_iterator i = _expressionStyles.find( key );
+        if ( i != _expressionStyles.end() )
+        {
+            out = i->second;
+            return;
+        }
+    }
+
+    // if the style string begins with an open bracket, it's an inline style definition.
+    if ( styleString.length() > 0 && styleString.at(0) == '{' )
+    {
+        Config conf( "style", styleString );
+        conf.setReferrer( uriContext.referrer() );
+        conf.set( "type", "text/css" );
+        out = Style(conf);
+    }
+
+    // otherwise, look up the style in the stylesheet. Do NOT fall back on a default
+    // style in this case: for style expressions, the user must be explicity about 
+    // default styling; this is because there is no other way to exclude unwanted
+    // features.
+    else
+    {
+        const Style* selectedStyle = _styles->getStyle( styleString, false );
+        if ( selectedStyle )
+            out = *selectedStyle;
+    }
+
+    Threading::ScopedMutexLock lock( _expressionStylesMutex );
+    if ( _expressionStyles.size() >= MAX_EXPRESSION_STYLES )
+        _expressionStyles.clear();
+    _expressionStyles[key] = out;
+}
@@ -39,10 +39,13 @@ FeatureModelOptions::FeatureModelOptions(const ConfigOptions& co) :
 _lit               ( true ),
 _maxGranularity_deg( 1.0 ),
 _clusterCulling    ( true ),
+_occlusionCulling  ( false ),
 _backfaceCulling   ( true ),
 _alphaBlending     ( true ),
 _sessionWideResourceCache( true ),
-_nodeCaching(false)
+_nodeCaching(false),
+_parallelCompileThreshold( 0u ),
+_featureBatchSize( 0u )
 {
     fromConfig(co.getConfig());
 }
@@ -62,9 +65,12 @@ FeatureModelOptions::fromConfig(const Config& conf)
     conf.getIfSet( "lighting",         _lit );
     conf.getIfSet( "max_granularity",  _maxGranularity_deg );
     conf.getIfSet( "cluster_culling",  _clusterCulling );
+    conf.getIfSet( "occlusion_culling", _occlusionCulling );
     conf.getIfSet( "backface_culling", _backfaceCulling );
     conf.getIfSet( "alpha_blending",   _alphaBlending );
     conf.getIfSet( "node_caching",     _nodeCaching );
+    conf.getIfSet( "parallel_compile_threshold", _parallelCompileThreshold );
+    conf.getIfSet( "feature_batch_size", _featureBatchSize );
     
     conf.getIfSet( "session_wide_resource_cache", _sessionWideResourceCache );
 }
@@ -84,9 +90,12 @@ FeatureModelOptions::getConfig() const
     conf.set( "lighting",         _lit );
     conf.set( "max_granularity",  _maxGranularity_deg );
     conf.set( "cluster_culling",  _clusterCulling );
+    conf.set( "occlusion_culling", _occlusionCulling );
     conf.set( "backface_culling", _backfaceCulling );
     conf.set( "alpha_blending",   _alphaBlending );
     conf.set( "node_caching",     _nodeCaching );
+    conf.set( "parallel_compile_threshold", _parallelCompileThreshold );
+    conf.set( "feature_batch_size", _featureBatchSize );
     
     conf.set( "session_wide_resource_cache", _sessionWideResourceCache );
 
@@ -118,9 +127,12 @@ FeatureModelSourceOptions::fromConfig( const Config& conf )
     conf.getIfSet( "lighting",         _lit );
     conf.getIfSet( "max_granularity",  _maxGranularity_deg );
     conf.getIfSet( "cluster_culling",  _clusterCulling );
+    conf.getIfSet( "occlusion_culling", _occlusionCulling );
     conf.getIfSet( "backface_culling", _backfaceCulling );
     conf.getIfSet( "alpha_blending",   _alphaBlending );
     conf.getIfSet( "node_caching",     _nodeCaching );
+    conf.getIfSet( "parallel_compile_threshold", _parallelCompileThreshold );
+    conf.getIfSet( "feature_batch_size", _featureBatchSize );
     
     conf.getIfSet( "session_wide_resource_cache", _sessionWideResourceCache );
 }
@@ -146,9 +158,12 @@ FeatureModelSourceOptions::getConfig() const
     conf.set( "lighting",         _lit );
     conf.set( "max_granularity",  _maxGranularity_deg );
     conf.set( "cluster_culling",  _clusterCulling );
+    conf.set( "occlusion_culling", _occlusionCulling );
     conf.set( "backface_culling", _backfaceCulling );
     conf.set( "alpha_blending",   _alphaBlending );
     conf.set( "node_caching",     _nodeCaching );
+    conf.set( "parallel_compile_threshold", _parallelCompileThreshold );
+    conf.set( "feature_batch_size", _featureBatchSize );
     
     conf.set( "session_wide_resource_cache", _sessionWideResourceCache );
 
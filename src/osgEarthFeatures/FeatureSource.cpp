@@ -20,10 +20,12 @@
 #include <osgEarthFeatures/ResampleFilter>
 #include <osgEarthFeatures/BufferFilter>
 #include <osgEarthFeatures/ConvertTypeFilter>
+#include <osgEarthFeatures/FeatureTable>
 #include <osgEarth/Registry>
 #include <osg/Notify>
 #include <osgDB/ReadFile>
 #include <OpenThreads/ScopedLock>
+#include <sstream>
 
 #define LC "[FeatureSource] "
 
@@ -195,6 +197,73 @@ FeatureSource::applyFilters(FeatureList& features, const GeoExtent& extent) cons
     }
 }
 
+namespace
+{
+    std::string featureCacheKey(const FeatureSource* source, const std::string& key)
+    {
+        Revision rev;
+        source->sync( rev );
+        return Stringify() << "features/" << key << "/rev" << (int)rev;
+    }
+}
+
+bool
+FeatureSource::readFeaturesFromCache(const std::string& key,
+                                     const osgDB::Options* readOptions,
+                                     FeatureList& output) const
+{
+    CacheSettings* cacheSettings = CacheSettings::get( readOptions );
+    if ( !cacheSettings || !cacheSettings->isCacheEnabled() || !cacheSettings->cachePolicy()->isCacheReadable() )
+        return false;
+
+    CacheBin* bin = cacheSettings->getCacheBin();
+    if ( !bin )
+        return false;
+
+    ReadResult r = bin->readString( featureCacheKey(this, key), readOptions );
+    if ( r.failed() || cacheSettings->cachePolicy()->isExpired(r.lastModifiedTime()) )
+        return false;
+
+    std::istringstream in( r.getString(), std::ios_base::in | std::ios_base::binary );
+    osg::ref_ptr<FeatureTable> table = FeatureTable::read( in );
+    if ( !table.valid() )
+    {
+        OE_WARN << LC << "Discarding unreadable cached features for \"" << key << "\"" << std::endl;
+        return false;
+    }
+
+    for(unsigned row = 0; row < table->size(); ++row)
+    {
+        if ( !isBlacklisted(table->getFID(row)) )
+            output.push_back( table->createFeature(row) );
+    }
+
+    return true;
+}
+
+bool
+FeatureSource::writeFeaturesToCache(const std::string& key,
+                                    const FeatureList& features,
+                                    const osgDB::Options* writeOptions) const
+{
+    CacheSettings* cacheSettings = CacheSettings::get( writeOptions );
+    if ( !cacheSettings || !cacheSettings->isCacheEnabled() || !cacheSettings->cachePolicy()->isCacheWriteable() )
+        return false;
+
+    CacheBin* bin = cacheSettings->getCacheBin();
+    if ( !bin )
+        return false;
+
+    osg::ref_ptr<FeatureTable> table = FeatureTable::create( features );
+
+    std::ostringstream out( std::ios_base::out | std::ios_base::binary );
+    if ( !table->write(out) )
+        return false;
+
+    osg::ref_ptr<StringObject> data = new StringObject( out.str() );
+    return bin->write( featureCacheKey(this, key), data.get(), writeOptions );
+}
+
 //------------------------------------------------------------------------
 
 #undef  LC
@@ -134,6 +134,29 @@ FeatureSourceIndexNode::tagNode(osg::Node* node, Feature* feature)
     return r ? r->_oid : OSGEARTH_OBJECTID_EMPTY;
 }
 
+void
+FeatureSourceIndexNode::tagDrawables(const std::vector<osg::Drawable*>& drawables,
+                                     const std::vector<Feature*>&       features,
+                                     std::vector<ObjectID>&             output)
+{
+    if ( !_index.valid() )
+    {
+        output.resize( output.size() + std::min(drawables.size(), features.size()), OSGEARTH_OBJECTID_EMPTY );
+        return;
+    }
+
+    std::vector<RefIDPair*> pairs;
+    _index->tagDrawables( drawables, features, pairs );
+
+    output.reserve( output.size() + pairs.size() );
+    for(unsigned i=0; i<pairs.size(); ++i)
+    {
+        RefIDPair* r = pairs[i];
+        if ( r ) _fids[ r->_fid ] = r;
+        output.push_back( r ? r->_oid : OSGEARTH_OBJECTID_EMPTY );
+    }
+}
+
 bool
 FeatureSourceIndexNode::getAllFIDs(std::vector<FeatureID>& output) const
 {
@@ -474,6 +497,62 @@ FeatureSourceIndex::tagNode(osg::Node* node, Feature* feature)
     return p;
 }
 
+void
+FeatureSourceIndex::tagDrawables(const std::vector<osg::Drawable*>& drawables,
+                                 const std::vector<Feature*>&       features,
+                                 std::vector<RefIDPair*>&           output)
+{
+    unsigned count = std::min(drawables.size(), features.size());
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    // find the features that are not in the index yet (once each, since
+    // a feature usually owns several drawables):
+    std::vector<Feature*> newFeatures;
+    std::set<FeatureID>   newFIDs;
+    for(unsigned i=0; i<count; ++i)
+    {
+        Feature* feature = features[i];
+        if ( feature && _fids.find(feature->getFID()) == _fids.end() && newFIDs.insert(feature->getFID()).second )
+        {
+            newFeatures.push_back( feature );
+        }
+    }
+
+    // register them with the master index in one go:
+    if ( !newFeatures.empty() )
+    {
+        std::vector<osg::Referenced*> owners( newFeatures.size(), this );
+        std::vector<ObjectID> oids( newFeatures.size() );
+        _masterIndex->insert( owners.begin(), owners.end(), oids.begin() );
+
+        for(unsigned i=0; i<newFeatures.size(); ++i)
+        {
+            FeatureID fid = newFeatures[i]->getFID();
+            _fids[fid] = new RefIDPair( fid, oids[i] );
+            _oids[oids[i]] = fid;
+
+            if ( _embed )
+            {
+                _embeddedFeatures[fid] = newFeatures[i];
+            }
+        }
+    }
+
+    // tag the drawables:
+    output.reserve( output.size() + count );
+    for(unsigned i=0; i<count; ++i)
+    {
+        RefIDPair* p = 0L;
+        if ( features[i] )
+        {
+            p = _fids[ features[i]->getFID() ].get();
+            _masterIndex->tagDrawable( drawables[i], p->_oid );
+        }
+        output.push_back( p );
+    }
+}
+
 Feature*
 FeatureSourceIndex::getFeature(ObjectID oid) const
 {
@@ -0,0 +1,248 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureSpatialIndex>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+#define NODE_CAPACITY     16u
+#define MIN_REPACK_EDITS 256u
+
+namespace
+{
+    template<typename T>
+    struct LessCenterX {
+        bool operator()(const T& a, const T& b) const {
+            return a._box._xmin + a._box._xmax < b._box._xmin + b._box._xmax;
+        }
+    };
+
+    template<typename T>
+    struct LessCenterY {
+        bool operator()(const T& a, const T& b) const {
+            return a._box._ymin + a._box._ymax < b._box._ymin + b._box._ymax;
+        }
+    };
+
+    // Sort-tile-recursive ordering: sort by x, cut into vertical slices,
+    // sort each slice by y. Consecutive runs of NODE_CAPACITY items then
+    // make compact nodes.
+    template<typename T>
+    void strSort(std::vector<T>& items)
+    {
+        unsigned numNodes  = (items.size() + NODE_CAPACITY - 1) / NODE_CAPACITY;
+        unsigned numSlices = (unsigned)ceil(sqrt((double)numNodes));
+        unsigned sliceSize = numSlices * NODE_CAPACITY;
+
+        std::sort(items.begin(), items.end(), LessCenterX<T>());
+        for(unsigned i = 0; i < items.size(); i += sliceSize)
+        {
+            unsigned end = std::min(i + sliceSize, (unsigned)items.size());
+            std::sort(items.begin()+i, items.begin()+end, LessCenterY<T>());
+        }
+    }
+}
+
+void
+FeatureSpatialIndex::Box::expandBy(const Box& rhs)
+{
+    _xmin = std::min(_xmin, rhs._xmin);
+    _ymin = std::min(_ymin, rhs._ymin);
+    _xmax = std::max(_xmax, rhs._xmax);
+    _ymax = std::max(_ymax, rhs._ymax);
+}
+
+FeatureSpatialIndex::FeatureSpatialIndex()
+{
+    //nop
+}
+
+void
+FeatureSpatialIndex::clear()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    _entries.clear();
+    _levels.clear();
+    _pending.clear();
+    _removed.clear();
+}
+
+void
+FeatureSpatialIndex::insert(unsigned id, const Bounds& bounds)
+{
+    if ( !bounds.isValid() )
+        return;
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    // re-inserting a removed ID: fold the removal in first so the
+    // old entry doesn't come back to life.
+    if ( _removed.find(id) != _removed.end() )
+        pack();
+
+    Entry e;
+    e._box._xmin = bounds.xMin();
+    e._box._ymin = bounds.yMin();
+    e._box._xmax = bounds.xMax();
+    e._box._ymax = bounds.yMax();
+    e._id = id;
+    _pending.push_back( e );
+}
+
+void
+FeatureSpatialIndex::remove(unsigned id)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    for(std::vector<Entry>::iterator i = _pending.begin(); i != _pending.end(); ++i)
+    {
+        if ( i->_id == id )
+        {
+            _pending.erase( i );
+            return;
+        }
+    }
+    _removed.insert( id );
+}
+
+unsigned
+FeatureSpatialIndex::size() const
+{
+    Threading::ScopedMutexLock lock(_mutex);
+    return _entries.size() + _pending.size() - _removed.size();
+}
+
+void
+FeatureSpatialIndex::pack() const
+{
+    // gather the live entries.
+    std::vector<Entry> entries;
+    entries.reserve( _entries.size() + _pending.size() );
+    for(std::vector<Entry>::const_iterator i = _entries.begin(); i != _entries.end(); ++i)
+    {
+        if ( _removed.empty() || _removed.find(i->_id) == _removed.end() )
+            entries.push_back( *i );
+    }
+    entries.insert( entries.end(), _pending.begin(), _pending.end() );
+    _pending.clear();
+    _removed.clear();
+
+    _levels.clear();
+    strSort( entries );
+    _entries.swap( entries );
+
+    if ( _entries.empty() )
+        return;
+
+    // leaves
+    _levels.push_back( std::vector<Node>() );
+    for(unsigned i = 0; i < _entries.size(); i += NODE_CAPACITY)
+    {
+        Node n;
+        n._first = i;
+        n._count = std::min(NODE_CAPACITY, (unsigned)_entries.size() - i);
+        n._box = _entries[i]._box;
+        for(unsigned j = 1; j < n._count; ++j)
+            n._box.expandBy( _entries[i+j]._box );
+        _levels.back().push_back( n );
+    }
+
+    // upper levels, until there is a single root.
+    while( _levels.back().size() > 1 )
+    {
+        std::vector<Node>& below = _levels.back();
+        strSort( below );
+
+        std::vector<Node> level;
+        for(unsigned i = 0; i < below.size(); i += NODE_CAPACITY)
+        {
+            Node n;
+            n._first = i;
+            n._count = std::min(NODE_CAPACITY, (unsigned)below.size() - i);
+            n._box = below[i]._box;
+            for(unsigned j = 1; j < n._count; ++j)
+                n._box.expandBy( below[i+j]._box );
+            level.push_back( n );
+        }
+        _levels.push_back( level );
+    }
+}
+
+void
+FeatureSpatialIndex::query(const Bounds& bounds, std::vector<unsigned>& output) const
+{
+    if ( !bounds.isValid() )
+        return;
+
+    Box q;
+    q._xmin = bounds.xMin();
+    q._ymin = bounds.yMin();
+    q._xmax = bounds.xMax();
+    q._ymax = bounds.yMax();
+
+    Threading::ScopedMutexLock lock(_mutex);
+
+    unsigned edits = _pending.size() + _removed.size();
+    if ( edits > std::max(MIN_REPACK_EDITS, (unsigned)_entries.size()/8u) )
+        pack();
+
+    unsigned start = output.size();
+
+    if ( !_levels.empty() )
+    {
+        // stack of (level, node index)
+        std::vector< std::pair<unsigned, unsigned> > stack;
+        stack.push_back( std::make_pair((unsigned)_levels.size()-1, 0u) );
+
+        while( !stack.empty() )
+        {
+            unsigned level = stack.back().first;
+            const Node& node = _levels[level][stack.back().second];
+            stack.pop_back();
+
+            if ( !node._box.intersects(q) )
+                continue;
+
+            if ( level == 0 )
+            {
+                for(unsigned i = node._first; i < node._first + node._count; ++i)
+                {
+                    const Entry& e = _entries[i];
+                    if ( e._box.intersects(q) && (_removed.empty() || _removed.find(e._id) == _removed.end()) )
+                        output.push_back( e._id );
+                }
+            }
+            else
+            {
+                for(unsigned i = node._first; i < node._first + node._count; ++i)
+                    stack.push_back( std::make_pair(level-1, i) );
+            }
+        }
+    }
+
+    for(std::vector<Entry>::const_iterator i = _pending.begin(); i != _pending.end(); ++i)
+    {
+        if ( i->_box.intersects(q) )
+            output.push_back( i->_id );
+    }
+
+    std::sort( output.begin()+start, output.end() );
+}
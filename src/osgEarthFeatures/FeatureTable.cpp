@@ -0,0 +1,824 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureTable>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Config>
+#include <istream>
+#include <ostream>
+#include <cstring>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+#define LC "[FeatureTable] "
+
+namespace
+{
+    // Cell states stored in Column::_set
+    const char CELL_ABSENT = 0; // attribute not present on the feature
+    const char CELL_NULL   = 1; // present but NULL
+    const char CELL_VALUE  = 2; // present with a value
+
+    Geometry* createPart(Geometry::Type type, unsigned capacity)
+    {
+        switch(type)
+        {
+        case Geometry::TYPE_POINTSET:   return new PointSet(capacity);
+        case Geometry::TYPE_LINESTRING: return new LineString(capacity);
+        case Geometry::TYPE_RING:       return new Ring(capacity);
+        case Geometry::TYPE_POLYGON:    return new Polygon(capacity);
+        default:                        return 0L;
+        }
+    }
+
+    // Binary layout tags for write()/read()
+    const char     TABLE_MAGIC[4] = { 'O', 'E', 'F', 'T' };
+    const unsigned TABLE_VERSION  = 1u;
+    const unsigned TABLE_BOM      = 0x01020304u;  // byte order check
+    const unsigned MAX_ELEMENTS   = 1u << 28;     // sanity limit against garbage input
+
+    template<typename T>
+    void writeValue(std::ostream& out, const T& value)
+    {
+        out.write( reinterpret_cast<const char*>(&value), sizeof(T) );
+    }
+
+    template<typename T>
+    bool readValue(std::istream& in, T& value)
+    {
+        in.read( reinterpret_cast<char*>(&value), sizeof(T) );
+        return in.good();
+    }
+
+    template<typename T>
+    void writeVector(std::ostream& out, const std::vector<T>& v)
+    {
+        writeValue( out, (unsigned)v.size() );
+        if ( !v.empty() )
+            out.write( reinterpret_cast<const char*>(&v[0]), v.size()*sizeof(T) );
+    }
+
+    template<typename T>
+    bool readVector(std::istream& in, std::vector<T>& v)
+    {
+        unsigned size;
+        if ( !readValue(in, size) || size > MAX_ELEMENTS )
+            return false;
+        v.resize( size );
+        if ( size > 0 )
+            in.read( reinterpret_cast<char*>(&v[0]), size*sizeof(T) );
+        return in.good();
+    }
+
+    void writeString(std::ostream& out, const std::string& s)
+    {
+        writeValue( out, (unsigned)s.size() );
+        out.write( s.data(), s.size() );
+    }
+
+    bool readString(std::istream& in, std::string& s)
+    {
+        unsigned size;
+        if ( !readValue(in, size) || size > MAX_ELEMENTS )
+            return false;
+        s.resize( size );
+        if ( size > 0 )
+            in.read( &s[0], size );
+        return in.good();
+    }
+}
+
+//---------------------------------------------------------------------------
+
+FeatureTable::FeatureTable(const SpatialReference* srs) :
+_srs( srs )
+{
+    _rowParts.push_back(0);
+    _partPoints.push_back(0);
+}
+
+FeatureTable*
+FeatureTable::create(const FeatureList& features)
+{
+    FeatureTable* table = new FeatureTable(features.empty() ? 0L : features.front()->getSRS());
+
+    unsigned numPoints = 0;
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        if ( i->valid() && i->get()->getGeometry() )
+            numPoints += i->get()->getGeometry()->getTotalPointCount();
+    }
+    table->reserve(features.size(), numPoints);
+    table->append(features);
+    return table;
+}
+
+void
+FeatureTable::clear()
+{
+    _fids.clear();
+    _bounds.clear();
+    _types.clear();
+    _rowParts.clear();
+    _rowParts.push_back(0);
+    _styles.clear();
+    _geoInterps.clear();
+    _totalBounds = Bounds();
+    _index.clear();
+    _partTypes.clear();
+    _partHoles.clear();
+    _partPoints.clear();
+    _partPoints.push_back(0);
+    _points.clear();
+    _columns.clear();
+    _columnIndex.clear();
+}
+
+void
+FeatureTable::reserve(unsigned numFeatures, unsigned numPoints)
+{
+    _fids.reserve(numFeatures);
+    _bounds.reserve(numFeatures);
+    _types.reserve(numFeatures);
+    _rowParts.reserve(numFeatures+1);
+    _points.reserve(numPoints);
+}
+
+unsigned
+FeatureTable::append(const Feature* feature)
+{
+    unsigned row = _fids.size();
+
+    if ( !_srs.valid() )
+        _srs = feature->getSRS();
+
+    unsigned firstPoint = _points.size();
+
+    const Geometry* geom = feature->getGeometry();
+    _fids.push_back( feature->getFID() );
+    _types.push_back( geom ? (unsigned char)geom->getType() : (unsigned char)Geometry::TYPE_UNKNOWN );
+    appendGeometry( geom );
+    _rowParts.push_back( _partTypes.size() );
+
+    // bring the new points into the table's SRS if necessary.
+    if (feature->getSRS() && _srs.valid() &&
+        _points.size() > firstPoint &&
+        !feature->getSRS()->isEquivalentTo(_srs.get()))
+    {
+        std::vector<osg::Vec3d> temp( _points.begin()+firstPoint, _points.end() );
+        if ( feature->getSRS()->transform(temp, _srs.get()) )
+            std::copy( temp.begin(), temp.end(), _points.begin()+firstPoint );
+        else
+            OE_WARN << LC << "Failed to transform feature " << feature->getFID() << " to the table SRS\n";
+    }
+
+    _bounds.push_back( Bounds() );
+    computeBounds( row );
+    if ( _bounds[row].isValid() )
+    {
+        _totalBounds.expandBy( _bounds[row] );
+        _index.insert( row, _bounds[row] );
+    }
+
+    if ( feature->style().isSet() )
+        _styles[row] = feature->style().get();
+
+    if ( feature->geoInterp().isSet() )
+        _geoInterps[row] = feature->geoInterp().get();
+
+    appendRowToColumns();
+
+    const AttributeTable& attrs = feature->getAttrs();
+    for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+    {
+        unsigned col = addColumn(a->first, a->second.first);
+        set( row, col, a->second );
+    }
+
+    return row;
+}
+
+void
+FeatureTable::append(const FeatureList& features)
+{
+    for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+    {
+        if ( i->valid() )
+            append( i->get() );
+    }
+}
+
+void
+FeatureTable::appendGeometry(const Geometry* geom)
+{
+    if ( !geom )
+        return;
+
+    if ( geom->getType() == Geometry::TYPE_MULTI )
+    {
+        // nested multi-geometries flatten into one list of parts.
+        const GeometryCollection& parts = static_cast<const MultiGeometry*>(geom)->getComponents();
+        for(GeometryCollection::const_iterator i = parts.begin(); i != parts.end(); ++i)
+            appendGeometry( i->get() );
+    }
+    else
+    {
+        appendPart( geom, false );
+
+        if ( geom->getType() == Geometry::TYPE_POLYGON )
+        {
+            const RingCollection& holes = static_cast<const Polygon*>(geom)->getHoles();
+            for(RingCollection::const_iterator h = holes.begin(); h != holes.end(); ++h)
+                appendPart( h->get(), true );
+        }
+    }
+}
+
+void
+FeatureTable::appendPart(const Geometry* part, bool hole)
+{
+    _partTypes.push_back( (unsigned char)part->getType() );
+    _partHoles.push_back( hole ? 1 : 0 );
+    _points.insert( _points.end(), part->begin(), part->end() );
+    _partPoints.push_back( _points.size() );
+}
+
+void
+FeatureTable::computeBounds(unsigned row)
+{
+    Bounds& b = _bounds[row];
+    b = Bounds();
+    unsigned first = _partPoints[_rowParts[row]];
+    unsigned last  = _partPoints[_rowParts[row+1]];
+    for(unsigned i = first; i < last; ++i)
+        b.expandBy( _points[i] );
+}
+
+int
+FeatureTable::findRow(FeatureID fid) const
+{
+    for(unsigned row = 0; row < _fids.size(); ++row)
+    {
+        if ( _fids[row] == fid )
+            return (int)row;
+    }
+    return -1;
+}
+
+void
+FeatureTable::remove(unsigned row)
+{
+    if ( row >= _fids.size() )
+        return;
+
+    unsigned firstPart  = _rowParts[row];
+    unsigned lastPart   = _rowParts[row+1];
+    unsigned firstPoint = _partPoints[firstPart];
+    unsigned lastPoint  = _partPoints[lastPart];
+    unsigned numParts   = lastPart - firstPart;
+    unsigned numPoints  = lastPoint - firstPoint;
+
+    _points.erase( _points.begin()+firstPoint, _points.begin()+lastPoint );
+
+    // drop the row's parts and pull the later offsets back.
+    _partTypes.erase( _partTypes.begin()+firstPart, _partTypes.begin()+lastPart );
+    _partHoles.erase( _partHoles.begin()+firstPart, _partHoles.begin()+lastPart );
+    _partPoints.erase( _partPoints.begin()+firstPart+1, _partPoints.begin()+lastPart+1 );
+    for(unsigned p = firstPart+1; p < _partPoints.size(); ++p)
+        _partPoints[p] -= numPoints;
+
+    _rowParts.erase( _rowParts.begin()+row+1 );
+    for(unsigned r = row+1; r < _rowParts.size(); ++r)
+        _rowParts[r] -= numParts;
+
+    _fids.erase( _fids.begin()+row );
+    _bounds.erase( _bounds.begin()+row );
+    _types.erase( _types.begin()+row );
+
+    // the sparse maps are keyed by row, so re-key everything after it.
+    std::map<unsigned, Style> styles;
+    for(std::map<unsigned, Style>::const_iterator s = _styles.begin(); s != _styles.end(); ++s)
+    {
+        if ( s->first != row )
+            styles[s->first > row ? s->first-1 : s->first] = s->second;
+    }
+    _styles.swap( styles );
+
+    std::map<unsigned, GeoInterpolation> geoInterps;
+    for(std::map<unsigned, GeoInterpolation>::const_iterator g = _geoInterps.begin(); g != _geoInterps.end(); ++g)
+    {
+        if ( g->first != row )
+            geoInterps[g->first > row ? g->first-1 : g->first] = g->second;
+    }
+    _geoInterps.swap( geoInterps );
+
+    for(std::vector<Column>::iterator c = _columns.begin(); c != _columns.end(); ++c)
+    {
+        c->_set.erase( c->_set.begin()+row );
+        c->_strings.erase( c->_strings.begin()+row );
+        c->_doubles.erase( c->_doubles.begin()+row );
+        c->_ints.erase( c->_ints.begin()+row );
+        c->_bools.erase( c->_bools.begin()+row );
+    }
+
+    // row numbers changed, so the index has to be rebuilt; the bounds themselves still hold.
+    _totalBounds = Bounds();
+    _index.clear();
+    for(unsigned r = 0; r < _fids.size(); ++r)
+    {
+        if ( _bounds[r].isValid() )
+        {
+            _totalBounds.expandBy( _bounds[r] );
+            _index.insert( r, _bounds[r] );
+        }
+    }
+}
+
+void
+FeatureTable::dirtyBounds()
+{
+    _totalBounds = Bounds();
+    _index.clear();
+    for(unsigned row = 0; row < _fids.size(); ++row)
+    {
+        computeBounds( row );
+        if ( _bounds[row].isValid() )
+        {
+            _totalBounds.expandBy( _bounds[row] );
+            _index.insert( row, _bounds[row] );
+        }
+    }
+}
+
+bool
+FeatureTable::transform(const SpatialReference* srs)
+{
+    if ( !srs || !_srs.valid() )
+        return false;
+
+    if ( _srs->isEquivalentTo(srs) )
+        return true;
+
+    if ( !_srs->transform(_points, srs) )
+        return false;
+
+    _srs = srs;
+    dirtyBounds();
+    return true;
+}
+
+bool
+FeatureTable::intersects(unsigned row, const Bounds& bounds) const
+{
+    const Bounds& b = _bounds[row];
+    if ( !b.isValid() || !bounds.isValid() )
+        return false;
+
+    return
+        b.xMin() <= bounds.xMax() && b.xMax() >= bounds.xMin() &&
+        b.yMin() <= bounds.yMax() && b.yMax() >= bounds.yMin();
+}
+
+void
+FeatureTable::query(const Bounds& bounds, std::vector<unsigned>& output_rows) const
+{
+    _index.query( bounds, output_rows );
+}
+
+Geometry*
+FeatureTable::createGeometry(unsigned row) const
+{
+    unsigned firstPart = _rowParts[row];
+    unsigned lastPart  = _rowParts[row+1];
+    if ( firstPart == lastPart )
+        return 0L;
+
+    GeometryCollection parts;
+    Polygon* lastPolygon = 0L;
+
+    for(unsigned p = firstPart; p < lastPart; ++p)
+    {
+        unsigned first = _partPoints[p];
+        unsigned last  = _partPoints[p+1];
+
+        Geometry* part = createPart( (Geometry::Type)_partTypes[p], last-first );
+        if ( !part )
+            continue;
+
+        part->insert( part->end(), _points.begin()+first, _points.begin()+last );
+
+        if ( _partHoles[p] && lastPolygon && part->getType() == Geometry::TYPE_RING )
+        {
+            lastPolygon->getHoles().push_back( static_cast<Ring*>(part) );
+        }
+        else
+        {
+            parts.push_back( part );
+            lastPolygon = part->getType() == Geometry::TYPE_POLYGON ? static_cast<Polygon*>(part) : 0L;
+        }
+    }
+
+    if ( _types[row] == Geometry::TYPE_MULTI )
+        return new MultiGeometry( parts );
+
+    return parts.empty() ? 0L : parts.front().release();
+}
+
+Feature*
+FeatureTable::createFeature(unsigned row) const
+{
+    Feature* feature = new Feature( createGeometry(row), _srs.get(), Style(), _fids[row] );
+
+    std::map<unsigned, Style>::const_iterator s = _styles.find(row);
+    if ( s != _styles.end() )
+        feature->style() = s->second;
+
+    std::map<unsigned, GeoInterpolation>::const_iterator g = _geoInterps.find(row);
+    if ( g != _geoInterps.end() )
+        feature->geoInterp() = g->second;
+
+    for(unsigned col = 0; col < _columns.size(); ++col)
+    {
+        const Column& c = _columns[col];
+        char state = c._set[row];
+        if ( state == CELL_VALUE )
+            feature->set( c._name, getValue(row, col) );
+        else if ( state == CELL_NULL )
+            feature->setNull( c._name, c._type );
+    }
+
+    return feature;
+}
+
+void
+FeatureTable::toFeatureList(FeatureList& output) const
+{
+    for(unsigned row = 0; row < _fids.size(); ++row)
+        output.push_back( createFeature(row) );
+}
+
+void
+FeatureTable::toFeatureList(const Symbology::Query& query, FeatureList& output) const
+{
+    osg::ref_ptr<FeatureCursor> cursor = createFeatureCursor(query);
+    cursor->fill( output );
+}
+
+FeatureCursor*
+FeatureTable::createFeatureCursor(const Symbology::Query& query) const
+{
+    return new FeatureTableCursor(this, query);
+}
+
+//...................................................................
+// attribute columns
+
+int
+FeatureTable::getColumnIndex(const std::string& name) const
+{
+    ColumnIndex::const_iterator i = _columnIndex.find(name);
+    return i != _columnIndex.end() ? (int)i->second : -1;
+}
+
+unsigned
+FeatureTable::addColumn(const std::string& name, AttributeType type)
+{
+    ColumnIndex::const_iterator i = _columnIndex.find(name);
+    if ( i != _columnIndex.end() )
+    {
+        Column& c = _columns[i->second];
+        // a column first seen as NULL-only takes the type of the first real value.
+        if ( c._type == ATTRTYPE_UNSPECIFIED && type != ATTRTYPE_UNSPECIFIED )
+            c._type = type;
+        return i->second;
+    }
+
+    unsigned col = _columns.size();
+    _columns.push_back( Column() );
+    _columnIndex[name] = col;
+
+    Column& c = _columns.back();
+    c._name = name;
+    c._type = type;
+
+    // back-fill previous rows.
+    unsigned rows = _fids.size();
+    c._set.resize( rows, CELL_ABSENT );
+    c._strings.resize( rows );
+    c._doubles.resize( rows, 0.0 );
+    c._ints.resize( rows, 0 );
+    c._bools.resize( rows, 0 );
+    return col;
+}
+
+void
+FeatureTable::appendRowToColumns()
+{
+    for(std::vector<Column>::iterator c = _columns.begin(); c != _columns.end(); ++c)
+    {
+        c->_set.push_back( CELL_ABSENT );
+        c->_strings.push_back( std::string() );
+        c->_doubles.push_back( 0.0 );
+        c->_ints.push_back( 0 );
+        c->_bools.push_back( 0 );
+    }
+}
+
+void
+FeatureTable::set(unsigned row, unsigned col, const AttributeValue& value)
+{
+    Column& c = _columns[col];
+    if ( !value.second.set )
+    {
+        c._set[row] = CELL_NULL;
+        return;
+    }
+
+    c._set[row] = CELL_VALUE;
+    switch( c._type )
+    {
+    case ATTRTYPE_STRING: c._strings[row] = value.getString(); break;
+    case ATTRTYPE_DOUBLE: c._doubles[row] = value.getDouble(); break;
+    case ATTRTYPE_INT:    c._ints[row]    = value.getInt(); break;
+    case ATTRTYPE_BOOL:   c._bools[row]   = value.getBool() ? 1 : 0; break;
+    default:              c._set[row]     = CELL_NULL; break;
+    }
+}
+
+AttributeValue
+FeatureTable::getValue(unsigned row, unsigned col) const
+{
+    const Column& c = _columns[col];
+    AttributeValue v;
+    v.first = c._type;
+    v.second.set = c._set[row] == CELL_VALUE;
+    v.second.doubleValue = 0.0;
+    v.second.intValue = 0;
+    v.second.boolValue = false;
+    if ( v.second.set )
+    {
+        switch( c._type )
+        {
+        case ATTRTYPE_STRING: v.second.stringValue = c._strings[row]; break;
+        case ATTRTYPE_DOUBLE: v.second.doubleValue = c._doubles[row]; break;
+        case ATTRTYPE_INT:    v.second.intValue    = c._ints[row]; break;
+        case ATTRTYPE_BOOL:   v.second.boolValue   = c._bools[row] != 0; break;
+        default: break;
+        }
+    }
+    return v;
+}
+
+std::string
+FeatureTable::getString(unsigned row, unsigned col) const
+{
+    return isSet(row, col) ? getValue(row, col).getString() : EMPTY_STRING;
+}
+
+double
+FeatureTable::getDouble(unsigned row, unsigned col, double defaultValue) const
+{
+    const Column& c = _columns[col];
+    if ( c._set[row] != CELL_VALUE ) return defaultValue;
+    return c._type == ATTRTYPE_DOUBLE ? c._doubles[row] : getValue(row, col).getDouble(defaultValue);
+}
+
+int
+FeatureTable::getInt(unsigned row, unsigned col, int defaultValue) const
+{
+    const Column& c = _columns[col];
+    if ( c._set[row] != CELL_VALUE ) return defaultValue;
+    return c._type == ATTRTYPE_INT ? c._ints[row] : getValue(row, col).getInt(defaultValue);
+}
+
+bool
+FeatureTable::getBool(unsigned row, unsigned col, bool defaultValue) const
+{
+    const Column& c = _columns[col];
+    if ( c._set[row] != CELL_VALUE ) return defaultValue;
+    return c._type == ATTRTYPE_BOOL ? c._bools[row] != 0 : getValue(row, col).getBool(defaultValue);
+}
+
+bool
+FeatureTable::write(std::ostream& out) const
+{
+    out.write( TABLE_MAGIC, 4 );
+    writeValue( out, TABLE_VERSION );
+    writeValue( out, TABLE_BOM );
+    writeValue( out, (unsigned)sizeof(FeatureID) );
+
+    writeString( out, _srs.valid() ? _srs->getHorizInitString() : std::string() );
+    writeString( out, _srs.valid() ? _srs->getVertInitString()  : std::string() );
+
+    // rows, parts and coordinates go out as flat blocks.
+    writeVector( out, _fids );
+    writeVector( out, _types );
+    writeVector( out, _rowParts );
+    writeVector( out, _partTypes );
+    writeVector( out, _partHoles );
+    writeVector( out, _partPoints );
+    writeVector( out, _points );
+
+    writeValue( out, (unsigned)_styles.size() );
+    for(std::map<unsigned, Style>::const_iterator s = _styles.begin(); s != _styles.end(); ++s)
+    {
+        writeValue( out, s->first );
+        writeString( out, s->second.getConfig().toJSON() );
+    }
+
+    writeValue( out, (unsigned)_geoInterps.size() );
+    for(std::map<unsigned, GeoInterpolation>::const_iterator g = _geoInterps.begin(); g != _geoInterps.end(); ++g)
+    {
+        writeValue( out, g->first );
+        writeValue( out, (int)g->second );
+    }
+
+    // each column writes only the value vector that matches its type.
+    writeValue( out, (unsigned)_columns.size() );
+    for(std::vector<Column>::const_iterator c = _columns.begin(); c != _columns.end(); ++c)
+    {
+        writeString( out, c->_name );
+        writeValue( out, (int)c->_type );
+        writeVector( out, c->_set );
+        switch( c->_type )
+        {
+        case ATTRTYPE_STRING:
+            for(std::vector<std::string>::const_iterator i = c->_strings.begin(); i != c->_strings.end(); ++i)
+                writeString( out, *i );
+            break;
+        case ATTRTYPE_DOUBLE: writeVector( out, c->_doubles ); break;
+        case ATTRTYPE_INT:    writeVector( out, c->_ints ); break;
+        case ATTRTYPE_BOOL:   writeVector( out, c->_bools ); break;
+        default: break;
+        }
+    }
+
+    return out.good();
+}
+
+FeatureTable*
+FeatureTable::read(std::istream& in)
+{
+    char magic[4];
+    unsigned version, bom, fidSize;
+    in.read( magic, 4 );
+    if (!in.good() || ::memcmp(magic, TABLE_MAGIC, 4) != 0 ||
+        !readValue(in, version) || version != TABLE_VERSION ||
+        !readValue(in, bom)     || bom != TABLE_BOM ||
+        !readValue(in, fidSize) || fidSize != sizeof(FeatureID))
+    {
+        return 0L;
+    }
+
+    std::string hinit, vinit;
+    if ( !readString(in, hinit) || !readString(in, vinit) )
+        return 0L;
+
+    osg::ref_ptr<FeatureTable> table = new FeatureTable( hinit.empty() ? 0L : SpatialReference::create(hinit, vinit) );
+    if ( !hinit.empty() && !table->_srs.valid() )
+        return 0L;
+
+    if (!readVector(in, table->_fids) ||
+        !readVector(in, table->_types) ||
+        !readVector(in, table->_rowParts) ||
+        !readVector(in, table->_partTypes) ||
+        !readVector(in, table->_partHoles) ||
+        !readVector(in, table->_partPoints) ||
+        !readVector(in, table->_points))
+    {
+        return 0L;
+    }
+
+    // make sure the offsets fit together before anything indexes with them.
+    unsigned rows  = table->_fids.size();
+    unsigned parts = table->_partTypes.size();
+    if (table->_types.size() != rows ||
+        table->_rowParts.size() != rows+1 ||
+        table->_partHoles.size() != parts ||
+        table->_partPoints.size() != parts+1 ||
+        table->_rowParts.back() != parts ||
+        table->_partPoints.back() != table->_points.size())
+    {
+        return 0L;
+    }
+
+    for(unsigned i = 0; i < rows; ++i)
+        if ( table->_rowParts[i] > table->_rowParts[i+1] ) return 0L;
+    for(unsigned i = 0; i < parts; ++i)
+        if ( table->_partPoints[i] > table->_partPoints[i+1] ) return 0L;
+
+    unsigned numStyles;
+    if ( !readValue(in, numStyles) || numStyles > rows )
+        return 0L;
+    for(unsigned i = 0; i < numStyles; ++i)
+    {
+        unsigned row;
+        std::string json;
+        if ( !readValue(in, row) || !readString(in, json) || row >= rows )
+            return 0L;
+        Config conf;
+        conf.fromJSON( json );
+        table->_styles[row] = Style( conf );
+    }
+
+    unsigned numInterps;
+    if ( !readValue(in, numInterps) || numInterps > rows )
+        return 0L;
+    for(unsigned i = 0; i < numInterps; ++i)
+    {
+        unsigned row;
+        int interp;
+        if ( !readValue(in, row) || !readValue(in, interp) || row >= rows )
+            return 0L;
+        table->_geoInterps[row] = (GeoInterpolation)interp;
+    }
+
+    unsigned numColumns;
+    if ( !readValue(in, numColumns) || numColumns > MAX_ELEMENTS )
+        return 0L;
+    for(unsigned i = 0; i < numColumns; ++i)
+    {
+        std::string name;
+        int type;
+        if ( !readString(in, name) || !readValue(in, type) )
+            return 0L;
+
+        unsigned col = table->addColumn( name, (AttributeType)type );
+        if ( col != i )
+            return 0L;
+
+        Column& c = table->_columns[col];
+        if ( !readVector(in, c._set) || c._set.size() != rows )
+            return 0L;
+
+        bool ok = true;
+        switch( c._type )
+        {
+        case ATTRTYPE_STRING:
+            for(unsigned row = 0; ok && row < rows; ++row)
+                ok = readString( in, c._strings[row] );
+            break;
+        case ATTRTYPE_DOUBLE: ok = readVector(in, c._doubles) && c._doubles.size() == rows; break;
+        case ATTRTYPE_INT:    ok = readVector(in, c._ints)    && c._ints.size()    == rows; break;
+        case ATTRTYPE_BOOL:   ok = readVector(in, c._bools)   && c._bools.size()   == rows; break;
+        default: break;
+        }
+        if ( !ok )
+            return 0L;
+    }
+
+    // per-feature bounds and the spatial index are cheaper to rebuild than to store.
+    table->_bounds.resize( rows );
+    table->dirtyBounds();
+
+    return table.release();
+}
+
+//---------------------------------------------------------------------------
+
+FeatureTableCursor::FeatureTableCursor(const FeatureTable* table, const Symbology::Query& query) :
+_table    ( table ),
+_query    ( query ),
+_row      ( 0 ),
+_useRows  ( query.bounds().isSet() ),
+_remaining( query.limit().isSet() ? query.limit().get() : -1 )
+{
+    if ( _useRows )
+        _table->query( query.bounds().get(), _rows );
+}
+
+bool
+FeatureTableCursor::hasMore() const
+{
+    return _row < (_useRows ? _rows.size() : _table->size()) && _remaining != 0;
+}
+
+Feature*
+FeatureTableCursor::nextFeature()
+{
+    if ( !hasMore() )
+        return 0L;
+
+    _lastFeature = _table->createFeature(_useRows ? _rows[_row] : _row);
+    ++_row;
+    if ( _remaining > 0 )
+        --_remaining;
+    return _lastFeature.get();
+}
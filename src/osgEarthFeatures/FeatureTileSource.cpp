@@ -31,7 +31,8 @@ using namespace osgEarth::Symbology;
 
 FeatureTileSourceOptions::FeatureTileSourceOptions( const ConfigOptions& options ) :
 TileSourceOptions( options ),
-_geomTypeOverride( Geometry::TYPE_UNKNOWN )
+_geomTypeOverride( Geometry::TYPE_UNKNOWN ),
+_featureBatchSize( 0u )
 {
     fromConfig( _conf );
 }
@@ -43,6 +44,7 @@ FeatureTileSourceOptions::getConfig() const
 
     conf.setObj( "features", _featureOptions );
     conf.setObj( "styles", _styles );
+    conf.set( "feature_batch_size", _featureBatchSize );
 
     if ( _geomTypeOverride.isSet() ) {
         if ( _geomTypeOverride == Geometry::TYPE_LINESTRING )
@@ -69,6 +71,7 @@ FeatureTileSourceOptions::fromConfig( const Config& conf )
     conf.getObjIfSet( "features", _featureOptions );
 
     conf.getObjIfSet( "styles", _styles );
+    conf.getIfSet( "feature_batch_size", _featureBatchSize );
     
     std::string gt = conf.value( "geometry_type" );
     if ( gt == "line" || gt == "lines" || gt == "linestring" )
@@ -304,19 +307,84 @@ FeatureTileSource::queryAndRenderFeaturesForStyle(const Style&     style,
                                                   const GeoExtent& imageExtent,
                                                   osg::Image*      out_image)
 {   
-    // Get the features
+    unsigned batchSize = _options.featureBatchSize().get();
+    if ( batchSize == 0u )
+    {
+        // Get the features
+        FeatureList features;
+        getFeatures(query, imageExtent, features );
+        if (!features.empty())
+        {
+            // Render them.
+            return renderFeaturesForStyle( _session.get(), style, features, data, imageExtent, out_image );
+        }
+        return false;
+    }
+
+    // Streaming: read and render at most batchSize features at a time.
+    Query localQuery;
+    if ( !createLocalQuery(query, imageExtent, localQuery) )
+        return false;
+
     FeatureList features;
-    getFeatures(query, imageExtent, features );
-    if (!features.empty())
+    osg::ref_ptr<FeatureCursor> cursor;
+    while( true )
+    {
+        cursor = _features->createFeatureCursor( localQuery );
+        if ( readFeatures(cursor.get(), features, batchSize) > 0u )
+            break;
+
+        // same tile key fall-back as getFeatures()
+        if ( !localQuery.tileKey().isSet() )
+            return false;
+
+        localQuery.tileKey() = localQuery.tileKey().get().createParentKey();
+        if ( !localQuery.tileKey()->valid() )
+            return false;
+    }
+
+    bool rendered = false;
+    while( !features.empty() )
     {
-        // Render them.
-        return renderFeaturesForStyle( _session.get(), style, features, data, imageExtent, out_image );
+        if ( renderFeaturesForStyle( _session.get(), style, features, data, imageExtent, out_image ) )
+            rendered = true;
+
+        features.clear();
+        readFeatures(cursor.get(), features, batchSize);
     }
-    return false;
+    return rendered;
 }
 
-void
-FeatureTileSource::getFeatures(const Query& query, const GeoExtent& imageExtent, FeatureList& features)
+unsigned
+FeatureTileSource::readFeatures(FeatureCursor* cursor, FeatureList& features, unsigned maxFeatures)
+{
+    unsigned count = 0u;
+    while( cursor && count < maxFeatures && cursor->hasMore() )
+    {
+        Feature* feature = cursor->nextFeature();
+        Geometry* geom = feature ? feature->getGeometry() : 0L;
+        if ( geom )
+        {
+            // apply a type override if requested:
+            if (_options.geometryTypeOverride().isSet() &&
+                _options.geometryTypeOverride() != geom->getComponentType() )
+            {
+                geom = geom->cloneAs( _options.geometryTypeOverride().value() );
+                if ( geom )
+                    feature->setGeometry( geom );
+            }
+        }
+        if ( geom )
+        {
+            features.push_back( feature );
+            ++count;
+        }
+    }
+    return count;
+}
+
+bool
+FeatureTileSource::createLocalQuery(const Query& query, const GeoExtent& imageExtent, Query& localQuery)
 {
     // first we need the overall extent of the layer:
     const GeoExtent& featuresExtent = getFeatureSource()->getFeatureProfile()->getExtent();
@@ -325,43 +393,32 @@ FeatureTileSource::getFeatures(const Query& query, const GeoExtent& imageExtent,
     GeoExtent featuresExtentWGS84 = featuresExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
     GeoExtent imageExtentWGS84 = imageExtent.transform( featuresExtent.getSRS()->getGeographicSRS() );
     GeoExtent queryExtentWGS84 = featuresExtentWGS84.intersectionSameSRS( imageExtentWGS84 );
-    if ( queryExtentWGS84.isValid() )
-    {
-        GeoExtent queryExtent = queryExtentWGS84.transform( featuresExtent.getSRS() );
+    if ( !queryExtentWGS84.isValid() )
+        return false;
 
-        // incorporate the image extent into the feature query for this style:
-        Query localQuery = query;
-        localQuery.bounds() = 
-            query.bounds().isSet() ? query.bounds()->unionWith( queryExtent.bounds() ) :
-            queryExtent.bounds();
+    GeoExtent queryExtent = queryExtentWGS84.transform( featuresExtent.getSRS() );
 
+    // incorporate the image extent into the feature query for this style:
+    localQuery = query;
+    localQuery.bounds() = 
+        query.bounds().isSet() ? query.bounds()->unionWith( queryExtent.bounds() ) :
+        queryExtent.bounds();
+    return true;
+}
+
+void
+FeatureTileSource::getFeatures(const Query& query, const GeoExtent& imageExtent, FeatureList& features)
+{
+    Query localQuery;
+    if ( createLocalQuery(query, imageExtent, localQuery) )
+    {
         // now copy the resulting feature set into a list, converting the data
         // types along the way if a geometry override is in place:
         while (features.empty())
         {
             // query the feature source:
             osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( localQuery );
-
-            while( cursor.valid() && cursor->hasMore() )
-            {
-                Feature* feature = cursor->nextFeature();
-                Geometry* geom = feature->getGeometry();
-                if ( geom )
-                {
-                    // apply a type override if requested:
-                    if (_options.geometryTypeOverride().isSet() &&
-                        _options.geometryTypeOverride() != geom->getComponentType() )
-                    {
-                        geom = geom->cloneAs( _options.geometryTypeOverride().value() );
-                        if ( geom )
-                            feature->setGeometry( geom );
-                    }
-                }
-                if ( geom )
-                {
-                    features.push_back( feature );
-                }
-            }
+            readFeatures( cursor.get(), features, ~0u );
 
             // If we didn't get any features and we have a tilekey set, try falling back.
             if (features.empty() && localQuery.tileKey().isSet())
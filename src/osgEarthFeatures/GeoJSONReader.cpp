@@ -0,0 +1,744 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthFeatures/GeoJSONReader>
+#include <osgEarth/StringUtils>
+#include <osgEarth/Notify>
+#include <osg/Math>
+#include <climits>
+#include <cstring>
+
+#define LC "[GeoJSONReader] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+namespace
+{
+    /**
+     * Minimal forward-only JSON scanner over a memory buffer.
+     */
+    class Scanner
+    {
+    public:
+        Scanner(const char* data, unsigned size) : _p(data), _end(data+size) { }
+
+        void ws()
+        {
+            while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r'))
+                ++_p;
+        }
+
+        bool peek(char c)
+        {
+            ws();
+            return _p < _end && *_p == c;
+        }
+
+        bool accept(char c)
+        {
+            if (peek(c)) { ++_p; return true; }
+            return false;
+        }
+
+        bool expect(char c)
+        {
+            return accept(c);
+        }
+
+        bool atEnd()
+        {
+            ws();
+            return _p >= _end;
+        }
+
+        bool atNumber()
+        {
+            ws();
+            return _p < _end && ((*_p >= '0' && *_p <= '9') || *_p == '-');
+        }
+
+        const char* pos() const { return _p; }
+
+        bool string(std::string& out)
+        {
+            if (!expect('"'))
+                return false;
+
+            out.clear();
+            while (_p < _end)
+            {
+                char c = *_p++;
+                if (c == '"')
+                    return true;
+
+                if (c != '\\')
+                {
+                    out.push_back(c);
+                    continue;
+                }
+
+                if (_p >= _end)
+                    return false;
+
+                c = *_p++;
+                switch (c)
+                {
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u':
+                    {
+                        unsigned cp;
+                        if (!hex4(cp))
+                            return false;
+
+                        // surrogate pair:
+                        if (cp >= 0xD800 && cp <= 0xDBFF && _end - _p >= 6 && _p[0] == '\\' && _p[1] == 'u')
+                        {
+                            _p += 2;
+                            unsigned lo;
+                            if (!hex4(lo))
+                                return false;
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        }
+                        utf8(cp, out);
+                    }
+                    break;
+                default:
+                    out.push_back(c); // \" \\ \/
+                }
+            }
+            return false;
+        }
+
+        bool number(double& out, bool& isInteger)
+        {
+            ws();
+            const char* start = _p;
+            isInteger = true;
+
+            if (_p < _end && *_p == '-')
+                ++_p;
+
+            while (_p < _end)
+            {
+                char c = *_p;
+                if (c >= '0' && c <= '9')
+                    ++_p;
+                else if (c == '.' || c == 'e' || c == 'E' || c == '-' || c == '+')
+                    isInteger = false, ++_p;
+                else
+                    break;
+            }
+
+            unsigned len = _p - start;
+            if (len == 0 || len >= 64)
+                return false;
+
+            // the buffer isn't terminated after the number, so copy it out.
+            char buf[64];
+            ::memcpy(buf, start, len);
+            buf[len] = 0;
+            out = osg::asciiToDouble(buf);
+            return true;
+        }
+
+        bool literal(const char* word)
+        {
+            ws();
+            unsigned len = ::strlen(word);
+            if ((unsigned)(_end - _p) < len || ::strncmp(_p, word, len) != 0)
+                return false;
+            _p += len;
+            return true;
+        }
+
+        //! Skips over any value without storing it.
+        bool skip()
+        {
+            ws();
+            if (_p >= _end)
+                return false;
+
+            char c = *_p;
+            if (c == '"')
+            {
+                // skip the string without decoding it
+                ++_p;
+                while (_p < _end)
+                {
+                    if (*_p == '\\') _p += 2;
+                    else if (*_p++ == '"') return true;
+                }
+                return false;
+            }
+            else if (c == '{')
+            {
+                ++_p;
+                if (accept('}'))
+                    return true;
+                do {
+                    if (!skip() || !expect(':') || !skip())
+                        return false;
+                } while (accept(','));
+                return expect('}');
+            }
+            else if (c == '[')
+            {
+                ++_p;
+                if (accept(']'))
+                    return true;
+                do {
+                    if (!skip())
+                        return false;
+                } while (accept(','));
+                return expect(']');
+            }
+            else if (c == 't')
+            {
+                return literal("true");
+            }
+            else if (c == 'f')
+            {
+                return literal("false");
+            }
+            else if (c == 'n')
+            {
+                return literal("null");
+            }
+            else
+            {
+                double d; bool i;
+                return number(d, i);
+            }
+        }
+
+    private:
+        bool hex4(unsigned& out)
+        {
+            if (_end - _p < 4)
+                return false;
+            out = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = *_p++;
+                out <<= 4;
+                if (c >= '0' && c <= '9') out |= c - '0';
+                else if (c >= 'a' && c <= 'f') out |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') out |= c - 'A' + 10;
+                else return false;
+            }
+            return true;
+        }
+
+        static void utf8(unsigned cp, std::string& out)
+        {
+            if (cp < 0x80) {
+                out.push_back((char)cp);
+            }
+            else if (cp < 0x800) {
+                out.push_back((char)(0xC0 | (cp >> 6)));
+                out.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            else if (cp < 0x10000) {
+                out.push_back((char)(0xE0 | (cp >> 12)));
+                out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+            else {
+                out.push_back((char)(0xF0 | (cp >> 18)));
+                out.push_back((char)(0x80 | ((cp >> 12) & 0x3F)));
+                out.push_back((char)(0x80 | ((cp >> 6) & 0x3F)));
+                out.push_back((char)(0x80 | (cp & 0x3F)));
+            }
+        }
+
+        const char* _p;
+        const char* _end;
+    };
+
+    /**
+     * The "coordinates" of one geometry, flattened. An array that holds
+     * positions has height 1, an array of those has height 2, and so on.
+     * _ends[h] records, for each closed array of height h+1, how many items
+     * of height h precede its end.
+     */
+    struct Coords
+    {
+        std::vector<osg::Vec3d> _points;
+        std::vector<unsigned>   _ends[4];
+    };
+
+    // Copies points [begin, end) in reverse, dropping repeats, like OgrUtils::populate.
+    void populate(Geometry* target, const std::vector<osg::Vec3d>& points, unsigned begin, unsigned end)
+    {
+        for (unsigned v = end; v > begin; --v)
+        {
+            const osg::Vec3d& p = points[v-1];
+            if (target->size() == 0 || p != target->back())
+                target->push_back(p);
+        }
+    }
+
+    // Polygon from the rings [ringBegin, ringEnd) in coords._ends[0].
+    Polygon* createPolygon(const Coords& c, unsigned ringBegin, unsigned ringEnd)
+    {
+        Polygon* output = 0L;
+        for (unsigned r = ringBegin; r < ringEnd; ++r)
+        {
+            unsigned begin = r > 0 ? c._ends[0][r-1] : 0u;
+            unsigned end = c._ends[0][r];
+
+            if (r == ringBegin)
+            {
+                output = new Polygon(end - begin);
+                populate(output, c._points, begin, end);
+                output->rewind(Ring::ORIENTATION_CCW);
+            }
+            else
+            {
+                Ring* hole = new Ring(end - begin);
+                populate(hole, c._points, begin, end);
+                hole->rewind(Ring::ORIENTATION_CW);
+                output->getHoles().push_back(hole);
+            }
+        }
+        return output;
+    }
+
+    Geometry* createGeometry(const std::string& type, const Coords& c, int height, MultiGeometry* collection)
+    {
+        if (type == "Point" && height == 0)
+        {
+            PointSet* output = new PointSet(1);
+            output->push_back(c._points[0]);
+            return output;
+        }
+        else if (type == "MultiPoint" && height == 1)
+        {
+            PointSet* output = new PointSet(c._points.size());
+            populate(output, c._points, 0, c._points.size());
+            return output;
+        }
+        else if (type == "LineString" && height == 1)
+        {
+            LineString* output = new LineString(c._points.size());
+            populate(output, c._points, 0, c._points.size());
+            return output;
+        }
+        else if (type == "MultiLineString" && height == 2)
+        {
+            MultiGeometry* output = new MultiGeometry();
+            for (unsigned i = 0; i < c._ends[0].size(); ++i)
+            {
+                unsigned begin = i > 0 ? c._ends[0][i-1] : 0u;
+                LineString* part = new LineString(c._ends[0][i] - begin);
+                populate(part, c._points, begin, c._ends[0][i]);
+                output->getComponents().push_back(part);
+            }
+            return output;
+        }
+        else if (type == "Polygon" && height == 2)
+        {
+            return createPolygon(c, 0, c._ends[0].size());
+        }
+        else if (type == "MultiPolygon" && height == 3)
+        {
+            MultiGeometry* output = new MultiGeometry();
+            for (unsigned i = 0; i < c._ends[1].size(); ++i)
+            {
+                unsigned begin = i > 0 ? c._ends[1][i-1] : 0u;
+                Polygon* part = createPolygon(c, begin, c._ends[1][i]);
+                if (part)
+                    output->getComponents().push_back(part);
+            }
+            return output;
+        }
+        else if (type == "GeometryCollection" && collection)
+        {
+            return collection;
+        }
+        return 0L;
+    }
+
+    bool isGeometryType(const std::string& type)
+    {
+        return
+            type == "Point" || type == "MultiPoint" ||
+            type == "LineString" || type == "MultiLineString" ||
+            type == "Polygon" || type == "MultiPolygon" ||
+            type == "GeometryCollection";
+    }
+
+    class Reader
+    {
+    public:
+        Reader(const char* data, unsigned size, const FeatureProfile* profile) :
+            _in(data, size),
+            _profile(profile),
+            _srs(profile ? profile->getSRS() : 0L),
+            _nextFID(0)
+        {
+            //nop
+        }
+
+        bool read(FeatureList& output)
+        {
+            return readObject(output, true) && _in.atEnd();
+        }
+
+    private:
+
+        // Reads a Feature, or at the top level, a FeatureCollection or geometry.
+        bool readObject(FeatureList& output, bool topLevel)
+        {
+            if (!_in.expect('{'))
+                return false;
+
+            std::string type, key;
+            osg::ref_ptr<Feature> feature = new Feature(0L, _srs);
+            bool hasFID = false;
+            osg::ref_ptr<Geometry> geometry;
+            osg::ref_ptr<MultiGeometry> collection;
+            Coords coords;
+            int height = -1;
+
+            if (!_in.accept('}'))
+            {
+                do
+                {
+                    if (!_in.string(key) || !_in.expect(':'))
+                        return false;
+
+                    bool ok = true;
+
+                    if (key == "type")
+                    {
+                        ok = _in.string(type);
+                    }
+                    else if (key == "features" && topLevel)
+                    {
+                        ok = _in.expect('[');
+                        if (ok && !_in.accept(']'))
+                        {
+                            do {
+                                ok = readObject(output, false);
+                            } while (ok && _in.accept(','));
+                            ok = ok && _in.expect(']');
+                        }
+                    }
+                    else if (key == "geometry")
+                    {
+                        ok = readGeometry(geometry);
+                    }
+                    else if (key == "properties")
+                    {
+                        ok = readProperties(feature.get());
+                    }
+                    else if (key == "id")
+                    {
+                        ok = readID(feature.get(), hasFID);
+                    }
+                    else if (key == "coordinates" && topLevel)
+                    {
+                        ok = readCoords(coords, height);
+                    }
+                    else if (key == "geometries" && topLevel)
+                    {
+                        ok = readGeometries(collection);
+                    }
+                    else
+                    {
+                        ok = _in.skip();
+                    }
+
+                    if (!ok)
+                        return false;
+
+                } while (_in.accept(','));
+
+                if (!_in.expect('}'))
+                    return false;
+            }
+
+            if (type == "Feature")
+            {
+                feature->setGeometry(geometry.get());
+            }
+            else if (topLevel && type == "FeatureCollection")
+            {
+                return true;
+            }
+            else if (topLevel && isGeometryType(type))
+            {
+                // a bare geometry becomes a single feature.
+                feature->setGeometry(createGeometry(type, coords, height, collection.get()));
+            }
+            else
+            {
+                return false;
+            }
+
+            // like OGR, number features in order when they have no numeric ID.
+            FeatureID index = _nextFID++;
+            if (!hasFID)
+                feature->setFID(index);
+
+            if (_profile && _profile->geoInterp().isSet())
+                feature->geoInterp() = _profile->geoInterp().get();
+
+            output.push_back(feature.get());
+            return true;
+        }
+
+        bool readID(Feature* feature, bool& hasFID)
+        {
+            if (_in.peek('"'))
+            {
+                // non-numeric IDs are kept as an attribute
+                std::string value;
+                if (!_in.string(value))
+                    return false;
+                feature->set("id", value);
+                return true;
+            }
+            else if (_in.atNumber())
+            {
+                double value;
+                bool isInteger;
+                if (!_in.number(value, isInteger))
+                    return false;
+                feature->setFID((FeatureID)value);
+                hasFID = true;
+                return true;
+            }
+            return _in.skip();
+        }
+
+        bool readGeometry(osg::ref_ptr<Geometry>& output)
+        {
+            if (_in.literal("null"))
+                return true;
+
+            if (!_in.expect('{'))
+                return false;
+
+            std::string type, key;
+            osg::ref_ptr<MultiGeometry> collection;
+            Coords coords;
+            int height = -1;
+
+            if (!_in.accept('}'))
+            {
+                do
+                {
+                    if (!_in.string(key) || !_in.expect(':'))
+                        return false;
+
+                    bool ok =
+                        key == "type"        ? _in.string(type) :
+                        key == "coordinates" ? readCoords(coords, height) :
+                        key == "geometries"  ? readGeometries(collection) :
+                        _in.skip();
+
+                    if (!ok)
+                        return false;
+
+                } while (_in.accept(','));
+
+                if (!_in.expect('}'))
+                    return false;
+            }
+
+            output = createGeometry(type, coords, height, collection.get());
+            return true;
+        }
+
+        bool readGeometries(osg::ref_ptr<MultiGeometry>& output)
+        {
+            output = new MultiGeometry();
+
+            if (!_in.expect('['))
+                return false;
+
+            if (_in.accept(']'))
+                return true;
+
+            do
+            {
+                osg::ref_ptr<Geometry> part;
+                if (!readGeometry(part))
+                    return false;
+                if (part.valid())
+                    output->getComponents().push_back(part.get());
+            }
+            while (_in.accept(','));
+
+            return _in.expect(']');
+        }
+
+        bool readCoords(Coords& c, int& height)
+        {
+            if (!_in.expect('['))
+                return false;
+
+            // a position:
+            if (_in.atNumber())
+            {
+                double v[3] = { 0.0, 0.0, 0.0 };
+                unsigned n = 0;
+                bool isInteger;
+                do
+                {
+                    double d;
+                    if (!_in.number(d, isInteger))
+                        return false;
+                    if (n < 3)
+                        v[n] = d;
+                    ++n;
+                }
+                while (_in.accept(','));
+
+                if (n < 2 || !_in.expect(']'))
+                    return false;
+
+                c._points.push_back(osg::Vec3d(v[0], v[1], v[2]));
+                height = 0;
+                return true;
+            }
+
+            // an array of arrays (or an empty array):
+            int childHeight = 0;
+            if (!_in.accept(']'))
+            {
+                childHeight = -1;
+                do
+                {
+                    int h;
+                    if (!readCoords(c, h))
+                        return false;
+                    if (childHeight >= 0 && h != childHeight)
+                        return false;
+                    childHeight = h;
+                }
+                while (_in.accept(','));
+
+                if (!_in.expect(']'))
+                    return false;
+            }
+
+            height = childHeight + 1;
+            if (height > 4)
+                return false;
+
+            c._ends[height-1].push_back(height == 1 ? c._points.size() : c._ends[height-2].size());
+            return true;
+        }
+
+        bool readProperties(Feature* feature)
+        {
+            if (_in.literal("null"))
+                return true;
+
+            if (!_in.expect('{'))
+                return false;
+
+            if (_in.accept('}'))
+                return true;
+
+            std::string key, value;
+            do
+            {
+                if (!_in.string(key) || !_in.expect(':'))
+                    return false;
+
+                std::string name = toLower(key);
+
+                if (_in.peek('"'))
+                {
+                    if (!_in.string(value))
+                        return false;
+                    feature->set(name, value);
+                }
+                else if (_in.atNumber())
+                {
+                    double d;
+                    bool isInteger;
+                    if (!_in.number(d, isInteger))
+                        return false;
+
+                    if (isInteger && d >= (double)INT_MIN && d <= (double)INT_MAX)
+                        feature->set(name, (int)d);
+                    else
+                        feature->set(name, d);
+                }
+                else if (_in.literal("true"))
+                {
+                    feature->set(name, 1);
+                }
+                else if (_in.literal("false"))
+                {
+                    feature->set(name, 0);
+                }
+                else if (_in.literal("null"))
+                {
+                    feature->setNull(name);
+                }
+                else
+                {
+                    // nested objects and arrays are kept as JSON text
+                    _in.ws();
+                    const char* start = _in.pos();
+                    if (!_in.skip())
+                        return false;
+                    feature->set(name, std::string(start, _in.pos()));
+                }
+            }
+            while (_in.accept(','));
+
+            return _in.expect('}');
+        }
+
+        Scanner                 _in;
+        const FeatureProfile*   _profile;
+        const SpatialReference* _srs;
+        FeatureID               _nextFID;
+    };
+}
+
+bool
+GeoJSONReader::read(const char* data, unsigned size, const FeatureProfile* profile, FeatureList& features)
+{
+    if (!data || size == 0)
+        return false;
+
+    FeatureList output;
+    Reader reader(data, size, profile);
+    if (!reader.read(output))
+    {
+        OE_DEBUG << LC << "Input is not GeoJSON that this reader understands" << std::endl;
+        return false;
+    }
+
+    features.splice(features.end(), output);
+    return true;
+}
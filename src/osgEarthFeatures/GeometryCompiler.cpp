@@ -64,6 +64,9 @@ _maxGranularity_deg    ( 10.0 ),
 _mergeGeometry         ( true ),
 _clustering            ( false ),
 _instancing            ( false ),
+_instanceCulling       ( false ),
+_instanceMaxRange      ( FLT_MAX ),
+_textureArrays         ( false ),
 _ignoreAlt             ( false ),
 _useVertexBufferObjects( true ),
 _shaderPolicy          ( SHADERPOLICY_GENERATE ),
@@ -71,7 +74,8 @@ _geoInterp             ( GEOINTERP_GREAT_CIRCLE ),
 _optimizeStateSharing  ( true ),
 _optimize              ( false ),
 _validate              ( false ),
-_maxPolyTilingAngle    ( 45.0f )
+_maxPolyTilingAngle    ( 45.0f ),
+_tessellator           ( Tessellator::METHOD_FAST )
 {
    //nop
 }
@@ -83,6 +87,9 @@ _maxGranularity_deg    ( s_defaults.maxGranularity().value() ),
 _mergeGeometry         ( s_defaults.mergeGeometry().value() ),
 _clustering            ( s_defaults.clustering().value() ),
 _instancing            ( s_defaults.instancing().value() ),
+_instanceCulling       ( s_defaults.instanceCulling().value() ),
+_instanceMaxRange      ( s_defaults.instanceMaxRange().value() ),
+_textureArrays         ( s_defaults.textureArrays().value() ),
 _ignoreAlt             ( s_defaults.ignoreAltitudeSymbol().value() ),
 _useVertexBufferObjects( s_defaults.useVertexBufferObjects().value() ),
 _shaderPolicy          ( s_defaults.shaderPolicy().value() ),
@@ -90,7 +97,8 @@ _geoInterp             ( s_defaults.geoInterp().value() ),
 _optimizeStateSharing  ( s_defaults.optimizeStateSharing().value() ),
 _optimize              ( s_defaults.optimize().value() ),
 _validate              ( s_defaults.validate().value() ),
-_maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() )
+_maxPolyTilingAngle    ( s_defaults.maxPolygonTilingAngle().value() ),
+_tessellator           ( s_defaults.tessellator().value() )
 {
     fromConfig(conf.getConfig());
 }
@@ -102,6 +110,9 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.getIfSet   ( "merge_geometry",   _mergeGeometry );
     conf.getIfSet   ( "clustering",       _clustering );
     conf.getIfSet   ( "instancing",       _instancing );
+    conf.getIfSet   ( "instance_culling", _instanceCulling );
+    conf.getIfSet   ( "instance_max_range", _instanceMaxRange );
+    conf.getIfSet   ( "texture_arrays",   _textureArrays );
     conf.getObjIfSet( "feature_name",     _featureNameExpr );
     conf.getIfSet   ( "ignore_altitude",  _ignoreAlt );
     conf.getIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
@@ -111,6 +122,8 @@ GeometryCompilerOptions::fromConfig( const Config& conf )
     conf.getIfSet   ( "optimize", _optimize );
     conf.getIfSet   ( "validate", _validate );
     conf.getIfSet   ( "max_polygon_tiling_angle", _maxPolyTilingAngle );
+    conf.getIfSet   ( "tessellator", "fast",         _tessellator, Tessellator::METHOD_FAST );
+    conf.getIfSet   ( "tessellator", "ear_clipping", _tessellator, Tessellator::METHOD_EAR_CLIPPING );
 
     conf.getIfSet( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.getIfSet( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -125,6 +138,9 @@ GeometryCompilerOptions::getConfig() const
     conf.addIfSet   ( "merge_geometry",   _mergeGeometry );
     conf.addIfSet   ( "clustering",       _clustering );
     conf.addIfSet   ( "instancing",       _instancing );
+    conf.addIfSet   ( "instance_culling", _instanceCulling );
+    conf.addIfSet   ( "instance_max_range", _instanceMaxRange );
+    conf.addIfSet   ( "texture_arrays",   _textureArrays );
     conf.addObjIfSet( "feature_name",     _featureNameExpr );
     conf.addIfSet   ( "ignore_altitude",  _ignoreAlt );
     conf.addIfSet   ( "geo_interpolation", "great_circle", _geoInterp, GEOINTERP_GREAT_CIRCLE );
@@ -134,6 +150,8 @@ GeometryCompilerOptions::getConfig() const
     conf.addIfSet   ( "optimize", _optimize );
     conf.addIfSet   ( "validate", _validate );
     conf.addIfSet   ( "max_polygon_tiling_angle", _maxPolyTilingAngle );
+    conf.addIfSet   ( "tessellator", "fast",         _tessellator, Tessellator::METHOD_FAST );
+    conf.addIfSet   ( "tessellator", "ear_clipping", _tessellator, Tessellator::METHOD_EAR_CLIPPING );
 
     conf.addIfSet( "shader_policy", "disable",  _shaderPolicy, SHADERPOLICY_DISABLE );
     conf.addIfSet( "shader_policy", "inherit",  _shaderPolicy, SHADERPOLICY_INHERIT );
@@ -209,6 +227,19 @@ GeometryCompiler::compile(FeatureCursor*        cursor,
     return compile(workingSet, style, context);
 }
 
+osg::Node*
+GeometryCompiler::compile(const FeatureTable*   table,
+                          const Style&          style,
+                          const FilterContext&  context)
+{
+    // filters modify their input, so build a working set from the table.
+    FeatureList workingSet;
+    if ( table )
+        table->toFeatureList( workingSet );
+
+    return compile(workingSet, style, context);
+}
+
 osg::Node*
 GeometryCompiler::compile(FeatureList&          workingSet,
                           const Style&          style,
@@ -364,6 +395,11 @@ GeometryCompiler::compile(FeatureList&          workingSet,
 
         sub.setUseDrawInstanced( *_options.instancing() );
 
+        sub.setCullInstances( *_options.instanceCulling() );
+        sub.setInstanceMaxRange( *_options.instanceMaxRange() );
+
+        sub.setUseTextureArrays( *_options.textureArrays() );
+
         if ( _options.featureName().isSet() )
             sub.setFeatureNameExpr( *_options.featureName() );
 
@@ -418,6 +454,13 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         // activate draw-instancing
         sub.setUseDrawInstanced( *_options.instancing() );
 
+        // per-instance culling and LOD for draw-instancing
+        sub.setCullInstances( *_options.instanceCulling() );
+        sub.setInstanceMaxRange( *_options.instanceMaxRange() );
+
+        // activate shared texture arrays for library icons
+        sub.setUseTextureArrays( *_options.textureArrays() );
+
         // activate feature naming
         if ( _options.featureName().isSet() )
             sub.setFeatureNameExpr( *_options.featureName() );
@@ -460,6 +503,11 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         if ( _options.mergeGeometry().isSet() )
             extrude.setMergeGeometry( *_options.mergeGeometry() );
 
+        if ( _options.tessellator().isSet() )
+            extrude.setTessellator( *_options.tessellator() );
+
+        extrude.setUseTextureArrays( *_options.textureArrays() );
+
         osg::Node* node = extrude.push( workingSet, sharedCX );
         if ( node )
         {
@@ -488,6 +536,9 @@ GeometryCompiler::compile(FeatureList&          workingSet,
         if (_options.maxPolygonTilingAngle().isSet())
             filter.maxPolygonTilingAngle() = *_options.maxPolygonTilingAngle();
 
+        if (_options.tessellator().isSet())
+            filter.tessellator() = *_options.tessellator();
+
         if ( _options.featureName().isSet() )
             filter.featureName() = *_options.featureName();
 
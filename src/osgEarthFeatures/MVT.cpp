@@ -22,7 +22,9 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/GeoData>
 #include <osgEarthFeatures/FeatureSource>
+#include <algorithm>
 #include <list>
+#include <map>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -62,248 +64,519 @@ int zig_zag_decode(int n)
 
 #ifdef OSGEARTH_HAVE_MVT
 
-Geometry* decodeLine(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
+namespace
 {
-    unsigned int length = 0;
-    int cmd = -1;
-    const int cmd_bits = 3;
-
-    int x = 0;
-    int y = 0;
+    // Maps tile-local integer coordinates to the tile key's extent.
+    struct TileXform
+    {
+        double _x0, _y0, _sx, _sy;
 
-    std::vector< osg::ref_ptr< osgEarth::Symbology::LineString > > lines;
-    osg::ref_ptr< osgEarth::Symbology::LineString > currentLine;
+        TileXform(const TileKey& key, unsigned int tileres)
+        {
+            const GeoExtent& e = key.getExtent();
+            _x0 = e.xMin();
+            _y0 = e.yMax();
+            _sx = e.width()  / (double)tileres;
+            _sy = e.height() / (double)tileres;
+        }
+    };
 
-    for (int k = 0; k < feature.geometry_size();)
+    // Reads a std::streambuf directly from a memory block (no copy).
+    struct MemoryBuffer : public std::streambuf
     {
-        if (!length)
+        MemoryBuffer(const char* data, unsigned size)
         {
-            unsigned int cmd_length = feature.geometry(k++);
-            cmd = cmd_length & ((1 << cmd_bits) - 1);
-            length = cmd_length >> cmd_bits;
+            char* p = const_cast<char*>(data);
+            setg(p, p, p + size);
         }
-        if (length > 0)
-        {
-            length--;
+    };
+
+    // Whether a buffer starts with a gzip or zlib header. An uncompressed
+    // tile starts with a protobuf field tag (0x1a for "layers").
+    bool isCompressed(const char* data, unsigned size)
+    {
+        if ( size < 2 )
+            return false;
+        unsigned char b0 = (unsigned char)data[0], b1 = (unsigned char)data[1];
+        if ( b0 == 0x1f && b1 == 0x8b )
+            return true;
+        return (b0 & 0x0f) == 8 && ((b0 << 8) | b1) % 31 == 0;
+    }
 
-            if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+    /**
+     * Decodes the command stream of a feature into one flat coordinate buffer.
+     * Each MoveTo starts a new part (recorded in "starts"); a ClosePath marks
+     * the current part as closed.
+     */
+    void decodePath(const mapnik::vector::tile_feature& feature,
+                    const TileXform&                    xform,
+                    std::vector<osg::Vec3d>&            points,
+                    std::vector<unsigned>&              starts,
+                    std::vector<char>&                  closed)
+    {
+        unsigned int length = 0;
+        int cmd = -1;
+        int x = 0;
+        int y = 0;
+        int size = feature.geometry_size();
+
+        points.clear();
+        starts.clear();
+        closed.clear();
+        points.reserve( size/2 );
+
+        for (int k = 0; k < size;)
+        {
+            if (!length)
             {
-                if (cmd == SEG_MOVETO)
-                {
-                    currentLine = new osgEarth::Symbology::LineString;
-                    lines.push_back( currentLine.get() );
-                }
-                int px = feature.geometry(k++);
-                int py = feature.geometry(k++);
-                px = zig_zag_decode(px);
-                py = zig_zag_decode(py);
+                unsigned int cmd_length = feature.geometry(k++);
+                cmd = cmd_length & ((1 << CMD_BITS) - 1);
+                length = cmd_length >> CMD_BITS;
+            }
+            if (length > 0)
+            {
+                length--;
 
-                x += px;
-                y += py;
+                if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+                {
+                    if (k + 1 >= size)
+                        break;
 
-                double width = key.getExtent().width();
-                double height = key.getExtent().height();
+                    if (cmd == SEG_MOVETO || starts.empty())
+                    {
+                        starts.push_back( points.size() );
+                        closed.push_back( 0 );
+                    }
 
-                double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
+                    x += zig_zag_decode(feature.geometry(k++));
+                    y += zig_zag_decode(feature.geometry(k++));
 
-                if (currentLine.valid())
+                    points.push_back( osg::Vec3d(
+                        xform._x0 + xform._sx * (double)x,
+                        xform._y0 - xform._sy * (double)y,
+                        0.0) );
+                }
+                else if (cmd == (SEG_CLOSE & ((1 << CMD_BITS) - 1)))
                 {
-                    currentLine->push_back(geoX, geoY, 0);
+                    if (!closed.empty())
+                        closed.back() = 1;
                 }
             }
         }
     }
 
-    currentLine = 0;
+    template<typename T>
+    T* createPart(const std::vector<osg::Vec3d>& points, unsigned first, unsigned last)
+    {
+        T* part = new T( last - first );
+        part->insert( part->end(), points.begin() + first, points.begin() + last );
+        return part;
+    }
 
-    if (lines.size() == 0)
+    Geometry* decodeLine(const std::vector<osg::Vec3d>& points, const std::vector<unsigned>& starts)
     {
-        return 0;
+        if (starts.size() == 0)
+        {
+            return 0;
+        }
+        else if (starts.size() == 1)
+        {
+            // Just return a simple LineString
+            return createPart<LineString>(points, 0, points.size());
+        }
+        else
+        {
+            // Return a multilinestring
+            MultiGeometry* multi = new MultiGeometry;
+            for (unsigned int i = 0; i < starts.size(); i++)
+            {
+                unsigned last = i+1 < starts.size() ? starts[i+1] : points.size();
+                multi->add( createPart<LineString>(points, starts[i], last) );
+            }
+            return multi;
+        }
     }
-    else if (lines.size() == 1)
+
+    Geometry* decodePoint(const std::vector<osg::Vec3d>& points)
     {
-        // Just return a simple LineString
-        return lines[0].release();
+        return createPart<PointSet>(points, 0, points.size());
     }
-    else
+
+    Geometry* decodePolygon(const std::vector<osg::Vec3d>& points, const std::vector<unsigned>& starts, const std::vector<char>& closed)
     {
-        // Return a multilinestring
-        MultiGeometry* multi = new MultiGeometry;
-        for (unsigned int i = 0; i < lines.size(); i++)
+        /*
+         https://github.com/mapbox/vector-tile-spec/tree/master/2.1
+         Decoding polygons is a bit more difficult than lines or points.
+         A Polygon geometry is either a single polygon or a multipolygon.  Each polygon has one exterior ring and zero or more interior rings.
+         The rings are in sequence and you must check the orientation of the ring to know if it's an exterior ring (new polygon) or an
+         interior ring (inner polygon of the current polygon).
+         */
+
+        // The list of polygons we've collected
+        std::vector< osg::ref_ptr< osgEarth::Symbology::Polygon > > polygons;
+
+        osg::ref_ptr< osgEarth::Symbology::Polygon > currentPolygon;
+
+        for (unsigned int i = 0; i < starts.size(); i++)
         {
-            multi->add(lines[i].get());
-        }
-        return multi;
-    }
-}
+            // rings that are never closed are not part of the polygon.
+            if (!closed[i])
+                continue;
 
-Geometry* decodePoint(const mapnik::vector::tile_feature& feature, const TileKey& key, unsigned int tileres)
-{
-    unsigned int length = 0;
-    int cmd = -1;
-    const int cmd_bits = 3;
+            unsigned last = i+1 < starts.size() ? starts[i+1] : points.size();
+            osg::ref_ptr< osgEarth::Symbology::Ring > currentRing = createPart<Ring>(points, starts[i], last);
 
-    int x = 0;
-    int y = 0;
+            // SEG_CLOSE: repeat the first point, as the original decoder did.
+            currentRing->close();
 
-    osgEarth::Symbology::PointSet *geometry = new osgEarth::Symbology::PointSet();
+            // The orientation is the opposite of what we want for features.  clockwise means exterior ring, counter clockwise means interior
+            Geometry::Orientation orientation = currentRing->getOrientation();
 
-    for (int k = 0; k < feature.geometry_size();)
-    {
-        if (!length)
+            // Clockwise means exterior ring.  Start a new polygon and add the ring.
+            if (orientation == Geometry::ORIENTATION_CW)
+            {
+                // osgearth orientations are reversed from mvt
+                currentRing->rewind(Geometry::ORIENTATION_CCW);
+
+                currentPolygon = new osgEarth::Symbology::Polygon(&currentRing->asVector());
+                polygons.push_back(currentPolygon.get());
+            }
+            else if (orientation == Geometry::ORIENTATION_CCW)
+            // Counter clockwise means a hole, add it to the existing polygon.
+            {
+                if (currentPolygon.valid())
+                {
+                    // osgearth orientations are reversed from mvt
+                    currentRing->rewind(Geometry::ORIENTATION_CW);
+                    currentPolygon->getHoles().push_back( currentRing.get() );
+                }
+                else
+                {
+                    // this means we encountered a "hole" without a parent outer ring,
+                    // discard for now -gw
+                    OE_INFO << LC << "Discarding improperly wound polygon (hole without an outer ring)\n";
+                }
+            }
+        }
+
+        currentPolygon = 0;
+
+        if (polygons.size() == 0)
+        {
+            return 0;
+        }
+        else if (polygons.size() == 1)
         {
-            unsigned int cmd_length = feature.geometry(k++);
-            cmd = cmd_length & ((1 << cmd_bits) - 1);
-            length = cmd_length >> cmd_bits;
+            // Just return a simple polygon
+            return polygons[0].release();
         }
-        if (length > 0)
+        else
         {
-            length--;
-            if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+            // Return a multipolygon
+            MultiGeometry* multi = new MultiGeometry;
+            for (unsigned int i = 0; i < polygons.size(); i++)
             {
-                int px = feature.geometry(k++);
-                int py = feature.geometry(k++);
-                px = zig_zag_decode(px);
-                py = zig_zag_decode(py);
+                multi->add(polygons[i].get());
+            }
+            return multi;
+        }
+    }
 
-                x += px;
-                y += py;
+    // Converts a tile value to an attribute value.
+    void decodeValue(const mapnik::vector::tile_value& value, AttributeValue& out)
+    {
+        out.second.set = true;
 
-                double width = key.getExtent().width();
-                double height = key.getExtent().height();
+        if (value.has_bool_value())
+        {
+            out.first = ATTRTYPE_BOOL;
+            out.second.boolValue = value.bool_value();
+        }
+        else if (value.has_double_value())
+        {
+            out.first = ATTRTYPE_DOUBLE;
+            out.second.doubleValue = value.double_value();
+        }
+        else if (value.has_float_value())
+        {
+            out.first = ATTRTYPE_DOUBLE;
+            out.second.doubleValue = value.float_value();
+        }
+        else if (value.has_int_value())
+        {
+            out.first = ATTRTYPE_INT;
+            out.second.intValue = (int)value.int_value();
+        }
+        else if (value.has_sint_value())
+        {
+            out.first = ATTRTYPE_INT;
+            out.second.intValue = (int)value.sint_value();
+        }
+        else if (value.has_string_value())
+        {
+            out.first = ATTRTYPE_STRING;
+            out.second.stringValue = value.string_value();
+        }
+        else if (value.has_uint_value())
+        {
+            out.first = ATTRTYPE_INT;
+            out.second.intValue = (int)value.uint_value();
+        }
+        else
+        {
+            out.first = ATTRTYPE_UNSPECIFIED;
+            out.second.set = false;
+        }
+    }
 
-                double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                geometry->push_back(geoX, geoY, 0);
+    // Special path for getting heights from our test dataset.
+    void decodeOtherTags(const std::string& other_tags, Feature* feature)
+    {
+        StringTokenizer tok("=>");
+        StringVector tized;
+        tok.tokenize(other_tags, tized);
+        if (tized.size() == 3)
+        {
+            if (tized[0] == "height")
+            {
+                std::string value = tized[2];
+                // Remove quotes from the height
+                float height = as<float>(value, FLT_MAX);
+                if (height != FLT_MAX)
+                {
+                    feature->set("height", height);
+                }
             }
         }
     }
 
-    return geometry;
-}
-
-Geometry* decodePolygon(const mapnik::vector::tile_feature& feature, const  TileKey& key, unsigned int tileres)
-{
-    /*
-     https://github.com/mapbox/vector-tile-spec/tree/master/2.1
-     Decoding polygons is a bit more difficult than lines or points.
-     A Polygon geometry is either a single polygon or a multipolygon.  Each polygon has one exterior ring and zero or more interior rings.
-     The rings are in sequence and you must check the orientation of the ring to know if it's an exterior ring (new polygon) or an
-     interior ring (inner polygon of the current polygon).
-     */
+    //........................................................................
+    // Encoding
 
+    int zig_zag_encode(int n)
+    {
+        return (n << 1) ^ (n >> 31);
+    }
 
-    unsigned int length = 0;
-    int cmd = -1;
-    const int cmd_bits = 3;
+    unsigned command(unsigned id, unsigned count)
+    {
+        return (id & ((1 << CMD_BITS) - 1)) | (count << CMD_BITS);
+    }
 
-    int x = 0;
-    int y = 0;
+    struct TilePoint
+    {
+        TilePoint(int x, int y) : _x(x), _y(y) { }
+        bool operator == (const TilePoint& rhs) const { return _x == rhs._x && _y == rhs._y; }
+        int _x, _y;
+    };
+    typedef std::vector<TilePoint> TilePoints;
+
+    // Squared distance from p to the segment a-b.
+    double distance2(const TilePoint& p, const TilePoint& a, const TilePoint& b)
+    {
+        double dx = b._x - a._x, dy = b._y - a._y;
+        double len2 = dx*dx + dy*dy;
+        double t = len2 > 0.0 ? osg::clampBetween(((p._x - a._x)*dx + (p._y - a._y)*dy) / len2, 0.0, 1.0) : 0.0;
+        double ex = a._x + t*dx - p._x, ey = a._y + t*dy - p._y;
+        return ex*ex + ey*ey;
+    }
 
-    // The list of polygons we've collected
-    std::vector< osg::ref_ptr< osgEarth::Symbology::Polygon > > polygons;
+    // Douglas-Peucker: marks the points between first and last to keep.
+    void simplify(const TilePoints& points, unsigned first, unsigned last, double tolerance2, std::vector<char>& keep)
+    {
+        std::vector< std::pair<unsigned,unsigned> > stack;
+        stack.push_back( std::make_pair(first, last) );
+        while (!stack.empty())
+        {
+            unsigned a = stack.back().first, b = stack.back().second;
+            stack.pop_back();
 
-    osg::ref_ptr< osgEarth::Symbology::Polygon > currentPolygon;
+            double maxDist2 = 0.0;
+            unsigned index = a;
+            for (unsigned i = a + 1; i < b; ++i)
+            {
+                double d2 = distance2(points[i], points[a], points[b]);
+                if (d2 > maxDist2)
+                {
+                    maxDist2 = d2;
+                    index = i;
+                }
+            }
 
-    osg::ref_ptr< osgEarth::Symbology::Ring > currentRing;
+            if (maxDist2 > tolerance2)
+            {
+                keep[index] = 1;
+                stack.push_back( std::make_pair(a, index) );
+                stack.push_back( std::make_pair(index, b) );
+            }
+        }
+    }
 
-    for (int k = 0; k < feature.geometry_size();)
+    /**
+     * Writes geometry parts into the command stream of one tile feature, in
+     * tile-local integer coordinates. The pen position carries over from one
+     * part to the next, as the spec requires.
+     */
+    struct PathEncoder
     {
-        if (!length)
+        PathEncoder(mapnik::vector::tile_feature* feature, const TileXform& xform, double tolerance) :
+            _feature(feature), _xform(xform), _tolerance2(tolerance*tolerance), _x(0), _y(0)
         {
-            unsigned int cmd_length = feature.geometry(k++);
-            cmd = cmd_length & ((1 << cmd_bits) - 1);
-            length = cmd_length >> cmd_bits;
         }
-        if (length > 0)
+
+        // Quantizes a part to the tile grid, dropping repeated points and
+        // simplifying what's left.
+        void quantize(const Geometry* part, bool ring, TilePoints& out) const
         {
-            length--;
-            if (cmd == SEG_MOVETO || cmd == SEG_LINETO)
+            out.clear();
+            out.reserve( part->size() );
+            for (Geometry::const_iterator i = part->begin(); i != part->end(); ++i)
             {
-                if (!currentRing)
-                {
-                    currentRing = new osgEarth::Symbology::Ring();
-                }
-
-                int px = feature.geometry(k++);
-                int py = feature.geometry(k++);
-                px = zig_zag_decode(px);
-                py = zig_zag_decode(py);
-
-                x += px;
-                y += py;
+                TilePoint p(
+                    (int)floor((i->x() - _xform._x0) / _xform._sx + 0.5),
+                    (int)floor((_xform._y0 - i->y()) / _xform._sy + 0.5) );
+                if (out.empty() || !(out.back() == p))
+                    out.push_back( p );
+            }
 
-                double width = key.getExtent().width();
-                double height = key.getExtent().height();
+            // rings are encoded open; the ClosePath command closes them.
+            if (ring && out.size() > 1 && out.front() == out.back())
+                out.pop_back();
 
-                double geoX = key.getExtent().xMin() + (width/(double)tileres) * (double)x;
-                double geoY = key.getExtent().yMax() - (height/(double)tileres) * (double)y;
-                currentRing->push_back(geoX, geoY, 0);
-            }
-            else if (cmd == (SEG_CLOSE & ((1 << cmd_bits) - 1)))
+            if (_tolerance2 > 0.0 && out.size() > 2)
             {
-                // The orientation is the opposite of what we want for features.  clockwise means exterior ring, counter clockwise means interior
+                // a ring simplifies as a line that ends where it starts.
+                if (ring)
+                    out.push_back( out.front() );
+
+                std::vector<char> keep( out.size(), 0 );
+                keep.front() = keep.back() = 1;
+                simplify(out, 0, out.size()-1, _tolerance2, keep);
+
+                unsigned n = 0;
+                for (unsigned i = 0; i < out.size(); ++i)
+                    if (keep[i])
+                        out[n++] = out[i];
+                out.resize( n );
+
+                if (ring)
+                    out.pop_back();
+            }
+        }
 
-                // Figure out what to do with the ring based on the orientation of the ring
-                Geometry::Orientation orientation = currentRing->getOrientation();
-                // Close the ring.
-                currentRing->close();
+        void moveTo(const TilePoint& p, unsigned count)
+        {
+            _feature->add_geometry( command(CMD_MOVETO, count) );
+            delta(p);
+        }
 
-                // Clockwise means exterior ring.  Start a new polygon and add the ring.
-                if (orientation == Geometry::ORIENTATION_CW)
-                {
-                    // osgearth orientations are reversed from mvt
-                    currentRing->rewind(Geometry::ORIENTATION_CCW);
+        void delta(const TilePoint& p)
+        {
+            _feature->add_geometry( zig_zag_encode(p._x - _x) );
+            _feature->add_geometry( zig_zag_encode(p._y - _y) );
+            _x = p._x;
+            _y = p._y;
+        }
 
-                    currentPolygon = new osgEarth::Symbology::Polygon(&currentRing->asVector());
-                    polygons.push_back(currentPolygon.get());
-                }
-                else if (orientation == Geometry::ORIENTATION_CCW)
-                // Counter clockwise means a hole, add it to the existing polygon.
-                {
-                    if (currentPolygon.valid())
-                    {
-                        // osgearth orientations are reversed from mvt
-                        currentRing->rewind(Geometry::ORIENTATION_CW);
-                        currentPolygon->getHoles().push_back( currentRing );
-                    }
-                    else
-                    {
-                        // this means we encountered a "hole" without a parent outer ring,
-                        // discard for now -gw
-                        OE_INFO << LC << "Discarding improperly wound polygon (hole without an outer ring)\n";
-                    }
-                }
+        bool addPoints(const Geometry* part)
+        {
+            TilePoints points;
+            quantize(part, false, points);
+            if (points.empty())
+                return false;
+
+            _feature->add_geometry( command(CMD_MOVETO, points.size()) );
+            for (unsigned i = 0; i < points.size(); ++i)
+                delta(points[i]);
+            return true;
+        }
 
-                // Start a new ring
-                currentRing = 0;
-            }
+        bool addLine(const Geometry* part)
+        {
+            TilePoints points;
+            quantize(part, false, points);
+            if (points.size() < 2)
+                return false;
+
+            moveTo(points[0], 1);
+            _feature->add_geometry( command(CMD_LINETO, points.size()-1) );
+            for (unsigned i = 1; i < points.size(); ++i)
+                delta(points[i]);
+            return true;
         }
-    }
 
-    currentRing = 0;
-    currentPolygon = 0;
+        // Exterior rings have a positive area in tile coordinates (y down);
+        // holes have a negative area.
+        bool addRing(const Geometry* part, bool exterior)
+        {
+            TilePoints points;
+            quantize(part, true, points);
+            if (points.size() < 3)
+                return false;
+
+            double area = 0.0;
+            for (unsigned i = 0, j = points.size()-1; i < points.size(); j = i++)
+                area += (double)points[j]._x * (double)points[i]._y - (double)points[i]._x * (double)points[j]._y;
+            if (area == 0.0)
+                return false;
+            if ((area > 0.0) != exterior)
+                std::reverse( points.begin(), points.end() );
+
+            moveTo(points[0], 1);
+            _feature->add_geometry( command(CMD_LINETO, points.size()-1) );
+            for (unsigned i = 1; i < points.size(); ++i)
+                delta(points[i]);
+            _feature->add_geometry( command(CMD_CLOSEPATH, 1) );
+            return true;
+        }
 
-    if (polygons.size() == 0)
-    {
-        return 0;
-    }
-    else if (polygons.size() == 1)
-    {
-        // Just return a simple polygon
-        return polygons[0].release();
-    }
-    else
+        mapnik::vector::tile_feature* _feature;
+        const TileXform&              _xform;
+        double                        _tolerance2;
+        int                           _x, _y;
+    };
+
+    // Shares keys and values among the features of a layer.
+    struct TagEncoder
     {
-        // Return a multipolygon
-        MultiGeometry* multi = new MultiGeometry;
-        for (unsigned int i = 0; i < polygons.size(); i++)
+        TagEncoder(mapnik::vector::tile_layer* layer) : _layer(layer) { }
+
+        void add(const std::string& name, const AttributeValue& value, mapnik::vector::tile_feature* feature)
         {
-            multi->add(polygons[i].get());
+            if (!value.second.set || value.first == ATTRTYPE_UNSPECIFIED)
+                return;
+
+            std::map<std::string, unsigned>::iterator k = _keys.find(name);
+            if (k == _keys.end())
+            {
+                k = _keys.insert( std::make_pair(name, (unsigned)_layer->keys_size()) ).first;
+                _layer->add_keys( name );
+            }
+
+            // values are shared by type and string form
+            std::string valueKey = Stringify() << (int)value.first << ":" << value.getString();
+            std::map<std::string, unsigned>::iterator v = _values.find(valueKey);
+            if (v == _values.end())
+            {
+                v = _values.insert( std::make_pair(valueKey, (unsigned)_layer->values_size()) ).first;
+                mapnik::vector::tile_value* tv = _layer->add_values();
+                switch (value.first)
+                {
+                case ATTRTYPE_BOOL:   tv->set_bool_value( value.second.boolValue ); break;
+                case ATTRTYPE_INT:    tv->set_sint_value( value.second.intValue ); break;
+                case ATTRTYPE_DOUBLE: tv->set_double_value( value.second.doubleValue ); break;
+                default:              tv->set_string_value( value.second.stringValue ); break;
+                }
+            }
+
+            feature->add_tags( k->second );
+            feature->add_tags( v->second );
         }
-        return multi;
-    }
+
+        mapnik::vector::tile_layer*     _layer;
+        std::map<std::string, unsigned> _keys;
+        std::map<std::string, unsigned> _values;
+    };
 }
 
 #endif
@@ -311,133 +584,138 @@ Geometry* decodePolygon(const mapnik::vector::tile_feature& feature, const  Tile
 
 bool
     MVT::read(std::istream& in, const TileKey& key, FeatureList& features)
+{
+    std::string buffer((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return read(buffer.data(), buffer.size(), key, features);
+}
+
+bool
+MVT::read(const char* data, unsigned size, const TileKey& key, FeatureList& features, const std::set<std::string>* attributes)
 {
     features.clear();
 
 #ifdef OSGEARTH_HAVE_MVT
 
-    // Get the compressor
-    osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
-    if (!compressor.valid())
+    mapnik::vector::tile tile;
+    bool parsed = false;
+
+    if (isCompressed(data, size))
     {
-        return false;
+        // Get the compressor
+        osg::ref_ptr< osgDB::BaseCompressor> compressor = osgDB::Registry::instance()->getObjectWrapperManager()->findCompressor("zlib");
+        if (!compressor.valid())
+        {
+            return false;
+        }
+
+        // Decompress the tile straight from the caller's buffer
+        MemoryBuffer buf(data, size);
+        std::istream in(&buf);
+        std::string value;
+        if (compressor->decompress(in, value))
+        {
+            parsed = tile.ParseFromString(value);
+        }
     }
 
-    // Decompress the tile
-    std::string original((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-    in.seekg (0, std::ios::beg);
-    std::string value;
-    if (!compressor->decompress(in, value))
+    if (!parsed)
     {
-        value = original;
+        parsed = tile.ParseFromArray(data, size);
     }
 
-
-    mapnik::vector::tile tile;
-
-    if (tile.ParseFromString(value))
+    if (parsed)
     {
-        for (unsigned int i = 0; i < tile.layers().size(); i++)
-        {
-            const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
-
+        // decoding scratch space, reused for every feature.
+        std::vector<osg::Vec3d> points;
+        std::vector<unsigned>   starts;
+        std::vector<char>       closed;
 
-            for (unsigned int j = 0; j < layer.features().size(); j++)
-            {
-                const mapnik::vector::tile_feature &feature = layer.features().Get(j);
+        TileXform xform(key, 1u);
+        const SpatialReference* srs = key.getProfile()->getSRS();
 
+        bool wantHeight = !attributes || attributes->find("height") != attributes->end();
 
-                osg::ref_ptr< Feature > oeFeature = new Feature(0, key.getProfile()->getSRS());
+        for (int i = 0; i < tile.layers_size(); i++)
+        {
+            const mapnik::vector::tile_layer &layer = tile.layers(i);
 
-                // Set the layer name as "mvt_layer" so we can filter it later
-                oeFeature->set("mvt_layer", layer.name());
+            xform = TileXform(key, layer.extent());
 
-                // Read attributes
-                for (unsigned int k = 0; k < feature.tags().size(); k+=2)
+            // Decide once per layer which keys to keep. Values are shared by
+            // many features, so each one is converted at most once.
+            std::vector<char> keepKey( layer.keys_size(), 1 );
+            if (attributes)
+            {
+                for (int k = 0; k < layer.keys_size(); k++)
                 {
-                    std::string key = layer.keys().Get(feature.tags().Get(k));
-                    mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
-
-                    if (value.has_bool_value())
-                    {
-                        oeFeature->set(key, value.bool_value());
-                    }
-                    else if (value.has_double_value())
-                    {
-                        oeFeature->set(key, value.double_value());
-                    }
-                    else if (value.has_float_value())
-                    {
-                        oeFeature->set(key, value.float_value());
-                    }
-                    else if (value.has_int_value())
-                    {
-                        oeFeature->set(key, (int)value.int_value());
-                    }
-                    else if (value.has_sint_value())
-                    {
-                        oeFeature->set(key, (int)value.sint_value());
-                    }
-                    else if (value.has_string_value())
-                    {
-                        oeFeature->set(key, value.string_value());
-                    }
-                    else if (value.has_uint_value())
-                    {
-                        oeFeature->set(key, (int)value.uint_value());
-                    }
-
-                    // Special path for getting heights from our test dataset.
-                    if (key == "other_tags")
-                    {
-                        std::string other_tags = value.string_value();
-
-                        StringTokenizer tok("=>");
-                        StringVector tized;
-                        tok.tokenize(other_tags, tized);
-                        if (tized.size() == 3)
-                        {
-                            if (tized[0] == "height")
-                            {
-                                std::string value = tized[2];
-                                // Remove quotes from the height
-                                float height = as<float>(value, FLT_MAX);
-                                if (height != FLT_MAX)
-                                {
-                                    oeFeature->set("height", height);
-                                }
-                            }
-                        }
-                    }
+                    const std::string& name = layer.keys(k);
+                    keepKey[k] = attributes->find(name) != attributes->end() || (wantHeight && name == "other_tags");
                 }
+            }
 
+            std::vector<AttributeValue> values( layer.values_size() );
+            std::vector<char>           decoded( layer.values_size(), 0 );
 
+            for (int j = 0; j < layer.features_size(); j++)
+            {
+                const mapnik::vector::tile_feature &feature = layer.features(j);
 
                 osg::ref_ptr< osgEarth::Symbology::Geometry > geometry;
 
+                decodePath(feature, xform, points, starts, closed);
+
                 eGeomType geomType = static_cast<eGeomType>(feature.type());
                 if (geomType == ::Polygon)
                 {
-                    geometry = decodePolygon(feature, key, layer.extent());
-                }
-                else if (geomType == ::LineString)
-                {
-                    geometry = decodeLine(feature, key, layer.extent());
+                    geometry = decodePolygon(points, starts, closed);
                 }
                 else if (geomType == ::Point)
                 {
-                    geometry = decodePoint(feature, key, layer.extent());
+                    geometry = decodePoint(points);
                 }
                 else
                 {
-                    geometry = decodeLine(feature, key, layer.extent());
+                    geometry = decodeLine(points, starts);
                 }
 
-                if (geometry)
+                // skip the attributes of features we're going to discard anyway.
+                if (!geometry.valid())
+                    continue;
+
+                osg::ref_ptr< Feature > oeFeature = new Feature(0, srs);
+
+                // Set the layer name as "mvt_layer" so we can filter it later
+                oeFeature->set("mvt_layer", layer.name());
+
+                // Read attributes
+                for (int k = 0; k + 1 < feature.tags_size(); k+=2)
                 {
-                    oeFeature->setGeometry( geometry );
-                    features.push_back(oeFeature.get());
+                    unsigned keyIndex   = feature.tags(k);
+                    unsigned valueIndex = feature.tags(k+1);
+                    if (keyIndex >= keepKey.size() || valueIndex >= values.size() || !keepKey[keyIndex])
+                        continue;
+
+                    const std::string& name = layer.keys(keyIndex);
+
+                    if (!decoded[valueIndex])
+                    {
+                        decodeValue(layer.values(valueIndex), values[valueIndex]);
+                        decoded[valueIndex] = 1;
+                    }
+
+                    if (!attributes || attributes->find(name) != attributes->end())
+                    {
+                        oeFeature->set(name, values[valueIndex]);
+                    }
+
+                    if (wantHeight && name == "other_tags")
+                    {
+                        decodeOtherTags(values[valueIndex].getString(), oeFeature.get());
+                    }
                 }
+
+                oeFeature->setGeometry( geometry.get() );
+                features.push_back(oeFeature.get());
             }
         }
     }
@@ -453,3 +731,95 @@ bool
     return false;
 #endif
 }
+
+
+bool
+MVT::write(const FeatureList& features, const TileKey& key, const std::string& layerName,
+           std::string& out, unsigned extent, double tolerance)
+{
+    out.clear();
+
+#ifdef OSGEARTH_HAVE_MVT
+
+    mapnik::vector::tile tile;
+    mapnik::vector::tile_layer* layer = tile.add_layers();
+    layer->set_version( 1 );
+    layer->set_name( layerName );
+    layer->set_extent( extent );
+
+    TileXform xform(key, extent);
+    TagEncoder tags(layer);
+
+    for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f)
+    {
+        const Feature* feature = f->get();
+        if (!feature || !feature->getGeometry())
+            continue;
+
+        // the first part decides the feature type; parts of other types are skipped.
+        ConstGeometryIterator first(feature->getGeometry(), false);
+        if (!first.hasMore())
+            continue;
+
+        Geometry::Type type = first.next()->getType();
+        eGeomType geomType =
+            type == Geometry::TYPE_POINTSET   ? ::Point :
+            type == Geometry::TYPE_LINESTRING ? ::LineString :
+                                                ::Polygon;
+
+        mapnik::vector::tile_feature* tf = layer->add_features();
+        PathEncoder path(tf, xform, geomType == ::Point ? 0.0 : tolerance);
+        bool encoded = false;
+
+        ConstGeometryIterator parts(feature->getGeometry(), false);
+        while (parts.hasMore())
+        {
+            const Geometry* part = parts.next();
+            if (geomType == ::Point && part->getType() == Geometry::TYPE_POINTSET)
+            {
+                encoded = path.addPoints(part) || encoded;
+            }
+            else if (geomType == ::LineString && part->getType() == Geometry::TYPE_LINESTRING)
+            {
+                encoded = path.addLine(part) || encoded;
+            }
+            else if (geomType == ::Polygon && part->getType() == Geometry::TYPE_POLYGON)
+            {
+                // holes only make sense after their exterior ring.
+                if (path.addRing(part, true))
+                {
+                    encoded = true;
+                    const osgEarth::Symbology::Polygon* poly = static_cast<const osgEarth::Symbology::Polygon*>(part);
+                    for (RingCollection::const_iterator h = poly->getHoles().begin(); h != poly->getHoles().end(); ++h)
+                        path.addRing(h->get(), false);
+                }
+            }
+            else if (geomType == ::Polygon && part->getType() == Geometry::TYPE_RING)
+            {
+                encoded = path.addRing(part, true) || encoded;
+            }
+        }
+
+        // features that simplify away entirely are dropped.
+        if (!encoded)
+        {
+            layer->mutable_features()->RemoveLast();
+            continue;
+        }
+
+        tf->set_type( static_cast<mapnik::vector::tile::GeomType>(geomType) );
+        tf->set_id( feature->getFID() );
+
+        const AttributeTable& attrs = feature->getAttrs();
+        for (AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+        {
+            tags.add(a->first, a->second, tf);
+        }
+    }
+
+    return tile.SerializeToString(&out);
+#else
+    OE_NOTICE << "Mapnik Vector Tiles NOT SUPPORTED - please compile osgEarth with protobuf to enable." << std::endl;
+    return false;
+#endif
+}
@@ -19,7 +19,6 @@
 #include <osgEarthFeatures/ResampleFilter>
 #include <osgEarth/GeoMath>
 #include <osg/io_utils>
-#include <list>
 #include <deque>
 #include <cstdlib>
 
@@ -29,6 +28,17 @@ using namespace osgEarth::Symbology;
 
 OSGEARTH_REGISTER_SIMPLE_FEATUREFILTER(resample, ResampleFilter );
 
+namespace
+{
+    // a kept segment, ending at point _end of the original part
+    struct Segment
+    {
+        unsigned _end;
+        double   _length;
+        unsigned _divs;
+    };
+}
+
 bool
 ResampleFilter::isSupported()
 {
@@ -55,6 +65,76 @@ ResampleFilterOptions( conf )
 }
 
 
+double
+ResampleFilter::segmentLength(const osg::Vec3d& p0, const osg::Vec3d& p1) const
+{
+    switch (resampleMode().value())
+    {
+    case RESAMPLE_GREATCIRCLE:
+        return GeoMath::distance(
+            osg::DegreesToRadians(p0.y()), osg::DegreesToRadians(p0.x()),
+            osg::DegreesToRadians(p1.y()), osg::DegreesToRadians(p1.x()));
+    case RESAMPLE_RHUMB:
+        return GeoMath::rhumbDistance(
+            osg::DegreesToRadians(p0.y()), osg::DegreesToRadians(p0.x()),
+            osg::DegreesToRadians(p1.y()), osg::DegreesToRadians(p1.x()));
+    default:
+        return (p1 - p0).length();
+    }
+}
+
+void
+ResampleFilter::subdivide(const osg::Vec3d& p0, const osg::Vec3d& p1, double segLen, unsigned numDivs, Vec3dVector& out) const
+{
+    double newSegLen = segLen/(double)numDivs;
+
+    double lat1 = osg::DegreesToRadians(p0.y()), lon1 = osg::DegreesToRadians(p0.x());
+    double lat2 = osg::DegreesToRadians(p1.y()), lon2 = osg::DegreesToRadians(p1.x());
+
+    // the bearing from p0 is the same for every new point on the segment:
+    double bearing = 0.0;
+    if (resampleMode().value() == RESAMPLE_GREATCIRCLE)
+        bearing = GeoMath::bearing(lat1, lon1, lat2, lon2);
+    else if (resampleMode().value() == RESAMPLE_RHUMB)
+        bearing = GeoMath::rhumbBearing(lat1, lon1, lat2, lon2);
+
+    bool perturb = _perturbThresh.value() > 0.0 && _perturbThresh.value() < newSegLen;
+
+    for(unsigned k = 1; k < numDivs; ++k)
+    {
+        double t = (double)k/(double)numDivs;
+        osg::Vec3d newPt;
+        switch (resampleMode().value())
+        {
+        case RESAMPLE_GREATCIRCLE:
+            {
+                double lat,lon;
+                GeoMath::destination(lat1, lon1, bearing, newSegLen*(double)k, lat, lon);
+                newPt = osg::Vec3d(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), p0.z() + (p1.z()-p0.z())*t);
+            }
+            break;
+        case RESAMPLE_RHUMB:
+            {
+                double lat,lon;
+                GeoMath::rhumbDestination(lat1, lon1, bearing, newSegLen*(double)k, lat, lon);
+                newPt = osg::Vec3d(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), p0.z() + (p1.z()-p0.z())*t);
+            }
+            break;
+        default:
+            newPt = p0 + (p1 - p0)*t;
+            break;
+        }
+
+        if ( perturb )
+        {
+            float r = 0.5 - (float)::rand()/(float)RAND_MAX;
+            newPt.x() += r;
+            newPt.y() += r;
+        }
+        out.push_back( newPt );
+    }
+}
+
 bool
 ResampleFilter::push( Feature* input, FilterContext& context )
 {
@@ -70,109 +150,48 @@ ResampleFilter::push( Feature* input, FilterContext& context )
 
         if ( part->size() < 2 ) continue;
 
-        unsigned int origSize = part->size();
-
-        // whether to resample the virtual segment that closes an open ring:
-        bool loop =
-            part->getComponentType() == Geometry::TYPE_RING &&
-            static_cast<Ring*>(part)->isOpen();
-
-        // copy the original part to a linked list. use a std::list since insert/erase
-        // will not invalidate iterators.
-        std::list<osg::Vec3d> plist;
-        plist.insert( plist.begin(), part->begin(), part->end() );
-
-        std::list<osg::Vec3d>::iterator v1 = plist.begin(); ++v1;
-        std::list<osg::Vec3d>::iterator v0 = plist.begin();
-        std::list<osg::Vec3d>::iterator last = plist.end(); --last;
-
-        while( v0 != last )
+        // First pass: decide which points to keep (points closer than the minimum
+        // length to the previous kept point are dropped, except the last one) and
+        // how many pieces each kept segment is split into. Doing this up front lets
+        // the output be allocated once and filled in order, instead of growing a
+        // linked list one point at a time.
+        std::vector<Segment> segments;
+        segments.reserve( part->size()-1 );
+
+        unsigned total = 1;
+        unsigned anchor = 0;
+        unsigned last = part->size()-1;
+        for(unsigned j = 1; j <= last; ++j)
         {
-            bool increment = true;
-
-            osg::Vec3d& p0 = *v0;
-            osg::Vec3d& p1 = *v1;
-            bool lastSeg = v1 == last;
-            osg::Vec3d seg = p1 - p0;
-
-            osg::Vec3d p0Rad, p1Rad;
+            double segLen = segmentLength( (*part)[anchor], (*part)[j] );
+
+            if ( segLen < _minLen.value() && j != last )
+                continue;
+
+            Segment seg;
+            seg._end    = j;
+            seg._length = segLen;
+            seg._divs   = segLen > _maxLen.value() ? (1 + (unsigned)(segLen/_maxLen.value())) : 1;
+            segments.push_back( seg );
+            total += seg._divs;
+            anchor = j;
+        }
 
-            if (resampleMode().value() == RESAMPLE_GREATCIRCLE || resampleMode().value() == RESAMPLE_RHUMB)
-            {
-                p0Rad = osg::Vec3d(osg::DegreesToRadians(p0.x()), osg::DegreesToRadians(p0.y()), p0.z());
-                p1Rad = osg::Vec3d(osg::DegreesToRadians(p1.x()), osg::DegreesToRadians(p1.y()), p1.z());
-            }
-                       
-            //Compute the length of the segment
-            double segLen = 0.0;
-            switch (resampleMode().value())
-            {
-            case RESAMPLE_LINEAR:
-                segLen = seg.length();
-                break;
-            case RESAMPLE_GREATCIRCLE:
-                segLen = GeoMath::distance(p0Rad.y(), p0Rad.x(), p1Rad.y(), p1Rad.x());
-                break;
-            case RESAMPLE_RHUMB:
-                segLen = GeoMath::rhumbDistance(p0Rad.y(), p0Rad.x(), p1Rad.y(), p1Rad.x());
-                break;
-            }
+        // Second pass: emit the kept points and the new ones between them.
+        Vec3dVector output;
+        output.reserve( total );
+        output.push_back( part->front() );
 
-            if ( segLen < _minLen.value() && !lastSeg && plist.size() > 2 )
-            {
-                v1 = plist.erase( v1 );
-                increment = false;
-            }
-            else if ( segLen > _maxLen.value() )
-            {
-                //Compute the number of divisions to make
-                int numDivs = (1 + (int)(segLen/_maxLen.value()));
-                double newSegLen = segLen/(double)numDivs;
-                seg.normalize();
-                osg::Vec3d newPt;
-                double newHeight;
-                switch (resampleMode().value())
-                {
-                case RESAMPLE_LINEAR:
-                    {
-                        newPt = p0 + seg * newSegLen;
-                    }
-                    break;
-                case RESAMPLE_GREATCIRCLE:
-                    {
-                        double bearing = GeoMath::bearing(p0Rad.y(), p0Rad.x(), p1Rad.y(), p1Rad.x());
-                        double lat,lon;
-                        GeoMath::destination(p0Rad.y(), p0Rad.x(), bearing, newSegLen, lat, lon);
-                        newHeight = p0Rad.z() + ( p1Rad.z() - p0Rad.z() ) / (double)numDivs;
-                        newPt = osg::Vec3d(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), newHeight);
-                    }
-                    break;
-                case RESAMPLE_RHUMB:
-                    {
-                        double bearing = GeoMath::rhumbBearing(p0Rad.y(), p0Rad.x(), p1Rad.y(), p1Rad.x());
-                        double lat,lon;
-                        GeoMath::rhumbDestination(p0Rad.y(), p0Rad.x(), bearing, newSegLen, lat, lon);
-                        newHeight = p0Rad.z() + ( p1Rad.z() - p0Rad.z() ) / (double)numDivs;
-                        newPt = osg::Vec3d(osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), newHeight);
-                    }
-                    break;
-                }
-                
-                if ( _perturbThresh.value() > 0.0 && _perturbThresh.value() < newSegLen )
-                {
-                    float r = 0.5 - (float)::rand()/(float)RAND_MAX;
-                    newPt.x() += r;
-                    newPt.y() += r;
-                }
-                v1 = plist.insert( v1, newPt );
-            }
-
-            if ( increment ) { ++v0; ++v1; }
+        anchor = 0;
+        for(std::vector<Segment>::const_iterator s = segments.begin(); s != segments.end(); ++s)
+        {
+            if ( s->_divs > 1 )
+                subdivide( (*part)[anchor], (*part)[s->_end], s->_length, s->_divs, output );
+            output.push_back( (*part)[s->_end] );
+            anchor = s->_end;
         }
 
-        part->clear();
-        part->reserve( plist.size() );
-        part->insert( part->begin(), plist.begin(), plist.end() );
+        part->swap( output );
     }
     return success;
 }
@@ -18,6 +18,7 @@
  */
 #include <osgEarthFeatures/ScatterFilter>
 #include <osgEarth/GeoMath>
+#include <algorithm>
 #include <stdlib.h>
 
 #define LC "[ScatterFilter] "
@@ -28,6 +29,104 @@ using namespace osgEarth::Symbology;
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    /**
+     * Coverage mask of a polygon (outer ring and holes), rasterized into
+     * horizontal bands. Each band lists the edges that overlap it, so placing
+     * a point only tests the few edges near it instead of every edge of the
+     * polygon. Uses the same crossing rule as Ring::contains2D.
+     */
+    class PolygonCoverage
+    {
+    public:
+        PolygonCoverage(const Polygon* polygon, const Bounds& bounds) :
+            _yMin( bounds.yMin() )
+        {
+            addRing( polygon );
+            for(RingCollection::const_iterator h = polygon->getHoles().begin(); h != polygon->getHoles().end(); ++h)
+                addRing( h->get() );
+
+            unsigned numBands = osg::clampBetween( (unsigned)(_edges.size()/4), 1u, 4096u );
+            _bandHeight = bounds.height() > 0.0 ? bounds.height() / (double)numBands : 1.0;
+            _bands.resize( numBands );
+
+            for(unsigned e=0; e<_edges.size(); ++e)
+            {
+                const Edge& edge = _edges[e];
+                unsigned b0 = band( std::min(edge._y0, edge._y1) );
+                unsigned b1 = band( std::max(edge._y0, edge._y1) );
+                for(unsigned b=b0; b<=b1; ++b)
+                    _bands[b].push_back( e );
+            }
+        }
+
+        bool contains(double x, double y) const
+        {
+            bool result = false;
+            const std::vector<unsigned>& edges = _bands[band(y)];
+            for(std::vector<unsigned>::const_iterator e = edges.begin(); e != edges.end(); ++e)
+            {
+                double xi;
+                if ( crosses(_edges[*e], y, xi) && x < xi )
+                    result = !result;
+            }
+            return result;
+        }
+
+        /** Sorted x coordinates where edges cross the scanline y */
+        void crossings(double y, std::vector<double>& xs) const
+        {
+            xs.clear();
+            const std::vector<unsigned>& edges = _bands[band(y)];
+            for(std::vector<unsigned>::const_iterator e = edges.begin(); e != edges.end(); ++e)
+            {
+                double xi;
+                if ( crosses(_edges[*e], y, xi) )
+                    xs.push_back( xi );
+            }
+            std::sort( xs.begin(), xs.end() );
+        }
+
+    private:
+        struct Edge
+        {
+            double _x0, _y0, _x1, _y1;
+        };
+
+        void addRing(const Ring* ring)
+        {
+            for(unsigned i=0, j=ring->size()-1; i<ring->size(); j = i++)
+            {
+                Edge edge;
+                edge._x0 = (*ring)[i].x(); edge._y0 = (*ring)[i].y();
+                edge._x1 = (*ring)[j].x(); edge._y1 = (*ring)[j].y();
+                _edges.push_back( edge );
+            }
+        }
+
+        unsigned band(double y) const
+        {
+            double b = (y - _yMin) / _bandHeight;
+            if ( b <= 0.0 ) return 0;
+            return std::min( (unsigned)b, (unsigned)_bands.size()-1 );
+        }
+
+        static bool crosses(const Edge& e, double y, double& out_x)
+        {
+            if ( ((e._y0 <= y) && (y < e._y1)) || ((e._y1 <= y) && (y < e._y0)) )
+            {
+                out_x = (e._x1-e._x0) * (y-e._y0)/(e._y1-e._y0) + e._x0;
+                return true;
+            }
+            return false;
+        }
+
+        std::vector<Edge>                    _edges;
+        std::vector< std::vector<unsigned> > _bands;
+        double                               _yMin, _bandHeight;
+    };
+}
 
 //------------------------------------------------------------------------
 
@@ -77,6 +176,8 @@ ScatterFilter::polyScatter(const Geometry*         input,
         if ( numInstancesInBoundingRect == 0 )
             continue;
 
+        PolygonCoverage coverage( polygon, bounds );
+
         if ( _random )
         {
             // Random scattering. Note, we try to place as many instances as would
@@ -88,9 +189,7 @@ ScatterFilter::polyScatter(const Geometry*         input,
                 double x = bounds.xMin() + _prng.next() * bounds.width();
                 double y = bounds.yMin() + _prng.next() * bounds.height();
 
-                bool include = true;
-
-                if ( include && polygon->contains2D( x, y ) )
+                if ( coverage.contains( x, y ) )
                     output->push_back( osg::Vec3d(x, y, zMin) );
             }
         }
@@ -106,13 +205,22 @@ ScatterFilter::polyScatter(const Geometry*         input,
             double rowInterval = bounds.height() / (double)(rows-1);
             double interval = 0.5*(colInterval+rowInterval);
 
+            // find each row's crossings once, then walk them along with the columns;
+            // a point is inside when an odd number of crossings lie to its right.
+            std::vector<double> xs;
             for( double cy=bounds.yMin(); cy<=bounds.yMax(); cy += interval )
             {
+                coverage.crossings( cy, xs );
+                if ( xs.empty() )
+                    continue;
+
+                unsigned passed = 0;
                 for( double cx = bounds.xMin(); cx <= bounds.xMax(); cx += interval )
                 {
-                    bool include = true;
+                    while( passed < xs.size() && xs[passed] <= cx )
+                        ++passed;
 
-                    if ( include && polygon->contains2D( cx, cy ) )
+                    if ( ((xs.size() - passed) & 1) == 1 )
                         output->push_back( osg::Vec3d(cx, cy, zMin) );
                 }
             }
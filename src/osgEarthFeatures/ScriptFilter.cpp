@@ -87,10 +87,23 @@ ScriptFilter::push( FeatureList& input, FilterContext& context )
         return context;
     }
 
-    bool ok = true;
+    // features without geometry are dropped; run the rest as one batch so the
+    // engine only does its setup once.
     for( FeatureList::iterator i = input.begin(); i != input.end(); )
     {
-        if ( push( i->get(), context ) )
+        if ( i->valid() && i->get()->getGeometry() )
+            ++i;
+        else
+            i = input.erase(i);
+    }
+
+    std::vector<ScriptResult> results;
+    _engine->runBatch(_expression.get(), input, results, &context);
+
+    unsigned r = 0;
+    for( FeatureList::iterator i = input.begin(); i != input.end(); ++r )
+    {
+        if ( r < results.size() && results[r].asBool() )
         {
             ++i;
         }
@@ -0,0 +1,224 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/SimplifyFilter>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+OSGEARTH_REGISTER_SIMPLE_FEATUREFILTER(simplify, SimplifyFilter );
+
+namespace
+{
+    // Squared distance from p to the segment a-b, in the XY plane.
+    double distance2(const osg::Vec3d& p, const osg::Vec3d& a, const osg::Vec3d& b)
+    {
+        double dx = b.x() - a.x(), dy = b.y() - a.y();
+        double len2 = dx*dx + dy*dy;
+        double t = len2 > 0.0 ? osg::clampBetween(((p.x() - a.x())*dx + (p.y() - a.y())*dy) / len2, 0.0, 1.0) : 0.0;
+        double ex = a.x() + t*dx - p.x(), ey = a.y() + t*dy - p.y();
+        return ex*ex + ey*ey;
+    }
+
+    // Farthest point from the segment a-b strictly between first and last.
+    unsigned farthest(const std::vector<osg::Vec3d>& points, unsigned first, unsigned last,
+                      const osg::Vec3d& a, const osg::Vec3d& b, double& out_dist2)
+    {
+        unsigned index = first;
+        out_dist2 = 0.0;
+        for (unsigned i = first + 1; i < last; ++i)
+        {
+            double d2 = distance2(points[i], a, b);
+            if (d2 > out_dist2)
+            {
+                out_dist2 = d2;
+                index = i;
+            }
+        }
+        return index;
+    }
+
+    // Douglas-Peucker: marks the points between first and last to keep.
+    void douglasPeucker(const std::vector<osg::Vec3d>& points, unsigned first, unsigned last, double tolerance2, std::vector<char>& keep)
+    {
+        std::vector< std::pair<unsigned,unsigned> > stack;
+        stack.push_back( std::make_pair(first, last) );
+        while (!stack.empty())
+        {
+            unsigned a = stack.back().first, b = stack.back().second;
+            stack.pop_back();
+
+            double maxDist2;
+            unsigned index = farthest(points, a, b, points[a], points[b], maxDist2);
+            if (maxDist2 > tolerance2)
+            {
+                keep[index] = 1;
+                stack.push_back( std::make_pair(a, index) );
+                stack.push_back( std::make_pair(index, b) );
+            }
+        }
+    }
+
+    // Simplifies one line or ring in place. Returns false if a ring
+    // collapsed to fewer than three distinct points.
+    bool simplifyPart(Geometry* part, double tolerance2)
+    {
+        bool ring = part->getType() == Geometry::TYPE_RING || part->getType() == Geometry::TYPE_POLYGON;
+        if ( part->size() < (ring ? 4u : 3u) )
+            return true;
+
+        // a ring simplifies as a line that ends where it starts.
+        std::vector<osg::Vec3d> points( part->begin(), part->end() );
+        bool closed = points.front() == points.back();
+        if ( ring && !closed )
+            points.push_back( points.front() );
+
+        unsigned last = points.size()-1;
+        std::vector<char> keep( points.size(), 0 );
+        keep[0] = keep[last] = 1;
+
+        if ( ring )
+        {
+            // split the ring at the point farthest from its start, and keep
+            // a third point so it stays a triangle at worst.
+            unsigned split = 0;
+            double maxDist2 = 0.0;
+            for (unsigned i = 1; i < last; ++i)
+            {
+                double d2 = (points[i] - points[0]).length2();
+                if (d2 > maxDist2)
+                {
+                    maxDist2 = d2;
+                    split = i;
+                }
+            }
+            if ( split == 0 )
+                return false;
+
+            keep[split] = 1;
+            douglasPeucker( points, 0, split, tolerance2, keep );
+            douglasPeucker( points, split, last, tolerance2, keep );
+
+            unsigned kept = 0;
+            for (unsigned i = 0; i < last; ++i)
+                kept += keep[i];
+
+            if ( kept < 3 )
+            {
+                double d2a, d2b;
+                unsigned a = farthest( points, 0, split, points[0], points[split], d2a );
+                unsigned b = farthest( points, split, last, points[0], points[split], d2b );
+                if ( d2a <= 0.0 && d2b <= 0.0 )
+                    return false;
+                keep[d2a >= d2b ? a : b] = 1;
+            }
+        }
+        else
+        {
+            douglasPeucker( points, 0, last, tolerance2, keep );
+        }
+
+        if ( ring && !closed )
+            keep[last] = 0;
+
+        unsigned n = 0;
+        for (unsigned i = 0; i < points.size(); ++i)
+            if ( keep[i] )
+                (*part)[n++] = points[i];
+        part->resize( n );
+
+        return true;
+    }
+
+    void simplifyGeometry(Geometry* geom, double tolerance2)
+    {
+        if ( geom->getType() == Geometry::TYPE_MULTI )
+        {
+            GeometryCollection& parts = static_cast<MultiGeometry*>(geom)->getComponents();
+            for (GeometryCollection::iterator i = parts.begin(); i != parts.end(); ++i)
+                simplifyGeometry( i->get(), tolerance2 );
+        }
+        else if ( geom->getType() == Geometry::TYPE_POLYGON )
+        {
+            simplifyPart( geom, tolerance2 );
+
+            // holes smaller than the tolerance go away.
+            RingCollection& holes = static_cast<Polygon*>(geom)->getHoles();
+            for (RingCollection::iterator i = holes.begin(); i != holes.end(); )
+            {
+                if ( simplifyPart(i->get(), tolerance2) )
+                    ++i;
+                else
+                    i = holes.erase( i );
+            }
+        }
+        else if ( geom->getType() != Geometry::TYPE_POINTSET )
+        {
+            simplifyPart( geom, tolerance2 );
+        }
+    }
+}
+
+SimplifyFilter::SimplifyFilter() :
+SimplifyFilterOptions()
+{
+    //NOP
+}
+
+SimplifyFilter::SimplifyFilter( double tolerance ) :
+SimplifyFilterOptions()
+{
+    _tolerance = tolerance;
+}
+
+SimplifyFilter::SimplifyFilter( const Config& conf ) :
+SimplifyFilterOptions( conf )
+{
+    //NOP
+}
+
+Geometry*
+SimplifyFilter::simplify( const Geometry* input, double tolerance )
+{
+    if ( !input )
+        return 0L;
+
+    Geometry* output = input->clone();
+    if ( tolerance > 0.0 )
+        simplifyGeometry( output, tolerance*tolerance );
+    return output;
+}
+
+FilterContext
+SimplifyFilter::push( FeatureList& input, FilterContext& context )
+{
+    if ( _tolerance.get() <= 0.0 )
+        return context;
+
+    double tolerance2 = _tolerance.get() * _tolerance.get();
+
+    for( FeatureList::iterator i = input.begin(); i != input.end(); ++i )
+    {
+        Feature* feature = i->get();
+        if ( feature && feature->getGeometry() )
+            simplifyGeometry( feature->getGeometry(), tolerance2 );
+    }
+
+    return context;
+}
@@ -29,6 +29,8 @@
 #include <osgEarth/ScreenSpaceLayout>
 #include <osgEarth/CullingUtils>
 #include <osgEarth/NodeUtils>
+#include <osgEarth/Impostor>
+#include <osgEarth/FadeEffect>
 
 #include <osg/AutoTransform>
 #include <osg/Drawable>
@@ -38,6 +40,7 @@
 #include <osg/ShapeDrawable>
 #include <osg/AlphaFunc>
 #include <osg/Billboard>
+#include <osg/LOD>
 
 #define LC "[SubstituteModelFilter] "
 
@@ -60,6 +63,13 @@ namespace
             traverse(node, nv);
         }
     };
+
+    struct CreateImpostor : public Session::CreateFunctor<Impostor>
+    {
+        osg::Node* _model;
+        CreateImpostor(osg::Node* model) : _model(model) { }
+        Impostor* operator()() const { return new Impostor(_model); }
+    };
 }
 
 //------------------------------------------------------------------------
@@ -68,7 +78,10 @@ SubstituteModelFilter::SubstituteModelFilter( const Style& style ) :
 _style                ( style ),
 _cluster              ( false ),
 _useDrawInstanced     ( false ),
+_cullInstances        ( false ),
+_instanceMaxRange     ( FLT_MAX ),
 _merge                ( true ),
+_useTextureArrays     ( false ),
 _normalScalingRequired( false ),
 _instanceCache        ( false )     // cache per object so MT not required
 {
@@ -148,6 +161,18 @@ SubstituteModelFilter::process(const FeatureList&           features,
     NumericExpression scaleYEx;
     NumericExpression scaleZEx;
 
+    // Impostor LOD: beyond the impostor range each instance swaps its model
+    // for a textured stand-in, cross-fading over a band past that range.
+    // Instancing and clustering merge the instances, so they don't apply.
+    bool useImpostors =
+        modelSymbol && modelSymbol->impostorRange().isSet() &&
+        !_useDrawInstanced && !_cluster && session;
+    float impostorRange = useImpostors ? modelSymbol->impostorRange().get() : FLT_MAX;
+    float impostorFade  = 0.1f * impostorRange;
+
+    // per unique model, the LOD children to share between instances
+    std::map< osg::Node*, std::pair<osg::ref_ptr<osg::Node>, osg::ref_ptr<osg::Node> > > lodChildren;
+
     if ( modelSymbol )
     {
         headingEx = *modelSymbol->heading();
@@ -227,7 +252,22 @@ SubstituteModelFilter::process(const FeatureList&           features,
         {
             // Always clone the cached instance so we're not processing data that's
             // already in the scene graph. -gw
-            context.resourceCache()->cloneOrCreateInstanceNode(instance.get(), model, context.getDBOptions());
+            // Draw-instancing only touches drawables and primitive sets, so those
+            // clones can share the vertex data of one copy across all tiles.
+            //
+            // Library icons can share a texture array so they all draw with the same state.
+            IconResource* icon = dynamic_cast<IconResource*>(instance.get());
+            bool fromTextureArray =
+                _useTextureArrays && icon && _resourceLib.valid() &&
+                context.resourceCache()->getOrCreateTextureArrayIconNode(_resourceLib.get(), icon, model, context.getDBOptions());
+
+            if ( !fromTextureArray )
+            {
+                if ( _useDrawInstanced )
+                    context.resourceCache()->cloneOrCreateSharedInstanceNode(instance.get(), model, context.getDBOptions());
+                else
+                    context.resourceCache()->cloneOrCreateInstanceNode(instance.get(), model, context.getDBOptions());
+            }
 
             // if icon decluttering is off, install an AutoTransform.
             if ( iconSymbol )
@@ -319,7 +359,55 @@ SubstituteModelFilter::process(const FeatureList&           features,
                     osg::MatrixTransform* xform = new osg::MatrixTransform();
                     xform->setMatrix( mat );
                     xform->setDataVariance( osg::Object::STATIC );
-                    xform->addChild( model.get() );
+
+                    osg::ref_ptr<osg::Node> instanceNode = model.get();
+                    if ( useImpostors )
+                    {
+                        std::pair<osg::ref_ptr<osg::Node>, osg::ref_ptr<osg::Node> >& children = lodChildren[model.get()];
+                        if ( !children.first.valid() )
+                        {
+                            // One impostor per model URI for the whole session, so the
+                            // atlas renders only once no matter how many tiles use it.
+                            osg::ref_ptr<Impostor> impostor;
+                            session->getOrCreateObject(
+                                "SubstituteModelFilter.impostor:" + instanceURI.full(),
+                                impostor,
+                                CreateImpostor(model.get()) );
+
+                            if ( impostor.valid() && impostor->valid() )
+                            {
+                                FadeEffect* nearNode = new FadeEffect();
+                                nearNode->setMaxRange( impostorRange + impostorFade );
+                                nearNode->setAttenuationDistance( impostorFade );
+                                nearNode->addChild( model.get() );
+
+                                FadeEffect* farNode = new FadeEffect();
+                                farNode->setMinRange( impostorRange );
+                                farNode->setAttenuationDistance( impostorFade );
+                                farNode->addChild( impostor->createImpostorNode() );
+
+                                children.first  = nearNode;
+                                children.second = farNode;
+
+                                // renders the atlas, unless another tile already has
+                                attachPoint->addChild( impostor->createRenderNode(model.get()) );
+                            }
+                            else
+                            {
+                                children.first = model.get();
+                            }
+                        }
+
+                        if ( children.second.valid() )
+                        {
+                            osg::LOD* lod = new osg::LOD();
+                            lod->addChild( children.first.get(),  0.0f,          impostorRange + impostorFade );
+                            lod->addChild( children.second.get(), impostorRange, FLT_MAX );
+                            instanceNode = lod;
+                        }
+                    }
+
+                    xform->addChild( instanceNode.get() );
                     attachPoint->addChild( xform );
 
                     // Only tag nodes if we aren't using clustering.
@@ -359,7 +447,7 @@ SubstituteModelFilter::process(const FeatureList&           features,
     // active DrawInstanced if required:
     if ( _useDrawInstanced )
     {
-        DrawInstanced::convertGraphToUseDrawInstanced( attachPoint );
+        DrawInstanced::convertGraphToUseDrawInstanced( attachPoint, _cullInstances, _instanceMaxRange );
 
         // install a shader program to render draw-instanced.
         DrawInstanced::install( attachPoint->getOrCreateStateSet() );
@@ -43,40 +43,39 @@ TessellateOperator::tessellateGeo( const osg::Vec3d& p0, const osg::Vec3d& p1, u
     double step = 1.0/double(parts);
     double zdelta = p1.z() - p0.z();
 
+    double lat1 = osg::DegreesToRadians(p0.y()), lon1 = osg::DegreesToRadians(p0.x());
+    double lat2 = osg::DegreesToRadians(p1.y()), lon2 = osg::DegreesToRadians(p1.x());
+
     out.push_back( p0 );
 
-    for( unsigned i=1; i<parts; ++i )
+    if ( interp == GEOINTERP_GREAT_CIRCLE )
     {
-        double t = step*double(i);
-        osg::Vec3d p;
+        std::vector<osg::Vec2d> latLon;
+        GeoMath::interpolate( lat1, lon1, lat2, lon2, parts, latLon );
 
-        if ( interp == GEOINTERP_GREAT_CIRCLE )
+        for( unsigned i=0; i<latLon.size(); ++i )
         {
-            double lat, lon;
-            GeoMath::interpolate(
-                osg::DegreesToRadians(p0.y()), osg::DegreesToRadians(p0.x()),
-                osg::DegreesToRadians(p1.y()), osg::DegreesToRadians(p1.x()),
-                t,
-                lat, lon );
-            p.set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), p0.z() + t*zdelta );
+            double t = step*double(i+1);
+            out.push_back( osg::Vec3d(
+                osg::RadiansToDegrees(latLon[i].y()), osg::RadiansToDegrees(latLon[i].x()), p0.z() + t*zdelta) );
         }
-        else // GEOINTERP_RHUMB_LINE
-        {
-            double lat1 = osg::DegreesToRadians(p0.y()), lon1 = osg::DegreesToRadians(p0.x());
-            double lat2 = osg::DegreesToRadians(p1.y()), lon2 = osg::DegreesToRadians(p1.x());
-
-            double totalDistance = GeoMath::rhumbDistance( lat1, lon1, lat2, lon2 );
-            double bearing  = GeoMath::rhumbBearing( lat1, lon1, lat2, lon2 );
+    }
+    else // GEOINTERP_RHUMB_LINE
+    {
+        // the distance and bearing are the same for every point on the segment.
+        double totalDistance = GeoMath::rhumbDistance( lat1, lon1, lat2, lon2 );
+        double bearing  = GeoMath::rhumbBearing( lat1, lon1, lat2, lon2 );
 
+        for( unsigned i=1; i<parts; ++i )
+        {
+            double t = step*double(i);
             double interpDistance = t * totalDistance;
 
             double lat3, lon3;
             GeoMath::rhumbDestination(lat1, lon1, bearing, interpDistance, lat3, lon3);
 
-            p.set( osg::RadiansToDegrees(lon3), osg::RadiansToDegrees(lat3), p0.z() + t*zdelta );
+            out.push_back( osg::Vec3d(osg::RadiansToDegrees(lon3), osg::RadiansToDegrees(lat3), p0.z() + t*zdelta) );
         }
-
-        out.push_back(p);
     }
 }
 
@@ -121,48 +120,42 @@ TessellateOperator::operator()( Feature* feature, FilterContext& context ) const
         Geometry* g = i.next();
         bool isRing = dynamic_cast<Ring*>( g ) != 0L;
 
-        Vec3dVector newVerts;
+        if ( g->empty() )
+            continue;
 
-        for( Geometry::const_iterator v = g->begin(); v != g->end(); ++v )
+        // count the slices for each segment up front (the closing segment of
+        // a ring included) so the output is allocated once.
+        unsigned numSegs = isRing ? g->size() : g->size()-1;
+        std::vector<unsigned> slices( numSegs, (unsigned)numPartitions );
+        unsigned total = isRing ? 0 : 1;
+        for( unsigned s=0; s<numSegs; ++s )
         {
-            unsigned slices = _numPartitions;
-
-            const osg::Vec3d& p0 = *v;
-            if ( v != g->end()-1 ) // not last vert
+            if ( sliceSize > 0.0 )
             {
-                // calculate slice count
-                if ( sliceSize > 0.0 )
-                {
-                    double dist = GeoMath::distance(*v, *(v + 1), feature->getSRS());
-                    slices = std::max( 1u, (unsigned)(dist / sliceSize) );
-                }
-
-                if ( isGeo )
-                    tessellateGeo( *v, *(v+1), slices, geoInterp, newVerts );
-                else
-                    tessellateLinear( *v, *(v+1), slices, newVerts );
-            }
-            else if ( isRing )
-            {
-                // calculate slice count
-                if ( sliceSize > 0.0 )
-                {
-                    double dist = GeoMath::distance(*v, *g->begin(), feature->getSRS());
-                    slices = std::max( 1u, (unsigned)(dist / sliceSize) );
-                }
-
-                if ( isGeo )
-                    tessellateGeo( *v, *g->begin(), slices, geoInterp, newVerts );
-                else
-                    tessellateLinear( *v, *g->begin(), slices, newVerts );
-            }
-            else 
-            {
-                // get the final vert.
-                newVerts.push_back( *v );
+                double dist = GeoMath::distance((*g)[s], (*g)[(s+1) % g->size()], feature->getSRS());
+                slices[s] = std::max( 1u, (unsigned)(dist / sliceSize) );
             }
+            total += slices[s];
+        }
+
+        Vec3dVector newVerts;
+        newVerts.reserve( total );
+
+        for( unsigned s=0; s<numSegs; ++s )
+        {
+            const osg::Vec3d& p0 = (*g)[s];
+            const osg::Vec3d& p1 = (*g)[(s+1) % g->size()];
+
+            if ( isGeo )
+                tessellateGeo( p0, p1, slices[s], geoInterp, newVerts );
+            else
+                tessellateLinear( p0, p1, slices[s], newVerts );
         }
 
+        // get the final vert.
+        if ( !isRing )
+            newVerts.push_back( g->back() );
+
         g->swap( newVerts );
     }
 }
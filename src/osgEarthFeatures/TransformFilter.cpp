@@ -116,16 +116,93 @@ TransformFilter::push( Feature* input, FilterContext& context )
     return true;
 }
 
+bool
+TransformFilter::pushBatch( FeatureList& input, FilterContext& context )
+{
+    bool needsMatrixXform = !_mat.isIdentity();
+
+    // gather every point of every feature into one buffer, so the SRS conversion
+    // (and any trip through the GDAL lock) happens once for the whole batch
+    // instead of once per geometry part.
+    unsigned count = 0;
+    for( FeatureList::iterator f = input.begin(); f != input.end(); ++f )
+    {
+        if ( f->valid() && f->get()->getGeometry() )
+            count += f->get()->getGeometry()->getTotalPointCount();
+    }
+
+    std::vector<osg::Vec3d> points;
+    points.reserve( count );
+
+    for( FeatureList::iterator f = input.begin(); f != input.end(); ++f )
+    {
+        if ( !f->valid() || !f->get()->getGeometry() )
+            continue;
+
+        GeometryIterator iter( f->get()->getGeometry() );
+        while( iter.hasMore() )
+        {
+            Geometry* geom = iter.next();
+
+            // pre-transform the point before doing an SRS transformation.
+            if ( needsMatrixXform )
+            {
+                for( unsigned i=0; i < geom->size(); ++i )
+                    points.push_back( (*geom)[i] * _mat );
+            }
+            else
+            {
+                points.insert( points.end(), geom->begin(), geom->end() );
+            }
+        }
+    }
+
+    bool ok = context.profile()->getSRS()->transform( points, _outputSRS.get() );
+
+    // scatter the results back, updating the bounding box.
+    unsigned p = 0;
+    for( FeatureList::iterator f = input.begin(); f != input.end(); ++f )
+    {
+        if ( !f->valid() || !f->get()->getGeometry() )
+            continue;
+
+        GeometryIterator iter( f->get()->getGeometry() );
+        while( iter.hasMore() )
+        {
+            Geometry* geom = iter.next();
+            for( unsigned i=0; i < geom->size(); ++i, ++p )
+            {
+                (*geom)[i] = points[p];
+                if ( _localize )
+                    _bbox.expandBy( points[p] );
+            }
+        }
+    }
+
+    return ok;
+}
+
 FilterContext
 TransformFilter::push( FeatureList& input, FilterContext& incx )
 {
     _bbox = osg::BoundingBoxd();
 
+    bool needsSRSXform =
+        _outputSRS.valid() &&
+        ( ! incx.profile()->getSRS()->isEquivalentTo( _outputSRS.get() ) );
+
     // first transform all the points into the output SRS, collecting a bounding box as we go:
     bool ok = true;
-    for( FeatureList::iterator i = input.begin(); i != input.end(); i++ )
-        if ( !push( i->get(), incx ) )
-            ok = false;
+    if ( needsSRSXform )
+    {
+        ok = pushBatch( input, incx );
+    }
+    else
+    {
+        for( FeatureList::iterator i = input.begin(); i != input.end(); i++ )
+            if ( !push( i->get(), incx ) )
+                ok = false;
+    }
 
     FilterContext outcx( incx );
 
@@ -1,4 +1,4 @@
-#version 400
+#version 400 compatibility
 
 /**
  * TCS that assigns a patch grid density.
@@ -11,16 +11,44 @@
 layout(vertices=3) out;
 
 uniform float oe_landcover_density;
+uniform float oe_landcover_maxDistance;
 
 // per-vertex tile coordinates
 vec4 oe_layer_tilec;
 
+// per-vertex up vector in view space
+vec3 oe_UpVectorView;
+
 // SDK function to sample the coverage data
 int oe_landcover_getBiomeIndex(in vec4);
 
+// SDK function to sample the elevation data
+float oe_terrain_getElevation(in vec2);
+
 // SDK function to load per-vertex data
 void VP_LoadVertex(in int);
 
+// Minimum view-space range of the (elevated) patch. Points generated inside
+// the patch are no closer than this, give or take the relief within it.
+float oe_landcover_getPatchRange()
+{
+    vec3 v[3];
+    for(int i=0; i<3; ++i)
+    {
+        VP_LoadVertex(i);
+        vec4 view = gl_ModelViewMatrix * gl_in[i].gl_Position;
+        v[i] = view.xyz + oe_UpVectorView * oe_terrain_getElevation(oe_layer_tilec.st);
+    }
+
+    float minRange = min(-v[0].z, min(-v[1].z, -v[2].z));
+
+    // allow for terrain relief between the corners, roughly bounded by
+    // the size of the patch itself.
+    float size = max(distance(v[0],v[1]), max(distance(v[1],v[2]), distance(v[2],v[0])));
+
+    return minRange - size;
+}
+
 // MAIN ENTRY POINT                
 void oe_landcover_configureTess()
 {
@@ -28,25 +56,15 @@ void oe_landcover_configureTess()
 	{
         float d = oe_landcover_density;
 
-        VP_LoadVertex(0);
-        if ( oe_landcover_getBiomeIndex(oe_layer_tilec) >= 0 ) {
-            d = oe_landcover_density;
-        }
-        else {
-            VP_LoadVertex(1);
-            if ( oe_landcover_getBiomeIndex(oe_layer_tilec) >= 0 ) {
-                d = oe_landcover_density;
-                VP_LoadVertex(0);
-            }
-            else {
-                VP_LoadVertex(2);
-                if ( oe_landcover_getBiomeIndex(oe_layer_tilec) >= 0 ) {
-                    d = oe_landcover_density;
-                    VP_LoadVertex(0);
-                }
-            }
+        // Distance culling for the whole patch: a tessellation level of zero
+        // discards it before the geometry shader runs once per point.
+        if ( oe_landcover_getPatchRange() >= oe_landcover_maxDistance )
+        {
+            d = 0.0;
         }
 
+        VP_LoadVertex(0);
+
         gl_TessLevelOuter[0] = d;
         gl_TessLevelOuter[1] = d;
         gl_TessLevelOuter[2] = d;
@@ -271,6 +271,7 @@ LandCoverLayerFactory::install(MapNode* mapNode)
                             LandCoverPatchLayer* patch = new LandCoverPatchLayer();
                             patch->setZoneAndLayer(zone, layer);
                             patch->setName("Land Cover: " + layer->getName());
+                            patch->setMaxRange(layer->getMaxDistance());
                             //patch->setAcceptCallback( new AcceptLOD(layer->getLOD()) );
                             patch->setStateSet( stateset );
                             mapNode->getMap()->addLayer( patch );
@@ -20,8 +20,11 @@
 
 #include <osgEarth/ImageUtils>
 #include <osgEarth/Random>
+#include <osgEarth/ThreadingUtils>
 #include <osgEarthUtil/SimplexNoise>
 #include <osg/Texture2D>
+#include <osg/observer_ptr>
+#include <map>
 
 using namespace osgEarth;
 using namespace osgEarth::Splat;
@@ -29,11 +32,38 @@ using namespace osgEarth::Splat;
 
 #define LC "[NoiseTextureFactory] "
 
+namespace
+{
+    typedef std::map< std::pair<unsigned,unsigned>, osg::observer_ptr<osg::Texture> > NoiseTextureCache;
+
+    NoiseTextureCache s_cache;
+    Threading::Mutex  s_cacheMutex;
+}
+
 osg::Texture*
 NoiseTextureFactory::create(unsigned dim, unsigned chans) const
 {
     chans = osg::clampBetween(chans, 1u, 4u);
 
+    // Generating noise is slow and each copy costs VRAM, so share them.
+    Threading::ScopedMutexLock lock( s_cacheMutex );
+
+    osg::ref_ptr<osg::Texture> tex;
+    osg::observer_ptr<osg::Texture>& cached = s_cache[std::make_pair(dim, chans)];
+    if ( !cached.lock(tex) )
+    {
+        tex = generate(dim, chans);
+        cached = tex.get();
+        OE_INFO << LC << "Generated " << dim << "x" << dim << " noise texture with " << chans << " channel(s)\n";
+    }
+
+    return tex.release();
+}
+
+osg::Texture*
+NoiseTextureFactory::generate(unsigned dim, unsigned chans) const
+{
+
     GLenum type = chans >= 2u ? GL_RGBA : GL_LUMINANCE;
     
     osg::Image* image = new osg::Image();
@@ -30,6 +30,7 @@ _clamping          ( CLAMP_NONE ),
 _technique         ( TECHNIQUE_MAP ),
 _binding           ( BINDING_VERTEX ),
 _resolution        ( 0.0 ), //0.001f ),
+_useElevationData  ( false ),
 _verticalScale     ( NumericExpression(1.0) ),
 _verticalOffset    ( NumericExpression(0.0) )
 {
@@ -42,6 +43,7 @@ _clamping(rhs._clamping),
 _technique(rhs._technique),
 _binding(rhs._binding),
 _resolution(rhs._resolution),
+_useElevationData(rhs._useElevationData),
 _verticalOffset(rhs._verticalOffset),
 _verticalScale(rhs._verticalScale)
 {
@@ -68,6 +70,7 @@ AltitudeSymbol::getConfig() const
     conf.addIfSet   ( "binding", "centroid", _binding, BINDING_CENTROID );
 
     conf.addIfSet   ( "clamping_resolution",     _resolution );
+    conf.addIfSet   ( "use_elevation_data",      _useElevationData );
     conf.addObjIfSet( "vertical_offset",         _verticalOffset );
     conf.addObjIfSet( "vertical_scale",          _verticalScale );
     return conf;
@@ -90,6 +93,7 @@ AltitudeSymbol::mergeConfig( const Config& conf )
     conf.getIfSet   ( "binding", "centroid", _binding, BINDING_CENTROID );
 
     conf.getIfSet   ( "clamping_resolution",   _resolution );
+    conf.getIfSet   ( "use_elevation_data",    _useElevationData );
     conf.getObjIfSet( "vertical_offset",       _verticalOffset );
     conf.getObjIfSet( "vertical_scale",        _verticalScale );
 }
@@ -150,6 +154,9 @@ AltitudeSymbol::parseSLD(const Config& c, Style& style)
     else if ( match(c.key(), "altitude-resolution") ) {
         style.getOrCreate<AltitudeSymbol>()->clampingResolution() = as<float>( c.value(), 0.0f );
     }
+    else if ( match(c.key(), "altitude-use-elevation-data") ) {
+        style.getOrCreate<AltitudeSymbol>()->useElevationData() = as<bool>( c.value(), false );
+    }
     else if ( match(c.key(), "altitude-offset") ) {
         style.getOrCreate<AltitudeSymbol>()->verticalOffset() = NumericExpression( c.value() );
     }
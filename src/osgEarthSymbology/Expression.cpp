@@ -282,82 +282,49 @@ NumericExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stack<double> s;
+        // The stack can never be deeper than the RPN program, so use a fixed
+        // buffer (on the stack for typical expressions) instead of allocating.
+        double  small[32];
+        std::vector<double> large;
+        double* s = small;
+        if ( _rpn.size() > 32 )
+        {
+            large.resize( _rpn.size() );
+            s = &large[0];
+        }
+        unsigned n = 0;
 
         for( unsigned i=0; i<_rpn.size(); ++i )
         {
             const Atom& a = _rpn[i];
 
-            if ( a.first == ADD )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 + op2 );
-                }
-            }
-            else if ( a.first == SUB )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 - op2 );
-                }
-            }
-            else if ( a.first == MULT )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 * op2 );
-                }
-            }
-            else if ( a.first == DIV )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 / op2 );
-                }
-            }
-            else if ( a.first == MOD )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( fmod(op1, op2) );
-                }
-            }
-            else if ( a.first == MIN )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( std::min(op1, op2) );
-                }
-            }
-            else if ( a.first == MAX )
+            if ( IS_OPERATOR(a) || a.first == MIN || a.first == MAX )
             {
-                if ( s.size() >= 2 )
+                if ( n >= 2 )
                 {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( std::max(op1, op2) );
+                    double  op2 = s[--n];
+                    double& op1 = s[n-1];
+
+                    switch( a.first )
+                    {
+                    case ADD:  op1 = op1 + op2; break;
+                    case SUB:  op1 = op1 - op2; break;
+                    case MULT: op1 = op1 * op2; break;
+                    case DIV:  op1 = op1 / op2; break;
+                    case MOD:  op1 = fmod(op1, op2); break;
+                    case MIN:  op1 = std::min(op1, op2); break;
+                    case MAX:  op1 = std::max(op1, op2); break;
+                    default:   break;
+                    }
                 }
             }
             else // OPERAND or VARIABLE
             {
-                s.push( a.second );
+                s[n++] = a.second;
             }
         }
 
-        const_cast<NumericExpression*>(this)->_value = s.size() > 0 ? s.top() : 0.0;
+        const_cast<NumericExpression*>(this)->_value = n > 0 ? s[n-1] : 0.0;
         const_cast<NumericExpression*>(this)->_dirty = false;
     }
 
@@ -550,11 +517,12 @@ StringExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stringstream buf;
+        // concatenate in place; the result buffer is reused across evaluations.
+        std::string& value = const_cast<StringExpression*>(this)->_value;
+        value.clear();
         for( AtomVector::const_iterator i = _infix.begin(); i != _infix.end(); ++i )
-            buf << i->second;
+            value.append( i->second );
 
-        const_cast<StringExpression*>(this)->_value = buf.str();
         const_cast<StringExpression*>(this)->_dirty = false;
     }
 
@@ -33,6 +33,8 @@ using namespace osgEarth::Symbology;
 #  include <geos/operation/buffer/BufferOp.h>
 #  include <geos/operation/buffer/BufferBuilder.h> 
 #  include <geos/operation/overlay/OverlayOp.h>
+#  include <geos/geom/prep/PreparedGeometry.h>
+#  include <geos/geom/prep/PreparedGeometryFactory.h>
 using namespace geos;
 using namespace geos::operation;
 #endif
@@ -310,16 +312,314 @@ Geometry::crop( const Polygon* cropPoly, osg::ref_ptr<Geometry>& output ) const
 #endif // OSGEARTH_HAVE_GEOS
 }
 
+namespace
+{
+    inline bool overlaps2D(const Bounds& a, const Bounds& b)
+    {
+        return
+            a.isValid() && b.isValid() &&
+            a.xMin() <= b.xMax() && a.xMax() >= b.xMin() &&
+            a.yMin() <= b.yMax() && a.yMax() >= b.yMin();
+    }
+
+    // Liang-Barsky: computes the parametric range [t0, t1] of the segment
+    // a->b that lies inside the rectangle. Returns false if none does.
+    bool clipSegment(const osg::Vec3d& a, const osg::Vec3d& b, const Bounds& r, double& t0, double& t1)
+    {
+        t0 = 0.0;
+        t1 = 1.0;
+        double dx = b.x() - a.x();
+        double dy = b.y() - a.y();
+        double p[4] = { -dx, dx, -dy, dy };
+        double q[4] = { a.x()-r.xMin(), r.xMax()-a.x(), a.y()-r.yMin(), r.yMax()-a.y() };
+        for(int i=0; i<4; ++i)
+        {
+            if ( p[i] == 0.0 )
+            {
+                if ( q[i] < 0.0 )
+                    return false;
+            }
+            else
+            {
+                double t = q[i]/p[i];
+                if ( p[i] < 0.0 )
+                {
+                    if ( t > t1 ) return false;
+                    if ( t > t0 ) t0 = t;
+                }
+                else
+                {
+                    if ( t < t0 ) return false;
+                    if ( t < t1 ) t1 = t;
+                }
+            }
+        }
+        return true;
+    }
+
+    // number of times a closed ring passes through the boundary of the rectangle.
+    unsigned countCrossings(const Geometry* ring, const Bounds& r)
+    {
+        unsigned count = 0;
+        for(unsigned i=0, j=ring->size()-1; i<ring->size(); j = i++)
+        {
+            double t0, t1;
+            if ( clipSegment((*ring)[j], (*ring)[i], r, t0, t1) )
+            {
+                if ( t0 > 0.0 ) ++count;
+                if ( t1 < 1.0 ) ++count;
+            }
+        }
+        return count;
+    }
+
+    // Sutherland-Hodgman: clips a closed ring against the rectangle, one side
+    // at a time. Exact as long as the result is a single piece.
+    void clipRing(const Geometry* ring, const Bounds& r, Geometry* output)
+    {
+        std::vector<osg::Vec3d> in( ring->begin(), ring->end() );
+        std::vector<osg::Vec3d> out;
+        out.reserve( in.size() + 4 );
+
+        for(int side=0; side<4 && !in.empty(); ++side)
+        {
+            // 0=xmin, 1=xmax, 2=ymin, 3=ymax
+            int    axis  = side / 2;
+            double limit = side==0 ? r.xMin() : side==1 ? r.xMax() : side==2 ? r.yMin() : r.yMax();
+            double sign  = (side % 2) == 0 ? 1.0 : -1.0;
+
+            out.clear();
+            for(unsigned i=0, j=in.size()-1; i<in.size(); j = i++)
+            {
+                const osg::Vec3d& a = in[j];
+                const osg::Vec3d& b = in[i];
+                double da = sign * (a[axis] - limit);
+                double db = sign * (b[axis] - limit);
+                if ( db >= 0.0 )
+                {
+                    if ( da < 0.0 )
+                        out.push_back( a + (b-a)*(da/(da-db)) );
+                    out.push_back( b );
+                }
+                else if ( da >= 0.0 )
+                {
+                    out.push_back( a + (b-a)*(da/(da-db)) );
+                }
+            }
+            in.swap( out );
+        }
+
+        output->insert( output->end(), in.begin(), in.end() );
+    }
+
+    // clips a line (closed, for a ring) against the rectangle, adding the
+    // pieces that fall inside to the parts list.
+    void clipLine(const Geometry* line, bool closed, const Bounds& r, GeometryCollection& parts)
+    {
+        osg::ref_ptr<LineString> current;
+        unsigned numSegments = closed ? line->size() : line->size()-1;
+        for(unsigned s=0; s<numSegments; ++s)
+        {
+            const osg::Vec3d& a = (*line)[s];
+            const osg::Vec3d& b = (*line)[(s+1) % line->size()];
+            double t0, t1;
+            if ( clipSegment(a, b, r, t0, t1) )
+            {
+                if ( !current.valid() )
+                {
+                    current = new LineString();
+                    current->push_back( a + (b-a)*t0 );
+                }
+                current->push_back( a + (b-a)*t1 );
+                if ( t1 < 1.0 )
+                {
+                    if ( current->size() > 1 )
+                        parts.push_back( current.get() );
+                    current = 0L;
+                }
+            }
+            else if ( current.valid() )
+            {
+                if ( current->size() > 1 )
+                    parts.push_back( current.get() );
+                current = 0L;
+            }
+        }
+        if ( current.valid() && current->size() > 1 )
+            parts.push_back( current.get() );
+    }
+
+    // Crops a single (non-multi) geometry to the rectangle, adding the results
+    // to the parts list. If "exact" is set, returns false for polygons the
+    // direct method cannot crop reliably: those whose boundary crosses the
+    // rectangle more than twice (the result may fall apart into several pieces)
+    // or that have holes crossing it.
+    bool cropToRect(const Geometry* input, const Bounds& r, bool exact, GeometryCollection& parts)
+    {
+        if ( input->size() == 0 )
+            return true;
+
+        Bounds b = input->getBounds();
+        if ( !overlaps2D(b, r) )
+            return true;
+
+        if ( r.contains(b) )
+        {
+            if ( input->getType() == Geometry::TYPE_POLYGON )
+                parts.push_back( new Polygon(*static_cast<const Polygon*>(input)) );
+            else
+                parts.push_back( input->cloneAs(input->getType()) );
+            return true;
+        }
+
+        switch( input->getType() )
+        {
+        case Geometry::TYPE_POINTSET:
+            {
+                osg::ref_ptr<PointSet> points = new PointSet();
+                for(Geometry::const_iterator p = input->begin(); p != input->end(); ++p)
+                {
+                    if ( r.contains(p->x(), p->y()) )
+                        points->push_back( *p );
+                }
+                if ( points->size() > 0 )
+                    parts.push_back( points.get() );
+            }
+            return true;
+
+        case Geometry::TYPE_LINESTRING:
+            clipLine( input, false, r, parts );
+            return true;
+
+        case Geometry::TYPE_RING:
+            clipLine( input, true, r, parts );
+            return true;
+
+        case Geometry::TYPE_POLYGON:
+            {
+                const Polygon* poly = static_cast<const Polygon*>(input);
+                osg::Vec2d center = r.center2d();
+
+                osg::ref_ptr<Polygon> output = new Polygon();
+                unsigned crossings = countCrossings( poly, r );
+                if ( crossings == 0 )
+                {
+                    // the outer ring is either around the rectangle or off to the side.
+                    if ( !poly->Ring::contains2D(center.x(), center.y()) )
+                        return true;
+                    output->push_back( osg::Vec3d(r.xMin(), r.yMin(), 0) );
+                    output->push_back( osg::Vec3d(r.xMax(), r.yMin(), 0) );
+                    output->push_back( osg::Vec3d(r.xMax(), r.yMax(), 0) );
+                    output->push_back( osg::Vec3d(r.xMin(), r.yMax(), 0) );
+                }
+                else if ( crossings > 2 && exact )
+                {
+                    return false;
+                }
+                else
+                {
+                    clipRing( poly, r, output.get() );
+                }
+
+                for(RingCollection::const_iterator h = poly->getHoles().begin(); h != poly->getHoles().end(); ++h)
+                {
+                    const Ring* hole = h->get();
+                    Bounds hb = hole->getBounds();
+                    if ( r.contains(hb) )
+                    {
+                        output->getHoles().push_back( new Ring(*hole) );
+                    }
+                    else if ( overlaps2D(hb, r) )
+                    {
+                        if ( countCrossings(hole, r) == 0 )
+                        {
+                            // a hole around the whole rectangle leaves nothing.
+                            if ( hole->contains2D(center.x(), center.y()) )
+                                return true;
+                        }
+                        else if ( exact )
+                        {
+                            return false;
+                        }
+                        else
+                        {
+                            osg::ref_ptr<Ring> clipped = new Ring();
+                            clipRing( hole, r, clipped.get() );
+                            if ( clipped->size() > 2 )
+                                output->getHoles().push_back( clipped.get() );
+                        }
+                    }
+                }
+
+                if ( output->size() > 2 )
+                    parts.push_back( output.get() );
+            }
+            return true;
+
+        default:
+            return !exact;
+        }
+    }
+}
+
 bool
 Geometry::crop( const Bounds& bounds, osg::ref_ptr<Geometry>& output ) const
 {
-    osg::ref_ptr<Polygon> poly = new Polygon;
-    poly->resize( 4 );        
-    (*poly)[0].set(bounds.xMin(), bounds.yMin(), 0);
-    (*poly)[1].set(bounds.xMax(), bounds.yMin(), 0);
-    (*poly)[2].set(bounds.xMax(), bounds.yMax(), 0);
-    (*poly)[3].set(bounds.xMin(), bounds.yMax(), 0);
-    return crop(poly, output);
+    output = 0L;
+
+    // Crop directly against the rectangle when possible. This avoids the GEOS
+    // conversion and overlay entirely, and works without GEOS. Polygons that
+    // cannot be cropped reliably this way fall back on GEOS when it's available.
+#ifdef OSGEARTH_HAVE_GEOS
+    bool exact = true;
+#else
+    bool exact = false;
+#endif
+
+    GeometryCollection parts;
+    bool direct = true;
+    if ( getType() == TYPE_MULTI )
+    {
+        const GeometryCollection& comps = static_cast<const MultiGeometry*>(this)->getComponents();
+        for(GeometryCollection::const_iterator i = comps.begin(); i != comps.end() && direct; ++i)
+        {
+            direct = cropToRect( i->get(), bounds, exact, parts );
+        }
+    }
+    else
+    {
+        direct = cropToRect( this, bounds, exact, parts );
+    }
+
+    if ( !direct )
+    {
+        osg::ref_ptr<Polygon> poly = new Polygon;
+        poly->resize( 4 );        
+        (*poly)[0].set(bounds.xMin(), bounds.yMin(), 0);
+        (*poly)[1].set(bounds.xMax(), bounds.yMin(), 0);
+        (*poly)[2].set(bounds.xMax(), bounds.yMax(), 0);
+        (*poly)[3].set(bounds.xMin(), bounds.yMax(), 0);
+        return crop(poly, output);
+    }
+
+    if ( parts.empty() )
+    {
+        // empty result; see crop(Polygon)
+        output = new Geometry();
+        return false;
+    }
+
+    if ( parts.size() == 1 )
+        output = parts.front().get();
+    else
+        output = new MultiGeometry( parts );
+
+    if ( !output->isValid() )
+    {
+        output = 0L;
+        return false;
+    }
+    return true;
 }
 
 bool
@@ -995,6 +1295,131 @@ MultiGeometry::removeColinearPoints()
 
 //----------------------------------------------------------------------------
 
+#ifdef OSGEARTH_HAVE_GEOS
+
+struct PreparedGeometry::Impl
+{
+    GEOSContext                         _gc;
+    geom::Geometry*                     _geos;
+    const geom::prep::PreparedGeometry* _prepared;
+
+    Impl() : _geos(0L), _prepared(0L) { }
+
+    ~Impl()
+    {
+        delete _prepared;
+        _gc.disposeGeometry( _geos );
+    }
+};
+
+#else // OSGEARTH_HAVE_GEOS
+
+struct PreparedGeometry::Impl { };
+
+#endif // OSGEARTH_HAVE_GEOS
+
+PreparedGeometry::PreparedGeometry( const Geometry* geom ) :
+_geom( geom ),
+_impl( 0L )
+{
+    if ( geom )
+        _bounds = geom->getBounds();
+}
+
+PreparedGeometry::~PreparedGeometry()
+{
+    delete _impl;
+}
+
+PreparedGeometry::Impl*
+PreparedGeometry::getImpl( bool prepare ) const
+{
+#ifdef OSGEARTH_HAVE_GEOS
+    if ( !_impl )
+    {
+        _impl = new Impl();
+        if ( _geom.valid() )
+            _impl->_geos = _impl->_gc.importGeometry( _geom.get() );
+    }
+
+    if ( prepare && _impl->_geos && !_impl->_prepared )
+    {
+        try {
+#if GEOS_VERSION_MAJOR >= 3 && GEOS_VERSION_MINOR >= 8
+            _impl->_prepared = geom::prep::PreparedGeometryFactory::prepare( _impl->_geos ).release();
+#else
+            _impl->_prepared = geom::prep::PreparedGeometryFactory::prepare( _impl->_geos );
+#endif
+        }
+        catch(const geos::util::GEOSException& ex) {
+            GEOS_OUT << LC << "Prepare(GEOS): "
+                << (ex.what()? ex.what() : " no error message")
+                << std::endl;
+        }
+    }
+#endif // OSGEARTH_HAVE_GEOS
+
+    return _impl;
+}
+
+bool
+PreparedGeometry::intersects( const PreparedGeometry* other ) const
+{
+    if ( !other || !_bounds.isValid() || !other->_bounds.isValid() )
+        return false;
+
+    if (_bounds.xMin() > other->_bounds.xMax() || _bounds.xMax() < other->_bounds.xMin() ||
+        _bounds.yMin() > other->_bounds.yMax() || _bounds.yMax() < other->_bounds.yMin() )
+        return false;
+
+#ifdef OSGEARTH_HAVE_GEOS
+
+    Impl* impl = getImpl( true );
+    Impl* otherImpl = other->getImpl( false );
+    if ( !impl->_geos || !otherImpl->_geos )
+        return false;
+
+    if ( impl->_prepared )
+        return impl->_prepared->intersects( otherImpl->_geos );
+    else
+        return impl->_geos->intersects( otherImpl->_geos );
+
+#else // OSGEARTH_HAVE_GEOS
+
+    OE_WARN << LC << "Intersects failed - GEOS not available" << std::endl;
+    return false;
+
+#endif // OSGEARTH_HAVE_GEOS
+}
+
+bool
+PreparedGeometry::contains( const PreparedGeometry* other ) const
+{
+    if ( !other || !_bounds.contains(other->_bounds) )
+        return false;
+
+#ifdef OSGEARTH_HAVE_GEOS
+
+    Impl* impl = getImpl( true );
+    Impl* otherImpl = other->getImpl( false );
+    if ( !impl->_geos || !otherImpl->_geos )
+        return false;
+
+    if ( impl->_prepared )
+        return impl->_prepared->contains( otherImpl->_geos );
+    else
+        return impl->_geos->contains( otherImpl->_geos );
+
+#else // OSGEARTH_HAVE_GEOS
+
+    OE_WARN << LC << "Contains failed - GEOS not available" << std::endl;
+    return false;
+
+#endif // OSGEARTH_HAVE_GEOS
+}
+
+//----------------------------------------------------------------------------
+
 GeometryIterator::GeometryIterator( Geometry* geom, bool holes ) :
 _next( 0L ),
 _traverseMulti( true ),
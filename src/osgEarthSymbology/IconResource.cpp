@@ -39,14 +39,17 @@ using namespace osgEarth::Symbology;
 
 namespace
 {
-    osg::Node* buildIconModel(osg::Image* image)
+    // icon state that doesn't depend on the texture.
+    void applyIconState(osg::StateSet* stateSet)
     {
-        // because the ShaderGenerator cannot handle texture rectangles yet.
-        bool useRect = !Registry::capabilities().supportsGLSL();
-
-        float width = image->s();
-        float height = image->t();
+        stateSet->setMode( GL_BLEND, 1 );
+        stateSet->setRenderBinDetails( 95, "DepthSortedBin" );
+        stateSet->setAttributeAndModes( new osg::Depth(osg::Depth::ALWAYS,false), 1 );
+    }
 
+    // a screen-aligned quad the size of the icon, in pixels.
+    osg::Geometry* buildIconQuad(float width, float height)
+    {
         osg::Geometry* geometry = new osg::Geometry;
         geometry->setUseVertexBufferObjects(true);
 
@@ -57,6 +60,26 @@ namespace
         (*verts)[3] = osg::Vec3(-width/2.0f,  height/2.0, 0.0f);
         geometry->setVertexArray( verts );
 
+        osg::Vec4Array* colors = new osg::Vec4Array(1);
+        (*colors)[0].set(1,1,1,1);
+        geometry->setColorArray( colors );
+        geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
+
+        geometry->addPrimitiveSet( new osg::DrawArrays(GL_QUADS, 0, 4));
+
+        return geometry;
+    }
+
+    osg::Node* buildIconModel(osg::Image* image)
+    {
+        // because the ShaderGenerator cannot handle texture rectangles yet.
+        bool useRect = !Registry::capabilities().supportsGLSL();
+
+        float width = image->s();
+        float height = image->t();
+
+        osg::Geometry* geometry = buildIconQuad(width, height);
+
         bool flip = image->getOrigin()==osg::Image::TOP_LEFT;
 
         osg::Vec2Array* texcoords = new osg::Vec2Array(4);
@@ -76,13 +99,6 @@ namespace
         }
         geometry->setTexCoordArray(0, texcoords);
 
-        osg::Vec4Array* colors = new osg::Vec4Array(1);
-        (*colors)[0].set(1,1,1,1);
-        geometry->setColorArray( colors );
-        geometry->setColorBinding( osg::Geometry::BIND_OVERALL );
-
-        geometry->addPrimitiveSet( new osg::DrawArrays(GL_QUADS, 0, 4));
-
         osg::StateSet* stateSet = geometry->getOrCreateStateSet();
 
         osg::Texture* texture;
@@ -105,9 +121,7 @@ namespace
 
         stateSet->setTextureAttributeAndModes(0, texture, osg::StateAttribute::ON);
 
-        stateSet->setMode( GL_BLEND, 1 );
-        stateSet->setRenderBinDetails( 95, "DepthSortedBin" );
-        stateSet->setAttributeAndModes( new osg::Depth(osg::Depth::ALWAYS,false), 1 );
+        applyIconState( stateSet );
 
         osg::Geode* geode = new osg::Geode;
         geode->addDrawable( geometry );
@@ -139,6 +153,39 @@ IconResource::getConfig() const
     return conf;
 }
 
+osg::Node*
+IconResource::createNodeFromTextureArray(osg::StateSet* stateSet,
+                                         unsigned       layer,
+                                         float          width,
+                                         float          height,
+                                         bool           flip) const
+{
+    osg::Geometry* geometry = buildIconQuad(width, height);
+
+    float r = (float)layer;
+    osg::Vec3Array* texcoords = new osg::Vec3Array(4);
+    (*texcoords)[0].set(0.0f, flip ? 1.0f : 0.0f, r);
+    (*texcoords)[1].set(1.0f, flip ? 1.0f : 0.0f, r);
+    (*texcoords)[2].set(1.0f, flip ? 0.0f : 1.0f, r);
+    (*texcoords)[3].set(0.0f, flip ? 0.0f : 1.0f, r);
+    geometry->setTexCoordArray(0, texcoords);
+
+    geometry->setStateSet( stateSet );
+
+    osg::Geode* geode = new osg::Geode;
+    geode->addDrawable( geometry );
+    return geode;
+}
+
+osg::StateSet*
+IconResource::createTextureArrayStateSet(osg::Texture* textureArray)
+{
+    osg::StateSet* stateSet = new osg::StateSet();
+    stateSet->setTextureAttributeAndModes(0, textureArray, osg::StateAttribute::ON);
+    applyIconState( stateSet );
+    return stateSet;
+}
+
 osg::Node*
 IconResource::createNodeFromURI( const URI& uri, const osgDB::Options* dbOptions ) const
 {
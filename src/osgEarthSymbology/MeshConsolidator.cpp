@@ -22,12 +22,15 @@
 
 #include <osgEarthSymbology/MeshConsolidator>
 #include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/Registry>
 #include <osg/TriangleFunctor>
 #include <osg/TriangleIndexFunctor>
 #include <osg/Version>
 #include <osgDB/WriteFile>
 #include <osgUtil/MeshOptimizers>
 #include <limits>
+#include <cstdlib>
 #include <map>
 #include <iterator>
 
@@ -387,59 +390,94 @@ typedef std::vector<osg::ref_ptr<osg::Drawable> > DrawableList;
 
 namespace
 {
-    void merge( 
-        DrawableList::iterator&       start, 
-        DrawableList::iterator&       end,
-        unsigned                      numVerts,
-        unsigned                      numColors,
-        unsigned                      numNormals,
-        const std::vector<unsigned>&  texCoordArrayUnits,
-        bool                          useVBOs,
-        DrawableList&                 results )
+    /**
+     * Everything that must match for two geometries to share one merged
+     * geometry: equivalent state, and the same set of vertex arrays.
+     */
+    struct Signature
     {
-        osg::Geometry::AttributeBinding newColorsBinding, newNormalsBinding;
+        osg::StateSet*        _stateSet;
+        bool                  _colors;
+        bool                  _normals;
+        bool                  _useVBOs;
+        std::vector<unsigned> _texCoordUnits;
+
+        Signature(osg::Geometry& geom) :
+            _stateSet( geom.getStateSet() ),
+            _colors  ( geom.getColorArray() != 0L ),
+            _normals ( geom.getNormalArray() != 0L ),
+            _useVBOs ( geom.getUseVertexBufferObjects() )
+        {
+            for( unsigned u=0; u<geom.getNumTexCoordArrays(); ++u )
+                if ( geom.getTexCoordArray(u) != 0L )
+                    _texCoordUnits.push_back( u );
+        }
+
+        bool matches(const Signature& rhs) const
+        {
+            if ( _colors != rhs._colors || _normals != rhs._normals || _useVBOs != rhs._useVBOs || _texCoordUnits != rhs._texCoordUnits )
+                return false;
+            if ( _stateSet == rhs._stateSet )
+                return true;
+            return _stateSet && rhs._stateSet && _stateSet->compare(*rhs._stateSet, true) == 0;
+        }
+    };
+
+    struct Group
+    {
+        Signature     _signature;
+        DrawableList  _geoms;
+        Group(const Signature& sig) : _signature(sig) { }
+    };
+
+    template<typename T>
+    void append( T* to, const osg::Array* from )
+    {
+        const T* src = dynamic_cast<const T*>( from );
+        if ( src )
+            to->insert( to->end(), src->begin(), src->end() );
+    }
+
+    osg::Geometry* merge( 
+        DrawableList::const_iterator  start, 
+        DrawableList::const_iterator  end,
+        const Signature&              sig )
+    {
+        const std::vector<unsigned>& texCoordArrayUnits = sig._texCoordUnits;
+
+        unsigned numVerts = 0;
+        for( DrawableList::const_iterator i = start; i != end; ++i )
+            numVerts += i->get()->asGeometry()->getVertexArray()->getNumElements();
 
         osg::Vec3Array* newVerts = new osg::Vec3Array();
         newVerts->reserve( numVerts );
 
         // Determine if we need to use 3D texture coordinates or not.
         bool use3DTextureCoords = false;
-        for( DrawableList::iterator i = start; i != end; ++i )
+        for( DrawableList::const_iterator i = start; i != end && !use3DTextureCoords; ++i )
         {
             for( unsigned a=0; a<texCoordArrayUnits.size(); ++a )
             {
-                unsigned unit = texCoordArrayUnits[a];
-
-                osg::Vec3Array* texCoords = dynamic_cast<osg::Vec3Array*>(i->get()->asGeometry()->getTexCoordArray( unit ));
-                if (texCoords)
+                if ( dynamic_cast<osg::Vec3Array*>(i->get()->asGeometry()->getTexCoordArray(texCoordArrayUnits[a])) )
                 {
                     use3DTextureCoords = true;
                     break;
                 }
             }
-
-            if (use3DTextureCoords) break;
         }
 
-
         osg::Vec4Array* newColors =0L;
-        if ( numColors > 0 )
+        if ( sig._colors )
         {
             newColors = new osg::Vec4Array();
             newColors->reserve( numVerts );
-            newColorsBinding = osg::Geometry::BIND_PER_VERTEX;
-            //newColors->reserve( numColors==numVerts? numColors : 1 );
-            //newColorsBinding = numColors==numVerts? osg::Geometry::BIND_PER_VERTEX : osg::Geometry::BIND_OVERALL;
         }
 
         osg::Vec3Array* newNormals =0L;
-        if ( numNormals > 0 )
+        if ( sig._normals )
         {
             newNormals = new osg::Vec3Array();
             newNormals->reserve( numVerts );
-            newNormalsBinding = osg::Geometry::BIND_PER_VERTEX;
-            //newNormals->reserve( numNormals==numVerts? numNormals : 1 );
-            //newNormalsBinding = numNormals==numVerts? osg::Geometry::BIND_PER_VERTEX : osg::Geometry::BIND_OVERALL;
         }
 
         std::vector<osg::Array*> newTexCoordsArrays;
@@ -464,130 +502,85 @@ namespace
         unsigned offset = 0;
         osg::Geometry::PrimitiveSetList newPrimSets;
 
-        std::vector<osg::ref_ptr<osg::Geometry> > nonOptimizedGeoms;
+        for( DrawableList::const_iterator i = start; i != end; ++i )
+        {
+            osg::Geometry* geom = i->get()->asGeometry();
 
-        osg::StateSet* unifiedStateSet = 0L;
+            // copy over the verts (type-checked by canOptimize):
+            osg::Vec3Array* geomVerts = static_cast<osg::Vec3Array*>( geom->getVertexArray() );
+            newVerts->insert( newVerts->end(), geomVerts->begin(), geomVerts->end() );
 
-        for( DrawableList::iterator i = start; i != end; ++i )
-        {
-            osg::Geometry* geom = i->get()->asGeometry(); //geode.getDrawable(i)->asGeometry();
+            // every array in the signature is bound per-vertex at this point.
+            if ( newColors )
+                append( newColors, geom->getColorArray() );
 
-            // merge in the stateset:
-            if ( unifiedStateSet == 0L )
-                unifiedStateSet = geom->getStateSet();
-            else if ( geom->getStateSet() )
-                unifiedStateSet->merge( *geom->getStateSet() );            
+            if ( newNormals )
+                append( newNormals, geom->getNormalArray() );
 
-            // copy over the verts:
-            osg::Vec3Array* geomVerts = dynamic_cast<osg::Vec3Array*>( geom->getVertexArray() );
-            if ( geomVerts )
+            for( unsigned a=0; a<texCoordArrayUnits.size(); ++a )
             {
-                std::copy( geomVerts->begin(), geomVerts->end(), std::back_inserter(*newVerts) );
+                const osg::Array* texCoords = geom->getTexCoordArray( texCoordArrayUnits[a] );
 
-                if ( newColors )
+                if ( !use3DTextureCoords )
                 {
-                    osg::Vec4Array* colors = dynamic_cast<osg::Vec4Array*>( geom->getColorArray() );
-                    if ( colors )
-                    {
-                        if ( newColorsBinding == osg::Geometry::BIND_PER_VERTEX )
-                        {
-                            std::copy( colors->begin(), colors->end(), std::back_inserter(*newColors) );
-                        }
-                        else if ( i == start ) //i == 0 ) // overall
-                        {
-                            newColors->push_back( (*colors)[0] );
-                        }
-                    }
+                    append( static_cast<osg::Vec2Array*>(newTexCoordsArrays[a]), texCoords );
                 }
-
-                if ( newNormals )
+                else
                 {
-                    osg::Vec3Array* normals = dynamic_cast<osg::Vec3Array*>( geom->getNormalArray() );
-                    if ( normals )
+                    // We are using 3D coordinates, so consolidate 2D and 3D coordinates into 3D.
+                    osg::Vec3Array* newTexCoords = static_cast<osg::Vec3Array*>( newTexCoordsArrays[a] );
+                    const osg::Vec2Array* texCoords2D = dynamic_cast<const osg::Vec2Array*>( texCoords );
+                    if ( texCoords2D )
                     {
-                        if ( newNormalsBinding == osg::Geometry::BIND_PER_VERTEX )
-                        {
-                            std::copy( normals->begin(), normals->end(), std::back_inserter(*newNormals) );
-                        }
-                        else if ( i == start ) //0 ) // overall
-                        {
-                            newNormals->push_back( (*normals)[0] );
-                        }
+                        for (osg::Vec2Array::const_iterator itr = texCoords2D->begin(); itr != texCoords2D->end(); ++itr)
+                            newTexCoords->push_back( osg::Vec3(itr->x(), itr->y(), 0) );
                     }
-                }
-
-                if ( newTexCoordsArrays.size() > 0 )
-                {
-                    for( unsigned a=0; a<texCoordArrayUnits.size(); ++a )
+                    else
                     {
-                        unsigned unit = texCoordArrayUnits[a];
-
-                        // We are just using 2D texture coordinates so only check for the 2D case
-                        if (!use3DTextureCoords)
-                        {
-                            osg::Vec2Array* texCoords2D = dynamic_cast<osg::Vec2Array*>( geom->getTexCoordArray(unit) );
-                            if (texCoords2D)
-                            {
-                                osg::Vec2Array* newTexCoords = static_cast< osg::Vec2Array*>( newTexCoordsArrays[a] );
-                                std::copy( texCoords2D->begin(), texCoords2D->end(), std::back_inserter(*newTexCoords) );
-                            }                                                           
-                        }
-                        else
-                        {
-                            // We are using 3D coordinates, so check for both 2D and 3D coordinates.  We will consolidate them all into 3D coordinates.
-                            osg::Vec2Array* texCoords2D = dynamic_cast<osg::Vec2Array*>( geom->getTexCoordArray(unit) );
-                            osg::Vec3Array* texCoords3D = dynamic_cast<osg::Vec3Array*>( geom->getTexCoordArray(unit) );
-                            if (texCoords2D || texCoords3D)
-                            {
-                                osg::Vec3Array* newTexCoords = static_cast< osg::Vec3Array*>( newTexCoordsArrays[a] );
-                                if (texCoords3D)
-                                {
-                                    std::copy( texCoords3D->begin(), texCoords3D->end(), std::back_inserter(*newTexCoords) );
-                                }
-                                else
-                                {
-                                    // Convert 2D to 3D coords
-                                    for (osg::Vec2Array::iterator itr = texCoords2D->begin(); itr != texCoords2D->end(); ++itr)
-                                    {                                        
-                                        newTexCoords->push_back( osg::Vec3(itr->x(), itr->y(), 0) );
-                                    }
-                                }
-                            }
-                        }                                                
+                        append( newTexCoords, texCoords );
                     }
                 }
+            }
 
-                osg::ref_ptr<osg::Referenced> sharedUserData;
+            osg::ref_ptr<osg::Referenced> sharedUserData;
 
-                for( unsigned j=0; j < geom->getNumPrimitiveSets(); ++j )
-                {
-                    osg::PrimitiveSet* pset = geom->getPrimitiveSet(j);
-                    osg::PrimitiveSet* newpset = 0L;
-
-                    // all primsets have the same user data (or else we would not have made it this far
-                    // since canOptimize would be false)
-                    if ( !sharedUserData.valid() )
-                        sharedUserData = pset->getUserData();
-
-                    if ( dynamic_cast<osg::DrawElementsUByte*>(pset) )
-                        newpset = remake( static_cast<osg::DrawElementsUByte*>(pset), numVerts, offset );
-                    else if ( dynamic_cast<osg::DrawElementsUShort*>(pset) )
-                        newpset = remake( static_cast<osg::DrawElementsUShort*>(pset), numVerts, offset );
-                    else if ( dynamic_cast<osg::DrawElementsUInt*>(pset) )
-                        newpset = remake( static_cast<osg::DrawElementsUInt*>(pset), numVerts, offset );
-                    else if ( dynamic_cast<osg::DrawArrays*>(pset) )
-                        newpset = convertDAtoDE( static_cast<osg::DrawArrays*>(pset), numVerts, offset );
-
-                    if ( newpset )
-                    {
-                        newpset->setUserData( sharedUserData.get() );
+            for( unsigned j=0; j < geom->getNumPrimitiveSets(); ++j )
+            {
+                osg::PrimitiveSet* pset = geom->getPrimitiveSet(j);
+                osg::PrimitiveSet* newpset = 0L;
 
-                        newPrimSets.push_back( newpset );
-                    }
+                // all primsets have the same user data (or else we would not have made it this far
+                // since canOptimize would be false)
+                if ( !sharedUserData.valid() )
+                    sharedUserData = pset->getUserData();
+
+                // re-index to the smallest element type that addresses the merged vertex array.
+                switch( pset->getType() )
+                {
+                case osg::PrimitiveSet::DrawElementsUBytePrimitiveType:
+                    newpset = remake( static_cast<osg::DrawElementsUByte*>(pset), numVerts, offset );
+                    break;
+                case osg::PrimitiveSet::DrawElementsUShortPrimitiveType:
+                    newpset = remake( static_cast<osg::DrawElementsUShort*>(pset), numVerts, offset );
+                    break;
+                case osg::PrimitiveSet::DrawElementsUIntPrimitiveType:
+                    newpset = remake( static_cast<osg::DrawElementsUInt*>(pset), numVerts, offset );
+                    break;
+                case osg::PrimitiveSet::DrawArraysPrimitiveType:
+                    newpset = convertDAtoDE( static_cast<osg::DrawArrays*>(pset), numVerts, offset );
+                    break;
+                default:
+                    break;
                 }
 
-                offset += geomVerts->size();
+                if ( newpset )
+                {
+                    newpset->setUserData( sharedUserData.get() );
+                    newPrimSets.push_back( newpset );
+                }
             }
+
+            offset += geomVerts->size();
         }
 
         // assemble the new geometry.
@@ -598,42 +591,74 @@ namespace
         if ( newColors )
         {
             newGeom->setColorArray( newColors );
-            newGeom->setColorBinding( newColorsBinding );
+            newGeom->setColorBinding( osg::Geometry::BIND_PER_VERTEX );
         }
 
         if ( newNormals )
         {
             newGeom->setNormalArray( newNormals );
-            newGeom->setNormalBinding( newNormalsBinding );
+            newGeom->setNormalBinding( osg::Geometry::BIND_PER_VERTEX );
         }
 
-        if ( newTexCoordsArrays.size() > 0 )
+        for( unsigned a=0; a<texCoordArrayUnits.size(); ++a )
         {
-            for( unsigned a=0; a<texCoordArrayUnits.size(); ++a )
-            {
-                unsigned unit = texCoordArrayUnits[a];
-                newGeom->setTexCoordArray( unit, newTexCoordsArrays[a] );
-            }
+            newGeom->setTexCoordArray( texCoordArrayUnits[a], newTexCoordsArrays[a] );
         }
 
         newGeom->setPrimitiveSetList( newPrimSets );
-        newGeom->setStateSet( unifiedStateSet );
 
-        newGeom->setUseVertexBufferObjects( useVBOs );
-        newGeom->setUseDisplayList( !useVBOs );
+        // all members of the group carry equivalent state, so sharing the
+        // first one's is enough.
+        newGeom->setStateSet( sig._stateSet );
 
-        results.push_back( newGeom );
+        newGeom->setUseVertexBufferObjects( sig._useVBOs );
+        newGeom->setUseDisplayList( !sig._useVBOs );
 
         //GeometryValidator().apply( *newGeom );
+
+        return newGeom;
     }
+
+    // Consolidations share the registry's thread budget under this UID.
+    TaskService* getConsolidationService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    /**
+     * One output geometry's worth of a group per job, merged in parallel.
+     * Results land in job order so the output does not depend on scheduling.
+     */
+    struct MergeJobs : public ParallelJobs
+    {
+        struct Job
+        {
+            DrawableList::const_iterator _start, _end;
+            const Signature*             _signature;
+        };
+
+        std::vector<Job>                          _jobs;
+        std::vector<osg::ref_ptr<osg::Geometry> > _results;
+
+        void runJob(unsigned i)
+        {
+            const Job& job = _jobs[i];
+            _results[i] = merge(job._start, job._end, *job._signature);
+        }
+
+        void run(TaskService* service)
+        {
+            _results.resize(_jobs.size());
+            ParallelJobs::run(_jobs.size(), service);
+        }
+    };
 }
 
 
 void
-MeshConsolidator::run( osg::Geode& geode )
+MeshConsolidator::run( osg::Geode& geode, unsigned maxVertsPerGeometry )
 {
-    bool useVBOs = false;
-    
     // NOTE: we'd rather use the IndexMeshVisitor instead of our own code here,
     // but the IMV does not preserve the user data attached to the primitive sets.
     // We need that since it holds the feature index information.
@@ -644,82 +669,87 @@ MeshConsolidator::run( osg::Geode& geode )
     if ( geode.getNumDrawables() <= 1 )
         return;
 
-    // list of geometries to consolidate and not to consolidate.
-    DrawableList consolidate, dontConsolidate;
+    if ( maxVertsPerGeometry == 0u )
+        maxVertsPerGeometry = 0xFFFF;
 
-    // list of texture coordinate array image units in use
-    std::vector<unsigned> texCoordArrayUnits;
-    texCoordArrayUnits.reserve(32);
+    // geometries to consolidate, grouped by signature, and those not to consolidate.
+    std::vector<Group> groups;
+    DrawableList dontConsolidate;
 
     // sort the drawables:
     for( unsigned i=0; i<geode.getNumDrawables(); ++i )
     {
         osg::Geometry* geom = geode.getDrawable(i)->asGeometry();
-        if ( geom )
+        if ( geom && canOptimize(*geom) )
         {
-            if ( canOptimize(*geom) )
-            {
-                // convert all surface primitives to triangles.
-                convertToTriangles( *geom );
+            // convert all surface primitives to triangles.
+            convertToTriangles( *geom );
 
-                // NOTE!! tex/attrib array counts much already be equal.
-                if ( texCoordArrayUnits.size() == 0 )
-                {
-                    for( unsigned u=0; u<32; ++u ) {
-                        if ( geom->getTexCoordArray(u) != 0L )
-                            texCoordArrayUnits.push_back( u );
-                    }
+            Signature sig( *geom );
+            unsigned g = 0;
+            while( g < groups.size() && !groups[g]._signature.matches(sig) )
+                ++g;
+            if ( g == groups.size() )
+                groups.push_back( Group(sig) );
 
-                    if ( geom->getUseVertexBufferObjects() )
-                        useVBOs = true;
-                }
-
-                consolidate.push_back(geom);
-            }
-            else
-            {
-                dontConsolidate.push_back(geom);
-            }
+            groups[g]._geoms.push_back( geom );
+        }
+        else
+        {
+            dontConsolidate.push_back( geode.getDrawable(i) );
         }
     }
 
-    // start consolidating the geometries.
-    unsigned targetNumVertsPerGeom = 100000; //TODO: configurable?
-    DrawableList results;
+    // cut each group into runs that fit the vertex budget. Staying within
+    // 64K verts lets the merged primitives use 16-bit indices.
+    osg::ref_ptr<MergeJobs> jobs = new MergeJobs();
+    unsigned totalVerts = 0;
 
-    unsigned numVerts = 0, numColors = 0, numNormals = 0;
-    DrawableList::iterator start = consolidate.begin();
-
-    for( DrawableList::iterator end = consolidate.begin(); end != consolidate.end(); )
+    for( std::vector<Group>::const_iterator g = groups.begin(); g != groups.end(); ++g )
     {
-        osg::Geometry* geom = end->get()->asGeometry(); // already type-checked this earlier.
-        unsigned geomNumVerts = geom->getVertexArray()->getNumElements();
-
-        ++end;
+        unsigned numVerts = 0;
+        DrawableList::const_iterator start = g->_geoms.begin();
 
-        numVerts += geomNumVerts;
-        if ( geom->getColorArray() )
-            numColors += geom->getColorArray()->getNumElements();
-        if ( geom->getNormalArray() )
-            numNormals += geom->getNormalArray()->getNumElements();
-
-        if ( numVerts > targetNumVertsPerGeom || end == consolidate.end() )
+        for( DrawableList::const_iterator end = g->_geoms.begin(); end != g->_geoms.end(); )
         {
-            OE_DEBUG << LC << "Merging " << ((unsigned)(end-start)) << " geoms with " << numVerts << " verts." << std::endl;
+            unsigned geomNumVerts = end->get()->asGeometry()->getVertexArray()->getNumElements();
 
-            merge( start, end, numVerts, numColors, numNormals, texCoordArrayUnits, useVBOs, results );
+            if ( numVerts > 0 && numVerts + geomNumVerts > maxVertsPerGeometry )
+            {
+                MergeJobs::Job job = { start, end, &g->_signature };
+                jobs->_jobs.push_back( job );
+                start = end;
+                numVerts = 0;
+            }
+
+            numVerts += geomNumVerts;
+            totalVerts += geomNumVerts;
+            ++end;
+        }
 
-            start = end;
-            numVerts = 0, numColors = 0, numNormals = 0;
+        if ( start != g->_geoms.end() )
+        {
+            MergeJobs::Job job = { start, g->_geoms.end(), &g->_signature };
+            jobs->_jobs.push_back( job );
         }
     }
 
+    OE_DEBUG << LC << "Merging " << totalVerts << " verts in " << groups.size() << " groups into " << jobs->_jobs.size() << " geoms." << std::endl;
+
+    // small geodes are not worth the hand-off.
+    bool parallel = jobs->_jobs.size() > 1 && totalVerts > maxVertsPerGeometry;
+    jobs->run( parallel ? getConsolidationService() : 0L );
+
     // re-build the geode:
     geode.removeDrawables( 0, geode.getNumDrawables() );
 
-    for( DrawableList::iterator i = results.begin(); i != results.end(); ++i )
-        geode.addDrawable( i->get() );
+    for( unsigned i=0; i<jobs->_results.size(); ++i )
+        geode.addDrawable( jobs->_results[i].get() );
 
     for( DrawableList::iterator i = dontConsolidate.begin(); i != dontConsolidate.end(); ++i )
         geode.addDrawable( i->get() );
+
+    // a helper task may still hold the jobs; don't leave our geometry in it.
+    jobs->_results.clear();
+    jobs->_jobs.clear();
 }
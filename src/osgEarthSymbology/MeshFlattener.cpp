@@ -23,9 +23,13 @@
 #include <osgEarthSymbology/MeshConsolidator>
 #include <osgEarthSymbology/MeshFlattener>
 #include <osgEarth/StateSetCache>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/Registry>
 #include <osgUtil/Optimizer>
 #include <osgDB/WriteFile>
 #include <osg/Billboard>
+#include <cstdlib>
 
 using namespace osgEarth;
 using namespace osgEarth::Symbology;
@@ -56,6 +60,32 @@ namespace
             }
         }
     };
+
+    // Flattening shares the registry's thread budget under this UID.
+    TaskService* getFlattenService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    /**
+     * Geodes to consolidate in parallel, one per state set stack; each
+     * geode is only touched by one thread.
+     */
+    struct ConsolidateJobs : public ParallelJobs
+    {
+        std::vector<osg::Geode*> _geodes;
+
+        void runJob(unsigned i)
+        {
+            MeshConsolidator::run(*_geodes[i]);
+        }
+
+        void run(TaskService* service)
+        {
+            ParallelJobs::run(_geodes.size(), service);
+        }
+    };
 }
 
 /********************************/
@@ -115,6 +145,10 @@ osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN )
             pushStateSet(ss.get());
         }
 
+        // drawables without a state set of their own all share this list,
+        // so only look it up once.
+        GeometryVector* geodeGeometries = 0L;
+
         for (unsigned int i = 0; i < geode.getNumDrawables(); i++)
         {
             osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
@@ -124,17 +158,15 @@ osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN )
                 if (geomSS.valid())
                 {
                     pushStateSet( geomSS.get() );
+                    _geometries[_ssStack].push_back(geometry);
+                    popStateSet();
                 }
-
-                GeometryVector& geometries = _geometries[_ssStack];
-                geometries.push_back(geometry);
-
-                if (geomSS.valid())
+                else
                 {
-                    popStateSet();
+                    if (!geodeGeometries)
+                        geodeGeometries = &_geometries[_ssStack];
+                    geodeGeometries->push_back(geometry);
                 }
-
-                
             }
         }
         
@@ -162,6 +194,10 @@ osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN )
 
         OE_DEBUG << "We have " << _geometries.size() << " stateset stacks" << std::endl;
 
+        // the geodes are independent of each other, so consolidate them in parallel.
+        osg::ref_ptr<ConsolidateJobs> jobs = new ConsolidateJobs();
+        jobs->_geodes.reserve(_geometries.size());
+
         unsigned int i = 0;
         for (StateSetStackToGeometryMap::iterator itr = _geometries.begin(); itr != _geometries.end(); ++itr)
         {
@@ -187,9 +223,15 @@ osg::NodeVisitor( osg::NodeVisitor::TRAVERSE_ALL_CHILDREN )
             result->addChild(geode);
             
             // Consolidate all the drawables in the geode.
-            MeshConsolidator::run(*geode);
+            if (geode->getNumDrawables() > 1)
+                jobs->_geodes.push_back(geode);
         }
 
+        jobs->run(jobs->_geodes.size() > 1 ? getFlattenService() : 0L);
+
+        // a helper task may still hold the jobs; don't leave our geodes in it.
+        jobs->_geodes.clear();
+
         if (_mergeGeometry)
         {
             // Run MERGE_GEOMETRY so that it will merge all the primitive sets
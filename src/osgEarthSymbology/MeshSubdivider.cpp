@@ -19,11 +19,15 @@
 #include <osgEarthSymbology/MeshSubdivider>
 #include <osgEarth/LineFunctor>
 #include <osgEarth/GeoMath>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
+#include <osgEarth/Registry>
 #include <osg/TriangleFunctor>
 #include <osg/TriangleIndexFunctor>
 #include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <queue>
-#include <map>
 #include <algorithm>
 #include <iterator>
 
@@ -119,6 +123,119 @@ namespace
 
     //--------------------------------------------------------------------
 
+    /**
+     * Open-addressed hash table mapping keys to vertex indices. The vertex
+     * and edge lookups happen once or more per triangle, and a tree map
+     * made them the bulk of the subdivision time on large meshes.
+     * Entries are never removed.
+     */
+    template<typename K, typename HASH>
+    class IndexTable
+    {
+    public:
+        IndexTable() : _count(0u) { _slots.resize(64u); }
+
+        //! Makes room for n entries without rehashing
+        void reserve(unsigned n)
+        {
+            unsigned capacity = _slots.size();
+            while (capacity < 2u*n)
+                capacity *= 2u;
+            if (capacity > _slots.size())
+                rehash(capacity);
+        }
+
+        //! Returns the index stored for the key; if there isn't one, stores
+        //! and returns "index" and sets "inserted".
+        GLuint findOrInsert(const K& key, GLuint index, bool& inserted)
+        {
+            if (2u*(_count+1u) > _slots.size())
+                rehash(2u*_slots.size());
+
+            unsigned mask = _slots.size()-1u;
+            for (unsigned s = _hash(key) & mask; ; s = (s+1u) & mask)
+            {
+                Slot& slot = _slots[s];
+                if (!slot._used)
+                {
+                    slot._key = key;
+                    slot._index = index;
+                    slot._used = true;
+                    ++_count;
+                    inserted = true;
+                    return index;
+                }
+                if (slot._key == key)
+                {
+                    inserted = false;
+                    return slot._index;
+                }
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            Slot() : _index(0u), _used(false) { }
+            K      _key;
+            GLuint _index;
+            bool   _used;
+        };
+
+        void rehash(unsigned capacity)
+        {
+            std::vector<Slot> old;
+            old.swap(_slots);
+            _slots.resize(capacity);
+            unsigned mask = capacity-1u;
+            for (unsigned i = 0; i < old.size(); ++i)
+            {
+                if (old[i]._used)
+                {
+                    unsigned s = _hash(old[i]._key) & mask;
+                    while (_slots[s]._used)
+                        s = (s+1u) & mask;
+                    _slots[s] = old[i];
+                }
+            }
+        }
+
+        std::vector<Slot> _slots;
+        unsigned          _count;
+        HASH              _hash;
+    };
+
+    inline unsigned mixHash(unsigned h)
+    {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    struct Vec3Hash
+    {
+        unsigned operator()(const osg::Vec3& v) const
+        {
+            unsigned h = 0u;
+            for (int i = 0; i < 3; ++i)
+            {
+                // adding 0 turns -0 into +0, which compare equal.
+                float f = v[i] + 0.0f;
+                unsigned bits;
+                ::memcpy(&bits, &f, sizeof(bits));
+                h = mixHash(h ^ bits);
+            }
+            return h;
+        }
+    };
+
+    typedef IndexTable<osg::Vec3, Vec3Hash> VertMap;
+
+    //--------------------------------------------------------------------
+
     struct Triangle
     {
         Triangle() { }
@@ -133,7 +250,6 @@ namespace
 
     struct TriangleData
     {
-        typedef std::map<osg::Vec3,GLuint> VertMap;        
         VertMap _vertMap;
         osg::Vec3Array* _sourceVerts;
         osg::Vec4Array* _sourceColors;
@@ -154,9 +270,17 @@ namespace
             _sourceNormals   = 0;
         }       
 
+        // number of output vertices to reserve space for
+        unsigned numSourceVerts() const
+        {
+            return _sourceVerts ? 2u * _sourceVerts->size() : 0u;
+        }
+
         void setSourceVerts(osg::Vec3Array* sourceVerts )
         {
             _sourceVerts = sourceVerts;
+            _verts->reserve( numSourceVerts() );
+            _vertMap.reserve( numSourceVerts() );
         }
 
         void setSourceColors(osg::Vec4Array* sourceColors)
@@ -165,6 +289,7 @@ namespace
             {
                 _sourceColors = sourceColors;
                 _colors       = new osg::Vec4Array();
+                _colors->reserve( numSourceVerts() );
             }
         }
 
@@ -174,6 +299,7 @@ namespace
             {
                 _sourceTexCoords = sourceTexCoords;
                 _texcoords       = new osg::Vec2Array();
+                _texcoords->reserve( numSourceVerts() );
             }
         }
 
@@ -183,17 +309,17 @@ namespace
             {
                 _sourceNormals = sourceNormals;
                 _normals       = new osg::Vec3Array();
+                _normals->reserve( numSourceVerts() );
             }
         }
 
         GLuint record( const osg::Vec3& v, const osg::Vec2f& t, const osg::Vec4f& c, const osg::Vec3& n )
         {
-            VertMap::iterator i = _vertMap.find(v);
-            if ( i == _vertMap.end() )
+            bool inserted;
+            GLuint index = _vertMap.findOrInsert(v, _verts->size(), inserted);
+            if ( inserted )
             {
-                GLuint index = _verts->size();
-                _verts->push_back(v);                
-                _vertMap[v] = index;
+                _verts->push_back(v);
                 //Only push back the texture coordinate if it's valid
                 if (_texcoords)
                 {
@@ -207,12 +333,8 @@ namespace
                 {
                     _normals->push_back( n );
                 }
-                return index;
-            }
-            else
-            {
-                return i->second;
             }
+            return index;
         }
        
 
@@ -266,7 +388,15 @@ namespace
         bool operator == (const Edge& rhs) const { return _i0==rhs._i0 && _i1==rhs._i1; }
     };
 
-    typedef std::map<Edge,GLuint> EdgeMap;
+    struct EdgeHash
+    {
+        unsigned operator()(const Edge& e) const
+        {
+            return mixHash(e._i0 ^ mixHash(e._i1));
+        }
+    };
+
+    typedef IndexTable<Edge,EdgeHash> EdgeMap;
     
     /**
      * Populates the geometry object with a collection of index elements primitives.
@@ -362,7 +492,6 @@ namespace
 
     struct LineData
     {
-        typedef std::map<osg::Vec3,GLuint> VertMap;        
         VertMap _vertMap;
         osg::Vec3Array* _sourceVerts;
         osg::Vec4Array* _sourceColors;
@@ -382,9 +511,17 @@ namespace
             _sourceTexCoords = 0;
         }       
 
+        // number of output vertices to reserve space for
+        unsigned numSourceVerts() const
+        {
+            return _sourceVerts ? 2u * _sourceVerts->size() : 0u;
+        }
+
         void setSourceVerts(osg::Vec3Array* sourceVerts )
         {
             _sourceVerts = sourceVerts;
+            _verts->reserve( numSourceVerts() );
+            _vertMap.reserve( numSourceVerts() );
         }
 
         void setSourceColors(osg::Vec4Array* sourceColors )
@@ -393,6 +530,7 @@ namespace
             {
                 _sourceColors = sourceColors;
                 _colors       = new osg::Vec4Array();
+                _colors->reserve( numSourceVerts() );
             }
         }
 
@@ -402,17 +540,17 @@ namespace
             {
                 _sourceTexCoords = sourceTexCoords;
                 _texcoords       = new osg::Vec2Array();
+                _texcoords->reserve( numSourceVerts() );
             }
         }
 
         GLuint record( const osg::Vec3& v, const osg::Vec2f& t, const osg::Vec4f& c )
         {
-            VertMap::iterator i = _vertMap.find(v);
-            if ( i == _vertMap.end() )
+            bool inserted;
+            GLuint index = _vertMap.findOrInsert(v, _verts->size(), inserted);
+            if ( inserted )
             {
-                GLuint index = _verts->size();
-                _verts->push_back(v);                
-                _vertMap[v] = index;
+                _verts->push_back(v);
                 if (_texcoords)
                 {
                     _texcoords->push_back( t );
@@ -421,12 +559,8 @@ namespace
                 {
                     _colors->push_back( c );
                 }
-                return index;
-            }
-            else
-            {
-                return i->second;
             }
+            return index;
         }
        
 
@@ -696,6 +830,7 @@ namespace
 
         // Used to make sure shared edges are not split more than once.
         EdgeMap edges;
+        edges.reserve( data._tris.size() );
 
         // Subdivide triangles until we run out
         while( data._tris.size() > 0 )
@@ -742,9 +877,9 @@ namespace
                 {
                     Edge edge( osg::minimum(tri._i0, tri._i1), osg::maximum(tri._i0, tri._i1) );
                     
-                    EdgeMap::iterator ei = edges.find(edge);
-                    GLuint i;
-                    if ( ei == edges.end() )
+                    bool split;
+                    GLuint i = edges.findOrInsert(edge, data._verts->size(), split);
+                    if ( split )
                     {
                         data._verts->push_back( geocentricMidpoint(v0_w, v1_w, interp) * W2L );
                         if ( data._colors.valid() )
@@ -753,12 +888,6 @@ namespace
                             data._texcoords->push_back( (t0 + t1) / 2.0f );
                         if ( data._normals.valid() )
                             data._normals->push_back( (n0 + n1) / 2.0f );
-                        i = data._verts->size() - 1;
-                        edges[edge] = i;
-                    }
-                    else
-                    {
-                        i = ei->second;
                     }
 
                     data._tris.push( Triangle(tri._i0, i, tri._i2) );
@@ -768,9 +897,9 @@ namespace
                 {
                     Edge edge( osg::minimum(tri._i1, tri._i2), osg::maximum(tri._i1,tri._i2) );
 
-                    EdgeMap::iterator ei = edges.find(edge);
-                    GLuint i;
-                    if ( ei == edges.end() )
+                    bool split;
+                    GLuint i = edges.findOrInsert(edge, data._verts->size(), split);
+                    if ( split )
                     {
                         data._verts->push_back( geocentricMidpoint(v1_w, v2_w, interp) * W2L );
                         if ( data._colors.valid() )
@@ -779,12 +908,6 @@ namespace
                             data._texcoords->push_back( (t1 + t2) / 2.0f );
                         if ( data._normals.valid() )
                             data._normals->push_back( (n1 + n2) / 2.0f );
-                        i = data._verts->size() - 1;
-                        edges[edge] = i;
-                    }
-                    else
-                    {
-                        i = ei->second;
                     }
 
                     data._tris.push( Triangle(tri._i1, i, tri._i0) );
@@ -794,9 +917,9 @@ namespace
                 {
                     Edge edge( osg::minimum(tri._i2, tri._i0), osg::maximum(tri._i2,tri._i0) );
 
-                    EdgeMap::iterator ei = edges.find(edge);
-                    GLuint i;
-                    if ( ei == edges.end() )
+                    bool split;
+                    GLuint i = edges.findOrInsert(edge, data._verts->size(), split);
+                    if ( split )
                     {
                         data._verts->push_back( geocentricMidpoint(v2_w, v0_w, interp) * W2L );
                         if ( data._colors.valid() )
@@ -805,12 +928,6 @@ namespace
                             data._texcoords->push_back( (t2 + t0) / 2.0f );
                         if ( data._normals.valid() )
                             data._normals->push_back( (n2 + n0) / 2.0f );
-                        i = data._verts->size() - 1;
-                        edges[edge] = i;
-                    }
-                    else
-                    {
-                        i = ei->second;
                     }
 
                     data._tris.push( Triangle(tri._i2, i, tri._i1) );
@@ -878,6 +995,46 @@ namespace
             subdivideTriangles( granularity, interp, geom, W2L, L2W, maxElementsPerEBO );
         }
     }
+
+    // Subdivisions share the registry's thread budget under this UID.
+    TaskService* getSubdivisionService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    // Below this many input vertices in total, subdivide on the calling thread.
+    const unsigned s_minParallelVerts = 10000u;
+
+    /**
+     * Geometries to subdivide in parallel; each geometry is only touched
+     * by one thread.
+     */
+    struct SubdivideJobs : public ParallelJobs
+    {
+        std::vector<osg::Geometry*> _geoms;
+        double                      _granularity;
+        GeoInterpolation            _interp;
+        osg::Matrixd                _world2local, _local2world;
+        unsigned                    _maxElementsPerEBO;
+
+        void runJob(unsigned i)
+        {
+            subdivide( _granularity, _interp, *_geoms[i], _world2local, _local2world, _maxElementsPerEBO );
+        }
+
+        void run(TaskService* service)
+        {
+            ParallelJobs::run(_geoms.size(), service);
+        }
+    };
+
+    // whether the subdivider can process this geometry
+    bool canSubdivide(const osg::Geometry& geom)
+    {
+        // vertex attribute arrays are unsupported for now. NYI.
+        return geom.getNumPrimitiveSets() > 0 && geom.getVertexAttribArrayList().size() == 0;
+    }
 }
 
 //------------------------------------------------------------------------
@@ -897,12 +1054,38 @@ _maxElementsPerEBO( INT_MAX )
 void
 MeshSubdivider::run(osg::Geometry& geom, double granularity, GeoInterpolation interp)
 {
-    if ( geom.getNumPrimitiveSets() < 1 )
-        return;
-
-    // unsupported for now. NYI.
-    if ( geom.getVertexAttribArrayList().size() > 0 )
+    if ( !canSubdivide(geom) )
         return;
 
     subdivide( granularity, interp, geom, _world2local, _local2world, _maxElementsPerEBO );
 }
+
+void
+MeshSubdivider::run(const std::vector<osg::Geometry*>& geoms, double granularity, GeoInterpolation interp)
+{
+    osg::ref_ptr<SubdivideJobs> jobs = new SubdivideJobs();
+    jobs->_granularity       = granularity;
+    jobs->_interp            = interp;
+    jobs->_world2local       = _world2local;
+    jobs->_local2world       = _local2world;
+    jobs->_maxElementsPerEBO = _maxElementsPerEBO;
+    jobs->_geoms.reserve( geoms.size() );
+
+    unsigned totalVerts = 0u;
+    for( std::vector<osg::Geometry*>::const_iterator i = geoms.begin(); i != geoms.end(); ++i )
+    {
+        if ( *i && canSubdivide(**i) )
+        {
+            jobs->_geoms.push_back( *i );
+            if ( (*i)->getVertexArray() )
+                totalVerts += (*i)->getVertexArray()->getNumElements();
+        }
+    }
+
+    // small batches are not worth the hand-off.
+    bool parallel = jobs->_geoms.size() > 1 && totalVerts >= s_minParallelVerts;
+    jobs->run( parallel ? getSubdivisionService() : 0L );
+
+    // a helper task may still hold the jobs; don't leave our geometry in it.
+    jobs->_geoms.clear();
+}
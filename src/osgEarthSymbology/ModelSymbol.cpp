@@ -39,7 +39,8 @@ _maxSizeX(rhs._maxSizeX),
 _maxSizeY(rhs._maxSizeY),
 _scaleX( rhs._scaleX ),
 _scaleY( rhs._scaleY ),
-_scaleZ( rhs._scaleZ )
+_scaleZ( rhs._scaleZ ),
+_impostorRange( rhs._impostorRange )
 {
     // nop
 }
@@ -56,7 +57,8 @@ _maxSizeX ( FLT_MAX ),
 _maxSizeY ( FLT_MAX ),
 _scaleX    ( NumericExpression(1.0) ),
 _scaleY    ( NumericExpression(1.0) ),
-_scaleZ    ( NumericExpression(1.0) )
+_scaleZ    ( NumericExpression(1.0) ),
+_impostorRange( FLT_MAX )
 {
     mergeConfig( conf );
 }
@@ -83,6 +85,8 @@ ModelSymbol::getConfig() const
     conf.addObjIfSet( "scale_y", _scaleY );
     conf.addObjIfSet( "scale_z", _scaleZ );
 
+    conf.addIfSet( "impostor_range", _impostorRange );
+
     conf.addNonSerializable( "ModelSymbol::node", _node.get() );
     return conf;
 }
@@ -107,6 +111,8 @@ ModelSymbol::mergeConfig( const Config& conf )
     conf.getObjIfSet( "scale_y", _scaleY );
     conf.getObjIfSet( "scale_z", _scaleZ );
 
+    conf.getIfSet( "impostor_range", _impostorRange );
+
     _node = conf.getNonSerializable<osg::Node>( "ModelSymbol::node" );
 }
 
@@ -178,5 +184,8 @@ ModelSymbol::parseSLD(const Config& c, Style& style)
     else if ( match(c.key(), "model-max-size-y") ) {
         style.getOrCreate<ModelSymbol>()->maxSizeY() = as<float>(c.value(), FLT_MAX);
     }
+    else if ( match(c.key(), "model-impostor-range") ) {
+        style.getOrCreate<ModelSymbol>()->impostorRange() = as<float>(c.value(), FLT_MAX);
+    }
 }
 
@@ -17,15 +17,153 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthSymbology/ResourceCache>
+#include <osgEarth/Utils>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/Registry>
+#include <osgEarth/Capabilities>
+#include <osgEarth/Memory>
 #include <osg/Texture2D>
+#include <osg/Texture2DArray>
+#include <osg/BlendFunc>
+#include <osg/Geode>
+#include <osg/NodeVisitor>
+#include <osg/DisplaySettings>
+#include <algorithm>
+
+#define LC "[ResourceCache] "
 
 using namespace osgEarth;
 using namespace osgEarth::Symbology;
 
+namespace
+{
+    // Keeps the images of every texture in a graph after they're applied,
+    // for textures that many clones share across graphics contexts.
+    struct KeepTextureImagesVisitor : public osg::NodeVisitor
+    {
+        KeepTextureImagesVisitor() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) { }
+
+        void applyStateSet(osg::StateSet* ss)
+        {
+            if ( !ss ) return;
+            const osg::StateSet::TextureAttributeList& tal = ss->getTextureAttributeList();
+            for(unsigned unit=0; unit<tal.size(); ++unit)
+            {
+                osg::Texture* tex = dynamic_cast<osg::Texture*>(ss->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+                if ( tex )
+                    tex->setUnRefImageDataAfterApply( false );
+            }
+        }
+
+        void apply(osg::Node& node)
+        {
+            applyStateSet( node.getStateSet() );
+            traverse( node );
+        }
+
+        void apply(osg::Geode& geode)
+        {
+            applyStateSet( geode.getStateSet() );
+            for(unsigned i=0; i<geode.getNumDrawables(); ++i)
+                applyStateSet( geode.getDrawable(i)->getStateSet() );
+        }
+    };
+
+    // Layers per texture array; the least that any GL3 implementation supports.
+    const unsigned MAX_LAYERS_PER_ARRAY = 256u;
+
+    // Where packTextureArrays put each image.
+    struct Packing
+    {
+        std::vector<unsigned> _array;
+        std::vector<unsigned> _layer;
+        std::vector<osg::ref_ptr<osg::Texture2DArray> > _textures;
+        std::vector<bool> _hasAlpha;
+    };
+
+    // Packs images into texture arrays, one image per layer. Images are grouped by
+    // size (rounded up to a power of two) so that small icons don't get blown up to
+    // the size of the largest one, and each group is split into arrays of at most
+    // MAX_LAYERS_PER_ARRAY layers.
+    void packTextureArrays(const std::vector<osg::ref_ptr<osg::Image> >& images,
+                           bool                                          repeat,
+                           Packing&                                      out)
+    {
+        unsigned maxSize = (unsigned)std::max(Registry::capabilities().getMaxTextureSize(), 1);
+
+        out._array.resize( images.size() );
+        out._layer.resize( images.size() );
+
+        // layer size => images of that size
+        typedef std::map<unsigned, std::vector<unsigned> > Groups;
+        Groups groups;
+        for(unsigned i=0; i<images.size(); ++i)
+        {
+            unsigned size = 1u;
+            while( size < (unsigned)std::max(images[i]->s(), images[i]->t()) && size < maxSize )
+                size <<= 1;
+            groups[size].push_back( i );
+        }
+
+        for(Groups::const_iterator g = groups.begin(); g != groups.end(); ++g)
+        {
+            unsigned size = g->first;
+            const std::vector<unsigned>& members = g->second;
+
+            for(unsigned first = 0; first < members.size(); first += MAX_LAYERS_PER_ARRAY)
+            {
+                unsigned count = std::min((unsigned)members.size() - first, MAX_LAYERS_PER_ARRAY);
+
+                osg::Texture2DArray* tex = new osg::Texture2DArray();
+                tex->setTextureSize( size, size, count );
+                tex->setInternalFormat( GL_RGBA8 );
+                tex->setSourceFormat( GL_RGBA );
+                tex->setSourceType( GL_UNSIGNED_BYTE );
+                tex->setFilter( osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR );
+                tex->setFilter( osg::Texture::MAG_FILTER, osg::Texture::LINEAR );
+                tex->setWrap( osg::Texture::WRAP_S, repeat ? osg::Texture::REPEAT : osg::Texture::CLAMP_TO_EDGE );
+                tex->setWrap( osg::Texture::WRAP_T, repeat ? osg::Texture::REPEAT : osg::Texture::CLAMP_TO_EDGE );
+                tex->setResizeNonPowerOfTwoHint( false );
+
+                // shared by every tile using the library, so keep the images around.
+                tex->setUnRefImageDataAfterApply( false );
+
+                bool hasAlpha = false;
+                unsigned arrayIndex = out._textures.size();
+
+                for(unsigned layer = 0; layer < count; ++layer)
+                {
+                    unsigned i = members[first + layer];
+                    const osg::Image* input = images[i].get();
+
+                    hasAlpha = hasAlpha || ImageUtils::hasAlphaChannel( input );
+
+                    osg::ref_ptr<osg::Image> image = ImageUtils::convertToRGBA8( input );
+                    if ( image->s() != (int)size || image->t() != (int)size )
+                    {
+                        osg::ref_ptr<osg::Image> resized;
+                        if ( ImageUtils::resizeImage(image.get(), size, size, resized) )
+                            image = resized.get();
+                    }
+
+                    tex->setImage( layer, image.get() );
+
+                    out._array[i] = arrayIndex;
+                    out._layer[i] = layer;
+                }
+
+                out._textures.push_back( tex );
+                out._hasAlpha.push_back( hasAlpha );
+            }
+        }
+    }
+}
+
 
 // internal thread-safety not required since we mutex it in this object.
 ResourceCache::ResourceCache() : // const osgDB::Options* dbOptions ) :
 //_dbOptions    ( dbOptions ),
+_keepTextureImages( false ),
 _skinCache    ( false ),
 _instanceCache( false ),
 _resourceLibraryCache( false )
@@ -36,14 +174,35 @@ _resourceLibraryCache( false )
 bool
 ResourceCache::getOrCreateLineTexture(const URI& uri, osg::ref_ptr<osg::Texture>& output, const osgDB::Options* readOptions)
 {
-    Threading::ScopedMutexLock lock(_texMutex);
-    TextureCache::Record rec;
-    if (_texCache.get(uri.full(), rec) && rec.value().valid())
+    output = 0L;
+    std::string key = uri.full();
+
+    // the lock only covers the lookup (the LRU reorders itself on a hit).
     {
-        output = rec.value().get();
+        Threading::ScopedMutexLock lock(_texMutex);
+        TextureCache::Record rec;
+        if (_texCache.get(key, rec) && rec.value().valid())
+        {
+            output = rec.value().get();
+            return true;
+        }
     }
-    else
+
+    // one thread loads it; others asking for the same URI wait for that result.
+    TextureFlights::Scope flight(_texFlights, key, output);
+    if (flight.isLeader())
     {
+        // double check; it may have landed in the cache since we looked
+        {
+            Threading::ScopedMutexLock lock(_texMutex);
+            TextureCache::Record rec;
+            if (_texCache.get(key, rec) && rec.value().valid())
+            {
+                output = rec.value().get();
+                return true;
+            }
+        }
+
         osg::ref_ptr<osg::Image> image = uri.getImage(readOptions);
         if (image.valid())
         {
@@ -55,7 +214,10 @@ ResourceCache::getOrCreateLineTexture(const URI& uri, osg::ref_ptr<osg::Texture>
             tex->setMaxAnisotropy( 4.0f );
             tex->setResizeNonPowerOfTwoHint( false );
             output = tex;
-            _texCache.insert(uri.full(), output.get());
+            Memory::charge( Memory::RESOURCE_CACHE, tex, Memory::estimateSize(tex) );
+
+            Threading::ScopedMutexLock lock(_texMutex);
+            _texCache.insert(key, output.get());
         }
     }
 
@@ -76,63 +238,121 @@ ResourceCache::getOrCreateStateSet(SkinResource*                skin,
     // were to provide a unique key.
     std::string key = skin->getUniqueID();
 
-    // exclusive lock (since it's an LRU)
+    // the lock only covers the lookup (the LRU reorders itself on a hit).
     {
         Threading::ScopedMutexLock exclusive( _skinMutex );
-            
-        // double check to avoid race condition
         SkinCache::Record rec;       
         if ( _skinCache.get(key, rec) && rec.value().valid() )
         {
             output = rec.value().get();
+            return true;
         }
-        else
+    }
+
+    // not there; one thread makes it while any others wanting the same skin
+    // wait for that result.
+    SkinFlights::Scope flight( _skinFlights, key, output );
+    if ( flight.isLeader() )
+    {
+        // double check to avoid race condition
         {
-            // still not there, make it.
-            output = skin->createStateSet(readOptions);
-            if ( output.valid() )
+            Threading::ScopedMutexLock exclusive( _skinMutex );
+            SkinCache::Record rec;
+            if ( _skinCache.get(key, rec) && rec.value().valid() )
             {
-                _skinCache.insert( key, output.get() );
+                output = rec.value().get();
+                return true;
             }
         }
+
+        output = skin->createStateSet(readOptions);
+        if ( output.valid() )
+        {
+            Memory::charge( Memory::RESOURCE_CACHE, output.get(), Memory::estimateSize(output.get()) );
+
+            Threading::ScopedMutexLock exclusive( _skinMutex );
+            _skinCache.insert( key, output.get() );
+        }
     }
 
     return output.valid();
 }
 
-
 bool
-ResourceCache::getOrCreateInstanceNode(InstanceResource*        res,
-                                       osg::ref_ptr<osg::Node>& output,
-                                       const osgDB::Options*    readOptions)
+ResourceCache::getOrCreateCachedInstance(const std::string&       key,
+                                         InstanceResource*        res,
+                                         bool                     shared,
+                                         osg::ref_ptr<osg::Node>& output,
+                                         const osgDB::Options*    readOptions)
 {
     output = 0L;
-    std::string key = res->getConfig().toJSON(false);
 
-    // exclusive lock (since it's an LRU)
+    // the lock only covers the lookup (the LRU reorders itself on a hit).
     {
         Threading::ScopedMutexLock exclusive( _instanceMutex );
-
-        // double check to avoid race condition
         InstanceCache::Record rec;
         if ( _instanceCache.get(key, rec) && rec.value().valid() )
         {
             output = rec.value().get();
+            return true;
+        }
+    }
+
+    // Not there. Only one thread loads a given model; any other tiles asking
+    // for it meanwhile wait and then share the same copy.
+    InstanceFlights::Scope flight( _instanceFlights, key, output );
+    if ( flight.isLeader() )
+    {
+        // double check to avoid race condition
+        {
+            Threading::ScopedMutexLock exclusive( _instanceMutex );
+            InstanceCache::Record rec;
+            if ( _instanceCache.get(key, rec) && rec.value().valid() )
+            {
+                output = rec.value().get();
+                return true;
+            }
         }
-        else
+
+        output = res->createNode(readOptions);
+        if ( output.valid() )
         {
-            // still not there, make it.
-            output = res->createNode(readOptions);
-            if ( output.valid() )
+            if ( shared )
+            {
+                // This copy is never placed in the scene graph; set up its buffer
+                // objects now so the clones share them (and don't each try to assign
+                // them to the shared arrays later on).
+                AllocateAndMergeBufferObjectsVisitor vbos;
+                output->accept( vbos );
+            }
+
+            // Every clone references this copy's textures, so with several graphics
+            // contexts they have to keep their images for whichever applies them later.
+            if ( _keepTextureImages || osg::DisplaySettings::instance()->getMaxNumberOfGraphicsContexts() > 1u )
             {
-                _instanceCache.insert( key, output.get() );
+                KeepTextureImagesVisitor keepImages;
+                output->accept( keepImages );
             }
+
+            Memory::charge( Memory::RESOURCE_CACHE, output.get(), Memory::estimateSize(output.get()) );
+
+            Threading::ScopedMutexLock exclusive( _instanceMutex );
+            _instanceCache.insert( key, output.get() );
         }
     }
 
     return output.valid();
 }
 
+bool
+ResourceCache::getOrCreateInstanceNode(InstanceResource*        res,
+                                       osg::ref_ptr<osg::Node>& output,
+                                       const osgDB::Options*    readOptions)
+{
+    std::string key = res->getConfig().toJSON(false);
+    return getOrCreateCachedInstance( key, res, false, output, readOptions );
+}
+
 bool
 ResourceCache::cloneOrCreateInstanceNode(InstanceResource*        res,
                                          osg::ref_ptr<osg::Node>& output,
@@ -141,30 +361,223 @@ ResourceCache::cloneOrCreateInstanceNode(InstanceResource*        res,
     output = 0L;
     std::string key = res->getConfig().toJSON(false);
 
-    // exclusive lock (since it's an LRU)
+    osg::ref_ptr<osg::Node> cached;
+    if ( getOrCreateCachedInstance(key, res, false, cached, readOptions) )
     {
-        Threading::ScopedMutexLock exclusive( _instanceMutex );
-
         // Deep copy everything except for images.  Some models may share imagery so we only want one copy of it at a time.
         osg::CopyOp copyOp = osg::CopyOp::DEEP_COPY_ALL & ~osg::CopyOp::DEEP_COPY_IMAGES & ~osg::CopyOp::DEEP_COPY_TEXTURES;
+        output = osg::clone(cached.get(), copyOp);
+    }
 
-        // double check to avoid race condition
-        InstanceCache::Record rec;
-        if ( _instanceCache.get(key, rec) && rec.value().valid() )
+    return output.valid();
+}
+
+bool
+ResourceCache::cloneOrCreateSharedInstanceNode(InstanceResource*        res,
+                                               osg::ref_ptr<osg::Node>& output,
+                                               const osgDB::Options*    readOptions)
+{
+    output = 0L;
+    std::string key = "shared:" + res->getConfig().toJSON(false);
+
+    osg::ref_ptr<osg::Node> cached;
+    if ( getOrCreateCachedInstance(key, res, true, cached, readOptions) )
+    {
+        // Copy everything but the vertex data (and images). Primitive sets are copied
+        // since draw-instancing sets the instance count on them.
+        osg::CopyOp copyOp = osg::CopyOp::DEEP_COPY_ALL & ~osg::CopyOp::DEEP_COPY_IMAGES & ~osg::CopyOp::DEEP_COPY_TEXTURES & ~osg::CopyOp::DEEP_COPY_ARRAYS;
+        output = osg::clone(cached.get(), copyOp);
+    }
+
+    return output.valid();
+}
+
+bool
+ResourceCache::getOrCreateTextureArrays(ResourceLibrary*              library,
+                                        osg::ref_ptr<TextureArrays>&  output,
+                                        const osgDB::Options*         readOptions)
+{
+    output = 0L;
+    if ( !library )
+        return false;
+
+    const std::string& key = library->getName();
+
+    // the lock only covers the lookup (the LRU reorders itself on a hit).
+    {
+        Threading::ScopedMutexLock exclusive( _resourceLibraryMutex );
+        ResourceLibraryCache::Record rec;
+        if ( _resourceLibraryCache.get(key, rec) && rec.value().valid() )
+        {
+            output = rec.value().get();
+            return true;
+        }
+    }
+
+    // building the arrays loads every image in the library, so make sure
+    // only one thread does it.
+    TextureArraysFlights::Scope flight( _resourceLibraryFlights, key, output );
+    if ( !flight.isLeader() )
+        return output.valid();
+
+    // double check to avoid race condition
+    {
+        Threading::ScopedMutexLock exclusive( _resourceLibraryMutex );
+        ResourceLibraryCache::Record rec;
+        if ( _resourceLibraryCache.get(key, rec) && rec.value().valid() )
         {
-            output = osg::clone(rec.value().get(), copyOp);
+            output = rec.value().get();
+            return true;
         }
-        else
+    }
+
+    output = new TextureArrays();
+
+    // Skins. Leave out the ones that can't share a texture with the others.
+    {
+        SkinResourceVector skins;
+        library->getSkins( skins, readOptions );
+
+        std::vector<std::string> keys;
+        std::vector<osg::ref_ptr<osg::Image> > images;
+
+        for(SkinResourceVector::const_iterator i = skins.begin(); i != skins.end(); ++i)
         {
-            // still not there, make it.
-            output = res->createNode(readOptions);
-            if ( output.valid() )
+            const SkinResource* skin = i->get();
+            if ( skin->atlasHint() == false || skin->texEnvMode().isSet() || skin->imageLayer().isSet() )
+                continue;
+
+            osg::ref_ptr<osg::Image> image = skin->createImage( readOptions );
+            if ( image.valid() && image->r() == 1 )
             {
-                _instanceCache.insert( key, output.get() );
-                output = osg::clone(output.get(), copyOp);
+                keys.push_back( skin->getUniqueID() );
+                images.push_back( image.get() );
             }
         }
+
+        Packing packing;
+        packTextureArrays( images, true, packing );
+
+        for(unsigned a=0; a<packing._textures.size(); ++a)
+        {
+            osg::StateSet* stateSet = new osg::StateSet();
+            stateSet->setTextureAttributeAndModes( 0, packing._textures[a].get(), osg::StateAttribute::ON );
+            if ( packing._hasAlpha[a] )
+            {
+                stateSet->setAttributeAndModes( new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA), osg::StateAttribute::ON );
+                stateSet->setRenderingHint( osg::StateSet::TRANSPARENT_BIN );
+            }
+            output->_skinStateSets.push_back( stateSet );
+        }
+
+        for(unsigned i=0; i<keys.size(); ++i)
+        {
+            TextureArrays::Entry& e = output->_skins[keys[i]];
+            e._array  = packing._array[i];
+            e._layer  = packing._layer[i];
+            e._width  = (float)images[i]->s();
+            e._height = (float)images[i]->t();
+            e._flip   = images[i]->getOrigin() == osg::Image::TOP_LEFT;
+        }
+    }
+
+    // Icons.
+    {
+        IconResourceVector icons;
+        library->getIcons( icons, readOptions );
+
+        std::vector<std::string> keys;
+        std::vector<osg::ref_ptr<osg::Image> > images;
+
+        for(IconResourceVector::const_iterator i = icons.begin(); i != icons.end(); ++i)
+        {
+            const IconResource* icon = i->get();
+            if ( !icon->uri().isSet() )
+                continue;
+
+            ReadResult r = icon->uri()->readImage( readOptions );
+            if ( r.succeeded() && r.getImage() && r.getImage()->r() == 1 )
+            {
+                keys.push_back( icon->uri()->full() );
+                images.push_back( r.getImage() );
+            }
+        }
+
+        Packing packing;
+        packTextureArrays( images, false, packing );
+
+        for(unsigned a=0; a<packing._textures.size(); ++a)
+        {
+            output->_iconStateSets.push_back( IconResource::createTextureArrayStateSet(packing._textures[a].get()) );
+        }
+
+        for(unsigned i=0; i<keys.size(); ++i)
+        {
+            TextureArrays::Entry& e = output->_icons[keys[i]];
+            e._array  = packing._array[i];
+            e._layer  = packing._layer[i];
+            e._width  = (float)images[i]->s();
+            e._height = (float)images[i]->t();
+            e._flip   = images[i]->getOrigin() == osg::Image::TOP_LEFT;
+        }
     }
 
+    OE_INFO << LC << "Library \"" << library->getName() << "\": "
+        << output->_skins.size() << " skins in " << output->_skinStateSets.size() << " texture array(s), "
+        << output->_icons.size() << " icons in " << output->_iconStateSets.size() << " texture array(s)"
+        << std::endl;
+
+    unsigned bytes = 0u;
+    for(unsigned i=0; i<output->_skinStateSets.size(); ++i)
+        bytes += Memory::estimateSize( output->_skinStateSets[i].get() );
+    for(unsigned i=0; i<output->_iconStateSets.size(); ++i)
+        bytes += Memory::estimateSize( output->_iconStateSets[i].get() );
+    Memory::charge( Memory::RESOURCE_CACHE, output.get(), bytes );
+
+    Threading::ScopedMutexLock exclusive( _resourceLibraryMutex );
+    _resourceLibraryCache.insert( key, output.get() );
+    return true;
+}
+
+bool
+ResourceCache::getOrCreateStateSet(ResourceLibrary*             library,
+                                   const SkinResource*          skin,
+                                   osg::ref_ptr<osg::StateSet>& output,
+                                   unsigned&                    out_layer,
+                                   const osgDB::Options*        readOptions)
+{
+    output = 0L;
+
+    osg::ref_ptr<TextureArrays> arrays;
+    if ( !skin || !getOrCreateTextureArrays(library, arrays, readOptions) )
+        return false;
+
+    TextureArrays::Entries::const_iterator i = arrays->_skins.find( skin->getUniqueID() );
+    if ( i == arrays->_skins.end() )
+        return false;
+
+    output    = arrays->_skinStateSets[i->second._array].get();
+    out_layer = i->second._layer;
+    return true;
+}
+
+bool
+ResourceCache::getOrCreateTextureArrayIconNode(ResourceLibrary*          library,
+                                               const IconResource*       icon,
+                                               osg::ref_ptr<osg::Node>&  output,
+                                               const osgDB::Options*     readOptions)
+{
+    output = 0L;
+
+    osg::ref_ptr<TextureArrays> arrays;
+    if ( !icon || !icon->uri().isSet() || !getOrCreateTextureArrays(library, arrays, readOptions) )
+        return false;
+
+    TextureArrays::Entries::const_iterator i = arrays->_icons.find( icon->uri()->full() );
+    if ( i == arrays->_icons.end() )
+        return false;
+
+    const TextureArrays::Entry& e = i->second;
+    output = icon->createNodeFromTextureArray( arrays->_iconStateSets[e._array].get(), e._layer, e._width, e._height, e._flip );
     return output.valid();
 }
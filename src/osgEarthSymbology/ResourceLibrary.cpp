@@ -369,6 +369,17 @@ ResourceLibrary::getModels( ModelResourceVector& output, const osgDB::Options* d
     }
 }
 
+void
+ResourceLibrary::getIcons( IconResourceVector& output, const osgDB::Options* dbOptions ) const
+{
+    const_cast<ResourceLibrary*>(this)->initialize( dbOptions );
+    Threading::ScopedReadLock shared( _mutex );
+    for( ResourceMap<InstanceResource>::const_iterator i = _instances.begin(); i != _instances.end(); ++i ) {
+        IconResource* icon = dynamic_cast<IconResource*>(i->second.get());
+        if ( icon ) output.push_back( icon );
+    }
+}
+
 void
 ResourceLibrary::getModels(const ModelSymbol* ms, ModelResourceVector& output, const osgDB::Options* dbOptions) const
 {
@@ -44,12 +44,14 @@ void
 StyleSheet::addStyle( const Style& style )
 {
     _styles[ style.getName() ] = style;
+    dirty();
 }
 
 void
 StyleSheet::removeStyle( const std::string& name )
 {
     _styles.erase( name );
+    dirty();
 }
 
 Style*
@@ -144,6 +146,7 @@ StyleSheet::addResourceLibrary( ResourceLibrary* lib )
 {
     Threading::ScopedWriteLock exclusive( _resLibsMutex );
     _resLibs[ lib->getName() ] = lib;
+    dirty();
 }
 
 ResourceLibrary*
@@ -171,6 +174,7 @@ StyleSheet::getDefaultResourceLibrary() const
 void StyleSheet::setScript( ScriptDef* script )
 {
   _script = script;
+  dirty();
 }
 
 
@@ -226,6 +230,8 @@ StyleSheet::getConfig() const
 void
 StyleSheet::mergeConfig( const Config& conf )
 {
+    dirty();
+
     _uriContext = URIContext( conf.referrer() );
 
     // read in any resource library references
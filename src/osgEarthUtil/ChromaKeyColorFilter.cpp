@@ -19,6 +19,7 @@
 #include <osgEarthUtil/ChromaKeyColorFilter>
 #include <osgEarth/VirtualProgram>
 #include <osgEarth/StringUtils>
+#include <osgEarth/ImageUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osg/Program>
 #include <OpenThreads/Atomic>
@@ -30,6 +31,12 @@ namespace
 {
     static OpenThreads::Atomic s_uniformNameGen;
 
+    static const char* s_bodySource =
+        "    float dist = distance(color.rgb, __COLOR_UNIFORM_NAME__); \n"
+        "    if (dist <= __DISTANCE_UNIFORM_NAME__) color.a = 0.0;\n";
+        // feathering:
+        //"    if (dist <= __DISTANCE_UNIFORM_NAME__) color.a = (dist/__DISTANCE_UNIFORM_NAME__); \n"
+
     static const char* s_localShaderSource =
 
         "#version 110\n"
@@ -39,10 +46,7 @@ namespace
 
         "void __ENTRY_POINT__(inout vec4 color)\n"
         "{ \n"
-        "    float dist = distance(color.rgb, __COLOR_UNIFORM_NAME__); \n"
-        "    if (dist <= __DISTANCE_UNIFORM_NAME__) color.a = 0.0;\n"
-        // feathering:
-        //"    if (dist <= __DISTANCE_UNIFORM_NAME__) color.a = (dist/__DISTANCE_UNIFORM_NAME__); \n" 
+        "__BODY__"
         "} \n";
 }
 
@@ -116,6 +120,7 @@ void ChromaKeyColorFilter::install(osg::StateSet* stateSet) const
         // use a template with search and replace for this one.
         std::string entryPoint = osgEarth::Stringify() << FUNCTION_PREFIX << _instanceId;
         std::string code = s_localShaderSource;
+        osgEarth::replaceIn(code, "__BODY__", s_bodySource);
         osgEarth::replaceIn(code, "__COLOR_UNIFORM_NAME__", _color->getName());
         osgEarth::replaceIn(code, "__DISTANCE_UNIFORM_NAME__", _distance->getName());
         osgEarth::replaceIn(code, "__ENTRY_POINT__", entryPoint);
@@ -125,6 +130,35 @@ void ChromaKeyColorFilter::install(osg::StateSet* stateSet) const
     }
 }
 
+bool ChromaKeyColorFilter::getInlineCode(std::string& out_declarations, std::string& out_statements) const
+{
+    out_declarations = osgEarth::Stringify()
+        << "uniform vec3 " << _color->getName() << ";\n"
+        << "uniform float " << _distance->getName() << ";\n";
+    out_statements = s_bodySource;
+    osgEarth::replaceIn(out_statements, "__COLOR_UNIFORM_NAME__", _color->getName());
+    osgEarth::replaceIn(out_statements, "__DISTANCE_UNIFORM_NAME__", _distance->getName());
+    return true;
+}
+
+void ChromaKeyColorFilter::applyToImage(osg::Image* image) const
+{
+    osg::Vec3f color = getColor();
+    float distance = getDistance();
+    ImageUtils::PixelReader read(image);
+    ImageUtils::PixelWriter write(image);
+    for (int r = 0; r < image->r(); ++r)
+        for (int t = 0; t < image->t(); ++t)
+            for (int s = 0; s < image->s(); ++s)
+            {
+                osg::Vec4f c = read(s, t, r);
+                if ((osg::Vec3f(c.r(), c.g(), c.b()) - color).length() <= distance)
+                {
+                    c.a() = 0.0f;
+                    write(c, s, t, r);
+                }
+            }
+}
 
 
 //---------------------------------------------------------------------------
@@ -188,6 +188,7 @@ Control::init()
     _absorbEvents = true;
     _dirty = true;
     _borderWidth = 1.0f;
+    _drawnViewportHeight = -1.0f;
 
     _geode = new osg::Geode();
     this->addChild( _geode );
@@ -658,6 +659,23 @@ Control::draw(const ControlContext& cx)
     }
 }
 
+void
+Control::drawIfChanged(const ControlContext& cx)
+{
+    // geometry is in window coordinates, so a control that is clean and in
+    // the same place can keep what it drew last time. That lets one readout
+    // in a large panel change without rebuilding all of its siblings.
+    float vph = cx._vp->height();
+    if ( !_dirty && _renderPos == _drawnPos && _renderSize == _drawnSize && vph == _drawnViewportHeight )
+        return;
+
+    draw( cx );
+
+    _drawnPos = _renderPos;
+    _drawnSize = _renderSize;
+    _drawnViewportHeight = vph;
+}
+
 bool
 Control::handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa, ControlContext& cx )
 {
@@ -881,7 +899,22 @@ LabelControl::setTextBackdropOffset(float offsetValue)
 void
 LabelControl::calcSize(const ControlContext& cx, osg::Vec2f& out_size)
 {
-    if ( visible() == true )
+    // a clean label is only being moved by its container, so the text
+    // it laid out last time is still good.
+    if ( visible() == true && !isDirty() && _drawable.valid() )
+    {
+        _renderSize.set(
+            (_bmax.x() - _bmin.x()) + padding().x(),
+            (_bmax.y() - _bmin.y()) + padding().y() );
+
+        if (width().isSet() && width().get() > _renderSize.x()) _renderSize.x() = width().get();
+
+        out_size.set(
+            margin().x() + _renderSize.x(),
+            margin().y() + _renderSize.y() );
+    }
+
+    else if ( visible() == true )
     {
         // we have to create the drawable during the layout pass so we can calculate its size.
         LabelText* t = new LabelText();
@@ -1826,7 +1859,7 @@ VBox::draw( const ControlContext& cx )
         {
             Control* c = dynamic_cast<Control*>(getChild(i));
             if ( c )
-                c->draw( cx );
+                c->drawIfChanged( cx );
         }
      
 }
@@ -1963,7 +1996,7 @@ HBox::draw( const ControlContext& cx )
         {
             Control* c = dynamic_cast<Control*>(getChild(i));
             if ( c )
-                c->draw( cx );
+                c->drawIfChanged( cx );
         }
     
 }
@@ -2226,7 +2259,7 @@ Grid::draw( const ControlContext& cx )
                     Control* c = dynamic_cast<Control*>( rowGroup->getChild(j) );
                     if ( c )
                     {
-                        c->draw( cx );
+                        c->drawIfChanged( cx );
                     }
                 }
             }
@@ -692,6 +692,9 @@ EarthManipulator::established()
     if ( !_mapNode.valid() )
         return false;
 
+    // elevation sampled from another map is no good.
+    _terrainSample = TerrainSample();
+
     // resetablish the terrain callback on the map node:
     if ( _terrainCallback.valid() && _mapNode->getTerrain() )
     {
@@ -1299,6 +1302,72 @@ EarthManipulator::getTetherNode() const
 }
 
 
+namespace
+{
+    // Collision detection skips its intersection test when the eye is at
+    // least this far above a coarse elevation sample (plus however far the
+    // eye has moved since the sample was taken). The sample comes from the
+    // elevation pool at TERRAIN_SAMPLE_LOD, and is refreshed once the eye
+    // moves more than TERRAIN_RESAMPLE_DISTANCE.
+    const unsigned TERRAIN_SAMPLE_LOD        = 12u;
+    const double   TERRAIN_SAMPLE_MARGIN     = 1000.0;
+    const double   TERRAIN_RESAMPLE_DISTANCE = 100.0;
+}
+
+bool
+EarthManipulator::isWellAboveTerrain(const osg::Vec3d& eye)
+{
+    osg::ref_ptr<MapNode> mapNode;
+    if ( !_mapNode.lock(mapNode) || !mapNode->getTerrainEngine() )
+        return false;
+
+    ElevationPool* pool = mapNode->getMap()->getElevationPool();
+    if ( !pool )
+        return false;
+
+    GeoPoint eyeMap;
+    if ( !eyeMap.fromWorld(mapNode->getMapSRS(), eye) )
+        return false;
+
+    TerrainSample& ts = _terrainSample;
+
+    // pick up a finished query.
+    if ( ts._pending && ts._future.isAvailable() )
+    {
+        osg::ref_ptr<ElevationSample> sample = ts._future.get();
+        ts._pending = false;
+        if ( sample.valid() && sample->elevation != NO_DATA_VALUE )
+        {
+            ts._valid     = true;
+            ts._eye       = ts._requestedEye;
+            ts._elevation = sample->elevation;
+        }
+    }
+    else if ( ts._pending && ts._future.isAbandoned() )
+    {
+        ts._pending = false;
+    }
+
+    double moved = ts._valid ? (eye - ts._eye).length() : 0.0;
+
+    // refine the sample in the background once the eye has moved on.
+    if ( !ts._pending && (!ts._valid || moved > TERRAIN_RESAMPLE_DISTANCE) )
+    {
+        ts._future       = pool->getElevation(eyeMap, TERRAIN_SAMPLE_LOD);
+        ts._requestedEye = eye;
+        ts._pending      = true;
+    }
+
+    if ( !ts._valid )
+        return false;
+
+    const TerrainOptions& terrainOptions = mapNode->getTerrainEngine()->getTerrainOptions();
+    double elevation = ts._elevation * terrainOptions.verticalScale().getOrUse(1.0f);
+
+    double clearance = eyeMap.z() - elevation;
+    return clearance > TERRAIN_SAMPLE_MARGIN + moved + _settings->getTerrainAvoidanceMinimumDistance();
+}
+
 void EarthManipulator::collisionDetect()
 {
     if (!getSettings()->getTerrainAvoidanceEnabled() ||
@@ -1310,6 +1379,10 @@ void EarthManipulator::collisionDetect()
     // The camera has changed, so make sure we aren't under the ground.
 
     osg::Vec3d eye = getMatrix().getTrans();
+
+    // nowhere near the ground? skip the intersection test.
+    if ( isWellAboveTerrain(eye) )
+        return;
     osg::CoordinateFrame eyeCoordFrame;
     createLocalCoordFrame( eye, eyeCoordFrame );
     osg::Vec3d eyeUp = getUpVector(eyeCoordFrame);
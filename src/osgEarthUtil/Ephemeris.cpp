@@ -20,6 +20,7 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>
 */
 #include <osgEarthUtil/Ephemeris>
+#include <osgEarth/Registry>
 #include <sstream>
 
 using namespace osgEarth;
@@ -400,3 +401,153 @@ Ephemeris::getECEFfromRADecl( double ra, double decl, double range ) const
 {
     return getPositionFromRADecl(ra, decl, range);
 }
+
+//------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[AsyncEphemeris] "
+
+namespace
+{
+    // Async ephemeris samples share the registry's thread budget under this UID.
+    TaskService* getEphemerisService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    struct FillTask : public TaskRequest
+    {
+        osg::ref_ptr<const AsyncEphemeris> _eph;
+        long long _first, _last;
+
+        FillTask(const AsyncEphemeris* eph, long long first, long long last) :
+            _eph(eph), _first(first), _last(last) { }
+
+        void operator()(ProgressCallback*)
+        {
+            _eph->fill(_first, _last);
+        }
+    };
+
+    // sample index at or before a time, and the fraction of the way to the next one.
+    long long sampleIndex(TimeStamp t, unsigned interval, double& frac)
+    {
+        long long tt = (long long)t;
+        long long i = tt >= 0 ? tt / interval : -((-tt + interval - 1) / interval);
+        frac = (double)(tt - i*interval) / (double)interval;
+        return i;
+    }
+
+    // interpolates direction and distance separately, so the blended
+    // position stays on the body's orbit instead of cutting across it.
+    osg::Vec3d blendPositions(const osg::Vec3d& a, const osg::Vec3d& b, double t)
+    {
+        double len = a.length()*(1.0-t) + b.length()*t;
+        osg::Vec3d v = a*(1.0-t) + b*t;
+        v.normalize();
+        return v * len;
+    }
+}
+
+AsyncEphemeris::AsyncEphemeris(Ephemeris* source, unsigned interval, unsigned lookahead) :
+_source   ( source ? source : new Ephemeris() ),
+_interval ( osg::maximum(interval, 1u) ),
+_lookahead( osg::maximum(lookahead, 1u) ),
+_pending  ( false )
+{
+    //nop
+}
+
+void
+AsyncEphemeris::fill(long long first, long long last) const
+{
+    for(long long i = first; i <= last; ++i)
+    {
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            if ( _samples.find(i) != _samples.end() )
+                continue;
+        }
+
+        DateTime dt( (TimeStamp)(i * _interval) );
+        Sample sample;
+        sample._sun  = _source->getSunPositionECEF( dt );
+        sample._moon = _source->getMoonPositionECEF( dt );
+
+        Threading::ScopedMutexLock lock(_mutex);
+        _samples[i] = sample;
+    }
+
+    Threading::ScopedMutexLock lock(_mutex);
+    _pending = false;
+}
+
+AsyncEphemeris::Sample
+AsyncEphemeris::getSample(long long index) const
+{
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        SampleMap::const_iterator i = _samples.find(index);
+        if ( i != _samples.end() )
+            return i->second;
+    }
+
+    // not ready; compute it here.
+    DateTime dt( (TimeStamp)(index * _interval) );
+    Sample sample;
+    sample._sun  = _source->getSunPositionECEF( dt );
+    sample._moon = _source->getMoonPositionECEF( dt );
+
+    Threading::ScopedMutexLock lock(_mutex);
+    _samples[index] = sample;
+    return sample;
+}
+
+void
+AsyncEphemeris::blend(const DateTime& dt, Sample& out) const
+{
+    double frac;
+    long long i0 = sampleIndex( dt.asTimeStamp(), _interval, frac );
+
+    Sample s0 = getSample( i0 );
+    Sample s1 = frac > 0.0 ? getSample( i0+1 ) : s0;
+
+    out._sun  = blendPositions( s0._sun,  s1._sun,  frac );
+    out._moon = blendPositions( s0._moon, s1._moon, frac );
+
+    // keep the samples around this time ready, in both directions since
+    // time can run backwards too.
+    long long half = (long long)_lookahead / 2;
+    Threading::ScopedMutexLock lock(_mutex);
+    if ( !_pending &&
+         (_samples.find(i0 - half) == _samples.end() || _samples.find(i0 + half + 1) == _samples.end()) )
+    {
+        // forget samples far from the current time first.
+        long long keep = 2 * (long long)_lookahead;
+        if ( _samples.size() > (size_t)(4 * keep) )
+        {
+            _samples.erase( _samples.begin(), _samples.lower_bound(i0 - keep) );
+            _samples.erase( _samples.upper_bound(i0 + keep), _samples.end() );
+        }
+
+        _pending = true;
+        getEphemerisService()->add( new FillTask(this, i0 - (long long)_lookahead, i0 + (long long)_lookahead) );
+    }
+}
+
+osg::Vec3d
+AsyncEphemeris::getSunPositionECEF(const DateTime& dt) const
+{
+    Sample s;
+    blend( dt, s );
+    return s._sun;
+}
+
+osg::Vec3d
+AsyncEphemeris::getMoonPositionECEF(const DateTime& dt) const
+{
+    Sample s;
+    blend( dt, s );
+    return s._moon;
+}
@@ -18,6 +18,7 @@
  */
 #include <osgEarthUtil/FlatteningLayer>
 #include <osgEarth/Registry>
+#include <osgEarth/Containers>
 #include <osgEarth/HeightFieldUtils>
 #include <osgEarth/Map>
 #include <osgEarth/Progress>
@@ -175,6 +176,43 @@ namespace
         return Dmin;
     }
     
+    // Size (in cells per side) of the grid used to find the features near each sample.
+    // Roughly 4x4 samples per cell for a 257x257 heightfield.
+    const unsigned IndexCellsPerSide = 64u;
+
+    // Computes the location of every heightfield sample in the working SRS (column-major,
+    // matching the order in which we write them) and the bounding box of the result.
+    void getSamplePoints(const GeoExtent& ex, const osg::HeightField* hf, const SpatialReference* geomSRS,
+                         std::vector<osg::Vec3d>& points, osg::BoundingBoxd& bounds)
+    {
+        double col_interval = ex.width() / (double)(hf->getNumColumns()-1);
+        double row_interval = ex.height() / (double)(hf->getNumRows()-1);
+
+        bool needsTransform = ex.getSRS() != geomSRS;
+
+        points.resize(hf->getNumColumns() * hf->getNumRows());
+        bounds.init();
+
+        osg::Vec3d Pex;
+        unsigned i = 0;
+        for (unsigned col = 0; col < hf->getNumColumns(); ++col)
+        {
+            Pex.x() = ex.xMin() + (double)col * col_interval;
+
+            for (unsigned row = 0; row < hf->getNumRows(); ++row, ++i)
+            {
+                Pex.y() = ex.yMin() + (double)row * row_interval;
+
+                if (needsTransform)
+                    ex.getSRS()->transform(Pex, geomSRS, points[i]);
+                else
+                    points[i] = Pex;
+
+                bounds.expandBy(points[i]);
+            }
+        }
+    }
+
     // Creates a heightfield that flattens an area intersecting the input polygon geometry.
     // The height of the area is found by sampling a point internal to the polygon.
     // bufferWidth = width of transition from flat area to natural terrain.
@@ -184,71 +222,94 @@ namespace
     {
         bool wroteChanges = false;
 
-        const GeoExtent& ex = key.getExtent();
+        std::vector<POINT> points;
+        osg::BoundingBoxd pointBounds;
+        getSamplePoints(key.getExtent(), hf, geomSRS, points, pointBounds);
+
+        // Index the polygons by their bounds, grown by the buffer width. A polygon
+        // whose grown bounds don't contain a sample can neither contain it nor be
+        // within the buffer of it, so each sample only visits the polygons in its cell.
+        // Indices go in ascending order so the first-match rule below is unchanged.
+        std::vector<const Polygon*> polygons;
+        ConstGeometryIterator giter(geom, false);
+        while (giter.hasMore())
+        {
+            const Polygon* polygon = dynamic_cast<const Polygon*>(giter.next());
+            if (polygon)
+                polygons.push_back(polygon);
+        }
 
-        double col_interval = ex.width() / (double)(hf->getNumColumns()-1);
-        double row_interval = ex.height() / (double)(hf->getNumRows()-1);
+        GridIndex index(
+            pointBounds.xMin(), pointBounds.yMin(), pointBounds.xMax(), pointBounds.yMax(),
+            std::min(hf->getNumColumns(), IndexCellsPerSide),
+            std::min(hf->getNumRows(), IndexCellsPerSide));
+
+        for (unsigned p = 0; p < polygons.size(); ++p)
+        {
+            const Bounds& b = polygons[p]->getBounds();
+            index.insert(p,
+                b.xMin() - bufferWidth, b.yMin() - bufferWidth,
+                b.xMax() + bufferWidth, b.yMax() + bufferWidth);
+        }
 
-        POINT Pex, P, internalP;
+        // Elevation at each polygon's internal point, computed the first time a
+        // sample needs it.
+        std::vector<float> internalElev(polygons.size(), NO_DATA_VALUE);
+        std::vector<bool>  internalElevValid(polygons.size(), false);
 
-        bool needsTransform = ex.getSRS() != geomSRS;
-        
+        unsigned i = 0;
         for (unsigned col = 0; col < hf->getNumColumns(); ++col)
         {
-            Pex.x() = ex.xMin() + (double)col * col_interval;
-
-            for (unsigned row = 0; row < hf->getNumRows(); ++row)
+            for (unsigned row = 0; row < hf->getNumRows(); ++row, ++i)
             {
                 // check for cancelation periodically
                 //if (progress && progress->isCanceled())
                 //    return false;
 
-                Pex.y() = ex.yMin() + (double)row * row_interval;
-
-                if (needsTransform)
-                    ex.getSRS()->transform(Pex, geomSRS, P);
-                else
-                    P = Pex;
+                const POINT& P = points[i];
                 
                 bool done = false;
                 double minD2 = bufferWidth * bufferWidth; // minimum distance(squared) to closest polygon edge
 
-                const Polygon* bestPoly = 0L;
+                int bestPoly = -1;
 
-                ConstGeometryIterator giter(geom, false);
-                while (giter.hasMore() && !done)
+                const std::vector<unsigned>& candidates = index.query(P.x(), P.y());
+                for (unsigned c = 0; c < candidates.size() && !done; ++c)
                 {
-                    const Polygon* polygon = dynamic_cast<const Polygon*>(giter.next());
-                    if (polygon)
+                    const Polygon* polygon = polygons[candidates[c]];
+
+                    // Does the point P fall within the polygon?
+                    if (polygon->contains2D(P.x(), P.y()))
                     {
-                        // Does the point P fall within the polygon?
-                        if (polygon->contains2D(P.x(), P.y()))
-                        {
-                            // yes, flatten it to the polygon's centroid elevation;
-                            // and we're dont with this point.
-                            done = true;
-                            bestPoly = polygon;
-                            minD2 = -1.0;
-                        }
+                        // yes, flatten it to the polygon's centroid elevation;
+                        // and we're dont with this point.
+                        done = true;
+                        bestPoly = candidates[c];
+                        minD2 = -1.0;
+                    }
 
-                        // If not in the polygon, how far to the closest edge?
-                        else
+                    // If not in the polygon, how far to the closest edge?
+                    else
+                    {
+                        double D2 = getDistanceSquaredToClosestEdge(P, polygon);
+                        if (D2 < minD2)
                         {
-                            double D2 = getDistanceSquaredToClosestEdge(P, polygon);
-                            if (D2 < minD2)
-                            {
-                                minD2 = D2;
-                                bestPoly = polygon;
-                            }
+                            minD2 = D2;
+                            bestPoly = candidates[c];
                         }
                     }
                 }
 
-                if (bestPoly && minD2 != 0.0)
+                if (bestPoly >= 0 && minD2 != 0.0)
                 {
                     float h;
-                    POINT internalP = getInternalPoint(bestPoly);
-                    float elevInternal = envelope->getElevation(internalP.x(), internalP.y());
+                    if (!internalElevValid[bestPoly])
+                    {
+                        POINT internalP = getInternalPoint(polygons[bestPoly]);
+                        internalElev[bestPoly] = envelope->getElevation(internalP.x(), internalP.y());
+                        internalElevValid[bestPoly] = true;
+                    }
+                    float elevInternal = internalElev[bestPoly];
 
                     if (minD2 < 0.0)
                     {
@@ -366,37 +427,56 @@ namespace
     {
         bool wroteChanges = false;
 
-        const GeoExtent& ex = key.getExtent();
-
-        double col_interval = ex.width() / (double)(hf->getNumColumns()-1);
-        double row_interval = ex.height() / (double)(hf->getNumRows()-1);
-
-        osg::Vec3d Pex, P, PROJ;
+        osg::Vec3d PROJ;
 
         double innerRadius = lineWidth * 0.5;
         double outerRadius = innerRadius + bufferWidth;
         double outerRadius2 = outerRadius * outerRadius;
 
-        bool needsTransform = ex.getSRS() != geomSRS;
+        // Sample locations in the working SRS:
+        std::vector<osg::Vec3d> points;
+        osg::BoundingBoxd pointBounds;
+        getSamplePoints(key.getExtent(), hf, geomSRS, points, pointBounds);
+
+        // Gather the line segments, and index them by their bounds grown by the
+        // outer radius. A segment whose grown bounds don't contain a sample can't be
+        // within the search radius of it, so each sample only visits the segments
+        // in its cell. Indices go in ascending order so the samples are collected
+        // in the same order as a scan over the whole geometry.
+        std::vector<Segment> segments;
+        ConstGeometryIterator giter(geom);
+        while (giter.hasMore())
+        {
+            const Geometry* part = giter.next();
+            for (unsigned i = 0; i+1 < part->size(); ++i)
+                segments.push_back(Segment((*part)[i], (*part)[i+1]));
+        }
+
+        GridIndex index(
+            pointBounds.xMin(), pointBounds.yMin(), pointBounds.xMax(), pointBounds.yMax(),
+            std::min(hf->getNumColumns(), IndexCellsPerSide),
+            std::min(hf->getNumRows(), IndexCellsPerSide));
+
+        for (unsigned s = 0; s < segments.size(); ++s)
+        {
+            const osg::Vec3d& A = segments[s].first;
+            const osg::Vec3d& B = segments[s].second;
+            index.insert(s,
+                osg::minimum(A.x(), B.x()) - outerRadius, osg::minimum(A.y(), B.y()) - outerRadius,
+                osg::maximum(A.x(), B.x()) + outerRadius, osg::maximum(A.y(), B.y()) + outerRadius);
+        }
         
         // Loop over the new heightfield.
+        unsigned p = 0;
         for (unsigned col = 0; col < hf->getNumColumns(); ++col)
         {
-            Pex.x() = ex.xMin() + (double)col * col_interval;
-
-            for (unsigned row = 0; row < hf->getNumRows(); ++row)
+            for (unsigned row = 0; row < hf->getNumRows(); ++row, ++p)
             {
                 // check for cancelation periodically
                 //if (progress && progress->isCanceled())
                 //    return false;
 
-                Pex.y() = ex.yMin() + (double)row * row_interval;
-
-                // Move the point into the working SRS if necessary
-                if (needsTransform)
-                    ex.getSRS()->transform(Pex, geomSRS, P);
-                else
-                    P = Pex;
+                const osg::Vec3d& P = points[p];
 
                 // For each point, we need to find the closest line segments to that point
                 // because the elevation values on these line segments will be the flattening
@@ -406,78 +486,73 @@ namespace
                 Samples samples;
                 
                 // Search for line segments.
-                ConstGeometryIterator giter(geom);
-                while (giter.hasMore())
+                const std::vector<unsigned>& candidates = index.query(P.x(), P.y());
+                for (unsigned c = 0; c < candidates.size(); ++c)
                 {
-                    const Geometry* part = giter.next();
+                    // AB is a candidate line segment:
+                    const osg::Vec3d& A = segments[candidates[c]].first;
+                    const osg::Vec3d& B = segments[candidates[c]].second;
                 
-                    for (int i = 0; i < part->size()-1; ++i)
+                    osg::Vec3d AB = B - A;    // current segment AB
+
+                    double t;                 // parameter [0..1] on segment AB
+                    double D2;                // shortest distance from point P to segment AB, squared
+                    double L2 = AB.length2(); // length (squared) of segment AB
+                    osg::Vec3d AP = P - A;    // vector from endpoint A to point P
+
+                    if (L2 == 0.0)
                     {
-                        // AB is a candidate line segment:
-                        const osg::Vec3d& A = (*part)[i];
-                        const osg::Vec3d& B = (*part)[i+1];
-                    
-                        osg::Vec3d AB = B - A;    // current segment AB
+                        // trivial case: zero-length segment
+                        t = 0.0;
+                        D2 = AP.length2();
+                    }
+                    else
+                    {
+                        // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
+                        // Clamping it means the closest point won't be beyond the endpoints of the segment.
+                        t = clamp((AP * AB)/L2, 0.0, 1.0);
+
+                        // project our point P onto segment AB:
+                        PROJ.set( A + AB*t );
 
-                        double t;                 // parameter [0..1] on segment AB
-                        double D2;                // shortest distance from point P to segment AB, squared
-                        double L2 = AB.length2(); // length (squared) of segment AB
-                        osg::Vec3d AP = P - A;    // vector from endpoint A to point P
+                        // measure the distance (squared) from P to the projected point on AB:
+                        D2 = (P - PROJ).length2();
+                    }
 
-                        if (L2 == 0.0)
+                    // If the distance from our point to the line segment falls within
+                    // the maximum flattening distance, store it.
+                    if (D2 <= outerRadius2)
+                    {
+                        // see if P is a new sample.
+                        Sample* b;
+                        if (samples.size() < Maxsamples)
                         {
-                            // trivial case: zero-length segment
-                            t = 0.0;
-                            D2 = AP.length2();
+                            // If we haven't collected the maximum number of samples yet,
+                            // just add this to the list:
+                            samples.push_back(Sample());
+                            b = &samples.back();
                         }
                         else
                         {
-                            // Calculate parameter "t" [0..1] which will yield the closest point on AB to P.
-                            // Clamping it means the closest point won't be beyond the endpoints of the segment.
-                            t = clamp((AP * AB)/L2, 0.0, 1.0);
+                            // If we are maxed out on samples, find the farthest one we have so far
+                            // and replace it if the new point is closer:
+                            unsigned max_i = 0;
+                            for (unsigned i=1; i<samples.size(); ++i)
+                                if (samples[i].D2 > samples[max_i].D2)
+                                    max_i = i;
 
-                            // project our point P onto segment AB:
-                            PROJ.set( A + AB*t );
+                            b = &samples[max_i];
 
-                            // measure the distance (squared) from P to the projected point on AB:
-                            D2 = (P - PROJ).length2();
+                            if (b->D2 < D2)
+                                b = 0L;
                         }
 
-                        // If the distance from our point to the line segment falls within
-                        // the maximum flattening distance, store it.
-                        if (D2 <= outerRadius2)
+                        if (b)
                         {
-                            // see if P is a new sample.
-                            Sample* b;
-                            if (samples.size() < Maxsamples)
-                            {
-                                // If we haven't collected the maximum number of samples yet,
-                                // just add this to the list:
-                                samples.push_back(Sample());
-                                b = &samples.back();
-                            }
-                            else
-                            {
-                                // If we are maxed out on samples, find the farthest one we have so far
-                                // and replace it if the new point is closer:
-                                unsigned max_i = 0;
-                                for (unsigned i=1; i<samples.size(); ++i)
-                                    if (samples[i].D2 > samples[max_i].D2)
-                                        max_i = i;
-
-                                b = &samples[max_i];
-
-                                if (b->D2 < D2)
-                                    b = 0L;
-                            }
-
-                            if (b)
-                            {
-                                b->D2 = D2;
-                                b->A = A;
-                                b->B = B;
-                                b->T = t;
-                            }
+                            b->D2 = D2;
+                            b->A = A;
+                            b->B = B;
+                            b->T = t;
                         }
                     }
                 }
@@ -22,6 +22,8 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarthUtil/SimplexNoise>
 #include <cstdlib> // for getenv
+#include <vector>
+#include <algorithm>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
@@ -34,6 +36,68 @@ REGISTER_OSGEARTH_LAYER(fractal_elevation, FractalElevationLayer);
 
 namespace
 {
+    //! Single-channel noise image converted to floats once, so tiles can
+    //! sample it without going through a PixelReader for every point.
+    struct NoiseGrid
+    {
+        std::vector<float> _data;
+        int _s, _t;
+
+        NoiseGrid() : _s(0), _t(0) { }
+
+        bool valid() const { return !_data.empty(); }
+
+        void set(const osg::Image* image)
+        {
+            _data.clear();
+            if (!image || image->s() < 1 || image->t() < 1)
+                return;
+
+            _s = image->s();
+            _t = image->t();
+            _data.resize(_s*_t);
+
+            ImageUtils::PixelReader read(image);
+            for (int t = 0; t < _t; ++t)
+                for (int s = 0; s < _s; ++s)
+                    _data[t*_s + s] = read(s, t).r();
+        }
+
+        float at(int s, int t) const { return _data[t*_s + s]; }
+    };
+
+    //! Bilinear sampling positions along one axis of a tile, precomputed
+    //! once per tile and shared by every row (or column) of the grid.
+    //! Matches PixelReader's bilinear addressing.
+    struct AxisLookup
+    {
+        std::vector<int>   _i0, _i1;
+        std::vector<float> _w;
+
+        void build(unsigned numSamples, double scale, double offset, int gridSize)
+        {
+            _i0.resize(numSamples);
+            _i1.resize(numSamples);
+            _w.resize(numSamples);
+
+            double size = (double)(gridSize - 1);
+
+            for (unsigned k = 0; k < numSamples; ++k)
+            {
+                double c = (double)k / (double)(numSamples - 1);
+                c = fmod(c*scale + offset, 1.0);
+
+                double x = c * size;
+                double x0 = std::max(floor(x), 0.0);
+                double x1 = std::min(x0 + 1.0, size);
+
+                _i0[k] = (int)x0;
+                _i1[k] = (int)x1;
+                _w[k] = x0 < x1 ? (float)(x - x0) : 0.0f;
+            }
+        }
+    };
+
     //! TileSource that provided elevation fiends to the FractalElevationLayer.
     class FractalElevationTileSource : public TileSource
     {
@@ -62,6 +126,7 @@ namespace
             noise.setLacunarity(_options.lacunarity().get());
             noise.setOctaves(12u);
             _noiseImage1 = noise.createSeamlessImage(1024u);
+            _noise1.set(_noiseImage1.get());
 
             // Try to load a secondary noise image:
             if (options().noiseImageURI().isSet())
@@ -71,6 +136,7 @@ namespace
                 {
                     //return Status::Error(Status::ServiceUnavailable, "Failed to load noise image");
                 }
+                _noise2.set(_noiseImage2.get());
             }
 
             return Status::OK();
@@ -88,60 +154,58 @@ namespace
             double min_h = FLT_MAX, max_h = -FLT_MAX;
             double h_mean = 0.0;
 
-            ImageUtils::PixelReader noise1(_noiseImage1.get());
-            noise1.setBilinear(true);
+            const unsigned size = getPixelsPerTile();
 
-            ImageUtils::PixelReader noise2(_noiseImage2.get());
-            noise2.setBilinear(true);
+            double finalScale = 4.0;
+            if (_noise1.valid()) finalScale *= 0.5;
+            if (_noise2.valid()) finalScale *= 0.5;
+            const float heightScale = (float)(finalScale * _options.amplitude().get());
 
-            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(key.getExtent(), getPixelsPerTile(), getPixelsPerTile(), 0u);
-            for (int s = 0; s < getPixelsPerTile(); ++s)
-            {
-                for (int t = 0; t < getPixelsPerTile(); ++t)
-                {
-                    double u = (double)s / (double)(getPixelsPerTile() - 1);
-                    double v = (double)t / (double)(getPixelsPerTile() - 1);
-
-                    double n = 0.0;
-                    double uScaled, vScaled;
+            // The tile's position within each noise image is an affine
+            // function of (u,v); work out the sample positions along each
+            // axis once instead of per point.
+            AxisLookup u1, v1, u2, v2;
+            double scale, offsetU, offsetV;
 
-                    double finalScale = 4.0;
-
-                    // Step 1
-                    if (_noiseImage1.valid())
-                    {
-                        uScaled = u, vScaled = v;
-                        scaleCoordsToLOD(uScaled, vScaled, _options.baseLOD().get(), key);
+            if (_noise1.valid())
+            {
+                getLODTransform(_options.baseLOD().get(), key, scale, offsetU, offsetV);
+                u1.build(size, scale, offsetU, _noise1._s);
+                v1.build(size, scale, offsetV, _noise1._t);
+            }
 
-                        double uMod = fmod(uScaled, 1.0);
-                        double vMod = fmod(vScaled, 1.0);
+            if (_noise2.valid())
+            {
+                getLODTransform(_options.baseLOD().get() + 3, key, scale, offsetU, offsetV);
+                u2.build(size, scale, offsetU, _noise2._s);
+                v2.build(size, scale, offsetV, _noise2._t);
+            }
 
-                        n += noise1(uMod, vMod).r() - 0.5;
-                        finalScale *= 0.5;
-                    }
+            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(key.getExtent(), size, size, 0u);
+            osg::FloatArray* heights = hf->getFloatArray();
 
-                    if (_noiseImage2.valid())
-                    {
-                        uScaled = u, vScaled = v;
-                        scaleCoordsToLOD(uScaled, vScaled, _options.baseLOD().get() + 3, key);
+            for (unsigned t = 0; t < size; ++t)
+            {
+                float* row = &(*heights)[t*size];
 
-                        double uMod = fmod(uScaled, 1.0);
-                        double vMod = fmod(vScaled, 1.0);
-                        n += noise2(uMod, vMod).r() - 0.5;
-                        finalScale *= 0.5;
-                    }
+                if (_noise1.valid())
+                    accumulateRow(_noise1, u1, v1._i0[t], v1._i1[t], v1._w[t], size, row);
 
-                    n *= finalScale;
+                if (_noise2.valid())
+                    accumulateRow(_noise2, u2, v2._i0[t], v2._i1[t], v2._w[t], size, row);
 
-                    hf->setHeight(s, t, n * _options.amplitude().get());
+                for (unsigned s = 0; s < size; ++s)
+                {
+                    float n = row[s];
+                    row[s] = n * heightScale;
 
                     if (_debug)
                     {
-                        h_mean += hf->getHeight(s, t);
-                        min_n = std::min(min_n, n);
-                        max_n = std::max(max_n, n);
-                        min_h = std::min(min_h, (double)hf->getHeight(s, t));
-                        max_h = std::max(max_h, (double)hf->getHeight(s, t));
+                        h_mean += row[s];
+                        min_n = std::min(min_n, (double)n * finalScale);
+                        max_n = std::max(max_n, (double)n * finalScale);
+                        min_h = std::min(min_h, (double)row[s]);
+                        max_h = std::max(max_h, (double)row[s]);
                     }
                 }
             }
@@ -173,14 +237,34 @@ namespace
 
     private:
 
-        void scaleCoordsToLOD(double& u, double& v, int baseLOD, const TileKey& key)
+        // Adds one row of bilinear noise samples (minus the 0.5 bias) into "out".
+        static void accumulateRow(const NoiseGrid& grid, const AxisLookup& u, int t0, int t1, float tw, unsigned size, float* out)
+        {
+            const float* row0 = &grid._data[t0*grid._s];
+            const float* row1 = &grid._data[t1*grid._s];
+            const int*   i0 = &u._i0[0];
+            const int*   i1 = &u._i1[0];
+            const float* w  = &u._w[0];
+
+            for (unsigned s = 0; s < size; ++s)
+            {
+                float top = row0[i0[s]] + (row0[i1[s]] - row0[i0[s]]) * w[s];
+                float bot = row1[i0[s]] + (row1[i1[s]] - row1[i0[s]]) * w[s];
+                out[s] += top + (bot - top) * tw - 0.5f;
+            }
+        }
+
+        // Maps tile coordinates to noise image coordinates (before wrapping):
+        // u' = u*scale + offsetU, v' = v*scale + offsetV.
+        void getLODTransform(int baseLOD, const TileKey& key, double& scale, double& offsetU, double& offsetV)
         {
             double dL = (double)((int)key.getLOD() - baseLOD);
             double factor = pow(2.0, dL); //exp2(dL) .. exp2 not available on some platforms
             double invFactor = 1.0/factor;
 
-            u *= invFactor;
-            v *= invFactor;
+            scale = invFactor;
+            offsetU = 0.0;
+            offsetV = 0.0;
 
             if (factor >= 1.0)
             {
@@ -199,8 +283,8 @@ namespace
                 double cx = bx + factor;
                 double cy = by + factor;
 
-                u += (tx - bx) / (cx - bx);
-                v += (ty - by) / (cy - by);
+                offsetU = (tx - bx) / (cx - bx);
+                offsetV = (ty - by) / (cy - by);
             }
         }
 
@@ -211,6 +295,8 @@ namespace
         bool _debug;
         osg::ref_ptr<osg::Image> _noiseImage1;
         osg::ref_ptr<osg::Image> _noiseImage2;
+        NoiseGrid _noise1;
+        NoiseGrid _noise2;
     };
 }
 
@@ -24,6 +24,7 @@
 #include <osgEarthUtil/GammaColorFilter>
 #include <osgEarth/VirtualProgram>
 #include <osgEarth/StringUtils>
+#include <osgEarth/ImageUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osg/Program>
 #include <OpenThreads/Atomic>
@@ -35,13 +36,16 @@ namespace
 {
     static OpenThreads::Atomic s_uniformNameGen;
 
+    static const char* s_bodySource =
+        "    color.rgb = pow(color.rgb, 1.0 / __UNIFORM_NAME__.rgb); \n";
+
     static const char* s_localShaderSource =
         "#version 110\n"
         "uniform vec3 __UNIFORM_NAME__;\n"
 
         "void __ENTRY_POINT__(inout vec4 color)\n"
         "{\n"
-        "    color.rgb = pow(color.rgb, 1.0 / __UNIFORM_NAME__.rgb); \n"
+        "__BODY__"
         "}\n";
 }
 
@@ -100,6 +104,7 @@ void GammaColorFilter::install(osg::StateSet* stateSet) const
         // use a template with search and replace for this one.
         std::string entryPoint = osgEarth::Stringify() << FUNCTION_PREFIX << m_instanceId;
         std::string code = s_localShaderSource;
+        osgEarth::replaceIn(code, "__BODY__", s_bodySource);
         osgEarth::replaceIn(code, "__UNIFORM_NAME__", m_gamma->getName());
         osgEarth::replaceIn(code, "__ENTRY_POINT__", entryPoint);
 
@@ -109,6 +114,32 @@ void GammaColorFilter::install(osg::StateSet* stateSet) const
     }
 }
 
+bool GammaColorFilter::getInlineCode(std::string& out_declarations, std::string& out_statements) const
+{
+    out_declarations = osgEarth::Stringify()
+        << "uniform vec3 " << m_gamma->getName() << ";\n";
+    out_statements = s_bodySource;
+    osgEarth::replaceIn(out_statements, "__UNIFORM_NAME__", m_gamma->getName());
+    return true;
+}
+
+void GammaColorFilter::applyToImage(osg::Image* image) const
+{
+    osg::Vec3f gamma = getGamma();
+    ImageUtils::PixelReader read(image);
+    ImageUtils::PixelWriter write(image);
+    for (int r = 0; r < image->r(); ++r)
+        for (int t = 0; t < image->t(); ++t)
+            for (int s = 0; s < image->s(); ++s)
+            {
+                osg::Vec4f c = read(s, t, r);
+                c.r() = powf(c.r(), 1.0f / gamma.x());
+                c.g() = powf(c.g(), 1.0f / gamma.y());
+                c.b() = powf(c.b(), 1.0f / gamma.z());
+                write(c, s, t, r);
+            }
+}
+
 
 //---------------------------------------------------------------------------
 
@@ -115,15 +115,7 @@ namespace
         "}\n";
 
 
-    static const char* s_localShaderSource =
-
-        "#version 110\n"
-        "void oe_hsl_RGB_2_HSL(in float r, in float g, in float b, out float h, out float s, out float l);\n"
-        "void oe_hsl_HSL_2_RGB(in float h, in float s, in float l, out float r, out float g, out float b);\n"
-        "uniform vec3 __UNIFORM_NAME__;\n"
-
-        "void __ENTRY_POINT__(inout vec4 color)\n"
-        "{ \n"
+    static const char* s_bodySource =
         "    if (__UNIFORM_NAME__.x != 0.0 || __UNIFORM_NAME__.y != 0.0 || __UNIFORM_NAME__.z != 0.0) \n"
         "    { \n"
         "        float h, s, l;\n"
@@ -144,7 +136,18 @@ namespace
         "        color.r = r;\n"
         "        color.g = g;\n"
         "        color.b = b;\n"
-        "    }\n"
+        "    }\n";
+
+    static const char* s_localShaderSource =
+
+        "#version 110\n"
+        "void oe_hsl_RGB_2_HSL(in float r, in float g, in float b, out float h, out float s, out float l);\n"
+        "void oe_hsl_HSL_2_RGB(in float h, in float s, in float l, out float r, out float g, out float b);\n"
+        "uniform vec3 __UNIFORM_NAME__;\n"
+
+        "void __ENTRY_POINT__(inout vec4 color)\n"
+        "{ \n"
+        "__BODY__"
         "} \n";
 }
 
@@ -228,6 +231,7 @@ HSLColorFilter::install( osg::StateSet* stateSet ) const
         // and replace for this one.
         std::string entryPoint = Stringify() << FUNCTION_PREFIX << _instanceId;
         std::string code       = s_localShaderSource;
+        replaceIn( code, "__BODY__",         s_bodySource );
         replaceIn( code, "__UNIFORM_NAME__", _hsl->getName() );
         replaceIn( code, "__ENTRY_POINT__",  entryPoint );
 
@@ -237,6 +241,19 @@ HSLColorFilter::install( osg::StateSet* stateSet ) const
     }
 }
 
+
+bool
+HSLColorFilter::getInlineCode(std::string& out_declarations, std::string& out_statements) const
+{
+    out_declarations = Stringify()
+        << "void oe_hsl_RGB_2_HSL(in float r, in float g, in float b, out float h, out float s, out float l);\n"
+        << "void oe_hsl_HSL_2_RGB(in float h, in float s, in float l, out float r, out float g, out float b);\n"
+        << "uniform vec3 " << _hsl->getName() << ";\n";
+    out_statements = s_bodySource;
+    replaceIn( out_statements, "__UNIFORM_NAME__", _hsl->getName() );
+    return true;
+}
+
 //---------------------------------------------------------------------------
 
 OSGEARTH_REGISTER_COLORFILTER( hsl, osgEarth::Util::HSLColorFilter );
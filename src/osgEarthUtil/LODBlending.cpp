@@ -45,6 +45,10 @@ namespace
     //
     // It will also transition between a parent texture and the current texture.
     //
+    // With blend_by_range off, only the timer applies, so the blend ends once
+    // the transition is over; the engine then stops binding parent textures
+    // and the fragment stage skips sampling them.
+    //
     // Caveats: You can still fake out the morph by zooming around very quickly.
     // Also, it will only morph properly if you use odd-numbers post spacings
     // in your terrain tile. (See MapOptions::elevation_tile_size). Finally,
@@ -61,6 +65,7 @@ namespace
         "uniform float oe_tile_birthtime; \n"
         "uniform float oe_lodblend_delay; \n"
         "uniform float oe_lodblend_duration; \n"
+        "uniform float oe_lodblend_by_range; \n"
         "uniform mat4 oe_layer_parent_texmat; \n"
 
         "out vec4 oe_layer_texc; \n"
@@ -76,7 +81,7 @@ namespace
         "    float r_dist     = clamp((d-near)/(far-near), 0.0, 1.0); \n"
 
         "    float r_time     = 1.0 - clamp(osg_FrameTime-(oe_tile_birthtime+oe_lodblend_delay), 0.0, oe_lodblend_duration)/oe_lodblend_duration; \n"
-        "    float r          = max(r_dist, r_time); \n"
+        "    float r          = max(r_dist*oe_lodblend_by_range, r_time); \n"
 
         "    oe_lodblend_texc = oe_layer_parent_texmat * oe_layer_texc; \n"
         "    oe_lodblend_r    = oe_layer_parent_texmat[0][0] > 0.0 ? r : 0.0; \n" // obe?
@@ -97,6 +102,7 @@ namespace
         "uniform float oe_tile_birthtime; \n"
         "uniform float oe_lodblend_delay; \n"
         "uniform float oe_lodblend_duration; \n"
+        "uniform float oe_lodblend_by_range; \n"
         "uniform float oe_lodblend_vscale; \n"
 
         "void oe_lodblend_elevation_vertex(inout vec4 VertexMODEL) \n"
@@ -109,7 +115,7 @@ namespace
         "    float r_dist     = clamp((d-near)/(far-near), 0.0, 1.0); \n"
 
         "    float r_time     = 1.0 - clamp(osg_FrameTime-(oe_tile_birthtime+oe_lodblend_delay), 0.0, oe_lodblend_duration)/oe_lodblend_duration; \n"
-        "    float r          = max(r_dist, r_time); \n"
+        "    float r          = max(r_dist*oe_lodblend_by_range, r_time); \n"
 
         "    vec3  upVector   = oe_terrain_attr.xyz; \n"
         "    float elev       = oe_terrain_attr.w; \n"
@@ -135,6 +141,7 @@ namespace
         "uniform float oe_tile_birthtime; \n"
         "uniform float oe_lodblend_delay; \n"
         "uniform float oe_lodblend_duration; \n"
+        "uniform float oe_lodblend_by_range; \n"
         "uniform float oe_lodblend_vscale; \n"
         "uniform mat4 oe_layer_parent_texmat; \n"
 
@@ -152,7 +159,7 @@ namespace
         "    float r_dist     = clamp((d-near)/(far-near), 0.0, 1.0); \n"
 
         "    float r_time     = 1.0 - clamp(osg_FrameTime-(oe_tile_birthtime+oe_lodblend_delay), 0.0, oe_lodblend_duration)/oe_lodblend_duration; \n"
-        "    float r          = max(r_dist, r_time); \n"
+        "    float r          = max(r_dist*oe_lodblend_by_range, r_time); \n"
 
         "    vec3  upVector   = oe_terrain_attr.xyz; \n"
         "    float elev       = oe_terrain_attr.w; \n"
@@ -181,7 +188,7 @@ namespace
 
         "void oe_lodblend_imagery_fragment(inout vec4 color) \n"
         "{ \n"
-        "    if ( oe_layer_uid >= 0 ) \n"
+        "    if ( oe_layer_uid >= 0 && oe_lodblend_r > 0.0 ) \n"
         "    { \n"
         "        vec4 texel = texture(oe_layer_tex_parent, oe_lodblend_texc.st); \n"
         "        float enable = step(0.09, texel.a); \n"          // did we get a parent texel?
@@ -211,6 +218,9 @@ LODBlending::init()
 
     _vscaleUniform = new osg::Uniform(osg::Uniform::FLOAT, "oe_lodblend_vscale");
     _vscaleUniform->set(osg::clampAbove(verticalScale().get(), 0.0f));
+
+    _byRangeUniform = new osg::Uniform(osg::Uniform::FLOAT, "oe_lodblend_by_range");
+    _byRangeUniform->set(blendByRange() == true ? 1.0f : 0.0f);
 }
 
 
@@ -222,11 +232,19 @@ LODBlending::onInstall(TerrainEngineNode* engine)
         // need the parent textures for blending.
         engine->requireParentTextures();
 
+        // blending by time alone only needs them until the transition ends.
+        if ( blendByRange() == false )
+        {
+            engine->setParentTexturesLifetime(
+                osg::clampAbove(delay().get(), 0.0f) + osg::clampAbove(duration().get(), 0.0f) );
+        }
+
         osg::StateSet* stateset = engine->getOrCreateStateSet();
 
         stateset->addUniform( _delayUniform.get() );
         stateset->addUniform( _durationUniform.get() );
         stateset->addUniform( _vscaleUniform.get() );
+        stateset->addUniform( _byRangeUniform.get() );
 
         VirtualProgram* vp = VirtualProgram::getOrCreate(stateset);
         vp->setName( "osgEarth::Util::LODBlending" );
@@ -252,12 +270,18 @@ LODBlending::onUninstall(TerrainEngineNode* engine)
 {
     if ( engine )
     {
+        if ( blendByRange() == false )
+        {
+            engine->setParentTexturesLifetime( -1.0f );
+        }
+
         osg::StateSet* stateset = engine->getStateSet();
         if ( stateset )
         {
             stateset->removeUniform( _delayUniform.get() );
             stateset->removeUniform( _durationUniform.get() );
             stateset->removeUniform( _vscaleUniform.get() );
+            stateset->removeUniform( _byRangeUniform.get() );
 
             VirtualProgram* vp = VirtualProgram::get(stateset);
             if ( vp )
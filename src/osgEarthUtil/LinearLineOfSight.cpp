@@ -22,6 +22,7 @@
 #include <osgEarthUtil/LinearLineOfSight>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/DPLineSegmentIntersector>
+#include <osgEarth/ElevationRayCaster>
 #include <osgSim/LineOfSight>
 #include <osgUtil/IntersectionVisitor>
 #include <osgUtil/LineSegmentIntersector>
@@ -83,7 +84,8 @@ _hasLOS( true ),
 _goodColor(0.0f, 1.0f, 0.0f, 1.0f),
 _badColor(1.0f, 0.0f, 0.0f, 1.0f),
 _displayMode( LineOfSight::MODE_SPLIT ),
-_terrainOnly( false )
+_terrainOnly( false ),
+_useElevationData( false )
 {
     compute(getNode());
     subscribeToTerrain();    
@@ -101,7 +103,8 @@ _hasLOS( true ),
 _goodColor(0.0f, 1.0f, 0.0f, 1.0f),
 _badColor(1.0f, 0.0f, 0.0f, 1.0f),
 _displayMode( LineOfSight::MODE_SPLIT ),
-_terrainOnly( false )
+_terrainOnly( false ),
+_useElevationData( false )
 {
     compute(getNode());    
     subscribeToTerrain();    
@@ -150,9 +153,78 @@ LinearLineOfSightNode::setMapNode( MapNode* mapNode )
 void
 LinearLineOfSightNode::terrainChanged( const osgEarth::TileKey& tileKey, osg::Node* terrain )
 {
+    // elevation data doesn't depend on which tiles are paged in.
+    if ( _useElevationData || !getMapNode() )
+        return;
+
+    // only a tile under the line can change the result.
+    GeoExtent footprint = getFootprint();
+    if ( footprint.isValid() )
+    {
+        const GeoExtent& tileExtent = tileKey.getExtent();
+        GeoExtent west, east;
+        if ( footprint.crossesAntimeridian() && footprint.splitAcrossAntimeridian(west, east) )
+        {
+            if ( !tileExtent.intersects(west) && !tileExtent.intersects(east) )
+                return;
+        }
+        else if ( !tileExtent.intersects(footprint) )
+        {
+            return;
+        }
+    }
+
     compute( getNode() );
 }
 
+GeoExtent
+LinearLineOfSightNode::getFootprint() const
+{
+    // The line is a straight chord through world space, so on a geocentric
+    // map it bows away from the straight lat/long segment between its ends.
+    // Sample the chord, then pad by the largest step between samples to
+    // cover the curve between them.
+    const unsigned numSamples = 16u;
+
+    osg::ref_ptr<MapNode> mapNode;
+    if ( !_mapNode.lock(mapNode) || _startWorld == _endWorld )
+        return GeoExtent::INVALID;
+
+    const SpatialReference* mapSRS = mapNode->getMapSRS();
+    std::vector<osg::Vec3d> samples;
+    double pad = 0.0;
+    for ( unsigned i = 0; i <= numSamples; ++i )
+    {
+        double t = (double)i / (double)numSamples;
+        GeoPoint p;
+        if ( !p.fromWorld(mapSRS, _startWorld*(1.0-t) + _endWorld*t) )
+            return GeoExtent::INVALID;
+
+        if ( !samples.empty() )
+        {
+            double dx = fabs(p.x() - samples.back().x());
+            if ( mapSRS->isGeographic() && dx > 180.0 )
+                dx = 360.0 - dx;
+            pad = osg::maximum( pad, osg::maximum(dx, fabs(p.y() - samples.back().y())) );
+        }
+        samples.push_back( p.vec3d() );
+    }
+
+    GeoExtent extent( mapSRS );
+    for ( std::vector<osg::Vec3d>::const_iterator s = samples.begin(); s != samples.end(); ++s )
+    {
+        double south = s->y() - pad, north = s->y() + pad;
+        if ( mapSRS->isGeographic() )
+        {
+            south = osg::maximum( south, -90.0 );
+            north = osg::minimum( north,  90.0 );
+        }
+        extent.expandToInclude( s->x() - pad, south );
+        extent.expandToInclude( s->x() + pad, north );
+    }
+    return extent;
+}
+
 const GeoPoint&
 LinearLineOfSightNode::getStart() const
 {
@@ -185,6 +257,17 @@ LinearLineOfSightNode::setEnd(const GeoPoint& end)
     }
 }
 
+void
+LinearLineOfSightNode::setStartEnd(const GeoPoint& start, const GeoPoint& end)
+{
+    if (_start != start || _end != end)
+    {
+        _start = start;
+        _end = end;
+        compute(getNode());
+    }
+}
+
 const osg::Vec3d&
 LinearLineOfSightNode::getStartWorld() const
 {
@@ -254,21 +337,33 @@ LinearLineOfSightNode::compute(osg::Node* node, bool backgroundThread)
       }
 
 
-      DPLineSegmentIntersector* lsi = new DPLineSegmentIntersector(_startWorld, _endWorld);
-      osgUtil::IntersectionVisitor iv( lsi );
-
-      node->accept( iv );
-
-      DPLineSegmentIntersector::Intersections& hits = lsi->getIntersections();
-      if ( hits.size() > 0 )
+      if (_useElevationData)
       {
-          _hasLOS = false;
-          _hitWorld = hits.begin()->getWorldIntersectPoint();
-          _hit.fromWorld( mapSRS, _hitWorld );
+          ElevationRayCaster caster( getMapNode()->getMap() );
+          _hasLOS = !caster.intersect( _startWorld, _endWorld, _hitWorld );
+          if (!_hasLOS)
+          {
+              _hit.fromWorld( mapSRS, _hitWorld );
+          }
       }
       else
       {
-          _hasLOS = true;
+          DPLineSegmentIntersector* lsi = new DPLineSegmentIntersector(_startWorld, _endWorld);
+          osgUtil::IntersectionVisitor iv( lsi );
+
+          node->accept( iv );
+
+          DPLineSegmentIntersector::Intersections& hits = lsi->getIntersections();
+          if ( hits.size() > 0 )
+          {
+              _hasLOS = false;
+              _hitWorld = hits.begin()->getWorldIntersectPoint();
+              _hit.fromWorld( mapSRS, _hitWorld );
+          }
+          else
+          {
+              _hasLOS = true;
+          }
       }
     }
 
@@ -414,6 +509,22 @@ LinearLineOfSightNode::setTerrainOnly( bool terrainOnly )
     }
 }
 
+bool
+LinearLineOfSightNode::getUseElevationData() const
+{
+    return _useElevationData;
+}
+
+void
+LinearLineOfSightNode::setUseElevationData( bool value )
+{
+    if (_useElevationData != value)
+    {
+        _useElevationData = value;
+        compute(getNode());
+    }
+}
+
 osg::Node*
 LinearLineOfSightNode::getNode()
 {
@@ -440,14 +551,15 @@ LineOfSightTether::operator()(osg::Node* node, osg::NodeVisitor* nv)
 
         if ( los->getMapNode() )
         {
+            GeoPoint mapStart = los->getStart();
+            GeoPoint mapEnd = los->getEnd();
+
             if (_startNode.valid())
             {
                 osg::Vec3d worldStart = getNodeCenter(_startNode);
 
                 //Convert to mappoint since that is what LOS expects
-                GeoPoint mapStart;
                 mapStart.fromWorld( los->getMapNode()->getMapSRS(), worldStart );
-                los->setStart( mapStart ); //.vec3d() );
             }
 
             if (_endNode.valid())
@@ -455,10 +567,11 @@ LineOfSightTether::operator()(osg::Node* node, osg::NodeVisitor* nv)
                 osg::Vec3d worldEnd = getNodeCenter( _endNode );
 
                 //Convert to mappoint since that is what LOS expects
-                GeoPoint mapEnd;
                 mapEnd.fromWorld( los->getMapNode()->getMapSRS(), worldEnd );
-                los->setEnd( mapEnd ); //.vec3d() );
             }
+
+            // set both at once so the LOS is computed once per frame
+            los->setStartEnd( mapStart, mapEnd );
         }
     }
     traverse(node, nv);
@@ -155,7 +155,39 @@ MGRSGraticule::rebuild()
     // intialize the UTM sector tables for this profile.
     _utmData.rebuild(_profile.get());
 
-    // now build the lateral tiles for the GZD level.
+    // compiled cells depend on the styles and the profile.
+    _utmData.setupCache(
+        getMapNode()->getMap(),
+        Stringify() << "mgrs_graticule_" << hashToString(getConfig().toJSON(false) + _profile->getFullSignature()) );
+
+    // The GZD level has over a thousand cells to compile, so page it in
+    // the background instead of building it here. It goes ahead of the
+    // SQID cells and stays resident.
+    osg::PagedLOD* plod = new osg::PagedLOD();
+    plod->setCenterMode( osg::LOD::USER_DEFINED_CENTER );
+    plod->setCenter( osg::Vec3d(0,0,0) );
+    plod->setRadius( _profile->getSRS()->getEllipsoid()->getRadiusEquator() );
+    plod->setFileName( 0, "gzd." MGRS_GRATICULE_EXTENSION );
+    plod->setRange( 0, 0.0f, FLT_MAX );
+    plod->setPriorityOffset( 0, 1.0f );
+    plod->setNumChildrenThatCannotBeExpired( 1 );
+
+    osgDB::Options* readOptions = new osgDB::Options();
+    OptionsData<MGRSGraticule>::set(readOptions, "osgEarth.MGRSGraticule", this);
+    plod->setDatabaseOptions(readOptions);
+
+    _root->addChild( plod );
+}
+
+osg::Node*
+MGRSGraticule::buildGZDTiles()
+{
+    if ( !getMapNode() )
+        return 0L;
+
+    osg::Group* root = new osg::Group();
+
+    // the lateral tiles for the GZD level.
     for( UTMData::SectorTable::iterator i = _utmData.sectorTable().begin(); i != _utmData.sectorTable().end(); ++i )
     {
         osg::Group* group = _utmData.buildGZDTile(i->first, i->second, gzdStyle().get(), _featureProfile.get(), getMapNode()->getMap());
@@ -164,10 +196,12 @@ MGRSGraticule::rebuild()
             group = buildGZDChildren(group, i->first);
             if (group)
             {
-                _root->addChild(group);
+                root->addChild(group);
             }
         }
     }
+
+    return root;
 }
 
 void
@@ -223,6 +257,12 @@ MGRSGraticule::buildGZDChildren( osg::Group* parent, const std::string& gzd )
 osg::Node*
 MGRSGraticule::buildSQIDTiles( const std::string& gzd )
 {
+    // a cell compiled in an earlier session?
+    std::string cacheKey = Stringify() << "sqid_" << gzd;
+    osg::Node* cached = _utmData.readCell(cacheKey);
+    if ( cached )
+        return cached;
+
     const GeoExtent& extent = _utmData.sectorTable()[gzd];
 
     // parse the GZD into its components:
@@ -629,7 +669,7 @@ MGRSGraticule::buildSQIDTiles( const std::string& gzd )
         }
     }
 
-    osg::Group* group = new osg::Group();
+    osg::ref_ptr<osg::Group> group = new osg::Group();
 
     Style lineStyle;
     lineStyle.add( sqidStyle()->get<LineSymbol>() );
@@ -651,7 +691,9 @@ MGRSGraticule::buildSQIDTiles( const std::string& gzd )
 
     Registry::shaderGenerator().run(textGeode, Registry::stateSetCache());
 
-    return group;
+    _utmData.writeCell( cacheKey, group.get() );
+
+    return group.release();
 }
 
 //---------------------------------------------------------------------------
@@ -706,7 +748,10 @@ namespace osgEarth { namespace Util
             std::string def = osgDB::getNameLessExtension(uri);
             std::string gzd = osgDB::getNameLessExtension(def);
             
-            osg::Node* result = graticule->buildSQIDTiles( gzd );
+            // "gzd" is the whole GZD level; anything else is one GZD's SQID cells.
+            osg::Node* result = gzd == "gzd" ?
+                graticule->buildGZDTiles() :
+                graticule->buildSQIDTiles( gzd );
 
             return result ? ReadResult(result) : ReadResult::ERROR_IN_READING_FILE;
         }
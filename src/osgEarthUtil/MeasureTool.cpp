@@ -272,7 +272,7 @@ bool MeasureToolHandler::handle( const osgGA::GUIEventAdapter& ea, osgGA::GUIAct
                 {
                     _feature->getGeometry()->back() = osg::Vec3d( lon, lat, 0 );
                 }
-                _featureNode->init();
+                _featureNode->dirtyFeature( _feature.get() );
                 fireDistanceChanged();
                 aa.requestRedraw();
             }
@@ -24,6 +24,7 @@
 #include <osgEarthUtil/RGBColorFilter>
 #include <osgEarth/VirtualProgram>
 #include <osgEarth/StringUtils>
+#include <osgEarth/ImageUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osg/Program>
 #include <OpenThreads/Atomic>
@@ -35,13 +36,16 @@ namespace
 {
     static OpenThreads::Atomic s_uniformNameGen;
 
+    static const char* s_bodySource =
+        "    color.rgb = clamp(color.rgb + __UNIFORM_NAME__.rgb, 0.0, 1.0); \n";
+
     static const char* s_localShaderSource =
         "#version 110\n"
         "uniform vec3 __UNIFORM_NAME__;\n"
 
         "void __ENTRY_POINT__(inout vec4 color)\n"
         "{\n"
-        "    color.rgb = clamp(color.rgb + __UNIFORM_NAME__.rgb, 0.0, 1.0); \n"
+        "__BODY__"
         "} \n";
 }
 
@@ -95,6 +99,7 @@ void RGBColorFilter::install(osg::StateSet* stateSet) const
         // use a template with search and replace for this one.
         std::string entryPoint = osgEarth::Stringify() << FUNCTION_PREFIX << m_instanceId;
         std::string code = s_localShaderSource;
+        osgEarth::replaceIn(code, "__BODY__", s_bodySource);
         osgEarth::replaceIn(code, "__UNIFORM_NAME__", m_rgb->getName());
         osgEarth::replaceIn(code, "__ENTRY_POINT__", entryPoint);
 
@@ -104,6 +109,31 @@ void RGBColorFilter::install(osg::StateSet* stateSet) const
     }
 }
 
+bool RGBColorFilter::getInlineCode(std::string& out_declarations, std::string& out_statements) const
+{
+    out_declarations = osgEarth::Stringify()
+        << "uniform vec3 " << m_rgb->getName() << ";\n";
+    out_statements = s_bodySource;
+    osgEarth::replaceIn(out_statements, "__UNIFORM_NAME__", m_rgb->getName());
+    return true;
+}
+
+void RGBColorFilter::applyToImage(osg::Image* image) const
+{
+    osg::Vec3f offset = getRGBOffset();
+    ImageUtils::PixelReader read(image);
+    ImageUtils::PixelWriter write(image);
+    for (int r = 0; r < image->r(); ++r)
+        for (int t = 0; t < image->t(); ++t)
+            for (int s = 0; s < image->s(); ++s)
+            {
+                osg::Vec4f c = read(s, t, r);
+                for (unsigned i = 0; i < 3; ++i)
+                    c[i] = osg::clampBetween(c[i] + offset[i], 0.0f, 1.0f);
+                write(c, s, t, r);
+            }
+}
+
 
 //---------------------------------------------------------------------------
 
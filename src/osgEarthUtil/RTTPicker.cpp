@@ -25,12 +25,33 @@
 
 #include <osgDB/WriteFile>
 #include <osg/BlendFunc>
+#include <osg/GLExtensions>
+#include <osg/Version>
+#include <cstring>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
 
 #define LC "[RTTPicker] "
 
+// Frames to wait for a readback before resolving a pick anyway
+// (e.g., if the pick camera did not render).
+#define MAX_PICK_LATENCY 8u
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3,6,0)
+#   define USE_READBACK_FENCES 1
+#endif
+
 namespace
 {
     // SHADERS for the RTT pick camera.
@@ -80,6 +101,190 @@ namespace
         "} \n";
 }
 
+namespace
+{
+    /**
+     * Image that the pick camera "reads back" into. Instead of a blocking
+     * glReadPixels, each frame starts an asynchronous copy into one of two
+     * pixel buffer objects, and copies out whichever earlier readback the
+     * GPU has finished. Pick results therefore arrive a frame or two later,
+     * without stalling the pipeline.
+     */
+    struct PickImage : public osg::Image
+    {
+        enum { NUM_PBOS = 2 };
+
+        PickImage() : _state(0L), _next(0u), _resultFrame(0u), _hasResult(false)
+        {
+            for(unsigned i=0; i<NUM_PBOS; ++i)
+            {
+                _pbo[i] = 0;
+                _frame[i] = 0u;
+                _pending[i] = false;
+#ifdef USE_READBACK_FENCES
+                _fence[i] = 0L;
+#endif
+            }
+        }
+
+        // Called by OSG on the draw thread, while the pick camera's FBO is bound.
+        void readPixels(int x, int y, int width, int height, GLenum pixelFormat, GLenum type, int packing)
+        {
+            if ( !_state )
+                return;
+
+            unsigned frame = _state->getFrameStamp() ? _state->getFrameStamp()->getFrameNumber() : 0u;
+            osg::GLExtensions* ext = _state->get<osg::GLExtensions>();
+
+            glPixelStorei(GL_PACK_ALIGNMENT, getPacking());
+
+            if ( !ext->isPBOSupported )
+            {
+                // no PBOs; read back synchronously.
+                Threading::ScopedMutexLock lock(_mutex);
+                glReadPixels(x, y, width, height, getPixelFormat(), getDataType(), data());
+                _resultFrame = frame;
+                _hasResult = true;
+                dirty();
+                return;
+            }
+
+            // we bind buffers directly, so make sure osg::State isn't tracking one.
+            _state->unbindPixelBufferObject();
+
+            // collect finished readbacks, oldest first:
+            for(unsigned n=0; n<NUM_PBOS; ++n)
+            {
+                unsigned i = (_next + n) % NUM_PBOS;
+                if ( _pending[i] && isComplete(ext, i, frame) )
+                {
+                    collect(ext, i);
+                }
+            }
+
+            // start a new readback. If every buffer is still in flight, skip
+            // this frame rather than wait on the GPU.
+            unsigned i = _next;
+            if ( _pending[i] )
+                return;
+
+            if ( _pbo[i] == 0 )
+            {
+                ext->glGenBuffers(1, &_pbo[i]);
+                ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, _pbo[i]);
+                ext->glBufferData(GL_PIXEL_PACK_BUFFER_ARB, getTotalSizeInBytes(), 0L, GL_STREAM_READ);
+            }
+            else
+            {
+                ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, _pbo[i]);
+            }
+
+            glReadPixels(x, y, width, height, getPixelFormat(), getDataType(), 0L);
+            ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+#ifdef USE_READBACK_FENCES
+            if ( ext->glFenceSync )
+                _fence[i] = ext->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+            _frame[i] = frame;
+            _pending[i] = true;
+            _next = (i+1) % NUM_PBOS;
+        }
+
+        // whether the GPU has finished the readback in buffer i.
+        bool isComplete(osg::GLExtensions* ext, unsigned i, unsigned frame) const
+        {
+#ifdef USE_READBACK_FENCES
+            if ( _fence[i] )
+            {
+                GLenum result = ext->glClientWaitSync(_fence[i], 0, 0);
+                return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+            }
+#endif
+            // no fences; assume a readback from an earlier frame is done.
+            return frame > _frame[i];
+        }
+
+        // copies the pixels from buffer i into the image.
+        void collect(osg::GLExtensions* ext, unsigned i)
+        {
+            ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, _pbo[i]);
+            const void* src = ext->glMapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+            if ( src )
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                ::memcpy(data(), src, getTotalSizeInBytes());
+                _resultFrame = _frame[i];
+                _hasResult = true;
+                dirty();
+            }
+            ext->glUnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+            ext->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+#ifdef USE_READBACK_FENCES
+            if ( _fence[i] )
+            {
+                ext->glDeleteSync(_fence[i]);
+                _fence[i] = 0L;
+            }
+#endif
+            _pending[i] = false;
+        }
+
+        void releaseGLObjects(osg::State* state) const
+        {
+            osg::Image::releaseGLObjects(state);
+
+            // GL objects belong to the pick camera's context; we can only
+            // delete them when that context is current.
+            if ( state && state == _state )
+            {
+                osg::GLExtensions* ext = state->get<osg::GLExtensions>();
+                for(unsigned i=0; i<NUM_PBOS; ++i)
+                {
+                    if ( _pbo[i] )
+                        ext->glDeleteBuffers(1, &_pbo[i]);
+                    _pbo[i] = 0;
+                    _pending[i] = false;
+#ifdef USE_READBACK_FENCES
+                    if ( _fence[i] )
+                        ext->glDeleteSync(_fence[i]);
+                    _fence[i] = 0L;
+#endif
+                }
+            }
+        }
+
+        osg::State*        _state;       // set by the pick camera's pre-draw callback
+        mutable GLuint     _pbo[NUM_PBOS];
+        unsigned           _frame[NUM_PBOS];
+        mutable bool       _pending[NUM_PBOS];
+#ifdef USE_READBACK_FENCES
+        mutable GLsync     _fence[NUM_PBOS];
+#endif
+        unsigned           _next;
+
+        // protects the image data and the result members below
+        Threading::Mutex   _mutex;
+        unsigned           _resultFrame; // frame in which the current pixels were rendered
+        bool               _hasResult;
+    };
+
+    // Tells the pick image which State it renders in.
+    struct PickImageDrawCallback : public osg::Camera::DrawCallback
+    {
+        PickImageDrawCallback(PickImage* image) : _image(image) { }
+
+        void operator()(osg::RenderInfo& ri) const
+        {
+            _image->_state = ri.getState();
+        }
+
+        PickImage* _image;
+    };
+}
+
 VirtualProgram* 
 RTTPicker::createRTTProgram()
 {    
@@ -156,8 +361,9 @@ RTTPicker::getOrCreatePickContext(osg::View* view)
 
     c._view = view;
 
-    c._image = new osg::Image();
-    c._image->allocateImage(_rttSize, _rttSize, 1, GL_RGBA, GL_UNSIGNED_BYTE);    
+    PickImage* image = new PickImage();
+    image->allocateImage(_rttSize, _rttSize, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    c._image = image;
     
     // make an RTT camera and bind it to our imag:
     c._pickCamera = new osg::Camera();
@@ -171,6 +377,10 @@ RTTPicker::getOrCreatePickContext(osg::View* view)
     c._pickCamera->setRenderTargetImplementation( osg::Camera::FRAME_BUFFER_OBJECT );
     c._pickCamera->attach( osg::Camera::COLOR_BUFFER0, c._image.get() );
     c._pickCamera->setSmallFeatureCullingPixelSize( -1.0f );
+    c._pickCamera->setPreDrawCallback( new PickImageDrawCallback(image) );
+
+    // only render when there are picks waiting for results.
+    c._pickCamera->setNodeMask( 0 );
     
     osg::StateSet* rttSS = c._pickCamera->getOrCreateStateSet();
 
@@ -222,6 +432,14 @@ RTTPicker::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIActionAdapter& aa)
         {
             aa.requestRedraw();
         }
+        else
+        {
+            // nothing to pick; stop rendering the pick cameras.
+            for(PickContextVector::iterator i = _pickContexts.begin(); i != _pickContexts.end(); ++i)
+            {
+                i->_pickCamera->setNodeMask( 0 );
+            }
+        }
 
         // synchronize the pick camera associated with this view
         osg::Camera* cam = aa.asView()->getCamera();
@@ -276,6 +494,9 @@ RTTPicker::pick(osg::View* view, float mouseX, float mouseY, Callback* callback)
 
     // install the RTT pick camera under this view's camera if it's not already:
     PickContext& context = getOrCreatePickContext( view );
+
+    // render the pick camera until the pick resolves:
+    context._pickCamera->setNodeMask( ~0 );
     
     // Create a new pick
     Pick pick;
@@ -294,10 +515,17 @@ RTTPicker::pick(osg::View* view, float mouseX, float mouseY, Callback* callback)
 void
 RTTPicker::runPicks(unsigned frameNumber)
 {
+    // Resolve every pick whose frame has been read back. All the picks
+    // queued in a frame share that frame's pick pass and readback.
     while( _picks.size() > 0 )
     {
         Pick& pick = _picks.front();
-        if ( frameNumber > pick._frame )
+        PickImage* image = static_cast<PickImage*>( pick._context->_image.get() );
+
+        Threading::ScopedMutexLock lock( image->_mutex );
+
+        bool ready = image->_hasResult && image->_resultFrame >= pick._frame;
+        if ( ready || frameNumber > pick._frame + MAX_PICK_LATENCY )
         {
             checkForPickResult(pick);
             _picks.pop();
@@ -361,6 +589,8 @@ namespace
 void
 RTTPicker::checkForPickResult(Pick& pick)
 {
+    // assume the image's mutex is locked.
+
     // decode the results
     osg::Image* image = pick._context->_image.get();
     ImageUtils::PixelReader read( image );
@@ -22,6 +22,7 @@
 #include <osgEarthUtil/RadialLineOfSight>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/DPLineSegmentIntersector>
+#include <osgEarth/ElevationRayCaster>
 #include <osgSim/LineOfSight>
 #include <osgUtil/IntersectionVisitor>
 #include <osgUtil/LineSegmentIntersector>
@@ -89,7 +90,8 @@ _outlineColor( 1.0f, 1.0f, 1.0f, 1.0f),
 _displayMode( LineOfSight::MODE_SPLIT ),
 //_altitudeMode( ALTMODE_ABSOLUTE ),
 _fill(false),
-_terrainOnly( false )
+_terrainOnly( false ),
+_useElevationData( false )
 {
     //compute(getNode());
     _terrainChangedCallback = new RadialLineOfSightNodeTerrainChangedCallback( this );
@@ -214,6 +216,22 @@ void RadialLineOfSightNode::setTerrainOnly( bool terrainOnly )
     }
 }
 
+bool
+RadialLineOfSightNode::getUseElevationData() const
+{
+    return _useElevationData;
+}
+
+void
+RadialLineOfSightNode::setUseElevationData( bool value )
+{
+    if (_useElevationData != value)
+    {
+        _useElevationData = value;
+        compute(getNode());
+    }
+}
+
 osg::Node*
 RadialLineOfSightNode::getNode()
 {
@@ -242,6 +260,49 @@ RadialLineOfSightNode::compute(osg::Node* node )
     }
 }
 
+void
+RadialLineOfSightNode::computeHits(osg::Node* node,
+                                   const std::vector<osg::Vec3d>& ends,
+                                   std::vector<osg::Vec3d>& out_hits,
+                                   std::vector<bool>& out_blocked)
+{
+    if (_useElevationData)
+    {
+        // every spoke is sampled in one batch against the elevation data
+        ElevationRayCaster caster( getMapNode()->getMap() );
+        std::vector<osg::Vec3d> starts( ends.size(), _centerWorld );
+        caster.intersect( starts, ends, out_hits, out_blocked );
+        return;
+    }
+
+    out_hits.assign( ends.size(), osg::Vec3d() );
+    out_blocked.assign( ends.size(), false );
+
+    osg::ref_ptr<osgUtil::IntersectorGroup> ivGroup = new osgUtil::IntersectorGroup();
+
+    for (unsigned int i = 0; i < ends.size(); i++)
+    {
+        osg::ref_ptr<DPLineSegmentIntersector> dplsi = new DPLineSegmentIntersector( _centerWorld, ends[i] );
+        ivGroup->addIntersector( dplsi.get() );
+    }
+
+    osgUtil::IntersectionVisitor iv;
+    iv.setIntersector( ivGroup.get() );
+
+    node->accept( iv );
+
+    for (unsigned int i = 0; i < ends.size(); i++)
+    {
+        DPLineSegmentIntersector* los = static_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[i].get());
+        DPLineSegmentIntersector::Intersections& hits = los->getIntersections();
+        if ( !hits.empty() )
+        {
+            out_blocked[i] = true;
+            out_hits[i] = hits.begin()->getWorldIntersectPoint();
+        }
+    }
+}
+
 void
 RadialLineOfSightNode::compute_line(osg::Node* node)
 {    
@@ -278,40 +339,28 @@ RadialLineOfSightNode::compute_line(osg::Node* node)
     osg::Vec3d previousEnd;
     osg::Vec3d firstEnd;
 
-    osg::ref_ptr<osgUtil::IntersectorGroup> ivGroup = new osgUtil::IntersectorGroup();
+    std::vector<osg::Vec3d> ends;
+    ends.reserve(_numSpokes);
 
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
         double angle = delta * (double)i;
         osg::Quat quat(angle, up );
         osg::Vec3d spoke = quat * (side * _radius);
-        osg::Vec3d end = _centerWorld + spoke;
-        osg::ref_ptr<DPLineSegmentIntersector> dplsi = new DPLineSegmentIntersector( _centerWorld, end );
-        ivGroup->addIntersector( dplsi.get() );
+        ends.push_back( _centerWorld + spoke );
     }
 
-    osgUtil::IntersectionVisitor iv;
-    iv.setIntersector( ivGroup.get() );
-
-    node->accept( iv );
+    std::vector<osg::Vec3d> hits;
+    std::vector<bool> blocked;
+    computeHits( node, ends, hits, blocked );
 
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
-        DPLineSegmentIntersector* los = dynamic_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[i].get());
-        if ( !los )
-            continue;
+        osg::Vec3d start = _centerWorld;
+        osg::Vec3d end = ends[i];
 
-        DPLineSegmentIntersector::Intersections& hits = los->getIntersections();
-
-        osg::Vec3d start = los->getStart();
-        osg::Vec3d end = los->getEnd();
-
-        osg::Vec3d hit;
-        bool hasLOS = hits.empty();
-        if (!hasLOS)
-        {
-            hit = hits.begin()->getWorldIntersectPoint();
-        }
+        osg::Vec3d hit = hits[i];
+        bool hasLOS = !blocked[i];
 
         if (hasLOS)
         {
@@ -421,46 +470,35 @@ RadialLineOfSightNode::compute_fill(osg::Node* node)
     geometry->setColorArray( colors );
     geometry->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
 
-    osg::ref_ptr<osgUtil::IntersectorGroup> ivGroup = new osgUtil::IntersectorGroup();
+    std::vector<osg::Vec3d> ends;
+    ends.reserve(_numSpokes);
 
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
         double angle = delta * (double)i;
         osg::Quat quat(angle, up );
         osg::Vec3d spoke = quat * (side * _radius);
-        osg::Vec3d end = _centerWorld + spoke;        
-        osg::ref_ptr<DPLineSegmentIntersector> dplsi = new DPLineSegmentIntersector( _centerWorld, end );
-        if (dplsi)
-            ivGroup->addIntersector( dplsi.get() );
+        ends.push_back( _centerWorld + spoke );
     }
 
-    osgUtil::IntersectionVisitor iv;
-    iv.setIntersector( ivGroup.get() );
-
-    node->accept( iv );
+    std::vector<osg::Vec3d> hits;
+    std::vector<bool> blocked;
+    computeHits( node, ends, hits, blocked );
 
     for (unsigned int i = 0; i < (unsigned int)_numSpokes; i++)
     {
         //Get the current hit
-        DPLineSegmentIntersector* los = dynamic_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[i].get());
-        if ( !los )
-            continue;
-
-        DPLineSegmentIntersector::Intersections& hits = los->getIntersections();
-
-        osg::Vec3d currEnd = los->getEnd();
-        bool currHasLOS = hits.empty();
-        osg::Vec3d currHit = currHasLOS ? osg::Vec3d() : hits.begin()->getWorldIntersectPoint();
+        osg::Vec3d currEnd = ends[i];
+        bool currHasLOS = !blocked[i];
+        osg::Vec3d currHit = currHasLOS ? osg::Vec3d() : hits[i];
 
         //Get the next hit
         unsigned int nextIndex = i + 1;
         if (nextIndex == _numSpokes) nextIndex = 0;
-        DPLineSegmentIntersector* losNext = static_cast<DPLineSegmentIntersector*>(ivGroup->getIntersectors()[nextIndex].get());
-        DPLineSegmentIntersector::Intersections& hitsNext = losNext->getIntersections();
 
-        osg::Vec3d nextEnd = losNext->getEnd();
-        bool nextHasLOS = hitsNext.empty();
-        osg::Vec3d nextHit = nextHasLOS ? osg::Vec3d() : hitsNext.begin()->getWorldIntersectPoint();
+        osg::Vec3d nextEnd = ends[nextIndex];
+        bool nextHasLOS = !blocked[nextIndex];
+        osg::Vec3d nextHit = nextHasLOS ? osg::Vec3d() : hits[nextIndex];
         
         if (currHasLOS && nextHasLOS)
         {
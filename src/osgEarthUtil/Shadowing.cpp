@@ -42,8 +42,13 @@ _size         ( 2048 ),
 _texImageUnit ( 7 ),
 _blurFactor   ( 0.001f ),
 _color        ( 0.4f ),
-_traversalMask( ~0 )
+_traversalMask( ~0 ),
+_cacheEnabled ( false ),
+_cacheMargin  ( 0.25f ),
+_staggered    ( false )
 {
+    setLightMovementThreshold( 0.1f );
+
     _castingGroup = new osg::Group();
 
     _supported = Registry::capabilities().supportsGLSL();
@@ -99,6 +104,20 @@ ShadowCaster::setShadowColor(float value)
         _shadowColorUniform->set(value);
 }
 
+void
+ShadowCaster::setLightMovementThreshold(float degrees)
+{
+    _lightMovementThreshold = degrees;
+    dirty();
+}
+
+void
+ShadowCaster::dirty()
+{
+    for(unsigned i=0; i<_slices.size(); ++i)
+        _slices[i]._valid = false;
+}
+
 void
 ShadowCaster::reinitialize()
 {
@@ -107,6 +126,7 @@ ShadowCaster::reinitialize()
 
     _shadowmap = 0L;
     _rttCameras.clear();
+    _slices.clear();
 
     int numSlices = (int)_ranges.size() - 1;
     if ( numSlices < 1 )
@@ -143,6 +163,8 @@ ShadowCaster::reinitialize()
         _rttCameras.push_back(rtt);
     }
 
+    _slices.resize( numSlices );
+
     _rttStateSet = new osg::StateSet();
 
     // only draw back faces to the shadow depth map
@@ -222,6 +244,26 @@ ShadowCaster::traverse(osg::NodeVisitor& nv)
             lightUp.normalize();
             lightViewMat.makeLookAt(lightPosWorld, lightPosWorld+lightVectorWorld, lightUp);
             
+            unsigned frame = nv.getFrameStamp() ? nv.getFrameStamp()->getFrameNumber() : 0u;
+
+            // Re-render every kept cascade if the light turned or the casters changed.
+            if ( _cacheEnabled || _staggered )
+            {
+                const osg::BoundingSphere& casterBound = _castingGroup->getBound();
+                double cosThreshold = cos( osg::DegreesToRadians((double)_lightMovementThreshold) );
+
+                if (lightVectorWorld * _cachedLightVector < cosThreshold ||
+                    casterBound.center() != _cachedCasterBound.center() ||
+                    casterBound.radius() != _cachedCasterBound.radius())
+                {
+                    dirty();
+                    _cachedLightVector = lightVectorWorld;
+                    _cachedCasterBound = casterBound;
+                }
+            }
+
+            std::vector<bool> renderSlice( _rttCameras.size(), true );
+
             //int i = nv.getFrameStamp()->getFrameNumber() % (_ranges.size()-1);
             int i;
             for(i=0; i < (int) _ranges.size()-1; ++i)
@@ -246,21 +288,66 @@ ShadowCaster::traverse(osg::NodeVisitor& nv)
                 std::vector<osg::Vec3d> verts;
                 frustumPH.getPoints( verts );
 
-                // project those on to the plane of the light camera and fit them
-                // to a bounding box. That box will form the extent of our orthographic camera.
-                osg::BoundingBoxd bbox;
-                for( std::vector<osg::Vec3d>::iterator v = verts.begin(); v != verts.end(); ++v )
-                    bbox.expandBy( (*v) * lightViewMat );
-
-                osg::Matrix lightProjMat;
-                n = -std::max(bbox.zMin(), bbox.zMax());
-                f = -std::min(bbox.zMin(), bbox.zMax());
-                // TODO: consider extending "n" so that objects outside the main view can still cast shadows
-                lightProjMat.makeOrtho(bbox.xMin(), bbox.xMax(), bbox.yMin(), bbox.yMax(), n, f);
-
-                // configure the RTT camera for this slice:
-                _rttCameras[i]->setViewMatrix( lightViewMat );
-                _rttCameras[i]->setProjectionMatrix( lightProjMat );
+                Slice& slice = _slices[i];
+
+                // Decide whether the shadow map this cascade already holds will do:
+                // either it isn't this cascade's turn to update yet, or (when caching)
+                // the slice of the view still fits inside the area it was rendered for.
+                bool reuse = false;
+                if ( slice._valid )
+                {
+                    bool due = !_staggered || (frame - slice._frame) >= (unsigned)(i+1);
+                    if ( !due )
+                    {
+                        reuse = true;
+                    }
+                    else if ( _cacheEnabled )
+                    {
+                        osg::BoundingBoxd box;
+                        for( std::vector<osg::Vec3d>::iterator v = verts.begin(); v != verts.end(); ++v )
+                            box.expandBy( (*v) * slice._viewMatrix );
+
+                        reuse =
+                            slice._lightSpaceBox.contains(box._min) &&
+                            slice._lightSpaceBox.contains(box._max);
+                    }
+                }
+
+                if ( !reuse )
+                {
+                    // project those on to the plane of the light camera and fit them
+                    // to a bounding box. That box will form the extent of our orthographic camera.
+                    osg::BoundingBoxd bbox;
+                    for( std::vector<osg::Vec3d>::iterator v = verts.begin(); v != verts.end(); ++v )
+                        bbox.expandBy( (*v) * lightViewMat );
+
+                    // a kept cascade covers a little more than the view needs, so
+                    // the camera can move a bit before it has to render again.
+                    if ( _cacheEnabled )
+                    {
+                        osg::Vec3d pad = (bbox._max - bbox._min) * (0.5 * _cacheMargin);
+                        bbox._min -= pad;
+                        bbox._max += pad;
+                    }
+
+                    osg::Matrix lightProjMat;
+                    n = -std::max(bbox.zMin(), bbox.zMax());
+                    f = -std::min(bbox.zMin(), bbox.zMax());
+                    // TODO: consider extending "n" so that objects outside the main view can still cast shadows
+                    lightProjMat.makeOrtho(bbox.xMin(), bbox.xMax(), bbox.yMin(), bbox.yMax(), n, f);
+
+                    // configure the RTT camera for this slice:
+                    _rttCameras[i]->setViewMatrix( lightViewMat );
+                    _rttCameras[i]->setProjectionMatrix( lightProjMat );
+
+                    slice._valid         = true;
+                    slice._frame         = frame;
+                    slice._viewMatrix    = lightViewMat;
+                    slice._projMatrix    = lightProjMat;
+                    slice._lightSpaceBox = bbox;
+                }
+
+                renderSlice[i] = !reuse;
 
                 // this xforms from clip [-1..1] to texture [0..1] space
                 static osg::Matrix s_scaleBiasMat = 
@@ -270,7 +357,7 @@ ShadowCaster::traverse(osg::NodeVisitor& nv)
                 // set the texture coordinate generation matrix that the shadow
                 // receiver will use to sample the shadow map. Doing this on the CPU
                 // prevents nasty precision issues!
-                osg::Matrix VPS = lightViewMat * lightProjMat * s_scaleBiasMat;
+                osg::Matrix VPS = slice._viewMatrix * slice._projMatrix * s_scaleBiasMat;
                 _shadowMapTexGenUniform->setElement(i, inverseMV * VPS);
             }
 
@@ -282,7 +369,8 @@ ShadowCaster::traverse(osg::NodeVisitor& nv)
             cv->pushStateSet( _rttStateSet.get() );
             for(i=0; i < (int) _rttCameras.size(); ++i)
             {
-                _rttCameras[i]->accept( nv );
+                if ( renderSlice[i] )
+                    _rttCameras[i]->accept( nv );
             }
             cv->popStateSet();
 
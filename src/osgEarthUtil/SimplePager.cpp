@@ -21,6 +21,8 @@ namespace
      */
     struct ProgressMaster : public osg::NodeCallback
     {
+        ProgressMaster() : _frame(0u), _canCancel(true) { }
+
         unsigned _frame;
         bool _canCancel;
 
@@ -49,7 +51,7 @@ namespace
         {
             osg::ref_ptr<ProgressMaster> master;
             if (!_master.lock(master)) return true;
-            if (!_master->_canCancel) return false;
+            if (!master->_canCancel) return false;
             return (master->_frame - _lastFrame > 1u);
         }
 
@@ -232,8 +234,16 @@ osg::Node* SimplePager::createPagedNode(const TileKey& key, ProgressCallback* pr
     // only create real node if we are at least at the min LOD:
     if ( key.getLevelOfDetail() >= _minLevel )
     {
+        // the parent tile left view before we got here; don't bother.
+        if ( progress && progress->isCanceled() )
+            return 0L;
+
         node = createNode( key, progress );
 
+        // or it left while createNode was running; drop the result.
+        if ( progress && progress->isCanceled() )
+            return 0L;
+
         if ( node.valid() )
         {
             tileBounds = node->getBound();
@@ -330,6 +340,13 @@ osg::Node* SimplePager::loadKey(const TileKey& key, ProgressTracker* tracker)
         {
             group->addChild( plod );
         }
+
+        // Abandon the request if it went stale. Returning nothing leaves the
+        // parent unloaded, so the pager asks again if it comes back into view.
+        if ( tracker->_progress[i]->isCanceled() )
+        {
+            return 0L;
+        }
     }
     if (group->getNumChildren() > 0)
     {
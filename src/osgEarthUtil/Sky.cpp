@@ -54,7 +54,11 @@ SkyNode::~SkyNode()
 void
 SkyNode::baseInit(const SkyOptions& options)
 {
-    _ephemeris = new Ephemeris();
+    if ( options.ephemerisInterval().isSet() && options.ephemerisInterval().get() > 0u )
+        _ephemeris = new AsyncEphemeris( new Ephemeris(), options.ephemerisInterval().get() );
+    else
+        _ephemeris = new Ephemeris();
+
     _sunVisible = true;
     _moonVisible = true;
     _starsVisible = true;
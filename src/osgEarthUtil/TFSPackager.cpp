@@ -22,6 +22,9 @@
 #include <osgEarthUtil/TFSPackager>
 
 #include <osgEarth/Registry>
+#include <osgEarth/TaskService>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarthFeatures/MVT>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgEarth/FileUtils>
@@ -37,8 +40,6 @@ using namespace osgEarth::Util;
 class FeatureTileVisitor;
 class FeatureTile;
 
-typedef std::list< osgEarth::Features::FeatureID > FeatureIDList;
-
 class FeatureTile : public osg::Referenced
 {
 public:
@@ -85,14 +86,15 @@ public:
           }
       }
 
-      FeatureIDList& getFeatures()
+      // Features (in the output SRS, not yet cropped) that belong to this tile.
+      FeatureList& getFeatures()
       {
           return _features;
       }
 
 
 private:    
-    FeatureIDList _features;
+    FeatureList _features;
     TileKey _key;   
     osg::ref_ptr<FeatureTile> _children[4];
     bool _isSplit;
@@ -171,8 +173,8 @@ public:
 
                       if (!features.empty() && clone->getGeometry() && clone->getGeometry()->isValid())
                       {
-                          //tile->getFeatures().push_back( clone );
-                          tile->getFeatures().push_back( clone->getFID() );
+                          // keep the uncropped feature; it's cropped again when the tile is written.
+                          tile->getFeatures().push_back( _feature.get() );
                           _added = true;
                           _levelAdded = tile->getKey().getLevelOfDetail();
                           _numAdded++;                   
@@ -211,80 +213,197 @@ public:
 
 
 /******************************************************************************************/
-class WriteFeaturesVisitor : public FeatureTileVisitor
+class CollectTilesVisitor : public FeatureTileVisitor
 {
 public:
-    WriteFeaturesVisitor(FeatureSource* features, const std::string& dest, CropFilter::Method cropMethod, const SpatialReference* srs):
-      _dest( dest ),
-          _features( features ),
-          _cropMethod( cropMethod ),
-          _srs( srs )
-      {
+    virtual void traverse( FeatureTile* tile)
+    {
+        if (tile->getFeatures().size() > 0)
+        {
+            _tiles.push_back( tile );
+        }
+        tile->traverse( this );
+    }
 
-      }
+    std::vector< osg::ref_ptr< FeatureTile > > _tiles;
+};
 
-      virtual void traverse( FeatureTile* tile)
-      {
-          if (tile->getFeatures().size() > 0)
-          {                 
-              //Actually load up the features
-              FeatureList features;
-              for (FeatureIDList::const_iterator i = tile->getFeatures().begin(); i != tile->getFeatures().end(); i++)
-              {
-                  Feature* f = _features->getFeature( *i );                  
+/******************************************************************************************/
+namespace
+{
+    double distance2(const osg::Vec3d& p, const osg::Vec3d& a, const osg::Vec3d& b)
+    {
+        double dx = b.x() - a.x(), dy = b.y() - a.y();
+        double len2 = dx*dx + dy*dy;
+        double t = len2 > 0.0 ? osg::clampBetween(((p.x() - a.x())*dx + (p.y() - a.y())*dy) / len2, 0.0, 1.0) : 0.0;
+        double ex = a.x() + t*dx - p.x(), ey = a.y() + t*dy - p.y();
+        return ex*ex + ey*ey;
+    }
 
-                  if (f)
-                  {
-                      //Reproject the feature to the dest SRS if it's not already
-                      if (!f->getSRS()->isEquivalentTo( _srs ) )
-                      {
-                          f->transform( _srs );
-                      }
-                      features.push_back( f );
-                  }
-                  else
-                  {
-                      OE_NOTICE << "couldn't get feature " << *i << std::endl;
-                  }
-              }
+    // Douglas-Peucker simplification of a single line or ring, in place.
+    void simplifyPart(Geometry* part, double tolerance2)
+    {
+        bool ring = part->getType() == Geometry::TYPE_RING || part->getType() == Geometry::TYPE_POLYGON;
+        unsigned minPoints = ring ? 3u : 2u;
+        if (part->size() <= minPoints)
+            return;
 
-              //Need to do the cropping again since these are brand new features coming from the feature source.
-              CropFilter cropFilter(_cropMethod);
-              FilterContext context(0);
-              context.extent() = tile->getExtent();
-              cropFilter.push( features, context );
+        std::vector<char> keep( part->size(), 0 );
+        keep.front() = keep.back() = 1;
 
-              std::string contents = Feature::featuresToGeoJSON( features );
-              std::stringstream buf;
-              int x =  tile->getKey().getTileX();
-              unsigned int numRows, numCols;
-              tile->getKey().getProfile()->getNumTiles(tile->getKey().getLevelOfDetail(), numCols, numRows);
-              int y  = numRows - tile->getKey().getTileY() - 1;
+        std::vector< std::pair<unsigned,unsigned> > stack;
+        stack.push_back( std::make_pair(0u, (unsigned)part->size()-1) );
+        while (!stack.empty())
+        {
+            unsigned a = stack.back().first, b = stack.back().second;
+            stack.pop_back();
 
-              buf << _dest << "/" << tile->getKey().getLevelOfDetail() << "/" << x << "/" << y << ".json";
-              std::string filename = buf.str();
-              //OE_NOTICE << "Writing " << features.size() << " features to " << filename << std::endl;
+            double maxDist2 = 0.0;
+            unsigned index = a;
+            for (unsigned i = a + 1; i < b; ++i)
+            {
+                double d2 = distance2((*part)[i], (*part)[a], (*part)[b]);
+                if (d2 > maxDist2)
+                {
+                    maxDist2 = d2;
+                    index = i;
+                }
+            }
 
-              if ( !osgDB::fileExists( osgDB::getFilePath(filename) ) )
-                  osgEarth::makeDirectoryForFile( filename );
+            if (maxDist2 > tolerance2)
+            {
+                keep[index] = 1;
+                stack.push_back( std::make_pair(a, index) );
+                stack.push_back( std::make_pair(index, b) );
+            }
+        }
 
+        unsigned n = 0;
+        for (unsigned i = 0; i < keep.size(); ++i)
+            n += keep[i];
 
-              std::fstream output( filename.c_str(), std::ios_base::out );
-              if ( output.is_open() )
-              {
-                  output << contents;
-                  output.flush();
-                  output.close();                
-              }            
-          }
-          tile->traverse( this );        
-      }
+        // don't collapse a ring into a sliver.
+        if (n < minPoints)
+            return;
 
-      osg::ref_ptr< FeatureSource > _features;
-      std::string _dest;      
-      CropFilter::Method _cropMethod;
-      osg::ref_ptr< const SpatialReference > _srs;
-};
+        unsigned j = 0;
+        for (unsigned i = 0; i < part->size(); ++i)
+            if (keep[i])
+                (*part)[j++] = (*part)[i];
+        part->resize( j );
+    }
+
+    void simplify(FeatureList& features, double tolerance)
+    {
+        double tolerance2 = tolerance * tolerance;
+        for (FeatureList::iterator f = features.begin(); f != features.end(); ++f)
+        {
+            Geometry* geom = f->get()->getGeometry();
+            if (!geom)
+                continue;
+
+            GeometryIterator parts( geom, true );
+            while (parts.hasMore())
+            {
+                Geometry* part = parts.next();
+                if (part->getType() != Geometry::TYPE_POINTSET)
+                    simplifyPart( part, tolerance2 );
+            }
+        }
+    }
+
+    /**
+     * Crops, simplifies, encodes and writes the features of one tile.
+     * Shared by all the writer threads.
+     */
+    struct TileWriter
+    {
+        std::string        _dest;
+        std::string        _format;
+        std::string        _layerName;
+        CropFilter::Method _cropMethod;
+        double             _simplification;
+        Threading::Mutex   _dirMutex;
+
+        void write( FeatureTile* tile )
+        {
+            // Work on copies: with cropping, one feature can belong to several tiles.
+            FeatureList features;
+            for (FeatureList::const_iterator i = tile->getFeatures().begin(); i != tile->getFeatures().end(); ++i)
+            {
+                features.push_back( new Feature( *i->get(), osg::CopyOp::DEEP_COPY_ALL ) );
+            }
+
+            CropFilter cropFilter(_cropMethod);
+            FilterContext context(0);
+            context.extent() = tile->getExtent();
+            cropFilter.push( features, context );
+
+            if (_simplification > 0.0)
+            {
+                simplify( features, tile->getExtent().width() * _simplification );
+            }
+
+            std::string contents;
+            if (_format == "pbf")
+            {
+                // already simplified above; only drop points that quantize together.
+                if (!MVT::write( features, tile->getKey(), _layerName, contents, 4096u, 0.0 ))
+                    return;
+            }
+            else
+            {
+                contents = Feature::featuresToGeoJSON( features );
+            }
+
+            std::stringstream buf;
+            int x =  tile->getKey().getTileX();
+            unsigned int numRows, numCols;
+            tile->getKey().getProfile()->getNumTiles(tile->getKey().getLevelOfDetail(), numCols, numRows);
+            int y  = numRows - tile->getKey().getTileY() - 1;
+
+            buf << _dest << "/" << tile->getKey().getLevelOfDetail() << "/" << x << "/" << y << "." << _format;
+            std::string filename = buf.str();
+
+            {
+                Threading::ScopedMutexLock lock( _dirMutex );
+                if ( !osgDB::fileExists( osgDB::getFilePath(filename) ) )
+                    osgEarth::makeDirectoryForFile( filename );
+            }
+
+            std::fstream output( filename.c_str(), std::ios_base::out | std::ios_base::binary );
+            if ( output.is_open() )
+            {
+                output << contents;
+                output.flush();
+                output.close();                
+            }            
+        }
+    };
+
+    // Writes one tile; run as a ParallelTask.
+    struct WriteTile
+    {
+        WriteTile() : _writer(0L) { }
+
+        void execute()
+        {
+            _writer->write( _tile.get() );
+            _tile = 0L;
+        }
+
+        TileWriter*               _writer;
+        osg::ref_ptr<FeatureTile> _tile;
+    };
+    typedef ParallelTask<WriteTile> WriteTileTask;
+
+    // Tile writes share the registry's thread budget under this UID.
+    TaskService* getWriteService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+}
 
 
 
@@ -294,7 +413,10 @@ TFSPackager::TFSPackager():
 _firstLevel( 0 ),
     _maxLevel( 10 ),
     _maxFeatures( 300 ),
-    _method( CropFilter::METHOD_CENTROID )
+    _method( CropFilter::METHOD_CENTROID ),
+    _format( "json" ),
+    _simplification( 0.0 ),
+    _numThreads( 4 )
 {
 }
 
@@ -382,8 +504,40 @@ void
     }
 #endif
 
-    WriteFeaturesVisitor write(features, destination, _method, _srs);
-    root->accept( &write );
+    // Every feature now sits in its tile's bucket, so the tiles can be
+    // written independently without going back to the feature source.
+    CollectTilesVisitor collect;
+    root->accept( &collect );
+
+    TileWriter writer;
+    writer._dest = destination;
+    writer._format = _format;
+    writer._layerName = layername;
+    writer._cropMethod = _method;
+    writer._simplification = _simplification;
+
+    OE_NOTICE << "Writing " << collect._tiles.size() << " tiles" << std::endl;
+
+    if (_numThreads > 0 && !collect._tiles.empty())
+    {
+        Threading::MultiEvent done( collect._tiles.size() );
+        TaskService* service = getWriteService();
+        for (unsigned i = 0; i < collect._tiles.size(); ++i)
+        {
+            WriteTileTask* task = new WriteTileTask( &done );
+            task->_writer = &writer;
+            task->_tile = collect._tiles[i].get();
+            service->add( task );
+        }
+        done.wait();
+    }
+    else
+    {
+        for (unsigned i = 0; i < collect._tiles.size(); ++i)
+        {
+            writer.write( collect._tiles[i].get() );
+        }
+    }
 
     //Write out the meta doc
     TFSLayer layer;
@@ -28,6 +28,9 @@
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/WriteFile>
+#include <osgDB/Registry>
+#include <fstream>
+#include <sstream>
 
 
 #define LC "[TMSPackager] "
@@ -35,6 +38,47 @@
 using namespace osgEarth::Util;
 using namespace osgEarth;
 
+namespace
+{
+    // Encodes a tile on one of the packager's encode threads.
+    struct EncodeTileTask : public TaskRequest
+    {
+        EncodeTileTask(TMSPackager* packager, const TileKey& key, osg::Image* image, const std::string& path) :
+            _packager(packager), _key(key), _image(image), _path(path) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            _packager->encodeTile(_key, _image.get(), _path);
+            _image = 0L;
+        }
+
+        TMSPackager*              _packager;
+        TileKey                   _key;
+        osg::ref_ptr<osg::Image>  _image;
+        std::string               _path;
+    };
+
+    // Stores a tile on one of the packager's write threads.
+    struct WriteTileTask : public TaskRequest
+    {
+        WriteTileTask(TMSPackager* packager, const TileKey& key, osg::Image* image, const std::string& data, const std::string& path) :
+            _packager(packager), _key(key), _image(image), _data(data), _path(path) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            _packager->tileDone( _packager->writeTile(_key, _image.get(), _data, _path) );
+            _image = 0L;
+            _data.clear();
+        }
+
+        TMSPackager*              _packager;
+        TileKey                   _key;
+        osg::ref_ptr<osg::Image>  _image;
+        std::string               _data;
+        std::string               _path;
+    };
+}
+
 WriteTMSTileHandler::WriteTMSTileHandler(TerrainLayer* layer,  Map* map, TMSPackager* packager):
     _layer( layer ),
     _map(map),
@@ -114,18 +158,7 @@ bool WriteTMSTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
                 final = ImageUtils::convertToRGB8( final );
             }
 
-            // use the TileSource provided if set, else use writeImageFile
-            if (tileSource)
-            {
-                tileSource->storeImage(key, final.get(), 0L);
-                return true;
-            }
-            else
-            {
-                // attempt to create the output folder:
-                osgEarth::makeDirectoryForFile( path );
-                return osgDB::writeImageFile(*final, path, _packager->getOptions());
-            }
+            return _packager->submitTile( key, final.get(), path );
         }
     }
     else if (elevationLayer )
@@ -137,18 +170,7 @@ bool WriteTMSTileHandler::handleTile(const TileKey& key, const TileVisitor& tv)
             ImageToHeightFieldConverter conv;
             osg::ref_ptr< osg::Image > image = conv.convert( hf.getHeightField(), _packager->getElevationPixelDepth() );
 
-            // use the TileSource provided if set, else use writeImageFile
-            if (tileSource)
-            {
-                tileSource->storeImage(key, image.get(), 0L);
-                return true;
-            }
-            else
-            {
-                // attempt to create the output folder:
-                osgEarth::makeDirectoryForFile( path );
-                return osgDB::writeImageFile(*image.get(), path, _packager->getOptions());
-            }
+            return _packager->submitTile( key, image.get(), path );
         }
     }
 
@@ -224,6 +246,17 @@ std::string WriteTMSTileHandler::getProcessString() const
     {
         buf << " --alpha-mask ";
     }
+    if (!_packager->getTextureCompression().empty())
+    {
+        buf << " --compress " << _packager->getTextureCompression() << " ";
+    }
+    buf << " --encode-threads " << _packager->getNumEncodeThreads() << " ";
+    buf << " --write-threads " << _packager->getNumWriteThreads() << " ";
+    buf << " --queue-size " << _packager->getMaxQueuedTiles() << " ";
+    if (_packager->getWriteMBTiles())
+    {
+        buf << " --mbtiles ";
+    }
     return buf.str();
 }
 
@@ -240,7 +273,11 @@ _visitor(new TileVisitor()),
     _overwrite(false),
     _keepEmpties(false),
     _applyAlphaMask(false),
-    _tileSource(0L)
+    _tileSource(0L),
+    _numEncodeThreads(2),
+    _numWriteThreads(2),
+    _maxQueuedTiles(64),
+    _writeMBTiles(false)
 {
 }
 
@@ -334,6 +371,182 @@ void TMSPackager::setApplyAlphaMask(bool applyAlphaMask)
     _applyAlphaMask = applyAlphaMask;
 }
 
+const std::string& TMSPackager::getTextureCompression() const
+{
+    return _textureCompression;
+}
+
+void TMSPackager::setTextureCompression(const std::string& processor)
+{
+    _textureCompression = processor;
+}
+
+bool TMSPackager::getWriteMBTiles() const
+{
+    return _writeMBTiles;
+}
+
+void TMSPackager::setWriteMBTiles(bool value)
+{
+    _writeMBTiles = value;
+}
+
+std::string TMSPackager::getMBTilesFilename(const std::string& layerName) const
+{
+    return osgDB::concatPaths( _destination, toLegalFileName(layerName) + ".mbtiles" );
+}
+
+unsigned TMSPackager::getNumEncodeThreads() const
+{
+    return _numEncodeThreads;
+}
+
+void TMSPackager::setNumEncodeThreads(unsigned value)
+{
+    _numEncodeThreads = value;
+}
+
+unsigned TMSPackager::getNumWriteThreads() const
+{
+    return _numWriteThreads;
+}
+
+void TMSPackager::setNumWriteThreads(unsigned value)
+{
+    _numWriteThreads = value;
+}
+
+unsigned TMSPackager::getMaxQueuedTiles() const
+{
+    return _maxQueuedTiles;
+}
+
+void TMSPackager::setMaxQueuedTiles(unsigned value)
+{
+    _maxQueuedTiles = osg::maximum(value, 1u);
+}
+
+bool TMSPackager::submitTile(const TileKey& key, osg::Image* image, const std::string& path)
+{
+    ++_tilesInFlight;
+
+    if (_encodeService.valid())
+    {
+        // blocks while the encode queue is full.
+        _encodeService->add( new EncodeTileTask(this, key, image, path) );
+        return true;
+    }
+
+    return encodeTile(key, image, path);
+}
+
+bool TMSPackager::encodeTile(const TileKey& key, osg::Image* image, const std::string& path)
+{
+    osg::ref_ptr< osg::Image > final = image;
+
+    // pre-encode for the GPU if requested
+    if ( !_textureCompression.empty() && !ImageUtils::isCompressed(final.get()) )
+    {
+        // never compress in place; the image may live in a layer's cache.
+        if ( !ImageUtils::hasAlphaChannel(final.get()) )
+            final = ImageUtils::convertToRGB8( final.get() );
+        else if ( final->getPixelFormat() != GL_RGBA || final->getDataType() != GL_UNSIGNED_BYTE )
+            final = ImageUtils::convertToRGBA8( final.get() );
+        else
+            final = ImageUtils::cloneImage( final.get() );
+
+        if ( !final.valid() || !ImageUtils::compressImageInPlace(final.get(), _textureCompression, true) )
+        {
+            OE_WARN << LC << "Failed to compress image for key " << key.str() << std::endl;
+            tileDone(false);
+            return false;
+        }
+    }
+
+    // A TileSource takes the image itself; otherwise encode it to the file format.
+    std::string data;
+    if (!_tileSource.valid())
+    {
+        osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension( _extension );
+        if ( !rw )
+        {
+            OE_WARN << LC << "No plugin to write \"" << _extension << "\" files" << std::endl;
+            tileDone(false);
+            return false;
+        }
+
+        std::stringstream buf;
+        osgDB::ReaderWriter::WriteResult wr = rw->writeImage( *final.get(), buf, _writeOptions.get() );
+        if ( !wr.success() )
+        {
+            OE_WARN << LC << "Failed to encode image for key " << key.str() << ": " << wr.message() << std::endl;
+            tileDone(false);
+            return false;
+        }
+        data = buf.str();
+        final = 0L;
+    }
+
+    if (_writeService.valid())
+    {
+        // blocks while the write queue is full.
+        _writeService->add( new WriteTileTask(this, key, final.get(), data, path) );
+        return true;
+    }
+
+    bool ok = writeTile(key, final.get(), data, path);
+    tileDone(ok);
+    return ok;
+}
+
+bool TMSPackager::writeTile(const TileKey& key, osg::Image* image, const std::string& data, const std::string& path)
+{
+    if (_tileSource.valid())
+    {
+        _tileSource->storeImage(key, image, 0L);
+        return true;
+    }
+
+    // attempt to create the output folder:
+    osgEarth::makeDirectoryForFile( path );
+
+    std::ofstream out( path.c_str(), std::ios::out | std::ios::binary );
+    if ( out.is_open() )
+    {
+        out.write( data.c_str(), data.size() );
+    }
+
+    if ( !out.is_open() || out.fail() )
+    {
+        OE_WARN << LC << "Failed to write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void TMSPackager::tileDone(bool ok)
+{
+    if (!ok)
+        ++_tilesFailed;
+    --_tilesInFlight;
+}
+
+void TMSPackager::drain()
+{
+    while (_tilesInFlight > 0)
+    {
+        OpenThreads::Thread::microSleep(10000);
+    }
+
+    _encodeService = 0L;
+    _writeService = 0L;
+
+    if (_tilesFailed > 0)
+    {
+        OE_WARN << LC << (unsigned)_tilesFailed << " tiles failed to encode or write" << std::endl;
+    }
+}
+
 TileVisitor* TMSPackager::getTileVisitor() const
 {
     return _visitor;
@@ -418,6 +631,13 @@ void TMSPackager::run( TerrainLayer* layer,  Map* map  )
             OE_NOTICE << LC << "Extension changed to PNG since output requires an alpha channel" << std::endl;
         }
 
+        // Compressed tiles need a container that keeps the DXT blocks and mipmaps.
+        if (!_textureCompression.empty() && _extension != "dds" && _extension != "osgb")
+        {
+            _extension = "dds";
+            OE_NOTICE << LC << "Extension changed to DDS since output is compressed" << std::endl;
+        }
+
         OE_INFO << LC << "Output extension: " << _extension << std::endl;
 
     }
@@ -431,13 +651,68 @@ void TMSPackager::run( TerrainLayer* layer,  Map* map  )
     }
 
 
+    // Write the layer to a single MBTiles file if requested.
+    bool ownTileSource = false;
+    if (_writeMBTiles && !_tileSource.valid())
+    {
+        Config conf;
+        conf.set( "driver",   "mbtiles" );
+        conf.set( "filename", getMBTilesFilename(_layerName) );
+        conf.set( "format",   _extension );
+        conf.add( "profile",  map->getProfile()->toProfileOptions().getConfig() );
+
+        osg::ref_ptr<TileSource> mbtiles = TileSourceFactory::create( TileSourceOptions(conf) );
+        if ( mbtiles.valid() )
+        {
+            mbtiles->getDataExtents() = layer->getDataExtents();
+            Status status = mbtiles->open( TileSource::MODE_WRITE | TileSource::MODE_CREATE, _writeOptions.get() );
+            if ( status.isError() )
+            {
+                OE_WARN << LC << "Failed to create " << getMBTilesFilename(_layerName) << ": " << status.message() << std::endl;
+                return;
+            }
+            _tileSource = mbtiles.get();
+            ownTileSource = true;
+        }
+        else
+        {
+            OE_WARN << LC << "MBTiles driver is not available" << std::endl;
+            return;
+        }
+    }
+
+    // start the encode and write stages.
+    _tilesInFlight.exchange(0);
+    _tilesFailed.exchange(0);
+
+    if (_numEncodeThreads > 0)
+        _encodeService = new TaskService("TMSPackager encode", _numEncodeThreads, _maxQueuedTiles);
+
+    if (_numWriteThreads > 0)
+        _writeService = new TaskService("TMSPackager write", _numWriteThreads, _maxQueuedTiles);
+
     _handler = new WriteTMSTileHandler(layer, map, this);
     _visitor->setTileHandler( _handler );
+    _visitor->setWorkQueueJob( _layerName );
     _visitor->run( map->getProfile() );
+
+    // the visitor only fetched the tiles; wait for the rest of the pipeline.
+    drain();
+
+    // closing the MBTiles file commits the last batch of tiles.
+    if (ownTileSource)
+    {
+        _tileSource = 0L;
+    }
 }
 
 void TMSPackager::writeXML(TerrainLayer* layer, Map* map)
 {
+    if (_writeMBTiles)
+    {
+        return;
+    }
+
     const DataExtentList& dataExtents = layer->getDataExtents();
 
      // create the tile map metadata:
@@ -457,6 +732,8 @@ void TMSPackager::writeXML(TerrainLayer* layer, Map* map)
         mimeType = "image/jpeg";
     else if ( _extension == "tif" || _extension == "tiff" )
         mimeType = "image/tiff";
+    else if ( _extension == "dds" )
+        mimeType = "image/vnd-ms.dds";
     else {
         OE_WARN << LC << "Unable to determine mime-type for extension \"" << _extension << "\"" << std::endl;
     }
@@ -23,10 +23,51 @@
 #include <osgEarth/MapNode>
 #include <osgEarth/TerrainEngineNode>
 #include <osgEarth/GeoMath>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/Registry>
+#include <osgEarth/TaskService>
+#include <algorithm>
 
 using namespace osgEarth;
 using namespace osgEarth::Util;
 
+namespace
+{
+    // Fewest samples worth handing to another thread
+    const unsigned MIN_SAMPLES_PER_TASK = 512u;
+
+    // Most samples in one elevation profile
+    const unsigned MAX_SAMPLES = 65536u;
+
+    // Profile sampling shares the registry's thread budget under this UID.
+    TaskService* getProfileService()
+    {
+        static UID s_uid = Registry::instance()->createUID();
+        return Registry::instance()->getTaskServiceManager()->getOrAdd(s_uid);
+    }
+
+    // Samples a contiguous range of profile points. Each range gets its own
+    // envelope since envelopes are not safe to share between threads.
+    struct SampleRange
+    {
+        ElevationPool* _pool;
+        const SpatialReference* _srs;
+        unsigned _lod;
+        const std::vector<osg::Vec3d>* _points;
+        std::vector<float>* _elevations;
+        unsigned _begin, _end;
+
+        void execute()
+        {
+            osg::ref_ptr<ElevationEnvelope> envelope = _pool->createEnvelope(_srs, _lod);
+            std::vector<osg::Vec3d> points(_points->begin() + _begin, _points->begin() + _end);
+            std::vector<float> elevations;
+            envelope->getElevations(points, elevations);
+            std::copy(elevations.begin(), elevations.end(), _elevations->begin() + _begin);
+        }
+    };
+}
+
 /***************************************************/
 TerrainProfile::TerrainProfile():
 _spacing( 1.0 )
@@ -94,14 +135,18 @@ TerrainProfile::getElevationRanges(double &min, double &max ) const
 TerrainProfileCalculator::TerrainProfileCalculator(MapNode* mapNode, const GeoPoint& start, const GeoPoint& end):
 _mapNode( mapNode ),
 _start( start),
-_end( end )
+_end( end ),
+_useElevationData( false ),
+_elevationLOD( 14u )
 {        
     _mapNode->getTerrain()->addTerrainCallback( this );        
     recompute();
 }
 
 TerrainProfileCalculator::TerrainProfileCalculator(MapNode* mapNode):
-_mapNode( mapNode )
+_mapNode( mapNode ),
+_useElevationData( false ),
+_elevationLOD( 14u )
 {
     _mapNode->getTerrain()->addTerrainCallback( this );
 }
@@ -185,8 +230,31 @@ void TerrainProfileCalculator::setStartEnd(const GeoPoint& start, const GeoPoint
     }
 }
 
+void TerrainProfileCalculator::setUseElevationData(bool value)
+{
+    if (_useElevationData != value)
+    {
+        _useElevationData = value;
+        recompute();
+    }
+}
+
+void TerrainProfileCalculator::setElevationLOD(unsigned lod)
+{
+    if (_elevationLOD != lod)
+    {
+        _elevationLOD = lod;
+        if (_useElevationData)
+            recompute();
+    }
+}
+
 void TerrainProfileCalculator::onTileAdded(const osgEarth::TileKey& tileKey, osg::Node* graph, TerrainCallbackContext&)
 {
+    // elevation data doesn't depend on which tiles are paged in.
+    if (_useElevationData)
+        return;
+
     if (_start.isValid() && _end.isValid())
     {
         GeoExtent extent( _start.getSRS());
@@ -204,7 +272,10 @@ void TerrainProfileCalculator::recompute()
 {
     if (_start.isValid() && _end.isValid())
     {
-        computeTerrainProfile( _mapNode.get(), _start, _end, _profile);
+        if (_useElevationData)
+            computeElevationProfile( _mapNode.get(), _start, _end, _elevationLOD, _profile);
+        else
+            computeTerrainProfile( _mapNode.get(), _start, _end, _profile);
 
         for( ChangedCallbackList::iterator i = _changedCallbacks.begin(); i != _changedCallbacks.end(); i++ )
         {
@@ -235,3 +306,95 @@ void TerrainProfileCalculator::computeTerrainProfile( osgEarth::MapNode* mapNode
         profile.addElevation( slice.getDistanceHeightIntersections()[i].first, slice.getDistanceHeightIntersections()[i].second);
     }
 }
+
+void TerrainProfileCalculator::computeElevationProfile( osgEarth::MapNode* mapNode, const GeoPoint& start, const GeoPoint& end, unsigned lod, TerrainProfile& profile)
+{
+    profile.clear();
+
+    const Map* map = mapNode ? mapNode->getMap() : 0L;
+    ElevationPool* pool = map ? map->getElevationPool() : 0L;
+    if (!pool)
+        return;
+
+    const SpatialReference* srs = map->getSRS();
+    GeoPoint p0 = start.transform(srs);
+    GeoPoint p1 = end.transform(srs);
+    if (!p0.isValid() || !p1.isValid())
+        return;
+
+    // one sample per elevation post at the requested LOD:
+    double w, h;
+    map->getProfile()->getTileDimensions(lod, w, h);
+    unsigned tileSize = pool->getTileSize();
+    double spacing = w / (double)(tileSize > 1u ? tileSize-1u : 1u);
+    if (srs->isGeographic())
+        spacing *= srs->getEllipsoid()->getRadiusEquator() * osg::PI / 180.0;
+
+    double length = GeoMath::distance(p0.vec3d(), p1.vec3d(), srs);
+    unsigned parts = (unsigned)osg::clampBetween(ceil(length/spacing), 1.0, (double)MAX_SAMPLES);
+
+    std::vector<osg::Vec3d> points;
+    points.reserve(parts+1);
+    points.push_back(osg::Vec3d(p0.x(), p0.y(), 0.0));
+    if (srs->isGeographic())
+    {
+        std::vector<osg::Vec2d> latLon;
+        GeoMath::interpolate(
+            osg::DegreesToRadians(p0.y()), osg::DegreesToRadians(p0.x()),
+            osg::DegreesToRadians(p1.y()), osg::DegreesToRadians(p1.x()),
+            parts, latLon);
+        for (unsigned i = 0; i < latLon.size(); ++i)
+            points.push_back(osg::Vec3d(osg::RadiansToDegrees(latLon[i].y()), osg::RadiansToDegrees(latLon[i].x()), 0.0));
+    }
+    else
+    {
+        for (unsigned i = 1; i < parts; ++i)
+        {
+            double t = (double)i / (double)parts;
+            points.push_back(osg::Vec3d(p0.x() + (p1.x()-p0.x())*t, p0.y() + (p1.y()-p0.y())*t, 0.0));
+        }
+    }
+    points.push_back(osg::Vec3d(p1.x(), p1.y(), 0.0));
+
+    std::vector<float> elevations(points.size(), NO_DATA_VALUE);
+
+    SampleRange range;
+    range._pool = pool;
+    range._srs = srs;
+    range._lod = lod;
+    range._points = &points;
+    range._elevations = &elevations;
+
+    unsigned numTasks = points.size() / MIN_SAMPLES_PER_TASK;
+    TaskService* service = numTasks > 1u ? getProfileService() : 0L;
+
+    if ( service && service->getNumThreads() > 1 )
+    {
+        numTasks = osg::minimum(numTasks, (unsigned)service->getNumThreads());
+        Threading::MultiEvent semaphore(numTasks);
+
+        for (unsigned t = 0; t < numTasks; ++t)
+        {
+            ParallelTask<SampleRange>* task = new ParallelTask<SampleRange>(&semaphore);
+            static_cast<SampleRange&>(*task) = range;
+            task->_begin = (t * points.size()) / numTasks;
+            task->_end = ((t + 1) * points.size()) / numTasks;
+            service->add(task);
+        }
+
+        semaphore.wait();
+    }
+    else
+    {
+        range._begin = 0u;
+        range._end = points.size();
+        range.execute();
+    }
+
+    // the points are evenly spaced, so distance is proportional to index.
+    for (unsigned i = 0; i < points.size(); ++i)
+    {
+        if (elevations[i] != NO_DATA_VALUE)
+            profile.addElevation( length * (double)i / (double)(points.size()-1), elevations[i] );
+    }
+}
@@ -75,6 +75,20 @@ TileIndex::load(const std::string& filename)
     TileIndex* index = new TileIndex();
     index->_features = features.get();
     index->_filename = filename;
+
+    // Read the whole index into memory once; every lookup after this is an
+    // R-tree query.
+    osg::ref_ptr< FeatureCursor > cursor = features->createFeatureCursor();
+    while (cursor.valid() && cursor->hasMore())
+    {
+        osg::ref_ptr< Feature > feature = cursor->nextFeature();
+        if (feature.valid() && feature->getGeometry())
+        {
+            index->_spatialIndex.insert( index->_locations.size(), feature->getGeometry()->getBounds() );
+            index->_locations.push_back( getFullPath(filename, feature->getString("location")) );
+        }
+    }
+
     return index;
 }
 
@@ -113,21 +127,21 @@ void
 TileIndex::getFiles(const osgEarth::GeoExtent& extent, std::vector< std::string >& files)
 {            
     files.clear();
-    osgEarth::Symbology::Query query;    
 
     GeoExtent transformed = extent.transform( _features->getFeatureProfile()->getSRS() );
-    query.bounds() = transformed.bounds();
-    osg::ref_ptr< osgEarth::Features::FeatureCursor> cursor = _features->createFeatureCursor( query );
+    if (!transformed.isValid())
+        return;
+
+    // IDs come back in insertion order, the same order the feature source returned them.
+    Threading::ScopedReadLock lock( _locationsMutex );
 
-    while (cursor->hasMore())
+    std::vector< unsigned > hits;
+    _spatialIndex.query( transformed.bounds(), hits );
+
+    for (unsigned i = 0; i < hits.size(); ++i)
     {
-        osg::ref_ptr< osgEarth::Features::Feature> feature = cursor->nextFeature();
-        if (feature.valid())
-        {
-            std::string location = getFullPath(_filename, feature->getString("location"));
-            files.push_back( location );
-        }
-    }    
+        files.push_back( _locations[hits[i]] );
+    }
 }
 
 bool TileIndex::add( const std::string& filename, const GeoExtent& extent )
@@ -145,6 +159,14 @@ bool TileIndex::add( const std::string& filename, const GeoExtent& extent )
     const SpatialReference* wgs84 = SpatialReference::create("epsg:4326");
     feature->transform( wgs84 );
 
-    return _features->insertFeature( feature.get() );    
+    if (!_features->insertFeature( feature.get() ))
+        return false;
+
+    feature->transform( _features->getFeatureProfile()->getSRS() );
+    {
+        Threading::ScopedWriteLock lock( _locationsMutex );
+        _spatialIndex.insert( _locations.size(), feature->getGeometry()->getBounds() );
+        _locations.push_back( getFullPath(_filename, filename) );
+    }
     return true;
 }
@@ -25,9 +25,16 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/Progress>
 #include <osgEarth/ImageLayer>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TaskService>
 #include <osgEarthDrivers/gdal/GDALOptions>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+#include <fstream>
+#include <iomanip>
+#include <limits>
 
 using namespace osgDB;
 using namespace osgEarth;
@@ -36,7 +43,111 @@ using namespace osgEarth::Drivers;
 using namespace osgEarth::Features;
 using namespace std;
 
-TileIndexBuilder::TileIndexBuilder()
+#define LC "[TileIndexBuilder] "
+
+namespace
+{
+    // Extents of one data file, in WGS84.
+    struct ScanRecord
+    {
+        ScanRecord() : _mtime(0) { }
+        TimeStamp         _mtime;
+        std::vector<Bounds> _extents;
+    };
+
+    typedef std::map<std::string, ScanRecord> ScanCache;
+
+    // Opens a file with GDAL and records its data extents.
+    void scanFile(const std::string& filename, ScanRecord& record)
+    {
+        GDALOptions opt;
+        opt.url() = filename;
+
+        osg::ref_ptr< ImageLayer > layer = new ImageLayer( ImageLayerOptions("", opt) );
+        osg::ref_ptr< TileSource > source = layer->getTileSource();
+        if (source.valid())
+        {
+            const SpatialReference* wgs84 = SpatialReference::create("epsg:4326");
+            for (DataExtentList::iterator itr = source->getDataExtents().begin(); itr != source->getDataExtents().end(); ++itr)
+            {
+                GeoExtent extent = itr->transform( wgs84 );
+                if (extent.isValid())
+                    record._extents.push_back( extent.bounds() );
+            }
+        }
+    }
+
+    struct ScanFileTask : public TaskRequest
+    {
+        ScanFileTask(const std::string& filename, ScanRecord& record, OpenThreads::Atomic& remaining) :
+            _filename(filename), _record(record), _remaining(remaining) { }
+
+        void operator()(ProgressCallback* progress)
+        {
+            scanFile( _filename, _record );
+            --_remaining;
+        }
+
+        std::string          _filename;
+        ScanRecord&          _record;
+        OpenThreads::Atomic& _remaining;
+    };
+
+    // One line per file: mtime <tab> xmin ymin xmax ymax[;...] <tab> path
+    void readScanCache(const std::string& filename, ScanCache& cache)
+    {
+        std::ifstream in( filename.c_str() );
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::string::size_type t1 = line.find('\t');
+            std::string::size_type t2 = t1 != std::string::npos ? line.find('\t', t1+1) : std::string::npos;
+            if (t2 == std::string::npos)
+                continue;
+
+            ScanRecord record;
+            std::stringstream(line.substr(0, t1)) >> record._mtime;
+
+            StringVector extents;
+            StringTokenizer(line.substr(t1+1, t2-t1-1), extents, ";", "", false, true);
+            for (unsigned i = 0; i < extents.size(); ++i)
+            {
+                Bounds b;
+                std::stringstream buf(extents[i]);
+                if (buf >> b.xMin() >> b.yMin() >> b.xMax() >> b.yMax())
+                    record._extents.push_back( b );
+            }
+
+            cache[line.substr(t2+1)] = record;
+        }
+    }
+
+    void writeScanCache(const std::string& filename, const ScanCache& cache)
+    {
+        osgEarth::makeDirectoryForFile( filename );
+        std::ofstream out( filename.c_str() );
+        if (!out.is_open())
+        {
+            OE_WARN << LC << "Failed to write scan cache " << filename << std::endl;
+            return;
+        }
+
+        out << std::setprecision( std::numeric_limits<double>::digits10 + 2 );
+        for (ScanCache::const_iterator i = cache.begin(); i != cache.end(); ++i)
+        {
+            out << i->second._mtime << '\t';
+            for (unsigned e = 0; e < i->second._extents.size(); ++e)
+            {
+                const Bounds& b = i->second._extents[e];
+                out << (e > 0 ? ";" : "") << b.xMin() << " " << b.yMin() << " " << b.xMax() << " " << b.yMax();
+            }
+            out << '\t' << i->first << '\n';
+        }
+    }
+}
+
+TileIndexBuilder::TileIndexBuilder() :
+_numThreads( 4 )
 {
 }
 
@@ -61,31 +172,70 @@ void TileIndexBuilder::build(const std::string& indexFilename, const osgEarth::S
     
     unsigned int total = _expandedFilenames.size();
 
+    // Reuse the extents of files that haven't changed since the last scan.
+    ScanCache previous;
+    if (!_scanCache.empty())
+    {
+        readScanCache( _scanCache, previous );
+    }
+
+    std::vector< ScanRecord > records( total );
+    std::vector< unsigned > toScan;
+    for (unsigned int i = 0; i < total; i++)
+    {
+        records[i]._mtime = osgEarth::getLastModifiedTime( _expandedFilenames[i] );
+        ScanCache::const_iterator cached = previous.find( _expandedFilenames[i] );
+        if (cached != previous.end() && cached->second._mtime == records[i]._mtime)
+            records[i] = cached->second;
+        else
+            toScan.push_back( i );
+    }
+
+    OE_INFO << LC << "Scanning " << toScan.size() << " of " << total << " files" << std::endl;
+
+    // Reading extents means opening every file, which dominates the build;
+    // do it in parallel. Each record is only touched by its own task.
+    if (_numThreads > 0 && toScan.size() > 1)
+    {
+        OpenThreads::Atomic remaining( toScan.size() );
+        osg::ref_ptr< TaskService > service = new TaskService( "TileIndexBuilder", _numThreads );
+        for (unsigned int i = 0; i < toScan.size(); i++)
+        {
+            service->add( new ScanFileTask( _expandedFilenames[toScan[i]], records[toScan[i]], remaining ) );
+        }
+
+        while (remaining > 0)
+        {
+            OpenThreads::Thread::microSleep( 10000 );
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < toScan.size(); i++)
+        {
+            scanFile( _expandedFilenames[toScan[i]], records[toScan[i]] );
+        }
+    }
+
+    const SpatialReference* wgs84 = SpatialReference::create("epsg:4326");
+    ScanCache current;
+
+    // The shapefile is written on this thread, in the original file order.
     for (unsigned int i = 0; i < _expandedFilenames.size(); i++)
     {   
         std::string filename = _expandedFilenames[ i ];        
 
-        GDALOptions opt;
-        opt.url() = filename;
-        
-        osg::ref_ptr< ImageLayer > layer = new ImageLayer( ImageLayerOptions("", opt) );        
-
         bool ok = false;
-                
-        if ( layer.valid() )        
-        {            
-            osg::ref_ptr< TileSource > source = layer->getTileSource();
-            if (source.valid())
-            {
-                for (DataExtentList::iterator itr = source->getDataExtents().begin(); itr != source->getDataExtents().end(); ++itr)
-                {
-                    // We want the filename as it is relative to the index file                
-                    std::string relative = getPathRelative( indexDir, filename );                
-                    index->add( relative, *itr);    
-                    ok = true;
-                }                
-            }
-        }        
+
+        for (unsigned int e = 0; e < records[i]._extents.size(); ++e)
+        {
+            // We want the filename as it is relative to the index file                
+            std::string relative = getPathRelative( indexDir, filename );                
+            index->add( relative, GeoExtent(wgs84, records[i]._extents[e]) );
+            ok = true;
+        }
+
+        current[ filename ] = records[i];
 
         if (_progress.valid())
         {
@@ -104,7 +254,10 @@ void TileIndexBuilder::build(const std::string& indexFilename, const osgEarth::S
         }
     }
 
-    osg::Timer_t end = osg::Timer::instance()->tick();    
+    if (!_scanCache.empty())
+    {
+        writeScanCache( _scanCache, current );
+    }
 }
 
 void TileIndexBuilder::expandFilenames()
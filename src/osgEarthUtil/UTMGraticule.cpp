@@ -94,10 +94,74 @@ UTMData::rebuild(const Profile* profile)
     _gzd.erase( "36X" );
 }
 
+void
+UTMData::setupCache(const Map* map, const std::string& binID)
+{
+    _cacheBin = 0L;
+    _cachePolicy.unset();
+
+    CacheSettings* mapSettings = map ? CacheSettings::get(map->getReadOptions()) : 0L;
+    if ( mapSettings && mapSettings->isCacheEnabled() )
+    {
+        CacheBin* bin = mapSettings->getCache()->addBin(binID);
+        if ( bin )
+        {
+            OE_INFO << LC << "Cache bin is [" << binID << "]\n";
+            _cacheBin = bin;
+            _cachePolicy = mapSettings->cachePolicy();
+        }
+        else
+        {
+            OE_WARN << LC << "Failed to open a cache bin [" << binID << "], disabling caching\n";
+        }
+    }
+}
+
+osg::Node*
+UTMData::readCell(const std::string& key) const
+{
+    if ( !_cacheBin.valid() || !_cachePolicy->isCacheReadable() )
+        return 0L;
+
+    ReadResult rr = _cacheBin->readObject(key, 0L);
+    if ( !rr.succeeded() || _cachePolicy->isExpired(rr.lastModifiedTime()) )
+        return 0L;
+
+    OE_DEBUG << LC << "Loaded " << key << " from the cache\n";
+    return rr.releaseNode();
+}
+
+void
+UTMData::writeCell(const std::string& key, osg::Node* node) const
+{
+    if ( node && _cacheBin.valid() && _cachePolicy->isCacheWriteable() )
+    {
+        _cacheBin->writeNode(key, node, Config(), 0L);
+    }
+}
+
 osg::Group*
 UTMData::buildGZDTile(const std::string& name, const GeoExtent& extent, const Style& style, const FeatureProfile* featureProfile, const Map* map)
 {
-    osg::Group* group = new osg::Group();
+    // get the geocentric tile center:
+    osg::Vec3d tileCenter;
+    extent.getCentroid( tileCenter.x(), tileCenter.y() );
+
+    const SpatialReference* ecefSRS = extent.getSRS()->getECEF();
+    
+    osg::Vec3d centerECEF;
+    extent.getSRS()->transform( tileCenter, ecefSRS, centerECEF );
+
+    // the cached cell doesn't include the culler, which won't serialize.
+    std::string cacheKey = Stringify() << "gzd_" << name;
+    osg::ref_ptr<osg::Group> group = dynamic_cast<osg::Group*>( readCell(cacheKey) );
+    if ( group.valid() )
+    {
+        osg::ref_ptr<osg::Node> result = ClusterCullingFactory::createAndInstall( group.get(), centerECEF );
+        return result.release()->asGroup();
+    }
+
+    group = new osg::Group();
 
     Style lineStyle;
     lineStyle.add( const_cast<LineSymbol*>(style.get<LineSymbol>()) );
@@ -145,15 +209,6 @@ UTMData::buildGZDTile(const std::string& name, const GeoExtent& extent, const St
     if ( geomNode ) 
         group->addChild( geomNode );
 
-    // get the geocentric tile center:
-    osg::Vec3d tileCenter;
-    extent.getCentroid( tileCenter.x(), tileCenter.y() );
-
-    const SpatialReference* ecefSRS = extent.getSRS()->getECEF();
-    
-    osg::Vec3d centerECEF;
-    extent.getSRS()->transform( tileCenter, ecefSRS, centerECEF );
-
     if ( hasText )
     {
         osg::Vec3d west, east;
@@ -182,9 +237,10 @@ UTMData::buildGZDTile(const std::string& name, const GeoExtent& extent, const St
 
     //group = buildGZDChildren( group, name );
 
-    group = ClusterCullingFactory::createAndInstall( group, centerECEF )->asGroup();
+    writeCell( cacheKey, group.get() );
 
-    return group;
+    osg::ref_ptr<osg::Node> result = ClusterCullingFactory::createAndInstall( group.get(), centerECEF );
+    return result.release()->asGroup();
 }
 
 //---------------------------------------------------------------------------
@@ -316,6 +372,11 @@ UTMGraticule::rebuild()
 
     _utmData.rebuild(_profile.get());
 
+    // compiled cells depend on the style and the profile.
+    _utmData.setupCache(
+        getMapNode()->getMap(),
+        Stringify() << "utm_graticule_" << hashToString(getConfig().toJSON(false) + _profile->getFullSignature()) );
+
     // now build the lateral tiles for the GZD level.
     for( UTMData::SectorTable::iterator i = _utmData.sectorTable().begin(); i != _utmData.sectorTable().end(); ++i )
     {
@@ -0,0 +1,145 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#include <osgEarthUtil/VectorTileGenerator>
+#include <osgEarthFeatures/CropFilter>
+#include <osgEarthFeatures/FilterContext>
+#include <osgEarthFeatures/MVT>
+
+#define LC "[VectorTileGenerator] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Util;
+
+
+VectorTileGenerator::VectorTileGenerator(FeatureSource* features, const Profile* profile) :
+_features( features ),
+_profile( profile ),
+_layerName( "features" ),
+_tileExtent( 4096u ),
+_tolerance( 1.0 ),
+_buffer( 64u ),
+_cacheSize( 512u ),
+_cache( true, 512u )
+{
+}
+
+void
+VectorTileGenerator::setCacheSize(unsigned value)
+{
+    _cacheSize = value;
+    _cache.setMaxSize( value );
+}
+
+void
+VectorTileGenerator::getFeatures(const TileKey& key, FeatureList& output)
+{
+    output.clear();
+
+    const FeatureProfile* featureProfile = _features.valid() ? _features->getFeatureProfile() : 0L;
+    if ( !featureProfile || !featureProfile->getSRS() )
+        return;
+
+    const SpatialReference* srs = key.getProfile()->getSRS();
+
+    // Clip to the tile plus a buffer, so lines and polygon edges don't show
+    // seams where neighboring tiles meet.
+    const GeoExtent& tileExtent = key.getExtent();
+    double bx = tileExtent.width()  * (double)_buffer / (double)_tileExtent;
+    double by = tileExtent.height() * (double)_buffer / (double)_tileExtent;
+    GeoExtent extent( srs,
+        tileExtent.xMin() - bx, tileExtent.yMin() - by,
+        tileExtent.xMax() + bx, tileExtent.yMax() + by );
+
+    Query query( _query );
+    GeoExtent queryExtent = extent.transform( featureProfile->getSRS() );
+    if ( queryExtent.isValid() )
+    {
+        if ( query.bounds().isSet() )
+            query.bounds() = query.bounds()->intersectionWith( queryExtent.bounds() );
+        else
+            query.bounds() = queryExtent.bounds();
+    }
+
+    osg::ref_ptr<FeatureCursor> cursor = _features->createFeatureCursor( query );
+    while ( cursor.valid() && cursor->hasMore() )
+    {
+        osg::ref_ptr<Feature> feature = cursor->nextFeature();
+        if ( !feature.valid() || !feature->getGeometry() )
+            continue;
+
+        if ( !feature->getSRS()->isEquivalentTo( srs ) )
+        {
+            feature->transform( srs );
+        }
+        output.push_back( feature.get() );
+    }
+
+    if ( !output.empty() )
+    {
+        CropFilter crop( CropFilter::METHOD_CROPPING );
+        FilterContext context( 0L );
+        context.extent() = extent;
+        crop.push( output, context );
+    }
+}
+
+bool
+VectorTileGenerator::getTile(const TileKey& key, const std::string& format, std::string& out)
+{
+    bool json = format == "json" || format == "geojson";
+    if ( !json && format != "mvt" && format != "pbf" )
+        return false;
+
+    std::string cacheKey = key.str() + "." + (json ? "json" : "mvt");
+    if ( _cacheSize > 0 )
+    {
+        LRUCache<std::string, std::string>::Record record;
+        if ( _cache.get(cacheKey, record) )
+        {
+            out = record.value();
+            return true;
+        }
+    }
+
+    FeatureList features;
+    getFeatures( key, features );
+
+    bool ok;
+    if ( json )
+    {
+        out = Feature::featuresToGeoJSON( features );
+        ok = true;
+    }
+    else
+    {
+        ok = MVT::write( features, key, _layerName, out, _tileExtent, _tolerance );
+    }
+
+    if ( ok && _cacheSize > 0 )
+    {
+        _cache.insert( cacheKey, out );
+    }
+
+    return ok;
+}
@@ -0,0 +1,120 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+#ifndef OSGEARTH_BENCHMARKS_BENCHMARK_H
+#define OSGEARTH_BENCHMARKS_BENCHMARK_H 1
+
+#include <osg/Timer>
+#include <string>
+#include <vector>
+
+namespace osgEarth { namespace Benchmarks
+{
+    /**
+     * Passed to each benchmark function. The function does its setup,
+     * calls start(), runs its kernel iterations() times, and returns.
+     * Only the time between start() and stop() counts; a function can
+     * stop() and start() again around per-iteration setup.
+     */
+    class Context
+    {
+    public:
+        Context(unsigned iterations) :
+            _iterations(iterations), _items(1u), _start(0), _elapsed(0.0), _running(false) { }
+
+        //! Number of times to run the kernel
+        unsigned iterations() const { return _iterations; }
+
+        //! Starts (or resumes) the clock
+        void start() { _running = true; _start = osg::Timer::instance()->tick(); }
+
+        //! Pauses the clock; called automatically when the function returns
+        void stop() {
+            if (_running) {
+                _elapsed += osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+                _running = false;
+            }
+        }
+
+        //! Number of items (points, pixels, ...) each iteration processes
+        void setItemsPerIteration(unsigned items) { _items = items; }
+
+        //! Skips the benchmark, e.g. when a data source isn't available
+        void skip(const std::string& reason) { _skipped = reason; }
+
+        //! Keeps the compiler from discarding a computed result
+        template<typename T> void consume(const T& value) { _sink += (double)value; }
+
+        double elapsed() const { return _elapsed; }
+        unsigned items() const { return _items; }
+        const std::string& skipped() const { return _skipped; }
+
+    private:
+        unsigned     _iterations;
+        unsigned     _items;
+        osg::Timer_t _start;
+        double       _elapsed;
+        bool         _running;
+        std::string  _skipped;
+        static volatile double _sink;
+    };
+
+    typedef void (*Function)(Context&);
+
+    struct Entry
+    {
+        std::string _name;
+        Function    _function;
+    };
+
+    //! All registered benchmarks, in registration order
+    std::vector<Entry>& registry();
+
+    //! Adds a benchmark to the registry at static-init time
+    struct Register
+    {
+        Register(const char* name, Function function)
+        {
+            Entry e;
+            e._name = name;
+            e._function = function;
+            registry().push_back(e);
+        }
+    };
+} }
+
+/**
+ * Defines a benchmark. The name is a dotted "group.kernel" string that the
+ * --filter option matches against.
+ *
+ *   OE_BENCHMARK(SRS_geo_to_merc, "srs.transform.geo_to_mercator")
+ *   {
+ *       ...setup...
+ *       cx.start();
+ *       for (unsigned i = 0; i < cx.iterations(); ++i) { ... }
+ *   }
+ */
+#define OE_BENCHMARK(ID, NAME) \
+    static void ID(osgEarth::Benchmarks::Context& cx); \
+    static osgEarth::Benchmarks::Register ID##_register(NAME, ID); \
+    static void ID(osgEarth::Benchmarks::Context& cx)
+
+#endif // OSGEARTH_BENCHMARKS_BENCHMARK_H
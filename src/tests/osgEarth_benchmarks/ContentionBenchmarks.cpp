@@ -0,0 +1,202 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark.h"
+#include <osgEarth/Containers>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/Map>
+#include <osgEarth/MapOptions>
+#include <osgEarth/Registry>
+#include <osgEarth/TileSource>
+#include <OpenThreads/Thread>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Benchmarks;
+
+#define NUM_THREADS 4
+
+namespace
+{
+    // Thread that runs "count" operations of a benchmark kernel.
+    struct Worker : public OpenThreads::Thread
+    {
+        Worker() : _count(0), _seed(0), _result(0.0) { }
+        virtual void work() =0;
+        void run() { work(); }
+        unsigned _count;
+        unsigned _seed;
+        double   _result;
+    };
+
+    // Splits the iterations across NUM_THREADS workers and times them
+    // from the first start to the last join.
+    template<typename WORKER>
+    void runWorkers(Context& cx, WORKER* workers)
+    {
+        for (unsigned t = 0; t < NUM_THREADS; ++t)
+        {
+            workers[t]._count = cx.iterations() / NUM_THREADS + 1;
+            workers[t]._seed = 1234u * (t+1);
+        }
+
+        cx.setItemsPerIteration(1u);
+        cx.start();
+        for (unsigned t = 0; t < NUM_THREADS; ++t)
+            workers[t].start();
+        for (unsigned t = 0; t < NUM_THREADS; ++t)
+            workers[t].join();
+        cx.stop();
+
+        for (unsigned t = 0; t < NUM_THREADS; ++t)
+            cx.consume(workers[t]._result);
+    }
+
+    inline unsigned nextRandom(unsigned& seed)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return seed >> 8;
+    }
+
+    typedef LRUCache<int, int> IntCache;
+
+    struct LRUWorker : public Worker
+    {
+        IntCache* _cache;
+        void work()
+        {
+            // Keys span twice the cache size, so about half the queries miss
+            // and turn into inserts.
+            for (unsigned i = 0; i < _count; ++i)
+            {
+                int key = (int)(nextRandom(_seed) & 2047);
+                IntCache::Record rec;
+                if (_cache->get(key, rec))
+                    _result += rec.value();
+                else
+                    _cache->insert(key, key);
+            }
+        }
+    };
+
+    // Procedural heightfields, so the pool benchmark has no data dependency.
+    class WaveTileSource : public TileSource
+    {
+    public:
+        WaveTileSource() : TileSource(TileSourceOptions()) { }
+
+        Status initialize(const osgDB::Options* dbOptions)
+        {
+            if (!getProfile())
+                setProfile(Registry::instance()->getGlobalGeodeticProfile());
+            return STATUS_OK;
+        }
+
+        CachePolicy getCachePolicyHint(const Profile* profile) const
+        {
+            return CachePolicy::NO_CACHE;
+        }
+
+        osg::HeightField* createHeightField(const TileKey& key, ProgressCallback* progress)
+        {
+            const GeoExtent& e = key.getExtent();
+            unsigned size = getPixelsPerTile();
+            osg::HeightField* hf = new osg::HeightField();
+            hf->allocate(size, size);
+            for (unsigned r = 0; r < size; ++r)
+            {
+                double y = e.yMin() + e.height() * (double)r / (double)(size-1);
+                for (unsigned c = 0; c < size; ++c)
+                {
+                    double x = e.xMin() + e.width() * (double)c / (double)(size-1);
+                    hf->setHeight(c, r, (float)(500.0*sin(x) + 300.0*cos(3.0*y)));
+                }
+            }
+            return hf;
+        }
+    };
+
+    struct PoolWorker : public Worker
+    {
+        osg::ref_ptr<ElevationEnvelope> _envelope;
+        void work()
+        {
+            // Sample a 1x1 degree area so the threads share tiles.
+            for (unsigned i = 0; i < _count; ++i)
+            {
+                double x = -77.0 + (double)(nextRandom(_seed) & 1023) / 1024.0;
+                double y =  38.0 + (double)(nextRandom(_seed) & 1023) / 1024.0;
+                _result += _envelope->getElevation(x, y);
+            }
+        }
+    };
+}
+
+OE_BENCHMARK(lru_contention, "lrucache.contention.4_threads")
+{
+    IntCache cache(true, 1024);
+    LRUWorker workers[NUM_THREADS];
+    for (unsigned t = 0; t < NUM_THREADS; ++t)
+        workers[t]._cache = &cache;
+
+    runWorkers(cx, workers);
+}
+
+OE_BENCHMARK(lru_single, "lrucache.single_thread")
+{
+    IntCache cache(false, 1024);
+    unsigned seed = 1234u;
+    double result = 0.0;
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        int key = (int)(nextRandom(seed) & 2047);
+        IntCache::Record rec;
+        if (cache.get(key, rec))
+            result += rec.value();
+        else
+            cache.insert(key, key);
+    }
+    cx.consume(result);
+}
+
+OE_BENCHMARK(pool_contention, "elevationpool.contention.4_threads")
+{
+    MapOptions mapOptions;
+    mapOptions.cachePolicy() = CachePolicy::NO_CACHE;
+    osg::ref_ptr<Map> map = new Map(mapOptions);
+
+    WaveTileSource* source = new WaveTileSource();
+    source->open();
+    map->addLayer(new ElevationLayer(ElevationLayerOptions("waves"), source));
+
+    ElevationPool* pool = map->getElevationPool();
+    const SpatialReference* wgs84 = map->getSRS()->getGeographicSRS();
+
+    PoolWorker workers[NUM_THREADS];
+    for (unsigned t = 0; t < NUM_THREADS; ++t)
+        workers[t]._envelope = pool->createEnvelope(wgs84, 12u);
+
+    runWorkers(cx, workers);
+}
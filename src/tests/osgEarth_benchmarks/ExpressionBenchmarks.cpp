@@ -0,0 +1,66 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark.h"
+#include <osgEarthSymbology/Expression>
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Benchmarks;
+
+OE_BENCHMARK(expr_numeric, "expression.numeric.eval")
+{
+    NumericExpression expr("max([height], 3.0) * [scale] + [base] % 10");
+    const NumericExpression::Variables& vars = expr.variables();
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        for (unsigned v = 0; v < vars.size(); ++v)
+            expr.set(vars[v], (double)(i & 255) + v);
+        cx.consume(expr.eval());
+    }
+}
+
+OE_BENCHMARK(expr_numeric_parse, "expression.numeric.parse")
+{
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        NumericExpression expr("max([height], 3.0) * [scale] + [base] % 10");
+        cx.consume(expr.variables().size());
+    }
+}
+
+OE_BENCHMARK(expr_string, "expression.string.eval")
+{
+    StringExpression expr("[name] (pop. [population])");
+    const StringExpression::Variables& vars = expr.variables();
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        for (unsigned v = 0; v < vars.size(); ++v)
+            expr.set(vars[v], (i & 1) ? "Washington" : "1000000");
+        cx.consume(expr.eval().size());
+    }
+}
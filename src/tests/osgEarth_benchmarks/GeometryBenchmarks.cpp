@@ -0,0 +1,130 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark.h"
+#include <osgEarth/Tessellator>
+#include <osgEarthSymbology/MeshConsolidator>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Benchmarks;
+
+namespace
+{
+    // A star-shaped (concave) polygon with "count" vertices.
+    osg::Vec3Array* makeStar(unsigned count)
+    {
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        for (unsigned i = 0; i < count; ++i)
+        {
+            double a = osg::PI * 2.0 * (double)i / (double)count;
+            double r = (i & 1) ? 60.0 : 100.0;
+            verts->push_back(osg::Vec3(r*cos(a), r*sin(a), 0.0f));
+        }
+        return verts;
+    }
+
+    osg::Geometry* makePolygon(osg::Vec3Array* verts)
+    {
+        osg::Geometry* geom = new osg::Geometry();
+        geom->setVertexArray(verts);
+        geom->addPrimitiveSet(new osg::DrawArrays(GL_POLYGON, 0, verts->size()));
+        return geom;
+    }
+
+    void tessellate(Context& cx, Tessellator::Method method, unsigned count)
+    {
+        osg::ref_ptr<osg::Vec3Array> verts = makeStar(count);
+        Tessellator tess(method);
+        cx.setItemsPerIteration(count);
+
+        for (unsigned i = 0; i < cx.iterations(); ++i)
+        {
+            osg::ref_ptr<osg::Geometry> geom = makePolygon(verts.get());
+            cx.start();
+            tess.tessellateGeometry(*geom.get());
+            cx.stop();
+            cx.consume(geom->getNumPrimitiveSets());
+        }
+    }
+
+    // A geode full of small triangle strips, the way feature geometry
+    // arrives before consolidation.
+    osg::Geode* makeGeode(unsigned numGeoms, unsigned vertsPerGeom)
+    {
+        osg::Geode* geode = new osg::Geode();
+        for (unsigned g = 0; g < numGeoms; ++g)
+        {
+            osg::Vec3Array* verts = new osg::Vec3Array();
+            osg::Vec3Array* normals = new osg::Vec3Array();
+            for (unsigned v = 0; v < vertsPerGeom; ++v)
+            {
+                verts->push_back(osg::Vec3((float)g, (float)(v/2), (float)(v&1)));
+                normals->push_back(osg::Vec3(0,0,1));
+            }
+            osg::Geometry* geom = new osg::Geometry();
+            geom->setUseVertexBufferObjects(true);
+            geom->setVertexArray(verts);
+            geom->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+            geom->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLE_STRIP, 0, vertsPerGeom));
+            geode->addDrawable(geom);
+        }
+        return geode;
+    }
+}
+
+OE_BENCHMARK(tess_earclip_small, "tessellator.ear_clipping.64")
+{
+    tessellate(cx, Tessellator::METHOD_EAR_CLIPPING, 64);
+}
+
+OE_BENCHMARK(tess_earclip_large, "tessellator.ear_clipping.2048")
+{
+    tessellate(cx, Tessellator::METHOD_EAR_CLIPPING, 2048);
+}
+
+OE_BENCHMARK(tess_fast_small, "tessellator.fast.64")
+{
+    tessellate(cx, Tessellator::METHOD_FAST, 64);
+}
+
+OE_BENCHMARK(tess_fast_large, "tessellator.fast.2048")
+{
+    tessellate(cx, Tessellator::METHOD_FAST, 2048);
+}
+
+OE_BENCHMARK(mesh_consolidate, "meshconsolidator.run.256x64")
+{
+    cx.setItemsPerIteration(256*64);
+
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        osg::ref_ptr<osg::Geode> geode = makeGeode(256, 64);
+        cx.start();
+        MeshConsolidator::run(*geode.get());
+        cx.stop();
+        cx.consume(geode->getNumDrawables());
+    }
+}
@@ -0,0 +1,165 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark.h"
+#include <osgEarth/ImageUtils>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/GeoData>
+#include <osgEarth/TileKey>
+#include <osgEarth/Registry>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Benchmarks;
+
+namespace
+{
+    // An image with a smooth gradient and some high-frequency detail.
+    osg::Image* makeImage(unsigned size, GLenum format)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(size, size, 1, format, GL_UNSIGNED_BYTE);
+        unsigned channels = osg::Image::computeNumComponents(format);
+        unsigned char* data = image->data();
+        for (unsigned t = 0; t < size; ++t)
+            for (unsigned s = 0; s < size; ++s)
+                for (unsigned c = 0; c < channels; ++c)
+                    *data++ = (unsigned char)((s*(c+1) + t*3 + ((s^t) & 15)) & 0xFF);
+        return image;
+    }
+
+    osg::HeightField* makeHeightField(unsigned size)
+    {
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(size, size);
+        for (unsigned r = 0; r < size; ++r)
+            for (unsigned c = 0; c < size; ++c)
+                hf->setHeight(c, r, 100.0f*sinf(0.1f*c) + 50.0f*cosf(0.07f*r));
+        return hf;
+    }
+}
+
+OE_BENCHMARK(image_resize_down, "imageutils.resize.256_to_128")
+{
+    osg::ref_ptr<osg::Image> input = makeImage(256, GL_RGBA);
+    cx.setItemsPerIteration(128*128);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        osg::ref_ptr<osg::Image> output;
+        ImageUtils::resizeImage(input.get(), 128, 128, output);
+        cx.consume(output->data()[0]);
+    }
+}
+
+OE_BENCHMARK(image_resize_up, "imageutils.resize.256_to_512")
+{
+    osg::ref_ptr<osg::Image> input = makeImage(256, GL_RGBA);
+    cx.setItemsPerIteration(512*512);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        osg::ref_ptr<osg::Image> output;
+        ImageUtils::resizeImage(input.get(), 512, 512, output);
+        cx.consume(output->data()[0]);
+    }
+}
+
+OE_BENCHMARK(image_convert_rgb, "imageutils.convert.rgb_to_rgba8")
+{
+    osg::ref_ptr<osg::Image> input = makeImage(256, GL_RGB);
+    cx.setItemsPerIteration(256*256);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        osg::ref_ptr<osg::Image> output = ImageUtils::convertToRGBA8(input.get());
+        cx.consume(output->data()[0]);
+    }
+}
+
+OE_BENCHMARK(image_mix, "imageutils.mix.rgba8")
+{
+    osg::ref_ptr<osg::Image> dest = makeImage(256, GL_RGBA);
+    osg::ref_ptr<osg::Image> src = makeImage(256, GL_RGBA);
+    cx.setItemsPerIteration(256*256);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        ImageUtils::mix(dest.get(), src.get(), 0.5f);
+        cx.consume(dest->data()[0]);
+    }
+}
+
+OE_BENCHMARK(hf_sample_bilinear, "heightfieldutils.sample.bilinear")
+{
+    osg::ref_ptr<osg::HeightField> hf = makeHeightField(257);
+    cx.setItemsPerIteration(64*64);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        for (unsigned y = 0; y < 64; ++y)
+            for (unsigned x = 0; x < 64; ++x)
+                cx.consume(HeightFieldUtils::getHeightAtNormalizedLocation(hf.get(), x/63.5, y/63.5, INTERP_BILINEAR));
+    }
+}
+
+OE_BENCHMARK(hf_sample_average, "heightfieldutils.sample.average")
+{
+    osg::ref_ptr<osg::HeightField> hf = makeHeightField(257);
+    cx.setItemsPerIteration(64*64);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        for (unsigned y = 0; y < 64; ++y)
+            for (unsigned x = 0; x < 64; ++x)
+                cx.consume(HeightFieldUtils::getHeightAtNormalizedLocation(hf.get(), x/63.5, y/63.5, INTERP_AVERAGE));
+    }
+}
+
+OE_BENCHMARK(geoimage_reproject, "geoimage.reproject.wgs84_to_mercator")
+{
+    const Profile* geodetic = Registry::instance()->getGlobalGeodeticProfile();
+    const Profile* mercator = Registry::instance()->getSphericalMercatorProfile();
+    if (!geodetic || !mercator)
+    {
+        cx.skip("profiles not available");
+        return;
+    }
+
+    TileKey key(6, 18, 20, geodetic);
+    GeoImage input(makeImage(256, GL_RGBA), key.getExtent());
+    GeoExtent outputExtent = key.getExtent().transform(mercator->getSRS());
+    cx.setItemsPerIteration(256*256);
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        GeoImage output = input.reproject(mercator->getSRS(), &outputExtent, 256, 256, true);
+        cx.consume(output.valid() ? output.getImage()->data()[0] : 0);
+    }
+}
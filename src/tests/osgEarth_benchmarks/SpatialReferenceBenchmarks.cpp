@@ -0,0 +1,94 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark.h"
+#include <osgEarth/SpatialReference>
+
+using namespace osgEarth;
+using namespace osgEarth::Benchmarks;
+
+namespace
+{
+    // A grid of geographic points over the eastern US.
+    void makeGeoPoints(std::vector<osg::Vec3d>& points)
+    {
+        points.clear();
+        for (unsigned y = 0; y < 32; ++y)
+            for (unsigned x = 0; x < 32; ++x)
+                points.push_back(osg::Vec3d(-80.0 + 0.1*x, 35.0 + 0.1*y, 100.0));
+    }
+
+    void transformPoints(Context& cx, const SpatialReference* fromSRS, const SpatialReference* toSRS)
+    {
+        if (!fromSRS || !toSRS)
+        {
+            cx.skip("SRS not available");
+            return;
+        }
+
+        std::vector<osg::Vec3d> source, points;
+        makeGeoPoints(source);
+        cx.setItemsPerIteration(source.size());
+
+        cx.start();
+        for (unsigned i = 0; i < cx.iterations(); ++i)
+        {
+            points = source;
+            fromSRS->transform(points, toSRS);
+            cx.consume(points.back().x());
+        }
+    }
+}
+
+OE_BENCHMARK(srs_geo_to_mercator, "srs.transform.wgs84_to_spherical_mercator")
+{
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr<const SpatialReference> merc = SpatialReference::create("spherical-mercator");
+    transformPoints(cx, wgs84.get(), merc.get());
+}
+
+OE_BENCHMARK(srs_geo_to_utm, "srs.transform.wgs84_to_utm")
+{
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr<const SpatialReference> utm = SpatialReference::create("epsg:32617");
+    transformPoints(cx, wgs84.get(), utm.get());
+}
+
+OE_BENCHMARK(srs_geo_to_ecef, "srs.transform.wgs84_to_ecef")
+{
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+    transformPoints(cx, wgs84.get(), wgs84.valid() ? wgs84->getECEF() : 0L);
+}
+
+OE_BENCHMARK(srs_single_point, "srs.transform.single_point")
+{
+    osg::ref_ptr<const SpatialReference> wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr<const SpatialReference> merc = SpatialReference::create("spherical-mercator");
+    osg::Vec3d out;
+
+    cx.start();
+    for (unsigned i = 0; i < cx.iterations(); ++i)
+    {
+        wgs84->transform(osg::Vec3d(-77.0 + 1e-6*(i & 1023), 38.0, 0.0), merc.get(), out);
+        cx.consume(out.x());
+    }
+}
@@ -0,0 +1,206 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "Benchmark.h"
+#include <osg/ArgumentParser>
+#include <osg/Math>
+#include <osgEarth/Notify>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#define LC "[benchmarks] "
+
+using namespace osgEarth;
+using namespace osgEarth::Benchmarks;
+
+volatile double Context::_sink = 0.0;
+
+std::vector<Entry>&
+osgEarth::Benchmarks::registry()
+{
+    static std::vector<Entry> s_entries;
+    return s_entries;
+}
+
+int
+usage(const char* name)
+{
+    OE_NOTICE
+        << "\nUsage: " << name << " [options]\n"
+        << "\nRuns the osgEarth microbenchmarks and prints one result per line.\n"
+        << "\nOptions:\n"
+        << "    --list             list the benchmark names and exit\n"
+        << "    --filter <text>    only run benchmarks whose name contains this text\n"
+        << "    --min-time <s>     minimum time for one measurement (default 0.25)\n"
+        << "    --repeat <n>       measurements per benchmark (default 5)\n"
+        << "    --format <fmt>     json (one object per line, the default) or csv\n"
+        << "    --out <file>       write results to a file instead of stdout\n"
+        << std::endl;
+
+    return 0;
+}
+
+namespace
+{
+    struct Result
+    {
+        std::string _name;
+        unsigned    _iterations;
+        double      _minNS;
+        double      _medianNS;
+        double      _itemsPerSecond;
+        std::string _skipped;
+    };
+
+    // Runs the benchmark once and returns the timed seconds.
+    double run(const Entry& entry, unsigned iterations, Result& result)
+    {
+        Context cx(iterations);
+        entry._function(cx);
+        cx.stop();
+        result._skipped = cx.skipped();
+        if (!result._skipped.empty())
+            return 0.0;
+        result._itemsPerSecond = (double)cx.items();
+        return cx.elapsed();
+    }
+
+    // Grows the iteration count until one run takes at least minTime, then
+    // takes "repeat" measurements at that count.
+    Result measure(const Entry& entry, double minTime, unsigned repeat)
+    {
+        Result result;
+        result._name = entry._name;
+        result._iterations = 1u;
+
+        double t = run(entry, 1u, result);
+        while (result._skipped.empty() && t < minTime && result._iterations < (1u << 30))
+        {
+            double scale = t > 0.0 ? 1.4 * minTime / t : 10.0;
+            scale = osg::clampBetween(scale, 2.0, 10.0);
+            result._iterations = (unsigned)std::min((double)(1u << 30), result._iterations * scale);
+            t = run(entry, result._iterations, result);
+        }
+
+        if (!result._skipped.empty())
+            return result;
+
+        std::vector<double> samples;
+        for (unsigned r = 0; r < repeat; ++r)
+        {
+            samples.push_back(1e9 * run(entry, result._iterations, result) / (double)result._iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        result._minNS = samples.front();
+        result._medianNS = samples[samples.size()/2];
+        result._itemsPerSecond = result._medianNS > 0.0 ? result._itemsPerSecond * 1e9 / result._medianNS : 0.0;
+        return result;
+    }
+
+    void write(std::ostream& out, const Result& r, bool json)
+    {
+        out << std::fixed << std::setprecision(3);
+        if (json)
+        {
+            out << "{\"name\":\"" << r._name << "\"";
+            if (!r._skipped.empty())
+                out << ",\"skipped\":\"" << r._skipped << "\"}";
+            else
+                out << ",\"iterations\":" << r._iterations
+                    << ",\"ns_per_op_min\":" << r._minNS
+                    << ",\"ns_per_op_median\":" << r._medianNS
+                    << ",\"items_per_second\":" << r._itemsPerSecond << "}";
+        }
+        else
+        {
+            out << r._name << ",";
+            if (!r._skipped.empty())
+                out << ",,,," << r._skipped;
+            else
+                out << r._iterations << "," << r._minNS << "," << r._medianNS << "," << r._itemsPerSecond << ",";
+        }
+        out << std::endl;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser arguments(&argc,argv);
+
+    if ( arguments.read("--help") )
+        return usage(argv[0]);
+
+    std::vector<Entry>& entries = registry();
+
+    if ( arguments.read("--list") )
+    {
+        for (unsigned i = 0; i < entries.size(); ++i)
+            std::cout << entries[i]._name << std::endl;
+        return 0;
+    }
+
+    std::string filter;
+    arguments.read("--filter", filter);
+
+    double minTime = 0.25;
+    arguments.read("--min-time", minTime);
+
+    unsigned repeat = 5u;
+    arguments.read("--repeat", repeat);
+    repeat = std::max(repeat, 1u);
+
+    std::string format = "json";
+    arguments.read("--format", format);
+    bool json = (format != "csv");
+
+    std::string outFile;
+    arguments.read("--out", outFile);
+
+    std::ofstream fout;
+    if ( !outFile.empty() )
+    {
+        fout.open( outFile.c_str() );
+        if ( !fout.is_open() )
+        {
+            OE_WARN << LC << "Cannot write to \"" << outFile << "\"" << std::endl;
+            return -1;
+        }
+    }
+    std::ostream& out = outFile.empty() ? std::cout : fout;
+
+    if ( !json )
+        out << "name,iterations,ns_per_op_min,ns_per_op_median,items_per_second,skipped" << std::endl;
+
+    for (unsigned i = 0; i < entries.size(); ++i)
+    {
+        if ( !filter.empty() && entries[i]._name.find(filter) == std::string::npos )
+            continue;
+
+        write( out, measure(entries[i], minTime, repeat), json );
+    }
+
+    return 0;
+}
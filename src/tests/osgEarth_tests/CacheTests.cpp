@@ -0,0 +1,134 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/StringUtils>
+#include <osg/Image>
+#include <osg/Timer>
+
+#include <osgEarthDrivers/cache_shm/SharedMemoryCache>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace
+{
+    osg::Image* makeImage(unsigned char seed)
+    {
+        osg::Image* image = new osg::Image();
+        image->allocateImage(64, 64, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+        for (unsigned i = 0; i < image->getTotalSizeInBytes(); ++i)
+            image->data()[i] = (unsigned char)(seed + i);
+        return image;
+    }
+
+    bool sameImage(const osg::Image* a, const osg::Image* b)
+    {
+        return
+            a && b &&
+            a->s() == b->s() && a->t() == b->t() &&
+            a->getPixelFormat() == b->getPixelFormat() &&
+            a->getTotalSizeInBytes() == b->getTotalSizeInBytes() &&
+            ::memcmp(a->data(), b->data(), a->getTotalSizeInBytes()) == 0;
+    }
+}
+
+TEST_CASE( "SharedMemoryCache stores and shares records" ) {
+
+    SharedMemoryCacheOptions options;
+    options.name() = Stringify() << "osgearth_tests_" << (unsigned)osg::Timer::instance()->tick();
+    options.size() = 4u;
+    options.blockSize() = 4u;
+
+    osg::ref_ptr<Cache> cache = CacheFactory::create(options);
+    REQUIRE( cache.valid() );
+    REQUIRE( cache->isOK() );
+
+    osg::ref_ptr<CacheBin> bin = cache->addBin("tiles");
+    REQUIRE( bin.valid() );
+
+    osg::ref_ptr<osg::Image> image = makeImage(7);
+
+    SECTION("Images read back unchanged") {
+        Config meta("meta");
+        meta.set("source", "test");
+        REQUIRE( bin->write("0/0/0", image.get(), meta, 0L) );
+
+        ReadResult r = bin->readImage("0/0/0", 0L);
+        REQUIRE( r.succeeded() );
+        REQUIRE( sameImage(r.getImage(), image.get()) );
+        REQUIRE( r.metadata().value("source") == "test" );
+        REQUIRE( bin->getRecordStatus("0/0/0") == CacheBin::STATUS_OK );
+    }
+
+    SECTION("Strings read back unchanged") {
+        REQUIRE( bin->write("string", new StringObject("hello"), Config(), 0L) );
+        REQUIRE( bin->readString("string", 0L).getString() == "hello" );
+    }
+
+    SECTION("Removed records are gone") {
+        REQUIRE( bin->write("0/0/0", image.get(), Config(), 0L) );
+        REQUIRE( bin->remove("0/0/0") );
+        REQUIRE( !bin->readImage("0/0/0", 0L).succeeded() );
+    }
+
+    SECTION("Bins don't see each other's records") {
+        osg::ref_ptr<CacheBin> other = cache->addBin("other");
+        REQUIRE( bin->write("0/0/0", image.get(), Config(), 0L) );
+        REQUIRE( !other->readImage("0/0/0", 0L).succeeded() );
+
+        REQUIRE( other->clear() );
+        REQUIRE( bin->readImage("0/0/0", 0L).succeeded() );
+    }
+
+    SECTION("A second cache with the same name sees the records") {
+        REQUIRE( bin->write("0/0/0", image.get(), Config(), 0L) );
+
+        osg::ref_ptr<Cache> cache2 = CacheFactory::create(options);
+        REQUIRE( cache2.valid() );
+        REQUIRE( cache2->isOK() );
+
+        ReadResult r = cache2->addBin("tiles")->readImage("0/0/0", 0L);
+        REQUIRE( r.succeeded() );
+        REQUIRE( sameImage(r.getImage(), image.get()) );
+    }
+
+    SECTION("Old records are evicted when full") {
+        // 4MB holds about 250 16KB images.
+        for (unsigned i = 0; i < 1000; ++i)
+        {
+            osg::ref_ptr<osg::Image> tile = makeImage((unsigned char)i);
+            REQUIRE( bin->write(Stringify() << i, tile.get(), Config(), 0L) );
+        }
+        REQUIRE( !bin->readImage("0", 0L).succeeded() );
+
+        ReadResult r = bin->readImage("999", 0L);
+        REQUIRE( r.succeeded() );
+        osg::ref_ptr<osg::Image> last = makeImage((unsigned char)999);
+        REQUIRE( sameImage(r.getImage(), last.get()) );
+    }
+
+    cache->clear();
+}
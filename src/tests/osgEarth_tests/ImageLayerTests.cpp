@@ -23,6 +23,8 @@
 #include <osgEarth/catch.hpp>
 
 #include <osgEarth/ImageLayer>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/CompositeTileSource>
 #include <osgEarth/Registry>
 
 #include <osgEarthDrivers/gdal/GDALOptions>
@@ -30,6 +32,36 @@
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
 
+namespace
+{
+    // Generates either one solid color or a translucent gradient.
+    class SyntheticSource : public TileSource
+    {
+    public:
+        SyntheticSource(bool uniform) : TileSource(TileSourceOptions()), _uniform(uniform) { }
+
+        Status initialize(const osgDB::Options* readOptions)
+        {
+            setProfile( Registry::instance()->getGlobalGeodeticProfile() );
+            return STATUS_OK;
+        }
+
+        osg::Image* createImage(const TileKey& key, ProgressCallback* progress)
+        {
+            osg::Image* image = new osg::Image();
+            image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+            ImageUtils::PixelWriter write(image);
+            for (int t = 0; t < image->t(); ++t)
+                for (int s = 0; s < image->s(); ++s)
+                    write(_uniform ? osg::Vec4(0, 0, 1, 1) : osg::Vec4(s/255.0f, t/255.0f, 0, 0.5f), s, t);
+            return image;
+        }
+
+    private:
+        bool _uniform;
+    };
+}
+
 TEST_CASE( "ImageLayers can be created from TileSourceOptions" ) {
 
     GDALOptions opt;
@@ -57,3 +89,30 @@ TEST_CASE( "ImageLayers can be created from TileSourceOptions" ) {
         REQUIRE(image.getExtent() == key.getExtent());
     }
 }
+
+TEST_CASE( "Composites over a single-color layer are not marked single-color" ) {
+
+    osg::ref_ptr< ImageLayer > bottom = new ImageLayer( ImageLayerOptions("bottom"), new SyntheticSource(true) );
+    osg::ref_ptr< ImageLayer > top = new ImageLayer( ImageLayerOptions("top"), new SyntheticSource(false) );
+    REQUIRE( bottom->open().isOK() );
+    REQUIRE( top->open().isOK() );
+
+    TileKey key(0, 0, 0, bottom->getProfile());
+
+    GeoImage bottomImage = bottom->createImage( key );
+    REQUIRE( bottomImage.valid() );
+    REQUIRE( ImageUtils::isMarkedAsSingleColor(bottomImage.getImage()) );
+
+    osg::ref_ptr< CompositeTileSource > composite = new CompositeTileSource();
+    REQUIRE( composite->add(bottom.get()) );
+    REQUIRE( composite->add(top.get()) );
+    REQUIRE( composite->open().isOK() );
+
+    osg::ref_ptr< osg::Image > mixed = composite->createImage( key, 0L );
+    REQUIRE( mixed.valid() );
+    REQUIRE( !ImageUtils::isSingleColorImage(mixed.get(), 0.0f) );
+    REQUIRE( !ImageUtils::isMarkedAsSingleColor(mixed.get()) );
+
+    // the copy must not have cleared the bottom layer's own mark
+    REQUIRE( ImageUtils::isMarkedAsSingleColor(bottomImage.getImage()) );
+}
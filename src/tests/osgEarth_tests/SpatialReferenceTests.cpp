@@ -23,9 +23,70 @@
 #include <osgEarth/catch.hpp>
 
 #include <osgEarth/SpatialReference>
+#include <osgEarth/StringUtils>
+#include <ogr_srs_api.h>
+#include <cmath>
 
 using namespace osgEarth;
 
+namespace
+{
+    // Reference transform straight through OGR, bypassing osgEarth's native paths.
+    bool ogrTransform(const std::string& from, const std::string& to, double& x, double& y)
+    {
+        OGRSpatialReferenceH fromSRS = OSRNewSpatialReference(NULL);
+        OGRSpatialReferenceH toSRS   = OSRNewSpatialReference(NULL);
+        bool ok = false;
+        if (OSRImportFromProj4(fromSRS, from.c_str()) == OGRERR_NONE &&
+            OSRImportFromProj4(toSRS,   to.c_str())   == OGRERR_NONE)
+        {
+            OGRCoordinateTransformationH xform = OCTNewCoordinateTransformation(fromSRS, toSRS);
+            if (xform)
+            {
+                ok = OCTTransform(xform, 1, &x, &y, 0L) != 0;
+                OCTDestroyCoordinateTransformation(xform);
+            }
+        }
+        OSRDestroySpatialReference(fromSRS);
+        OSRDestroySpatialReference(toSRS);
+        return ok;
+    }
+
+    std::string utmProj4(int zone, bool north)
+    {
+        return Stringify() << "+proj=utm +zone=" << zone << (north ? "" : " +south") << " +datum=WGS84 +units=m +no_defs";
+    }
+
+    std::string utmEPSG(int zone, bool north)
+    {
+        return Stringify() << "epsg:" << (north ? 32600 : 32700) + zone;
+    }
+
+    // Checks one geographic point against OGR in the given zone, and that it round-trips.
+    void checkUTM(int zone, bool north, double lon, double lat)
+    {
+        osg::ref_ptr<const SpatialReference> geo = SpatialReference::create("wgs84");
+        osg::ref_ptr<const SpatialReference> utm = SpatialReference::create(utmEPSG(zone, north));
+        REQUIRE(geo.valid());
+        REQUIRE(utm.valid());
+
+        INFO("zone " << zone << (north ? "N" : "S") << " lon " << lon << " lat " << lat);
+
+        double ex = lon, ey = lat;
+        REQUIRE(ogrTransform("+proj=longlat +datum=WGS84 +no_defs", utmProj4(zone, north), ex, ey));
+
+        osg::Vec3d out;
+        REQUIRE(geo->transform(osg::Vec3d(lon, lat, 0.0), utm.get(), out));
+        REQUIRE(std::fabs(out.x() - ex) < 0.001);
+        REQUIRE(std::fabs(out.y() - ey) < 0.001);
+
+        osg::Vec3d back;
+        REQUIRE(utm->transform(out, geo.get(), back));
+        REQUIRE(std::fabs(back.x() - lon) < 1e-8);
+        REQUIRE(std::fabs(back.y() - lat) < 1e-8);
+    }
+}
+
 TEST_CASE( "SpatialReferences are cached" ) {
     osg::ref_ptr< const SpatialReference > srs1 = SpatialReference::create("spherical-mercator");
     REQUIRE(srs1.valid());
@@ -90,3 +151,37 @@ TEST_CASE("Plate Carre SpatialReferences can be created") {
     REQUIRE(!plateCarre->isGeodetic());
     REQUIRE(plateCarre->isProjected());
 }
+
+TEST_CASE("Geographic to UTM matches OGR and round-trips") {
+    const int zones[] = { 1, 18, 31, 60 };
+
+    SECTION("northern hemisphere") {
+        for (unsigned z = 0; z < 4; ++z) {
+            double cm = -183.0 + 6.0*zones[z];
+            for (double lat = 0.0; lat <= 84.0; lat += 12.0) {
+                checkUTM(zones[z], true, cm, lat);
+                checkUTM(zones[z], true, cm - 3.0, lat);   // zone edges
+                checkUTM(zones[z], true, cm + 3.0, lat);
+            }
+        }
+    }
+
+    SECTION("southern hemisphere") {
+        for (unsigned z = 0; z < 4; ++z) {
+            double cm = -183.0 + 6.0*zones[z];
+            for (double lat = -80.0; lat < 0.0; lat += 10.0) {
+                checkUTM(zones[z], false, cm, lat);
+                checkUTM(zones[z], false, cm - 3.0, lat);
+                checkUTM(zones[z], false, cm + 3.0, lat);
+            }
+            checkUTM(zones[z], false, cm + 1.0, -0.001);     // just south of the equator
+        }
+    }
+
+    SECTION("outside the zone") {
+        // a few degrees past the zone edge is still fine; further out falls back to OGR.
+        checkUTM(18, true, -75.0 + 9.0, 45.0);
+        checkUTM(18, false, -75.0 - 9.0, -45.0);
+        checkUTM(18, true, -75.0 + 25.0, 30.0);
+    }
+}
@@ -0,0 +1,259 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Tessellator>
+#include <osg/Geometry>
+#include <osgUtil/Tessellator>
+#include <algorithm>
+#include <cmath>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Builds a geometry with one GL_LINE_LOOP DrawArrays per loop.
+    osg::Geometry* makeGeometry(const std::vector< std::vector<osg::Vec3> >& loops)
+    {
+        osg::Geometry* geom = new osg::Geometry();
+        osg::Vec3Array* verts = new osg::Vec3Array();
+        geom->setVertexArray(verts);
+        for (unsigned i = 0; i < loops.size(); ++i)
+        {
+            unsigned first = verts->size();
+            verts->insert(verts->end(), loops[i].begin(), loops[i].end());
+            geom->addPrimitiveSet(new osg::DrawArrays(GL_LINE_LOOP, first, loops[i].size()));
+        }
+        return geom;
+    }
+
+    std::vector<osg::Vec3> square(float x0, float y0, float size, bool ccw =true)
+    {
+        std::vector<osg::Vec3> loop;
+        loop.push_back(osg::Vec3(x0, y0, 0));
+        loop.push_back(osg::Vec3(x0+size, y0, 0));
+        loop.push_back(osg::Vec3(x0+size, y0+size, 0));
+        loop.push_back(osg::Vec3(x0, y0+size, 0));
+        if (!ccw)
+            std::reverse(loop.begin(), loop.end());
+        return loop;
+    }
+
+    std::vector<osg::Vec3> circle(float cx, float cy, float radius, unsigned numPoints)
+    {
+        std::vector<osg::Vec3> loop;
+        for (unsigned i = 0; i < numPoints; ++i)
+        {
+            double a = 2.0*osg::PI*(double)i/(double)numPoints;
+            loop.push_back(osg::Vec3(cx + radius*cos(a), cy + radius*sin(a), 0));
+        }
+        return loop;
+    }
+
+    double loopArea(const std::vector<osg::Vec3>& loop)
+    {
+        double sum = 0.0;
+        for (unsigned i = 0, j = loop.size()-1; i < loop.size(); j = i++)
+            sum += ((double)loop[j].x() - loop[i].x()) * ((double)loop[i].y() + loop[j].y());
+        return fabs(0.5*sum);
+    }
+
+    // Total area of the triangles the tessellator produced, and whether any
+    // triangle's centroid falls inside the given bounds (i.e. covers a hole).
+    double triangleArea(const osg::Geometry* geom, const osg::BoundingBox& hole =osg::BoundingBox())
+    {
+        const osg::Vec3Array* verts = static_cast<const osg::Vec3Array*>(geom->getVertexArray());
+        double total = 0.0;
+        for (unsigned p = 0; p < geom->getNumPrimitiveSets(); ++p)
+        {
+            const osg::PrimitiveSet* prim = geom->getPrimitiveSet(p);
+            REQUIRE(prim->getMode() == GL_TRIANGLES);
+            REQUIRE(prim->getNumIndices() % 3 == 0);
+            for (unsigned i = 0; i < prim->getNumIndices(); i += 3)
+            {
+                const osg::Vec3& a = (*verts)[prim->index(i)];
+                const osg::Vec3& b = (*verts)[prim->index(i+1)];
+                const osg::Vec3& c = (*verts)[prim->index(i+2)];
+                total += 0.5 * fabs(((b - a) ^ (c - a)).z());
+
+                osg::Vec3 centroid = (a + b + c) / 3.0f;
+                if (hole.valid())
+                    REQUIRE(!hole.contains(centroid));
+            }
+        }
+        return total;
+    }
+}
+
+TEST_CASE("Fast tessellator cuts holes out of polygons") {
+    Tessellator tess(Tessellator::METHOD_FAST);
+
+    SECTION("square with a hole") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10));
+        loops.push_back(square(3, 3, 4));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(geom->getNumPrimitiveSets() == 1u);
+        REQUIRE(fabs(triangleArea(geom.get(), osg::BoundingBox(3.01f, 3.01f, -1, 6.99f, 6.99f, 1)) - 84.0) < 1e-4);
+    }
+
+    SECTION("holes of either winding") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10, false));
+        loops.push_back(square(1, 1, 2, true));
+        loops.push_back(square(6, 6, 2, false));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(fabs(triangleArea(geom.get()) - (100.0 - 4.0 - 4.0)) < 1e-4);
+    }
+
+    SECTION("island inside a hole is filled again") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10));
+        loops.push_back(square(2, 2, 6));
+        loops.push_back(square(4, 4, 2));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(fabs(triangleArea(geom.get()) - (100.0 - 36.0 + 4.0)) < 1e-4);
+    }
+
+    SECTION("large ring with a hole uses the hashed path") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(circle(0, 0, 100, 500));
+        loops.push_back(circle(10, 0, 20, 100));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+
+        double expected = loopArea(loops[0]) - loopArea(loops[1]);
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(fabs(triangleArea(geom.get()) - expected) < 1e-3 * expected);
+    }
+
+    SECTION("other primitive sets are kept") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+        osg::ref_ptr<osg::PrimitiveSet> points = new osg::DrawArrays(GL_POINTS, 0, 4);
+        geom->addPrimitiveSet(points.get());
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(geom->getNumPrimitiveSets() == 2u);
+        REQUIRE(geom->getPrimitiveSet(0) == points.get());
+    }
+}
+
+TEST_CASE("Fast tessellator handles degenerate rings") {
+    Tessellator tess(Tessellator::METHOD_FAST);
+
+    SECTION("repeated closing vertex") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10));
+        loops[0].push_back(loops[0].front());
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(fabs(triangleArea(geom.get()) - 100.0) < 1e-4);
+    }
+
+    SECTION("loops with fewer than three points are ignored") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10));
+        loops.push_back(std::vector<osg::Vec3>(2, osg::Vec3(5, 5, 0)));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+
+        REQUIRE(tess.tessellateGeometry(*geom));
+        REQUIRE(fabs(triangleArea(geom.get()) - 100.0) < 1e-4);
+    }
+
+    SECTION("zero-area ring fails without touching the geometry") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        std::vector<osg::Vec3> line;
+        line.push_back(osg::Vec3(0, 0, 0));
+        line.push_back(osg::Vec3(5, 0, 0));
+        line.push_back(osg::Vec3(10, 0, 0));
+        line.push_back(osg::Vec3(5, 0, 0));
+        loops.push_back(line);
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+        osg::ref_ptr<osg::PrimitiveSet> original = geom->getPrimitiveSet(0);
+
+        REQUIRE(!tess.tessellateGeometry(*geom));
+        REQUIRE(geom->getNumPrimitiveSets() == 1u);
+        REQUIRE(geom->getPrimitiveSet(0) == original.get());
+    }
+}
+
+TEST_CASE("Fast tessellator leaves the geometry alone when it cannot run") {
+    // Callers fall back to another tessellator when this returns false, so
+    // the input must come back untouched.
+    Tessellator tess(Tessellator::METHOD_FAST);
+
+    SECTION("unsupported primitive type") {
+        osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+        std::vector<osg::Vec3> loop = square(0, 0, 10);
+        geom->setVertexArray(new osg::Vec3Array(loop.begin(), loop.end()));
+        osg::DrawElementsUShort* elements = new osg::DrawElementsUShort(GL_POLYGON);
+        for (unsigned short i = 0; i < 4; ++i)
+            elements->push_back(i);
+        geom->addPrimitiveSet(elements);
+
+        REQUIRE(!tess.tessellateGeometry(*geom));
+        REQUIRE(geom->getNumPrimitiveSets() == 1u);
+        REQUIRE(geom->getPrimitiveSet(0) == elements);
+    }
+
+    SECTION("loop runs past the vertex array") {
+        std::vector< std::vector<osg::Vec3> > loops;
+        loops.push_back(square(0, 0, 10));
+        osg::ref_ptr<osg::Geometry> geom = makeGeometry(loops);
+        static_cast<osg::DrawArrays*>(geom->getPrimitiveSet(0))->setCount(8);
+
+        REQUIRE(!tess.tessellateGeometry(*geom));
+        REQUIRE(geom->getPrimitiveSet(0)->getMode() == GL_LINE_LOOP);
+    }
+
+    SECTION("the GLU fallback runs on what the fast method rejects") {
+        // same sequence as BuildGeometryFilter's tesselateGeometry()
+        osg::ref_ptr<osg::Geometry> geom = new osg::Geometry();
+        std::vector<osg::Vec3> loop = square(0, 0, 10);
+        geom->setVertexArray(new osg::Vec3Array(loop.begin(), loop.end()));
+        osg::DrawElementsUShort* elements = new osg::DrawElementsUShort(GL_POLYGON);
+        for (unsigned short i = 0; i < 4; ++i)
+            elements->push_back(i);
+        geom->addPrimitiveSet(elements);
+
+        REQUIRE(!tess.tessellateGeometry(*geom));
+
+        osgUtil::Tessellator glu;
+        glu.setTessellationType(osgUtil::Tessellator::TESS_TYPE_GEOMETRY);
+        glu.setWindingType(osgUtil::Tessellator::TESS_WINDING_POSITIVE);
+        glu.retessellatePolygons(*geom);
+
+        REQUIRE(geom->getNumPrimitiveSets() > 0u);
+        for (unsigned p = 0; p < geom->getNumPrimitiveSets(); ++p)
+            REQUIRE(geom->getPrimitiveSet(p)->getMode() != GL_POLYGON);
+    }
+}
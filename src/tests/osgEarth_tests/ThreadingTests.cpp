@@ -22,6 +22,7 @@
 
 #include <osgEarth/catch.hpp>
 #include <osgEarth/ThreadingUtils>
+#include <osgEarth/TaskService>
 
 using namespace osgEarth;
 
@@ -132,4 +133,75 @@ TEST_CASE( "ReadWriteMutex can handle mulitple read locks from the same thread w
     REQUIRE(!thread2.isRunning());
     REQUIRE(elapsedTime < maxTimeSeconds);
 }
-*/
\ No newline at end of file
+*/
+
+namespace WorkStealingQueueTest
+{
+    struct NopTask : public osgEarth::TaskRequest
+    {
+        void operator()(osgEarth::ProgressCallback*) { }
+    };
+
+    // Adds one request to a queue, blocking if the queue is full.
+    class Adder : public OpenThreads::Thread
+    {
+    public:
+        Adder(osgEarth::WorkStealingTaskRequestQueue* queue) : _queue(queue) { }
+        void run() { _queue->add(new NopTask()); }
+        osgEarth::WorkStealingTaskRequestQueue* _queue;
+    };
+}
+
+TEST_CASE( "WorkStealingTaskRequestQueue never holds more than its maximum size" ) {
+
+    const unsigned maxSize = 4u;
+    const unsigned numAdders = 16u;
+
+    osg::ref_ptr<osgEarth::WorkStealingTaskRequestQueue> queue =
+        new osgEarth::WorkStealingTaskRequestQueue(3u, maxSize);
+
+    std::vector<WorkStealingQueueTest::Adder*> adders;
+    for (unsigned i = 0; i < numAdders; ++i)
+    {
+        adders.push_back(new WorkStealingQueueTest::Adder(queue.get()));
+        adders.back()->start();
+    }
+
+    // Let the adders pile up against the bound.
+    OpenThreads::Thread::microSleep(200000);
+    REQUIRE(queue->getNumRequests() <= maxSize);
+
+    // Drain everything, checking the bound as blocked adders get in.
+    for (unsigned i = 0; i < numAdders; ++i)
+    {
+        osg::ref_ptr<osgEarth::TaskRequest> request = queue->get(i % queue->getNumSlots());
+        REQUIRE(request.valid());
+        REQUIRE(queue->getNumRequests() <= maxSize);
+    }
+
+    for (unsigned i = 0; i < numAdders; ++i)
+    {
+        adders[i]->join();
+        delete adders[i];
+    }
+
+    REQUIRE(queue->getNumRequests() == 0u);
+}
+
+TEST_CASE( "WorkStealingTaskRequestQueue round-robins many requests without losing any" ) {
+
+    const unsigned numSlots = 3u;
+
+    osg::ref_ptr<osgEarth::WorkStealingTaskRequestQueue> queue =
+        new osgEarth::WorkStealingTaskRequestQueue(numSlots);
+
+    for (unsigned i = 0; i < 100u * numSlots; ++i)
+        queue->add(new WorkStealingQueueTest::NopTask());
+
+    REQUIRE(queue->getNumRequests() == 100u * numSlots);
+
+    osgEarth::TaskRequestList drained;
+    queue->drain(drained);
+    REQUIRE(drained.size() == 100u * numSlots);
+    REQUIRE(queue->getNumRequests() == 0u);
+}